@@ -0,0 +1,301 @@
+//******************************************************************************
+//* File:   kernels_bench.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../lib/datatypes/Position2D.h"
+#include "../src/framefilter/BackgroundSubtractor.h"
+#include "../src/framefilter/BackgroundSubtractorMOG.h"
+#include "../src/framefilter/FrameMasker.h"
+#include "../src/framefilter/Undistorter.h"
+#include "../src/positiondetector/DetectorFunc.h"
+#include "../src/positiondetector/DifferenceDetector.h"
+#include "../src/positiondetector/HSVDetector.h"
+#include "../src/positiondetector/SimpleThreshold.h"
+
+namespace po = boost::program_options;
+
+// Frame sizes benchmarked, indexed by the first benchmark argument. The 1 and
+// 5 MP frames are the test/perf images. The others are resized from the 5 MP
+// image so that detectors see natural content.
+struct FrameSize { const char *name; int cols, rows; const char *image; };
+static const std::vector<FrameSize> frame_sizes {
+    {"0.3MP", 640, 480, nullptr},
+    {"1MP", 0, 0, "earth-1MP.jpg"},
+    {"5MP", 0, 0, "beach-5MP.jpg"},
+    {"20MP", 5472, 3648, nullptr},
+};
+
+/**
+ * BGR test frame of a given size. Loaded once. Falls back to a synthetic
+ * frame, noise with a bright blob, if the test/perf images cannot be read.
+ */
+static const cv::Mat &testFrame(const size_t index)
+{
+    static std::map<size_t, cv::Mat> frames;
+    auto it = frames.find(index);
+    if (it != frames.end())
+        return it->second;
+
+    const auto &s = frame_sizes[index];
+    const std::string dir = OAT_PERF_DIR;
+    cv::Mat frame = cv::imread(dir + "/" + (s.image ? s.image : "beach-5MP.jpg"),
+                               cv::IMREAD_COLOR);
+
+    const cv::Size size = s.image ? frame.size() : cv::Size(s.cols, s.rows);
+    if (frame.empty()) {
+        frame.create(size.area() > 0 ? size : cv::Size(1000, 1000), CV_8UC3);
+        cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(64));
+        cv::circle(frame, cv::Point(frame.cols / 2, frame.rows / 2),
+                   frame.rows / 20, cv::Scalar(40, 220, 40), -1);
+    } else if (!s.image) {
+        cv::resize(frame, frame, size, 0, 0, cv::INTER_AREA);
+    }
+
+    return frames[index] = frame;
+}
+
+static const cv::Mat &testGrey(const size_t index)
+{
+    static std::map<size_t, cv::Mat> frames;
+    auto it = frames.find(index);
+    if (it != frames.end())
+        return it->second;
+
+    cv::Mat grey;
+    cv::cvtColor(testFrame(index), grey, cv::COLOR_BGR2GRAY);
+    return frames[index] = grey;
+}
+
+/**
+ * Configure a component from command line style arguments, as its program
+ * would.
+ */
+template <typename C>
+static void configure(C &component, const std::vector<std::string> &args)
+{
+    po::options_description opts;
+    component.appendOptions(opts);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(args).options(opts).run(), vm);
+    po::notify(vm);
+
+    component.configure(vm);
+}
+
+// Reach the protected kernels of detectors and filters, which are otherwise
+// only called from their process() loops
+struct DetectorAccess : oat::PositionDetector {
+
+    static void detect(oat::PositionDetector &d, cv::Mat &frame, oat::Position2D &pos)
+    {
+        (d.*(&DetectorAccess::detectPosition))(frame, pos);
+    }
+
+    static bool zeroCopy(const oat::PositionDetector &d)
+    {
+        return d.*(&DetectorAccess::zero_copy_);
+    }
+};
+
+struct FilterAccess : oat::FrameFilter {
+
+    static void filter(oat::FrameFilter &f, const cv::Mat &in, cv::Mat &out)
+    {
+        (f.*(&FilterAccess::filterInto))(in, out);
+    }
+};
+
+static void setLabel(benchmark::State &state)
+{
+    state.SetLabel(frame_sizes[state.range(0)].name);
+}
+
+/**
+ * Run a detector on successive frames. Detectors that modify their frame get
+ * a fresh copy each iteration, outside of the timed region.
+ */
+static void detect(benchmark::State &state,
+                   oat::PositionDetector &detector,
+                   const std::vector<cv::Mat> &frames)
+{
+    const bool copy = !DetectorAccess::zeroCopy(detector);
+    oat::Position2D pos("bench");
+    cv::Mat work;
+    size_t i = 0;
+
+    for (auto _ : state) {
+        const cv::Mat &frame = frames[i++ % frames.size()];
+        if (copy) {
+            state.PauseTiming();
+            frame.copyTo(work);
+            state.ResumeTiming();
+        } else {
+            work = frame;
+        }
+
+        DetectorAccess::detect(detector, work, pos);
+        benchmark::DoNotOptimize(pos.position);
+    }
+
+    setLabel(state);
+}
+
+static void BM_HSVDetector(benchmark::State &state)
+{
+    oat::HSVDetector detector("raw", "pos");
+    configure(detector, {"-H", "[30,80]", "-S", "[100,256]", "-V", "[100,256]"});
+    detect(state, detector, {testFrame(state.range(0))});
+}
+
+static void BM_DifferenceDetector(benchmark::State &state)
+{
+    // Alternate between the frame and a shifted copy, so there is always a
+    // difference to find
+    const cv::Mat &grey = testGrey(state.range(0));
+    cv::Mat shifted;
+    cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, 8, 0, 1, 8);
+    cv::warpAffine(grey, shifted, shift, grey.size());
+
+    oat::DifferenceDetector detector("raw", "pos");
+    configure(detector, {});
+    detect(state, detector, {grey, shifted});
+}
+
+static void BM_SimpleThreshold(benchmark::State &state)
+{
+    oat::SimpleThreshold detector("raw", "pos");
+    configure(detector, {"-T", "[200,256]"});
+    detect(state, detector, {testGrey(state.range(0))});
+}
+
+static void BM_siftContours(benchmark::State &state)
+{
+    cv::Mat binary;
+    cv::threshold(testGrey(state.range(0)), binary, 200, 255, cv::THRESH_BINARY);
+
+    oat::Position2D pos("bench");
+    double area = 0;
+    cv::Mat work;
+
+    for (auto _ : state) {
+        // Contour tracing modifies the frame
+        state.PauseTiming();
+        binary.copyTo(work);
+        state.ResumeTiming();
+
+        oat::siftContours(work, pos, area, 0, binary.total());
+        benchmark::DoNotOptimize(pos.position);
+    }
+
+    setLabel(state);
+}
+
+/**
+ * Run a filter from an unmodified source frame into a scratch frame, as done
+ * between shared frames by zero copy filters.
+ */
+static void filter(benchmark::State &state,
+                   oat::FrameFilter &filter,
+                   const cv::Mat &frame)
+{
+    cv::Mat out;
+    for (auto _ : state) {
+        FilterAccess::filter(filter, frame, out);
+        benchmark::DoNotOptimize(out.data);
+    }
+
+    state.SetBytesProcessed(state.iterations() * frame.total() * frame.elemSize());
+    setLabel(state);
+}
+
+static void BM_BackgroundSubtractor(benchmark::State &state)
+{
+    oat::BackgroundSubtractor bsub("raw", "flt");
+    configure(bsub, {"-a", "0.1"});
+    filter(state, bsub, testFrame(state.range(0)));
+}
+
+static void BM_BackgroundSubtractorMOG(benchmark::State &state)
+{
+    oat::BackgroundSubtractorMOG mog("raw", "flt");
+    configure(mog, {});
+    filter(state, mog, testFrame(state.range(0)));
+}
+
+static void BM_FrameMasker(benchmark::State &state)
+{
+    const cv::Mat &frame = testFrame(state.range(0));
+
+    // Circular region of interest
+    cv::Mat mask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    cv::circle(mask, cv::Point(mask.cols / 2, mask.rows / 2),
+               mask.rows / 2, cv::Scalar(255), -1);
+    const std::string path = "/tmp/oat-kernels-bench-mask-"
+                             + std::to_string(state.range(0)) + ".png";
+    cv::imwrite(path, mask);
+
+    oat::FrameMasker masker("raw", "flt");
+    configure(masker, {"-f", path});
+    filter(state, masker, frame);
+}
+
+static void BM_Undistorter(benchmark::State &state)
+{
+    const cv::Mat &frame = testFrame(state.range(0));
+
+    // Plausible lens for the frame size
+    const auto f = std::to_string(frame.cols);
+    const auto cx = std::to_string(frame.cols / 2);
+    const auto cy = std::to_string(frame.rows / 2);
+
+    oat::Undistorter undistorter("raw", "flt");
+    configure(undistorter,
+              {"-k", "[" + f + ",0," + cx + ",0," + f + "," + cy + ",0,0,1]",
+               "-d", "[-0.2,0.05,0,0,0]"});
+    filter(state, undistorter, frame);
+}
+
+static void frameSizes(benchmark::internal::Benchmark *b)
+{
+    for (size_t i = 0; i < frame_sizes.size(); i++)
+        b->Arg(i);
+    b->ArgName("size")->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_HSVDetector)->Apply(frameSizes);
+BENCHMARK(BM_DifferenceDetector)->Apply(frameSizes);
+BENCHMARK(BM_SimpleThreshold)->Apply(frameSizes);
+BENCHMARK(BM_siftContours)->Apply(frameSizes);
+BENCHMARK(BM_BackgroundSubtractor)->Apply(frameSizes);
+BENCHMARK(BM_BackgroundSubtractorMOG)->Apply(frameSizes);
+BENCHMARK(BM_FrameMasker)->Apply(frameSizes);
+BENCHMARK(BM_Undistorter)->Apply(frameSizes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,554 @@
+//******************************************************************************
+//* File:   serialization_bench.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/multicast.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/program_options.hpp>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <zmq.hpp>
+
+#include "../lib/datatypes/Position2D.h"
+#include "../lib/shmemdf/Sink.h"
+#include "../src/positionsocket/PositionPublisher.h"
+#include "../src/positionsocket/PositionSerializer.h"
+#include "../src/positionsocket/UDPPositionClient.h"
+
+namespace po = boost::program_options;
+
+// Heap allocations made by this process, counted by the replacement global
+// operator new below
+static std::atomic<size_t> allocations {0};
+
+void *operator new(size_t bytes)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+/**
+ * Report heap allocations per iteration since a count taken before the
+ * benchmark loop.
+ */
+static void countAllocations(benchmark::State &state, const size_t before)
+{
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(allocations.load() - before),
+        benchmark::Counter::kAvgIterations);
+}
+
+/**
+ * A position with every field valid, so that concise JSON is as long as it
+ * gets.
+ */
+static oat::Position2D testPosition()
+{
+    oat::Position2D p("bench");
+    p.position_valid = true;
+    p.position = cv::Point2d(312.25, 207.5);
+    p.velocity_valid = true;
+    p.velocity = cv::Point2d(-1.125, 3.5);
+    p.heading_valid = true;
+    p.heading = cv::Point2d(0.6, 0.8);
+    p.region_valid = true;
+    std::strncpy(p.region, "north", sizeof(p.region));
+    return p;
+}
+
+/**
+ * Position formats. Each holds its own buffers, as a socket or recorder
+ * would, and provides encode(), returning the encoded bytes, and decode() of
+ * those bytes. A new format is benchmarked by adding a codec here and
+ * registering it at the bottom of this file.
+ */
+
+// JSON, as sent by sockets (concise) or written by oat-record (verbose)
+template <bool Verbose>
+struct JSONCodec {
+
+    static const char *name() { return Verbose ? "json-verbose" : "json"; }
+
+    const char *encode(const oat::Position2D &p, size_t &bytes)
+    {
+        buffer.Clear();
+        writer.Reset(buffer);
+        oat::serializePosition(p, writer, Verbose);
+        bytes = buffer.GetSize();
+        return buffer.GetString();
+    }
+
+    // Parse as a consumer would, with a fresh document per message, and
+    // read the fields back as oat-posigen's replay does
+    void decode(const char *data, size_t bytes, oat::Position2D &p)
+    {
+        rapidjson::Document doc;
+        doc.Parse(data, bytes);
+
+        auto flag = [&doc](const char *key) {
+            return doc.HasMember(key) && doc[key].IsBool() && doc[key].GetBool();
+        };
+
+        auto pair = [&doc](const char *key, double *out) {
+            if (!doc.HasMember(key) || !doc[key].IsArray() || doc[key].Size() != 2)
+                return false;
+            out[0] = doc[key][0].GetDouble();
+            out[1] = doc[key][1].GetDouble();
+            return true;
+        };
+
+        auto r = p.record();
+        r.position_valid = flag("pos_ok") && pair("pos_xy", r.position);
+        r.velocity_valid = flag("vel_ok") && pair("vel_xy", r.velocity);
+        r.heading_valid = flag("head_ok") && pair("head_xy", r.heading);
+        r.region_valid = flag("reg_ok") && doc.HasMember("reg");
+        if (r.region_valid)
+            std::strncpy(r.region, doc["reg"].GetString(), sizeof(r.region));
+        r.region[sizeof(r.region) - 1] = '\0';
+        p.set_record(r);
+    }
+
+    rapidjson::StringBuffer buffer {nullptr,
+                                    oat::PositionSerializer<>::INITIAL_BYTES};
+    rapidjson::Writer<rapidjson::StringBuffer> writer {buffer};
+};
+
+// Records in the layout of Position2D::NPY_DTYPE, as sent by binary sockets
+// and written to binary position files
+struct NPYCodec {
+
+    static const char *name() { return "npy"; }
+
+    const char *encode(const oat::Position2D &p, size_t &bytes)
+    {
+        oat::packPosition(p, packed);
+        bytes = sizeof(packed);
+        return packed;
+    }
+
+    void decode(const char *data, size_t bytes, oat::Position2D &p)
+    {
+        (void)bytes;
+        oat::unpackPosition(data, p);
+    }
+
+    char packed[oat::Position2D::NPY_DTYPE_BYTES];
+};
+
+/**
+ * Encode throughput, bytes per sample and allocations per sample. The
+ * position changes each iteration so that the number formatting is not of
+ * one value.
+ */
+template <typename Codec>
+static void BM_Encode(benchmark::State &state)
+{
+    Codec codec;
+    auto p = testPosition();
+    size_t bytes {0}, total {0};
+
+    // Grow the codec's buffers before counting
+    codec.encode(p, bytes);
+    const size_t before = allocations.load();
+
+    for (auto _ : state) {
+        p.position.x += 0.25;
+        benchmark::DoNotOptimize(codec.encode(p, bytes));
+        total += bytes;
+    }
+
+    countAllocations(state, before);
+    state.counters["bytes"] = bytes;
+    state.SetBytesProcessed(total);
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(Codec::name());
+}
+
+/**
+ * Decode throughput and allocations per sample, of the encoding of the
+ * test position.
+ */
+template <typename Codec>
+static void BM_Decode(benchmark::State &state)
+{
+    Codec codec;
+    auto p = testPosition();
+    size_t bytes {0};
+    const char *data = codec.encode(p, bytes);
+    const std::vector<char> encoded(data, data + bytes);
+
+    oat::Position2D decoded("decoded");
+    const size_t before = allocations.load();
+
+    for (auto _ : state) {
+        codec.decode(encoded.data(), encoded.size(), decoded);
+        benchmark::DoNotOptimize(decoded.position.x);
+    }
+
+    countAllocations(state, before);
+    state.counters["bytes"] = bytes;
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(Codec::name());
+}
+
+/**
+ * Configure a component from command line style arguments, as its program
+ * would.
+ */
+template <typename C>
+static void configure(C &component, const std::vector<std::string> &args)
+{
+    po::options_description opts;
+    component.appendOptions(opts);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(args).options(opts).run(), vm);
+    po::notify(vm);
+
+    component.configure(vm);
+}
+
+// Each benchmark run gets its own node and port so that runs do not see each
+// other's leftover readers and connections
+static std::string nextAddress()
+{
+    static int n = 0;
+    return "serial_bench_" + std::to_string(n++);
+}
+
+static int nextPort()
+{
+    static int port = 15600;
+    return port++;
+}
+
+/**
+ * Subscribers that count the messages they receive on a thread of their
+ * own. Concrete subscribers open their sockets on that thread, via open(),
+ * and receive everything waiting on them via drain().
+ */
+class Subscribers {
+public:
+    virtual ~Subscribers() { }
+
+    // Wait until the sockets are open
+    void start()
+    {
+        thread_ = std::thread([this] {
+            open();
+            ready_ = true;
+
+            // Keep draining after stop() until the sockets fall quiet, so
+            // that messages in flight are counted
+            bool quiet = false;
+            while (!(done_ && quiet))
+                quiet = !drain(POLL_MS);
+        });
+
+        while (!ready_)
+            std::this_thread::yield();
+    }
+
+    // Messages received by all subscribers
+    size_t stop()
+    {
+        done_ = true;
+        thread_.join();
+        return received_;
+    }
+
+protected:
+    static constexpr int POLL_MS {50};
+
+    virtual void open() = 0;
+    virtual bool drain(int timeout_ms) = 0;
+
+    size_t received_ {0};
+
+private:
+    std::thread thread_;
+    std::atomic<bool> ready_ {false};
+    std::atomic<bool> done_ {false};
+};
+
+// SUB sockets connected to a PositionPublisher
+class ZMQSubscribers : public Subscribers {
+public:
+    ZMQSubscribers(int count, const std::string &endpoint)
+    : count_(count)
+    , endpoint_(endpoint)
+    {
+        start();
+    }
+
+private:
+    void open() override
+    {
+        for (int i = 0; i < count_; i++) {
+            sockets_.emplace_back(context_, ZMQ_SUB);
+            sockets_.back().setsockopt(ZMQ_SUBSCRIBE, "", 0);
+            sockets_.back().connect(endpoint_);
+        }
+
+        for (auto &s : sockets_)
+            items_.push_back({static_cast<void *>(s), 0, ZMQ_POLLIN, 0});
+
+        // PUB drops messages to subscribers still joining
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    bool drain(int timeout_ms) override
+    {
+        if (zmq::poll(items_.data(), items_.size(), timeout_ms) <= 0)
+            return false;
+
+        zmq::message_t msg;
+        for (size_t i = 0; i < sockets_.size(); i++)
+            if (items_[i].revents & ZMQ_POLLIN)
+                while (sockets_[i].recv(&msg, ZMQ_DONTWAIT))
+                    received_++;
+
+        return true;
+    }
+
+    const int count_;
+    const std::string endpoint_;
+    zmq::context_t context_ {1};
+    std::vector<zmq::socket_t> sockets_;
+    std::vector<zmq::pollitem_t> items_;
+};
+
+// Listeners that have joined the multicast group a UDPPositionClient sends
+// to, over the loopback interface
+class UDPSubscribers : public Subscribers {
+public:
+    UDPSubscribers(int count, const std::string &group, int port)
+    : count_(count)
+    , group_(boost::asio::ip::address::from_string(group))
+    , port_(port)
+    {
+        start();
+    }
+
+private:
+    using udp = boost::asio::ip::udp;
+
+    void open() override
+    {
+        const auto loopback = boost::asio::ip::address_v4::loopback();
+
+        for (int i = 0; i < count_; i++) {
+            sockets_.emplace_back(io_service_);
+            auto &s = sockets_.back();
+            s.open(udp::v4());
+            s.set_option(udp::socket::reuse_address(true));
+            s.bind(udp::endpoint(boost::asio::ip::address_v4::any(), port_));
+            s.set_option(boost::asio::ip::multicast::join_group(
+                group_.to_v4(), loopback));
+            s.non_blocking(true);
+            fds_.push_back({s.native_handle(), POLLIN, 0});
+        }
+    }
+
+    bool drain(int timeout_ms) override
+    {
+        if (::poll(fds_.data(), fds_.size(), timeout_ms) <= 0)
+            return false;
+
+        char datagram[oat::PositionSerializer<>::INITIAL_BYTES];
+        for (size_t i = 0; i < sockets_.size(); i++) {
+            if (!(fds_[i].revents & POLLIN))
+                continue;
+
+            boost::system::error_code ec;
+            while (sockets_[i].receive(
+                       boost::asio::buffer(datagram, sizeof(datagram)), 0, ec),
+                   !ec)
+                received_++;
+        }
+
+        return true;
+    }
+
+    const int count_;
+    const boost::asio::ip::address group_;
+    const int port_;
+    boost::asio::io_service io_service_;
+    std::vector<udp::socket> sockets_;
+    std::vector<pollfd> fds_;
+};
+
+/**
+ * Step a position socket, end to end from its SOURCE node to its
+ * subscribers, while a sink thread publishes positions as fast as the socket
+ * reads them. Sends per second are the items rate. Messages delivered to all
+ * subscribers, and the fraction of them lost, e.g. to the PUB high water mark
+ * or full receive buffers, are reported alongside.
+ */
+template <typename Socket>
+static void socketSend(benchmark::State &state,
+                       Socket &socket,
+                       const std::string &addr,
+                       Subscribers &subscribers)
+{
+    const int num_subscribers = state.range(1);
+    std::atomic<bool> done {false};
+
+    std::thread producer([&addr, &done] {
+        oat::Sink<oat::Position2D> sink;
+        sink.bind(addr, "bench");
+
+        auto p = testPosition();
+        while (!done) {
+            p.position.x += 0.25;
+            sink.wait();
+            sink.write(p);
+            sink.post();
+        }
+    }); // Sink leaves the node, ending the socket's stream
+
+    if (!socket.connect()) {
+        state.SkipWithError("Socket could not connect to its SOURCE.");
+        done = true;
+        producer.join();
+        subscribers.stop();
+        return;
+    }
+
+    for (auto _ : state)
+        socket.step();
+
+    done = true;
+    while (!socket.step()) { }
+    producer.join();
+
+    const size_t received = subscribers.stop();
+    const double expected
+        = static_cast<double>(state.iterations()) * num_subscribers;
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["delivered"]
+        = benchmark::Counter(received, benchmark::Counter::kIsRate);
+    state.counters["lost"]
+        = expected > 0 ? std::max(0.0, 1.0 - received / expected) : 0.0;
+    state.SetLabel(state.range(0) ? "npy" : "json");
+}
+
+/**
+ * PositionPublisher over TCP loopback. Arguments are whether positions are
+ * sent binary (1) or as JSON (0), and the number of SUB sockets.
+ */
+static void BM_PublisherSend(benchmark::State &state)
+{
+    const std::string addr = nextAddress();
+    const std::string endpoint
+        = "tcp://127.0.0.1:" + std::to_string(nextPort());
+
+    oat::PositionPublisher socket(addr);
+    std::vector<std::string> args {"--endpoint", endpoint};
+    if (state.range(0))
+        args.push_back("--binary");
+    configure(socket, args);
+
+    ZMQSubscribers subscribers(state.range(1), endpoint);
+    socketSend(state, socket, addr, subscribers);
+}
+
+/**
+ * UDPPositionClient multicasting over the loopback interface, which is how
+ * one client reaches many listeners. Arguments are as for
+ * BM_PublisherSend.
+ */
+static void BM_UDPClientSend(benchmark::State &state)
+{
+    const std::string addr = nextAddress();
+    const std::string group {"239.255.0.1"};
+    const int port = nextPort();
+
+    oat::UDPPositionClient socket(addr);
+    std::vector<std::string> args {"--host", group,
+                                   "--port", std::to_string(port),
+                                   "--interface", "127.0.0.1",
+                                   "--loopback"};
+    if (state.range(0))
+        args.push_back("--binary");
+
+    try {
+        configure(socket, args);
+    } catch (const std::exception &ex) {
+        state.SkipWithError(ex.what());
+        return;
+    }
+
+    UDPSubscribers subscribers(state.range(1), group, port);
+    socketSend(state, socket, addr, subscribers);
+}
+
+// JSON and binary encodings to 1 to 100 subscribers
+static void sendArgs(benchmark::internal::Benchmark *b)
+{
+    for (int64_t binary = 0; binary <= 1; binary++)
+        for (int64_t n : {1, 2, 5, 10, 20, 50, 100})
+            b->Args({binary, n});
+}
+
+BENCHMARK_TEMPLATE(BM_Encode, JSONCodec<false>);
+BENCHMARK_TEMPLATE(BM_Encode, JSONCodec<true>);
+BENCHMARK_TEMPLATE(BM_Encode, NPYCodec);
+
+BENCHMARK_TEMPLATE(BM_Decode, JSONCodec<false>);
+BENCHMARK_TEMPLATE(BM_Decode, JSONCodec<true>);
+BENCHMARK_TEMPLATE(BM_Decode, NPYCodec);
+
+BENCHMARK(BM_PublisherSend)
+    ->Apply(sendArgs)
+    ->ArgNames({"binary", "subscribers"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_UDPClientSend)
+    ->Apply(sendArgs)
+    ->ArgNames({"binary", "subscribers"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,233 @@
+//******************************************************************************
+//* File:   shmemdf_bench.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lib/datatypes/Color.h"
+#include "../lib/datatypes/Frame.h"
+#include "../lib/datatypes/Position2D.h"
+#include "../lib/shmemdf/Node.h"
+#include "../lib/shmemdf/SharedFrameHeader.h"
+#include "../lib/shmemdf/Sink.h"
+#include "../lib/shmemdf/Source.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+// Each benchmark run gets its own node so that runs do not see each other's
+// leftover readers
+static std::string nextAddress()
+{
+    static int n = 0;
+    return "bench_" + std::to_string(n++);
+}
+
+/**
+ * Time each sink wait() -> write -> post() round trip, which only completes
+ * once every reader has read the previous sample and posted, and report the
+ * 50th and 99th percentile in ns alongside the mean per op.
+ * @param state Benchmark state
+ * @param readers Reader threads, each of which connects a source and loops
+ * wait() -> read -> post() until the sink leaves.
+ * @param connected Number of readers that have connected
+ * @param write Write a sample between sink wait() and post()
+ */
+template <typename Write>
+static void roundTrips(benchmark::State &state,
+                       std::vector<std::thread> &readers,
+                       const std::atomic<int> &connected,
+                       Write write)
+{
+    while (connected.load() < static_cast<int>(readers.size()))
+        std::this_thread::yield();
+
+    std::vector<int64_t> ns;
+    ns.reserve(1 << 20);
+
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        write();
+        const auto t1 = std::chrono::steady_clock::now();
+        if (ns.size() < ns.capacity())
+            ns.push_back(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(t1 - t0).count());
+    }
+
+    if (!ns.empty()) {
+        std::sort(ns.begin(), ns.end());
+        state.counters["p50_ns"] = ns[ns.size() / 2];
+        state.counters["p99_ns"] = ns[ns.size() * 99 / 100];
+    }
+    state.counters["readers"] = readers.size();
+}
+
+/**
+ * Frame round trips. Arguments are columns and rows of 8-bit grey frames,
+ * whether payloads are copied in and out (1) or only touched (0), which
+ * separates transport cost from memory bandwidth, and the number of readers.
+ */
+static void BM_FrameRoundTrip(benchmark::State &state)
+{
+    const int cols = state.range(0);
+    const int rows = state.range(1);
+    const bool copy = state.range(2) != 0;
+    const int num_readers = state.range(3);
+    const std::string addr = nextAddress();
+
+    std::vector<std::thread> readers;
+    std::atomic<int> connected {0};
+    cv::Mat payload(rows, cols, CV_8UC1, cv::Scalar(1));
+
+    {
+        oat::Sink<oat::Frame> sink;
+        sink.bind(addr, static_cast<size_t>(rows) * cols);
+        sink.retrieve(rows, cols, CV_8UC1, oat::PIX_GREY);
+
+        for (int i = 0; i < num_readers; i++) {
+            readers.emplace_back([&addr, &connected, copy] {
+                oat::Source<oat::Frame> source;
+                source.touch(addr);
+                source.connect();
+                oat::Frame local = source.clone();
+                connected++;
+
+                while (source.wait() == oat::NodeState::SINK_BOUND) {
+                    if (copy)
+                        source.copyTo(local);
+                    else
+                        benchmark::DoNotOptimize(source.borrow().data[0]);
+                    source.post();
+                }
+                source.post();
+            });
+        }
+
+        roundTrips(state, readers, connected, [&sink, &payload, copy] {
+            sink.wait();
+            oat::Frame f = sink.retrieve();
+            if (copy)
+                std::memcpy(f.data, payload.data, payload.total());
+            else
+                f.data[0]++;
+            sink.post();
+        });
+
+        if (copy)
+            state.SetBytesProcessed(state.iterations() * payload.total()
+                                    * (1 + num_readers));
+    } // Sink leaves the node, releasing the readers
+
+    for (auto &r : readers)
+        r.join();
+}
+
+/**
+ * Position round trips. The argument is the number of readers.
+ */
+static void BM_PositionRoundTrip(benchmark::State &state)
+{
+    const int num_readers = state.range(0);
+    const std::string addr = nextAddress();
+
+    std::vector<std::thread> readers;
+    std::atomic<int> connected {0};
+
+    {
+        oat::Sink<oat::Position2D> sink;
+        sink.bind(addr, "bench");
+
+        for (int i = 0; i < num_readers; i++) {
+            readers.emplace_back([&addr, &connected] {
+                oat::Source<oat::Position2D> source;
+                source.touch(addr);
+                source.connect();
+                oat::Position2D local("bench");
+                connected++;
+
+                while (source.wait() == oat::NodeState::SINK_BOUND) {
+                    source.copyTo(local);
+                    source.post();
+                }
+                source.post();
+            });
+        }
+
+        oat::Position2D pos("bench");
+        pos.position_valid = true;
+        roundTrips(state, readers, connected, [&sink, &pos] {
+            pos.position.x += 1.0;
+            sink.wait();
+            sink.write(pos);
+            sink.post();
+        });
+    }
+
+    for (auto &r : readers)
+        r.join();
+}
+
+// Readers from 1 to the size of a node's reader table, see OAT_MAX_SOURCES
+static void readerCounts(benchmark::internal::Benchmark *b,
+                         const std::vector<int64_t> &prefix)
+{
+    for (int64_t n = 1; n <= static_cast<int64_t>(oat::Node::default_max_sources()); n *= 2) {
+        auto args = prefix;
+        args.push_back(n);
+        b->Args(args);
+    }
+}
+
+static void frameArgs(benchmark::internal::Benchmark *b)
+{
+    // VGA, 1080p, 5 MP and 20 MP frames
+    const std::vector<std::vector<int64_t>> sizes {
+        {640, 480}, {1920, 1080}, {2592, 1944}, {5472, 3648}};
+
+    for (const auto &s : sizes)
+        for (int64_t copy = 0; copy <= 1; copy++)
+            readerCounts(b, {s[0], s[1], copy});
+}
+
+static void positionArgs(benchmark::internal::Benchmark *b)
+{
+    readerCounts(b, {});
+}
+
+BENCHMARK(BM_FrameRoundTrip)
+    ->Apply(frameArgs)
+    ->ArgNames({"cols", "rows", "copy", "readers"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_PositionRoundTrip)
+    ->Apply(positionArgs)
+    ->ArgNames({"readers"})
+    ->UseRealTime()
+    ->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -27,8 +27,12 @@ pc()
 # oat-frameserve type configurations
 pc "$(oat frameserve gige --help)" 
 ofs_g="$pc_res"
+pc "$(oat frameserve gige-multi --help)" 
+ofs_gm="$pc_res"
 pc "$(oat frameserve wcam --help)" 
 ofs_w="$pc_res"
+pc "$(oat frameserve v4l2 --help)" 
+ofs_v="$pc_res"
 pc "$(oat frameserve file --help)" 
 ofs_f="$pc_res"
 pc "$(oat frameserve test --help)" 
@@ -45,22 +49,34 @@ pc "$(oat framefilt undistort --help)"
 off_u="$pc_res"
 pc "$(oat framefilt thresh --help)" 
 off_t="$pc_res"
+pc "$(oat framefilt fused --help)" 
+off_fu="$pc_res"
+pc "$(oat framefilt decimate --help)" 
+off_de="$pc_res"
+pc "$(oat framefilt fanout --help)" 
+off_fa="$pc_res"
 
 # oat-view type configurations
 pc "$(oat view frame --help)" 
 ovi_f="$pc_res"
+pc "$(oat view tile --help)" 
+ovi_t="$pc_res"
 
 # oat-posidet type configurations
 pc "$(oat posidet diff --help)" 
 opd_d="$pc_res"
 pc "$(oat posidet hsv --help)" 
 opd_h="$pc_res"
+pc "$(oat posidet mog --help)" 
+opd_m="$pc_res"
 pc "$(oat posidet thresh --help)" 
 opd_t="$pc_res"
 
 # oat-posigen type configurations
 pc "$(oat posigen rand2D --help)" 
 opg_r2="$pc_res"
+pc "$(oat posigen replay --help)" 
+opg_rp="$pc_res"
 
 # oat-posifilt type configurations
 pc "$(oat posifilt kalman --help)" 
@@ -69,10 +85,18 @@ pc "$(oat posifilt homography --help)"
 opf_h="$pc_res"
 pc "$(oat posifilt region --help)" 
 opf_r="$pc_res"
+pc "$(oat posifilt track --help)" 
+opf_t="$pc_res"
+pc "$(oat posifilt chain --help)" 
+opf_c="$pc_res"
 
 # oat-posicom configurations
 pc "$(oat posicom mean --help)" 
 opc_m="$pc_res"
+pc "$(oat posicom weighted --help)" 
+opc_w="$pc_res"
+pc "$(oat posicom median --help)" 
+opc_d="$pc_res"
 
 # oat-posisck configurations
 pc "$(oat posisock std --help)" 
@@ -83,6 +107,12 @@ pc "$(oat posisock rep --help)"
 ops_r="$pc_res"
 pc "$(oat posisock udp --help)" 
 ops_u="$pc_res"
+pc "$(oat posisock udps --help)" 
+ops_us="$pc_res"
+
+# oat-buffer configurations
+pc "$(oat buffer frame --help)" 
+obu_f="$pc_res"
 
 # oat-calibrate configurations
 pc "$(oat calibrate camera --help)" 
@@ -93,7 +123,9 @@ oca_h="$pc_res"
 # Semi-automated README.md and README.pdf construction
 awk -v ofs="$(oat frameserve --help)" \
     -v ofs_g="$ofs_g" \
+    -v ofs_gm="$ofs_gm" \
     -v ofs_w="$ofs_w" \
+    -v ofs_v="$ofs_v" \
     -v ofs_f="$ofs_f" \
     -v ofs_t="$ofs_t" \
     -v off="$(oat framefilt --help)" \
@@ -102,20 +134,30 @@ awk -v ofs="$(oat frameserve --help)" \
     -v off_mo="$off_mo" \
     -v off_u="$off_u" \
     -v off_t="$off_t" \
+    -v off_fu="$off_fu" \
+    -v off_de="$off_de" \
+    -v off_fa="$off_fa" \
     -v ovi="$(oat view --help)"      \
     -v ovi_f="$ovi_f" \
+    -v ovi_t="$ovi_t" \
     -v opd="$(oat posidet --help)"   \
     -v opd_d="$opd_d" \
     -v opd_h="$opd_h" \
+    -v opd_m="$opd_m" \
     -v opd_t="$opd_t" \
     -v opg="$(oat posigen --help)"   \
     -v opg_r2="$opg_r2" \
+    -v opg_rp="$opg_rp" \
     -v opf="$(oat posifilt --help)"  \
     -v opf_k="$opf_k" \
     -v opf_h="$opf_h" \
     -v opf_r="$opf_r" \
+    -v opf_t="$opf_t" \
+    -v opf_c="$opf_c" \
     -v opc="$(oat posicom --help)"  \
     -v opc_m="$opc_m" \
+    -v opc_w="$opc_w" \
+    -v opc_d="$opc_d" \
     -v ode="$(oat decorate --help)"  \
     -v ore="$(oat record --help)"  \
     -v ops="$(oat posisock --help)"  \
@@ -123,15 +165,22 @@ awk -v ofs="$(oat frameserve --help)" \
     -v ops_p="$ops_p" \
     -v ops_r="$ops_r" \
     -v ops_u="$ops_u" \
+    -v ops_us="$ops_us" \
     -v obu="$(oat buffer --help)"  \
+    -v obu_f="$obu_f" \
+    -v opi="$(oat pipeline --help)"  \
     -v ocl="$(oat clean --help)"  \
+    -v oto="$(oat top --help)"  \
+    -v ock="$(oat check --help)"  \
     -v oca="$(oat calibrate --help)"  \
     -v oca_c="$oca_c" \
     -v oca_h="$oca_h" \
 '{
     sub(/oat-frameserve-help/, ofs);
     sub(/oat-frameserve-gige-help/, ofs_g);
+    sub(/oat-frameserve-gige-multi-help/, ofs_gm);
     sub(/oat-frameserve-wcam-help/, ofs_w);
+    sub(/oat-frameserve-v4l2-help/, ofs_v);
     sub(/oat-frameserve-file-help/, ofs_f);
     sub(/oat-frameserve-test-help/, ofs_t);
     sub(/oat-framefilt-help/, off);
@@ -140,29 +189,44 @@ awk -v ofs="$(oat frameserve --help)" \
     sub(/oat-framefilt-mog-help/, off_mo);
     sub(/oat-framefilt-undistort-help/, off_u);
     sub(/oat-framefilt-thresh-help/, off_t);
+    sub(/oat-framefilt-fused-help/, off_fu);
+    sub(/oat-framefilt-decimate-help/, off_de);
+    sub(/oat-framefilt-fanout-help/, off_fa);
     sub(/oat-view-help/, ovi);
     sub(/oat-view-frame-help/, ovi_f);
+    sub(/oat-view-tile-help/, ovi_t);
     sub(/oat-posidet-help/, opd);
     sub(/oat-posidet-diff-help/, opd_d);
     sub(/oat-posidet-hsv-help/, opd_h);
+    sub(/oat-posidet-mog-help/, opd_m);
     sub(/oat-posidet-thresh-help/, opd_t);
     sub(/oat-posigen-help/, opg);
     sub(/oat-posigen-rand2D-help/, opg_r2);
+    sub(/oat-posigen-replay-help/, opg_rp);
     sub(/oat-posifilt-help/, opf);
     sub(/oat-posifilt-kalman-help/, opf_k);
     sub(/oat-posifilt-homography-help/, opf_h);
     sub(/oat-posifilt-region-help/, opf_r);
+    sub(/oat-posifilt-track-help/, opf_t);
+    sub(/oat-posifilt-chain-help/, opf_c);
     sub(/oat-posicom-help/, opc);
     sub(/oat-posicom-mean-help/, opc_m);
+    sub(/oat-posicom-weighted-help/, opc_w);
+    sub(/oat-posicom-median-help/, opc_d);
     sub(/oat-decorate-help/, ode);
     sub(/oat-record-help/, ore);
     sub(/oat-posisock-help/, ops);
     sub(/oat-posisock-std-help/, ops_s);
     sub(/oat-posisock-pub-help/, ops_p);
     sub(/oat-posisock-rep-help/, ops_r);
+    sub(/oat-posisock-udps-help/, ops_us);
     sub(/oat-posisock-udp-help/, ops_u);
     sub(/oat-buffer-help/, obu);
+    sub(/oat-buffer-frame-help/, obu_f);
+    sub(/oat-pipeline-help/, opi);
     sub(/oat-clean-help/, ocl);
+    sub(/oat-top-help/, oto);
+    sub(/oat-check-help/, ock);
     sub(/oat-calibrate-help/, oca);
     sub(/oat-calibrate-camera-help/, oca_c);
     sub(/oat-calibrate-homography-help/, oca_h);
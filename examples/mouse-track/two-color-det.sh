@@ -14,7 +14,7 @@ case "$1" in
 		oat posidet hsv SUB PBLU -c config.toml hsv_blue  	        & 
 		oat framefilt mog RAW SUB   	                            & 
 
-		sleep 1
+		oat await RAW SUB
 		oat frameserve file RAW -f mouse.mpg -c config.toml video   
 		;;
 
@@ -14,7 +14,7 @@ case "$1" in
 		oat framefilt mog raw bac                                   &
 		#oat framefilt mask raw roi -c config.toml mask             &
 
-		sleep 1
+		oat await raw:2 bac det pix final
 		oat frameserve file raw -f ~/Desktop/rat.avi -c config.toml video  
 		;;
 
@@ -14,7 +14,7 @@ case "$1" in
         oat posigen rand2D p2 -c config.toml pgen             & 
         oat posigen rand2D p1 -c config.toml pgen             & 
 
-		sleep 1
+		oat await raw final pr1 pr2 pr3 pcr pc p3 p2:2 p1:2
 		oat frameserve file raw -f ~/Desktop/rat.avi -c config.toml video
 		;;
 
@@ -0,0 +1,39 @@
+#!/bin/python
+
+# Merge position files recorded by pipelines that each processed one
+# segment of a video file, given in segment order. Samples are numbered by
+# frame index in the whole file, so the warm-up samples at the start of each
+# segment are those already covered by the segment before it, and are
+# dropped.
+#
+# Usage: python3 merge-positions.py OUTPUT SEGMENT_0 [SEGMENT_1 ...]
+
+import json
+import sys
+
+if len(sys.argv) < 3:
+    print("Usage: merge-positions.py OUTPUT SEGMENT_0 [SEGMENT_1 ...]")
+    sys.exit(1)
+
+merged = None
+last_tick = 0
+
+for path in sys.argv[2:]:
+
+    with open(path) as f:
+        segment = json.load(f)
+
+    # Header from the first segment
+    if merged is None:
+        merged = dict(segment)
+        merged["positions"] = []
+
+    for p in segment["positions"]:
+        if p["tick"] > last_tick:
+            merged["positions"].append(p)
+            last_tick = p["tick"]
+
+with open(sys.argv[1], "w") as f:
+    json.dump(merged, f)
+
+print("Merged %d positions into %s" % (len(merged["positions"]), sys.argv[1]))
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Reprocess a video file in K segments, in parallel, one pipeline per
+# segment. Each pipeline uses its own node names, so pipelines do not share
+# memory segments. Segments start with some warm-up frames so that the mog
+# background model and kalman filter have settled by the first frame that
+# is kept. Recorded positions are then merged by sample number.
+#
+# Usage: ./reprocess.sh VIDEO NUM_FRAMES K [WARM_UP]
+
+VIDEO=$1
+NUM_FRAMES=$2
+K=$3
+WARM_UP=${4:-300}
+
+if [ -z "$VIDEO" ] || [ -z "$NUM_FRAMES" ] || [ -z "$K" ]; then
+    echo $"Usage: $0 VIDEO NUM_FRAMES K [WARM_UP]"
+    exit 1
+fi
+
+SEG=$(( (NUM_FRAMES + K - 1) / K ))
+FILES=()
+
+for (( k=0; k<K; k++ )); do
+
+    FIRST=$(( k * SEG ))
+    LAST=$(( FIRST + SEG < NUM_FRAMES ? FIRST + SEG : NUM_FRAMES ))
+
+    oat record -p kal$k -f ./ -n seg$k -o                       &
+    oat posifilt kalman det$k kal$k -c config.toml kalman       &
+    oat posidet hsv bac$k det$k -c config.toml hsv              &
+    oat framefilt mog raw$k bac$k                               &
+
+    oat await raw$k bac$k det$k kal$k
+    oat frameserve file raw$k -f $VIDEO -c config.toml video \
+        --segment [$FIRST,$LAST] --warm-up $WARM_UP             \
+        --max-throughput --decode-ahead 8                       &
+
+    FILES+=(kal${k}_seg$k.json)
+done
+
+# Each pipeline exits when its segment ends
+wait
+
+python3 merge-positions.py merged.json "${FILES[@]}"
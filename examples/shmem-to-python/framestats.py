@@ -0,0 +1,17 @@
+#!/bin/python
+
+# Example python script that reads frames directly from the 'raw' node, e.g.
+# from oat frameserve wcam raw, and prints the mean intensity of each channel.
+# Requires oat/python to be on PYTHONPATH.
+
+import oat
+
+with oat.FrameSource('raw') as source:
+    try:
+        while True:
+            with source.read() as frame:
+                means = frame.reshape(frame.shape[0], frame.shape[1], -1) \
+                             .mean(axis=(0, 1))
+                print(source.sample.count, means)
+    except oat.EndOfStream:
+        pass
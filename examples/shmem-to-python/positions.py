@@ -0,0 +1,16 @@
+#!/bin/python
+
+# Example python script that reads the most recent position from the 'pos'
+# node, e.g. from oat posidet diff raw pos, without holding back the detector.
+# Requires oat/python to be on PYTHONPATH.
+
+import oat
+
+with oat.PositionSource('pos', latest=True) as source:
+    try:
+        while True:
+            with source.read() as pos:
+                if pos['pos_ok']:
+                    print(pos['tick'], pos['pos_xy'])
+    except oat.EndOfStream:
+        print('Skipped {} positions'.format(source.dropped))
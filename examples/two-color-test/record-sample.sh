@@ -8,7 +8,6 @@
 CONFIG_PATH="./config.toml"
 
 oat view raw &
-sleep 0.1
 oat record -i raw -f ./ -n two_color_test -d -F 30 &
-sleep 0.1
+oat await raw:2
 oat frameserve gige raw -c "$CONFIG_PATH" -k gige
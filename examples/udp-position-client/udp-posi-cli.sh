@@ -8,7 +8,7 @@ case "$1" in
 
         oat posisock udp pos -h 10.121.43.222 -p 5555       &
 
-		sleep 1
+		oat await pos
         oat positest rand2D pos -r 100
 		;;
 
@@ -17,17 +17,25 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include "OatConfig.h" // Generated by CMake
+
 #include "Component.h"
 #include "Globals.h"
+#include "Profiler.h"
+#include "ThreadShare.h"
 
 #include <chrono>
+#include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <sstream>
 #include <thread>
 
+#include <signal.h>
+
 #include <boost/interprocess/exceptions.hpp>
 
+#include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ZMQHelpers.h"
 
 namespace oat {
@@ -43,8 +51,19 @@ static void sigHandler(int)
 
 Component::Component()
 {
+#ifdef USE_FUTEX
+    // Install Ctrl-c signal handler without SA_RESTART so that futex waits
+    // on shmem nodes are interrupted instead of silently restarted
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = sigHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, nullptr);
+#else
     // Install Ctrl-c signal handler
     std::signal(SIGINT, sigHandler);
+#endif
 }
 
 void Component::run()
@@ -53,6 +72,39 @@ void Component::run()
     runComponent();
 }
 
+bool Component::connect()
+{
+    try {
+        return connectToNode();
+    } catch (const boost::interprocess::interprocess_exception &ex) {
+
+        // A SIGINT during a call to wait()
+        if (ex.get_error_code() != 1)
+            throw;
+    }
+
+    return false;
+}
+
+bool Component::step()
+{
+    try {
+        ThreadShare::process().rebalance();
+        applyUpdates();
+        OAT_PHASE(OTHER);
+        const bool end_of_stream = process();
+        OAT_PHASE_END();
+        return end_of_stream;
+    } catch (const boost::interprocess::interprocess_exception &ex) {
+
+        // A SIGINT during a call to wait()
+        if (ex.get_error_code() != 1)
+            throw;
+    }
+
+    return true;
+}
+
 void Component::runComponent()
 {
     try {
@@ -63,7 +115,11 @@ void Component::runComponent()
 
         bool end_of_stream = false;
         while (!end_of_stream && !quit) {
+            ThreadShare::process().rebalance();
+            applyUpdates();
+            OAT_PHASE(OTHER);
             end_of_stream = process();
+            OAT_PHASE_END();
         }
 
     } catch (const boost::interprocess::interprocess_exception &ex) {
@@ -73,6 +129,21 @@ void Component::runComponent()
         if (ex.get_error_code() != 1)
             throw;
     }
+
+#ifdef USE_PROFILER
+    // Setting OAT_TRACE asks for a trace of the last process() calls on exit
+    if (std::getenv("OAT_TRACE") != nullptr) {
+        OAT_PHASE_END();
+        writeTraceFile(name());
+        std::cerr << oat::whoMessage(name(), "Trace written to "
+                                     + traceFile() + ".") << "\n";
+
+        // Deterministic runs are compared by their per-phase costs
+        if (oat::deterministic())
+            std::cerr << oat::whoMessage(name(), "Phase costs written to "
+                                         + writeSummaryFile() + ".") << "\n";
+    }
+#endif
 }
 
 } /* namespace oat */
@@ -25,6 +25,7 @@
 #include <string>
 #include <cstring>
 #include <map>
+#include <vector>
 
 #include <boost/program_options.hpp>
 #include <zmq.hpp>
@@ -33,6 +34,9 @@
 
 namespace oat {
 
+// Forward decl.
+class SampleEvent;
+
 enum ComponentType : uint16_t {
     mock = 0,
     buffer,
@@ -48,6 +52,9 @@ enum ComponentType : uint16_t {
     recorder,
     viewer,
     decorator,
+    bridge,
+    trigger,
+    occupancy,
     COMP_N // Number of components
 };
 
@@ -63,6 +70,35 @@ public:
      */
     virtual void run();
 
+    /**
+     * @brief Attach to nodes ahead of calls to step(). Used in place of run()
+     * by hosts that share a few threads between many components.
+     * @return False if the component could not connect, e.g. on SIGINT.
+     */
+    bool connect(void);
+
+    /**
+     * @brief Perform a single iteration of the processing loop.
+     * @return True at the end of the stream.
+     */
+    bool step(void);
+
+    /**
+     * @brief Whether step() can run without sleeping on a node, e.g. because
+     * the SOURCE has a sample and the SINK a free buffer. Only a hint, since
+     * either may change before step() is called. Components that cannot
+     * tell are always ready.
+     */
+    virtual bool ready(void) const { return true; }
+
+    /**
+     * @brief Events of the nodes that ready() looks at, whose generations
+     * move on whenever it may have become true, so that a host with nothing
+     * ready can sleep on them through SampleEvent::waitAny(). Null entries
+     * are ignored. Components that return none are polled.
+     */
+    virtual std::vector<SampleEvent *> events(void) const { return {}; }
+
     /**
      * @brief Human readable component name. Usually provides indication of
      * component type and IO.
@@ -95,6 +131,12 @@ protected:
      * @return Return code. 0 = More. 1 = End of stream.
      */
     virtual int process(void) = 0;
+
+    /**
+     * @brief Apply pending runtime changes. Called on the processing thread
+     * before each call to process().
+     */
+    virtual void applyUpdates(void) { }
 };
 }      /* namespace oat */
 #endif /* OAT_COMPONENT_H */
@@ -29,6 +29,8 @@
 #include <zmq.hpp>
 
 #include "../utility/TOMLSanitize.h"
+#include "ThreadPolicy.h"
+#include "ThreadShare.h"
 
 namespace oat {
 
@@ -64,11 +66,43 @@ public:
                 ;
         }
 
+        // Scheduling and memory options, which can also be set from a
+        // configuration file
+        po::options_description scheduling_options;
+        scheduling_options.add_options()
+            ("cpus", po::value<std::string>(),
+             "Array of CPU indices, e.g. [2,3], on which the processing "
+             "thread may run. Threads it starts inherit it. Defaults to any "
+             "CPU.")
+            ("priority", po::value<int>(),
+             "SCHED_FIFO priority, 1 to 99, of the processing thread. Threads "
+             "it starts inherit it. Requires CAP_SYS_NICE or an rtprio limit. "
+             "Defaults to 0, which keeps normal scheduling.")
+            ("helper-cpus", po::value<std::string>(),
+             "Array of CPU indices for helper threads, such as the recorder's "
+             "file writers, the viewer's display thread and the buffer's sink "
+             "thread. Defaults to cpus.")
+            ("helper-priority", po::value<int>(),
+             "SCHED_FIFO priority, 0 to 99, of helper threads. Defaults to "
+             "priority.")
+            ("lock-memory",
+             "If true, lock the component's memory, including shared memory "
+             "segments mapped later, into RAM so that page faults do not add "
+             "latency. Every page is faulted in when it is mapped. May require "
+             "raising RLIMIT_MEMLOCK.")
+            ("thread-weight", po::value<int>(),
+             "Weight, 1 to 100, of the component's share of the OpenCV "
+             "threads budgeted by OAT_CV_THREADS. Defaults to 1.")
+            ;
+        opts.add(scheduling_options);
+
         // Get type-specific options
         auto local_options = options();
         opts.add(local_options);
 
         // Create valid keys
+        for (auto &o : scheduling_options.options())
+            config_keys_.push_back(o->long_name());
         for (auto &o : local_options.options())
             config_keys_.push_back(o->long_name());
     }
@@ -81,7 +115,11 @@ public:
     {
         // Check for config file and entry correctness
         auto config_table = oat::config::getConfigTable(vm);
-        oat::config::checkKeys(config_keys_, config_table);
+        checkConfigKeys(config_table);
+
+        // Scheduling is applied first so that threads started during
+        // configuration inherit it
+        configureScheduling(vm, config_table);
 
         // Concrete component uses configuration map to configure itself
         applyConfiguration(vm, config_table);
@@ -103,8 +141,54 @@ protected:
     virtual void applyConfiguration(const po::variables_map &vm,
                                     const config::OptionTable &config_table) = 0;
 
+    /**
+     * @brief Check that every key of the configuration table is an option.
+     * Components whose tables also hold user-named entries, such as regions,
+     * override this to accept them.
+     * @param config_table Parsed TOML options table.
+     */
+    virtual void checkConfigKeys(const config::OptionTable &config_table) const
+    {
+        oat::config::checkKeys(config_keys_, config_table);
+    }
+
     // Allowable configuration keys
     std::vector<std::string> config_keys_;
+
+    // Policy of helper threads. Components apply it to the helper threads
+    // they start, once configured.
+    oat::ThreadPolicy helper_thread_policy_;
+
+private:
+    void configureScheduling(const po::variables_map &vm,
+                             const config::OptionTable &config_table)
+    {
+        oat::ThreadPolicy processing;
+        oat::config::getArray<int>(vm, config_table, "cpus", processing.cpus);
+        oat::config::getNumericValue<int>(
+            vm, config_table, "priority", processing.priority, 0, 99);
+
+        helper_thread_policy_ = processing;
+        oat::config::getArray<int>(
+            vm, config_table, "helper-cpus", helper_thread_policy_.cpus);
+        oat::config::getNumericValue<int>(
+            vm, config_table, "helper-priority",
+            helper_thread_policy_.priority, 0, 99);
+
+        bool lock_memory = false;
+        oat::config::getValue<bool>(vm, config_table, "lock-memory", lock_memory);
+        if (lock_memory)
+            oat::lockMemory();
+
+        // configure() is called on the thread that runs the component
+        processing.apply("processing");
+
+        // OpenCV's pool is shared with the other components on the machine
+        int weight = 1;
+        oat::config::getNumericValue<int>(
+            vm, config_table, "thread-weight", weight, 1, 100);
+        oat::ThreadShare::process().join(weight, processing.cpus.size());
+    }
 };
 
 }      /* namespace oat */
@@ -17,18 +17,28 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include "OatConfig.h" // Generated by CMake
+
 #include "ControllableComponent.h"
 #include "Globals.h"
+#include "Profiler.h"
 
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <thread>
 
+#include <pthread.h>
+#include <signal.h>
+
 #include <boost/interprocess/exceptions.hpp>
 
+#include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ZMQHelpers.h"
 
 namespace oat {
@@ -63,39 +73,64 @@ void ControllableComponent::run()
 
 void ControllableComponent::runController(const char *endpoint)
 {
+#ifdef USE_FUTEX
+    // Make sure SIGINT is delivered to the processing thread, which may be
+    // asleep on a node futex
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+#endif
+
     zmq::context_t ctx(1);
 
     try {
 
-        auto ctrl_socket = getCtrlSocket(ctx, endpoint);
+        zmq::socket_t *monitor {nullptr};
+        auto ctrl_socket = getCtrlSocket(ctx, endpoint, monitor);
 
-        oat::sendStringMore(ctrl_socket, ""); // Delimeter
-        oat::sendString(ctrl_socket, whoAmI());
-
-        // Execute control loop
+        // Execute control loop. Both sockets are waited on without a timeout,
+        // so an idle component makes no calls until oat-control connects or
+        // sends a command.
         while (!quit) {
 
-            // Poll the socket and find all existing connections
-            zmq::pollitem_t p[] = {{*ctrl_socket, 0, ZMQ_POLLIN, 0}};
-            zmq::poll(&p[0], 1, REQUEST_TIMEOUT_MS);
+            zmq::pollitem_t p[] = {{*ctrl_socket, 0, ZMQ_POLLIN, 0},
+                                   {*monitor, 0, ZMQ_POLLIN, 0}};
+            try {
+                zmq::poll(&p[0], 2, -1);
+            } catch (zmq::error_t &ex) {
+                if (ex.num() == EINTR)
+                    continue;
+                throw;
+            }
 
             if (p[0].revents & ZMQ_POLLIN && !quit) {
 
                 // Found a command, run it.
                 oat::recvString(ctrl_socket); // Delimeter
                 auto command = oat::recvString(ctrl_socket);
-                quit = control(command);
 
-            } else {
-                // If we did not get a reply on this socket
-                // REQUEST_TIMEOUT_MS, tear it down and make a new one
-                delete ctrl_socket;
-                ctrl_socket = getCtrlSocket(ctx, endpoint);
+                // Scheduled commands are acknowledged, so that oat-control
+                // can tell which components will act on the sample
+                if (command.compare(0, 3, "at ") == 0) {
+                    const bool ok = schedule(command.substr(3));
+                    oat::sendStringMore(ctrl_socket, ""); // Delimeter
+                    oat::sendString(ctrl_socket,
+                                    (ok ? "ack " : "nack ") + command);
+                } else {
+                    quit = control(command);
+                }
+            }
+
+            // Each oat-control instance that binds the endpoint is announced
+            // to once, when the socket (re)connects to it
+            if (p[1].revents & ZMQ_POLLIN && connected(monitor)) {
                 oat::sendStringMore(ctrl_socket, ""); // Delimeter
                 oat::sendString(ctrl_socket, whoAmI());
             }
         }
 
+        delete monitor;
         delete ctrl_socket;
 
     } catch (zmq::error_t &ex) {
@@ -115,6 +150,22 @@ int ControllableComponent::control(const std::string &command)
 {
     if (command == "quit" || command == "Quit") {
         return 1;
+    } else if (command.compare(0, 4, "set ") == 0) {
+        setParameter(command.substr(4));
+#ifdef USE_PROFILER
+    } else if (command == "profile") {
+        // Snapshots are lock-free, so the processing thread keeps running
+        std::cerr << oat::whoMessage(name(), "Phases of the last process() "
+                                     "calls:") << "\n";
+        profiler().writeSummary(std::cerr);
+        try {
+            writeTraceFile(name());
+            std::cerr << oat::whoMessage(name(), "Trace written to "
+                                         + traceFile() + ".") << "\n";
+        } catch (const std::runtime_error &ex) {
+            std::cerr << oat::whoWarn(name(), ex.what()) << "\n";
+        }
+#endif
     } else {
 
         // Check that command is in hash
@@ -125,6 +176,78 @@ int ControllableComponent::control(const std::string &command)
     return 0;
 }
 
+bool ControllableComponent::schedule(const std::string &schedule)
+{
+    std::istringstream ss {schedule};
+    uint64_t sample;
+    std::string command;
+    if (!(ss >> sample >> command)) {
+        std::cerr << oat::whoWarn(name(), "Scheduled commands take the form "
+                                  "'at SAMPLE COMMAND'.") << "\n";
+        return false;
+    }
+
+    if (!commands().count(command)) {
+        std::cerr << oat::whoWarn(name(), "No command named '" + command
+                                  + "'.") << "\n";
+        return false;
+    }
+
+    return applyCommandAt(command, sample);
+}
+
+void ControllableComponent::setParameter(const std::string &assignment)
+{
+    const auto params = parameters();
+    const auto start = assignment.find_first_not_of(' ');
+    const auto split = assignment.find(' ', start);
+    const auto key = start == std::string::npos
+                   ? std::string()
+                   : assignment.substr(start, split - start);
+
+    if (!params.count(key)) {
+        std::cerr << oat::whoWarn(name(), "No runtime parameter named '" + key
+                                  + "'.") << "\n";
+        return;
+    }
+
+    if (split == std::string::npos) {
+        std::cerr << oat::whoWarn(name(), "No value given for '" + key + "'.")
+                  << "\n";
+        return;
+    }
+
+    config::OptionTable table;
+    try {
+        std::istringstream toml {key + "=" + assignment.substr(split + 1)};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    } catch (const cpptoml::parse_exception &ex) {
+        std::cerr << oat::whoWarn(name(), "Invalid value for '" + key + "': "
+                                  + ex.what()) << "\n";
+        return;
+    }
+
+    if (!updates_.push(table))
+        std::cerr << oat::whoWarn(name(), "Too many pending parameter "
+                                  "changes. '" + key + "' was not set.")
+                  << "\n";
+}
+
+void ControllableComponent::applyUpdates()
+{
+    config::OptionTable table;
+    while (updates_.pop(table)) {
+
+        // A bad value is reported, but does not stop processing
+        try {
+            applyParameters(po::variables_map(), table);
+        } catch (const std::runtime_error &ex) {
+            std::cerr << oat::whoWarn(name(), ex.what()) << "\n";
+        }
+    }
+}
+
 std::string ControllableComponent::whoAmI()
 {
     // JSON string with name, type, and command/description map
@@ -134,6 +257,24 @@ std::string ControllableComponent::whoAmI()
     whoami << "\"type\":" << std::to_string(static_cast<uint16_t>(type())) << ",";
 
     auto cmds = commands();
+#ifdef USE_PROFILER
+    cmds.emplace("profile", "Print the time spent in each phase of recent "
+                            "processing steps and write them as a Chrome "
+                            "trace.");
+#endif
+
+    auto params = parameters();
+    if (!params.empty()) {
+
+        std::string keys;
+        for (const auto &p : params)
+            keys += (keys.empty() ? "" : ", ") + p.first;
+
+        cmds.emplace("set", "Change a parameter without restarting: 'set KEY "
+                            "VALUE', with VALUE in TOML syntax. KEY is one of "
+                            + keys + ".");
+    }
+
     if (!cmds.empty()) {
 
         whoami << "\"commands\":{";
@@ -151,17 +292,52 @@ std::string ControllableComponent::whoAmI()
 }
 
 zmq::socket_t *ControllableComponent::getCtrlSocket(zmq::context_t &context,
-                                                    const char *endpoint)
+                                                    const char *endpoint,
+                                                    zmq::socket_t *&monitor)
 {
     zmq::socket_t *socket = new zmq::socket_t(context, ZMQ_DEALER);
     char id[32];
     identity(id, 32);
     socket->setsockopt(ZMQ_IDENTITY, id, std::strlen(id));
-    socket->connect(endpoint);
 
     // Configure socket to not wait at close time
     socket->setsockopt(ZMQ_LINGER, 0);
+
+    // oat-control scans assume a newly bound endpoint is found within this
+    // interval
+    const int reconnect_ms {100};
+    socket->setsockopt(ZMQ_RECONNECT_IVL, &reconnect_ms, sizeof(reconnect_ms));
+
+    // Report connections before connecting so that none are missed
+    const std::string monitor_endpoint = "inproc://ctrl-monitor";
+    if (zmq_socket_monitor(static_cast<void *>(*socket),
+                           monitor_endpoint.c_str(),
+                           ZMQ_EVENT_CONNECTED) != 0)
+        throw zmq::error_t();
+
+    monitor = new zmq::socket_t(context, ZMQ_PAIR);
+    monitor->connect(monitor_endpoint.c_str());
+
+    socket->connect(endpoint);
+
     return socket;
 }
 
+bool ControllableComponent::connected(zmq::socket_t *monitor)
+{
+    // First frame holds a 16-bit event ID and a 32-bit value, the second the
+    // peer endpoint
+    zmq::message_t event;
+    monitor->recv(&event);
+
+    uint16_t id {0};
+    if (event.size() >= sizeof(id))
+        std::memcpy(&id, event.data(), sizeof(id));
+
+    while (monitor->getsockopt<int>(ZMQ_RCVMORE))
+        monitor->recv(&event);
+
+    return id == ZMQ_EVENT_CONNECTED;
+}
+
 } /* namespace oat */
@@ -21,22 +21,24 @@
 #define OAT_CONTROLLABLECOMPONENT_H
 
 #include <csignal>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <cstring>
 #include <map>
 
+#include <boost/lockfree/spsc_queue.hpp>
 #include <boost/program_options.hpp>
 #include <zmq.hpp>
 
 #include "Component.h"
 #include "Globals.h"
-
-#define REQUEST_RETRIES 1e6
-#define REQUEST_TIMEOUT_MS 500
+#include "../utility/TOMLSanitize.h"
 
 namespace oat {
 
+namespace po = boost::program_options;
+
 typedef std::map<std::string, std::string> CommandDescription;
 
 class ControllableComponent : public Component {
@@ -79,7 +81,60 @@ protected:
      */
     virtual oat::CommandDescription commands() = 0;
 
+    /**
+     * @brief Schedule a command, received as 'at SAMPLE COMMAND', to take
+     * effect at a sample number, so that components that receive it at
+     * different times still act on the same sample. By default commands
+     * cannot be scheduled.
+     * @note Called on the control thread, so it must be thread-safe with
+     * the processing thread.
+     * @param command One of the keys of commands().
+     * @param sample Sample number of the first sample the command applies to.
+     * @return True if the command will be applied at sample. The reply to
+     * oat-control acknowledges it.
+     */
+    virtual bool applyCommandAt(const std::string &command, uint64_t sample)
+    {
+        (void)command;
+        (void)sample;
+        return false;
+    }
+
+    /**
+     * @brief Return map containing configuration keys that can be changed
+     * while the component runs, using the 'set KEY VALUE' command, and their
+     * descriptions.
+     * @return parameter/description map.
+     */
+    virtual oat::CommandDescription parameters() { return {}; }
+
+    /**
+     * @brief Apply parameters received with the 'set' command. Called on the
+     * processing thread between calls to process(), so it need not be
+     * thread-safe.
+     * @param vm Empty program option map.
+     * @param config_table Table holding the key set and its value.
+     */
+    virtual void applyParameters(const po::variables_map & /* vm */,
+                                 const config::OptionTable & /* config_table */)
+    {
+    }
+
 private:
+    // Component Interface
+    void applyUpdates(void) override;
+
+    // Parameter tables waiting to be applied by the processing thread
+    boost::lockfree::spsc_queue<config::OptionTable,
+                                boost::lockfree::capacity<16>> updates_;
+
+    /**
+     * @brief Parse a 'KEY VALUE' parameter assignment, with VALUE in TOML
+     * syntax, and pass it to the processing thread.
+     * @param assignment Parameter assignment.
+     */
+    void setParameter(const std::string &assignment);
+
     /**
      * @brief Start component controller on a separate thread.
      * @param endpoint Endpoint over which communicaiton with an oat-control
@@ -91,7 +146,33 @@ private:
 
     int control(const std::string &command);
 
-    zmq::socket_t *getCtrlSocket(zmq::context_t &context, const char *endpoint);
+    /**
+     * @brief Parse a 'SAMPLE COMMAND' schedule and pass it to
+     * applyCommandAt().
+     * @param schedule Scheduled command.
+     * @return True if the command was scheduled.
+     */
+    bool schedule(const std::string &schedule);
+
+    /**
+     * @brief Create the control socket and a monitor that reports each time
+     * it connects to an oat-control instance, so the component can announce
+     * itself once per connection instead of polling for one.
+     * @param context ZMQ context.
+     * @param endpoint Control endpoint.
+     * @param monitor Set to the socket on which connection events arrive.
+     * @return Control socket.
+     */
+    zmq::socket_t *getCtrlSocket(zmq::context_t &context,
+                                 const char *endpoint,
+                                 zmq::socket_t *&monitor);
+
+    /**
+     * @brief Receive a monitor event.
+     * @param monitor Monitor socket.
+     * @return True if the event is a new connection.
+     */
+    bool connected(zmq::socket_t *monitor);
 };
 }      /* namespace oat */
 #endif /* OAT_CONTROLLABLECOMPONENT_H */
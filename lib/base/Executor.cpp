@@ -0,0 +1,214 @@
+//******************************************************************************
+//* File:   Executor.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Executor.h"
+#include "Globals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace oat {
+
+// Failed attempts to find a ready component before an idle worker yields
+// its core, and then before it sleeps on the nodes of waiting components
+static constexpr int IDLE_SPINS {64};
+static constexpr int IDLE_YIELDS {256};
+
+// Longest sleep of an idle worker when every waiting component has events,
+// so that quit is seen, and when some must be polled
+static constexpr std::chrono::milliseconds IDLE_TIMEOUT {100};
+static constexpr std::chrono::microseconds IDLE_POLL {100};
+
+Executor::Executor(size_t workers)
+: num_workers_(std::max<size_t>(workers, 1))
+{
+    for (size_t i = 0; i < num_workers_; i++)
+        queues_.emplace_back(new Queue);
+}
+
+void Executor::run(const std::vector<std::shared_ptr<Component>> &components)
+{
+    components_ = components;
+    errors_.assign(components_.size(), nullptr);
+    remaining_ = components_.size();
+
+    std::vector<std::thread> connectors;
+    for (size_t i = 0; i < components_.size(); i++) {
+        connectors.emplace_back([this, i] {
+            try {
+                if (components_[i]->connect())
+                    give(i % num_workers_, i);
+                else
+                    finish(i);
+            } catch (...) {
+                finish(i, std::current_exception());
+            }
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < num_workers_; w++)
+        workers.emplace_back([this, w] { work(w); });
+
+    for (auto &t : workers)
+        t.join();
+    for (auto &t : connectors)
+        t.join();
+
+    for (auto &e : errors_)
+        if (e)
+            std::rethrow_exception(e);
+}
+
+void Executor::work(size_t worker)
+{
+    std::vector<SampleEvent *> events;
+    std::vector<uint32_t> seen;
+
+    int idle = 0;
+    while (remaining_ > 0 && !quit) {
+
+        size_t task;
+        if (!take(worker, task)) {
+
+            if (++idle < IDLE_SPINS)
+                continue;
+
+            if (idle < IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Generations are taken before looking once more, so that a
+            // component that becomes ready after the look wakes the worker
+            const bool polled = !watch(events, seen);
+            if (!take(worker, task)) {
+                if (polled)
+                    std::this_thread::sleep_for(IDLE_POLL);
+                else
+                    SampleEvent::waitAny(events.data(), seen.data(),
+                                         events.size(), IDLE_TIMEOUT);
+                continue;
+            }
+        }
+
+        idle = 0;
+
+        bool done = false;
+        try {
+            done = components_[task]->step();
+        } catch (...) {
+            finish(task, std::current_exception());
+            continue;
+        }
+
+        if (done)
+            finish(task);
+        else
+            give(worker, task);
+    }
+}
+
+bool Executor::take(size_t worker, size_t &task)
+{
+    // Own components first, oldest first so that none is starved
+    {
+        auto &q = *queues_[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        for (auto t = q.tasks.begin(); t != q.tasks.end(); ++t) {
+            if (components_[*t]->ready()) {
+                task = *t;
+                q.tasks.erase(t);
+                return true;
+            }
+        }
+    }
+
+    // Then steal from the far end of the other workers' queues
+    for (size_t k = 1; k < num_workers_; k++) {
+        auto &q = *queues_[(worker + k) % num_workers_];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        for (auto t = q.tasks.rbegin(); t != q.tasks.rend(); ++t) {
+            if (components_[*t]->ready()) {
+                task = *t;
+                q.tasks.erase(std::next(t).base());
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Executor::watch(std::vector<SampleEvent *> &events,
+                     std::vector<uint32_t> &seen)
+{
+    // Any component queued after this is seen by the wait
+    events.assign(1, &queued_);
+    seen.assign(1, queued_.generation());
+
+    for (auto &q : queues_) {
+        std::lock_guard<std::mutex> lock(q->mutex);
+        for (const auto t : q->tasks) {
+
+            const auto e = components_[t]->events();
+            if (e.empty())
+                return false;
+
+            // Components sharing a node share its event
+            for (const auto n : e) {
+                if (n != nullptr
+                    && std::find(events.begin(), events.end(), n)
+                           == events.end()) {
+                    events.push_back(n);
+                    seen.push_back(n->generation());
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void Executor::give(size_t worker, size_t task)
+{
+    {
+        auto &q = *queues_[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(task);
+    }
+
+    queued_.notify();
+}
+
+void Executor::finish(size_t task, std::exception_ptr error)
+{
+    // Bring the other components down with this one
+    if (error) {
+        errors_[task] = error;
+        quit = 1;
+    }
+
+    --remaining_;
+    queued_.notify();
+}
+
+} /* namespace oat */
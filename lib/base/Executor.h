@@ -0,0 +1,88 @@
+//******************************************************************************
+//* File:   Executor.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+
+#ifndef OAT_EXECUTOR_H
+#define OAT_EXECUTOR_H
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Component.h"
+#include "../shmemdf/SampleEvent.h"
+
+namespace oat {
+
+/**
+ * @brief Runs many components over a few worker threads. Each call to a
+ * component's step() is a task that is only picked up once the component is
+ * ready(), so a worker never sleeps on one component's node while another has
+ * work to do. Workers keep the components they ran in their own queue, for
+ * cache locality, and idle workers steal ready components from the others.
+ * A worker that finds nothing ready for a while sleeps on the events of the
+ * nodes the waiting components read and write.
+ */
+class Executor {
+
+public:
+    /**
+     * @param workers Number of worker threads. At least one is used.
+     */
+    explicit Executor(size_t workers);
+
+    /**
+     * @brief Run components until each reaches the end of its stream or quit
+     * is requested. Each component connects on a thread of its own, since
+     * connecting can wait for an upstream component to write, and joins the
+     * workers once it is connected. An exception thrown by a component stops
+     * the others and is rethrown.
+     * @param components Components to run.
+     */
+    void run(const std::vector<std::shared_ptr<Component>> &components);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    const size_t num_workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::shared_ptr<Component>> components_;
+    std::vector<std::exception_ptr> errors_;
+    std::atomic<size_t> remaining_ {0};
+
+    // Advanced each time a component is queued or finishes, since neither
+    // moves the events of any node
+    SampleEvent queued_;
+
+    void work(size_t worker);
+    bool watch(std::vector<SampleEvent *> &events,
+               std::vector<uint32_t> &seen);
+    bool take(size_t worker, size_t &task);
+    void give(size_t worker, size_t task);
+    void finish(size_t task, std::exception_ptr error = nullptr);
+};
+
+}      /* namespace oat */
+#endif /* OAT_EXECUTOR_H */
@@ -21,11 +21,22 @@
 #define OAT_GLOBALS_H
 
 #include <csignal>
+#include <cstdlib>
 
 namespace oat {
 
 // Global, atomic quit flag
 extern volatile std::sig_atomic_t quit;
 
+// Deterministic replay, asked for by setting OAT_DETERMINISTIC, e.g. from
+// oat-run. Results then depend only on the input samples and their recorded
+// times: SOURCEs read every sample, even in LATEST mode, components do not
+// trade quality for time, and file servers do not pace themselves.
+inline bool deterministic()
+{
+    static const bool d = std::getenv("OAT_DETERMINISTIC") != nullptr;
+    return d;
+}
+
 }      /* namespace oat */
 #endif /* OAT_GLOBALS_H */
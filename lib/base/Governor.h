@@ -0,0 +1,130 @@
+//******************************************************************************
+//* File:   Governor.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_GOVERNOR_H
+#define	OAT_GOVERNOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "Globals.h"
+
+namespace oat {
+
+/**
+ * @brief Trades a component's quality for latency. The component reports how
+ * long each processing step took, and the governor answers with a level of
+ * degradation, from 0 for full quality up to a component-specific maximum,
+ * that the component maps onto its own knobs, e.g. a coarser detection
+ * pyramid or a lower display rate. When CPU time is short every step slows
+ * down, so each governed component backs off in turn until its steps fit its
+ * budget again, and recovers once they fit with room to spare.
+ *
+ * Decisions are made once per window of steps, so single slow steps do not
+ * move the level. A level is given up only after several quiet windows in a
+ * row, so that the component does not oscillate around its budget.
+ */
+class Governor {
+
+public:
+
+    // Steps per decision
+    static constexpr uint32_t WINDOW {32};
+
+    // Slow steps in a window, out of WINDOW, that raise the level
+    static constexpr uint32_t SLOW_STEPS {4};
+
+    // Consecutive windows in which every step took less than RESTORE_PERCENT
+    // of the budget after which the level is lowered
+    static constexpr uint32_t RESTORE_WINDOWS {4};
+    static constexpr uint32_t RESTORE_PERCENT {50};
+
+    /**
+     * @brief Set the budget and the most degraded level. Resets the level.
+     * @param budget Longest a step should take. 0 to disable the governor.
+     * Ignored, and the governor disabled, in deterministic replay.
+     * @param max_level Highest level the component can apply.
+     */
+    void configure(const std::chrono::nanoseconds budget, const int max_level)
+    {
+        budget_ns_ = budget.count() > 0 && !oat::deterministic()
+            ? budget.count() : 0;
+        max_level_ = std::max(max_level, 0);
+        level_ = 0;
+        steps_ = slow_ = fast_windows_ = 0;
+        all_fast_ = true;
+    }
+
+    bool enabled(void) const { return budget_ns_ > 0 && max_level_ > 0; }
+
+    int level(void) const { return level_; }
+
+    /**
+     * @brief Record the duration of a processing step.
+     * @param ns Step duration in nanoseconds.
+     * @return True if the level changed.
+     */
+    bool record(const uint64_t ns)
+    {
+        if (!enabled())
+            return false;
+
+        if (ns > budget_ns_)
+            slow_++;
+        if (ns * 100 >= budget_ns_ * RESTORE_PERCENT)
+            all_fast_ = false;
+
+        if (++steps_ < WINDOW)
+            return false;
+
+        const int before = level_;
+
+        if (slow_ >= SLOW_STEPS) {
+            level_ = std::min(level_ + 1, max_level_);
+            fast_windows_ = 0;
+        } else if (all_fast_ && ++fast_windows_ >= RESTORE_WINDOWS) {
+            level_ = std::max(level_ - 1, 0);
+            fast_windows_ = 0;
+        } else if (!all_fast_) {
+            fast_windows_ = 0;
+        }
+
+        steps_ = slow_ = 0;
+        all_fast_ = true;
+
+        return level_ != before;
+    }
+
+private:
+
+    uint64_t budget_ns_ {0};
+    int max_level_ {0};
+    int level_ {0};
+
+    // Current window
+    uint32_t steps_ {0};
+    uint32_t slow_ {0};
+    bool all_fast_ {true};
+    uint32_t fast_windows_ {0};
+};
+
+}      /* namespace oat */
+#endif /* OAT_GOVERNOR_H */
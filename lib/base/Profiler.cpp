@@ -0,0 +1,159 @@
+//******************************************************************************
+//* File:   Profiler.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace oat {
+
+const char *phaseName(const Phase phase)
+{
+    switch (phase) {
+        case Phase::OTHER:       return "other";
+        case Phase::WAIT_SOURCE: return "wait-source";
+        case Phase::COPY_IN:     return "copy-in";
+        case Phase::COMPUTE:     return "compute";
+        case Phase::WAIT_SINK:   return "wait-sink";
+        case Phase::COPY_OUT:    return "copy-out";
+        case Phase::PUBLISH:     return "publish";
+        default:                 return "unknown";
+    }
+}
+
+Profiler::Profiler()
+: t0_(std::chrono::steady_clock::now())
+, cpu_time_(oat::deterministic())
+{
+    // Nothing
+}
+
+std::vector<Profiler::Record> Profiler::snapshot() const
+{
+    const uint64_t h0 = head_.load(std::memory_order_acquire);
+    const uint64_t first = h0 > CAPACITY ? h0 - CAPACITY : 0;
+
+    std::vector<Record> out;
+    out.reserve(h0 - first);
+    for (uint64_t i = first; i < h0; i++)
+        out.push_back(ring_[i % CAPACITY]);
+
+    // Record i is overwritten by record i + CAPACITY, which may have been
+    // in progress when the copy was made
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t h1 = head_.load(std::memory_order_relaxed);
+    if (h1 + 1 > first + CAPACITY) {
+        const auto stale = std::min<uint64_t>(h1 + 1 - CAPACITY - first,
+                                              out.size());
+        out.erase(out.begin(), out.begin() + stale);
+    }
+
+    return out;
+}
+
+void Profiler::writeTrace(std::ostream &out, const std::string &name) const
+{
+    const auto records = snapshot();
+    const auto pid = ::getpid();
+
+    // Times in the trace format are microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":0,\"args\":{\"name\":\"" << name << "\"}}";
+
+    for (const auto &r : records) {
+        out << ",\n{\"name\":\"" << phaseName(r.phase) << "\",\"ph\":\"X\""
+            << ",\"ts\":" << r.start_ns / 1e3
+            << ",\"dur\":" << r.duration_ns / 1e3
+            << ",\"pid\":" << pid << ",\"tid\":0"
+            << ",\"args\":{\"iteration\":" << r.iteration << "}}";
+    }
+
+    out << "]}\n";
+}
+
+void Profiler::writeSummary(std::ostream &out) const
+{
+    const auto records = snapshot();
+
+    std::array<uint64_t, static_cast<size_t>(Phase::N)> count {}, total {};
+    for (const auto &r : records) {
+        count[static_cast<size_t>(r.phase)]++;
+        total[static_cast<size_t>(r.phase)] += r.duration_ns;
+    }
+
+    out << std::left << std::setw(12) << "phase"
+        << std::right << std::setw(10) << "count"
+        << std::setw(12) << "mean us"
+        << std::setw(12) << "total ms" << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (size_t p = 0; p < count.size(); p++) {
+        if (count[p] == 0)
+            continue;
+        out << std::left << std::setw(12) << phaseName(static_cast<Phase>(p))
+            << std::right << std::setw(10) << count[p]
+            << std::setw(12) << total[p] / 1e3 / count[p]
+            << std::setw(12) << total[p] / 1e6 << "\n";
+    }
+}
+
+Profiler &profiler()
+{
+    static Profiler p;
+    return p;
+}
+
+std::string traceFile()
+{
+    const char *dir = std::getenv("OAT_TRACE");
+    return std::string(dir != nullptr && *dir ? dir : "/tmp")
+           + "/oat-" + std::to_string(::getpid()) + ".json";
+}
+
+void writeTraceFile(const std::string &name)
+{
+    const auto path = traceFile();
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Could not open trace file " + path + ".");
+
+    profiler().writeTrace(out, name);
+}
+
+std::string writeSummaryFile()
+{
+    auto path = traceFile();
+    path.replace(path.size() - 5, 5, ".txt");
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Could not open summary file " + path + ".");
+
+    profiler().writeSummary(out);
+    return path;
+}
+
+} /* namespace oat */
@@ -0,0 +1,201 @@
+//******************************************************************************
+//* File:   Profiler.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_PROFILER_H
+#define	OAT_PROFILER_H
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "Globals.h"
+
+namespace oat {
+
+// Named parts of a call to Component::process()
+enum class Phase : uint8_t {
+    OTHER = 0,   // Time in process() not attributed to any other phase
+    WAIT_SOURCE, // Waiting for a SOURCE's sink to write
+    COPY_IN,     // Copying from SOURCE nodes
+    COMPUTE,     // Component's own work
+    WAIT_SINK,   // Waiting for a SINK's sources to read
+    COPY_OUT,    // Copying to SINK nodes
+    PUBLISH,     // Posting to sources and sinks
+    N            // Number of phases
+};
+
+const char *phaseName(const Phase phase);
+
+/**
+ * @brief Records the phases of each call to process() made by a component's
+ * processing thread into a fixed ring, overwriting the oldest records once it
+ * is full. Records are written by the processing thread only and can be read
+ * from any other thread without stopping it.
+ *
+ * In deterministic replay, phases are timed by the processing thread's CPU
+ * clock instead of the wall clock. Their durations are then the logical cost
+ * of each phase, without the time spent preempted or blocked, and are stable
+ * enough from run to run to compare two builds on the same input.
+ */
+class Profiler {
+
+public:
+    struct Record {
+        uint64_t start_ns;    // Since profiler construction
+        uint32_t duration_ns;
+        uint16_t iteration;   // Low bits of the process() call number
+        Phase phase;
+    };
+
+    static constexpr size_t CAPACITY {1 << 16};
+
+    Profiler();
+
+    /**
+     * @brief End the current phase, if any, and start another.
+     * @param phase Phase that starts now.
+     */
+    void mark(const Phase phase)
+    {
+        const auto now = nowNs();
+        close(now);
+        phase_ = phase;
+        start_ns_ = now;
+    }
+
+    /**
+     * @brief End the current phase and the call to process() it belongs to.
+     */
+    void end()
+    {
+        close(nowNs());
+        iteration_++;
+    }
+
+    /**
+     * @brief Copy out the records currently held by the ring, oldest first.
+     * Records overwritten while they were being copied are dropped.
+     * @return Records.
+     */
+    std::vector<Record> snapshot() const;
+
+    /**
+     * @brief Write a snapshot as a Chrome trace (chrome://tracing, Perfetto)
+     * JSON object of complete ('X') events.
+     * @param out Output stream.
+     * @param name Process name shown in the trace.
+     */
+    void writeTrace(std::ostream &out, const std::string &name) const;
+
+    /**
+     * @brief Write the count, mean and total duration of each phase in a
+     * snapshot as a human readable table.
+     * @param out Output stream.
+     */
+    void writeSummary(std::ostream &out) const;
+
+private:
+    uint64_t nowNs() const
+    {
+        if (cpu_time_) {
+            timespec ts;
+            ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL
+                   + static_cast<uint64_t>(ts.tv_nsec);
+        }
+
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - t0_).count();
+    }
+
+    void close(const uint64_t now)
+    {
+        if (phase_ == Phase::N)
+            return;
+
+        const auto h = head_.load(std::memory_order_relaxed);
+        auto &r = ring_[h % CAPACITY];
+        r.start_ns = start_ns_;
+        r.duration_ns = static_cast<uint32_t>(now - start_ns_);
+        r.iteration = static_cast<uint16_t>(iteration_);
+        r.phase = phase_;
+        head_.store(h + 1, std::memory_order_release);
+
+        phase_ = Phase::N;
+    }
+
+    const std::chrono::steady_clock::time_point t0_;
+    const bool cpu_time_;
+
+    // Processing thread only
+    Phase phase_ {Phase::N};
+    uint64_t start_ns_ {0};
+    uint64_t iteration_ {0};
+
+    // Number of records ever written
+    std::atomic<uint64_t> head_ {0};
+    std::array<Record, CAPACITY> ring_;
+};
+
+/**
+ * @brief Profiler of this process's component.
+ */
+Profiler &profiler();
+
+/**
+ * @brief Path of this process's Chrome trace file, oat-PID.json, in the
+ * directory named by the OAT_TRACE environment variable, or in /tmp if it is
+ * not set.
+ * @return Trace file path.
+ */
+std::string traceFile();
+
+/**
+ * @brief Write the profiler's records to traceFile().
+ * @param name Process name shown in the trace.
+ */
+void writeTraceFile(const std::string &name);
+
+/**
+ * @brief Write the profiler's summary to traceFile(), with a .txt extension
+ * in place of .json.
+ * @return Path of the summary.
+ */
+std::string writeSummaryFile(void);
+
+}      /* namespace oat */
+
+// Phase markers compile away unless USE_PROFILER is set
+#ifdef USE_PROFILER
+ #define OAT_PHASE(phase) oat::profiler().mark(oat::Phase::phase)
+ #define OAT_PHASE_END() oat::profiler().end()
+#else
+ #define OAT_PHASE(phase) do { } while (0)
+ #define OAT_PHASE_END() do { } while (0)
+#endif
+
+#endif /* OAT_PROFILER_H */
@@ -0,0 +1,128 @@
+//******************************************************************************
+//* File:   ThreadPolicy.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_THREADPOLICY_H
+#define	OAT_THREADPOLICY_H
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "../utility/IOFormat.h"
+
+namespace oat {
+
+/**
+ * @brief CPU placement and scheduling of a thread. Threads inherit both from
+ * the thread that starts them, so a policy applied to a component's
+ * processing thread before it starts others also holds for those.
+ *
+ * Failures, e.g. for lack of CAP_SYS_NICE when asking for a real-time
+ * priority, are warned about rather than thrown, because the component works
+ * as before without them.
+ */
+struct ThreadPolicy {
+
+    std::vector<int> cpus; //!< CPUs the thread may run on. Empty for any.
+    int priority {0};      //!< SCHED_FIFO priority, or 0 for SCHED_OTHER
+
+    /**
+     * @brief Apply the policy to the calling thread.
+     * @param what Thread description used in warnings.
+     */
+    void apply(const std::string &what) const
+    {
+        apply(pthread_self(), what);
+    }
+
+    /**
+     * @brief Apply the policy to a running thread.
+     * @param thread Thread to apply the policy to.
+     * @param what Thread description used in warnings.
+     */
+    void apply(std::thread &thread, const std::string &what) const
+    {
+        apply(thread.native_handle(), what);
+    }
+
+private:
+
+    void apply(pthread_t thread, const std::string &what) const
+    {
+        if (!cpus.empty()) {
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (auto c : cpus)
+                if (c >= 0 && c < CPU_SETSIZE)
+                    CPU_SET(c, &set);
+
+            int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+            if (rc != 0)
+                std::cerr << oat::Warn("Could not pin " + what + " thread to "
+                                       "its CPUs: " + std::strerror(rc) + "\n");
+        }
+
+        // A thread that inherited real-time priority is returned to normal
+        // scheduling, which needs no privileges
+        int policy;
+        sched_param param;
+        if (priority == 0 && pthread_getschedparam(thread, &policy, &param) == 0
+            && policy != SCHED_OTHER) {
+            std::memset(&param, 0, sizeof(param));
+            pthread_setschedparam(thread, SCHED_OTHER, &param);
+        }
+
+        if (priority > 0) {
+
+            std::memset(&param, 0, sizeof(param));
+            param.sched_priority = priority;
+
+            int rc = pthread_setschedparam(thread, SCHED_FIFO, &param);
+            if (rc != 0)
+                std::cerr << oat::Warn("Could not give " + what + " thread "
+                                       "real-time priority "
+                                       + std::to_string(priority) + ": "
+                                       + std::strerror(rc) + "\n");
+        }
+    }
+};
+
+/**
+ * @brief Lock all current and future pages of the process into RAM. Each
+ * page is faulted in when it is mapped, including those of shared memory
+ * segments mapped later, so that page faults do not add latency at run time.
+ * Warns on failure, e.g. when RLIMIT_MEMLOCK is too low.
+ */
+inline void lockMemory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        std::cerr << oat::Warn(std::string("Could not lock memory: ")
+                               + std::strerror(errno) + "\n");
+}
+
+}       /* namespace oat */
+#endif	/* OAT_THREADPOLICY_H */
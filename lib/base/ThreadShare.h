@@ -0,0 +1,177 @@
+//******************************************************************************
+//* File:   ThreadShare.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_THREADSHARE_H
+#define	OAT_THREADSHARE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/utility.hpp>
+
+#include "../shmemdf/ThreadBudget.h"
+#include "../utility/IOFormat.h"
+
+namespace oat {
+
+/**
+ * @brief This process's share of a machine-wide budget of OpenCV threads.
+ * Every Oat component is a process, and OpenCV sizes the thread pool of
+ * each to all cores, so a rig of many components oversubscribes its cores
+ * many times over. When OAT_CV_THREADS is set, components instead divide
+ * that many threads between them, in proportion to their thread-weight
+ * options, through a ThreadBudget table. Each process applies its share
+ * with cv::setNumThreads() and adjusts it as components start and stop.
+ * OAT_CV_THREADS=0 divides the CPUs of the machine.
+ */
+class ThreadShare {
+
+public:
+
+    // Components of one process, e.g. in oat-pipeline, share its entry
+    static ThreadShare &process()
+    {
+        static ThreadShare share;
+        return share;
+    }
+
+    ~ThreadShare()
+    {
+        if (budget_)
+            budget_->leave();
+    }
+
+    /**
+     * @brief Take part in the budget, if OAT_CV_THREADS is set. Weights of
+     * the components of a process add up.
+     * @param weight Relative size of the component's share.
+     * @param cpus Number of CPUs the component is pinned to, 0 for any. The
+     * pool is never larger than the CPUs it may run on.
+     */
+    void join(const uint32_t weight, const size_t cpus)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!budget_) {
+
+            const char *env = std::getenv("OAT_CV_THREADS");
+            if (env == nullptr || *env == '\0')
+                return;
+
+            char *end;
+            auto value = std::strtoul(env, &end, 10);
+            if (*end != '\0')
+                throw std::runtime_error("OAT_CV_THREADS must be a number of "
+                                         "threads, or 0 for every CPU.");
+            total_ = value > 0 ? value
+                               : std::max(1u, std::thread::hardware_concurrency());
+
+            try {
+                budget_.reset(new ThreadBudget());
+            } catch (const std::exception &ex) {
+                std::cerr << oat::Warn(std::string("OpenCV thread budget is "
+                                       "not available: ") + ex.what() + "\n");
+                return;
+            }
+        }
+
+        weight_ += weight;
+        if (cpus > 0)
+            cap_ = cap_ == 0 ? cpus : std::max(cap_, cpus);
+
+        if (!budget_->join(weight_))
+            std::cerr << oat::Warn("OpenCV thread budget is full. This "
+                                   "process keeps its own pool.\n");
+
+        applyLocked();
+    }
+
+    /**
+     * @brief Apply a new share if components have started or stopped since
+     * the last one. Called from processing loops, so it only reads the
+     * table's generation unless enough time has passed to look for
+     * processes that exited without leaving.
+     */
+    void rebalance()
+    {
+        if (!enabled_.load(std::memory_order_acquire))
+            return;
+
+        if (budget_->generation() == seen_.load(std::memory_order_relaxed)
+            && nowNs() < next_check_ns_.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        applyLocked();
+    }
+
+private:
+
+    ThreadShare() = default;
+
+    // Sweep for processes that died this often
+    static constexpr int64_t CHECK_PERIOD_NS {1000000000};
+
+    std::unique_ptr<ThreadBudget> budget_;
+    size_t total_ {0};  //!< Threads in the budget
+    uint32_t weight_ {0}; //!< Weight of this process's components
+    size_t cap_ {0};    //!< CPUs this process's components may run on, or 0
+    int threads_ {0};   //!< Threads last given to OpenCV
+
+    std::mutex mutex_;
+    std::atomic<bool> enabled_ {false};
+    std::atomic<uint32_t> seen_ {0};
+    std::atomic<int64_t> next_check_ns_ {0};
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Requires mutex_
+    void applyLocked()
+    {
+        seen_ = budget_->generation();
+        next_check_ns_ = nowNs() + CHECK_PERIOD_NS;
+
+        size_t n = budget_->share(total_);
+        if (cap_ > 0)
+            n = std::min(n, cap_);
+
+        if (static_cast<int>(n) != threads_) {
+            threads_ = static_cast<int>(n);
+            cv::setNumThreads(threads_);
+        }
+
+        enabled_ = true;
+    }
+};
+
+}       /* namespace oat */
+#endif	/* OAT_THREADSHARE_H */
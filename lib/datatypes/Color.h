@@ -30,24 +30,47 @@ enum PixelColor {
     PIX_BINARY = 0,
     PIX_GREY,
     PIX_BGR, // Default
-    PIX_HSV
+    PIX_HSV,
+    PIX_BAYER_RG, // Raw sensor mosaics, by their top-left 2x2 tile
+    PIX_BAYER_GR,
+    PIX_BAYER_GB,
+    PIX_BAYER_BG,
+    PIX_GREY16, // Unsigned 16-bit intensity, e.g. unpacked 12-bit sensor data
+    PIX_MASK // Binary mask packed eight pixels to a byte, see PackedMask.h
 };
 
 // Used conversion structures
-static const int color_2_cvtype[4]{CV_8UC1, CV_8UC1, CV_8UC3, CV_8UC3};
-static const int color_2_bytes[4]{1, 1, 3, 3};
+static const int color_2_cvtype[10]{
+    CV_8UC1, CV_8UC1, CV_8UC3, CV_8UC3, CV_8UC1, CV_8UC1, CV_8UC1, CV_8UC1,
+    CV_16UC1, CV_8UC1};
+static const int color_2_bytes[10]{1, 1, 3, 3, 1, 1, 1, 1, 2, 1};
 
-static const int color_2_imread_code[4]{
-    -2, cv::IMREAD_GRAYSCALE, cv::IMREAD_COLOR, -2};
+static const int color_2_imread_code[10]{
+    -2, cv::IMREAD_GRAYSCALE, cv::IMREAD_COLOR, -2, -2, -2, -2, -2, -2, -2};
 
 // Arguments are from/to PixelColors
 // -1 = No conversion needed
 // -2 = Conversion not possible
-static const int color_conv_table[4][4]{
-    {-1, -1, cv::COLOR_GRAY2BGR, -2}, // From BINARY
-    {-1, -1, cv::COLOR_GRAY2BGR, -2}, // From GREY
-    {cv::COLOR_BGR2GRAY, cv::COLOR_BGR2GRAY, -1, cv::COLOR_BGR2HSV}, // From BGR
-    {-2, -2, cv::COLOR_HSV2BGR, -1}, // From HSV
+// OpenCV names Bayer codes by the second row of the tile, so that an RGGB
+// sensor is demosaiced by cv::COLOR_BayerBG2BGR. GREY16 is converted to 8-bit
+// by a window over its range (oat-framefilt window), not by a color code.
+// MASK frames are packed and unpacked by packMask() and unpackMask().
+static const int color_conv_table[10][10]{
+    {-1, -1, cv::COLOR_GRAY2BGR, -2, -2, -2, -2, -2, -2, -2}, // From BINARY
+    {-1, -1, cv::COLOR_GRAY2BGR, -2, -2, -2, -2, -2, -2, -2}, // From GREY
+    {cv::COLOR_BGR2GRAY, cv::COLOR_BGR2GRAY, -1, cv::COLOR_BGR2HSV,
+     -2, -2, -2, -2, -2, -2}, // From BGR
+    {-2, -2, cv::COLOR_HSV2BGR, -1, -2, -2, -2, -2, -2, -2}, // From HSV
+    {-2, cv::COLOR_BayerBG2GRAY, cv::COLOR_BayerBG2BGR, -2,
+     -1, -2, -2, -2, -2, -2}, // From BAYER_RG
+    {-2, cv::COLOR_BayerGB2GRAY, cv::COLOR_BayerGB2BGR, -2,
+     -2, -1, -2, -2, -2, -2}, // From BAYER_GR
+    {-2, cv::COLOR_BayerGR2GRAY, cv::COLOR_BayerGR2BGR, -2,
+     -2, -2, -1, -2, -2, -2}, // From BAYER_GB
+    {-2, cv::COLOR_BayerRG2GRAY, cv::COLOR_BayerRG2BGR, -2,
+     -2, -2, -2, -1, -2, -2}, // From BAYER_BG
+    {-2, -2, -2, -2, -2, -2, -2, -2, -1, -2}, // From GREY16
+    {-2, -2, -2, -2, -2, -2, -2, -2, -2, -1}, // From MASK
 };
 
 inline std::string color_str(const oat::PixelColor col)
@@ -57,6 +80,12 @@ inline std::string color_str(const oat::PixelColor col)
         case PIX_GREY : return "GREY";
         case PIX_BGR : return "BGR";
         case PIX_HSV : return "HSV";
+        case PIX_BAYER_RG : return "BAYER_RG";
+        case PIX_BAYER_GR : return "BAYER_GR";
+        case PIX_BAYER_GB : return "BAYER_GB";
+        case PIX_BAYER_BG : return "BAYER_BG";
+        case PIX_GREY16 : return "GREY16";
+        case PIX_MASK : return "MASK";
         default : throw std::runtime_error("Invalid color.");
     }
 }
@@ -71,10 +100,32 @@ inline oat::PixelColor str_color(const std::string &s)
         return PIX_BGR;
     else if (s == "HSV")
         return PIX_HSV;
+    else if (s == "BAYER_RG")
+        return PIX_BAYER_RG;
+    else if (s == "BAYER_GR")
+        return PIX_BAYER_GR;
+    else if (s == "BAYER_GB")
+        return PIX_BAYER_GB;
+    else if (s == "BAYER_BG")
+        return PIX_BAYER_BG;
+    else if (s == "GREY16")
+        return PIX_GREY16;
+    else if (s == "MASK")
+        return PIX_MASK;
     else
         throw std::runtime_error("Invalid color.");
 }
 
+/**
+ * @brief Whether frames of a color are raw Bayer mosaics, which must be
+ * demosaiced before their color can be used. Their single plane can be used
+ * as intensity as it is.
+ */
+inline bool is_bayer(oat::PixelColor col)
+{
+    return col >= PIX_BAYER_RG && col <= PIX_BAYER_BG;
+}
+
 inline int cv_type(oat::PixelColor col)
 {
     return color_2_cvtype[col];
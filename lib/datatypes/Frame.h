@@ -24,6 +24,7 @@
 #include <opencv2/imgproc.hpp>
 
 #include "Color.h"
+#include "FrameCopy.h"
 #include "Sample.h"
 
 namespace oat {
@@ -94,25 +95,28 @@ public:
           const int t,
           const oat::PixelColor col,
           void *data,
-          void *samp_ptr)
-    : cv::Mat(r, c, t, data)
+          void *samp_ptr,
+          const size_t step = cv::Mat::AUTO_STEP)
+    : cv::Mat(r, c, t, data, step)
     , sample_ptr_(static_cast<Sample *>(samp_ptr))
     , color_(col)
     {
         // Nothing
     }
 
-    Frame clone() const
+    Frame clone(const CopyHint hint = CopyHint::CACHED) const
     {
-        Frame f(cv::Mat::clone());
+        cv::Mat m;
+        copyPixels(*this, m, hint);
+        Frame f(m);
         *(f.sample_ptr_) = *sample_ptr_;
         f.color_ = color_;
         return f;
     }
 
-    void copyTo(Frame &f) const
+    void copyTo(Frame &f, const CopyHint hint = CopyHint::CACHED) const
     {
-        cv::Mat::copyTo(f);
+        copyPixels(*this, f, hint);
         *(f.sample_ptr_) = *sample_ptr_;
         f.color_ = color_;
     }
@@ -126,9 +130,17 @@ public:
     uint64_t sample_count(void) const { return sample_ptr_->count(); }
     void incrementSampleCount() { sample_ptr_->incrementCount(); }
     void incrementSampleCount(USec us) { sample_ptr_->incrementCount(us); }
+    void stampSample() { sample_ptr_->stamp(); }
+    void setSampleClock(oat::Sample::ClockSource source,
+                        uint64_t host_ns,
+                        std::chrono::nanoseconds precision)
+    {
+        sample_ptr_->set_clock(source, host_ns, precision);
+    }
 
     // Provide copy of sample_
     oat::Sample sample() const { return *sample_ptr_; };
+    void set_sample(const oat::Sample &val) { *sample_ptr_ = val; }
 
     // Color accessors
     PixelColor color(void) const { return color_; }
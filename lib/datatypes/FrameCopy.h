@@ -0,0 +1,142 @@
+//******************************************************************************
+//* File:   FrameCopy.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMECOPY_H
+#define	OAT_FRAMECOPY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <opencv2/core/mat.hpp>
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+
+namespace oat {
+
+/**
+ * @brief How pixels are copied, which depends on what the reader of the copy
+ * does with it next.
+ */
+enum class CopyHint {
+    CACHED = 0, // Plain copy. The copy ends up in cache.
+    STREAM,     // Non-temporal stores, for copies that the reader will not
+                // touch for a while, e.g. a recorder's queue. Neither the
+                // copy nor the source evicts the copier's working set.
+    PREFETCH    // Plain stores, fetching the source ahead of the copy, for
+                // copies that the reader computes on right away
+};
+
+// Copies smaller than this are made with plain stores whatever the hint,
+// since they fit in cache alongside the copier's working set
+static constexpr size_t STREAM_COPY_MIN_BYTES {1 << 20};
+
+namespace detail {
+
+inline void streamBytes(const uint8_t *in, uint8_t *out, const size_t n)
+{
+    size_t x = 0;
+
+#if defined __SSE2__
+    // Non-temporal stores must be 16 byte aligned
+    x = std::min(n, (16 - (reinterpret_cast<uintptr_t>(out) & 15)) & 15);
+    std::memcpy(out, in, x);
+
+    for (; x + 64 <= n; x += 64) {
+        const auto *i = reinterpret_cast<const __m128i *>(in + x);
+        auto *o = reinterpret_cast<__m128i *>(out + x);
+        const __m128i a = _mm_loadu_si128(i);
+        const __m128i b = _mm_loadu_si128(i + 1);
+        const __m128i c = _mm_loadu_si128(i + 2);
+        const __m128i d = _mm_loadu_si128(i + 3);
+        _mm_stream_si128(o, a);
+        _mm_stream_si128(o + 1, b);
+        _mm_stream_si128(o + 2, c);
+        _mm_stream_si128(o + 3, d);
+    }
+#endif
+
+    std::memcpy(out + x, in + x, n - x);
+}
+
+inline void prefetchBytes(const uint8_t *in, uint8_t *out, const size_t n)
+{
+    // Each block is copied once the next one has been asked for
+    constexpr size_t BLOCK {4096}, LINE {64};
+
+    for (size_t x = 0; x < n; x += BLOCK) {
+
+        const size_t m = std::min(BLOCK, n - x);
+        const size_t ahead = std::min(BLOCK, n - x - m);
+        for (size_t k = 0; k < ahead; k += LINE)
+            __builtin_prefetch(in + x + m + k);
+
+        std::memcpy(out + x, in + x, m);
+    }
+}
+
+} /* namespace detail */
+
+/**
+ * @brief Copy the pixels of a matrix, reallocating the destination only if
+ * its format differs, as cv::Mat::copyTo() does.
+ * @param src Source matrix. Rows may be padded.
+ * @param dst Destination matrix. Rows may be padded.
+ * @param hint How to copy.
+ */
+inline void copyPixels(const cv::Mat &src,
+                       cv::Mat &dst,
+                       const CopyHint hint = CopyHint::CACHED)
+{
+    const size_t bytes = src.total() * src.elemSize();
+    if (hint == CopyHint::CACHED || bytes < STREAM_COPY_MIN_BYTES) {
+        src.copyTo(dst);
+        return;
+    }
+
+    dst.create(src.rows, src.cols, src.type());
+
+    // Frames without padding are copied in one run
+    int rows = src.rows;
+    size_t row_bytes = src.cols * src.elemSize();
+    if (src.isContinuous() && dst.isContinuous()) {
+        rows = 1;
+        row_bytes = bytes;
+    }
+
+    for (int i = 0; i < rows; i++) {
+        if (hint == CopyHint::STREAM)
+            detail::streamBytes(src.ptr(i), dst.ptr(i), row_bytes);
+        else
+            detail::prefetchBytes(src.ptr(i), dst.ptr(i), row_bytes);
+    }
+
+#if defined __SSE2__
+    // Non-temporal stores are weakly ordered. Make them visible before the
+    // copy is handed on, e.g. through a semaphore.
+    if (hint == CopyHint::STREAM)
+        _mm_sfence();
+#endif
+}
+
+}      /* namespace oat */
+#endif /* OAT_FRAMECOPY_H */
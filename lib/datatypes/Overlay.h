@@ -0,0 +1,166 @@
+//******************************************************************************
+//* File:   Overlay.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_OVERLAY_H
+#define	OAT_OVERLAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "Sample.h"
+
+namespace oat {
+
+/**
+ * @brief A single vector drawing primitive. Coordinates are in pixels of the
+ * frame the overlay was made for.
+ */
+struct OverlayShape {
+
+    enum Kind : uint8_t {
+        CIRCLE = 0, // Centered at (x0, y0) with radius x1
+        LINE,       // From (x0, y0) to (x1, y1)
+        ARROW,      // From (x0, y0) to (x1, y1), head at (x1, y1)
+        HISTORY,    // Latest point (x0, y0) of path number x1, persistent
+        TEXT        // Origin at (x0, y0) with font scale x1
+    };
+
+    Kind kind;
+
+    // BGR color
+    uint8_t color[3];
+
+    // Line thickness or font thickness
+    int16_t thickness;
+
+    // OpenCV font face, for TEXT only
+    int16_t font;
+
+    float x0, y0, x1, y1;
+
+    // Null terminated, for TEXT only
+    static constexpr size_t TEXT_LENGTH {48};
+    char text[TEXT_LENGTH];
+};
+
+/**
+ * @brief Fixed-capacity list of drawing primitives describing the decoration
+ * of a single frame. Unlike a decorated frame, an overlay is a few kilobytes
+ * no matter the frame size and can be composited onto the frame by whatever
+ * component finally displays it.
+ */
+class Overlay {
+
+public:
+
+    // Maximum number of shapes a single overlay can hold
+    static constexpr size_t CAPACITY {128};
+
+    /**
+     * @brief Append a shape.
+     * @return False if the overlay is full and the shape was dropped.
+     */
+    bool push(const OverlayShape &shape)
+    {
+        if (size_ == CAPACITY)
+            return false;
+
+        shapes_[size_++] = shape;
+        return true;
+    }
+
+    /**
+     * @brief Append a TEXT shape.
+     * @return False if the overlay is full and the text was dropped.
+     */
+    bool pushText(const std::string &text,
+                  const float x,
+                  const float y,
+                  const uint8_t *bgr,
+                  const int font,
+                  const double scale,
+                  const int thickness)
+    {
+        OverlayShape s;
+        s.kind = OverlayShape::TEXT;
+        std::copy(bgr, bgr + 3, s.color);
+        s.thickness = static_cast<int16_t>(thickness);
+        s.font = static_cast<int16_t>(font);
+        s.x0 = x;
+        s.y0 = y;
+        s.x1 = static_cast<float>(scale);
+        s.y1 = 0;
+
+        const size_t n = std::min(text.size(), OverlayShape::TEXT_LENGTH - 1);
+        std::memcpy(s.text, text.data(), n);
+        s.text[n] = '\0';
+
+        return push(s);
+    }
+
+    /**
+     * @brief Remove all shapes and flags. The sample is untouched.
+     */
+    void clear()
+    {
+        size_ = 0;
+        encode_bit_size = 0;
+    }
+
+    size_t size(void) const { return size_; }
+    bool empty(void) const { return size_ == 0; }
+
+    const OverlayShape &operator[](const size_t i) const { return shapes_[i]; }
+    const OverlayShape *begin() const { return shapes_; }
+    const OverlayShape *end() const { return shapes_ + size_; }
+
+    // Sample information, that of the frame the overlay was made for
+    void set_sample(const Sample &val) { sample_ = val; }
+    uint64_t sample_count(void) const { return sample_.count(); }
+    const oat::Sample &sample() const { return sample_; }
+
+    // Incremented each time path history is cleared. The renderer erases
+    // accumulated HISTORY when it changes, even if the overlay that changed
+    // it was never rendered.
+    uint32_t history_epoch {0};
+
+    // Maximum number of HISTORY line segments, over all paths, the renderer
+    // keeps. The oldest are dropped first.
+    uint32_t history_length {1024};
+
+    // If non-zero, the sample number is drawn as a binary bar of blocks of
+    // this size along the top of the frame
+    int encode_bit_size {0};
+
+private:
+
+    oat::Sample sample_;
+    size_t size_ {0};
+    OverlayShape shapes_[CAPACITY];
+};
+
+static_assert(std::is_trivially_copyable<Overlay>::value,
+              "Overlay must be trivially copyable.");
+
+}      /* namespace oat */
+#endif /* OAT_OVERLAY_H */
@@ -0,0 +1,162 @@
+//******************************************************************************
+//* File:   PackedMask.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_PACKEDMASK_H
+#define	OAT_PACKEDMASK_H
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace oat {
+
+// Binary masks are packed eight pixels to a byte, pixel x of a row in bit
+// x % 8 of byte x / 8. PIX_MASK frames are CV_8UC1 matrices of packed bytes,
+// so a mask of width w is (w + 7) / 8 columns wide. Pixels added to pad the
+// last byte of a row are 0.
+
+/**
+ * @brief Columns of the packed form of a mask.
+ * @param width Width of the mask, in pixels.
+ */
+inline int packed_cols(const int width) { return (width + 7) / 8; }
+
+/**
+ * @brief Width, in pixels, of the mask held by a packed frame.
+ */
+inline int mask_width(const cv::Mat &packed) { return 8 * packed.cols; }
+
+namespace detail {
+
+inline void packRow(const uint8_t *in, uint8_t *out, const int w)
+{
+    int x = 0;
+
+#if defined __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= w; x += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + x));
+        const int bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        out[x / 8] = static_cast<uint8_t>(bits);
+        out[x / 8 + 1] = static_cast<uint8_t>(bits >> 8);
+    }
+#elif defined __ARM_NEON
+    static const uint8_t weights[16] {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weight = vld1q_u8(weights);
+    for (; x + 16 <= w; x += 16) {
+        const uint8x16_t v = vld1q_u8(in + x);
+        const uint8x16_t b = vandq_u8(vtstq_u8(v, v), weight);
+        uint8x8_t s = vpadd_u8(vget_low_u8(b), vget_high_u8(b));
+        s = vpadd_u8(s, s);
+        s = vpadd_u8(s, s);
+        out[x / 8] = vget_lane_u8(s, 0);
+        out[x / 8 + 1] = vget_lane_u8(s, 1);
+    }
+#endif
+
+    for (; x < w; x += 8) {
+        uint8_t byte = 0;
+        for (int k = 0; k < 8 && x + k < w; k++)
+            byte |= static_cast<uint8_t>(in[x + k] != 0) << k;
+        out[x / 8] = byte;
+    }
+}
+
+inline void unpackRow(const uint8_t *in, uint8_t *out, const int w)
+{
+    int x = 0;
+
+#if defined __SSE2__
+    const __m128i weight = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                         1, 2, 4, 8, 16, 32, 64, -128);
+    for (; x + 16 <= w; x += 16) {
+        const __m128i v = _mm_unpacklo_epi64(
+            _mm_set1_epi8(static_cast<char>(in[x / 8])),
+            _mm_set1_epi8(static_cast<char>(in[x / 8 + 1])));
+        const __m128i set = _mm_cmpeq_epi8(_mm_and_si128(v, weight), weight);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), set);
+    }
+#elif defined __ARM_NEON
+    static const uint8_t weights[16] {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weight = vld1q_u8(weights);
+    for (; x + 16 <= w; x += 16) {
+        const uint8x16_t v = vcombine_u8(vdup_n_u8(in[x / 8]),
+                                         vdup_n_u8(in[x / 8 + 1]));
+        vst1q_u8(out + x, vtstq_u8(v, weight));
+    }
+#endif
+
+    for (; x < w; x++)
+        out[x] = (in[x / 8] >> (x % 8)) & 1 ? 255 : 0;
+}
+
+} /* namespace detail */
+
+/**
+ * @brief Pack a binary mask, in which every nonzero pixel is set.
+ * @param mask CV_8UC1 mask.
+ * @param packed Set to the packed mask. Must already have the packed size of
+ * the mask if it is a shared frame, which is then written in place.
+ */
+inline void packMask(const cv::Mat &mask, cv::Mat &packed)
+{
+    if (mask.type() != CV_8UC1)
+        throw std::runtime_error("Only 8 bit, single channel masks can be "
+                                 "packed.");
+    packed.create(mask.rows, packed_cols(mask.cols), CV_8UC1);
+
+    cv::parallel_for_(cv::Range(0, mask.rows), [&](const cv::Range &r) {
+        for (int y = r.start; y < r.end; y++)
+            detail::packRow(mask.ptr<uint8_t>(y), packed.ptr<uint8_t>(y),
+                            mask.cols);
+    });
+}
+
+/**
+ * @brief Unpack a mask into a CV_8UC1 mask whose set pixels are 255.
+ * @param packed Packed mask.
+ * @param mask Set to the mask, mask_width(packed) pixels wide.
+ */
+inline void unpackMask(const cv::Mat &packed, cv::Mat &mask)
+{
+    if (packed.type() != CV_8UC1)
+        throw std::runtime_error("Packed masks must be 8 bit, single "
+                                 "channel frames.");
+    mask.create(packed.rows, mask_width(packed), CV_8UC1);
+
+    cv::parallel_for_(cv::Range(0, packed.rows), [&](const cv::Range &r) {
+        for (int y = r.start; y < r.end; y++)
+            detail::unpackRow(packed.ptr<uint8_t>(y), mask.ptr<uint8_t>(y),
+                              mask.cols);
+    });
+}
+
+}      /* namespace oat */
+#endif /* OAT_PACKEDMASK_H */
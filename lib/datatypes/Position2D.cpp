@@ -19,6 +19,9 @@
 
 #include "Position2D.h"
 
+#include <cstdint>
+#include <cstring>
+
 namespace oat {
 
 const char Position2D::NPY_DTYPE[]{"[('tick', '<u8'),"
@@ -33,65 +36,97 @@ const char Position2D::NPY_DTYPE[]{"[('tick', '<u8'),"
                                     "('reg_ok', '<i1'),"
                                     "('reg', 'a10')]"};
 
-// TODO: This feels horrible...
-std::vector<char> packPosition(const Position2D &p)
+void packPosition(const Position2D &p, char *out)
 {
-    std::vector<char> pack;
-    pack.reserve(oat::Position2D::NPY_DTYPE_BYTES);
+    // Fields are packed in the order and sizes of NPY_DTYPE
+    auto put = [&out](const void *val, const size_t n) {
+        std::memcpy(out, val, n);
+        out += n;
+    };
 
-    auto sc = p.sample_.count();
-    auto val = reinterpret_cast<char*>(&sc);
-    pack.insert(pack.end(), val, val + sizeof (sc));
+    const uint64_t sc = p.sample_.count();
+    put(&sc, sizeof(sc));
 
-    auto su = p.sample_usec();
-    val = reinterpret_cast<char*>(&su);
-    pack.insert(pack.end(), val, val + sizeof (su));
+    const uint64_t su = p.sample_usec();
+    put(&su, sizeof(su));
 
-    auto u = static_cast<int>(p.unit_of_length_);
-    val = reinterpret_cast<char*>(&u);
-    pack.insert(pack.end(), val, val + sizeof (u));
+    const int32_t u = static_cast<int32_t>(p.unit_of_length_);
+    put(&u, sizeof(u));
 
     // Position
-    char pok = p.position_valid ? 1 : 0;
-    pack.insert(pack.end(), &pok, &pok + 1);
-
-    auto px = p.position.x;
-    val = reinterpret_cast<char*>(&px);
-    pack.insert(pack.end(), val, val + sizeof (px));
-
-    auto py = p.position.y;
-    val = reinterpret_cast<char*>(&py);
-    pack.insert(pack.end(), val, val + sizeof (px));
+    const char pok = p.position_valid ? 1 : 0;
+    put(&pok, 1);
+    put(&p.position.x, sizeof(double));
+    put(&p.position.y, sizeof(double));
 
     // Velocity
-    char vok = p.velocity_valid ? 1 : 0;
-    pack.insert(pack.end(), &vok, &vok + 1);
+    const char vok = p.velocity_valid ? 1 : 0;
+    put(&vok, 1);
+    put(&p.velocity.x, sizeof(double));
+    put(&p.velocity.y, sizeof(double));
 
-    auto vx = p.velocity.x;
-    val = reinterpret_cast<char*>(&vx);
-    pack.insert(pack.end(), val, val + sizeof (vx));
+    // Heading
+    const char hok = p.heading_valid ? 1 : 0;
+    put(&hok, 1);
+    put(&p.heading.x, sizeof(double));
+    put(&p.heading.y, sizeof(double));
 
-    auto vy = p.velocity.y;
-    val = reinterpret_cast<char*>(&vy);
-    pack.insert(pack.end(), val, val + sizeof (vx));
+    // Region
+    const char rok = p.region_valid ? 1 : 0;
+    put(&rok, 1);
+    put(p.region, oat::Position2D::REGION_LEN);
+}
 
-    // Heading
-    char hok = p.heading_valid ? 1 : 0;
-    pack.insert(pack.end(), &hok, &hok + 1);
+void unpackPosition(const char *in, Position2D &p)
+{
+    // Fields are unpacked in the order and sizes of NPY_DTYPE
+    auto get = [&in](void *val, const size_t n) {
+        std::memcpy(val, in, n);
+        in += n;
+    };
+
+    // The count is moved so that incrementing it restores both the count and
+    // the sample time
+    uint64_t sc, su;
+    get(&sc, sizeof(sc));
+    get(&su, sizeof(su));
+    p.sample_.set_count(sc - 1);
+    p.sample_.incrementCount(Position2D::USec(su));
+
+    int32_t u;
+    get(&u, sizeof(u));
+    p.unit_of_length_ = static_cast<DistanceUnit>(u);
+
+    // Position
+    char ok;
+    get(&ok, 1);
+    p.position_valid = ok != 0;
+    get(&p.position.x, sizeof(double));
+    get(&p.position.y, sizeof(double));
 
-    auto hx = p.heading.x;
-    val = reinterpret_cast<char*>(&hx);
-    pack.insert(pack.end(), val, val + sizeof (hx));
+    // Velocity
+    get(&ok, 1);
+    p.velocity_valid = ok != 0;
+    get(&p.velocity.x, sizeof(double));
+    get(&p.velocity.y, sizeof(double));
 
-    auto hy = p.heading.y;
-    val = reinterpret_cast<char*>(&hy);
-    pack.insert(pack.end(), val, val + sizeof (hx));
+    // Heading
+    get(&ok, 1);
+    p.heading_valid = ok != 0;
+    get(&p.heading.x, sizeof(double));
+    get(&p.heading.y, sizeof(double));
 
     // Region
-    char rok = p.region_valid ? 1 : 0;
-    pack.insert(pack.end(), &rok, &rok + 1);
-    pack.insert(pack.end(), p.region, p.region + oat::Position2D::REGION_LEN);
+    get(&ok, 1);
+    p.region_valid = ok != 0;
+    get(p.region, oat::Position2D::REGION_LEN);
+    p.region[sizeof(p.region) - 1] = '\0';
+}
 
+std::vector<char> packPosition(const Position2D &p)
+{
+    std::vector<char> pack(oat::Position2D::NPY_DTYPE_BYTES);
+    packPosition(p, pack.data());
     return pack;
 }
 
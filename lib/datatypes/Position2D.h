@@ -20,7 +20,9 @@
 #ifndef OAT_POSITION_H
 #define	OAT_POSITION_H
 
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <opencv2/core/mat.hpp>
@@ -36,6 +38,7 @@ using UnitVector2D = cv::Point2d;
 
 // Forward decl.
 class Position2D;
+struct PositionRecord;
 
 /** 
  * @brief Serialize position.
@@ -53,6 +56,23 @@ void serializePosition(const Position2D &p, Writer &w, bool verbose = false);
  */
 std::vector<char> packPosition(const Position2D &p);
 
+/**
+ * @brief Pack a position object into an existing buffer, e.g. the storage of
+ * a network message, in the layout given by Position2D::NPY_DTYPE.
+ * @param p Position to pack.
+ * @param out Buffer of at least Position2D::NPY_DTYPE_BYTES bytes.
+ */
+void packPosition(const Position2D &p, char *out);
+
+/**
+ * @brief Unpack a position from a buffer in the layout given by
+ * Position2D::NPY_DTYPE, e.g. a record of a binary position file. The label
+ * and homography of the position are untouched.
+ * @param in Buffer of at least Position2D::NPY_DTYPE_BYTES bytes.
+ * @param p Position to unpack into.
+ */
+void unpackPosition(const char *in, Position2D &p);
+
 /**
  * Unit of length used to specify position.
  */
@@ -68,6 +88,8 @@ class Position2D {
     friend void
     serializePosition(const Position2D &, Writer &, bool verbose);
     friend std::vector<char> packPosition(const Position2D &);
+    friend void packPosition(const Position2D &, char *);
+    friend void unpackPosition(const char *, Position2D &);
 
     using USec = Sample::Microseconds;
 
@@ -97,6 +119,7 @@ public:
         position = p.position;
         velocity = p.velocity;
         heading = p.heading;
+        score = p.score;
         region_valid = p.region_valid;
         strncpy(region, p.region, sizeof(region));
         region[sizeof(region) - 1] = '\0';
@@ -105,7 +128,9 @@ public:
     }
 
     // Accessors
+    static constexpr size_t LABEL_LEN {100};
     char *label() { return label_; }
+    const char *label() const { return label_; }
     DistanceUnit unit_of_length(void) const { return unit_of_length_; }
 
     // Categorical position
@@ -123,6 +148,10 @@ public:
     Velocity2D velocity;
     UnitVector2D heading;
 
+    // Detection confidence, e.g. object area, used to weight combination. 0
+    // if unknown.
+    double score {0.0};
+
     // Homography
     cv::Matx33d homography() const { return homography_; }
 
@@ -134,6 +163,9 @@ public:
     uint64_t sample_usec(void) const { return sample_.microseconds().count(); }
     void incrementSampleCount() { sample_.incrementCount(); }
     void incrementSampleCount(USec us) { sample_.incrementCount(us); }
+    void stampSample() { sample_.stamp(); }
+    uint64_t sample_latency_usec(void) const { return sample_.latency().count(); }
+    const oat::Sample &sample() const { return sample_; }
 
     void setCoordSystem(const DistanceUnit value, const cv::Matx33d homography)
     {
@@ -141,12 +173,24 @@ public:
         homography_ = homography;
     }
 
+    /**
+     * @brief Per-sample part of the position, as exchanged through shared
+     * memory.
+     */
+    PositionRecord record() const;
+
+    /**
+     * @brief Set the per-sample part of the position. Label, unit of length
+     * and homography are untouched.
+     */
+    void set_record(const PositionRecord &record);
+
     static constexpr size_t NPY_DTYPE_BYTES {82};
     static const char NPY_DTYPE[];
 
 private:
 
-    char label_[100] {0}; //!< Position label (e.g. "anterior")
+    char label_[LABEL_LEN] {0}; //!< Position label (e.g. "anterior")
     DistanceUnit unit_of_length_ {DistanceUnit::PIXELS};
 
     oat::Sample sample_;
@@ -155,6 +199,68 @@ private:
     cv::Matx33d homography_ {1.0, 0, 0, 0, 1.0, 0, 0, 0, 1.0};
 };
 
+/**
+ * @brief Plain, trivially copyable form of the per-sample data of a
+ * Position2D. This is what position nodes carry for each sample. The label,
+ * unit of length and homography do not change from sample to sample and are
+ * kept once per node instead.
+ */
+struct PositionRecord {
+
+    oat::Sample sample;
+
+    bool position_valid {false};
+    bool velocity_valid {false};
+    bool heading_valid {false};
+    bool region_valid {false};
+
+    double position[2] {0, 0};
+    double velocity[2] {0, 0};
+    double heading[2] {0, 0};
+    double score {0};
+
+    char region[Position2D::REGION_LEN] {0};
+};
+
+static_assert(std::is_trivially_copyable<PositionRecord>::value,
+              "PositionRecord must be trivially copyable.");
+
+inline PositionRecord Position2D::record() const
+{
+    PositionRecord r;
+    r.sample = sample_;
+    r.position_valid = position_valid;
+    r.velocity_valid = velocity_valid;
+    r.heading_valid = heading_valid;
+    r.region_valid = region_valid;
+    r.position[0] = position.x;
+    r.position[1] = position.y;
+    r.velocity[0] = velocity.x;
+    r.velocity[1] = velocity.y;
+    r.heading[0] = heading.x;
+    r.heading[1] = heading.y;
+    r.score = score;
+    std::memcpy(r.region, region, sizeof(r.region));
+    r.region[sizeof(r.region) - 1] = '\0';
+
+    return r;
+}
+
+inline void Position2D::set_record(const PositionRecord &r)
+{
+    sample_ = r.sample;
+    position_valid = r.position_valid;
+    velocity_valid = r.velocity_valid;
+    heading_valid = r.heading_valid;
+    region_valid = r.region_valid;
+    position = Point2D(r.position[0], r.position[1]);
+    velocity = Velocity2D(r.velocity[0], r.velocity[1]);
+    heading = UnitVector2D(r.heading[0], r.heading[1]);
+    score = r.score;
+    std::memcpy(region, r.region, sizeof(region));
+    region[sizeof(region) - 1] = '\0';
+}
+
 /**
  * @brief JSON Serializer
  *
@@ -180,6 +286,10 @@ void serializePosition(const Position2D &p, Writer &writer, bool verbose)
     writer.String("usec");
     writer.Uint64(p.sample_usec());
 
+    // Time since capture, as of serialization
+    writer.String("lat_usec");
+    writer.Uint64(p.sample_latency_usec());
+
     // Coordinate system
     writer.String("unit");
     writer.Int(static_cast<int>(p.unit_of_length_));
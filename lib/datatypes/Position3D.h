@@ -0,0 +1,89 @@
+//******************************************************************************
+//* File:   Position3D.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITION3D_H
+#define	OAT_POSITION3D_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "Sample.h"
+
+namespace oat {
+
+/**
+ * @brief Fixed-capacity set of 3D object positions in a single sample, e.g.
+ * triangulated from several calibrated cameras. Positions are in the world
+ * frame and units of the camera calibration. Like PositionArray, storage is
+ * a contiguous structure of arrays, so the whole set is exchanged through
+ * shared memory in a single copy.
+ */
+class Position3D {
+
+public:
+
+    // Maximum number of objects a single sample can hold
+    static constexpr size_t CAPACITY {64};
+
+    /**
+     * @brief Set the number of objects. Entries beyond the old size are not
+     * cleared.
+     * @param n Number of objects, at most CAPACITY.
+     */
+    void resize(const size_t n) { size_ = n < CAPACITY ? n : CAPACITY; }
+
+    /**
+     * @brief Remove all objects. The sample is untouched.
+     */
+    void clear() { size_ = 0; }
+
+    size_t size(void) const { return size_; }
+    bool empty(void) const { return size_ == 0; }
+
+    // Sample information
+    void set_sample(const Sample &val) { sample_ = val; }
+    double sample_period_sec() const { return sample_.period_sec().count(); }
+    uint64_t sample_count(void) const { return sample_.count(); }
+    void stampSample() { sample_.stamp(); }
+    const oat::Sample &sample() const { return sample_; }
+
+    // Object data. Only the first size() entries are meaningful.
+    double x[CAPACITY];
+    double y[CAPACITY];
+    double z[CAPACITY];
+    bool valid[CAPACITY];
+
+    // Mean reprojection error, in pixels, of each valid position
+    double error[CAPACITY];
+
+    // Number of cameras each valid position was triangulated from
+    uint32_t views[CAPACITY];
+
+private:
+
+    oat::Sample sample_;
+    size_t size_ {0};
+};
+
+static_assert(std::is_trivially_copyable<Position3D>::value,
+              "Position3D must be trivially copyable.");
+
+}      /* namespace oat */
+#endif /* OAT_POSITION3D_H */
@@ -0,0 +1,108 @@
+//******************************************************************************
+//* File:   PositionArray.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONARRAY_H
+#define	OAT_POSITIONARRAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "Position2D.h"
+#include "Sample.h"
+
+namespace oat {
+
+/**
+ * @brief Fixed-capacity set of object positions detected in a single sample,
+ * e.g. one per animal in a colony. Storage is a contiguous structure of
+ * arrays so that the whole set can be exchanged through shared memory in a
+ * single copy and iterated over one coordinate at a time.
+ */
+class PositionArray {
+
+public:
+
+    // Maximum number of objects a single array can hold
+    static constexpr size_t CAPACITY {64};
+
+    /**
+     * @brief Append an object.
+     * @param x Horizontal position
+     * @param y Vertical position
+     * @param area Object area
+     * @return False if the array is full and the object was dropped.
+     */
+    bool push(const double x, const double y, const double area)
+    {
+        if (size_ == CAPACITY)
+            return false;
+
+        this->x[size_] = x;
+        this->y[size_] = y;
+        this->area[size_] = area;
+        valid[size_] = true;
+        id[size_] = static_cast<uint32_t>(size_);
+        size_++;
+
+        return true;
+    }
+
+    /**
+     * @brief Remove all objects. The sample is untouched.
+     */
+    void clear() { size_ = 0; }
+
+    size_t size(void) const { return size_; }
+    bool empty(void) const { return size_ == 0; }
+    bool full(void) const { return size_ == CAPACITY; }
+
+    DistanceUnit unit_of_length(void) const { return unit_of_length_; }
+    void set_unit_of_length(const DistanceUnit value) { unit_of_length_ = value; }
+
+    // Sample information
+    void set_sample(const Sample &val) { sample_ = val; }
+    double sample_period_sec() const { return sample_.period_sec().count(); }
+    uint64_t sample_count(void) const { return sample_.count(); }
+    void stampSample() { sample_.stamp(); }
+    const oat::Sample &sample() const { return sample_; }
+
+    // Object data. Only the first size() entries are meaningful. An entry
+    // may be invalidated, e.g. by a filter, without compacting the array.
+    double x[CAPACITY];
+    double y[CAPACITY];
+    double area[CAPACITY];
+    bool valid[CAPACITY];
+
+    // Object identities. Objects are numbered in order of detection unless
+    // a tracker gives them IDs that are stable across samples.
+    uint32_t id[CAPACITY];
+
+private:
+
+    oat::Sample sample_;
+    DistanceUnit unit_of_length_ {DistanceUnit::PIXELS};
+    size_t size_ {0};
+};
+
+static_assert(std::is_trivially_copyable<PositionArray>::value,
+              "PositionArray must be trivially copyable.");
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONARRAY_H */
@@ -21,8 +21,10 @@
 #define	OAT_SAMPLE_H
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <ratio>
 
 #include <opencv2/core/mat.hpp>
@@ -30,16 +32,33 @@
 namespace oat {
 
 /**
- * Class specifying general sample timing information.
+ * Class specifying general sample timing information. Samples also carry the
+ * steady_clock time at which they were captured and a short trace of the
+ * times at which each downstream SINK published them, so that latency can be
+ * measured end to end. The capture time of each sample is also kept on the
+ * host steady_clock, along with the clock it was derived from and its
+ * precision, so that samples from different sources can be aligned.
  */
 class Sample {
 
 public:
 
+    // Clock that a sample's capture time was taken from, from worst to best
+    enum class ClockSource : uint8_t {
+        NONE = 0, // No capture time, e.g. synthetic or recorded frames
+        HOST,     // Host clock when the frame reached the host
+        DRIVER,   // Driver timestamp
+        SENSOR    // Timestamp embedded by the sensor
+    };
+
     using Seconds = std::chrono::duration<double, std::ratio<1>>;
     using Microseconds = std::chrono::microseconds; 
     using IEEE1394Tick = std::chrono::duration<float, std::ratio<1,8000>>;
 
+    // Number of per-stage timestamps that a sample can carry. Stages beyond
+    // this are not recorded.
+    static constexpr size_t MAX_STAMPS {8};
+
     explicit Sample()
     {
         // Nothing
@@ -77,6 +96,7 @@ public:
      */
     uint64_t incrementCount() {
         microseconds_ += period_microseconds_;
+        startTrace();
         return ++count_;
     }
 
@@ -90,9 +110,64 @@ public:
      */
     uint64_t incrementCount(const Microseconds usec) {
         microseconds_ = usec;
+        startTrace();
         return ++count_;
     }
 
+    /**
+     * @brief Move the sample clock, e.g. to serve part of a recording under
+     * its original sample numbers. Only pure SINKs should do this.
+     *
+     * @param count Sample count. The next incremented sample is count + 1.
+     */
+    void set_count(const uint64_t count) {
+        count_ = count;
+        microseconds_ = period_microseconds_ * count;
+    }
+
+    /**
+     * @brief Set the capture time of the sample. Only pure SINKs should do
+     * this, after the count is incremented.
+     *
+     * @param source Clock the capture time was taken from.
+     * @param host_ns Capture time on the host steady_clock, in nanoseconds,
+     * after correcting for the offset of the source clock.
+     * @param precision Precision of the capture time.
+     */
+    void set_clock(const ClockSource source,
+                   const uint64_t host_ns,
+                   const std::chrono::nanoseconds precision) {
+        clock_source_ = source;
+        host_ns_ = host_ns;
+        clock_precision_ns_ = static_cast<uint32_t>(precision.count());
+    }
+
+    /**
+     * @brief Record the time at which a stage published this sample. Called
+     * by SINKs on post().
+     */
+    void stamp() {
+        if (num_stamps_ < MAX_STAMPS)
+            stamps_[num_stamps_++] = now_ns();
+    }
+
+    /**
+     * @brief Move the steady_clock times of the sample onto another clock,
+     * e.g. that of the host a sample was sent to. Only components that carry
+     * samples between hosts should do this.
+     *
+     * @param offset_ns Nanoseconds to add to each time.
+     */
+    void shiftClock(const int64_t offset_ns) {
+        const auto offset = static_cast<uint64_t>(offset_ns);
+        if (capture_ns_ != 0)
+            capture_ns_ += offset;
+        if (host_ns_ != 0)
+            host_ns_ += offset;
+        for (size_t i = 0; i < num_stamps_; i++)
+            stamps_[i] += offset;
+    }
+
     /** 
      * @brief Set the sample rate.
      * 
@@ -113,6 +188,31 @@ public:
     Microseconds period_microseconds() const { return period_microseconds_; }
     double rate_hz() const { return rate_hz_; }
 
+    // Capture time. host_ns() is 0 if clock_source() is NONE.
+    ClockSource clock_source() const { return clock_source_; }
+    uint64_t host_ns() const { return host_ns_; }
+    std::chrono::nanoseconds clock_precision() const {
+        return std::chrono::nanoseconds(clock_precision_ns_);
+    }
+
+    // Latency trace. Times are steady_clock nanoseconds, which are comparable
+    // across processes on the same machine. 0 if the sample was not counted.
+    uint64_t capture_ns() const { return capture_ns_; }
+    size_t num_stamps() const { return num_stamps_; }
+    uint64_t stamp_ns(const size_t stage) const { return stamps_.at(stage); }
+
+    /**
+     * @brief Time since the sample was captured.
+     * @return Latency, or 0 if the sample has no capture time.
+     */
+    Microseconds latency() const {
+        if (capture_ns_ == 0)
+            return Microseconds(0);
+
+        return std::chrono::duration_cast<Microseconds>(
+            std::chrono::nanoseconds(now_ns() - capture_ns_));
+    }
+
 private:
 
     uint64_t count_ {0};
@@ -120,6 +220,27 @@ private:
     Seconds period_sec_ {0.0};
     Microseconds period_microseconds_ {0};
     double rate_hz_ {0.0};
+
+    uint64_t host_ns_ {0};
+    uint32_t clock_precision_ns_ {0};
+    ClockSource clock_source_ {ClockSource::NONE};
+
+    uint64_t capture_ns_ {0};
+    uint32_t num_stamps_ {0};
+    std::array<uint64_t, MAX_STAMPS> stamps_ {{0}};
+
+    void startTrace() {
+        capture_ns_ = now_ns();
+        num_stamps_ = 0;
+        clock_source_ = ClockSource::NONE;
+        host_ns_ = 0;
+        clock_precision_ns_ = 0;
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 };
 
 }      /* namespace oat */
@@ -0,0 +1,346 @@
+"""
+Zero-copy access to Oat frame and position nodes from Python.
+
+Sources attach to nodes like any Oat component, so a script reading frames in
+synchronous mode holds back the node's sink exactly as oat-framefilt would.
+Frames are NumPy views of the node's shared memory rather than copies, and
+are only valid inside the `with source.read()` block that produced them.
+Copy them, e.g. with frame.copy(), to keep them for longer.
+
+    import oat
+
+    with oat.FrameSource('raw') as source:
+        while True:
+            with source.read() as frame:
+                print(source.sample.count, frame.mean())
+
+Positions are read as NumPy records in the layout of binary position files
+saved by oat-record. Reading stops with oat.EndOfStream once the sink leaves.
+A PositionBus reads many position streams, the channels of a bus, with a
+single wait.
+
+    with oat.PositionBus('arenas') as bus:
+        while True:
+            for name, pos in bus.read().items():
+                print(name, pos['tick'], pos['pos_xy'])
+
+Nodes are reached through liboat-shmemdf.so, which is looked for in the lib
+directory of the Oat installation unless OAT_SHMEMDF_LIB gives its path.
+"""
+
+import ast
+import collections
+import contextlib
+import ctypes
+import os
+
+import numpy as np
+
+__all__ = ['EndOfStream', 'FrameSource', 'PositionBus', 'PositionSource',
+           'Sample']
+
+
+class EndOfStream(Exception):
+    """The node's sink has left."""
+
+
+# Sample information of the last frame read
+Sample = collections.namedtuple('Sample', ['count', 'usec', 'rate_hz'])
+
+
+class _Frame(ctypes.Structure):
+    _fields_ = [('data', ctypes.c_void_p),
+                ('rows', ctypes.c_int32),
+                ('cols', ctypes.c_int32),
+                ('type', ctypes.c_int32),
+                ('color', ctypes.c_int32),
+                ('step', ctypes.c_uint64),
+                ('sample_count', ctypes.c_uint64),
+                ('sample_usec', ctypes.c_uint64),
+                ('rate_hz', ctypes.c_double)]
+
+
+# OAT_SHMEMDF_ABI_VERSION this module was written for
+_ABI_VERSION = 1
+
+
+def _load():
+    here = os.path.dirname(os.path.abspath(__file__))
+    path = os.environ.get('OAT_SHMEMDF_LIB',
+                          os.path.join(here, '..', 'lib', 'liboat-shmemdf.so'))
+    lib = ctypes.CDLL(path)
+
+    if lib.oat_abi_version() != _ABI_VERSION:
+        raise ImportError('{} has ABI version {}, expected {}.'.format(
+            path, lib.oat_abi_version(), _ABI_VERSION))
+
+    lib.oat_last_error.restype = ctypes.c_char_p
+    lib.oat_position_bytes.restype = ctypes.c_size_t
+    lib.oat_position_dtype.restype = ctypes.c_char_p
+
+    for kind in ('frame', 'position'):
+        fn = lambda name: getattr(lib, 'oat_{}_source_{}'.format(kind, name))
+        fn('open').restype = ctypes.c_void_p
+        fn('open').argtypes = [ctypes.c_char_p, ctypes.c_int]
+        fn('close').argtypes = [ctypes.c_void_p]
+        fn('wait').argtypes = [ctypes.c_void_p]
+        fn('post').argtypes = [ctypes.c_void_p]
+        fn('dropped').restype = ctypes.c_uint64
+        fn('dropped').argtypes = [ctypes.c_void_p]
+
+    lib.oat_frame_source_borrow.argtypes = [ctypes.c_void_p,
+                                            ctypes.POINTER(_Frame)]
+    lib.oat_position_source_pack.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+
+    lib.oat_position_bus_open.restype = ctypes.c_void_p
+    lib.oat_position_bus_open.argtypes = [ctypes.c_char_p]
+    lib.oat_position_bus_close.argtypes = [ctypes.c_void_p]
+    lib.oat_position_bus_name.argtypes = [ctypes.c_void_p, ctypes.c_int,
+                                          ctypes.c_char_p, ctypes.c_size_t]
+    lib.oat_position_bus_writes.restype = ctypes.c_uint64
+    lib.oat_position_bus_writes.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.oat_position_bus_generation.restype = ctypes.c_uint32
+    lib.oat_position_bus_generation.argtypes = [ctypes.c_void_p]
+    lib.oat_position_bus_wait.argtypes = [ctypes.c_void_p, ctypes.c_uint32,
+                                          ctypes.c_uint64]
+    lib.oat_position_bus_pack.argtypes = [ctypes.c_void_p, ctypes.c_int,
+                                          ctypes.c_void_p,
+                                          ctypes.POINTER(ctypes.c_uint64)]
+
+    # CTRL+C interrupts waits, then raises KeyboardInterrupt as usual
+    lib.oat_install_sigint_handler()
+
+    return lib
+
+
+_lib = _load()
+
+# OpenCV matrix depths
+_DEPTHS = [np.uint8, np.int8, np.uint16, np.int16, np.int32, np.float32,
+           np.float64]
+
+# Layout of packed positions
+_POSITION_DTYPE = np.dtype(ast.literal_eval(
+    _lib.oat_position_dtype().decode('ascii')))
+assert _POSITION_DTYPE.itemsize == _lib.oat_position_bytes()
+
+
+def _check(rc):
+    if rc < 0:
+        raise RuntimeError(_lib.oat_last_error().decode())
+    return rc
+
+
+class _Source(object):
+
+    _kind = None
+
+    def __init__(self, address, latest=False):
+        """
+        Attach to a node. Blocks until its sink binds.
+
+        address -- Name of the node, e.g. 'raw'.
+        latest -- If True, read the most recent sample instead of every
+                  sample. The sink never waits for this source, and samples
+                  that arrive while it is busy are dropped.
+        """
+        self._handle = None
+        self._fn = lambda name: getattr(
+            _lib, 'oat_{}_source_{}'.format(self._kind, name))
+        self._handle = self._fn('open')(address.encode(), int(latest))
+        if not self._handle:
+            raise RuntimeError(_lib.oat_last_error().decode())
+
+    def close(self):
+        """Detach from the node."""
+        if self._handle:
+            self._fn('close')(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def wait(self):
+        """Wait for the sink to write a sample. Must be followed by post()."""
+        _lib.oat_clear_quit()
+        rc = _check(self._fn('wait')(self._handle))
+        if rc == 1:
+            raise EndOfStream()
+        if rc == 2:
+            raise KeyboardInterrupt()
+
+    def post(self):
+        """Tell the sink that the current sample has been read."""
+        _check(self._fn('post')(self._handle))
+
+    @property
+    def dropped(self):
+        """Samples skipped by a latest-value source."""
+        return self._fn('dropped')(self._handle)
+
+
+class FrameSource(_Source):
+    """Reads frames from a frame node."""
+
+    _kind = 'frame'
+    sample = None
+
+    def borrow(self):
+        """
+        The current frame, as a read-only NumPy view of shared memory. Only
+        valid between wait() and post().
+        """
+        f = _Frame()
+        _check(_lib.oat_frame_source_borrow(self._handle, ctypes.byref(f)))
+        self.sample = Sample(f.sample_count, f.sample_usec, f.rate_hz)
+
+        dtype = np.dtype(_DEPTHS[f.type & 7])
+        channels = (f.type >> 3) + 1
+        size = (f.rows - 1) * f.step + f.cols * channels * dtype.itemsize
+        buf = (ctypes.c_char * size).from_address(f.data)
+
+        if channels == 1:
+            shape = (f.rows, f.cols)
+            strides = (f.step, dtype.itemsize)
+        else:
+            shape = (f.rows, f.cols, channels)
+            strides = (f.step, channels * dtype.itemsize, dtype.itemsize)
+
+        frame = np.ndarray(shape, dtype, buffer=buf, strides=strides)
+        frame.flags.writeable = False
+        return frame
+
+    @contextlib.contextmanager
+    def read(self):
+        """Wait for a frame and lend it for the duration of the block."""
+        self.wait()
+        try:
+            yield self.borrow()
+        finally:
+            self.post()
+
+
+class PositionSource(_Source):
+    """Reads positions from a position node."""
+
+    _kind = 'position'
+    dtype = _POSITION_DTYPE
+
+    def copy(self):
+        """The current position. Only available between wait() and post()."""
+        record = np.zeros(1, dtype=_POSITION_DTYPE)
+        _check(_lib.oat_position_source_pack(self._handle,
+                                             record.ctypes.data))
+        return record[0]
+
+    @contextlib.contextmanager
+    def read(self):
+        """Wait for a position and return it for the duration of the block."""
+        self.wait()
+        try:
+            yield self.copy()
+        finally:
+            self.post()
+
+
+class PositionBus(object):
+    """
+    Reads the channels of a position bus, each the latest position of one
+    stream, e.g. one per tracked arena. Writers never wait for the bus's
+    readers, so a reader that falls behind skips positions. The number it
+    skipped on each channel is kept in skipped.
+    """
+
+    # Channels of a bus, and the length of their names
+    capacity = 64
+    _name_len = 32
+
+    dtype = _POSITION_DTYPE
+
+    def __init__(self, name):
+        """
+        Open a bus, creating it if it does not exist.
+
+        name -- Name of the bus, e.g. 'arenas'.
+        """
+        self._handle = None
+        self._handle = _lib.oat_position_bus_open(name.encode())
+        if not self._handle:
+            raise RuntimeError(_lib.oat_last_error().decode())
+
+        self._names = [None] * self.capacity
+        self._writes = [0] * self.capacity
+        self.skipped = collections.Counter()
+
+    def close(self):
+        """Close the bus."""
+        if self._handle:
+            _lib.oat_position_bus_close(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def _name(self, i):
+        if self._names[i] is None:
+            buf = ctypes.create_string_buffer(self._name_len)
+            if _check(_lib.oat_position_bus_name(self._handle, i, buf,
+                                                 self._name_len)) > 0:
+                self._names[i] = buf.value.decode()
+        return self._names[i]
+
+    def _changed(self):
+        positions = {}
+        for i in range(self.capacity):
+            n = _lib.oat_position_bus_writes(self._handle, i)
+            if n == self._writes[i] or self._name(i) is None:
+                continue
+
+            record = np.zeros(1, dtype=_POSITION_DTYPE)
+            write = ctypes.c_uint64()
+            if _check(_lib.oat_position_bus_pack(self._handle, i,
+                                                 record.ctypes.data,
+                                                 ctypes.byref(write))) != 0:
+                continue
+
+            if self._writes[i]:
+                self.skipped[self._names[i]] += \
+                    write.value - self._writes[i] - 1
+            self._writes[i] = write.value
+            positions[self._names[i]] = record[0]
+
+        return positions
+
+    def read(self, timeout=None):
+        """
+        Wait for a write to any channel, then return a dict of the latest
+        position of each channel written since the last read, by channel
+        name. Empty if timeout, in seconds, passes first.
+        """
+        _lib.oat_clear_quit()
+        # Without a timeout, wait a second at a time
+        timeout_ns = int((1.0 if timeout is None else timeout) * 1e9)
+        while True:
+            seen = _lib.oat_position_bus_generation(self._handle)
+            positions = self._changed()
+            if positions:
+                return positions
+
+            rc = _check(_lib.oat_position_bus_wait(self._handle, seen,
+                                                   timeout_ns))
+            if rc == 2:
+                raise KeyboardInterrupt()
+            if rc == 3 and timeout is not None:
+                return {}
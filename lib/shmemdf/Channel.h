@@ -0,0 +1,207 @@
+//******************************************************************************
+//* File:   Channel.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_CHANNEL_H
+#define	OAT_CHANNEL_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+
+namespace oat {
+
+/**
+ * @brief Process-local memory that holds a node in place of its shared
+ * memory segment, for nodes whose SINK and SOURCEs are all threads of one
+ * process, e.g. stages of oat-pipeline.
+ *
+ * Nodes at addresses declared in-process are laid out exactly as they are in
+ * a segment, so Sink and Source use them unchanged, but nothing is created in
+ * /dev/shm: there is no file to open, truncate or map, and the components
+ * reading a channel share the SINK's pointers. Channels are invisible to
+ * other processes, so oat-top, oat-view and the like cannot attach to them.
+ *
+ * A channel reserves a fixed range of address space and makes it usable as
+ * it grows, so the pointers handed out before a channel grows stay valid,
+ * just as earlier mappings of a growing segment are kept.
+ */
+class Channel {
+
+public:
+
+    // Address space reserved by each channel, and so its largest size
+    static constexpr size_t RESERVE_BYTES {size_t{1} << 36};
+
+    Channel()
+    {
+        void *addr = mmap(nullptr, RESERVE_BYTES, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED)
+            throw std::runtime_error("Could not reserve memory for an "
+                    "in-process channel, " + std::string(std::strerror(errno))
+                    + ".");
+
+        base_ = static_cast<char *>(addr);
+    }
+
+    ~Channel() { munmap(base_, RESERVE_BYTES); }
+
+    // Channels own their reservation
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    char *base() const { return base_; }
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Make the first bytes of the channel usable. Channels only grow.
+     * Memory is zero filled when it is first made usable, as a new segment
+     * is.
+     * @param bytes Size of the channel.
+     */
+    void resize(const size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(resize_mutex_);
+
+        const size_t current = size_.load(std::memory_order_relaxed);
+        if (bytes <= current)
+            return;
+
+        if (bytes > RESERVE_BYTES)
+            throw std::runtime_error("In-process channels hold at most "
+                    + std::to_string(RESERVE_BYTES) + " bytes.");
+
+        if (mprotect(base_, bytes, PROT_READ | PROT_WRITE) != 0)
+            throw std::runtime_error("Could not grow an in-process channel, "
+                    + std::string(std::strerror(errno)) + ".");
+
+        size_.store(bytes, std::memory_order_release);
+    }
+
+    /**
+     * @brief Hold the nodes at an address in-process from now on. Must be
+     * called before any SINK or SOURCE of the node is made.
+     * @param address Node address.
+     */
+    static void declare(const std::string &address)
+    {
+        auto &t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.declared.insert(segmentName(address));
+    }
+
+    /**
+     * @brief Whether the segment of a node is held in-process.
+     * @param name Segment name.
+     */
+    static bool declared(const std::string &name)
+    {
+        auto &t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        return t.declared.count(name) > 0;
+    }
+
+    /**
+     * @brief Open the channel holding a segment, creating it if it does not
+     * exist.
+     * @param name Segment name.
+     * @param make Called on a channel that this call creates, before any
+     * other thread can open it, to make the node it holds.
+     */
+    static std::shared_ptr<Channel> open(const std::string &name,
+                                         const std::function<void(Channel &)> &make)
+    {
+        auto &t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+
+        auto c = t.channels.find(name);
+        if (c != t.channels.end())
+            return c->second;
+
+        auto channel = std::make_shared<Channel>();
+        make(*channel);
+        t.channels.emplace(name, channel);
+
+        return channel;
+    }
+
+    /**
+     * @brief The channel holding a segment.
+     * @param name Segment name.
+     * @return The channel, or nullptr if it does not exist.
+     */
+    static std::shared_ptr<Channel> find(const std::string &name)
+    {
+        auto &t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+
+        auto c = t.channels.find(name);
+        return c == t.channels.end() ? nullptr : c->second;
+    }
+
+    /**
+     * @brief Remove a channel's name, as removing a segment unlinks it. Its
+     * memory is released once the last component holding it lets go, and
+     * the next component to open the name makes a new channel.
+     * @param name Segment name.
+     * @return True if the channel existed.
+     */
+    static bool remove(const std::string &name)
+    {
+        auto &t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        return t.channels.erase(name) > 0;
+    }
+
+private:
+
+    char *base_ {nullptr};
+    std::atomic<size_t> size_ {0};
+    std::mutex resize_mutex_;
+
+    // Name Sink and Source give the segment of the node at an address
+    static std::string segmentName(const std::string &address)
+    {
+        return address + "_node";
+    }
+
+    struct Table {
+        std::mutex mutex;
+        std::set<std::string> declared;
+        std::map<std::string, std::shared_ptr<Channel>> channels;
+    };
+
+    static Table &table()
+    {
+        static Table t;
+        return t;
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_CHANNEL_H */
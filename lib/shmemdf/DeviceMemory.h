@@ -0,0 +1,324 @@
+//******************************************************************************
+//* File:   DeviceMemory.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_DEVICEMEMORY_H
+#define	OAT_DEVICEMEMORY_H
+
+#include <opencv2/cvconfig.h>
+
+#ifdef HAVE_CUDA
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <cuda_runtime_api.h>
+#include <opencv2/core/cuda.hpp>
+
+#include "SharedFrameHeader.h"
+
+namespace oat {
+
+static_assert(sizeof(cudaIpcMemHandle_t) == sizeof(DeviceHandle),
+              "DeviceHandle must hold a cudaIpcMemHandle_t.");
+
+/**
+ * @brief Frame buffers in GPU memory that are shared between processes using
+ * CUDA IPC memory handles. A SINK allocates the buffers and publishes their
+ * handles in its SharedFrameHeader; SOURCEs open them. CUDA cannot open a
+ * handle in the process that exported it, so buffers allocated in this
+ * process, e.g. by another stage of an oat-pipeline, are found in a process
+ * local registry instead.
+ */
+class DeviceBuffers {
+
+public:
+
+    DeviceBuffers() = default;
+    DeviceBuffers(const DeviceBuffers &) = delete;
+    DeviceBuffers &operator=(const DeviceBuffers &) = delete;
+
+    ~DeviceBuffers() { release(); }
+
+    /**
+     * @brief Allocate pitched device buffers.
+     * @param num_buffers Number of buffers.
+     * @param rows Rows per buffer.
+     * @param row_bytes Bytes of pixel data per row.
+     * @param step Set to the bytes per row, including padding.
+     * @return IPC handle to each buffer.
+     */
+    std::vector<DeviceHandle> allocate(const size_t num_buffers,
+                                       const size_t rows,
+                                       const size_t row_bytes,
+                                       size_t &step)
+    {
+        release();
+        owned_ = true;
+
+        std::vector<DeviceHandle> handles(num_buffers);
+        for (size_t i = 0; i < num_buffers; i++) {
+
+            void *ptr = nullptr;
+            check(cudaMallocPitch(&ptr, &step, row_bytes, rows),
+                  "Device frame allocation failed");
+            ptrs_.push_back(ptr);
+
+            cudaIpcMemHandle_t h;
+            check(cudaIpcGetMemHandle(&h, ptr),
+                  "Device frame handle export failed");
+            std::memcpy(handles[i].data(), &h, sizeof(h));
+
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry()[handles[i]] = ptr;
+        }
+
+        return handles;
+    }
+
+    /**
+     * @brief Open device buffers allocated by a SINK.
+     * @param header Header of the SINK's node.
+     */
+    void open(const SharedFrameHeader &header)
+    {
+        release();
+        owned_ = false;
+
+        for (size_t i = 0; i < header.num_buffers(); i++) {
+
+            const auto &handle = header.device_data(i);
+
+            {
+                std::lock_guard<std::mutex> lock(registryMutex());
+                auto local = registry().find(handle);
+                if (local != registry().end()) {
+                    ptrs_.push_back(local->second);
+                    opened_.push_back(false);
+                    continue;
+                }
+            }
+
+            cudaIpcMemHandle_t h;
+            std::memcpy(&h, handle.data(), sizeof(h));
+            void *ptr = nullptr;
+            check(cudaIpcOpenMemHandle(&ptr, h,
+                                       cudaIpcMemLazyEnablePeerAccess),
+                  "Device frame handle could not be opened");
+            ptrs_.push_back(ptr);
+            opened_.push_back(true);
+        }
+    }
+
+    /**
+     * @brief Header for a device buffer. Does not own the memory.
+     */
+    cv::cuda::GpuMat view(const size_t index,
+                          const int rows,
+                          const int cols,
+                          const int type,
+                          const size_t step) const
+    {
+        return cv::cuda::GpuMat(rows, cols, type, ptrs_[index], step);
+    }
+
+    bool empty() const { return ptrs_.empty(); }
+
+private:
+
+    std::vector<void *> ptrs_;
+    std::vector<bool> opened_;
+    bool owned_ {false};
+
+    void release()
+    {
+        for (size_t i = 0; i < ptrs_.size(); i++) {
+            if (owned_) {
+                std::lock_guard<std::mutex> lock(registryMutex());
+                for (auto it = registry().begin(); it != registry().end(); ++it)
+                    if (it->second == ptrs_[i]) {
+                        registry().erase(it);
+                        break;
+                    }
+                cudaFree(ptrs_[i]);
+            } else if (opened_[i]) {
+                cudaIpcCloseMemHandle(ptrs_[i]);
+            }
+        }
+
+        ptrs_.clear();
+        opened_.clear();
+    }
+
+    static void check(const cudaError_t err, const std::string &what)
+    {
+        if (err != cudaSuccess)
+            throw std::runtime_error(what + ": " + cudaGetErrorString(err)
+                                     + ".");
+    }
+
+    // Buffers allocated by this process, by handle
+    static std::map<DeviceHandle, void *> &registry()
+    {
+        static std::map<DeviceHandle, void *> r;
+        return r;
+    }
+
+    static std::mutex &registryMutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+};
+
+/**
+ * @brief Device views of host frames for GPUs that share physical memory with
+ * the CPU, such as those of Jetson modules. The pages of a frame, which
+ * usually lie in a node's shared memory, are registered with CUDA the first
+ * time they are seen, after which kernels read and write them in place. On
+ * discrete GPUs, or if registration fails, frames are copied as usual.
+ */
+class MappedFrames {
+
+public:
+
+    MappedFrames() = default;
+    MappedFrames(const MappedFrames &) = delete;
+    MappedFrames &operator=(const MappedFrames &) = delete;
+
+    ~MappedFrames()
+    {
+        for (const auto &r : regions_)
+            if (r.second.mapped)
+                cudaHostUnregister(r.first);
+    }
+
+    /**
+     * @brief Whether the current device can address host memory in place.
+     */
+    static bool supported()
+    {
+        static const bool s = [] {
+            int dev = 0;
+            cudaDeviceProp p;
+            if (cudaGetDevice(&dev) != cudaSuccess
+                || cudaGetDeviceProperties(&p, dev) != cudaSuccess)
+                return false;
+            return p.integrated && p.canMapHostMemory;
+        }();
+
+        return s;
+    }
+
+    /**
+     * @brief Device view of the pixels of a host frame.
+     * @param frame Host frame.
+     * @param view Set to a header of the frame's pixels if they can be
+     * mapped.
+     * @return False if the frame cannot be mapped.
+     */
+    bool map(const cv::Mat &frame, cv::cuda::GpuMat &view)
+    {
+        if (!supported() || frame.empty())
+            return false;
+
+        static const auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const auto begin
+            = reinterpret_cast<uintptr_t>(frame.datastart) & ~(page - 1);
+        const auto end
+            = (reinterpret_cast<uintptr_t>(frame.dataend) + page - 1)
+              & ~(page - 1);
+        void *base = reinterpret_cast<void *>(begin);
+
+        auto r = regions_.find(base);
+        if (r == regions_.end() || r->second.bytes < end - begin) {
+
+            // A region that grew is registered afresh
+            if (r != regions_.end() && r->second.mapped)
+                cudaHostUnregister(base);
+
+            const bool mapped = cudaHostRegister(base, end - begin,
+                                                 cudaHostRegisterMapped
+                                                 | cudaHostRegisterPortable)
+                                == cudaSuccess;
+
+            // Pages shared with a region registered before cannot be
+            // registered again, and are copied
+            if (!mapped)
+                cudaGetLastError();
+
+            auto &region = regions_[base];
+            region.bytes = end - begin;
+            region.mapped = mapped;
+            r = regions_.find(base);
+        }
+
+        void *dev = nullptr;
+        if (!r->second.mapped
+            || cudaHostGetDevicePointer(&dev, frame.data, 0) != cudaSuccess)
+            return false;
+
+        view = cv::cuda::GpuMat(frame.rows, frame.cols, frame.type(), dev,
+                                frame.step);
+        return true;
+    }
+
+    /**
+     * @brief Device view of a host frame, or a copy uploaded to upload if it
+     * cannot be mapped.
+     */
+    cv::cuda::GpuMat in(const cv::Mat &frame, cv::cuda::GpuMat &upload)
+    {
+        cv::cuda::GpuMat view;
+        if (map(frame, view))
+            return view;
+
+        upload.upload(frame);
+        return upload;
+    }
+
+private:
+
+    struct Region {
+        uintptr_t bytes {0};
+        bool mapped {false};
+    };
+
+    std::map<void *, Region> regions_;
+};
+
+/**
+ * @brief Wait for device work queued on the default stream, so that device
+ * frames can be handed to another process.
+ */
+inline void synchronizeDevice()
+{
+    cudaStreamSynchronize(0);
+}
+
+}      /* namespace oat */
+
+#endif /* HAVE_CUDA */
+#endif /* OAT_DEVICEMEMORY_H */
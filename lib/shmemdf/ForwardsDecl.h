@@ -20,15 +20,15 @@
 #ifndef OAT_FORWARDSDECL_H
 #define	OAT_FORWARDSDECL_H
 
+#include <cstddef>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/interprocess/interprocess_fwd.hpp>
-#include <boost/interprocess/managed_shared_memory.hpp>
 
 namespace oat {
 
 namespace bip = boost::interprocess;
 
-using shmem_t = bip::managed_shared_memory;
-using handle_t = bip::managed_shared_memory::handle_t;
+using handle_t = std::ptrdiff_t; //!< Byte offset into a node's segment
 using msec_t = boost::posix_time::milliseconds;
 
 } // namespace oat
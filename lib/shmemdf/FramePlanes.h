@@ -0,0 +1,325 @@
+//******************************************************************************
+//* File:   FramePlanes.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMEPLANES_H
+#define	OAT_FRAMEPLANES_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../datatypes/Color.h"
+#include "SharedFrameHeader.h"
+
+namespace oat {
+
+/**
+ * @brief Planes derived from the frames of a frame node that the node can
+ * host for its sources. Each is computed at most once per frame, by the
+ * first source that asks for it or by the sink before it publishes the
+ * frame, and read in place by the others.
+ *
+ * HALF, QUARTER and EIGHTH are the levels of a frame pyramid. Each is
+ * derived from the level above it, so that a node hosting several of them
+ * builds the pyramid in one pass.
+ */
+enum class FramePlane : uint32_t {
+    GREY = 0, //!< Intensity of BGR frames
+    HSV,      //!< HSV conversion of BGR frames
+    HALF,     //!< Frames at half resolution in each dimension
+    PLANAR,   //!< Channels of 3 channel frames, one contiguous plane each
+    QUARTER,  //!< Frames at a quarter of their resolution in each dimension
+    EIGHTH,   //!< Frames at an eighth of their resolution in each dimension
+    COUNT
+};
+
+/**
+ * @brief Filter that each level of a node's frame pyramid is halved with.
+ */
+enum class PyramidFilter : uint32_t {
+    AREA = 0, //!< Mean of each 2x2 block. Sizes are rounded down.
+    GAUSSIAN  //!< 5x5 Gaussian, then every other pixel, as cv::pyrDown. Sizes are rounded up.
+};
+
+/**
+ * @brief Highest level of a frame pyramid that nodes can host.
+ */
+static constexpr int MAX_PYRAMID_LEVELS {3};
+
+static constexpr size_t NUM_FRAME_PLANES {
+    static_cast<size_t>(FramePlane::COUNT)};
+static_assert(NUM_FRAME_PLANES <= SharedFrameHeader::MAX_PLANES,
+              "Frame nodes cannot host every plane.");
+
+inline const char *plane_str(const FramePlane plane)
+{
+    switch (plane) {
+        case FramePlane::GREY : return "grey";
+        case FramePlane::HSV : return "hsv";
+        case FramePlane::HALF : return "half";
+        case FramePlane::PLANAR : return "planar";
+        case FramePlane::QUARTER : return "quarter";
+        case FramePlane::EIGHTH : return "eighth";
+        default : return "";
+    }
+}
+
+inline PyramidFilter str_pyramid_filter(const std::string &s)
+{
+    if (s == "area")
+        return PyramidFilter::AREA;
+    if (s == "gauss")
+        return PyramidFilter::GAUSSIAN;
+
+    throw std::runtime_error("Pyramid filter must be area or gauss.");
+}
+
+/**
+ * @brief Plane holding a level of the frame pyramid, from 1 (HALF) to
+ * MAX_PYRAMID_LEVELS (EIGHTH).
+ */
+inline FramePlane pyramid_plane(const int level)
+{
+    switch (level) {
+        case 1 : return FramePlane::HALF;
+        case 2 : return FramePlane::QUARTER;
+        case 3 : return FramePlane::EIGHTH;
+        default :
+            throw std::runtime_error("Nodes host pyramid levels 1 to "
+                                     + std::to_string(MAX_PYRAMID_LEVELS)
+                                     + ".");
+    }
+}
+
+/**
+ * @brief Level of a plane in the frame pyramid, or 0 if it is not a level.
+ */
+inline int pyramid_level(const FramePlane plane)
+{
+    switch (plane) {
+        case FramePlane::HALF : return 1;
+        case FramePlane::QUARTER : return 2;
+        case FramePlane::EIGHTH : return 3;
+        default : return 0;
+    }
+}
+
+/**
+ * @brief Plane holding frames of a color converted from other frames, if
+ * there is one.
+ * @return False if no plane has frames of that color.
+ */
+inline bool plane_of(const oat::PixelColor color, FramePlane &plane)
+{
+    switch (color) {
+        case PIX_GREY : plane = FramePlane::GREY; return true;
+        case PIX_HSV : plane = FramePlane::HSV; return true;
+        default : return false;
+    }
+}
+
+/**
+ * @brief Format of a plane derived from frames of a given format, with
+ * packed rows. The PLANAR plane keeps the color of its frames but is a
+ * single channel matrix of three times their rows: all of the first
+ * channel, then the second, then the third.
+ * @param filter Filter of the node's frame pyramid, which sets the size of
+ * its levels.
+ * @return Format with zero rows if the plane cannot be derived from such
+ * frames.
+ */
+inline FrameParams planeParams(const FramePlane plane,
+                               const FrameParams &frame,
+                               const PyramidFilter filter = PyramidFilter::AREA)
+{
+    FrameParams p;
+    const bool bgr = frame.color == PIX_BGR && frame.type == CV_8UC3;
+
+    switch (plane) {
+        case FramePlane::GREY :
+            if (!bgr)
+                return p;
+            p.rows = frame.rows;
+            p.cols = frame.cols;
+            p.type = CV_8UC1;
+            p.color = PIX_GREY;
+            break;
+        case FramePlane::HSV :
+            if (!bgr)
+                return p;
+            p.rows = frame.rows;
+            p.cols = frame.cols;
+            p.type = CV_8UC3;
+            p.color = PIX_HSV;
+            break;
+        case FramePlane::HALF :
+        case FramePlane::QUARTER :
+        case FramePlane::EIGHTH : {
+            // Halving would mix the colors of a Bayer tile, and the bits of
+            // a packed mask
+            const int level = pyramid_level(plane);
+            if (oat::is_bayer(frame.color) || frame.color == PIX_MASK
+                || frame.rows < (1u << level) || frame.cols < (1u << level))
+                return p;
+            p.rows = frame.rows;
+            p.cols = frame.cols;
+            for (int i = 0; i < level; i++) {
+                const size_t up = filter == PyramidFilter::GAUSSIAN ? 1 : 0;
+                p.rows = (p.rows + up) / 2;
+                p.cols = (p.cols + up) / 2;
+            }
+            p.type = frame.type;
+            p.color = frame.color;
+            break;
+        }
+        case FramePlane::PLANAR :
+            if (frame.type != CV_8UC3 || oat::is_bayer(frame.color))
+                return p;
+            p.rows = 3 * frame.rows;
+            p.cols = frame.cols;
+            p.type = CV_8UC1;
+            p.color = frame.color;
+            break;
+        default :
+            return p;
+    }
+
+    p.step = p.cols * CV_ELEM_SIZE(p.type);
+    p.bytes = p.rows * p.step;
+
+    return p;
+}
+
+/**
+ * @brief Headers of the three channel planes of a PLANAR plane.
+ */
+inline void planarChannels(const cv::Mat &planar, cv::Mat channels[3])
+{
+    const int rows = planar.rows / 3;
+    for (int c = 0; c < 3; c++)
+        channels[c] = planar.rowRange(c * rows, (c + 1) * rows);
+}
+
+/**
+ * @brief Plane that a level of the frame pyramid is halved from.
+ * @return False if the plane derives from the frame itself.
+ */
+inline bool parent_plane(const FramePlane plane, FramePlane &parent)
+{
+    const int level = pyramid_level(plane);
+    if (level < 2)
+        return false;
+
+    parent = pyramid_plane(level - 1);
+    return true;
+}
+
+/**
+ * @brief Compute a plane into a matrix of the plane's format.
+ * @param from The frame, or for a plane that has a parent_plane(), that
+ * parent.
+ * @param filter Filter of the node's frame pyramid.
+ */
+inline void derivePlane(const FramePlane plane,
+                        const cv::Mat &from,
+                        cv::Mat &out,
+                        const PyramidFilter filter = PyramidFilter::AREA)
+{
+    switch (plane) {
+        case FramePlane::GREY :
+            cv::cvtColor(from, out, cv::COLOR_BGR2GRAY);
+            break;
+        case FramePlane::HSV :
+            cv::cvtColor(from, out, cv::COLOR_BGR2HSV);
+            break;
+        case FramePlane::HALF :
+        case FramePlane::QUARTER :
+        case FramePlane::EIGHTH :
+            if (filter == PyramidFilter::GAUSSIAN)
+                cv::pyrDown(from, out);
+            else
+                cv::resize(from, out, cv::Size(from.cols / 2, from.rows / 2),
+                           0, 0, cv::INTER_AREA);
+            break;
+        case FramePlane::PLANAR : {
+            out.create(3 * from.rows, from.cols, CV_8UC1);
+            cv::Mat channels[3];
+            planarChannels(out, channels);
+            cv::split(from, channels);
+            break;
+        }
+        default :
+            throw std::runtime_error("Invalid frame plane.");
+    }
+}
+
+/**
+ * @brief Add the pyramid levels that the levels of a plane mask derive from.
+ */
+inline uint32_t withPyramidParents(uint32_t mask)
+{
+    for (int level = MAX_PYRAMID_LEVELS; level > 1; level--)
+        if (mask & (1u << static_cast<size_t>(pyramid_plane(level))))
+            mask |= 1u << static_cast<size_t>(pyramid_plane(level - 1));
+
+    return mask;
+}
+
+/**
+ * @brief Planes that frame sinks host, as a mask of (1 << FramePlane) bits,
+ * taken from OAT_FRAME_PLANES. It holds a comma separated list of planes,
+ * e.g. "grey,hsv,half,planar". Planes that cannot be derived from a sink's
+ * frames are not hosted. A pyramid level brings the levels above it, which
+ * it is derived from.
+ */
+inline uint32_t planesFromEnvironment()
+{
+    const char *env = std::getenv("OAT_FRAME_PLANES");
+    if (env == nullptr || *env == '\0')
+        return 0;
+
+    uint32_t mask = 0;
+    std::istringstream list {env};
+    std::string name;
+    while (std::getline(list, name, ',')) {
+
+        bool found = false;
+        for (size_t i = 0; i < NUM_FRAME_PLANES; i++) {
+            if (name == plane_str(static_cast<FramePlane>(i))) {
+                mask |= 1u << i;
+                found = true;
+            }
+        }
+
+        if (!found)
+            throw std::runtime_error("OAT_FRAME_PLANES must be a comma "
+                                     "separated list of grey, hsv, half, "
+                                     "planar, quarter and eighth.");
+    }
+
+    return withPyramidParents(mask);
+}
+
+}       /* namespace oat */
+#endif	/* OAT_FRAMEPLANES_H */
@@ -0,0 +1,217 @@
+//******************************************************************************
+//* File:   FutexSemaphore.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FUTEXSEMAPHORE_H
+#define	OAT_FUTEXSEMAPHORE_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace oat {
+
+/**
+ * @brief Process-shared counting semaphore built on an atomic counter and
+ * Linux futex wait/wake. It is a drop-in replacement for
+ * bip::interprocess_semaphore when placed in shared memory. Uncontended
+ * post() and wait() calls are a single atomic operation and never enter the
+ * kernel. Waiters spin briefly before sleeping and, once asleep, are only
+ * woken by a post(), a signal or the end of their timeout. There are no
+ * other periodic wakeups.
+ */
+class FutexSemaphore {
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Futex word must be a plain 32-bit integer.");
+
+public:
+
+    // Number of try_wait() attempts before sleeping on the futex
+    static constexpr int SPIN_COUNT {128};
+
+    explicit FutexSemaphore(const unsigned int initial_count)
+    : count_(initial_count)
+    {
+        // Nothing
+    }
+
+    // Semaphores are not copyable or movable
+    FutexSemaphore(const FutexSemaphore &) = delete;
+    FutexSemaphore &operator=(const FutexSemaphore &) = delete;
+
+    /**
+     * @brief Increment the count and wake a sleeping waiter, if there is one.
+     */
+    void post()
+    {
+        count_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) > 0)
+            futex(FUTEX_WAKE, 1, nullptr);
+    }
+
+    /**
+     * @brief Decrement the count if it is positive without blocking.
+     * @return True if the count was decremented.
+     */
+    bool try_wait()
+    {
+        auto c = count_.load(std::memory_order_relaxed);
+        while (c > 0) {
+            if (count_.compare_exchange_weak(c, c - 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Block until the count can be decremented.
+     */
+    void wait()
+    {
+        while (!sleep(nullptr, false, false)) { }
+    }
+
+    /**
+     * @brief Block until the count can be decremented or a signal is
+     * delivered to the calling thread.
+     * @return True if the count was decremented. False if the wait was
+     * interrupted.
+     */
+    bool wait_interruptible() { return sleep(nullptr, false, true); }
+
+    /**
+     * @brief Block until the count can be decremented, timeout passes or a
+     * signal is delivered to the calling thread. Lets a waiter recheck a
+     * condition, e.g. quit, that no post() or signal reports.
+     * @param timeout Longest time to sleep.
+     * @return True if the count was decremented.
+     */
+    bool wait_for(const std::chrono::nanoseconds timeout)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        const auto ns = deadline.tv_nsec + timeout.count();
+        deadline.tv_sec += ns / 1000000000;
+        deadline.tv_nsec = ns % 1000000000;
+
+        return sleep(&deadline, false, true);
+    }
+
+    /**
+     * @brief Block until the count can be decremented or abs_time passes.
+     * @param abs_time Absolute UTC deadline.
+     * @return True if the count was decremented before the deadline.
+     */
+    bool timed_wait(const boost::posix_time::ptime &abs_time)
+    {
+        static const boost::posix_time::ptime epoch(
+            boost::gregorian::date(1970, 1, 1));
+
+        auto since_epoch = abs_time - epoch;
+        struct timespec deadline;
+        deadline.tv_sec = since_epoch.total_seconds();
+        deadline.tv_nsec = (since_epoch.total_microseconds()
+                            - deadline.tv_sec * 1000000) * 1000;
+
+        return sleep(&deadline, true, false);
+    }
+
+private:
+
+    std::atomic<uint32_t> count_;
+    std::atomic<uint32_t> waiters_ {0};
+
+    // deadline is an absolute CLOCK_REALTIME time if realtime, else an
+    // absolute CLOCK_MONOTONIC time, or nullptr to wait forever
+    bool sleep(const struct timespec *deadline,
+               bool realtime,
+               bool interruptible)
+    {
+        for (int i = 0; i < SPIN_COUNT; i++) {
+            if (try_wait())
+                return true;
+            relax();
+        }
+
+        while (true) {
+
+            // Announce ourselves before the final check so that a post()
+            // between the check and the futex call cannot be missed
+            waiters_.fetch_add(1, std::memory_order_seq_cst);
+            if (try_wait()) {
+                waiters_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            const int clock = realtime ? FUTEX_CLOCK_REALTIME : 0;
+            auto rc = deadline == nullptr
+                ? futex(FUTEX_WAIT, 0, nullptr)
+                : futex(FUTEX_WAIT_BITSET | clock, 0, deadline);
+            auto err = errno;
+
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+
+            if (rc == -1 && err == ETIMEDOUT)
+                return try_wait();
+
+            if (rc == -1 && err == EINTR && interruptible)
+                return try_wait();
+
+            // Woken, spurious wakeup, or the count changed before we slept
+            if (try_wait())
+                return true;
+        }
+    }
+
+    long futex(const int op, const uint32_t val, const struct timespec *ts)
+    {
+        // NOTE: No FUTEX_PRIVATE_FLAG because the word is shared between
+        // processes
+        return syscall(SYS_futex,
+                       reinterpret_cast<uint32_t *>(&count_),
+                       op,
+                       val,
+                       ts,
+                       nullptr,
+                       FUTEX_BITSET_MATCH_ANY);
+    }
+
+    static void relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_FUTEXSEMAPHORE_H */
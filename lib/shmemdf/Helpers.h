@@ -24,97 +24,171 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <memory>
+#include <vector>
 
-#include "../utility/in_place.h"
 #include "../utility/make_unique.h"
 
 namespace oat {
 
-/**
- * @brief Maybe useful for tagging the T in source<T>. Not implemented.
- */
-enum class TokenType : int {
-    Any = -1,
-    Frame,
-    Position
-};
+// Shared object type of GenericSource, which reads nodes of any type
+struct AnyToken { };
 
 /**
- * @brief Type erased source. Not yet used.
+ * @brief Source of a node of any type. The token type and location of each
+ * sample are read from the layout that the node's SINK records, so tools that
+ * move or inspect samples without interpreting them, such as recorders,
+ * bridges and checkers, need not be built for each type. Finding a sample
+ * is address arithmetic on the layout, without virtual dispatch.
  */
-class GenericSource {
-
+class GenericSource : public SourceBase<AnyToken> {
 public:
 
-    template <typename T>
-    GenericSource(oat::in_place<T>)
-    : source(std::make_shared<SourceModel<T>>()) { }
+    /**
+     * @brief Bytes of a sample record in shared memory.
+     */
+    struct Record {
+        const void *data {nullptr};
+        size_t bytes {0};
+    };
 
-    void touch(const std::string &addr) const { source->touch(addr); }
-    void connect(void) const { source->connect(); }
-    NodeState wait(void) const { return source->wait(); }
-    void post(void) const { source->post(); }
-    uint64_t write_number(void) const { return source->write_number(); }
-    void * retrieve(void) const { return source->retrieve(); }
-    double sample_period_sec(void) const { return source->sample_period_sec(); }
+    SourceState connect(void) override;
 
-private:
+    TokenType type() const { return layout_.type; }
+    const NodeLayout &layout() const { return layout_; }
 
-    struct SourceConcept {
-        virtual ~SourceConcept() { }
-        virtual void touch(const std::string &addr) = 0;
-        virtual void connect(void) = 0;
-        virtual NodeState wait(void) = 0;
-        virtual void post(void) = 0;
-        virtual uint64_t write_number(void) const = 0;
-        virtual void * retrieve(void) const = 0;
-        virtual double sample_period_sec(void) const = 0;
-    };
+    /**
+     * @brief Get the record that this source must read during the current
+     * critical section. In LATEST mode, this is the latest completed record,
+     * which is not protected from being overwritten.
+     */
+    Record record() const;
 
-    template <typename T>
-    struct SourceModel : SourceConcept {
-        SourceModel() : source() { }
-        void touch(const std::string &addr) override { source.touch(addr); }
-        void connect(void) override { source.connect(); }
-        NodeState wait(void) override { return source.wait();}
-        void post(void) override { source.post(); }
-        uint64_t write_number() const override { return source.write_number(); }
-        void * retrieve() const override { return (void *)(source.retrieve()); }
-        double sample_period_sec() const override
-            { return source.retrieve()->sample().period_sec().count();}
-
-    private:
-        T source;
-    };
+    /**
+     * @brief Copy the record read during the current critical section. In
+     * LATEST mode, the latest completed record is copied, again if the sink
+     * overwrote it during the copy.
+     * @param dst Destination, resized to the record.
+     */
+    void copyRecord(std::vector<char> &dst) const;
 
-    std::shared_ptr<SourceConcept> source;
-};
+    /**
+     * @brief Copy the sample of the record read during the current critical
+     * section, as copyRecord() copies the record.
+     */
+    oat::Sample sample() const;
 
-/**
- * @brief Generic source package containing address, totken type and source.
- * Not used and probably not very useful -- token type should be retrieabel
- * from source without knowing anything about it except its address.
- */
-struct TaggedSource {
-
-    template <typename T>
-    TaggedSource(const oat::TokenType source_type,
-                 const std::string &source_addr,
-                 oat::in_place<T>)
-    : type(source_type)
-    , addr(source_addr)
-    , source(oat::in_place<T>())
+private:
+
+    NodeLayout layout_;
+    const char *object_ {nullptr};
+
+    // Buffer read in SYNC mode, or latest completed in LATEST mode
+    size_t index() const
     {
-        // Nothing
+        if (mode_ == SourceMode::SYNC)
+            return node_->read_index(slot_index_);
+
+        const uint64_t done = node_->write_number();
+        return (done == 0 ? 0 : done - 1) % node_->num_buffers();
     }
 
-    const oat::TokenType type {oat::TokenType::Any};
-    const std::string addr;
-    oat::GenericSource source;
+    Record at(const NodeLayout::Span &span, const size_t index) const;
 };
 
+inline SourceState GenericSource::connect()
+{
+    if (state_ != SourceState::TOUCHED)
+        throw std::runtime_error("A source can only connect() after it has "
+                                 "touch()ed a node.");
+
+    if (!waitForSink())
+        return SourceState::ERR_CONNECT;
+
+    prefault_ = MemoryPolicy::fromEnvironment().prefault;
+    object_ = static_cast<const char *>(segment_.connectAny(prefault_));
+    node_ = segment_.node();
+    layout_ = segment_.info().node_layout;
+
+    if (layout_.flags & NodeLayout::VIEW) {
+        state_ = SourceState::ERR_TYPEMIS;
+        throw std::runtime_error("Node '" + address_ + "' is a view. Its "
+                                 "samples are read from its parent node.");
+    }
+
+    state_ = SourceState::CONNECTED;
+    return SourceState::CONNECTED;
+}
+
+inline GenericSource::Record GenericSource::at(const NodeLayout::Span &span,
+                                               const size_t index) const
+{
+    Record r;
+    r.data = object_ + span.offset + index * span.stride;
+    r.bytes = span.bytes;
+
+    if (span.sized)
+        r.bytes = *reinterpret_cast<const size_t *>(
+            object_ + span.size_offset + index * span.size_stride);
+
+    if (span.indirect) {
+
+        // Records may be in payload added since the last mapping
+        segment_.update(prefault_);
+        r.data = segment_.address(*static_cast<const handle_t *>(r.data));
+    }
+
+    return r;
+}
+
+inline GenericSource::Record GenericSource::record() const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (state_ < SourceState::CONNECTED)
+        throw (std::runtime_error("Source must be connected before a record "
+                                  "is retrieved."));
+#endif
+
+    return at(layout_.record, index());
+}
+
+inline void GenericSource::copyRecord(std::vector<char> &dst) const
+{
+    auto copy = [&](size_t i) {
+        const auto r = at(layout_.record, i);
+        dst.resize(r.bytes);
+        std::memcpy(dst.data(), r.data, r.bytes);
+    };
+
+    if (mode_ == SourceMode::SYNC)
+        copy(index());
+    else
+        readLatest(copy, node_->num_buffers());
+}
+
+inline oat::Sample GenericSource::sample() const
+{
+    if (layout_.sample.bytes != sizeof(oat::Sample))
+        throw std::runtime_error("Tokens of node '" + address_ + "' carry "
+                                 "no sample.");
+
+    oat::Sample sample;
+    auto copy = [&](size_t i) {
+        sample = *static_cast<const oat::Sample *>(at(layout_.sample, i).data);
+    };
+
+    if (mode_ == SourceMode::SYNC)
+        copy(index());
+    else
+        readLatest(copy, node_->num_buffers());
+
+    return sample;
+}
+
 template<typename T>
 struct NamedSource {
 
@@ -133,6 +207,97 @@ struct NamedSource {
 template<typename T>
 using NamedSourceList = std::vector<NamedSource<T>>;
 
+/**
+ * @brief Wait on every source in a list at once and copy out a sample from
+ * each. Sources that are ready are read, in whatever order they become
+ * ready, and each is posted as soon as its sample has been copied. The call
+ * only blocks when none of the remaining sources are ready. With futex
+ * synchronization it then sleeps until any of them is written, and
+ * otherwise on one outstanding source at a time. Fan-in latency is
+ * therefore that of the slowest source rather than the sum of each source's
+ * wait.
+ * @param sources Sources to read.
+ * @param samples Copied samples, in the same order as sources. Must be the
+ * same size as sources.
+ * @return NodeState::END if any of the sources' sinks has left, in which
+ * case samples are incomplete. The sink state of the last source read
+ * otherwise.
+ */
+template<typename T>
+inline NodeState waitAll(NamedSourceList<T> &sources, std::vector<T> &samples)
+{
+    assert(samples.size() == sources.size());
+
+    std::vector<bool> done(sources.size(), false);
+    size_t remaining = sources.size();
+    NodeState state = NodeState::SINK_BOUND;
+
+#ifdef USE_FUTEX
+    // Longest sleep before quit is checked again
+    const std::chrono::nanoseconds check_period = std::chrono::milliseconds(100);
+
+    std::vector<SampleEvent *> events;
+    std::vector<uint32_t> seen;
+#endif
+
+    while (remaining > 0) {
+
+#ifdef USE_FUTEX
+        // Generations are taken before the sources are checked, so that a
+        // write made after a check ends the sleep below
+        events.clear();
+        seen.clear();
+        for (size_t i = 0; i < sources.size(); i++) {
+            if (!done[i]) {
+                events.push_back(&sources[i].source->sample_event());
+                seen.push_back(events.back()->generation());
+            }
+        }
+#endif
+
+        // Read whatever is ready without blocking
+        for (size_t i = 0; i < sources.size(); i++) {
+
+            if (done[i] || !sources[i].source->tryWait(state))
+                continue;
+
+            if (state == NodeState::END)
+                return state;
+
+            samples[i] = sources[i].source->clone();
+            sources[i].source->post();
+            done[i] = true;
+            remaining--;
+        }
+
+        if (remaining == 0)
+            break;
+
+#ifdef USE_FUTEX
+        // Sleep until any outstanding source's node is written
+        if (quit)
+            return NodeState::END;
+        SampleEvent::waitAny(events.data(), seen.data(), events.size(),
+                             check_period);
+#else
+        // Nothing left is ready, so block on the first outstanding source
+        auto i = static_cast<size_t>(
+            std::find(done.begin(), done.end(), false) - done.begin());
+
+        state = sources[i].source->wait();
+        if (state == NodeState::END)
+            return state;
+
+        samples[i] = sources[i].source->clone();
+        sources[i].source->post();
+        done[i] = true;
+        remaining--;
+#endif
+    }
+
+    return state;
+}
+
 /**
  * @brief Check if a set of sample periods is consistent.
  * @param periods_sec Sample periods in seconds.
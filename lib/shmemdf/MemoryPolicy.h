@@ -0,0 +1,169 @@
+//******************************************************************************
+//* File:   MemoryPolicy.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_MEMORYPOLICY_H
+#define	OAT_MEMORYPOLICY_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace oat {
+
+/**
+ * @brief Page placement policy for shared frame segments.
+ *
+ * Segments live in /dev/shm, so huge pages are transparent huge pages on
+ * tmpfs. They are only granted when
+ * /sys/kernel/mm/transparent_hugepage/shmem_enabled is "advise" or "always".
+ * NUMA placement binds the segment's pages to a single node. Shared memory
+ * policy belongs to the segment, so it also holds for sources that map it
+ * later.
+ */
+struct MemoryPolicy {
+
+    // Size of a transparent huge page on x86_64 and aarch64 with 4 KB pages
+    static constexpr size_t HUGE_PAGE_SIZE {2 * 1024 * 1024};
+
+    // Alignment of shared frame data blocks and of padded rows
+    static constexpr size_t DATA_ALIGNMENT {64};
+
+    bool huge_pages {false}; //!< Advise the kernel to back with huge pages
+    bool prefault {false};   //!< Fault in every page when the segment is
+                             //!< made, and when sources map it
+    int numa_node {-1};      //!< NUMA node to bind pages to, or -1 for any
+    bool pad_rows {false};   //!< Pad frame rows to DATA_ALIGNMENT bytes
+
+    /**
+     * @brief Read the policy from the environment. OAT_HUGE_PAGES and
+     * OAT_PREFAULT enable the corresponding options when set to 1.
+     * OAT_NUMA_NODE selects a NUMA node. OAT_PAD_ROWS=1 pads each frame row
+     * to a multiple of DATA_ALIGNMENT bytes.
+     */
+    static MemoryPolicy fromEnvironment()
+    {
+        MemoryPolicy p;
+        p.huge_pages = flag("OAT_HUGE_PAGES");
+        p.prefault = flag("OAT_PREFAULT");
+        p.pad_rows = flag("OAT_PAD_ROWS");
+
+        const char *node = std::getenv("OAT_NUMA_NODE");
+        if (node != nullptr && *node != '\0') {
+            char *end;
+            auto value = std::strtol(node, &end, 10);
+            if (*end != '\0' || value < 0 || value >= 1024)
+                throw std::runtime_error("OAT_NUMA_NODE must be a NUMA node "
+                                         "number.");
+            p.numa_node = static_cast<int>(value);
+        }
+
+        return p;
+    }
+
+    /**
+     * @brief Size of the segment to create in order to hold the requested
+     * number of bytes. Segments that use huge pages are rounded up to a
+     * whole number of huge pages.
+     */
+    size_t segmentBytes(const size_t bytes) const
+    {
+        if (!huge_pages)
+            return bytes;
+
+        return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    /**
+     * @brief Bytes to reserve for a frame data block holding the given
+     * number of packed pixel bytes. When rows are padded, up to an eighth
+     * extra is reserved for the padding.
+     */
+    size_t blockBytes(const size_t bytes) const
+    {
+        return pad_rows ? bytes + bytes / 8 : bytes;
+    }
+
+    /**
+     * @brief Row stride for rows of row_bytes packed bytes.
+     */
+    size_t rowStep(const size_t row_bytes) const
+    {
+        if (!pad_rows)
+            return row_bytes;
+
+        return (row_bytes + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    }
+
+    /**
+     * @brief Apply the policy to a mapped segment. Must be called by the
+     * segment's creator before any other process uses it.
+     * @param addr Page aligned start of the mapping.
+     * @param bytes Length of the mapping.
+     */
+    void apply(void *addr, const size_t bytes) const
+    {
+        if (huge_pages && madvise(addr, bytes, MADV_HUGEPAGE) != 0)
+            throw std::runtime_error("Huge pages were requested but could not "
+                    "be enabled, " + std::string(std::strerror(errno))
+                    + ". Check that transparent huge pages are enabled for "
+                    "shared memory.");
+
+        if (numa_node >= 0) {
+
+            // Enough words to hold a bit for each of 1024 nodes
+            unsigned long mask[1024 / (8 * sizeof(unsigned long))] {};
+            mask[numa_node / (8 * sizeof(unsigned long))]
+                |= 1UL << (numa_node % (8 * sizeof(unsigned long)));
+
+            if (syscall(SYS_mbind, addr, bytes, MPOL_BIND, mask,
+                        sizeof(mask) * 8, MPOL_MF_MOVE) != 0)
+                throw std::runtime_error("Could not bind shared memory to "
+                        "NUMA node " + std::to_string(numa_node) + ", "
+                        + std::string(std::strerror(errno)) + ".");
+        }
+
+        if (prefault) {
+
+            // Touch each page without altering the segment's contents
+            const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            auto p = static_cast<volatile char *>(addr);
+            for (size_t i = 0; i < bytes; i += page)
+                p[i] = p[i];
+        }
+    }
+
+private:
+
+    static bool flag(const char *name)
+    {
+        const char *val = std::getenv(name);
+        return val != nullptr && std::strcmp(val, "1") == 0;
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_MEMORYPOLICY_H */
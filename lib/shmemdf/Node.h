@@ -20,14 +20,31 @@
 #ifndef OAT_NODE_H
 #define	OAT_NODE_H
 
+#include "OatConfig.h" // Generated by CMake
+
 #include <iostream>
+#include <algorithm>
 #include <array>
 #include <atomic>
-#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
+#include <boost/interprocess/offset_ptr.hpp>
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
 
 #include "ForwardsDecl.h"
+#include "ProcessId.h"
+#include "SampleEvent.h"
+#include "StateEvent.h"
+#include "Telemetry.h"
+#ifdef USE_FUTEX
+#include "FutexSemaphore.h"
+#endif
 
 namespace oat {
 
@@ -41,46 +58,237 @@ enum class NodeState {
 class Node {
 public:
 
+#ifdef USE_FUTEX
+    using semaphore = oat::FutexSemaphore;
+#else
     using semaphore = bip::interprocess_semaphore;
-
-    Node()
+#endif
+
+    // Reader records are padded to this many bytes so that sources sharing a
+    // node never contend for the same cache line
+    static constexpr size_t CACHE_LINE_SIZE {64};
+
+    // Number of SOURCE slots a node is created with when OAT_MAX_SOURCES is
+    // not set, and the largest number that can be requested
+    static constexpr size_t DEFAULT_MAX_SOURCES {32};
+    static constexpr size_t MAX_SOURCES_LIMIT {1024};
+
+    /**
+     * @brief Per-SOURCE synchronization state. Stored contiguously in the
+     * node's shared memory segment, one cache line (or more) per SOURCE.
+     */
+    struct alignas(CACHE_LINE_SIZE) Reader {
+        semaphore read_barrier {0};
+        uint64_t read_number {0}; //!< Read cursor
+        bool bound {false};
+        bool best_effort {false}; //!< The sink does not wait for this SOURCE
+        std::atomic<uint64_t> dropped {0}; //!< Writes a best-effort SOURCE skipped
+        LatencyHistogram read_hold; //!< Time between wait() and post()
+        ProcessId owner; //!< Process that acquired the slot
+    };
+
+    // SINKs that can share a merge node
+    static constexpr size_t MAX_PRODUCERS {16};
+
+    /**
+     * @brief Per-SINK ordering state of a merge node.
+     */
+    struct Producer {
+        bool bound {false};
+        bool pending {false}; //!< Sample count offered, waiting for or holding the turn
+        uint64_t count {0}; //!< Sample count last offered
+        ProcessId owner; //!< Process that joined
+    };
+
+    // Outcome of asking for the write turn of a merge node
+    enum class Turn {
+        GRANTED, //!< The offered sample may be written now
+        WAIT,    //!< Another SINK may still publish an earlier sample
+        STALE    //!< A later sample was already published. Drop this one.
+    };
+
+    /**
+     * @brief Construct a node with a reader table holding max_sources
+     * SOURCEs. The table is placed directly after the node, which must be
+     * constructed in at least bytes(max_sources) of memory.
+     * @param max_sources Capacity of the reader table.
+     */
+    explicit Node(const size_t max_sources)
+    : max_sources_(max_sources)
     {
-        source_slots_.reset();
-        source_read_required_.reset();
+        if (max_sources_ == 0 || max_sources_ > MAX_SOURCES_LIMIT)
+            throw std::runtime_error("Node source capacity must be between 1 "
+                    "and " + std::to_string(MAX_SOURCES_LIMIT) + ".");
+
+        auto end = reinterpret_cast<uintptr_t>(this + 1);
+        auto table = reinterpret_cast<Reader *>(
+                (end + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+        for (size_t i = 0; i < max_sources_; i++)
+            new (table + i) Reader();
+        readers_ = table;
+
+        reads_remaining_.fill(0);
     }
 
-    // Nodes are movable
-    Node(Node&&) = default;
-    Node & operator=(Node&&) = default;
-
-    // Nodes are not copyable
+    // Nodes are neither copyable nor movable because their reader table
+    // follows them in memory
     Node(const Node &) = delete;
     Node & operator=(const Node &) = delete;
 
+    /**
+     * @brief Source capacity used when creating a node. Taken from the
+     * OAT_MAX_SOURCES environment variable, if it is set, so that the limit
+     * can be raised without recompiling. All components sharing a node
+     * should agree on it, but only the value seen by the component that
+     * creates the node matters.
+     */
+    static size_t default_max_sources()
+    {
+        const char *env = std::getenv("OAT_MAX_SOURCES");
+        if (env == nullptr || *env == '\0')
+            return DEFAULT_MAX_SOURCES;
+
+        char *end;
+        auto value = std::strtoul(env, &end, 10);
+        if (*end != '\0' || value == 0 || value > MAX_SOURCES_LIMIT)
+            throw std::runtime_error("OAT_MAX_SOURCES must be an integer "
+                    "between 1 and " + std::to_string(MAX_SOURCES_LIMIT) + ".");
+
+        return value;
+    }
+
+    /**
+     * @brief Bytes of memory required to hold a node and its reader table.
+     * @param max_sources Capacity of the reader table.
+     */
+    static size_t bytes(const size_t max_sources)
+    {
+        // Alignment of the table can waste up to a cache line
+        return sizeof(Node) + CACHE_LINE_SIZE + max_sources * sizeof(Reader);
+    }
+
     // SINK state
-    void set_sink_state(NodeState value) { sink_state_ = value; }
+    void set_sink_state(NodeState value)
+    {
+        sink_state_ = value;
+        state_event_.notify();
+        sample_event_.notify();
+
+        // Wake all sources so that they see that the sink has left
+        if (value == NodeState::END)
+            wakeSources();
+    }
     NodeState sink_state(void) const { return sink_state_; }
 
-    // SINK writes (~sample number)
-    // TODO: write_number_ being atomic is redundant because only one sink can
-    //       be bound to a node, right?
+    // Advanced by each change of SINK state and each SOURCE that arrives or
+    // leaves, so that sources and launchers waiting for the node to become
+    // ready can sleep instead of polling it. Take state_generation(), check
+    // the node, then pass the generation to awaitStateChange().
+    uint32_t state_generation(void) const { return state_event_.generation(); }
+
+    bool awaitStateChange(const uint32_t seen,
+                          const std::chrono::nanoseconds timeout) const
+    {
+        return state_event_.wait(seen, timeout);
+    }
+
+    // Advanced by each SINK write, change of SINK state and write that every
+    // SOURCE has finished reading, so that a thread reading or writing
+    // several nodes can sleep until any of them has a sample or a buffer
+    SampleEvent &sample_event(void) { return sample_event_; }
+
+    // Post the read barrier of every bound SOURCE without writing, e.g. so
+    // that sources waiting on a node that is never written see a change of
+    // SINK state
+    void wakeSources()
+    {
+        mutex_.wait();
+        for (size_t i = 0; i < max_sources_; i++)
+            if (readers_[i].bound)
+                readers_[i].read_barrier.post();
+        mutex_.post();
+    }
+
+    // SINK writes (~sample number). Atomic because latest-value sources read
+    // it without taking part in synchronization.
     uint64_t write_number() const { return write_number_; }
 
-    void notifySinkWriteComplete()
+    // SINK writes that have been started, including one that is in progress.
+    // Latest-value sources compare this to write_number() to detect reads
+    // that raced with a write, seqlock style.
+    uint64_t writes_started() const { return writes_started_; }
+
+    void notifySinkWriteStart()
     {
+        ++writes_started_;
+
+        // Shared object writes must not be seen before the increment
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // SINK ring buffer depth. Writes are made round-robin to this many shared
+    // objects so that sources may lag the sink by up to num_buffers() - 1
+    // writes without blocking it.
+    static constexpr size_t MAX_BUFFERS {8};
+    size_t num_buffers(void) const { return num_buffers_; }
+
+    void set_num_buffers(const size_t value)
+    {
+        if (value == 0 || value > MAX_BUFFERS)
+            throw std::runtime_error("Number of node buffers must be between 1 "
+                                     "and " + std::to_string(MAX_BUFFERS) + ".");
+
         mutex_.wait();
 
-        // Require one read from all connected sources
-        source_read_required_ = source_slots_;
+        if (write_number_ > 0 || value < num_buffers_) {
+            mutex_.post();
+            throw std::runtime_error("Node buffers can only be added before "
+                                     "the first write.");
+        }
 
-        // Tell each source connected to the node that it may read
-        for (size_t i = 0; i < source_slots_.size(); i++)
-            if (source_slots_[i])
-                read_barrier(i).post();
+        // Each additional buffer is a free write that the sink can make
+        // before it must wait for sources to read
+        for (size_t i = num_buffers_; i < value; i++)
+            write_barrier.post();
+
+        num_buffers_ = value;
+
+        mutex_.post();
+    }
+
+    // Index of the buffer that the SINK is currently writing to
+    size_t write_index() const { return write_number_ % num_buffers_; }
+
+    // Index of the buffer that a SOURCE is currently reading from
+    size_t read_index(size_t index) const
+    {
+        return reader(index).read_number % num_buffers_;
+    }
+
+    // SOURCE reads (~sample number)
+    uint64_t read_number(size_t index) const
+    {
+        return reader(index).read_number;
+    }
+
+    void notifySinkWriteComplete()
+    {
+        mutex_.wait();
 
+        // Require one read of this buffer from all sources the sink waits for
+        reads_remaining_[write_index()] = sync_ref_count_;
+
+        // Best-effort sources wake to a write number that already includes
+        // this write
         ++write_number_;
 
+        // Tell each source connected to the node that it may read
+        for (size_t i = 0; i < max_sources_; i++)
+            if (readers_[i].bound)
+                readers_[i].read_barrier.post();
+
         mutex_.post();
+        sample_event_.notify();
     }
 
     // SOURCE read counting
@@ -88,99 +296,505 @@ public:
     {
         mutex_.wait();
 
-        source_read_required_[index] = false;
-        bool reads_finished = source_read_required_.none();
+        auto &remaining = reads_remaining_[read_index(index)];
+        if (remaining > 0)
+            --remaining;
+        ++readers_[index].read_number;
+        bool reads_finished = remaining == 0;
 
         mutex_.post();
 
+        // The SINK may now be writable
+        if (reads_finished)
+            sample_event_.notify();
+
         return reads_finished;
     }
 
-    // SOURCE slots
-    static constexpr size_t NUM_SLOTS {10};
+    // Readiness hints for schedulers that multiplex components over a few
+    // threads. Taken without the mutex, so they may be stale by the time
+    // the caller acts on them.
 
-    int acquireSlot(size_t &index)
+    // A SYNC SOURCE has an unread write, or the SINK has left
+    bool readable(size_t index) const
     {
+        return write_number_ > readers_[index].read_number
+               || sink_state_ == NodeState::END;
+    }
+
+    // The SINK has a buffer that every SYNC SOURCE has finished reading
+    bool writable(void) const
+    {
+        for (size_t i = 0; i < max_sources_; i++) {
+            const auto &r = readers_[i];
+            if (r.bound && !r.best_effort
+                && write_number_ - r.read_number >= num_buffers_)
+                return false;
+        }
+
+        return true;
+    }
+
+    // SOURCE slots
+    size_t max_sources(void) const { return max_sources_; }
+
+    /**
+     * @brief Bind a SOURCE to a free slot of the reader table.
+     * @param index Index of the slot.
+     * @param best_effort If true, the sink never waits for this SOURCE to
+     * read. It is still woken by each write.
+     * @return 0 on success, -1 if the table is full.
+     */
+    int acquireSlot(size_t &index, const bool best_effort = false)
+    {
+        const auto owner = ProcessId::self();
+
         mutex_.wait();
 
-        if (source_slots_.all()) {
+        if (source_ref_count_ == max_sources_) {
             mutex_.post();
             return -1;
         }
 
         index = 0;
-        while (source_slots_[index])
+        while (readers_[index].bound)
             ++index;
 
-        source_slots_[index] = true;
-        source_ref_count_ = source_slots_.count();
+        // New sources start reading at the next write
+        readers_[index].bound = true;
+        readers_[index].best_effort = best_effort;
+        readers_[index].read_number = write_number_;
+        readers_[index].dropped = 0;
+        readers_[index].owner = owner;
+        ++source_ref_count_;
+        if (!best_effort)
+            ++sync_ref_count_;
 
         mutex_.post();
+        state_event_.notify();
 
         return 0;
     }
 
     int releaseSlot(size_t index)
     {
-        if (index >= source_slots_.size())
+        if (index >= max_sources_)
             return -1;
 
         mutex_.wait();
-        source_slots_[index] = false;
-        source_ref_count_ = source_slots_.count();
+
+        const bool bound = readers_[index].bound;
+        if (bound)
+            releaseLocked(index);
+
         mutex_.post();
 
+        if (bound)
+            state_event_.notify();
+
         return 0;
     }
 
+    /**
+     * @brief Release the slots of SOURCEs whose processes have exited
+     * without releasing them, e.g. because they crashed. Otherwise the SINK
+     * would wait forever for their reads, and the node would never be
+     * deallocated.
+     * @return Number of slots released.
+     */
+    size_t releaseDeadSources()
+    {
+        // Owners are checked outside of the lock since it takes system calls
+        std::vector<std::pair<size_t, ProcessId>> owners;
+        mutex_.wait();
+        for (size_t i = 0; i < max_sources_; i++)
+            if (readers_[i].bound)
+                owners.emplace_back(i, readers_[i].owner);
+        mutex_.post();
+
+        size_t released = 0;
+        for (const auto &o : owners) {
+
+            if (o.second.alive())
+                continue;
+
+            // The slot may have been released and taken again meanwhile
+            mutex_.wait();
+            const auto &r = readers_[o.first];
+            if (r.bound && r.owner.pid == o.second.pid
+                && r.owner.start == o.second.start) {
+                releaseLocked(o.first);
+                released++;
+            }
+            mutex_.post();
+        }
+
+        if (released > 0)
+            state_event_.notify();
+
+        return released;
+    }
+
     size_t source_ref_count(void) const { return source_ref_count_; }
 
+    // Number of SOURCEs the sink waits for. Best-effort SOURCEs hold a slot,
+    // but are not counted.
+    size_t sync_ref_count(void) const { return sync_ref_count_; }
+
+    bool best_effort(size_t index) const
+    {
+        return slot_bound(index) && readers_[index].best_effort;
+    }
+
+    // Process that acquired a bound slot
+    ProcessId owner(size_t index) const { return reader(index).owner; }
+
+    // Writes skipped by a best-effort SOURCE because it was busy when they
+    // were made
+    void recordDrops(size_t index, const uint64_t count)
+    {
+        reader(index).dropped.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    uint64_t dropped(size_t index) const
+    {
+        if (index >= max_sources_)
+            throw std::runtime_error("Requested index is outside of the "
+                                     "reader table.");
+
+        return readers_[index].dropped.load(std::memory_order_relaxed);
+    }
+
+    // Merge nodes. Several SINKs, each holding a producer slot, publish
+    // samples tagged with their Sample::count(). Writes are made in count
+    // order, so sources read one ordered stream just as from a single SINK.
+    // A SINK holding a count waits for any other SINK whose last offered
+    // count is lower, since it may still publish a sample in between, unless
+    // that SINK lags by more than the reorder window. Samples it then offers
+    // that are older than one already written are dropped.
+    bool merge(void) const { return merge_; }
+    uint64_t reorder_window(void) const { return reorder_window_; }
+    size_t producer_count(void) const { return producer_count_; }
+
+    // Samples dropped because they arrived after the reorder window closed
+    uint64_t merge_dropped(void) const { return merge_dropped_; }
+
+    /**
+     * @brief Join the node as one of its SINKs. The first SINK to join a node
+     * that is not yet bound makes it a merge node with the given reorder
+     * window. Others may only join a merge node, and their window is ignored.
+     * @param index Index of the producer slot.
+     * @param window Samples by which the counts of SINKs may lag the count
+     * being written before they are no longer waited for.
+     * @return 0 on success, -1 if the node is not a merge node or has no free
+     * producer slot.
+     */
+    int joinProducer(size_t &index, const uint64_t window)
+    {
+        const auto owner = ProcessId::self();
+
+        mutex_.wait();
+
+        if (producer_count_ == 0 && sink_state_ == NodeState::UNDEFINED) {
+            merge_ = true;
+            reorder_window_ = window;
+        }
+
+        if (!merge_ || producer_count_ == MAX_PRODUCERS) {
+            mutex_.post();
+            return -1;
+        }
+
+        index = 0;
+        while (producers_[index].bound)
+            ++index;
+
+        // New SINKs hold back others until they have offered a sample of
+        // their own, or until the window passes them by
+        auto &p = producers_[index];
+        p.bound = true;
+        p.pending = false;
+        p.count = last_merged_;
+        p.owner = owner;
+        ++producer_count_;
+
+        mutex_.post();
+        state_event_.notify();
+
+        return 0;
+    }
+
+    /**
+     * @brief Leave a merge node.
+     * @return True if this was the last SINK, which should end the node.
+     */
+    bool leaveProducer(size_t index)
+    {
+        mutex_.wait();
+
+        bool last = false;
+        if (index < MAX_PRODUCERS && producers_[index].bound) {
+            leaveLocked(index);
+            last = producer_count_ == 0;
+        }
+
+        mutex_.post();
+        state_event_.notify();
+        sample_event_.notify();
+
+        return last;
+    }
+
+    // Process of any SINK still bound to a merge node, to take over
+    // ownership of the segment from one that leaves
+    bool anyProducer(ProcessId &owner) const
+    {
+        for (const auto &p : producers_) {
+            if (p.bound) {
+                owner = p.owner;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Offer a sample for writing and check whether it is this SINK's
+     * turn. Once granted, the turn is held until the SINK has written, that
+     * is, until releaseTurn().
+     * @param index Index of the producer slot.
+     * @param count Sample::count() of the sample to write.
+     */
+    Turn requestTurn(size_t index, const uint64_t count)
+    {
+        auto &self = producer(index);
+
+        mutex_.wait();
+
+        const bool offered = !self.pending || self.count != count;
+
+        if (merged_any_ && count <= last_merged_) {
+            self.pending = false;
+            self.count = count;
+            ++merge_dropped_;
+            mutex_.post();
+            return Turn::STALE;
+        }
+
+        self.pending = true;
+        self.count = count;
+
+        bool granted = writer_ == NO_WRITER;
+        for (size_t i = 0; granted && i < MAX_PRODUCERS; i++) {
+
+            const auto &p = producers_[i];
+            if (i == index || !p.bound)
+                continue;
+
+            // Earlier samples, and equal ones from lower slots, go first. The
+            // next sample of an idle SINK follows the one it last offered.
+            if (p.pending)
+                granted = p.count > count || (p.count == count && i > index);
+            else
+                granted = p.count + 1 >= count || count - p.count > reorder_window_;
+        }
+
+        if (granted)
+            writer_ = index;
+
+        mutex_.post();
+
+        // SINKs waiting on this one may now see a later count
+        if (offered)
+            sample_event_.notify();
+
+        return granted ? Turn::GRANTED : Turn::WAIT;
+    }
+
+    // Give up a pending or granted turn without writing
+    void cancelTurn(size_t index)
+    {
+        auto &self = producer(index);
+
+        mutex_.wait();
+        self.pending = false;
+        if (writer_ == index)
+            writer_ = NO_WRITER;
+        mutex_.post();
+        sample_event_.notify();
+    }
+
+    // Release the turn after the write. Must follow notifySinkWriteComplete().
+    void releaseTurn(size_t index)
+    {
+        auto &self = producer(index);
+
+        mutex_.wait();
+
+        self.pending = false;
+        last_merged_ = self.count;
+        merged_any_ = true;
+        writer_ = NO_WRITER;
+
+        mutex_.post();
+        sample_event_.notify();
+    }
+
+    /**
+     * @brief Remove the producer slots of SINKs whose processes have exited
+     * without leaving, so that the others neither wait for them nor for a
+     * turn they held.
+     * @return Number of slots released.
+     */
+    size_t releaseDeadProducers()
+    {
+        std::vector<std::pair<size_t, ProcessId>> owners;
+        mutex_.wait();
+        for (size_t i = 0; i < MAX_PRODUCERS; i++)
+            if (producers_[i].bound)
+                owners.emplace_back(i, producers_[i].owner);
+        mutex_.post();
+
+        size_t released = 0;
+        for (const auto &o : owners) {
+
+            if (o.second.alive())
+                continue;
+
+            mutex_.wait();
+            const auto &p = producers_[o.first];
+            if (p.bound && p.owner.pid == o.second.pid
+                && p.owner.start == o.second.start) {
+                leaveLocked(o.first);
+                released++;
+            }
+            mutex_.post();
+        }
+
+        if (released > 0) {
+            state_event_.notify();
+            sample_event_.notify();
+        }
+
+        return released;
+    }
+
+    // Telemetry. Updated by the SINK and SOURCEs, read by observers such as
+    // oat-top that map the node read-only.
+    SinkTelemetry &sink_telemetry(void) { return sink_telemetry_; }
+    const SinkTelemetry &sink_telemetry(void) const { return sink_telemetry_; }
+
+    LatencyHistogram &read_hold(size_t index) { return reader(index).read_hold; }
+
+    // Observers may look at any slot, bound or not
+    bool slot_bound(size_t index) const
+    {
+        return index < max_sources_ && readers_[index].bound;
+    }
+
+    const LatencyHistogram &read_hold(size_t index) const
+    {
+        if (index >= max_sources_)
+            throw std::runtime_error("Requested index is outside of the "
+                                     "reader table.");
+
+        return readers_[index].read_hold;
+    }
+
     // Synchronization constructs
     // write _always_ occurs before read. By starting at 1, the writer is not
     // blocked by an initial wait. Readers to do not post to the write_barrier
     // until a write occurs.
     semaphore write_barrier {1};
 
-    // This method is required because an std::array of semaphores requires
-    // each semaphore to be copy-constructed to initialized the array.
-    // Because of their nature, semaphores are NOT copy constructable, so
-    // this approach does not work.
     semaphore &read_barrier(size_t index)
     {
-        if (!source_slots_[index])
-            throw std::runtime_error("Requested index refers to a SOURCE "
-                                     "that is not bound to this node.");
-
-        switch (index) {
-            case 0: return rb0_; break;
-            case 1: return rb1_; break;
-            case 2: return rb2_; break;
-            case 3: return rb3_; break;
-            case 4: return rb4_; break;
-            case 6: return rb6_; break;
-            case 7: return rb7_; break;
-            case 8: return rb8_; break;
-            case 9: return rb9_; break;
-            default:
-                throw std::runtime_error("Source index out of range.");
-                break;
-        }
+        return reader(index).read_barrier;
     }
 
 private:
 
     std::atomic<NodeState> sink_state_ {oat::NodeState::UNDEFINED}; //!< SINK state
-    //std::atomic<size_t> source_read_count_ {0}; //!< Number SOURCE reads that have occured since last sink reset
-    std::bitset<NUM_SLOTS> source_slots_;
-    std::bitset<NUM_SLOTS> source_read_required_;
+    std::array<size_t, MAX_BUFFERS> reads_remaining_; //!< Per-buffer SOURCE reads still required
 
     size_t source_ref_count_ {0}; //!< Number of SOURCES sharing this node
-    uint64_t write_number_ {0}; //!< Number of writes to shmem that have been facilited by this node
+    size_t sync_ref_count_ {0}; //!< Number of SOURCES the SINK waits for
+    size_t max_sources_; //!< Capacity of the reader table
+    size_t num_buffers_ {1}; //!< Number of shared objects written round-robin
+    std::atomic<uint64_t> write_number_ {0}; //!< Number of writes to shmem that have been facilited by this node
+    std::atomic<uint64_t> writes_started_ {0}; //!< Number of writes to shmem that the SINK has begun
+
+    semaphore mutex_ {1}; //!< mutex governing exclusive acces to the reader table
+    StateEvent state_event_; //!< Wakes waiters on SINK state and SOURCE changes
+    SampleEvent sample_event_; //!< Wakes waiters on SINK writes
+
+    SinkTelemetry sink_telemetry_; //!< SINK timing
+
+    // Merge node ordering. Guarded by mutex_.
+    static constexpr size_t NO_WRITER {MAX_PRODUCERS};
+    bool merge_ {false}; //!< Several SINKs may join
+    uint64_t reorder_window_ {0}; //!< Samples by which SINKs may lag before they are not waited for
+    std::array<Producer, MAX_PRODUCERS> producers_; //!< Producer slots
+    size_t producer_count_ {0}; //!< Number of SINKs sharing this node
+    size_t writer_ {NO_WRITER}; //!< Producer slot holding the write turn
+    bool merged_any_ {false}; //!< A merged sample has been written
+    uint64_t last_merged_ {0}; //!< Count of the last merged sample written
+    uint64_t merge_dropped_ {0}; //!< Samples that arrived too late to be written
+
+    // Reader table, placed directly after the node
+    bip::offset_ptr<Reader> readers_;
+
+    // Release a bound slot. Requires mutex_.
+    void releaseLocked(size_t index)
+    {
+        auto &r = readers_[index];
+
+        // Reads this source still owed are no longer required. If it was the
+        // last reader of a buffer, that buffer is free for the sink again.
+        auto owed = r.best_effort ? 0 :
+                    std::min<uint64_t>(write_number_ - r.read_number,
+                                       num_buffers_);
+        for (uint64_t i = 0; i < owed; i++) {
+            auto &remaining = reads_remaining_[(r.read_number + i) % num_buffers_];
+            if (remaining > 0 && --remaining == 0)
+                write_barrier.post();
+        }
+
+        r.bound = false;
+        --source_ref_count_;
+        if (!r.best_effort)
+            --sync_ref_count_;
+    }
 
-    // Unfortunately, must manually maintain the number of rbx_'s to match NUM_SLOTS
-    semaphore mutex_ {1}; //!< mutex governing exclusive acces to the read_barrier_
-    semaphore rb0_ {0}, rb1_ {0}, rb2_ {0}, rb3_ {0}, rb4_ {0},
-              rb5_ {0}, rb6_ {0}, rb7_ {0}, rb8_ {0}, rb9_ {0};
+    // Remove a bound producer slot. Requires mutex_.
+    void leaveLocked(size_t index)
+    {
+        auto &p = producers_[index];
+        p.bound = false;
+        p.pending = false;
+        if (writer_ == index)
+            writer_ = NO_WRITER;
+        --producer_count_;
+    }
+
+    Producer &producer(size_t index)
+    {
+        if (index >= MAX_PRODUCERS || !producers_[index].bound)
+            throw std::runtime_error("Requested index refers to a SINK "
+                                     "that has not joined this node.");
+
+        return producers_[index];
+    }
+
+    Reader &reader(size_t index) const
+    {
+        if (index >= max_sources_ || !readers_[index].bound)
+            throw std::runtime_error("Requested index refers to a SOURCE "
+                                     "that is not bound to this node.");
+
+        return readers_[index];
+    }
 };
 
 }       /* namespace oat */
@@ -0,0 +1,171 @@
+//******************************************************************************
+//* File:   NodeLayout.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_NODELAYOUT_H
+#define	OAT_NODELAYOUT_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "ForwardsDecl.h"
+
+namespace oat {
+
+class PositionArray;
+class Position3D;
+class Overlay;
+
+/**
+ * @brief Type of the tokens exchanged through a node. Unlike the type hash
+ * of the shared object, tags are the same in every build, so that tools
+ * reading nodes of any type can tell them apart.
+ */
+enum class TokenType : int32_t {
+    Any = -1,
+    Frame,
+    Position,
+    PositionArray,
+    Position3D,
+    Overlay
+};
+
+inline const char *token_type_str(const TokenType type)
+{
+    switch (type) {
+        case TokenType::Frame : return "frame";
+        case TokenType::Position : return "position";
+        case TokenType::PositionArray : return "positions";
+        case TokenType::Position3D : return "position3d";
+        case TokenType::Overlay : return "overlay";
+        default : return "any";
+    }
+}
+
+/**
+ * @brief Where the samples of a node are, recorded in its segment header by
+ * the SINK, so that tools can find and copy the samples of any node without
+ * knowing its type.
+ *
+ * Each buffer of the node holds a sample record, the bytes that a copy of the
+ * sample comprises, e.g. a position record or a frame's pixels, and its
+ * oat::Sample. Both are located by a Span.
+ */
+struct NodeLayout {
+
+    // Flags
+    static constexpr uint32_t VIEW {1}; //!< Records are those of another node
+
+    /**
+     * @brief A byte range per buffer. The range of buffer i starts offset +
+     * i * stride bytes from the shared object or, if indirect, at the segment
+     * handle stored there. It is bytes long or, if sized, as long as the
+     * size_t at size_offset + i * size_stride from the shared object.
+     */
+    struct Span {
+        uint64_t offset {0};
+        uint64_t stride {0};
+        uint64_t bytes {0};
+        uint64_t size_offset {0};
+        uint64_t size_stride {0};
+        uint32_t indirect {0};
+        uint32_t sized {0};
+    };
+
+    TokenType type {TokenType::Any};
+    uint32_t flags {0};
+    Span record;
+    Span sample;
+};
+
+template <typename T>
+struct TokenTag { static constexpr TokenType value {TokenType::Any}; };
+template <>
+struct TokenTag<PositionArray> {
+    static constexpr TokenType value {TokenType::PositionArray};
+};
+template <>
+struct TokenTag<Position3D> {
+    static constexpr TokenType value {TokenType::Position3D};
+};
+template <>
+struct TokenTag<Overlay> { static constexpr TokenType value {TokenType::Overlay}; };
+
+/**
+ * @brief Offset of a member of a shared object, taken from a constructed
+ * one, since shared objects are not standard layout.
+ */
+template <typename T, typename M>
+inline uint64_t memberOffset(const T &obj, const M &member)
+{
+    return reinterpret_cast<const char *>(&member)
+           - reinterpret_cast<const char *>(&obj);
+}
+
+namespace detail {
+
+// Objects carrying their sample: the whole object is one record
+template <typename T>
+inline auto describeObject(const T &obj, int) -> decltype(obj.sample(), NodeLayout())
+{
+    NodeLayout l;
+    l.type = TokenTag<T>::value;
+    l.record.bytes = sizeof(T);
+    l.sample.offset = memberOffset(obj, obj.sample());
+    l.sample.bytes = sizeof(typename std::decay<decltype(obj.sample())>::type);
+    return l;
+}
+
+// Anything else, e.g. an integer in a test: a record and no sample
+template <typename T>
+inline NodeLayout describeObject(const T &, long)
+{
+    NodeLayout l;
+    l.type = TokenTag<T>::value;
+    l.record.bytes = sizeof(T);
+    return l;
+}
+
+// Shared objects that describe themselves, such as frame headers
+template <typename T>
+inline auto describe(const T &obj, int) -> decltype(obj.layout())
+{
+    return obj.layout();
+}
+
+template <typename T>
+inline NodeLayout describe(const T &obj, long)
+{
+    return describeObject(obj, 0);
+}
+
+} // namespace detail
+
+/**
+ * @brief Layout of a node whose SINK constructed obj.
+ */
+template <typename T>
+inline NodeLayout describeNode(const T &obj)
+{
+    return detail::describe(obj, 0);
+}
+
+} // namespace oat
+
+#endif	/* OAT_NODELAYOUT_H */
@@ -0,0 +1,353 @@
+//******************************************************************************
+//* File:   PositionBus.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONBUS_H
+#define	OAT_POSITIONBUS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "../datatypes/Position2D.h"
+#include "ForwardsDecl.h"
+#include "ProcessId.h"
+#include "SampleEvent.h"
+
+namespace oat {
+
+/**
+ * @brief Many small, named position streams, or channels, in one shared
+ * memory segment. A node costs a segment, a set of semaphores and a polling
+ * source per reader, which adds up when tens of positions are tracked at
+ * once. Channels instead share one fixed size table and a single event that
+ * every write notifies, so a reader follows all of them with one wait.
+ *
+ * Channels hold the latest position only. Like a latest-value source, a
+ * reader that falls behind skips positions rather than holding back the
+ * writer, and tells how many it skipped from the channel's write count. Each
+ * channel has one writer. Each position is guarded by a sequence number that
+ * is odd while it is being written, so readers never keep torn positions.
+ */
+class PositionBus {
+
+public:
+
+    // Most channels on one bus
+    static constexpr size_t CAPACITY {64};
+
+    // Length of channel names, including the terminating null
+    static constexpr size_t NAME_LEN {32};
+
+    /**
+     * @brief Name of the shared memory segment holding a bus.
+     */
+    static std::string segmentName(const std::string &bus)
+    {
+        return bus + "_bus";
+    }
+
+    /**
+     * @brief Open a bus, creating it if it does not exist.
+     * @param bus Name of the bus, e.g. "arenas".
+     */
+    explicit PositionBus(const std::string &bus)
+    : name_(segmentName(bus))
+    {
+        shm_ = bip::shared_memory_object(
+                bip::open_or_create, name_.c_str(), bip::read_write);
+
+        // Truncating to the current size changes nothing, so a table is made
+        // once, zero filled, however many processes race to open it
+        shm_.truncate(sizeof(Table));
+        region_ = bip::mapped_region(shm_, bip::read_write);
+        table_ = static_cast<Table *>(region_.get_address());
+
+        uint64_t unset = 0;
+        table_->layout.compare_exchange_strong(unset, LAYOUT);
+        if (table_->layout != LAYOUT)
+            throw std::runtime_error("Shared memory at '" + name_
+                    + "' was made by an incompatible version of Oat. Use "
+                    "oat-clean to remove it.");
+    }
+
+    PositionBus(const PositionBus &) = delete;
+    PositionBus &operator=(const PositionBus &) = delete;
+
+    /**
+     * @brief Become the writer of a channel, naming a free one if no channel
+     * has the name yet. Channels keep their name for the life of the bus. A
+     * channel whose writer has exited is taken over, and keeps its last
+     * position and write count. If the writer died part way through a write,
+     * nothing can be read from the channel until it is written again.
+     * @param channel Name of the channel, e.g. "arena3".
+     * @return Index of the channel.
+     */
+    size_t claim(const std::string &channel)
+    {
+        if (channel.empty() || channel.size() >= NAME_LEN)
+            throw std::runtime_error("Bus channel names must be between 1 "
+                    "and " + std::to_string(NAME_LEN - 1) + " characters.");
+
+        const auto self = ProcessId::self();
+        NamingLock lock {table_->naming};
+
+        const size_t found = find(channel);
+        if (found < CAPACITY) {
+
+            Channel &c = table_->channels[found];
+            if (!same(c.writer, self) && c.writer.alive())
+                throw std::runtime_error("Channel '" + channel + "' of '"
+                        + name_ + "' is written by another running process.");
+
+            c.writer = self;
+            return found;
+        }
+
+        for (size_t i = 0; i < CAPACITY; i++) {
+
+            Channel &c = table_->channels[i];
+            if (c.state.load(std::memory_order_acquire) != FREE)
+                continue;
+
+            c.writer = self;
+            std::strncpy(c.name, channel.c_str(), NAME_LEN);
+            c.state.store(NAMED, std::memory_order_release);
+            table_->event.notify();
+            return i;
+        }
+
+        throw std::runtime_error("All " + std::to_string(CAPACITY)
+                + " channels of '" + name_ + "' are in use.");
+    }
+
+    /**
+     * @brief Publish the latest position of a claimed channel and wake the
+     * bus's readers.
+     * @param channel Index returned by claim().
+     * @param record Position, as published.
+     * @param unit Unit of length of the position.
+     * @param homography Homography of the position.
+     */
+    void write(const size_t channel,
+               const oat::PositionRecord &record,
+               const oat::DistanceUnit unit,
+               const cv::Matx33d &homography)
+    {
+        Channel &c = table_->channels[channel];
+
+        // A writer that died part way through a write left the sequence odd.
+        // Writing on from that odd value keeps the torn position unread and
+        // odd still meaning a write is under way.
+        const uint64_t odd = c.sequence.load(std::memory_order_relaxed) | 1;
+
+        c.sequence.store(odd, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&c.record, &record, sizeof(record));
+        c.unit = static_cast<int32_t>(unit);
+        std::copy(homography.val, homography.val + 9, c.homography);
+        c.sequence.store(odd + 1, std::memory_order_release);
+
+        table_->event.notify();
+    }
+
+    void write(const size_t channel, const oat::Position2D &position)
+    {
+        write(channel,
+              position.record(),
+              position.unit_of_length(),
+              position.homography());
+    }
+
+    /**
+     * @brief Name of channel i, or an empty string if it is not in use.
+     */
+    std::string name(const size_t i) const
+    {
+        const Channel &c = table_->channels[i];
+        if (c.state.load(std::memory_order_acquire) != NAMED)
+            return "";
+
+        return std::string(c.name, strnlen(c.name, NAME_LEN));
+    }
+
+    /**
+     * @brief Index of the channel with a name, or CAPACITY if there is none.
+     */
+    size_t find(const std::string &channel) const
+    {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            const Channel &c = table_->channels[i];
+            if (c.state.load(std::memory_order_acquire) == NAMED
+                && channel.compare(0, NAME_LEN, c.name,
+                                   strnlen(c.name, NAME_LEN)) == 0)
+                return i;
+        }
+
+        return CAPACITY;
+    }
+
+    /**
+     * @brief Number of positions written to channel i. A reader that last
+     * read write number w and now reads w + k has skipped k - 1 positions.
+     */
+    uint64_t writes(const size_t i) const
+    {
+        return table_->channels[i].sequence.load(std::memory_order_acquire) / 2;
+    }
+
+    /**
+     * @brief Copy the latest position of channel i.
+     * @param i Channel index.
+     * @param position Set to the position. Its label is untouched.
+     * @return Write number of the position copied, or 0 if nothing has been
+     * written, or the writer is stuck part way through a write.
+     */
+    uint64_t read(const size_t i, oat::Position2D &position) const
+    {
+        const Channel &c = table_->channels[i];
+
+        oat::PositionRecord record;
+        int32_t unit;
+        cv::Matx33d homography;
+
+        for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+
+            const uint64_t n = c.sequence.load(std::memory_order_acquire);
+            if (n == 0)
+                return 0;
+            if (n & 1)
+                continue;
+
+            std::memcpy(&record, &c.record, sizeof(record));
+            unit = c.unit;
+            std::copy(c.homography, c.homography + 9, homography.val);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (c.sequence.load(std::memory_order_relaxed) != n)
+                continue;
+
+            position.set_record(record);
+            position.setCoordSystem(static_cast<oat::DistanceUnit>(unit),
+                                    homography);
+            return n / 2;
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Advanced by every write to the bus and by every channel that is
+     * named. Take the generation, read the channels, then pass it to wait().
+     */
+    uint32_t generation() const { return table_->event.generation(); }
+
+    /**
+     * @brief Sleep until the bus is written after generation seen, timeout
+     * passes, or a signal is delivered to the calling thread.
+     * @return True if the bus was written.
+     */
+    bool wait(const uint32_t seen, const std::chrono::nanoseconds timeout)
+    {
+        SampleEvent *events[] {&table_->event};
+        return SampleEvent::waitAny(events, &seen, 1, timeout);
+    }
+
+private:
+
+    // Channel states
+    static constexpr uint32_t FREE {0}, NAMED {1};
+
+    // Longest a channel is taken to be named for. A lock held longer was
+    // left by a process that died while naming one.
+    static std::chrono::milliseconds namingTimeout()
+    {
+        return std::chrono::milliseconds(1000);
+    }
+
+    // Copies of a position attempted before a reader gives up on a writer
+    // that is part way through a write
+    static constexpr int READ_ATTEMPTS {1024};
+
+    struct Channel {
+        std::atomic<uint32_t> state;
+        char name[NAME_LEN];
+        ProcessId writer;
+        std::atomic<uint64_t> sequence;
+        oat::PositionRecord record;
+        int32_t unit;
+        double homography[9];
+    };
+
+    struct Table {
+        std::atomic<uint64_t> layout;
+        std::atomic<uint32_t> naming;
+        SampleEvent event;
+        Channel channels[CAPACITY];
+    };
+
+    static constexpr uint64_t LAYOUT {
+        CAPACITY | static_cast<uint64_t>(sizeof(Table)) << 32};
+
+    const std::string name_;
+    bip::shared_memory_object shm_;
+    bip::mapped_region region_;
+    Table *table_ {nullptr};
+
+    // Held while a channel is looked up and named, so that two processes
+    // naming the same channel at once get the same slot
+    class NamingLock {
+    public:
+        explicit NamingLock(std::atomic<uint32_t> &word)
+        : word_(word)
+        {
+            const auto deadline =
+                std::chrono::steady_clock::now() + namingTimeout();
+
+            uint32_t unlocked = 0;
+            while (!word_.compare_exchange_weak(unlocked, 1,
+                                                std::memory_order_acquire)) {
+                unlocked = 0;
+                if (std::chrono::steady_clock::now() > deadline)
+                    break;
+                std::this_thread::yield();
+            }
+        }
+
+        ~NamingLock() { word_.store(0, std::memory_order_release); }
+
+    private:
+        std::atomic<uint32_t> &word_;
+    };
+
+    static bool same(const ProcessId &a, const ProcessId &b)
+    {
+        return a.pid == b.pid && a.start == b.start;
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONBUS_H */
@@ -0,0 +1,194 @@
+//******************************************************************************
+//* File:   PositionHistoryRing.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONHISTORYRING_H
+#define	OAT_POSITIONHISTORYRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "../datatypes/Position2D.h"
+
+namespace oat {
+
+/**
+ * @brief Ring of the most recent positions published to a position node,
+ * kept in the node's payload. The SINK appends each position as it posts it
+ * and any number of readers scan it by sample number without taking part in
+ * the node's synchronization, so features that need a position's history,
+ * e.g. trails or dwell times, do not each have to keep their own.
+ *
+ * Each slot carries a sequence number that is odd while the slot is being
+ * written. Readers copy a slot and keep the copy only if the number was even
+ * and unchanged across the copy, so a reader that is overtaken by the SINK
+ * loses the overwritten positions rather than reading torn ones.
+ */
+class PositionHistoryRing {
+
+public:
+
+    /**
+     * @brief Bytes of payload a ring of a given capacity occupies.
+     */
+    static size_t bytes(const size_t capacity)
+    {
+        return sizeof(PositionHistoryRing) + capacity * sizeof(Slot);
+    }
+
+    /**
+     * @param capacity Number of positions kept. The ring must be constructed
+     * in at least bytes(capacity) bytes.
+     */
+    explicit PositionHistoryRing(const size_t capacity)
+    : capacity_(capacity)
+    {
+        for (size_t i = 0; i < capacity_; i++)
+            new (&slots()[i]) Slot();
+    }
+
+    PositionHistoryRing(const PositionHistoryRing &) = delete;
+    PositionHistoryRing &operator=(const PositionHistoryRing &) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * @brief Number of positions appended since the ring was made.
+     */
+    uint64_t written() const
+    {
+        return written_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Append a position, overwriting the oldest if the ring is full.
+     * Only one writer may append at a time.
+     */
+    void push(const oat::PositionRecord &record)
+    {
+        const uint64_t n = written_.load(std::memory_order_relaxed);
+        Slot &s = slots()[n % capacity_];
+
+        s.sequence.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&s.record, &record, sizeof(record));
+        s.sequence.store(2 * n + 2, std::memory_order_release);
+
+        written_.store(n + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copy the positions held whose sample numbers lie in
+     * [first_count, last_count], oldest first. The ring is scanned back from
+     * the newest position, so recent ranges are cheap to read however large
+     * the ring is.
+     * @param first_count Sample number of the oldest position to copy.
+     * @param last_count Sample number of the newest position to copy.
+     * @param records Cleared, then filled with the positions found.
+     * @return Number of positions copied.
+     */
+    size_t read(const uint64_t first_count,
+                const uint64_t last_count,
+                std::vector<oat::PositionRecord> &records) const
+    {
+        records.clear();
+
+        const uint64_t n = written();
+        const uint64_t oldest = n > capacity_ ? n - capacity_ : 0;
+
+        oat::PositionRecord r;
+        for (uint64_t i = n; i > oldest; i--) {
+
+            if (!copy(i - 1, r))
+                break;
+
+            const uint64_t count = r.sample.count();
+            if (count < first_count)
+                break;
+
+            if (count <= last_count)
+                records.push_back(r);
+        }
+
+        std::reverse(records.begin(), records.end());
+        return records.size();
+    }
+
+    /**
+     * @brief Copy the latest positions held, oldest first.
+     * @param max Most positions to copy.
+     * @param records Cleared, then filled with the positions found.
+     * @return Number of positions copied.
+     */
+    size_t latest(const size_t max,
+                  std::vector<oat::PositionRecord> &records) const
+    {
+        records.clear();
+
+        const uint64_t n = written();
+        const uint64_t oldest = n > capacity_ ? n - capacity_ : 0;
+
+        oat::PositionRecord r;
+        for (uint64_t i = n; i > oldest && records.size() < max; i--) {
+            if (!copy(i - 1, r))
+                break;
+            records.push_back(r);
+        }
+
+        std::reverse(records.begin(), records.end());
+        return records.size();
+    }
+
+private:
+
+    struct Slot {
+        std::atomic<uint64_t> sequence {0};
+        oat::PositionRecord record;
+    };
+
+    const size_t capacity_;
+    std::atomic<uint64_t> written_ {0};
+
+    Slot *slots() { return reinterpret_cast<Slot *>(this + 1); }
+    const Slot *slots() const
+    {
+        return reinterpret_cast<const Slot *>(this + 1);
+    }
+
+    // Copy the position appended as number i
+    bool copy(const uint64_t i, oat::PositionRecord &record) const
+    {
+        const Slot &s = slots()[i % capacity_];
+        const uint64_t expected = 2 * i + 2;
+
+        if (s.sequence.load(std::memory_order_acquire) != expected)
+            return false;
+
+        std::memcpy(&record, &s.record, sizeof(record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return s.sequence.load(std::memory_order_relaxed) == expected;
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONHISTORYRING_H */
@@ -0,0 +1,122 @@
+//******************************************************************************
+//* File:   ProcessId.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_PROCESSID_H
+#define	OAT_PROCESSID_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace oat {
+
+/**
+ * @brief Identifies a process in a way that survives PID reuse, so that
+ * components can tell whether the owner of a slot or a node that was left in
+ * shared memory is still running. A process is identified by its PID, its
+ * start time since boot, and its PID namespace. Processes in a different PID
+ * namespace cannot be checked and are always taken to be alive.
+ */
+struct ProcessId {
+
+    int32_t pid {0};        //!< 0 if unknown
+    uint64_t start {0};     //!< Start time in clock ticks since boot, or 0
+    uint64_t namespace_ {0}; //!< Inode of the PID namespace, or 0
+
+    /**
+     * @brief Identity of the calling process.
+     */
+    static ProcessId self()
+    {
+        ProcessId p;
+        p.pid = static_cast<int32_t>(getpid());
+        p.start = startTime(p.pid);
+        p.namespace_ = pidNamespace();
+        return p;
+    }
+
+    /**
+     * @brief False only if the process is known to have exited.
+     */
+    bool alive() const
+    {
+        if (pid <= 0 || namespace_ != pidNamespace())
+            return true;
+
+        if (kill(pid, 0) != 0 && errno == ESRCH)
+            return false;
+
+        // The PID now belongs to a process started later
+        if (start != 0) {
+            const auto now = startTime(pid);
+            if (now != 0 && now != start)
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    // Field 22 of /proc/<pid>/stat, or 0 if it cannot be read
+    static uint64_t startTime(const int32_t pid)
+    {
+        const std::string path = "/proc/" + std::to_string(pid) + "/stat";
+        auto f = std::fopen(path.c_str(), "r");
+        if (f == nullptr)
+            return 0;
+
+        char buf[1024];
+        const size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+        std::fclose(f);
+        buf[n] = '\0';
+
+        // The command name, field 2, is parenthesized and may hold spaces
+        const char *p = std::strrchr(buf, ')');
+        if (p == nullptr)
+            return 0;
+
+        // Skip to field 22, counting from field 3 which follows ") "
+        p++;
+        for (int field = 3; field < 22 && p != nullptr; field++)
+            p = std::strchr(p + 1, ' ');
+
+        return p == nullptr ? 0 : std::strtoull(p, nullptr, 10);
+    }
+
+    static uint64_t pidNamespace()
+    {
+        struct stat s;
+        if (stat("/proc/self/ns/pid", &s) != 0)
+            return 0;
+
+        return static_cast<uint64_t>(s.st_ino);
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_PROCESSID_H */
@@ -0,0 +1,104 @@
+//******************************************************************************
+//* File:   Readiness.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_READINESS_H
+#define	OAT_READINESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <string>
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include "Node.h"
+#include "Registry.h"
+#include "Segment.h"
+
+namespace oat {
+
+/**
+ * @brief Wait until a node is ready or the deadline passes. Sleeps on the
+ * registry until the node exists, and then on the node itself, so readiness
+ * is seen the moment it changes.
+ * @param registry Registry listing node segments.
+ * @param address Node address.
+ * @param sources Number of SOURCEs that must be attached.
+ * @param bound Wait for the SINK to bind instead of for SOURCEs to attach.
+ * @param deadline Time to give up at.
+ * @param stop Flag that ends the wait when set, e.g. by a signal handler.
+ * @return True if the node is ready.
+ */
+inline bool awaitNode(const Registry &registry,
+                      const std::string &address,
+                      const size_t sources,
+                      const bool bound,
+                      const std::chrono::steady_clock::time_point deadline,
+                      const volatile std::sig_atomic_t &stop)
+{
+    // Longest sleep before stop and the deadline are checked again
+    const std::chrono::nanoseconds check_period = std::chrono::milliseconds(100);
+
+    std::unique_ptr<Segment> segment;
+    const Node *node {nullptr};
+    uint32_t listed = 0;
+
+    while (!stop) {
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+
+        const auto slice = std::min<std::chrono::nanoseconds>(
+                check_period, deadline - now);
+
+        // A node that was removed and made again is a new segment
+        if (node != nullptr && registry.generation() != listed)
+            node = nullptr;
+
+        if (node == nullptr) {
+
+            listed = registry.generation();
+            try {
+                segment.reset(new Segment());
+                node = segment->observe(address + "_node");
+            } catch (const bip::interprocess_exception &) {
+                node = nullptr;
+            }
+
+            if (node == nullptr) {
+                registry.awaitChange(listed, slice);
+                continue;
+            }
+        }
+
+        const auto seen = node->state_generation();
+        if (bound ? node->sink_state() == NodeState::SINK_BOUND
+                  : node->source_ref_count() >= sources)
+            return true;
+
+        node->awaitStateChange(seen, slice);
+    }
+
+    return false;
+}
+
+}      /* namespace oat */
+#endif /* OAT_READINESS_H */
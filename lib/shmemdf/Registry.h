@@ -0,0 +1,200 @@
+//******************************************************************************
+//* File:   Registry.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_REGISTRY_H
+#define	OAT_REGISTRY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "ForwardsDecl.h"
+#include "StateEvent.h"
+
+namespace oat {
+
+/**
+ * @brief Small shared memory table listing the node segments that currently
+ * exist. A segment is added by whichever component creates it and removed
+ * along with it, so that tools can discover nodes and wait for them to
+ * appear without polling their names. The table is advisory: nodes work
+ * whether or not they could be listed.
+ */
+class Registry {
+
+public:
+
+    // Shared memory segment holding the table
+    static constexpr const char *SEGMENT {"oat_registry"};
+
+    // Most segments listed at once and longest name that can be listed
+    static constexpr size_t CAPACITY {256};
+    static constexpr size_t NAME_BYTES {128};
+
+    /**
+     * @brief Open the table, creating it if it does not exist.
+     */
+    Registry()
+    {
+        shm_ = bip::shared_memory_object(
+                bip::open_or_create, SEGMENT, bip::read_write);
+
+        // Truncating to the current size changes nothing, so a table is made
+        // once, zero filled, however many components race to open it
+        shm_.truncate(sizeof(Table));
+        region_ = bip::mapped_region(shm_, bip::read_write);
+        table_ = static_cast<Table *>(region_.get_address());
+
+        uint64_t unset = 0;
+        table_->layout.compare_exchange_strong(unset, LAYOUT);
+        if (table_->layout != LAYOUT)
+            throw std::runtime_error(std::string("Shared memory at '")
+                    + SEGMENT + "' was made by an incompatible version of "
+                    "Oat. Use oat-clean to remove it.");
+    }
+
+    /**
+     * @brief List a segment. Names that are too long are not listed.
+     * @param name Segment name.
+     */
+    void add(const std::string &name)
+    {
+        if (name.size() >= NAME_BYTES)
+            return;
+
+        // A segment left by a component that crashed may be listed already
+        remove(name);
+
+        for (auto &e : table_->entries) {
+
+            uint32_t unclaimed = FREE;
+            if (!e.state.compare_exchange_strong(unclaimed, CLAIMED))
+                continue;
+
+            std::memset(e.name, 0, NAME_BYTES);
+            std::memcpy(e.name, name.data(), name.size());
+            e.state.store(LISTED, std::memory_order_release);
+            table_->changes.notify();
+            return;
+        }
+    }
+
+    /**
+     * @brief Remove a segment from the list.
+     * @param name Segment name.
+     */
+    void remove(const std::string &name)
+    {
+        for (auto &e : table_->entries) {
+
+            if (e.state.load(std::memory_order_acquire) != LISTED
+                || name.compare(0, NAME_BYTES, e.name) != 0)
+                continue;
+
+            uint32_t listed = LISTED;
+            if (e.state.compare_exchange_strong(listed, FREE))
+                table_->changes.notify();
+        }
+    }
+
+    /**
+     * @brief Names of the listed segments.
+     */
+    std::vector<std::string> names() const
+    {
+        std::vector<std::string> n;
+        for (const auto &e : table_->entries)
+            if (e.state.load(std::memory_order_acquire) == LISTED)
+                n.emplace_back(e.name, strnlen(e.name, NAME_BYTES));
+
+        return n;
+    }
+
+    /**
+     * @brief Advanced by each change to the list. Take the generation, check
+     * the list, then pass it to awaitChange().
+     */
+    uint32_t generation() const { return table_->changes.generation(); }
+
+    bool awaitChange(const uint32_t seen,
+                     const std::chrono::nanoseconds timeout) const
+    {
+        return table_->changes.wait(seen, timeout);
+    }
+
+    /**
+     * @brief List a segment, ignoring any failure to open the table.
+     */
+    static void tryAdd(const std::string &name) noexcept
+    {
+        try {
+            Registry().add(name);
+        } catch (...) {
+            // Advisory only
+        }
+    }
+
+    /**
+     * @brief Remove a segment from the list, ignoring any failure to open
+     * the table.
+     */
+    static void tryRemove(const std::string &name) noexcept
+    {
+        try {
+            Registry().remove(name);
+        } catch (...) {
+            // Advisory only
+        }
+    }
+
+private:
+
+    // Entry states
+    static constexpr uint32_t FREE {0}, CLAIMED {1}, LISTED {2};
+
+    struct Entry {
+        std::atomic<uint32_t> state;
+        char name[NAME_BYTES];
+    };
+
+    struct Table {
+        std::atomic<uint64_t> layout;
+        StateEvent changes;
+        Entry entries[CAPACITY];
+    };
+
+    static constexpr uint64_t LAYOUT {
+        CAPACITY | NAME_BYTES << 16 | static_cast<uint64_t>(sizeof(Table)) << 32};
+
+    bip::shared_memory_object shm_;
+    bip::mapped_region region_;
+    Table *table_ {nullptr};
+};
+
+}      /* namespace oat */
+#endif /* OAT_REGISTRY_H */
@@ -0,0 +1,210 @@
+//******************************************************************************
+//* File:   SampleEvent.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_SAMPLEEVENT_H
+#define	OAT_SAMPLEEVENT_H
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+#ifdef USE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace oat {
+
+/**
+ * @brief Process-shared event that a SINK notifies on every write, so that a
+ * thread reading many nodes can sleep until any one of them is written
+ * rather than on each node's read barrier in turn. Like StateEvent, it holds
+ * a generation that notify() advances, but notify() only enters the kernel
+ * while someone is asleep on it, so writes to nodes that nobody waits on this
+ * way cost a single atomic increment. Waiters register themselves and must
+ * therefore map the node read-write.
+ */
+class SampleEvent {
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Futex word must be a plain 32-bit integer.");
+
+public:
+
+    // Polling period of waits on several events where the kernel cannot
+    // sleep on all of them at once
+    static std::chrono::microseconds pollPeriod()
+    {
+        return std::chrono::microseconds(100);
+    }
+
+    SampleEvent() = default;
+
+    // Events are not copyable or movable
+    SampleEvent(const SampleEvent &) = delete;
+    SampleEvent &operator=(const SampleEvent &) = delete;
+
+    /**
+     * @brief Current generation, to be passed to waitAny() once the nodes it
+     * guards have been checked.
+     */
+    uint32_t generation() const
+    {
+        return generation_.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief Advance the generation and wake every waiter.
+     */
+    void notify()
+    {
+        // Paired with the registration in waitAny(): either the waiter sees
+        // the new generation or this sees the waiter
+        generation_.fetch_add(1, std::memory_order_seq_cst);
+#ifdef USE_FUTEX
+        if (sleepers_.load(std::memory_order_seq_cst) > 0)
+            syscall(SYS_futex, word(), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+    /**
+     * @brief Sleep until the generation of any of the events differs from
+     * the one seen, timeout passes, or a signal is delivered to the calling
+     * thread.
+     * @param events Events to wait on.
+     * @param seen Generation of each event at which its node was last
+     * checked.
+     * @param count Number of events.
+     * @param timeout Longest time to sleep.
+     * @return True if any generation moved on.
+     */
+    static bool waitAny(SampleEvent *const *events,
+                        const uint32_t *seen,
+                        const size_t count,
+                        const std::chrono::nanoseconds timeout)
+    {
+        if (count == 0)
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+            events[i]->sleepers_.fetch_add(1, std::memory_order_seq_cst);
+
+        bool moved = changed(events, seen, count);
+
+#ifdef USE_FUTEX
+        const bool slept = !moved && sleep(events, seen, count, timeout);
+#else
+        const bool slept = false;
+#endif
+
+        // Poll where the kernel could not sleep on every event at once
+        if (!moved && !slept) {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!(moved = changed(events, seen, count))
+                   && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(pollPeriod());
+        }
+
+        for (size_t i = 0; i < count; i++)
+            events[i]->sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+
+        return moved || changed(events, seen, count);
+    }
+
+private:
+
+    std::atomic<uint32_t> generation_ {0};
+    std::atomic<uint32_t> sleepers_ {0}; //!< Threads in waitAny()
+
+    static bool changed(SampleEvent *const *events,
+                        const uint32_t *seen,
+                        const size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            if (events[i]->generation() != seen[i])
+                return true;
+
+        return false;
+    }
+
+#ifdef USE_FUTEX
+    uint32_t *word()
+    {
+        return reinterpret_cast<uint32_t *>(&generation_);
+    }
+
+    // Sleep in the kernel on every event. Returns false if it cannot, so
+    // the caller polls instead.
+    static bool sleep(SampleEvent *const *events,
+                      const uint32_t *seen,
+                      const size_t count,
+                      const std::chrono::nanoseconds timeout)
+    {
+        struct timespec ts;
+
+        if (count == 1) {
+            ts.tv_sec = timeout.count() / 1000000000;
+            ts.tv_nsec = timeout.count() % 1000000000;
+            syscall(SYS_futex, events[0]->word(), FUTEX_WAIT, seen[0], &ts,
+                    nullptr, 0);
+            return true;
+        }
+
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+        // NOTE: No FUTEX_PRIVATE_FLAG because the words are shared between
+        // processes
+        struct futex_waitv waiters[FUTEX_WAITV_MAX] {};
+        if (count > FUTEX_WAITV_MAX)
+            return false;
+
+        for (size_t i = 0; i < count; i++) {
+            waiters[i].val = seen[i];
+            waiters[i].uaddr = reinterpret_cast<uintptr_t>(events[i]->word());
+            waiters[i].flags = FUTEX_32;
+        }
+
+        // Absolute timeout
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        const auto end = std::chrono::seconds(ts.tv_sec)
+                         + std::chrono::nanoseconds(ts.tv_nsec) + timeout;
+        ts.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(end).count();
+        ts.tv_nsec = (end - std::chrono::seconds(ts.tv_sec)).count();
+
+        const auto rc = syscall(SYS_futex_waitv, waiters, count, 0, &ts,
+                                CLOCK_MONOTONIC);
+
+        // Kernels before 5.16 do not have the call
+        return !(rc < 0 && errno == ENOSYS);
+#else
+        return false;
+#endif
+    }
+#endif
+};
+
+}      /* namespace oat */
+#endif /* OAT_SAMPLEEVENT_H */
@@ -0,0 +1,558 @@
+//******************************************************************************
+//* File:   Segment.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_SEGMENT_H
+#define	OAT_SEGMENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Channel.h"
+#include "ForwardsDecl.h"
+#include "MemoryPolicy.h"
+#include "Node.h"
+#include "NodeLayout.h"
+#include "ProcessId.h"
+#include "Registry.h"
+
+namespace oat {
+
+/**
+ * @brief Header at the start of each node's shared memory segment.
+ *
+ * A node is a single segment with a fixed layout:
+ *
+ *     | SegmentHeader | Node | reader table | shared object | payload |
+ *
+ * The header, node and reader table are made by whichever of the SINK or
+ * SOURCEs arrives first. The SINK then grows the segment to hold the shared
+ * object and its payload, e.g. frame pixel data, and records where they are.
+ * Everything is found through these offsets, so the segment needs no
+ * allocator or name index.
+ *
+ * The SINK that claims the node records its process. A segment whose SINK
+ * has exited without removing it, e.g. because it crashed, is stale, and is
+ * reclaimed by the next component that opens it.
+ */
+struct SegmentHeader {
+
+    // "OATNODE" followed by the layout version
+    static constexpr uint64_t MAGIC {0x4f41544e4f444500};
+    static constexpr uint64_t VERSION {2};
+
+    std::atomic<uint64_t> magic {0}; //!< MAGIC | VERSION once the node is made
+    uint64_t layout {0};      //!< Sizes of the shared structures
+    uint64_t sync_bytes {0};  //!< Bytes of header, node and reader table
+    std::atomic<uint32_t> sink_claimed {0}; //!< Set by the first SINK to bind
+    std::atomic<uint32_t> reclaimed {0};    //!< Set by the component removing a stale segment
+    ProcessId sink_owner;     //!< Process of the claiming SINK
+
+    // Written by the SINK before it marks the node bound
+    uint64_t type_hash {0};   //!< Identifies the type of the shared object
+    uint64_t object_offset {0};
+    uint64_t payload_offset {0};
+    uint64_t bytes {0};       //!< Size of the whole segment
+    NodeLayout node_layout;   //!< Type tag and where the samples are
+};
+
+/**
+ * @brief A node's shared memory segment, mapped into this process, or the
+ * in-process Channel standing in for it when the node's address is declared
+ * in-process.
+ */
+class Segment {
+
+public:
+
+    // Node follows the header on its own cache line
+    static constexpr size_t NODE_OFFSET {
+        (sizeof(SegmentHeader) + Node::CACHE_LINE_SIZE - 1)
+            / Node::CACHE_LINE_SIZE * Node::CACHE_LINE_SIZE};
+
+    /**
+     * @brief Open a node's segment, creating it and the node it holds if it
+     * does not exist. A stale segment, whose SINK has exited without removing
+     * it, is removed and made again. Its SOURCEs, if any still run, see the
+     * end of the stream. Slots held by SOURCEs that have exited are released.
+     * @param name Segment name.
+     * @param max_sources Capacity of the reader table, if the node is created.
+     * @return The node.
+     */
+    Node *open(const std::string &name, const size_t max_sources);
+
+    /**
+     * @brief Map an existing node's segment read-only.
+     * @param name Segment name.
+     * @return The node, or nullptr if it does not exist or is not made yet.
+     */
+    const Node *observe(const std::string &name);
+
+    /**
+     * @brief Claim the node for a SINK, grow the segment to hold a T followed
+     * by payload_bytes, and construct the T. The memory policy is applied to
+     * the shared object and payload before any SOURCE can map them.
+     * @return The shared object, or nullptr if another SINK claimed the node.
+     */
+    template <typename T, typename... Targs>
+    T *bind(const size_t payload_bytes,
+            const MemoryPolicy &policy,
+            Targs &&... args);
+
+    /**
+     * @brief Map the shared object constructed by the node's SINK. Must
+     * follow the SINK binding the node.
+     * @param populate Fault in the page tables of the whole segment now.
+     * @return The shared object, or nullptr if it is not a T.
+     */
+    template <typename T>
+    T *connect(const bool populate);
+
+    /**
+     * @brief Map the shared object constructed by the node's SINK, whatever
+     * its type. Must follow the SINK binding the node. Its layout is then
+     * info().node_layout.
+     * @param populate Fault in the page tables of the whole segment now.
+     * @return The shared object.
+     */
+    void *connectAny(const bool populate);
+
+    /**
+     * @brief Grow a bound segment by bytes of payload, e.g. to hold frames
+     * that no longer fit their buffers. Mappings made before are kept, so
+     * pointers into them stay valid.
+     * @param bytes Bytes of payload to add.
+     * @param policy Page placement of the new payload.
+     * @return Handle to the new payload.
+     */
+    handle_t grow(const size_t bytes, const MemoryPolicy &policy);
+
+    /**
+     * @brief Map the whole segment if its SINK has grown it past this
+     * process' mapping. Mappings made before are kept.
+     * @param populate Fault in the page tables of the whole segment now.
+     */
+    void update(const bool populate);
+
+    Node *node() const
+    {
+        return reinterpret_cast<Node *>(base() + NODE_OFFSET);
+    }
+
+    void *payload() const { return base() + header()->payload_offset; }
+
+    // Interprocess pointers are byte offsets from the start of the segment
+    void *address(const handle_t handle) const { return base() + handle; }
+    handle_t handle(const void *address) const
+    {
+        return static_cast<const char *>(address) - base();
+    }
+
+    size_t size() const
+    {
+        return channel_ ? channel_->size() : region_.get_size();
+    }
+
+    // Header of the mapped segment, for tools that report on nodes they
+    // observe
+    const SegmentHeader &info() const { return *header(); }
+
+    // Mark the node as a view, whose records are those of another node
+    void set_view() { header()->node_layout.flags |= NodeLayout::VIEW; }
+
+    // Hand the segment to another SINK of a merge node, so that it is not
+    // reclaimed as stale when the SINK that bound it leaves first
+    void set_sink_owner(const ProcessId &owner) { header()->sink_owner = owner; }
+
+    // The SINK has bound a T. Its shared object is then at object().
+    template <typename T>
+    bool holds() const { return header()->type_hash == typeHash<T>(); }
+    const void *object() const { return base() + header()->object_offset; }
+
+    static bool remove(const std::string &name)
+    {
+        if (Channel::declared(name))
+            return Channel::remove(name);
+
+        Registry::tryRemove(name);
+        return bip::shared_memory_object::remove(name.c_str());
+    }
+
+    static size_t sync_bytes(const size_t max_sources)
+    {
+        return NODE_OFFSET + Node::bytes(max_sources);
+    }
+
+private:
+
+    bip::shared_memory_object shm_;
+    bip::mapped_region region_;
+    std::vector<bip::mapped_region> retired_; //!< Earlier, smaller mappings
+    std::shared_ptr<Channel> channel_; //!< In place of shm_ for in-process nodes
+    std::string name_;
+
+    // Granularity at which the memory policy is applied
+    static size_t pageBytes(const MemoryPolicy &policy)
+    {
+        return policy.huge_pages ? MemoryPolicy::HUGE_PAGE_SIZE
+                                 : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    char *base() const
+    {
+        return channel_ ? channel_->base()
+                        : static_cast<char *>(region_.get_address());
+    }
+    SegmentHeader *header() const
+    {
+        return reinterpret_cast<SegmentHeader *>(base());
+    }
+
+    void map(const bip::mode_t mode, const size_t bytes, const bool populate);
+    void resize(const size_t bytes);
+    Node *openChannel(const size_t max_sources);
+    bool waitForInit(const bip::mode_t mode);
+    bool reclaimStale();
+    void checkHeader() const;
+
+    static uint64_t layout()
+    {
+        return sizeof(SegmentHeader)
+               | sizeof(Node) << 16
+               | static_cast<uint64_t>(sizeof(Node::Reader)) << 32;
+    }
+
+    // FNV-1a of the type's name, which is what managed segments used to
+    // index shared objects by, and its size
+    template <typename T>
+    static uint64_t typeHash()
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (const char *c = typeid(T).name(); *c != '\0'; c++)
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 0x100000001b3;
+
+        return (hash ^ sizeof(T)) * 0x100000001b3;
+    }
+
+    static size_t roundUp(const size_t bytes, const size_t align)
+    {
+        return (bytes + align - 1) / align * align;
+    }
+};
+
+inline Node *Segment::open(const std::string &name, const size_t max_sources)
+{
+    name_ = name;
+
+    if (Channel::declared(name))
+        return openChannel(max_sources);
+
+    while (true) {
+
+        try {
+            shm_ = bip::shared_memory_object(
+                    bip::create_only, name.c_str(), bip::read_write);
+            break;
+        } catch (const bip::interprocess_exception &ex) {
+            if (ex.get_error_code() != bip::already_exists_error)
+                throw;
+        }
+
+        // Another component made the node. If it is removed before it can be
+        // opened, try to make it again.
+        try {
+            shm_ = bip::shared_memory_object(
+                    bip::open_only, name.c_str(), bip::read_write);
+        } catch (const bip::interprocess_exception &ex) {
+            if (ex.get_error_code() != bip::not_found_error)
+                throw;
+            continue;
+        }
+
+        if (!waitForInit(bip::read_write))
+            throw std::runtime_error("Shared memory at '" + name + "' was "
+                    "never initialized. Use oat-clean to remove it.");
+        checkHeader();
+
+        if (reclaimStale())
+            continue;
+
+        node()->releaseDeadSources();
+
+        return node();
+    }
+
+    // This process made the segment. Its pages are zero filled.
+    const auto bytes = sync_bytes(max_sources);
+    shm_.truncate(bytes);
+    map(bip::read_write, bytes, false);
+
+    auto h = new (base()) SegmentHeader();
+    h->layout = layout();
+    h->sync_bytes = bytes;
+    h->bytes = bytes;
+    new (base() + NODE_OFFSET) Node(max_sources);
+
+    // Other processes use the node only once this is seen
+    h->magic.store(SegmentHeader::MAGIC | SegmentHeader::VERSION,
+                   std::memory_order_release);
+
+    // Tools waiting for the node to appear are woken
+    Registry::tryAdd(name);
+
+    return node();
+}
+
+inline Node *Segment::openChannel(const size_t max_sources)
+{
+    // The node is made before any other component of the process can open
+    // the channel. It cannot be left stale by a SINK of another process.
+    channel_ = Channel::open(name_, [max_sources](Channel &c) {
+        const auto bytes = sync_bytes(max_sources);
+        c.resize(bytes);
+
+        auto h = new (c.base()) SegmentHeader();
+        h->layout = layout();
+        h->sync_bytes = bytes;
+        h->bytes = bytes;
+        new (c.base() + NODE_OFFSET) Node(max_sources);
+
+        h->magic.store(SegmentHeader::MAGIC | SegmentHeader::VERSION,
+                       std::memory_order_release);
+    });
+
+    checkHeader();
+
+    return node();
+}
+
+inline const Node *Segment::observe(const std::string &name)
+{
+    name_ = name;
+
+    if (Channel::declared(name)) {
+        channel_ = Channel::find(name);
+        if (channel_ == nullptr)
+            return nullptr;
+        checkHeader();
+        return node();
+    }
+
+    try {
+        shm_ = bip::shared_memory_object(
+                bip::open_only, name.c_str(), bip::read_only);
+    } catch (const bip::interprocess_exception &) {
+        return nullptr;
+    }
+
+    if (!waitForInit(bip::read_only))
+        return nullptr;
+    checkHeader();
+
+    return node();
+}
+
+template <typename T, typename... Targs>
+inline T *Segment::bind(const size_t payload_bytes,
+                        const MemoryPolicy &policy,
+                        Targs &&... args)
+{
+    uint32_t unclaimed = 0;
+    if (!header()->sink_claimed.compare_exchange_strong(unclaimed, 1))
+        return nullptr;
+
+    header()->sink_owner = ProcessId::self();
+
+    // Start the shared object on a fresh page, or huge page, so that the
+    // memory policy covers it and the payload but not the node
+    const size_t object_offset =
+            roundUp(header()->sync_bytes, pageBytes(policy));
+    const size_t payload_offset =
+            roundUp(object_offset + sizeof(T), MemoryPolicy::DATA_ALIGNMENT);
+    const size_t bytes = policy.segmentBytes(payload_offset + payload_bytes);
+
+    resize(bytes);
+    policy.apply(base() + object_offset, bytes - object_offset);
+
+    auto h = header();
+    h->type_hash = typeHash<T>();
+    h->object_offset = object_offset;
+    h->payload_offset = payload_offset;
+    h->bytes = bytes;
+
+    auto obj = new (base() + object_offset) T(std::forward<Targs>(args)...);
+    h->node_layout = describeNode(*obj);
+
+    return obj;
+}
+
+template <typename T>
+inline T *Segment::connect(const bool populate)
+{
+    if (header()->type_hash != typeHash<T>())
+        return nullptr;
+
+    return static_cast<T *>(connectAny(populate));
+}
+
+inline void *Segment::connectAny(const bool populate)
+{
+    const size_t object_offset = header()->object_offset;
+    map(bip::read_write, header()->bytes, populate);
+
+    return base() + object_offset;
+}
+
+inline handle_t Segment::grow(const size_t bytes, const MemoryPolicy &policy)
+{
+    const size_t offset = roundUp(header()->bytes, pageBytes(policy));
+    const size_t total = policy.segmentBytes(offset + bytes);
+
+    resize(total);
+    policy.apply(base() + offset, total - offset);
+
+    // Sources map the new payload when they meet a handle into it
+    header()->bytes = total;
+
+    return offset;
+}
+
+inline void Segment::update(const bool populate)
+{
+    const size_t bytes = header()->bytes;
+    if (bytes > size())
+        map(bip::read_write, bytes, populate);
+}
+
+inline void Segment::map(const bip::mode_t mode,
+                         const size_t bytes,
+                         const bool populate)
+{
+    // A channel is always wholly usable
+    if (channel_)
+        return;
+
+    int options = bip::default_map_options;
+#ifdef MAP_POPULATE
+    if (populate)
+        options = MAP_POPULATE;
+#endif
+
+    // Pointers into the current mapping may still be in use
+    if (region_.get_address() != nullptr)
+        retired_.push_back(std::move(region_));
+
+    region_ = bip::mapped_region(shm_, mode, 0, bytes, nullptr, options);
+}
+
+inline void Segment::resize(const size_t bytes)
+{
+    if (channel_) {
+        channel_->resize(bytes);
+        return;
+    }
+
+    shm_.truncate(bytes);
+    map(bip::read_write, bytes, false);
+}
+
+inline bool Segment::waitForInit(const bip::mode_t mode)
+{
+    // Time allowed for another process to finish making a node that it has
+    // created
+    const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    bip::offset_t bytes = 0;
+
+    // The creator sizes the segment and then fills in the header
+    while (!shm_.get_size(bytes)
+           || bytes < static_cast<bip::offset_t>(sizeof(SegmentHeader))) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    map(mode, static_cast<size_t>(bytes), false);
+
+    while (header()->magic.load(std::memory_order_acquire) == 0) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+inline bool Segment::reclaimStale()
+{
+    auto h = header();
+    if (h->sink_claimed == 0 || h->sink_owner.alive())
+        return false;
+
+    // Only one component removes the segment, so that none can remove the
+    // one made to replace it
+    uint32_t unclaimed = 0;
+    if (h->reclaimed.compare_exchange_strong(unclaimed, 1)) {
+
+        // Sources still reading it leave as though the SINK had exited
+        node()->set_sink_state(NodeState::END);
+        remove(name_);
+
+#ifndef NDEBUG
+        std::cout << "Shared memory at \'" + name_ + "\' left by process "
+                  << h->sink_owner.pid << ", which has exited, was reclaimed.\n";
+#endif
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    region_ = bip::mapped_region();
+    retired_.clear();
+    shm_ = bip::shared_memory_object();
+
+    return true;
+}
+
+inline void Segment::checkHeader() const
+{
+    const auto h = header();
+    if (h->magic != (SegmentHeader::MAGIC | SegmentHeader::VERSION)
+        || h->layout != layout()
+        || size() < h->sync_bytes)
+        throw std::runtime_error("Shared memory at '" + name_ + "' is not an "
+                "Oat node or was made by an incompatible version of Oat. Use "
+                "oat-clean to remove it.");
+}
+
+}      /* namespace oat */
+#endif /* OAT_SEGMENT_H */
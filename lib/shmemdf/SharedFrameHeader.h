@@ -20,13 +20,24 @@
 #ifndef OAT_SHAREDFRAMEHEADER_H
 #define	OAT_SHAREDFRAMEHEADER_H
 
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <boost/interprocess/managed_shared_memory.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "../datatypes/Color.h"
+#include "../datatypes/Sample.h"
+#include "ForwardsDecl.h"
+#include "Node.h"
+#include "NodeLayout.h"
 
 namespace oat {
-namespace bip = boost::interprocess;
+
+// Opaque CUDA IPC memory handle. Holds the bytes of a cudaIpcMemHandle_t so
+// that the header's layout does not depend on CUDA being available.
+using DeviceHandle = std::array<char, 64>;
 
 struct FrameParams {
     size_t cols  {0};
@@ -34,51 +45,295 @@ struct FrameParams {
     int type  {0};
     oat::PixelColor color {oat::PIX_BGR};
     size_t bytes {0};
+    size_t step {0}; //!< Bytes per row, including any padding
 };
 
 /** Header to facilitate zero-copy oat::Frame exchange through shared
   * memory.
   *
   * This class contains everything required to pass Frames through shared
-  * memory without a copy. Basically, this class contains two shmem handles:
-  * data_ and sample_. These handles provide cross-process pointer access to
-  * two blocks of shared memory, one for matrix data and other for sample count
-  * and rate information. Non-pointer members allow construction of Frames at
-  * source and sink end contain this data and sample information.
+  * memory without a copy. Basically, this class contains two shmem handles
+  * per buffer: data_ and sample_. These handles are offsets into the node's
+  * segment of two blocks of its payload, one for matrix data and other for
+  * sample count and rate information. Non-pointer members allow construction
+  * of Frames at source and sink end contain this data and sample information.
+  * When the node is operated as a ring, there is one data/sample handle pair
+  * for each of num_buffers() buffers, and the header publishes the index of
+  * the most recently completed buffer.
+  *
+  * Each buffer carries its own format and the generation of that format.
+  * A SINK may change the format between writes, in which case each buffer
+  * takes the new format, and a new generation, when it is next written.
+  * Sources rebuild their view of a buffer when its generation changes.
+  *
+  * A SINK may also keep its pixel data in GPU memory. The header then holds
+  * a CUDA IPC handle to each device buffer and the host data handles only
+  * back the frames' sample information.
+  *
+  * A header may instead describe a view: a rectangle of the frames of
+  * another, parent, frame node. A view node holds no frames and is never
+  * written. Sources that connect to it follow it to its parent and read the
+  * rectangle in place.
+  *
+  * Each buffer may also host planes derived from its frame, such as its
+  * grey conversion. A plane is computed by the first SYNC source to ask for
+  * it after each write, which claims it with the write's number, and is
+  * read in place by the others once it is ready. The SINK may instead
+  * compute a plane itself before publishing the write, in which case it is
+  * ready before any source looks at it.
   */
 
 class SharedFrameHeader {
 
-    using handle_t = bip::managed_shared_memory::handle_t;
-
 public :
 
-    handle_t sample() const { return sample_; }
-    handle_t data() const { return data_; }
-    FrameParams params() const { return params_; }
+    handle_t sample(const size_t index = 0) const { return sample_[index]; }
+    handle_t data(const size_t index = 0) const { return data_[index]; }
+    size_t num_buffers() const { return num_buffers_; }
+    FrameParams params(const size_t index = 0) const { return params_[index]; }
+
+    /**
+     * @brief Where each buffer's pixels, rows of step bytes, and sample are,
+     * for tools that read nodes of any type.
+     */
+    NodeLayout layout() const
+    {
+        NodeLayout l;
+        l.type = TokenType::Frame;
+
+        l.record.offset = memberOffset(*this, data_[0]);
+        l.record.stride = sizeof(handle_t);
+        l.record.indirect = 1;
+        l.record.sized = 1;
+        l.record.size_offset = memberOffset(*this, data_bytes_[0]);
+        l.record.size_stride = sizeof(size_t);
+
+        l.sample.offset = memberOffset(*this, sample_[0]);
+        l.sample.stride = sizeof(handle_t);
+        l.sample.bytes = sizeof(Sample);
+        l.sample.indirect = 1;
+
+        return l;
+    }
+
+    /**
+     * @brief Generation of the format of a buffer. Zero until the SINK sets
+     * the buffer's parameters. Increases each time the format changes.
+     */
+    uint64_t generation(const size_t index = 0) const
+    {
+        uint64_t g = generation_[index];
+
+        // Format fields must not be read before the generation
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return g;
+    }
+
+    /**
+     * @brief True if pixel data is held in device memory, in which case only
+     * device_data() handles point to valid pixels.
+     */
+    bool on_device() const { return on_device_; }
+    const DeviceHandle &device_data(const size_t index = 0) const
+    {
+        return device_data_[index];
+    }
+    size_t device_step() const { return device_step_; }
+
+    /**
+     * @brief Number of frames the SINK has finished writing.
+     */
+    uint64_t completed_writes() const { return completed_writes_; }
+
+    /**
+     * @brief Index of the buffer holding the latest completed frame. Zero if
+     * no frame has been written yet.
+     */
+    size_t latest_index() const
+    {
+        uint64_t n = completed_writes_;
+        return n == 0 ? 0 : (n - 1) % num_buffers_;
+    }
+
+    /**
+     * @brief Mark a write as complete. Called by the SINK before it notifies
+     * its sources.
+     * @param write_number Node write number of the completed write.
+     */
+    void publish(const uint64_t write_number)
+    {
+        completed_writes_ = write_number + 1;
+    }
 
     /**
      * Set header data fields.
      *
-     * @param data Interprocess handle to matrix data pointer
-     * @param sample Interprocess handle to frame sample struct pointer
+     * @param data Interprocess handles to matrix data pointers, one per buffer
+     * @param sample Interprocess handles to frame sample struct pointers, one
+     * per buffer
      * @param rows Number of rows in the matrix
      * @param cols Number of columns in the matrix
      * @param type OpenCV cv::Mat type of the frame
+     * @param color Pixel color of the frame
+     * @param step Bytes per matrix row, including padding
+     * @param generation Generation of the format
      */
-    void setParameters(const handle_t data,
-                       const handle_t sample,
+    void setParameters(const std::vector<handle_t> &data,
+                       const std::vector<handle_t> &sample,
                        const size_t rows,
                        const size_t cols,
                        const int type,
-                       const oat::PixelColor color)
+                       const oat::PixelColor color,
+                       const size_t step,
+                       const uint64_t generation = 1)
     {
-        data_ = data;
-        sample_ = sample;
-        params_.rows = rows;
-        params_.cols = cols;
-        params_.type = type;
-        params_.color = color;
+        if (data.size() != sample.size() || data.size() > data_.size())
+            throw std::runtime_error("Invalid number of shared frame buffers.");
+
+        num_buffers_ = data.size();
+        std::copy(sample.begin(), sample.end(), sample_.begin());
+
+        FrameParams p;
+        p.rows = rows;
+        p.cols = cols;
+        p.type = type;
+        p.color = color;
+        p.step = step;
+        for (size_t i = 0; i < num_buffers_; i++)
+            setFormat(i, data[i], p, generation);
+    }
+
+    /**
+     * Change the format of a single buffer. Only the SINK may call this, and
+     * only for the buffer it is writing.
+     *
+     * @param index Buffer index
+     * @param data Interprocess handle to the buffer's matrix data
+     * @param params Format of the buffer
+     * @param generation Generation of the format
+     */
+    void setFormat(const size_t index,
+                   const handle_t data,
+                   const FrameParams &params,
+                   const uint64_t generation)
+    {
+        if (index >= num_buffers_)
+            throw std::runtime_error("Invalid shared frame buffer index.");
+
+        data_[index] = data;
+        params_[index] = params;
+        data_bytes_[index] = params.rows * params.step;
+
+        // Format fields must be seen before the generation
+        std::atomic_thread_fence(std::memory_order_release);
+        generation_[index] = generation;
+    }
+
+    /**
+     * Move pixel data to device memory. Must follow setParameters().
+     *
+     * @param data CUDA IPC handles to device buffers, one per buffer
+     * @param step Bytes per device buffer row, including padding
+     */
+    void setDeviceData(const std::vector<DeviceHandle> &data,
+                       const size_t step)
+    {
+        if (data.size() != num_buffers_)
+            throw std::runtime_error("Invalid number of device frame buffers.");
+
+        std::copy(data.begin(), data.end(), device_data_.begin());
+        device_step_ = step;
+        on_device_ = true;
+    }
+
+    // Derived planes that each buffer can host
+    static constexpr size_t MAX_PLANES {6};
+
+    /**
+     * @brief Derived plane of a buffer. Hosted while its generation matches
+     * that of the buffer's format.
+     */
+    struct Plane {
+        handle_t data {0};
+        FrameParams params;
+        uint64_t generation {0}; //!< Format generation it was laid out for
+        std::atomic<uint64_t> claimed {0}; //!< Write number + 1 being computed
+        std::atomic<uint64_t> ready {0};   //!< Write number + 1 computed
+    };
+
+    Plane &plane(const size_t index, const size_t plane)
+    {
+        return planes_[index][plane];
+    }
+
+    /**
+     * @brief True if a buffer hosts a plane for its current format.
+     */
+    bool hosts(const size_t index, const size_t plane) const
+    {
+        const auto g = planes_[index][plane].generation;
+        return g != 0 && g == generation_[index];
+    }
+
+    /**
+     * Lay out a plane of a buffer for a format generation. Only the SINK may
+     * call this, and only before it sets the buffer's format, so that sources
+     * see the plane along with the format.
+     *
+     * @param index Buffer index
+     * @param plane Plane index
+     * @param data Interprocess handle to the plane's matrix data
+     * @param params Format of the plane
+     * @param generation Generation of the buffer format it derives from
+     */
+    /**
+     * @brief Filter of the frame pyramid levels among the planes, as a
+     * PyramidFilter. Set by the SINK when it binds.
+     */
+    uint32_t pyramid_filter() const { return pyramid_filter_; }
+    void set_pyramid_filter(const uint32_t filter) { pyramid_filter_ = filter; }
+
+    void setPlane(const size_t index,
+                  const size_t plane,
+                  const handle_t data,
+                  const FrameParams &params,
+                  const uint64_t generation)
+    {
+        auto &p = planes_[index][plane];
+        p.data = data;
+        p.params = params;
+        p.generation = generation;
+    }
+
+    // Longest parent address that a view can refer to, including the
+    // terminating null
+    static constexpr size_t MAX_PARENT_BYTES {256};
+
+    /**
+     * @brief True if this header is a view of a rectangle of a parent node's
+     * frames rather than a node with frames of its own.
+     */
+    bool is_view() const { return parent_[0] != '\0'; }
+    const char *view_parent() const { return parent_; }
+    cv::Rect view_rect() const { return view_rect_; }
+
+    /**
+     * Make this header a view. Must be called before the SINK marks the
+     * node bound.
+     *
+     * @param parent Address of the parent frame node
+     * @param rect Rectangle of the parent's frames in pixels
+     */
+    void setView(const std::string &parent, const cv::Rect &rect)
+    {
+        if (parent.empty() || parent.size() >= MAX_PARENT_BYTES)
+            throw std::runtime_error("View parent addresses must be between 1 "
+                                     "and " + std::to_string(MAX_PARENT_BYTES - 1)
+                                     + " characters long.");
+
+        std::copy(parent.begin(), parent.end(), parent_);
+        parent_[parent.size()] = '\0';
+        view_rect_ = rect;
     }
 
 private :
@@ -88,12 +343,31 @@ private :
     // are manipulated by bind() and connect() methods without semaphore
     // protection though. But, only bind writes.
 
-    // Matrix metadata
-    FrameParams params_;
+    // Matrix metadata and its generation, per buffer
+    std::array<FrameParams, Node::MAX_BUFFERS> params_;
+    std::array<uint64_t, Node::MAX_BUFFERS> generation_ {{}};
 
     // Interprocess matrix data and sample handles
-    handle_t data_;
-    handle_t sample_;
+    size_t num_buffers_ {0};
+    std::array<handle_t, Node::MAX_BUFFERS> data_;
+    std::array<handle_t, Node::MAX_BUFFERS> sample_;
+    std::array<size_t, Node::MAX_BUFFERS> data_bytes_ {{}};
+
+    // Device pixel data, if any
+    bool on_device_ {false};
+    size_t device_step_ {0};
+    std::array<DeviceHandle, Node::MAX_BUFFERS> device_data_;
+
+    // Latest completed write, read by sources without taking the node mutex
+    std::atomic<uint64_t> completed_writes_ {0};
+
+    // Parent node and rectangle, if this header is a view
+    char parent_[MAX_PARENT_BYTES] {};
+    cv::Rect view_rect_;
+
+    // Derived planes, per buffer
+    std::array<std::array<Plane, MAX_PLANES>, Node::MAX_BUFFERS> planes_;
+    uint32_t pyramid_filter_ {0};
 };
 
 }       /* namespace oat */
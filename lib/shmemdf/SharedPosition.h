@@ -0,0 +1,166 @@
+//******************************************************************************
+//* File:   SharedPosition.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_SHAREDPOSITION_H
+#define	OAT_SHAREDPOSITION_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "../datatypes/Position2D.h"
+#include "Node.h"
+#include "NodeLayout.h"
+
+namespace oat {
+
+/** Shared memory layout of a position node.
+  *
+  * Positions are exchanged as fixed-size PositionRecords, one per buffer,
+  * rather than as whole Position2D objects, so each write and read copies
+  * only the per-sample data. The label, unit of length and homography are
+  * written once per node by its SINK. When the node is operated as a ring,
+  * the header publishes the index of the most recently completed record.
+  * The SINK may also keep a PositionHistoryRing of recent positions in the
+  * node's payload, whose capacity the header records.
+  */
+class SharedPosition {
+
+public :
+
+    explicit SharedPosition(const std::string &label)
+    {
+        strncpy(label_, label.c_str(), sizeof(label_));
+        label_[sizeof(label_) - 1] = '\0';
+    }
+
+    const char *label() const { return label_; }
+    size_t num_buffers() const { return num_buffers_; }
+    DistanceUnit unit_of_length() const { return unit_of_length_; }
+
+    cv::Matx33d homography() const
+    {
+        cv::Matx33d h;
+        std::copy(homography_, homography_ + 9, h.val);
+        return h;
+    }
+
+    PositionRecord &record(const size_t index) { return records_[index]; }
+    const PositionRecord &record(const size_t index) const { return records_[index]; }
+
+    /**
+     * @brief Where each buffer's record and sample are, for tools that read
+     * nodes of any type.
+     */
+    NodeLayout layout() const
+    {
+        NodeLayout l;
+        l.type = TokenType::Position;
+
+        l.record.offset = memberOffset(*this, records_[0]);
+        l.record.stride = sizeof(PositionRecord);
+        l.record.bytes = sizeof(PositionRecord);
+
+        l.sample.offset = memberOffset(*this, records_[0].sample);
+        l.sample.stride = sizeof(PositionRecord);
+        l.sample.bytes = sizeof(Sample);
+
+        return l;
+    }
+
+    /**
+     * @brief Check if the node's coordinate system is the given one.
+     */
+    bool hasCoordSystem(const DistanceUnit unit,
+                        const cv::Matx33d &homography) const
+    {
+        return unit == unit_of_length_
+               && std::equal(homography_, homography_ + 9, homography.val);
+    }
+
+    void setCoordSystem(const DistanceUnit unit, const cv::Matx33d &homography)
+    {
+        unit_of_length_ = unit;
+        std::copy(homography.val, homography.val + 9, homography_);
+    }
+
+    void set_num_buffers(const size_t num_buffers)
+    {
+        if (num_buffers == 0 || num_buffers > records_.size())
+            throw std::runtime_error("Invalid number of shared position buffers.");
+
+        num_buffers_ = num_buffers;
+    }
+
+    /**
+     * @brief Capacity of the history ring in the node's payload. Zero if the
+     * node keeps no history.
+     */
+    size_t history_capacity() const { return history_capacity_; }
+    void set_history_capacity(const size_t capacity)
+    {
+        history_capacity_ = capacity;
+    }
+
+    /**
+     * @brief Number of positions the SINK has finished writing.
+     */
+    uint64_t completed_writes() const { return completed_writes_; }
+
+    /**
+     * @brief Index of the record holding the latest completed position. Zero
+     * if no position has been written yet.
+     */
+    size_t latest_index() const
+    {
+        uint64_t n = completed_writes_;
+        return n == 0 ? 0 : (n - 1) % num_buffers_;
+    }
+
+    /**
+     * @brief Mark a write as complete. Called by the SINK before it notifies
+     * its sources.
+     * @param write_number Node write number of the completed write.
+     */
+    void publish(const uint64_t write_number)
+    {
+        completed_writes_ = write_number + 1;
+    }
+
+private :
+
+    // Written once by the SINK
+    char label_[Position2D::LABEL_LEN] {0};
+    DistanceUnit unit_of_length_ {DistanceUnit::PIXELS};
+    double homography_[9] {1.0, 0, 0, 0, 1.0, 0, 0, 0, 1.0};
+    size_t num_buffers_ {1};
+    size_t history_capacity_ {0};
+
+    // Per-sample data
+    std::array<PositionRecord, Node::MAX_BUFFERS> records_;
+
+    // Latest completed write, read by sources without taking the node mutex
+    std::atomic<uint64_t> completed_writes_ {0};
+};
+
+}       /* namespace oat */
+#endif	/* OAT_SHAREDPOSITION_H */
@@ -20,20 +20,30 @@
 #ifndef OAT_SINK_H
 #define	OAT_SINK_H
 
-#include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/thread/thread_time.hpp>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "../datatypes/Color.h"
 #include "../datatypes/Frame.h"
+#include "../datatypes/Position2D.h"
 #include "../datatypes/Sample.h"
 #include "../base/Globals.h"
 
+#include "DeviceMemory.h"
 #include "ForwardsDecl.h"
+#include "FramePlanes.h"
+#include "MemoryPolicy.h"
 #include "Node.h"
+#include "Segment.h"
 #include "SharedFrameHeader.h"
+#include "PositionBus.h"
+#include "PositionHistoryRing.h"
+#include "SharedPosition.h"
 
 namespace oat {
 
@@ -50,17 +60,86 @@ public:
     void wait();
     void post();
 
+    /**
+     * @brief Make this sink one of several that publish to a merge node. Must
+     * be called before binding. The first sink to bind creates the node and
+     * sets its reorder window. The others join it and share its shared
+     * object. Sources read the samples of all sinks in Sample::count()
+     * order. Merge sinks publish with wait(count) rather than wait().
+     * @param window Samples by which another sink's last count may lag the
+     * count being written before it is no longer waited for. Samples it then
+     * publishes behind the stream are dropped.
+     */
+    void set_merge(const uint64_t window);
+
+    /**
+     * @brief Wait for the turn of a merge sink to write a sample, and then
+     * for sources to read, as wait() does. Followed by post() only if it
+     * returns true.
+     * @param count Sample::count() of the sample to be written.
+     * @return False if a later sample was already published, so that this
+     * one is dropped, or if quit was set while waiting.
+     */
+    bool wait(const uint64_t count);
+
+    bool merge() const { return merge_; }
+
+    /**
+     * @brief Whether wait() would return without sleeping, i.e. every SYNC
+     * source has read the buffer that is written next. Only a hint, since
+     * sources may read or attach before the call to wait(). Sinks that are
+     * not bound are always writable.
+     */
+    bool writable() const { return !bound_ || node_->writable(); }
+
+    /**
+     * @brief Event of the node, advanced whenever writable() may have become
+     * true, or nullptr if the sink is not bound. Lets a scheduler sleep on
+     * several nodes at once through SampleEvent::waitAny().
+     */
+    SampleEvent *sample_event() const
+    {
+        return bound_ ? &node_->sample_event() : nullptr;
+    }
+
+    /**
+     * @brief Loss counters of the link this sink's data arrives over, e.g.
+     * from a GigE camera, shown by observers such as oat-top. Must be bound.
+     */
+    TransportTelemetry &transport() { return node_->sink_telemetry().transport; }
+
 protected:
 
     std::string address_;
-    shmem_t node_shmem_, obj_shmem_;
+    Segment segment_;
     Node * node_ {nullptr};
     T * sh_object_ {nullptr};
-    std::string node_address_, obj_address_;
+    std::string node_address_;
     bool bound_ {false};
-
-private:
     bool did_wait_need_post_ {false};
+
+    // Merge node producer slot
+    bool merge_ {false};
+    uint64_t merge_window_ {0};
+    size_t producer_ {0};
+
+    // Wait for sources to read the buffer that is written next
+    void waitForBuffer();
+
+    /**
+     * @brief Open the node at address and construct its shared object in the
+     * node's segment, followed by payload_bytes of payload. The node is not
+     * marked bound until the caller has finished setting it up.
+     * @param address Node address.
+     * @param payload_bytes Bytes to reserve after the shared object.
+     * @param policy Page placement of the shared object and payload.
+     * @param args Shared object constructor arguments.
+     */
+    template <typename... Targs>
+    void bindNode(const std::string &address,
+                  const size_t payload_bytes,
+                  const MemoryPolicy &policy,
+                  Targs &&... args);
 };
 
 template <typename T>
@@ -75,21 +154,103 @@ inline SinkBase<T>::~SinkBase()
     // Detach this server from shared mat header
     if (bound_) {
 
+        // Other sinks of a merge node carry on without this one
+        if (merge_ && !node_->leaveProducer(producer_)) {
+            ProcessId owner;
+            if (node_->anyProducer(owner))
+                segment_.set_sink_owner(owner);
+            return;
+        }
+
         node_->set_sink_state(NodeState::END);
 
         // If the client ref count is 0, memory can be deallocated
-        if (node_->source_ref_count() == 0 &&
-            bip::shared_memory_object::remove(node_address_.c_str()) &&
-            bip::shared_memory_object::remove(obj_address_.c_str())) {
+        if (node_->source_ref_count() == 0 && Segment::remove(node_address_)) {
 
 #ifndef NDEBUG
         std::cout << "Shared memory at \'" + node_address_ +
-                "\' and \'" + obj_address_ + "\' was deallocated.\n";
+                "\' was deallocated.\n";
 #endif
         }
     }
 }
 
+template <typename T>
+template <typename... Targs>
+inline void SinkBase<T>::bindNode(const std::string &address,
+                                  const size_t payload_bytes,
+                                  const MemoryPolicy &policy,
+                                  Targs &&... args)
+{
+    if (bound_)
+        throw std::runtime_error("A sink can only bind a "
+                                 "single time to a single node.");
+
+    // Address for this block of shared memory
+    address_ = address;
+    node_address_ = address + "_node";
+
+    // Define shared memory. The node's reader table is sized when the node is
+    // created by whichever of the SINK or SOURCEs arrives first.
+    node_ = segment_.open(node_address_, Node::default_max_sources());
+
+    // Make sure there is not another SINK using this shmem
+    if (node_->sink_state() == NodeState::UNDEFINED)
+        sh_object_ = segment_.template bind<T>(
+                payload_bytes, policy, std::forward<Targs>(args)...);
+
+    if (merge_ && sh_object_ != nullptr) {
+
+        // First sink of a merge node
+        if (node_->joinProducer(producer_, merge_window_) != 0)
+            throw std::runtime_error("Requested SINK address, '" + address
+                                     + "', could not be made a merge node.");
+
+    } else if (merge_) {
+
+        // Another sink may still be setting up the node it created
+        const auto deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (node_->sink_state() == NodeState::UNDEFINED
+               && std::chrono::steady_clock::now() < deadline) {
+            const auto seen = node_->state_generation();
+            if (node_->sink_state() != NodeState::UNDEFINED)
+                break;
+            node_->awaitStateChange(seen, std::chrono::milliseconds(10));
+        }
+
+        // Join it if it is a merge node
+        if (node_->sink_state() == NodeState::SINK_BOUND && node_->merge()) {
+            node_->releaseDeadProducers();
+            if (node_->joinProducer(producer_, merge_window_) != 0)
+                throw std::runtime_error("Merge node at '" + address
+                                         + "' has no free SINK slots.");
+            sh_object_ = segment_.template connect<T>(false);
+        }
+    }
+
+    if (sh_object_ == nullptr) {
+
+        // There is already a SINK using this shmem
+        throw (std::runtime_error(
+                "Requested SINK address, '" + address + "', is not available."));
+    }
+
+    // Growing the segment maps it again
+    node_ = segment_.node();
+}
+
+template <typename T>
+inline void SinkBase<T>::set_merge(const uint64_t window)
+{
+    if (bound_)
+        throw std::runtime_error("A sink must be made a merge sink before it "
+                                 "binds.");
+
+    merge_ = true;
+    merge_window_ = window;
+}
+
 template <typename T>
 inline void SinkBase<T>::wait()
 {
@@ -101,16 +262,89 @@ inline void SinkBase<T>::wait()
         throw std::runtime_error("wait() called when post() was required.");
 #endif
 
+    if (merge_)
+        throw std::runtime_error("Merge sinks must wait with the count of the "
+                                 "sample they write.");
+
+    waitForBuffer();
+}
+
+template <typename T>
+inline bool SinkBase<T>::wait(const uint64_t count)
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if(!bound_)
+        throw std::runtime_error("Sink must be bound before calling wait()");
+    if (did_wait_need_post_)
+        throw std::runtime_error("wait() called when post() was required.");
+#endif
+
+    if (!merge_) {
+        waitForBuffer();
+        return true;
+    }
+
+    // Sleep until another sink writes, offers a later count or leaves. Sinks
+    // that died holding the node back are looked for once in a while.
+    SampleEvent *event = &node_->sample_event();
+    size_t polls = 0;
+    while (!quit) {
+
+        const uint32_t seen = event->generation();
+        const auto turn = node_->requestTurn(producer_, count);
+        if (turn == Node::Turn::GRANTED)
+            break;
+        if (turn == Node::Turn::STALE)
+            return false;
+
+        SampleEvent::waitAny(&event, &seen, 1, std::chrono::milliseconds(10));
+        if (++polls % 100 == 0)
+            node_->releaseDeadProducers();
+    }
+
+    if (quit) {
+        node_->cancelTurn(producer_);
+        return false;
+    }
+
+    waitForBuffer();
+
+    return true;
+}
+
+template <typename T>
+inline void SinkBase<T>::waitForBuffer()
+{
+    const auto wait_start = telemetryNow();
+
+#ifdef USE_FUTEX
+    // Only wait if there is a SYNC SOURCE attached to the node. Sleep until
+    // a read completes, a source detaches, or a signal interrupts the wait.
+    // The sleep is bounded because quit can be set without a signal to this
+    // thread.
+    while (node_->sync_ref_count() > 0 &&
+          !node_->write_barrier.wait_for(std::chrono::milliseconds(100)) &&
+          !quit) {
+        // Interrupted or timed out, but not by quit
+    }
+#else
     boost::system_time timeout = boost::get_system_time() + msec_t(10);
 
-    // Only wait if there is a SOURCE attached to the node
+    // Only wait if there is a SYNC SOURCE attached to the node
     // Wait with timed wait with period check to prevent deadlocks
-    while (node_->source_ref_count() > 0 &&
+    while (node_->sync_ref_count() > 0 &&
           !node_->write_barrier.timed_wait(timeout) &&
           !quit) {
         // Loops checking if wait has been released
         timeout = boost::get_system_time() + msec_t(10);
     }
+#endif
+
+    node_->sink_telemetry().wait.record(telemetryNow() - wait_start);
+
+    // The sink is now free to write the shared object
+    node_->notifySinkWriteStart();
 
     did_wait_need_post_ = true;
 }
@@ -129,6 +363,15 @@ inline void SinkBase<T>::post()
     // Increment the number times this node has facilitated a shmem write
     node_->notifySinkWriteComplete();
 
+    if (merge_)
+        node_->releaseTurn(producer_);
+
+    auto &telemetry = node_->sink_telemetry();
+    const auto now = telemetryNow();
+    const auto last = telemetry.last_post_ns.exchange(now, std::memory_order_relaxed);
+    if (last != 0)
+        telemetry.write_interval.record(now - last);
+
     did_wait_need_post_ = false;
 
 #ifndef NDEBUG
@@ -144,14 +387,10 @@ inline void SinkBase<T>::post()
 template <typename T>
 class Sink : public SinkBase<T> {
 
-    using SinkBase<T>::address_;
-    using SinkBase<T>::node_address_;
-    using SinkBase<T>::obj_address_;
-    using SinkBase<T>::node_shmem_;
-    using SinkBase<T>::obj_shmem_;
     using SinkBase<T>::node_;
     using SinkBase<T>::sh_object_;
     using SinkBase<T>::bound_;
+    using SinkBase<T>::did_wait_need_post_;
 
 public:
 
@@ -159,51 +398,44 @@ public:
     void bind(const std::string &address, Targs... args);
     T * retrieve();
 
+    /**
+     * @brief Notify sources that they may read. Shared objects that carry a
+     * sample, such as positions, have their publication time stamped into
+     * it first.
+     */
+    void post();
+
+private:
+
+    template <typename U>
+    static auto stampSample(U *obj, int) -> decltype(obj->stampSample(), void())
+    {
+        obj->stampSample();
+    }
+
+    template <typename U>
+    static void stampSample(U *, long) { }
 };
 
 template <typename T>
 template <typename... Targs>
 inline void Sink<T>::bind(const std::string &address, Targs... args)
 {
-    if (bound_)
-        throw std::runtime_error("A sink can only bind a "
-                                 "single time to a single node.");
+    this->bindNode(address, 0, MemoryPolicy(), args...);
 
-    // Addresses for this block of shared memory
-    address_ = address;
-    node_address_ = address + "_node";
-    obj_address_ = address + "_obj";
-
-    // Define shared memory
-    // Extra 1024 bytes are used to hold managed shared mem helper objects
-    // (name-object index, internal synchronization objects, internal
-    // variables...)
-    node_shmem_ = bip::managed_shared_memory(
-            bip::open_or_create,
-            node_address_.c_str(),
-            1024 + sizeof(Node));
-
-    // Bind to a node which facilitates synchronized access to shmem
-    node_ = node_shmem_.template find_or_construct<Node>(typeid(Node).name())();
-
-    // Make sure there is not another SINK using this shmem
-    if (node_->sink_state() != NodeState::UNDEFINED) {
-
-        // There is already a SINK using this shmem
-        throw (std::runtime_error(
-                "Requested SINK address, '" + address + "', is not available."));
-    } else {
+    // Sinks joining a merge node find it bound already
+    if (node_->sink_state() != NodeState::SINK_BOUND)
+        node_->set_sink_state(NodeState::SINK_BOUND);
+    bound_ = true;
+}
 
-        obj_shmem_ = bip::managed_shared_memory(
-            bip::create_only,
-            obj_address_.c_str(),
-            1024 + sizeof (T));
+template <typename T>
+inline void Sink<T>::post()
+{
+    if (bound_ && did_wait_need_post_)
+        stampSample(sh_object_, 0);
 
-        // Find an existing shared object or construct one
-        sh_object_ = obj_shmem_.template find_or_construct<T>(typeid(T).name())(args...);
-        node_->set_sink_state(NodeState::SINK_BOUND);
-        bound_ = true;
-    }
+    SinkBase<T>::post();
 }
 
 template <typename T>
@@ -224,77 +456,674 @@ template <>
 class Sink<Frame> : public SinkBase<SharedFrameHeader> {
 
 public:
-    void bind(const std::string &address, const size_t bytes);
+    /**
+     * @brief Bind a frame node.
+     * @param address Node address.
+     * @param bytes Number of bytes of pixel data per frame.
+     * @param num_buffers Number of frame buffers written round-robin. When
+     * greater than 1, sources may lag the sink by up to num_buffers - 1
+     * frames before the sink blocks.
+     *
+     * Huge pages, prefaulting, NUMA placement and row padding of the frame
+     * segment are taken from the environment. See
+     * MemoryPolicy::fromEnvironment(). So are the derived planes that the
+     * node hosts for its sources. See planesFromEnvironment().
+     */
+    void bind(const std::string &address,
+              const size_t bytes,
+              const size_t num_buffers = 1);
+
+    /**
+     * @brief Host derived planes of each frame and compute them in post(),
+     * before the frame is published, rather than leaving them to the first
+     * source that asks for them. Sources then never wait for them. Must be
+     * called before bind(). They are hosted along with the planes taken from
+     * the environment.
+     * @param planes Mask of (1 << FramePlane) bits. Pyramid levels bring the
+     * levels above them.
+     * @param filter Filter that the frame pyramid levels are halved with.
+     */
+    void set_planes(const uint32_t planes,
+                    const PyramidFilter filter = PyramidFilter::AREA)
+    {
+        computed_planes_ = withPyramidParents(planes);
+        pyramid_filter_ = filter;
+    }
+
+    /**
+     * @brief Fault in every page of the frame segment when it is bound, as
+     * OAT_PREFAULT=1 does, so that the first frames written do not take the
+     * page faults. Must be called before bind().
+     */
+    void set_prefault(const bool prefault) { prefault_ = prefault; }
+
+    /**
+     * @brief Bind a view node, which publishes a rectangle of the frames of
+     * a parent frame node without holding pixels of its own. Sources that
+     * connect to the view read the rectangle in place from the parent, in
+     * step with its sink, as though they had connected to the parent. A view
+     * is never written: wait(), post() and retrieve() must not be used.
+     * @param address Node address.
+     * @param parent_address Address of the parent frame node.
+     * @param rect Rectangle of the parent's frames in pixels. It is clipped
+     * to the parent's frames by each source.
+     */
+    void bindView(const std::string &address,
+                  const std::string &parent_address,
+                  const cv::Rect &rect);
+
+    /**
+     * @brief Allocate shared frame buffers. Pixel data blocks are aligned to
+     * MemoryPolicy::DATA_ALIGNMENT bytes.
+     * @param step Bytes per row. If 0, rows are packed, or padded to
+     * MemoryPolicy::DATA_ALIGNMENT bytes when the memory policy requests it
+     * and the padding fits. Writers that fill the buffer with their own
+     * stride, such as camera drivers, should pass it here.
+     * @return The frame to be written on the first write.
+     */
     oat::Frame retrieve(const size_t rows, size_t cols, const int type, const
-            oat::PixelColor color);
+            oat::PixelColor color, const size_t step = 0);
+
+    /**
+     * @brief Get the shared frame that should be written during the current
+     * critical section. In ring mode, that is, with more than one buffer, this
+     * must be called after each wait(). The sample information of the
+     * previous write is carried into the returned frame so that sample counts
+     * continue across buffers.
+     * @return The frame to be written.
+     */
+    oat::Frame retrieve();
+
+    /**
+     * @brief Change the format of the frames written from now on without
+     * rebinding the node. Must be called between wait() and post(). The
+     * buffer being written takes the new format now and, in ring mode, each
+     * other buffer takes it when it is next written, so frames that sources
+     * have yet to read are untouched. A frame that no longer fits its buffer
+     * is moved to new space at the end of the node's segment. Sources follow
+     * each change as they reach the first frame written in the new format.
+     * @param step Bytes per row. If 0, rows are packed, or padded as the
+     * memory policy requests.
+     * @return The frame to be written.
+     */
+    oat::Frame reformat(const size_t rows, size_t cols, const int type, const
+            oat::PixelColor color, const size_t step = 0);
+
+    /**
+     * @brief Lend the shared frame that the next post() will publish so that
+     * it can be written in place rather than copied into. The frame is only
+     * valid between wait() and post().
+     * @return The frame to be written.
+     */
+    oat::Frame borrow();
+
+#ifdef HAVE_CUDA
+    /**
+     * @brief Allocate shared frame buffers whose pixel data lives in device
+     * memory. The returned host frames carry sample information only; pixels
+     * are written through borrowDevice(). Only sources that accept device
+     * frames can connect.
+     * @return The frame to be written on the first write.
+     */
+    oat::Frame retrieveDevice(const size_t rows, size_t cols, const int type,
+            const oat::PixelColor color);
+
+    /**
+     * @brief Lend the device buffer that the next post() will publish. Only
+     * valid between wait() and post().
+     * @return Device frame to be written.
+     */
+    cv::cuda::GpuMat borrowDevice();
+
+    bool on_device() const { return !device_buffers_.empty(); }
+#endif
+
+    /**
+     * @brief Publish the frame written during this critical section as the
+     * latest completed frame and notify sources that they may read it.
+     */
+    void post();
+
+    size_t num_buffers() const { return num_buffers_; }
+
+private:
+    size_t num_buffers_ {1};
+    size_t block_bytes_ {0}; //!< Bytes reserved for each buffer's pixel data
+    size_t slot_bytes_ {0};  //!< Bytes of payload used by each buffer
+    MemoryPolicy policy_;
+    std::vector<oat::Frame> frames_;
+
+    // Frame format and where each buffer's pixel data lives
+    FrameParams format_; //!< Format of the frames written from now on
+    uint64_t generation_ {0}; //!< Generation of format_
+    std::vector<uint64_t> generations_; //!< Generation of each buffer's format
+    std::vector<handle_t> data_; //!< Pixel data of each buffer
+    std::vector<size_t> capacity_; //!< Bytes available at each data_ handle
+
+    // Derived planes hosted for sources, as a mask of FramePlane bits, and
+    // where each buffer's planes live
+    using PlaneHandles = std::array<handle_t, SharedFrameHeader::MAX_PLANES>;
+    using PlaneBytes = std::array<size_t, SharedFrameHeader::MAX_PLANES>;
+    uint32_t planes_ {0};
+    std::vector<PlaneHandles> plane_data_;
+    std::vector<PlaneBytes> plane_capacity_;
+
+    // Planes computed by post() rather than by sources, and the filter of
+    // the node's frame pyramid
+    uint32_t computed_planes_ {0};
+    PyramidFilter pyramid_filter_ {PyramidFilter::AREA};
+
+    // Prefault the segment whatever the environment asks
+    bool prefault_ {false};
+
+#ifdef HAVE_CUDA
+    DeviceBuffers device_buffers_;
+    size_t device_step_ {0};
+#endif
+
+    static size_t alignData(const size_t bytes)
+    {
+        return (bytes + MemoryPolicy::DATA_ALIGNMENT - 1)
+               / MemoryPolicy::DATA_ALIGNMENT * MemoryPolicy::DATA_ALIGNMENT;
+    }
+
+    void setFormat(const size_t rows, const size_t cols, const int type,
+                   const oat::PixelColor color, const size_t step);
+
+    // Give a buffer the current format
+    void formatBuffer(const size_t index);
+
+    // Lay out the derived planes of a buffer for the current format. Must
+    // precede the buffer's format being set in the header.
+    void layoutPlanes(const size_t index);
+
+    // Compute the computed_planes_ of the buffer being written
+    void computePlanes(const size_t index);
 };
 
-inline void Sink<Frame>::bind(const std::string &address, const size_t bytes)
+inline void Sink<Frame>::bind(const std::string &address,
+                              const size_t bytes,
+                              const size_t num_buffers)
 {
-    if (bound_)
-        throw std::runtime_error("A sink can only bind a "
-                                 "single time to a single node.");
+    if (num_buffers == 0 || num_buffers > Node::MAX_BUFFERS)
+        throw std::runtime_error("Number of frame buffers must be between 1 "
+                                 "and " + std::to_string(Node::MAX_BUFFERS) + ".");
 
-    // Addresses for this block of shared memory
-    address_ = address;
-    node_address_ = address + "_node";
-    obj_address_ = address + "_obj";
+    // Frames are written in place and may be reformatted by their sink
+    if (merge_)
+        throw std::runtime_error("Frame nodes cannot be merge nodes.");
 
-    // Define shared memory
-    node_shmem_ = bip::managed_shared_memory(
-            bip::open_or_create,
-            node_address_.c_str(),
-            1024  + sizeof(Node));
+    // Each buffer holds its sample followed by its pixel data
+    policy_ = MemoryPolicy::fromEnvironment();
+    policy_.prefault |= prefault_;
+    block_bytes_ = policy_.blockBytes(bytes);
+    slot_bytes_ = alignData(sizeof(oat::Sample)) + alignData(block_bytes_);
 
-    // Facilitates synchronized access to shmem
-    node_ = node_shmem_.find_or_construct<Node>(typeid(Node).name())();
+    planes_ = planesFromEnvironment() | computed_planes_;
 
-    // Make sure there is not another SINK using this shmem
-    if (node_->sink_state() != NodeState::UNDEFINED) {
+    // Pages are placed before any source maps the payload
+    bindNode(address, num_buffers * slot_bytes_, policy_);
+    sh_object_->set_pyramid_filter(static_cast<uint32_t>(pyramid_filter_));
 
-        // There is already a SINK using this shmem
-        throw (std::runtime_error(
-                "Requested SINK address, '" + address + "', is not available."));
-    } else {
+    num_buffers_ = num_buffers;
+    node_->set_num_buffers(num_buffers_);
+    node_->set_sink_state(NodeState::SINK_BOUND);
+    bound_ = true;
+}
 
-        // Object shared memory
-        obj_shmem_ = bip::managed_shared_memory(
-            bip::create_only,
-            obj_address_.c_str(),
-            1024 + sizeof(SharedFrameHeader) + bytes + sizeof(uint64_t));
+inline void Sink<Frame>::bindView(const std::string &address,
+                                  const std::string &parent_address,
+                                  const cv::Rect &rect)
+{
+    if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0)
+        throw std::runtime_error("View '" + address + "' must be a non-empty "
+                                 "rectangle at non-negative coordinates.");
 
-        // Find an existing shared object or construct one
-        sh_object_ = obj_shmem_.find_or_construct<SharedFrameHeader>(typeid(SharedFrameHeader).name())();
+    if (parent_address == address)
+        throw std::runtime_error("View '" + address + "' cannot be a view of "
+                                 "itself.");
 
-        node_->set_sink_state(NodeState::SINK_BOUND);
-        bound_ = true;
-    }
+    bindNode(address, 0, MemoryPolicy());
+    sh_object_->setView(parent_address, rect);
+    segment_.set_view();
+
+    node_->set_sink_state(NodeState::SINK_BOUND);
+    bound_ = true;
+
+    // Nothing is ever written here, so sources already waiting for the sink
+    // must be woken explicitly
+    node_->wakeSources();
 }
 
 inline oat::Frame Sink<Frame>::retrieve(const size_t rows,
                                         const size_t cols,
                                         const int type,
-                                        const oat::PixelColor color)
+                                        const oat::PixelColor color,
+                                        const size_t step)
 {
     // Make sure that the SINK is bound to a shared memory segment
     //assert(bound_);
     if (!bound_)
         throw (std::runtime_error("SINK must be bound before shared frame is retrieved."));
 
-    // Allocate memory for sample number
-    void * sample = obj_shmem_.allocate(sizeof(oat::Sample));
-    handle_t sample_handle = obj_shmem_.get_handle_from_address(sample);
+    // Row stride. Padding is dropped rather than overflowing the segment.
+    const size_t row_bytes = cols * CV_ELEM_SIZE(type);
+    size_t row_step = step;
+    if (row_step == 0) {
+        row_step = policy_.rowStep(row_bytes);
+        if (rows * row_step > block_bytes_)
+            row_step = row_bytes;
+    }
+
+    if (row_step < row_bytes || rows * row_step > block_bytes_)
+        throw (std::runtime_error("Shared frame does not fit the number of "
+                                  "bytes it was bound with."));
+
+    setFormat(rows, cols, type, color, row_step);
+
+    std::vector<handle_t> sample_handles;
+    frames_.clear();
+    data_.clear();
+    capacity_.assign(num_buffers_, block_bytes_);
+    generations_.assign(num_buffers_, generation_);
+    plane_data_.assign(num_buffers_, PlaneHandles {});
+    plane_capacity_.assign(num_buffers_, PlaneBytes {});
+
+    for (size_t i = 0; i < num_buffers_; i++) {
 
-    // Allocate memory for the shared object's data
-    cv::Mat temp(rows, cols, type);
-    void * data = obj_shmem_.allocate(temp.total() * temp.elemSize());
-    handle_t data_handle = obj_shmem_.get_handle_from_address(data);
+        // Sample number and the shared object's data sit at fixed offsets in
+        // the payload reserved by bind()
+        char * sample = static_cast<char *>(segment_.payload()) + i * slot_bytes_;
+        sample_handles.push_back(segment_.handle(sample));
+
+        char * data = sample + alignData(sizeof(oat::Sample));
+        data_.push_back(segment_.handle(data));
+
+        frames_.emplace_back(rows, cols, type, color, data, sample, row_step);
+        layoutPlanes(i);
+    }
 
     // Reset the SharedFrameHeader's parameters now that we know what they should be
-    sh_object_->setParameters(data_handle, sample_handle, rows, cols, type, color);
+    sh_object_->setParameters(data_, sample_handles, rows, cols, type, color,
+                              row_step, generation_);
 
     // Return pointer to memory allocated for shared object
-    return oat::Frame(rows, cols, type, color, data, sample);
+    return frames_[0];
+}
+
+inline oat::Frame Sink<Frame>::retrieve()
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (frames_.empty())
+        throw (std::runtime_error("Shared frames must be allocated before they are retrieved."));
+#endif
+
+    auto idx = node_->write_index();
+
+    // Buffers take a new format when they are next written
+    if (generations_[idx] != generation_)
+        formatBuffer(idx);
+
+    if (num_buffers_ > 1 && node_->write_number() > 0) {
+        auto prev = (idx + num_buffers_ - 1) % num_buffers_;
+        frames_[idx].set_sample(frames_[prev].sample());
+    }
+
+    return frames_[idx];
+}
+
+inline oat::Frame Sink<Frame>::reformat(const size_t rows,
+                                        const size_t cols,
+                                        const int type,
+                                        const oat::PixelColor color,
+                                        const size_t step)
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (!did_wait_need_post_ || frames_.empty())
+        throw (std::runtime_error("Shared frames can only be reformatted "
+                                  "between wait() and post() once allocated."));
+#endif
+
+#ifdef HAVE_CUDA
+    if (on_device())
+        throw (std::runtime_error("Device frames cannot be reformatted."));
+#endif
+
+    const size_t row_bytes = cols * CV_ELEM_SIZE(type);
+    const size_t row_step = step == 0 ? policy_.rowStep(row_bytes) : step;
+    if (row_step < row_bytes)
+        throw (std::runtime_error("Shared frame rows cannot be shorter than "
+                                  "their pixels."));
+
+    setFormat(rows, cols, type, color, row_step);
+
+    return retrieve();
+}
+
+inline void Sink<Frame>::setFormat(const size_t rows,
+                                   const size_t cols,
+                                   const int type,
+                                   const oat::PixelColor color,
+                                   const size_t step)
+{
+    format_.rows = rows;
+    format_.cols = cols;
+    format_.type = type;
+    format_.color = color;
+    format_.bytes = rows * cols * CV_ELEM_SIZE(type);
+    format_.step = step;
+
+    ++generation_;
+}
+
+inline void Sink<Frame>::formatBuffer(const size_t index)
+{
+    // Frames that outgrow their buffer move to new payload. Capacity is
+    // never given back, so switching between formats only grows once.
+    const size_t bytes = format_.rows * format_.step;
+    if (bytes > capacity_[index]) {
+        capacity_[index] = alignData(bytes);
+        data_[index] = segment_.grow(capacity_[index], policy_);
+    }
+
+    // The sample stays where it is
+    frames_[index] = oat::Frame(format_.rows,
+                                format_.cols,
+                                format_.type,
+                                format_.color,
+                                segment_.address(data_[index]),
+                                segment_.address(sh_object_->sample(index)),
+                                format_.step);
+
+    layoutPlanes(index);
+    sh_object_->setFormat(index, data_[index], format_, generation_);
+    generations_[index] = generation_;
+}
+
+inline void Sink<Frame>::layoutPlanes(const size_t index)
+{
+    for (size_t i = 0; i < NUM_FRAME_PLANES; i++) {
+
+        if (!(planes_ & (1u << i)))
+            continue;
+
+        const auto p = planeParams(
+            static_cast<FramePlane>(i), format_, pyramid_filter_);
+        if (p.rows == 0)
+            continue;
+
+        // As with frames, plane capacity only ever grows
+        if (p.bytes > plane_capacity_[index][i]) {
+            plane_capacity_[index][i] = alignData(p.bytes);
+            plane_data_[index][i] =
+                    segment_.grow(plane_capacity_[index][i], policy_);
+        }
+
+        sh_object_->setPlane(index, i, plane_data_[index][i], p, generation_);
+    }
+}
+
+inline void Sink<Frame>::computePlanes(const size_t index)
+{
+#ifdef HAVE_CUDA
+    // The host frames of device nodes hold no pixels
+    if (on_device())
+        return;
+#endif
+
+    if (computed_planes_ == 0)
+        return;
+
+    // Tagged as a source would tag them, with the write number + 1. Levels of
+    // the pyramid follow the levels they are halved from.
+    const uint64_t tag = node_->write_number() + 1;
+
+    for (size_t i = 0; i < NUM_FRAME_PLANES; i++) {
+
+        if (!(computed_planes_ & (1u << i)) || !sh_object_->hosts(index, i))
+            continue;
+
+        const auto plane = static_cast<FramePlane>(i);
+        auto &slot = sh_object_->plane(index, i);
+        cv::Mat out(slot.params.rows, slot.params.cols, slot.params.type,
+                    segment_.address(slot.data), slot.params.step);
+
+        FramePlane parent;
+        if (parent_plane(plane, parent)) {
+            const auto &up = sh_object_->plane(index, static_cast<size_t>(parent));
+            const cv::Mat from(up.params.rows, up.params.cols, up.params.type,
+                               segment_.address(up.data), up.params.step);
+            derivePlane(plane, from, out, pyramid_filter_);
+        } else {
+            derivePlane(plane, frames_[index], out, pyramid_filter_);
+        }
+
+        slot.claimed.store(tag, std::memory_order_relaxed);
+        slot.ready.store(tag, std::memory_order_release);
+    }
+}
+
+#ifdef HAVE_CUDA
+inline oat::Frame Sink<Frame>::retrieveDevice(const size_t rows,
+                                              const size_t cols,
+                                              const int type,
+                                              const oat::PixelColor color)
+{
+    auto frame = retrieve(rows, cols, type, color);
+
+    auto handles = device_buffers_.allocate(
+        num_buffers_, rows, cols * CV_ELEM_SIZE(type), device_step_);
+    sh_object_->setDeviceData(handles, device_step_);
+
+    return frame;
+}
+
+inline cv::cuda::GpuMat Sink<Frame>::borrowDevice()
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (!did_wait_need_post_ || device_buffers_.empty())
+        throw (std::runtime_error("Device frame can only be borrowed between "
+                                  "wait() and post() once allocated."));
+#endif
+
+    const auto &f = frames_[node_->write_index()];
+    return device_buffers_.view(
+        node_->write_index(), f.rows, f.cols, f.type(), device_step_);
+}
+#endif
+
+inline void Sink<Frame>::post()
+{
+#ifdef HAVE_CUDA
+    // Device writes must land before sources are told about them
+    if (!device_buffers_.empty())
+        synchronizeDevice();
+#endif
+
+    if (bound_ && did_wait_need_post_) {
+        if (!frames_.empty()) {
+            const auto index = node_->write_index();
+            computePlanes(index);
+            frames_[index].stampSample();
+        }
+        sh_object_->publish(node_->write_number());
+    }
+
+    SinkBase<SharedFrameHeader>::post();
+}
+
+inline oat::Frame Sink<Frame>::borrow()
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (!did_wait_need_post_)
+        throw (std::runtime_error("Shared frame can only be borrowed between "
+                                  "wait() and post()."));
+#endif
+
+    return retrieve();
+}
+
+// 2. SharedPosition
+
+template <>
+class Sink<Position2D> : public SinkBase<SharedPosition> {
+
+public:
+    /**
+     * @brief Bind a position node.
+     * @param address Node address.
+     * @param label Label of the positions written to the node.
+     * @param num_buffers Number of position records written round-robin. When
+     * greater than 1, sources may lag the sink by up to num_buffers - 1
+     * positions before the sink blocks.
+     */
+    void bind(const std::string &address,
+              const std::string &label,
+              const size_t num_buffers = 1);
+
+    /**
+     * @brief Write a position to the record that the next post() will
+     * publish. Must be called between wait() and post(). The label of the
+     * position is ignored. Its unit of length and homography are written to
+     * the node only when they change.
+     * @param position Position to write.
+     */
+    void write(const oat::Position2D &position);
+
+    /**
+     * @brief Publish the position written during this critical section as
+     * the latest completed position and notify sources that they may read
+     * it.
+     */
+    void post();
+
+    size_t num_buffers() const { return num_buffers_; }
+
+    /**
+     * @brief Keep the latest positions published to the node in a history
+     * ring that its readers can scan by sample number. Must be called before
+     * bind(). Sinks joining a merge node use the ring of the sink that
+     * created it, if it has one.
+     * @param capacity Number of positions kept.
+     */
+    void set_history(const size_t capacity);
+
+    /**
+     * @brief Also publish each position to the channel of a position bus
+     * named after the node, so that components following many positions can
+     * wait on the bus instead of on each node. Must be called before bind().
+     * Not available to merge sinks, since a channel has one writer.
+     * @param bus Name of the bus.
+     */
+    void set_bus(const std::string &bus);
+
+private:
+    size_t num_buffers_ {1};
+    size_t history_capacity_ {0};
+    PositionHistoryRing *history_ {nullptr};
+    std::string bus_name_;
+    std::unique_ptr<PositionBus> bus_;
+    size_t bus_channel_ {0};
+};
+
+inline void Sink<Position2D>::bind(const std::string &address,
+                                   const std::string &label,
+                                   const size_t num_buffers)
+{
+    if (num_buffers == 0 || num_buffers > Node::MAX_BUFFERS)
+        throw std::runtime_error("Number of position buffers must be between 1 "
+                                 "and " + std::to_string(Node::MAX_BUFFERS) + ".");
+
+    const size_t payload_bytes = history_capacity_ > 0
+            ? PositionHistoryRing::bytes(history_capacity_)
+            : 0;
+    if (!bus_name_.empty()) {
+        if (merge_)
+            throw std::runtime_error("A merge sink cannot publish to a "
+                                     "position bus.");
+        bus_.reset(new PositionBus(bus_name_));
+        bus_channel_ = bus_->claim(address);
+    }
+
+    bindNode(address, payload_bytes, MemoryPolicy(), label);
+
+    // Sinks joining a merge node use the rings of the sink that created it
+    if (node_->sink_state() == NodeState::SINK_BOUND) {
+        num_buffers_ = node_->num_buffers();
+        if (sh_object_->history_capacity() > 0)
+            history_ = static_cast<PositionHistoryRing *>(segment_.payload());
+        bound_ = true;
+        return;
+    }
+
+    if (history_capacity_ > 0) {
+        history_ = new (segment_.payload())
+            PositionHistoryRing(history_capacity_);
+        sh_object_->set_history_capacity(history_capacity_);
+    }
+
+    num_buffers_ = num_buffers;
+    sh_object_->set_num_buffers(num_buffers_);
+    node_->set_num_buffers(num_buffers_);
+    node_->set_sink_state(NodeState::SINK_BOUND);
+    bound_ = true;
+}
+
+inline void Sink<Position2D>::write(const oat::Position2D &position)
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (!did_wait_need_post_)
+        throw (std::runtime_error("Shared position can only be written between "
+                                  "wait() and post()."));
+#endif
+
+    auto unit = position.unit_of_length();
+    auto homography = position.homography();
+    if (!sh_object_->hasCoordSystem(unit, homography))
+        sh_object_->setCoordSystem(unit, homography);
+
+    sh_object_->record(node_->write_index()) = position.record();
+}
+
+inline void Sink<Position2D>::post()
+{
+    if (bound_ && did_wait_need_post_) {
+        auto &record = sh_object_->record(node_->write_index());
+        record.sample.stamp();
+        if (history_ != nullptr)
+            history_->push(record);
+        if (bus_)
+            bus_->write(bus_channel_,
+                        record,
+                        sh_object_->unit_of_length(),
+                        sh_object_->homography());
+        sh_object_->publish(node_->write_number());
+    }
+
+    SinkBase<SharedPosition>::post();
+}
+
+inline void Sink<Position2D>::set_history(const size_t capacity)
+{
+    if (bound_)
+        throw std::runtime_error("Position history must be set before the "
+                                 "sink binds.");
+
+    history_capacity_ = capacity;
+}
+
+inline void Sink<Position2D>::set_bus(const std::string &bus)
+{
+    if (bound_)
+        throw std::runtime_error("Position bus must be set before the sink "
+                                 "binds.");
+
+    bus_name_ = bus;
 }
 
 } // namespace oat
@@ -20,21 +20,31 @@
 #ifndef OAT_SOURCE_H
 #define	OAT_SOURCE_H
 
+#include "DeviceMemory.h"
 #include "ForwardsDecl.h"
+#include "FramePlanes.h"
+#include "MemoryPolicy.h"
 #include "Node.h"
+#include "PositionHistoryRing.h"
+#include "Segment.h"
 #include "SharedFrameHeader.h"
+#include "SharedPosition.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
-#include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/thread/thread_time.hpp>
 
 #include "../datatypes/Frame.h"
+#include "../datatypes/Position2D.h"
 #include "../base/Globals.h"
 
 namespace oat {
@@ -49,38 +59,161 @@ enum class SourceState : std::int16_t
     CONNECTED       = 2,
 };
 
+enum class SourceMode : std::int16_t
+{
+    SYNC            = 0, //!< Read every sample. The sink waits for this source.
+    LATEST          = 1, //!< Best effort. Read the latest sample. The sink never waits.
+};
+
 template <typename T>
 class SourceBase {
 public:
     SourceBase();
     virtual ~SourceBase();
 
-    // Node connection
-    void touch(const std::string &address);
+    /**
+     * @brief Touch a node.
+     * @param address Node address.
+     * @param mode In SYNC mode, the source takes part in the node's read
+     * barriers and reads every sample. In LATEST mode, it occupies a
+     * best-effort slot that the sink never waits for. wait() then sleeps
+     * until a write it has not seen, counting the writes it skipped as
+     * drops, and data accessors copy the most recently completed sample,
+     * retrying if the sink overwrote it mid-copy. Pointers to the shared
+     * object are not protected in LATEST mode. In deterministic replay every
+     * source is SYNC, since what LATEST sources skip depends on timing.
+     */
+    void touch(const std::string &address,
+               const SourceMode mode = SourceMode::SYNC);
     virtual SourceState connect(void);
+    SourceMode mode(void) const { return mode_; }
 
     // Sychronization
     NodeState wait();
     void post();
 
+    /**
+     * @brief Complete a wait() only if it would not block. If it does,
+     * post() must follow as it would after wait().
+     * @param state Node state, set if the wait completed.
+     * @return True if the wait completed.
+     */
+    bool tryWait(NodeState &state);
+
+    /**
+     * @brief Whether wait() would return without sleeping, because there is
+     * a write this source has not read or the sink has left. Unlike
+     * tryWait(), nothing is consumed, so it is only a hint: by the time
+     * wait() is called, a LATEST source's write may have been superseded,
+     * but never lost.
+     */
+    bool readable() const;
+
+    /**
+     * @brief Event advanced by every write to the node, by the sink leaving
+     * and by sources finishing a write. Lets a thread sleep on several
+     * sources at once through SampleEvent::waitAny().
+     */
+    SampleEvent &sample_event() const { return node_->sample_event(); }
+
     uint64_t write_number() const
     {
         return (node_ == nullptr ? 0 : node_->write_number());
     }
 
+    /**
+     * @brief Writes that a LATEST source skipped because it was busy when they
+     * were made.
+     */
+    uint64_t dropped() const
+    {
+        return (node_ == nullptr || state_ < SourceState::TOUCHED
+                ? 0 : node_->dropped(slot_index_));
+    }
+
+    /**
+     * @brief Write number of the sample last copied by a LATEST source. Lets
+     * readers tell gaps in a node's sample counts apart from writes that
+     * they skipped.
+     */
+    uint64_t latest_write_number() const { return latest_write_; }
+
 protected:
 
-    shmem_t node_shmem_, obj_shmem_;
+    mutable Segment segment_; //!< Mapped further when a frame node grows
+    bool prefault_ {false};
     T * sh_object_ {nullptr};
     Node * node_ {nullptr};
-    std::string address_, node_address_, obj_address_;
+    std::string address_, node_address_;
     size_t slot_index_ {0};
     std::atomic<SourceState> state_ {SourceState::VIRGIN};
     bool touched_ {false};
     bool connected_ {false};
     bool did_wait_need_post_ {false};
+    SourceMode mode_ {SourceMode::SYNC};
+    uint64_t seen_writes_ {0}; //!< Writes observed by a LATEST source
+    mutable uint64_t latest_write_ {0}; //!< Write last copied by readLatest()
+    uint64_t wait_return_ns_ {0}; //!< Time that the last wait() returned
+
+    // Longest sleep while waiting for the sink to bind or write before quit
+    // is checked
+    static constexpr std::chrono::milliseconds QUIT_PERIOD {100};
+
+    /**
+     * @brief Open the node at address and take a slot in its reader table
+     * in this source's mode.
+     * @param address Node address.
+     * @return False if the node's reader table is full.
+     */
+    bool openNode(const std::string &address);
+
+    /**
+     * @brief Block until the sink binds the node.
+     * @return False if the sink left or quit was requested first.
+     */
+    bool waitForSink(void);
+
+    // Sleep until the read barrier is posted or the sink leaves
+    void waitReadBarrier(void);
+
+    // Move a LATEST source's cursor to the latest write, discarding the
+    // barrier posts of the writes it skipped
+    void skipToLatest(void);
+
+    /**
+     * @brief Map the shared object that the sink constructed. Pages are
+     * faulted in now if OAT_PREFAULT is set.
+     */
+    void mapObject(void);
+
+    /**
+     * @brief Copy the latest completed sample, seqlock style. copy(index) is
+     * called with the buffer index of the latest sample and is repeated
+     * until the sink is seen not to have overwritten it during the copy.
+     * @param copy Copy function.
+     * @param num_buffers Number of buffers the sink writes round-robin.
+     */
+    template <typename Copier>
+    void readLatest(Copier copy, const size_t num_buffers) const
+    {
+        while (true) {
+            const uint64_t done = node_->write_number();
+            copy((done == 0 ? 0 : done - 1) % num_buffers);
+
+            // The buffer that was copied is next overwritten by write
+            // done + num_buffers - 1
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (node_->writes_started() < done + num_buffers || quit) {
+                latest_write_ = done;
+                return;
+            }
+        }
+    }
 };
 
+template <typename T>
+constexpr std::chrono::milliseconds SourceBase<T>::QUIT_PERIOD;
+
 template <typename T>
 inline SourceBase<T>::SourceBase()
 {
@@ -100,9 +233,7 @@ inline SourceBase<T>::~SourceBase()
     if ( (node_ != nullptr && node_-> source_ref_count() == 0) &&
         node_->sink_state() != NodeState::SINK_BOUND) {
 
-        bool shmem_freed = false;
-        shmem_freed |= bip::shared_memory_object::remove(node_address_.c_str());
-        shmem_freed |= bip::shared_memory_object::remove(obj_address_.c_str());
+        bool shmem_freed = Segment::remove(node_address_);
 
 #ifndef NDEBUG
         if (shmem_freed)
@@ -112,32 +243,16 @@ inline SourceBase<T>::~SourceBase()
 }
 
 template <typename T>
-inline void SourceBase<T>::touch(const std::string &address)
+inline void SourceBase<T>::touch(const std::string &address,
+                                 const SourceMode mode)
 {
     // Make sure we did not connect already
     if (state_ != SourceState::VIRGIN)
         throw std::runtime_error("A source can only connect a "
                                  "single time to a single node.");
 
-    // Addresses for this block of shared memory
-    address_ = address;
-    node_address_ = address + "_node";
-    obj_address_ = address + "_obj";
-
-    // Define shared memory
-    // Extra 1024 bytes are used to hold managed shared mem helper objects
-    // (name-object index, internal synchronization objects, internal
-    // variables...)
-    node_shmem_ = bip::managed_shared_memory(
-            bip::open_or_create,
-            node_address_.c_str(),
-            1024 + sizeof(Node));
-
-    // Facilitates synchronized access to shmem
-    node_ = node_shmem_.find_or_construct<Node>(typeid(Node).name())();
-
-    // Let the node know this source is attached and retrieve *this's index
-    if (node_->acquireSlot(slot_index_) < 0) {
+    mode_ = oat::deterministic() ? SourceMode::SYNC : mode;
+    if (!openNode(address)) {
         state_ = SourceState::ERR_NODEFULL;
         return;
     }
@@ -146,6 +261,30 @@ inline void SourceBase<T>::touch(const std::string &address)
     state_ = SourceState::TOUCHED;
 }
 
+template <typename T>
+inline bool SourceBase<T>::openNode(const std::string &address)
+{
+    // Address for this block of shared memory
+    address_ = address;
+    node_address_ = address + "_node";
+
+    // Define shared memory. The node's reader table is sized when the node is
+    // created by whichever of the SINK or SOURCEs arrives first.
+    node_ = segment_.open(node_address_, Node::default_max_sources());
+
+    // Let the node know this source is attached and retrieve *this's index.
+    // The sink does not wait for latest-value sources.
+    if (node_->acquireSlot(slot_index_, mode_ == SourceMode::LATEST) < 0)
+        return false;
+
+    // A latest-value source's first read is the latest write, so writes
+    // made before it arrived are not counted as drops
+    if (mode_ == SourceMode::LATEST && node_->write_number() > 0)
+        seen_writes_ = node_->write_number() - 1;
+
+    return true;
+}
+
 template <typename T>
 inline SourceState SourceBase<T>::connect()
 {
@@ -155,33 +294,65 @@ inline SourceState SourceBase<T>::connect()
                                  "touch()ed a node.");
 
     // Wait for the SINK to bind and construct the shared object
-    if (node_->sink_state() != NodeState::SINK_BOUND) {
+    if (!waitForSink())
+        return SourceState::ERR_CONNECT; // No throw because this can occur
+                                         // at quit
 
-        if (wait() != NodeState::SINK_BOUND)
-            return SourceState::ERR_CONNECT; // No throw because this can occur
-                                             // at quit
+    mapObject();
 
-        // Self post since all loops start with wait() and we just
-        // finished our wait(). This will make the first call to
-        // wait() a 'freebie'
-        node_->read_barrier(slot_index_).post();
-        did_wait_need_post_ = false;
-    }
+    state_ = SourceState::CONNECTED;
+    return SourceState::CONNECTED;
+}
 
-    // Find an existing shared object constructed by the SINK
-    obj_shmem_ =
-            bip::managed_shared_memory(bip::open_only, obj_address_.c_str());
-    std::pair<T *,std::size_t> temp = obj_shmem_.find<T>(typeid(T).name());
-    sh_object_ = temp.first;
+template <typename T>
+inline void SourceBase<T>::mapObject()
+{
+    // Find the shared object constructed by the SINK
+    prefault_ = MemoryPolicy::fromEnvironment().prefault;
+    sh_object_ = segment_.template connect<T>(prefault_);
 
-    // Only occurs when the name of the shared object does not match typeid(T).name()
+    // Only occurs when the SINK's shared object is not a T
     if (sh_object_ == nullptr) {
         state_ = SourceState::ERR_TYPEMIS;
         throw std::runtime_error("Type mismatch: Source<T> can only connect to Node<T>.");
     }
 
-    state_ = SourceState::CONNECTED;
-    return SourceState::CONNECTED;
+    // Mapping the whole segment moves the node
+    node_ = segment_.node();
+}
+
+template <typename T>
+inline bool SourceBase<T>::waitForSink()
+{
+    if (node_->sink_state() == NodeState::SINK_BOUND)
+        return true;
+
+    // Sleep until the node's state changes rather than polling it, so that
+    // sources wake the moment the sink binds
+    while (!quit) {
+        auto seen = node_->state_generation();
+        if (node_->sink_state() != NodeState::UNDEFINED)
+            break;
+        node_->awaitStateChange(seen, QUIT_PERIOD);
+    }
+
+    if (node_->sink_state() != NodeState::SINK_BOUND)
+        return false;
+
+    // Latest-value sources do not take the sink's first write here
+    if (mode_ == SourceMode::LATEST)
+        return true;
+
+    if (SourceBase<T>::wait() != NodeState::SINK_BOUND)
+        return false;
+
+    // Self post since all loops start with wait() and we just
+    // finished our wait(). This will make the first call to
+    // wait() a 'freebie'
+    node_->read_barrier(slot_index_).post();
+    did_wait_need_post_ = false;
+
+    return true;
 }
 
 template <typename T>
@@ -195,6 +366,39 @@ inline NodeState SourceBase<T>::wait()
         throw std::runtime_error("wait() called when post() was required.");
 #endif
 
+    // Latest-value sources sleep until a write they have not seen. Posts by
+    // writes that were skipped wake them without one.
+    if (mode_ == SourceMode::LATEST) {
+        while (node_->write_number() <= seen_writes_ && !quit
+               && node_->sink_state() != NodeState::END)
+            waitReadBarrier();
+
+        skipToLatest();
+    } else {
+        waitReadBarrier();
+    }
+
+    did_wait_need_post_ = true;
+    wait_return_ns_ = telemetryNow();
+
+    return node_->sink_state();
+}
+
+template <typename T>
+inline void SourceBase<T>::waitReadBarrier()
+{
+#ifdef USE_FUTEX
+    // Sleep until the sink writes, the sink leaves (which posts all read
+    // barriers), or a signal interrupts the wait. The sleep is bounded
+    // because quit can be set without a signal to this thread, e.g. by a
+    // pipeline stage that threw.
+    while (!node_->read_barrier(slot_index_).wait_for(QUIT_PERIOD) && !quit) {
+
+        // If the sink has left the room, we should too
+        if (node_->sink_state() == NodeState::END)
+            break;
+    }
+#else
     boost::system_time timeout = boost::get_system_time() + msec_t(10);
 
     // Only wait if there is a SOURCE attached to the node
@@ -208,10 +412,63 @@ inline NodeState SourceBase<T>::wait()
         if (node_->sink_state() == NodeState::END)
             break;
     }
+#endif
+}
+
+template <typename T>
+inline void SourceBase<T>::skipToLatest()
+{
+    // Each write posts the barrier after it is counted, so none of the posts
+    // taken here are for a write that is not yet seen below
+    while (node_->read_barrier(slot_index_).try_wait()) { }
+
+    const auto writes = node_->write_number();
+    if (writes > seen_writes_ + 1)
+        node_->recordDrops(slot_index_, writes - seen_writes_ - 1);
+
+    seen_writes_ = writes;
+}
+
+template <typename T>
+inline bool SourceBase<T>::tryWait(NodeState &state)
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if(state_ < SourceState::CONNECTED)
+        throw std::runtime_error("Source must be connected before calling tryWait()");
+    if (did_wait_need_post_)
+        throw std::runtime_error("tryWait() called when post() was required.");
+#endif
+
+    bool ready = mode_ == SourceMode::SYNC
+               ? node_->read_barrier(slot_index_).try_wait()
+               : node_->write_number() > seen_writes_;
+
+    // A sink that has left the room completes the wait, just like wait()
+    if (!ready && node_->sink_state() != NodeState::END)
+        return false;
+
+    if (mode_ == SourceMode::LATEST)
+        skipToLatest();
 
     did_wait_need_post_ = true;
+    wait_return_ns_ = telemetryNow();
+    state = node_->sink_state();
 
-    return node_->sink_state();
+    return true;
+}
+
+template <typename T>
+inline bool SourceBase<T>::readable() const
+{
+    if (state_ < SourceState::CONNECTED)
+        return false;
+
+    if (mode_ == SourceMode::LATEST)
+        return node_->write_number() > seen_writes_
+               || node_->sink_state() == NodeState::END;
+
+    return node_->readable(slot_index_);
 }
 
 template <typename T>
@@ -225,7 +482,10 @@ inline void SourceBase<T>::post()
         throw std::runtime_error("post() called when wait() was required.");
 #endif
 
-    if (node_->notifySourceReadComplete(slot_index_))
+    node_->read_hold(slot_index_).record(telemetryNow() - wait_return_ns_);
+
+    if (mode_ == SourceMode::SYNC &&
+        node_->notifySourceReadComplete(slot_index_))
         node_->write_barrier.post();
 
     did_wait_need_post_ = false;
@@ -241,6 +501,7 @@ class Source : public SourceBase<T> {
     using SourceBase<T>::sh_object_;
     using SourceBase<T>::connected_;
     using SourceBase<T>::state_;
+    using SourceBase<T>::mode_;
 
 public:
     T *retrieve() const;
@@ -268,7 +529,12 @@ inline T Source<T>::clone() const
         throw (std::runtime_error("Source must be connected before shared object is cloned."));
 #endif
 
-    return *sh_object_;
+    if (mode_ == SourceMode::SYNC)
+        return *sh_object_;
+
+    T sample(*sh_object_);
+    this->readLatest([&](size_t) { sample = *sh_object_; }, 1);
+    return sample;
 }
 
 // 1. SharedFrameHeader
@@ -285,18 +551,339 @@ public:
     SourceState connect() override;
     SourceState connect(const oat::PixelColor col);
 
+    /**
+     * @brief Wait for the sink to write a frame. In ring mode, that is, when
+     * the sink was bound with more than one buffer, this also points the
+     * retrieved frame to the buffer that this source must read next. In
+     * LATEST mode, it points the retrieved frame to the latest completed
+     * buffer.
+     * @return Node state.
+     */
+    NodeState wait();
+    bool tryWait(NodeState &state);
+
+    /**
+     * @brief Lend the shared frame, read-only, in place of copying it out. The
+     * frame is only valid between wait() and post(). After post(), the sink
+     * is free to overwrite it.
+     * @return Shared frame.
+     */
+    const oat::Frame &borrow() const;
+
+    /**
+     * @brief Lend the latest frame that the sink has completed, which may be
+     * ahead of the frame returned by borrow() in ring mode. Sinks never
+     * overwrite frames that this source has not finished reading, so the
+     * frame is valid until post().
+     * @return Latest completed shared frame.
+     */
+    const oat::Frame &latest() const;
+    size_t latest_index() const { return sh_object_->latest_index(); }
+
     const oat::Frame * retrieve() const { return &frame_; }
-    oat::Frame clone() const { return frame_.clone(); }
-    void copyTo(oat::Frame &frame) const { frame_.copyTo(frame); };
+    oat::Frame clone() const;
+    void copyTo(oat::Frame &frame) const;
+
+    /**
+     * @brief Set how clone() and copyTo() copy pixels, e.g. with streaming
+     * stores for copies that are queued rather than read right away.
+     * @param hint Copy hint. Defaults to CopyHint::CACHED.
+     */
+    void set_copy_hint(const CopyHint hint) { copy_hint_ = hint; }
+
+    /**
+     * @brief Copy only the sample information of the frame, without its
+     * pixels. In LATEST mode, that of the latest completed frame.
+     * @return Sample information.
+     */
+    oat::Sample sample() const;
+
+    /**
+     * @brief Format of the frame returned by borrow(). Follows format changes
+     * made by the sink, as does generation().
+     */
     FrameParams parameters() const { return parameters_; }
 
+    /**
+     * @brief Generation of the format of the frame returned by borrow().
+     * Increases when the sink reformats its frames.
+     */
+    uint64_t generation() const
+    {
+        return generations_.empty() ? 0 : generations_[frame_index_];
+    }
+
+    /**
+     * @brief True if the source connected to a view node, in which case it
+     * reads view_rect() of the frames of the node that the view refers to.
+     * Frames are those of the parent node cropped to the rectangle, and
+     * sources synchronize with the parent's sink.
+     */
+    bool is_view() const { return is_view_; }
+    cv::Rect view_rect() const { return view_; }
+
+    /**
+     * @brief Lend a plane derived from the frame returned by borrow(), such
+     * as its grey conversion. When the node hosts the plane, it is computed
+     * once per frame by the first SYNC source that asks for it and read in
+     * place by the others. Otherwise, this source computes it into memory of
+     * its own. Only valid between wait() and post().
+     * @param plane Plane to lend.
+     * @return Plane, carrying the frame's sample.
+     */
+    oat::Frame plane(const FramePlane plane) const;
+
+    /**
+     * @brief True if plane() reads the plane from the node rather than
+     * computing it alone, because the node hosts it for the current frame
+     * and this source is a SYNC source of the node holding the frame.
+     */
+    bool hosts(const FramePlane plane) const
+    {
+        return mode_ == SourceMode::SYNC && !is_view_ && !frames_.empty()
+               && !sh_object_->on_device()
+               && sh_object_->hosts(frame_index_, static_cast<size_t>(plane));
+    }
+
+    /**
+     * @brief Format of a plane of the frame returned by borrow(). Zero rows
+     * if the plane cannot be derived from it.
+     */
+    FrameParams planeParameters(const FramePlane plane) const
+    {
+        return planeParams(plane, parameters_, pyramid_filter());
+    }
+
+    /**
+     * @brief Filter that the node's frame pyramid levels are halved with.
+     */
+    PyramidFilter pyramid_filter() const
+    {
+        return static_cast<PyramidFilter>(sh_object_->pyramid_filter());
+    }
+
+    /**
+     * @brief Allow connection to a node whose pixel data is in device memory.
+     * Must be called before connect(). The host frames of such a node only
+     * carry sample information and pixels must be read with borrowDevice().
+     */
+    void acceptDevice() { accept_device_ = true; }
+
+    /**
+     * @brief True if the connected node keeps its pixel data in device memory.
+     */
+    bool on_device() const
+    {
+        return sh_object_ != nullptr && sh_object_->on_device();
+    }
+
+#ifdef HAVE_CUDA
+    /**
+     * @brief Lend the device buffer holding the frame returned by borrow().
+     * Only valid between wait() and post().
+     * @return Shared device frame.
+     */
+    cv::cuda::GpuMat borrowDevice() const;
+#endif
+
 private :
 
     // Shared frame
     oat::Frame frame_;
+    size_t frame_index_ {0};
     FrameParams parameters_;
+
+    // How frames are copied out of the node
+    CopyHint copy_hint_ {CopyHint::CACHED};
+
+    // Shared frame buffers when the node is used as a ring, and the format
+    // generation each was last built for. Rebuilt, even by const readers,
+    // when the sink reformats a buffer.
+    mutable std::vector<oat::Frame> frames_;
+    mutable std::vector<uint64_t> generations_;
+
+    // Rectangle of the parent's frames, if connected through a view
+    bool is_view_ {false};
+    cv::Rect view_;
+
+    // Views of views are followed to this depth
+    static constexpr int MAX_VIEW_DEPTH {8};
+
+    /**
+     * @brief Move from a view node to the node holding its frames, composing
+     * the rectangles of any views in between.
+     * @return False if the sink left or quit was requested first.
+     */
+    bool followView();
+
+    // Device pixel data, if the sink keeps it on the GPU
+    bool accept_device_ {false};
+#ifdef HAVE_CUDA
+    DeviceBuffers device_buffers_;
+#endif
+
+    // Planes computed by this source when the node does not host them
+    mutable std::array<cv::Mat, NUM_FRAME_PLANES> own_planes_;
+
+    // Time allowed for another source to finish a plane it has claimed
+    // before this one computes its own, e.g. because the other crashed
+    static constexpr int PLANE_WAIT_MS {100};
+
+    void selectFrame()
+    {
+        frame_index_ = mode_ == SourceMode::SYNC
+                     ? node_->read_index(slot_index_)
+                     : sh_object_->latest_index();
+        frame_ = buffer(frame_index_);
+
+        // Save parameters to construct cv::Mats with
+        auto p = sh_object_->params(frame_index_);
+        parameters_.cols = frame_.cols;
+        parameters_.rows = frame_.rows;
+        parameters_.type = p.type;
+        parameters_.color = p.color;
+        parameters_.bytes = frame_.total() * frame_.elemSize();
+        parameters_.step = p.step;
+    }
+
+    // Shared frame buffer, rebuilt if the sink changed its format
+    const oat::Frame &buffer(const size_t index) const
+    {
+        const auto generation = sh_object_->generation(index);
+        if (generation == generations_[index])
+            return frames_[index];
+
+        // The frame may have moved to payload added since the last mapping
+        segment_.update(prefault_);
+
+        auto p = sh_object_->params(index);
+        auto data = static_cast<char *>(segment_.address(sh_object_->data(index)));
+        auto rect = cv::Rect(0, 0, p.cols, p.rows);
+
+        // Views are strided headers over a rectangle of the parent's pixels
+        if (is_view_) {
+            rect &= view_;
+
+            // Keep the Bayer tile, and so the color, of the parent
+            if (oat::is_bayer(p.color)) {
+                rect.width -= rect.x & 1;
+                rect.height -= rect.y & 1;
+                rect.x += rect.x & 1;
+                rect.y += rect.y & 1;
+                rect.width &= ~1;
+                rect.height &= ~1;
+            }
+
+            data += rect.y * p.step + rect.x * CV_ELEM_SIZE(p.type);
+        }
+
+        frames_[index] = oat::Frame(rect.height,
+                                    rect.width,
+                                    p.type,
+                                    p.color,
+                                    data,
+                                    segment_.address(sh_object_->sample(index)),
+                                    p.step);
+        generations_[index] = generation;
+
+        return frames_[index];
+    }
 };
 
+inline NodeState Source<Frame>::wait()
+{
+    auto state = SourceBase<SharedFrameHeader>::wait();
+
+    if (!frames_.empty() && state_ == SourceState::CONNECTED)
+        selectFrame();
+
+    return state;
+}
+
+inline bool Source<Frame>::tryWait(NodeState &state)
+{
+    if (!SourceBase<SharedFrameHeader>::tryWait(state))
+        return false;
+
+    if (!frames_.empty())
+        selectFrame();
+
+    return true;
+}
+
+inline oat::Frame Source<Frame>::clone() const
+{
+    if (mode_ == SourceMode::SYNC)
+        return frame_.clone(copy_hint_);
+
+    oat::Frame frame;
+    readLatest([&](size_t i) { frame = buffer(i).clone(copy_hint_); },
+               frames_.size());
+    return frame;
+}
+
+inline void Source<Frame>::copyTo(oat::Frame &frame) const
+{
+    if (mode_ == SourceMode::SYNC)
+        frame_.copyTo(frame, copy_hint_);
+    else
+        readLatest([&](size_t i) { buffer(i).copyTo(frame, copy_hint_); },
+                   frames_.size());
+}
+
+inline oat::Sample Source<Frame>::sample() const
+{
+    if (mode_ == SourceMode::SYNC)
+        return frame_.sample();
+
+    oat::Sample sample;
+    readLatest([&](size_t i) { sample = buffer(i).sample(); }, frames_.size());
+    return sample;
+}
+
+inline const oat::Frame &Source<Frame>::latest() const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (state_ < SourceState::CONNECTED || !did_wait_need_post_)
+        throw (std::runtime_error("Shared frame can only be borrowed between "
+                                  "wait() and post()."));
+#endif
+
+    return buffer(sh_object_->latest_index());
+}
+
+inline const oat::Frame &Source<Frame>::borrow() const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (state_ < SourceState::CONNECTED || !did_wait_need_post_)
+        throw (std::runtime_error("Shared frame can only be borrowed between "
+                                  "wait() and post()."));
+#endif
+
+    return frame_;
+}
+
+#ifdef HAVE_CUDA
+inline cv::cuda::GpuMat Source<Frame>::borrowDevice() const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (state_ < SourceState::CONNECTED || !did_wait_need_post_
+        || device_buffers_.empty())
+        throw (std::runtime_error("Device frame can only be borrowed between "
+                                  "wait() and post() from a device node."));
+#endif
+
+    return device_buffers_.view(frame_index_,
+                                frame_.rows,
+                                frame_.cols,
+                                frame_.type(),
+                                sh_object_->device_step());
+}
+#endif
+
 inline SourceState Source<Frame>::connect(const oat::PixelColor color)
 {
     auto rc = connect();
@@ -321,50 +908,246 @@ inline SourceState Source<Frame>::connect()
 
     // Wait for the SINK to bind the node and provide matrix
     // header info.
-    if (node_->sink_state() != NodeState::SINK_BOUND) {
+    if (!waitForSink())
+        return SourceState::ERR_CONNECT; // No throw because this can occur
+                                         // at quit
+
+    mapObject();
+
+    // Views are read in place from the node holding their frames
+    if (sh_object_->is_view() && !followView())
+        return SourceState::ERR_CONNECT;
+
+    // Generate frame headers using info in shmem segment
+    frames_.clear();
+    frames_.resize(sh_object_->num_buffers());
+    generations_.assign(sh_object_->num_buffers(), 0);
+    if (!frames_.empty())
+        selectFrame();
+
+    // Device frames can only be read by components that expect them
+    if (sh_object_->on_device()) {
+        if (!accept_device_)
+            throw std::runtime_error("Frame source '" + address_ + "' is kept "
+                                     "in device memory and can only be read "
+                                     "by GPU filters. Unset device-frames on "
+                                     "the component writing it.");
+#ifdef HAVE_CUDA
+        device_buffers_.open(*sh_object_);
+#else
+        throw std::runtime_error("Frame source '" + address_ + "' is kept in "
+                                 "device memory, but Oat was built without "
+                                 "CUDA support.");
+#endif
+    }
 
-        if (wait() != NodeState::SINK_BOUND)
-            return SourceState::ERR_CONNECT; // No throw because this can occur
-                                             // at quit
+    state_ = SourceState::CONNECTED;
+    return SourceState::CONNECTED;
+}
 
-        // Self post since all loops start with wait() and we just
-        // finished our wait(). This will make the first call to
-        // wait() a 'freebie'
-        node_->read_barrier(slot_index_).post();
-        did_wait_need_post_ = false;
+inline oat::Frame Source<Frame>::plane(const FramePlane plane) const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if (state_ < SourceState::CONNECTED || !did_wait_need_post_)
+        throw (std::runtime_error("Frame planes can only be borrowed between "
+                                  "wait() and post()."));
+#endif
+
+    const auto filter = pyramid_filter();
+    const auto p = planeParams(plane, parameters_, filter);
+    if (p.rows == 0)
+        throw std::runtime_error("Frames of source '" + address_ + "' have no "
+                                 + plane_str(plane) + " plane.");
+
+    void *sample = segment_.address(sh_object_->sample(frame_index_));
+
+    // Pyramid levels are halved from the level above, which is itself read
+    // from the node where it can be
+    auto from = [this, plane]() -> cv::Mat {
+        FramePlane parent;
+        if (parent_plane(plane, parent))
+            return this->plane(parent);
+        return frame_;
+    };
+
+    if (hosts(plane)) {
+
+        // The plane may be in payload added since the last mapping
+        segment_.update(prefault_);
+
+        auto &slot = sh_object_->plane(frame_index_, static_cast<size_t>(plane));
+        oat::Frame out(p.rows, p.cols, p.type, p.color,
+                       segment_.address(slot.data), sample, p.step);
+
+        // Planes are tagged with the number of the write they derive from.
+        // The sink cannot overwrite the frame while this source reads it. It
+        // may have computed the plane itself before publishing the frame.
+        const uint64_t tag = node_->read_number(slot_index_) + 1;
+        if (slot.ready.load(std::memory_order_acquire) == tag)
+            return out;
+
+        uint64_t claimed = slot.claimed.load(std::memory_order_acquire);
+        if (claimed != tag && slot.claimed.compare_exchange_strong(claimed, tag)) {
+            derivePlane(plane, from(), out, filter);
+            slot.ready.store(tag, std::memory_order_release);
+            return out;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now()
+                            + std::chrono::milliseconds(int {PLANE_WAIT_MS});
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (slot.ready.load(std::memory_order_acquire) == tag)
+                return out;
+            std::this_thread::yield();
+        }
     }
 
-    // Find an existing shared object constructed by the SINK
-    obj_shmem_ =
-            bip::managed_shared_memory(bip::open_only, obj_address_.c_str());
-    std::pair<SharedFrameHeader *, size_t> temp =
-            obj_shmem_.find<SharedFrameHeader>(typeid(SharedFrameHeader).name());
-    sh_object_ = temp.first;
+    auto &own = own_planes_[static_cast<size_t>(plane)];
+    own.create(p.rows, p.cols, p.type);
+    derivePlane(plane, from(), own, filter);
 
-    // Only occurs when the name of the shared object does not match typeid(T).name()
-    if (sh_object_ == nullptr) {
-        state_ = SourceState::ERR_TYPEMIS;
-        throw std::runtime_error("Type mismatch: Source<T> can only connect to Node<T>.");
+    return oat::Frame(own.rows, own.cols, own.type(), p.color, own.data,
+                      sample, own.step);
+}
+
+inline bool Source<Frame>::followView()
+{
+    const std::string view_address = address_;
+    auto rect = sh_object_->view_rect();
+
+    for (int depth = 0; sh_object_->is_view(); depth++) {
+
+        if (depth == MAX_VIEW_DEPTH)
+            throw std::runtime_error("Frame source '" + view_address + "' is "
+                                     "a view of views nested more than "
+                                     + std::to_string(MAX_VIEW_DEPTH)
+                                     + " deep. Is there a cycle?");
+
+        const std::string parent = sh_object_->view_parent();
+
+        // Leave the view, dropping any wake-ups it gave this slot so that
+        // they are not inherited by the next source to take it
+        while (node_->read_barrier(slot_index_).try_wait()) { }
+        node_->releaseSlot(slot_index_);
+
+        if (!openNode(parent)) {
+            state_ = SourceState::ERR_NODEFULL;
+            throw std::runtime_error("Frame source '" + parent + "', the "
+                                     "parent of view '" + view_address
+                                     + "', has no free source slots.");
+        }
+
+        if (!waitForSink())
+            return false;
+
+        mapObject();
+
+        // Rectangles of views of views are relative to the view they crop
+        if (sh_object_->is_view()) {
+            const auto outer = sh_object_->view_rect();
+            rect = (rect + outer.tl()) & outer;
+        }
     }
 
-    // Generate frame header using info in shmem segment
-    auto p = sh_object_->params();
-    frame_ = oat::Frame(p.rows,
-                        p.cols,
-                        p.type,
-                        p.color,
-                        obj_shmem_.get_address_from_handle(sh_object_->data()),
-                        obj_shmem_.get_address_from_handle(sh_object_->sample()));
-
-    // Save parameters to construct cv::Mats with
-    parameters_.cols = p.cols;
-    parameters_.rows = p.rows;
-    parameters_.type = p.type;
-    parameters_.color = p.color;
-    parameters_.bytes = frame_.total() * frame_.elemSize();
+    if (sh_object_->on_device())
+        throw std::runtime_error("View '" + view_address + "' refers to frame "
+                                 "source '" + address_ + "', which is kept in "
+                                 "device memory. Views can only be made of "
+                                 "host frames.");
 
-    state_ = SourceState::CONNECTED;
-    return SourceState::CONNECTED;
+    is_view_ = true;
+    view_ = rect;
+
+    return true;
+}
+
+// 2. SharedPosition
+
+template <>
+class Source<Position2D> : public SourceBase<SharedPosition> {
+public:
+
+    /**
+     * @brief Get the position record that this source must read during the
+     * current critical section. In LATEST mode, this is the latest completed
+     * record, which is not protected from being overwritten.
+     * @return Shared position record.
+     */
+    const oat::PositionRecord *retrieve() const;
+
+    /**
+     * @brief Copy the shared position into a new Position2D carrying the
+     * label that the sink bound the node with.
+     * @return Position.
+     */
+    oat::Position2D clone() const;
+
+    /**
+     * @brief Copy the shared position into an existing Position2D. The label
+     * of the destination is untouched.
+     * @param position Destination position.
+     */
+    void copyTo(oat::Position2D &position) const;
+
+    const char *label() const { return sh_object_->label(); }
+
+    /**
+     * @brief Recent positions kept by the node, which may be scanned at any
+     * time after connecting, inside or outside of critical sections.
+     * @return Null if the node's sink keeps no history.
+     */
+    const oat::PositionHistoryRing *history() const;
+};
+
+inline const oat::PositionRecord *Source<Position2D>::retrieve() const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if(state_ < SourceState::CONNECTED)
+        throw (std::runtime_error("Source must be connected before shared object is retrieved."));
+#endif
+
+    return mode_ == SourceMode::SYNC
+           ? &sh_object_->record(node_->read_index(slot_index_))
+           : &sh_object_->record(sh_object_->latest_index());
+}
+
+inline const oat::PositionHistoryRing *Source<Position2D>::history() const
+{
+    if (state_ < SourceState::CONNECTED || sh_object_->history_capacity() == 0)
+        return nullptr;
+
+    return static_cast<const PositionHistoryRing *>(segment_.payload());
+}
+
+inline oat::Position2D Source<Position2D>::clone() const
+{
+    oat::Position2D position(sh_object_->label());
+    copyTo(position);
+    return position;
+}
+
+inline void Source<Position2D>::copyTo(oat::Position2D &position) const
+{
+#ifndef NDEBUG
+    // Don't use Asserts because it does not clean shmem
+    if(state_ < SourceState::CONNECTED)
+        throw (std::runtime_error("Source must be connected before shared object is cloned."));
+#endif
+
+    position.setCoordSystem(sh_object_->unit_of_length(),
+                            sh_object_->homography());
+
+    if (mode_ == SourceMode::SYNC) {
+        position.set_record(sh_object_->record(node_->read_index(slot_index_)));
+        return;
+    }
+
+    oat::PositionRecord record;
+    readLatest([&](size_t i) { record = sh_object_->record(i); },
+               sh_object_->num_buffers());
+    position.set_record(record);
 }
 
 }      /* namespace oat */
@@ -0,0 +1,191 @@
+//******************************************************************************
+//* File:   SourceLoop.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_SOURCELOOP_H
+#define	OAT_SOURCELOOP_H
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "../base/Globals.h"
+#include "SampleEvent.h"
+#include "Source.h"
+
+namespace oat {
+
+/**
+ * @brief Event loop that serves many sources from a single thread. Each
+ * source is added with a handler that the loop calls, between the source's
+ * wait() and post(), whenever the source has a sample, so samples are taken
+ * in the order they are written rather than by blocking on each source in
+ * turn. When no source has a sample, the loop sleeps until any of their
+ * nodes is written. The handler of a source whose sink has left is called
+ * once more with NodeState::END, after which the source is no longer served.
+ *
+ *     oat::SourceLoop loop;
+ *     loop.add(frames, [&](oat::NodeState s) { ... frames.retrieve() ... });
+ *     loop.add(positions, [&](oat::NodeState s) { ... });
+ *     loop.run();
+ *
+ * Waits without futex synchronization poll the sources' nodes every
+ * SampleEvent::pollPeriod().
+ */
+class SourceLoop {
+
+public:
+
+    using Handler = std::function<void(NodeState)>;
+
+    /**
+     * @brief Serve a connected source.
+     * @param source Source to serve. Must outlive the loop.
+     * @param handler Called with the sink state each time the source has a
+     * sample. The source is posted when it returns.
+     * @return Index of the source in the loop.
+     */
+    template <typename T>
+    size_t add(SourceBase<T> &source, Handler handler)
+    {
+        Entry e;
+        e.try_wait = [&source](NodeState &s) { return source.tryWait(s); };
+        e.post = [&source] { source.post(); };
+        e.event = &source.sample_event();
+        e.handler = std::move(handler);
+        entries_.push_back(std::move(e));
+
+        return entries_.size() - 1;
+    }
+
+    /**
+     * @brief Stop or resume serving a source, e.g. to hold back one that is
+     * ahead of the others.
+     */
+    void set_paused(const size_t index, const bool paused)
+    {
+        entries_.at(index).paused = paused;
+    }
+
+    /**
+     * @brief True once the sink of the source has left.
+     */
+    bool ended(const size_t index) const { return entries_.at(index).ended; }
+
+    /**
+     * @brief Number of sources that are still served, i.e. not ended or
+     * paused.
+     */
+    size_t active() const
+    {
+        return std::count_if(entries_.begin(), entries_.end(),
+                             [](const Entry &e) { return e.live(); });
+    }
+
+    /**
+     * @brief Call the handler of each source that has a sample, sleeping
+     * until at least one has if none do.
+     * @param timeout Longest time to sleep.
+     * @return Number of handlers called. 0 if the timeout passed, quit was
+     * requested or no source is active.
+     */
+    size_t poll(const std::chrono::nanoseconds timeout)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        while (!quit) {
+
+            // Generations first, so that a write made after a source is
+            // checked ends the sleep below
+            events_.clear();
+            seen_.clear();
+            for (auto &e : entries_) {
+                if (e.live()) {
+                    events_.push_back(e.event);
+                    seen_.push_back(e.event->generation());
+                }
+            }
+
+            if (events_.empty())
+                return 0;
+
+            size_t served = 0;
+            for (auto &e : entries_) {
+
+                NodeState state;
+                if (!e.live() || !e.try_wait(state))
+                    continue;
+
+                e.ended = state == NodeState::END;
+                e.handler(state);
+                e.post();
+                served++;
+            }
+
+            if (served > 0)
+                return served;
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                return 0;
+
+            SampleEvent::waitAny(events_.data(), seen_.data(), events_.size(),
+                                 std::min<std::chrono::nanoseconds>(
+                                     deadline - now, checkPeriod()));
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Serve sources until every one has ended or is paused, or quit
+     * is requested.
+     */
+    void run()
+    {
+        while (!quit && active() > 0)
+            poll(checkPeriod());
+    }
+
+private:
+
+    // Longest sleep before quit is checked again
+    static std::chrono::milliseconds checkPeriod() { return std::chrono::milliseconds(100); }
+
+    struct Entry {
+        std::function<bool(NodeState &)> try_wait;
+        std::function<void()> post;
+        SampleEvent *event {nullptr};
+        Handler handler;
+        bool paused {false};
+        bool ended {false};
+
+        bool live() const { return !paused && !ended; }
+    };
+
+    std::vector<Entry> entries_;
+
+    // Reused by each poll()
+    std::vector<SampleEvent *> events_;
+    std::vector<uint32_t> seen_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_SOURCELOOP_H */
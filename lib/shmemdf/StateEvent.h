@@ -0,0 +1,137 @@
+//******************************************************************************
+//* File:   StateEvent.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_STATEEVENT_H
+#define	OAT_STATEEVENT_H
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+#ifdef USE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace oat {
+
+/**
+ * @brief Process-shared broadcast event for changes that are rare but must
+ * be seen at once, such as a SINK binding its node. It holds a generation
+ * number that every notify() advances. A waiter takes the generation,
+ * checks the state it is interested in, and then sleeps until the
+ * generation moves on, so that no change between the check and the sleep
+ * can be missed. With futex synchronization, waiters sleep in the kernel
+ * and notify() wakes all of them. Otherwise, they poll the generation every
+ * pollPeriod().
+ */
+class StateEvent {
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Futex word must be a plain 32-bit integer.");
+
+public:
+
+    // Polling period of waits without futex synchronization
+    static std::chrono::milliseconds pollPeriod() { return std::chrono::milliseconds(1); }
+
+    StateEvent() = default;
+
+    // Events are not copyable or movable
+    StateEvent(const StateEvent &) = delete;
+    StateEvent &operator=(const StateEvent &) = delete;
+
+    /**
+     * @brief Current generation, to be passed to wait() once the state it
+     * guards has been checked.
+     */
+    uint32_t generation() const
+    {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Advance the generation and wake every waiter.
+     */
+    void notify()
+    {
+        generation_.fetch_add(1, std::memory_order_release);
+#ifdef USE_FUTEX
+        futex(FUTEX_WAKE, INT_MAX, nullptr);
+#endif
+    }
+
+    /**
+     * @brief Sleep until the generation differs from seen, timeout passes,
+     * or a signal is delivered to the calling thread. Safe to call on a
+     * read-only mapping.
+     * @param seen Generation at which the state was last checked.
+     * @param timeout Longest time to sleep.
+     * @return True if the generation moved on.
+     */
+    bool wait(const uint32_t seen, const std::chrono::nanoseconds timeout) const
+    {
+        if (generation() != seen)
+            return true;
+
+#ifdef USE_FUTEX
+        struct timespec ts;
+        ts.tv_sec = timeout.count() / 1000000000;
+        ts.tv_nsec = timeout.count() % 1000000000;
+        futex(FUTEX_WAIT, seen, &ts);
+#else
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (generation() == seen
+               && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(pollPeriod());
+#endif
+
+        return generation() != seen;
+    }
+
+private:
+
+    std::atomic<uint32_t> generation_ {0};
+
+#ifdef USE_FUTEX
+    // ts is a relative timeout or nullptr to wait forever
+    long futex(const int op, const uint32_t val, const struct timespec *ts) const
+    {
+        // NOTE: No FUTEX_PRIVATE_FLAG because the word is shared between
+        // processes
+        return syscall(SYS_futex,
+                       const_cast<uint32_t *>(
+                           reinterpret_cast<const uint32_t *>(&generation_)),
+                       op,
+                       val,
+                       ts,
+                       nullptr,
+                       0);
+    }
+#endif
+};
+
+}      /* namespace oat */
+#endif /* OAT_STATEEVENT_H */
@@ -0,0 +1,144 @@
+//******************************************************************************
+//* File:   Telemetry.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_TELEMETRY_H
+#define	OAT_TELEMETRY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace oat {
+
+/**
+ * @brief Monotonic time in nanoseconds. Comparable across processes on the
+ * same machine.
+ */
+inline uint64_t telemetryNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Lock-free histogram of durations with power of two bins, kept in
+ * shared memory. Bin i counts durations in [2^(i-1), 2^i) nanoseconds. Counts
+ * only ever grow. Observers get a rolling view by taking snapshots and
+ * differencing them.
+ */
+class LatencyHistogram {
+
+public:
+
+    // Bin 40 holds everything from ~9 minutes up
+    static constexpr size_t BINS {41};
+
+    using Snapshot = std::array<uint64_t, BINS>;
+
+    void record(const uint64_t ns)
+    {
+        size_t bin = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+        if (bin >= BINS)
+            bin = BINS - 1;
+
+        counts_[bin].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot s;
+        for (size_t i = 0; i < BINS; i++)
+            s[i] = counts_[i].load(std::memory_order_relaxed);
+        return s;
+    }
+
+    /**
+     * @brief Total count of a snapshot or snapshot difference.
+     */
+    static uint64_t count(const Snapshot &s)
+    {
+        uint64_t n = 0;
+        for (auto c : s)
+            n += c;
+        return n;
+    }
+
+    /**
+     * @brief Approximate quantile of a snapshot or snapshot difference.
+     * @param s Bin counts.
+     * @param q Quantile in [0, 1].
+     * @return Upper bound of the bin holding the quantile, in nanoseconds.
+     * 0 if there are no counts.
+     */
+    static uint64_t quantile(const Snapshot &s, const double q)
+    {
+        const uint64_t n = count(s);
+        if (n == 0)
+            return 0;
+
+        const auto rank = static_cast<uint64_t>(q * (n - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BINS; i++) {
+            seen += s[i];
+            if (seen > rank)
+                return i == 0 ? 0 : (1ULL << i) - 1;
+        }
+
+        return (1ULL << (BINS - 1)) - 1;
+    }
+
+    static Snapshot difference(const Snapshot &now, const Snapshot &then)
+    {
+        Snapshot d;
+        for (size_t i = 0; i < BINS; i++)
+            d[i] = now[i] - then[i];
+        return d;
+    }
+
+private:
+
+    std::array<std::atomic<uint64_t>, BINS> counts_ {};
+};
+
+/**
+ * @brief Losses on the link that a SINK's data arrives over before it is
+ * published, such as the network link of a GigE camera. Totals since the
+ * SINK started publishing, set by producers that can count them and 0 for
+ * all others.
+ */
+struct TransportTelemetry {
+    std::atomic<uint64_t> dropped {0};           //!< Images dropped by the device or driver
+    std::atomic<uint64_t> corrupt {0};           //!< Images that arrived incomplete
+    std::atomic<uint64_t> resends_requested {0}; //!< Packets the host asked to be re-sent
+    std::atomic<uint64_t> resends_received {0};  //!< Re-sent packets that arrived
+};
+
+/**
+ * @brief Timing of a node's SINK, kept in the node's shared memory segment.
+ */
+struct SinkTelemetry {
+    LatencyHistogram wait;           //!< Time spent blocked in wait()
+    LatencyHistogram write_interval; //!< Time between successive post()s
+    std::atomic<uint64_t> last_post_ns {0};
+    TransportTelemetry transport;    //!< Losses upstream of the SINK
+};
+
+}      /* namespace oat */
+#endif /* OAT_TELEMETRY_H */
@@ -0,0 +1,207 @@
+//******************************************************************************
+//* File:   ThreadBudget.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_THREADBUDGET_H
+#define	OAT_THREADBUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "ForwardsDecl.h"
+#include "ProcessId.h"
+#include "StateEvent.h"
+
+namespace oat {
+
+/**
+ * @brief Small shared memory table of the processes that take part in a
+ * machine-wide budget of worker threads, and the weight of each. A process's
+ * share of the budget is its weight over the total weight of the processes
+ * that are running, so shares grow and shrink as components start and stop.
+ * Processes that exit without leaving are dropped when shares are next
+ * computed. Like the Registry, the table is advisory.
+ */
+class ThreadBudget {
+
+public:
+
+    // Shared memory segment holding the table
+    static constexpr const char *SEGMENT {"oat_thread_budget"};
+
+    // Most processes that can take part at once
+    static constexpr size_t CAPACITY {256};
+
+    /**
+     * @brief Open the table, creating it if it does not exist.
+     */
+    ThreadBudget()
+    {
+        shm_ = bip::shared_memory_object(
+                bip::open_or_create, SEGMENT, bip::read_write);
+
+        // Truncating to the current size changes nothing, so a table is made
+        // once, zero filled, however many processes race to open it
+        shm_.truncate(sizeof(Table));
+        region_ = bip::mapped_region(shm_, bip::read_write);
+        table_ = static_cast<Table *>(region_.get_address());
+
+        uint64_t unset = 0;
+        table_->layout.compare_exchange_strong(unset, LAYOUT);
+        if (table_->layout != LAYOUT)
+            throw std::runtime_error(std::string("Shared memory at '")
+                    + SEGMENT + "' was made by an incompatible version of "
+                    "Oat. Use oat-clean to remove it.");
+    }
+
+    /**
+     * @brief Add this process to the table, or change its weight if it has
+     * joined already.
+     * @param weight Relative size of the process's share.
+     * @return False if the table is full.
+     */
+    bool join(const uint32_t weight)
+    {
+        const auto self = ProcessId::self();
+
+        if (Entry *e = find(self)) {
+            e->weight.store(weight, std::memory_order_relaxed);
+            table_->changes.notify();
+            return true;
+        }
+
+        for (auto &e : table_->entries) {
+
+            uint32_t unclaimed = FREE;
+            if (!e.state.compare_exchange_strong(unclaimed, CLAIMED))
+                continue;
+
+            e.owner = self;
+            e.weight.store(weight, std::memory_order_relaxed);
+            e.state.store(JOINED, std::memory_order_release);
+            table_->changes.notify();
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Remove this process from the table.
+     */
+    void leave()
+    {
+        if (Entry *e = find(ProcessId::self()))
+            release(*e);
+    }
+
+    /**
+     * @brief This process's share of a budget, in threads. At least one
+     * thread, even when there are more processes than threads.
+     * @param total Threads in the budget.
+     */
+    size_t share(const size_t total)
+    {
+        const auto self = ProcessId::self();
+
+        uint64_t total_weight = 0, own_weight = 0;
+        for (auto &e : table_->entries) {
+
+            if (e.state.load(std::memory_order_acquire) != JOINED)
+                continue;
+
+            if (!e.owner.alive()) {
+                release(e);
+                continue;
+            }
+
+            const uint64_t w = e.weight.load(std::memory_order_relaxed);
+            total_weight += w;
+            if (same(e.owner, self))
+                own_weight += w;
+        }
+
+        if (own_weight == 0)
+            return total;
+
+        const size_t n = total * own_weight / total_weight;
+        return n > 0 ? n : 1;
+    }
+
+    /**
+     * @brief Advanced by each process that joins, leaves or changes its
+     * weight. Take the generation, compute the share, then compare the
+     * generation again later to see whether the share may have changed.
+     */
+    uint32_t generation() const { return table_->changes.generation(); }
+
+private:
+
+    // Entry states
+    static constexpr uint32_t FREE {0}, CLAIMED {1}, JOINED {2};
+
+    struct Entry {
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> weight;
+        ProcessId owner;
+    };
+
+    struct Table {
+        std::atomic<uint64_t> layout;
+        StateEvent changes;
+        Entry entries[CAPACITY];
+    };
+
+    static constexpr uint64_t LAYOUT {
+        CAPACITY | static_cast<uint64_t>(sizeof(Table)) << 32};
+
+    bip::shared_memory_object shm_;
+    bip::mapped_region region_;
+    Table *table_ {nullptr};
+
+    static bool same(const ProcessId &a, const ProcessId &b)
+    {
+        return a.pid == b.pid && a.start == b.start;
+    }
+
+    Entry *find(const ProcessId &owner)
+    {
+        for (auto &e : table_->entries)
+            if (e.state.load(std::memory_order_acquire) == JOINED
+                && same(e.owner, owner))
+                return &e;
+
+        return nullptr;
+    }
+
+    void release(Entry &e)
+    {
+        uint32_t joined = JOINED;
+        if (e.state.compare_exchange_strong(joined, FREE))
+            table_->changes.notify();
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_THREADBUDGET_H */
@@ -0,0 +1,544 @@
+//******************************************************************************
+//* File:   OatShmemdf.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "oat_shmemdf.h"
+
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+
+#include "../../datatypes/Frame.h"
+#include "../../datatypes/Position2D.h"
+#include "../PositionBus.h"
+#include "../Sink.h"
+#include "../Source.h"
+
+namespace oat {
+
+// Global via extern in Globals.h
+volatile sig_atomic_t quit = 0;
+
+}
+
+// Handles are the C++ objects under other names
+struct oat_frame_sink {
+    oat::Sink<oat::Frame> sink;
+    oat::Frame frame;
+};
+
+struct oat_frame_source {
+    oat::Source<oat::Frame> source;
+};
+
+struct oat_position_sink {
+    oat::Sink<oat::Position2D> sink;
+    oat::Position2D position {""};
+};
+
+struct oat_position_source {
+    oat::Source<oat::Position2D> source;
+    oat::Position2D position {""};
+};
+
+struct oat_position_bus {
+    std::unique_ptr<oat::PositionBus> bus;
+
+    // Positions written through this handle, for their sample numbers, and
+    // read through it
+    std::vector<oat::Position2D> written {oat::PositionBus::CAPACITY,
+                                          oat::Position2D("")};
+    oat::Position2D read {""};
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+struct sigaction previous_sigint;
+
+void sigintHandler(int sig)
+{
+    oat::quit = 1;
+
+    if (previous_sigint.sa_flags & SA_SIGINFO) {
+        previous_sigint.sa_sigaction(sig, nullptr, nullptr);
+    } else if (previous_sigint.sa_handler == SIG_DFL) {
+        sigaction(SIGINT, &previous_sigint, nullptr);
+        raise(sig);
+    } else if (previous_sigint.sa_handler != SIG_IGN) {
+        previous_sigint.sa_handler(sig);
+    }
+}
+
+template <typename F>
+int guard(F f)
+{
+    try {
+        return f();
+    } catch (const std::exception &ex) {
+        last_error = ex.what();
+    } catch (...) {
+        last_error = "Unknown exception.";
+    }
+    return -1;
+}
+
+template <typename H, typename F>
+H *make(F f)
+{
+    H *handle = nullptr;
+    try {
+        handle = new H();
+        if (f(*handle))
+            return handle;
+    } catch (const std::exception &ex) {
+        last_error = ex.what();
+    } catch (...) {
+        last_error = "Unknown exception.";
+    }
+
+    delete handle;
+    return nullptr;
+}
+
+template <typename H>
+H *open(const char *address, const int latest)
+{
+    return make<H>([address, latest](H &h) {
+        h.source.touch(address, latest ? oat::SourceMode::LATEST
+                                       : oat::SourceMode::SYNC);
+        if (h.source.connect() == oat::SourceState::CONNECTED)
+            return true;
+
+        last_error = "Could not connect to " + std::string(address) + ".";
+        return false;
+    });
+}
+
+template <typename H>
+int wait(H *h)
+{
+    return guard([h] {
+        if (h->source.wait() == oat::NodeState::END)
+            return OAT_END;
+        return oat::quit ? OAT_INTERRUPTED : OAT_OK;
+    });
+}
+
+template <typename H>
+int post(H *h)
+{
+    return guard([h] {
+        h->source.post();
+        return OAT_OK;
+    });
+}
+
+void count(oat::Sample &sample, const uint64_t capture_ns)
+{
+    sample.incrementCount();
+    if (capture_ns != 0)
+        sample.set_clock(oat::Sample::ClockSource::HOST,
+                         capture_ns,
+                         std::chrono::nanoseconds(0));
+}
+
+void lend(const oat::Frame &f, oat_frame *out)
+{
+    const auto s = f.sample();
+    out->data = f.data;
+    out->rows = f.rows;
+    out->cols = f.cols;
+    out->type = f.type();
+    out->color = f.color();
+    out->step = f.step;
+    out->sample_count = s.count();
+    out->sample_usec = s.microseconds().count();
+    out->rate_hz = s.rate_hz();
+}
+
+void lend(const oat::Position2D &p, oat_position *out)
+{
+    out->sample_count = p.sample_count();
+    out->sample_usec = p.sample_usec();
+    out->unit = static_cast<int32_t>(p.unit_of_length());
+    out->position_valid = p.position_valid;
+    out->velocity_valid = p.velocity_valid;
+    out->heading_valid = p.heading_valid;
+    out->region_valid = p.region_valid;
+    out->position[0] = p.position.x;
+    out->position[1] = p.position.y;
+    out->velocity[0] = p.velocity.x;
+    out->velocity[1] = p.velocity.y;
+    out->heading[0] = p.heading.x;
+    out->heading[1] = p.heading.y;
+    out->score = p.score;
+    std::memcpy(out->region, p.region, sizeof(out->region));
+}
+
+void assign(const oat_position &in, oat::Position2D &p)
+{
+    p.setCoordSystem(static_cast<oat::DistanceUnit>(in.unit), p.homography());
+    p.position_valid = in.position_valid != 0;
+    p.velocity_valid = in.velocity_valid != 0;
+    p.heading_valid = in.heading_valid != 0;
+    p.region_valid = in.region_valid != 0;
+    p.position = {in.position[0], in.position[1]};
+    p.velocity = {in.velocity[0], in.velocity[1]};
+    p.heading = {in.heading[0], in.heading[1]};
+    p.score = in.score;
+    std::memcpy(p.region, in.region, sizeof(p.region));
+    p.region[sizeof(p.region) - 1] = '\0';
+}
+
+size_t channelIndex(const int channel)
+{
+    if (channel < 0 || static_cast<size_t>(channel) >= oat::PositionBus::CAPACITY)
+        throw std::runtime_error("No bus channel " + std::to_string(channel)
+                                 + ".");
+    return static_cast<size_t>(channel);
+}
+
+} /* namespace */
+
+extern "C" {
+
+// General
+
+int oat_abi_version() { return OAT_SHMEMDF_ABI_VERSION; }
+
+const char *oat_last_error() { return last_error.c_str(); }
+
+void oat_request_quit() { oat::quit = 1; }
+
+void oat_clear_quit() { oat::quit = 0; }
+
+int oat_quit_requested() { return oat::quit != 0; }
+
+void oat_install_sigint_handler()
+{
+    static bool installed = false;
+    if (installed)
+        return;
+
+    // No SA_RESTART, so that futex waits are interrupted
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = sigintHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &previous_sigint);
+    installed = true;
+}
+
+// Frame sinks
+
+oat_frame_sink *oat_frame_sink_bind(const char *address,
+                                    int32_t rows,
+                                    int32_t cols,
+                                    int32_t type,
+                                    int32_t color,
+                                    uint64_t step,
+                                    uint32_t num_buffers,
+                                    double rate_hz)
+{
+    return make<oat_frame_sink>([=](oat_frame_sink &h) {
+        const size_t row_bytes = step ? step : cols * CV_ELEM_SIZE(type);
+        h.sink.bind(address, rows * row_bytes, num_buffers);
+        h.frame = h.sink.retrieve(rows,
+                                  cols,
+                                  type,
+                                  static_cast<oat::PixelColor>(color),
+                                  step);
+        if (rate_hz > 0)
+            h.frame.set_rate_hz(rate_hz);
+        return true;
+    });
+}
+
+int oat_frame_sink_wait(oat_frame_sink *sink, oat_frame *out)
+{
+    return guard([sink, out] {
+        sink->sink.wait();
+        if (oat::quit)
+            return OAT_INTERRUPTED;
+
+        sink->frame = sink->sink.retrieve();
+        lend(sink->frame, out);
+        return OAT_OK;
+    });
+}
+
+int oat_frame_sink_post(oat_frame_sink *sink, uint64_t capture_ns)
+{
+    return guard([sink, capture_ns] {
+        auto sample = sink->frame.sample();
+        count(sample, capture_ns);
+        sink->frame.set_sample(sample);
+        sink->sink.post();
+        return OAT_OK;
+    });
+}
+
+void oat_frame_sink_close(oat_frame_sink *sink) { delete sink; }
+
+// Frame sources
+
+oat_frame_source *oat_frame_source_open(const char *address, int latest)
+{
+    return open<oat_frame_source>(address, latest);
+}
+
+int oat_frame_source_wait(oat_frame_source *source) { return wait(source); }
+
+int oat_frame_source_borrow(oat_frame_source *source, oat_frame *out)
+{
+    return guard([source, out] {
+        lend(source->source.borrow(), out);
+        return OAT_OK;
+    });
+}
+
+int oat_frame_source_post(oat_frame_source *source) { return post(source); }
+
+uint64_t oat_frame_source_dropped(const oat_frame_source *source)
+{
+    return source->source.dropped();
+}
+
+void oat_frame_source_close(oat_frame_source *source) { delete source; }
+
+// Position sinks
+
+oat_position_sink *oat_position_sink_bind(const char *address,
+                                          uint32_t num_buffers,
+                                          double rate_hz)
+{
+    return make<oat_position_sink>([=](oat_position_sink &h) {
+        h.sink.bind(address, address, num_buffers);
+        if (rate_hz > 0)
+            h.position.set_rate_hz(rate_hz);
+        return true;
+    });
+}
+
+int oat_position_sink_write(oat_position_sink *sink,
+                            const oat_position *position,
+                            uint64_t capture_ns)
+{
+    return guard([sink, position, capture_ns] {
+        auto &p = sink->position;
+        auto sample = p.sample();
+        count(sample, capture_ns);
+        p.set_sample(sample);
+
+        assign(*position, p);
+
+        sink->sink.wait();
+        if (oat::quit)
+            return OAT_INTERRUPTED;
+
+        sink->sink.write(p);
+        sink->sink.post();
+        return OAT_OK;
+    });
+}
+
+void oat_position_sink_close(oat_position_sink *sink) { delete sink; }
+
+// Position sources
+
+oat_position_source *oat_position_source_open(const char *address, int latest)
+{
+    return open<oat_position_source>(address, latest);
+}
+
+int oat_position_source_wait(oat_position_source *source)
+{
+    return wait(source);
+}
+
+int oat_position_source_read(oat_position_source *source, oat_position *out)
+{
+    return guard([source, out] {
+        source->source.copyTo(source->position);
+        lend(source->position, out);
+        return OAT_OK;
+    });
+}
+
+int oat_position_source_pack(oat_position_source *source, char *out)
+{
+    return guard([source, out] {
+        source->source.copyTo(source->position);
+        oat::packPosition(source->position, out);
+        return OAT_OK;
+    });
+}
+
+int oat_position_source_post(oat_position_source *source)
+{
+    return post(source);
+}
+
+uint64_t oat_position_source_dropped(const oat_position_source *source)
+{
+    return source->source.dropped();
+}
+
+void oat_position_source_close(oat_position_source *source) { delete source; }
+
+// Position buses
+
+oat_position_bus *oat_position_bus_open(const char *name)
+{
+    return make<oat_position_bus>([name](oat_position_bus &h) {
+        h.bus.reset(new oat::PositionBus(name));
+        return true;
+    });
+}
+
+int oat_position_bus_claim(oat_position_bus *bus, const char *channel)
+{
+    return guard([bus, channel] {
+        return static_cast<int>(bus->bus->claim(channel));
+    });
+}
+
+int oat_position_bus_write(oat_position_bus *bus,
+                           int channel,
+                           const oat_position *position,
+                           uint64_t capture_ns)
+{
+    return guard([bus, channel, position, capture_ns] {
+        const size_t i = channelIndex(channel);
+        auto &p = bus->written[i];
+
+        // Channels taken over from a writer that exited carry on counting
+        auto sample = p.sample();
+        if (sample.count() == 0)
+            sample.set_count(bus->bus->writes(i));
+        count(sample, capture_ns);
+        p.set_sample(sample);
+
+        assign(*position, p);
+        auto record = p.record();
+        record.sample.stamp();
+        bus->bus->write(i, record, p.unit_of_length(), p.homography());
+        return OAT_OK;
+    });
+}
+
+int oat_position_bus_name(const oat_position_bus *bus,
+                          int channel,
+                          char *out,
+                          size_t len)
+{
+    return guard([bus, channel, out, len] {
+        const auto name = bus->bus->name(channelIndex(channel));
+        if (len > 0) {
+            std::strncpy(out, name.c_str(), len);
+            out[len - 1] = '\0';
+        }
+        return static_cast<int>(name.size());
+    });
+}
+
+int oat_position_bus_find(const oat_position_bus *bus, const char *channel)
+{
+    return guard([bus, channel] {
+        const size_t i = bus->bus->find(channel);
+        if (i >= oat::PositionBus::CAPACITY)
+            throw std::runtime_error("No channel '" + std::string(channel)
+                                     + "'.");
+        return static_cast<int>(i);
+    });
+}
+
+uint64_t oat_position_bus_writes(const oat_position_bus *bus, int channel)
+{
+    if (channel < 0 || static_cast<size_t>(channel) >= oat::PositionBus::CAPACITY)
+        return 0;
+
+    return bus->bus->writes(static_cast<size_t>(channel));
+}
+
+uint32_t oat_position_bus_generation(const oat_position_bus *bus)
+{
+    return bus->bus->generation();
+}
+
+int oat_position_bus_wait(oat_position_bus *bus,
+                          uint32_t seen,
+                          uint64_t timeout_ns)
+{
+    return guard([bus, seen, timeout_ns] {
+        const bool written =
+            bus->bus->wait(seen, std::chrono::nanoseconds(timeout_ns));
+        if (oat::quit)
+            return OAT_INTERRUPTED;
+        return written ? OAT_OK : OAT_TIMEOUT;
+    });
+}
+
+int oat_position_bus_read(oat_position_bus *bus,
+                          int channel,
+                          oat_position *out,
+                          uint64_t *write)
+{
+    return guard([bus, channel, out, write] {
+        const uint64_t n = bus->bus->read(channelIndex(channel), bus->read);
+        if (write != nullptr)
+            *write = n;
+        if (n == 0)
+            return OAT_EMPTY;
+
+        lend(bus->read, out);
+        return OAT_OK;
+    });
+}
+
+int oat_position_bus_pack(oat_position_bus *bus,
+                          int channel,
+                          char *out,
+                          uint64_t *write)
+{
+    return guard([bus, channel, out, write] {
+        const uint64_t n = bus->bus->read(channelIndex(channel), bus->read);
+        if (write != nullptr)
+            *write = n;
+        if (n == 0)
+            return OAT_EMPTY;
+
+        oat::packPosition(bus->read, out);
+        return OAT_OK;
+    });
+}
+
+void oat_position_bus_close(oat_position_bus *bus) { delete bus; }
+
+size_t oat_position_bytes() { return oat::Position2D::NPY_DTYPE_BYTES; }
+
+const char *oat_position_dtype() { return oat::Position2D::NPY_DTYPE; }
+
+} /* extern "C" */
@@ -0,0 +1,330 @@
+//******************************************************************************
+//* File:   oat_shmemdf.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+/*
+ * Stable C interface to Oat frame and position nodes, for programs that are
+ * not Oat components, such as acquisition software written in another
+ * language or loaded through an FFI. Sinks publish into an Oat graph and
+ * sources read from it exactly as components do.
+ *
+ * Handles are opaque. Functions that can fail return a negative value, or
+ * NULL, after which oat_last_error() describes the failure on the calling
+ * thread. Waits return early with OAT_INTERRUPTED once oat_request_quit() is
+ * called, e.g. from a signal handler.
+ *
+ * Structures are only ever extended at their end, and OAT_SHMEMDF_ABI_VERSION
+ * changes whenever a function or structure changes incompatibly.
+ */
+
+#ifndef OAT_SHMEMDF_C_H
+#define OAT_SHMEMDF_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OAT_SHMEMDF_ABI_VERSION 1
+
+/* Return values of waits */
+#define OAT_OK 0
+#define OAT_END 1          /* The node's sink has left */
+#define OAT_INTERRUPTED 2  /* oat_request_quit() was called */
+#define OAT_TIMEOUT 3      /* Nothing was written before the timeout */
+#define OAT_EMPTY 4        /* Nothing has been written to the channel */
+
+/* Length of position region labels, including the terminating null */
+#define OAT_REGION_LEN 10
+
+/* Channels of a position bus, and the length of their names including the
+ * terminating null */
+#define OAT_BUS_CAPACITY 64
+#define OAT_BUS_NAME_LEN 32
+
+typedef struct oat_frame_sink oat_frame_sink;
+typedef struct oat_frame_source oat_frame_source;
+typedef struct oat_position_sink oat_position_sink;
+typedef struct oat_position_source oat_position_source;
+typedef struct oat_position_bus oat_position_bus;
+
+/**
+ * @brief A frame in shared memory. Sinks fill data between wait and post.
+ * Sources must treat data as read-only and only use it until their next post.
+ */
+typedef struct oat_frame {
+    void *data;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;  /* OpenCV matrix type, e.g. 16 for CV_8UC3 */
+    int32_t color; /* oat::PixelColor, e.g. 2 for BGR */
+    uint64_t step; /* Bytes per row, including any padding */
+    uint64_t sample_count;
+    uint64_t sample_usec;
+    double rate_hz;
+} oat_frame;
+
+/**
+ * @brief A position. Sample fields are set by sources and ignored by sinks,
+ * which count samples themselves.
+ */
+typedef struct oat_position {
+    uint64_t sample_count;
+    uint64_t sample_usec;
+    int32_t unit; /* oat::DistanceUnit: 0 for pixels, 1 for world units */
+    int32_t position_valid;
+    int32_t velocity_valid;
+    int32_t heading_valid;
+    int32_t region_valid;
+    double position[2];
+    double velocity[2];
+    double heading[2];
+    double score;
+    char region[OAT_REGION_LEN];
+} oat_position;
+
+/* General */
+
+/** @brief OAT_SHMEMDF_ABI_VERSION of the library that was loaded. */
+int oat_abi_version(void);
+
+/** @brief Description of the last failure on the calling thread. */
+const char *oat_last_error(void);
+
+/** @brief Make waits on any thread return OAT_INTERRUPTED. Signal safe. */
+void oat_request_quit(void);
+
+/** @brief Allow waits to block again after oat_request_quit(). */
+void oat_clear_quit(void);
+
+/** @brief True if oat_request_quit() was called, or SIGINT received. */
+int oat_quit_requested(void);
+
+/**
+ * @brief Request quit on SIGINT, then call the handler that was installed
+ * before, e.g. that of an interpreter. Waits are not restarted after SIGINT.
+ */
+void oat_install_sigint_handler(void);
+
+/* Frame sinks */
+
+/**
+ * @brief Bind a frame node and allocate its buffers.
+ * @param step Bytes per row, or 0 for packed rows.
+ * @param num_buffers Number of frame buffers written round-robin, between 1
+ * and 8.
+ * @param rate_hz Sample rate of the frames, or 0 if unknown.
+ */
+oat_frame_sink *oat_frame_sink_bind(const char *address,
+                                    int32_t rows,
+                                    int32_t cols,
+                                    int32_t type,
+                                    int32_t color,
+                                    uint64_t step,
+                                    uint32_t num_buffers,
+                                    double rate_hz);
+
+/**
+ * @brief Wait until sources have read the buffer to be written, and lend it
+ * through out for writing.
+ * @return OAT_OK or OAT_INTERRUPTED.
+ */
+int oat_frame_sink_wait(oat_frame_sink *sink, oat_frame *out);
+
+/**
+ * @brief Count the frame written since the last wait and publish it.
+ * @param capture_ns Capture time on the host's CLOCK_MONOTONIC, in
+ * nanoseconds, or 0 if unknown.
+ */
+int oat_frame_sink_post(oat_frame_sink *sink, uint64_t capture_ns);
+
+/** @brief Unbind the node. Sources see the end of the stream. */
+void oat_frame_sink_close(oat_frame_sink *sink);
+
+/* Frame sources */
+
+/**
+ * @brief Attach to a frame node. Blocks until its sink binds.
+ * @param latest If nonzero, read the most recent frame instead of every
+ * frame. The sink never waits for this source.
+ */
+oat_frame_source *oat_frame_source_open(const char *address, int latest);
+
+/** @return OAT_OK, OAT_END or OAT_INTERRUPTED. */
+int oat_frame_source_wait(oat_frame_source *source);
+
+/** @brief Lend the frame read since the last wait. */
+int oat_frame_source_borrow(oat_frame_source *source, oat_frame *out);
+
+/** @brief Tell the sink that the frame has been read. */
+int oat_frame_source_post(oat_frame_source *source);
+
+/** @brief Frames skipped by a latest-value source. */
+uint64_t oat_frame_source_dropped(const oat_frame_source *source);
+
+void oat_frame_source_close(oat_frame_source *source);
+
+/* Position sinks */
+
+/**
+ * @brief Bind a position node.
+ * @param num_buffers Number of positions written round-robin, between 1 and
+ * 8.
+ * @param rate_hz Sample rate of the positions, or 0 if unknown.
+ */
+oat_position_sink *oat_position_sink_bind(const char *address,
+                                          uint32_t num_buffers,
+                                          double rate_hz);
+
+/**
+ * @brief Wait until sources have read, then count and publish a position.
+ * @param capture_ns Capture time on the host's CLOCK_MONOTONIC, in
+ * nanoseconds, or 0 if unknown.
+ * @return OAT_OK or OAT_INTERRUPTED.
+ */
+int oat_position_sink_write(oat_position_sink *sink,
+                            const oat_position *position,
+                            uint64_t capture_ns);
+
+/** @brief Unbind the node. Sources see the end of the stream. */
+void oat_position_sink_close(oat_position_sink *sink);
+
+/* Position sources */
+
+/**
+ * @brief Attach to a position node. Blocks until its sink binds.
+ * @param latest If nonzero, read the most recent position instead of every
+ * position. The sink never waits for this source.
+ */
+oat_position_source *oat_position_source_open(const char *address, int latest);
+
+/** @return OAT_OK, OAT_END or OAT_INTERRUPTED. */
+int oat_position_source_wait(oat_position_source *source);
+
+/** @brief Copy the position read since the last wait. */
+int oat_position_source_read(oat_position_source *source, oat_position *out);
+
+/**
+ * @brief Pack the position read since the last wait into out, in the layout
+ * of binary position files written by oat-record.
+ * @param out Buffer of at least oat_position_bytes() bytes.
+ */
+int oat_position_source_pack(oat_position_source *source, char *out);
+
+/** @brief Tell the sink that the position has been read. */
+int oat_position_source_post(oat_position_source *source);
+
+/** @brief Positions skipped by a latest-value source. */
+uint64_t oat_position_source_dropped(const oat_position_source *source);
+
+void oat_position_source_close(oat_position_source *source);
+
+/* Position buses */
+
+/*
+ * A bus holds the latest position of up to OAT_BUS_CAPACITY named channels in
+ * one segment, and wakes its readers on a write to any of them. Readers are
+ * never waited for: one that falls behind skips positions, and tells how many
+ * from the write numbers of the positions it reads.
+ */
+
+/** @brief Open a bus, creating it if it does not exist. */
+oat_position_bus *oat_position_bus_open(const char *name);
+
+/**
+ * @brief Become the writer of a channel, naming a free one if need be.
+ * @return Index of the channel.
+ */
+int oat_position_bus_claim(oat_position_bus *bus, const char *channel);
+
+/**
+ * @brief Count and publish the latest position of a claimed channel.
+ * @param capture_ns Capture time on the host's CLOCK_MONOTONIC, in
+ * nanoseconds, or 0 if unknown.
+ */
+int oat_position_bus_write(oat_position_bus *bus,
+                           int channel,
+                           const oat_position *position,
+                           uint64_t capture_ns);
+
+/**
+ * @brief Copy the name of a channel, truncated to len bytes including the
+ * terminating null.
+ * @return Length of the name, or 0 if the channel is not in use.
+ */
+int oat_position_bus_name(const oat_position_bus *bus,
+                          int channel,
+                          char *out,
+                          size_t len);
+
+/** @return Index of the channel with a name. */
+int oat_position_bus_find(const oat_position_bus *bus, const char *channel);
+
+/** @brief Positions written to a channel so far. */
+uint64_t oat_position_bus_writes(const oat_position_bus *bus, int channel);
+
+/**
+ * @brief Advanced by every write to the bus. Take it, read the channels, then
+ * pass it to oat_position_bus_wait().
+ */
+uint32_t oat_position_bus_generation(const oat_position_bus *bus);
+
+/**
+ * @brief Sleep until any channel is written after generation seen.
+ * @return OAT_OK, OAT_TIMEOUT or OAT_INTERRUPTED.
+ */
+int oat_position_bus_wait(oat_position_bus *bus,
+                          uint32_t seen,
+                          uint64_t timeout_ns);
+
+/**
+ * @brief Copy the latest position of a channel.
+ * @param write Set to the write number of the position, or 0. May be NULL.
+ * @return OAT_OK or OAT_EMPTY.
+ */
+int oat_position_bus_read(oat_position_bus *bus,
+                          int channel,
+                          oat_position *out,
+                          uint64_t *write);
+
+/**
+ * @brief Pack the latest position of a channel into out, as
+ * oat_position_source_pack() does.
+ * @return OAT_OK or OAT_EMPTY.
+ */
+int oat_position_bus_pack(oat_position_bus *bus,
+                          int channel,
+                          char *out,
+                          uint64_t *write);
+
+void oat_position_bus_close(oat_position_bus *bus);
+
+/** @brief Bytes of a packed position. */
+size_t oat_position_bytes(void);
+
+/** @brief NumPy dtype of a packed position, as a Python literal. */
+const char *oat_position_dtype(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OAT_SHMEMDF_C_H */
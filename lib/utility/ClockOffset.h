@@ -0,0 +1,100 @@
+//******************************************************************************
+//* File:   ClockOffset.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_CLOCKOFFSET_H
+#define	OAT_CLOCKOFFSET_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace oat {
+
+/**
+ * @brief Estimates the offset between a device clock, e.g. a camera's
+ * embedded timestamps, and the host steady_clock. Each frame gives the
+ * device time at which it was captured and the host time at which it
+ * arrived. Their difference is the offset plus a transfer delay that is
+ * never negative, so the smallest difference over a sliding window of recent
+ * frames is the best estimate of the offset. The window follows slow drift
+ * between the two clocks.
+ */
+class ClockOffset {
+public:
+
+    // Number of frames in the window
+    static constexpr size_t WINDOW {128};
+
+    /**
+     * @brief Add a frame and map its device time onto the host clock.
+     * @param device_ns Device capture time in nanoseconds.
+     * @param host_ns Host steady_clock arrival time in nanoseconds.
+     * @return Capture time on the host steady_clock, in nanoseconds.
+     */
+    int64_t update(const int64_t device_ns, const int64_t host_ns)
+    {
+        // Device clock restart, e.g. after the camera was reconfigured
+        if (count_ > 0 && device_ns < last_device_ns_)
+            reset();
+        last_device_ns_ = device_ns;
+
+        diffs_[next_] = host_ns - device_ns;
+        next_ = (next_ + 1) % WINDOW;
+        if (count_ < WINDOW)
+            count_++;
+
+        offset_ns_ = *std::min_element(diffs_.begin(), diffs_.begin() + count_);
+        return device_ns + offset_ns_;
+    }
+
+    /**
+     * @brief Forget all frames.
+     */
+    void reset(void)
+    {
+        next_ = 0;
+        count_ = 0;
+        offset_ns_ = 0;
+    }
+
+    // Host minus device time, in nanoseconds
+    int64_t offset_ns(void) const { return offset_ns_; }
+
+    /**
+     * @brief Host steady_clock time in nanoseconds, as used by Sample.
+     */
+    static int64_t hostNs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+
+    std::array<int64_t, WINDOW> diffs_;
+    size_t next_ {0};
+    size_t count_ {0};
+    int64_t offset_ns_ {0};
+    int64_t last_device_ns_ {std::numeric_limits<int64_t>::min()};
+};
+
+}      /* namespace oat */
+#endif /* OAT_CLOCKOFFSET_H */
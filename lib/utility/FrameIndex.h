@@ -0,0 +1,146 @@
+//******************************************************************************
+//* File:   FrameIndex.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_FRAMEINDEX_H
+#define	OAT_FRAMEINDEX_H
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace oat {
+
+/**
+ * Entry of the '.idx' file written next to each recorded video file. One per
+ * frame, in the order of the file, so that the frame holding a sample can be
+ * found without decoding up to it.
+ */
+struct FrameIndexEntry {
+    uint64_t count;       //!< Sample count
+    int64_t microseconds; //!< Sample time
+    uint64_t frame;       //!< Index of the frame in the video file
+};
+
+static_assert(sizeof(FrameIndexEntry) == 24,
+              "FrameIndexEntry must be 24 bytes.");
+
+/**
+ * Appends entries to a frame index file.
+ */
+class FrameIndexWriter {
+
+public:
+
+    FrameIndexWriter() = default;
+    ~FrameIndexWriter() { close(); }
+
+    FrameIndexWriter(const FrameIndexWriter &) = delete;
+    FrameIndexWriter &operator=(const FrameIndexWriter &) = delete;
+
+    /**
+     * Start the index of a video file. It is written to video_path + ".idx".
+     */
+    void open(const std::string &video_path)
+    {
+        path_ = video_path + ".idx";
+        file_ = std::fopen(path_.c_str(), "wb");
+        if (file_ == nullptr)
+            throw std::runtime_error("Write permission denied for " + path_);
+        frames_ = 0;
+    }
+
+    /**
+     * Index the next frame of the video file.
+     */
+    void append(const uint64_t count, const int64_t microseconds)
+    {
+        const FrameIndexEntry e {count, microseconds, frames_++};
+        entries_.push_back(e);
+    }
+
+    /**
+     * Write the entries appended so far, e.g. once per encoded batch.
+     */
+    void flush()
+    {
+        if (file_ == nullptr || entries_.empty())
+            return;
+
+        std::fwrite(entries_.data(), sizeof(FrameIndexEntry), entries_.size(),
+                    file_);
+        std::fflush(file_);
+        entries_.clear();
+    }
+
+    void close()
+    {
+        if (file_ == nullptr)
+            return;
+
+        flush();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    void remove()
+    {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+
+        if (!path_.empty())
+            std::remove(path_.c_str());
+    }
+
+private:
+
+    std::string path_;
+    FILE *file_ {nullptr};
+    uint64_t frames_ {0};
+    std::vector<FrameIndexEntry> entries_;
+};
+
+/**
+ * Read the index of a video file, if it has one.
+ * @param video_path Path of the video file.
+ * @param index Set to the index entries, in file order.
+ * @return True if video_path + ".idx" exists.
+ */
+inline bool readFrameIndex(const std::string &video_path,
+                           std::vector<FrameIndexEntry> &index)
+{
+    const auto path = video_path + ".idx";
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    index.clear();
+    FrameIndexEntry e;
+    while (std::fread(&e, sizeof(e), 1, f) == 1)
+        index.push_back(e);
+
+    std::fclose(f);
+    return true;
+}
+
+}      /* namespace oat */
+#endif /* OAT_FRAMEINDEX_H */
@@ -0,0 +1,83 @@
+//******************************************************************************
+//* File:   Homography.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_HOMOGRAPHY_H
+#define	OAT_HOMOGRAPHY_H
+
+#include <cstddef>
+
+#include <opencv2/core/matx.hpp>
+#include <opencv2/core/types.hpp>
+
+namespace oat {
+
+/**
+ * Apply a homography to contiguous arrays of coordinates, as
+ * cv::perspectiveTransform() would, but without packing them into vectors of
+ * points. The loop body is branch free so that it can be vectorized. Output
+ * arrays may be the input arrays.
+ * @param h Homography
+ * @param x Horizontal coordinates
+ * @param y Vertical coordinates
+ * @param x_out Transformed horizontal coordinates
+ * @param y_out Transformed vertical coordinates
+ * @param n Number of points
+ * @param offset If false, the translation part of h is ignored, as for
+ * velocities and headings.
+ */
+inline void transformPoints(const cv::Matx33d &h,
+                            const double *x,
+                            const double *y,
+                            double *x_out,
+                            double *y_out,
+                            const size_t n,
+                            const bool offset = true)
+{
+    const double h00 = h(0, 0), h01 = h(0, 1), h02 = offset ? h(0, 2) : 0.0;
+    const double h10 = h(1, 0), h11 = h(1, 1), h12 = offset ? h(1, 2) : 0.0;
+    const double h20 = h(2, 0), h21 = h(2, 1), h22 = h(2, 2);
+
+    for (size_t i = 0; i < n; i++) {
+        const double xi = x[i];
+        const double yi = y[i];
+        const double w = h20 * xi + h21 * yi + h22;
+        const double s = w != 0.0 ? 1.0 / w : 0.0;
+        x_out[i] = (h00 * xi + h01 * yi + h02) * s;
+        y_out[i] = (h10 * xi + h11 * yi + h12) * s;
+    }
+}
+
+/**
+ * Apply a homography to a single point.
+ * @param h Homography
+ * @param p Point
+ * @param offset If false, the translation part of h is ignored.
+ * @return Transformed point
+ */
+inline cv::Point2d transformPoint(const cv::Matx33d &h,
+                                  const cv::Point2d &p,
+                                  const bool offset = true)
+{
+    cv::Point2d out;
+    transformPoints(h, &p.x, &p.y, &out.x, &out.y, 1, offset);
+    return out;
+}
+
+}      /* namespace oat */
+#endif /* OAT_HOMOGRAPHY_H */
@@ -0,0 +1,248 @@
+//******************************************************************************
+//* File:   OverlayRenderer.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "OverlayRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace oat {
+
+// Side of the square tiles in which symbols are blended
+static constexpr int TILE {32};
+
+/**
+ * Bounding rectangle of a line segment drawn with a given thickness.
+ */
+static cv::Rect segmentBounds(const cv::Point2d &a,
+                              const cv::Point2d &b,
+                              const double pad)
+{
+    const int x0 = static_cast<int>(std::floor(std::min(a.x, b.x) - pad));
+    const int y0 = static_cast<int>(std::floor(std::min(a.y, b.y) - pad));
+    const int x1 = static_cast<int>(std::ceil(std::max(a.x, b.x) + pad));
+    const int y1 = static_cast<int>(std::ceil(std::max(a.y, b.y) + pad));
+
+    return cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+void OverlayRenderer::clear()
+{
+    history_.clear();
+    path_ends_.clear();
+}
+
+void OverlayRenderer::allocate(const cv::Mat &frame)
+{
+    if (symbol_frame_.size() == frame.size()
+        && symbol_frame_.type() == frame.type())
+        return;
+
+    symbol_frame_ = cv::Mat::zeros(frame.size(), frame.type());
+    blend_frame_.create(frame.size(), frame.type());
+    blank_mask_.create(frame.size(), CV_8UC1);
+    symbol_mask_.create(frame.size(), CV_8UC1);
+
+    tile_rows_ = (frame.rows + TILE - 1) / TILE;
+    tile_cols_ = (frame.cols + TILE - 1) / TILE;
+    dirty_.assign(tile_rows_ * tile_cols_, 0);
+
+    clear();
+}
+
+void OverlayRenderer::markDirty(const cv::Rect &r)
+{
+    const cv::Rect c = r & cv::Rect(0, 0, symbol_frame_.cols, symbol_frame_.rows);
+    if (c.area() == 0)
+        return;
+
+    const int tx1 = (c.x + c.width - 1) / TILE;
+    const int ty1 = (c.y + c.height - 1) / TILE;
+    for (int ty = c.y / TILE; ty <= ty1; ty++)
+        for (int tx = c.x / TILE; tx <= tx1; tx++)
+            dirty_[ty * tile_cols_ + tx] = 1;
+}
+
+void OverlayRenderer::blendDirty(cv::Mat &frame)
+{
+    const cv::Scalar zero(0);
+
+    // Runs of dirty tiles along each row of tiles are blended together
+    for (int ty = 0; ty < tile_rows_; ty++) {
+
+        uint8_t *row = &dirty_[ty * tile_cols_];
+        int tx = 0;
+        while (tx < tile_cols_) {
+
+            if (!row[tx]) {
+                tx++;
+                continue;
+            }
+
+            const int begin = tx;
+            while (tx < tile_cols_ && row[tx])
+                row[tx++] = 0;
+
+            const int x0 = begin * TILE;
+            const int y0 = ty * TILE;
+            const cv::Rect roi(x0,
+                               y0,
+                               std::min(tx * TILE, frame.cols) - x0,
+                               std::min(y0 + TILE, frame.rows) - y0);
+
+            cv::Mat symbols = symbol_frame_(roi);
+            cv::Mat dst = frame(roi);
+            cv::Mat blend = blend_frame_(roi);
+            cv::Mat blank = blank_mask_(roi);
+            cv::Mat mask = symbol_mask_(roi);
+
+            cv::addWeighted(dst, 1 - symbol_alpha_, symbols, symbol_alpha_, 0.0, blend);
+            cv::inRange(symbols, zero, zero, blank);
+            cv::bitwise_not(blank, mask);
+            blend.copyTo(dst, mask);
+
+            // Clean up for the next frame
+            symbols.setTo(zero);
+        }
+    }
+}
+
+void OverlayRenderer::render(const oat::Overlay &overlay, cv::Mat &frame)
+{
+    allocate(frame);
+
+    if (overlay.history_epoch != history_epoch_) {
+        history_epoch_ = overlay.history_epoch;
+        clear();
+    }
+
+    const size_t history_length = overlay.history_length;
+    if (history_.capacity() != history_length)
+        history_.set_capacity(history_length);
+
+    // Paths missing from this overlay are broken
+    std::vector<PathEnd> path_ends(path_ends_.size(), PathEnd{false, {}});
+
+    for (const auto &s : overlay) {
+        if (s.kind != OverlayShape::HISTORY)
+            continue;
+
+        const size_t k = static_cast<size_t>(s.x1);
+        if (k >= path_ends.size()) {
+            path_ends.resize(k + 1, PathEnd{false, {}});
+            path_ends_.resize(k + 1, PathEnd{false, {}});
+        }
+
+        const cv::Point2d a(s.x0, s.y0);
+        if (path_ends_[k].valid && history_.capacity() > 0)
+            history_.push_back(Segment{a,
+                                       path_ends_[k].point,
+                                       cv::Scalar(s.color[0], s.color[1], s.color[2]),
+                                       s.thickness});
+
+        path_ends[k] = PathEnd{true, a};
+    }
+
+    path_ends_.swap(path_ends);
+
+    // History is drawn first, so that symbols are on top of it
+    for (const auto &h : history_) {
+        cv::line(symbol_frame_, h.a, h.b, h.color, h.thickness);
+        markDirty(segmentBounds(h.a, h.b, h.thickness + 1.0));
+    }
+
+    for (const auto &s : overlay) {
+
+        const cv::Scalar color(s.color[0], s.color[1], s.color[2]);
+        const cv::Point2d a(s.x0, s.y0);
+        const cv::Point2d b(s.x1, s.y1);
+        const double pad = s.thickness + 1.0;
+
+        switch (s.kind) {
+            case OverlayShape::CIRCLE:
+                cv::circle(symbol_frame_, a, s.x1, color, s.thickness);
+                markDirty(segmentBounds(a, a, s.x1 + pad));
+                break;
+            case OverlayShape::LINE:
+                cv::line(symbol_frame_, a, b, color, s.thickness);
+                markDirty(segmentBounds(a, b, pad));
+                break;
+            case OverlayShape::ARROW:
+                cv::arrowedLine(symbol_frame_, a, b, color, s.thickness);
+
+                // Arrow head is a fraction of the line length
+                markDirty(segmentBounds(a, b, pad + 0.1 * cv::norm(b - a)));
+                break;
+            case OverlayShape::HISTORY:
+            case OverlayShape::TEXT:
+                break;
+        }
+    }
+
+    // Blend symbols into the frame, within touched tiles only
+    blendDirty(frame);
+
+    // Text is drawn on top, opaque
+    for (const auto &s : overlay) {
+        if (s.kind == OverlayShape::TEXT)
+            cv::putText(frame,
+                        s.text,
+                        cv::Point(std::lround(s.x0), std::lround(s.y0)),
+                        s.font,
+                        s.x1,
+                        cv::Scalar(s.color[0], s.color[1], s.color[2]),
+                        s.thickness);
+    }
+
+    if (overlay.encode_bit_size > 0)
+        encodeSampleNumber(overlay, frame);
+}
+
+void OverlayRenderer::encodeSampleNumber(const oat::Overlay &overlay,
+                                         cv::Mat &frame)
+{
+    const int bit_size = overlay.encode_bit_size;
+    uint64_t sample_count = overlay.sample_count();
+    int column = frame.cols - 64 * bit_size;
+
+    if (column < 0 || bit_size > frame.rows)
+        throw std::runtime_error("Binary counter bar is too large for frame."
+                                 "Use more x-dim pixels or turn binary counter off.");
+
+    // Bits are filled in place, without temporary blocks
+    const cv::Scalar one = CV_RGB(255, 255, 255);
+    const cv::Scalar zero = cv::Scalar::all(0);
+    cv::Mat bar = frame.rowRange(0, bit_size);
+
+    for (int shift = 0; shift < 64; shift++) {
+
+        bar.colRange(column, column + bit_size)
+            .setTo(sample_count & 0x1 ? one : zero);
+
+        sample_count >>= 1;
+        column += bit_size;
+    }
+}
+
+} /* namespace oat */
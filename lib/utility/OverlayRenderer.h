@@ -0,0 +1,97 @@
+//******************************************************************************
+//* File:   OverlayRenderer.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_OVERLAYRENDERER_H
+#define	OAT_OVERLAYRENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+#include <opencv2/core/mat.hpp>
+
+#include "../datatypes/Overlay.h"
+
+namespace oat {
+
+/**
+ * @brief Composites oat::Overlay shapes onto frames. Symbols and path history
+ * are alpha blended, text is drawn opaque. Each path joins the HISTORY points
+ * of consecutively rendered overlays, so overlays can be skipped without
+ * leaving gaps. Paths are kept as a ring of at most Overlay::history_length
+ * line segments, until the overlay history epoch changes or clear() is
+ * called. Only tiles of the frame touched by a symbol or segment are blended.
+ */
+class OverlayRenderer {
+
+public:
+
+    /**
+     * @param symbol_alpha Opacity of blended symbols, 0 to 1
+     */
+    explicit OverlayRenderer(const double symbol_alpha = 0.4)
+    : symbol_alpha_(symbol_alpha)
+    {
+        // Nothing
+    }
+
+    /**
+     * @brief Draw an overlay onto a frame, in place. Drawing buffers are
+     * (re)allocated when the frame size or type changes.
+     * @param overlay Shapes to draw
+     * @param frame 8-bit frame to draw on
+     */
+    void render(const oat::Overlay &overlay, cv::Mat &frame);
+
+    /**
+     * @brief Erase accumulated path history.
+     */
+    void clear();
+
+private:
+
+    const double symbol_alpha_;
+
+    // Drawing buffers. Only dirty tiles are blended, then cleared for the
+    // next frame.
+    cv::Mat symbol_frame_, blend_frame_, blank_mask_, symbol_mask_;
+    int tile_rows_ {0}, tile_cols_ {0};
+    std::vector<uint8_t> dirty_;
+
+    // Path history, oldest segment first
+    struct Segment {
+        cv::Point2d a, b;
+        cv::Scalar color;
+        int thickness;
+    };
+    boost::circular_buffer<Segment> history_;
+
+    // Last HISTORY point of each path, if it was in the last overlay
+    struct PathEnd { bool valid; cv::Point2d point; };
+    std::vector<PathEnd> path_ends_;
+    uint32_t history_epoch_ {0};
+
+    void allocate(const cv::Mat &frame);
+    void markDirty(const cv::Rect &r);
+    void blendDirty(cv::Mat &frame);
+    void encodeSampleNumber(const oat::Overlay &overlay, cv::Mat &frame);
+};
+
+}      /* namespace oat */
+#endif /* OAT_OVERLAYRENDERER_H */
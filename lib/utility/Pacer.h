@@ -0,0 +1,157 @@
+//******************************************************************************
+//* File:   Pacer.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_PACER_H
+#define	OAT_PACER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include <time.h>
+
+namespace oat {
+
+/**
+ * @brief Paces a loop at a fixed period using absolute deadlines on the
+ * monotonic clock, so that the rate does not drift with the time spent in
+ * each iteration. Deadlines are slept toward with clock_nanosleep. The last
+ * part of each period can be busy waited instead, to hide scheduler wake up
+ * latency at high rates.
+ */
+class Pacer {
+public:
+
+    /**
+     * @brief Set the loop period. Non-positive periods disable pacing.
+     * @param period Period in seconds.
+     */
+    void set_period(const std::chrono::duration<double> period)
+    {
+        const double ns = period.count() * 1e9;
+        period_ns_ = std::isfinite(ns) && ns > 0 ? std::llround(ns) : 0;
+        started_ = false;
+    }
+
+    /**
+     * @brief Set the time before each deadline that is busy waited.
+     * @param spin Spin time in seconds.
+     */
+    void set_spin(const std::chrono::duration<double> spin)
+    {
+        spin_ns_ = std::max<int64_t>(0, std::llround(spin.count() * 1e9));
+    }
+
+    /**
+     * @brief Start deadlines one period from now.
+     */
+    void reset(void)
+    {
+        start_ns_ = nowNs();
+        deadline_ns_ = start_ns_ + period_ns_;
+        started_ = true;
+    }
+
+    /**
+     * @brief Block until the next deadline. The first call starts the
+     * deadlines. Deadlines that have already passed by more than a period
+     * are skipped rather than caught up with in a burst, so a stall does not
+     * change the phase of later iterations.
+     * @return Number of skipped deadlines.
+     */
+    uint64_t wait(void)
+    {
+        if (period_ns_ == 0)
+            return 0;
+
+        if (!started_) {
+            reset();
+        }
+
+        uint64_t missed = 0;
+        const int64_t late = nowNs() - deadline_ns_;
+        if (late >= period_ns_) {
+            missed = late / period_ns_;
+            deadline_ns_ += missed * period_ns_;
+        }
+
+        sleepUntil(deadline_ns_);
+        deadline_ns_ += period_ns_;
+
+        return missed;
+    }
+
+    /**
+     * @brief Block until a given time after the first call of wait() or
+     * waitUntil(), rather than until the next periodic deadline, e.g. to
+     * reproduce recorded sample times. Times that have passed return
+     * immediately.
+     * @param offset Time since the first call.
+     */
+    void waitUntil(const std::chrono::nanoseconds offset)
+    {
+        if (!started_)
+            reset();
+
+        sleepUntil(start_ns_ + offset.count());
+    }
+
+private:
+
+    static constexpr int64_t NS_PER_SEC {1000000000};
+
+    int64_t start_ns_ {0};
+    int64_t period_ns_ {0};
+    int64_t spin_ns_ {0};
+    int64_t deadline_ns_ {0};
+    bool started_ {false};
+
+    static int64_t nowNs(void)
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+    }
+
+    void sleepUntil(const int64_t deadline_ns) const
+    {
+        const int64_t wake_ns = deadline_ns - spin_ns_;
+        if (wake_ns > nowNs()) {
+
+            timespec ts;
+            ts.tv_sec = wake_ns / NS_PER_SEC;
+            ts.tv_nsec = wake_ns % NS_PER_SEC;
+
+            // A signal, e.g. SIGINT, ends the wait early so that the caller
+            // can check for it
+            if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)
+                == EINTR)
+                return;
+        }
+
+        while (nowNs() < deadline_ns) {
+            // Spin
+        }
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_PACER_H */
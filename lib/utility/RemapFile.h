@@ -0,0 +1,145 @@
+//******************************************************************************
+//* File:   RemapFile.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_REMAPFILE_H
+#define	OAT_REMAPFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <opencv2/core/mat.hpp>
+
+namespace oat {
+
+/**
+ * Header of a precomputed remap table file. It is followed by map1 (CV_16SC2)
+ * and then map2 (CV_16UC1), as produced by cv::initUndistortRectifyMap(),
+ * each row major and unpadded, so both maps can be used straight from a
+ * memory mapping of the file.
+ */
+struct RemapFileHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    uint32_t reserved[3];
+};
+
+static_assert(sizeof(RemapFileHeader) == 32,
+              "RemapFileHeader must be 32 bytes.");
+
+static const char REMAP_FILE_MAGIC[8] {'O', 'A', 'T', 'R', 'E', 'M', 'A', 'P'};
+static const uint32_t REMAP_FILE_VERSION {1};
+
+/**
+ * Write fixed-point remap tables to a file.
+ * @param path File path.
+ * @param map1 CV_16SC2 integer source coordinates.
+ * @param map2 CV_16UC1 interpolation table indices.
+ */
+inline void writeRemapFile(const std::string &path,
+                           const cv::Mat &map1,
+                           const cv::Mat &map2)
+{
+    if (map1.type() != CV_16SC2 || map2.type() != CV_16UC1
+        || map1.size() != map2.size())
+        throw std::runtime_error("Remap tables must be CV_16SC2 and CV_16UC1 "
+                                 "maps of the same size.");
+
+    RemapFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, REMAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = REMAP_FILE_VERSION;
+    header.rows = map1.rows;
+    header.cols = map1.cols;
+
+    std::ofstream fs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fs)
+        throw std::runtime_error("Could not open " + path + " for writing.");
+
+    fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int y = 0; y < map1.rows; y++)
+        fs.write(map1.ptr<char>(y), map1.cols * map1.elemSize());
+    for (int y = 0; y < map2.rows; y++)
+        fs.write(map2.ptr<char>(y), map2.cols * map2.elemSize());
+
+    if (!fs)
+        throw std::runtime_error("Could not write to " + path + ".");
+}
+
+/**
+ * Read-only memory mapping of a remap table file. The maps point into the
+ * mapping, so no per-pixel work is done to load them, and must not be
+ * written to.
+ */
+class RemapFile {
+
+public:
+
+    explicit RemapFile(const std::string &path)
+    try
+    : file_(path.c_str(), boost::interprocess::read_only)
+    , region_(file_, boost::interprocess::read_only)
+    {
+        const auto bytes = region_.get_size();
+        if (bytes < sizeof(RemapFileHeader))
+            throw std::runtime_error(path + " is not a remap table file.");
+
+        const char *data = static_cast<const char *>(region_.get_address());
+        RemapFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+
+        if (std::memcmp(header.magic, REMAP_FILE_MAGIC, sizeof(header.magic)) != 0
+            || header.version != REMAP_FILE_VERSION
+            || header.rows <= 0 || header.cols <= 0)
+            throw std::runtime_error(path + " is not a remap table file.");
+
+        const size_t n = static_cast<size_t>(header.rows) * header.cols;
+        if (bytes < sizeof(header) + n * (2 * sizeof(int16_t) + sizeof(uint16_t)))
+            throw std::runtime_error(path + " is truncated.");
+
+        // Read only, cv::remap() does not write its maps
+        char *m = const_cast<char *>(data) + sizeof(header);
+        map1_ = cv::Mat(header.rows, header.cols, CV_16SC2, m);
+        map2_ = cv::Mat(header.rows, header.cols, CV_16UC1,
+                        m + n * 2 * sizeof(int16_t));
+    }
+    catch (const boost::interprocess::interprocess_exception &ex)
+    {
+        throw std::runtime_error("Could not map " + path + ": " + ex.what());
+    }
+
+    cv::Size size() const { return map1_.size(); }
+    const cv::Mat &map1() const { return map1_; }
+    const cv::Mat &map2() const { return map2_; }
+
+private:
+
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region region_;
+    cv::Mat map1_, map2_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_REMAPFILE_H */
@@ -343,6 +343,40 @@ getArray(const po::variables_map &vm,
     return rc;
 }
 
+// TOML array of strings from table
+inline bool
+getArray(const po::variables_map &vm,
+         const OptionTable table,
+         const std::string& key,
+         std::vector<std::string> &array_out,
+         bool required = false) {
+
+    OptionTable t;
+
+    if (vm.count(key)) {
+
+        std::istringstream toml {key + "=" + vm[key].as<std::string>()};
+        cpptoml::parser p {toml};
+        t = p.parse();
+
+    } else if (table->contains(key)) {
+
+        t = table;
+
+    } else if (required) {
+        throw (std::runtime_error("Required configuration value '" + key + "' was not specified."));
+    } else {
+        return false;
+    }
+
+    auto out = t->get_array_of<std::string>(key);
+    if (!out)
+        throw (std::runtime_error("'" + key + "' must be a TOML array of strings."));
+
+    array_out.assign(out->begin(), out->end());
+    return true;
+}
+
 // TOML array from table, any size
 inline bool 
 getArray(const OptionTable table, 
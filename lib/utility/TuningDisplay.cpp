@@ -0,0 +1,145 @@
+//******************************************************************************
+//* File:   TuningDisplay.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "TuningDisplay.h"
+
+#include <cmath>
+#include <utility>
+
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace oat {
+
+static constexpr double PI {3.14159265358979323846};
+
+TuningDisplay::TuningDisplay(const std::string &title,
+                             std::function<void(void)> setup,
+                             const oat::ThreadPolicy &policy,
+                             std::chrono::milliseconds min_update_period)
+: title_(title)
+, setup_(std::move(setup))
+, min_update_period_(min_update_period)
+, next_update_(Clock::now())
+{
+    thread_ = std::thread([this] { run(); });
+    policy.apply(thread_, "tuning display");
+}
+
+TuningDisplay::~TuningDisplay()
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        running_ = false;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void TuningDisplay::capture(const cv::Mat &frame, const cv::Mat &mask)
+{
+    // The display thread is idle, so frame_ is ours until show(). Masked
+    // pixels are copied into a cleared buffer, which avoids building an
+    // inverted mask to zero the others.
+    if (mask.empty()) {
+        frame.copyTo(frame_);
+    } else {
+        frame_.create(frame.size(), frame.type());
+        frame_.setTo(0);
+        frame.copyTo(frame_, mask);
+    }
+}
+
+void TuningDisplay::show(const oat::Position2D &position,
+                         double area,
+                         const cv::Scalar &color)
+{
+    found_ = position.position_valid;
+    center_ = position.position;
+    radius_ = std::sqrt(area / PI);
+    color_ = color;
+
+    next_update_ = Clock::now() + min_update_period_;
+    idle_ = false;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        pending_ = true;
+    }
+    cv_.notify_one();
+}
+
+void TuningDisplay::run()
+{
+    setup_();
+    idle_ = true;
+
+    while (true) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+
+        // Wake up at least once per update period to service sliders
+        cv_.wait_for(lk, min_update_period_, [this] {
+            return pending_ || !running_;
+        });
+
+        if (!running_)
+            break;
+
+        const bool pending = pending_;
+        pending_ = false;
+        lk.unlock();
+
+        if (pending) {
+            draw();
+            cv::imshow(title_, frame_);
+            idle_ = true;
+        }
+
+        // If user hits escape, close the tuning window
+        if ((cv::waitKey(1) & 0xFF) == 27) {
+            closed_ = true;
+            break;
+        }
+    }
+
+    cv::destroyWindow(title_);
+    cv::waitKey(1);
+}
+
+void TuningDisplay::draw()
+{
+    std::string msg = cv::format("Object not found");
+
+    // Plot a circle representing found object
+    if (found_) {
+        cv::circle(frame_, center_, radius_, color_, 4);
+        msg = cv::format("(%d, %d) pixels", (int)center_.x, (int)center_.y);
+    }
+
+    int baseline = 0;
+    cv::Size textSize = cv::getTextSize(msg, 1, 1, 1, &baseline);
+    cv::Point text_origin(frame_.cols - textSize.width - 10,
+                          frame_.rows - 2 * baseline - 10);
+
+    cv::putText(frame_, msg, text_origin, 1, 1, cv::Scalar(0, 255, 0));
+}
+
+} /* namespace oat */
@@ -0,0 +1,140 @@
+//******************************************************************************
+//* File:   TuningDisplay.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_TUNINGDISPLAY_H
+#define	OAT_TUNINGDISPLAY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../base/ThreadPolicy.h"
+#include "../datatypes/Position2D.h"
+
+namespace oat {
+
+/**
+ * @brief Window with parameter sliders, shown and serviced by its own thread
+ * so that HighGUI never runs on a component's processing thread. Frames are
+ * handed over with latest-frame semantics: while the display thread is busy,
+ * or the minimum update period has not passed, ready() is false and the
+ * caller skips preparing a frame at all. Pressing ESC in the window closes it.
+ *
+ * Sliders write the component's parameters from the display thread, as
+ * runtime 'set' commands do from the control thread.
+ */
+class TuningDisplay {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+
+    /**
+     * @param title Window title
+     * @param setup Creates the window and its sliders. Called on the display
+     * thread before anything is shown.
+     * @param policy CPU placement and scheduling of the display thread
+     * @param min_update_period Minimum period between displayed frames
+     */
+    TuningDisplay(const std::string &title,
+                  std::function<void(void)> setup,
+                  const oat::ThreadPolicy &policy = oat::ThreadPolicy(),
+                  std::chrono::milliseconds min_update_period
+                      = std::chrono::milliseconds(33));
+    ~TuningDisplay();
+
+    TuningDisplay(const TuningDisplay &) = delete;
+    TuningDisplay &operator=(const TuningDisplay &) = delete;
+
+    /**
+     * @brief Whether a frame passed to show() now would be displayed. Never
+     * blocks.
+     */
+    bool ready() const
+    {
+        return idle_ && !closed_ && Clock::now() >= next_update_;
+    }
+
+    /**
+     * @brief Copy the pixels of a frame that are set in a mask, others being
+     * black, as the next frame to display. Only call when ready(), and follow
+     * with show().
+     * @param frame Frame to display
+     * @param mask 8-bit mask of pixels to display, or empty for all pixels
+     */
+    void capture(const cv::Mat &frame, const cv::Mat &mask = cv::Mat());
+
+    /**
+     * @brief Hand the captured frame to the display thread, which marks the
+     * detected object on it and shows it.
+     * @param position Detected position, in frame pixels
+     * @param area Detected object area, in pixels^2
+     * @param color Color of the object marker
+     */
+    void show(const oat::Position2D &position,
+              double area,
+              const cv::Scalar &color);
+
+    /**
+     * @brief Whether the user has closed the window.
+     */
+    bool closed() const { return closed_; }
+
+private:
+
+    const std::string title_;
+    const std::function<void(void)> setup_;
+    const std::chrono::milliseconds min_update_period_;
+
+    // Frame to display and its marker. Only written by capture() and show()
+    // while the display thread is idle.
+    cv::Mat frame_;
+    bool found_ {false};
+    cv::Point2d center_;
+    double radius_ {0.0};
+    cv::Scalar color_;
+
+    // Display thread
+    std::atomic<bool> running_ {true};
+    std::atomic<bool> idle_ {false};
+    std::atomic<bool> closed_ {false};
+    bool pending_ {false};
+    Clock::time_point next_update_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    /**
+     * @brief Display thread: sets up the window, then shows frames as they
+     * are handed over and services slider events in between.
+     */
+    void run(void);
+
+    void draw(void);
+};
+
+}      /* namespace oat */
+#endif /* OAT_TUNINGDISPLAY_H */
@@ -0,0 +1,202 @@
+//******************************************************************************
+//* File:   oat await main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../../lib/shmemdf/Readiness.h"
+#include "../../lib/shmemdf/Registry.h"
+#include "../../lib/utility/IOFormat.h"
+
+namespace po = boost::program_options;
+
+volatile sig_atomic_t quit = 0;
+
+void sigHandler(int) { quit = 1; }
+
+void printUsage(po::options_description options) {
+    std::cout << "Usage: await [INFO]\n"
+              << "   or: await NAMES [CONFIGURATION]\n"
+              << "Wait until the nodes specified by NAMES are ready, then exit. "
+                 "A node is ready\nonce SOURCEs have attached to it, so that "
+                 "components reading it are started\nbefore the component "
+                 "writing it. NAME:N waits for N SOURCEs, and NAME for\none. "
+                 "Nodes need not exist yet. Use in place of fixed sleeps when "
+                 "launching\na processing network, e.g.\n\n"
+              << "    oat framefilt mog raw bac &\n"
+              << "    oat decorate raw final &\n"
+              << "    oat await raw:2 && oat frameserve file raw -f video.avi\n\n"
+              << "Exits with a non-zero status if the timeout passes or it "
+                 "is interrupted first.\n\n"
+              << options << "\n";
+}
+
+// A node being waited for
+struct Awaited {
+    std::string name;
+    size_t sources {1};
+};
+
+int main(int argc, char *argv[]) {
+
+    std::vector<Awaited> awaited;
+    double timeout_sec = 0;
+    bool bound = false;
+
+    try {
+
+        po::options_description options("INFO");
+        options.add_options()
+            ("help", "Produce help message.")
+            ("version,v", "Print version information.")
+            ("list,l", "List the nodes that currently exist and exit.")
+            ;
+
+        po::options_description config("CONFIGURATION");
+        config.add_options()
+            ("bound,b",
+             "Wait for the SINK of each node to bind instead of for its "
+             "SOURCEs to attach. Source counts are ignored.")
+            ("timeout,t", po::value<double>(&timeout_sec),
+             "Seconds to wait for all nodes to be ready. Defaults to 0, which "
+             "waits until interrupted.")
+            ;
+
+        po::options_description hidden("HIDDEN OPTIONS");
+        hidden.add_options()
+            ("names", po::value< std::vector<std::string> >(),
+            "The names of the nodes to wait for.")
+            ;
+
+        po::positional_options_description positional_options;
+        positional_options.add("names", -1);
+
+        po::options_description all_options("ALL");
+        all_options.add(options).add(config).add(hidden);
+
+        po::options_description visible_options("OPTIONS");
+        visible_options.add(options).add(config);
+
+        po::variables_map variable_map;
+        po::store(po::command_line_parser(argc, argv)
+                .options(all_options)
+                .positional(positional_options)
+                .run(),
+                variable_map);
+        po::notify(variable_map);
+
+        if (variable_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (variable_map.count("version")) {
+            std::cout << "Oat Await version "
+                      << Oat_VERSION_MAJOR
+                      << "."
+                      << Oat_VERSION_MINOR
+                      << "\n";
+            std::cout << "Written by Jonathan P. Newman in the MWL@MIT.\n";
+            std::cout << "Licensed under the GPL3.0.\n";
+            return 0;
+        }
+
+        if (variable_map.count("list")) {
+            const std::string suffix {"_node"};
+            for (const auto &n : oat::Registry().names())
+                if (n.size() > suffix.size()
+                    && n.compare(n.size() - suffix.size(), suffix.size(), suffix) == 0)
+                    std::cout << n.substr(0, n.size() - suffix.size()) << "\n";
+            return 0;
+        }
+
+        if (!variable_map.count("names")) {
+            printUsage(visible_options);
+            std::cout << "Error: at least a single NAME must be specified. Exiting.\n";
+            return -1;
+        }
+
+        if (timeout_sec < 0) {
+            std::cerr << oat::Error("Timeout must be non-negative.\n");
+            return -1;
+        }
+
+        bound = variable_map.count("bound") > 0;
+
+        for (const auto &n : variable_map["names"].as< std::vector<std::string> >()) {
+
+            Awaited a;
+            a.name = n;
+
+            const auto colon = n.rfind(':');
+            if (colon != std::string::npos) {
+                a.name = n.substr(0, colon);
+                const auto count = std::stoi(n.substr(colon + 1));
+                if (count < 1)
+                    throw std::runtime_error("Source count of '" + a.name
+                                             + "' must be positive.");
+                a.sources = static_cast<size_t>(count);
+            }
+
+            awaited.push_back(a);
+        }
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    } catch (...) {
+        std::cerr << oat::Error("Exception of unknown type.\n");
+        return -1;
+    }
+
+    std::signal(SIGINT, sigHandler);
+
+    const auto deadline = timeout_sec > 0
+        ? std::chrono::steady_clock::now()
+              + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(timeout_sec))
+        : std::chrono::steady_clock::time_point::max();
+
+    try {
+
+        oat::Registry registry;
+        for (const auto &a : awaited) {
+            if (!oat::awaitNode(registry, a.name, a.sources, bound, deadline, quit)) {
+                if (!quit)
+                    std::cerr << oat::Error("Node '" + a.name
+                                            + "' was not ready in time.\n");
+                return 1;
+            }
+        }
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    }
+
+    // Exit
+    return 0;
+}
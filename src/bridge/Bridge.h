@@ -0,0 +1,73 @@
+//******************************************************************************
+//* File:   Bridge.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_BRIDGE_H
+#define	OAT_BRIDGE_H
+
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+
+#include "BridgeProtocol.h"
+
+namespace po = boost::program_options;
+
+namespace oat {
+
+class Bridge : public Component, public Configurable<false> {
+
+public:
+    /**
+     * @brief An abstract end of a link between hosts.
+     * @param name Component name.
+     */
+    explicit Bridge(const std::string &name);
+    virtual ~Bridge() { }
+
+    // Component Interface
+    oat::ComponentType type(void) const override { return oat::bridge; };
+    std::string name(void) const override { return name_; }
+
+    /**
+     * @brief Number of samples sent or received.
+     */
+    uint64_t samples() const { return samples_; }
+
+    /**
+     * @brief Number of samples that were not bridged, e.g. skipped by a
+     * latest-value source or lost on an unreliable link.
+     */
+    virtual uint64_t dropped() const { return 0; }
+
+protected:
+    // Samples sent or received
+    uint64_t samples_ {0};
+
+    static uint64_t now_ns();
+
+private:
+    // Component name
+    const std::string name_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_BRIDGE_H */
@@ -0,0 +1,179 @@
+//******************************************************************************
+//* File:   BridgeProtocol.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_BRIDGEPROTOCOL_H
+#define	OAT_BRIDGEPROTOCOL_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "OatConfig.h" // Generated by CMake
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/Sample.h"
+
+namespace oat {
+namespace wire {
+
+/*
+ * Frames. The sender streams frames to a single receiver over a pair of ZMQ DEALER
+ * sockets. The receiver grants credits, one per frame it is willing to take,
+ * and the sender sends a frame only against a credit. The receiver returns a
+ * credit each time it has published a frame to its sink, so no more than the
+ * granted number of frames are ever queued on the link.
+ *
+ * Fields are in host byte order and samples are copied bytewise, so both ends
+ * must run the same build of Oat on hosts of the same architecture. The magic
+ * number, version and sample size catch most mismatches.
+ */
+
+static constexpr uint32_t MAGIC {0x4254414f}; // "OATB"
+static constexpr uint16_t VERSION {1};
+
+// Time waited on the socket before checking for a quit request
+static constexpr int POLL_MS {100};
+
+/*
+ * Positions. The sender sends each position in a single UDP datagram as soon
+ * as it is read, without flow control. Datagrams carry a sequence number so
+ * that the receiver can count lost datagrams and discard those that arrive
+ * out of order, which are stale by then, and a session number, so that a
+ * restarted sender is not mistaken for one that went back in time.
+ */
+
+// Kind of a sender message
+enum class Kind : uint8_t {
+    SAMPLE = 0, // A frame or position
+    END         // Upstream end of stream. Frames are sent without pixels.
+};
+
+// Encoding of the pixel part of a frame message
+enum class Codec : uint8_t {
+    RAW = 0, // Packed rows
+    LZ4,     // LZ4 compressed packed rows. Lossless.
+    JPEG,    // JPEG image. Lossy. 8-bit GREY and BGR frames only.
+    TILES    // Tiles changed since the previous frame, or a keyframe
+};
+
+inline Codec str_codec(const std::string &s)
+{
+    if (s == "raw")
+        return Codec::RAW;
+    if (s == "lz4") {
+#ifdef USE_LZ4
+        return Codec::LZ4;
+#else
+        throw std::runtime_error("LZ4 compression requires Oat to be built "
+                                 "with USE_LZ4.");
+#endif
+    }
+    if (s == "jpeg")
+        return Codec::JPEG;
+    if (s == "tiles")
+        return Codec::TILES;
+
+    throw std::runtime_error("Unknown codec '" + s + "'.");
+}
+
+/**
+ * @brief First part of each message from the sender.
+ */
+struct FrameHeader {
+
+    uint32_t magic {MAGIC};
+    uint16_t version {VERSION};
+    Kind kind {Kind::SAMPLE};
+    Codec codec {Codec::RAW};
+    int32_t rows {0};
+    int32_t cols {0};
+    int32_t type {0};
+    int32_t color {0};
+    uint32_t sample_bytes {sizeof(oat::Sample)};
+    uint32_t reserved {0};
+    uint64_t sent_ns {0}; //!< Sender steady_clock time when sent
+    oat::Sample sample;   //!< Sample of the frame, on the sender's clock
+
+    bool valid() const
+    {
+        return magic == MAGIC && version == VERSION
+            && sample_bytes == sizeof(oat::Sample);
+    }
+};
+
+/**
+ * @brief First part of the pixels of a TILES frame. A keyframe is followed
+ * by the packed rows of the whole frame. Any other frame is followed by
+ * count tiles, each a uint32_t tile index, in row-major order of tiles,
+ * followed by the tile's packed rows. Tiles at the right and bottom edges
+ * are cut off by the frame. Every other tile is as in the previous frame,
+ * whose sequence number is one less.
+ */
+struct TileHeader {
+
+    uint64_t sequence {0};
+    uint32_t tile {0};  //!< Side length of tiles, in pixels
+    uint32_t count {0}; //!< Number of tiles following
+    uint8_t keyframe {0};
+    uint8_t reserved[7] {};
+};
+
+/**
+ * @brief Message from the receiver granting credits to the sender.
+ */
+struct Credit {
+
+    uint32_t magic {MAGIC};
+    uint32_t count {0};
+    uint32_t reset {0}; //!< If non-zero, count replaces any unused credits
+
+    bool valid() const { return magic == MAGIC; }
+};
+
+/**
+ * @brief Datagram carrying a position.
+ */
+struct PositionDatagram {
+
+    uint32_t magic {MAGIC};
+    uint16_t version {VERSION};
+    Kind kind {Kind::SAMPLE};
+    uint8_t unit {0}; //!< DistanceUnit of the position
+    uint32_t record_bytes {sizeof(oat::PositionRecord)};
+    uint32_t reserved {0};
+    uint64_t session {0};
+    uint64_t sequence {0};
+    uint64_t sent_ns {0}; //!< Sender steady_clock time when sent
+    double homography[9] {1.0, 0, 0, 0, 1.0, 0, 0, 0, 1.0};
+    oat::PositionRecord record; //!< Position, on the sender's clock
+
+    bool valid() const
+    {
+        return magic == MAGIC && version == VERSION
+            && record_bytes == sizeof(oat::PositionRecord);
+    }
+};
+
+static_assert(std::is_trivially_copyable<oat::Sample>::value,
+              "Samples are sent bytewise.");
+
+}       /* namespace wire */
+}       /* namespace oat */
+#endif	/* OAT_BRIDGEPROTOCOL_H */
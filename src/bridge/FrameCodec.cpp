@@ -0,0 +1,333 @@
+//******************************************************************************
+//* File:   FrameCodec.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "FrameCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+namespace oat {
+namespace wire {
+
+const cv::Mat &FrameCodec::pack(const oat::Frame &frame)
+{
+    if (frame.isContinuous())
+        return frame;
+
+    static_cast<const cv::Mat &>(frame).copyTo(packed_);
+    return packed_;
+}
+
+void FrameCodec::encode(const oat::Frame &frame, zmq::message_t &message)
+{
+    switch (codec_) {
+        case Codec::RAW:
+        {
+            const auto &src = pack(frame);
+            const size_t bytes = src.total() * src.elemSize();
+            message.rebuild(bytes);
+            std::memcpy(message.data(), src.data, bytes);
+            break;
+        }
+#ifdef USE_LZ4
+        case Codec::LZ4:
+        {
+            const auto &src = pack(frame);
+            const int bytes = static_cast<int>(src.total() * src.elemSize());
+            buffer_.resize(LZ4_compressBound(bytes));
+            const int n = LZ4_compress_default(
+                reinterpret_cast<const char *>(src.data),
+                reinterpret_cast<char *>(buffer_.data()),
+                bytes,
+                static_cast<int>(buffer_.size()));
+            if (n <= 0)
+                throw std::runtime_error("LZ4 compression failed.");
+
+            message.rebuild(n);
+            std::memcpy(message.data(), buffer_.data(), n);
+            break;
+        }
+#endif
+        case Codec::JPEG:
+        {
+            if (frame.depth() != CV_8U
+                || (frame.channels() != 1 && frame.channels() != 3))
+                throw std::runtime_error("JPEG compression requires 8-bit, 1 "
+                                         "or 3 channel frames.");
+
+            cv::imencode(".jpg", frame, buffer_,
+                         {cv::IMWRITE_JPEG_QUALITY, quality_});
+            message.rebuild(buffer_.size());
+            std::memcpy(message.data(), buffer_.data(), buffer_.size());
+            break;
+        }
+        case Codec::TILES:
+        {
+            encodeTiles(frame, message);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unsupported codec.");
+    }
+}
+
+void FrameCodec::decode(const FrameHeader &header,
+                        const zmq::message_t &message,
+                        oat::Frame &frame)
+{
+    const size_t bytes = header.rows * header.cols * CV_ELEM_SIZE(header.type);
+    const void *src = message.data();
+
+    switch (header.codec) {
+        case Codec::RAW:
+        {
+            if (message.size() != bytes)
+                throw std::runtime_error("Bridged frame has the wrong size.");
+
+            cv::Mat(header.rows, header.cols, header.type,
+                    const_cast<void *>(src)).copyTo(frame);
+            break;
+        }
+        case Codec::LZ4:
+        {
+#ifdef USE_LZ4
+            // Decompress in place unless the rows of the frame are padded
+            cv::Mat dst = frame;
+            if (!frame.isContinuous()) {
+                packed_.create(header.rows, header.cols, header.type);
+                dst = packed_;
+            }
+
+            const int n = LZ4_decompress_safe(static_cast<const char *>(src),
+                                              reinterpret_cast<char *>(dst.data),
+                                              static_cast<int>(message.size()),
+                                              static_cast<int>(bytes));
+            if (n < 0 || static_cast<size_t>(n) != bytes)
+                throw std::runtime_error("Bridged frame could not be "
+                                         "decompressed.");
+
+            if (dst.data != frame.data)
+                packed_.copyTo(frame);
+            break;
+#else
+            throw std::runtime_error("Received LZ4 compressed frames, but Oat "
+                                     "was built without USE_LZ4.");
+#endif
+        }
+        case Codec::JPEG:
+        {
+            cv::Mat encoded(1, static_cast<int>(message.size()), CV_8U,
+                            const_cast<void *>(src));
+            cv::imdecode(encoded, cv::IMREAD_UNCHANGED, &packed_);
+            if (packed_.rows != header.rows || packed_.cols != header.cols
+                || packed_.type() != header.type)
+                throw std::runtime_error("Bridged frame could not be "
+                                         "decoded.");
+
+            packed_.copyTo(frame);
+            break;
+        }
+        case Codec::TILES:
+        {
+            decodeTiles(header, message, frame);
+            break;
+        }
+        default:
+            throw std::runtime_error("Bridged frame uses an unknown codec.");
+    }
+}
+
+bool FrameCodec::decodable(const FrameHeader &header,
+                           const zmq::message_t &message) const
+{
+    if (header.codec != Codec::TILES)
+        return true;
+
+    TileHeader tiles;
+    if (message.size() < sizeof(tiles))
+        throw std::runtime_error("Bridged frame has the wrong size.");
+    std::memcpy(&tiles, message.data(), sizeof(tiles));
+
+    return tiles.keyframe
+           || (tiles.sequence == sequence_ + 1
+               && reference_.rows == header.rows
+               && reference_.cols == header.cols
+               && reference_.type() == header.type);
+}
+
+bool FrameCodec::changed(const cv::Mat &tile, const cv::Mat &reference) const
+{
+    if (tile_threshold_ > 0)
+        return cv::norm(tile, reference, cv::NORM_INF) > tile_threshold_;
+
+    const size_t row_bytes = tile.cols * tile.elemSize();
+    for (int i = 0; i < tile.rows; i++)
+        if (std::memcmp(tile.ptr(i), reference.ptr(i), row_bytes) != 0)
+            return true;
+
+    return false;
+}
+
+void FrameCodec::encodeTiles(const oat::Frame &frame, zmq::message_t &message)
+{
+    TileHeader tiles;
+    tiles.sequence = ++sequence_;
+    tiles.tile = static_cast<uint32_t>(tile_);
+
+    const size_t elem_bytes = frame.elemSize();
+
+    // A new decoder, or a new frame format, needs the whole frame
+    if (keyframe_due_ || since_keyframe_ + 1 >= keyframe_interval_
+        || reference_.size() != frame.size()
+        || reference_.type() != frame.type()) {
+
+        tiles.keyframe = 1;
+        const auto &src = pack(frame);
+        const size_t bytes = src.total() * elem_bytes;
+        message.rebuild(sizeof(tiles) + bytes);
+        std::memcpy(message.data(), &tiles, sizeof(tiles));
+        std::memcpy(static_cast<char *>(message.data()) + sizeof(tiles),
+                    src.data,
+                    bytes);
+
+        static_cast<const cv::Mat &>(frame).copyTo(reference_);
+        keyframe_due_ = false;
+        since_keyframe_ = 0;
+        return;
+    }
+
+    // Changed tiles are compared against, and copied into, the reference so
+    // that it stays what the decoder has. Below-threshold differences then
+    // never add up.
+    buffer_.clear();
+    const int tiles_x = (frame.cols + tile_ - 1) / tile_;
+    for (int y = 0; y < frame.rows; y += tile_) {
+        for (int x = 0; x < frame.cols; x += tile_) {
+
+            const cv::Rect r(x,
+                             y,
+                             std::min(tile_, frame.cols - x),
+                             std::min(tile_, frame.rows - y));
+            const cv::Mat tile = frame(r);
+            cv::Mat reference = reference_(r);
+            if (!changed(tile, reference))
+                continue;
+
+            const uint32_t index = (y / tile_) * tiles_x + x / tile_;
+            const auto *i = reinterpret_cast<const uchar *>(&index);
+            buffer_.insert(buffer_.end(), i, i + sizeof(index));
+
+            const size_t row_bytes = r.width * elem_bytes;
+            for (int j = 0; j < r.height; j++)
+                buffer_.insert(buffer_.end(),
+                               tile.ptr(j),
+                               tile.ptr(j) + row_bytes);
+
+            tile.copyTo(reference);
+            tiles.count++;
+        }
+    }
+
+    message.rebuild(sizeof(tiles) + buffer_.size());
+    std::memcpy(message.data(), &tiles, sizeof(tiles));
+    std::memcpy(static_cast<char *>(message.data()) + sizeof(tiles),
+                buffer_.data(),
+                buffer_.size());
+
+    since_keyframe_++;
+}
+
+void FrameCodec::decodeTiles(const FrameHeader &header,
+                             const zmq::message_t &message,
+                             oat::Frame &frame)
+{
+    if (!decodable(header, message))
+        throw std::runtime_error("Bridged frame does not follow the last "
+                                 "one decoded.");
+
+    TileHeader tiles;
+    std::memcpy(&tiles, message.data(), sizeof(tiles));
+
+    const auto *src = static_cast<const uchar *>(message.data())
+                      + sizeof(tiles);
+    const auto *end = static_cast<const uchar *>(message.data())
+                      + message.size();
+    const size_t elem_bytes = CV_ELEM_SIZE(header.type);
+
+    if (tiles.keyframe) {
+
+        const size_t bytes = header.rows * header.cols * elem_bytes;
+        if (static_cast<size_t>(end - src) != bytes)
+            throw std::runtime_error("Bridged frame has the wrong size.");
+
+        cv::Mat(header.rows, header.cols, header.type,
+                const_cast<uchar *>(src)).copyTo(reference_);
+
+    } else {
+
+        const int tile = static_cast<int>(tiles.tile);
+        if (tile < 1)
+            throw std::runtime_error("Bridged frame has no tile size.");
+
+        const uint32_t tiles_x = (header.cols + tile - 1) / tile;
+        const uint32_t tiles_y = (header.rows + tile - 1) / tile;
+
+        for (uint32_t n = 0; n < tiles.count; n++) {
+
+            uint32_t index;
+            if (static_cast<size_t>(end - src) < sizeof(index))
+                throw std::runtime_error("Bridged frame has the wrong size.");
+            std::memcpy(&index, src, sizeof(index));
+            src += sizeof(index);
+
+            if (index >= tiles_x * tiles_y)
+                throw std::runtime_error("Bridged frame has a tile outside "
+                                         "the frame.");
+
+            const int x = (index % tiles_x) * tile;
+            const int y = (index / tiles_x) * tile;
+            const cv::Rect r(x,
+                             y,
+                             std::min(tile, header.cols - x),
+                             std::min(tile, header.rows - y));
+
+            const size_t row_bytes = r.width * elem_bytes;
+            if (static_cast<size_t>(end - src) < row_bytes * r.height)
+                throw std::runtime_error("Bridged frame has the wrong size.");
+
+            cv::Mat reference = reference_(r);
+            for (int j = 0; j < r.height; j++, src += row_bytes)
+                std::memcpy(reference.ptr(j), src, row_bytes);
+        }
+    }
+
+    sequence_ = tiles.sequence;
+    reference_.copyTo(frame);
+}
+
+}       /* namespace wire */
+}       /* namespace oat */
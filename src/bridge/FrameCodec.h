@@ -0,0 +1,133 @@
+//******************************************************************************
+//* File:   FrameCodec.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMECODEC_H
+#define	OAT_FRAMECODEC_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <zmq.hpp>
+
+#include "../../lib/datatypes/Frame.h"
+
+#include "BridgeProtocol.h"
+
+namespace oat {
+namespace wire {
+
+/**
+ * @brief Encodes the pixels of frames into messages and back. Scratch space
+ * is kept between frames so that steady state coding does not allocate.
+ */
+class FrameCodec {
+
+public:
+    /**
+     * @param codec Encoding produced by encode().
+     * @param quality JPEG quality, 0 to 100.
+     * @param tile Side length of TILES tiles, in pixels.
+     * @param tile_threshold Largest difference of any pixel value of a tile
+     * from the last one sent at which the tile is not sent again. 0 to send
+     * every changed tile, which is lossless.
+     * @param keyframe Number of frames between TILES keyframes.
+     */
+    explicit FrameCodec(const Codec codec = Codec::RAW,
+                        const int quality = 90,
+                        const int tile = 32,
+                        const double tile_threshold = 0,
+                        const uint64_t keyframe = 100)
+    : codec_(codec)
+    , quality_(quality)
+    , tile_(tile)
+    , tile_threshold_(tile_threshold)
+    , keyframe_interval_(keyframe)
+    {
+        // Nothing
+    }
+
+    Codec codec() const { return codec_; }
+
+    /**
+     * @brief Make the next TILES frame a keyframe, e.g. because the peer
+     * that decodes them has reconnected.
+     */
+    void reset() { keyframe_due_ = true; }
+
+    /**
+     * @brief Encode the pixels of a frame.
+     * @param frame Frame to encode. Rows may be padded.
+     * @param message Message to fill with the encoded pixels.
+     */
+    void encode(const oat::Frame &frame, zmq::message_t &message);
+
+    /**
+     * @brief Decode pixels into a frame.
+     * @param header Header that arrived with the pixels. Its codec, rather
+     * than this codec's, is used.
+     * @param message Encoded pixels.
+     * @param frame Frame to write, already in the format of the header.
+     * Rows may be padded.
+     */
+    void decode(const FrameHeader &header,
+                const zmq::message_t &message,
+                oat::Frame &frame);
+
+    /**
+     * @brief Check that decode() can reconstruct a frame, which it cannot
+     * for TILES frames that do not follow the last one decoded, e.g. once
+     * some were dropped, until the next keyframe.
+     * @param header Header that arrived with the pixels.
+     * @param message Encoded pixels.
+     */
+    bool decodable(const FrameHeader &header,
+                   const zmq::message_t &message) const;
+
+private:
+    Codec codec_;
+    int quality_;
+
+    // Scratch space for compressed data, and for frames whose rows must be
+    // packed or unpacked around the codec
+    std::vector<uchar> buffer_;
+    cv::Mat packed_;
+
+    // Packed view of frame, copied through packed_ if its rows are padded
+    const cv::Mat &pack(const oat::Frame &frame);
+
+    // TILES coding. The reference is the last frame as the decoder has it,
+    // and the sequence number that of the last frame coded.
+    int tile_;
+    double tile_threshold_;
+    uint64_t keyframe_interval_;
+    uint64_t since_keyframe_ {0};
+    bool keyframe_due_ {true};
+    uint64_t sequence_ {0};
+    cv::Mat reference_;
+    void encodeTiles(const oat::Frame &frame, zmq::message_t &message);
+    void decodeTiles(const FrameHeader &header,
+                     const zmq::message_t &message,
+                     oat::Frame &frame);
+    bool changed(const cv::Mat &tile, const cv::Mat &reference) const;
+};
+
+}       /* namespace wire */
+}       /* namespace oat */
+#endif	/* OAT_FRAMECODEC_H */
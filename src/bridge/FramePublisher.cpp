@@ -0,0 +1,235 @@
+//******************************************************************************
+//* File:   FramePublisher.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "FramePublisher.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+FramePublisher::FramePublisher(const std::string &frame_source_address)
+: Bridge("bridge[" + frame_source_address + "=>*]")
+, frame_source_address_(frame_source_address)
+, socket_(context_, ZMQ_PUB)
+{
+    // Frames still queued for subscribers when we exit are dropped, which
+    // releases their pixels before the node is unmapped
+    int linger = 0;
+    socket_.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+#ifdef ZMQ_HEARTBEAT_IVL
+    // A subscriber that is gone without closing its connection would
+    // otherwise hold the frame it was queued until TCP gives up on it
+    int ivl = 1000, timeout = 3000;
+    socket_.setsockopt(ZMQ_HEARTBEAT_IVL, &ivl, sizeof(ivl));
+    socket_.setsockopt(ZMQ_HEARTBEAT_TIMEOUT, &timeout, sizeof(timeout));
+#endif
+}
+
+po::options_description FramePublisher::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("endpoint,e", po::value<std::string>(),
+         "ZMQ-style endpoint to bind. For TCP: '<transport>://<host>:<port>'. "
+         "For instance, 'tcp://*:5563'. Any number of ZMQ SUB sockets may "
+         "connect to it.")
+        ("codec", po::value<std::string>(),
+         "Encoding of pixel data. Defaults to raw.\n"
+         "Values:\n"
+         "  raw: \tUncompressed, sent without a copy.\n"
+         "  lz4: \tLossless LZ4 compression. Requires a build with USE_LZ4.\n"
+         "  jpeg: \tLossy JPEG compression. 8-bit GREY and BGR frames only.\n"
+         "  tiles: \tOnly the tiles that changed since the previous frame, "
+         "with periodic keyframes. Lossless unless tile-threshold is set.")
+        ("quality,q", po::value<int>(),
+         "JPEG quality, 0 to 100. Defaults to 90.")
+        ("tile", po::value<int>(),
+         "Side length, in pixels, of tiles sent by the tiles codec, between "
+         "8 and 256. Defaults to 32.")
+        ("tile-threshold", po::value<double>(),
+         "Largest difference of any pixel value of a tile from the last one "
+         "sent at which the tiles codec does not send the tile again, e.g. "
+         "to ignore sensor noise. Defaults to 0, which sends every changed "
+         "tile.")
+        ("keyframe", po::value<uint64_t>(),
+         "Number of frames between whole frames sent by the tiles codec. "
+         "Defaults to 100.")
+        ("hwm", po::value<int>(),
+         "Number of frames, between 1 and 64, queued for each subscriber "
+         "before further frames are dropped for it. Defaults to 2.")
+        ("latest",
+         "If true, publish the most recent frame instead of every frame. The "
+         "upstream component never waits for subscribers, and frames that "
+         "arrive while a frame is being sent are dropped. Raw frames are "
+         "then copied, since the sink may overwrite them while they are "
+         "sent.")
+        ;
+
+    return local_opts;
+}
+
+void FramePublisher::applyConfiguration(const po::variables_map &vm,
+                                        const config::OptionTable &config_table)
+{
+    // Queue length
+    int hwm {2};
+    oat::config::getNumericValue<int>(vm, config_table, "hwm", hwm, 1, 64);
+    socket_.setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
+
+    // Endpoint
+    std::string endpoint;
+    oat::config::getValue<std::string>(
+        vm, config_table, "endpoint", endpoint, true);
+    socket_.bind(endpoint);
+
+    // Encoding
+    std::string codec {"raw"};
+    oat::config::getValue<std::string>(vm, config_table, "codec", codec);
+
+    int quality {90};
+    oat::config::getNumericValue<int>(
+        vm, config_table, "quality", quality, 0, 100);
+
+    int tile {32};
+    oat::config::getNumericValue<int>(vm, config_table, "tile", tile, 8, 256);
+
+    double tile_threshold {0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "tile-threshold", tile_threshold, 0);
+
+    uint64_t keyframe {100};
+    oat::config::getNumericValue<uint64_t>(
+        vm, config_table, "keyframe", keyframe, 1);
+
+    codec_ = wire::FrameCodec(
+        wire::str_codec(codec), quality, tile, tile_threshold, keyframe);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+}
+
+bool FramePublisher::connectToNode()
+{
+    // Establish our a slot in the node
+    frame_source_.touch(frame_source_address_,
+                        latest_ ? SourceMode::LATEST : SourceMode::SYNC);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (frame_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    return true;
+}
+
+int FramePublisher::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (frame_source_.wait() == oat::NodeState::END) {
+        sendEnd();
+        return 1;
+    }
+
+    const auto &frame = frame_source_.borrow();
+
+    wire::FrameHeader header;
+    header.codec = codec_.codec();
+    header.rows = frame.rows;
+    header.cols = frame.cols;
+    header.type = frame.type();
+    header.color = frame.color();
+    header.sample = frame.sample();
+
+    // Raw pixels are lent to ZMQ as they are in the node. Only a synchronous
+    // source keeps the sink from overwriting them while they are sent.
+    const bool zero_copy = codec_.codec() == wire::Codec::RAW
+                           && !latest_ && frame.isContinuous();
+
+    zmq::message_t pixels;
+    if (zero_copy) {
+        release_.released = false;
+        pixels.rebuild(frame.data, frame.total() * frame.elemSize(),
+                       &FramePublisher::releasePixels, &release_);
+    } else {
+        codec_.encode(frame, pixels);
+        frame_source_.post();
+    }
+
+    header.sent_ns = now_ns();
+    zmq::message_t head(sizeof(header));
+    std::memcpy(head.data(), &header, sizeof(header));
+    socket_.send(head, ZMQ_SNDMORE);
+    socket_.send(pixels);
+
+    // The read barrier is held until every subscriber has been sent the
+    // pixels, or has had them dropped
+    if (zero_copy) {
+        if (!awaitRelease())
+            return 1;
+        frame_source_.post();
+    }
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    samples_++;
+
+    return 0;
+}
+
+void FramePublisher::releasePixels(void *data, void *hint)
+{
+    (void)data;
+    auto *release = static_cast<Release *>(hint);
+
+    std::lock_guard<std::mutex> lock(release->mutex);
+    release->released = true;
+    release->cv.notify_one();
+}
+
+bool FramePublisher::awaitRelease()
+{
+    std::unique_lock<std::mutex> lock(release_.mutex);
+    while (!release_.released) {
+        release_.cv.wait_for(lock, std::chrono::milliseconds(wire::POLL_MS));
+        if (quit)
+            return false;
+    }
+
+    return true;
+}
+
+void FramePublisher::sendEnd()
+{
+    wire::FrameHeader header;
+    header.kind = wire::Kind::END;
+    header.sent_ns = now_ns();
+
+    zmq::message_t head(sizeof(header));
+    std::memcpy(head.data(), &header, sizeof(header));
+    socket_.send(head);
+}
+
+} /* namespace oat */
@@ -0,0 +1,94 @@
+//******************************************************************************
+//* File:   FramePublisher.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMEPUBLISHER_H
+#define	OAT_FRAMEPUBLISHER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "Bridge.h"
+#include "FrameCodec.h"
+
+namespace oat {
+
+class FramePublisher : public Bridge {
+
+public:
+    /**
+     * @brief Publishes frames from a local SOURCE to any number of
+     * subscribers. Raw frames are sent straight from the node's shared
+     * memory, without being copied, and the source only tells the sink it may
+     * continue once ZMQ has released them.
+     * @param frame_source_address Frame source to publish from.
+     */
+    explicit FramePublisher(const std::string &frame_source_address);
+
+    uint64_t dropped() const override { return frame_source_.dropped(); }
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Frame source. Declared before the socket so that the node is still
+    // mapped while the socket drops any frames it holds on close.
+    const std::string frame_source_address_;
+    oat::Source<oat::Frame> frame_source_;
+    bool latest_ {false};
+
+    // Pixel encoding
+    wire::FrameCodec codec_;
+
+    /**
+     * @brief Set by ZMQ, from its I/O thread, once it no longer needs
+     * the pixels of the frame being sent without a copy.
+     */
+    struct Release {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool released {true};
+    } release_;
+
+    static void releasePixels(void *data, void *hint);
+
+    /**
+     * @brief Wait for ZMQ to release the frame's pixels.
+     * @return False if interrupted first.
+     */
+    bool awaitRelease();
+
+    // Subscribers
+    zmq::context_t context_ {1};
+    zmq::socket_t socket_;
+
+    void sendEnd();
+};
+
+}      /* namespace oat */
+#endif /* OAT_FRAMEPUBLISHER_H */
@@ -0,0 +1,207 @@
+//******************************************************************************
+//* File:   FrameReceiver.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "FrameReceiver.h"
+
+#include <cstring>
+#include <string>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Polls without a frame after which credits are granted again
+static constexpr int IDLE_POLLS {10};
+
+FrameReceiver::FrameReceiver(const std::string &frame_sink_address)
+: Bridge("bridge[*->" + frame_sink_address + "]")
+, socket_(context_, ZMQ_DEALER)
+, frame_sink_address_(frame_sink_address)
+{
+    // Credits are useless once we are gone
+    int linger = 0;
+    socket_.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+}
+
+po::options_description FrameReceiver::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("endpoint,e", po::value<std::string>(),
+         "ZMQ-style endpoint of the sender to connect to. For instance, "
+         "'tcp://acq-pc:5560'.")
+        ("credits", po::value<uint32_t>(),
+         "Number of frames, between 1 and 64, that the sender may have in "
+         "flight. More hide more network latency at the cost of more "
+         "frames queued on the link. Defaults to 2.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the bridge by up to this number of frames minus one without "
+         "blocking it. Defaults to 1.")
+        ;
+
+    return local_opts;
+}
+
+void FrameReceiver::applyConfiguration(const po::variables_map &vm,
+                                       const config::OptionTable &config_table)
+{
+    // Endpoint
+    std::string endpoint;
+    oat::config::getValue<std::string>(
+        vm, config_table, "endpoint", endpoint, true);
+    socket_.connect(endpoint);
+
+    // Flow control
+    oat::config::getNumericValue<uint32_t>(
+        vm, config_table, "credits", credits_, 1, 64);
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+}
+
+bool FrameReceiver::connectToNode()
+{
+    grantCredits(credits_, true);
+
+    // The sink cannot be bound before the frame format is known
+    while (!receiveFrame()) {
+        if (quit || end_)
+            return false;
+    }
+
+    frame_sink_.bind(frame_sink_address_,
+                     header_.rows * header_.cols * CV_ELEM_SIZE(header_.type),
+                     num_buffers_);
+
+    shared_frame_ = frame_sink_.retrieve(
+        header_.rows,
+        header_.cols,
+        header_.type,
+        static_cast<oat::PixelColor>(header_.color));
+
+    return true;
+}
+
+int FrameReceiver::process()
+{
+    if (!pending_ && !receiveFrame())
+        return end_ ? 1 : 0;
+
+    // Tiles that do not follow the last frame decoded are skipped until the
+    // next keyframe
+    if (!codec_.decodable(header_, pixels_)) {
+        pending_ = false;
+        grantCredits(1, false);
+        return 0;
+    }
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    frame_sink_.wait();
+
+    shared_frame_ = frame_sink_.retrieve();
+
+    // Follow format changes made upstream
+    const auto color = static_cast<oat::PixelColor>(header_.color);
+    if (shared_frame_.rows != header_.rows
+        || shared_frame_.cols != header_.cols
+        || shared_frame_.type() != header_.type
+        || shared_frame_.color() != color)
+        shared_frame_ = frame_sink_.reformat(
+            header_.rows, header_.cols, header_.type, color);
+
+    codec_.decode(header_, pixels_, shared_frame_);
+
+    // Keep the sample, with its times moved onto our clock as though it had
+    // arrived the moment it was sent
+    auto sample = header_.sample;
+    sample.shiftClock(static_cast<int64_t>(now_ns() - header_.sent_ns));
+    shared_frame_.set_sample(sample);
+
+    // Tell sources there is new data
+    frame_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    pending_ = false;
+    samples_++;
+    grantCredits(1, false);
+
+    return 0;
+}
+
+bool FrameReceiver::poll(const int timeout_ms)
+{
+    zmq::pollitem_t p[] = {{socket_, 0, ZMQ_POLLIN, 0}};
+    zmq::poll(&p[0], 1, timeout_ms);
+    return p[0].revents & ZMQ_POLLIN;
+}
+
+bool FrameReceiver::receiveFrame()
+{
+    for (int i = 0; i < IDLE_POLLS && !poll(wire::POLL_MS); i++) {
+        if (quit)
+            return false;
+    }
+
+    zmq::message_t head;
+    if (!socket_.recv(&head, ZMQ_DONTWAIT)) {
+        grantCredits(credits_, true);
+        return false;
+    }
+
+    if (head.size() != sizeof(header_))
+        throw std::runtime_error("Bridge received a malformed frame header.");
+
+    std::memcpy(&header_, head.data(), sizeof(header_));
+    if (!header_.valid())
+        throw std::runtime_error("Bridge received a frame from an "
+                                 "incompatible version of Oat.");
+
+    if (header_.kind == wire::Kind::END) {
+        end_ = true;
+        return false;
+    }
+
+    // Parts of a message arrive together
+    socket_.recv(&pixels_);
+    pending_ = true;
+
+    return true;
+}
+
+void FrameReceiver::grantCredits(const uint32_t count, const bool reset)
+{
+    wire::Credit credit;
+    credit.count = count;
+    credit.reset = reset ? 1 : 0;
+
+    zmq::message_t message(sizeof(credit));
+    std::memcpy(message.data(), &credit, sizeof(credit));
+    socket_.send(message);
+}
+
+} /* namespace oat */
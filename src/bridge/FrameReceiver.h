@@ -0,0 +1,95 @@
+//******************************************************************************
+//* File:   FrameReceiver.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMERECEIVER_H
+#define	OAT_FRAMERECEIVER_H
+
+#include <string>
+
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/shmemdf/Sink.h"
+
+#include "Bridge.h"
+#include "FrameCodec.h"
+
+namespace oat {
+
+class FrameReceiver : public Bridge {
+
+public:
+    /**
+     * @brief Publishes frames sent by a FrameSender on another host to a
+     * local SINK. The sink is bound once the first frame, and with it the
+     * frame format, arrives.
+     * @param frame_sink_address Frame sink to publish to.
+     */
+    explicit FrameReceiver(const std::string &frame_sink_address);
+
+private:
+    // Link to the other end
+    zmq::context_t context_ {1};
+    zmq::socket_t socket_;
+
+    /**
+     * @brief Wait for a message from the other end.
+     * @param timeout_ms Time to wait.
+     * @return True if a message is waiting to be received.
+     */
+    bool poll(const int timeout_ms);
+
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Frame sink
+    const std::string frame_sink_address_;
+    oat::Sink<oat::Frame> frame_sink_;
+    oat::Frame shared_frame_;
+    size_t num_buffers_ {1};
+
+    // Frames the sender may have in flight
+    uint32_t credits_ {2};
+
+    // Received frame waiting to be published
+    wire::FrameHeader header_;
+    zmq::message_t pixels_;
+    bool pending_ {false};
+    bool end_ {false};
+
+    // Pixel decoding. The codec is chosen by the sender.
+    wire::FrameCodec codec_;
+
+    /**
+     * @brief Receive the next message from the sender. If none arrives for a
+     * while, all credits are granted again in case the sender restarted and
+     * lost them.
+     * @return True if a frame is pending.
+     */
+    bool receiveFrame();
+
+    void grantCredits(const uint32_t count, const bool reset);
+};
+
+}      /* namespace oat */
+#endif /* OAT_FRAMERECEIVER_H */
@@ -0,0 +1,220 @@
+//******************************************************************************
+//* File:   FrameSender.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "FrameSender.h"
+
+#include <cstring>
+#include <string>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+FrameSender::FrameSender(const std::string &frame_source_address)
+: Bridge("bridge[" + frame_source_address + "->*]")
+, socket_(context_, ZMQ_DEALER)
+, frame_source_address_(frame_source_address)
+{
+    // Give the end of stream message a chance to leave on exit, but do not
+    // hang if the receiver is gone
+    int linger = 1000;
+    socket_.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+}
+
+po::options_description FrameSender::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("endpoint,e", po::value<std::string>(),
+         "ZMQ-style endpoint to bind. For TCP: '<transport>://<host>:<port>'. "
+         "For instance, 'tcp://*:5560'. A single receiver connects to it.")
+        ("codec", po::value<std::string>(),
+         "Encoding of pixel data. Defaults to raw.\n"
+         "Values:\n"
+         "  raw: \tUncompressed.\n"
+         "  lz4: \tLossless LZ4 compression. Requires a build with USE_LZ4.\n"
+         "  jpeg: \tLossy JPEG compression. 8-bit GREY and BGR frames only.\n"
+         "  tiles: \tOnly the tiles that changed since the previous frame, "
+         "with periodic keyframes. Lossless unless tile-threshold is set.")
+        ("quality,q", po::value<int>(),
+         "JPEG quality, 0 to 100. Defaults to 90.")
+        ("tile", po::value<int>(),
+         "Side length, in pixels, of tiles sent by the tiles codec, between "
+         "8 and 256. Defaults to 32.")
+        ("tile-threshold", po::value<double>(),
+         "Largest difference of any pixel value of a tile from the last one "
+         "sent at which the tiles codec does not send the tile again, e.g. "
+         "to ignore sensor noise. Defaults to 0, which sends every changed "
+         "tile.")
+        ("keyframe", po::value<uint64_t>(),
+         "Number of frames between whole frames sent by the tiles codec. "
+         "Defaults to 100.")
+        ("latest",
+         "If true, send the most recent frame each time the receiver has "
+         "credit instead of every frame. The upstream component never waits "
+         "for the link, and frames that arrive while it is busy are "
+         "dropped.")
+        ;
+
+    return local_opts;
+}
+
+void FrameSender::applyConfiguration(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    // Endpoint
+    std::string endpoint;
+    oat::config::getValue<std::string>(
+        vm, config_table, "endpoint", endpoint, true);
+    socket_.bind(endpoint);
+
+    // Encoding
+    std::string codec {"raw"};
+    oat::config::getValue<std::string>(vm, config_table, "codec", codec);
+
+    int quality {90};
+    oat::config::getNumericValue<int>(
+        vm, config_table, "quality", quality, 0, 100);
+
+    int tile {32};
+    oat::config::getNumericValue<int>(vm, config_table, "tile", tile, 8, 256);
+
+    double tile_threshold {0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "tile-threshold", tile_threshold, 0);
+
+    uint64_t keyframe {100};
+    oat::config::getNumericValue<uint64_t>(
+        vm, config_table, "keyframe", keyframe, 1);
+
+    codec_ = wire::FrameCodec(
+        wire::str_codec(codec), quality, tile, tile_threshold, keyframe);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+}
+
+bool FrameSender::connectToNode()
+{
+    // Establish our a slot in the node
+    frame_source_.touch(frame_source_address_,
+                        latest_ ? SourceMode::LATEST : SourceMode::SYNC);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (frame_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    return true;
+}
+
+int FrameSender::process()
+{
+    // Frames are only read against credit, so a slow link holds back the
+    // upstream sink, or, for latest sources, only makes us skip frames
+    while (credits_ == 0) {
+        receiveCredits(wire::POLL_MS);
+        if (quit)
+            return 1;
+    }
+    receiveCredits(0);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (frame_source_.wait() == oat::NodeState::END) {
+        sendEnd();
+        return 1;
+    }
+
+    const auto &frame = frame_source_.borrow();
+
+    wire::FrameHeader header;
+    header.codec = codec_.codec();
+    header.rows = frame.rows;
+    header.cols = frame.cols;
+    header.type = frame.type();
+    header.color = frame.color();
+    header.sample = frame.sample();
+
+    zmq::message_t pixels;
+    codec_.encode(frame, pixels);
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    header.sent_ns = now_ns();
+    zmq::message_t head(sizeof(header));
+    std::memcpy(head.data(), &header, sizeof(header));
+    socket_.send(head, ZMQ_SNDMORE);
+    socket_.send(pixels);
+
+    credits_--;
+    samples_++;
+
+    return 0;
+}
+
+bool FrameSender::poll(const int timeout_ms)
+{
+    zmq::pollitem_t p[] = {{socket_, 0, ZMQ_POLLIN, 0}};
+    zmq::poll(&p[0], 1, timeout_ms);
+    return p[0].revents & ZMQ_POLLIN;
+}
+
+void FrameSender::receiveCredits(const int timeout_ms)
+{
+    if (!poll(timeout_ms))
+        return;
+
+    zmq::message_t message;
+    while (socket_.recv(&message, ZMQ_DONTWAIT)) {
+
+        wire::Credit credit;
+        if (message.size() != sizeof(credit))
+            throw std::runtime_error("Bridge received a malformed credit.");
+
+        std::memcpy(&credit, message.data(), sizeof(credit));
+        if (!credit.valid())
+            throw std::runtime_error("Bridge received a malformed credit.");
+
+        // A (re)connecting receiver replaces whatever credit we held, and
+        // has no frame for tiles to be applied to
+        if (credit.reset) {
+            credits_ = credit.count;
+            codec_.reset();
+        } else
+            credits_ += credit.count;
+    }
+}
+
+void FrameSender::sendEnd()
+{
+    wire::FrameHeader header;
+    header.kind = wire::Kind::END;
+    header.sent_ns = now_ns();
+
+    zmq::message_t head(sizeof(header));
+    std::memcpy(head.data(), &header, sizeof(header));
+    socket_.send(head);
+}
+
+} /* namespace oat */
@@ -0,0 +1,87 @@
+//******************************************************************************
+//* File:   FrameSender.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMESENDER_H
+#define	OAT_FRAMESENDER_H
+
+#include <string>
+
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "Bridge.h"
+#include "FrameCodec.h"
+
+namespace oat {
+
+class FrameSender : public Bridge {
+
+public:
+    /**
+     * @brief Sends frames from a local SOURCE to a FrameReceiver on another
+     * host.
+     * @param frame_source_address Frame source to send from.
+     */
+    explicit FrameSender(const std::string &frame_source_address);
+
+    uint64_t dropped() const override { return frame_source_.dropped(); }
+
+private:
+    // Link to the other end
+    zmq::context_t context_ {1};
+    zmq::socket_t socket_;
+
+    /**
+     * @brief Wait for a message from the other end.
+     * @param timeout_ms Time to wait.
+     * @return True if a message is waiting to be received.
+     */
+    bool poll(const int timeout_ms);
+
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Frame source
+    const std::string frame_source_address_;
+    oat::Source<oat::Frame> frame_source_;
+    bool latest_ {false};
+
+    // Pixel encoding
+    wire::FrameCodec codec_;
+
+    // Frames the receiver will accept
+    uint64_t credits_ {0};
+
+    /**
+     * @brief Add credits granted by the receiver.
+     * @param timeout_ms Time to wait for the first grant.
+     */
+    void receiveCredits(const int timeout_ms);
+
+    void sendEnd();
+};
+
+}      /* namespace oat */
+#endif /* OAT_FRAMESENDER_H */
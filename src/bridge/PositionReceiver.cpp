@@ -0,0 +1,200 @@
+//******************************************************************************
+//* File:   PositionReceiver.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "PositionReceiver.h"
+
+#include <string>
+
+#include <poll.h>
+
+#include <boost/asio/buffer.hpp>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+PositionReceiver::PositionReceiver(const std::string &position_sink_address)
+: Bridge("bridge[*->" + position_sink_address + "]")
+, position_sink_address_(position_sink_address)
+, position_(position_sink_address)
+, socket_(io_service_)
+{
+    // Nothing
+}
+
+po::options_description PositionReceiver::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("port,p", po::value<int>(),
+         "UDP port to receive positions on. For instance, 5561.")
+        ("interface", po::value<std::string>(),
+         "IP address of the local network interface to receive on. Defaults "
+         "to all interfaces.")
+        ("busy-poll",
+         "If true, spin on the socket instead of sleeping until a datagram "
+         "arrives. Removes the wake-up latency of the receiving thread at "
+         "the cost of occupying a core. Best combined with the cpus option.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared position buffers, between 1 and 8. When greater "
+         "than 1, positions are written round-robin so that downstream "
+         "components can lag the bridge by up to this number of positions "
+         "minus one without blocking it. Defaults to 1.")
+        ("merge", po::value<size_t>(),
+         "Publish to SINK as one of several bridges sharing a merge node, for "
+         "instance one per host running a shard of a detector. Sources read "
+         "the positions of every bridge in sample number order. The value is "
+         "the reorder window: the number of samples by which another bridge "
+         "may lag before it is no longer waited for. Its positions that then "
+         "arrive behind the stream are dropped.")
+        ;
+
+    return local_opts;
+}
+
+void PositionReceiver::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Port
+    int port;
+    oat::config::getNumericValue<int>(
+        vm, config_table, "port", port, 1025, 65535, true);
+
+    // Interface
+    auto address = boost::asio::ip::address(boost::asio::ip::address_v4::any());
+    std::string iface;
+    if (oat::config::getValue<std::string>(vm, config_table, "interface", iface))
+        address = boost::asio::ip::address::from_string(iface);
+
+    socket_.open(boost::asio::ip::udp::v4());
+    socket_.bind(boost::asio::ip::udp::endpoint(address, port));
+    socket_.non_blocking(true);
+
+    // Receive mode
+    oat::config::getValue<bool>(vm, config_table, "busy-poll", busy_poll_);
+
+    // Number of shared position buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Merge node
+    size_t window;
+    if (oat::config::getNumericValue<size_t>(
+            vm, config_table, "merge", window, 1))
+        position_sink_.set_merge(window);
+}
+
+bool PositionReceiver::connectToNode()
+{
+    position_sink_.bind(position_sink_address_,
+                        position_sink_address_,
+                        num_buffers_);
+
+    return true;
+}
+
+int PositionReceiver::process()
+{
+    if (!receive())
+        return end_ ? 1 : 0;
+
+    // Keep the sample, with its times moved onto our clock as though it had
+    // arrived the moment it was sent
+    auto record = datagram_.record;
+    record.sample.shiftClock(static_cast<int64_t>(now_ns() - datagram_.sent_ns));
+    position_.set_record(record);
+    position_.setCoordSystem(static_cast<DistanceUnit>(datagram_.unit),
+                             cv::Matx33d(datagram_.homography));
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read. Positions that other bridges of a merge
+    // node have overtaken are dropped.
+    if (!position_sink_.wait(record.sample.count()))
+        return 0;
+
+    position_sink_.write(position_);
+
+    // Tell sources there is new data
+    position_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    samples_++;
+
+    return 0;
+}
+
+bool PositionReceiver::receive()
+{
+    while (!quit) {
+
+        boost::system::error_code ec;
+        const size_t n = socket_.receive(
+            boost::asio::buffer(&datagram_, sizeof(datagram_)), 0, ec);
+
+        if (ec == boost::asio::error::would_block) {
+
+            // Sleep in poll() rather than in a blocking receive so that
+            // CTRL+C is noticed
+            if (!busy_poll_) {
+                pollfd p {socket_.native_handle(), POLLIN, 0};
+                ::poll(&p, 1, wire::POLL_MS);
+            }
+            continue;
+        }
+
+        if (ec)
+            throw boost::system::system_error(ec);
+
+        // Not from a sender
+        if (n != sizeof(datagram_) || !datagram_.valid())
+            continue;
+
+        // A new sender starts a new sequence
+        if (datagram_.session != session_) {
+            session_ = datagram_.session;
+            next_sequence_ = datagram_.sequence;
+        }
+
+        // Positions that arrive out of order are older than one already
+        // published
+        if (datagram_.sequence < next_sequence_) {
+            stale_++;
+            continue;
+        }
+
+        lost_ += datagram_.sequence - next_sequence_;
+        next_sequence_ = datagram_.sequence + 1;
+
+        if (datagram_.kind == wire::Kind::END) {
+            end_ = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+} /* namespace oat */
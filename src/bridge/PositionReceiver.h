@@ -0,0 +1,88 @@
+//******************************************************************************
+//* File:   PositionReceiver.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONRECEIVER_H
+#define	OAT_POSITIONRECEIVER_H
+
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/Sink.h"
+
+#include "Bridge.h"
+
+namespace oat {
+
+class PositionReceiver : public Bridge {
+
+    using UDPSocket = boost::asio::ip::udp::socket;
+
+public:
+    /**
+     * @brief Publishes positions sent by a PositionSender on another host to
+     * a local SINK.
+     * @param position_sink_address Position sink to publish to.
+     */
+    explicit PositionReceiver(const std::string &position_sink_address);
+
+    uint64_t dropped() const override { return lost_ + stale_; }
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Position sink
+    const std::string position_sink_address_;
+    oat::Sink<oat::Position2D> position_sink_;
+    oat::Position2D position_;
+    size_t num_buffers_ {1};
+
+    // Link to the sender
+    boost::asio::io_service io_service_;
+    UDPSocket socket_;
+    bool busy_poll_ {false};
+
+    // Last datagram received
+    wire::PositionDatagram datagram_;
+    bool end_ {false};
+
+    // Sequence tracking
+    uint64_t session_ {0};
+    uint64_t next_sequence_ {0};
+    uint64_t lost_ {0};  //!< Sequence numbers that never arrived
+    uint64_t stale_ {0}; //!< Datagrams that arrived out of order
+
+    /**
+     * @brief Receive the next in-order position datagram.
+     * @return True if a position was received.
+     */
+    bool receive();
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONRECEIVER_H */
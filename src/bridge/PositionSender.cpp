@@ -0,0 +1,137 @@
+//******************************************************************************
+//* File:   PositionSender.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "PositionSender.h"
+
+#include <string>
+
+#include <boost/asio/buffer.hpp>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Number of times the end of stream is sent, since datagrams can be lost
+static constexpr int END_REPEATS {3};
+
+PositionSender::PositionSender(const std::string &position_source_address)
+: Bridge("bridge[" + position_source_address + "->*]")
+, position_source_address_(position_source_address)
+, socket_(io_service_, UDPEndpoint(boost::asio::ip::udp::v4(), 0))
+{
+    // Distinguishes this run from earlier ones
+    datagram_.session = now_ns();
+}
+
+po::options_description PositionSender::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("host,h", po::value<std::string>(),
+         "IP address or name of the host running the receiver. For "
+         "instance, '10.0.0.2'.")
+        ("port,p", po::value<int>(),
+         "UDP port of the receiver. For instance, 5561.")
+        ("latest",
+         "If true, send the most recent position instead of every position. "
+         "The upstream component never waits for the link, and positions "
+         "that arrive while it is busy sending are dropped.")
+        ;
+
+    return local_opts;
+}
+
+void PositionSender::applyConfiguration(const po::variables_map &vm,
+                                        const config::OptionTable &config_table)
+{
+    // Host
+    std::string host;
+    oat::config::getValue<std::string>(vm, config_table, "host", host, true);
+
+    // Port
+    int port;
+    oat::config::getNumericValue<int>(
+        vm, config_table, "port", port, 1025, 65535, true);
+
+    boost::asio::ip::udp::resolver resolver(io_service_);
+    endpoint_ = *resolver.resolve({boost::asio::ip::udp::v4(),
+                                   host,
+                                   std::to_string(port)});
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+}
+
+bool PositionSender::connectToNode()
+{
+    // Establish our a slot in the node
+    position_source_.touch(position_source_address_,
+                           latest_ ? SourceMode::LATEST : SourceMode::SYNC);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (position_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    return true;
+}
+
+int PositionSender::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (position_source_.wait() == oat::NodeState::END) {
+
+        datagram_.kind = wire::Kind::END;
+        for (int i = 0; i < END_REPEATS; i++)
+            send();
+
+        return 1;
+    }
+
+    // Copy the shared position
+    position_source_.copyTo(position_);
+
+    // Tell sink it can continue
+    position_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    datagram_.unit = static_cast<uint8_t>(position_.unit_of_length());
+    const auto h = position_.homography();
+    for (int i = 0; i < 9; i++)
+        datagram_.homography[i] = h.val[i];
+    datagram_.record = position_.record();
+
+    send();
+    samples_++;
+
+    return 0;
+}
+
+void PositionSender::send()
+{
+    datagram_.sent_ns = now_ns();
+    socket_.send_to(boost::asio::buffer(&datagram_, sizeof(datagram_)),
+                    endpoint_);
+    datagram_.sequence++;
+}
+
+} /* namespace oat */
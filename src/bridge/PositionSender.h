@@ -0,0 +1,79 @@
+//******************************************************************************
+//* File:   PositionSender.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONSENDER_H
+#define	OAT_POSITIONSENDER_H
+
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "Bridge.h"
+
+namespace oat {
+
+class PositionSender : public Bridge {
+
+    using UDPSocket = boost::asio::ip::udp::socket;
+    using UDPEndpoint = boost::asio::ip::udp::endpoint;
+
+public:
+    /**
+     * @brief Sends positions from a local SOURCE to a PositionReceiver on
+     * another host.
+     * @param position_source_address Position source to send from.
+     */
+    explicit PositionSender(const std::string &position_source_address);
+
+    uint64_t dropped() const override { return position_source_.dropped(); }
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Position source
+    const std::string position_source_address_;
+    oat::Source<oat::Position2D> position_source_;
+    oat::Position2D position_ {"bridge"};
+    bool latest_ {false};
+
+    // Link to the receiver
+    boost::asio::io_service io_service_;
+    UDPSocket socket_;
+    UDPEndpoint endpoint_;
+
+    // Reused for every datagram. Only the sequence number, send time and
+    // position change.
+    wire::PositionDatagram datagram_;
+
+    void send();
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONSENDER_H */
@@ -21,6 +21,8 @@
 
 #include <string>
 
+#include "../../lib/utility/TOMLSanitize.h"
+
 namespace oat {
 
 Buffer::Buffer(const std::string &source_address,
@@ -34,6 +36,11 @@ Buffer::Buffer(const std::string &source_address,
 }
 
 Buffer::~Buffer()
+{
+    stopSink();
+}
+
+void Buffer::stopSink()
 {
     // Join threads
     sink_running_ = false;
@@ -41,4 +48,68 @@ Buffer::~Buffer()
         sink_thread_.join();
 }
 
+po::options_description Buffer::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("depth,n", po::value<int>(),
+         "Number of tokens the FIFO holds in memory. Defaults to 1000.")
+        ("overflow,o", po::value<std::string>(),
+         "Action taken when a token arrives at a full FIFO. Values:\n"
+         "  block: hold the SOURCE until there is room.\n"
+         "  drop-oldest: discard the oldest token in the FIFO.\n"
+         "  drop-newest: discard the arriving token (default).\n"
+         "  spill: write tokens to disk until the FIFO drains.")
+        ("spill-dir", po::value<std::string>(),
+         "Directory holding spilled tokens. Defaults to /tmp.")
+        ("pace",
+         "If true, release tokens at the sample rate of the SOURCE, so that "
+         "bursts are smoothed out. Otherwise tokens are released as fast as "
+         "the SINK's readers take them.")
+        ("batch", po::value<size_t>(),
+         "Most tokens moved out of the FIFO at once each time the SINK "
+         "thread wakes, so that bursts are drained without waking per "
+         "token. Position buffers only. Defaults to 64.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared position buffers, between 1 and 8. When greater "
+         "than 1, positions are written round-robin so that readers can take "
+         "a drained batch without holding back each successive token. "
+         "Position buffers only. Defaults to 1.")
+        ;
+
+    return local_opts;
+}
+
+void Buffer::applyConfiguration(const po::variables_map &vm,
+                                const config::OptionTable &config_table)
+{
+    // FIFO depth
+    int depth;
+    if (oat::config::getNumericValue<int>(vm, config_table, "depth", depth, 1))
+        depth_ = depth;
+
+    // Overflow policy
+    std::string overflow;
+    if (oat::config::getValue<std::string>(vm, config_table, "overflow", overflow))
+        overflow_ = overflowPolicy(overflow);
+
+    // Spill directory
+    oat::config::getValue<std::string>(vm, config_table, "spill-dir", spill_dir_);
+
+    // Release
+    oat::config::getValue<bool>(vm, config_table, "pace", pace_);
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "batch", batch_size_, 1);
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+}
+
+std::unique_ptr<SpillFile> Buffer::makeSpillFile(const size_t record_bytes) const
+{
+    if (overflow_ != OverflowPolicy::SPILL)
+        return nullptr;
+
+    return std::unique_ptr<SpillFile>(new SpillFile(spill_dir_, record_bytes));
+}
+
 } /* namespace oat */
@@ -20,22 +20,29 @@
 #ifndef OAT_BUFFER_H
 #define OAT_BUFFER_H
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
-#include <mutex>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/program_options.hpp>
 
 #include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
+#include "../../lib/utility/Pacer.h"
+
+#include "TokenFifo.h"
 
 namespace oat {
 
-class Buffer : public Component {
+namespace po = boost::program_options;
+
+class Buffer : public Component, public Configurable<false> {
 
 public:
 
@@ -53,11 +60,33 @@ public:
     std::string name() const override { return name_; }
     ComponentType type() const override { return ComponentType::buffer; }
 
+    /**
+     * @brief FIFO occupancy metrics so far.
+     */
+    virtual FifoStats stats(void) const = 0;
+
 protected:
-    static constexpr size_t BUFFSIZE{1000};
-    using buffer_size_t = boost::lockfree::capacity<BUFFSIZE>;
+    static constexpr size_t DEFAULT_DEPTH{1000};
     using msec = std::chrono::milliseconds;
 
+    // Implement Configurable interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    /**
+     * @brief Create the FIFO file that SPILL mode writes to.
+     * @param record_bytes Bytes per spilled token.
+     * @return Spill file, or null if the overflow policy does not spill.
+     */
+    std::unique_ptr<SpillFile> makeSpillFile(const size_t record_bytes) const;
+
+    /**
+     * @brief Stop and join the consumer thread. Must be called by the
+     * destructors of concrete buffers, before their FIFO is destroyed.
+     */
+    void stopSink(void);
+
     /**
      * @brief In response to downstream request, publish object from FIFO to SINK.
      */
@@ -69,11 +98,24 @@ protected:
     // Source
     const std::string source_address_;
 
+    // FIFO configuration
+    size_t depth_ {DEFAULT_DEPTH};
+    OverflowPolicy overflow_ {OverflowPolicy::DROP_NEWEST};
+    std::string spill_dir_ {"/tmp"};
+
+    // Release. Tokens leave the FIFO as fast as the SINK's readers take them,
+    // or one per sample period of the SOURCE when paced.
+    bool pace_ {false};
+    oat::Pacer pacer_;
+
+    // Token buffers drain up to batch_size_ tokens per wake up and publish
+    // them through num_buffers_ round-robin SINK buffers
+    size_t batch_size_ {64};
+    size_t num_buffers_ {1};
+
     // Sink
     std::atomic<bool> sink_running_{true};
     std::thread sink_thread_;
-    std::mutex cv_m_;
-    std::condition_variable cv_;
     const std::string sink_address_;
 };
 
@@ -81,13 +123,13 @@ protected:
 
 static constexpr size_t PROGRESS_BAR_WIDTH{80};
 
-template <typename T>
-void showBufferState(const T &buffer, size_t buffer_size)
+inline void showBufferState(size_t occupancy, size_t buffer_size)
 {
 
     std::cout << "[";
 
-    int progress = (PROGRESS_BAR_WIDTH * buffer.read_available()) / buffer_size;
+    // Spilled tokens can take occupancy past the buffer size
+    int progress = (PROGRESS_BAR_WIDTH * std::min(occupancy, buffer_size)) / buffer_size;
     int remaining = PROGRESS_BAR_WIDTH - progress;
 
     for (int i = 0; i < progress; ++i)
@@ -96,7 +138,7 @@ void showBufferState(const T &buffer, size_t buffer_size)
         std::cout << " ";
 
     std::cout << "] "
-              + std::to_string(buffer.read_available())
+              + std::to_string(occupancy)
               + "/"
               + std::to_string(buffer_size)
               + "\n";
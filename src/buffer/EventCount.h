@@ -0,0 +1,133 @@
+//******************************************************************************
+//* File:   EventCount.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_EVENTCOUNT_H
+#define	OAT_EVENTCOUNT_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace oat {
+
+/**
+ * @brief Eventcount for threads of one process, built on a futex. Lets a
+ * thread sleep until some lock-free condition becomes true without a mutex.
+ * notify() is a single atomic increment unless a thread is asleep, in which
+ * case it also makes one FUTEX_WAKE call.
+ */
+class EventCount {
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Futex word must be a plain 32-bit integer.");
+
+public:
+
+    // Number of condition checks before sleeping on the futex
+    static constexpr int SPIN_COUNT {128};
+
+    EventCount() = default;
+    EventCount(const EventCount &) = delete;
+    EventCount &operator=(const EventCount &) = delete;
+
+    /**
+     * @brief Wake every thread sleeping in await(). Call after making the
+     * condition they wait for true.
+     */
+    void notify()
+    {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) > 0)
+            futex(FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+    }
+
+    /**
+     * @brief Block until ready() returns true or timeout passes.
+     * @param ready Condition to wait for. Must only read state that is
+     * changed before a notify().
+     * @param timeout Maximum wait.
+     * @return The last result of ready().
+     */
+    template <typename Pred, typename Rep, typename Period>
+    bool await(Pred ready, const std::chrono::duration<Rep, Period> timeout)
+    {
+        for (int i = 0; i < SPIN_COUNT; i++) {
+            if (ready())
+                return true;
+            relax();
+        }
+
+        // Announce ourselves and note the epoch before the final check so
+        // that a notify() between the check and the futex call cannot be
+        // missed
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        auto key = epoch_.load(std::memory_order_seq_cst);
+        if (ready()) {
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      timeout).count();
+        struct timespec ts;
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+
+        // Returns at once if the epoch already moved on
+        futex(FUTEX_WAIT_PRIVATE, key, &ts);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+
+        return ready();
+    }
+
+    static void relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+private:
+
+    std::atomic<uint32_t> epoch_ {0};
+    std::atomic<uint32_t> waiters_ {0};
+
+    long futex(const int op, const uint32_t val, const struct timespec *ts)
+    {
+        // ts is relative for FUTEX_WAIT
+        return syscall(SYS_futex,
+                       reinterpret_cast<uint32_t *>(&epoch_),
+                       op,
+                       val,
+                       ts,
+                       nullptr,
+                       0);
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_EVENTCOUNT_H */
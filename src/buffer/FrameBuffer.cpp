@@ -19,7 +19,9 @@
 
 #include "FrameBuffer.h"
 
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 namespace oat {
 
@@ -30,10 +32,22 @@ FrameBuffer::FrameBuffer(const std::string &source_address,
     // Nothing
 }
 
+FrameBuffer::~FrameBuffer()
+{
+    stopSink();
+}
+
+FifoStats FrameBuffer::stats() const
+{
+    return buffer_ ? buffer_->stats() : FifoStats();
+}
+
 bool FrameBuffer::connectToNode()
 {
-    // Establish our a slot in the node
+    // Establish our a slot in the node. Buffered frames are not read until
+    // they are popped, so they are copied without passing through cache.
     source_.touch(source_address_);
+    source_.set_copy_hint(oat::CopyHint::STREAM);
 
     // Wait for sychronous start with sink when it binds the node
     if (source_.connect() != SourceState::CONNECTED)
@@ -42,19 +56,40 @@ bool FrameBuffer::connectToNode()
     // Get frame meta data to format sink
     auto param = source_.parameters();
 
+    // Frames in flight: those in the FIFO, the one being read from the
+    // SOURCE and the one being published. Pages are taken from the same huge
+    // page policy as frame nodes.
+    pool_.reset(new FramePool(depth_ + 2, param, MemoryPolicy::fromEnvironment()));
+
+    row_bytes_ = param.cols * CV_ELEM_SIZE(param.type);
+    buffer_.reset(new TokenFifo<size_t>(
+        depth_,
+        overflow_,
+        makeSpillFile(sizeof(oat::Sample) + param.rows * row_bytes_)));
+
     // Bind sink node
     sink_.bind(sink_address_, param.bytes);
     shared_frame_
         = sink_.retrieve(param.rows, param.cols, param.type, param.color);
 
+    if (pace_)
+        pacer_.set_period(std::chrono::duration<double>(
+            source_.retrieve()->sample().period_sec().count()));
+
     // Start consumer thread
     sink_thread_ = std::thread(&FrameBuffer::pop, this);
+    helper_thread_policy_.apply(sink_thread_, "sink");
 
     return true;
 }
 
 int FrameBuffer::process()
 {
+    // A pool frame is always free because the pool outnumbers the frames
+    // that can be in flight
+    if (!have_next_ && !pool_->acquire(next_))
+        throw std::runtime_error("Frame pool exhausted.");
+
     // START CRITICAL SECTION //
     ////////////////////////////
 
@@ -62,8 +97,7 @@ int FrameBuffer::process()
     if (source_.wait() == oat::NodeState::END)
         return 1;
 
-    if (!buffer_.push(source_.clone()))
-        std::cerr << "Buffer overrun.\n";
+    source_.copyTo(pool_->frame(next_));
 
     // Tell sink it can continue
     source_.post();
@@ -71,11 +105,16 @@ int FrameBuffer::process()
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
-    // Notify comsumer thread that it can proceed
-    cv_.notify_one();
+    // Whatever frame the FIFO does not keep is reused for the next read
+    have_next_ = false;
+    buffer_->push(next_,
+        [this](size_t index) { next_ = index; have_next_ = true; },
+        [this](size_t index, char *record) {
+            writeRecord(pool_->frame(index), record);
+        });
 
 #ifndef NDEBUG
-    showBufferState(buffer_, BUFFSIZE);
+    showBufferState(buffer_->occupancy(), depth_);
 #endif
 
     // Sink was not at END state
@@ -87,32 +126,56 @@ void FrameBuffer::pop()
     while (sink_running_) {
 
         // Proceed only if buffer_ has data
-        std::unique_lock<std::mutex> lk(cv_m_);
-        if  (cv_.wait_for(lk, msec(10)) == std::cv_status::timeout)
+        if (!buffer_->waitForToken(msec(10)))
             continue;
 
-        // Publish objects when they are requested until the buffer
-        // is empty
-        while (buffer_.read_available() > 0) {
+        // START CRITICAL SECTION //
+        ////////////////////////////
 
-            // START CRITICAL SECTION //
-            ////////////////////////////
+        // Wait for sources to read
+        sink_.wait();
 
-            // Wait for sources to read
-            sink_.wait();
+        size_t index;
+        bool pooled = false;
+        buffer_->pop(
+            [&](size_t i) { index = i; pooled = true; },
+            [this](const char *record) { readRecord(record, shared_frame_); });
 
-            // TODO: use specialized spsc allocator for popping somehow?
-            buffer_.consume_one(
-                [this](oat::Frame frame){ frame.copyTo(shared_frame_); }
-            );
+        if (pooled) {
+            pool_->frame(index).copyTo(shared_frame_);
+            pool_->release(index);
+        }
 
-            // Tell sources there is new data
-            sink_.post();
+        // Tell sources there is new data
+        sink_.post();
 
-            ////////////////////////////
-            //  END CRITICAL SECTION  //
-        }
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+        if (pace_)
+            pacer_.wait();
     }
 }
 
+void FrameBuffer::writeRecord(const oat::Frame &frame, char *record) const
+{
+    auto sample = frame.sample();
+    std::memcpy(record, &sample, sizeof(sample));
+    record += sizeof(sample);
+
+    for (int r = 0; r < frame.rows; r++)
+        std::memcpy(record + r * row_bytes_, frame.ptr(r), row_bytes_);
+}
+
+void FrameBuffer::readRecord(const char *record, oat::Frame &frame) const
+{
+    oat::Sample sample;
+    std::memcpy(&sample, record, sizeof(sample));
+    frame.set_sample(sample);
+    record += sizeof(sample);
+
+    for (int r = 0; r < frame.rows; r++)
+        std::memcpy(frame.ptr(r), record + r * row_bytes_, row_bytes_);
+}
+
 } /* namespace oat */
@@ -21,8 +21,9 @@
 #define	OAT_FRAME_BUFFER_H
 
 #include "Buffer.h"
+#include "FramePool.h"
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <memory>
 
 #include "../../lib/shmemdf/SharedFrameHeader.h"
 
@@ -30,9 +31,6 @@ namespace oat {
 
 class FrameBuffer : public Buffer {
 
-    using SPSCBuffer =
-        boost::lockfree::spsc_queue<oat::Frame, buffer_size_t>;
-
 public:
 
     /**
@@ -42,6 +40,9 @@ public:
      */
     FrameBuffer(const std::string &source_address,
                 const std::string &sink_address);
+    ~FrameBuffer();
+
+    FifoStats stats(void) const override;
 
 protected:
 
@@ -56,8 +57,19 @@ private:
     // Source
     oat::Source<oat::Frame> source_;
 
-    // Buffer
-    SPSCBuffer buffer_;
+    // Buffer of indices into pool_. Frames are copied into preallocated pool
+    // frames, so buffering does not allocate.
+    std::unique_ptr<FramePool> pool_;
+    std::unique_ptr<TokenFifo<size_t>> buffer_;
+
+    // Pool frame that the next SOURCE read is copied into
+    size_t next_ {0};
+    bool have_next_ {false};
+
+    // Spill records are the sample followed by packed pixels
+    size_t row_bytes_ {0};
+    void writeRecord(const oat::Frame &frame, char *record) const;
+    void readRecord(const char *record, oat::Frame &frame) const;
 
     // Sink
     oat::Frame shared_frame_;
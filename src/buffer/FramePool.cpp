@@ -0,0 +1,79 @@
+//******************************************************************************
+//* File:   FramePool.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "FramePool.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+
+namespace oat {
+
+FramePool::FramePool(const size_t capacity,
+                     const oat::FrameParams &params,
+                     const oat::MemoryPolicy &policy)
+: free_(capacity)
+{
+    if (capacity == 0)
+        throw std::runtime_error("Frame pool must hold at least one frame.");
+
+    // Keep each frame's data block aligned
+    const size_t row_bytes = params.cols * CV_ELEM_SIZE(params.type);
+    const size_t a = MemoryPolicy::DATA_ALIGNMENT;
+    const size_t block = (params.rows * row_bytes + a - 1) / a * a;
+
+    bytes_ = policy.segmentBytes(capacity * block);
+    data_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data_ == MAP_FAILED)
+        throw std::runtime_error("Could not map frame pool of "
+                                 + std::to_string(bytes_) + " bytes, "
+                                 + std::string(std::strerror(errno)) + ".");
+
+    try {
+        policy.apply(data_, bytes_);
+    } catch (...) {
+        munmap(data_, bytes_);
+        throw;
+    }
+
+    samples_.resize(capacity);
+    frames_.reserve(capacity);
+    for (size_t i = 0; i < capacity; i++) {
+        frames_.emplace_back(params.rows,
+                             params.cols,
+                             params.type,
+                             params.color,
+                             static_cast<char *>(data_) + i * block,
+                             &samples_[i],
+                             row_bytes);
+        free_.push(i);
+    }
+}
+
+FramePool::~FramePool()
+{
+    frames_.clear();
+    munmap(data_, bytes_);
+}
+
+} /* namespace oat */
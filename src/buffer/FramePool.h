@@ -0,0 +1,95 @@
+//******************************************************************************
+//* File:   FramePool.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_FRAMEPOOL_H
+#define	OAT_FRAMEPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/datatypes/Sample.h"
+#include "../../lib/shmemdf/MemoryPolicy.h"
+#include "../../lib/shmemdf/SharedFrameHeader.h"
+
+namespace oat {
+
+/**
+ * @brief Fixed set of preallocated frames shared by a producer and a consumer
+ * thread. Pixel data for every frame lives in a single anonymous mapping. It
+ * is reserved up front but only committed by the kernel when first written.
+ * The producer acquire()s a free frame and the consumer release()s it when
+ * done, so frames are recycled by index and are never reallocated.
+ */
+class FramePool {
+
+public:
+
+    /**
+     * @brief Create a pool.
+     * @param capacity Number of frames in the pool.
+     * @param params Layout of the frames. Rows are stored packed.
+     * @param policy Memory policy applied to the pool's mapping, e.g. to back
+     * it with huge pages.
+     */
+    FramePool(const size_t capacity,
+              const oat::FrameParams &params,
+              const oat::MemoryPolicy &policy);
+    ~FramePool();
+
+    // Pools cannot be copied
+    FramePool &operator=(const FramePool &) = delete;
+    FramePool(const FramePool &) = delete;
+
+    /**
+     * @brief Take a free frame. Producer only.
+     * @param index Index of the frame that was taken.
+     * @return False if every frame is in use.
+     */
+    bool acquire(size_t &index) { return free_.pop(index); }
+
+    /**
+     * @brief Return a frame to the pool. Consumer only.
+     * @param index Index of a frame obtained from acquire().
+     */
+    void release(const size_t index) { free_.push(index); }
+
+    /**
+     * @brief Number of free frames. Producer only.
+     */
+    size_t available(void) const { return free_.read_available(); }
+
+    oat::Frame &frame(const size_t index) { return frames_[index]; }
+    size_t capacity(void) const { return frames_.size(); }
+
+private:
+
+    void *data_ {nullptr};
+    size_t bytes_ {0};
+    std::vector<oat::Sample> samples_;
+    std::vector<oat::Frame> frames_;
+
+    // Indices of frames that are not in use
+    boost::lockfree::spsc_queue<size_t> free_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_FRAMEPOOL_H */
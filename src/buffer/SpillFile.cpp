@@ -0,0 +1,177 @@
+//******************************************************************************
+//* File:   SpillFile.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "SpillFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace oat {
+
+static std::runtime_error spillError(const std::string &what)
+{
+    return std::runtime_error("Could not " + what + " spill file, "
+                              + std::string(std::strerror(errno)) + ".");
+}
+
+SpillFile::SpillFile(const std::string &dir, const size_t record_bytes)
+: record_bytes_(record_bytes)
+{
+    if (record_bytes_ == 0)
+        throw std::runtime_error("Spill file records must not be empty.");
+
+    // Segments hold a whole number of records and start on page boundaries
+    const size_t page = sysconf(_SC_PAGESIZE);
+    segment_records_ = std::max<size_t>(1, SEGMENT_BYTES / record_bytes_);
+    segment_bytes_ = segment_records_ * record_bytes_;
+    segment_bytes_ = (segment_bytes_ + page - 1) / page * page;
+
+    std::string path = dir + "/oat-spill-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+
+    fd_ = mkstemp(name.data());
+    if (fd_ < 0)
+        throw std::runtime_error("Could not create spill file in " + dir
+                                 + ", " + std::strerror(errno) + ".");
+
+    // Keep the file open but nameless so that it is reclaimed on exit
+    unlink(name.data());
+}
+
+SpillFile::~SpillFile()
+{
+    unmap(write_window_);
+    unmap(read_window_);
+
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void SpillFile::write(const char *record)
+{
+    const uint64_t segment = written_ / segment_records_;
+    const size_t slot = written_ % segment_records_;
+
+    if (write_window_.data == nullptr || write_window_.segment != segment) {
+
+        // Start writeback of the segment just filled rather than letting
+        // its dirty pages build up in memory
+        if (write_window_.data != nullptr)
+            sync_file_range(fd_,
+                            write_window_.segment * segment_bytes_,
+                            segment_bytes_,
+                            SYNC_FILE_RANGE_WRITE);
+
+        unmap(write_window_);
+
+        // Grow the file before touching the new segment. Touching pages
+        // past the end of the file would raise SIGBUS.
+        if (ftruncate(fd_, (segment + 1) * segment_bytes_) != 0)
+            throw spillError("extend");
+
+        map(write_window_, segment);
+    }
+
+    std::memcpy(write_window_.data + slot * record_bytes_,
+                record,
+                record_bytes_);
+    written_++;
+}
+
+bool SpillFile::read(char *record)
+{
+    if (pending() == 0)
+        return false;
+
+    const uint64_t segment = read_ / segment_records_;
+    const size_t slot = read_ % segment_records_;
+
+    if (read_window_.data == nullptr || read_window_.segment != segment) {
+        if (read_window_.data != nullptr) {
+            unmap(read_window_);
+            release(read_window_.segment);
+        }
+        map(read_window_, segment);
+        madvise(read_window_.data, segment_bytes_, MADV_SEQUENTIAL);
+    }
+
+    std::memcpy(record,
+                read_window_.data + slot * record_bytes_,
+                record_bytes_);
+
+    // Drained, give the disk space back
+    if (++read_ == written_)
+        reset();
+
+    return true;
+}
+
+char *SpillFile::map(Window &w, const uint64_t segment)
+{
+    auto p = mmap(nullptr,
+                  segment_bytes_,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED,
+                  fd_,
+                  segment * segment_bytes_);
+
+    if (p == MAP_FAILED)
+        throw spillError("map");
+
+    w.data = static_cast<char *>(p);
+    w.segment = segment;
+    return w.data;
+}
+
+void SpillFile::unmap(Window &w)
+{
+    if (w.data != nullptr)
+        munmap(w.data, segment_bytes_);
+    w.data = nullptr;
+}
+
+void SpillFile::release(const uint64_t segment)
+{
+    // Best effort. Filesystems without hole punching keep the space until
+    // the file drains.
+    fallocate(fd_,
+              FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              segment * segment_bytes_,
+              segment_bytes_);
+}
+
+void SpillFile::reset()
+{
+    unmap(write_window_);
+    unmap(read_window_);
+    written_ = read_ = 0;
+
+    if (ftruncate(fd_, 0) != 0)
+        throw spillError("truncate");
+}
+
+} /* namespace oat */
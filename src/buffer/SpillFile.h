@@ -0,0 +1,98 @@
+//******************************************************************************
+//* File:   SpillFile.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_SPILLFILE_H
+#define	OAT_SPILLFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace oat {
+
+/**
+ * @brief Anonymous, append-only, on-disk FIFO of fixed-size records. The file
+ * is unlinked as soon as it is created, so it never outlives the process
+ * that made it. Not thread safe.
+ *
+ * The file is accessed through memory maps of one segment at a time, so
+ * appending or reading a record is a memcpy rather than a system call. Full
+ * segments are handed to the kernel for writeback straight away and read
+ * segments are punched out of the file, so neither dirty pages nor disk
+ * space accumulate behind the reader during a long backlog.
+ */
+class SpillFile {
+
+public:
+
+    // Approximate size of each mapped segment
+    static constexpr size_t SEGMENT_BYTES {64 << 20};
+
+    /**
+     * @brief Create a spill file.
+     * @param dir Directory to create the file in.
+     * @param record_bytes Size of each record in bytes.
+     */
+    SpillFile(const std::string &dir, const size_t record_bytes);
+    ~SpillFile();
+
+    // Spill files cannot be copied
+    SpillFile &operator=(const SpillFile &) = delete;
+    SpillFile(const SpillFile &) = delete;
+
+    /**
+     * @brief Append a record.
+     * @param record record_bytes() bytes to append.
+     */
+    void write(const char *record);
+
+    /**
+     * @brief Read the oldest record that has not been read. Once every record
+     * has been read, the file is truncated to give its space back.
+     * @param record Buffer of record_bytes() bytes to read into.
+     * @return False if there are no records to read.
+     */
+    bool read(char *record);
+
+    size_t pending(void) const { return written_ - read_; }
+    size_t record_bytes(void) const { return record_bytes_; }
+
+private:
+
+    // A mapped segment of the file
+    struct Window {
+        char *data {nullptr};
+        uint64_t segment {0};
+    };
+
+    int fd_ {-1};
+    size_t record_bytes_;
+    size_t segment_records_;
+    size_t segment_bytes_;
+    uint64_t written_ {0}, read_ {0};
+    Window write_window_, read_window_;
+
+    char *map(Window &w, const uint64_t segment);
+    void unmap(Window &w);
+    void release(const uint64_t segment);
+    void reset(void);
+};
+
+}      /* namespace oat */
+#endif /* OAT_SPILLFILE_H */
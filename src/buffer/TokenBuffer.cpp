@@ -18,12 +18,50 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #include "TokenBuffer.h"
 
 namespace oat {
 
+template <>
+struct SpillRecord<oat::Position2D> {
+
+    struct Layout {
+        oat::PositionRecord record;
+        oat::DistanceUnit unit;
+        double homography[9];
+    };
+
+    static constexpr size_t BYTES {sizeof(Layout)};
+
+    static void write(const oat::Position2D &p, char *bytes)
+    {
+        Layout l;
+        l.record = p.record();
+        l.unit = p.unit_of_length();
+        auto h = p.homography();
+        std::copy(h.val, h.val + 9, l.homography);
+        std::memcpy(bytes, &l, sizeof(l));
+    }
+
+    static oat::Position2D read(const char *bytes)
+    {
+        Layout l;
+        std::memcpy(&l, bytes, sizeof(l));
+
+        cv::Matx33d h;
+        std::copy(l.homography, l.homography + 9, h.val);
+
+        oat::Position2D p("");
+        p.set_record(l.record);
+        p.setCoordSystem(l.unit, h);
+        return p;
+    }
+};
+
 template <typename T>
 TokenBuffer<T>::TokenBuffer(const std::string &source_address,
                             const std::string &sink_address)
@@ -32,6 +70,18 @@ TokenBuffer<T>::TokenBuffer(const std::string &source_address,
     // Nothing
 }
 
+template <typename T>
+TokenBuffer<T>::~TokenBuffer()
+{
+    stopSink();
+}
+
+template <typename T>
+FifoStats TokenBuffer<T>::stats() const
+{
+    return buffer_ ? buffer_->stats() : FifoStats();
+}
+
 template <typename T>
 bool TokenBuffer<T>::connectToNode()
 {
@@ -42,11 +92,19 @@ bool TokenBuffer<T>::connectToNode()
     if (source_.connect() != SourceState::CONNECTED)
         return false;
 
-    sink_.bind(sink_address_, sink_address_);
-    shared_token_ = sink_.retrieve();
+    sink_.bind(sink_address_, sink_address_, num_buffers_);
+
+    buffer_.reset(new TokenFifo<T>(
+        depth_, overflow_, makeSpillFile(SpillRecord<T>::BYTES)));
+    batch_.reserve(batch_size_);
+
+    if (pace_)
+        pacer_.set_period(std::chrono::duration<double>(
+            source_.retrieve()->sample.period_sec().count()));
 
     // Start consumer thread
     sink_thread_ = std::thread(&TokenBuffer<T>::pop, this);
+    helper_thread_policy_.apply(sink_thread_, "sink");
 
     return true;
 }
@@ -61,8 +119,7 @@ int TokenBuffer<T>::process()
     if (source_.wait() == oat::NodeState::END)
         return 1;
 
-    if (!buffer_.push(source_.clone()))
-        std::cerr << "Buffer overrun.\n";
+    auto token = source_.clone();
 
     // Tell sink it can continue
     source_.post();
@@ -70,11 +127,10 @@ int TokenBuffer<T>::process()
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
-    // Notify comsumer thread that it can proceed
-    cv_.notify_one();
+    buffer_->push(token, [](const T &) { }, SpillRecord<T>::write);
 
 #ifndef NDEBUG
-    showBufferState(buffer_, BUFFSIZE);
+    showBufferState(buffer_->occupancy(), depth_);
 #endif
 
     // Sink was not at END state
@@ -87,13 +143,14 @@ void TokenBuffer<T>::pop()
     while (sink_running_) {
 
         // Proceed only if buffer_ has data
-        std::unique_lock<std::mutex> lk(cv_m_);
-        if  (cv_.wait_for(lk, msec(10)) == std::cv_status::timeout)
+        if (!buffer_->waitForToken(msec(10)))
             continue;
 
-        // Publish objects when they are requested until the buffer
-        // is empty
-        while (buffer_.read_available() > 0) {
+        // Take everything that has arrived, up to a batch, at once
+        batch_.clear();
+        buffer_->popBatch(batch_, batch_size_, SpillRecord<T>::read);
+
+        for (const auto &t : batch_) {
 
             // START CRITICAL SECTION //
             ////////////////////////////
@@ -101,13 +158,16 @@ void TokenBuffer<T>::pop()
             // Wait for sources to read
             sink_.wait();
 
-            buffer_.pop(*shared_token_);
+            sink_.write(t);
 
             // Tell sources there is new data
             sink_.post();
 
             ////////////////////////////
             //  END CRITICAL SECTION  //
+
+            if (pace_)
+                pacer_.wait();
         }
     }
 }
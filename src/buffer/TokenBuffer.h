@@ -22,25 +22,34 @@
 
 #include "Buffer.h"
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <memory>
+#include <vector>
 
 #include "../../lib/datatypes/Position2D.h"
 
 namespace oat {
 
+/**
+ * @brief Format of a token on disk when it is spilled. Specialized for each
+ * type of token that can be buffered, with BYTES, write(token, bytes) and
+ * read(bytes) members.
+ */
+template <typename T>
+struct SpillRecord;
+
 /**
  * Generic token buffer.
  */
 template <typename T>
 class TokenBuffer : public Buffer {
 
-    using SPSCBuffer =
-        boost::lockfree::spsc_queue<T, buffer_size_t>;
-
 public:
 
     TokenBuffer(const std::string &source_address,
                 const std::string &sink_address);
+    ~TokenBuffer();
+
+    FifoStats stats(void) const override;
 
 protected:
 
@@ -54,11 +63,11 @@ private:
     // Source
     oat::Source<T> source_;
 
-    // Buffer
-    SPSCBuffer buffer_;
+    // Buffer, and tokens drained from it on one wake up
+    std::unique_ptr<TokenFifo<T>> buffer_;
+    std::vector<T> batch_;
 
     // Sink
-    T * shared_token_;
     oat::Sink<T> sink_;
 };
 
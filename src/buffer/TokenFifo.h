@@ -0,0 +1,310 @@
+//******************************************************************************
+//* File:   TokenFifo.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_TOKENFIFO_H
+#define	OAT_TOKENFIFO_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+
+#include "../../lib/base/Globals.h"
+
+#include "EventCount.h"
+#include "SpillFile.h"
+
+namespace oat {
+
+/**
+ * What a FIFO does with a token that arrives when it is full.
+ */
+enum class OverflowPolicy {
+    BLOCK,       //!< Wait for the consumer to make room
+    DROP_OLDEST, //!< Discard the oldest token in the FIFO
+    DROP_NEWEST, //!< Discard the arriving token
+    SPILL        //!< Write tokens to disk until the FIFO drains
+};
+
+inline OverflowPolicy overflowPolicy(const std::string &name)
+{
+    if (name == "block")
+        return OverflowPolicy::BLOCK;
+    if (name == "drop-oldest")
+        return OverflowPolicy::DROP_OLDEST;
+    if (name == "drop-newest")
+        return OverflowPolicy::DROP_NEWEST;
+    if (name == "spill")
+        return OverflowPolicy::SPILL;
+
+    throw std::runtime_error("Invalid overflow policy '" + name + "'. Use "
+                             "block, drop-oldest, drop-newest or spill.");
+}
+
+/**
+ * FIFO occupancy metrics.
+ */
+struct FifoStats {
+    size_t depth {0};      //!< Tokens the FIFO holds in memory
+    size_t high_water {0}; //!< Most tokens held at once, including spilled ones
+    uint64_t pushed {0};   //!< Tokens offered to the FIFO
+    uint64_t dropped {0};  //!< Tokens discarded
+    uint64_t spilled {0};  //!< Tokens written to disk
+};
+
+/**
+ * @brief Bounded FIFO linking the source and sink threads of a buffer, with
+ * a selectable overflow policy. Only one thread may push() and only one
+ * other thread may pop().
+ *
+ * In SPILL mode, once a token has been spilled, arriving tokens go to disk
+ * until every spilled token has been read back, so tokens always leave in
+ * the order they arrived.
+ *
+ * The ring itself is guarded by a mutex, but the threads sleep and wake on
+ * eventcounts over atomic copies of its occupancy, so waiting for a token
+ * or for room never takes the lock and a push() only enters the kernel when
+ * the consumer is asleep.
+ */
+template <typename T>
+class TokenFifo {
+
+public:
+
+    /**
+     * @brief Create a FIFO.
+     * @param depth Number of tokens held in memory.
+     * @param policy Overflow policy.
+     * @param spill File to spill tokens to. Required in SPILL mode.
+     */
+    TokenFifo(const size_t depth,
+              const OverflowPolicy policy,
+              std::unique_ptr<SpillFile> spill = nullptr)
+    : ring_(depth)
+    , depth_(depth)
+    , policy_(policy)
+    , spill_(std::move(spill))
+    {
+        if (depth == 0)
+            throw std::runtime_error("Buffer depth must be at least 1.");
+        if (policy_ == OverflowPolicy::SPILL && !spill_)
+            throw std::runtime_error("Spilling requires a spill file.");
+
+        stats_.depth = depth;
+    }
+
+    /**
+     * @brief Append a token.
+     * @param token Token to append.
+     * @param release Called with any token that the FIFO does not keep: the
+     * evicted oldest token in DROP_OLDEST mode or the arriving token when it
+     * is dropped or spilled.
+     * @param record Called as record(token, bytes) to write a token to a
+     * spill record of SpillFile::record_bytes() bytes. Only used in SPILL
+     * mode.
+     */
+    template <typename Release, typename Record>
+    void push(const T &token, Release release, Record record)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        stats_.pushed++;
+
+        if (policy_ == OverflowPolicy::BLOCK) {
+            while (ring_.full() && !quit) {
+                lk.unlock();
+                not_full_.await([this] {
+                    return in_ring_.load(std::memory_order_acquire) < depth_;
+                }, WAIT_PERIOD);
+                lk.lock();
+            }
+        }
+
+        if (policy_ == OverflowPolicy::SPILL
+            && (ring_.full() || spill_->pending() > 0)) {
+
+            record_.resize(spill_->record_bytes());
+            record(token, record_.data());
+            spill_->write(record_.data());
+            stats_.spilled++;
+            release(token);
+
+        } else if (!ring_.full()) {
+            ring_.push_back(token);
+        } else if (policy_ == OverflowPolicy::DROP_OLDEST) {
+            // Evict the oldest token to make room
+            release(ring_.front());
+            ring_.pop_front();
+            ring_.push_back(token);
+            stats_.dropped++;
+        } else {
+            // Full, or blocking was interrupted by quit
+            release(token);
+            stats_.dropped++;
+        }
+
+        stats_.high_water = std::max(stats_.high_water, size());
+        publish();
+
+        lk.unlock();
+        not_empty_.notify();
+    }
+
+    /**
+     * @brief Wait for a token to be available. Tokens stay available until
+     * the consumer pop()s them.
+     * @param timeout Maximum wait.
+     * @return True if a token is available.
+     */
+    template <typename Duration>
+    bool waitForToken(const Duration timeout)
+    {
+        return not_empty_.await([this] {
+            return held_.load(std::memory_order_acquire) > 0;
+        }, timeout);
+    }
+
+    /**
+     * @brief Remove the oldest token.
+     * @param token Called as token(t) with the oldest token if it is held in
+     * memory.
+     * @param record Called as record(bytes) with the oldest token's spill
+     * record if it was spilled.
+     * @return False if the FIFO was empty.
+     */
+    template <typename Token, typename Record>
+    bool pop(Token token, Record record)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+
+        if (!ring_.empty()) {
+            token(ring_.front());
+            ring_.pop_front();
+        } else if (spill_ && spill_->pending() > 0) {
+            record_out_.resize(spill_->record_bytes());
+            spill_->read(record_out_.data());
+            publish();
+            lk.unlock();
+            not_full_.notify();
+            record(static_cast<const char *>(record_out_.data()));
+            return true;
+        } else {
+            return false;
+        }
+
+        publish();
+        lk.unlock();
+        not_full_.notify();
+        return true;
+    }
+
+    /**
+     * @brief Remove up to max of the oldest tokens at once, taking the lock
+     * once for all of them.
+     * @param batch Removed tokens are appended to it, oldest first.
+     * @param max Most tokens to remove.
+     * @param read Called as read(bytes) to turn a spill record back into a
+     * token.
+     * @return Number of tokens removed.
+     */
+    template <typename Read>
+    size_t popBatch(std::vector<T> &batch, const size_t max, Read read)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+
+        // Tokens in memory always arrived before any spilled ones
+        size_t n = 0;
+        for (; n < max && !ring_.empty(); n++) {
+            batch.push_back(ring_.front());
+            ring_.pop_front();
+        }
+
+        if (spill_) {
+            record_out_.resize(spill_->record_bytes());
+            for (; n < max && spill_->pending() > 0; n++) {
+                spill_->read(record_out_.data());
+                batch.push_back(
+                    read(static_cast<const char *>(record_out_.data())));
+            }
+        }
+
+        if (n == 0)
+            return 0;
+
+        publish();
+        lk.unlock();
+        not_full_.notify();
+        return n;
+    }
+
+    /**
+     * @brief Tokens held, including spilled ones.
+     */
+    size_t occupancy(void) const
+    {
+        return held_.load(std::memory_order_acquire);
+    }
+
+    FifoStats stats(void) const
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return stats_;
+    }
+
+private:
+
+    static constexpr std::chrono::milliseconds WAIT_PERIOD {10};
+
+    boost::circular_buffer<T> ring_;
+    const size_t depth_;
+    const OverflowPolicy policy_;
+    std::unique_ptr<SpillFile> spill_;
+    std::vector<char> record_, record_out_;
+    FifoStats stats_;
+
+    mutable std::mutex mutex_;
+    EventCount not_empty_, not_full_;
+
+    // Lock-free copies of the occupancy for waiting threads
+    std::atomic<size_t> in_ring_ {0}, held_ {0};
+
+    size_t size(void) const
+    {
+        return ring_.size() + (spill_ ? spill_->pending() : 0);
+    }
+
+    // Call with the lock held after changing the ring or spill file
+    void publish(void)
+    {
+        in_ring_.store(ring_.size(), std::memory_order_release);
+        held_.store(size(), std::memory_order_release);
+    }
+};
+
+template <typename T>
+constexpr std::chrono::milliseconds TokenFifo<T>::WAIT_PERIOD;
+
+}      /* namespace oat */
+#endif /* OAT_TOKENFIFO_H */
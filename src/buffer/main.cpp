@@ -170,6 +170,12 @@ int main(int argc, char *argv[])
                     return -1;
                 }
             }
+
+            // Specialize program options for the selected TYPE
+            po::options_description detail_opts {"CONFIGURATION"};
+            buffer->appendOptions(detail_opts);
+            visible_options.add(detail_opts);
+            options.add(detail_opts);
         }
 
         // Check INFO arguments
@@ -221,6 +227,8 @@ int main(int argc, char *argv[])
                  .run(), option_map);
         po::notify(option_map);
 
+        buffer->configure(option_map);
+
         // Tell user
         std::cout << oat::whoMessage(comp_name,
                 "Listening to source " + oat::sourceText(source) + ".\n")
@@ -232,8 +240,15 @@ int main(int argc, char *argv[])
         // Infinite loop until ctrl-c or end of stream signal
         buffer->run();
 
-        // Tell user
-        std::cout << oat::whoMessage(comp_name, "Exiting.")
+        // Tell user how full the FIFO got so that it can be sized
+        auto stats = buffer->stats();
+        std::cout << oat::whoMessage(comp_name,
+                "Peak occupancy " + std::to_string(stats.high_water)
+                + "/" + std::to_string(stats.depth) + " of "
+                + std::to_string(stats.pushed) + " tokens, "
+                + std::to_string(stats.dropped) + " dropped, "
+                + std::to_string(stats.spilled) + " spilled.\n")
+                  << oat::whoMessage(comp_name, "Exiting.")
                   << std::endl;
 
         // Exit success
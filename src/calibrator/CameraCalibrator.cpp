@@ -19,6 +19,7 @@
 
 //#include "OatConfig.h" // Generated by CMake
 
+#include <algorithm>
 #include <utility>
 #include <map>
 
@@ -70,6 +71,18 @@ CameraCalibrator::CameraCalibrator(const std::string &source_name) :
     std::cout << "Starting interactive session.\n";
 }
 
+CameraCalibrator::~CameraCalibrator()
+{
+    {
+        std::lock_guard<std::mutex> lock(detection_mutex_);
+        detectors_running_ = false;
+    }
+    detection_cv_.notify_all();
+
+    for (auto &d : detectors_)
+        d.join();
+}
+
 po::options_description CameraCalibrator::options() const
 {
     // Common program options
@@ -89,6 +102,14 @@ po::options_description CameraCalibrator::options() const
         "the horizontal and vertical demensions of the chessboard used for calibration.\n")
         ("square-width,w", po::value<double>(),
         "The length/width of a single chessboard square in meters.\n")
+        ("detection-width", po::value<int>(),
+        "Frames wider than this, in pixels, are downsampled to this width "
+        "to search for the chessboard. Corners are then refined at full "
+        "resolution. Defaults to 960.\n")
+        ("detection-threads", po::value<size_t>(),
+        "Number of threads searching frames for the chessboard, off the "
+        "frame loop. Frames arriving while all are busy are not searched. "
+        "Defaults to 2.\n")
         ;
 
     return local_opts;
@@ -109,6 +130,12 @@ void CameraCalibrator::applyConfiguration(
     oat::config::getNumericValue<double>(vm, config_table, "square-width",
                                          square_size_meters_, 0);
 
+    // Detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "detection-width", detection_width_, 16);
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "detection-threads", detection_threads_, 1);
+
     // Chessboard size
     std::vector<double> s;
     if (oat::config::getArray<double, 2>(vm, config_table, "chessboard-size", s, true)) {
@@ -142,6 +169,9 @@ void CameraCalibrator::calibrate(cv::Mat &frame)
     // yet known and therefore things like frame size are not known.
     frame_size_ = frame.size();
 
+    // Pick up a finished calibration solve
+    collectCalibration();
+
     if (mode_ == Mode::DETECT)
         detectChessboard(frame);
 
@@ -226,47 +256,116 @@ void CameraCalibrator::clearDataPoints()
 
 void CameraCalibrator::detectChessboard(cv::Mat &frame)
 {
-    // Extract the chessboard from the current image
-    std::vector<cv::Point2f> point_buffer;
-    bool detected =
-        cv::findChessboardCorners(frame, chessboard_size_, point_buffer,
-        cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_FAST_CHECK | cv::CALIB_CB_NORMALIZE_IMAGE);
+    if (detectors_.empty()) {
+        for (size_t i = 0; i < detection_threads_; i++)
+            detectors_.emplace_back([this] { runDetector(); });
+    }
+
+    Detection detection;
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> lock(detection_mutex_);
+
+        // Hand the frame to an idle worker, if there is one
+        if (detection_jobs_.size() + detections_running_ < detection_threads_) {
+            cv::Mat grey;
+            if (frame.channels() == 3)
+                cv::cvtColor(frame, grey, cv::COLOR_BGR2GRAY);
+            else
+                grey = frame.clone();
+            detection_jobs_.emplace_back(std::move(grey), tick_);
+            detection_cv_.notify_one();
+        }
+
+        detection = latest_detection_;
+        fresh = detection_ready_;
+        detection_ready_ = false;
+    }
 
-    // Draw corners on the frame
-    cv::drawChessboardCorners(frame, chessboard_size_, cv::Mat(point_buffer), detected);
+    // Draw the latest corners on the frame
+    cv::drawChessboardCorners(frame, chessboard_size_,
+                              cv::Mat(detection.corners), detection.detected);
 
     // Calculate elapsed time since last detection
-    if (detected) {
+    if (fresh && detection.detected) {
 
         Milliseconds elapsed_time =
-            std::chrono::duration_cast<Milliseconds>(tick_ - tock_);
+            std::chrono::duration_cast<Milliseconds>(detection.time - tock_);
 
         if (elapsed_time > min_detection_delay_) {
 
             std::cout << "Chessboard detected.\n";
 
             // Reset timer
-            tock_ = Clock::now();
+            tock_ = detection.time;
+
+            // Push the new corners into storage
+            corners_.push_back(detection.corners);
+
+            // Note visually that we have added new corners to our data set
+            cv::bitwise_not(frame, frame);
+        }
+    }
+}
+
+void CameraCalibrator::runDetector()
+{
+    // Subpixel corner location estimation termination criteria
+    // Max iterations = 30;
+    // Desired accuracy of pixel resolution = 0.1
+    const cv::TermCriteria term(
+            cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1);
 
-            // Subpixel corner location estimation termination criteria
-            // Max iterations = 30;
-            // Desired accuracy of pixel resolution = 0.1
-            cv::TermCriteria term(
-                    cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1);
+    cv::Mat small;
 
-            // Generate grey-scale image
-            cv::Mat frame_grey;
-            cv::cvtColor(frame, frame_grey, cv::COLOR_BGR2GRAY);
+    while (true) {
 
-            // Find exact corner locations
-            cv::cornerSubPix(frame_grey, point_buffer, cv::Size(11, 11),
+        cv::Mat grey;
+        Detection detection;
+        {
+            std::unique_lock<std::mutex> lock(detection_mutex_);
+            detection_cv_.wait(lock, [this] {
+                return !detectors_running_ || !detection_jobs_.empty();
+            });
+
+            if (!detectors_running_)
+                return;
+
+            grey = std::move(detection_jobs_.front().first);
+            detection.time = detection_jobs_.front().second;
+            detection_jobs_.pop_front();
+            detections_running_++;
+        }
+
+        // Search a downsampled copy for the chessboard
+        const double scale = std::min(1.0, detection_width_ / static_cast<double>(grey.cols));
+        if (scale < 1.0)
+            cv::resize(grey, small, cv::Size(), scale, scale, cv::INTER_AREA);
+        else
+            small = grey;
+
+        detection.detected =
+            cv::findChessboardCorners(small, chessboard_size_, detection.corners,
+            cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_FAST_CHECK | cv::CALIB_CB_NORMALIZE_IMAGE);
+
+        // Find exact corner locations at full resolution
+        if (detection.detected) {
+            for (auto &c : detection.corners)
+                c *= static_cast<float>(1.0 / scale);
+
+            cv::cornerSubPix(grey, detection.corners, cv::Size(11, 11),
                     cv::Size(-1, -1), term);
+        }
 
-            // Push the new corners into storage
-            corners_.push_back(point_buffer);
+        {
+            std::lock_guard<std::mutex> lock(detection_mutex_);
+            detections_running_--;
 
-            // Note visually that we have added new corners to our data set
-            cv::bitwise_not(frame, frame);
+            // Workers can finish out of order
+            if (detection.time >= latest_detection_.time) {
+                latest_detection_ = std::move(detection);
+                detection_ready_ = true;
+            }
         }
     }
 }
@@ -280,6 +379,12 @@ void CameraCalibrator::undistortFrame(cv::Mat &frame)
 
 void CameraCalibrator::generateCalibrationParameters()
 {
+    if (calibration_.valid()) {
+        std::cerr << oat::Error("Calibration parameters are already being "
+                                "generated.\n");
+        return;
+    }
+
     if (corners_.size() == 0) {
         std::cerr << oat::Error("At least one chessboard detection "
                                 "is needed to generate calibration "
@@ -295,11 +400,6 @@ void CameraCalibrator::generateCalibrationParameters()
     // Reset the calibration settings
     int calibration_flags = 0;
 
-    // Reinitialized the camera matrix and distortion coefficients
-    // with sizes required for pinhole model
-    camera_matrix_ = cv::Mat::eye(3, 3, CV_64F);
-    distortion_coefficients_ = cv::Mat::zeros(8, 1, CV_64F);
-
     // TODO: user options for the following
     // Fix the aspect ratio of the lens (ratio of lens focal lengths for each
     // dimension of its internal reference frame, fc(2)/fc(1) where fc =
@@ -315,15 +415,46 @@ void CameraCalibrator::generateCalibrationParameters()
     // frame : cc = [(nx-1)/2;(ny-1)/2)]
     // calibration_flags |= CALIB_FIX_PRINCIPAL_POINT
 
-    rms_error_ = cv::calibrateCamera(
-            object_points,
-            corners_,
-            frame_size_,
-            camera_matrix_,
-            distortion_coefficients_,
-            cv::noArray(),
-            cv::noArray(),
-            calibration_flags | cv::CALIB_FIX_K4 | cv::CALIB_FIX_K5);
+    // Solve on a copy of the data set, so the live feed keeps flowing
+    std::cout << "Generating calibration parameters.\n";
+    const auto corners = corners_;
+    const auto frame_size = frame_size_;
+    calibration_ = std::async(std::launch::async,
+        [object_points, corners, frame_size, calibration_flags] () {
+
+        Calibration c;
+
+        // Reinitialized the camera matrix and distortion coefficients
+        // with sizes required for pinhole model
+        c.camera_matrix = cv::Mat::eye(3, 3, CV_64F);
+        c.distortion_coefficients = cv::Mat::zeros(8, 1, CV_64F);
+
+        c.rms_error = cv::calibrateCamera(
+                object_points,
+                corners,
+                frame_size,
+                c.camera_matrix,
+                c.distortion_coefficients,
+                cv::noArray(),
+                cv::noArray(),
+                calibration_flags | cv::CALIB_FIX_K4 | cv::CALIB_FIX_K5);
+
+        return c;
+    });
+}
+
+void CameraCalibrator::collectCalibration()
+{
+    if (!calibration_.valid()
+        || calibration_.wait_for(std::chrono::seconds(0))
+           != std::future_status::ready)
+        return;
+
+    // Rethrows errors from the solve
+    Calibration c = calibration_.get();
+    camera_matrix_ = c.camera_matrix;
+    distortion_coefficients_ = c.distortion_coefficients;
+    rms_error_ = c.rms_error;
 
     calibration_valid_ =
             cv::checkRange(camera_matrix_) && cv::checkRange(distortion_coefficients_);
@@ -336,6 +467,8 @@ void CameraCalibrator::decorateFrame(cv::Mat &frame)
 {
     auto m_idx = static_cast<typename std::underlying_type<Mode>::type>(mode_);
     std::string mode_msg =  "Mode: " + mode_strings_[m_idx];
+    if (calibration_.valid())
+        mode_msg += " (calibrating)";
     cv::Size txt_size = cv::getTextSize(mode_msg, 1, 1, 1, 0);
     cv::Point mode_origin(frame.cols - txt_size.width - 10, frame.rows - 10);
     cv::putText(frame, mode_msg, mode_origin, 1, 1, cv::Scalar(0, 0, 255));
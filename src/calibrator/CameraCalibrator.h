@@ -21,8 +21,14 @@
 #define OAT_CAMERACALIBRATOR_H
 
 #include <chrono>
-#include <string>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 
@@ -53,6 +59,7 @@ public:
      * @param model Camera model used to generate camera matrix and distortion coefficients.
      */
     CameraCalibrator(const std::string &source_name);
+    ~CameraCalibrator();
 
     // Accept visitors
     void accept(CalibratorVisitor* visitor) override;
@@ -71,6 +78,7 @@ public:
     bool calibration_valid() const { return calibration_valid_; }
     cv::Mat camera_matrix() const { return camera_matrix_; }
     cv::Mat distortion_coefficients() const { return distortion_coefficients_; }
+    cv::Size frame_size() const { return frame_size_; }
 
 protected:
 
@@ -110,10 +118,39 @@ private:
     std::vector<std::vector<cv::Point2f>> corners_;
     std::vector<cv::Point3f> corners_meters_;
 
+    // Chessboard detection pool. Frames are handed to idle workers, and
+    // dropped if there are none, so detection never holds up the live feed.
+    // Workers search a copy downsampled to at most detection_width_ pixels
+    // wide, then refine corners at full resolution.
+    struct Detection {
+        bool detected {false};
+        std::vector<cv::Point2f> corners;
+        Clock::time_point time;
+    };
+    size_t detection_threads_ {2};
+    int detection_width_ {960};
+    std::vector<std::thread> detectors_;
+    std::mutex detection_mutex_;
+    std::condition_variable detection_cv_;
+    std::deque<std::pair<cv::Mat, Clock::time_point>> detection_jobs_;
+    size_t detections_running_ {0};
+    bool detectors_running_ {true};
+    Detection latest_detection_;
+    bool detection_ready_ {false};
+
+    // The calibration solve runs asynchronously
+    struct Calibration {
+        cv::Mat camera_matrix, distortion_coefficients;
+        double rms_error;
+    };
+    std::future<Calibration> calibration_;
+
     // Interactive session
     bool requireMode(const Mode&&, const Mode&&);
     void toggleMode(Mode);
     void detectChessboard(cv::Mat& frame);
+    void runDetector(void);
+    void collectCalibration(void);
     void undistortFrame(cv::Mat& frame);
     void decorateFrame(cv::Mat& frame);
     void printDataPoints(void);
@@ -23,11 +23,13 @@
 #include <stdexcept>
 
 #include <boost/filesystem.hpp>
+#include <opencv2/calib3d.hpp>
 #include <opencv2/core/mat.hpp>
 
 #include <cpptoml.h>
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/IOUtility.h"
+#include "../../lib/utility/RemapFile.h"
 
 #include "CameraCalibrator.h"
 #include "HomographyGenerator.h"
@@ -79,6 +81,28 @@ void Saver::visit(CameraCalibrator* cc) {
     camera->insert("camera-matrix", cam);
     camera->insert("distortion-coeffs", dc);
 
+    // Precomputed undistortion maps, so oat-framefilt undistort can start
+    // without computing them, saved next to the calibration file
+    auto size = cc->frame_size();
+    if (size.area() > 0) {
+
+        bfs::path cal_path(calibration_file_);
+        bfs::path map_path = bfs::absolute(cal_path).parent_path()
+                             / (cal_path.stem().string() + "-" + entry_key_ + ".remap");
+
+        try {
+            cv::Mat map1, map2;
+            cv::initUndistortRectifyMap(_cam, _dc, cv::Mat(), _cam, size,
+                                        CV_16SC2, map1, map2);
+            writeRemapFile(map_path.string(), map1, map2);
+            camera->insert("undistortion-maps",
+                           cpptoml::make_value<std::string>(map_path.string()));
+            std::cout << "Undistortion maps saved to " + map_path.string() + "\n";
+        } catch (const std::runtime_error& ex) {
+            std::cerr << oat::Error(std::string(ex.what()) + "\n");
+        }
+    }
+
     // Place camera table into main calibration file
     calibration->insert(entry_key_, camera);
 
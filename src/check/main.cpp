@@ -0,0 +1,346 @@
+//******************************************************************************
+//* File:   oat check main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../../lib/shmemdf/Helpers.h"
+#include "../../lib/utility/IOFormat.h"
+
+namespace po = boost::program_options;
+
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+void sigHandler(int) { oat::quit = 1; }
+
+void printUsage(po::options_description options) {
+    std::cout << "Usage: check [INFO]\n"
+              << "   or: check [CONFIGURATION]\n"
+              << "Verify the sample sequences of nodes of any type.\n"
+              << "Nodes are read in latest-value mode, so their sinks never "
+                 "wait for this\nprogram, and need not exist yet. For each "
+                 "node, it reports, once per period,\nthe write rate and the "
+                 "samples dropped per second, i.e. sample counts that\nwere "
+                 "skipped across consecutive writes, as well as any repeated "
+                 "or\nreordered sample counts. Exits with a non-zero status if "
+                 "any sequence was\nreordered or, if set, if any check failed.\n\n"
+              << options << "\n";
+}
+
+// Sample sequence statistics of a node, updated by its watcher thread
+struct Checked {
+
+    std::string name;
+
+    std::atomic<bool> connected {false}, ended {false};
+    std::atomic<uint64_t> reads {0}, writes {0}, drops {0}, repeats {0},
+                          reorders {0};
+
+    // Latest sample count, or -1 before the first read
+    std::atomic<int64_t> count {-1};
+
+    // Counts at the previous report
+    uint64_t last_writes {0}, last_drops {0}, last_reads {0};
+
+    /**
+     * Account for a read of the sample written by write number w. Sample
+     * counts should advance by exactly the number of writes since the last
+     * read.
+     */
+    void update(const uint64_t w, const uint64_t c)
+    {
+        if (reads++ > 0) {
+
+            const int64_t dw = w - last_write_;
+            const int64_t dc = static_cast<int64_t>(c) - static_cast<int64_t>(last_count_);
+
+            writes += dw;
+            if (dc > dw)
+                drops += dc - dw;
+            else if (dc < 0)
+                reorders++;
+            else if (dc < dw)
+                repeats += dw - dc;
+        }
+
+        last_write_ = w;
+        last_count_ = c;
+        count = c;
+    }
+
+private:
+    uint64_t last_write_ {0}, last_count_ {0};
+};
+
+/**
+ * Read every completed write of a node, until it ends or quit is set. Only
+ * the sample is copied, wherever the node's layout puts it.
+ */
+static void watch(Checked &c)
+{
+    try {
+
+        oat::GenericSource source;
+        source.touch(c.name, oat::SourceMode::LATEST);
+        if (source.connect() != oat::SourceState::CONNECTED) {
+            c.ended = true;
+            return;
+        }
+        c.connected = true;
+
+        while (!oat::quit) {
+
+            oat::NodeState state;
+            if (!source.tryWait(state)) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+
+            if (state == oat::NodeState::END) {
+                source.post();
+                break;
+            }
+
+            const auto count = source.sample().count();
+            c.update(source.latest_write_number(), count);
+            source.post();
+        }
+
+    } catch (const std::exception &ex) {
+        std::cerr << oat::Error(c.name + ": " + ex.what() + "\n");
+    }
+
+    c.ended = true;
+}
+
+int main(int argc, char *argv[]) {
+
+    std::vector<std::string> names;
+    double period_sec = 1.0;
+    int count = 0;
+    bool aligned = false;
+    int64_t max_skew = 2;
+    bool no_drops = false;
+
+    try {
+
+        po::options_description options("INFO");
+        options.add_options()
+            ("help", "Produce help message.")
+            ("version,v", "Print version information.")
+            ;
+
+        po::options_description config("CONFIGURATION");
+        config.add_options()
+            ("nodes", po::value< std::vector<std::string> >()->multitoken(),
+             "The names of the nodes to check, of any type. The type of each "
+             "is read from the node.")
+            ("frame-sources,s", po::value< std::vector<std::string> >()->multitoken(),
+             "The names of frame nodes to check. As nodes.")
+            ("position-sources,p", po::value< std::vector<std::string> >()->multitoken(),
+             "The names of position nodes to check. As nodes.")
+            ("aligned,a",
+             "If set, all nodes are expected to carry the same sample "
+             "sequence, e.g. the inputs and output of a position combiner or "
+             "other fan-in component. The spread of their latest sample counts "
+             "is then reported, and it is a failure if it exceeds max-skew.")
+            ("max-skew", po::value<int64_t>(&max_skew),
+             "Largest spread of latest sample counts between aligned nodes "
+             "that is not a failure. Nodes are read at slightly different "
+             "times, and rings let readers lag, so it is not 0. Defaults to "
+             "2.")
+            ("no-drops",
+             "If set, dropped samples are a failure. Leave unset for "
+             "pipelines that drop samples by design, e.g. ones with "
+             "decimating or latest-value components.")
+            ("period", po::value<double>(&period_sec),
+             "Report period in seconds. Defaults to 1.")
+            ("count,n", po::value<int>(&count),
+             "Exit after this many reports. Defaults to 0, which reports "
+             "until interrupted or until every node has ended.")
+            ;
+
+        po::options_description visible_options("OPTIONS");
+        visible_options.add(options).add(config);
+
+        po::variables_map variable_map;
+        po::store(po::command_line_parser(argc, argv)
+                .options(visible_options)
+                .run(),
+                variable_map);
+        po::notify(variable_map);
+
+        if (variable_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (variable_map.count("version")) {
+            std::cout << "Oat Check version "
+                      << Oat_VERSION_MAJOR
+                      << "."
+                      << Oat_VERSION_MINOR
+                      << "\n";
+            std::cout << "Written by Jonathan P. Newman in the MWL@MIT.\n";
+            std::cout << "Licensed under the GPL3.0.\n";
+            return 0;
+        }
+
+        for (const auto &key : {"nodes", "frame-sources", "position-sources"}) {
+            if (variable_map.count(key)) {
+                const auto &n = variable_map[key].as< std::vector<std::string> >();
+                names.insert(names.end(), n.begin(), n.end());
+            }
+        }
+
+        if (names.empty()) {
+            printUsage(visible_options);
+            std::cout << "Error: at least a single node must be specified. "
+                         "Exiting.\n";
+            return -1;
+        }
+
+        if (period_sec <= 0) {
+            std::cerr << oat::Error("Report period must be positive.\n");
+            return -1;
+        }
+
+        if (count < 0 || max_skew < 0) {
+            std::cerr << oat::Error("Report count and max-skew must be non-negative.\n");
+            return -1;
+        }
+
+        aligned = variable_map.count("aligned") > 0;
+        no_drops = variable_map.count("no-drops") > 0;
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    } catch (...) {
+        std::cerr << oat::Error("Exception of unknown type.\n");
+        return -1;
+    }
+
+    std::signal(SIGINT, sigHandler);
+
+    std::vector<std::unique_ptr<Checked>> checked;
+    std::vector<std::thread> watchers;
+    for (const auto &n : names) {
+        checked.emplace_back(new Checked);
+        checked.back()->name = n;
+    }
+    for (auto &c : checked)
+        watchers.emplace_back(watch, std::ref(*c));
+
+    // Aligned nodes are compared far more often than reports are printed
+    const auto poll = std::chrono::milliseconds(1);
+    const auto period = std::chrono::duration<double>(period_sec);
+    auto next_report = std::chrono::steady_clock::now() + period;
+
+    int64_t period_skew = 0;
+    bool failed = false;
+
+    for (int n = 0; !oat::quit && (count == 0 || n < count); ) {
+
+        std::this_thread::sleep_for(poll);
+
+        if (aligned) {
+            int64_t lo = -1, hi = -1;
+            for (auto &c : checked) {
+                const int64_t k = c->count;
+                if (k < 0 || c->ended)
+                    continue;
+                lo = lo < 0 ? k : std::min(lo, k);
+                hi = std::max(hi, k);
+            }
+            period_skew = std::max(period_skew, hi - lo);
+        }
+
+        if (std::chrono::steady_clock::now() < next_report)
+            continue;
+        next_report += std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(period);
+        n++;
+
+        std::printf("\n");
+        bool all_ended = true;
+        for (auto &c : checked) {
+
+            all_ended &= c->ended;
+            if (!c->connected) {
+                std::printf("%-16s (waiting for sink)\n", c->name.c_str());
+                continue;
+            }
+
+            const uint64_t writes = c->writes, drops = c->drops, reads = c->reads;
+            std::printf("%-16s %8.1f wr/s  %8.1f rd/s  %8.1f drops/s  "
+                        "%6llu repeats  %6llu reorders%s\n",
+                        c->name.c_str(),
+                        (writes - c->last_writes) / period_sec,
+                        (reads - c->last_reads) / period_sec,
+                        (drops - c->last_drops) / period_sec,
+                        static_cast<unsigned long long>(c->repeats),
+                        static_cast<unsigned long long>(c->reorders),
+                        c->ended ? "  (ended)" : "");
+
+            c->last_writes = writes;
+            c->last_drops = drops;
+            c->last_reads = reads;
+
+            failed |= c->reorders > 0 || (no_drops && drops > 0);
+        }
+
+        if (aligned) {
+            failed |= period_skew > max_skew;
+            std::printf("aligned          max count spread %lld%s\n",
+                        static_cast<long long>(period_skew),
+                        period_skew > max_skew ? "   <- misaligned" : "");
+            period_skew = 0;
+        }
+
+        std::fflush(stdout);
+
+        if (all_ended)
+            break;
+    }
+
+    // Watchers leave when their nodes end or on quit
+    oat::quit = 1;
+    for (auto &w : watchers)
+        w.join();
+
+    for (auto &c : checked)
+        failed |= c->reorders > 0 || (no_drops && c->drops > 0);
+
+    // Exit
+    return failed ? 1 : 0;
+}
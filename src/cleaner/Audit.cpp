@@ -0,0 +1,232 @@
+//******************************************************************************
+//* File:   Audit.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+
+#include "Audit.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../../lib/shmemdf/Segment.h"
+#include "../../lib/shmemdf/SharedFrameHeader.h"
+
+namespace oat {
+
+// Where POSIX shared memory objects are kept
+static const std::string SHM_DIR {"/dev/shm/"};
+
+// Segment name endings of nodes, and of earlier versions' segments
+static const std::string NODE_SUFFIX {"_node"};
+static const std::vector<std::string> LEGACY_SUFFIXES {"_obj", "_sh_mem"};
+
+// A frame node is oversized if it maps more than this many times what its
+// buffers need, and by more than a few huge pages of rounding
+static constexpr size_t OVERSIZE_RATIO {2};
+static constexpr size_t OVERSIZE_SLACK {4 << 20};
+
+static bool endsWith(const std::string &s, const std::string &suffix)
+{
+    return s.size() > suffix.size()
+           && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string humanBytes(const size_t bytes)
+{
+    char buf[32];
+    if (bytes < 1024 * 1024)
+        std::snprintf(buf, sizeof(buf), "%.1f KiB", bytes / 1024.0);
+    else if (bytes < 1024 * 1024 * 1024)
+        std::snprintf(buf, sizeof(buf), "%.1f MiB", bytes / 1048576.0);
+    else
+        std::snprintf(buf, sizeof(buf), "%.2f GiB", bytes / 1073741824.0);
+
+    return buf;
+}
+
+static const char *describe(const SegmentStatus status)
+{
+    switch (status) {
+        case SegmentStatus::OK: return "ok";
+        case SegmentStatus::OVERSIZED: return "oversized";
+        case SegmentStatus::STALE: return "stale";
+        case SegmentStatus::ORPHANED: return "orphaned";
+        case SegmentStatus::LEGACY: return "legacy";
+        case SegmentStatus::INVALID: return "invalid";
+        case SegmentStatus::MISSING: return "missing";
+    }
+
+    return "";
+}
+
+// Bytes the buffers of a frame node need for their current formats
+static size_t frameBytes(const SharedFrameHeader &frames, const size_t offset)
+{
+    size_t bytes = offset;
+    for (size_t i = 0; i < frames.num_buffers(); i++) {
+        const auto p = frames.params(i);
+        bytes += p.step > 0 ? p.rows * p.step : p.bytes;
+    }
+
+    return bytes;
+}
+
+std::vector<std::string> listSegments()
+{
+    std::vector<std::string> names;
+
+    DIR *dir = ::opendir(SHM_DIR.c_str());
+    if (dir == nullptr)
+        return names;
+
+    while (const dirent *e = ::readdir(dir)) {
+        const std::string name {e->d_name};
+        if (endsWith(name, NODE_SUFFIX)
+            || std::any_of(LEGACY_SUFFIXES.begin(), LEGACY_SUFFIXES.end(),
+                           [&name](const std::string &s) {
+                               return endsWith(name, s);
+                           }))
+            names.push_back(name);
+    }
+    ::closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+SegmentAudit audit(const std::string &segment)
+{
+    SegmentAudit a;
+    a.segment = segment;
+
+    // Memory is only taken by the pages that have been touched
+    struct stat st;
+    if (::stat((SHM_DIR + segment).c_str(), &st) != 0) {
+        a.status = SegmentStatus::MISSING;
+        return a;
+    }
+    a.mapped = static_cast<size_t>(st.st_size);
+    a.resident = static_cast<size_t>(st.st_blocks) * 512;
+
+    if (!endsWith(segment, NODE_SUFFIX)) {
+        a.status = SegmentStatus::LEGACY;
+        return a;
+    }
+
+    oat::Segment s;
+    const oat::Node *node {nullptr};
+    try {
+        node = s.observe(segment);
+    } catch (const std::exception &) {
+        node = nullptr;
+    }
+
+    if (node == nullptr)
+        return a;
+
+    const auto &h = s.info();
+    const bool claimed = h.sink_claimed != 0;
+    if (claimed)
+        a.sink_pid = h.sink_owner.pid;
+
+    // Slots may be released while they are being looked at
+    try {
+        for (size_t i = 0; i < node->max_sources(); i++) {
+            if (!node->slot_bound(i))
+                continue;
+            a.sources++;
+            if (node->owner(i).alive())
+                a.live_sources++;
+        }
+    } catch (const std::runtime_error &) {
+        // Counted so far
+    }
+
+    if (claimed && !h.sink_owner.alive()) {
+        a.status = SegmentStatus::STALE;
+        return a;
+    }
+
+    if (!claimed && a.live_sources == 0) {
+        a.status = SegmentStatus::ORPHANED;
+        return a;
+    }
+
+    a.status = SegmentStatus::OK;
+
+    // Frame nodes grow when their frames no longer fit, and keep the space
+    // they had before
+    if (node->sink_state() != NodeState::UNDEFINED
+        && s.holds<SharedFrameHeader>()) {
+
+        const auto &frames = *static_cast<const SharedFrameHeader *>(s.object());
+        if (!frames.on_device()) {
+            a.in_use = frameBytes(frames, h.payload_offset);
+            if (a.mapped > OVERSIZE_RATIO * a.in_use
+                && a.mapped - a.in_use > OVERSIZE_SLACK)
+                a.status = SegmentStatus::OVERSIZED;
+        }
+    }
+
+    return a;
+}
+
+void printAudit(std::ostream &out, const std::vector<SegmentAudit> &audits)
+{
+    size_t width = 8;
+    for (const auto &a : audits)
+        width = std::max(width, a.segment.size() + 2);
+
+    out << std::left << std::setw(width) << "SEGMENT"
+        << std::right << std::setw(12) << "MAPPED"
+        << std::setw(12) << "RESIDENT"
+        << std::setw(12) << "IN USE"
+        << std::setw(10) << "SOURCES"
+        << std::setw(10) << "SINK"
+        << "  STATUS\n";
+
+    size_t mapped = 0, resident = 0, removable = 0;
+    for (const auto &a : audits) {
+
+        out << std::left << std::setw(width) << a.segment
+            << std::right << std::setw(12) << humanBytes(a.mapped)
+            << std::setw(12) << humanBytes(a.resident)
+            << std::setw(12) << (a.in_use > 0 ? humanBytes(a.in_use) : "-")
+            << std::setw(10)
+            << (std::to_string(a.live_sources) + "/" + std::to_string(a.sources))
+            << std::setw(10)
+            << (a.sink_pid > 0 ? std::to_string(a.sink_pid) : "-")
+            << "  " << describe(a.status) << "\n";
+
+        mapped += a.mapped;
+        resident += a.resident;
+        removable += a.removable() ? a.resident : 0;
+    }
+
+    out << "\n" << audits.size() << " segment(s) map " << humanBytes(mapped)
+        << ", of which " << humanBytes(resident) << " is resident. "
+        << humanBytes(removable) << " is held by segments that oat clean "
+        << "--orphans would remove.\n";
+}
+
+} /* namespace oat */
@@ -0,0 +1,82 @@
+//******************************************************************************
+//* File:   Audit.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+
+#ifndef OAT_AUDIT_H
+#define	OAT_AUDIT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace oat {
+
+enum class SegmentStatus {
+    OK,        //!< In use
+    OVERSIZED, //!< Much larger than the frames it holds
+    STALE,     //!< Its SINK has exited without removing it
+    ORPHANED,  //!< Neither a SINK nor a live SOURCE holds it
+    LEGACY,    //!< Left behind by an older version of Oat
+    INVALID,   //!< Not an Oat node, or never fully made
+    MISSING    //!< Not in shared memory
+};
+
+/**
+ * @brief Memory held by a shared memory segment and the processes holding it.
+ */
+struct SegmentAudit {
+
+    std::string segment;    //!< Segment name, e.g. "raw_node"
+    size_t mapped {0};      //!< Size of the segment
+    size_t resident {0};    //!< Bytes of memory backing it
+    size_t in_use {0};      //!< Bytes a frame node's buffers need, or 0
+    size_t sources {0};     //!< Bound SOURCE slots
+    size_t live_sources {0};//!< Bound slots whose process is running
+    int32_t sink_pid {0};   //!< Process of the SINK, or 0 if unclaimed
+    SegmentStatus status {SegmentStatus::INVALID};
+
+    //! Safe to remove: nothing will use the segment again
+    bool removable(void) const
+    {
+        return status == SegmentStatus::STALE
+               || status == SegmentStatus::ORPHANED
+               || status == SegmentStatus::LEGACY;
+    }
+};
+
+/**
+ * @brief Names of the Oat segments in shared memory: node segments, and
+ * those left behind by older versions.
+ */
+std::vector<std::string> listSegments(void);
+
+/**
+ * @brief Observe a segment read-only and account for its memory.
+ * @param segment Segment name, e.g. "raw_node".
+ */
+SegmentAudit audit(const std::string &segment);
+
+/**
+ * @brief Print one line per audited segment, followed by their totals.
+ */
+void printAudit(std::ostream &out, const std::vector<SegmentAudit> &audits);
+
+}      /* namespace oat */
+#endif /* OAT_AUDIT_H */
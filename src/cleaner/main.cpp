@@ -25,15 +25,23 @@
 #include <boost/program_options.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
 
+#include "../../lib/shmemdf/PositionBus.h"
+#include "../../lib/shmemdf/Segment.h"
 #include "../../lib/utility/IOFormat.h"
 
+#include "Audit.h"
+
 namespace po = boost::program_options;
 namespace bip = boost::interprocess;
 
 void printUsage(po::options_description options) {
     std::cout << "Usage: clean [INFO]\n"
               << "   or: clean NAMES [CONFIGURATION]\n"
-              << "Deallocate the named shared memory segments specified by NAMES.\n\n"
+              << "   or: clean --report [NAMES]\n"
+              << "   or: clean --orphans [CONFIGURATION]\n"
+              << "Deallocate the named shared memory segments specified by NAMES.\n"
+              << "Or report the memory held by Oat segments, and remove those "
+                 "that no\ncomponent will use again.\n\n"
               << options << "\n";
 }
 
@@ -42,6 +50,8 @@ int main(int argc, char *argv[]) {
     std::vector<std::string> names;
     bool quiet = false;
     bool legacy = false;
+    bool report = false;
+    bool orphans = false;
 
     try {
 
@@ -55,6 +65,17 @@ int main(int argc, char *argv[]) {
         options.add_options()
             ("quiet,q", "Quiet mode. Prevent output text.")
             ("legacy,l", "Legacy mode. Append  \"_sh_mem\" to input NAMES before removing.")
+            ("report,r",
+             "List the Oat segments in shared memory, or the nodes of NAMES, "
+             "with their mapped and resident sizes, the bytes a frame node's "
+             "buffers need, live and bound SOURCEs, and SINK process. Flags "
+             "segments that are stale (their SINK exited), orphaned (no SINK "
+             "or live SOURCE holds them), left by older versions, or "
+             "oversized (mapping more than twice what their frames need). "
+             "Nothing is removed.")
+            ("orphans,o",
+             "Remove every segment that --report flags as stale, orphaned or "
+             "left by an older version, instead of NAMES.")
             ;
 
         po::options_description hidden("HIDDEN OPTIONS");
@@ -97,7 +118,10 @@ int main(int argc, char *argv[]) {
             return 0;
         }
 
-        if (!variable_map.count("names")) {
+        report = variable_map.count("report") > 0;
+        orphans = variable_map.count("orphans") > 0;
+
+        if (!variable_map.count("names") && !report && !orphans) {
             printUsage(visible_options);
             std::cout << "Error: at least a single NAME must be specified. Exiting.\n";
             return -1;
@@ -109,7 +133,8 @@ int main(int argc, char *argv[]) {
         if (variable_map.count("legacy"))
             legacy = true;
 
-        names = variable_map["names"].as< std::vector<std::string> >();
+        if (variable_map.count("names"))
+            names = variable_map["names"].as< std::vector<std::string> >();
 
     } catch (std::exception& e) {
         std::cerr << oat::Error(e.what()) << "\n";
@@ -119,6 +144,42 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
+    if (report) {
+
+        std::vector<std::string> segments;
+        for (const auto &name : names)
+            segments.push_back(name + "_node");
+        if (segments.empty())
+            segments = oat::listSegments();
+
+        std::vector<oat::SegmentAudit> audits;
+        for (const auto &s : segments)
+            audits.push_back(oat::audit(s));
+
+        oat::printAudit(std::cout, audits);
+        return 0;
+    }
+
+    if (orphans) {
+
+        for (const auto &s : oat::listSegments()) {
+
+            const auto a = oat::audit(s);
+            if (!a.removable())
+                continue;
+
+            const bool removed = a.status == oat::SegmentStatus::LEGACY
+                ? bip::shared_memory_object::remove(s.c_str())
+                : oat::Segment::remove(s);
+
+            if (removed && !quiet)
+                std::cout << "Removed \'" << s << "\', freeing "
+                          << a.resident / 1024 << " KiB of memory.\n";
+        }
+
+        return 0;
+    }
+
     for (auto &name : names) {
 
         // All servers (MatServer and SMServer) append "_sh_mem" to user-provided
@@ -139,10 +200,18 @@ int main(int argc, char *argv[]) {
 
             bool success {false};
 
-            if (bip::shared_memory_object::remove((name + "_node").c_str())) {
+            if (oat::Segment::remove(name + "_node")) {
+                success = true;
+            }
+
+            // Position bus of the same name
+            if (bip::shared_memory_object::remove(
+                    oat::PositionBus::segmentName(name).c_str())) {
                 success = true;
             }
 
+            // Left behind by versions that kept the shared object in a
+            // segment of its own
             if (bip::shared_memory_object::remove((name + "_obj").c_str())) {
                 success = true;
             }
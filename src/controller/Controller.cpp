@@ -32,6 +32,11 @@
 
 namespace oat {
 
+// Time without announcements after which a scan is complete, and the
+// longest a scan can take
+static constexpr long SCAN_QUIET_MS {150};
+static constexpr long SCAN_MAX_MS {1000};
+
 Controller::Controller(const char *endpoint)
 : ctx_(1)
 , router_(ctx_, ZMQ_ROUTER)
@@ -71,34 +76,86 @@ void Controller::send(const std::string &command, const Subs::size_type idx)
     }
 }
 
+size_t Controller::acknowledge(size_t expected)
+{
+    // Components reply as soon as they receive a scheduled command, so this
+    // only waits as long as a scan for ones that do not
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(SCAN_MAX_MS);
+
+    size_t replies {0}, acks {0};
+    while (replies < expected && clock::now() < deadline) {
+
+        zmq::pollitem_t p[] = {{router_, 0, ZMQ_POLLIN, 0}};
+        const auto remaining
+            = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock::now());
+        zmq::poll(&p[0], 1, remaining.count());
+
+        if (!(p[0].revents & ZMQ_POLLIN))
+            break;
+
+        std::string id, reply;
+        if (!recvReqEnvelope(&router_, id, reply)) {
+            std::cerr << oat::Warn("Bad receive") << "\n";
+            continue;
+        }
+
+        // Components that connect late announce themselves instead
+        if (!subscriptions_.count(id)
+            || (reply.compare(0, 4, "ack ") != 0
+                && reply.compare(0, 5, "nack ") != 0))
+            continue;
+
+        replies++;
+        const auto &name = subscriptions_.at(id).name;
+        if (reply[0] == 'a') {
+            acks++;
+            std::cout << name << ": " << reply.substr(4) << "\n";
+        } else {
+            std::cerr << oat::Warn(name + " refused: " + reply.substr(5))
+                      << "\n";
+        }
+    }
+
+    if (replies < expected)
+        std::cerr << oat::Warn(std::to_string(expected - replies)
+                               + " component(s) did not acknowledge the "
+                                 "command.") << "\n";
+
+    return acks;
+}
+
 void Controller::scan()
 {
     // Clear subscriptions in preparation for update
     subscriptions_.clear();
 
-    // Poll the socket and find all existing connections
-    int retries_left = 100;
-    while (true) {
+    // Components announce themselves once as soon as they connect, which
+    // they retry every 100 ms until this
+    // router is bound. Scanning ends once no announcement has arrived for
+    // a little longer than that.
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(SCAN_MAX_MS);
 
-        zmq::pollitem_t p[] = {{router_, 0, ZMQ_POLLIN, 0}};
-        zmq::poll(&p[0], 1, 10);
+    while (clock::now() < deadline) {
 
-        if (p[0].revents & ZMQ_POLLIN) {
+        zmq::pollitem_t p[] = {{router_, 0, ZMQ_POLLIN, 0}};
+        zmq::poll(&p[0], 1, SCAN_QUIET_MS);
 
-            std::string id, name;
-            if (!recvReqEnvelope(&router_, id, name)) {
-                std::cerr << oat::Warn("Bad receive") << "\n";
-                continue;
-            }
+        if (!(p[0].revents & ZMQ_POLLIN))
+            break;
 
-            if (addSubscriber(id, name)) {
-                std::cerr << oat::Warn("Invalid component: " + id + " " + name)
-                          << "\n";
-                continue;
-            }
+        std::string id, name;
+        if (!recvReqEnvelope(&router_, id, name)) {
+            std::cerr << oat::Warn("Bad receive") << "\n";
+            continue;
+        }
 
-        } else if (retries_left-- == 0) {
-            break;
+        if (addSubscriber(id, name)) {
+            std::cerr << oat::Warn("Invalid component: " + id + " " + name)
+                      << "\n";
+            continue;
         }
     }
 }
@@ -157,16 +214,19 @@ int Controller::addSubscriber(const std::string &id_string,
     assert(sub_info["name"].IsString());
     auto name = std::string(sub_info["name"].GetString());
 
-    // Get description and format
-    assert(sub_info.HasMember("commands"));
-    const rapidjson::Value &desc = sub_info["commands"];
-    assert(desc.IsObject());
-
+    // Get description and format. Components without commands of their own
+    // leave it out.
     oat::CommandDescription desc_map;
-    for (auto &d : desc.GetObject()) {
+    if (sub_info.HasMember("commands")) {
 
-        assert(d.value.IsString());
-        desc_map.emplace(d.name.GetString(), d.value.GetString());
+        const rapidjson::Value &desc = sub_info["commands"];
+        assert(desc.IsObject());
+
+        for (auto &d : desc.GetObject()) {
+
+            assert(d.value.IsString());
+            desc_map.emplace(d.name.GetString(), d.value.GetString());
+        }
     }
 
     // Add if this component is not already in hash
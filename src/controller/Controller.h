@@ -53,8 +53,8 @@ public:
     Controller(const char *endpoint);
 
     /**
-     * @brief Find out which clients are available on the socket. Update
-     * subscriptions_ hash.
+     * @brief Collect the announcements of components connecting to the
+     * socket. Update subscriptions_ hash.
      */
     void scan();
 
@@ -62,6 +62,16 @@ public:
     void send(const std::string &cmd, const Subs::size_type idx);
     void send(const std::string &cmd);
 
+    /**
+     * @brief Wait for the acknowledgements of a command scheduled with 'at
+     * SAMPLE COMMAND' and report which components will act on it.
+     * @param expected Number of components the command was sent to.
+     * @return Number of components that acknowledged the command.
+     */
+    size_t acknowledge(size_t expected);
+
+    Subs::size_type size(void) const { return subscriptions_.size(); }
+
     std::string list(void) const;
 
     int addSubscriber(const std::string &identity,
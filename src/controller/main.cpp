@@ -19,6 +19,7 @@
 
 #include "OatConfig.h" // Generated by CMake
 
+#include <cstdint>
 #include <iostream>
 
 #include <boost/program_options.hpp>
@@ -33,7 +34,7 @@ namespace po = boost::program_options;
 void printUsage(po::options_description options) {
     std::cout << "Usage: control [INFO]\n"
               << "   or: control ENDPOINT [INFO]\n"
-              << "   or: control ENDPOINT ID COMMAND\n"
+              << "   or: control ENDPOINT ID COMMAND [--at SAMPLE]\n"
               << "   or: control\n"
               << "Control running oat components.\n\n"
               << options << "\n";
@@ -52,6 +53,12 @@ int main(int argc, char *argv[]) {
             ("version,v", "Print version information.")
             ("list,l", "Print a list of controllable components, along with IDs " 
              "and valid commands, for the specified endpoint.")
+            ("at", po::value<uint64_t>(),
+             "Sample number at which components act on COMMAND, rather than "
+             "when they receive it, so that several components sent the same "
+             "command, e.g. recorders given ID 'all', act on the same sample. "
+             "Each component acknowledges the command, or refuses it if it "
+             "cannot be scheduled or the sample has already passed.")
             ;
 
         po::options_description hidden("HIDDEN OPTIONS");
@@ -65,7 +72,8 @@ int main(int argc, char *argv[]) {
              "ZMQ ROUTER socket that routes COMMANDs to running components "
              "using their ID.")
             ("id", po::value<std::string>(),
-            "The ID of the running component to send a command to.")
+            "The ID or index of the running component to send a command to, "
+            "or 'all' for every component.")
             ("command", po::value<std::string>(),
             "The COMMAND to send.")
             ;
@@ -128,13 +136,28 @@ int main(int argc, char *argv[]) {
             auto id = variable_map["id"].as<std::string>();
             auto command = variable_map["command"].as<std::string>();
             
+            // Scheduled commands are acknowledged by each target
+            size_t targets = 1;
+            const bool scheduled = variable_map.count("at") > 0;
+            if (scheduled) {
+                const auto sample = variable_map["at"].as<uint64_t>();
+                command = "at " + std::to_string(sample) + " " + command;
+            }
+
             oat::Controller ctrl(endpoint.c_str());
             ctrl.scan();
 
-            if (id[0] == 'O')
+            if (id == "all") {
+                ctrl.send(command);
+                targets = ctrl.size();
+            } else if (id[0] == 'O') {
                 ctrl.send(command, id);
-            else
+            } else {
                 ctrl.send(command, std::stoi(id));
+            }
+
+            if (scheduled && ctrl.acknowledge(targets) < targets)
+                return -1;
 
         } else {
 
@@ -17,6 +17,8 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //****************************************************************************
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <exception>
 #include <string>
@@ -24,9 +26,9 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <ctime>
-#include <cmath>
 
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/utility/Homography.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/make_unique.h"
@@ -35,6 +37,47 @@
 
 namespace oat {
 
+/**
+ * Overlay shape of a given kind and color, with unset text.
+ */
+static oat::OverlayShape makeShape(const oat::OverlayShape::Kind kind,
+                                   const cv::Scalar &color,
+                                   const int thickness,
+                                   const cv::Point2d &a,
+                                   const cv::Point2d &b)
+{
+    oat::OverlayShape s;
+    s.kind = kind;
+    for (int c = 0; c < 3; c++)
+        s.color[c] = cv::saturate_cast<uint8_t>(color[c]);
+    s.thickness = static_cast<int16_t>(thickness);
+    s.font = 0;
+    s.x0 = static_cast<float>(a.x);
+    s.y0 = static_cast<float>(a.y);
+    s.x1 = static_cast<float>(b.x);
+    s.y1 = static_cast<float>(b.y);
+    s.text[0] = '\0';
+
+    return s;
+}
+
+/**
+ * Append text drawn as cv::putText(frame, text, origin, 1, scale, color)
+ * would.
+ */
+static void pushText(oat::Overlay &overlay,
+                     const std::string &text,
+                     const cv::Point &origin,
+                     const double scale,
+                     const cv::Scalar &color)
+{
+    uint8_t bgr[3];
+    for (int c = 0; c < 3; c++)
+        bgr[c] = cv::saturate_cast<uint8_t>(color[c]);
+
+    overlay.pushText(text, origin.x, origin.y, bgr, 1, scale, 1);
+}
+
 Decorator::Decorator(const std::string &frame_source_address,
                      const std::string &frame_sink_address)
 : name_("decorator[" + frame_source_address+ "->" + frame_sink_address + "]")
@@ -57,7 +100,26 @@ po::options_description Decorator::options() const
         ("region,R", "Write region information on each frame "
         "if there is a position stream that contains it.\n")
         ("history,h", "Display position history.\n")
+        ("history-length", po::value<int>(),
+         "Maximum number of path segments, over all position SOURCEs, shown "
+         "when displaying position history. The oldest are dropped first. "
+         "Default is 1024.\n")
         ("invert-font,i", "Invert font color.\n")
+        ("overlay,o", "Publish the decorations to SINK as vector overlays, "
+         "instead of decorated copies of frames. Overlays are a few kB no "
+         "matter the frame size and can be composited by a viewer using its "
+         "overlay option.\n")
+        ("latest",
+         "Read SOURCEs in best-effort mode. Upstream components never wait "
+         "for the decorator, and frames and positions that arrive while it "
+         "is busy are dropped.\n")
+        ("budget", po::value<double>(),
+         "Time, in ms, that decorating a frame should take. When decoration "
+         "keeps taking longer, e.g. because the CPU is saturated, only every "
+         "second, fourth and then eighth frame is decorated and published, "
+         "and every frame again once decoration is well within budget. "
+         "Positions are still read for every frame. Defaults to 0, which "
+         "decorates every frame.\n")
         ;
 
     return local_opts;
@@ -106,10 +168,30 @@ void Decorator::applyConfiguration(const po::variables_map &vm,
     // Path history
     oat::config::getValue<bool>(vm, config_table, "history", show_position_history_);
 
+    // Path history length
+    int history_length;
+    if (oat::config::getNumericValue<int>(
+            vm, config_table, "history-length", history_length, 1))
+        history_length_ = history_length;
+
     // Invert font
     bool invert_font;
     if (oat::config::getValue<bool>(vm, config_table, "invert-font", invert_font))
         font_color_ = cv::Scalar(0,0,0);
+
+    // Overlay only
+    oat::config::getValue<bool>(vm, config_table, "overlay", overlay_only_);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+
+    // Decoration rate under load
+    double budget_ms {0.0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "budget", budget_ms, 0.0);
+    governor_.configure(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::duration<double, std::milli>(budget_ms)),
+                        3);
 }
 
 bool Decorator::connectToNode()
@@ -119,10 +201,11 @@ bool Decorator::connectToNode()
     std::vector<double> all_ts;
 
     // Establish our a slots in the frame and positions sources
-    frame_source_.touch(frame_source_address_);
+    const auto mode = latest_ ? SourceMode::LATEST : SourceMode::SYNC;
+    frame_source_.touch(frame_source_address_, mode);
 
     for (auto &ps : position_sources_)
-        ps.source->touch(ps.name);
+        ps.source->touch(ps.name, mode);
 
     // Wait for synchronous start with sink when it binds the node
     if (frame_source_.connect() != SourceState::CONNECTED)
@@ -130,17 +213,25 @@ bool Decorator::connectToNode()
 
     for (auto &ps : position_sources_) {
         ps.source->connect();
-        all_ts.push_back(ps.source->retrieve()->sample_period_sec());
+        all_ts.push_back(ps.source->retrieve()->sample.period_sec().count());
     }
 
     // Get frame meta data to format sink
     oat::Source<oat::Frame>::FrameParams param =
             frame_source_.parameters();
-
-    // Bind to sink sink node and create a shared frame
-    frame_sink_.bind(frame_sink_address_, param.bytes);
-    shared_frame_ = frame_sink_.retrieve(param.rows, param.cols, param.type, param.color);
-    all_ts.push_back(shared_frame_.sample_period_sec());
+    frame_rows_ = param.rows;
+    frame_cols_ = param.cols;
+
+    // Bind to sink sink node and create a shared frame, or publish overlays
+    // only
+    if (overlay_only_) {
+        overlay_sink_.bind(frame_sink_address_);
+        all_ts.push_back(frame_source_.retrieve()->sample_period_sec());
+    } else {
+        frame_sink_.bind(frame_sink_address_, param.bytes);
+        shared_frame_ = frame_sink_.retrieve(param.rows, param.cols, param.type, param.color);
+        all_ts.push_back(shared_frame_.sample_period_sec());
+    }
 
     if (!oat::checkSamplePeriods(all_ts, sample_rate_hz)) {
         std::cerr << oat::Warn(oat::inconsistentSampleRateWarning(sample_rate_hz));
@@ -153,13 +244,22 @@ bool Decorator::connectToNode()
     encode_bit_size_  =
         std::ceil(param.cols / 3 / sizeof(internal_frame_.sample_count()) / 8);
 
+    if (encode_sample_number_ && param.cols < 64 * encode_bit_size_)
+        throw std::runtime_error("Binary counter bar is too large for frame."
+                                 "Use more x-dim pixels or turn binary counter off.");
+
     // If we are drawing positions, get ready for that
     if (decorate_position_) {
-        previous_positions_.push_back(oat::Point2D(0,0));
-        positions_found_.push_back(false);
-        history_frame_ = cv::Mat::zeros(shared_frame_.size(), shared_frame_.type());
+        // Identity homographies are their own inverse
+        homographies_.assign(positions_.size(), cv::Matx33d::eye());
+        inverse_homographies_.assign(positions_.size(), cv::Matx33d::eye());
     }
 
+    // Region text layout does not change
+    int baseline = 0;
+    region_text_height_ = cv::getTextSize(
+        "Regions:", font_type_, font_scale_, font_thickness_, &baseline).height;
+
     return true;
 }
 
@@ -173,40 +273,79 @@ int Decorator::process()
     if (frame_source_.wait() == oat::NodeState::END)
         return 1;
 
-    // Clone the shared frame
-    frame_source_.copyTo(internal_frame_);
+    // Skipped frames are released without waiting on SINK, but their
+    // positions are still read so that SOURCEs stay in step
+    const uint64_t period_mask = (1ULL << governor_.level()) - 1;
+    if ((frames_++ & period_mask) != 0) {
 
-    // Tell sink it can continue
-    frame_source_.post();
+        frame_source_.post();
 
-    ////////////////////////////
-    //  END CRITICAL SECTION  //
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
 
-    // 2. Get positions
-    for (pvec_size_t i = 0; i !=  position_sources_.size(); i++) {
+        const auto state = oat::waitAll(position_sources_, positions_);
+        return state == oat::NodeState::END ? 1 : 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (overlay_only_) {
+
+        // Only the sample is needed, pixels are left alone
+        const oat::Sample sample = frame_source_.sample();
+
+        // Tell sink it can continue
+        frame_source_.post();
 
-        // START CRITICAL SECTION //
         ////////////////////////////
-        if (position_sources_[i].source->wait() == oat::NodeState::END)
+        //  END CRITICAL SECTION  //
+
+        // 2. Get positions
+        if (oat::waitAll(position_sources_, positions_) == oat::NodeState::END)
             return 1;
 
-        positions_[i] = position_sources_[i].source->clone();
+        buildOverlay(sample);
 
-        position_sources_[i].source->post();
+        // 3. Publish overlay
+        // START CRITICAL SECTION //
+        ////////////////////////////
+        overlay_sink_.wait();
+        *overlay_sink_.retrieve() = overlay_;
+        overlay_sink_.post();
         ////////////////////////////
         //  END CRITICAL SECTION  //
-    }
 
-    // Decorate frame
-    drawOnFrame();
+        govern(start);
 
-    // START CRITICAL SECTION //
-    ////////////////////////////
+        return 0;
+    }
 
     // Wait for sources to read
     frame_sink_.wait();
+    start = std::chrono::steady_clock::now();
 
-    internal_frame_.copyTo(shared_frame_);
+    // Copy the frame straight into the sink's shared frame and decorate it
+    // there
+    internal_frame_ = frame_sink_.borrow();
+    frame_source_.copyTo(internal_frame_);
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // 2. Get positions
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (oat::waitAll(position_sources_, positions_) == oat::NodeState::END)
+        return 1;
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Decorate frame
+    buildOverlay(internal_frame_.sample());
+    renderer_.render(overlay_, internal_frame_);
 
     // Tell sources there is new data
     frame_sink_.post();
@@ -214,10 +353,25 @@ int Decorator::process()
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
+    govern(start);
+
     // None of the sink's were at the END state
     return 0;
 }
 
+void Decorator::govern(const std::chrono::steady_clock::time_point &start)
+{
+    if (!governor_.enabled())
+        return;
+
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Counting starts over so that the next frame is decorated
+    if (governor_.record(ns))
+        frames_ = 0;
+}
+
 oat::CommandDescription Decorator::commands() 
 {
     const oat::CommandDescription commands{
@@ -230,13 +384,20 @@ oat::CommandDescription Decorator::commands()
 void Decorator::applyCommand(const std::string &command)
 {
     const auto cmds = commands();
-    if (cmds.at(command) == "clear") {
-        history_frame_ = cv::Scalar::all(0);
-    }
+    if (cmds.at(command) == "clear")
+        history_epoch_++;
 }
 
-void Decorator::drawOnFrame()
+void Decorator::buildOverlay(const oat::Sample &sample)
 {
+    overlay_.clear();
+    overlay_.set_sample(sample);
+
+    // Commands arrive on the control thread. History is cleared by whoever
+    // renders the overlay.
+    overlay_.history_epoch = history_epoch_;
+    overlay_.history_length = history_length_;
+
     if (decorate_position_) {
 
         drawPosition();
@@ -252,44 +413,31 @@ void Decorator::drawOnFrame()
         printSampleNumber();
 
     if (encode_sample_number_)
-        encodeSampleNumber();
+        overlay_.encode_bit_size = encode_bit_size_;
 }
 
-void Decorator::invertHomography(oat::Position2D &p)
+void Decorator::invertHomography(oat::Position2D &p, const size_t idx)
 {
     if (p.position_valid) {
 
-        cv::Matx33d inv_homo = p.homography().inv();
+        const cv::Matx33d homography = p.homography();
+        if (homography != homographies_[idx]) {
+            homographies_[idx] = homography;
+            inverse_homographies_[idx] = homography.inv();
+        }
 
-        std::vector<oat::Point2D> in_positions;
-        std::vector<oat::Point2D> out_positions;
-        in_positions.push_back(p.position);
-        cv::perspectiveTransform(in_positions, out_positions, inv_homo);
-        p.position = out_positions[0];
+        const cv::Matx33d &inv_homo = inverse_homographies_[idx];
 
-        if (p.velocity_valid) {
+        p.position = oat::transformPoint(inv_homo, p.position);
 
-            std::vector<oat::Velocity2D> in_velocities;
-            std::vector<oat::Velocity2D> out_velocities;
-            cv::Matx33d vel_inv_homo = inv_homo;
-            vel_inv_homo(0, 2) = 0.0; // offsets do not apply to velocity
-            vel_inv_homo(1, 2) = 0.0; // offsets do not apply to velocity
-            in_velocities.push_back(p.velocity);
-            cv::perspectiveTransform(in_velocities, out_velocities, vel_inv_homo);
-            p.velocity = out_velocities[0];
-        }
+        // Offsets do not apply to velocity or heading
+        if (p.velocity_valid)
+            p.velocity = oat::transformPoint(inv_homo, p.velocity, false);
 
         if (p.heading_valid) {
-
-            std::vector<oat::UnitVector2D> in_heading;
-            std::vector<oat::UnitVector2D> out_heading;
-            cv::Matx33d head_inv_homo = inv_homo;
-            head_inv_homo(0, 2) = 0.0; // offsets do not apply to heading
-            head_inv_homo(1, 2) = 0.0; // offsets do not apply to heading
-            in_heading.push_back(p.heading);
-            cv::perspectiveTransform(in_heading, out_heading, head_inv_homo);
-            cv::normalize(out_heading, out_heading);
-            p.heading = out_heading[0];
+            const cv::Point2d h = oat::transformPoint(inv_homo, p.heading, false);
+            const double n = std::sqrt(h.dot(h));
+            p.heading = n > 0.0 ? h * (1.0 / n) : h;
         }
     }
 }
@@ -298,84 +446,46 @@ void Decorator::drawPosition()
 {
     size_t i = 0;
 
-    cv::Mat symbol_frame =
-        cv::Mat::zeros(internal_frame_.size(), internal_frame_.type());
-
     for (auto &p : positions_) {
 
         if (p.unit_of_length() == oat::DistanceUnit::WORLD)
-            invertHomography(p);
+            invertHomography(p, i);
 
         if (p.position_valid) {
 
-            cv::circle(symbol_frame,
-                       p.position,
-                       position_circle_radius_,
-                       pos_colors_[i],
-                       line_thickness_);
-
-            if (show_position_history_ && positions_found_[i]) {
-
-                cv::line(history_frame_,
-                         p.position,
-                         previous_positions_[i],
-                         pos_colors_[i],1);
-            }
-
-            previous_positions_[i] = p.position;
-
-            if (p.velocity_valid) {
-
-                cv::Point2d end =
-                    p.position + (velocity_scale_factor_ * p.velocity);
-                cv::line(symbol_frame,
-                         p.position,
-                         end,
-                         pos_colors_[i],
-                         line_thickness_);
-            }
-
-            if (p.heading_valid) {
-
-                cv::Point2d start =
-                    p.position - (heading_line_length_ * p.heading);
-                cv::Point2d end =
-                    p.position + (1.5 * heading_line_length_ * p.heading);
-
-                cv::arrowedLine(symbol_frame,
-                                start,
-                                end,
-                                font_color_,
-                                line_thickness_);
-            }
-
-            positions_found_[i] = true;
-        } else {
-            positions_found_[i] = false;
+            overlay_.push(makeShape(oat::OverlayShape::CIRCLE,
+                                    pos_colors_[i],
+                                    line_thickness_,
+                                    p.position,
+                                    cv::Point2d(position_circle_radius_, 0)));
+
+            // The renderer joins this to the path's previous point
+            if (show_position_history_)
+                overlay_.push(makeShape(oat::OverlayShape::HISTORY,
+                                        pos_colors_[i],
+                                        1,
+                                        p.position,
+                                        cv::Point2d(i, 0)));
+
+            if (p.velocity_valid)
+                overlay_.push(makeShape(
+                    oat::OverlayShape::LINE,
+                    pos_colors_[i],
+                    line_thickness_,
+                    p.position,
+                    p.position + (velocity_scale_factor_ * p.velocity)));
+
+            if (p.heading_valid)
+                overlay_.push(makeShape(
+                    oat::OverlayShape::ARROW,
+                    font_color_,
+                    line_thickness_,
+                    p.position - (heading_line_length_ * p.heading),
+                    p.position + (1.5 * heading_line_length_ * p.heading)));
         }
 
         (i > position_sources_.size() - 1) ? i = 0 : i++;
     }
-
-    // TODO: Following is inefficient and it shows in the performance testing
-    if (show_position_history_)
-        symbol_frame += history_frame_;
-
-    cv::Mat result_frame =
-        cv::Mat::zeros(internal_frame_.size(), internal_frame_.type());
-    cv::addWeighted(internal_frame_,
-                    1 - symbol_alpha_,
-                    symbol_frame,
-                    symbol_alpha_,
-                    0.0,
-                    result_frame);
-
-    cv::Mat mask;
-    const cv::Scalar zero(0);
-    cv::inRange(symbol_frame, zero, zero, mask);
-    internal_frame_.setTo(zero, mask == 0);
-    result_frame.setTo(zero, mask);
-    internal_frame_ += result_frame;
 }
 
 void Decorator::printRegion()
@@ -388,13 +498,9 @@ void Decorator::printRegion()
     else
         reg_text = "Regions:";
 
-    // Calculate text origin based upon message size
-    int baseline = 0;
-    cv::Size reg_text_size =
-            cv::getTextSize(reg_text, font_type_, font_scale_, font_thickness_, &baseline);
-
-    cv::Point text_origin(10, reg_text_size.height);
-    cv::putText(internal_frame_, reg_text, text_origin, font_thickness_, font_scale_, font_color_);
+    // Text origin is based upon message size
+    cv::Point text_origin(10, region_text_height_);
+    pushText(overlay_, reg_text, text_origin, font_scale_, font_color_);
 
     // Add ID: region information
     size_t i = 0;
@@ -404,12 +510,8 @@ void Decorator::printRegion()
         else
             reg_text = ps.name + ": ?";
 
-        text_origin.y += reg_text_size.height + 2;
-        cv::putText(internal_frame_,
-                    reg_text, text_origin,
-                    font_thickness_,
-                    font_scale_,
-                    pos_colors_[i]);
+        text_origin.y += region_text_height_ + 2;
+        pushText(overlay_, reg_text, text_origin, font_scale_, pos_colors_[i]);
 
         (i > position_sources_.size() - 1) ? i = 0 : i++;
     }
@@ -426,48 +528,18 @@ void Decorator::printTimeStamp()
 
     std::strftime(buffer, 80, "%c", time_info);
 
-    cv::Point text_origin(internal_frame_.cols - 230, internal_frame_.rows - 10);
-    cv::putText(internal_frame_, std::string(buffer), text_origin, 1, font_scale_, font_color_);
+    cv::Point text_origin(frame_cols_ - 230, frame_rows_ - 10);
+    pushText(overlay_, std::string(buffer), text_origin, font_scale_, font_color_);
 }
 
 void Decorator::printSampleNumber()
 {
-    cv::Point text_origin(10, internal_frame_.rows - 10);
-    cv::putText(internal_frame_,
-                std::to_string(internal_frame_.sample_count()),
-                text_origin,
-                1,
-                font_scale_,
-                font_color_);
-}
-
-void Decorator::encodeSampleNumber()
-{
-    uint64_t sample_count = internal_frame_.sample_count();
-    int column = internal_frame_.cols - 64 * encode_bit_size_;
-
-    if (column < 0)
-        throw std::runtime_error("Binary counter bar is too large for frame."
-                                 "Use more x-dim pixels or turn binary counter off.");
-
-    for (int shift = 0; shift < 64; shift++) {
-
-        cv::Mat sub_square = internal_frame_.colRange(column, column + encode_bit_size_).rowRange(0, encode_bit_size_);
-
-        if (sample_count & 0x1) {
-
-            cv::Mat true_mat(encode_bit_size_, encode_bit_size_, internal_frame_.type(), CV_RGB(255, 255, 255));
-            true_mat.copyTo(sub_square);
-
-        } else {
-
-            cv::Mat false_mat = cv::Mat::zeros(encode_bit_size_, encode_bit_size_, internal_frame_.type());
-            false_mat.copyTo(sub_square);
-        }
-
-        sample_count >>= 1;
-        column += encode_bit_size_;
-    }
+    cv::Point text_origin(10, frame_rows_ - 10);
+    pushText(overlay_,
+             std::to_string(overlay_.sample_count()),
+             text_origin,
+             font_scale_,
+             font_color_);
 }
 
 } /* namespace oat */
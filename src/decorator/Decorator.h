@@ -20,6 +20,8 @@
 #ifndef OAT_DECORATOR_H
 #define OAT_DECORATOR_H
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -27,12 +29,15 @@
 #include <zmq.hpp>
 
 #include "../../lib/base/Configurable.h"
+#include "../../lib/base/Governor.h"
 #include "../../lib/base/ControllableComponent.h"
 #include "../../lib/datatypes/Frame.h"
+#include "../../lib/datatypes/Overlay.h"
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/shmemdf/Helpers.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
+#include "../../lib/utility/OverlayRenderer.h"
 
 namespace po = boost::program_options;
 
@@ -48,10 +53,11 @@ public:
 
     /**
      * Frame decorator.
-     * Adds positional, sample, and date information to frames.
+     * Adds positional, sample, and date information to frames, or publishes
+     * it as an oat::Overlay to be composited by a viewer.
      * @param position_source_addresses SOURCE addresses
      * @param frame_source_address Frame SOURCE address
-     * @param frame_sink_address Decorated frame SINK address
+     * @param frame_sink_address Decorated frame or overlay SINK address
      */
     Decorator(const std::string &frame_source_address,
               const std::string &frame_sink_address);
@@ -89,6 +95,27 @@ private:
     std::string frame_sink_address_;
     oat::Sink<oat::Frame> frame_sink_;
 
+    // Publish overlays to SINK instead of decorated frames
+    bool overlay_only_ {false};
+
+    // Read SOURCEs in LATEST mode so they never wait for the decorator
+    bool latest_ {false};
+    oat::Sink<oat::Overlay> overlay_sink_;
+
+    // Under load, only every 2^level-th frame is decorated and published
+    oat::Governor governor_;
+    uint64_t frames_ {0};
+
+    /**
+     * Record the time spent decorating a frame.
+     * @param start Time decoration started
+     */
+    void govern(const std::chrono::steady_clock::time_point &start);
+
+    // Decoration of the current frame
+    oat::Overlay overlay_;
+    int frame_rows_ {0}, frame_cols_ {0};
+
     // Positions to be added to the image stream
     std::vector<oat::Position2D> positions_;
     oat::NamedSourceList<oat::Position2D> position_sources_;
@@ -107,9 +134,8 @@ private:
     double position_circle_radius_ {2.0};
     double heading_line_length_ {8.0};
     bool show_position_history_ {false};
-    std::vector<bool> positions_found_;
-    std::vector<oat::Point2D> previous_positions_;
-    cv::Mat history_frame_;
+    std::atomic<uint32_t> history_epoch_ {0};
+    uint32_t history_length_ {1024};
     const double symbol_alpha_ {0.4};
     const cv::Scalar pos_colors_[12] {CV_RGB(255,  51,  51),
                                       CV_RGB( 51, 255,  51),
@@ -134,20 +160,30 @@ private:
     // Sample number encoding
     int encode_bit_size_ {5};
 
+    // Per-source homography and its inverse, recomputed only when a source's
+    // homography changes
+    std::vector<cv::Matx33d> homographies_, inverse_homographies_;
+
+    // Draws overlays onto decorated frames
+    oat::OverlayRenderer renderer_ {symbol_alpha_};
+
+    // Height of a line of region text
+    int region_text_height_ {0};
+
     /**
      * Project Positions into oat::PIXEL coordinates.
      * @param pos Position with unit_of_length != oat::PIXEL to be converted to
      * unit_of_length == oat::PIXEL.
+     * @param idx Index of the position's SOURCE
      */
-    void invertHomography(oat::Position2D &pos);
+    void invertHomography(oat::Position2D &pos, const size_t idx);
 
-    // Frame mutating subroutines
+    // Overlay building subroutines
+    void buildOverlay(const oat::Sample &sample);
     void drawPosition(void);
     void printRegion(void);
-    void drawOnFrame(void);
     void printTimeStamp(void);
     void printSampleNumber(void);
-    void encodeSampleNumber(void);
 };
 
 }      /* namespace oat */
@@ -41,13 +41,14 @@ void printUsage(po::options_description options) {
     std::cout << "Usage: decorate [INFO]\n"
               << "   or: decorate SOURCE SINK [CONFIGURATION]\n"
               << "Decorate the frames from SOURCE, e.g. with object position "
-              << "markers and sample number. Publish decorated frames to SINK.\n\n"
+              << "markers and sample number. Publish decorated frames, or "
+              << "overlays, to SINK.\n\n"
               << "SOURCE:\n"
               << "  User-supplied name of the memory segment from which frames "
               << "are received (e.g. raw).\n\n"
               << "SINK:\n"
-              << "  User-supplied name of the memory segment to publish frames "
-              << "to (e.g. out).\n"
+              << "  User-supplied name of the memory segment to publish frames, "
+              << "or overlays, to (e.g. out).\n"
               << options << "\n";
 }
 
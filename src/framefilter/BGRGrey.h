@@ -0,0 +1,42 @@
+//******************************************************************************
+//* File:   BGRGrey.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_BGRGREY_H
+#define	OAT_BGRGREY_H
+
+#include <cstdint>
+
+namespace oat {
+
+// cv::COLOR_BGR2GRAY fixed point coefficients
+static constexpr int B2Y {1868}, G2Y {9617}, R2Y {4899}, Y_SHIFT {14};
+
+/**
+ * @brief Intensity of a BGR pixel, rounded exactly as cv::cvtColor does for
+ * 8-bit frames.
+ * @param p Pointer to the blue component of the pixel.
+ */
+inline int bgrToGrey(const uint8_t *p)
+{
+    return (p[0] * B2Y + p[1] * G2Y + p[2] * R2Y + (1 << (Y_SHIFT - 1)))
+           >> Y_SHIFT;
+}
+
+}      /* namespace oat */
+#endif /* OAT_BGRGREY_H */
@@ -19,12 +19,19 @@
 
 #include "BackgroundSubtractor.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <iostream>
 #include <cpptoml.h>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#ifdef HAVE_CUDA
+ #include <opencv2/cudaarithm.hpp>
+#endif
 
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ProgramOptions.h"
@@ -37,7 +44,13 @@ BackgroundSubtractor::BackgroundSubtractor(
             const std::string &frame_sink_address)
 : FrameFilter(frame_source_address, frame_sink_address)
 {
-    // Nothing
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
+
+#ifdef HAVE_CUDA
+    // Frames can be exchanged with other GPU filters in device memory
+    device_filter_ = true;
+#endif
 }
 
 po::options_description BackgroundSubtractor::options() const
@@ -52,6 +65,12 @@ po::options_description BackgroundSubtractor::options() const
         ("background,f", po::value<std::string>(),
          "Path to background image used for subtraction. If not provided, the "
          "first frame is used as the background image.")
+#ifdef HAVE_CUDA
+        ("device-frames",
+         "If true, keep frames published to SINK in GPU memory, so that "
+         "downstream GPU filters can read them without host copies. Only "
+         "GPU filters can then read from SINK.")
+#endif
         ;
 
     return local_opts;
@@ -70,33 +89,76 @@ void BackgroundSubtractor::applyConfiguration(const po::variables_map &vm,
         if (background_frame_.data == nullptr)
             throw (std::runtime_error("File \"" + img_path + "\" could not be read."));
 
-        background_set_ = true;
+        setBackgroundImage(background_frame_);
     }
 
     // Adaptation coefficient
     oat::config::getNumericValue<double>(vm, config_table, "adaptation-coeff", alpha_, 0.0, 1.0);
+
+#ifdef HAVE_CUDA
+    // Device memory sink
+    oat::config::getValue<bool>(vm, config_table, "device-frames", device_frames_);
+#endif
 }
 
 void BackgroundSubtractor::setBackgroundImage(const cv::Mat &frame)
 {
+    if (frame.depth() != CV_8U && frame.depth() != CV_16U)
+        throw std::runtime_error("Background subtraction requires frames of "
+                                 "8 or 16 bit depth.");
+
     background_frame_ = frame.clone();
-    frame.clone().convertTo(background_frame_f_, CV_32F);
+    average_ = oat::RunningAverage();
     background_set_ = true;
 }
 
 void BackgroundSubtractor::filter(cv::Mat &frame)
+{
+    filterInto(frame, frame);
+}
+
+void BackgroundSubtractor::filterInto(const cv::Mat &in, cv::Mat &out)
 {
     // First image is always used as the default background image if one is
     // not provided in a configuration file
     if (!background_set_)
-        setBackgroundImage(frame);
+        setBackgroundImage(in);
+
+    if (alpha_ == 0.0) {
+        cv::subtract(in, background_frame_, out);
+        return;
+    }
+
+    // Seeded here because the background can be set before alpha_
+    if (average_.empty())
+        average_.reset(background_frame_, alpha_);
+    average_.subtract(in, out);
+}
+
+#ifdef HAVE_CUDA
+void BackgroundSubtractor::filterDevice(const cv::cuda::GpuMat &in,
+                                        cv::cuda::GpuMat &out)
+{
+    if (gpu_background_.empty()) {
+        if (background_set_)
+            gpu_background_.upload(background_frame_);
+        else
+            in.copyTo(gpu_background_);
+        gpu_background_.convertTo(gpu_background_f_, CV_32F);
+        background_set_ = true;
+    }
 
+    // Running average, as cv::accumulateWeighted
     if (alpha_ > 0.0) {
-       cv::accumulateWeighted(frame, background_frame_f_, alpha_);
-       background_frame_f_.convertTo(background_frame_, CV_8U);
+        in.convertTo(gpu_frame_f_, CV_32F);
+        cv::cuda::addWeighted(gpu_frame_f_, alpha_,
+                              gpu_background_f_, 1.0 - alpha_,
+                              0.0, gpu_background_f_);
+        gpu_background_f_.convertTo(gpu_background_, in.depth());
     }
 
-    frame = frame - background_frame_;
+    cv::cuda::subtract(in, gpu_background_, out);
 }
+#endif
 
 } /* namespace oat */
@@ -21,6 +21,7 @@
 #define	OAT_BACKGROUNDSUBTRACTOR_H
 
 #include "FrameFilter.h"
+#include "RunningAverage.h"
 
 namespace oat {
 
@@ -47,9 +48,9 @@ private:
     // Is the background frame set?
     bool background_set_ {false};
 
-    // The background frame(s)
+    // The background frame, and the adaptive background seeded from it
     cv::Mat background_frame_;
-    cv::Mat background_frame_f_;
+    oat::RunningAverage average_;
 
     // Background update rate
     double alpha_ {0.0};
@@ -61,6 +62,27 @@ private:
      */
     void filter(cv::Mat &frame) override;
 
+    /**
+     * Apply background subtraction without modifying the input.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+#ifdef HAVE_CUDA
+    /**
+     * Apply background subtraction in device memory.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterDevice(const cv::cuda::GpuMat &in,
+                      cv::cuda::GpuMat &out) override;
+
+    // The background frame(s) in device memory, uploaded or taken from the
+    // first frame
+    cv::cuda::GpuMat gpu_background_, gpu_background_f_, gpu_frame_f_;
+#endif
+
     // Set the background frame
     void setBackgroundImage(const cv::Mat&);
 };
@@ -21,10 +21,12 @@
 
 #include "BackgroundSubtractorMOG.h"
 
+#include <algorithm>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/cvconfig.h>
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/video/background_segm.hpp>
 #include <stdexcept>
 #include <string>
@@ -40,12 +42,21 @@
 
 namespace oat {
 
+#ifndef HAVE_CUDA
+// Rows of each band's model. Several bands per thread keep the work of a
+// frame balanced.
+static constexpr int BAND_ROWS {64};
+#endif
+
 BackgroundSubtractorMOG::BackgroundSubtractorMOG(
         const std::string &frame_source_address,
         const std::string &frame_sink_address)
 : FrameFilter(frame_source_address, frame_sink_address)
 {
-    // Nothing
+#ifdef HAVE_CUDA
+    // Frames can be exchanged with other GPU filters in device memory
+    device_filter_ = true;
+#endif
 }
 
 po::options_description BackgroundSubtractorMOG::options() const
@@ -60,6 +71,17 @@ po::options_description BackgroundSubtractorMOG::options() const
 #ifdef HAVE_CUDA
         ("gpu-index", po::value<size_t>(),
          "Index of GPU card to use for performing MOG segmentation.")
+        ("device-frames",
+         "If true, keep frames published to SINK in GPU memory, so that "
+         "downstream GPU filters can read them without host copies. Only "
+         "GPU filters can then read from SINK.")
+#else
+        ("model-scale", po::value<int>(),
+         "Factor, 1, 2 or 4, by which frames are area-averaged before being "
+         "segmented, with the foreground mask scaled back up to the frame. "
+         "The model holds 1/scale^2 of the pixels, so segmenting and "
+         "updating it costs as much less, at the cost of foreground edges "
+         "this many pixels coarse. Defaults to 1.")
 #endif
         ;
 
@@ -78,9 +100,15 @@ void BackgroundSubtractorMOG::applyConfiguration(const po::variables_map &vm,
     configureGPU(index);
     background_subtractor_
         = cv::cuda::createBackgroundSubtractorMOG(/*TODO: defaults OK?*/);
+
+    // Device memory sink
+    oat::config::getValue<bool>(vm, config_table, "device-frames", device_frames_);
 #else
-    background_subtractor_
-        = cv::createBackgroundSubtractorMOG2(/*TODO:defaults OK?*/);
+    // Model resolution
+    oat::config::getNumericValue<int>(
+        vm, config_table, "model-scale", model_scale_, 1, 4);
+    if (model_scale_ == 3)
+        throw std::runtime_error("Model scale must be 1, 2 or 4.");
 #endif
 
     // Learning coefficient
@@ -114,16 +142,72 @@ void BackgroundSubtractorMOG::configureGPU(size_t index)
 void BackgroundSubtractorMOG::filter(cv::Mat &frame)
 {
 #ifdef HAVE_CUDA
-    current_frame_.upload(frame);
-    background_subtractor_->apply(current_frame_, background_mask_, learning_coeff_);
-    //TODO: Add hard mask operation here to increase performance
-    cv::cuda::bitwise_not(background_mask_, background_mask_);
-    current_frame_.setTo(0, background_mask_);
-    current_frame_.download(frame);
+    filterDevice(mapped_.in(frame, current_frame_), filtered_frame_);
+    filtered_frame_.download(frame);
 #else
-    background_subtractor_->apply(frame, background_mask_, learning_coeff_);
-    frame.setTo(0, background_mask_ == 0);
+    if (frame.size() != frame_size_)
+        makeBands(frame.size());
+
+    // Bands are segmented and updated on the threads of this component. Masks
+    // and scaled frames are kept from frame to frame.
+    cv::parallel_for_(cv::Range(0, static_cast<int>(bands_.size())),
+                      [&](const cv::Range &r) {
+
+        for (int i = r.start; i < r.end; i++) {
+
+            auto &b = bands_[i];
+            const int y0 = i * BAND_ROWS;
+            cv::Mat rows
+                = frame.rowRange(y0, std::min(frame.rows, y0 + BAND_ROWS));
+
+            if (model_scale_ > 1) {
+                cv::resize(rows, b.small, b.small_size, 0, 0, cv::INTER_AREA);
+                b.model->apply(b.small, b.small_mask, learning_coeff_);
+                cv::resize(b.small_mask, b.mask, rows.size(), 0, 0,
+                           cv::INTER_NEAREST);
+            } else {
+                b.model->apply(rows, b.mask, learning_coeff_);
+            }
+
+            // Shadows, marked 127, are kept along with the foreground
+            cv::compare(b.mask, 0, b.background, cv::CMP_EQ);
+            rows.setTo(0, b.background);
+        }
+    });
+#endif
+}
+
+#ifndef HAVE_CUDA
+void BackgroundSubtractorMOG::makeBands(const cv::Size &size)
+{
+    bands_.clear();
+    bands_.resize((size.height + BAND_ROWS - 1) / BAND_ROWS);
+
+    for (size_t i = 0; i < bands_.size(); i++) {
+
+        auto &b = bands_[i];
+        const int rows
+            = std::min(size.height - static_cast<int>(i) * BAND_ROWS, BAND_ROWS);
+
+        b.model = cv::createBackgroundSubtractorMOG2();
+        b.small_size = cv::Size((size.width + model_scale_ - 1) / model_scale_,
+                                (rows + model_scale_ - 1) / model_scale_);
+    }
+
+    frame_size_ = size;
+}
 #endif
+
+#ifdef HAVE_CUDA
+void BackgroundSubtractorMOG::filterDevice(const cv::cuda::GpuMat &in,
+                                           cv::cuda::GpuMat &out)
+{
+    // Keep foreground pixels only
+    background_subtractor_->apply(in, foreground_mask_, learning_coeff_);
+    out.create(in.size(), in.type());
+    out.setTo(cv::Scalar::all(0));
+    in.copyTo(out, foreground_mask_);
 }
+#endif
 
 } /* namespace oat */
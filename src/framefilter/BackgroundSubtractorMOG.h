@@ -28,6 +28,8 @@
  #include <opencv2/video.hpp>
 #endif
 
+#include <vector>
+
 #include "FrameFilter.h"
 
 namespace oat {
@@ -59,6 +61,13 @@ private:
     void filter(cv::Mat &frame) override;
 
 #ifdef HAVE_CUDA
+    /**
+     * Apply background subtraction in device memory.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterDevice(const cv::cuda::GpuMat &in,
+                      cv::cuda::GpuMat &out) override;
 
      /**
      * Configure the GPU to perform background subtraction.
@@ -67,10 +76,29 @@ private:
     void configureGPU(size_t index_);
 
     cv::Ptr<cv::cuda::BackgroundSubtractorMOG> background_subtractor_;
-    cv::cuda::GpuMat current_frame_, background_mask_;
+    cv::cuda::GpuMat current_frame_, filtered_frame_, foreground_mask_;
+    oat::MappedFrames mapped_;
 #else
-    cv::Ptr<cv::BackgroundSubtractorMOG2> background_subtractor_;
-    cv::Mat background_mask_;
+    // Band of frame rows with a background model of its own. Pixels are
+    // modelled independently, so bands are segmented in parallel with the
+    // same result as one model of the whole frame.
+    struct Band {
+        cv::Ptr<cv::BackgroundSubtractorMOG2> model;
+        cv::Size small_size;
+        cv::Mat small, small_mask, mask, background;
+    };
+    std::vector<Band> bands_;
+    cv::Size frame_size_;
+
+    // Frames are area-averaged by this factor before reaching the model,
+    // and the foreground mask is scaled back up
+    int model_scale_ {1};
+
+    /**
+     * (Re)create a model per band for frames of a new size.
+     * @param size Size of frames from SOURCE.
+     */
+    void makeBands(const cv::Size &size);
 #endif
 
     double learning_coeff_ {0.0};
@@ -19,21 +19,30 @@
 
 #include "ColorConvert.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <string>
+#include <vector>
 
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ProgramOptions.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
+#include "BGRGrey.h"
+
 namespace oat {
 
+// Rows per band processed by each thread when a preview is published
+static constexpr int BAND_ROWS {32};
+
 ColorConvert::ColorConvert(const std::string &frame_source_address,
                            const std::string &frame_sink_address)
 : FrameFilter(frame_source_address, frame_sink_address)
 {
-    // Nothing
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
 }
 
 po::options_description ColorConvert::options() const
@@ -46,6 +55,15 @@ po::options_description ColorConvert::options() const
          "  GREY: \t 8-bit Greyscale image.\n"
          "  BRG: \t8-bit, 3-chanel, BGR Color image.\n"
          "  HSV: \t8-bit, 3-chanel, HSV Color image.\n")
+        ("preview", po::value<std::string>(),
+         "Address of a second SINK that also receives a GREY copy of each "
+         "frame, downscaled by preview-scale. It is computed in the same pass "
+         "as the conversion, for detectors that only need a coarse, single "
+         "channel image. SOURCE must be GREY or BGR.")
+        ("preview-scale", po::value<int>(),
+         "Integer factor, 2 or more, by which the preview is downscaled. Each "
+         "preview pixel is the mean of a preview-scale x preview-scale square "
+         "of pixels. Default is 2.")
         ;
 
     return local_opts;
@@ -60,44 +78,154 @@ void ColorConvert::applyConfiguration(const po::variables_map &vm,
             vm, config_table, "color", col, true)) {
         color_ = oat::str_color(col);
     }
+
+    // Preview sink
+    oat::config::getValue<std::string>(
+        vm, config_table, "preview", preview_address_);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "preview-scale", preview_scale_, 2);
 }
 
-bool ColorConvert::connectToNode()
+oat::FrameParams ColorConvert::outputParameters(const oat::FrameParams &in)
 {
-    // Establish our a slot in the source node
-    frame_source_.touch(frame_source_address_);
-
-    // Wait for synchronous start with sink when it binds its node
-    if (frame_source_.connect() != SourceState::CONNECTED)
-        return false;
-
-    // Get frame meta data to format sink
-    auto frame_parameters = frame_source_.parameters();
-
     // Get the color conversion code
-    conversion_code_ = oat::color_conv_code(frame_parameters.color, color_);
+    conversion_code_ = oat::color_conv_code(in.color, color_);
 
     // If there is no conversion being done, throw
     if (conversion_code_ == -1) {
-        throw std::runtime_error("Nothing to be done for " + color_str(frame_parameters.color)
+        throw std::runtime_error("Nothing to be done for " + color_str(in.color)
                                  + " to "
                                  + color_str(color_)
                                  + " conversion.");
     }
 
-    // Bind to sink node and create a shared frame
     // Because this changes the color, it might change the size and type of
     // frame
-    size_t bytes = frame_parameters.rows * frame_parameters.cols
-                   * oat::color_bytes(color_);
-    frame_sink_.bind(frame_sink_address_, bytes);
-    shared_frame_ = frame_sink_.retrieve(frame_parameters.rows,
-                                         frame_parameters.cols,
-                                         oat::cv_type(color_),
-                                         color_);
+    auto out = in;
+    out.type = oat::cv_type(color_);
+    out.color = color_;
+    return out;
+}
+
+bool ColorConvert::connectToNode()
+{
+    if (!FrameFilter::connectToNode())
+        return false;
+
+    if (!preview_address_.empty()) {
+
+        auto frame_parameters = frame_source_.parameters();
+        if (frame_parameters.color != PIX_GREY
+            && frame_parameters.color != PIX_BGR)
+            throw std::runtime_error("A preview requires GREY or BGR frames "
+                                     "from SOURCE.");
+
+        const size_t rows = frame_parameters.rows / preview_scale_;
+        const size_t cols = frame_parameters.cols / preview_scale_;
+        if (rows == 0 || cols == 0)
+            throw std::runtime_error("preview-scale is larger than frames "
+                                     "from SOURCE.");
+
+        preview_sink_.bind(preview_address_, rows * cols);
+        preview_frame_ = preview_sink_.retrieve(rows, cols, CV_8UC1, PIX_GREY);
+    }
+
     return true;
 }
 
+int ColorConvert::process()
+{
+    if (preview_address_.empty())
+        return FrameFilter::process();
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    if (frame_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // Wait for sources to read
+    frame_sink_.wait();
+    preview_sink_.wait();
+
+    const auto &in = frame_source_.borrow();
+    shared_frame_ = frame_sink_.borrow();
+    preview_frame_ = preview_sink_.borrow();
+
+    // Bands hold whole preview rows
+    const int band
+        = preview_scale_ * std::max(1, BAND_ROWS / preview_scale_);
+    const int bands = (in.rows + band - 1) / band;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &r) {
+        convertRows(in,
+                    shared_frame_,
+                    preview_frame_,
+                    r.start * band,
+                    std::min(in.rows, r.end * band));
+    });
+
+    shared_frame_.set_sample(in.sample());
+    preview_frame_.set_sample(in.sample());
+
+    // Tell sources there is new data
+    preview_sink_.post();
+    frame_sink_.post();
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Sink was not at END state
+    return 0;
+}
+
+void ColorConvert::convertRows(const cv::Mat &in,
+                               cv::Mat &out,
+                               cv::Mat &preview,
+                               const int y0,
+                               const int y1)
+{
+    // Convert the band in place in the sink frame
+    if (conversion_code_ == cv::COLOR_BGR2GRAY) {
+        for (int y = y0; y < y1; y++) {
+            const uint8_t *src = in.ptr<uint8_t>(y);
+            uint8_t *dst = out.ptr<uint8_t>(y);
+            for (int x = 0; x < in.cols; x++)
+                dst[x] = static_cast<uint8_t>(bgrToGrey(src + 3 * x));
+        }
+    } else {
+        cv::Mat out_rows = out.rowRange(y0, y1);
+        cv::cvtColor(in.rowRange(y0, y1), out_rows, conversion_code_);
+    }
+
+    // Box average the band into the preview, reading intensities from
+    // whichever of in or out is GREY
+    const int s = preview_scale_;
+    const bool from_out = out.channels() == 1;
+    const bool from_bgr = !from_out && in.channels() == 3;
+    std::vector<int> sum(preview.cols);
+
+    for (int py = y0 / s; py < std::min(y1 / s, preview.rows); py++) {
+
+        std::fill(sum.begin(), sum.end(), 0);
+        for (int y = py * s; y < (py + 1) * s; y++) {
+
+            const uint8_t *g = from_out ? out.ptr<uint8_t>(y)
+                                        : in.ptr<uint8_t>(y);
+            for (int px = 0; px < preview.cols; px++)
+                for (int x = px * s; x < (px + 1) * s; x++)
+                    sum[px] += from_bgr ? bgrToGrey(g + 3 * x) : g[x];
+        }
+
+        uint8_t *p = preview.ptr<uint8_t>(py);
+        for (int px = 0; px < preview.cols; px++)
+            p[px] = static_cast<uint8_t>((sum[px] + s * s / 2) / (s * s));
+    }
+}
+
 void ColorConvert::filter(cv::Mat &frame)
 {
     cv::Mat out; // Might change underlying element type
@@ -106,4 +234,10 @@ void ColorConvert::filter(cv::Mat &frame)
     static_cast<oat::Frame &>(frame).set_color(color_);
 }
 
+void ColorConvert::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    // Sink frame already has the converted element type
+    cv::cvtColor(in, out, conversion_code_);
+}
+
 } /* namespace oat */
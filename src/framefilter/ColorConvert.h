@@ -39,16 +39,50 @@ public:
     ColorConvert(const std::string &frame_souce_address,
                  const std::string &frame_sink_address);
 
+    bool ready(void) const override
+    {
+        return FrameFilter::ready() && preview_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        auto e = FrameFilter::events();
+        e.push_back(preview_sink_.sample_event());
+        return e;
+    }
+
 private:
     bool connectToNode(void) override;
+    int process(void) override;
     po::options_description options() const override;
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    oat::FrameParams outputParameters(const oat::FrameParams &in) override;
+
     void filter(cv::Mat &frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
 
     int conversion_code_;
     oat::PixelColor color_;
+
+    // Optional downscaled GREY preview, published to its own SINK in the
+    // same pass as the conversion
+    std::string preview_address_;
+    int preview_scale_ {2};
+    oat::Sink<oat::Frame> preview_sink_;
+    oat::Frame preview_frame_;
+
+    /**
+     * @brief Convert a band of rows into out and box average the
+     * corresponding preview rows while the band is in cache.
+     * @param in Unconverted frame
+     * @param out Converted frame
+     * @param preview Preview frame
+     * @param y0 First row. Multiple of preview_scale_.
+     * @param y1 One past the last row
+     */
+    void convertRows(const cv::Mat &in, cv::Mat &out, cv::Mat &preview,
+                     const int y0, const int y1);
 };
 
 }      /* namespace oat */
@@ -0,0 +1,117 @@
+//******************************************************************************
+//* File:   Decimator.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "Decimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+Decimator::Decimator(const std::string &frame_source_address,
+                     const std::string &frame_sink_address)
+: FrameFilter(frame_source_address, frame_sink_address)
+{
+    // Resize straight from the source frame into the sink frame
+    zero_copy_ = true;
+}
+
+po::options_description Decimator::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("decimate,n", po::value<int>(),
+         "Publish one frame out of every n from SOURCE. Others are dropped. "
+         "Published frames keep their original sample number. Default is 1.")
+        ("scale,s", po::value<double>(),
+         "Resize factor in (0, 1] applied to both frame dimensions, using "
+         "area interpolation. Default is 1.")
+        ;
+
+    return local_opts;
+}
+
+void Decimator::applyConfiguration(const po::variables_map &vm,
+                                   const config::OptionTable &config_table)
+{
+    // Temporal decimation
+    oat::config::getNumericValue<int>(
+        vm, config_table, "decimate", decimate_, 1);
+
+    // Spatial decimation
+    oat::config::getNumericValue<double>(
+        vm, config_table, "scale", scale_, 0.0, 1.0);
+
+    if (scale_ == 0.0)
+        throw std::runtime_error("scale must be greater than 0.");
+}
+
+oat::FrameParams Decimator::outputParameters(const oat::FrameParams &in)
+{
+    size_.width
+        = std::max(1, static_cast<int>(std::lround(in.cols * scale_)));
+    size_.height
+        = std::max(1, static_cast<int>(std::lround(in.rows * scale_)));
+
+    // SINK is sized for decimated frames
+    auto out = in;
+    out.cols = size_.width;
+    out.rows = size_.height;
+    return out;
+}
+
+bool Decimator::publish(oat::Sample &sample)
+{
+    // Dropped frames only hold the SOURCE. Readers of SINK see nothing until
+    // the next kept frame.
+    if (frames_seen_++ % decimate_ != 0)
+        return false;
+
+    // The decimated stream runs at a fraction of the source rate
+    if (decimate_ > 1 && sample.rate_hz() > 0.0)
+        sample.set_rate_hz(sample.rate_hz() / decimate_);
+
+    return true;
+}
+
+void Decimator::filter(cv::Mat &frame)
+{
+    cv::Mat out; // Changes the frame size
+    filterInto(frame, out);
+    frame = out;
+}
+
+void Decimator::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    // Sink frame already has the decimated size
+    if (in.size() == size_)
+        in.copyTo(out);
+    else
+        cv::resize(in, out, size_, 0, 0, cv::INTER_AREA);
+}
+
+} /* namespace oat */
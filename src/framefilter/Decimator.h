@@ -0,0 +1,65 @@
+//******************************************************************************
+//* File:   Decimator.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_DECIMATOR_H
+#define	OAT_DECIMATOR_H
+
+#include "FrameFilter.h"
+
+namespace oat {
+
+/**
+ * A spatial and temporal frame decimator
+ */
+class Decimator : public FrameFilter {
+public:
+
+    /**
+     * @brief Publish every Nth frame from SOURCE, resized with area
+     * interpolation, to a smaller SINK. Kept frames carry their original
+     * sample number so that they can be matched to the full rate stream.
+     *
+     * @param frame_souce_address raw frame source address
+     * @param frame_sink_address decimated frame sink address
+     */
+    Decimator(const std::string &frame_souce_address,
+              const std::string &frame_sink_address);
+
+private:
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    oat::FrameParams outputParameters(const oat::FrameParams &in) override;
+    bool publish(oat::Sample &sample) override;
+
+    void filter(cv::Mat &frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+    // Keep one frame in every decimate_
+    int decimate_ {1};
+    uint64_t frames_seen_ {0};
+
+    // Resize factor in (0, 1] and the resulting frame size
+    double scale_ {1.0};
+    cv::Size size_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_DECIMATOR_H */
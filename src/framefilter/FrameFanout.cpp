@@ -0,0 +1,242 @@
+//******************************************************************************
+//* File:   FrameFanout.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "FrameFanout.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+#include "BackgroundSubtractor.h"
+#include "BackgroundSubtractorMOG.h"
+#include "ColorConvert.h"
+#include "Decimator.h"
+#include "FrameMasker.h"
+#include "FusedFilter.h"
+#include "IntensityWindow.h"
+#include "Threshold.h"
+#include "Undistorter.h"
+
+namespace oat {
+
+static std::shared_ptr<FrameFilter> makeBranch(const std::string &type,
+                                               const std::string &source,
+                                               const std::string &sink)
+{
+    if (type == "bsub")
+        return std::make_shared<oat::BackgroundSubtractor>(source, sink);
+    if (type == "mask")
+        return std::make_shared<oat::FrameMasker>(source, sink);
+    if (type == "mog")
+        return std::make_shared<oat::BackgroundSubtractorMOG>(source, sink);
+    if (type == "undistort")
+        return std::make_shared<oat::Undistorter>(source, sink);
+    if (type == "col")
+        return std::make_shared<oat::ColorConvert>(source, sink);
+    if (type == "thresh")
+        return std::make_shared<oat::Threshold>(source, sink);
+    if (type == "fused")
+        return std::make_shared<oat::FusedFilter>(source, sink);
+    if (type == "decimate")
+        return std::make_shared<oat::Decimator>(source, sink);
+    if (type == "window")
+        return std::make_shared<oat::IntensityWindow>(source, sink);
+
+    throw std::runtime_error("Invalid branch TYPE '" + type + "'.");
+}
+
+FrameFanout::FrameFanout(const std::string &frame_source_address,
+                         const std::string &frame_sink_addresses)
+: FrameFilter(frame_source_address, frame_sink_addresses)
+{
+    std::istringstream sinks {frame_sink_addresses};
+    std::string address;
+    while (std::getline(sinks, address, ',')) {
+
+        if (address.empty())
+            throw std::runtime_error("Empty SINK name in '"
+                                     + frame_sink_addresses + "'.");
+
+        branches_.emplace_back(new Branch);
+        branches_.back()->sink_address = address;
+    }
+}
+
+po::options_description FrameFanout::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("branch", po::value<std::string>(),
+         "TOML array of tables, one per SINK, in order. Each table gives the "
+         "framefilt 'type' that publishes to that SINK along with that "
+         "type's configuration keys, e.g. [{type=\"mask\",mask=\"roi.png\"},"
+         "{type=\"col\",color=\"GREY\"}]. Options that add SINKs of their own, "
+         "such as col's preview, are not available in a branch.")
+        ;
+
+    return local_opts;
+}
+
+void FrameFanout::applyConfiguration(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    // Branch tables, from the command line or the configuration table
+    auto table = config_table;
+    if (vm.count("branch")) {
+        std::istringstream toml {"branch=" + vm["branch"].as<std::string>()};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    }
+
+    auto tables = table->get_table_array("branch");
+    if (!tables)
+        throw std::runtime_error("A fanout requires a 'branch' array of "
+                                 "tables, one per SINK.");
+
+    if (tables->get().size() != branches_.size())
+        throw std::runtime_error("Number of branches ("
+                                 + std::to_string(tables->get().size())
+                                 + ") does not match the number of SINKs ("
+                                 + std::to_string(branches_.size()) + ").");
+
+    size_t i = 0;
+    for (const auto &t : *tables) {
+
+        auto &b = *branches_[i++];
+
+        auto type = t->get_as<std::string>("type");
+        if (!type)
+            throw std::runtime_error("Each branch requires a 'type' key.");
+
+        b.filter = makeBranch(*type, frame_source_address_, b.sink_address);
+
+        // Branches take the keys of their own TYPE
+        po::options_description opts;
+        b.filter->appendOptions(opts);
+        b.filter->config_keys_.push_back("type");
+        oat::config::checkKeys(b.filter->config_keys_, t);
+
+        b.filter->applyConfiguration(po::variables_map(), t);
+
+        if (b.filter->device_frames_)
+            throw std::runtime_error("Branches cannot keep frames in device "
+                                     "memory.");
+    }
+}
+
+bool FrameFanout::connectToNode()
+{
+    // Establish our a slot in the source node
+    frame_source_.touch(frame_source_address_);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (frame_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    // Format each branch's sink from the same source
+    auto frame_parameters = frame_source_.parameters();
+    for (auto &b : branches_) {
+
+        auto p = b->filter->outputParameters(frame_parameters);
+        b->sink.bind(b->sink_address, p.rows * p.cols * CV_ELEM_SIZE(p.type));
+        b->frame = b->sink.retrieve(p.rows, p.cols, p.type, p.color);
+    }
+
+    return true;
+}
+
+bool FrameFanout::ready() const
+{
+    if (!frame_source_.readable())
+        return false;
+
+    for (const auto &b : branches_)
+        if (!b->sink.writable())
+            return false;
+
+    return true;
+}
+
+std::vector<SampleEvent *> FrameFanout::events() const
+{
+    std::vector<SampleEvent *> e {&frame_source_.sample_event()};
+    for (const auto &b : branches_)
+        e.push_back(b->sink.sample_event());
+
+    return e;
+}
+
+int FrameFanout::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    if (frame_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // One read of SOURCE serves every branch
+    const auto &in = frame_source_.borrow();
+
+    for (auto &b : branches_) {
+
+        auto sample = in.sample();
+        if (!b->filter->publish(sample))
+            continue;
+
+        // Wait for this branch's sources to read
+        b->sink.wait();
+        b->frame = b->sink.borrow();
+
+        // As in processInPlace(), copy if the filter reallocated its output
+        cv::Mat out = b->frame;
+        b->filter->filterInto(in, out);
+        if (out.data != b->frame.data)
+            out.copyTo(b->frame);
+
+        b->frame.set_sample(sample);
+
+        // Tell this branch's sources there is new data
+        b->sink.post();
+    }
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Sink was not at END state
+    return 0;
+}
+
+void FrameFanout::filter(cv::Mat &frame)
+{
+    (void)frame;
+    throw std::runtime_error("A fanout has no filter of its own.");
+}
+
+} /* namespace oat */
@@ -0,0 +1,75 @@
+//******************************************************************************
+//* File:   FrameFanout.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_FRAMEFANOUT_H
+#define	OAT_FRAMEFANOUT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameFilter.h"
+
+namespace oat {
+
+/**
+ * Several frame filters sharing one read of their SOURCE
+ */
+class FrameFanout : public FrameFilter {
+public:
+
+    /**
+     * @brief Run several filter branches on each frame from SOURCE, each
+     * publishing to its own SINK. SOURCE is read once per frame for all
+     * branches and each branch filters straight from its shared frame into
+     * the branch's shared frame.
+     *
+     * @param frame_souce_address raw frame source address
+     * @param frame_sink_addresses comma separated filtered frame sink
+     * addresses, one per branch
+     */
+    FrameFanout(const std::string &frame_souce_address,
+                const std::string &frame_sink_addresses);
+
+    bool ready(void) const override;
+    std::vector<SampleEvent *> events(void) const override;
+
+private:
+    bool connectToNode(void) override;
+    int process(void) override;
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Branches do the filtering
+    void filter(cv::Mat &frame) override;
+
+    struct Branch {
+        std::string sink_address;
+        std::shared_ptr<FrameFilter> filter;
+        oat::Sink<oat::Frame> sink;
+        oat::Frame frame;
+    };
+
+    // In SINK order
+    std::vector<std::unique_ptr<Branch>> branches_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_FRAMEFANOUT_H */
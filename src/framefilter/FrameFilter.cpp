@@ -21,6 +21,8 @@
 
 #include <string>
 
+#include "../../lib/base/Profiler.h"
+
 namespace oat {
 
 FrameFilter::FrameFilter(const std::string &frame_source_address,
@@ -39,62 +41,239 @@ bool FrameFilter::connectToNode()
     // Establish our a slot in the source node
     frame_source_.touch(frame_source_address_);
 
+    // GPU filters can read frames straight from device memory
+    if (device_filter_)
+        frame_source_.acceptDevice();
+
     // Wait for synchronous start with sink when it binds its node
     if (frame_source_.connect() != SourceState::CONNECTED)
         return false;
 
-    // Get frame meta data to format sink
-    auto frame_parameters = frame_source_.parameters();
+    // Get frame meta data to format sink. The filter might change the size
+    // and type of frames.
+    const auto in = frame_source_.parameters();
+    auto p = outputParameters(in);
+
+    // Copies of SOURCE frames reuse this buffer from now on
+    if (!zero_copy_)
+        internal_frame_.create(in.rows, in.cols, in.type);
 
     // Bind to sink node and create a shared frame
-    frame_sink_.bind(frame_sink_address_, frame_parameters.bytes);
-    shared_frame_ = frame_sink_.retrieve(frame_parameters.rows,
-                                         frame_parameters.cols,
-                                         frame_parameters.type,
-                                         frame_parameters.color);
+    frame_sink_.bind(frame_sink_address_,
+                     p.rows * p.cols * CV_ELEM_SIZE(p.type));
+#ifdef HAVE_CUDA
+    if (device_frames_) {
+        shared_frame_ = frame_sink_.retrieveDevice(p.rows,
+                                                   p.cols,
+                                                   p.type,
+                                                   p.color);
+        return true;
+    }
+#endif
+    shared_frame_ = frame_sink_.retrieve(p.rows, p.cols, p.type, p.color);
+    source_generation_ = frame_source_.generation();
 
     return true;
 }
 
+void FrameFilter::followSourceFormat()
+{
+    // Must be called between frame_sink_.wait() and post(), while
+    // frame_source_ still describes the frame being filtered
+    if (frame_source_.generation() == source_generation_)
+        return;
+
+    const auto p = outputParameters(frame_source_.parameters());
+    shared_frame_ = frame_sink_.reformat(p.rows, p.cols, p.type, p.color);
+    source_generation_ = frame_source_.generation();
+}
+
 int FrameFilter::process()
 {
-    oat::Frame internal_frame;
+#ifdef HAVE_CUDA
+    if (device_frames_ || frame_source_.on_device())
+        return processDevice();
+#endif
+
+    if (zero_copy_)
+        return processInPlace();
 
     // START CRITICAL SECTION //
     ////////////////////////////
 
     // Wait for sink to write to node
+    OAT_PHASE(WAIT_SOURCE);
     if (frame_source_.wait() == oat::NodeState::END)
         return 1;
 
     // Clone the shared frame
-    frame_source_.copyTo(internal_frame);
+    OAT_PHASE(COPY_IN);
+    frame_source_.copyTo(internal_frame_);
 
     // Tell sink it can continue
+    OAT_PHASE(PUBLISH);
     frame_source_.post();
 
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
+    OAT_PHASE(COMPUTE);
+    auto sample = internal_frame_.sample();
+    if (!publish(sample))
+        return 0;
+
     // Filter internal frame
-    filter(internal_frame);
+    filter(internal_frame_);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    OAT_PHASE(WAIT_SINK);
+    frame_sink_.wait();
+    followSourceFormat();
+
+    OAT_PHASE(COPY_OUT);
+    internal_frame_.copyTo(shared_frame_);
+    shared_frame_.set_sample(sample);
+
+    // Tell sources there is new data
+    OAT_PHASE(PUBLISH);
+    frame_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Sink was not at END state
+    return 0;
+}
+
+int FrameFilter::processInPlace()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    OAT_PHASE(WAIT_SOURCE);
+    if (frame_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    const auto &in = frame_source_.borrow();
+    OAT_PHASE(COMPUTE);
+    auto sample = in.sample();
+    if (!publish(sample)) {
+        frame_source_.post();
+        return 0;
+    }
 
+    // Wait for sources to read
+    OAT_PHASE(WAIT_SINK);
+    frame_sink_.wait();
+    followSourceFormat();
+
+    OAT_PHASE(COMPUTE);
+    shared_frame_ = frame_sink_.borrow();
+
+    // If the filter had to reallocate its output, fall back to a copy so that
+    // the shared frame is not orphaned
+    cv::Mat out = shared_frame_;
+    filterInto(in, out);
+    OAT_PHASE(COPY_OUT);
+    if (out.data != shared_frame_.data)
+        out.copyTo(shared_frame_);
+
+    shared_frame_.set_sample(sample);
+
+    // Tell sources there is new data
+    OAT_PHASE(PUBLISH);
+    frame_sink_.post();
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Sink was not at END state
+    return 0;
+}
+
+#ifdef HAVE_CUDA
+int FrameFilter::processDevice()
+{
     // START CRITICAL SECTION //
     ////////////////////////////
 
+    // Wait for sink to write to node
+    OAT_PHASE(WAIT_SOURCE);
+    if (frame_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // Host frames carry sample information even when pixels are on the GPU
+    const auto &in = frame_source_.borrow();
+    OAT_PHASE(COMPUTE);
+    auto sample = in.sample();
+    if (!publish(sample)) {
+        frame_source_.post();
+        return 0;
+    }
+
     // Wait for sources to read
+    OAT_PHASE(WAIT_SINK);
     frame_sink_.wait();
 
-    internal_frame.copyTo(shared_frame_);
+    OAT_PHASE(COMPUTE);
+    shared_frame_ = frame_sink_.borrow();
+
+    cv::cuda::GpuMat gpu_in;
+    if (frame_source_.on_device()) {
+        gpu_in = frame_source_.borrowDevice();
+    } else {
+        OAT_PHASE(COPY_IN);
+        gpu_in = mapped_.in(in, gpu_in_);
+        OAT_PHASE(COMPUTE);
+    }
+
+    if (frame_sink_.on_device()) {
+
+        // As in processInPlace(), copy if the filter reallocated its output
+        auto shared = frame_sink_.borrowDevice();
+        cv::cuda::GpuMat out = shared;
+        filterDevice(gpu_in, out);
+        if (out.data != shared.data)
+            out.copyTo(shared);
+
+    } else if (mapped_.map(shared_frame_, gpu_out_view_)) {
+
+        // Written in place where the GPU shares host memory
+        cv::cuda::GpuMat out = gpu_out_view_;
+        filterDevice(gpu_in, out);
+        if (out.data != gpu_out_view_.data)
+            out.copyTo(gpu_out_view_);
+        synchronizeDevice();
+
+    } else {
+        filterDevice(gpu_in, gpu_out_);
+        OAT_PHASE(COPY_OUT);
+        cv::Mat out = shared_frame_;
+        gpu_out_.download(out);
+    }
+
+    shared_frame_.set_sample(sample);
 
     // Tell sources there is new data
+    OAT_PHASE(PUBLISH);
     frame_sink_.post();
 
+    // Tell sink it can continue
+    frame_source_.post();
+
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
     // Sink was not at END state
     return 0;
 }
+#endif
 
 } /* namespace oat */
@@ -20,8 +20,14 @@
 #ifndef OAT_FRAMEFILT_H
 #define	OAT_FRAMEFILT_H
 
+#include <stdexcept>
 #include <string>
 
+#include <opencv2/cvconfig.h>
+#ifdef HAVE_CUDA
+ #include <opencv2/core/cuda.hpp>
+#endif
+
 #include "../../lib/base/Configurable.h"
 #include "../../lib/base/ControllableComponent.h"
 #include "../../lib/datatypes/Frame.h"
@@ -31,11 +37,15 @@
 namespace oat {
 
 class ColorConvert; // Forward decl.
+class FrameFanout;
+namespace fuse { struct Access; }
 namespace po = boost::program_options;
 
 class FrameFilter : public Component, public Configurable<false> {
 
 friend ColorConvert;
+friend FrameFanout;
+friend fuse::Access;
 
 public:
     /**
@@ -51,6 +61,14 @@ public:
     // Component Interface
     oat::ComponentType type(void) const override { return oat::framefilter; };
     std::string name(void) const override { return name_; }
+    bool ready(void) const override
+    {
+        return frame_source_.readable() && frame_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        return {&frame_source_.sample_event(), frame_sink_.sample_event()};
+    }
 
 protected:
     // Filter name
@@ -63,11 +81,97 @@ protected:
      */
     virtual void filter(cv::Mat &frame) = 0;
 
+    /**
+     * Perform frame filtering from the SOURCE's shared frame directly into
+     * the SINK's shared frame. Only used when zero_copy_ is set. The default
+     * implementation copies the input to the output and filters it there.
+     * Both frames are only valid for the length of the call and the SOURCE
+     * node is held until the call returns.
+     * @param in Frame to be filtered. Must not be modified.
+     * @param out Filtered frame. Has the sink's size and type.
+     */
+    virtual void filterInto(const cv::Mat &in, cv::Mat &out)
+    {
+        in.copyTo(out);
+        filter(out);
+    }
+
+    // Set by filters that implement filterInto() to skip the intermediate
+    // frame copies made by process()
+    bool zero_copy_ {false};
+
+    /**
+     * Parameters of the frames published to SINK, given those of frames from
+     * SOURCE. Called after SOURCE connects and again whenever SOURCE frames
+     * change format. Override in filters that
+     * change the frame size or color.
+     * @param in SOURCE frame parameters
+     * @return SINK frame parameters
+     */
+    virtual oat::FrameParams outputParameters(const oat::FrameParams &in)
+    {
+        return in;
+    }
+
+    /**
+     * Decide whether the current SOURCE frame is filtered and published.
+     * Dropped frames are released without waiting on the SINK.
+     * @param sample Sample of the SOURCE frame. It is published with the
+     * filtered frame and may be modified.
+     * @return True to publish the frame.
+     */
+    virtual bool publish(oat::Sample &sample)
+    {
+        (void)sample;
+        return true;
+    }
+
+#ifdef HAVE_CUDA
+    /**
+     * Perform frame filtering in device memory. Used in place of
+     * filterInto() when the SOURCE or SINK keeps its frames on the GPU, so
+     * that consecutive GPU filters exchange frames without host copies. Only
+     * called by filters that set device_filter_.
+     * @param in Frame to be filtered. Must not be modified.
+     * @param out Filtered frame. If the SINK is on the device, this is its
+     * shared frame and has the sink's size and type.
+     */
+    virtual void filterDevice(const cv::cuda::GpuMat &in,
+                              cv::cuda::GpuMat &out)
+    {
+        (void)in;
+        (void)out;
+        throw std::runtime_error("Filter has no device implementation.");
+    }
+#endif
+
+    // Set by filters that implement filterDevice(). These can read SOURCEs
+    // held in device memory.
+    bool device_filter_ {false};
+
+    // If true, the SINK keeps its pixel data in device memory. Requires
+    // device_filter_. Only GPU filters can then read it.
+    bool device_frames_ {false};
+
 private:
     // Component Interface
     virtual bool connectToNode(void) override;
     int process(void) override;
 
+    // process() for filters that set zero_copy_
+    int processInPlace(void);
+
+    // Reformat the SINK if the SOURCE frame being filtered changed format
+    void followSourceFormat(void);
+    uint64_t source_generation_ {0};
+
+#ifdef HAVE_CUDA
+    // process() when the SOURCE or SINK is in device memory
+    int processDevice(void);
+    cv::cuda::GpuMat gpu_in_, gpu_out_, gpu_out_view_;
+    oat::MappedFrames mapped_;
+#endif
+
     // Frame source
     const std::string frame_source_address_;
     oat::Source<oat::Frame> frame_source_;
@@ -78,6 +182,10 @@ private:
 
     // Currently acquired, shared frame
     oat::Frame shared_frame_;
+
+    // Working copy of SOURCE frames for filters that do not set zero_copy_.
+    // Allocated when the node connects and reused by every call to process().
+    oat::Frame internal_frame_;
 };
 
 }      /* namespace oat */
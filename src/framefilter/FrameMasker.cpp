@@ -19,6 +19,10 @@
 
 #include "FrameMasker.h"
 
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
 #include <cpptoml.h>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgproc.hpp>
@@ -34,7 +38,13 @@ FrameMasker::FrameMasker(const std::string &frame_source_address,
                          const std::string &frame_sink_address)
 : FrameFilter(frame_source_address, frame_sink_address)
 {
-    // Nothing
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
+
+#ifdef HAVE_CUDA
+    // Frames can be exchanged with other GPU filters in device memory
+    device_filter_ = true;
+#endif
 }
 
 po::options_description FrameMasker::options() const
@@ -47,6 +57,12 @@ po::options_description FrameMasker::options() const
          "pixels with indices corresponding to non-zero value pixels in the mask "
          "image will be unaffected. Others will be set to zero. This image must "
          "have the same dimensions as frames from SOURCE.")
+#ifdef HAVE_CUDA
+        ("device-frames",
+         "If true, keep frames published to SINK in GPU memory, so that "
+         "downstream GPU filters can read them without host copies. Only "
+         "GPU filters can then read from SINK.")
+#endif
         ;
 
     return local_opts;
@@ -64,14 +80,112 @@ void FrameMasker::applyConfiguration(const po::variables_map &vm,
         if (roi_mask_.data == NULL)
             throw (std::runtime_error("File \"" + img_path + "\" could not be read."));
 
+        analyzeMask();
         mask_set_ = true;
     }
+
+#ifdef HAVE_CUDA
+    // Device memory sink
+    oat::config::getValue<bool>(vm, config_table, "device-frames", device_frames_);
+#endif
+}
+
+void FrameMasker::analyzeMask()
+{
+    spans_.clear();
+    row_spans_.assign(1, 0);
+
+    for (int y = 0; y < roi_mask_.rows; y++) {
+
+        const uint8_t *m = roi_mask_.ptr<uint8_t>(y);
+        int x = 0;
+        while (x < roi_mask_.cols) {
+
+            if (m[x] != 0) {
+                x++;
+                continue;
+            }
+
+            const int begin = x;
+            while (x < roi_mask_.cols && m[x] == 0)
+                x++;
+            spans_.push_back({begin, x});
+        }
+
+        row_spans_.push_back(spans_.size());
+    }
+}
+
+void FrameMasker::checkSize(const cv::Mat &frame) const
+{
+    if (frame.rows != roi_mask_.rows || frame.cols != roi_mask_.cols)
+        throw std::runtime_error("Mask must have the same dimensions as "
+                                 "frames from SOURCE.");
 }
 
 void FrameMasker::filter(cv::Mat &frame)
 {
-    if (mask_set_)
-        frame.setTo(0, roi_mask_ == 0);
+    if (!mask_set_)
+        return;
+
+    checkSize(frame);
+
+    // Only the excluded spans are touched
+    const size_t px = frame.elemSize();
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (size_t i = row_spans_[y]; i < row_spans_[y + 1]; i++)
+            std::memset(row + spans_[i].begin * px,
+                        0,
+                        (spans_[i].end - spans_[i].begin) * px);
+    }
+}
+
+void FrameMasker::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    if (!mask_set_) {
+        in.copyTo(out);
+        return;
+    }
+
+    checkSize(in);
+    out.create(in.size(), in.type());
+
+    // Copy the spans between excluded ones and zero the rest, so each
+    // output pixel is written once
+    const size_t px = in.elemSize();
+    for (int y = 0; y < in.rows; y++) {
+
+        const uint8_t *src = in.ptr<uint8_t>(y);
+        uint8_t *dst = out.ptr<uint8_t>(y);
+
+        int x = 0;
+        for (size_t i = row_spans_[y]; i < row_spans_[y + 1]; i++) {
+            const Span &s = spans_[i];
+            std::memcpy(dst + x * px, src + x * px, (s.begin - x) * px);
+            std::memset(dst + s.begin * px, 0, (s.end - s.begin) * px);
+            x = s.end;
+        }
+        std::memcpy(dst + x * px, src + x * px, (in.cols - x) * px);
+    }
+}
+
+#ifdef HAVE_CUDA
+void FrameMasker::filterDevice(const cv::cuda::GpuMat &in,
+                               cv::cuda::GpuMat &out)
+{
+    if (!mask_set_) {
+        in.copyTo(out);
+        return;
+    }
+
+    if (gpu_mask_.empty())
+        gpu_mask_.upload(roi_mask_);
+
+    out.create(in.size(), in.type());
+    out.setTo(cv::Scalar::all(0));
+    in.copyTo(out, gpu_mask_);
 }
+#endif
 
 } /* namespace oat */
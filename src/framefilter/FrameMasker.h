@@ -20,6 +20,8 @@
 #ifndef OAT_FRAMEMASKER_H
 #define	OAT_FRAMEMASKER_H
 
+#include <vector>
+
 #include "FrameFilter.h"
 
 namespace oat {
@@ -46,10 +48,39 @@ private:
                             const config::OptionTable &config_table) override;
 
     void filter(cv::Mat& frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+#ifdef HAVE_CUDA
+    /**
+     * Apply mask in device memory.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterDevice(const cv::cuda::GpuMat &in,
+                      cv::cuda::GpuMat &out) override;
+
+    // Mask uploaded on first use
+    cv::cuda::GpuMat gpu_mask_;
+#endif
 
     // Mask frames with an arbitrary ROI
     bool mask_set_ = false;
     cv::Mat roi_mask_;
+
+    // Columns [begin, end) of a row that the mask excludes
+    struct Span { int begin, end; };
+
+    // Run-length form of roi_mask_. The excluded spans of row y are
+    // spans_[row_spans_[y]] up to spans_[row_spans_[y + 1]].
+    std::vector<Span> spans_;
+    std::vector<size_t> row_spans_;
+
+    /**
+     * @brief Find the excluded spans of each row of roi_mask_.
+     */
+    void analyzeMask();
+
+    void checkSize(const cv::Mat &frame) const;
 };
 
 }      /* namespace oat */
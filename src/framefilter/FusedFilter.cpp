@@ -0,0 +1,277 @@
+//******************************************************************************
+//* File:   FusedFilter.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "FusedFilter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+#include "BGRGrey.h"
+
+namespace oat {
+
+// Rows per band processed by each thread
+static constexpr int BAND_ROWS {32};
+
+FusedFilter::FusedFilter(const std::string &frame_source_address,
+                         const std::string &frame_sink_address)
+: FrameFilter(frame_source_address, frame_sink_address)
+{
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
+}
+
+po::options_description FusedFilter::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("ops", po::value<std::string>(),
+         "Array of strings, e.g. [\"mask\",\"bsub\",\"thresh\"], specifying "
+         "the operations to apply, in order. Each may appear once. Options "
+         "below are those of the framefilt TYPE of the same name.")
+        ("mask", po::value<std::string>(),
+         "mask: Path to a binary image used to mask frames. Pixels "
+         "corresponding to zero value pixels of the mask are set to zero. "
+         "Must have the same dimensions as frames from SOURCE.")
+        ("background", po::value<std::string>(),
+         "bsub: Path to background image used for subtraction. If not "
+         "provided, the first frame is used as the background image.")
+        ("adaptation-coeff", po::value<double>(),
+         "bsub: Scalar value, 0 to 1.0, specifying how quickly new frames are "
+         "used to update the background image. Default is 0.")
+        ("intensity", po::value<std::string>(),
+         "thresh: Array of ints between 0 and 256, [min,max], specifying the "
+         "intensity passband.")
+        ;
+
+    return local_opts;
+}
+
+void FusedFilter::applyConfiguration(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    // Operations
+    std::vector<std::string> ops;
+    oat::config::getArray(vm, config_table, "ops", ops, true);
+
+    ops_.clear();
+    for (const auto &o : ops) {
+
+        Op op;
+        if (o == "mask")
+            op = Op::MASK;
+        else if (o == "bsub")
+            op = Op::BSUB;
+        else if (o == "thresh")
+            op = Op::THRESH;
+        else
+            throw std::runtime_error("Unknown fused operation '" + o + "'. "
+                                     "Use mask, bsub or thresh.");
+
+        if (std::find(ops_.begin(), ops_.end(), op) != ops_.end())
+            throw std::runtime_error("Fused operation '" + o + "' is listed "
+                                     "more than once.");
+        ops_.push_back(op);
+    }
+
+    auto uses = [this](const Op op) {
+        return std::find(ops_.begin(), ops_.end(), op) != ops_.end();
+    };
+
+    // Mask image path
+    std::string mask_path;
+    if (oat::config::getValue(
+            vm, config_table, "mask", mask_path, uses(Op::MASK))) {
+
+        roi_mask_ = cv::imread(mask_path, CV_LOAD_IMAGE_GRAYSCALE);
+
+        if (roi_mask_.data == NULL)
+            throw (std::runtime_error("File \"" + mask_path + "\" could not be read."));
+    }
+
+    // Background image path
+    std::string img_path;
+    if (oat::config::getValue(vm, config_table, "background", img_path)) {
+
+        background_frame_ = cv::imread(img_path, CV_LOAD_IMAGE_COLOR);
+
+        if (background_frame_.data == nullptr)
+            throw (std::runtime_error("File \"" + img_path + "\" could not be read."));
+
+        background_frame_.convertTo(background_frame_f_, CV_32F);
+        background_set_ = true;
+    }
+
+    // Adaptation coefficient
+    oat::config::getNumericValue<double>(
+        vm, config_table, "adaptation-coeff", alpha_, 0.0, 1.0);
+
+    // Intensity
+    std::vector<int> i;
+    if (oat::config::getArray<int, 2>(vm, config_table, "intensity", i)) {
+
+        i_min_ = i[0];
+        i_max_ = i[1];
+
+        if (i_min_ < 0 || i_min_> 256 || i_max_ < 0 || i_max_ > 256)
+           throw std::runtime_error("Values of intensity should be between 0 and 256.");
+    }
+}
+
+void FusedFilter::prepare(const cv::Mat &in)
+{
+    if (in.depth() != CV_8U || (in.channels() != 1 && in.channels() != 3))
+        throw std::runtime_error("Fused filter requires 8-bit, 1 or 3 channel "
+                                 "frames.");
+
+    auto has = [this](const Op op) {
+        return std::find(ops_.begin(), ops_.end(), op) != ops_.end();
+    };
+
+    if (has(Op::MASK) && roi_mask_.size() != in.size())
+        throw std::runtime_error("Mask must have the same dimensions as "
+                                 "frames from SOURCE.");
+
+    if (has(Op::THRESH) && in.channels() == 3
+        && static_cast<const oat::Frame &>(in).color() != PIX_BGR)
+        throw std::runtime_error("Fused threshold requires GREY or BGR "
+                                 "frames.");
+
+    if (has(Op::BSUB) && background_set_
+        && (background_frame_.size() != in.size()
+            || background_frame_.type() != in.type()))
+        throw std::runtime_error("Background image must have the same "
+                                 "dimensions and color as frames from "
+                                 "SOURCE.");
+
+    // Otherwise the background is taken from the first frame, as seen by
+    // the bsub operation, while it is filtered
+    if (has(Op::BSUB) && !background_set_) {
+        background_frame_.create(in.size(), in.type());
+        if (alpha_ > 0.0)
+            background_frame_f_.create(in.size(),
+                                       CV_MAKETYPE(CV_32F, in.channels()));
+    }
+
+    prepared_ = true;
+}
+
+template <int CHANNELS>
+void FusedFilter::filterRows(const cv::Mat &in,
+                             cv::Mat &out,
+                             const int y0,
+                             const int y1)
+{
+    const int n = in.cols * CHANNELS;
+    const bool capture = !background_set_;
+    const float a = static_cast<float>(alpha_);
+
+    for (int y = y0; y < y1; y++) {
+
+        // All operations work in place on the output row
+        uint8_t *v = out.ptr<uint8_t>(y);
+        const uint8_t *src = in.ptr<uint8_t>(y);
+        if (v != src)
+            std::copy(src, src + n, v);
+
+        for (const auto op : ops_) {
+            switch (op) {
+                case Op::MASK:
+                {
+                    const uint8_t *m = roi_mask_.ptr<uint8_t>(y);
+                    for (int x = 0; x < in.cols; x++)
+                        if (m[x] == 0)
+                            for (int c = 0; c < CHANNELS; c++)
+                                v[CHANNELS * x + c] = 0;
+                    break;
+                }
+                case Op::BSUB:
+                {
+                    uint8_t *b = background_frame_.ptr<uint8_t>(y);
+                    if (capture) {
+                        std::copy(v, v + n, b);
+                        if (a > 0) {
+                            float *bf = background_frame_f_.ptr<float>(y);
+                            std::copy(v, v + n, bf);
+                        }
+                    } else if (a > 0) {
+                        float *bf = background_frame_f_.ptr<float>(y);
+                        for (int k = 0; k < n; k++) {
+                            bf[k] = bf[k] * (1 - a) + v[k] * a;
+                            b[k] = cv::saturate_cast<uint8_t>(bf[k]);
+                        }
+                    }
+
+                    for (int k = 0; k < n; k++)
+                        v[k] = v[k] > b[k] ? v[k] - b[k] : 0;
+                    break;
+                }
+                case Op::THRESH:
+                {
+                    for (int x = 0; x < in.cols; x++) {
+                        uint8_t *p = v + CHANNELS * x;
+                        const int g = CHANNELS == 3 ? bgrToGrey(p) : p[0];
+                        if (g < i_min_ || g > i_max_)
+                            for (int c = 0; c < CHANNELS; c++)
+                                p[c] = 0;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void FusedFilter::filter(cv::Mat &frame)
+{
+    filterInto(frame, frame);
+}
+
+void FusedFilter::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    if (!prepared_)
+        prepare(in);
+
+    out.create(in.size(), in.type());
+
+    const int bands = (in.rows + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &r) {
+        const int y0 = r.start * BAND_ROWS;
+        const int y1 = std::min(in.rows, r.end * BAND_ROWS);
+        if (in.channels() == 1)
+            filterRows<1>(in, out, y0, y1);
+        else
+            filterRows<3>(in, out, y0, y1);
+    });
+
+    background_set_ = true;
+}
+
+} /* namespace oat */
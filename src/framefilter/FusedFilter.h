@@ -0,0 +1,91 @@
+//******************************************************************************
+//* File:   FusedFilter.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_FUSEDFILTER_H
+#define	OAT_FUSEDFILTER_H
+
+#include <vector>
+
+#include "FrameFilter.h"
+
+namespace oat {
+
+/**
+ * Several simple filters applied in a single pass over each frame.
+ */
+class FusedFilter : public FrameFilter {
+public:
+
+    /**
+     * @brief Apply an ordered list of masking, background subtraction and
+     * intensity threshold operations in one pass. Each row of a frame is run
+     * through every operation while it is still in cache, and bands of rows
+     * are processed in parallel. Results match the equivalent chain of mask,
+     * bsub and thresh filters.
+     *
+     * @param frame_source_address raw frame source address
+     * @param frame_sink_address filtered frame sink address
+     */
+    FusedFilter(const std::string &frame_source_address,
+                const std::string &frame_sink_address);
+
+private:
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    void filter(cv::Mat &frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+    enum class Op { MASK, BSUB, THRESH };
+    std::vector<Op> ops_;
+
+    // Mask
+    cv::Mat roi_mask_;
+
+    // Background subtraction
+    bool background_set_ {false};
+    cv::Mat background_frame_, background_frame_f_;
+    double alpha_ {0.0};
+
+    // Intensity threshold boundaries
+    int i_min_ {0};
+    int i_max_ {256};
+
+    /**
+     * Check that a frame can be filtered, and take the background from it
+     * if need be.
+     * @param in First frame
+     */
+    void prepare(const cv::Mat &in);
+    bool prepared_ {false};
+
+    /**
+     * Apply all operations to a range of rows.
+     * @param in Unfiltered frame
+     * @param out Filtered frame. May be in.
+     * @param y0 First row
+     * @param y1 One past the last row
+     */
+    template <int CHANNELS>
+    void filterRows(const cv::Mat &in, cv::Mat &out, const int y0, const int y1);
+};
+
+}      /* namespace oat */
+#endif /* OAT_FUSEDFILTER_H */
@@ -0,0 +1,154 @@
+//******************************************************************************
+//* File:   IntensityWindow.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "IntensityWindow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Rows per band processed by each thread
+static constexpr int BAND_ROWS {32};
+
+// Entries of the lookup table, one per 16-bit intensity
+static constexpr int LUT_SIZE {1 << 16};
+
+IntensityWindow::IntensityWindow(const std::string &frame_source_address,
+                                 const std::string &frame_sink_address)
+: FrameFilter(frame_source_address, frame_sink_address)
+{
+    // Map straight from the source frame into the sink frame
+    zero_copy_ = true;
+}
+
+po::options_description IntensityWindow::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("range,R", po::value<std::string>(),
+         "Array of ints between 0 and 65535, [min,max], specifying the "
+         "intensities mapped to 0 and 255. Defaults to [0,4095], the range of "
+         "12-bit sensors.")
+        ("gamma,g", po::value<double>(),
+         "Exponent applied to intensities within the range, after scaling "
+         "them to [0,1]. Values below 1 brighten dim parts of the image. "
+         "Default is 1.")
+        ;
+
+    return local_opts;
+}
+
+void IntensityWindow::applyConfiguration(const po::variables_map &vm,
+                                         const config::OptionTable &config_table)
+{
+    // Window
+    int lo = 0, hi = 4095;
+    std::vector<int> r;
+    if (oat::config::getArray<int, 2>(vm, config_table, "range", r)) {
+
+        lo = r[0];
+        hi = r[1];
+
+        if (lo < 0 || hi > LUT_SIZE - 1 || lo >= hi)
+            throw std::runtime_error("range should be increasing and between "
+                                     "0 and 65535.");
+    }
+
+    // Transfer curve
+    double gamma = 1.0;
+    oat::config::getNumericValue<double>(
+        vm, config_table, "gamma", gamma, 0.0);
+
+    if (gamma == 0.0)
+        throw std::runtime_error("gamma must be greater than 0.");
+
+    // A table turns the per pixel scale, clip and power into one load
+    lut_.resize(LUT_SIZE);
+    for (int i = 0; i < LUT_SIZE; i++) {
+        const double x = std::max(0, std::min(i - lo, hi - lo))
+                         / static_cast<double>(hi - lo);
+        lut_[i] = static_cast<uint8_t>(std::lround(255 * std::pow(x, gamma)));
+    }
+}
+
+oat::FrameParams IntensityWindow::outputParameters(const oat::FrameParams &in)
+{
+    if (in.color != PIX_GREY16)
+        throw std::runtime_error("Intensity windows require GREY16 frames.");
+
+    // SINK is sized for 8-bit frames
+    auto out = in;
+    out.type = oat::cv_type(PIX_GREY);
+    out.color = PIX_GREY;
+    return out;
+}
+
+void IntensityWindow::filter(cv::Mat &frame)
+{
+    cv::Mat out; // Changes the frame type
+    filterInto(frame, out);
+    frame = out;
+}
+
+void IntensityWindow::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    if (in.type() != CV_16UC1)
+        throw std::runtime_error("Intensity windows require GREY16 frames.");
+
+    out.create(in.size(), CV_8UC1);
+
+    const int bands = (in.rows + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &r) {
+        mapRows(in,
+                out,
+                r.start * BAND_ROWS,
+                std::min(in.rows, r.end * BAND_ROWS));
+    });
+}
+
+void IntensityWindow::mapRows(const cv::Mat &in,
+                              cv::Mat &out,
+                              const int y0,
+                              const int y1)
+{
+    const uint8_t *lut = lut_.data();
+
+    for (int y = y0; y < y1; y++) {
+
+        const uint16_t *src = in.ptr<uint16_t>(y);
+        uint8_t *dst = out.ptr<uint8_t>(y);
+
+        for (int x = 0; x < in.cols; x++)
+            dst[x] = lut[src[x]];
+    }
+}
+
+} /* namespace oat */
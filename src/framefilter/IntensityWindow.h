@@ -0,0 +1,73 @@
+//******************************************************************************
+//* File:   IntensityWindow.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_INTENSITYWINDOW_H
+#define	OAT_INTENSITYWINDOW_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FrameFilter.h"
+
+namespace oat {
+
+/**
+ * A 16 to 8 bit intensity window
+ */
+class IntensityWindow : public FrameFilter {
+public:
+
+    /**
+     * @brief Map a window of the intensities of 16-bit GREY16 frames from
+     * SOURCE onto the 0 to 255 range of GREY frames published to SINK, for
+     * components that only read 8-bit frames. Intensities below and above
+     * the window are clipped.
+     *
+     * @param frame_souce_address GREY16 frame source address
+     * @param frame_sink_address GREY frame sink address
+     */
+    IntensityWindow(const std::string &frame_souce_address,
+                    const std::string &frame_sink_address);
+
+private:
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    oat::FrameParams outputParameters(const oat::FrameParams &in) override;
+
+    void filter(cv::Mat &frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+    // 8-bit value of each 16-bit intensity
+    std::vector<uint8_t> lut_;
+
+    /**
+     * Map a band of rows through the lookup table.
+     * @param in GREY16 frame
+     * @param out GREY frame of the same size
+     * @param y0 First row
+     * @param y1 One past the last row
+     */
+    void mapRows(const cv::Mat &in, cv::Mat &out, const int y0, const int y1);
+};
+
+}      /* namespace oat */
+#endif /* OAT_INTENSITYWINDOW_H */
@@ -0,0 +1,146 @@
+//******************************************************************************
+//* File:   RunningAverage.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "RunningAverage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+namespace oat {
+
+// Rows per band processed by each thread
+static constexpr int BAND_ROWS {32};
+
+// Fraction bits of the fixed point average and of its coefficient. A
+// difference of two 8.8 values times a Q15 coefficient fits in 32 bits.
+// From MIN_FIXED_ALPHA, the coefficient is at least 512, so it is within
+// 0.1% of alpha and an update only stalls on differences under 1/8 grey
+// level.
+static constexpr int BG_SHIFT {8};
+static constexpr int ALPHA_SHIFT {15};
+
+void RunningAverage::reset(const cv::Mat &frame, const double alpha)
+{
+    if (frame.depth() != CV_8U && frame.depth() != CV_16U)
+        throw std::runtime_error("Background subtraction requires frames of "
+                                 "8 or 16 bit depth.");
+    if (!(alpha > 0.0 && alpha <= 1.0))
+        throw std::runtime_error("The adaptation coefficient of a running "
+                                 "average must be in (0, 1].");
+
+    alpha_ = alpha;
+    depth_ = frame.depth();
+    fixed_ = frame.depth() == CV_8U && alpha >= MIN_FIXED_ALPHA;
+    if (fixed_)
+        frame.convertTo(average_, CV_16U, 1 << BG_SHIFT);
+    else
+        frame.convertTo(average_, CV_32F);
+}
+
+cv::Mat RunningAverage::background() const
+{
+    cv::Mat b;
+    average_.convertTo(b, depth_, fixed_ ? 1.0 / (1 << BG_SHIFT) : 1.0);
+    return b;
+}
+
+void RunningAverage::subtract(const cv::Mat &in, cv::Mat &out)
+{
+    if (in.size() != average_.size() || in.channels() != average_.channels()
+        || in.depth() != depth_)
+        throw std::runtime_error("Background image must have the same "
+                                 "dimensions and color as frames from "
+                                 "SOURCE.");
+
+    out.create(in.size(), in.type());
+
+    const int bands = (in.rows + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &r) {
+        const int y0 = r.start * BAND_ROWS;
+        const int y1 = std::min(in.rows, r.end * BAND_ROWS);
+        if (fixed_)
+            fixedRows(in, out, y0, y1);
+        else if (depth_ == CV_8U)
+            floatRows<uint8_t>(in, out, y0, y1);
+        else
+            floatRows<uint16_t>(in, out, y0, y1);
+    });
+}
+
+void RunningAverage::fixedRows(const cv::Mat &in,
+                               cv::Mat &out,
+                               const int y0,
+                               const int y1)
+{
+    const int32_t a = static_cast<int32_t>(
+        std::lround(alpha_ * (1 << ALPHA_SHIFT)));
+    const int32_t round_a = 1 << (ALPHA_SHIFT - 1);
+    const int32_t round_bg = 1 << (BG_SHIFT - 1);
+    const int n = in.cols * in.channels();
+
+    for (int y = y0; y < y1; y++) {
+
+        const uint8_t *src = in.ptr<uint8_t>(y);
+        uint16_t *bq = average_.ptr<uint16_t>(y);
+        uint8_t *dst = out.ptr<uint8_t>(y);
+
+        // Branch free so that it vectorizes. Each element is read and
+        // written once.
+        for (int k = 0; k < n; k++) {
+            const int32_t x = src[k];
+            int32_t q = bq[k];
+            q += (a * ((x << BG_SHIFT) - q) + round_a) >> ALPHA_SHIFT;
+            bq[k] = static_cast<uint16_t>(q);
+
+            const int32_t bx = (q + round_bg) >> BG_SHIFT;
+            dst[k] = static_cast<uint8_t>(std::max<int32_t>(x - bx, 0));
+        }
+    }
+}
+
+template <typename T>
+void RunningAverage::floatRows(const cv::Mat &in,
+                               cv::Mat &out,
+                               const int y0,
+                               const int y1)
+{
+    // The update of cv::accumulateWeighted
+    const float a = static_cast<float>(alpha_);
+    const float b = 1.0f - a;
+    const int n = in.cols * in.channels();
+
+    for (int y = y0; y < y1; y++) {
+
+        const T *src = in.ptr<T>(y);
+        float *bf = average_.ptr<float>(y);
+        T *dst = out.ptr<T>(y);
+
+        for (int k = 0; k < n; k++) {
+            const T x = src[k];
+            bf[k] = x * a + bf[k] * b;
+            dst[k] = cv::saturate_cast<T>(x - cv::saturate_cast<T>(bf[k]));
+        }
+    }
+}
+
+}      /* namespace oat */
@@ -0,0 +1,78 @@
+//******************************************************************************
+//* File:   RunningAverage.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_RUNNINGAVERAGE_H
+#define	OAT_RUNNINGAVERAGE_H
+
+#include <opencv2/core/mat.hpp>
+
+namespace oat {
+
+/**
+ * Running average background of a frame stream, as cv::accumulateWeighted,
+ * that is updated with each frame and subtracted from it in one banded pass.
+ *
+ * With 8 bit frames and a coefficient of at least MIN_FIXED_ALPHA, the
+ * average is kept in 8.8 fixed point, which halves its memory traffic. Below
+ * that, a Q15 coefficient is too coarse and the update too small to stay
+ * within one grey level of the float average, so smaller coefficients, and
+ * 16 bit frames, keep the average in float.
+ */
+class RunningAverage {
+public:
+
+    // Smallest coefficient that uses the fixed point average
+    static constexpr double MIN_FIXED_ALPHA {1.0 / 64.0};
+
+    /**
+     * Start the average at a frame.
+     * @param frame Initial background, of 8 or 16 bit depth
+     * @param alpha Weight of each new frame, in (0, 1]
+     */
+    void reset(const cv::Mat &frame, const double alpha);
+
+    /**
+     * Update the average with a frame, then subtract it, saturating at 0.
+     * @param in Frame, of the size and type of the initial background
+     * @param out Difference. Can be in.
+     */
+    void subtract(const cv::Mat &in, cv::Mat &out);
+
+    // The average, rounded to the frame depth
+    cv::Mat background(void) const;
+
+    bool empty(void) const { return average_.empty(); }
+
+private:
+
+    double alpha_ {0.0};
+    int depth_ {CV_8U};
+    bool fixed_ {false};
+
+    // 8.8 fixed point (CV_16U) or float (CV_32F) average
+    cv::Mat average_;
+
+    // Update and subtract a band of rows
+    void fixedRows(const cv::Mat &in, cv::Mat &out, const int y0, const int y1);
+    template <typename T>
+    void floatRows(const cv::Mat &in, cv::Mat &out, const int y0, const int y1);
+};
+
+}      /* namespace oat */
+#endif /* OAT_RUNNINGAVERAGE_H */
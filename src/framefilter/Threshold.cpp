@@ -23,17 +23,36 @@
 #include <opencv2/imgproc.hpp>
 #include <string>
 
+#include "../../lib/datatypes/PackedMask.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ProgramOptions.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
 
+// Intensity plane of a frame. GREY16 frames are thresholded at full depth.
+static void intensity(const cv::Mat &frame, cv::Mat &grey)
+{
+    const auto color = static_cast<const oat::Frame &>(frame).color();
+    if (color == oat::PIX_GREY16) {
+        grey = frame;
+        return;
+    }
+
+    auto conversion_code = oat::color_conv_code(color, oat::PIX_GREY);
+
+    if (conversion_code >= 0)
+        cv::cvtColor(frame, grey, conversion_code);
+    else
+        grey = frame;
+}
+
 Threshold::Threshold(const std::string &frame_source_address,
                      const std::string &frame_sink_address)
 : FrameFilter(frame_source_address, frame_sink_address)
 {
-    // Nothing
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
 }
 
 po::options_description Threshold::options() const
@@ -43,7 +62,13 @@ po::options_description Threshold::options() const
     local_opts.add_options()
         ("intensity,I", po::value<std::string>(),
          "Array of ints between 0 and 256, [min,max], specifying the "
-         "intensity passband.")
+         "intensity passband. GREY16 frames take bounds up to 65536.")
+        ("pack",
+         "If true, publish a MASK frame, with pixels in the passband set, "
+         "packed eight pixels to a byte instead of the frame with pixels "
+         "outside the passband zeroed. Detectors that accept MASK frames skip "
+         "thresholding, and the SINK carries an eighth of the bytes of a "
+         "GREY frame.")
         ;
 
     return local_opts;
@@ -59,25 +84,57 @@ void Threshold::applyConfiguration(const po::variables_map &vm,
         i_min_ = i[0];
         i_max_ = i[1];
 
-        if (i_min_ < 0 || i_min_> 256 || i_max_ < 0 || i_max_ > 256)
-           throw std::runtime_error("Values of intensity should be between 0 and 256.");
+        if (i_min_ < 0 || i_min_> 65536 || i_max_ < 0 || i_max_ > 65536)
+           throw std::runtime_error("Values of intensity should be between 0 and 65536.");
     }
+
+    // Packed output
+    oat::config::getValue<bool>(vm, config_table, "pack", pack_);
+}
+
+oat::FrameParams Threshold::outputParameters(const oat::FrameParams &in)
+{
+    if (!pack_)
+        return in;
+
+    // SINK is sized for packed masks
+    auto out = in;
+    out.cols = oat::packed_cols(static_cast<int>(in.cols));
+    out.type = oat::cv_type(oat::PIX_MASK);
+    out.color = oat::PIX_MASK;
+    return out;
 }
 
 void Threshold::filter(cv::Mat &frame)
 {
+    if (pack_) {
+        cv::Mat packed; // Changes the frame size
+        filterInto(frame, packed);
+        frame = packed;
+        return;
+    }
+
     cv::Mat grey_frame, thresh_frame;
+    intensity(frame, grey_frame);
 
-    auto conversion_code = oat::color_conv_code(
-        static_cast<oat::Frame &>(frame).color(), oat::PIX_GREY);
+    cv::inRange(grey_frame, i_min_, i_max_, thresh_frame);
+    frame.setTo(cv::Scalar(0, 0, 0), thresh_frame == 0);
+}
 
-    if (conversion_code >= 0)
-        cv::cvtColor(frame, grey_frame, conversion_code);
-    else
-        grey_frame = frame;
+void Threshold::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    cv::Mat grey_frame, thresh_frame;
+    intensity(in, grey_frame);
+
+    if (pack_) {
+        cv::inRange(grey_frame, i_min_, i_max_, mask_);
+        oat::packMask(mask_, out);
+        return;
+    }
 
     cv::inRange(grey_frame, i_min_, i_max_, thresh_frame);
-    frame.setTo(cv::Scalar(0, 0, 0), thresh_frame == 0);
+    out.setTo(cv::Scalar(0, 0, 0));
+    in.copyTo(out, thresh_frame);
 }
 
 } /* namespace oat */
@@ -43,11 +43,18 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    oat::FrameParams outputParameters(const oat::FrameParams &in) override;
     void filter(cv::Mat &frame) override;
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
 
     // Intensity threshold boundaries
     int i_min_ {0};
     int i_max_ {256};
+
+    // If true, publish the passband as a packed MASK rather than the pixels
+    // within it
+    bool pack_ {false};
+    cv::Mat mask_;
 };
 
 }      /* namespace oat */
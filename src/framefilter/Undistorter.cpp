@@ -19,15 +19,20 @@
 
 #include "Undistorter.h"
 
+#include <stdexcept>
 #include <string>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/calib3d.hpp>
+#ifdef HAVE_CUDA
+ #include <opencv2/cudawarping.hpp>
+#endif
 #include <cpptoml.h>
 
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
@@ -35,7 +40,8 @@ Undistorter::Undistorter(const std::string &source_name,
                          const std::string &sink_name)
 : FrameFilter(source_name, sink_name)
 {
-    // Nothing
+    // Filter straight from the source frame into the sink frame
+    zero_copy_ = true;
 }
 
 po::options_description Undistorter::options() const
@@ -49,6 +55,21 @@ po::options_description Undistorter::options() const
         ("distortion-coeffs,d", po::value<std::string>(),
          "Five to eight element float array, [x1,x2,x3,...], specifying lens "
          "distortion coefficients. Generated by oat-calibrate.")
+        ("undistortion-maps,m", po::value<std::string>(),
+         "Path to a remap table file generated by oat-calibrate. It is memory "
+         "mapped, so frames of the size it was made for are remapped without "
+         "first computing per-pixel maps. If given, camera-matrix and "
+         "distortion-coeffs are only needed for frames of other sizes.")
+#ifdef HAVE_CUDA
+        ("gpu",
+         "If true, remap frames on the GPU.")
+        ("gpu-index", po::value<size_t>(),
+         "Index of GPU card to use if gpu is set.")
+        ("device-frames",
+         "If true, keep frames published to SINK in GPU memory, so that "
+         "downstream GPU filters can read them without host copies. Only "
+         "GPU filters can then read from SINK. Requires gpu.")
+#endif
         ;
 
     return local_opts;
@@ -57,8 +78,15 @@ po::options_description Undistorter::options() const
 void Undistorter::applyConfiguration(const po::variables_map &vm,
                                      const config::OptionTable &config_table)
 {
+    // Precomputed maps
+    std::string map_path;
+    if (oat::config::getValue(vm, config_table, "undistortion-maps", map_path))
+        remap_file_ = oat::make_unique<oat::RemapFile>(map_path);
+
+    const bool need_model = !remap_file_;
+
     if (oat::config::getArray<double>(
-            vm, config_table, "distortion-coeffs", dist_coeff_, true)) {
+            vm, config_table, "distortion-coeffs", dist_coeff_, need_model)) {
 
         if (dist_coeff_.size() < 5 || dist_coeff_.size() > 8)
             throw (std::runtime_error("Distortion coefficients consist of 5 to 8 values."));
@@ -66,7 +94,7 @@ void Undistorter::applyConfiguration(const po::variables_map &vm,
 
     // Camera Matrix
     std::vector<double> K;
-    if (oat::config::getArray<double, 9>(vm, config_table, "camera-matrix", K, true)) {
+    if (oat::config::getArray<double, 9>(vm, config_table, "camera-matrix", K, need_model)) {
 
         camera_matrix_(0, 0) = K[0];
         camera_matrix_(0, 1) = K[1];
@@ -78,13 +106,119 @@ void Undistorter::applyConfiguration(const po::variables_map &vm,
         camera_matrix_(2, 1) = K[7];
         camera_matrix_(2, 2) = K[8];
     }
+
+#ifdef HAVE_CUDA
+    // GPU
+    oat::config::getValue<bool>(vm, config_table, "gpu", use_gpu_);
+    if (use_gpu_) {
+        size_t index = 0;
+        oat::config::getNumericValue<size_t>(
+            vm, config_table, "gpu-index", index, 0);
+        configureGPU(index);
+    }
+
+    // Device memory frames
+    oat::config::getValue<bool>(vm, config_table, "device-frames", device_frames_);
+    if (device_frames_ && !use_gpu_)
+        throw std::runtime_error("device-frames requires gpu.");
+    device_filter_ = use_gpu_;
+#endif
+
+    // Parameters changed
+    map1_.release();
+}
+
+void Undistorter::createMaps(const cv::Size &size)
+{
+    if (!map1_.empty() && map1_.size() == size)
+        return;
+
+    // Use the precomputed maps when they fit
+    if (remap_file_ && remap_file_->size() == size) {
+#ifdef HAVE_CUDA
+        if (use_gpu_) {
+            cv::convertMaps(remap_file_->map1(), remap_file_->map2(),
+                            map1_, map2_, CV_32FC1);
+            gpu_map_x_.upload(map1_);
+            gpu_map_y_.upload(map2_);
+            return;
+        }
+#endif
+        map1_ = remap_file_->map1();
+        map2_ = remap_file_->map2();
+        return;
+    }
+
+    if (dist_coeff_.empty())
+        throw std::runtime_error("Undistortion maps do not match the frame "
+                                 "size, and no distortion coefficients were "
+                                 "given to compute others.");
+
+    // Same maps as used internally by cv::undistort
+#ifdef HAVE_CUDA
+    if (use_gpu_) {
+        cv::initUndistortRectifyMap(camera_matrix_, dist_coeff_, cv::Mat(),
+                                    camera_matrix_, size, CV_32FC1,
+                                    map1_, map2_);
+        gpu_map_x_.upload(map1_);
+        gpu_map_y_.upload(map2_);
+        return;
+    }
+#endif
+
+    cv::initUndistortRectifyMap(camera_matrix_, dist_coeff_, cv::Mat(),
+                                camera_matrix_, size, CV_16SC2,
+                                map1_, map2_);
 }
 
 void Undistorter::filter(cv::Mat &frame)
 {
-    cv::Mat temp = frame.clone();
-    // TODO: too slow -- GPU implementation.
-    cv::undistort(temp, frame, camera_matrix_, dist_coeff_);
+    // Remapping cannot be done in place
+    filterInto(frame, undistorted_);
+    undistorted_.copyTo(frame);
+}
+
+void Undistorter::filterInto(const cv::Mat &in, cv::Mat &out)
+{
+    createMaps(in.size());
+
+#ifdef HAVE_CUDA
+    if (use_gpu_) {
+        gpu_frame_.upload(in);
+        filterDevice(gpu_frame_, gpu_undistorted_);
+        gpu_undistorted_.download(out);
+        return;
+    }
+#endif
+
+    cv::remap(in, out, map1_, map2_, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+#ifdef HAVE_CUDA
+void Undistorter::filterDevice(const cv::cuda::GpuMat &in,
+                               cv::cuda::GpuMat &out)
+{
+    createMaps(in.size());
+    cv::cuda::remap(in, out, gpu_map_x_, gpu_map_y_,
+                    cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+void Undistorter::configureGPU(const size_t index)
+{
+    // Determine if a compatible device is available
+    size_t num_devices = cv::cuda::getCudaEnabledDeviceCount();
+    if (num_devices < 1)
+        throw (std::runtime_error("No GPU found or OpenCV was compiled without CUDA support."));
+
+    if (index >= num_devices)
+        throw (std::runtime_error("Selected GPU index is invalid."));
+
+    cv::cuda::DeviceInfo gpu_info(index);
+    if (!gpu_info.isCompatible())
+        throw (std::runtime_error("Selected GPU is not compatible with OpenCV."));
+
+    cv::cuda::setDevice(index);
 }
+#endif
 
 } /* namespace oat */
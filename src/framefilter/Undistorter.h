@@ -20,6 +20,17 @@
 #ifndef OAT_UNDISTORTER_H
 #define	OAT_UNDISTORTER_H
 
+#include <memory>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/cvconfig.h>
+
+#ifdef HAVE_CUDA
+ #include <opencv2/core/cuda.hpp>
+#endif
+
+#include "../../lib/utility/RemapFile.h"
+
 #include "FrameFilter.h"
 
 namespace oat {
@@ -54,9 +65,49 @@ private:
      */
     void filter(cv::Mat &frame) override;
 
+    /**
+     * Apply undistortion filter without modifying the input.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterInto(const cv::Mat &in, cv::Mat &out) override;
+
+#ifdef HAVE_CUDA
+    /**
+     * Apply undistortion filter in device memory.
+     * @param in Unfiltered frame
+     * @param out Filtered frame
+     */
+    void filterDevice(const cv::cuda::GpuMat &in,
+                      cv::cuda::GpuMat &out) override;
+#endif
+
+    /**
+     * Compute the undistortion maps for frames of the given size, unless
+     * they already exist.
+     * @param size Frame size
+     */
+    void createMaps(const cv::Size &size);
+
     cv::Matx33d camera_matrix_ {cv::Matx33d::eye()};
     std::vector<double> dist_coeff_;
 
+    // Source pixel of each undistorted pixel, in the fixed point format that
+    // cv::remap is fastest with
+    cv::Mat map1_, map2_;
+    cv::Mat undistorted_;
+
+    // Precomputed maps from oat-calibrate, if any
+    std::unique_ptr<oat::RemapFile> remap_file_;
+
+#ifdef HAVE_CUDA
+    // GPU remap. Maps are uploaded once.
+    bool use_gpu_ {false};
+    cv::cuda::GpuMat gpu_map_x_, gpu_map_y_;
+    cv::cuda::GpuMat gpu_frame_, gpu_undistorted_;
+    void configureGPU(const size_t index);
+#endif
+
     static const std::map<std::string, int> commands_;
 };
 
@@ -34,8 +34,12 @@
 #include "BackgroundSubtractor.h"
 #include "BackgroundSubtractorMOG.h"
 #include "ColorConvert.h"
+#include "Decimator.h"
+#include "FrameFanout.h"
 #include "FrameFilter.h"
 #include "FrameMasker.h"
+#include "FusedFilter.h"
+#include "IntensityWindow.h"
 #include "Undistorter.h"
 #include "Threshold.h"
 
@@ -50,7 +54,12 @@ const char usage_type[] =
     "  mask: Binary mask\n"
     "  mog: Mixture of Gaussians background segmentation.\n"
     "  undistort: Correct for lens distortion using lens distortion model.\n"
-    "  thresh: Simple intensity threshold.";
+    "  thresh: Simple intensity threshold.\n"
+    "  fused: Mask, background subtraction and threshold in one pass.\n"
+    "  decimate: Keep every Nth frame and downscale it.\n"
+    "  fanout: Several filters sharing one SOURCE read. SINK is a comma\n"
+    "          separated list, one per filter.\n"
+    "  window: Map a range of 16-bit intensities onto 8-bit GREY frames.";
 
 const char usage_io[] =
     "SOURCE:\n"
@@ -103,6 +112,10 @@ int main(int argc, char *argv[]) {
     type_hash["undistort"] = 'd';
     type_hash["col"] = 'e';
     type_hash["thresh"] = 'f';
+    type_hash["fused"] = 'g';
+    type_hash["decimate"] = 'h';
+    type_hash["fanout"] = 'i';
+    type_hash["window"] = 'j';
 
     // The component itself
     std::string comp_name = "framefilt";
@@ -191,6 +204,26 @@ int main(int argc, char *argv[]) {
                     filter = std::make_shared<oat::Threshold>(source, sink);
                     break;
                 }
+                case 'g':
+                {
+                    filter = std::make_shared<oat::FusedFilter>(source, sink);
+                    break;
+                }
+                case 'h':
+                {
+                    filter = std::make_shared<oat::Decimator>(source, sink);
+                    break;
+                }
+                case 'i':
+                {
+                    filter = std::make_shared<oat::FrameFanout>(source, sink);
+                    break;
+                }
+                case 'j':
+                {
+                    filter = std::make_shared<oat::IntensityWindow>(source, sink);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
@@ -17,9 +17,13 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
 #include <thread>
 
 #include <cpptoml.h>
+#include "../../lib/shmemdf/MemoryPolicy.h"
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/IOFormat.h"
 
@@ -30,8 +34,12 @@ namespace oat {
 FileReader::FileReader(const std::string &sink_address)
 : FrameServer(sink_address)
 {
-    // Initialize time
-    tick_ = clock_.now();
+    // Nothing
+}
+
+FileReader::~FileReader()
+{
+    stopDecoding();
 }
 
 po::options_description FileReader::options() const
@@ -42,28 +50,107 @@ po::options_description FileReader::options() const
         ("video-file,f", po::value<std::string>(),
          "Path to video file to serve frames from.")
         ("fps,r", po::value<double>(),
-         "Frames to serve per second.")
+         "Frames to serve per second. Defaults to the frame rate of the "
+         "video file.")
+        ("spin", po::value<double>(),
+         "Microseconds before each frame deadline that are busy waited "
+         "instead of slept, so that frames are served at exact times at high "
+         "fps. Occupies a core while waiting. Defaults to 0.")
+        ("max-throughput",
+         "If true, serve frames as fast as SINK's readers allow instead of "
+         "at fps, e.g. for offline reanalysis. Frames still carry fps as "
+         "their sample rate.")
+        ("decode-ahead", po::value<size_t>(),
+         "Number of frames decoded ahead of those served, on a separate "
+         "thread, into preallocated frames. 0 decodes each frame when it is "
+         "served. Defaults to 0.")
+        ("decoder-options", po::value<std::string>(),
+         "FFmpeg capture options for the video decoder, as "
+         "'key;value|key;value', e.g. 'threads;4' for multi-threaded "
+         "decoding or 'video_codec;h264_cuvid' for a hardware decoder. Only "
+         "used by OpenCV's FFmpeg backend.")
+        ("segment", po::value<std::string>(),
+         "Two element array of unsigned ints, [first,last], specifying the "
+         "range of frame indices, first included and last excluded, to serve. "
+         "Frames keep their sample numbers in the whole file, so that the "
+         "results of segments processed in parallel can be merged by sample "
+         "number. Defaults to the whole file.")
+        ("sample-ranges", po::value<std::string>(),
+         "Array of unsigned ints, [first0,last0,first1,last1,...], "
+         "specifying ranges of sample numbers, first included and last "
+         "excluded, to serve in turn, e.g. around events. Ranges must be in "
+         "increasing order and must not overlap. The reader seeks straight "
+         "to each range, using the .idx frame index that oat-record writes "
+         "next to the video to find samples in files with gaps. Without an "
+         "index, sample s is frame s - 1. Cannot be used with segment.")
+        ("warm-up", po::value<size_t>(),
+         "Number of frames before the first of segment, or of each sample "
+         "range, that are served first, so that stateful components, e.g. "
+         "kalman filters or mog background models, have settled by the start "
+         "of the segment. Defaults to 0.")
         ("roi", po::value<std::string>(),
          "Four element array of unsigned ints, [x0,y0,width,height],"
          "defining a rectangular region of interest. Origin"
          "is upper left corner. ROI must fit within acquired"
          "frame size. Defaults to full video size.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
         ;
 
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+
     return local_opts;
 }
 
 void FileReader::applyConfiguration(const po::variables_map &vm,
                                     const config::OptionTable &config_table)
 {
+    // Decoder options are read by OpenCV's FFmpeg backend when the file is
+    // opened
+    std::string decoder_options;
+    if (oat::config::getValue(
+            vm, config_table, "decoder-options", decoder_options))
+        setenv("OPENCV_FFMPEG_CAPTURE_OPTIONS", decoder_options.c_str(), 1);
+
     // Video file
     std::string file_name;
     oat::config::getValue(vm, config_table, "video-file", file_name, true);
-    file_reader_.open(file_name);
+    if (!file_reader_.open(file_name))
+        throw std::runtime_error("File \"" + file_name + "\" could not be opened.");
+
+    // Frame index written alongside the file by oat-record, if any
+    oat::readFrameIndex(file_name, index_);
 
     // Frame rate
-    if (oat::config::getNumericValue(vm, config_table, "fps", frames_per_second_, 0.0))
-        calculateFramePeriod();
+    if (!oat::config::getNumericValue(
+            vm, config_table, "fps", frames_per_second_, 0.0))
+        frames_per_second_ = file_reader_.get(cv::CAP_PROP_FPS);
+
+    if (!(frames_per_second_ > 0.0))
+        throw std::runtime_error("The frame rate of \"" + file_name
+                                 + "\" is unknown. Set fps.");
+
+    calculateFramePeriod();
+
+    // Pacing
+    oat::config::getValue<bool>(
+        vm, config_table, "max-throughput", max_throughput_);
+
+    // Replay runs in the recording's time, not the wall clock's
+    if (oat::deterministic())
+        max_throughput_ = true;
+
+    double spin_us = 0.0;
+    if (oat::config::getNumericValue(vm, config_table, "spin", spin_us, 0.0))
+        pacer_.set_spin(std::chrono::duration<double, std::micro>(spin_us));
+
+    // Decode-ahead depth
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "decode-ahead", decode_ahead_, 0);
 
     // ROI
     std::vector<size_t> roi;
@@ -75,6 +162,88 @@ void FileReader::applyConfiguration(const po::variables_map &vm,
         region_of_interest_.width  = roi[2];
         region_of_interest_.height = roi[3];
     }
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+
+    // Segment
+    std::vector<uint64_t> segment;
+    if (oat::config::getArray<uint64_t, 2>(vm, config_table, "segment", segment)) {
+
+        if (segment[0] >= segment[1])
+            throw std::runtime_error("The first frame of segment must come "
+                                     "before the last.");
+
+        ranges_.emplace_back(segment[0], segment[1]);
+    }
+
+    // Sample ranges
+    std::vector<uint64_t> samples;
+    if (oat::config::getArray<uint64_t>(
+            vm, config_table, "sample-ranges", samples)) {
+
+        if (!ranges_.empty())
+            throw std::runtime_error("segment and sample-ranges cannot both "
+                                     "be specified.");
+
+        if (samples.empty() || samples.size() % 2 != 0)
+            throw std::runtime_error("sample-ranges must hold pairs of first "
+                                     "and last sample numbers.");
+
+        for (size_t i = 0; i < samples.size(); i += 2) {
+
+            if (samples[i] >= samples[i + 1])
+                throw std::runtime_error("The first sample of each range must "
+                                         "come before the last.");
+
+            if (i > 0 && samples[i] < samples[i - 1])
+                throw std::runtime_error("sample-ranges must be in increasing "
+                                         "order and must not overlap.");
+
+            ranges_.emplace_back(frameOf(samples[i]), frameOf(samples[i + 1]));
+        }
+    }
+
+    if (ranges_.empty())
+        ranges_.emplace_back(0, std::numeric_limits<uint64_t>::max());
+
+    // Warm-up frames, clipped to the start of the file and to the end of the
+    // previous range
+    size_t warm_up = 0;
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "warm-up", warm_up, 0);
+    for (size_t i = 0; i < ranges_.size(); i++) {
+        const uint64_t floor = i > 0 ? ranges_[i - 1].second : 0;
+        auto &first = ranges_[i].first;
+        first -= std::min<uint64_t>(warm_up, first - std::min(first, floor));
+    }
+
+    next_frame_ = ranges_[0].first;
+    end_frame_ = ranges_[0].second;
+}
+
+uint64_t FileReader::frameOf(const uint64_t sample) const
+{
+    if (index_.empty())
+        return sample > 0 ? sample - 1 : 0;
+
+    // First frame at or after the sample. Sample counts increase through
+    // the file.
+    auto it = std::lower_bound(
+        index_.begin(), index_.end(), sample,
+        [](const oat::FrameIndexEntry &e, const uint64_t s) {
+            return e.count < s;
+        });
+
+    return it == index_.end() ? index_.size()
+                              : static_cast<uint64_t>(it - index_.begin());
 }
 
 bool FileReader::connectToNode()
@@ -86,28 +255,152 @@ bool FileReader::connectToNode()
         example_frame = example_frame(region_of_interest_);
 
     frame_sink_.bind(frame_sink_address_,
-            example_frame.total() * example_frame.elemSize());
+            example_frame.total() * example_frame.elemSize(),
+            num_buffers_);
 
     shared_frame_ = frame_sink_.retrieve(
             example_frame.rows, example_frame.cols, example_frame.type(), PIX_BGR);
+    bindViews(example_frame.rows, example_frame.cols);
 
-    // Reset the video to the start
-    file_reader_.set(cv::CAP_PROP_POS_AVI_RATIO, 0);
+    // Move to the first served frame
+    if (next_frame_ == 0)
+        file_reader_.set(cv::CAP_PROP_POS_AVI_RATIO, 0);
+    else
+        file_reader_.set(cv::CAP_PROP_POS_FRAMES,
+                         static_cast<double>(next_frame_));
 
-    // Put the sample rate in the shared frame
+    // Put the sample rate in the shared frame. Served frames are numbered
+    // in process().
     shared_frame_.set_rate_hz(1.0 / frame_period_in_sec_.count());
 
+    if (decode_ahead_ > 0) {
+
+        // Frames in flight: those queued, the one being decoded and the one
+        // being published
+        oat::FrameParams params;
+        params.cols = example_frame.cols;
+        params.rows = example_frame.rows;
+        params.type = example_frame.type();
+        params.color = PIX_BGR;
+        pool_.reset(new FramePool(
+            decode_ahead_ + 2, params, MemoryPolicy::fromEnvironment()));
+        decoded_.reset(
+            new boost::lockfree::spsc_queue<size_t>(pool_->capacity()));
+        pool_frames_.assign(pool_->capacity(), 0);
+
+        // Start decoder thread
+        decoding_ = true;
+        decode_thread_ = std::thread(&FileReader::decode, this);
+    }
+
     return true;
 }
 
+bool FileReader::readFrame(cv::Mat &frame, uint64_t &index)
+{
+    // End of the served range. Any later range is sought to directly,
+    // without decoding the frames between.
+    while (next_frame_ >= end_frame_) {
+
+        if (++range_ >= ranges_.size())
+            return false;
+
+        const uint64_t position = next_frame_;
+        next_frame_ = ranges_[range_].first;
+        end_frame_ = ranges_[range_].second;
+
+        if (next_frame_ != position && next_frame_ < end_frame_)
+            file_reader_.set(cv::CAP_PROP_POS_FRAMES,
+                             static_cast<double>(next_frame_));
+    }
+
+    // Decoders write in place when the frame has the right size
+    cv::Mat out = use_roi_ ? decoded_frame_ : frame;
+    if (!file_reader_.read(out))
+        return false;
+    index = next_frame_++;
+
+    if (use_roi_) {
+        decoded_frame_ = out;
+        out = out(region_of_interest_);
+    }
+
+    if (frame.empty())
+        frame = out;
+    else if (out.data != frame.data)
+        out.copyTo(frame);
+
+    return true;
+}
+
+void FileReader::decode()
+{
+    size_t index;
+    while (decoding_) {
+
+        // Wait for a free pool frame
+        if (!pool_->acquire(index)) {
+            std::unique_lock<std::mutex> lock(decode_mutex_);
+            decode_cv_.wait(lock, [this] {
+                return pool_->available() > 0 || !decoding_;
+            });
+            continue;
+        }
+
+        cv::Mat frame = pool_->frame(index);
+        if (readFrame(frame, pool_frames_[index]))
+            decoded_->push(index);
+        else
+            end_of_file_ = true;
+
+        // Lock so that process() cannot miss the notification
+        { std::lock_guard<std::mutex> lock(decode_mutex_); }
+        decode_cv_.notify_all();
+
+        if (end_of_file_)
+            return;
+    }
+}
+
+void FileReader::stopDecoding()
+{
+    if (!decode_thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex_);
+        decoding_ = false;
+    }
+    decode_cv_.notify_all();
+    decode_thread_.join();
+}
+
 int FileReader::process()
 {
     cv::Mat frame;
-    if (!file_reader_.read(frame)) 
-        return 1;
+    size_t index {0};
+    uint64_t frame_index {0};
+    if (pool_) {
 
-    if (use_roi_ )
-        frame = frame(region_of_interest_);
+        // Wait for the decoder thread
+        {
+            std::unique_lock<std::mutex> lock(decode_mutex_);
+            decode_cv_.wait(lock, [this] {
+                return decoded_->read_available() > 0 || end_of_file_;
+            });
+        }
+
+        if (!decoded_->pop(index))
+            return 1;
+
+        frame = pool_->frame(index);
+        frame_index = pool_frames_[index];
+
+    } else {
+
+        if (!readFrame(frame, frame_index))
+            return 1;
+    }
 
     // START CRITICAL SECTION //
     ////////////////////////////
@@ -115,8 +408,23 @@ int FileReader::process()
     // Wait for sources to read
     frame_sink_.wait();
 
+    shared_frame_ = frame_sink_.retrieve();
     frame.copyTo(shared_frame_);
-    shared_frame_.incrementSampleCount();
+
+    // Frames keep the sample numbers they were recorded with, and their
+    // sample times too when the file is indexed, so that results can be
+    // merged with the recording's other streams
+    auto sample = shared_frame_.sample();
+    if (frame_index < index_.size()) {
+        const auto &e = index_[frame_index];
+        sample.set_count(e.count > 0 ? e.count - 1 : 0);
+        shared_frame_.set_sample(sample);
+        shared_frame_.incrementSampleCount(USec(e.microseconds));
+    } else {
+        sample.set_count(frame_index);
+        shared_frame_.set_sample(sample);
+        shared_frame_.incrementSampleCount();
+    }
 
     // Tell sources there is new data
     frame_sink_.post();
@@ -124,8 +432,15 @@ int FileReader::process()
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
-    std::this_thread::sleep_for(frame_period_in_sec_ - (clock_.now() - tick_));
-    tick_ = clock_.now();
+    // Pool frame can be decoded into again
+    if (pool_) {
+        pool_->release(index);
+        { std::lock_guard<std::mutex> lock(decode_mutex_); }
+        decode_cv_.notify_all();
+    }
+
+    if (!max_throughput_)
+        pacer_.wait();
 
     return 0;
 }
@@ -135,6 +450,7 @@ void FileReader::calculateFramePeriod()
     // Copy assignment provides automatic unit conversion
     std::chrono::duration<double> frame_period {1.0 / frames_per_second_};
     frame_period_in_sec_ = frame_period;
+    pacer_.set_period(frame_period_in_sec_);
 }
 
 } /* namespace oat */
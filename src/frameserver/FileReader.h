@@ -20,13 +20,25 @@
 #ifndef OAT_FILEREADER_H
 #define	OAT_FILEREADER_H
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include <boost/lockfree/spsc_queue.hpp>
 #include <opencv2/videoio.hpp>
 
 #include "FrameServer.h"
+#include "../buffer/FramePool.h"
+#include "../../lib/utility/FrameIndex.h"
+#include "../../lib/utility/Pacer.h"
 
 namespace oat {
 
@@ -34,6 +46,7 @@ class FileReader : public FrameServer {
 public:
 
     FileReader(const std::string &sink_name);
+    ~FileReader();
 
 private:
     // Component Interface
@@ -48,17 +61,49 @@ private:
     // Video file
     cv::VideoCapture file_reader_;
 
+    // Index of the file's frames by sample, written by oat-record. Empty if
+    // the file has none, in which case sample s is frame s - 1.
+    std::vector<oat::FrameIndexEntry> index_;
+    uint64_t frameOf(const uint64_t sample) const;
+
+    // Served ranges of the file, as frame indices, first included and last
+    // excluded. Frames before each range, if any, warm up stateful
+    // downstream components. The decoder seeks straight to each range.
+    std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+    size_t range_ {0};
+    uint64_t next_frame_ {0};
+    uint64_t end_frame_ {std::numeric_limits<uint64_t>::max()};
+
+    // Decode one frame, cropped to the region of interest
+    cv::Mat decoded_frame_;
+    bool readFrame(cv::Mat &frame, uint64_t &index);
+
+    // Decode-ahead. Frames are decoded on a separate thread into
+    // preallocated pool frames, whose indices are queued for process() to
+    // publish along with the index in the file of the frame each holds.
+    size_t decode_ahead_ {0};
+    std::unique_ptr<FramePool> pool_;
+    std::vector<uint64_t> pool_frames_;
+    std::unique_ptr<boost::lockfree::spsc_queue<size_t>> decoded_;
+    std::thread decode_thread_;
+    std::atomic<bool> decoding_ {false};
+    std::atomic<bool> end_of_file_ {false};
+    std::mutex decode_mutex_;
+    std::condition_variable decode_cv_;
+    void decode(void);
+    void stopDecoding(void);
+
     // Playback speed
-    double frames_per_second_;
+    double frames_per_second_ {0.0};
+    bool max_throughput_ {false};
     void calculateFramePeriod(void);
 
     // Region of interest
     cv::Rect_<size_t> region_of_interest_;
 
     // Frame generation clock
-    std::chrono::high_resolution_clock clock_;
-    std::chrono::duration<double> frame_period_in_sec_;
-    std::chrono::high_resolution_clock::time_point tick_;
+    std::chrono::duration<double> frame_period_in_sec_ {0.0};
+    oat::Pacer pacer_;
 };
 
 }       /* namespace oat */
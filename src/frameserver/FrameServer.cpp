@@ -19,6 +19,7 @@
 
 #include "FrameServer.h"
 
+#include <sstream>
 #include <string>
 
 namespace oat {
@@ -29,4 +30,125 @@ FrameServer::FrameServer(const std::string &frame_sink_address) :
 {
     // Nothing
 }
+
+void FrameServer::addViewOptions(po::options_description &opts)
+{
+    opts.add_options()
+        ("views", po::value<std::string>(),
+         "TOML table of views to publish alongside the frame SINK, e.g. "
+         "{arena1=[0,0,320,240],arena2=[320,0,320,240]}. Each key is the "
+         "address of a view node and each value a four element array, "
+         "[x0,y0,width,height], defining a rectangle of the served frames. "
+         "Components reading a view read that rectangle in place, without a "
+         "copy, in step with the frame SINK. Positions detected in a view "
+         "are in its own coordinates.")
+        ;
+}
+
+void FrameServer::configureViews(const po::variables_map &vm,
+                                 const config::OptionTable &config_table)
+{
+    // View table, from the command line or the configuration table
+    auto table = config_table;
+    if (vm.count("views")) {
+        std::istringstream toml {"views=" + vm["views"].as<std::string>()};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    }
+
+    config::OptionTable views;
+    if (!oat::config::getTable(table, "views", views))
+        return;
+
+    for (const auto &v : *views) {
+
+        std::vector<size_t> rect;
+        oat::config::getArray<size_t, 4>(po::variables_map(), views, v.first, rect);
+
+        if (v.first == frame_sink_address_)
+            throw std::runtime_error("View '" + v.first + "' cannot have the "
+                                     "address of the frame SINK.");
+
+        views_.emplace_back(v.first,
+                            cv::Rect(rect[0], rect[1], rect[2], rect[3]));
+    }
+}
+
+void FrameServer::bindViews(const int rows, const int cols)
+{
+    const cv::Rect frame(0, 0, cols, rows);
+
+    for (const auto &v : views_) {
+
+        if ((v.second & frame) != v.second || v.second.area() == 0)
+            throw std::runtime_error("View '" + v.first + "' must be a "
+                                     "non-empty rectangle within the "
+                                     + std::to_string(cols) + "x"
+                                     + std::to_string(rows) + " served frames.");
+
+        view_sinks_.emplace_back(new oat::Sink<oat::Frame>());
+        view_sinks_.back()->bindView(v.first, frame_sink_address_, v.second);
+    }
+}
+
+void FrameServer::addPyramidOptions(po::options_description &opts)
+{
+    opts.add_options()
+        ("pyramid", po::value<int>(),
+         "Number of pyramid levels, between 1 and 3, to publish alongside "
+         "each frame. Level n is the frame halved n times. Levels are "
+         "computed once per frame, before it is published, so that "
+         "components reading a level, e.g. a detector's downsample, do not "
+         "each scale the frame themselves.")
+        ("pyramid-filter", po::value<std::string>(),
+         "Filter that pyramid levels are halved with, either 'area', which "
+         "averages each 2x2 block, or 'gauss', which blurs before halving as "
+         "cv::pyrDown does. Defaults to area.")
+        ;
+}
+
+void FrameServer::configurePyramid(const po::variables_map &vm,
+                                   const config::OptionTable &config_table)
+{
+    int levels = 0;
+    if (!oat::config::getNumericValue<int>(
+            vm, config_table, "pyramid", levels, 1, MAX_PYRAMID_LEVELS))
+        return;
+
+    auto filter = PyramidFilter::AREA;
+    std::string f;
+    if (oat::config::getValue<std::string>(
+            vm, config_table, "pyramid-filter", f))
+        filter = str_pyramid_filter(f);
+
+    // Levels above the deepest are included by the sink
+    frame_sink_.set_planes(
+        1u << static_cast<size_t>(pyramid_plane(levels)), filter);
+}
+
+void FrameServer::addWarmupOptions(po::options_description &opts)
+{
+    opts.add_options()
+        ("prefault",
+         "If true, fault in every page of the frame SINK's buffers when it "
+         "is bound, as OAT_PREFAULT=1 does, rather than on the first writes "
+         "to each buffer. The camera is started while this is done.")
+        ("discard", po::value<size_t>(),
+         "Number of frames, between 0 and 100, to capture and discard "
+         "before the first frame is served, so that the first frames that "
+         "downstream components see are not taken while exposure and the "
+         "driver settle. Defaults to 0.")
+        ;
+}
+
+void FrameServer::configureWarmup(const po::variables_map &vm,
+                                  const config::OptionTable &config_table)
+{
+    bool prefault = false;
+    if (oat::config::getValue<bool>(vm, config_table, "prefault", prefault))
+        frame_sink_.set_prefault(prefault);
+
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "discard", warmup_frames_, 0, 100);
+}
 } /* namespace oat */
@@ -20,13 +20,17 @@
 #ifndef OAT_FRAMESERVER_H
 #define	OAT_FRAMESERVER_H
 
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/program_options.hpp>
 #include <opencv2/core.hpp>
 
 #include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
+#include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/datatypes/Frame.h"
 #include "../../lib/shmemdf/Sink.h"
 
@@ -59,9 +63,77 @@ protected:
     const std::string frame_sink_address_;
     oat::Sink<oat::Frame> frame_sink_;
 
+    // Number of shared frame buffers. If greater than 1, the sink node is
+    // operated as a ring and slow readers do not block capture until all
+    // buffers are full.
+    size_t num_buffers_ {1};
+
+    // Number of frames captured and discarded before the first one is
+    // served, while exposure and the driver's buffers settle
+    size_t warmup_frames_ {0};
+
     // Currently acquired, shared frame
     //bool frame_empty_ {true};
     oat::Frame shared_frame_;
+
+    /**
+     * @brief Add the views option, which publishes rectangles of the served
+     * frames as view nodes of their own.
+     * @param opts Options of the frame server.
+     */
+    static void addViewOptions(po::options_description &opts);
+
+    /**
+     * @brief Read the views option.
+     * @param vm Program option variable map obtained from command line input.
+     * @param config_table Potentially empty table from a TOML config file.
+     */
+    void configureViews(const po::variables_map &vm,
+                        const config::OptionTable &config_table);
+
+    /**
+     * @brief Bind a view node for each configured view. Must follow binding
+     * frame_sink_.
+     * @param rows Rows of the served frames.
+     * @param cols Columns of the served frames.
+     */
+    void bindViews(const int rows, const int cols);
+
+    /**
+     * @brief Add the pyramid options, which publish halved levels of the
+     * served frames in the frame SINK's node.
+     * @param opts Options of the frame server.
+     */
+    static void addPyramidOptions(po::options_description &opts);
+
+    /**
+     * @brief Read the pyramid options. Must precede binding frame_sink_.
+     * @param vm Program option variable map obtained from command line input.
+     * @param config_table Potentially empty table from a TOML config file.
+     */
+    void configurePyramid(const po::variables_map &vm,
+                          const config::OptionTable &config_table);
+
+    /**
+     * @brief Add the warm-up options, which prefault the frame SINK's
+     * segment and discard the camera's first frames.
+     * @param opts Options of the frame server.
+     */
+    static void addWarmupOptions(po::options_description &opts);
+
+    /**
+     * @brief Read the warm-up options. Must precede binding frame_sink_.
+     * @param vm Program option variable map obtained from command line input.
+     * @param config_table Potentially empty table from a TOML config file.
+     */
+    void configureWarmup(const po::variables_map &vm,
+                         const config::OptionTable &config_table);
+
+private:
+    // Views of the served frames, by address. They share the frame sink's
+    // pixels, so serving them costs no copies.
+    std::vector<std::pair<std::string, cv::Rect>> views_;
+    std::vector<std::unique_ptr<oat::Sink<oat::Frame>>> view_sinks_;
 };
 
 }       /* namespace oat */
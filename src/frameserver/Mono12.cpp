@@ -0,0 +1,97 @@
+//******************************************************************************
+//* File:   Mono12.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "Mono12.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+namespace oat {
+
+// Rows per parallel band
+static constexpr int BAND_ROWS {32};
+
+namespace {
+
+// Unpack the pairs of a row. The byte holding the low nibbles of a pair is
+// at offset LOW, and the high bits of the second pixel at offset 3 - LOW.
+// Indexing by the pair, rather than walking pointers, lets the compiler turn
+// the loop into strided vector loads.
+template <int LOW>
+void unpackRow(const uint8_t *src, uint16_t *dst, const int pairs)
+{
+    constexpr int HIGH1 = 3 - LOW;
+    for (int i = 0; i < pairs; i++) {
+        const uint16_t b0 = src[3 * i];
+        const uint16_t lo = src[3 * i + LOW];
+        const uint16_t b1 = src[3 * i + HIGH1];
+        dst[2 * i] = static_cast<uint16_t>(b0 << 4 | (lo & 0x0F));
+        dst[2 * i + 1] = static_cast<uint16_t>(b1 << 4 | lo >> 4);
+    }
+}
+
+template <int LOW>
+void unpackRows(const cv::Mat &packed, cv::Mat &unpacked, int y0, int y1)
+{
+    const int cols = unpacked.cols;
+    const int pairs = cols / 2;
+
+    for (int y = y0; y < y1; y++) {
+
+        const uint8_t *src = packed.ptr<uint8_t>(y);
+        uint16_t *dst = unpacked.ptr<uint16_t>(y);
+        unpackRow<LOW>(src, dst, pairs);
+
+        // A trailing pixel has a group of its own
+        if (cols & 1) {
+            const uint16_t b0 = src[3 * pairs];
+            const uint16_t lo = src[3 * pairs + LOW];
+            dst[cols - 1] = static_cast<uint16_t>(b0 << 4 | (lo & 0x0F));
+        }
+    }
+}
+
+} /* namespace */
+
+void unpackMono12(const cv::Mat &packed,
+                  cv::Mat &unpacked,
+                  const Mono12Packing packing)
+{
+    if (packed.type() != CV_8UC1 || unpacked.type() != CV_16UC1
+        || packed.rows < unpacked.rows
+        || packed.cols < 3 * ((unpacked.cols + 1) / 2))
+        throw std::runtime_error("12-bit packed frame does not fit the "
+                                 "unpacked frame.");
+
+    const int bands = (unpacked.rows + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &r) {
+        const int y0 = r.start * BAND_ROWS;
+        const int y1 = std::min(unpacked.rows, r.end * BAND_ROWS);
+        if (packing == Mono12Packing::GIGE_VISION)
+            unpackRows<1>(packed, unpacked, y0, y1);
+        else
+            unpackRows<2>(packed, unpacked, y0, y1);
+    });
+}
+
+} /* namespace oat */
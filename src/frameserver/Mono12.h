@@ -0,0 +1,53 @@
+//******************************************************************************
+//* File:   Mono12.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_MONO12_H
+#define	OAT_MONO12_H
+
+#include <opencv2/core/mat.hpp>
+
+namespace oat {
+
+/**
+ * @brief Byte layouts of 12-bit pixels packed two to three bytes. Both
+ * store the high 8 bits of each pixel in a byte of its own and share the
+ * third byte between the low nibbles.
+ */
+enum class Mono12Packing {
+    GIGE_VISION, //!< P0[11:4], P1[3:0] P0[3:0], P1[11:4], e.g. FlyCapture MONO12
+    MIPI         //!< P0[11:4], P1[11:4], P1[3:0] P0[3:0], e.g. V4L2 Y12P
+};
+
+/**
+ * @brief Unpack 12-bit pixels into a 16-bit frame. Pixels keep their 12-bit
+ * values, 0 to 4095. Rows are unpacked in parallel bands by a loop the
+ * compiler vectorizes.
+ * @param packed CV_8UC1 frame of packed rows, each holding at least
+ * 3 * ceil(cols / 2) bytes.
+ * @param unpacked CV_16UC1 output, allocated by the caller. Its size sets the
+ * number of pixels unpacked.
+ * @param packing Byte layout of packed.
+ */
+void unpackMono12(const cv::Mat &packed,
+                  cv::Mat &unpacked,
+                  const Mono12Packing packing);
+
+}      /* namespace oat */
+#endif /* OAT_MONO12_H */
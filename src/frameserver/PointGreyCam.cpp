@@ -19,9 +19,13 @@
 
 #include "PointGreyCam.h"
 #include "PointGreySettings.h"
+#include "Mono12.h"
 
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -30,16 +34,147 @@
 #include <thread>
 #include <unistd.h>
 
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+
 #include "FlyCapture2.h"
 #include <cpptoml.h>
 #include <opencv2/opencv.hpp>
 
+#include "../../lib/shmemdf/Telemetry.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
+// Used by reference for sample clock precision
+template <typename T>
+constexpr int64_t PointGreyCam<T>::IEEE_1394_TICK_NS;
+
+// GigE stream packets carry IP, UDP and GVSP headers, and occupy the wire
+// for their Ethernet header, FCS, preamble and inter-frame gap as well
+static constexpr double GVSP_HEADER_BYTES {36.0};
+static constexpr double ETHERNET_FRAMING_BYTES {38.0};
+
+// On a 1 Gb/s link a byte takes 8 ns, which is also one tick of the clock
+// that the camera counts inter-packet delays in
+static constexpr double BYTE_NS {8.0};
+static constexpr double PACKET_DELAY_TICK_NS {8.0};
+
+// Fraction of the frame period that automatic packet delays spread each
+// frame over, leaving the rest for other cameras on a shared link
+static constexpr double FRAME_SPREAD {0.8};
+
+// Receive buffer size below which the kernel drops stream packets at jumbo
+// frame rates (TAN2012004)
+static constexpr long MIN_RMEM_BYTES {1048576};
+
+// Host network interface on the camera's subnet, or "" if there is none
+static std::string cameraInterface(const pg::CameraInfo &info)
+{
+    uint32_t ip = 0;
+    for (int i = 0; i < 4; i++)
+        ip = (ip << 8) | info.ipAddress.octets[i];
+
+    ifaddrs *addrs = nullptr;
+    if (getifaddrs(&addrs) != 0)
+        return "";
+
+    std::string name;
+    for (auto a = addrs; a != nullptr; a = a->ifa_next) {
+
+        if (a->ifa_addr == nullptr || a->ifa_netmask == nullptr
+            || a->ifa_addr->sa_family != AF_INET)
+            continue;
+
+        const auto host = ntohl(
+            reinterpret_cast<sockaddr_in *>(a->ifa_addr)->sin_addr.s_addr);
+        const auto mask = ntohl(
+            reinterpret_cast<sockaddr_in *>(a->ifa_netmask)->sin_addr.s_addr);
+
+        if ((host & mask) == (ip & mask)) {
+            name = a->ifa_name;
+            break;
+        }
+    }
+
+    freeifaddrs(addrs);
+    return name;
+}
+
+// NUMA node of a network interface, or -1 if it has none
+static int interfaceNode(const std::string &iface)
+{
+    int node = -1;
+    std::ifstream f("/sys/class/net/" + iface + "/device/numa_node");
+    if (!(f >> node))
+        return -1;
+
+    return node;
+}
+
+// CPUs of a NUMA node, read from a list such as 0-7,16-23
+static std::vector<int> nodeCpus(const int node)
+{
+    std::ifstream f("/sys/devices/system/node/node" + std::to_string(node)
+                    + "/cpulist");
+    std::string list;
+    std::getline(f, list);
+
+    std::vector<int> cpus;
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+
+        if (range.empty())
+            continue;
+
+        const auto dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos
+                       ? first : std::stoi(range.substr(dash + 1));
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+    }
+
+    return cpus;
+}
+
+// Bits per pixel of the formats a camera transmits in
+static double transmittedBits(const pg::PixelFormat format)
+{
+    switch (format) {
+        case pg::PIXEL_FORMAT_MONO12:
+        case pg::PIXEL_FORMAT_RAW12: return 12.0;
+        case pg::PIXEL_FORMAT_MONO16:
+        case pg::PIXEL_FORMAT_RAW16: return 16.0;
+        case pg::PIXEL_FORMAT_RGB8: return 24.0;
+        default: return 8.0;
+    }
+}
+
+// Inter-packet delay, in camera ticks, that spreads a frame over
+// FRAME_SPREAD of the frame period
+static unsigned int spreadingPacketDelay(const double frame_bytes,
+                                         const double fps,
+                                         const unsigned int packet_size)
+{
+    if (fps <= 0.0 || packet_size <= GVSP_HEADER_BYTES)
+        return 0;
+
+    const double packets
+        = std::ceil(frame_bytes / (packet_size - GVSP_HEADER_BYTES));
+    const double packet_ns = (packet_size + ETHERNET_FRAMING_BYTES) * BYTE_NS;
+    const double gap_ns = FRAME_SPREAD * 1.0e9 / fps / packets - packet_ns;
+
+    return gap_ns > 0.0
+         ? static_cast<unsigned int>(gap_ns / PACKET_DELAY_TICK_NS) : 0;
+}
+
 // Initialize Pixel map
 template <typename T>
 const typename PointGreyCam<T>::PixelMap PointGreyCam<T>::pix_map_ =
@@ -47,7 +182,17 @@ const typename PointGreyCam<T>::PixelMap PointGreyCam<T>::pix_map_ =
     {PIX_GREY,
         std::make_tuple(pg::PIXEL_FORMAT_MONO8, pg::PIXEL_FORMAT_MONO8, CV_8UC1)},
     {PIX_BGR,
-        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_BGR, CV_8UC3)}
+        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_BGR, CV_8UC3)},
+    {PIX_BAYER_RG,
+        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_RAW8, CV_8UC1)},
+    {PIX_BAYER_GR,
+        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_RAW8, CV_8UC1)},
+    {PIX_BAYER_GB,
+        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_RAW8, CV_8UC1)},
+    {PIX_BAYER_BG,
+        std::make_tuple(pg::PIXEL_FORMAT_RAW8, pg::PIXEL_FORMAT_RAW8, CV_8UC1)},
+    {PIX_GREY16,
+        std::make_tuple(pg::PIXEL_FORMAT_MONO12, pg::PIXEL_FORMAT_MONO16, CV_16UC1)}
 };
 
 template <typename T>
@@ -63,6 +208,8 @@ template <typename T>
 PointGreyCam<T>::~PointGreyCam()
 {
     // Ignore error return values -- throwing exception unsafe in destructor
+    if (use_frame_buffer_)
+        camera_.WriteRegister(IMAGE_RETRANSMIT, frame_buffer_reg_ & ~HOLD_IMAGE);
     camera_.StopCapture();
     camera_.Disconnect();
 }
@@ -91,7 +238,12 @@ po::options_description PointGreyCam<T>::options() const
          "Pixel color format. Defaults to BRG.\n"
          "Values:\n"
          "  GREY: \t 8-bit Greyscale image.\n"
-         "  BRG: \t8-bit, 3-chanel, BGR Color image.\n")
+         "  BRG: \t8-bit, 3-chanel, BGR Color image.\n"
+         "  BAYER: \t8-bit raw sensor mosaic, published as it is read out "
+         "and demosaiced only by the components that need color. A third of "
+         "the size of BGR. Only works for color sensors.\n"
+         "  GREY16: \t12-bit Greyscale image, read out packed and unpacked to "
+         "16 bits per pixel holding values from 0 to 4095.\n")
         ("gain,g", po::value<double>(),
          "Sensor gain value, specified in dB. Defaults to auto.")
         ("strobe-pin,S", po::value<size_t>(),
@@ -133,8 +285,46 @@ po::options_description PointGreyCam<T>::options() const
         ("auto-white-balance,W",
          "If specified, the white balance will be adjusted by the camera. "
          "This option overrides manual white-balance specification.")
+        ("buffers", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
+        ("frame-buffer",
+         "If specified, frames are held in the camera's on-board frame buffer "
+         "and transmitted one at a time as the host asks for them, so that "
+         "frames are not lost while the host falls behind. Samples are "
+         "numbered by the camera's frame counter, so frames lost when the "
+         "on-board buffer overflows leave gaps in the sample count. Torn "
+         "images are re-transmitted once. Cannot be used with enforce-fps.")
+        ("packet-size", po::value<size_t>(),
+         "GigE only. Stream packet size in bytes, between 576 and 9000. Sizes "
+         "above 1500 are jumbo frames, which the host's network interface "
+         "must be configured to accept. Defaults to the largest size that "
+         "the path from the camera to the host carries, which is discovered "
+         "on startup.")
+        ("packet-delay", po::value<int>(),
+         "GigE only. Delay between stream packets, in 8 ns ticks. Longer "
+         "delays spread each frame over more of the frame period, so that "
+         "cameras sharing a link or switch do not overflow its buffers. "
+         "Defaults to the delay that spreads each frame over 80% of the "
+         "frame period at the configured frame rate and region of interest.")
+        ("driver-buffers", po::value<size_t>(),
+         "Number of image buffers the driver receives frames into. More "
+         "buffers ride out longer stalls of the host before frames are "
+         "dropped, at the cost of memory. Defaults to the driver's default.")
+        ("nic-node",
+         "GigE only. If true, pin the grab thread, and the receive threads "
+         "that the driver starts with capture, to the CPUs of the NUMA node "
+         "of the network interface that the camera is reached through, so "
+         "that packets are never handled across nodes. Replaces cpus for "
+         "the grab thread. Ignored if the interface has no NUMA node.")
         ;
 
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+    addWarmupOptions(local_opts);
+
     return local_opts;
 }
 
@@ -169,7 +359,7 @@ void PointGreyCam<T>::applyConfiguration(
     // Pixel color
     std::string col;
     if (oat::config::getValue<std::string>(vm, config_table, "color", col))
-        pix_col_ = oat::str_color(col);
+        pix_col_ = col == "BAYER" ? sensorMosaic() : oat::str_color(col);
 
     // Determine if color conversion is required
     if (std::get<PG_FROM>(pix_map_.at(pix_col_)) != std::get<PG_TO>(pix_map_.at(pix_col_)))
@@ -214,14 +404,16 @@ void PointGreyCam<T>::applyConfiguration(
         setupImageFormat();
     }
 
-    // TODO: Onboard frame buffer
-    //int retries = 0;
-    //if (oat::config::getValue(vm, config_table, "retries", retries, 0, false))
-    //    setupCameraFrameBuffer(retries)
-
     // Enforce FPS
     oat::config::getValue<bool>(vm, config_table, "enforce_fps", enforce_fps_, false);
 
+    // On-camera frame buffer
+    oat::config::getValue<bool>(
+        vm, config_table, "frame-buffer", use_frame_buffer_);
+
+    if (use_frame_buffer_ && enforce_fps_)
+        throw rte("frame-buffer and enforce-fps cannot be used together.");
+
     // Strobe pin (configure before trigger to look for pin conflict)
     int strobe_pin = 1;
     oat::config::getNumericValue<int>(
@@ -248,13 +440,43 @@ void PointGreyCam<T>::applyConfiguration(
 
     setupAsyncTrigger(trigger_mode, trigger_rising, trigger_pin);
 
-    // Start the configured camera
-    setupGrabSettings();
-    startCapture();
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
 
-    // TODO: Has hack that requires camera to be running in order to function
-    // Embed timestamp with frames
-    setupEmbeddedImageData();
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+
+    // Prefaulting and warm-up frames
+    configureWarmup(vm, config_table);
+
+    // Triggered frames are samples that cannot be thrown away
+    if (warmup_frames_ > 0 && use_trigger_)
+        throw rte("discard cannot be used with a trigger mode.");
+
+    // Receive path
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "packet-size", packet_size_, 576, 9000);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "packet-delay", packet_delay_, 0);
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "driver-buffers", driver_buffers_, 1);
+    oat::config::getValue<bool>(
+        vm, config_table, "nic-node", pin_to_interface_node_);
+
+    // Stream channels are sized for the image format and frame rate set above
+    setupStreamChannels();
+
+    // Receive threads that the driver starts inherit the placement
+    if (pin_to_interface_node_)
+        pinToInterfaceNode();
+
+    // The configured camera is started in connectToNode(), while its SINK
+    // is bound
+    setupGrabSettings();
 }
 
 template <typename T>
@@ -396,41 +618,52 @@ void PointGreyCam<T>::setupPixelBinning(size_t x_bin, size_t y_bin)
     static_assert(sizeof(T) == 0, "Not a valid PoinGreyCam type.");
 }
 
-// template<typename T>
-// int PointGreyCam<T>::setupCameraFrameBuffer() {
-//
-//    // If requested
-//    if (use_frame_buffer_) {
-//
-//        unsigned int image_retransmit_reg;
-//        const unsigned int image_retransmit_addr = 0x634;
-//
-//        pg::Error error = camera_.ReadRegister(image_retransmit_addr,
-//                                              &image_retransmit_reg);
-//        if (error != pg::PGRERROR_OK) {
-//            throw (rte(error.GetDescription()));
-//        }
-//
-//        std::cout << "Setting up camera_ frame buffering...\n";
-//        // Enable framebuffer
-//        image_retransmit_reg |= 1 << 0;
-//
-//        // Direct image data through frame buffer
-//        image_retransmit_reg |= 1 << 1;
-//
-//        error = camera_.WriteRegister(image_retransmit_addr,
-//        image_retransmit_reg);
-//        if (error != pg::PGRERROR_OK) {
-//            std::cout << "Warning: camera_ frame buffering requested, but this
-//            "
-//                         "camera_ does not support frame buffering.\n"
-//                      << "Request ignored.\n";
-//            use_frame_buffer_ = false;
-//        }
-//    }
-//
-//    return 0;
-//}
+template <typename T>
+void PointGreyCam<T>::setupCameraFrameBuffer()
+{
+    std::cout << "Setting up camera frame buffer...";
+
+    pg::Error error
+        = camera_.ReadRegister(IMAGE_RETRANSMIT, &frame_buffer_reg_);
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+
+    if (!(frame_buffer_reg_ & FRAME_BUFFER_PRESENT))
+        throw (rte("This camera does not have an on-board frame buffer."));
+
+    // Store images to the frame buffer rather than transmitting them. Each
+    // write of the image count then transmits one image (TAN2007004).
+    frame_buffer_reg_ |= HOLD_IMAGE;
+    error = camera_.WriteRegister(IMAGE_RETRANSMIT, frame_buffer_reg_);
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+
+    frame_buffer_size_ = (frame_buffer_reg_ >> 8) & 0xFF;
+
+    std::cout << "holding up to " << frame_buffer_size_ << " frames.\n";
+}
+
+template <typename T>
+unsigned int PointGreyCam<T>::bufferedImages()
+{
+    unsigned int reg;
+    pg::Error error = camera_.ReadRegister(IMAGE_RETRANSMIT, &reg);
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+
+    return reg & 0xFF;
+}
+
+template <typename T>
+void PointGreyCam<T>::transmitBufferedImage(unsigned int num_images)
+{
+    // 0 re-transmits the last image, 1 transmits the next one, and n > 1
+    // skips n - 1 images first
+    pg::Error error = camera_.WriteRegister(
+        IMAGE_RETRANSMIT, (frame_buffer_reg_ & ~0xFFu) | (num_images & 0xFF));
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+}
 
 // TODO: Required??
 template <typename T>
@@ -540,7 +773,8 @@ void PointGreyCam<T>::setupGrabSettings()
     flyCapConfig.grabTimeout = 5;
     flyCapConfig.grabMode = pg::DROP_FRAMES;
     flyCapConfig.highPerformanceRetrieveBuffer = true;
-    //flyCapConfig.numBuffers = 1;
+    if (driver_buffers_ > 0)
+        flyCapConfig.numBuffers = static_cast<unsigned int>(driver_buffers_);
 
     error = camera_.SetConfiguration(&flyCapConfig);
     if (error != pg::PGRERROR_OK)
@@ -565,6 +799,151 @@ void PointGreyCam<T>::startCapture()
 
     acquisition_started_ = true;
     std::cout << "started.\n";
+
+    // Transport losses are counted from here
+    if (camera_.GetStats(&stats_start_) != pg::PGRERROR_OK)
+        stats_start_ = pg::CameraStats();
+}
+
+template <typename T>
+void PointGreyCam<T>::bindAndStart(const size_t bytes)
+{
+    // The starting thread inherits the grab thread's CPU placement, and so
+    // do the receive threads that the driver starts with capture
+    std::exception_ptr error {nullptr};
+    std::thread starter([this, &error] {
+        try {
+            startCamera();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+
+    try {
+        frame_sink_.bind(frame_sink_address_, bytes, num_buffers_);
+    } catch (...) {
+        starter.join();
+        throw;
+    }
+
+    starter.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    image_bytes_ = bytes;
+}
+
+template <typename T>
+void PointGreyCam<T>::startCamera()
+{
+    startCapture();
+
+    // TODO: Has hack that requires camera to be running in order to function
+    // Embed timestamp with frames
+    setupEmbeddedImageData();
+
+    // Warm-up frames are retrieved without touching the sample clock. Those
+    // held on the camera are never sent, so they are discarded first.
+    size_t discarded = 0;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (discarded < warmup_frames_
+           && std::chrono::steady_clock::now() < deadline) {
+
+        const pg::Error error = camera_.RetrieveBuffer(&raw_image_);
+        if (error == pg::PGRERROR_OK)
+            discarded++;
+        else if (error != pg::PGRERROR_TIMEOUT)
+            throw (rte(error.GetDescription()));
+    }
+
+    if (discarded < warmup_frames_)
+        std::cerr << oat::Warn("Only " + std::to_string(discarded) + " of "
+                               + std::to_string(warmup_frames_)
+                               + " warm-up frames arrived.\n");
+
+    // Frames are held on the camera from here on
+    if (use_frame_buffer_)
+        setupCameraFrameBuffer();
+}
+
+template <typename T>
+void PointGreyCam<T>::setupStreamChannels()
+{
+    if (packet_size_ > 0 || packet_delay_ >= 0 || pin_to_interface_node_)
+        throw (rte("packet-size, packet-delay and nic-node apply only to GigE "
+                   "cameras."));
+}
+
+template <typename T>
+void PointGreyCam<T>::pinToInterfaceNode()
+{
+    std::cout << "Pinning grab to the network interface's NUMA node...";
+
+    pg::CameraInfo camera_info;
+    pg::Error error = camera_.GetCameraInfo(&camera_info);
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+
+    const auto iface = cameraInterface(camera_info);
+    if (iface.empty()) {
+        std::cout << "no interface is on the camera's subnet.\n";
+        return;
+    }
+
+    const int node = interfaceNode(iface);
+    if (node >= 0)
+        interface_cpus_ = nodeCpus(node);
+
+    if (interface_cpus_.empty()) {
+        std::cout << iface << " has no NUMA node.\n";
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto c : interface_cpus_)
+        if (c < CPU_SETSIZE)
+            CPU_SET(c, &cpus);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        std::cerr << oat::Warn("Could not pin grab thread to NUMA node "
+                               + std::to_string(node) + ".\n");
+        return;
+    }
+
+    std::cout << "pinned to node " << node << " of " << iface << ".\n";
+}
+
+template <typename T>
+void PointGreyCam<T>::publishTransportStats()
+{
+    // Statistics are register reads over the camera's link, so they are not
+    // made for every frame
+    const auto now = static_cast<int64_t>(oat::telemetryNow());
+    if (now - stats_published_ns_ < STATS_PERIOD_NS)
+        return;
+    stats_published_ns_ = now;
+
+    pg::CameraStats stats;
+    if (camera_.GetStats(&stats) != pg::PGRERROR_OK)
+        return;
+
+    const auto &s0 = stats_start_;
+    auto &t = frame_sink_.transport();
+    t.dropped.store(
+        static_cast<uint64_t>(stats.imageDropped - s0.imageDropped)
+        + (stats.imageDriverDropped - s0.imageDriverDropped)
+        + (stats.imageXmitFailed - s0.imageXmitFailed),
+        std::memory_order_relaxed);
+    t.corrupt.store(stats.imageCorrupt - s0.imageCorrupt,
+                    std::memory_order_relaxed);
+    t.resends_requested.store(
+        stats.numResendPacketsRequested - s0.numResendPacketsRequested,
+        std::memory_order_relaxed);
+    t.resends_received.store(
+        stats.numResendPacketsReceived - s0.numResendPacketsReceived,
+        std::memory_order_relaxed);
 }
 
 template <typename T>
@@ -597,8 +976,15 @@ void PointGreyCam<T>::setupEmbeddedImageData()
     if (error != pg::PGRERROR_OK)
         throw (rte(error.GetDescription()));
 
-    // For now, only inlcude timestamp
+    // For now, only inlcude timestamp, and the frame counter that numbers
+    // samples when frames come from the on-board buffer
     embeddedInfo.timestamp.onOff = true;
+    if (use_frame_buffer_) {
+        if (!embeddedInfo.frameCounter.available)
+            throw (rte("This camera cannot embed frame counters, which are "
+                       "required by frame-buffer."));
+        embeddedInfo.frameCounter.onOff = true;
+    }
 
     error = camera_.SetEmbeddedImageInfo(&embeddedInfo);
     if (error != pg::PGRERROR_OK)
@@ -623,16 +1009,38 @@ void PointGreyCam<T>::setupEmbeddedImageData()
 //
 //}
 
-// TODO: implement onboard buffer and perform retry a RetrieveBuffer
-// A single time if a torn image is detected.
 template <typename T>
 int PointGreyCam<T>::grabImage(pg::Image *raw_image)
 {
     assert (acquisition_started_ &&
             "Cannot grab image because acquisition has not been started.");
+
+    // Ask for the oldest frame held on the camera
+    if (use_frame_buffer_) {
+
+        const auto held = bufferedImages();
+        if (held == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return -1;
+        }
+
+        if (held >= frame_buffer_size_)
+            std::cerr << oat::Warn("Camera frame buffer is full. Frames are "
+                                   "being lost.\n");
+
+        transmitBufferedImage(1);
+    }
+
     pg::Error error;
     error = camera_.RetrieveBuffer(raw_image);
 
+    // Torn images are still held by the camera and can be sent again
+    if (use_frame_buffer_ && error == pg::PGRERROR_IMAGE_CONSISTENCY_ERROR) {
+        transmitBufferedImage(0);
+        error = camera_.RetrieveBuffer(raw_image);
+    }
+    const int64_t arrival_ns = oat::ClockOffset::hostNs();
+
     if (error == pg::PGRERROR_TIMEOUT) {
         return -1;
 #ifndef NDEBUG
@@ -656,6 +1064,20 @@ int PointGreyCam<T>::grabImage(pg::Image *raw_image)
     uint64_t total_ieee_1394_cycles =
         uncycle1394Timestamp(ts.cycleSeconds, ts.cycleCount);
 
+    // Shutter time on the host clock
+    capture_host_ns_ = clock_offset_.update(
+        static_cast<int64_t>(total_ieee_1394_cycles) * IEEE_1394_TICK_NS,
+        arrival_ns);
+
+    // Frames lost by the camera show up as jumps of the frame counter
+    if (use_frame_buffer_) {
+        const auto counter = raw_image->GetMetadata().embeddedFrameCounter;
+        if (frame_counter_set_)
+            frame_index_ += static_cast<uint32_t>(counter - last_frame_counter_);
+        frame_counter_set_ = true;
+        last_frame_counter_ = counter;
+    }
+
     // Convert to chrono::time_point
     tock_ = tick_;
     tick_ = std::chrono::duration_cast<oat::Sample::Microseconds> (
@@ -699,11 +1121,18 @@ bool PointGreyCam<T>::connectToNode()
     return true;
 }
 
+template <typename T>
+void PointGreyCam<T>::retrieveSharedImage()
+{
+    // In ring mode each write goes to the next buffer
+    shared_frame_ = frame_sink_.retrieve();
+    shmem_image_->SetData(shared_frame_.data, image_bytes_);
+}
+
 template <typename T>
 int PointGreyCam<T>::process()
 {
-    pg::Image raw_image;
-    int rc = grabImage(&raw_image);
+    int rc = grab();
 
     // There was a grab timeout.
     // Allow check to see if SIGINT occurred.
@@ -716,6 +1145,35 @@ int PointGreyCam<T>::process()
                                " skipped trigger(s).\n");
     }
 
+    publish(rc);
+
+    return 0;
+}
+
+template <typename T>
+int PointGreyCam<T>::grab()
+{
+    // Without a pixel format change the driver copies each image straight
+    // into the shared frame, instead of into a temporary that is then deep
+    // copied. The SINK must then be waited on before the grab, and stays held
+    // across grab timeouts. Cameras whose SINK is not bound grab into
+    // raw_image_.
+    pg::Image *image = &raw_image_;
+    if (!color_conversion_required_ && shmem_image_) {
+        if (!sink_held_) {
+            frame_sink_.wait();
+            sink_held_ = true;
+            retrieveSharedImage();
+        }
+        image = shmem_image_.get();
+    }
+
+    return grabImage(image);
+}
+
+template <typename T>
+void PointGreyCam<T>::publish(int rc)
+{
     int i = 0;
     do {
 
@@ -723,14 +1181,32 @@ int PointGreyCam<T>::process()
         ////////////////////////////
 
         // Wait for sources to read
-        frame_sink_.wait();
+        if (!sink_held_) {
 
-        if (color_conversion_required_)
-            raw_image.Convert(std::get<PG_TO>(pix_map_.at(pix_col_)), shmem_image_.get());
-        else
-            shmem_image_->DeepCopy(&raw_image);
+            frame_sink_.wait();
 
+            // Re-transmissions of a direct grab copy the last buffer
+            cv::Mat last = shared_frame_;
+            retrieveSharedImage();
+
+            if (color_conversion_required_)
+                convertRawImage(shmem_image_.get());
+            else if (last.data != shared_frame_.data)
+                last.copyTo(shared_frame_);
+        }
+        sink_held_ = false;
+
+        // Samples from the on-board buffer are numbered by the camera, so
+        // frames it lost leave gaps
+        if (use_frame_buffer_) {
+            auto sample = shared_frame_.sample();
+            sample.set_count(frame_index_);
+            shared_frame_.set_sample(sample);
+        }
         shared_frame_.incrementSampleCount(tick_);
+        shared_frame_.setSampleClock(oat::Sample::ClockSource::SENSOR,
+                                     capture_host_ns_,
+                                     std::chrono::nanoseconds(IEEE_1394_TICK_NS));
 
         // Tell sources there is new data
         frame_sink_.post();
@@ -740,7 +1216,30 @@ int PointGreyCam<T>::process()
 
     } while (i++ < rc);
 
-    return 0;
+    publishTransportStats();
+}
+
+template <typename T>
+void PointGreyCam<T>::convertRawImage(pg::Image *image)
+{
+    // FlyCapture's MONO12 conversion is single threaded and shifts pixels to
+    // the top of their 16 bits, so 12-bit images are unpacked here instead
+    if (pix_col_ == PIX_GREY16) {
+        const cv::Mat packed(raw_image_.GetRows(),
+                             raw_image_.GetStride(),
+                             CV_8UC1,
+                             raw_image_.GetData(),
+                             raw_image_.GetStride());
+        cv::Mat unpacked(image->GetRows(),
+                         image->GetCols(),
+                         CV_16UC1,
+                         image->GetData(),
+                         image->GetStride());
+        oat::unpackMono12(packed, unpacked, oat::Mono12Packing::GIGE_VISION);
+        return;
+    }
+
+    raw_image_.Convert(std::get<PG_TO>(pix_map_.at(pix_col_)), image);
 }
 
 template <typename T>
@@ -783,6 +1282,24 @@ bool PointGreyCam<T>::pollForTriggerReady()
     return true;
 }
 
+template <typename T>
+oat::PixelColor PointGreyCam<T>::sensorMosaic(void)
+{
+    pg::CameraInfo camera_info;
+    pg::Error error = camera_.GetCameraInfo(&camera_info);
+    if (error != pg::PGRERROR_OK)
+        throw (rte(error.GetDescription()));
+
+    switch (camera_info.bayerTileFormat) {
+        case pg::RGGB: return PIX_BAYER_RG;
+        case pg::GRBG: return PIX_BAYER_GR;
+        case pg::GBRG: return PIX_BAYER_GB;
+        case pg::BGGR: return PIX_BAYER_BG;
+        default:
+            throw (rte("BAYER color requires a color sensor."));
+    }
+}
+
 template <typename T>
 void PointGreyCam<T>::printCameraInfo(void)
 {
@@ -856,35 +1373,34 @@ void PointGreyCam<T>::printCameraInfo(void)
 // 0. GigE Camera
 
 template <>
-void PointGreyCam<pg::GigECamera>::connectToCamera(int index)
+void PointGreyCam<pg::GigECamera>::setupStreamChannels()
 {
-    auto num_cameras = static_cast<int>(findNumCameras());
-
-    if (index >= num_cameras)
-        throw (rte("Requested camera index " +
-               std::to_string(index) + " is out of range.\n"));
-
-    std::cout << "Connecting to camera: " << index << "\n";
-
-    pg::BusManager busMgr;
-    pg::PGRGuid guid;
-    pg::Error error = busMgr.GetCameraFromIndex(index, &guid);
-    if (error != pg::PGRERROR_OK)
-        throw (rte(error.GetDescription()));
+    std::cout << "Setting up stream channels...\n";
 
-    error = camera_.Connect(&guid);
-    if (error != pg::PGRERROR_OK)
-        throw (rte(error.GetDescription()));
+    pg::Error error;
 
-    printCameraInfo();
+    // Largest packet the path carries, jumbo if the host interface allows
+    auto packet_size = static_cast<unsigned int>(packet_size_);
+    if (packet_size == 0) {
+        error = camera_.DiscoverGigEPacketSize(&packet_size);
+        if (error != pg::PGRERROR_OK)
+            throw (rte(error.GetDescription()));
+    }
 
-    std::cout << "Restoring default acqusition settings...\n";
+    auto packet_delay = static_cast<unsigned int>(packet_delay_);
+    if (packet_delay_ < 0) {
 
-    error = camera_.RestoreFromMemoryChannel(0);
-    if (error != pg::PGRERROR_OK)
-        throw (rte(error.GetDescription()));
+        pg::GigEImageSettings image_settings;
+        error = camera_.GetGigEImageSettings(&image_settings);
+        if (error != pg::PGRERROR_OK)
+            throw (rte(error.GetDescription()));
 
-    std::cout << "Default settings restored.\n";
+        const double frame_bytes = image_settings.width * image_settings.height
+                                   * transmittedBits(image_settings.pixelFormat)
+                                   / 8.0;
+        packet_delay = spreadingPacketDelay(
+            frame_bytes, frames_per_second_, packet_size);
+    }
 
     unsigned int numStreamChannels = 0;
     error = camera_.GetNumStreamChannels(&numStreamChannels);
@@ -903,10 +1419,8 @@ void PointGreyCam<pg::GigECamera>::connectToCamera(int index)
         streamChannel.destinationIpAddress.octets[2] = 0;
         streamChannel.destinationIpAddress.octets[3] = 1;
 
-        // TODO: Make a more reasoned choice for these parameters based on the
-        // number of cameras on the system...
-        streamChannel.packetSize = 9000;
-        streamChannel.interPacketDelay = 250;
+        streamChannel.packetSize = packet_size;
+        streamChannel.interPacketDelay = packet_delay;
 
         error = camera_.SetGigEStreamChannelInfo(i, &streamChannel);
         if (error != pg::PGRERROR_OK)
@@ -934,6 +1448,16 @@ void PointGreyCam<pg::GigECamera>::connectToCamera(int index)
         std::cout << "Source port (on camera): " << streamChannel.sourcePort
                   << "\n\n";
     }
+
+    // Packets beyond what the socket buffers hold are dropped by the kernel
+    long rmem_max = 0;
+    std::ifstream rmem("/proc/sys/net/core/rmem_max");
+    if (rmem >> rmem_max && rmem_max < MIN_RMEM_BYTES)
+        std::cerr << oat::Warn("net.core.rmem_max is "
+                               + std::to_string(rmem_max) + " bytes, so "
+                               "stream packets may be dropped. Raise it to at "
+                               "least " + std::to_string(MIN_RMEM_BYTES)
+                               + " bytes with sysctl.\n");
 }
 
 template <>
@@ -1041,10 +1565,11 @@ bool PointGreyCam<pg::GigECamera>::connectToNode()
     const size_t cols = temp.GetCols();
     const size_t stride = temp.GetStride();
 
-    frame_sink_.bind(frame_sink_address_, bytes);
+    bindAndStart(bytes);
 
     shared_frame_ = frame_sink_.retrieve(
-        rows, cols, std::get<CV_TYPE>(pix_map_.at(pix_col_)), pix_col_);
+        rows, cols, std::get<CV_TYPE>(pix_map_.at(pix_col_)), pix_col_, stride);
+    bindViews(rows, cols);
     shared_frame_.set_rate_hz(frames_per_second_);
 
     // Use the shared_frame_.data, which points to a block of shared memory as
@@ -1226,9 +1751,11 @@ bool PointGreyCam<pg::Camera>::connectToNode()
     const size_t cols = temp.GetCols();
     const size_t stride = temp.GetStride();
 
-    frame_sink_.bind(frame_sink_address_, bytes);
+    bindAndStart(bytes);
 
-    shared_frame_ = frame_sink_.retrieve(rows, cols, std::get<CV_TYPE>(pix_map_.at(pix_col_)), pix_col_);
+    shared_frame_ = frame_sink_.retrieve(
+        rows, cols, std::get<CV_TYPE>(pix_map_.at(pix_col_)), pix_col_, stride);
+    bindViews(rows, cols);
     shared_frame_.set_rate_hz(frames_per_second_);
 
     // Use the shared_frame_.data, which points to a block of shared memory as
@@ -30,13 +30,20 @@
 #include <opencv2/core/mat.hpp>
 
 #include "../../lib/datatypes/Frame.h"
+#include "../../lib/utility/ClockOffset.h"
 
 namespace oat {
 
 namespace pg = FlyCapture2;
 
+template <typename T>
+class PointGreyMultiCam;
+
 template <typename T>
 class PointGreyCam : public FrameServer {
+
+friend PointGreyMultiCam<T>;
+
     using rte = std::runtime_error;
     using PixelMap
         = std::map<oat::PixelColor,
@@ -64,12 +71,40 @@ private:
     bool enforce_fps_ {false};
     double frames_per_second_ {30.0};
     static constexpr uint64_t IEEE_1394_HZ = {8000};
+    static constexpr int64_t IEEE_1394_TICK_NS = {125000};
     uint64_t ieee_1394_cycle_index_ {0};
     uint64_t ieee_1394_start_cycle_ {0};
     bool ieee_1394_start_set_ {false};
     int last_ieee_1394_sec_ {0};
     bool first_frame_ {true};
 
+    // On-camera frame buffer (TAN2007004)
+    bool use_frame_buffer_ {false};
+    static constexpr unsigned int IMAGE_RETRANSMIT = {0x12E8};
+    static constexpr unsigned int FRAME_BUFFER_PRESENT = {0x80000000};
+    static constexpr unsigned int HOLD_IMAGE = {0x02000000};
+    unsigned int frame_buffer_reg_ {0};
+    unsigned int frame_buffer_size_ {0};
+
+    // GigE receive path (TAN2012004)
+    size_t packet_size_ {0};            // 0 to discover the largest
+    int packet_delay_ {-1};             // -1 to derive from the frame rate
+    size_t driver_buffers_ {0};         // 0 keeps the driver default
+    bool pin_to_interface_node_ {false};
+    std::vector<int> interface_cpus_;   // CPUs of the interface's NUMA node
+
+    // Transport loss counters at start of capture, and when they were last
+    // published
+    pg::CameraStats stats_start_;
+    int64_t stats_published_ns_ {0};
+    static constexpr int64_t STATS_PERIOD_NS = {1000000000};
+
+    // Embedded frame counter of the last frame, and the sample number
+    // derived from it
+    bool frame_counter_set_ {false};
+    uint32_t last_frame_counter_ {0};
+    uint64_t frame_index_ {0};
+
     // Pixel color mapping
     bool color_conversion_required_ {false};
     oat::PixelColor pix_col_ {PIX_BGR};
@@ -79,14 +114,32 @@ private:
     // Used to mark times between acquisitions
     oat::Sample::Microseconds tick_, tock_;
 
+    // Shutter time of the last frame on the host clock, in nanoseconds
+    oat::ClockOffset clock_offset_;
+    int64_t capture_host_ns_ {0};
+
     bool acquisition_started_ {false};
     bool use_trigger_ {false};
 
     // Camera object
     T camera_;
 
-    // The current, unbuffered frame in PG's format
+    // The current shared frame in PG's format, wrapping the SINK's buffer
     std::unique_ptr<pg::Image> shmem_image_;
+    size_t image_bytes_ {0};
+
+    // Image written by the driver when it cannot write to the shared frame
+    pg::Image raw_image_;
+
+    // True if the SINK was waited on for a direct grab that has not been
+    // posted yet
+    bool sink_held_ {false};
+
+    // Point shmem_image_ at the frame the next post() publishes
+    void retrieveSharedImage(void);
+
+    // Convert raw_image_ to the served pixel format, into image
+    void convertRawImage(pg::Image *image);
 
     // Acquisition setup routines
     void setupFrameRate(double fps, bool is_auto = false);
@@ -99,21 +152,49 @@ private:
     void setupPixelBinning(size_t x_bin, size_t y_bin);
     void setupImageFormat(const std::vector<size_t> &roi);
     void setupImageFormat(void);
-    //TODO: int setupCameraFrameBuffer(void);
+    void setupCameraFrameBuffer(void);
     void setupAsyncTrigger(int trigger_mode, bool trigger_rising, int trigger_pin);
     void setupStrobeOutput(int strobe_pin);
     void setupEmbeddedImageData(void);
     void setupGrabSettings(void);
+    void setupStreamChannels(void);
+
+    // Pin the calling thread, and so the driver's receive threads started by
+    // capture, to the NUMA node of the camera's network interface
+    void pinToInterfaceNode(void);
+
+    // Publish the camera's transport loss counters to the SINK's telemetry,
+    // at most once per STATS_PERIOD_NS
+    void publishTransportStats(void);
+
+    // Number of frames held in the on-camera frame buffer
+    unsigned int bufferedImages(void);
+
+    // Transmit a frame from the on-camera frame buffer, after dropping
+    // num_images - 1 frames. num_images = 0 re-transmits the last frame.
+    void transmitBufferedImage(unsigned int num_images);
 
     // IEEE 1394 shutter open timestamp uncycling
     uint64_t uncycle1394Timestamp(int ieee_1394_sec,
                                   int ieee_1394_cycle);
 
+    // Raw color of the sensor's Bayer mosaic
+    oat::PixelColor sensorMosaic(void);
+
     // Physical camera control
     void turnCameraOn(void);
     void connectToCamera(int index);
     void startCapture(void);
 
+    /**
+     * @brief Start capture, and discard the warm-up frames, on a thread of
+     * its own while the frame SINK is bound and its segment prefaulted, so
+     * that sources can connect while the camera is still coming up.
+     * @param bytes Number of bytes of pixel data per frame.
+     */
+    void bindAndStart(const size_t bytes);
+    void startCamera(void);
+
     /**
      * @brief Grab a frame from the camera's buffer.
      *
@@ -128,6 +209,22 @@ private:
      */
     int grabImage(pg::Image *raw_image);
 
+    /**
+     * @brief Grab the next frame from the camera, straight into the SINK if
+     * possible.
+     *
+     * @return grabImage() return code.
+     */
+    int grab(void);
+
+    /**
+     * @brief Publish the last grabbed frame to the SINK.
+     *
+     * @param rc Number of re-transmissions of the frame, as returned by
+     * grab().
+     */
+    void publish(int rc);
+
     // Diagnostics and meta
     unsigned int findNumCameras(void);
     void printError(pg::Error error);
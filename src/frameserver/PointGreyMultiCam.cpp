@@ -0,0 +1,423 @@
+//******************************************************************************
+//* File:   PointGreyMultiCam.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "PointGreyMultiCam.h"
+#include "Mono12.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+
+#include "../../lib/base/Globals.h"
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
+
+namespace oat {
+
+template <typename T>
+PointGreyMultiCam<T>::PointGreyMultiCam(const std::string &sink_addresses)
+: FrameServer(sink_addresses)
+{
+    // Nothing
+}
+
+template <typename T>
+PointGreyMultiCam<T>::~PointGreyMultiCam()
+{
+    // Release and join the capture threads before the cameras are destroyed
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        for (auto &g : grabbers_)
+            g->job = Job::QUIT;
+    }
+    job_cv_.notify_all();
+
+    for (auto &g : grabbers_)
+        if (g->thread.joinable())
+            g->thread.join();
+}
+
+template <typename T>
+po::options_description PointGreyMultiCam<T>::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("camera", po::value<std::string>(),
+         "TOML array of tables, one per camera, in SINK order. Each table "
+         "holds the configuration keys of the single camera TYPE, e.g. "
+         "[{index=0,trigger-mode=14},{index=1,trigger-mode=14}]. Frames are "
+         "matched across cameras using each camera's fps, so all cameras "
+         "should run at the same rate. enforce-fps is replaced by this "
+         "matching and is ignored.")
+        ("cores", po::value<std::string>(),
+         "Array of ints, one per camera, specifying the CPU core that the "
+         "camera's capture thread is pinned to. -1 leaves a thread unpinned, "
+         "or on the NUMA node of its camera's network interface if the "
+         "camera's table sets nic-node. Defaults to all -1.")
+        ("stitch",
+         "If true, publish the frames from all cameras side by side, left to "
+         "right in camera order, as one frame to a single SINK. Cameras must "
+         "then produce frames with the same height and pixel color.")
+        ;
+
+    return local_opts;
+}
+
+template <typename T>
+void PointGreyMultiCam<T>::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Stitched output
+    oat::config::getValue<bool>(vm, config_table, "stitch", stitch_);
+
+    std::vector<std::string> sinks;
+    std::istringstream addresses {frame_sink_address_};
+    std::string address;
+    while (std::getline(addresses, address, ',')) {
+        if (address.empty())
+            throw rte("Empty SINK name in '" + frame_sink_address_ + "'.");
+        sinks.push_back(address);
+    }
+
+    if (stitch_ && sinks.size() != 1)
+        throw rte("Stitched frames are published to a single SINK.");
+
+    // Camera tables, from the command line or the configuration table
+    auto table = config_table;
+    if (vm.count("camera")) {
+        std::istringstream toml {"camera=" + vm["camera"].as<std::string>()};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    }
+
+    auto tables = table->get_table_array("camera");
+    if (!tables)
+        throw rte("A 'camera' array of tables, one per camera, is required.");
+
+    const size_t num_cams = tables->get().size();
+    if (!stitch_ && num_cams != sinks.size())
+        throw rte("Number of cameras (" + std::to_string(num_cams)
+                  + ") does not match the number of SINKs ("
+                  + std::to_string(sinks.size()) + ").");
+
+    // Capture thread cores
+    std::vector<int> cores;
+    if (oat::config::getArray<int>(vm, config_table, "cores", cores)
+        && cores.size() != num_cams)
+        throw rte("'cores' must contain one core per camera.");
+
+    const int num_cores = static_cast<int>(std::thread::hardware_concurrency());
+    for (const auto c : cores)
+        if (c < -1 || (num_cores > 0 && c >= num_cores))
+            throw rte("Core " + std::to_string(c) + " does not exist.");
+
+    // Each camera configures, and starts, as its single camera TYPE would
+    size_t i = 0;
+    for (const auto &t : *tables) {
+
+        grabbers_.emplace_back(new Grabber);
+        auto &g = *grabbers_.back();
+        g.sink_address = stitch_ ? "" : sinks[i];
+        g.camera = oat::make_unique<PointGreyCam<T>>(g.sink_address);
+        g.core = cores.empty() ? -1 : cores[i];
+
+        po::options_description opts;
+        g.camera->appendOptions(opts);
+        oat::config::checkKeys(g.camera->config_keys_, t);
+        g.camera->applyConfiguration(po::variables_map(), t);
+
+        // Slot matching takes the place of re-transmission
+        g.camera->enforce_fps_ = false;
+
+        i++;
+    }
+}
+
+template <typename T>
+bool PointGreyMultiCam<T>::connectToNode()
+{
+    // Stitched frames size the SINK from the first frame of each camera, so
+    // their cameras are started without a SINK of their own
+    for (auto &g : grabbers_) {
+        if (stitch_)
+            g->camera->startCamera();
+        else
+            g->camera->connectToNode();
+    }
+
+    return true;
+}
+
+template <typename T>
+void PointGreyMultiCam<T>::capture(Grabber &g)
+{
+    auto &cam = *g.camera;
+
+    // Keep this camera's captures on one core, or else on the NUMA node of
+    // its network interface if it was asked to be
+    if (g.core >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(g.core, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            std::cerr << oat::Warn("Could not pin capture thread to core "
+                                   + std::to_string(g.core) + ".\n");
+    } else if (!cam.interface_cpus_.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (const auto c : cam.interface_cpus_)
+            if (c < CPU_SETSIZE)
+                CPU_SET(c, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            std::cerr << oat::Warn("Could not pin capture thread to its "
+                                   "network interface's NUMA node.\n");
+    }
+
+    while (true) {
+
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex_);
+            job_cv_.wait(lock, [&g] { return g.job != Job::NONE; });
+            job = g.job;
+        }
+
+        if (job == Job::QUIT)
+            return;
+
+        try {
+
+            if (job == Job::GRAB) {
+
+                // Retry timeouts until a frame arrives or SIGINT
+                int rc = -1;
+                while (rc == -1 && !quit)
+                    rc = cam.grab();
+
+                g.held = rc != -1;
+                g.slot = std::llround(cam.tick_.count()
+                                      * cam.frames_per_second_ / 1.0e6);
+
+            } else if (stitch_) {
+                copyToBand(g);
+            } else {
+                cam.publish(0);
+            }
+
+        } catch (...) {
+            g.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(job_mutex_);
+            g.job = Job::NONE;
+            jobs_pending_--;
+        }
+        done_cv_.notify_all();
+    }
+}
+
+template <typename T>
+void PointGreyMultiCam<T>::dispatch(const std::vector<Grabber *> &grabbers,
+                                    Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        for (auto g : grabbers)
+            g->job = job;
+        jobs_pending_ = grabbers.size();
+    }
+    job_cv_.notify_all();
+
+    std::unique_lock<std::mutex> lock(job_mutex_);
+    done_cv_.wait(lock, [this] { return jobs_pending_ == 0; });
+
+    for (auto g : grabbers)
+        if (g->error)
+            std::rethrow_exception(g->error);
+}
+
+template <typename T>
+int PointGreyMultiCam<T>::process()
+{
+    if (!threads_started_) {
+        for (auto &g : grabbers_) {
+            auto gp = g.get();
+            g->thread = std::thread([this, gp] { capture(*gp); });
+        }
+        threads_started_ = true;
+    }
+
+    std::vector<Grabber *> all;
+    for (auto &g : grabbers_)
+        all.push_back(g.get());
+
+    // Grab one frame per camera, then re-grab on cameras whose frame belongs
+    // to an earlier frame period than the latest one seen. This drops, on
+    // every camera, the frames of periods that any camera missed.
+    dispatch(all, Job::GRAB);
+
+    while (!quit) {
+
+        int64_t target = 0;
+        for (auto g : all)
+            target = std::max(target, g->slot);
+
+        std::vector<Grabber *> stale;
+        for (auto g : all)
+            if (g->slot < target)
+                stale.push_back(g);
+
+        if (stale.empty())
+            break;
+
+        frames_dropped_ += stale.size();
+        std::cerr << oat::Warn("Dropped " + std::to_string(stale.size())
+                               + " frame(s) to realign cameras at frame "
+                               + std::to_string(target) + ".\n");
+
+        dispatch(stale, Job::GRAB);
+    }
+
+    // Allow check to see if SIGINT occurred.
+    for (auto g : all)
+        if (!g->held)
+            return 0;
+
+    // Publish the matched set, each camera to its own SINK or all cameras to
+    // the stitched frame
+    if (stitch_) {
+
+        if (!stitch_bound_)
+            bindStitched();
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sources to read
+        frame_sink_.wait();
+
+        dispatch(all, Job::PUBLISH);
+
+        shared_frame_.incrementSampleCount(grabbers_[0]->camera->tick_);
+        shared_frame_.setSampleClock(
+            oat::Sample::ClockSource::SENSOR,
+            grabbers_[0]->camera->capture_host_ns_,
+            std::chrono::nanoseconds(PointGreyCam<T>::IEEE_1394_TICK_NS));
+
+        // Tell sources there is new data
+        frame_sink_.post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+    } else {
+        dispatch(all, Job::PUBLISH);
+    }
+
+    for (auto g : all)
+        g->held = false;
+
+    return 0;
+}
+
+template <typename T>
+void PointGreyMultiCam<T>::bindStitched()
+{
+    using Cam = PointGreyCam<T>;
+
+    const auto &first = *grabbers_[0]->camera;
+    const auto color = first.pix_col_;
+    const int type = std::get<Cam::CV_TYPE>(Cam::pix_map_.at(color));
+    const int rows = first.raw_image_.GetRows();
+
+    int cols = 0;
+    for (auto &g : grabbers_) {
+
+        const auto &cam = *g->camera;
+        if (cam.pix_col_ != color
+            || static_cast<int>(cam.raw_image_.GetRows()) != rows)
+            throw rte("Stitched cameras must produce frames with the same "
+                      "height and pixel color.");
+
+        g->band = cv::Rect(cols, 0, cam.raw_image_.GetCols(), rows);
+        cols += g->band.width;
+    }
+
+    frame_sink_.bind(frame_sink_address_, rows * cols * CV_ELEM_SIZE(type));
+    shared_frame_ = frame_sink_.retrieve(rows, cols, type, color);
+    shared_frame_.set_rate_hz(first.frames_per_second_);
+
+    stitch_bound_ = true;
+}
+
+template <typename T>
+void PointGreyMultiCam<T>::copyToBand(Grabber &g)
+{
+    using Cam = PointGreyCam<T>;
+
+    auto &cam = *g.camera;
+    const auto &map = Cam::pix_map_.at(cam.pix_col_);
+
+    cv::Mat band(shared_frame_, g.band);
+
+    // 12-bit images are unpacked straight into the band
+    if (cam.pix_col_ == PIX_GREY16) {
+        const cv::Mat packed(cam.raw_image_.GetRows(),
+                             cam.raw_image_.GetStride(),
+                             CV_8UC1,
+                             cam.raw_image_.GetData(),
+                             cam.raw_image_.GetStride());
+        oat::unpackMono12(packed, band, oat::Mono12Packing::GIGE_VISION);
+        return;
+    }
+
+    pg::Image converted;
+    pg::Image *image = &cam.raw_image_;
+    if (cam.color_conversion_required_) {
+        cam.raw_image_.Convert(std::get<Cam::PG_TO>(map), &converted);
+        image = &converted;
+    }
+
+    const cv::Mat frame(image->GetRows(),
+                        image->GetCols(),
+                        std::get<Cam::CV_TYPE>(map),
+                        image->GetData(),
+                        image->GetStride());
+
+    frame.copyTo(band);
+}
+
+// Explicit instantiation
+template class PointGreyMultiCam<pg::Camera>;
+template class PointGreyMultiCam<pg::GigECamera>;
+
+} /* namespace oat */
@@ -0,0 +1,117 @@
+//******************************************************************************
+//* File:   PointGreyMultiCam.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_POINTGREYMULTICAM_H
+#define	OAT_POINTGREYMULTICAM_H
+
+#include "FrameServer.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "PointGreyCam.h"
+
+namespace oat {
+
+/**
+ * Several Point Grey cameras served in lock step from one process
+ */
+template <typename T>
+class PointGreyMultiCam : public FrameServer {
+    using rte = std::runtime_error;
+
+public:
+    /**
+     * @brief Serve synchronized frames from several Point Grey cameras.
+     * Each camera is read by its own capture thread. Frames are matched
+     * across cameras using their IEEE 1394 shutter timestamps and are
+     * published together, either one SINK per camera or side by side to a
+     * single SINK.
+     *
+     * @param sink_addresses comma separated frame sink addresses, one per
+     * camera, or a single address if frames are stitched
+     */
+    explicit PointGreyMultiCam(const std::string &sink_addresses);
+    ~PointGreyMultiCam() final;
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Work handed from process() to the capture threads
+    enum class Job { NONE = 0, GRAB, PUBLISH, QUIT };
+
+    struct Grabber {
+        std::string sink_address;
+        std::unique_ptr<PointGreyCam<T>> camera;
+        std::thread thread;
+        int core {-1};
+        Job job {Job::NONE};
+        std::exception_ptr error;
+
+        // Frame period slot of the held frame, counted from the camera's
+        // first frame
+        int64_t slot {0};
+        bool held {false};
+
+        // Columns of the stitched frame written by this camera
+        cv::Rect band;
+    };
+
+    // In camera order
+    std::vector<std::unique_ptr<Grabber>> grabbers_;
+    bool threads_started_ {false};
+    std::mutex job_mutex_;
+    std::condition_variable job_cv_, done_cv_;
+    size_t jobs_pending_ {0};
+
+    // Stitched output
+    bool stitch_ {false};
+    bool stitch_bound_ {false};
+    uint64_t frames_dropped_ {0};
+
+    // Capture thread work loop
+    void capture(Grabber &g);
+
+    // Hand a job to each listed capture thread and wait for all of them to
+    // finish it
+    void dispatch(const std::vector<Grabber *> &grabbers, Job job);
+
+    // Stitched output
+    void bindStitched(void);
+    void copyToBand(Grabber &g);
+};
+
+}      /* namespace oat */
+#endif /* OAT_POINTGREYMULTICAM_H */
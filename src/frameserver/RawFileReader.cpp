@@ -0,0 +1,267 @@
+//******************************************************************************
+//* File:   RawFileReader.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "RawFileReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Bytes the kernel is asked to read ahead of the served frame
+static constexpr size_t READ_AHEAD_BYTES {64 << 20};
+
+RawFileReader::RawFileReader(const std::string &sink_address)
+: FrameServer(sink_address)
+{
+    // Nothing
+}
+
+RawFileReader::~RawFileReader()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<char *>(data_), bytes_);
+}
+
+po::options_description RawFileReader::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("video-file,f", po::value<std::string>(),
+         "Path to .oatraw file to serve frames from.")
+        ("fps,r", po::value<double>(),
+         "Frames to serve per second. Defaults to the frame rate the file "
+         "was recorded at.")
+        ("spin", po::value<double>(),
+         "Microseconds before each frame deadline that are busy waited "
+         "instead of slept, so that frames are served at exact times at high "
+         "fps. Occupies a core while waiting. Defaults to 0.")
+        ("max-throughput",
+         "If true, serve frames as fast as SINK's readers allow instead of "
+         "at fps, e.g. for offline reanalysis.")
+        ("segment", po::value<std::string>(),
+         "Two element array of unsigned ints, [first,last], specifying the "
+         "range of frame indices, first included and last excluded, to serve. "
+         "Defaults to the whole file.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
+        ;
+
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+
+    return local_opts;
+}
+
+void RawFileReader::applyConfiguration(const po::variables_map &vm,
+                                       const config::OptionTable &config_table)
+{
+    // Raw file
+    oat::config::getValue(vm, config_table, "video-file", file_name_, true);
+
+    const int fd = ::open(file_name_.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("File \"" + file_name_ + "\" could not be "
+                                 "opened: " + std::strerror(errno) + ".");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(header_)) {
+        ::close(fd);
+        throw std::runtime_error("\"" + file_name_ + "\" is not a raw frame "
+                                 "file.");
+    }
+
+    bytes_ = st.st_size;
+    void *p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("File \"" + file_name_ + "\" could not be "
+                                 "mapped: " + std::strerror(errno) + ".");
+    data_ = static_cast<const char *>(p);
+
+    // Frames are read in order, so pages can be read ahead aggressively and
+    // dropped soon after they are served
+    madvise(p, bytes_, MADV_SEQUENTIAL);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    if (std::strncmp(header_.magic, "OATRAW", sizeof(header_.magic)) != 0
+        || header_.version != 1)
+        throw std::runtime_error("\"" + file_name_ + "\" is not a raw frame "
+                                 "file.");
+
+    // Samples are stored as the recorder's oat::Sample
+    if (header_.sample_bytes != sizeof(oat::Sample))
+        throw std::runtime_error("\"" + file_name_ + "\" was recorded by an "
+                                 "incompatible version of Oat.");
+
+    // Frame rate
+    if (!oat::config::getNumericValue(
+            vm, config_table, "fps", frames_per_second_, 0.0))
+        frames_per_second_ = header_.fps;
+
+    if (!(frames_per_second_ > 0.0))
+        throw std::runtime_error("The frame rate of \"" + file_name_
+                                 + "\" is unknown. Set fps.");
+
+    pacer_.set_period(std::chrono::duration<double>(1.0 / frames_per_second_));
+
+    // Pacing
+    oat::config::getValue<bool>(
+        vm, config_table, "max-throughput", max_throughput_);
+
+    // Replay runs in the recording's time, not the wall clock's
+    if (oat::deterministic())
+        max_throughput_ = true;
+
+    double spin_us = 0.0;
+    if (oat::config::getNumericValue(vm, config_table, "spin", spin_us, 0.0))
+        pacer_.set_spin(std::chrono::duration<double, std::micro>(spin_us));
+
+    // Segment, clipped to the blocks in the file. A block cut short by a
+    // crash is not served.
+    end_block_ = (bytes_ - std::min<size_t>(bytes_, header_.header_bytes))
+                 / header_.block_bytes;
+
+    std::vector<uint64_t> segment;
+    if (oat::config::getArray<uint64_t, 2>(vm, config_table, "segment", segment)) {
+
+        if (segment[0] >= segment[1])
+            throw std::runtime_error("The first frame of segment must come "
+                                     "before the last.");
+
+        next_block_ = std::min<uint64_t>(segment[0], end_block_);
+        end_block_ = std::min<uint64_t>(segment[1], end_block_);
+    }
+
+    read_ahead_block_ = next_block_;
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+}
+
+bool RawFileReader::connectToNode()
+{
+    frame_sink_.bind(frame_sink_address_, header_.frame_bytes, num_buffers_);
+
+    shared_frame_ = frame_sink_.retrieve(header_.rows,
+                                         header_.cols,
+                                         header_.type,
+                                         static_cast<oat::PixelColor>(header_.color));
+    bindViews(header_.rows, header_.cols);
+
+    readAhead();
+
+    return true;
+}
+
+int RawFileReader::process()
+{
+    if (next_block_ >= end_block_)
+        return 1;
+
+    const char *block = data_ + header_.header_bytes
+                        + next_block_ * header_.block_bytes;
+
+    // The recorded sample
+    oat::Sample sample;
+    std::memcpy(&sample, block, sizeof(sample));
+
+    // Pixels are stored packed, straight after the sample
+    const cv::Mat pixels(header_.rows,
+                         header_.cols,
+                         header_.type,
+                         const_cast<char *>(block + header_.sample_bytes));
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    frame_sink_.wait();
+
+    shared_frame_ = frame_sink_.retrieve();
+    pixels.copyTo(shared_frame_);
+
+    // Publish the sample as recorded, including its clock
+    const auto count = sample.count();
+    const auto usec = sample.microseconds();
+    sample.set_count(count > 0 ? count - 1 : 0);
+    shared_frame_.set_sample(sample);
+    shared_frame_.incrementSampleCount(usec);
+
+    // Tell sources there is new data
+    frame_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    next_block_++;
+    readAhead();
+
+    if (!max_throughput_)
+        pacer_.wait();
+
+    return 0;
+}
+
+void RawFileReader::readAhead()
+{
+    // Ask for the next window once half of the last one has been served
+    const uint64_t window
+        = std::max<uint64_t>(1, READ_AHEAD_BYTES / header_.block_bytes);
+    if (read_ahead_block_ >= end_block_
+        || read_ahead_block_ > next_block_ + window / 2)
+        return;
+
+    const uint64_t last = std::min(end_block_, next_block_ + window);
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t from = (header_.header_bytes
+                         + read_ahead_block_ * header_.block_bytes)
+                        / page * page;
+    const size_t to = header_.header_bytes + last * header_.block_bytes;
+
+    madvise(const_cast<char *>(data_) + from, to - from, MADV_WILLNEED);
+    read_ahead_block_ = last;
+}
+
+} /* namespace oat */
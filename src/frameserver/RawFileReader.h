@@ -0,0 +1,83 @@
+//******************************************************************************
+//* File:   RawFileReader.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_RAWFILEREADER_H
+#define	OAT_RAWFILEREADER_H
+
+#include "FrameServer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "../recorder/RawFrameEncoder.h"
+#include "../../lib/utility/Pacer.h"
+
+namespace oat {
+
+class RawFileReader : public FrameServer {
+public:
+    /**
+     * @brief Serve frames from a raw frame file written by oat-record's raw
+     * encoder. The file is memory mapped and read ahead sequentially, and
+     * each frame is copied from the mapping straight into shared memory, so
+     * replay is limited by memory and disk bandwidth rather than by a
+     * decoder. Frames are published with the samples they were recorded
+     * with.
+     * @param sink_address frame sink address
+     */
+    explicit RawFileReader(const std::string &sink_address);
+    ~RawFileReader();
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Mapped file
+    std::string file_name_;
+    const char *data_ {nullptr};
+    size_t bytes_ {0};
+    oat::RawFrameHeader header_;
+
+    // Served blocks, first included and last excluded
+    uint64_t next_block_ {0};
+    uint64_t end_block_ {std::numeric_limits<uint64_t>::max()};
+
+    // Blocks up to which the kernel has been asked to read ahead
+    uint64_t read_ahead_block_ {0};
+    void readAhead(void);
+
+    // Playback speed
+    double frames_per_second_ {0.0};
+    bool max_throughput_ {false};
+
+    // Frame generation clock
+    oat::Pacer pacer_;
+};
+
+}       /* namespace oat */
+#endif	/* OAT_RAWFILEREADER_H */
@@ -19,20 +19,31 @@
 
 #include "TestFrame.h"
 
-#include <thread>
+#include <algorithm>
+#include <cmath>
 
 #include <cpptoml.h>
+#include <opencv2/imgproc.hpp>
 
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
 
+// Most blobs that can be rendered
+static constexpr size_t MAX_BLOBS {64};
+
+// Blob velocities decay by this factor each frame, so that random
+// accelerations give smooth motion at a bounded speed
+static constexpr double VELOCITY_DECAY {0.98};
+
+// Brightness of the background of rendered frames
+static constexpr double BACKGROUND {32.0};
+
 TestFrame::TestFrame(const std::string &sink_address)
 : FrameServer(sink_address)
 {
-    // Initialize time
-    tick_ = clock_.now();
+    // Nothing
 }
 
 po::options_description TestFrame::options() const
@@ -42,25 +53,75 @@ po::options_description TestFrame::options() const
     local_opts.add_options()
         ("test-image,f", po::value<std::string>(),
          "Path to test image used as frame source.")
+        ("blobs", po::value<size_t>(),
+         "Render this many moving blobs, between 1 and 64, in each frame "
+         "instead of serving test-image. Blobs move with random, but smooth, "
+         "accelerations and bounce off the edges of the frame. BGR blobs each "
+         "have their own hue, and GREY blobs their own brightness.")
+        ("size,s", po::value<std::string>(),
+         "Two element array of unsigned ints, [width,height], specifying the "
+         "size of rendered frames. Defaults to [640,480].")
+        ("blob-radius", po::value<double>(),
+         "Radius of rendered blobs, in pixels. Defaults to 10.")
+        ("sigma-accel", po::value<double>(),
+         "Standard deviation of the random accelerations of rendered blobs, "
+         "in pixels per frame squared. Defaults to 0.5.")
+        ("noise", po::value<double>(),
+         "Standard deviation of Gaussian noise added to each pixel of "
+         "rendered frames. Defaults to 0.")
+        ("drift", po::value<double>(),
+         "Amplitude of a slow, sinusoidal drift in the lighting of rendered "
+         "frames, as a fraction of their brightness between 0 and 1. Defaults "
+         "to 0.")
+        ("drift-period", po::value<double>(),
+         "Frames per cycle of the lighting drift. Defaults to 600.")
+        ("seed", po::value<uint64_t>(),
+         "Seed of the blobs' motion and of the pixel noise, so that rendered "
+         "frames are the same from run to run. Defaults to 0.")
+        ("truth", po::value<std::string>(),
+         "CSV file to write the true position of each rendered blob to, with "
+         "a line of 'sample,blob,x,y' per blob per frame. Positions are in "
+         "pixels.")
         ("color,C", po::value<std::string>(),
          "Pixel color format. Defaults to BGR.\n"
          "Values:\n"
          "  GREY: \t 8-bit Greyscale image.\n"
          "  BGR: \t8-bit, 3-chanel, BGR Color image.\n")
         ("fps,r", po::value<double>(),
-         "Frames to serve per second.")
+         "Frames to serve per second. Defaults to as fast as possible.")
+        ("spin", po::value<double>(),
+         "Microseconds before each frame deadline that are busy waited "
+         "instead of slept, so that frames are served at exact times at high "
+         "fps. Occupies a core while waiting. Defaults to 0.")
         ("num-frames,n", po::value<uint64_t>(),
          "Number of frames to serve before exiting.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
         ;
 
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+
     return local_opts;
 }
 
 void TestFrame::applyConfiguration(const po::variables_map &vm,
                                    const config::OptionTable &config_table)
 {
+    // Rendered blobs, or a test image
+    size_t blobs = 0;
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "blobs", blobs, 1, MAX_BLOBS);
+
     // Test image path
-    oat::config::getValue(vm, config_table, "test-image", file_name_, true);
+    if (oat::config::getValue(
+            vm, config_table, "test-image", file_name_, blobs == 0)
+        && blobs > 0)
+        throw std::runtime_error("Give either a test-image or a number of "
+                                 "blobs to render, not both.");
 
     // Pixel color
     std::string col;
@@ -76,23 +137,98 @@ void TestFrame::applyConfiguration(const po::variables_map &vm,
     // Frame rate
     if (oat::config::getNumericValue(vm, config_table, "fps", frames_per_second_, 0.0))
         calculateFramePeriod();
+
+    // Busy wait before each deadline
+    double spin_us = 0.0;
+    if (oat::config::getNumericValue(vm, config_table, "spin", spin_us, 0.0))
+        pacer_.set_spin(std::chrono::duration<double, std::micro>(spin_us));
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+
+    if (blobs == 0)
+        return;
+
+    if (color_ != PIX_GREY && color_ != PIX_BGR)
+        throw std::runtime_error("Blobs can be rendered as GREY or BGR.");
+
+    // Frame size
+    std::vector<size_t> size;
+    if (oat::config::getArray<size_t, 2>(vm, config_table, "size", size)) {
+        if (size[0] == 0 || size[1] == 0)
+            throw std::runtime_error("Frame size must be positive.");
+        size_ = cv::Size(static_cast<int>(size[0]), static_cast<int>(size[1]));
+    }
+
+    oat::config::getNumericValue<double>(vm, config_table, "blob-radius",
+        blob_radius_, 1.0, std::min(size_.width, size_.height) / 2.0);
+    oat::config::getNumericValue<double>(
+        vm, config_table, "sigma-accel", sigma_accel_, 0.0);
+    oat::config::getNumericValue<double>(vm, config_table, "noise", noise_, 0.0);
+    oat::config::getNumericValue<double>(
+        vm, config_table, "drift", drift_, 0.0, 1.0);
+    oat::config::getNumericValue<double>(
+        vm, config_table, "drift-period", drift_period_, 1.0);
+
+    // Motion and noise are both repeatable
+    uint64_t seed = 0;
+    oat::config::getNumericValue<uint64_t>(vm, config_table, "seed", seed);
+    rng_.seed(static_cast<std::mt19937::result_type>(seed));
+    cv::theRNG() = cv::RNG(seed);
+
+    std::string truth;
+    if (oat::config::getValue<std::string>(vm, config_table, "truth", truth)) {
+        truth_.open(truth);
+        if (!truth_)
+            throw std::runtime_error("Could not open ground truth file \""
+                                     + truth + "\".");
+        truth_ << "sample,blob,x,y\n";
+    }
+
+    initBlobs(blobs);
 }
 
 bool TestFrame::connectToNode() {
 
+    if (!blobs_.empty()) {
+
+        const int type = color_ == PIX_GREY ? CV_8UC1 : CV_8UC3;
+        frame_sink_.bind(frame_sink_address_,
+                size_.area() * CV_ELEM_SIZE(type),
+                num_buffers_);
+
+        shared_frame_ = frame_sink_.retrieve(
+                size_.height, size_.width, type, color_);
+        bindViews(size_.height, size_.width);
+
+        shared_frame_.set_rate_hz(1.0 / frame_period_in_sec_.count());
+
+        return true;
+    }
+
     auto mat = cv::imread(file_name_, oat::imread_code(color_));
 
     if (mat.data == NULL)
         throw (std::runtime_error("File \"" + file_name_ + "\" could not be read."));
 
     frame_sink_.bind(frame_sink_address_,
-            mat.total() * mat.elemSize());
+            mat.total() * mat.elemSize(),
+            num_buffers_);
 
     shared_frame_ = frame_sink_.retrieve(
             mat.rows, mat.cols, mat.type(), color_);
+    bindViews(mat.rows, mat.cols);
 
     // Static image, never changes
     mat.copyTo(shared_frame_);
+    test_mat_ = mat;
 
     // Put the sample rate in the shared frame
     shared_frame_.set_rate_hz(1.0 / frame_period_in_sec_.count());
@@ -110,8 +246,24 @@ int TestFrame::process()
         // Wait for sources to read
         frame_sink_.wait();
 
-        // Zero frame copy
+        // Rendered frames are drawn afresh into whichever buffer is next
+        if (!blobs_.empty()) {
+            if (num_buffers_ > 1)
+                shared_frame_ = frame_sink_.retrieve();
+            moveBlobs();
+            renderBlobs(shared_frame_);
+        }
+
+        // Zero frame copy unless buffers rotate, in which case each buffer
+        // needs to be filled once
+        else if (num_buffers_ > 1) {
+            shared_frame_ = frame_sink_.retrieve();
+            if (shared_frame_.sample_count() < num_buffers_)
+                test_mat_.copyTo(shared_frame_);
+        }
+
         shared_frame_.incrementSampleCount();
+        const auto count = shared_frame_.sample_count();
 
         // Tell sources there is new data
         frame_sink_.post();
@@ -119,8 +271,13 @@ int TestFrame::process()
         ////////////////////////////
         //  END CRITICAL SECTION  //
 
-        std::this_thread::sleep_for(frame_period_in_sec_ - (clock_.now() - tick_));
-        tick_ = clock_.now();
+        if (truth_.is_open())
+            for (size_t i = 0; i < blobs_.size(); i++)
+                truth_ << count << "," << i << ","
+                       << blobs_[i].position.x << ","
+                       << blobs_[i].position.y << "\n";
+
+        pacer_.wait();
 
         return 0;
     }
@@ -132,6 +289,94 @@ void TestFrame::calculateFramePeriod()
     // Copy assignment provides automatic unit conversion
     std::chrono::duration<double> frame_period {1.0 / frames_per_second_};
     frame_period_in_sec_ = frame_period;
+    pacer_.set_period(frame_period_in_sec_);
+}
+
+void TestFrame::initBlobs(const size_t count)
+{
+    std::uniform_real_distribution<double> x(blob_radius_,
+                                             size_.width - blob_radius_);
+    std::uniform_real_distribution<double> y(blob_radius_,
+                                             size_.height - blob_radius_);
+
+    blobs_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+
+        auto &b = blobs_[i];
+        b.position = cv::Point2d(x(rng_), y(rng_));
+        b.velocity = cv::Point2d(0, 0);
+
+        // Evenly spread hues, or brightnesses well above the background
+        if (color_ == PIX_BGR) {
+            cv::Mat hsv(1, 1, CV_8UC3,
+                        cv::Scalar(180.0 * i / count, 255, 255)), bgr;
+            cv::cvtColor(hsv, bgr, cv::COLOR_HSV2BGR);
+            const auto &p = bgr.at<cv::Vec3b>(0, 0);
+            b.color = cv::Scalar(p[0], p[1], p[2]);
+        } else {
+            b.color = cv::Scalar::all(255.0 - 128.0 * i / count);
+        }
+    }
+}
+
+void TestFrame::moveBlobs()
+{
+    std::normal_distribution<double> accel(0.0, sigma_accel_);
+
+    const double lo = blob_radius_;
+    const double hi_x = size_.width - blob_radius_;
+    const double hi_y = size_.height - blob_radius_;
+
+    for (auto &b : blobs_) {
+
+        b.velocity = VELOCITY_DECAY * b.velocity
+                     + cv::Point2d(accel(rng_), accel(rng_));
+        b.position += b.velocity;
+
+        // Bounce off the edges
+        if (b.position.x < lo || b.position.x > hi_x) {
+            b.position.x = b.position.x < lo ? 2 * lo - b.position.x
+                                             : 2 * hi_x - b.position.x;
+            b.velocity.x = -b.velocity.x;
+        }
+        if (b.position.y < lo || b.position.y > hi_y) {
+            b.position.y = b.position.y < lo ? 2 * lo - b.position.y
+                                             : 2 * hi_y - b.position.y;
+            b.velocity.y = -b.velocity.y;
+        }
+
+        b.position.x = std::min(std::max(b.position.x, lo), hi_x);
+        b.position.y = std::min(std::max(b.position.y, lo), hi_y);
+    }
+}
+
+void TestFrame::renderBlobs(cv::Mat &frame)
+{
+    // Lighting of the frame about to be counted
+    const double phase = 2 * CV_PI * (shared_frame_.sample_count() + 1)
+                         / drift_period_;
+    const double gain = 1.0 + drift_ * std::sin(phase);
+
+    frame.setTo(cv::Scalar::all(BACKGROUND * gain));
+
+    // Subpixel centres, so that the true positions are the drawn ones
+    constexpr int SHIFT = 4;
+    constexpr double SCALE = 1 << SHIFT;
+    for (const auto &b : blobs_)
+        cv::circle(frame,
+                   cv::Point(cvRound(b.position.x * SCALE),
+                             cvRound(b.position.y * SCALE)),
+                   cvRound(blob_radius_ * SCALE),
+                   b.color * gain,
+                   cv::FILLED,
+                   cv::LINE_AA,
+                   SHIFT);
+
+    if (noise_ > 0) {
+        noise_mat_.create(frame.size(), CV_16SC(frame.channels()));
+        cv::randn(noise_mat_, cv::Scalar::all(0), cv::Scalar::all(noise_));
+        cv::add(frame, noise_mat_, frame, cv::noArray(), frame.type());
+    }
 }
 
 } /* namespace oat */
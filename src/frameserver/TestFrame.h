@@ -23,15 +23,21 @@
 #include "FrameServer.h"
 
 #include <chrono>
+#include <fstream>
 #include <limits>
+#include <random>
 #include <string>
+#include <vector>
+
+#include "../../lib/utility/Pacer.h"
 
 namespace oat {
 
 class TestFrame : public FrameServer {
 public:
     /**
-     * @brief Serve test frames using a static image.
+     * @brief Serve test frames using a static image, or frames rendered with
+     * moving blobs whose true positions are known.
      * @param sink_address frame sink address
      */
     explicit TestFrame(const std::string &sink_address);
@@ -48,21 +54,45 @@ private:
 
     // Image file
     std::string file_name_;
+    cv::Mat test_mat_;
 
     // Frame speed
-    double frames_per_second_;
+    double frames_per_second_ {0.0};
     void calculateFramePeriod(void);
 
     // frame generation clock
-    std::chrono::high_resolution_clock clock_;
-    std::chrono::duration<double> frame_period_in_sec_;
-    std::chrono::high_resolution_clock::time_point tick_;
+    std::chrono::duration<double> frame_period_in_sec_ {0.0};
+    oat::Pacer pacer_;
 
     // Sample count specification
     uint64_t num_samples_ {std::numeric_limits<int64_t>::max()};
 
     // Color switch
     oat::PixelColor color_ {oat::PIX_BGR};
+
+    // Synthetic frames of random, but smooth, moving blobs. Each frame is
+    // rendered in full so that sources see changing pixels.
+    struct Blob {
+        cv::Point2d position;
+        cv::Point2d velocity;
+        cv::Scalar color;
+    };
+    std::vector<Blob> blobs_;
+    cv::Size size_ {640, 480};
+    double blob_radius_ {10.0};
+    double sigma_accel_ {0.5};  //!< Pixels per frame squared
+    double noise_ {0.0};        //!< Standard deviation of pixel noise
+    double drift_ {0.0};        //!< Amplitude of the lighting drift
+    double drift_period_ {600}; //!< Frames per lighting cycle
+    std::mt19937 rng_;
+    cv::Mat noise_mat_;
+
+    // Ground truth trajectories
+    std::ofstream truth_;
+
+    void initBlobs(size_t count);
+    void moveBlobs(void);
+    void renderBlobs(cv::Mat &frame);
 };
 
 }       /* namespace oat */
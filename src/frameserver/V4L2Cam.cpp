@@ -0,0 +1,490 @@
+//******************************************************************************
+//* File:   V4L2Cam.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "V4L2Cam.h"
+#include "Mono12.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cpptoml.h>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+// Packed 12-bit greyscale, missing from older kernel headers
+#ifndef V4L2_PIX_FMT_Y12P
+#define V4L2_PIX_FMT_Y12P v4l2_fourcc('Y', '1', '2', 'P')
+#endif
+
+namespace oat {
+
+// Time to wait for a frame before checking for SIGINT
+static constexpr int POLL_TIMEOUT_MS {100};
+
+// ioctl that retries when interrupted by a signal
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+    int rc;
+    do {
+        rc = ioctl(fd, request, arg);
+    } while (rc == -1 && errno == EINTR);
+
+    return rc;
+}
+
+static std::runtime_error v4l2Error(const std::string &what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno) + ".");
+}
+
+V4L2Cam::V4L2Cam(const std::string &sink_address)
+: FrameServer(sink_address)
+{
+    // Nothing
+}
+
+V4L2Cam::~V4L2Cam()
+{
+    // Ignore error return values -- throwing exception unsafe in destructor
+    if (streaming_) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(fd_, VIDIOC_STREAMOFF, &type);
+    }
+
+    for (auto &b : buffers_)
+        munmap(b.data, b.length);
+
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+po::options_description V4L2Cam::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("device,d", po::value<std::string>(),
+         "Path to the V4L2 capture device. Defaults to /dev/video0.")
+        ("format,F", po::value<std::string>(),
+         "Pixel format requested from the device. Defaults to YUYV.\n"
+         "Values:\n"
+         "  YUYV: \tPacked 4:2:2 YUV. Converted to BGR, or the luma plane is "
+         "copied for GREY.\n"
+         "  MJPEG: \tMotion JPEG. Decoded straight into the shared frame.\n"
+         "  GREY: \t8-bit greyscale. Copied.\n"
+         "  Y12: \t12-bit greyscale, 16 bits per pixel. Copied.\n"
+         "  Y12P: \t12-bit greyscale, packed two pixels to three bytes. "
+         "Unpacked to 16 bits per pixel.\n")
+        ("color,C", po::value<std::string>(),
+         "Pixel color format of served frames, GREY or BGR. Defaults to BGR, "
+         "or GREY for the GREY format. The 12-bit formats are served as "
+         "GREY16.")
+        ("size,s", po::value<std::string>(),
+         "Two element array of unsigned ints, [width,height], specifying "
+         "the frame size requested from the device. Defaults to the device's "
+         "current size.")
+        ("fps,r", po::value<double>(),
+         "Frame rate requested from the device. Defaults to the device's "
+         "current rate.")
+        ("driver-buffers", po::value<size_t>(),
+         "Number of memory mapped driver buffers, between 2 and 32. More "
+         "buffers absorb longer stalls before the driver drops frames. "
+         "Defaults to 4.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
+        ;
+
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+
+    return local_opts;
+}
+
+void V4L2Cam::applyConfiguration(const po::variables_map &vm,
+                                 const config::OptionTable &config_table)
+{
+    // Device
+    oat::config::getValue(vm, config_table, "device", device_);
+
+    fd_ = open(device_.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd_ < 0)
+        throw v4l2Error("Could not open " + device_);
+
+    v4l2_capability cap;
+    std::memset(&cap, 0, sizeof(cap));
+    if (xioctl(fd_, VIDIOC_QUERYCAP, &cap) == -1)
+        throw v4l2Error(device_ + " is not a V4L2 device");
+
+    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)
+        || !(cap.capabilities & V4L2_CAP_STREAMING))
+        throw std::runtime_error(device_ + " does not support streaming "
+                                 "video capture.");
+
+    // Pixel format
+    std::string format {"YUYV"};
+    oat::config::getValue(vm, config_table, "format", format);
+    if (format == "YUYV")
+        pixel_format_ = V4L2_PIX_FMT_YUYV;
+    else if (format == "MJPEG")
+        pixel_format_ = V4L2_PIX_FMT_MJPEG;
+    else if (format == "GREY")
+        pixel_format_ = V4L2_PIX_FMT_GREY;
+    else if (format == "Y12")
+        pixel_format_ = V4L2_PIX_FMT_Y12;
+    else if (format == "Y12P")
+        pixel_format_ = V4L2_PIX_FMT_Y12P;
+    else
+        throw std::runtime_error("Invalid format. Use YUYV, MJPEG, GREY, Y12 "
+                                 "or Y12P.");
+
+    const bool deep = pixel_format_ == V4L2_PIX_FMT_Y12
+                      || pixel_format_ == V4L2_PIX_FMT_Y12P;
+
+    // Served color
+    if (pixel_format_ == V4L2_PIX_FMT_GREY)
+        color_ = PIX_GREY;
+    else if (deep)
+        color_ = PIX_GREY16;
+
+    std::string col;
+    if (oat::config::getValue<std::string>(vm, config_table, "color", col))
+        color_ = oat::str_color(col);
+
+    if (deep) {
+        if (color_ != PIX_GREY16)
+            throw std::runtime_error("12-bit formats can only be served as "
+                                     "GREY16.");
+    } else if (color_ != PIX_GREY && color_ != PIX_BGR) {
+        throw std::runtime_error("V4L2 frames can be served as GREY or BGR.");
+    }
+
+    if (pixel_format_ == V4L2_PIX_FMT_GREY && color_ != PIX_GREY)
+        throw std::runtime_error("The GREY format can only be served as GREY.");
+
+    // Frame size
+    std::vector<size_t> size;
+    oat::config::getArray<size_t, 2>(vm, config_table, "size", size);
+    setFormat(size);
+
+    // Frame rate
+    double fps = 0.0;
+    if (oat::config::getNumericValue<double>(vm, config_table, "fps", fps, 0.0))
+        setFrameRate(fps);
+    else
+        setFrameRate(0.0);
+
+    // Driver buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "driver-buffers", num_driver_buffers_, 2, 32);
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+
+    mapBuffers();
+}
+
+void V4L2Cam::setFormat(const std::vector<size_t> &size)
+{
+    v4l2_format fmt;
+    std::memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd_, VIDIOC_G_FMT, &fmt) == -1)
+        throw v4l2Error("Could not get format of " + device_);
+
+    if (!size.empty()) {
+        fmt.fmt.pix.width = size[0];
+        fmt.fmt.pix.height = size[1];
+    }
+    fmt.fmt.pix.pixelformat = pixel_format_;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+
+    if (xioctl(fd_, VIDIOC_S_FMT, &fmt) == -1)
+        throw v4l2Error("Could not set format of " + device_);
+
+    // Drivers adjust requests they cannot meet
+    if (fmt.fmt.pix.pixelformat != pixel_format_)
+        throw std::runtime_error(device_ + " does not support the requested "
+                                 "format.");
+
+    width_ = fmt.fmt.pix.width;
+    height_ = fmt.fmt.pix.height;
+    bytes_per_line_ = fmt.fmt.pix.bytesperline;
+
+    if (!size.empty() && (width_ != size[0] || height_ != size[1]))
+        std::cerr << oat::Warn("Frame size set to "
+                               + std::to_string(width_) + "x"
+                               + std::to_string(height_) + ".\n");
+}
+
+void V4L2Cam::setFrameRate(double fps)
+{
+    v4l2_streamparm parm;
+    std::memset(&parm, 0, sizeof(parm));
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd_, VIDIOC_G_PARM, &parm) == -1)
+        throw v4l2Error("Could not get frame rate of " + device_);
+
+    if (fps > 0.0 && (parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        parm.parm.capture.timeperframe.numerator = 1000;
+        parm.parm.capture.timeperframe.denominator
+            = static_cast<uint32_t>(fps * 1000.0 + 0.5);
+        if (xioctl(fd_, VIDIOC_S_PARM, &parm) == -1)
+            throw v4l2Error("Could not set frame rate of " + device_);
+    } else if (fps > 0.0) {
+        std::cerr << oat::Warn("Not able to set V4L2 frame rate.\n");
+    }
+
+    const auto &tpf = parm.parm.capture.timeperframe;
+    frames_per_second_ = tpf.numerator > 0
+        ? static_cast<double>(tpf.denominator) / tpf.numerator
+        : 30.0;
+}
+
+void V4L2Cam::mapBuffers()
+{
+    v4l2_requestbuffers req;
+    std::memset(&req, 0, sizeof(req));
+    req.count = num_driver_buffers_;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd_, VIDIOC_REQBUFS, &req) == -1)
+        throw v4l2Error(device_ + " does not support memory mapped buffers");
+
+    if (req.count < 2)
+        throw std::runtime_error("Not enough driver buffers on " + device_ + ".");
+
+    buffers_.resize(req.count);
+    for (uint32_t i = 0; i < req.count; i++) {
+
+        v4l2_buffer buf;
+        std::memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(fd_, VIDIOC_QUERYBUF, &buf) == -1)
+            throw v4l2Error("Could not query driver buffer");
+
+        buffers_[i].length = buf.length;
+        buffers_[i].data = mmap(nullptr,
+                                buf.length,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED,
+                                fd_,
+                                buf.m.offset);
+
+        if (buffers_[i].data == MAP_FAILED) {
+            buffers_[i].data = nullptr;
+            buffers_.resize(i);
+            throw v4l2Error("Could not map driver buffer");
+        }
+    }
+}
+
+void V4L2Cam::startStreaming()
+{
+    for (uint32_t i = 0; i < buffers_.size(); i++) {
+
+        v4l2_buffer buf;
+        std::memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(fd_, VIDIOC_QBUF, &buf) == -1)
+            throw v4l2Error("Could not queue driver buffer");
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd_, VIDIOC_STREAMON, &type) == -1)
+        throw v4l2Error("Could not start streaming from " + device_);
+
+    streaming_ = true;
+}
+
+bool V4L2Cam::connectToNode()
+{
+    const int type = oat::cv_type(color_);
+
+    frame_sink_.bind(frame_sink_address_,
+                     width_ * height_ * oat::color_bytes(color_),
+                     num_buffers_);
+
+    shared_frame_ = frame_sink_.retrieve(height_, width_, type, color_);
+    bindViews(height_, width_);
+    shared_frame_.set_rate_hz(frames_per_second_);
+
+    startStreaming();
+
+    return true;
+}
+
+void V4L2Cam::publish(const Buffer &buffer, size_t bytes_used)
+{
+    // Driver buffers are read once, straight into the shared frame
+    switch (pixel_format_) {
+        case V4L2_PIX_FMT_YUYV:
+        {
+            const cv::Mat yuyv(height_, width_, CV_8UC2,
+                               buffer.data, bytes_per_line_);
+            cv::cvtColor(yuyv,
+                         shared_frame_,
+                         color_ == PIX_GREY ? cv::COLOR_YUV2GRAY_YUYV
+                                            : cv::COLOR_YUV2BGR_YUYV);
+            break;
+        }
+        case V4L2_PIX_FMT_GREY:
+        {
+            const cv::Mat grey(height_, width_, CV_8UC1,
+                               buffer.data, bytes_per_line_);
+            grey.copyTo(shared_frame_);
+            break;
+        }
+        case V4L2_PIX_FMT_Y12:
+        {
+            const cv::Mat grey(height_, width_, CV_16UC1,
+                               buffer.data, bytes_per_line_);
+            grey.copyTo(shared_frame_);
+            break;
+        }
+        case V4L2_PIX_FMT_Y12P:
+        {
+            const cv::Mat packed(height_, bytes_per_line_, CV_8UC1,
+                                 buffer.data, bytes_per_line_);
+            oat::unpackMono12(packed, shared_frame_, Mono12Packing::MIPI);
+            break;
+        }
+        case V4L2_PIX_FMT_MJPEG:
+        {
+            const cv::Mat jpeg(1, bytes_used, CV_8UC1, buffer.data);
+            cv::Mat out = shared_frame_;
+            cv::imdecode(jpeg,
+                         color_ == PIX_GREY ? cv::IMREAD_GRAYSCALE
+                                            : cv::IMREAD_COLOR,
+                         &out);
+
+            // Torn or corrupt frames decode to nothing, or to another size
+            if (out.data != shared_frame_.data) {
+                if (out.size() == shared_frame_.size())
+                    out.copyTo(shared_frame_);
+                else
+                    std::cerr << oat::Warn("WARNING: corrupt MJPEG frame.\n");
+            }
+            break;
+        }
+    }
+}
+
+int V4L2Cam::process()
+{
+    pollfd pfd {fd_, POLLIN, 0};
+    const int rc = poll(&pfd, 1, POLL_TIMEOUT_MS);
+
+    // Timeout or signal. Allow check to see if SIGINT occurred.
+    if (rc == 0 || (rc == -1 && errno == EINTR))
+        return 0;
+    if (rc == -1)
+        throw v4l2Error("Could not poll " + device_);
+
+    v4l2_buffer buf;
+    std::memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd_, VIDIOC_DQBUF, &buf) == -1) {
+        if (errno == EAGAIN)
+            return 0;
+        throw v4l2Error("Could not dequeue driver buffer");
+    }
+    const int64_t arrival_ns = oat::ClockOffset::hostNs();
+
+    // Kernel capture time, relative to the first frame
+    const int64_t usec
+        = static_cast<int64_t>(buf.timestamp.tv_sec) * 1000000
+          + buf.timestamp.tv_usec;
+    if (first_frame_) {
+        first_frame_ = false;
+        first_usec_ = usec;
+        first_sequence_ = buf.sequence;
+    }
+
+    // Monotonic kernel timestamps are already on the steady_clock
+    int64_t host_ns = usec * 1000;
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK)
+        != V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        host_ns = clock_offset_.update(host_ns, arrival_ns);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    frame_sink_.wait();
+
+    shared_frame_ = frame_sink_.retrieve();
+    publish(buffers_[buf.index], buf.bytesused);
+
+    // Samples are numbered by the driver's sequence number, so frames the
+    // driver dropped leave gaps
+    auto sample = shared_frame_.sample();
+    sample.set_count(buf.sequence - first_sequence_);
+    shared_frame_.set_sample(sample);
+    shared_frame_.incrementSampleCount(
+        Sample::Microseconds(usec - first_usec_));
+    shared_frame_.setSampleClock(Sample::ClockSource::DRIVER,
+                                 host_ns,
+                                 std::chrono::microseconds(1));
+
+    // Tell sources there is new data
+    frame_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Return the driver buffer
+    if (xioctl(fd_, VIDIOC_QBUF, &buf) == -1)
+        throw v4l2Error("Could not queue driver buffer");
+
+    return 0;
+}
+
+} /* namespace oat */
@@ -0,0 +1,89 @@
+//******************************************************************************
+//* File:   V4L2Cam.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_V4L2CAM_H
+#define	OAT_V4L2CAM_H
+
+#include "FrameServer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../lib/utility/ClockOffset.h"
+
+namespace oat {
+
+class V4L2Cam : public FrameServer {
+public:
+    /**
+     * @brief Serve frames from a Video4Linux2 capture device. Driver buffers
+     * are memory mapped and each frame is converted, or copied, once,
+     * straight from the driver buffer into the shared frame.
+     * @param sink_address frame sink address
+     */
+    explicit V4L2Cam(const std::string &sink_address);
+    ~V4L2Cam() final;
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Device
+    std::string device_ {"/dev/video0"};
+    int fd_ {-1};
+    bool streaming_ {false};
+
+    // Capture format
+    uint32_t pixel_format_ {0};
+    size_t width_ {0}, height_ {0}, bytes_per_line_ {0};
+    double frames_per_second_ {0.0};
+    oat::PixelColor color_ {oat::PIX_BGR};
+
+    // Memory mapped driver buffers
+    struct Buffer {
+        void *data {nullptr};
+        size_t length {0};
+    };
+    std::vector<Buffer> buffers_;
+    size_t num_driver_buffers_ {4};
+
+    // Kernel timestamp and sequence number of the first frame
+    bool first_frame_ {true};
+    int64_t first_usec_ {0};
+    uint32_t first_sequence_ {0};
+
+    // Maps kernel timestamps that are not on the monotonic clock onto it
+    oat::ClockOffset clock_offset_;
+
+    void setFormat(const std::vector<size_t> &size);
+    void setFrameRate(double fps);
+    void mapBuffers(void);
+    void startStreaming(void);
+    void publish(const Buffer &buffer, size_t bytes_used);
+};
+
+}      /* namespace oat */
+#endif /* OAT_V4L2CAM_H */
@@ -21,6 +21,7 @@
 
 #include <chrono>
 #include <string>
+#include <utility>
 #include <opencv2/core/mat.hpp>
 
 #include "../../lib/utility/TOMLSanitize.h"
@@ -35,6 +36,13 @@ WebCam::WebCam(const std::string &sink_name)
     // Nothing
 }
 
+WebCam::~WebCam()
+{
+    capturing_ = false;
+    if (capture_thread_.joinable())
+        capture_thread_.join();
+}
+
 po::options_description WebCam::options() const
 {
     // Update CLI options
@@ -50,8 +58,22 @@ po::options_description WebCam::options() const
          "defining a rectangular region of interest. Origin"
          "is upper left corner. ROI must fit within acquired"
          "mat size. Defaults to full sensor size.")
+        ("latest-only,l",
+         "If true, a capture thread continuously reads the camera and only "
+         "the most recent frame is published. Downstream stalls then drop "
+         "frames, seen as gaps in sample numbers, instead of queueing stale "
+         "frames in the driver. Defaults to false.")
+        ("buffers,b", po::value<size_t>(),
+         "Number of shared frame buffers, between 1 and 8. When greater than "
+         "1, frames are written round-robin so that downstream components can "
+         "lag the frame server by up to this number of frames minus one "
+         "without blocking capture. Defaults to 1.")
         ;
 
+    addViewOptions(local_opts);
+    addPyramidOptions(local_opts);
+    addWarmupOptions(local_opts);
+
     return local_opts; 
 }
 
@@ -84,6 +106,22 @@ void WebCam::applyConfiguration(const po::variables_map &vm,
         region_of_interest_.width  = roi[2];
         region_of_interest_.height = roi[3];
     }
+
+    // Latest frame handoff
+    oat::config::getValue<bool>(vm, config_table, "latest-only", latest_only_);
+
+    // Number of shared frame buffers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "buffers", num_buffers_, 1, oat::Node::MAX_BUFFERS);
+
+    // Views of the served frames
+    configureViews(vm, config_table);
+
+    // Pyramid levels of the served frames
+    configurePyramid(vm, config_table);
+
+    // Prefaulting and warm-up frames
+    configureWarmup(vm, config_table);
 }
 
 bool WebCam::connectToNode()
@@ -94,25 +132,136 @@ bool WebCam::connectToNode()
     if (use_roi_)
         example_frame = example_frame(region_of_interest_);
 
-    frame_sink_.bind(frame_sink_address_,
-                     example_frame.total() * oat::color_bytes(oat::PIX_BGR));
+    // Warm-up frames are read while the SINK is bound and its segment
+    // prefaulted, which does not touch the camera
+    std::thread warmup([this] {
+        cv::Mat discard;
+        for (size_t i = 0; i < warmup_frames_; i++)
+            if (!cv_camera_->read(discard))
+                break;
+    });
+
+    try {
+        frame_sink_.bind(frame_sink_address_,
+                         example_frame.total() * oat::color_bytes(oat::PIX_BGR),
+                         num_buffers_);
+    } catch (...) {
+        warmup.join();
+        throw;
+    }
+    warmup.join();
 
     shared_frame_ = frame_sink_.retrieve(
         example_frame.rows, example_frame.cols, example_frame.type(), oat::PIX_BGR);
+    bindViews(example_frame.rows, example_frame.cols);
 
     // Put the sample rate in the shared mat
     shared_frame_.set_rate_hz(cv_camera_->get(cv::CAP_PROP_FPS));
 
+    if (latest_only_) {
+        start_ = clock_.now();
+        capturing_ = true;
+        capture_thread_ = std::thread(&WebCam::capture, this);
+    }
+
     return true;
 }
 
+void WebCam::capture()
+{
+    uint64_t count = 0;
+    while (capturing_) {
+
+        // Decode into the back slot, outside the lock
+        if (!cv_camera_->read(back_.mat))
+            break;
+
+        back_.count = ++count;
+        back_.host_ns = oat::ClockOffset::hostNs();
+        back_.time = std::chrono::duration_cast<Sample::Microseconds>(
+            clock_.now() - start_);
+
+        // An unpublished fresh frame is stale now. Its buffer is decoded
+        // into next.
+        {
+            std::lock_guard<std::mutex> lock(capture_mutex_);
+            std::swap(back_, fresh_);
+            have_fresh_ = true;
+        }
+        capture_cv_.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        end_of_stream_ = true;
+    }
+    capture_cv_.notify_one();
+}
+
+int WebCam::publishLatest()
+{
+    // Wait for a frame newer than the last one published
+    {
+        std::unique_lock<std::mutex> lock(capture_mutex_);
+        capture_cv_.wait(lock, [this] { return have_fresh_ || end_of_stream_; });
+
+        if (!have_fresh_)
+            return 1;
+
+        std::swap(fresh_, front_);
+        have_fresh_ = false;
+    }
+
+    cv::Mat mat = front_.mat;
+    if (use_roi_)
+        mat = mat(region_of_interest_);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    frame_sink_.wait();
+
+    shared_frame_ = frame_sink_.retrieve();
+
+    // Samples are numbered by capture, so dropped frames leave gaps
+    auto sample = shared_frame_.sample();
+    sample.set_count(front_.count - 1);
+    shared_frame_.set_sample(sample);
+    shared_frame_.incrementSampleCount(front_.time);
+    setSampleClock(front_.host_ns);
+
+    mat.copyTo(shared_frame_);
+
+    // Tell sources there is new data
+    frame_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    return 0;
+}
+
+void WebCam::setSampleClock(const int64_t host_ns)
+{
+    shared_frame_.setSampleClock(
+        Sample::ClockSource::HOST,
+        host_ns,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            shared_frame_.sample().period_sec()));
+}
+
 int WebCam::process()
 {
+    if (latest_only_)
+        return publishLatest();
+
     // Frame decoding (if compression was performed) can be
     // computationally expensive. So do this outside the critical section
     cv::Mat mat;
     if (!cv_camera_->read(mat)) 
         return 1;
+    const int64_t host_ns = oat::ClockOffset::hostNs();
 
     if (use_roi_ )
         mat = mat(region_of_interest_);
@@ -126,6 +275,8 @@ int WebCam::process()
     // Wait for sources to read
     frame_sink_.wait();
 
+    shared_frame_ = frame_sink_.retrieve();
+
     // Pure SINKs increment sample count
     // NOTE: webcams have poorly controlled sample period, so it must be
     // calculated. This operation is very inexpensive
@@ -137,6 +288,7 @@ int WebCam::process()
                                                                - start_);
         shared_frame_.incrementSampleCount(time_since_start);
     }
+    setSampleClock(host_ns);
 
     mat.copyTo(shared_frame_);
 
@@ -22,11 +22,18 @@
 
 #include "FrameServer.h"
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <opencv2/videoio.hpp>
 
+#include "../../lib/utility/ClockOffset.h"
+
 namespace oat {
 
 class WebCam : public FrameServer {
@@ -36,6 +43,7 @@ public:
      * @param sink_address frame sink address
      */
     explicit WebCam(const std::string &sink_address_);
+    ~WebCam();
 
 private:
     // Component Interface
@@ -54,6 +62,31 @@ private:
     bool first_frame_ {true};
     std::chrono::steady_clock clock_;
     std::chrono::steady_clock::time_point start_;
+
+    // Latest frame handoff. A capture thread drains the camera into a two
+    // slot buffer, swapping each new frame into the fresh slot, and
+    // process() publishes only the fresh frame.
+    struct Capture {
+        cv::Mat mat;
+        uint64_t count {0};
+        Sample::Microseconds time {0};
+        int64_t host_ns {0};
+    };
+
+    bool latest_only_ {false};
+    Capture back_, fresh_, front_;
+    bool have_fresh_ {false};
+    std::atomic<bool> capturing_ {false};
+    bool end_of_stream_ {false};
+    std::thread capture_thread_;
+    std::mutex capture_mutex_;
+    std::condition_variable capture_cv_;
+    void capture(void);
+    int publishLatest(void);
+
+    // Frames are timed by the host when read() returns, to no better than a
+    // frame period
+    void setSampleClock(int64_t host_ns);
 };
 
 }      /* namespace oat */
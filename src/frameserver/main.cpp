@@ -34,10 +34,15 @@
 
 #include "TestFrame.h"
 #include "FileReader.h"
+#include "RawFileReader.h"
 #include "WebCam.h"
+#ifdef USE_V4L2
+ #include "V4L2Cam.h"
+#endif
 #ifdef USE_FLYCAP
  #include "FlyCapture2.h"
  #include "PointGreyCam.h"
+ #include "PointGreyMultiCam.h"
  namespace pg = FlyCapture2;
 #endif
 
@@ -48,15 +53,21 @@ namespace po = boost::program_options;
 const char usage_type[] =
     "TYPE\n"
     "  wcam: Onboard or USB webcam.\n"
+    "  v4l2: Video4Linux2 device, without OpenCV's capture layer.\n"
     "  usb: Point Grey USB camera.\n"
     "  gige: Point Grey GigE camera.\n"
+    "  usb-multi: Several synchronized Point Grey USB cameras.\n"
+    "  gige-multi: Several synchronized Point Grey GigE cameras.\n"
     "  file: Video from file (*.mpg, *.avi, etc.).\n"
-    "  test: Write-free static image server for performance testing.";
+    "  raw: Memory mapped replay of a .oatraw file recorded by oat-record.\n"
+    "  test: Write-free static image server for performance testing, or a\n"
+    "        renderer of moving blobs with ground truth positions.";
 
 const char usage_io[] =
     "SINK:\n"
     "  User-supplied name of the memory segment to publish frames "
-    "to (e.g. raw).";
+    "to (e.g. raw). The multi-camera TYPEs take a comma separated list, one "
+    "per camera (e.g. left,right).";
 
 const char purpose[] =
     "Serve frames to SINK.";
@@ -98,6 +109,10 @@ int main(int argc, char *argv[])
     type_hash["file"] = 'c';
     type_hash["test"] = 'd';
     type_hash["usb"] = 'e';
+    type_hash["usb-multi"] = 'f';
+    type_hash["gige-multi"] = 'g';
+    type_hash["v4l2"] = 'h';
+    type_hash["raw"] = 'i';
 
     // The component itself
     std::string comp_name = "frameserve";
@@ -196,6 +211,52 @@ int main(int argc, char *argv[])
 #endif
                     break;
                 }
+                case 'f':
+                {
+
+#ifndef USE_FLYCAP
+                    std::cerr << oat::Error(
+                        "Oat was not compiled with Point-Grey "
+                        "flycapture support, so TYPE=usb-multi is not available.\n");
+                    return -1;
+#else
+                    server = std::make_shared<
+                        oat::PointGreyMultiCam<pg::Camera>>(sink);
+#endif
+                    break;
+                }
+                case 'g':
+                {
+
+#ifndef USE_FLYCAP
+                    std::cerr << oat::Error(
+                        "Oat was not compiled with Point-Grey "
+                        "flycapture support, so TYPE=gige-multi is not available.\n");
+                    return -1;
+#else
+                    server = std::make_shared<
+                        oat::PointGreyMultiCam<pg::GigECamera>>(sink);
+#endif
+                    break;
+                }
+                case 'h':
+                {
+
+#ifndef USE_V4L2
+                    std::cerr << oat::Error(
+                        "Oat was not compiled with V4L2 support, so "
+                        "TYPE=v4l2 is not available.\n");
+                    return -1;
+#else
+                    server = std::make_shared<oat::V4L2Cam>(sink);
+#endif
+                    break;
+                }
+                case 'i':
+                {
+                    server = std::make_shared<oat::RawFileReader>(sink);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
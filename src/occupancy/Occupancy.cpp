@@ -0,0 +1,308 @@
+//******************************************************************************
+//* File:   Occupancy.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Occupancy.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+Occupancy::Occupancy(const std::string &position_source_address)
+: name_("occupancy[" + position_source_address + "->*]")
+, position_source_address_(position_source_address)
+{
+    // Nothing
+}
+
+Occupancy::~Occupancy()
+{
+    // Final snapshot, including after CTRL+C
+    if (output_path_.empty())
+        return;
+
+    try {
+        snapshot();
+    } catch (const std::runtime_error &ex) {
+        std::cerr << oat::Warn(std::string(ex.what()) + "\n");
+    }
+}
+
+po::options_description Occupancy::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("extent,e", po::value<std::string>(),
+         "Array of [xmin, ymin, xmax, ymax] bounding the occupancy grid, in "
+         "the units of the positions: pixels or, for positions in world "
+         "units, the units of the homography. Time spent outside is counted "
+         "separately.")
+        ("bin-size,b", po::value<double>(),
+         "Side length of the square bins of the occupancy grid, in the "
+         "units of the positions. Defaults to 10.")
+        ("output,o", po::value<std::string>(),
+         "File to write snapshots of the occupancy grid and region dwell "
+         "times to, as JSON. Each snapshot replaces the last atomically, so "
+         "the file always holds a complete snapshot.")
+        ("period,p", po::value<double>(),
+         "Seconds between snapshots. A final snapshot is written on exit. "
+         "Defaults to 10.")
+        ("max-gap", po::value<double>(),
+         "Longest interval, in seconds, between consecutive positions that "
+         "is counted as dwell time. Longer intervals are gaps in tracking. "
+         "Defaults to 1.")
+        ("latest",
+         "If true, read the most recent position instead of every position. "
+         "The upstream component never waits for this accumulator. Dwell "
+         "times remain correct because they are taken from sample times.")
+        ;
+
+    return local_opts;
+}
+
+void Occupancy::applyConfiguration(const po::variables_map &vm,
+                                   const config::OptionTable &config_table)
+{
+    // Grid extent
+    std::vector<double> extent;
+    oat::config::getArray<double, 4>(vm, config_table, "extent", extent, true);
+    if (extent[2] <= extent[0] || extent[3] <= extent[1])
+        throw std::runtime_error("The extent must be [xmin, ymin, xmax, ymax] "
+                                 "with xmax > xmin and ymax > ymin.");
+
+    // Bin size
+    oat::config::getNumericValue<double>(
+        vm, config_table, "bin-size", bin_size_,
+        std::numeric_limits<double>::min());
+
+    x_min_ = extent[0];
+    y_min_ = extent[1];
+    cols_ = static_cast<int>(std::ceil((extent[2] - extent[0]) / bin_size_));
+    rows_ = static_cast<int>(std::ceil((extent[3] - extent[1]) / bin_size_));
+    bin_seconds_.assign(static_cast<size_t>(rows_) * cols_, 0);
+    bin_samples_.assign(bin_seconds_.size(), 0);
+
+    // Snapshots
+    oat::config::getValue<std::string>(
+        vm, config_table, "output", output_path_, true);
+
+    double period;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "period", period, 0.001))
+        period_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(period));
+
+    // Tracking gaps
+    oat::config::getNumericValue<double>(
+        vm, config_table, "max-gap", max_gap_s_, 0.0);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+}
+
+bool Occupancy::connectToNode()
+{
+    // Establish our a slot in the node
+    position_source_.touch(position_source_address_,
+                           latest_ ? SourceMode::LATEST : SourceMode::SYNC);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (position_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    next_snapshot_ = Clock::now() + period_;
+
+    return true;
+}
+
+int Occupancy::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (position_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // Copy the shared position
+    position_source_.copyTo(position_);
+
+    // Tell sink it can continue
+    position_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    accumulate(position_);
+
+    if (Clock::now() >= next_snapshot_) {
+        snapshot();
+        next_snapshot_ += period_;
+    }
+
+    return 0;
+}
+
+int Occupancy::binOf(const oat::Position2D &position) const
+{
+    const int c = static_cast<int>(
+        std::floor((position.position.x - x_min_) / bin_size_));
+    const int r = static_cast<int>(
+        std::floor((position.position.y - y_min_) / bin_size_));
+
+    if (c < 0 || c >= cols_ || r < 0 || r >= rows_)
+        return -1;
+
+    return r * cols_ + c;
+}
+
+void Occupancy::accumulate(const oat::Position2D &position)
+{
+    const int64_t usec = position.sample_usec();
+
+    // Credit the interval since the previous sample to where it was
+    if (have_last_ && last_valid_) {
+
+        const double dt = (usec - last_us_) * 1e-6;
+        if (dt > 0 && dt <= max_gap_s_) {
+
+            tracked_seconds_ += dt;
+            if (last_bin_ < 0)
+                outside_seconds_ += dt;
+            else
+                bin_seconds_[last_bin_] += dt;
+
+            if (!last_region_.empty())
+                regions_[last_region_].seconds += dt;
+        }
+    }
+
+    samples_++;
+
+    // Make this sample the previous one
+    std::string region;
+    if (position.position_valid && position.region_valid)
+        region = position.region;
+
+    if (!region.empty() && region != last_region_)
+        regions_[region].entries++;
+
+    have_last_ = true;
+    last_us_ = usec;
+    last_valid_ = position.position_valid;
+    last_region_ = region;
+    last_bin_ = -1;
+
+    if (position.position_valid) {
+        valid_samples_++;
+        unit_ = position.unit_of_length();
+        last_bin_ = binOf(position);
+        if (last_bin_ >= 0)
+            bin_samples_[last_bin_]++;
+    }
+}
+
+void Occupancy::snapshot()
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.SetMaxDecimalPlaces(6);
+
+    writer.StartObject();
+
+    writer.String("samples");
+    writer.Uint64(samples_);
+    writer.String("valid_samples");
+    writer.Uint64(valid_samples_);
+    writer.String("tracked_sec");
+    writer.Double(tracked_seconds_);
+    writer.String("outside_sec");
+    writer.Double(outside_seconds_);
+
+    // Grid, row-major from [xmin, ymin]
+    writer.String("unit");
+    writer.Int(static_cast<int>(unit_));
+    writer.String("origin");
+    writer.StartArray();
+    writer.Double(x_min_);
+    writer.Double(y_min_);
+    writer.EndArray();
+    writer.String("bin_size");
+    writer.Double(bin_size_);
+    writer.String("rows");
+    writer.Int(rows_);
+    writer.String("cols");
+    writer.Int(cols_);
+
+    writer.String("bin_sec");
+    writer.StartArray();
+    for (const auto s : bin_seconds_)
+        writer.Double(s);
+    writer.EndArray();
+
+    writer.String("bin_samples");
+    writer.StartArray();
+    for (const auto n : bin_samples_)
+        writer.Uint64(n);
+    writer.EndArray();
+
+    // Regions
+    writer.String("regions");
+    writer.StartObject();
+    for (const auto &r : regions_) {
+        writer.String(r.first.c_str());
+        writer.StartObject();
+        writer.String("sec");
+        writer.Double(r.second.seconds);
+        writer.String("entries");
+        writer.Uint64(r.second.entries);
+        writer.EndObject();
+    }
+    writer.EndObject();
+
+    writer.EndObject();
+
+    // Replace the previous snapshot only once this one is complete
+    const std::string tmp_path = output_path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        out << buffer.GetString() << '\n';
+        if (!out)
+            throw std::runtime_error("Could not write occupancy snapshot "
+                                     + tmp_path + ".");
+    }
+
+    if (std::rename(tmp_path.c_str(), output_path_.c_str()) != 0)
+        throw std::runtime_error("Could not replace occupancy snapshot "
+                                 + output_path_ + ".");
+
+    snapshots_++;
+}
+
+} /* namespace oat */
@@ -0,0 +1,127 @@
+//******************************************************************************
+//* File:   Occupancy.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_OCCUPANCY_H
+#define	OAT_OCCUPANCY_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/Source.h"
+
+namespace po = boost::program_options;
+
+namespace oat {
+
+class Occupancy : public Component, public Configurable<false> {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+    /**
+     * @brief Accumulates the time positions spend in each bin of a spatial
+     * grid and in each labelled region, and periodically writes a snapshot of
+     * the totals.
+     * @param position_source_address Position source to read from.
+     */
+    explicit Occupancy(const std::string &position_source_address);
+    ~Occupancy();
+
+    // Component Interface
+    oat::ComponentType type(void) const override { return oat::occupancy; };
+    std::string name(void) const override { return name_; }
+
+    /**
+     * @brief Number of positions accumulated.
+     */
+    uint64_t samples() const { return samples_; }
+
+    /**
+     * @brief Number of snapshots written.
+     */
+    uint64_t snapshots() const { return snapshots_; }
+
+private:
+    // Component Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Occupancy name
+    const std::string name_;
+
+    // The position SOURCE
+    const std::string position_source_address_;
+    oat::Source<oat::Position2D> position_source_;
+    oat::Position2D position_ {"occupancy"};
+    bool latest_ {false};
+
+    // Grid, in the units of the positions
+    double x_min_ {0}, y_min_ {0};
+    double bin_size_ {10};
+    int cols_ {0}, rows_ {0};
+
+    // Intervals longer than this are gaps in tracking and are not counted
+    double max_gap_s_ {1.0};
+
+    // Snapshots
+    std::string output_path_;
+    Clock::duration period_ {std::chrono::seconds(10)};
+    Clock::time_point next_snapshot_;
+    uint64_t snapshots_ {0};
+
+    // Totals. Each interval between consecutive samples is credited to the
+    // bin and region of the first of them.
+    struct Dwell {
+        double seconds {0};
+        uint64_t entries {0};
+    };
+    std::vector<double> bin_seconds_;
+    std::vector<uint64_t> bin_samples_;
+    std::map<std::string, Dwell> regions_;
+    double tracked_seconds_ {0};
+    double outside_seconds_ {0};
+    uint64_t samples_ {0};
+    uint64_t valid_samples_ {0};
+    DistanceUnit unit_ {DistanceUnit::PIXELS};
+
+    // Previous sample
+    bool have_last_ {false};
+    int64_t last_us_ {0};
+    int last_bin_ {-1};
+    bool last_valid_ {false};
+    std::string last_region_;
+
+    int binOf(const oat::Position2D &position) const;
+    void accumulate(const oat::Position2D &position);
+    void snapshot();
+};
+
+}      /* namespace oat */
+#endif /* OAT_OCCUPANCY_H */
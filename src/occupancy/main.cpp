@@ -0,0 +1,190 @@
+//******************************************************************************
+//* File:   main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/program_options.hpp>
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+
+#include "Occupancy.h"
+
+#define REQ_POSITIONAL_ARGS 1
+
+namespace po = boost::program_options;
+
+const char usage_io[] =
+    "SOURCE:\n"
+    "  User-supplied name of the memory segment to receive positions "
+    "from (e.g. pos).";
+
+const char purpose[] =
+    "Accumulate the time positions from SOURCE spend in each bin of a "
+    "spatial grid and in each region, and periodically write a snapshot "
+    "of the totals.";
+
+void printUsage(const po::options_description &options)
+{
+    std::cout <<
+    "Usage: occupancy [INFO]\n"
+    "   or: occupancy SOURCE [CONFIGURATION]\n";
+
+    std::cout << purpose << "\n\n";
+    std::cout << usage_io << "\n";
+    std::cout << options;
+}
+
+int main(int argc, char *argv[])
+{
+    // Results of command line input
+    std::string source;
+
+    // The component itself
+    std::string comp_name = "occupancy";
+    std::shared_ptr<oat::Occupancy> occupancy;
+
+    // Program options
+    po::options_description visible_options;
+
+    try {
+
+        // Required positional options
+        po::options_description positional_opt_desc("POSITIONAL");
+        positional_opt_desc.add_options()
+            ("source", po::value<std::string>(&source),
+             "User-supplied name of the memory segment to receive positions.")
+            ("type-args", po::value<std::vector<std::string> >(),
+             "type-specific arguments.")
+            ;
+
+        // Required positional arguments and configuration
+        po::positional_options_description positional_options;
+        positional_options.add("source", 1);
+        positional_options.add("type-args", -1);
+
+        // Visible options for help message
+        visible_options.add(oat::config::ComponentInfo::instance()->get());
+
+        // All options, including positional
+        po::options_description options;
+        options.add(positional_opt_desc)
+               .add(oat::config::ComponentInfo::instance()->get());
+
+        // Parse options, including unrecognized options which are
+        // component-specific
+        auto parsed_opt = po::command_line_parser(argc, argv)
+            .options(options)
+            .positional(positional_options)
+            .allow_unregistered()
+            .run();
+
+        po::variables_map option_map;
+        po::store(parsed_opt, option_map);
+
+        // Check options for errors and bind options to local variables
+        po::notify(option_map);
+
+        // Component program options
+        occupancy = std::make_shared<oat::Occupancy>(source);
+        po::options_description detail_opts {"CONFIGURATION"};
+        occupancy->appendOptions(detail_opts);
+        visible_options.add(detail_opts);
+        options.add(detail_opts);
+
+        // Check INFO arguments
+        if (option_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (option_map.count("version")) {
+            std::cout << oat::config::VERSION_STRING;
+            return 0;
+        }
+
+        // Check IO arguments
+        if (!option_map.count("source")) {
+            printUsage(visible_options);
+            std::cerr << oat::Error("A SOURCE must be specified.\n");
+            return -1;
+        }
+
+        // Get specialized component name
+        comp_name = occupancy->name();
+
+        // Reparse component options
+        auto special_opt =
+            po::collect_unrecognized(parsed_opt.options, po::include_positional);
+        special_opt.erase(special_opt.begin(),special_opt.begin() + REQ_POSITIONAL_ARGS);
+
+        po::store(po::command_line_parser(special_opt)
+                 .options(options)
+                 .run(), option_map);
+        po::notify(option_map);
+
+        occupancy->configure(option_map);
+
+        // Tell user
+        std::cout << oat::whoMessage(comp_name,
+                     "Listening to source " + oat::sourceText(source) + ".\n");
+        std::cout << oat::whoMessage(comp_name,
+                     "Press CTRL+C to exit.\n");
+
+        // Infinite loop until ctrl-c or end-of-stream signal
+        occupancy->run();
+
+        // Tell user
+        std::cout << oat::whoMessage(comp_name,
+                     std::to_string(occupancy->samples()) + " positions, "
+                     + std::to_string(occupancy->snapshots()) + " snapshots.\n")
+                  << oat::whoMessage(comp_name, "Exiting.")
+                  << std::endl;
+
+        // Exit success
+        return 0;
+
+    } catch (const po::error &ex) {
+        printUsage(visible_options);
+        std::cerr << oat::whoError(comp_name, ex.what()) << std::endl;
+    } catch (const cpptoml::parse_exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(TOML) ", ex.what()) << std::endl;
+    } catch (const cv::Exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(OPENCV) ", ex.what()) << std::endl;
+    } catch (const boost::interprocess::interprocess_exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(SHMEM) ", ex.what()) << std::endl;
+    } catch (const zmq::error_t &ex) {
+        if (ex.num() != EINTR)
+            std::cerr << oat::whoError(comp_name + "(ZMQ) " , ex.what()) << std::endl;
+    } catch (const std::runtime_error &ex) {
+        std::cerr << oat::whoError(comp_name, ex.what()) << std::endl;
+    } catch (...) {
+        std::cerr << oat::whoError(comp_name, "Unknown exception.")
+                  << std::endl;
+    }
+
+    // exit failure
+    return -1;
+}
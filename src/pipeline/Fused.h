@@ -0,0 +1,510 @@
+//******************************************************************************
+//* File:   Fused.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_FUSED_H
+#define OAT_FUSED_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "../framefilter/FrameFilter.h"
+#include "../positiondetector/PositionDetector.h"
+#include "../positionfilter/PositionFilter.h"
+
+namespace oat {
+namespace fuse {
+
+/**
+ * @brief What a sample is while it passes through a chain: a frame before
+ * the detector and a position after it.
+ */
+struct FrameDomain { };
+struct PositionDomain { };
+
+/**
+ * @brief Sample in flight through a chain.
+ */
+struct State {
+    cv::Mat frame;
+    oat::Position2D position {"fused"};
+};
+
+/**
+ * @brief Reaches the processing kernels of hosted component types, which
+ * are otherwise only called by the components' own processing loops.
+ */
+struct Access {
+
+    static oat::FrameParams outputParameters(FrameFilter &f,
+                                             const oat::FrameParams &in)
+    {
+        return f.outputParameters(in);
+    }
+
+    static bool publish(FrameFilter &f, oat::Sample &sample)
+    {
+        return f.publish(sample);
+    }
+
+    static void filter(FrameFilter &f, cv::Mat &frame) { f.filter(frame); }
+
+    static void prepare(PositionDetector &d, const oat::PixelColor color)
+    {
+        if (color != d.required_color_
+            && std::find(d.accepted_colors_.begin(),
+                         d.accepted_colors_.end(),
+                         color) == d.accepted_colors_.end()) {
+            throw std::runtime_error("Fused detector requires frames with "
+                                     "pixels of type "
+                                     + oat::color_str(d.required_color_)
+                                     + ". Maybe add a col stage?");
+        }
+
+        d.frame_color_ = color;
+    }
+
+    static void detect(PositionDetector &d,
+                       cv::Mat &frame,
+                       oat::Position2D &position)
+    {
+        d.detectPosition(frame, position);
+        d.orient(position);
+    }
+
+    static void filter(PositionFilter &f, oat::Position2D &position)
+    {
+        f.filter(position);
+    }
+};
+
+/**
+ * @brief Configure a kernel just as its own program would, from a
+ * '--config file key' pair.
+ * @param kernel Kernel to configure
+ * @param file Configuration file. Empty to use defaults.
+ * @param key Key of the kernel's table in file
+ */
+template <typename K>
+void configure(K &kernel, const std::string &file, const std::string &key)
+{
+    std::vector<std::string> args;
+    if (!key.empty())
+        args = {"--config", file, key};
+
+    po::options_description opts;
+    kernel.appendOptions(opts);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(args).options(opts).run(), vm);
+    po::notify(vm);
+
+    kernel.configure(vm);
+}
+
+/**
+ * @brief Frame filter T applied to the frame in flight.
+ */
+template <typename T>
+class FrameStage {
+
+    static_assert(std::is_base_of<FrameFilter, T>::value,
+                  "FrameStage requires a FrameFilter.");
+
+public:
+    using In = FrameDomain;
+    using Out = FrameDomain;
+
+    FrameStage(const std::string &source, const std::string &sink)
+    : kernel_(source, sink)
+    {
+        // Nothing
+    }
+
+    T &kernel(void) { return kernel_; }
+
+    void connect(oat::FrameParams &params)
+    {
+        params = Access::outputParameters(kernel_, params);
+    }
+
+    bool apply(State &state, oat::Sample &sample)
+    {
+        if (!Access::publish(kernel_, sample))
+            return false;
+
+        Access::filter(kernel_, state.frame);
+        return true;
+    }
+
+private:
+    T kernel_;
+};
+
+/**
+ * @brief Position detector T, which turns the frame in flight into a
+ * position. Only the detector's kernel is run: search windows, optical flow
+ * following, workers and deadlines, which its own component layers around
+ * the kernel, do not apply. Axis headings are still pointed along the
+ * object's motion.
+ */
+template <typename T>
+class DetectStage {
+
+    static_assert(std::is_base_of<PositionDetector, T>::value,
+                  "DetectStage requires a PositionDetector.");
+
+public:
+    using In = FrameDomain;
+    using Out = PositionDomain;
+
+    DetectStage(const std::string &source, const std::string &sink)
+    : kernel_(source, sink)
+    {
+        // Nothing
+    }
+
+    T &kernel(void) { return kernel_; }
+
+    void connect(oat::FrameParams &params)
+    {
+        Access::prepare(kernel_, params.color);
+    }
+
+    bool apply(State &state, oat::Sample &sample)
+    {
+        (void)sample;
+        Access::detect(kernel_, state.frame, state.position);
+        return true;
+    }
+
+private:
+    T kernel_;
+};
+
+/**
+ * @brief Position filter T applied to the position in flight.
+ */
+template <typename T>
+class PositionStage {
+
+    static_assert(std::is_base_of<PositionFilter, T>::value,
+                  "PositionStage requires a PositionFilter.");
+
+public:
+    using In = PositionDomain;
+    using Out = PositionDomain;
+
+    PositionStage(const std::string &source, const std::string &sink)
+    : kernel_(source, sink)
+    {
+        // Nothing
+    }
+
+    T &kernel(void) { return kernel_; }
+
+    void connect(oat::FrameParams &params) { (void)params; }
+
+    bool apply(State &state, oat::Sample &sample)
+    {
+        (void)sample;
+        Access::filter(kernel_, state.position);
+        return true;
+    }
+
+private:
+    T kernel_;
+};
+
+/**
+ * @brief Stages applied in order as a single, statically dispatched call.
+ * Each stage holds its kernel by value, so the kernel's type is known at
+ * every call and the compiler can resolve and inline its virtual methods.
+ * Adjacent stages must agree on whether a frame or a position passes
+ * between them.
+ */
+template <typename... Stages>
+class Chain;
+
+template <typename Last>
+class Chain<Last> {
+
+public:
+    using In = typename Last::In;
+    using Out = typename Last::Out;
+    static constexpr size_t size = 1;
+
+    Chain(const std::string &source, const std::string &sink)
+    : last_(source, sink)
+    {
+        // Nothing
+    }
+
+    void configure(const std::string &file,
+                   const std::vector<std::string> &keys,
+                   const size_t index = 0)
+    {
+        fuse::configure(last_.kernel(), file, keys[index]);
+    }
+
+    void connect(oat::FrameParams &params) { last_.connect(params); }
+
+    bool apply(State &state, oat::Sample &sample)
+    {
+        return last_.apply(state, sample);
+    }
+
+private:
+    Last last_;
+};
+
+template <typename Head, typename... Tail>
+class Chain<Head, Tail...> {
+
+    using Rest = Chain<Tail...>;
+
+    static_assert(std::is_same<typename Head::Out, typename Rest::In>::value,
+                  "A frame stage cannot follow the detector and a position "
+                  "stage cannot precede it.");
+
+public:
+    using In = typename Head::In;
+    using Out = typename Rest::Out;
+    static constexpr size_t size = 1 + Rest::size;
+
+    Chain(const std::string &source, const std::string &sink)
+    : head_(source, sink)
+    , rest_(source, sink)
+    {
+        // Nothing
+    }
+
+    void configure(const std::string &file,
+                   const std::vector<std::string> &keys,
+                   const size_t index = 0)
+    {
+        fuse::configure(head_.kernel(), file, keys[index]);
+        rest_.configure(file, keys, index + 1);
+    }
+
+    void connect(oat::FrameParams &params)
+    {
+        head_.connect(params);
+        rest_.connect(params);
+    }
+
+    bool apply(State &state, oat::Sample &sample)
+    {
+        return head_.apply(state, sample) && rest_.apply(state, sample);
+    }
+
+private:
+    Head head_;
+    Rest rest_;
+};
+
+}      /* namespace fuse */
+
+/**
+ * @brief Frame filters, a position detector and position filters fused into
+ * one component. Frames are read from a frame SOURCE, passed through the
+ * chain without intermediate nodes and the resulting positions published to
+ * a position SINK, so the whole chain costs one pair of shared memory
+ * exchanges and no handoffs between threads.
+ */
+template <typename C>
+class Fused : public Component, public Configurable<false> {
+
+    static_assert(std::is_same<typename C::In, fuse::FrameDomain>::value
+                  && std::is_same<typename C::Out, fuse::PositionDomain>::value,
+                  "A fused chain must turn frames into positions.");
+
+public:
+    /**
+     * @param frame_source_address Frame SOURCE node address
+     * @param position_sink_address Position SINK node address
+     * @param stage_keys Name of each stage, in order. Each is also the
+     * option naming the table that configures that stage.
+     */
+    Fused(const std::string &frame_source_address,
+          const std::string &position_sink_address,
+          const std::vector<std::string> &stage_keys)
+    : name_("fused[" + frame_source_address + "->" + position_sink_address + "]")
+    , frame_source_address_(frame_source_address)
+    , position_sink_address_(position_sink_address)
+    , stage_keys_(stage_keys)
+    , chain_(frame_source_address, position_sink_address)
+    {
+        if (stage_keys_.size() != C::size)
+            throw std::runtime_error("Fused chain needs a key per stage.");
+    }
+
+    // Component Interface
+    oat::ComponentType type(void) const override { return oat::positiondetector; }
+    std::string name(void) const override { return name_; }
+    bool ready(void) const override
+    {
+        return frame_source_.readable() && position_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        return {&frame_source_.sample_event(), position_sink_.sample_event()};
+    }
+
+private:
+    // Configurable Interface
+    po::options_description options() const override
+    {
+        po::options_description local_opts;
+        for (const auto &k : stage_keys_)
+            local_opts.add_options()
+                (k.c_str(), po::value<std::string>(),
+                 ("Key of the table, in the configuration file given with "
+                  "--config, that configures the " + k + " stage, as it "
+                  "would the component of that TYPE.").c_str())
+                ;
+
+        return local_opts;
+    }
+
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override
+    {
+        // Stage tables are looked up in this component's configuration file
+        std::string file;
+        if (!vm["config"].empty())
+            file = vm["config"].as<std::vector<std::string>>()[0];
+
+        std::vector<std::string> tables;
+        for (const auto &k : stage_keys_) {
+
+            std::string key;
+            if (oat::config::getValue(vm, config_table, k, key)
+                && file.empty())
+                throw std::runtime_error("Fused stage '" + k + "' must be "
+                                         "configured from the file given "
+                                         "with --config.");
+            tables.push_back(key);
+        }
+
+        chain_.configure(file, tables);
+    }
+
+    // Component Interface
+    bool connectToNode(void) override
+    {
+        // Establish our a slot in the node
+        frame_source_.touch(frame_source_address_);
+
+        // Wait for synchronous start with sink when it binds its node
+        if (frame_source_.connect() != SourceState::CONNECTED)
+            return false;
+
+        // Check that every stage accepts what the one before it produces
+        auto params = frame_source_.parameters();
+        internal_frame_.create(params.rows, params.cols, params.type);
+        chain_.connect(params);
+
+        position_sink_.bind(position_sink_address_, position_sink_address_);
+
+        return true;
+    }
+
+    int process(void) override
+    {
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sink to write to node
+        if (frame_source_.wait() == oat::NodeState::END)
+            return 1;
+
+        // Clone the shared frame
+        frame_source_.copyTo(internal_frame_);
+
+        // Tell sink it can continue
+        frame_source_.post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+        // Stages may reallocate the frame, so they work on a header of it
+        auto sample = internal_frame_.sample();
+        state_.frame = internal_frame_;
+        state_.position.set_record(oat::PositionRecord());
+        state_.position.set_sample(sample);
+
+        // Frames dropped by a stage are not published
+        if (!chain_.apply(state_, sample))
+            return 0;
+
+        state_.position.set_sample(sample);
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sources to read
+        position_sink_.wait();
+
+        position_sink_.write(state_.position);
+
+        // Tell sources there is new data
+        position_sink_.post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+        // Sink was not at END state
+        return 0;
+    }
+
+    const std::string name_;
+
+    // Frame source
+    const std::string frame_source_address_;
+    oat::Source<oat::Frame> frame_source_;
+
+    // Position sink
+    const std::string position_sink_address_;
+    oat::Sink<oat::Position2D> position_sink_;
+
+    // Stages
+    const std::vector<std::string> stage_keys_;
+    C chain_;
+
+    // Working copy of SOURCE frames and the sample in flight
+    oat::Frame internal_frame_;
+    fuse::State state_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_FUSED_H */
@@ -0,0 +1,284 @@
+//******************************************************************************
+//* File:   Pipeline.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "Pipeline.h"
+
+#include <exception>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+#include <boost/program_options.hpp>
+#include <cpptoml.h>
+
+#include "../../lib/base/Executor.h"
+#include "../../lib/base/Globals.h"
+#include "../../lib/shmemdf/Channel.h"
+
+#include "Fused.h"
+
+#include "../framefilter/BackgroundSubtractor.h"
+#include "../framefilter/BackgroundSubtractorMOG.h"
+#include "../framefilter/ColorConvert.h"
+#include "../framefilter/Decimator.h"
+#include "../framefilter/FrameFanout.h"
+#include "../framefilter/FrameMasker.h"
+#include "../framefilter/FusedFilter.h"
+#include "../framefilter/Threshold.h"
+#include "../framefilter/Undistorter.h"
+#include "../positiondetector/ArenaDetector.h"
+#include "../positiondetector/DifferenceDetector.h"
+#include "../positiondetector/HSVDetector.h"
+#include "../positiondetector/HSVMarkerDetector.h"
+#include "../positiondetector/MOGDetector.h"
+#include "../positiondetector/SimpleThreshold.h"
+#include "../positionfilter/HomographyTransform2D.h"
+#include "../positionfilter/KalmanFilter2D.h"
+#include "../positionfilter/MultiTargetTracker.h"
+#include "../positionfilter/PositionFilterChain.h"
+#include "../positionfilter/PositionPredictor.h"
+#include "../positionfilter/RegionFilter2D.h"
+
+namespace oat {
+
+namespace po = boost::program_options;
+
+// Chains hosted as single fused stages
+using FusedThreshRegion =
+    Fused<fuse::Chain<fuse::DetectStage<oat::SimpleThreshold>,
+                      fuse::PositionStage<oat::RegionFilter2D>>>;
+using FusedMaskThreshRegion =
+    Fused<fuse::Chain<fuse::FrameStage<oat::FrameMasker>,
+                      fuse::DetectStage<oat::SimpleThreshold>,
+                      fuse::PositionStage<oat::RegionFilter2D>>>;
+
+Pipeline::Pipeline(const std::string &file)
+{
+    // Will throw if file contains bad syntax
+    auto graph = cpptoml::parse_file(file);
+
+    auto stages = graph->get_table_array("stage");
+    if (!stages)
+        throw std::runtime_error("Pipeline file " + file + " does not "
+                                 "declare any [[stage]]s.");
+
+    for (const auto &t : *stages) {
+        std::vector<std::string> keys {"component", "type", "source", "sink"};
+        for (const auto &k : keys)
+            if (!t->contains(k))
+                throw std::runtime_error("Each pipeline stage requires a '"
+                                         + k + "' key.");
+    }
+
+    // Nodes between stages are held in-process before any stage is made
+    declareChannels(graph);
+
+    for (const auto &t : *stages) {
+
+        auto stage = makeStage(*t->get_as<std::string>("component"),
+                               *t->get_as<std::string>("type"),
+                               *t->get_as<std::string>("source"),
+                               *t->get_as<std::string>("sink"));
+
+        // Configure the stage just as its own program would, from a
+        // '--config file key' pair
+        po::options_description opts;
+        stage.configurable->appendOptions(opts);
+
+        std::vector<std::string> args;
+        if (t->contains("config")) {
+            auto config_file = t->contains("config-file")
+                ? *t->get_as<std::string>("config-file") : file;
+            args = {"--config", config_file, *t->get_as<std::string>("config")};
+        }
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(args).options(opts).run(), vm);
+        po::notify(vm);
+
+        stage.configurable->configure(vm);
+
+        stages_.push_back(std::move(stage));
+    }
+}
+
+void Pipeline::declareChannels(const std::shared_ptr<cpptoml::table> &graph)
+{
+    // Components that take several SOURCEs or SINKs take comma separated
+    // lists of addresses
+    auto addresses = [](const std::string &list) {
+        std::vector<std::string> a;
+        std::istringstream s {list};
+        std::string address;
+        while (std::getline(s, address, ','))
+            if (!address.empty())
+                a.push_back(address);
+        return a;
+    };
+
+    std::set<std::string> sinks, sources;
+    for (const auto &t : *graph->get_table_array("stage")) {
+        for (const auto &a : addresses(*t->get_as<std::string>("sink")))
+            sinks.insert(a);
+        for (const auto &a : addresses(*t->get_as<std::string>("source")))
+            sources.insert(a);
+    }
+
+    std::set<std::string> shared;
+    if (graph->contains("shared")) {
+        auto a = graph->get_array_of<std::string>("shared");
+        if (!a)
+            throw std::runtime_error("'shared' must be an array of node "
+                                     "addresses.");
+        shared.insert(a->begin(), a->end());
+    }
+
+    for (const auto &a : sinks) {
+        if (sources.count(a) == 0 || shared.count(a) > 0)
+            continue;
+
+        Channel::declare(a);
+        channels_.push_back(a);
+    }
+}
+
+Pipeline::Stage Pipeline::makeStage(const std::string &component,
+                                    const std::string &type,
+                                    const std::string &source,
+                                    const std::string &sink)
+{
+    if (component == "framefilt") {
+        if (type == "bsub")
+            return makeStage<oat::BackgroundSubtractor>(source, sink);
+        if (type == "mask")
+            return makeStage<oat::FrameMasker>(source, sink);
+        if (type == "mog")
+            return makeStage<oat::BackgroundSubtractorMOG>(source, sink);
+        if (type == "undistort")
+            return makeStage<oat::Undistorter>(source, sink);
+        if (type == "col")
+            return makeStage<oat::ColorConvert>(source, sink);
+        if (type == "thresh")
+            return makeStage<oat::Threshold>(source, sink);
+        if (type == "fused")
+            return makeStage<oat::FusedFilter>(source, sink);
+        if (type == "decimate")
+            return makeStage<oat::Decimator>(source, sink);
+        if (type == "fanout")
+            return makeStage<oat::FrameFanout>(source, sink);
+    } else if (component == "posidet") {
+        if (type == "diff")
+            return makeStage<oat::DifferenceDetector>(source, sink);
+        if (type == "hsv")
+            return makeStage<oat::HSVDetector>(source, sink);
+        if (type == "markers")
+            return makeStage<oat::HSVMarkerDetector>(source, sink);
+        if (type == "thresh")
+            return makeStage<oat::SimpleThreshold>(source, sink);
+        if (type == "mog")
+            return makeStage<oat::MOGDetector>(source, sink);
+        if (type == "arenas")
+            return makeStage<oat::ArenaDetector>(source, sink);
+    } else if (component == "posifilt") {
+        if (type == "kalman")
+            return makeStage<oat::KalmanFilter2D>(source, sink);
+        if (type == "homography")
+            return makeStage<oat::HomographyTransform2D>(source, sink);
+        if (type == "region")
+            return makeStage<oat::RegionFilter2D>(source, sink);
+        if (type == "track")
+            return makeStage<oat::MultiTargetTracker>(source, sink);
+        if (type == "chain")
+            return makeStage<oat::PositionFilterChain>(source, sink);
+        if (type == "predict")
+            return makeStage<oat::PositionPredictor>(source, sink);
+    } else if (component == "fused") {
+        if (type == "thresh-region")
+            return makeFusedStage<FusedThreshRegion>(
+                source, sink, {"thresh", "region"});
+        if (type == "mask-thresh-region")
+            return makeFusedStage<FusedMaskThreshRegion>(
+                source, sink, {"mask", "thresh", "region"});
+    } else {
+        throw std::runtime_error("Component '" + component + "' cannot be "
+                                 "hosted by a pipeline.");
+    }
+
+    throw std::runtime_error("Invalid TYPE '" + type + "' for component '"
+                             + component + "'.");
+}
+
+void Pipeline::run(size_t workers)
+{
+    if (workers == 0) {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+            && static_cast<size_t>(CPU_COUNT(&allowed)) < stages_.size())
+            workers = CPU_COUNT(&allowed);
+    }
+
+    // Fewer threads than stages are shared through an executor
+    if (workers > 0 && workers < stages_.size()) {
+        std::vector<std::shared_ptr<oat::Component>> components;
+        for (const auto &s : stages_)
+            components.push_back(s.component);
+
+        Executor(workers).run(components);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(stages_.size());
+
+    for (size_t i = 0; i < stages_.size(); i++) {
+        threads.emplace_back([this, i, &errors] {
+            try {
+                stages_[i].component->run();
+            } catch (...) {
+
+                // Bring the other stages down with this one
+                errors[i] = std::current_exception();
+                quit = 1;
+            }
+        });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    for (auto &e : errors)
+        if (e)
+            std::rethrow_exception(e);
+}
+
+std::vector<std::string> Pipeline::names() const
+{
+    std::vector<std::string> n;
+    for (const auto &s : stages_)
+        n.push_back(s.component->name());
+
+    return n;
+}
+
+} /* namespace oat */
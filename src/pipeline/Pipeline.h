@@ -0,0 +1,115 @@
+//******************************************************************************
+//* File:   Pipeline.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_PIPELINE_H
+#define OAT_PIPELINE_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cpptoml.h>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+
+namespace oat {
+
+/**
+ * @brief Hosts several components in a single process. Each component runs
+ * its processing loop on its own thread, so each stage behaves exactly as it
+ * would as a standalone program. A node that one stage writes and another
+ * reads is held in an in-process Channel rather than in shared memory, so
+ * hops between stages neither cross process boundaries nor map segments.
+ */
+class Pipeline {
+
+public:
+
+    /**
+     * @brief Build a pipeline from a TOML graph. Each [[stage]] entry of the
+     * file requires 'component' (framefilt, posidet, posifilt or fused),
+     * 'type', 'source' and 'sink' keys. An optional 'config' key names a
+     * table in the same file holding the component's configuration, just as
+     * the '-c file key' option of the component itself. An optional
+     * 'config-file' key takes that table from another file instead. An
+     * optional top level 'shared' array lists nodes between stages that are
+     * kept in shared memory, so that other programs can read them.
+     * @param file Pipeline configuration file.
+     */
+    explicit Pipeline(const std::string &file);
+
+    /**
+     * @brief Run every stage until they all reach the end of their streams
+     * or quit is requested.
+     * @param workers Number of threads shared by the stages. With 0, each
+     * stage runs on its own thread unless there are more stages than CPUs
+     * this process may use, in which case that many threads are shared.
+     */
+    void run(size_t workers = 0);
+
+    /**
+     * @brief Names of the stages in the order they were declared.
+     */
+    std::vector<std::string> names(void) const;
+
+    /**
+     * @brief Addresses of the nodes between stages that are held in-process.
+     */
+    const std::vector<std::string> &channels(void) const { return channels_; }
+
+private:
+
+    struct Stage {
+        std::shared_ptr<oat::Component> component;
+        std::shared_ptr<oat::Configurable<false>> configurable;
+    };
+
+    template <typename T>
+    static Stage makeStage(const std::string &source, const std::string &sink)
+    {
+        auto c = std::make_shared<T>(source, sink);
+        return Stage {c, c};
+    }
+
+    template <typename T>
+    static Stage makeFusedStage(const std::string &source,
+                                const std::string &sink,
+                                const std::vector<std::string> &stage_keys)
+    {
+        auto c = std::make_shared<T>(source, sink, stage_keys);
+        return Stage {c, c};
+    }
+
+    static Stage makeStage(const std::string &component,
+                           const std::string &type,
+                           const std::string &source,
+                           const std::string &sink);
+
+    // Declare the nodes between stages in-process, except for those the
+    // graph shares
+    void declareChannels(const std::shared_ptr<cpptoml::table> &graph);
+
+    std::vector<Stage> stages_;
+    std::vector<std::string> channels_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_PIPELINE_H */
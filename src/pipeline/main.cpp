@@ -0,0 +1,171 @@
+//******************************************************************************
+//* File:   oat pipeline main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include <iostream>
+#include <string>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/program_options.hpp>
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+
+#include "Pipeline.h"
+
+namespace po = boost::program_options;
+
+const char usage_file[] =
+    "FILE:\n"
+    "  TOML file declaring the pipeline's stages. Each [[stage]] requires\n"
+    "  'component' (framefilt, posidet or posifilt), 'type', 'source' and\n"
+    "  'sink' keys, which take the same values as the positional arguments\n"
+    "  of the component's own program. An optional 'config' key names a\n"
+    "  table in the same file holding the component's configuration, or in\n"
+    "  the file given by an optional 'config-file' key.\n\n"
+    "  Nodes that one stage writes and another reads are held in the\n"
+    "  memory of this process instead of in shared memory, so programs\n"
+    "  outside the pipeline cannot read them. A top level 'shared' array\n"
+    "  of addresses keeps the nodes it lists in shared memory.\n\n"
+    "  The fused component runs a fixed chain of frame filters, a position\n"
+    "  detector and position filters as one stage, with no nodes between\n"
+    "  them. Its TYPE is thresh-region (posidet thresh, then posifilt\n"
+    "  region) or mask-thresh-region (framefilt mask first). Its table names\n"
+    "  the table of each of its stages under the keys mask, thresh and\n"
+    "  region.";
+
+const char purpose[] =
+    "Run several processing components in a single process, each on its "
+    "own thread or sharing a few.";
+
+void printUsage(const po::options_description &options) {
+
+    std::cout <<
+    "Usage: pipeline [INFO]\n"
+    "   or: pipeline FILE [CONFIGURATION]\n";
+
+    std::cout << purpose << "\n";
+    std::cout << options << "\n";
+    std::cout << usage_file << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+    // Results of command line input
+    std::string file;
+    size_t workers = 0;
+
+    std::string comp_name = "pipeline";
+
+    // Program options
+    po::options_description visible_options;
+
+    try {
+
+        // Required positional options
+        po::options_description positional_opt_desc("POSITIONAL");
+        positional_opt_desc.add_options()
+            ("file", po::value<std::string>(&file),
+             "Pipeline configuration file.")
+            ;
+
+        po::positional_options_description positional_options;
+        positional_options.add("file", 1);
+
+        po::options_description config_opt_desc("CONFIGURATION");
+        config_opt_desc.add_options()
+            ("workers,w", po::value<size_t>(&workers),
+             "Number of threads shared by the stages. Each stage is run "
+             "whenever its SOURCE has a sample and its SINK a free buffer, by "
+             "whichever thread is idle. Defaults to one thread per stage, or "
+             "to one per CPU if there are more stages than the CPUs this "
+             "process may use.")
+            ;
+
+        // Visible options for help message
+        visible_options.add(oat::config::ComponentInfo::instance()->get())
+                       .add(config_opt_desc);
+
+        // All options, including positional
+        po::options_description options;
+        options.add(positional_opt_desc)
+               .add(oat::config::ComponentInfo::instance()->get())
+               .add(config_opt_desc);
+
+        po::variables_map option_map;
+        po::store(po::command_line_parser(argc, argv)
+                  .options(options)
+                  .positional(positional_options)
+                  .run(), option_map);
+        po::notify(option_map);
+
+        // Check INFO arguments
+        if (option_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (option_map.count("version")) {
+            std::cout << oat::config::VERSION_STRING;
+            return 0;
+        }
+
+        if (!option_map.count("file")) {
+            printUsage(visible_options);
+            std::cerr << oat::Error("A FILE must be specified.\n");
+            return -1;
+        }
+
+        oat::Pipeline pipeline(file);
+
+        // Tell user
+        for (const auto &n : pipeline.names())
+            std::cout << oat::whoMessage(comp_name, "Hosting " + n + ".\n");
+        std::cout << oat::whoMessage(comp_name, "Press CTRL+C to exit.\n");
+
+        // Infinite loop until ctrl-c or end of messages signal
+        pipeline.run(workers);
+
+        // Tell user
+        std::cout << oat::whoMessage(comp_name, "Exiting.")
+                  << std::endl;
+
+        // Exit success
+        return 0;
+
+    } catch (const po::error &ex) {
+        printUsage(visible_options);
+        std::cerr << oat::whoError(comp_name, ex.what()) << std::endl;
+    } catch (const cpptoml::parse_exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(TOML) ", ex.what()) << std::endl;
+    } catch (const cv::Exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(OPENCV) ", ex.what()) << std::endl;
+    } catch (const boost::interprocess::interprocess_exception &ex) {
+        std::cerr << oat::whoError(comp_name + "(SHMEM) ", ex.what()) << std::endl;
+    } catch (const std::runtime_error &ex) {
+        std::cerr << oat::whoError(comp_name, ex.what()) << std::endl;
+    } catch (...) {
+        std::cerr << oat::whoError(comp_name, "Unknown exception.")
+                  << std::endl;
+    }
+
+    // Exit failure
+    return -1;
+}
@@ -41,6 +41,8 @@ po::options_description MeanPosition::options() const
          "unspecified, the heading is not calculated.")
         ;
 
+    local_opts.add(alignmentOptions());
+
     return local_opts;
 }
 
@@ -55,6 +57,9 @@ void MeanPosition::applyConfiguration(const po::variables_map &vm,
     generate_heading_ = oat::config::getNumericValue<int>(
         vm, config_table, "heading-anchor", heading_anchor_idx_, 0, num_sources() - 1
     );
+
+    // Time alignment
+    PositionCombiner::configureAlignment(vm, config_table);
 }
 
 void MeanPosition::combine(const std::vector<oat::Position2D> &sources,
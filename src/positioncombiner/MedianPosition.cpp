@@ -0,0 +1,152 @@
+//******************************************************************************
+//* File:   MedianPosition.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "MedianPosition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+/**
+ * @brief Median of a set of values, which are reordered.
+ * @param v Values. Must not be empty.
+ * @return Median.
+ */
+static double median(std::vector<double> &v)
+{
+    const auto mid = v.begin() + v.size() / 2;
+    std::nth_element(v.begin(), mid, v.end());
+
+    if (v.size() % 2)
+        return *mid;
+
+    // Even counts average the two middle values
+    return 0.5 * (*mid + *std::max_element(v.begin(), mid));
+}
+
+po::options_description MedianPosition::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("reject,r", po::value<double>(),
+         "Distance from the median SOURCE position beyond which SOURCE "
+         "positions are rejected as outliers. The combined position is then "
+         "the mean of the remaining positions. If unspecified, the combined "
+         "position is the median.")
+        ;
+
+    local_opts.add(alignmentOptions());
+
+    return local_opts;
+}
+
+void MedianPosition::applyConfiguration(const po::variables_map &vm,
+                                        const config::OptionTable &config_table)
+{
+    // Setup sources and sink
+    PositionCombiner::resolvePositionSources(vm);
+
+    // Outlier rejection distance
+    oat::config::getNumericValue<double>(
+        vm, config_table, "reject", reject_, 0.0);
+
+    // No allocation while combining
+    xs_.reserve(num_sources());
+    ys_.reserve(num_sources());
+
+    // Time alignment
+    PositionCombiner::configureAlignment(vm, config_table);
+}
+
+void MedianPosition::combine(const std::vector<oat::Position2D> &sources,
+                             oat::Position2D &combined_position)
+{
+    xs_.clear();
+    ys_.clear();
+    for (const auto &pos : sources) {
+        if (pos.position_valid) {
+            xs_.push_back(pos.position.x);
+            ys_.push_back(pos.position.y);
+        }
+    }
+
+    combined_position.position_valid = !xs_.empty();
+    combined_position.velocity_valid = false;
+    combined_position.heading_valid = false;
+    combined_position.score = 0.0;
+
+    if (xs_.empty())
+        return;
+
+    const oat::Point2D m(median(xs_), median(ys_));
+
+    // Average the SOURCES that agree with the median
+    const double r2 = reject_ > 0 ? reject_ * reject_ : HUGE_VAL;
+    oat::Point2D p(0, 0);
+    oat::Velocity2D v(0, 0);
+    oat::UnitVector2D h(0, 0);
+    int np {0}, nv {0};
+
+    for (const auto &pos : sources) {
+
+        if (!pos.position_valid)
+            continue;
+
+        const oat::Point2D d = pos.position - m;
+        if (d.x * d.x + d.y * d.y > r2)
+            continue;
+
+        p += pos.position;
+        np++;
+        combined_position.score += pos.score;
+
+        if (pos.velocity_valid) {
+            v += pos.velocity;
+            nv++;
+        }
+
+        if (pos.heading_valid)
+            h += pos.heading;
+    }
+
+    // The component-wise median need not be near any position, in which
+    // case it stands
+    combined_position.position = reject_ > 0 && np > 0 ? p / np : m;
+
+    combined_position.velocity_valid = nv > 0;
+    if (nv > 0)
+        combined_position.velocity = v / nv;
+
+    // Renormalize head-direction unit vector
+    const double mag = std::sqrt(h.x * h.x + h.y * h.y);
+    combined_position.heading_valid = mag > 0;
+    if (mag > 0)
+        combined_position.heading = h / mag;
+}
+
+} /* namespace oat */
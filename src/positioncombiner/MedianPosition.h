@@ -0,0 +1,61 @@
+//******************************************************************************
+//* File:   MedianPosition.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_MEDIANPOSITION_H
+#define	OAT_MEDIANPOSITION_H
+
+#include "PositionCombiner.h"
+
+#include <string>
+#include <vector>
+
+namespace oat {
+
+/**
+ * A robust position combiner.
+ * Generates the component-wise median of valid SOURCE positions, which is
+ * unaffected by a minority of SOURCES reporting the wrong object. Optionally,
+ * SOURCE positions far from the median are rejected and the remaining ones
+ * are averaged.
+ */
+class MedianPosition : public PositionCombiner {
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    /**
+     * Calculate the median of SOURCE positions.
+     * @param sources SOURCE positions to combine
+     * @param combined_position Combined position output
+     */
+    void combine(const std::vector<oat::Position2D> &source_positions,
+                 oat::Position2D &combined_position) override;
+
+    /// Distance from the median beyond which positions are rejected. 0 to
+    /// use the median itself.
+    double reject_ {0.0};
+
+    /// Valid SOURCE position coordinates, reused across samples
+    std::vector<double> xs_, ys_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_MEDIANPOSITION_H */
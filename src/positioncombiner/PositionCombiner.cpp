@@ -22,6 +22,7 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <chrono>
 #include <utility>
 #include <thread>
 #include <future>
@@ -29,11 +30,16 @@
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
+#include "../../lib/utility/ClockOffset.h"
 #include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
+// Clock resolution reported for combined samples in time-aligned mode
+static constexpr int64_t ALIGN_POLL_NS {200000};
+
 void PositionCombiner::resolvePositionSources(const po::variables_map &vm)
 {
     // Pull the sources and sink out as positional options
@@ -61,6 +67,58 @@ void PositionCombiner::resolvePositionSources(const po::variables_map &vm)
     }
 }
 
+po::options_description PositionCombiner::alignmentOptions() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("align-rate", po::value<double>(),
+         "If specified, publish combined positions at this rate, in Hz, "
+         "rather than in lockstep with SOURCES, which would hold every "
+         "SOURCE to the rate of the slowest. Each SOURCE is read as soon as it "
+         "publishes and its position is interpolated, or extrapolated, to the "
+         "time of each combined sample. Sample times are the capture times "
+         "of SOURCE samples, when they carry one, and their sample "
+         "microseconds otherwise.")
+        ("align-delay", po::value<double>(),
+         "Time-aligned mode: seconds by which combined samples trail the "
+         "present. Delays longer than the slowest SOURCE's sample period and "
+         "latency allow positions to be interpolated rather than "
+         "extrapolated. Default is 0.")
+        ("max-extrapolation", po::value<double>(),
+         "Time-aligned mode: longest time, in seconds, that a SOURCE "
+         "position is extrapolated. SOURCES without a position within this "
+         "time of a combined sample are invalid in it. Default is 0.1.")
+        ;
+
+    return local_opts;
+}
+
+void PositionCombiner::configureAlignment(const po::variables_map &vm,
+                                          const config::OptionTable &config_table)
+{
+    // Combination rate
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "align-rate", align_rate_hz_, 0.0)) {
+
+        if (align_rate_hz_ <= 0.0)
+            throw std::runtime_error("align-rate must be greater than 0.");
+
+        combined_sample_.set_rate_hz(align_rate_hz_);
+    }
+
+    // Delay
+    double delay_sec = 0.0;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "align-delay", delay_sec, 0.0))
+        align_delay_ns_ = static_cast<int64_t>(delay_sec * 1e9);
+
+    // Extrapolation limit
+    double extrap_sec = 0.0;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "max-extrapolation", extrap_sec, 0.0))
+        max_extrapolation_ns_ = static_cast<int64_t>(extrap_sec * 1e9);
+}
+
 bool PositionCombiner::connectToNode()
 {
     // Establish our slot in each node
@@ -75,52 +133,141 @@ bool PositionCombiner::connectToNode()
     for (auto &ps : position_sources_) {
         if (ps.source->connect() != SourceState::CONNECTED)
             return false;
-        all_ts.push_back(ps.source->retrieve()->sample_period_sec());
+        all_ts.push_back(ps.source->retrieve()->sample.period_sec().count());
     }
 
-    if (!oat::checkSamplePeriods(all_ts, sample_rate_hz))
+    // Sources at different rates are expected in time-aligned mode
+    if (align_rate_hz_ > 0.0) {
+        histories_.resize(position_sources_.size());
+        next_combine_ns_ = oat::ClockOffset::hostNs();
+    } else if (!oat::checkSamplePeriods(all_ts, sample_rate_hz))
         std::cerr << oat::Warn(oat::inconsistentSampleRateWarning(sample_rate_hz));
 
-    // Bind to sink node and create a shared position
-    position_sink_.bind(position_sink_address_, position_sink_address_);
-    shared_position_ = position_sink_.retrieve();
+    bindSink(position_sink_address_);
 
     return true;
 }
 
+void PositionCombiner::bindSink(const std::string &address)
+{
+    // Bind to sink node and create a shared position
+    position_sink_.bind(address, address);
+}
+
+void PositionCombiner::publish(const oat::Sample &)
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    position_sink_.wait();
+
+    position_sink_.write(internal_position_);
+
+    // Tell sources there is new data
+    position_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+}
+
 int PositionCombiner::process()
 {
-    for (pvec_size_t i = 0; i != position_sources_.size(); i++) {
+    if (align_rate_hz_ > 0.0)
+        return processAligned();
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (oat::waitAll(position_sources_, positions_) == oat::NodeState::END)
+        return 1;
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    combine(positions_, internal_position_);
+    publish(positions_[0].sample());
+
+    // Sink was not at END state
+    return 0;
+}
+
+int PositionCombiner::readUntilDue()
+{
+    NodeState state;
+
+    sample_events_.clear();
+    for (auto &s : position_sources_)
+        sample_events_.push_back(&s.source->sample_event());
+    seen_generations_.resize(sample_events_.size());
+
+    while (!quit) {
+
+        // Generations first, so that a write made after a SOURCE is checked
+        // ends the sleep below
+        for (size_t i = 0; i < sample_events_.size(); i++)
+            seen_generations_[i] = sample_events_[i]->generation();
 
         // START CRITICAL SECTION //
         ////////////////////////////
-        if (position_sources_[i].source->wait() == oat::NodeState::END)
-            return 1;
+        for (pvec_size_t i = 0; i < position_sources_.size(); i++) {
+
+            auto &source = position_sources_[i].source;
+            if (!source->tryWait(state))
+                continue;
+
+            if (state == NodeState::END)
+                return 1;
 
-        positions_[i] = position_sources_[i].source->clone();
+            source->copyTo(positions_[i]);
+            source->post();
 
-        position_sources_[i].source->post();
+            histories_[i].push(positions_[i].record(),
+                               oat::ClockOffset::hostNs());
+        }
         ////////////////////////////
         //  END CRITICAL SECTION  //
+
+        const int64_t now = oat::ClockOffset::hostNs();
+        if (now >= next_combine_ns_)
+            break;
+
+        // Sleep until a SOURCE publishes or the combined sample is due
+        const int64_t sleep_ns = next_combine_ns_ - now;
+        SampleEvent::waitAny(sample_events_.data(),
+                             seen_generations_.data(),
+                             sample_events_.size(),
+                             std::chrono::nanoseconds(sleep_ns));
     }
 
-    combine(positions_, internal_position_);
+    return 0;
+}
 
-    // START CRITICAL SECTION //
-    ////////////////////////////
+int PositionCombiner::processAligned()
+{
+    if (readUntilDue() || quit)
+        return 1;
 
-    // Wait for sources to read
-    position_sink_.wait();
+    // Combined sample time. A combiner that has fallen more than a period
+    // behind skips ahead rather than publishing a burst.
+    const int64_t period_ns = static_cast<int64_t>(1e9 / align_rate_hz_);
+    const int64_t now = oat::ClockOffset::hostNs();
+    next_combine_ns_ += period_ns;
+    if (next_combine_ns_ < now)
+        next_combine_ns_ = now + period_ns;
 
-    *shared_position_ = internal_position_;
+    const int64_t t_ns = now - align_delay_ns_;
+    for (pvec_size_t i = 0; i < histories_.size(); i++)
+        histories_[i].estimate(t_ns, max_extrapolation_ns_, positions_[i]);
 
-    // Tell sources there is new data
-    position_sink_.post();
+    combine(positions_, internal_position_);
 
-    ////////////////////////////
-    //  END CRITICAL SECTION  //
+    // The combiner is the sample clock of its SINK
+    combined_sample_.incrementCount();
+    combined_sample_.set_clock(oat::Sample::ClockSource::HOST,
+                               t_ns,
+                               std::chrono::nanoseconds(ALIGN_POLL_NS));
+    internal_position_.set_sample(combined_sample_);
+    publish(combined_sample_);
 
-    // Sink was not at END state
     return 0;
 }
 
@@ -34,6 +34,8 @@
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
 
+#include "PositionHistory.h"
+
 namespace po = boost::program_options;
 
 namespace oat {
@@ -59,6 +61,21 @@ protected:
      */
     void resolvePositionSources(const po::variables_map &vm);
 
+    /**
+     * @brief Options controlling time-aligned combination, which TYPEs
+     * add to their own.
+     * @return Time alignment options.
+     */
+    po::options_description alignmentOptions(void) const;
+
+    /**
+     * @brief Configure time-aligned combination.
+     * @param vm Program options variable map.
+     * @param config_table Configuration table.
+     */
+    void configureAlignment(const po::variables_map &vm,
+                            const config::OptionTable &config_table);
+
     /**
      * Perform position combination.
      * @param sources SOURCE position servers
@@ -73,11 +90,33 @@ protected:
      */
     int num_sources(void) const { return position_sources_.size(); };
 
+    /**
+     * @brief Bind the SINK node. Combiners that publish something other
+     * than a Position2D override this together with publish().
+     * @param address SINK node address.
+     */
+    virtual void bindSink(const std::string &address);
+
+    /**
+     * @brief Publish the result of the last combine() to SINK.
+     * @param sample Sample of the combined result: that of the first SOURCE
+     * in lockstep mode, or the combiner's own in time-aligned mode.
+     */
+    virtual void publish(const oat::Sample &sample);
+
 private:
     // Component Interface
     virtual bool connectToNode(void) override;
     int process(void) override;
 
+    /**
+     * @brief Read each SOURCE as soon as it publishes, until the next
+     * combined sample is due.
+     * @return 1 if a SOURCE has ended.
+     */
+    int readUntilDue(void);
+    int processAligned(void);
+
     // Combiner name
     std::string name_;
 
@@ -85,11 +124,23 @@ private:
     std::vector<oat::Position2D> positions_;
     oat::NamedSourceList<oat::Position2D> position_sources_;
 
+    // Time-aligned combination, or 0 to combine in lockstep with SOURCES
+    double align_rate_hz_ {0.0};
+    int64_t align_delay_ns_ {0};
+    int64_t max_extrapolation_ns_ {100000000};
+    int64_t next_combine_ns_ {0};
+    oat::Sample combined_sample_;
+    std::vector<oat::PositionHistory> histories_;
+
+    // Write events of the SOURCES and their generations, which
+    // readUntilDue() sleeps on between reads
+    std::vector<oat::SampleEvent *> sample_events_;
+    std::vector<uint32_t> seen_generations_;
+
     // Combined position
     oat::Position2D internal_position_ {"internal"};
 
     // Position SINK object for publishing combined position
-    oat::Position2D * shared_position_ {nullptr};
     std::string position_sink_address_;
     oat::Sink<oat::Position2D> position_sink_;
 };
@@ -0,0 +1,215 @@
+//******************************************************************************
+//* File:   PositionHistory.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_POSITIONHISTORY_H
+#define	OAT_POSITIONHISTORY_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/Sample.h"
+#include "../../lib/utility/ClockOffset.h"
+
+namespace oat {
+
+/**
+ * @brief Recent positions from a single SOURCE, each with the time at which
+ * it was captured on the host steady_clock. The position at nearby times is
+ * estimated from them by interpolation and limited extrapolation, so that
+ * SOURCES publishing at different rates and phases can be combined on a
+ * common clock.
+ */
+class PositionHistory {
+public:
+
+    // Number of positions kept
+    static constexpr size_t CAPACITY {16};
+
+    /**
+     * @brief Add a position read from the SOURCE.
+     * @param record Position.
+     * @param arrival_ns Host steady_clock time at which it was read, in
+     * nanoseconds.
+     */
+    void push(const oat::PositionRecord &record, const int64_t arrival_ns)
+    {
+        const int64_t t = captureNs(record.sample, arrival_ns);
+
+        // Times must increase, which they do not after a SOURCE restart
+        if (size_ > 0 && t <= at(size_ - 1).t_ns)
+            size_ = 0;
+
+        if (size_ == CAPACITY) {
+            first_ = (first_ + 1) % CAPACITY;
+            size_--;
+        }
+
+        Entry &e = entries_[(first_ + size_) % CAPACITY];
+        e.t_ns = t;
+        e.record = record;
+        size_++;
+    }
+
+    /**
+     * @brief Estimate the position at a given time. Between two positions,
+     * it is interpolated. After the latest position, it is extrapolated using
+     * the reported velocity or, if there is none, the last displacement.
+     * @param t_ns Host steady_clock time in nanoseconds.
+     * @param max_extrapolation_ns Largest time past the latest, or before the
+     * earliest, position for which an estimate is made.
+     * @param position Estimated position. Its label, unit of length and
+     * homography are untouched. All fields are invalid if no estimate can be
+     * made.
+     * @return True if an estimate was made.
+     */
+    bool estimate(const int64_t t_ns,
+                  const int64_t max_extrapolation_ns,
+                  oat::Position2D &position) const
+    {
+        // Latest position at or before t_ns
+        size_t k = size_;
+        while (k > 0 && at(k - 1).t_ns > t_ns)
+            k--;
+
+        if (k == 0) {
+
+            // Before the earliest position, which is held
+            if (size_ == 0 || at(0).t_ns - t_ns > max_extrapolation_ns)
+                return invalidate(position);
+
+            position.set_record(at(0).record);
+            return true;
+        }
+
+        if (k < size_) {
+            interpolate(at(k - 1), at(k), t_ns, position);
+            return true;
+        }
+
+        // After the latest position
+        const Entry &e = at(size_ - 1);
+        const int64_t dt_ns = t_ns - e.t_ns;
+        if (dt_ns > max_extrapolation_ns)
+            return invalidate(position);
+
+        position.set_record(e.record);
+        if (!position.position_valid || dt_ns == 0)
+            return true;
+
+        Velocity2D v;
+        if (position.velocity_valid) {
+            v = position.velocity;
+        } else if (size_ > 1 && at(size_ - 2).record.position_valid) {
+            const Entry &p = at(size_ - 2);
+            v = Velocity2D(e.record.position[0] - p.record.position[0],
+                           e.record.position[1] - p.record.position[1])
+                * (1e9 / (e.t_ns - p.t_ns));
+        } else {
+            return true;
+        }
+
+        position.position += v * (dt_ns * 1e-9);
+        return true;
+    }
+
+    /**
+     * @brief Host steady_clock time of the latest position, in nanoseconds.
+     * 0 if there is none.
+     */
+    int64_t latest_ns(void) const
+    {
+        return size_ == 0 ? 0 : at(size_ - 1).t_ns;
+    }
+
+private:
+
+    struct Entry {
+        int64_t t_ns {0};
+        oat::PositionRecord record;
+    };
+
+    std::array<Entry, CAPACITY> entries_;
+    size_t first_ {0};
+    size_t size_ {0};
+
+    // Maps sample times onto the host clock for SOURCES without a capture
+    // time
+    oat::ClockOffset clock_;
+
+    const Entry &at(const size_t i) const
+    {
+        return entries_[(first_ + i) % CAPACITY];
+    }
+
+    int64_t captureNs(const oat::Sample &s, const int64_t arrival_ns)
+    {
+        if (s.clock_source() != Sample::ClockSource::NONE)
+            return static_cast<int64_t>(s.host_ns());
+
+        // Sample times are exact but have an unknown origin. Uncounted
+        // samples only have their arrival time.
+        if (s.count() == 0)
+            return arrival_ns;
+
+        return clock_.update(s.microseconds().count() * 1000, arrival_ns);
+    }
+
+    static bool invalidate(oat::Position2D &position)
+    {
+        position.position_valid = false;
+        position.velocity_valid = false;
+        position.heading_valid = false;
+        position.region_valid = false;
+        return false;
+    }
+
+    static void interpolate(const Entry &a,
+                            const Entry &b,
+                            const int64_t t_ns,
+                            oat::Position2D &position)
+    {
+        const double f
+            = static_cast<double>(t_ns - a.t_ns) / (b.t_ns - a.t_ns);
+
+        // Region and sample are those of the nearest position
+        position.set_record(f < 0.5 ? a.record : b.record);
+
+        auto lerp = [f](const double *u, const double *w) {
+            return Point2D(u[0] + f * (w[0] - u[0]), u[1] + f * (w[1] - u[1]));
+        };
+
+        if (a.record.position_valid && b.record.position_valid)
+            position.position = lerp(a.record.position, b.record.position);
+
+        if (a.record.velocity_valid && b.record.velocity_valid)
+            position.velocity = lerp(a.record.velocity, b.record.velocity);
+
+        if (a.record.heading_valid && b.record.heading_valid) {
+            const UnitVector2D h = lerp(a.record.heading, b.record.heading);
+            const double mag = std::sqrt(h.x * h.x + h.y * h.y);
+            if (mag > 0)
+                position.heading = h / mag;
+        }
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONHISTORY_H */
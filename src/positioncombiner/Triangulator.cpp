@@ -0,0 +1,276 @@
+//******************************************************************************
+//* File:   Triangulator.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "Triangulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Rows of a nested TOML array of doubles, each with one of the given lengths
+static std::vector<std::vector<double>>
+getRows(const po::variables_map &vm,
+        const config::OptionTable &config_table,
+        const std::string &key,
+        const std::vector<size_t> &lengths,
+        const bool required)
+{
+    if (vm.count(key))
+        throw std::runtime_error(key + " can only be specified using a "
+                                 "config file.");
+
+    std::vector<std::vector<double>> rows;
+    oat::config::Array arr;
+    if (!oat::config::getArray(config_table, key, arr, required))
+        return rows;
+
+    for (const auto &v : arr->nested_array()) {
+
+        std::vector<double> row;
+        for (const auto &x : v->array_of<double>())
+            row.push_back(x->get());
+
+        if (std::find(lengths.begin(), lengths.end(), row.size()) == lengths.end())
+            throw std::runtime_error("Each element of " + key + " must be an "
+                                     "array of " + std::to_string(lengths[0])
+                                     + " doubles.");
+
+        rows.push_back(std::move(row));
+    }
+
+    return rows;
+}
+
+po::options_description Triangulator::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("targets,t", po::value<size_t>(),
+         "Number of targets seen by each camera. SOURCES are grouped by "
+         "camera: the first targets SOURCES are the pixel positions of each "
+         "target in camera 0, the next in camera 1, and so on. Default is 1.")
+        ("camera-matrices", po::value<std::string>(),
+         "NOTE: Can only be specified in a config file.\n"
+         "Nested array holding the 9-element camera matrix of each camera, "
+         "as saved by oat-calibrate camera.")
+        ("distortion-coeffs", po::value<std::string>(),
+         "NOTE: Can only be specified in a config file.\n"
+         "Nested array holding the distortion coefficients of each camera, "
+         "as saved by oat-calibrate camera. If unspecified, positions are "
+         "assumed to be free of lens distortion, e.g. because frames were "
+         "undistorted by oat-framefilt undistort.")
+        ("rotations", po::value<std::string>(),
+         "NOTE: Can only be specified in a config file.\n"
+         "Nested array holding the rotation from world to camera coordinates "
+         "of each camera, either as a 3-element Rodrigues vector, e.g. from "
+         "cv::solvePnP, or as a 9-element rotation matrix.")
+        ("translations", po::value<std::string>(),
+         "NOTE: Can only be specified in a config file.\n"
+         "Nested array holding the 3-element translation from world to "
+         "camera coordinates of each camera, in the world units of the "
+         "published positions.")
+        ("max-error", po::value<double>(),
+         "Largest mean reprojection error, in pixels, of a valid position. "
+         "Targets whose views do not agree to within it, e.g. because a "
+         "camera detected a reflection, are invalid. If unspecified, any "
+         "target seen by two or more cameras is valid.")
+        ;
+
+    local_opts.add(alignmentOptions());
+
+    return local_opts;
+}
+
+void Triangulator::applyConfiguration(const po::variables_map &vm,
+                                      const config::OptionTable &config_table)
+{
+    // Setup sources and sink
+    PositionCombiner::resolvePositionSources(vm);
+
+    // Targets
+    oat::config::getNumericValue<size_t>(vm, config_table, "targets",
+            num_targets_, 1, oat::Position3D::CAPACITY);
+
+    if (num_sources() % num_targets_ != 0)
+        throw std::runtime_error("Each camera must have one SOURCE per target.");
+
+    const size_t num_cameras = num_sources() / num_targets_;
+    if (num_cameras < 2)
+        throw std::runtime_error("Triangulation requires at least two cameras.");
+
+    // Calibration
+    auto k = getRows(vm, config_table, "camera-matrices", {9}, true);
+    auto d = getRows(vm, config_table, "distortion-coeffs", {4, 5, 8, 12, 14}, false);
+    auto r = getRows(vm, config_table, "rotations", {3, 9}, true);
+    auto t = getRows(vm, config_table, "translations", {3}, true);
+
+    if (k.size() != num_cameras || r.size() != num_cameras
+        || t.size() != num_cameras || !(d.empty() || d.size() == num_cameras))
+        throw std::runtime_error("Calibration must be given for each of the "
+                                 + std::to_string(num_cameras) + " cameras.");
+
+    for (size_t c = 0; c < num_cameras; c++) {
+
+        camera_matrices_.emplace_back(k[c].data());
+        distortion_coeffs_.push_back(
+            d.empty() ? cv::Mat() : cv::Mat(d[c], true));
+
+        cv::Matx33d R;
+        if (r[c].size() == 3)
+            cv::Rodrigues(cv::Vec3d(r[c].data()), R);
+        else
+            R = cv::Matx33d(r[c].data());
+
+        projections_.emplace_back(R(0, 0), R(0, 1), R(0, 2), t[c][0],
+                                  R(1, 0), R(1, 1), R(1, 2), t[c][1],
+                                  R(2, 0), R(2, 1), R(2, 2), t[c][2]);
+    }
+
+    pixel_points_.resize(num_targets_);
+    image_points_.assign(num_cameras, std::vector<cv::Point2d>(num_targets_));
+    image_valid_.assign(num_cameras, std::vector<bool>(num_targets_));
+    positions_3d_.resize(num_targets_);
+
+    // Reprojection error limit
+    oat::config::getNumericValue<double>(
+        vm, config_table, "max-error", max_error_, 0.0);
+
+    // Time alignment
+    PositionCombiner::configureAlignment(vm, config_table);
+}
+
+void Triangulator::combine(const std::vector<oat::Position2D> &sources,
+                           oat::Position2D &)
+{
+    // Normalized image coordinates, undistorting all of a camera's targets
+    // at once
+    for (size_t c = 0; c < projections_.size(); c++) {
+
+        auto &pts = pixel_points_;
+        for (size_t i = 0; i < num_targets_; i++) {
+
+            const auto &pos = sources[c * num_targets_ + i];
+            if (pos.position_valid
+                && pos.unit_of_length() != oat::DistanceUnit::PIXELS)
+                throw std::runtime_error("SOURCE positions must be in pixels "
+                                         "to be triangulated.");
+
+            image_valid_[c][i] = pos.position_valid;
+            pts[i] = pos.position_valid ? pos.position : oat::Point2D(0, 0);
+        }
+
+        cv::undistortPoints(pts, image_points_[c],
+                            camera_matrices_[c], distortion_coeffs_[c]);
+    }
+
+    for (size_t i = 0; i < num_targets_; i++) {
+
+        // Each view contributes two rows of the DLT system A X = 0. Only
+        // A^T A is needed, which keeps the system 4x4 however many cameras
+        // there are.
+        cv::Matx44d AtA = cv::Matx44d::zeros();
+        uint32_t views = 0;
+        for (size_t c = 0; c < projections_.size(); c++) {
+
+            if (!image_valid_[c][i])
+                continue;
+
+            const auto &P = projections_[c];
+            const auto &p = image_points_[c][i];
+            const cv::Matx14d a = p.x * P.row(2) - P.row(0);
+            const cv::Matx14d b = p.y * P.row(2) - P.row(1);
+            AtA += a.t() * a + b.t() * b;
+            views++;
+        }
+
+        positions_3d_.valid[i] = false;
+        positions_3d_.views[i] = views;
+        if (views < 2)
+            continue;
+
+        // Homogeneous solution is the singular vector of least singular value
+        cv::Matx41d w;
+        cv::Matx44d u, vt;
+        cv::SVD::compute(AtA, w, u, vt);
+        if (std::abs(vt(3, 3)) < 1e-12)
+            continue;
+
+        const cv::Vec4d X(vt(3, 0) / vt(3, 3),
+                          vt(3, 1) / vt(3, 3),
+                          vt(3, 2) / vt(3, 3),
+                          1.0);
+
+        // Reprojection error, in pixels. Points behind a camera are invalid.
+        double error = 0;
+        bool in_front = true;
+        for (size_t c = 0; c < projections_.size(); c++) {
+
+            if (!image_valid_[c][i])
+                continue;
+
+            const auto x = projections_[c] * X;
+            in_front &= x(2) > 0;
+
+            const auto &K = camera_matrices_[c];
+            const double dx = x(0) / x(2) - image_points_[c][i].x;
+            const double dy = x(1) / x(2) - image_points_[c][i].y;
+            error += std::sqrt(std::pow(K(0, 0) * dx + K(0, 1) * dy, 2.0)
+                               + std::pow(K(1, 1) * dy, 2.0));
+        }
+        error /= views;
+
+        positions_3d_.x[i] = X(0);
+        positions_3d_.y[i] = X(1);
+        positions_3d_.z[i] = X(2);
+        positions_3d_.error[i] = error;
+        positions_3d_.valid[i]
+            = in_front && (max_error_ <= 0 || error <= max_error_);
+    }
+}
+
+void Triangulator::bindSink(const std::string &address)
+{
+    position_3d_sink_.bind(address);
+}
+
+void Triangulator::publish(const oat::Sample &sample)
+{
+    positions_3d_.set_sample(sample);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    position_3d_sink_.wait();
+    *position_3d_sink_.retrieve() = positions_3d_;
+    position_3d_sink_.post();
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+}
+
+} /* namespace oat */
@@ -0,0 +1,85 @@
+//******************************************************************************
+//* File:   Triangulator.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_TRIANGULATOR_H
+#define	OAT_TRIANGULATOR_H
+
+#include "PositionCombiner.h"
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/datatypes/Position3D.h"
+#include "../../lib/shmemdf/Sink.h"
+
+namespace oat {
+
+/**
+ * A multi-camera triangulating position combiner.
+ * SOURCES hold pixel positions of the same targets seen by two or more
+ * calibrated cameras. Each target is triangulated from every camera that
+ * sees it, by linear least squares on cached projection matrices, and the
+ * resulting set of 3D positions is published as a Position3D.
+ */
+class Triangulator : public PositionCombiner {
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    /**
+     * Triangulate each target from the SOURCE positions of every camera.
+     * @param sources SOURCE positions, grouped by camera
+     * @param combined_position Unused. The result is kept for publish().
+     */
+    void combine(const std::vector<oat::Position2D> &source_positions,
+                 oat::Position2D &combined_position) override;
+
+    // Publish a Position3D instead of a Position2D
+    void bindSink(const std::string &address) override;
+    void publish(const oat::Sample &sample) override;
+
+    /// Number of targets seen by each camera
+    size_t num_targets_ {1};
+
+    /// Largest mean reprojection error, in pixels, of a valid position
+    double max_error_ {0.0};
+
+    // Per-camera calibration. Projection matrices are of normalized image
+    // coordinates, i.e. [R|t], so that triangulation is well conditioned.
+    std::vector<cv::Matx33d> camera_matrices_;
+    std::vector<cv::Mat> distortion_coeffs_;
+    std::vector<cv::Matx34d> projections_;
+
+    // Pixel coordinates of each target in one camera, and undistorted,
+    // normalized image coordinates of each target, by camera
+    std::vector<cv::Point2d> pixel_points_;
+    std::vector<std::vector<cv::Point2d>> image_points_;
+    std::vector<std::vector<bool>> image_valid_;
+
+    // Triangulated positions
+    oat::Position3D positions_3d_;
+    oat::Sink<oat::Position3D> position_3d_sink_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_TRIANGULATOR_H */
@@ -0,0 +1,123 @@
+//******************************************************************************
+//* File:   WeightedPosition.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "WeightedPosition.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+po::options_description WeightedPosition::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("weights,w", po::value<std::string>(),
+         "Array of non-negative weights, one per SOURCE, e.g. [1.0,0.5], "
+         "specifying the confidence in each SOURCE, e.g. from camera "
+         "resolution. Default is equal weights.")
+        ("use-score,s",
+         "Multiply the weight of each SOURCE position by its "
+         "detection score, e.g. the area of the detected object. SOURCE "
+         "positions with a score of 0 then get no weight.")
+        ;
+
+    local_opts.add(alignmentOptions());
+
+    return local_opts;
+}
+
+void WeightedPosition::applyConfiguration(const po::variables_map &vm,
+                                          const config::OptionTable &config_table)
+{
+    // Setup sources and sink
+    PositionCombiner::resolvePositionSources(vm);
+
+    // Weights
+    weights_.assign(num_sources(), 1.0);
+    std::vector<double> w;
+    if (oat::config::getArray<double>(vm, config_table, "weights", w)) {
+
+        if (w.size() != weights_.size())
+            throw std::runtime_error("There must be one weight per SOURCE.");
+
+        for (const auto x : w)
+            if (x < 0)
+                throw std::runtime_error("Weights must be non-negative.");
+
+        weights_ = w;
+    }
+
+    // Score weighting
+    oat::config::getValue<bool>(vm, config_table, "use-score", use_score_);
+
+    // Time alignment
+    PositionCombiner::configureAlignment(vm, config_table);
+}
+
+void WeightedPosition::combine(const std::vector<oat::Position2D> &sources,
+                               oat::Position2D &combined_position)
+{
+    double wp {0.0}, wv {0.0}, wh {0.0}, score {0.0};
+    oat::Point2D p(0, 0);
+    oat::Velocity2D v(0, 0);
+    oat::UnitVector2D h(0, 0);
+
+    // Invalid fields have zero weight rather than a branch
+    for (size_t i = 0; i < sources.size(); i++) {
+
+        const auto &pos = sources[i];
+        const double w = weights_[i] * (use_score_ ? pos.score : 1.0);
+
+        const double a = w * pos.position_valid;
+        const double b = w * pos.velocity_valid;
+        const double c = w * pos.heading_valid;
+
+        // Invalid fields might hold anything, including NaN
+        p += a * (a > 0 ? pos.position : oat::Point2D(0, 0));
+        v += b * (b > 0 ? pos.velocity : oat::Velocity2D(0, 0));
+        h += c * (c > 0 ? pos.heading : oat::UnitVector2D(0, 0));
+
+        wp += a;
+        wv += b;
+        wh += c;
+        score += pos.score * pos.position_valid;
+    }
+
+    combined_position.position_valid = wp > 0;
+    combined_position.velocity_valid = wv > 0;
+    combined_position.position = wp > 0 ? p / wp : oat::Point2D(0, 0);
+    combined_position.velocity = wv > 0 ? v / wv : oat::Velocity2D(0, 0);
+    combined_position.score = score;
+
+    // Renormalize head-direction unit vector
+    const double mag = std::sqrt(h.x * h.x + h.y * h.y);
+    combined_position.heading_valid = wh > 0 && mag > 0;
+    combined_position.heading
+        = combined_position.heading_valid ? h / mag : oat::UnitVector2D(0, 0);
+}
+
+} /* namespace oat */
@@ -0,0 +1,60 @@
+//******************************************************************************
+//* File:   WeightedPosition.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_WEIGHTEDPOSITION_H
+#define	OAT_WEIGHTEDPOSITION_H
+
+#include "PositionCombiner.h"
+
+#include <string>
+#include <vector>
+
+namespace oat {
+
+/**
+ * A weighted mean position combiner.
+ * Each SOURCE position is weighted by a fixed per-SOURCE weight and,
+ * optionally, by its detection score, e.g. object area. Invalid SOURCE
+ * positions get no weight, so the combined position is valid as long as any
+ * SOURCE position is.
+ */
+class WeightedPosition : public PositionCombiner {
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    /**
+     * Calculate the weighted mean of SOURCE positions.
+     * @param sources SOURCE positions to combine
+     * @param combined_position Combined position output
+     */
+    void combine(const std::vector<oat::Position2D> &source_positions,
+                 oat::Position2D &combined_position) override;
+
+    /// Fixed weight of each SOURCE
+    std::vector<double> weights_;
+
+    /// Should weights be multiplied by SOURCE position scores?
+    bool use_score_ {false};
+};
+
+}      /* namespace oat */
+#endif /* OAT_WEIGHTEDPOSITION_H */
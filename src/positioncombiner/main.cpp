@@ -33,7 +33,10 @@
 #include "../../lib/utility/ProgramOptions.h"
 
 #include "MeanPosition.h"
+#include "MedianPosition.h"
 #include "PositionCombiner.h"
+#include "Triangulator.h"
+#include "WeightedPosition.h"
 
 #define REQ_POSITIONAL_ARGS 1
 
@@ -41,7 +44,10 @@ namespace po = boost::program_options;
 
 const char usage_type[] =
     "TYPE\n"
-    "  mean: Geometric mean of positions";
+    "  mean: Geometric mean of positions\n"
+    "  weighted: Weighted mean of valid positions, e.g. by detected object area\n"
+    "  median: Median of valid positions, optionally rejecting outliers\n"
+    "  triangulate: 3D positions of targets seen by calibrated cameras";
 
 const char usage_io[] =
     "SOURCES:\n"
@@ -87,6 +93,9 @@ int main(int argc, char *argv[]) {
     // Component specializations
     std::unordered_map<std::string, char> type_hash;
     type_hash["mean"] = 'a';
+    type_hash["weighted"] = 'b';
+    type_hash["median"] = 'c';
+    type_hash["triangulate"] = 'd';
 
     // The component itself
     std::string comp_name = "posicom";
@@ -145,6 +154,21 @@ int main(int argc, char *argv[]) {
                     combiner = std::make_shared<oat::MeanPosition>();
                     break;
                 }
+                case 'b':
+                {
+                    combiner = std::make_shared<oat::WeightedPosition>();
+                    break;
+                }
+                case 'c':
+                {
+                    combiner = std::make_shared<oat::MedianPosition>();
+                    break;
+                }
+                case 'd':
+                {
+                    combiner = std::make_shared<oat::Triangulator>();
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
@@ -0,0 +1,124 @@
+//******************************************************************************
+//* File:   AdaptiveThreshold.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "AdaptiveThreshold.h"
+
+#include <cstring>
+
+namespace oat {
+
+void AdaptiveThreshold::configure(Method method,
+                                  int stride,
+                                  double decay,
+                                  double percentile)
+{
+    method_ = method;
+    stride_ = stride;
+    decay_ = static_cast<float>(decay);
+    percentile_ = percentile;
+}
+
+int AdaptiveThreshold::update(const cv::Mat &frame)
+{
+    std::memset(counts_, 0, sizeof(counts_));
+
+    // Start each sampled row at a different phase so that the grid does not
+    // alias with vertical structure in the scene
+    uint32_t n = 0;
+    for (int r = stride_ / 2, phase = 0; r < frame.rows; r += stride_) {
+
+        const uint8_t *row = frame.ptr<uint8_t>(r);
+        int c = phase;
+        for (; c + 3 * stride_ < frame.cols; c += 4 * stride_) {
+            counts_[0][row[c]]++;
+            counts_[1][row[c + stride_]]++;
+            counts_[2][row[c + 2 * stride_]]++;
+            counts_[3][row[c + 3 * stride_]]++;
+            n += 4;
+        }
+        for (; c < frame.cols; c += stride_) {
+            counts_[0][row[c]]++;
+            n++;
+        }
+
+        phase = (phase + 3) % stride_;
+    }
+
+    if (n == 0)
+        return threshold_;
+
+    // Blend into the decayed histogram. Plain loops over contiguous arrays,
+    // which the compiler vectorizes.
+    const float a = empty_ ? 1.0f : decay_;
+    const float w = a / n;
+    for (int i = 0; i < 256; i++) {
+        const uint32_t k = counts_[0][i] + counts_[1][i]
+                         + counts_[2][i] + counts_[3][i];
+        hist_[i] = (1.0f - a) * hist_[i] + w * k;
+    }
+    empty_ = false;
+
+    threshold_ = method_ == Method::OTSU ? otsu() : percentile();
+    return threshold_;
+}
+
+int AdaptiveThreshold::otsu() const
+{
+    double total_mean = 0;
+    for (int i = 0; i < 256; i++)
+        total_mean += i * hist_[i];
+
+    // Maximize the between-class variance
+    double w0 = 0, sum0 = 0, best = -1;
+    int t = 0;
+    for (int i = 0; i < 255; i++) {
+
+        w0 += hist_[i];
+        sum0 += i * hist_[i];
+
+        const double w1 = 1.0 - w0;
+        if (w0 <= 0 || w1 <= 0)
+            continue;
+
+        const double d = sum0 / w0 - (total_mean - sum0) / w1;
+        const double var = w0 * w1 * d * d;
+        if (var > best) {
+            best = var;
+            t = i + 1;
+        }
+    }
+
+    return t;
+}
+
+int AdaptiveThreshold::percentile() const
+{
+    const double target = percentile_ / 100.0;
+
+    double cum = 0;
+    for (int i = 0; i < 256; i++) {
+        cum += hist_[i];
+        if (cum >= target)
+            return i < 255 ? i + 1 : 255;
+    }
+
+    return 255;
+}
+
+} /* namespace oat */
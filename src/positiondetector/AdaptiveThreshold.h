@@ -0,0 +1,88 @@
+//******************************************************************************
+//* File:   AdaptiveThreshold.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_ADAPTIVETHRESHOLD_H
+#define	OAT_ADAPTIVETHRESHOLD_H
+
+#include <cstdint>
+
+#include <opencv2/core/mat.hpp>
+
+namespace oat {
+
+/**
+ * @brief Intensity threshold that follows slow changes in lighting. An 8-bit
+ * intensity histogram is kept as an exponentially decaying average over
+ * frames. Each frame only contributes the pixels of a sparse grid, so that
+ * with the default stride the histogram costs about 1% of a pass over the
+ * frame. The threshold is derived from the histogram after each update,
+ * either by Otsu's method or as an intensity percentile.
+ */
+class AdaptiveThreshold {
+
+public:
+
+    enum class Method {
+        OTSU = 0,  //!< Threshold that best separates two intensity classes
+        PERCENTILE //!< Intensity below which a given share of pixels fall
+    };
+
+    /**
+     * @param method How the threshold is derived from the histogram
+     * @param stride Spacing, in pixels, of the sampled grid along rows and
+     * columns
+     * @param decay Share, between 0 and 1, of the histogram replaced by each
+     * frame's samples
+     * @param percentile Percentile, between 0 and 100, used by PERCENTILE
+     */
+    void configure(Method method, int stride, double decay, double percentile);
+
+    /**
+     * @brief Add a grey frame to the histogram and derive a new threshold.
+     * @param frame CV_8UC1 frame
+     * @return Threshold, between 0 and 255: the lowest intensity of the
+     * brighter class of pixels.
+     */
+    int update(const cv::Mat &frame);
+
+    int threshold() const { return threshold_; }
+
+private:
+
+    int otsu() const;
+    int percentile() const;
+
+    Method method_ {Method::OTSU};
+    int stride_ {10};
+    float decay_ {0.05f};
+    double percentile_ {99.0};
+
+    // Decayed, normalized histogram and its threshold
+    bool empty_ {true};
+    float hist_[256] {};
+    int threshold_ {0};
+
+    // Counts from the current frame. Consecutive samples go to different
+    // sub-histograms, so that runs of equal intensities do not stall on
+    // the same counter.
+    uint32_t counts_[4][256] {};
+};
+
+}      /* namespace oat */
+#endif /* OAT_ADAPTIVETHRESHOLD_H */
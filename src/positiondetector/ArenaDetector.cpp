@@ -0,0 +1,397 @@
+//******************************************************************************
+//* File:   ArenaDetector.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#include "ArenaDetector.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+
+#include "../../lib/base/Profiler.h"
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
+
+#include "DifferenceDetector.h"
+#include "HSVDetector.h"
+#include "MOGDetector.h"
+#include "SimpleThreshold.h"
+
+namespace oat {
+
+static std::unique_ptr<PositionDetector> makeArena(const std::string &type,
+                                                   const std::string &source,
+                                                   const std::string &sink)
+{
+    if (type == "diff")
+        return oat::make_unique<oat::DifferenceDetector>(source, sink);
+    if (type == "hsv")
+        return oat::make_unique<oat::HSVDetector>(source, sink);
+    if (type == "mog")
+        return oat::make_unique<oat::MOGDetector>(source, sink);
+    if (type == "thresh")
+        return oat::make_unique<oat::SimpleThreshold>(source, sink);
+
+    throw std::runtime_error("Invalid arena TYPE '" + type + "'.");
+}
+
+// Keys of the layers that a detector's component wraps around its kernel,
+// and of its tuning view, none of which an arena runs
+static const std::vector<std::string> component_keys {
+    "all-objects", "budget", "bus", "deadline", "degrade", "flow-features",
+    "flow-min-features", "flow-refresh", "flow-window", "history", "pyramid",
+    "search-misses", "search-window", "shard", "tune", "workers"};
+
+ArenaDetector::ArenaDetector(const std::string &frame_source_address,
+                             const std::string &position_sink_addresses)
+: PositionDetector(frame_source_address, position_sink_addresses)
+, source_address_(frame_source_address)
+{
+    std::istringstream sinks {position_sink_addresses};
+    std::string address;
+    while (std::getline(sinks, address, ',')) {
+
+        if (address.empty())
+            throw std::runtime_error("Empty SINK name in '"
+                                     + position_sink_addresses + "'.");
+
+        sink_addresses_.push_back(address);
+    }
+}
+
+po::options_description ArenaDetector::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("arena", po::value<std::string>(),
+         "TOML array of tables, one per arena. Each table gives the arena's "
+         "'roi', an array of ints, [x,y,width,height], in pixels, and the "
+         "posidet 'type' that searches it, which is diff, hsv, mog or "
+         "thresh, along with that type's configuration keys, e.g. "
+         "[{type=\"thresh\",roi=[0,0,320,240],thresh=[200,256]},"
+         "{type=\"thresh\",roi=[320,0,320,240],thresh=[180,256]}]. Only the "
+         "detection itself is configurable: search windows, flow following, "
+         "workers and the other options that a detector's component adds "
+         "around it are not available in an arena.")
+        ("array",
+         "If true, publish the positions of every arena to the single SINK "
+         "as a PositionArray indexed by arena, instead of each to its own "
+         "SINK.")
+        ;
+
+    return local_opts;
+}
+
+void ArenaDetector::applyConfiguration(const po::variables_map &vm,
+                                       const config::OptionTable &config_table)
+{
+    // Position array
+    oat::config::getValue<bool>(vm, config_table, "array", array_);
+
+    // Arena tables, from the command line or the configuration table
+    auto table = config_table;
+    if (vm.count("arena")) {
+        std::istringstream toml {"arena=" + vm["arena"].as<std::string>()};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    }
+
+    auto tables = table->get_table_array("arena");
+    if (!tables)
+        throw std::runtime_error("An arena detector requires an 'arena' "
+                                 "array of tables.");
+
+    const size_t n = tables->get().size();
+    if (array_) {
+        if (sink_addresses_.size() != 1)
+            throw std::runtime_error("An arena array is published to a "
+                                     "single SINK.");
+        if (n > oat::PositionArray::CAPACITY)
+            throw std::runtime_error(
+                "An arena array holds at most "
+                + std::to_string(oat::PositionArray::CAPACITY) + " arenas.");
+    } else if (n != sink_addresses_.size()) {
+        throw std::runtime_error("Number of arenas (" + std::to_string(n)
+                                 + ") does not match the number of SINKs ("
+                                 + std::to_string(sink_addresses_.size())
+                                 + ").");
+    }
+
+    arenas_.clear();
+    for (const auto &t : *tables) {
+
+        const auto sink = array_ ? sink_addresses_[0]
+                                 : sink_addresses_[arenas_.size()];
+        arenas_.emplace_back(new Arena(sink));
+        auto &a = *arenas_.back();
+
+        auto type = t->get_as<std::string>("type");
+        if (!type)
+            throw std::runtime_error("Each arena requires a 'type' key.");
+
+        std::vector<int> roi;
+        oat::config::getArray<int, 4>(po::variables_map(), t, "roi", roi, true);
+        a.roi = cv::Rect(roi[0], roi[1], roi[2], roi[3]);
+        if (a.roi.x < 0 || a.roi.y < 0 || a.roi.width < 1 || a.roi.height < 1)
+            throw std::runtime_error("Each arena's roi must have a "
+                                     "non-negative origin and a positive "
+                                     "size.");
+
+        a.detector = makeArena(*type, source_address_, sink);
+
+        // Arenas take the detection keys of their own TYPE
+        auto &d = *a.detector;
+        po::options_description opts;
+        d.appendOptions(opts);
+        auto &keys = d.config_keys_;
+        keys.erase(std::remove_if(keys.begin(),
+                                  keys.end(),
+                                  [](const std::string &k) {
+                                      return std::find(component_keys.begin(),
+                                                       component_keys.end(),
+                                                       k)
+                                             != component_keys.end();
+                                  }),
+                   keys.end());
+        keys.push_back("type");
+        keys.push_back("roi");
+        oat::config::checkKeys(keys, t);
+
+        d.applyConfiguration(po::variables_map(), t);
+    }
+}
+
+bool ArenaDetector::connectToNode()
+{
+    // Establish our a slot in the node
+    source_.touch(source_address_);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    const auto in = source_.parameters();
+    if (in.color == PIX_MASK)
+        throw std::runtime_error("Arenas cannot be detected on in MASK "
+                                 "frames.");
+
+    const cv::Rect bounds(0, 0, in.cols, in.rows);
+    for (auto &a : arenas_) {
+
+        auto &d = *a->detector;
+        if (in.color != d.required_color_
+            && std::find(d.accepted_colors_.begin(),
+                         d.accepted_colors_.end(),
+                         in.color) == d.accepted_colors_.end()) {
+            throw std::runtime_error("Arena detector requires frames with "
+                                     "pixels of type "
+                                     + oat::color_str(d.required_color_)
+                                     + ". Maybe use oat-framefilt col?");
+        }
+        d.frame_color_ = in.color;
+
+        if ((a->roi & bounds) != a->roi)
+            throw std::runtime_error("Arena roi lies outside the "
+                                     + std::to_string(in.cols) + "x"
+                                     + std::to_string(in.rows) + " frame.");
+
+        // Detectors that modify their frame get a copy of their arena only
+        if (!d.zero_copy_)
+            a->frame.create(a->roi.height, a->roi.width, in.type);
+    }
+
+    // Bind to sink nodes and create shared positions, or a position array
+    if (array_) {
+        array_sink_.bind(sink_addresses_[0]);
+    } else {
+        for (size_t i = 0; i < arenas_.size(); i++) {
+            arenas_[i]->sink = oat::make_unique<oat::Sink<oat::Position2D>>();
+            arenas_[i]->sink->bind(sink_addresses_[i], sink_addresses_[i]);
+        }
+    }
+
+    return true;
+}
+
+bool ArenaDetector::ready() const
+{
+    if (!source_.readable())
+        return false;
+
+    if (array_)
+        return array_sink_.writable();
+
+    for (const auto &a : arenas_)
+        if (!a->sink->writable())
+            return false;
+
+    return true;
+}
+
+std::vector<SampleEvent *> ArenaDetector::events() const
+{
+    std::vector<SampleEvent *> e {&source_.sample_event()};
+    if (array_) {
+        e.push_back(array_sink_.sample_event());
+    } else {
+        for (const auto &a : arenas_)
+            e.push_back(a->sink->sample_event());
+    }
+
+    return e;
+}
+
+int ArenaDetector::process()
+{
+    // Detectors only set what they find
+    for (auto &a : arenas_)
+        a->position.set_record(oat::PositionRecord());
+
+    const int n = static_cast<int>(arenas_.size());
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    OAT_PHASE(WAIT_SOURCE);
+    if (source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // One read of SOURCE serves every arena. Detectors that leave their
+    // frame untouched detect on it in place; the others copy their arena.
+    OAT_PHASE(COMPUTE);
+    cv::Mat shared = source_.borrow();
+    const auto sample = source_.borrow().sample();
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range &r) {
+        for (int i = r.start; i < r.end; i++) {
+            auto &a = *arenas_[i];
+            a.position.set_sample(sample);
+            try {
+                cv::Mat view = shared(a.roi);
+                if (a.detector->zero_copy_)
+                    detect(a, view);
+                else
+                    view.copyTo(a.frame);
+            } catch (...) {
+                a.error = std::current_exception();
+            }
+        }
+    });
+
+    // Tell sink it can continue
+    OAT_PHASE(PUBLISH);
+    source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    OAT_PHASE(COMPUTE);
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range &r) {
+        for (int i = r.start; i < r.end; i++) {
+            auto &a = *arenas_[i];
+            if (a.detector->zero_copy_ || a.error)
+                continue;
+            try {
+                detect(a, a.frame);
+            } catch (...) {
+                a.error = std::current_exception();
+            }
+        }
+    });
+
+    for (auto &a : arenas_)
+        if (a->error)
+            std::rethrow_exception(a->error);
+
+    if (array_) {
+
+        positions_.clear();
+        positions_.set_sample(sample);
+        for (const auto &a : arenas_) {
+            const auto &p = a->position;
+            positions_.push(p.position.x, p.position.y, p.score);
+            positions_.valid[positions_.size() - 1] = p.position_valid;
+        }
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sources to read
+        OAT_PHASE(WAIT_SINK);
+        array_sink_.wait();
+
+        OAT_PHASE(COPY_OUT);
+        *array_sink_.retrieve() = positions_;
+
+        // Tell sources there is new data
+        OAT_PHASE(PUBLISH);
+        array_sink_.post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+        return 0;
+    }
+
+    for (auto &a : arenas_) {
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sources to read
+        OAT_PHASE(WAIT_SINK);
+        a->sink->wait();
+
+        OAT_PHASE(COPY_OUT);
+        a->sink->write(a->position);
+
+        // Tell sources there is new data
+        OAT_PHASE(PUBLISH);
+        a->sink->post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+    }
+
+    // Sink was not at END state
+    return 0;
+}
+
+void ArenaDetector::detect(Arena &a, cv::Mat &frame)
+{
+    auto &d = *a.detector;
+    d.detectPosition(frame, a.position);
+
+    // Move the position from arena to frame coordinates
+    if (a.position.position_valid) {
+        a.position.position.x += a.roi.x;
+        a.position.position.y += a.roi.y;
+    }
+
+    d.orient(a.position);
+}
+
+} /* namespace oat */
@@ -0,0 +1,108 @@
+//******************************************************************************
+//* File:   ArenaDetector.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#ifndef OAT_ARENADETECTOR_H
+#define	OAT_ARENADETECTOR_H
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/datatypes/PositionArray.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "PositionDetector.h"
+
+namespace oat {
+
+class ArenaDetector : public PositionDetector {
+public:
+    /**
+     * Detector that finds one object in each of several rectangular arenas
+     * of a frame, e.g. one animal per cage of a rack filmed by one camera.
+     * Every arena has its own detector, of any single-object TYPE, which is
+     * configured separately. The frame is read once and the arenas are
+     * detected on in parallel. Each arena's position is published to its
+     * own SINK, or every position to one SINK as a PositionArray indexed by
+     * arena.
+     * @param frame_source_address Frame SOURCE node address
+     * @param position_sink_addresses Comma-separated position SINK node
+     * addresses, one per arena
+     */
+    ArenaDetector(const std::string &frame_source_address,
+                  const std::string &position_sink_addresses);
+
+    bool ready(void) const override;
+    std::vector<SampleEvent *> events(void) const override;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Component Interface. The SOURCE and every SINK are handled here
+    // rather than by PositionDetector, which serves a single object.
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Not used: process() runs each arena's detector
+    void detectPosition(cv::Mat &, oat::Position2D &) override { }
+
+    // An arena, the detector that searches it, and where its position goes.
+    // Only the detector's kernel is run, as in a fused chain.
+    struct Arena {
+        explicit Arena(const std::string &label) : position(label) { }
+        cv::Rect roi;
+        std::unique_ptr<PositionDetector> detector;
+        cv::Mat frame;
+        oat::Position2D position;
+        std::exception_ptr error;
+        std::unique_ptr<oat::Sink<oat::Position2D>> sink;
+    };
+
+    /**
+     * Detect the object in an arena of the shared frame, or of the arena's
+     * own copy of it, and move its position to frame coordinates.
+     * @param a Arena
+     * @param frame The shared frame, cropped to the arena, or the copy
+     */
+    void detect(Arena &a, cv::Mat &frame);
+
+    // Frame source
+    const std::string source_address_;
+    oat::Source<oat::Frame> source_;
+
+    // Arenas, in the order of their tables
+    std::vector<std::string> sink_addresses_;
+    std::vector<std::unique_ptr<Arena>> arenas_;
+
+    // If true, every arena's position is published to the single SINK as
+    // one PositionArray
+    bool array_ {false};
+    oat::PositionArray positions_;
+    oat::Sink<oat::PositionArray> array_sink_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_ARENADETECTOR_H */
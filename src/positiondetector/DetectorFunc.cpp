@@ -17,22 +17,57 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //****************************************************************************
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include <string>
 #include <vector>
+#include <opencv2/core.hpp>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgproc.hpp>
 
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/PositionArray.h"
 
 #include "DetectorFunc.h"
 
 namespace oat {
 
+namespace {
+
+// Set the heading of a position to the major axis of an object given its
+// second order central moments, if it is elongated enough to have one
+inline void setAxis(double mu20, double mu02, double mu11, Position2D &position)
+{
+    const double spread = mu20 + mu02;
+    const double elongation
+        = std::sqrt((mu20 - mu02) * (mu20 - mu02) + 4 * mu11 * mu11);
+
+    position.heading_valid
+        = spread > 0 && elongation >= MIN_AXIS_ELONGATION * spread;
+    if (!position.heading_valid)
+        return;
+
+    const double theta = 0.5 * std::atan2(2 * mu11, mu20 - mu02);
+    position.heading.x = std::cos(theta);
+    position.heading.y = std::sin(theta);
+}
+
+// Sum of x^2 for x in [0, n)
+inline uint64_t sumSquares(uint64_t n)
+{
+    return n == 0 ? 0 : (n - 1) * n * (2 * n - 1) / 6;
+}
+
+} /* namespace */
+
 void siftContours(cv::Mat &frame,
                   Position2D &position,
                   double &area,
                   double min_area,
-                  double max_area)
+                  double max_area,
+                  PositionArray *objects,
+                  bool axis)
 {
 
     std::vector<std::vector <cv::Point> > contours;
@@ -44,12 +79,26 @@ void siftContours(cv::Mat &frame,
 
     double object_area = 0;
     position.position_valid = false;
+    cv::Moments object_moment;
+
+    if (objects != nullptr)
+        objects->clear();
 
     for (auto &c : contours) {
 
         cv::Moments moment = cv::moments(static_cast<cv::Mat>(c));
         double countour_area = moment.m00;
 
+        // Keep every object within the min/max range if requested
+        if (objects != nullptr &&
+            countour_area >= min_area &&
+            countour_area < max_area) {
+
+            objects->push(moment.m10 / countour_area,
+                          moment.m01 / countour_area,
+                          countour_area);
+        }
+
         // Isolate the largest contour within the min/max range.
         if (countour_area >= min_area &&
             countour_area < max_area &&
@@ -59,10 +108,320 @@ void siftContours(cv::Mat &frame,
             position.position.y = moment.m01 / countour_area;
             position.position_valid = true;
             object_area = countour_area;
+            object_moment = moment;
         }
     }
 
+    if (axis && position.position_valid)
+        setAxis(object_moment.mu20,
+                object_moment.mu02,
+                object_moment.mu11,
+                position);
+
     area = object_area;
 }
 
+namespace {
+
+// Find the next run of set pixels, [begin, end), at or after x in a row of
+// w pixels. Returns false if there is none.
+inline bool nextRun(const uint8_t *row, const int w, int &x, int &begin, int &end)
+{
+    while (x < w && row[x] == 0)
+        x++;
+    if (x == w)
+        return false;
+
+    begin = x;
+    while (x < w && row[x] != 0)
+        x++;
+    end = x;
+
+    return true;
+}
+
+// As nextRun(), for a packed row. Whole bytes are skipped at a time.
+inline bool nextPackedRun(const uint8_t *row, const int w, int &x, int &begin, int &end)
+{
+    while (x < w) {
+        const unsigned set = row[x >> 3] >> (x & 7);
+        if (set != 0) {
+            x += __builtin_ctz(set);
+            break;
+        }
+        x = (x | 7) + 1;
+    }
+    if (x >= w)
+        return false;
+
+    begin = x;
+    while (x < w) {
+        const unsigned clear = (~row[x >> 3] & 0xFFu) >> (x & 7);
+        if (clear != 0) {
+            x += __builtin_ctz(clear);
+            break;
+        }
+        x = (x | 7) + 1;
+    }
+    end = std::min(x, w);
+    x = end;
+
+    return true;
+}
+
+} /* namespace */
+
+void ComponentSifter::sift(const cv::Mat &frame,
+                           Position2D &position,
+                           double &area,
+                           double min_area,
+                           double max_area,
+                           PositionArray *objects,
+                           bool axis)
+{
+    siftRuns<false>(frame, position, area, min_area, max_area, objects, axis);
+}
+
+void ComponentSifter::siftPacked(const cv::Mat &mask,
+                                 Position2D &position,
+                                 double &area,
+                                 double min_area,
+                                 double max_area,
+                                 PositionArray *objects,
+                                 bool axis)
+{
+    siftRuns<true>(mask, position, area, min_area, max_area, objects, axis);
+}
+
+template <bool PACKED>
+void ComponentSifter::siftRuns(const cv::Mat &frame,
+                               Position2D &position,
+                               double &area,
+                               double min_area,
+                               double max_area,
+                               PositionArray *objects,
+                               bool axis)
+{
+    if (frame.type() != CV_8UC1)
+        throw std::runtime_error("Connected components require a binary, "
+                                 "8 bit frame.");
+
+    const int n_bands = std::max(
+        1, std::min(cv::getNumThreads(), frame.rows / MIN_BAND_ROWS));
+    const int band_rows = (frame.rows + n_bands - 1) / n_bands;
+    bands_.resize(n_bands);
+
+    cv::parallel_for_(cv::Range(0, n_bands), [&](const cv::Range &r) {
+        for (int b = r.start; b < r.end; b++) {
+            const int y0 = b * band_rows;
+            labelBand<PACKED>(
+                frame, y0, std::min(y0 + band_rows, frame.rows), bands_[b]);
+        }
+    });
+
+    // Gather every band's labels into one forest
+    parent_.clear();
+    m00_.clear();
+    m10_.clear();
+    m01_.clear();
+    m20_.clear();
+    m02_.clear();
+    m11_.clear();
+
+    std::vector<uint32_t> offset(n_bands);
+    for (int b = 0; b < n_bands; b++) {
+
+        const auto &band = bands_[b];
+        offset[b] = static_cast<uint32_t>(parent_.size());
+
+        for (auto l : band.parent)
+            parent_.push_back(l + offset[b]);
+        m00_.insert(m00_.end(), band.m00.begin(), band.m00.end());
+        m10_.insert(m10_.end(), band.m10.begin(), band.m10.end());
+        m01_.insert(m01_.end(), band.m01.begin(), band.m01.end());
+        m20_.insert(m20_.end(), band.m20.begin(), band.m20.end());
+        m02_.insert(m02_.end(), band.m02.begin(), band.m02.end());
+        m11_.insert(m11_.end(), band.m11.begin(), band.m11.end());
+    }
+
+    // Join components that touch across band edges
+    for (int b = 1; b < n_bands; b++) {
+
+        const auto &above = bands_[b - 1].prev_runs;
+        const auto &below = bands_[b].first_runs;
+
+        size_t p = 0;
+        for (const auto &run : below) {
+
+            while (p < above.size() && above[p].end < run.begin)
+                p++;
+
+            for (size_t q = p; q < above.size() && above[q].begin <= run.end; q++)
+                merge(parent_,
+                      above[q].label + offset[b - 1],
+                      run.label + offset[b]);
+        }
+    }
+
+    // Roll each label's moments into its root. Roots have the lowest label
+    // of their component, so they are visited first.
+    for (uint32_t l = 0; l < parent_.size(); l++) {
+        auto r = root(parent_, l);
+        if (r != l) {
+            m00_[r] += m00_[l];
+            m10_[r] += m10_[l];
+            m01_[r] += m01_[l];
+            m20_[r] += m20_[l];
+            m02_[r] += m02_[l];
+            m11_[r] += m11_[l];
+        }
+    }
+
+    double object_area = 0;
+    position.position_valid = false;
+    uint32_t object_label = 0;
+
+    if (objects != nullptr)
+        objects->clear();
+
+    for (uint32_t l = 0; l < parent_.size(); l++) {
+
+        if (parent_[l] != l)
+            continue;
+
+        const double component_area = static_cast<double>(m00_[l]);
+        if (component_area < min_area || component_area >= max_area)
+            continue;
+
+        const double cx = m10_[l] / component_area;
+        const double cy = m01_[l] / component_area;
+
+        if (objects != nullptr)
+            objects->push(cx, cy, component_area);
+
+        if (component_area > object_area) {
+            position.position.x = cx;
+            position.position.y = cy;
+            position.position_valid = true;
+            object_area = component_area;
+            object_label = l;
+        }
+    }
+
+    // Central moments from the raw ones
+    if (axis && position.position_valid) {
+        const auto l = object_label;
+        const double cx = position.position.x;
+        const double cy = position.position.y;
+        setAxis(m20_[l] - cx * m10_[l],
+                m02_[l] - cy * m01_[l],
+                m11_[l] - cx * m01_[l],
+                position);
+    }
+
+    area = object_area;
+}
+
+template <bool PACKED>
+void ComponentSifter::labelBand(const cv::Mat &frame,
+                                int y0,
+                                int y1,
+                                Band &band)
+{
+    const int w = PACKED ? 8 * frame.cols : frame.cols;
+
+    band.parent.clear();
+    band.m00.clear();
+    band.m10.clear();
+    band.m01.clear();
+    band.m20.clear();
+    band.m02.clear();
+    band.m11.clear();
+    band.prev_runs.clear();
+
+    auto &parent = band.parent;
+
+    for (int y = y0; y < y1; y++) {
+
+        const uint8_t *row = frame.ptr<uint8_t>(y);
+        const auto &prev_runs = band.prev_runs;
+        auto &curr_runs = band.curr_runs;
+        curr_runs.clear();
+
+        // Runs of the previous row that may touch the current run. Both rows'
+        // runs are sorted, so this only moves forward.
+        size_t p = 0;
+
+        int x = 0, begin, end;
+        while (PACKED ? nextPackedRun(row, w, x, begin, end)
+                      : nextRun(row, w, x, begin, end)) {
+
+            // Skip runs that end left of this one's 8-neighborhood
+            while (p < prev_runs.size() && prev_runs[p].end < begin)
+                p++;
+
+            uint32_t label = static_cast<uint32_t>(parent.size());
+            for (size_t q = p;
+                 q < prev_runs.size() && prev_runs[q].begin <= end;
+                 q++) {
+
+                if (label == parent.size())
+                    label = root(parent, prev_runs[q].label);
+                else
+                    merge(parent, label, prev_runs[q].label);
+            }
+
+            if (label == parent.size()) {
+                parent.push_back(label);
+                band.m00.push_back(0);
+                band.m10.push_back(0);
+                band.m01.push_back(0);
+                band.m20.push_back(0);
+                band.m02.push_back(0);
+                band.m11.push_back(0);
+            }
+
+            const uint64_t n = end - begin;
+            const uint64_t sum_x = n * (begin + end - 1) / 2;
+            band.m00[label] += n;
+            band.m10[label] += sum_x;
+            band.m01[label] += n * y;
+            band.m20[label] += sumSquares(end) - sumSquares(begin);
+            band.m02[label] += n * y * y;
+            band.m11[label] += sum_x * y;
+
+            curr_runs.push_back({begin, end, label});
+        }
+
+        if (y == y0)
+            band.first_runs = curr_runs;
+
+        std::swap(band.prev_runs, band.curr_runs);
+    }
+}
+
+uint32_t ComponentSifter::root(std::vector<uint32_t> &parent, uint32_t label)
+{
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+
+    return label;
+}
+
+void ComponentSifter::merge(std::vector<uint32_t> &parent,
+                            uint32_t a,
+                            uint32_t b)
+{
+    a = root(parent, a);
+    b = root(parent, b);
+
+    // Lower label becomes the root
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
 } /* namespace oat */
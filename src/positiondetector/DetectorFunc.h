@@ -20,6 +20,9 @@
 #ifndef OAT_DETECTORFUNC
 #define	OAT_DETECTORFUNC
 
+#include <cstdint>
+#include <vector>
+
 // Forward decl.
 namespace cv { class Mat; }
 
@@ -28,8 +31,14 @@ namespace oat {
 // Constants
 static constexpr double PI {3.14159265358979323846};
 
+// Smallest difference between the variances of an object along its major and
+// minor axes, as a fraction of their sum, at which the major axis is taken as
+// the object's heading. Rounder objects have no heading.
+static constexpr double MIN_AXIS_ELONGATION {0.1};
+
 // Forward decl.
 class Position2D;
+class PositionArray;
 
 /**
  * Given a binary frame, find all contours and return a position corresponding
@@ -38,13 +47,113 @@ class Position2D;
  * @param position Position output
  * @param min_area Minimum contour area to be considered candidate for position
  * @param max_area Maximum contour area to be considered candidate for position
+ * @param objects If not null, cleared and filled with the centroid and area
+ * of every contour within the min/max range, in the order they are found, up
+ * to PositionArray::CAPACITY.
+ * @param axis If true, the heading of the position is set to the major axis
+ * of the largest contour, from its second order central moments. The axis
+ * points to either end of the object.
  * @return Position corresponding the centroid of the largest contour in the frame.
  */
 void siftContours(cv::Mat &frame,
                   Position2D &position,
                   double &object_area,
                   double min_area,
-                  double max_area);
+                  double max_area,
+                  PositionArray *objects = nullptr,
+                  bool axis = false);
+
+/**
+ * Alternative to siftContours() that labels 8-connected components of a binary
+ * frame in a single pass over its rows, accumulating the zeroth and first and
+ * second moments of each component as it goes. No contours are formed and the
+ * frame is not modified. An object's area is its pixel count, so unlike a
+ * contour area it excludes the object's boundary half-pixels and any holes
+ * inside it. Large frames are split into horizontal bands that are labeled in
+ * parallel, and components that cross band edges are then joined. Scratch space
+ * is kept between frames.
+ */
+class ComponentSifter {
+
+public:
+
+    // Fewest rows worth labeling on a thread of their own
+    static constexpr int MIN_BAND_ROWS {64};
+
+    /**
+     * Given a binary frame, find all connected components and return a
+     * position corresponding to the centroid of the largest one.
+     * @param frame Frame to look for positions in.
+     * @param position Position output
+     * @param area Area of the chosen component, or 0 if none
+     * @param min_area Minimum component area to be considered candidate for
+     * position
+     * @param max_area Maximum component area to be considered candidate for
+     * position
+     * @param objects If not null, cleared and filled with the centroid and
+     * area of every component within the min/max range, in order of their
+     * topmost pixel, up to PositionArray::CAPACITY.
+     * @param axis If true, the heading of the position is set to the major
+     * axis of the chosen component, as for siftContours().
+     */
+    void sift(const cv::Mat &frame,
+              Position2D &position,
+              double &area,
+              double min_area,
+              double max_area,
+              PositionArray *objects = nullptr,
+              bool axis = false);
+
+    /**
+     * As sift(), for a mask packed eight pixels to a byte, e.g. a PIX_MASK
+     * frame. Runs are found a byte at a time, so empty stretches of each row
+     * cost an eighth of what they do unpacked.
+     */
+    void siftPacked(const cv::Mat &mask,
+                    Position2D &position,
+                    double &area,
+                    double min_area,
+                    double max_area,
+                    PositionArray *objects = nullptr,
+                    bool axis = false);
+
+private:
+
+    // Horizontal run of foreground pixels, [begin, end)
+    struct Run {
+        int begin, end;
+        uint32_t label;
+    };
+
+    // Labels of one band of rows, and the runs of its first and last rows
+    // to stitch it to its neighbors
+    struct Band {
+        std::vector<Run> first_runs, prev_runs, curr_runs;
+        std::vector<uint32_t> parent;
+        std::vector<uint64_t> m00, m10, m01, m20, m02, m11;
+    };
+
+    std::vector<Band> bands_;
+
+    // Union-find forest over the labels of every band and the moments of
+    // each label
+    std::vector<uint32_t> parent_;
+    std::vector<uint64_t> m00_, m10_, m01_, m20_, m02_, m11_;
+
+    template <bool PACKED>
+    void siftRuns(const cv::Mat &frame,
+                  Position2D &position,
+                  double &area,
+                  double min_area,
+                  double max_area,
+                  PositionArray *objects,
+                  bool axis);
+
+    template <bool PACKED>
+    static void labelBand(const cv::Mat &frame, int y0, int y1, Band &band);
+    static uint32_t root(std::vector<uint32_t> &parent, uint32_t label);
+    static void merge(std::vector<uint32_t> &parent, uint32_t a, uint32_t b);
+};
 
 }       /* namespace oat */
 #endif	/* OAT_DETECTORFUNC */
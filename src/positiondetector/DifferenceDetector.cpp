@@ -20,6 +20,9 @@
 #include "DifferenceDetector.h"
 #include "DetectorFunc.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <opencv2/cvconfig.h>
 #include <opencv2/opencv.hpp>
@@ -28,9 +31,53 @@
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
+// Fused cv::absdiff and cv::threshold(THRESH_BINARY, 255) over 8 or 16 bit
+// frames. Saves a full pass over the difference image.
+template <typename T>
+static void thresholdDifference(const cv::Mat &a,
+                                const cv::Mat &b,
+                                cv::Mat &out,
+                                const int thresh)
+{
+    out.create(a.size(), CV_8UC(a.channels()));
+
+    const int n = a.cols * a.channels();
+    for (int y = 0; y < a.rows; y++) {
+
+        const T *pa = a.ptr<T>(y);
+        const T *pb = b.ptr<T>(y);
+        uint8_t *po = out.ptr<uint8_t>(y);
+
+        // Branch-free so that it vectorizes
+        for (int x = 0; x < n; x++) {
+            const int d = std::max(pa[x], pb[x]) - std::min(pa[x], pb[x]);
+            po[x] = static_cast<uint8_t>(-(d > thresh));
+        }
+    }
+}
+
+static void thresholdDifference(const cv::Mat &a,
+                                const cv::Mat &b,
+                                cv::Mat &out,
+                                const int thresh)
+{
+    if (a.size() != b.size() || a.type() != b.type())
+        throw std::runtime_error("Difference detector requires frames of "
+                                 "equal size and type.");
+
+    if (a.depth() == CV_8U)
+        thresholdDifference<uint8_t>(a, b, out, thresh);
+    else if (a.depth() == CV_16U)
+        thresholdDifference<uint16_t>(a, b, out, thresh);
+    else
+        throw std::runtime_error("Difference detector requires frames of "
+                                 "8 or 16 bit depth.");
+}
+
 DifferenceDetector::DifferenceDetector(const std::string &frame_source_address,
                                        const std::string &position_sink_address) :
   PositionDetector(frame_source_address, position_sink_address)
@@ -40,8 +87,17 @@ DifferenceDetector::DifferenceDetector(const std::string &frame_source_address,
     // must be set to false
     set_blur_size(2);
 
-    // Set required frame type
+    // Set required frame type. Motion only needs intensity, so the plane of
+    // a Bayer frame is differenced as it is, each pixel against itself.
     required_color_ = PIX_GREY;
+    accepted_colors_ = {PIX_BAYER_RG,
+                        PIX_BAYER_GR,
+                        PIX_BAYER_GB,
+                        PIX_BAYER_BG,
+                        PIX_GREY16};
+
+    // Frames are only read, or cloned before they are modified
+    zero_copy_ = true;
 }
 
 po::options_description DifferenceDetector::options() const
@@ -55,6 +111,44 @@ po::options_description DifferenceDetector::options() const
         ("area,a", po::value<std::string>(),
          "Array of floats, [min,max], specifying the minimum and maximum "
          "object contour area in pixels^2.")
+        ("all-objects",
+         "If true, publish every object within the area bounds to SINK as a "
+         "position array, rather than only the largest as a position.")
+        ("label",
+         "If true, find objects by labeling connected pixels in a single pass "
+         "rather than by tracing their contours. Object area is then a pixel "
+         "count that excludes any holes.")
+        ("axis",
+         "If true, set the heading of each position to the major axis of the "
+         "detected object, from its second order moments, pointed along the "
+         "object's motion or, while it is still, to the side of the previous "
+         "heading. Objects too round to have an axis have no heading.")
+        ("deadline", po::value<double>(),
+         "Largest lag, in ms, of the frame being processed behind the newest "
+         "frame in SOURCE's ring buffers. Staler frames are skipped, so "
+         "positions stay fresh when detection falls behind. Skipped frames "
+         "show as gaps in position sample numbers. Defaults to 0, which "
+         "processes every frame.")
+        ("shard", po::value<std::string>(),
+         "Share detection with other posidet processes as I/N, e.g. 0/2 and "
+         "1/2. This process detects only frames whose sample number modulo N "
+         "is I, and SINK becomes a merge node that the other shards publish "
+         "to as well. Sources read the positions of all shards in sample "
+         "order.")
+        ("history", po::value<size_t>(),
+         "Keep the last N positions published to SINK in a history ring that "
+         "components reading SINK can scan by sample number, e.g. to draw "
+         "trails, instead of each keeping its own. At 30 Hz, 300 keeps the "
+         "last 10 s. Defaults to 0, which keeps no history.")
+        ("bus", po::value<std::string>(),
+         "Also publish positions to this position bus, on a channel named "
+         "after SINK, so that programs following many positions can read "
+         "them all with a single wait rather than a source per SINK.")
+        ("pyramid", po::value<int>(),
+         "Number of times to halve the frame, using cv::pyrDown, before "
+         "looking for the object. The coarse detection is then refined in a "
+         "small window of the full resolution frame. Defaults to 0, which "
+         "detects at full resolution.")
         ("tune,t",
          "If true, provide a GUI with sliders for tuning detection "
          "parameters.")
@@ -65,6 +159,53 @@ po::options_description DifferenceDetector::options() const
 
 void DifferenceDetector::applyConfiguration(
     const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Parameters that can also be set at runtime
+    configureDetection(vm, config_table);
+
+    // Multiple objects
+    oat::config::getValue<bool>(vm, config_table, "all-objects", all_objects_);
+
+    // Connected component labeling
+    oat::config::getValue<bool>(vm, config_table, "label", label_components_);
+
+    // Heading from the object's major axis
+    oat::config::getValue<bool>(vm, config_table, "axis", axis_heading_);
+
+    // Skip stale frames
+    configureDeadline(vm, config_table);
+
+    // Detect a share of the frames
+    configureShard(vm, config_table);
+    configureHistory(vm, config_table);
+    configureBus(vm, config_table);
+
+    // Coarse to fine detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "pyramid", pyramid_levels_, 0, 8);
+
+    // Tuning GUI, whose sliders start from the configuration above
+    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
+    if (tuning_on_)
+        tuner_ = oat::make_unique<oat::TuningDisplay>(
+            tuning_image_title_,
+            [this] { createTuningWindows(); },
+            helper_thread_policy_);
+}
+
+oat::CommandDescription DifferenceDetector::parameters()
+{
+    const oat::CommandDescription params{
+        {"diff-threshold", "Intensity difference threshold."},
+        {"blur", "Blur kernel size in pixels."},
+        {"area", "Object area range, [min,max], in pixels^2."}
+    };
+
+    return params;
+}
+
+void DifferenceDetector::configureDetection(const po::variables_map &vm,
+                                            const config::OptionTable &config_table)
 {
     // Difference threshold
     oat::config::getNumericValue<int>(
@@ -90,86 +231,117 @@ void DifferenceDetector::applyConfiguration(
         if (min_object_area_ >= max_object_area_)
            throw std::runtime_error("Max area should be larger than min area.");
     }
-
-    // Tuning GUI
-    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
 }
 
 void DifferenceDetector::detectPosition(cv::Mat &frame,
                                         oat::Position2D &position)
 {
-    if (tuning_on_)
-        tune_frame_ = frame.clone();
+    // The tuning view shows the full resolution difference
+    if (pyramid_levels_ > 0 && !tuning_on_) {
+        detectCoarseToFine(frame, position);
+        return;
+    }
+
+    // Only build a tuning view if the display can take it
+    const bool tune = tuner_ && tuner_->ready();
 
     applyThreshold(frame);
 
     // Threshold frame will be destroyed by the transform below, so we need to use
     // it to form the frame that will be shown in the tuning window here
-    if (tuning_on_)
-         tune_frame_.setTo(0, threshold_frame_ == 0);
+    if (tune)
+        tuner_->capture(frame, threshold_frame_);
 
-    siftContours(threshold_frame_,
-                 position,
-                 object_area_,
-                 min_object_area_,
-                 max_object_area_);
+    siftObjects(threshold_frame_,
+                position,
+                object_area_,
+                min_object_area_,
+                max_object_area_);
 
-    if (tuning_on_)
-        tune(tune_frame_, position);
+    if (tune)
+        tuner_->show(position, object_area_, cv::Scalar(255));
 }
 
-void DifferenceDetector::tune(cv::Mat &frame, const oat::Position2D &position) {
-
-    if (!tuning_windows_created_)
-        createTuningWindows();
+void DifferenceDetector::detectCoarseToFine(cv::Mat &frame,
+                                            oat::Position2D &position)
+{
+    const double scale = 1 << pyramid_levels_;
+    const auto &coarse = downsample(frame);
 
-    std::string msg = cv::format("Object not found");
+    // Nothing to compare the first frame to
+    if (!last_image_set_) {
+        coarse.copyTo(last_coarse_);
+        frame.copyTo(last_image_);
+        last_image_set_ = true;
+        position.position_valid = false;
+        object_area_ = 0;
+        if (objects_ != nullptr)
+            objects_->clear();
+        return;
+    }
 
-    // Plot a circle representing found object
+    // Find the object on the downsampled frames
+    applyDifference(coarse, last_coarse_, pyramid_levels_);
+    siftObjects(threshold_frame_,
+                position,
+                object_area_,
+                min_object_area_ / (scale * scale),
+                max_object_area_ / (scale * scale));
+    upsample(position, object_area_);
+
+    // Refine its centroid at full resolution. The coarse estimate stands if
+    // refinement fails.
     if (position.position_valid) {
 
-        // TODO: object_area_ is not set, so this will be 0!
-        auto radius = std::sqrt(object_area_ / PI);
-        cv::Point center;
-        center.x = position.position.x;
-        center.y = position.position.y;
-        cv::circle(frame, center, radius, cv::Scalar(255), 4);
-        msg = cv::format("(%d, %d) pixels",
-                (int) position.position.x,
-                (int) position.position.y);
+        auto window = refinementWindow(position, object_area_, frame.size());
+        applyDifference(frame(window), last_image_(window), 0);
+
+        oat::Position2D fine("");
+        double fine_area {0.0};
+        siftObjects(threshold_frame_,
+                    fine,
+                    fine_area,
+                    min_object_area_,
+                    max_object_area_,
+                    false);
+
+        if (fine.position_valid) {
+            position.position.x = fine.position.x + window.x;
+            position.position.y = fine.position.y + window.y;
+            object_area_ = fine_area;
+        }
     }
 
-    int baseline = 0;
-    cv::Size textSize = cv::getTextSize(msg, 1, 1, 1, &baseline);
-    cv::Point text_origin(
-            frame.cols - textSize.width - 10,
-            frame.rows - 2 * baseline - 10);
+    coarse.copyTo(last_coarse_);
+    frame.copyTo(last_image_);
+}
 
-    cv::putText(frame, msg, text_origin, 1, 1, cv::Scalar(0, 255, 0));
+void DifferenceDetector::applyDifference(const cv::Mat &frame,
+                                         const cv::Mat &last,
+                                         const int level)
+{
+    thresholdDifference(
+        frame, last, threshold_frame_, difference_intensity_threshold_);
 
-    cv::imshow(tuning_image_title_, frame);
-    cv::waitKey(1);
+    if (blur_on_) {
+
+        // Kernel shrinks with the frame
+        auto px = std::max(1, (blur_size_.width + (1 << level) / 2) >> level);
+        cv::blur(threshold_frame_, threshold_frame_, cv::Size(px, px));
+    }
 }
 
 void DifferenceDetector::applyThreshold(cv::Mat &frame) {
 
+    // Copies reuse the buffers from the previous sample
     if (last_image_set_) {
-        cv::absdiff(frame, last_image_, threshold_frame_);
-        cv::threshold(threshold_frame_,
-                      threshold_frame_,
-                      difference_intensity_threshold_,
-                      255,
-                      cv::THRESH_BINARY);
-        if (blur_on_)
-            cv::blur(threshold_frame_, threshold_frame_, blur_size_);
-
-
-        last_image_ = frame.clone(); // Get a copy of the last image
+        applyDifference(frame, last_image_, 0);
     } else {
-        threshold_frame_ = frame.clone();
-        last_image_ = frame.clone();
+        frame.copyTo(threshold_frame_);
         last_image_set_ = true;
     }
+
+    frame.copyTo(last_image_);
 }
 
 void DifferenceDetector::createTuningWindows()
@@ -206,7 +378,6 @@ void DifferenceDetector::createTuningWindows()
                        OAT_POSIDET_MAX_OBJ_AREA_PIX,
                        &diffDetectorMaxAreaSliderChangedCallback,
                        this);
-    tuning_windows_created_ = true;
 }
 
 void DifferenceDetector::set_blur_size(int value)
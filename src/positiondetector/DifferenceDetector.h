@@ -23,6 +23,9 @@
 #include "PositionDetector.h"
 
 #include <limits>
+#include <memory>
+
+#include "../../lib/utility/TuningDisplay.h"
 
 namespace oat {
 
@@ -55,10 +58,15 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    // Runtime parameters
+    oat::CommandDescription parameters(void) override;
+    void configureDetection(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
     void detectPosition(cv::Mat &frame, oat::Position2D &position) override;
 
     // Intermediate variables
-    cv::Mat this_image_, last_image_;
+    cv::Mat this_image_, last_image_, last_coarse_;
     cv::Mat threshold_frame_;
     bool last_image_set_ {false};
 
@@ -77,15 +85,17 @@ private:
 
     // Tuning stuff
     const std::string tuning_image_title_;
-    cv::Mat tune_frame_;
+    std::unique_ptr<oat::TuningDisplay> tuner_;
     int dummy0_ {0}, dummy1_ {10000};
 
     // Processing functions
     bool tuning_on_ {false};
-    bool tuning_windows_created_ {false};
     void createTuningWindows(void);
-    void tune(cv::Mat &frame, const oat::Position2D &position);
     void applyThreshold(cv::Mat &frame);
+    void applyDifference(const cv::Mat &frame,
+                         const cv::Mat &last,
+                         const int level);
+    void detectCoarseToFine(cv::Mat &frame, oat::Position2D &position);
 };
 
 }       /* namespace oat */
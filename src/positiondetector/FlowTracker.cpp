@@ -0,0 +1,189 @@
+//******************************************************************************
+//* File:   FlowTracker.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#include "FlowTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "DetectorFunc.h"
+
+namespace oat {
+
+// Lucas-Kanade search window side length and pyramid levels
+static const cv::Size LK_WINDOW {15, 15};
+static constexpr int LK_LEVELS {2};
+
+// Largest distance, in pixels, between a feature and where it lands when
+// followed forward and then back again
+static constexpr float MAX_FB_ERROR_PX {1.0f};
+
+FlowTracker::FlowTracker(int window_px, int max_features, int min_features)
+: window_px_(window_px)
+, max_features_(max_features)
+, min_features_(min_features)
+{
+    // Nothing
+}
+
+void FlowTracker::grey(const cv::Mat &frame, oat::PixelColor color, cv::Mat &out)
+{
+    switch (color) {
+        case PIX_BGR:
+            cv::cvtColor(frame, out, cv::COLOR_BGR2GRAY);
+            break;
+        case PIX_HSV:
+            cv::extractChannel(frame, out, 2);
+            break;
+        case PIX_BAYER_RG:
+        case PIX_BAYER_GR:
+        case PIX_BAYER_GB:
+        case PIX_BAYER_BG:
+            cv::cvtColor(frame, out, oat::color_conv_code(color, PIX_GREY));
+            break;
+        case PIX_GREY16:
+            // Features are found on the top 8 of the sensor's 12 bits
+            frame.convertTo(out, CV_8U, 1.0 / 16);
+            break;
+        default:
+            frame.copyTo(out);
+            break;
+    }
+}
+
+cv::Rect FlowTracker::windowAround(const cv::Point2d &p) const
+{
+    // Windows at the frame's edges are shifted inside it rather than
+    // clipped, so that the window keeps its size as the object moves
+    const int half = window_px_ / 2;
+    cv::Rect w(static_cast<int>(p.x) - half,
+               static_cast<int>(p.y) - half,
+               window_px_,
+               window_px_);
+    w.x = std::max(0, std::min(w.x, frame_size_.width - w.width));
+    w.y = std::max(0, std::min(w.y, frame_size_.height - w.height));
+
+    // Windows start on even pixels, so that views of Bayer frames keep the
+    // color order of their tiles
+    w.x &= ~1;
+    w.y &= ~1;
+
+    return w & cv::Rect(cv::Point(0, 0), frame_size_);
+}
+
+void FlowTracker::prepare(const cv::Mat &frame, oat::PixelColor color)
+{
+    locked_ = false;
+    frame_size_ = frame.size();
+    grey(frame, color, prepared_);
+}
+
+bool FlowTracker::acquire(const cv::Point2d &position, double area)
+{
+    locked_ = false;
+    if (prepared_.empty())
+        return false;
+
+    window_ = windowAround(position);
+    prepared_(window_).copyTo(prev_);
+
+    // Features are only looked for on the object
+    const cv::Point2d tl(window_.x, window_.y);
+    const double radius = std::max(4.0, 1.5 * std::sqrt(area / PI));
+    cv::Mat mask = cv::Mat::zeros(prev_.size(), CV_8U);
+    cv::circle(mask, position - tl, static_cast<int>(radius), 255, -1);
+
+    cv::goodFeaturesToTrack(prev_, features_, max_features_, 0.01, 3, mask);
+    if (static_cast<int>(features_.size()) < min_features_)
+        return false;
+
+    for (auto &f : features_)
+        f += cv::Point2f(tl);
+
+    position_ = position;
+    locked_ = true;
+
+    return true;
+}
+
+bool FlowTracker::follow(const cv::Mat &frame,
+                         oat::PixelColor color,
+                         cv::Point2d &position)
+{
+    if (!locked_)
+        return false;
+
+    grey(frame(window_), color, next_);
+
+    const cv::Point2f tl(window_.x, window_.y);
+    prev_pts_.clear();
+    for (const auto &f : features_)
+        prev_pts_.push_back(f - tl);
+
+    // Forward, then back again to check each feature
+    cv::calcOpticalFlowPyrLK(prev_, next_, prev_pts_, next_pts_,
+                             status_, error_, LK_WINDOW, LK_LEVELS);
+    cv::calcOpticalFlowPyrLK(next_, prev_, next_pts_, back_pts_,
+                             back_status_, error_, LK_WINDOW, LK_LEVELS);
+
+    const cv::Rect_<float> bounds(0, 0, next_.cols, next_.rows);
+    features_.clear();
+    dx_.clear();
+    dy_.clear();
+    for (size_t i = 0; i < prev_pts_.size(); i++) {
+
+        const auto fb = back_pts_[i] - prev_pts_[i];
+        if (!status_[i] || !back_status_[i]
+            || fb.dot(fb) > MAX_FB_ERROR_PX * MAX_FB_ERROR_PX
+            || !bounds.contains(next_pts_[i]))
+            continue;
+
+        dx_.push_back(next_pts_[i].x - prev_pts_[i].x);
+        dy_.push_back(next_pts_[i].y - prev_pts_[i].y);
+        features_.push_back(next_pts_[i] + tl);
+    }
+
+    if (static_cast<int>(features_.size()) < min_features_) {
+        locked_ = false;
+        return false;
+    }
+
+    // Median displacement, which ignores features that slid off the object
+    const auto mid = dx_.size() / 2;
+    std::nth_element(dx_.begin(), dx_.begin() + mid, dx_.end());
+    std::nth_element(dy_.begin(), dy_.begin() + mid, dy_.end());
+    position_ += cv::Point2d(dx_[mid], dy_[mid]);
+    position = position_;
+
+    // Re-centre the window on the object for the next frame
+    const auto w = windowAround(position_);
+    if (w == window_) {
+        std::swap(prev_, next_);
+    } else {
+        window_ = w;
+        grey(frame(window_), color, prev_);
+    }
+
+    return true;
+}
+
+} /* namespace oat */
@@ -0,0 +1,115 @@
+//******************************************************************************
+//* File:   FlowTracker.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#ifndef OAT_FLOWTRACKER_H
+#define	OAT_FLOWTRACKER_H
+
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/datatypes/Color.h"
+
+namespace oat {
+
+/**
+ * Follows an object found by a full detection from frame to frame with
+ * pyramidal Lucas-Kanade optical flow on a small set of corner features on
+ * the object. Only a window around the object is ever converted and
+ * searched, so the cost of following does not depend on frame size. The
+ * object is lost, and must be detected again, when too few features survive
+ * a forward-backward consistency check.
+ */
+class FlowTracker {
+
+public:
+
+    /**
+     * @param window_px Side length of the square window around the object
+     * in which features are found and followed
+     * @param max_features Largest number of features to follow
+     * @param min_features Fewest surviving features with which the object is
+     * still followed
+     */
+    FlowTracker(int window_px, int max_features, int min_features);
+
+    /**
+     * Keep a grey copy of a frame in which the object is about to be
+     * detected, so that features can be found on it by acquire() even if
+     * detection modifies the frame.
+     * @param frame Full frame
+     * @param color Pixel type of the frame
+     */
+    void prepare(const cv::Mat &frame, oat::PixelColor color);
+
+    /**
+     * Find features on an object detected in the last prepared frame.
+     * @param position Object position, in frame coordinates
+     * @param area Object area, in pixels^2, bounding where features are
+     * looked for
+     * @return True if enough features were found to follow the object.
+     */
+    bool acquire(const cv::Point2d &position, double area);
+
+    /**
+     * Follow the object into the next frame.
+     * @param frame Full frame, of the same size and type as the last
+     * @param color Pixel type of the frame
+     * @param position Object position output, in frame coordinates
+     * @return True if the object was followed. False if it was lost.
+     */
+    bool follow(const cv::Mat &frame,
+                oat::PixelColor color,
+                cv::Point2d &position);
+
+    bool locked() const { return locked_; }
+    void unlock() { locked_ = false; }
+
+private:
+
+    // Grey copy of part of a frame
+    static void grey(const cv::Mat &frame, oat::PixelColor color, cv::Mat &out);
+
+    // Window of side window_px_ centred on a point, within the frame
+    cv::Rect windowAround(const cv::Point2d &p) const;
+
+    const int window_px_;
+    const int max_features_;
+    const int min_features_;
+
+    bool locked_ {false};
+    cv::Point2d position_;
+    cv::Size frame_size_;
+
+    // Last prepared frame
+    cv::Mat prepared_;
+
+    // Window last followed in, and its grey pixels in the last frame
+    cv::Rect window_;
+    cv::Mat prev_, next_;
+
+    // Feature positions, in frame coordinates, and scratch space
+    std::vector<cv::Point2f> features_, prev_pts_, next_pts_, back_pts_;
+    std::vector<uchar> status_, back_status_;
+    std::vector<float> error_;
+    std::vector<float> dx_, dy_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_FLOWTRACKER_H */
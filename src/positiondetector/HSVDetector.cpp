@@ -20,6 +20,7 @@
 #include "HSVDetector.h"
 #include "DetectorFunc.h"
 
+#include <algorithm>
 #include <string>
 #include <limits>
 #include <opencv2/opencv.hpp>
@@ -28,6 +29,7 @@
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
@@ -42,8 +44,18 @@ HSVDetector::HSVDetector(const std::string &frame_source_address,
     set_erode_size(0);
     set_dilate_size(10);
 
-    // Set required frame type
+    // Set required frame type. BGR frames are thresholded through a lookup
+    // table instead of being converted, and Bayer frames are demosaiced to BGR
+    // first.
     required_color_ = PIX_HSV;
+    accepted_colors_ = {PIX_BGR,
+                        PIX_BAYER_RG,
+                        PIX_BAYER_GR,
+                        PIX_BAYER_GB,
+                        PIX_BAYER_BG};
+
+    // Frames are only read, or copied for the tuning view
+    zero_copy_ = true;
 }
 
 po::options_description HSVDetector::options() const
@@ -67,8 +79,96 @@ po::options_description HSVDetector::options() const
         ("area,a", po::value<std::string>(),
          "Array of floats, [min,max], specifying the minimum and maximum "
          "object contour area in pixels^2.")
+        ("all-objects",
+         "If true, publish every object within the area bounds to SINK as a "
+         "position array, rather than only the largest as a position.")
+        ("label",
+         "If true, find objects by labeling connected pixels in a single pass "
+         "rather than by tracing their contours. Object area is then a pixel "
+         "count that excludes any holes.")
+        ("axis",
+         "If true, set the heading of each position to the major axis of the "
+         "detected object, from its second order moments, pointed along the "
+         "object's motion or, while it is still, to the side of the previous "
+         "heading. Objects too round to have an axis have no heading.")
+        ("deadline", po::value<double>(),
+         "Largest lag, in ms, of the frame being processed behind the newest "
+         "frame in SOURCE's ring buffers. Staler frames are skipped, so "
+         "positions stay fresh when detection falls behind. Skipped frames "
+         "show as gaps in position sample numbers. Defaults to 0, which "
+         "processes every frame.")
+        ("shard", po::value<std::string>(),
+         "Share detection with other posidet processes as I/N, e.g. 0/2 and "
+         "1/2. This process detects only frames whose sample number modulo N "
+         "is I, and SINK becomes a merge node that the other shards publish "
+         "to as well. Sources read the positions of all shards in sample "
+         "order.")
+        ("history", po::value<size_t>(),
+         "Keep the last N positions published to SINK in a history ring that "
+         "components reading SINK can scan by sample number, e.g. to draw "
+         "trails, instead of each keeping its own. At 30 Hz, 300 keeps the "
+         "last 10 s. Defaults to 0, which keeps no history.")
+        ("bus", po::value<std::string>(),
+         "Also publish positions to this position bus, on a channel named "
+         "after SINK, so that programs following many positions can read "
+         "them all with a single wait rather than a source per SINK.")
+        ("search-window", po::value<int>(),
+         "Side length, in pixels, of a square window around the predicted "
+         "object position to which detection is restricted. The prediction "
+         "extrapolates the last two detected positions. The full frame is "
+         "searched until the object is found and after search-misses "
+         "consecutive misses. Defaults to 0, which always searches the full "
+         "frame.")
+        ("search-misses", po::value<int>(),
+         "Number of consecutive misses within the search window after which "
+         "the full frame is searched. Defaults to 5.")
+        ("flow-window", po::value<int>(),
+         "Side length, in pixels, of a square window in which an object, "
+         "once detected, is followed from frame to frame by pyramidal "
+         "Lucas-Kanade optical flow on corner features found on it, rather "
+         "than being detected again. The object is detected again when too "
+         "few features can be followed. Cannot be used with all-objects or "
+         "workers. Defaults to 0, which detects in every frame.")
+        ("flow-features", po::value<int>(),
+         "Largest number of features followed by flow-window. Defaults to "
+         "20.")
+        ("flow-min-features", po::value<int>(),
+         "Fewest features that must survive a forward-backward check for the "
+         "object to still be followed. Defaults to 5.")
+        ("flow-refresh", po::value<int>(),
+         "Most consecutive frames in which the object is followed before it "
+         "is detected again, bounding drift. Defaults to 0, which follows "
+         "until the object is lost.")
+        ("pyramid", po::value<int>(),
+         "Number of times to halve the frame, using cv::pyrDown, before "
+         "looking for the object. The coarse detection is then refined in a "
+         "small window of the full resolution frame. Defaults to 0, which "
+         "detects at full resolution.")
+        ("workers", po::value<int>(),
+         "Number of threads that detect positions in successive frames in "
+         "parallel. Positions are still published in order. Cannot be used "
+         "with tune, search-window or flow-window. Defaults to 1.")
+        ("budget", po::value<double>(),
+         "Time, in ms, that detecting the position in a frame should take. "
+         "When detection keeps taking longer, e.g. because the CPU is "
+         "saturated, accuracy is traded for speed in the order given by "
+         "degrade, and it is restored once detection is well within budget "
+         "again. Cannot be used with workers. Defaults to 0, which never "
+         "degrades.")
+        ("degrade", po::value<std::string>(),
+         "Array of strings, e.g. [\"pyramid\",\"window\"], giving the order "
+         "in which accuracy is traded for speed when budget is exceeded. "
+         "'pyramid' halves frames up to two more times before detection. "
+         "'window' halves the search-window up to twice. Defaults to "
+         "pyramid, followed by window if a search-window is set.")
         ("tune,t",
          "If true, provide a GUI with sliders for tuning detection parameters.")
+#ifdef HAVE_CUDA
+        ("gpu",
+         "If true, perform thresholding and morphology on the GPU.")
+        ("gpu-index", po::value<size_t>(),
+         "Index of GPU card to use if gpu is set.")
+#endif
         ;
 
     return local_opts;
@@ -76,6 +176,98 @@ po::options_description HSVDetector::options() const
 
 void HSVDetector::applyConfiguration(const po::variables_map &vm,
                                      const config::OptionTable &config_table)
+{
+    // Parameters that can also be set at runtime
+    configureDetection(vm, config_table);
+
+    // Multiple objects
+    oat::config::getValue<bool>(vm, config_table, "all-objects", all_objects_);
+
+    // Connected component labeling
+    oat::config::getValue<bool>(vm, config_table, "label", label_components_);
+
+    // Heading from the object's major axis
+    oat::config::getValue<bool>(vm, config_table, "axis", axis_heading_);
+
+    // Skip stale frames
+    configureDeadline(vm, config_table);
+
+    // Detect a share of the frames
+    configureShard(vm, config_table);
+    configureHistory(vm, config_table);
+    configureBus(vm, config_table);
+
+    // Search window
+    oat::config::getNumericValue<int>(
+        vm, config_table, "search-window", search_window_px_, 0);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "search-misses", search_misses_, 1);
+
+    // Optical flow following
+    configureFlow(vm, config_table);
+
+    // Coarse to fine detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "pyramid", pyramid_levels_, 0, 8);
+
+    // Tuning GUI
+    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
+
+#ifdef HAVE_CUDA
+    // GPU
+    oat::config::getValue<bool>(vm, config_table, "gpu", use_gpu_);
+    if (use_gpu_) {
+        size_t index = 0;
+        oat::config::getNumericValue<size_t>(
+            vm, config_table, "gpu-index", index, 0);
+        configureGPU(index);
+    }
+#endif
+
+    // Parallel detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "workers", workers_, 1);
+    if (workers_ > 1 && tuning_on_)
+        throw std::runtime_error("Tuning cannot be used with multiple "
+                                 "workers.");
+
+    // HSV passbands are applied to each channel plane in turn. The GPU
+    // uploads interleaved frames.
+    planar_colors_ = {PIX_HSV};
+#ifdef HAVE_CUDA
+    if (use_gpu_)
+        planar_colors_.clear();
+#endif
+
+    // Trade accuracy for speed under load
+    configureGovernor(vm, config_table, true);
+
+    configureWorkers(vm, config_table);
+
+    // Its sliders start from the configuration above
+    if (tuning_on_)
+        tuner_ = oat::make_unique<oat::TuningDisplay>(
+            tuning_image_title_,
+            [this] { createTuningWindows(); },
+            helper_thread_policy_);
+}
+
+oat::CommandDescription HSVDetector::parameters()
+{
+    const oat::CommandDescription params{
+        {"h-thresh", "Hue passband, [min,max]."},
+        {"s-thresh", "Saturation passband, [min,max]."},
+        {"v-thresh", "Value passband, [min,max]."},
+        {"erode", "Erode kernel size in pixels."},
+        {"dilate", "Dilate kernel size in pixels."},
+        {"area", "Object area range, [min,max], in pixels^2."}
+    };
+
+    return params;
+}
+
+void HSVDetector::configureDetection(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
 {
     // Hue
     std::vector<int> h;
@@ -134,72 +326,158 @@ void HSVDetector::applyConfiguration(const po::variables_map &vm,
         if (min_object_area_ >= max_object_area_)
            throw std::runtime_error("Max area should be larger than min area.");
     }
-
-    // Tuning GUI
-    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
 }
 
-void HSVDetector::detectPosition(cv::Mat &frame, oat::Position2D &position)
+void HSVDetector::detectPosition(cv::Mat &raw_frame, oat::Position2D &position)
 {
-    // Threshold HSV channels
-    // (Very expensive operation)
-    cv::inRange(frame,
-                cv::Scalar(h_min_, s_min_, v_min_),
-                cv::Scalar(h_max_, s_max_, v_max_),
-                threshold_frame_);
+    // Only build a tuning view if the display can take it
+    const bool tune = tuner_ && tuner_->ready();
+
+    // Channel planes are thresholded where they lie. The tuning view and the
+    // coarse to fine search interleave them first.
+    if (planar_ && !tune && (pyramid_levels_ == 0 || tuning_on_)) {
+        applyThreshold(raw_frame, 0);
+        siftObjects(threshold_frame_,
+                    position,
+                    object_area_,
+                    min_object_area_,
+                    max_object_area_);
+        return;
+    }
 
-    // Filter the resulting threshold image
-    if (erode_on_)
-        cv::erode(threshold_frame_, threshold_frame_, erode_element_);
+    // Bayer frames are demosaiced here, and only within the search window,
+    // rather than by a filter upstream that would pass three times the bytes
+    // through shared memory. The GPU demosaics full resolution frames itself.
+    cv::Mat &frame = demosaic(raw_frame, tune);
+
+    // The tuning view shows the full resolution threshold
+    if (pyramid_levels_ > 0 && !tuning_on_) {
+        detectCoarseToFine(frame, position);
+        return;
+    }
 
-    if (dilate_on_)
-        cv::dilate(threshold_frame_, threshold_frame_, dilate_element_);
+    applyThreshold(frame, 0);
 
     // Threshold frame will be destroyed by the transform below, so we need to use
     // it to form the frame that will be shown in the tuning window here
-    if (tuning_on_)
-        frame.setTo(0, threshold_frame_ == 0).clone();
+    if (tune)
+        tuner_->capture(frame, threshold_frame_);
+
+    // Find the largest object in the threshold image
+    siftObjects(threshold_frame_,
+                position,
+                object_area_,
+                min_object_area_,
+                max_object_area_);
+
+    if (tune)
+        tuner_->show(position, object_area_, cv::Scalar(0, 0, 255));
+}
 
-    // Find the largest contour in the threshold image
-    siftContours(threshold_frame_,
-                 position,
-                 object_area_,
-                 min_object_area_,
-                 max_object_area_);
+cv::Mat &HSVDetector::demosaic(cv::Mat &frame, bool tune)
+{
+    if (planar_) {
+        cv::Mat channels[3];
+        oat::planarChannels(frame, channels);
+        cv::merge(channels, 3, bgr_frame_);
+        return bgr_frame_;
+    }
 
-    // Use the GUI tuner if requested
-    if (tuning_on_)
-        tune(frame, position);
+    if (!oat::is_bayer(frame_color_))
+        return frame;
+
+    if (demosaic_code_ < 0)
+        demosaic_code_ = oat::color_conv_code(frame_color_, PIX_BGR);
+
+#ifdef HAVE_CUDA
+    // Uploaded raw, which also moves a third of the bytes to the device
+    if (use_gpu_ && pyramid_levels_ == 0 && !tune)
+        return frame;
+#endif
+
+    cv::cvtColor(frame, bgr_frame_, demosaic_code_);
+    return bgr_frame_;
 }
 
-void HSVDetector::tune(cv::Mat &frame, const oat::Position2D &position)
+void HSVDetector::detectCoarseToFine(cv::Mat &frame,
+                                     oat::Position2D &position)
 {
-    if (!tuning_windows_created_)
-        createTuningWindows();
-
-    std::string msg = cv::format("Object not found");
-
-    // Plot a circle representing found object
-    if (position.position_valid) {
-        auto radius = std::sqrt(object_area_ / PI);
-        cv::Point center;
-        center.x = position.position.x;
-        center.y = position.position.y;
-        cv::circle(frame, center, radius, cv::Scalar(0, 0, 255), 4);
-        msg = cv::format("(%d, %d) pixels",
-                         (int)position.position.x,
-                         (int)position.position.y);
+    const double scale = 1 << pyramid_levels_;
+
+    // Find the object on the downsampled frame
+    applyThreshold(downsample(frame), pyramid_levels_);
+    siftObjects(threshold_frame_,
+                position,
+                object_area_,
+                min_object_area_ / (scale * scale),
+                max_object_area_ / (scale * scale));
+    upsample(position, object_area_);
+
+    if (!position.position_valid)
+        return;
+
+    // Refine its centroid at full resolution. The coarse estimate stands if
+    // refinement fails.
+    auto window = refinementWindow(position, object_area_, frame.size());
+    applyThreshold(frame(window), 0);
+
+    oat::Position2D fine("");
+    double fine_area {0.0};
+    siftObjects(threshold_frame_,
+                fine,
+                fine_area,
+                min_object_area_,
+                max_object_area_,
+                false);
+
+    if (fine.position_valid) {
+        position.position.x = fine.position.x + window.x;
+        position.position.y = fine.position.y + window.y;
+        object_area_ = fine_area;
     }
+}
 
-    int baseline = 0;
-    cv::Size textSize = cv::getTextSize(msg, 1, 1, 1, &baseline);
-    cv::Point text_origin(frame.cols - textSize.width - 10,
-                          frame.rows - 2 * baseline - 10);
+void HSVDetector::applyThreshold(const cv::Mat &frame, const int level)
+{
+#ifdef HAVE_CUDA
+    if (use_gpu_ && level == 0) {
+        thresholdGPU(frame);
+        return;
+    }
+#endif
 
-    cv::putText(frame, msg, text_origin, 1, 1, cv::Scalar(0, 255, 0));
+    // Kernels shrink with the frame
+    auto shrink = [level](int px) { return (px + (1 << level) / 2) >> level; };
+
+    // Threshold HSV channels and filter the result in one pass
+    const int lo[3] {h_min_, s_min_, v_min_};
+    const int hi[3] {h_max_, s_max_, v_max_};
+    if (planar_ && frame.type() == CV_8UC1) {
+        threshold_.applyPlanar(frame,
+                               threshold_frame_,
+                               lo,
+                               hi,
+                               erode_on_ ? shrink(erode_px_) : 0,
+                               dilate_on_ ? shrink(dilate_px_) : 0);
+        return;
+    }
 
-    cv::imshow(tuning_image_title_, frame);
-    cv::waitKey(1);
+    if (frame_color_ != PIX_HSV) {
+        hsv_table_.update(lo, hi);
+        threshold_.apply(frame,
+                         threshold_frame_,
+                         hsv_table_,
+                         erode_on_ ? shrink(erode_px_) : 0,
+                         dilate_on_ ? shrink(dilate_px_) : 0);
+        return;
+    }
+
+    threshold_.apply<PIX_HSV>(frame,
+                              threshold_frame_,
+                              lo,
+                              hi,
+                              erode_on_ ? shrink(erode_px_) : 0,
+                              dilate_on_ ? shrink(dilate_px_) : 0);
 }
 
 void HSVDetector::createTuningWindows()
@@ -246,10 +524,88 @@ void HSVDetector::createTuningWindows()
                        50,
                        &hsvDetectorDilateSliderChangedCallback,
                        this);
+}
+
+#ifdef HAVE_CUDA
+void HSVDetector::configureGPU(const size_t index)
+{
+    // Determine if a compatible device is available
+    size_t num_devices = cv::cuda::getCudaEnabledDeviceCount();
+    if (num_devices < 1)
+        throw (std::runtime_error("No GPU found or OpenCV was compiled without CUDA support."));
 
-    tuning_windows_created_ = true;
+    if (index >= num_devices)
+        throw (std::runtime_error("Selected GPU index is invalid."));
+
+    cv::cuda::DeviceInfo gpu_info(index);
+    if (!gpu_info.isCompatible())
+        throw (std::runtime_error("Selected GPU is not compatible with OpenCV."));
+
+    cv::cuda::setDevice(index);
+
+#ifndef NDEBUG
+    cv::cuda::printShortCudaDeviceInfo(index);
+#endif
 }
 
+void HSVDetector::thresholdGPU(const cv::Mat &frame)
+{
+    // The passbands are applied as a per-channel lookup table, rebuilt
+    // whenever they change (e.g. from the tuning GUI)
+    const int bounds[6] {h_min_, h_max_, s_min_, s_max_, v_min_, v_max_};
+    if (!gpu_lut_ || !std::equal(bounds, bounds + 6, gpu_lut_bounds_)) {
+
+        cv::Mat lut(1, 256, CV_8UC3);
+        for (int i = 0; i < 256; i++) {
+            auto &px = lut.at<cv::Vec3b>(0, i);
+            for (int c = 0; c < 3; c++)
+                px[c] = i >= bounds[2 * c] && i <= bounds[2 * c + 1] ? 255 : 0;
+        }
+
+        gpu_lut_ = cv::cuda::createLookUpTable(lut);
+        std::copy(bounds, bounds + 6, gpu_lut_bounds_);
+    }
+
+    if (gpu_filters_stale_) {
+        gpu_erode_.release();
+        gpu_dilate_.release();
+        if (erode_on_)
+            gpu_erode_ = cv::cuda::createMorphologyFilter(
+                cv::MORPH_ERODE, CV_8UC1, erode_element_);
+        if (dilate_on_)
+            gpu_dilate_ = cv::cuda::createMorphologyFilter(
+                cv::MORPH_DILATE, CV_8UC1, dilate_element_);
+        gpu_filters_stale_ = false;
+    }
+
+    // Read in place where the GPU shares host memory
+    const auto gpu_frame = mapped_.in(frame, gpu_frame_);
+    if (frame.channels() == 1) {
+        cv::cuda::demosaicing(gpu_frame, gpu_bgr_frame_, demosaic_code_);
+        cv::cuda::cvtColor(gpu_bgr_frame_, gpu_hsv_frame_, cv::COLOR_BGR2HSV);
+        gpu_lut_->transform(gpu_hsv_frame_, gpu_lut_frame_);
+    } else if (frame_color_ != PIX_HSV) {
+        cv::cuda::cvtColor(gpu_frame, gpu_hsv_frame_, cv::COLOR_BGR2HSV);
+        gpu_lut_->transform(gpu_hsv_frame_, gpu_lut_frame_);
+    } else {
+        gpu_lut_->transform(gpu_frame, gpu_lut_frame_);
+    }
+
+    // A pixel passes if all three of its channels are within their bands
+    cv::cuda::split(gpu_lut_frame_, gpu_channels_);
+    cv::cuda::bitwise_and(gpu_channels_[0], gpu_channels_[1], gpu_threshold_);
+    cv::cuda::bitwise_and(gpu_channels_[2], gpu_threshold_, gpu_threshold_);
+
+    if (gpu_erode_)
+        gpu_erode_->apply(gpu_threshold_, gpu_threshold_);
+
+    if (gpu_dilate_)
+        gpu_dilate_->apply(gpu_threshold_, gpu_threshold_);
+
+    gpu_threshold_.download(threshold_frame_);
+}
+#endif
+
 void HSVDetector::set_erode_size(int value)
 {
     if (value > 0) {
@@ -259,6 +615,10 @@ void HSVDetector::set_erode_size(int value)
     } else {
         erode_on_ = false;
     }
+
+#ifdef HAVE_CUDA
+    gpu_filters_stale_ = true;
+#endif
 }
 
 void HSVDetector::set_dilate_size(int value)
@@ -270,6 +630,10 @@ void HSVDetector::set_dilate_size(int value)
     } else {
         dilate_on_ = false;
     }
+
+#ifdef HAVE_CUDA
+    gpu_filters_stale_ = true;
+#endif
 }
 
 // Non-member GUI callback functions
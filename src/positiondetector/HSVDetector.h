@@ -22,16 +22,21 @@
 
 #include "OatConfig.h" // Generated by CMake
 
-#include <string>
 #include <limits>
+#include <memory>
+#include <string>
 #include <opencv2/core/mat.hpp>
 
-#ifdef NOIMP_OAT_USE_CUDA
+#ifdef HAVE_CUDA
+ #include <opencv2/core/cuda.hpp>
  #include <opencv2/cudaarithm.hpp>
  #include <opencv2/cudafilters.hpp>
  #include <opencv2/cudaimgproc.hpp>
 #endif
 
+#include "../../lib/utility/TuningDisplay.h"
+
+#include "PassbandThreshold.h"
 #include "PositionDetector.h"
 
 namespace oat {
@@ -66,6 +71,11 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    // Runtime parameters
+    oat::CommandDescription parameters(void) override;
+    void configureDetection(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
     /**
      * Perform color-based object position detection.
      * @param Frame to look for object within.
@@ -73,6 +83,39 @@ private:
      */
     void detectPosition(cv::Mat &frame, oat::Position2D &position) override;
 
+    std::unique_ptr<PositionDetector> replicate() const override
+    {
+        return replicateAs<HSVDetector>();
+    }
+
+    /**
+     * Find the object on a downsampled frame, then refine its centroid in a
+     * window of the full resolution frame.
+     * @param Frame to look for object within.
+     * @param position Detected object position.
+     */
+    void detectCoarseToFine(cv::Mat &frame, oat::Position2D &position);
+
+    /**
+     * Threshold and filter a frame into threshold_frame_.
+     * @param frame Frame to threshold
+     * @param level Pyramid level of the frame. Morphology kernels are
+     * halved for each level.
+     */
+    void applyThreshold(const cv::Mat &frame, const int level);
+
+    /**
+     * Demosaic Bayer frames to BGR, unless the GPU will do it, and
+     * interleave planar frames.
+     * @param frame Frame from SOURCE
+     * @param tune True if a tuning view will be made of the frame
+     * @return frame if it needs no demosaicing here, else the demosaiced
+     * or interleaved frame.
+     */
+    cv::Mat &demosaic(cv::Mat &frame, bool tune);
+    cv::Mat bgr_frame_;
+    int demosaic_code_ {-1};
+
     // Erode and dilate kernels
     int erode_px_ {0}, dilate_px_ {10};
     bool erode_on_ {false}, dilate_on_ {false};
@@ -81,6 +124,23 @@ private:
 
     // Internal matricies
     cv::Mat threshold_frame_, erode_element_, dilate_element_;
+    PassbandThreshold threshold_;
+    HSVTable hsv_table_;
+
+#ifdef HAVE_CUDA
+    // GPU threshold and morphology. Only the binary mask is downloaded.
+    bool use_gpu_ {false};
+    bool gpu_filters_stale_ {true};
+    int gpu_lut_bounds_[6] {-1, -1, -1, -1, -1, -1};
+    cv::cuda::GpuMat gpu_frame_, gpu_bgr_frame_, gpu_hsv_frame_;
+    oat::MappedFrames mapped_;
+    cv::cuda::GpuMat gpu_lut_frame_, gpu_threshold_;
+    std::vector<cv::cuda::GpuMat> gpu_channels_;
+    cv::Ptr<cv::cuda::LookUpTable> gpu_lut_;
+    cv::Ptr<cv::cuda::Filter> gpu_erode_, gpu_dilate_;
+    void configureGPU(const size_t index);
+    void thresholdGPU(const cv::Mat &frame);
+#endif
 
     // HSV threshold values
     int h_min_ {0}, h_max_ {256};
@@ -95,9 +155,8 @@ private:
 
     // Parameter tuning GUI functions and properties
     bool tuning_on_ {false};
-    bool tuning_windows_created_ {false};
     const std::string tuning_image_title_;
-    void tune(cv::Mat &frame, const oat::Position2D &position);
+    std::unique_ptr<oat::TuningDisplay> tuner_;
     void createTuningWindows(void);
 };
 
@@ -0,0 +1,268 @@
+//******************************************************************************
+//* File:   HSVMarkerDetector.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#include "HSVMarkerDetector.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <cpptoml.h>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+HSVMarkerDetector::HSVMarkerDetector(const std::string &frame_source_address,
+                                     const std::string &position_sink_address)
+: PositionDetector(frame_source_address, position_sink_address)
+{
+    // BGR frames are classified through a lookup table instead of being
+    // converted
+    required_color_ = PIX_HSV;
+    accepted_colors_ = {PIX_BGR};
+
+    // Frames are only read
+    zero_copy_ = true;
+}
+
+po::options_description HSVMarkerDetector::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("markers,m", po::value<std::string>(),
+         "TOML array of up to 8 tables, one per marker, in order. Each gives "
+         "the marker's 'h-thresh', 's-thresh' and 'v-thresh' passbands, "
+         "[min,max] arrays of ints between 0 and 256 that default to the "
+         "full range, and its 'area', [min,max] in pixels^2, e.g. "
+         "[{h-thresh=[5,20],area=[10,400]},{h-thresh=[100,130]}].")
+        ("erode,e", po::value<int>(),
+         "Contour erode kernel size in pixels (normalized box filter), for "
+         "every marker.")
+        ("dilate,d", po::value<int>(),
+         "Contour dilation kernel size in pixels (normalized box filter), "
+         "for every marker.")
+        ("heading-anchor,h", po::value<int>(),
+         "Index of the marker from which the heading is measured. If given, "
+         "a single position is published: the mean of the markers found, "
+         "with the mean direction from the anchor to each other marker as "
+         "its heading. Otherwise every marker is published, in order, as a "
+         "position array whose entries are invalid for markers that were not "
+         "found.")
+        ("label",
+         "If true, find markers by labeling connected pixels in a single "
+         "pass rather than by tracing their contours. Marker area is then a "
+         "pixel count that excludes any holes.")
+        ("deadline", po::value<double>(),
+         "Largest lag, in ms, of the frame being processed behind the newest "
+         "frame in SOURCE's ring buffers. Staler frames are skipped, so "
+         "positions stay fresh when detection falls behind. Skipped frames "
+         "show as gaps in position sample numbers. Defaults to 0, which "
+         "processes every frame.")
+        ("shard", po::value<std::string>(),
+         "Share detection with other posidet processes as I/N, e.g. 0/2 and "
+         "1/2. This process detects only frames whose sample number modulo N "
+         "is I, and SINK becomes a merge node that the other shards publish "
+         "to as well. Sources read the positions of all shards in sample "
+         "order.")
+        ("history", po::value<size_t>(),
+         "Keep the last N positions published to SINK in a history ring that "
+         "components reading SINK can scan by sample number, e.g. to draw "
+         "trails, instead of each keeping its own. At 30 Hz, 300 keeps the "
+         "last 10 s. Defaults to 0, which keeps no history.")
+        ("bus", po::value<std::string>(),
+         "Also publish positions to this position bus, on a channel named "
+         "after SINK, so that programs following many positions can read "
+         "them all with a single wait rather than a source per SINK.")
+        ("workers", po::value<int>(),
+         "Number of threads that detect markers in successive frames in "
+         "parallel. Positions are still published in order. Defaults to 1.")
+        ;
+
+    return local_opts;
+}
+
+void HSVMarkerDetector::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Marker tables, from the command line or the configuration table
+    auto table = config_table;
+    if (vm.count("markers")) {
+        std::istringstream toml {"markers=" + vm["markers"].as<std::string>()};
+        cpptoml::parser p {toml};
+        table = p.parse();
+    }
+
+    auto tables = table->get_table_array("markers");
+    if (!tables || tables->get().empty())
+        throw std::runtime_error("A marker detector requires a 'markers' "
+                                 "array of tables, one per marker.");
+
+    if (tables->get().size() > HSVLabelTable::MAX_BANDS)
+        throw std::runtime_error("At most "
+                                 + std::to_string(HSVLabelTable::MAX_BANDS)
+                                 + " markers can be detected at once.");
+
+    markers_.clear();
+    lo_.clear();
+    hi_.clear();
+    for (const auto &t : *tables) {
+
+        oat::config::checkKeys({"h-thresh", "s-thresh", "v-thresh", "area"}, t);
+
+        for (const auto &key : {"h-thresh", "s-thresh", "v-thresh"}) {
+
+            std::vector<int> band {0, 256};
+            oat::config::getArray<int, 2>(po::variables_map(), t, key, band);
+
+            if (band[0] < 0 || band[0] > 256 || band[1] < 0 || band[1] > 256)
+                throw std::runtime_error("Values of " + std::string(key)
+                                         + " should be between 0 and 256.");
+
+            lo_.push_back(band[0]);
+            hi_.push_back(band[1]);
+        }
+
+        Marker m;
+        std::vector<double> area;
+        if (oat::config::getArray<double, 2>(
+                po::variables_map(), t, "area", area)) {
+
+            m.min_area = area[0];
+            m.max_area = area[1];
+
+            if (m.min_area >= m.max_area)
+                throw std::runtime_error("Max area should be larger than min "
+                                         "area.");
+        }
+
+        markers_.push_back(m);
+    }
+
+    found_.assign(markers_.size(), oat::Position2D(""));
+    areas_.assign(markers_.size(), 0.0);
+
+    // Morphology
+    oat::config::getNumericValue<int>(vm, config_table, "erode", erode_px_, 0);
+    oat::config::getNumericValue<int>(vm, config_table, "dilate", dilate_px_, 0);
+
+    // Output
+    oat::config::getNumericValue<int>(vm, config_table, "heading-anchor",
+                                      heading_anchor_, 0,
+                                      static_cast<int>(markers_.size()) - 1);
+    all_objects_ = heading_anchor_ < 0;
+
+    // Connected component labeling
+    oat::config::getValue<bool>(vm, config_table, "label", label_components_);
+
+    // Skip stale frames
+    configureDeadline(vm, config_table);
+
+    // Detect a share of the frames
+    configureShard(vm, config_table);
+    configureHistory(vm, config_table);
+    configureBus(vm, config_table);
+
+    // Parallel detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "workers", workers_, 1);
+
+    configureWorkers(vm, config_table);
+}
+
+void HSVMarkerDetector::detectPosition(cv::Mat &frame,
+                                       oat::Position2D &position)
+{
+    // One pass over the frame classifies every pixel into every band
+    if (frame_color_ == PIX_HSV) {
+        threshold_.classify(frame, labels_, lo_, hi_);
+    } else {
+        label_table_.update(lo_, hi_);
+        threshold_.classify(frame, labels_, label_table_);
+    }
+
+    // Each marker is then filtered and found on its bit of the labels
+    for (size_t k = 0; k < markers_.size(); k++) {
+        threshold_.applyBand(labels_, mask_, static_cast<int>(k),
+                             erode_px_, dilate_px_);
+        siftObjects(mask_,
+                    found_[k],
+                    areas_[k],
+                    markers_[k].min_area,
+                    markers_[k].max_area,
+                    false);
+    }
+
+    if (objects_ != nullptr) {
+
+        // Entries keep the order of the markers, found or not
+        objects_->clear();
+        for (size_t k = 0; k < markers_.size(); k++) {
+            const auto &p = found_[k];
+            objects_->push(p.position.x, p.position.y, areas_[k]);
+            objects_->valid[k] = p.position_valid;
+        }
+    }
+
+    combine(position);
+}
+
+void HSVMarkerDetector::combine(oat::Position2D &position) const
+{
+    position.position = oat::Point2D(0, 0);
+    position.position_valid = false;
+    position.heading = oat::UnitVector2D(0, 0);
+    position.heading_valid = false;
+    position.score = 0.0;
+
+    size_t n = 0;
+    for (size_t k = 0; k < found_.size(); k++) {
+        if (!found_[k].position_valid)
+            continue;
+        position.position += found_[k].position;
+        position.score += areas_[k];
+        n++;
+    }
+
+    if (n == 0)
+        return;
+
+    position.position *= 1.0 / n;
+    position.position_valid = true;
+
+    if (heading_anchor_ < 0 || !found_[heading_anchor_].position_valid)
+        return;
+
+    // Mean direction from the anchor to each other marker found
+    const auto &anchor = found_[heading_anchor_].position;
+    for (size_t k = 0; k < found_.size(); k++)
+        if (static_cast<int>(k) != heading_anchor_ && found_[k].position_valid)
+            position.heading += found_[k].position - anchor;
+
+    const double mag = std::sqrt(position.heading.dot(position.heading));
+    if (mag > 0.0) {
+        position.heading *= 1.0 / mag;
+        position.heading_valid = true;
+    }
+}
+
+} /* namespace oat */
@@ -0,0 +1,102 @@
+//******************************************************************************
+//* File:   HSVMarkerDetector.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#ifndef OAT_HSVMARKERDETECTOR_H
+#define	OAT_HSVMARKERDETECTOR_H
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "PassbandThreshold.h"
+#include "PositionDetector.h"
+
+namespace oat {
+
+class Position2D;
+
+class HSVMarkerDetector : public PositionDetector {
+
+public:
+    /**
+     * A color-based detector of several markers, e.g. the LEDs of a
+     * headstage, each with its own HSV passbands. Every pixel is classified
+     * into all bands in a single pass over the frame, so K markers cost one
+     * frame sweep instead of the K of as many hsv detectors.
+     * @param frame_source_address Frame SOURCE node address
+     * @param position_sink_address Position SINK node address
+     */
+    HSVMarkerDetector(const std::string &frame_source_address,
+                      const std::string &position_sink_address);
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    /**
+     * Detect each marker.
+     * @param Frame to look for markers within.
+     * @param position Mean marker position and, if a heading anchor is set,
+     * the heading of the markers.
+     */
+    void detectPosition(cv::Mat &frame, oat::Position2D &position) override;
+
+    std::unique_ptr<PositionDetector> replicate() const override
+    {
+        return replicateAs<HSVMarkerDetector>();
+    }
+
+    // Passbands of each marker, three per marker, and its area range
+    struct Marker {
+        double min_area {0.0};
+        double max_area {std::numeric_limits<double>::max()};
+    };
+    std::vector<Marker> markers_;
+    std::vector<int> lo_, hi_;
+
+    // Erode and dilate kernels, shared by every marker
+    int erode_px_ {0}, dilate_px_ {10};
+
+    // Marker whose heading to the others is published, or -1 to publish
+    // every marker as a position array
+    int heading_anchor_ {-1};
+
+    // Internal matricies
+    cv::Mat labels_, mask_;
+    PassbandThreshold threshold_;
+    HSVLabelTable label_table_;
+
+    // Markers found in the current frame
+    std::vector<oat::Position2D> found_;
+    std::vector<double> areas_;
+
+    /**
+     * Combine found markers, as posicom mean would.
+     * @param position Mean of the found markers, with the mean heading
+     * from the anchor to each other marker.
+     */
+    void combine(oat::Position2D &position) const;
+};
+
+}       /* namespace oat */
+#endif	/* OAT_HSVMARKERDETECTOR_H */
@@ -0,0 +1,251 @@
+//******************************************************************************
+//* File:   MOGDetector.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "MOGDetector.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#ifdef HAVE_CUDA
+ #include <opencv2/cudaarithm.hpp>
+#endif
+#include <cpptoml.h>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+MOGDetector::MOGDetector(const std::string &frame_source_address,
+                         const std::string &position_sink_address)
+: PositionDetector(frame_source_address, position_sink_address)
+{
+    // The background model works on color or grey-scale frames
+    accepted_colors_ = {PIX_GREY};
+
+    // Frames are only read
+    zero_copy_ = true;
+}
+
+po::options_description MOGDetector::options() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("adaptation-coeff,a", po::value<double>(),
+         "Value, 0 to 1.0, specifying how quickly the statistical model "
+         "of the background image should be updated. "
+         "Default is 0, specifying no adaptation.")
+        ("area", po::value<std::string>(),
+         "Array of floats, [min,max], specifying the minimum and maximum "
+         "object area in pixels^2.")
+        ("all-objects",
+         "If true, publish every object within the area bounds to SINK as a "
+         "position array, rather than only the largest as a position.")
+        ("label",
+         "If true, find objects by labeling connected pixels in a single pass "
+         "rather than by tracing their contours. Object area is then a pixel "
+         "count that excludes any holes.")
+        ("axis",
+         "If true, set the heading of each position to the major axis of the "
+         "detected object, from its second order moments, pointed along the "
+         "object's motion or, while it is still, to the side of the previous "
+         "heading. Objects too round to have an axis have no heading.")
+        ("deadline", po::value<double>(),
+         "Largest lag, in ms, of the frame being processed behind the newest "
+         "frame in SOURCE's ring buffers. Staler frames are skipped, so "
+         "positions stay fresh when detection falls behind. Skipped frames "
+         "show as gaps in position sample numbers. Defaults to 0, which "
+         "processes every frame.")
+        ("shard", po::value<std::string>(),
+         "Share detection with other posidet processes as I/N, e.g. 0/2 and "
+         "1/2. This process detects only frames whose sample number modulo N "
+         "is I, and SINK becomes a merge node that the other shards publish "
+         "to as well. Sources read the positions of all shards in sample "
+         "order.")
+        ("history", po::value<size_t>(),
+         "Keep the last N positions published to SINK in a history ring that "
+         "components reading SINK can scan by sample number, e.g. to draw "
+         "trails, instead of each keeping its own. At 30 Hz, 300 keeps the "
+         "last 10 s. Defaults to 0, which keeps no history.")
+        ("bus", po::value<std::string>(),
+         "Also publish positions to this position bus, on a channel named "
+         "after SINK, so that programs following many positions can read "
+         "them all with a single wait rather than a source per SINK.")
+#ifdef HAVE_CUDA
+        ("gpu-index", po::value<size_t>(),
+         "Index of GPU card to use for performing MOG segmentation. With a "
+         "GPU, the position is the centroid of the whole foreground, unless "
+         "all-objects is set.")
+#endif
+        ;
+
+    return local_opts;
+}
+
+void MOGDetector::applyConfiguration(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    // Parameters that can also be set at runtime
+    configureDetection(vm, config_table);
+
+    // Multiple objects
+    oat::config::getValue<bool>(vm, config_table, "all-objects", all_objects_);
+
+    // Connected component labeling
+    oat::config::getValue<bool>(vm, config_table, "label", label_components_);
+
+    // Heading from the object's major axis
+    oat::config::getValue<bool>(vm, config_table, "axis", axis_heading_);
+
+    // Skip stale frames
+    configureDeadline(vm, config_table);
+
+    // Detect a share of the frames
+    configureShard(vm, config_table);
+    configureHistory(vm, config_table);
+    configureBus(vm, config_table);
+
+#ifdef HAVE_CUDA
+    // GPU index
+    size_t index = 0;
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "gpu-index", index, 0);
+    configureGPU(index);
+    background_subtractor_ = cv::cuda::createBackgroundSubtractorMOG();
+#else
+    // Shadows would be marked as foreground
+    background_subtractor_ = cv::createBackgroundSubtractorMOG2(500, 16, false);
+#endif
+}
+
+oat::CommandDescription MOGDetector::parameters()
+{
+    const oat::CommandDescription params{
+        {"adaptation-coeff", "Background learning coefficient, 0 to 1."},
+        {"area", "Object area range, [min,max], in pixels^2."}
+    };
+
+    return params;
+}
+
+void MOGDetector::configureDetection(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    // Learning coefficient
+    oat::config::getNumericValue(
+        vm, config_table, "adaptation-coeff", learning_coeff_, 0.0, 1.0);
+
+    // Min/max object area
+    std::vector<double> area;
+    if (oat::config::getArray<double, 2>(vm, config_table, "area", area)) {
+
+        min_object_area_ = area[0];
+        max_object_area_ = area[1];
+
+        if (min_object_area_ >= max_object_area_)
+           throw std::runtime_error("Max area should be larger than min area.");
+    }
+}
+
+#ifdef HAVE_CUDA
+void MOGDetector::configureGPU(const size_t index)
+{
+    // Determine if a compatible device is available
+    size_t num_devices = cv::cuda::getCudaEnabledDeviceCount();
+    if (num_devices < 1)
+        throw (std::runtime_error("No GPU found or OpenCV was compiled without CUDA support."));
+
+    if (index >= num_devices)
+        throw (std::runtime_error("Selected GPU index is invalid."));
+
+    cv::cuda::DeviceInfo gpu_info(index);
+    if (!gpu_info.isCompatible())
+        throw (std::runtime_error("Selected GPU is not compatible with OpenCV."));
+
+    cv::cuda::setDevice(index);
+}
+
+void MOGDetector::momentsGPU(oat::Position2D &position)
+{
+    // Pixel coordinates, uploaded once per frame size
+    if (gpu_x_.size() != gpu_mask_.size()) {
+
+        cv::Mat x(gpu_mask_.size(), CV_32FC1), y(gpu_mask_.size(), CV_32FC1);
+        for (int r = 0; r < x.rows; r++) {
+            float *px = x.ptr<float>(r);
+            float *py = y.ptr<float>(r);
+            for (int c = 0; c < x.cols; c++) {
+                px[c] = static_cast<float>(c);
+                py[c] = static_cast<float>(r);
+            }
+        }
+
+        gpu_x_.upload(x);
+        gpu_y_.upload(y);
+    }
+
+    // Fraction of each pixel that is foreground
+    gpu_mask_.convertTo(gpu_weight_, CV_32FC1, 1.0 / 255.0);
+
+    const double m00 = cv::cuda::sum(gpu_weight_)[0];
+    cv::cuda::multiply(gpu_weight_, gpu_x_, gpu_product_);
+    const double m10 = cv::cuda::sum(gpu_product_)[0];
+    cv::cuda::multiply(gpu_weight_, gpu_y_, gpu_product_);
+    const double m01 = cv::cuda::sum(gpu_product_)[0];
+
+    position.position_valid = false;
+    object_area_ = 0;
+
+    if (m00 > 0 && m00 >= min_object_area_ && m00 < max_object_area_) {
+        position.position.x = m10 / m00;
+        position.position.y = m01 / m00;
+        position.position_valid = true;
+        object_area_ = m00;
+    }
+}
+#endif
+
+void MOGDetector::detectPosition(cv::Mat &frame, oat::Position2D &position)
+{
+#ifdef HAVE_CUDA
+    background_subtractor_->apply(
+        mapped_.in(frame, gpu_frame_), gpu_mask_, learning_coeff_);
+
+    // Individual objects need the mask on the host
+    if (objects_ == nullptr) {
+        momentsGPU(position);
+        return;
+    }
+
+    gpu_mask_.download(foreground_mask_);
+#else
+    background_subtractor_->apply(frame, foreground_mask_, learning_coeff_);
+#endif
+
+    siftObjects(foreground_mask_,
+                position,
+                object_area_,
+                min_object_area_,
+                max_object_area_);
+}
+
+} /* namespace oat */
@@ -0,0 +1,99 @@
+//******************************************************************************
+//* File:   MOGDetector.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_MOGDETECTOR_H
+#define	OAT_MOGDETECTOR_H
+
+#include <limits>
+
+#include <opencv2/cvconfig.h>
+
+#ifdef HAVE_CUDA
+ #include <opencv2/core/cuda.hpp>
+ #include <opencv2/cudabgsegm.hpp>
+#else
+ #include <opencv2/video.hpp>
+#endif
+
+#include "PositionDetector.h"
+
+namespace oat {
+
+// Forward decl.
+class Position2D;
+
+class MOGDetector : public PositionDetector {
+
+public:
+    /**
+     * Mixture of Gaussians background model object position detector. With
+     * CUDA, the foreground mask never leaves the GPU: its moments are summed
+     * on the device and only those are downloaded.
+     * @param frame_source_address Frame SOURCE node address
+     * @param position_sink_address Position SINK node address
+     */
+    MOGDetector(const std::string &frame_source_address,
+                const std::string &position_sink_address);
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Runtime parameters
+    oat::CommandDescription parameters(void) override;
+    void configureDetection(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    void detectPosition(cv::Mat &frame, oat::Position2D &position) override;
+
+    // Object detection
+    double object_area_ {0.0};
+    double min_object_area_ {0.0};
+    double max_object_area_ {std::numeric_limits<double>::max()};
+
+    // Background model
+    double learning_coeff_ {0.0};
+    cv::Mat foreground_mask_;
+
+#ifdef HAVE_CUDA
+    /**
+     * Configure the GPU used for background modeling.
+     * @param index Index of the GPU to use for processing
+     */
+    void configureGPU(const size_t index);
+
+    /**
+     * Find the centroid of the whole foreground mask on the GPU.
+     * @param position Detected object position.
+     */
+    void momentsGPU(oat::Position2D &position);
+
+    cv::Ptr<cv::cuda::BackgroundSubtractorMOG> background_subtractor_;
+    cv::cuda::GpuMat gpu_frame_, gpu_mask_, gpu_weight_, gpu_product_;
+    oat::MappedFrames mapped_;
+    cv::cuda::GpuMat gpu_x_, gpu_y_;
+#else
+    cv::Ptr<cv::BackgroundSubtractorMOG2> background_subtractor_;
+#endif
+};
+
+}       /* namespace oat */
+#endif	/* OAT_MOGDETECTOR_H */
@@ -0,0 +1,577 @@
+//******************************************************************************
+//* File:   PassbandThreshold.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "PassbandThreshold.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#ifdef __ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace oat {
+
+// Rows per band are chosen so that a band's working set stays in L2
+static constexpr size_t BAND_BYTES {256 << 10};
+static constexpr int MIN_BAND_ROWS {8};
+
+namespace {
+
+// Kernel extent along one axis: pixel i covers [i - anchor, i - anchor + size)
+struct Extent {
+    Extent(const int px) : size(px > 0 ? px : 1), anchor(size / 2) { }
+    int size;
+    int anchor;
+};
+
+// out[x] = 1 if every in[j], j in the window of x, is 1. Pixels outside of
+// the row count as 1, as for cv::erode.
+void erodeRow(const uint8_t *in, uint8_t *out, const int w, const Extent &k,
+              uint32_t *prefix)
+{
+    prefix[0] = 0;
+    for (int x = 0; x < w; x++)
+        prefix[x + 1] = prefix[x] + (in[x] == 0);
+
+    for (int x = 0; x < w; x++) {
+        const int a = std::max(0, x - k.anchor);
+        const int b = std::min(w, x - k.anchor + k.size);
+        out[x] = prefix[b] == prefix[a];
+    }
+}
+
+// out[x] = 1 if any in[j], j in the window of x, is 1. Pixels outside of the
+// row count as 0, as for cv::dilate.
+void dilateRow(const uint8_t *in, uint8_t *out, const int w, const Extent &k,
+               uint32_t *prefix)
+{
+    prefix[0] = 0;
+    for (int x = 0; x < w; x++)
+        prefix[x + 1] = prefix[x] + in[x];
+
+    for (int x = 0; x < w; x++) {
+        const int a = std::max(0, x - k.anchor);
+        const int b = std::min(w, x - k.anchor + k.size);
+        out[x] = prefix[b] != prefix[a];
+    }
+}
+
+// Running per-column sum of a window of rows of a band
+class ColumnWindow {
+
+public:
+    ColumnWindow(const uint8_t *band, const int first_row, const int w,
+                 uint32_t *count, const bool zeros)
+    : band_(band), first_(first_row), w_(w), count_(count), zeros_(zeros)
+    {
+        std::fill(count_, count_ + w_, 0);
+        lo_ = hi_ = first_row;
+    }
+
+    // Move the window to image rows [lo, hi). Both must not decrease.
+    void moveTo(const int lo, const int hi)
+    {
+        for (; hi_ < hi; hi_++)
+            add(hi_, 1);
+        for (; lo_ < lo; lo_++)
+            add(lo_, -1);
+    }
+
+private:
+    const uint8_t *band_;
+    const int first_, w_;
+    uint32_t *count_;
+    const bool zeros_;
+    int lo_, hi_;
+
+    void add(const int row, const int sign)
+    {
+        const uint8_t *r = band_ + static_cast<size_t>(row - first_) * w_;
+        if (zeros_) {
+            for (int x = 0; x < w_; x++)
+                count_[x] += sign * (r[x] == 0);
+        } else {
+            for (int x = 0; x < w_; x++)
+                count_[x] += sign * r[x];
+        }
+    }
+};
+
+// 1 if every channel of px lies within its passband
+template <int CHANNELS, typename T>
+inline uint8_t passes(const T *px, const T *l, const T *h)
+{
+    uint8_t p = 1;
+    for (int c = 0; c < CHANNELS; c++)
+        p &= (px[c] >= l[c]) & (px[c] <= h[c]);
+    return p;
+}
+
+// t[x] = 1 if every channel of pixel x of a row lies within its passband
+template <int CHANNELS, typename T>
+inline void passRow(const T *p, uint8_t *t, const int w, const T *l, const T *h)
+{
+    for (int x = 0; x < w; x++)
+        t[x] = passes<CHANNELS>(p + CHANNELS * x, l, h);
+}
+
+// As passRow(), for a row whose three 8 bit channels lie in separate planes
+inline void passPlanarRow(const uint8_t *const p[3],
+                          uint8_t *t,
+                          const int w,
+                          const uint8_t *l,
+                          const uint8_t *h)
+{
+    int x = 0;
+
+#ifdef __ARM_NEON
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; x + 16 <= w; x += 16) {
+        uint8x16_t in = one;
+        for (int c = 0; c < 3; c++) {
+            const uint8x16_t v = vld1q_u8(p[c] + x);
+            in = vandq_u8(in, vcgeq_u8(v, vdupq_n_u8(l[c])));
+            in = vandq_u8(in, vcleq_u8(v, vdupq_n_u8(h[c])));
+        }
+        vst1q_u8(t + x, in);
+    }
+#endif
+
+    for (; x < w; x++)
+        t[x] = (p[0][x] >= l[0]) & (p[0][x] <= h[0])
+             & (p[1][x] >= l[1]) & (p[1][x] <= h[1])
+             & (p[2][x] >= l[2]) & (p[2][x] <= h[2]);
+}
+
+#ifdef __ARM_NEON
+// Interleaved 8 bit pixels are split into channel registers as they load
+template <>
+inline void passRow<3, uint8_t>(const uint8_t *p,
+                                uint8_t *t,
+                                const int w,
+                                const uint8_t *l,
+                                const uint8_t *h)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const uint8x16x3_t v = vld3q_u8(p + 3 * x);
+        uint8x16_t in = one;
+        for (int c = 0; c < 3; c++) {
+            in = vandq_u8(in, vcgeq_u8(v.val[c], vdupq_n_u8(l[c])));
+            in = vandq_u8(in, vcleq_u8(v.val[c], vdupq_n_u8(h[c])));
+        }
+        vst1q_u8(t + x, in);
+    }
+
+    for (; x < w; x++)
+        t[x] = passes<3>(p + 3 * x, l, h);
+}
+#endif
+
+// Channels of each pixel color
+template <PixelColor COLOR>
+constexpr int channels()
+{
+    return COLOR == PIX_BGR || COLOR == PIX_HSV ? 3 : 1;
+}
+
+// Channel type of each pixel color
+template <PixelColor COLOR>
+struct Depth { using type = uint8_t; };
+
+template <>
+struct Depth<PIX_GREY16> { using type = uint16_t; };
+
+// HSV value of the centre of every cell of a table quantized to QUANT_BITS
+// bits per channel, B major
+template <int QUANT_BITS>
+cv::Mat cellCentres()
+{
+    constexpr int LEVELS = 1 << QUANT_BITS;
+    constexpr int HALF = 1 << (7 - QUANT_BITS);
+    cv::Mat bgr(1, LEVELS * LEVELS * LEVELS, CV_8UC3), hsv;
+    auto px = bgr.ptr<uint8_t>(0);
+    for (int b = 0; b < LEVELS; b++)
+        for (int g = 0; g < LEVELS; g++)
+            for (int r = 0; r < LEVELS; r++) {
+                *px++ = static_cast<uint8_t>((b << (8 - QUANT_BITS)) + HALF);
+                *px++ = static_cast<uint8_t>((g << (8 - QUANT_BITS)) + HALF);
+                *px++ = static_cast<uint8_t>((r << (8 - QUANT_BITS)) + HALF);
+            }
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+
+    return hsv;
+}
+
+} /* namespace */
+
+void HSVTable::update(const int lo[], const int hi[])
+{
+    if (!bits_.empty()
+        && std::equal(lo, lo + 3, lo_) && std::equal(hi, hi + 3, hi_))
+        return;
+
+    std::copy(lo, lo + 3, lo_);
+    std::copy(hi, hi + 3, hi_);
+
+    const cv::Mat hsv = cellCentres<QUANT_BITS>();
+
+    bits_.assign(hsv.cols / 8, 0);
+    auto v = hsv.ptr<uint8_t>(0);
+    for (int i = 0; i < hsv.cols; i++, v += 3) {
+        bool in = true;
+        for (int c = 0; c < 3; c++)
+            in &= v[c] >= lo[c] && v[c] <= hi[c];
+        bits_[i >> 3] |= static_cast<uint8_t>(in) << (i & 7);
+    }
+}
+
+void HSVLabelTable::update(const std::vector<int> &lo,
+                           const std::vector<int> &hi)
+{
+    if (!labels_.empty() && lo == lo_ && hi == hi_)
+        return;
+
+    if (lo.size() != hi.size() || lo.size() % 3 != 0
+        || lo.size() / 3 > MAX_BANDS)
+        throw std::runtime_error("HSV label tables hold up to "
+                                 + std::to_string(MAX_BANDS)
+                                 + " sets of H, S and V passbands.");
+
+    lo_ = lo;
+    hi_ = hi;
+
+    const cv::Mat hsv = cellCentres<QUANT_BITS>();
+    const size_t bands = lo.size() / 3;
+
+    labels_.assign(hsv.cols, 0);
+    auto v = hsv.ptr<uint8_t>(0);
+    for (int i = 0; i < hsv.cols; i++, v += 3) {
+        uint8_t l = 0;
+        for (size_t k = 0; k < bands; k++) {
+            bool in = true;
+            for (int c = 0; c < 3; c++)
+                in &= v[c] >= lo[3 * k + c] && v[c] <= hi[3 * k + c];
+            l |= static_cast<uint8_t>(in) << k;
+        }
+        labels_[i] = l;
+    }
+}
+
+template <PixelColor COLOR>
+void PassbandThreshold::apply(const cv::Mat &frame,
+                              cv::Mat &mask,
+                              const int lo[],
+                              const int hi[],
+                              const int erode_px,
+                              const int dilate_px)
+{
+    static_assert(COLOR != PIX_BINARY, "Binary frames need no threshold.");
+    constexpr int CH = channels<COLOR>();
+    using T = typename Depth<COLOR>::type;
+    constexpr int MAX = std::numeric_limits<T>::max();
+
+    if (frame.type() != cv_type(COLOR))
+        throw std::runtime_error("Passband threshold requires a "
+                                 + color_str(COLOR) + " frame.");
+
+    const int rows = frame.rows;
+    const int w = frame.cols;
+    mask.create(rows, w, CV_8UC1);
+    if (rows == 0 || w == 0)
+        return;
+
+    // Passbands as bounds of the channel type. A band entirely above its
+    // largest value passes nothing.
+    bool none = false;
+    T l[CH], h[CH];
+    for (int c = 0; c < CH; c++) {
+        none |= lo[c] > MAX || lo[c] > hi[c] || hi[c] < 0;
+        l[c] = static_cast<T>(std::max(0, std::min(MAX, lo[c])));
+        h[c] = static_cast<T>(std::max(0, std::min(MAX, hi[c])));
+    }
+
+    if (none) {
+        mask.setTo(0);
+        return;
+    }
+
+    filter(frame, mask, erode_px, dilate_px,
+           [&l, &h](const uint8_t *row, uint8_t *t, const int w) {
+               passRow<CH>(reinterpret_cast<const T *>(row), t, w, l, h);
+           });
+}
+
+void PassbandThreshold::applyPlanar(const cv::Mat &planar,
+                                    cv::Mat &mask,
+                                    const int lo[],
+                                    const int hi[],
+                                    const int erode_px,
+                                    const int dilate_px)
+{
+    if (planar.type() != CV_8UC1 || planar.rows % 3 != 0)
+        throw std::runtime_error("Planar passband threshold requires three "
+                                 "stacked 8 bit channel planes.");
+
+    // Rows of the first plane stand for the frame. Its other planes lie a
+    // fixed distance beyond.
+    const int rows = planar.rows / 3;
+    const cv::Mat first = planar.rowRange(0, rows);
+    mask.create(rows, planar.cols, CV_8UC1);
+    if (rows == 0 || planar.cols == 0)
+        return;
+
+    bool none = false;
+    uint8_t l[3], h[3];
+    for (int c = 0; c < 3; c++) {
+        none |= lo[c] > 255 || lo[c] > hi[c] || hi[c] < 0;
+        l[c] = static_cast<uint8_t>(std::max(0, std::min(255, lo[c])));
+        h[c] = static_cast<uint8_t>(std::max(0, std::min(255, hi[c])));
+    }
+
+    if (none) {
+        mask.setTo(0);
+        return;
+    }
+
+    const size_t plane_bytes = static_cast<size_t>(rows) * planar.step[0];
+    filter(first, mask, erode_px, dilate_px,
+           [&l, &h, plane_bytes](const uint8_t *row, uint8_t *t, const int w) {
+               const uint8_t *p[3] {
+                   row, row + plane_bytes, row + 2 * plane_bytes};
+               passPlanarRow(p, t, w, l, h);
+           });
+}
+
+void PassbandThreshold::apply(const cv::Mat &frame,
+                              cv::Mat &mask,
+                              const HSVTable &table,
+                              const int erode_px,
+                              const int dilate_px)
+{
+    if (frame.type() != cv_type(PIX_BGR))
+        throw std::runtime_error("HSV table threshold requires a "
+                                 + color_str(PIX_BGR) + " frame.");
+
+    mask.create(frame.rows, frame.cols, CV_8UC1);
+    if (frame.rows == 0 || frame.cols == 0)
+        return;
+
+    filter(frame, mask, erode_px, dilate_px,
+           [&table](const uint8_t *p, uint8_t *t, const int w) {
+               for (int x = 0; x < w; x++)
+                   t[x] = table.passes(p + 3 * x);
+           });
+}
+
+void PassbandThreshold::classify(const cv::Mat &frame,
+                                 cv::Mat &labels,
+                                 const HSVLabelTable &table)
+{
+    if (frame.type() != cv_type(PIX_BGR))
+        throw std::runtime_error("HSV label table classification requires a "
+                                 + color_str(PIX_BGR) + " frame.");
+
+    classifyRows(frame, labels,
+                 [&table](const uint8_t *p, uint8_t *l, const int w) {
+                     for (int x = 0; x < w; x++)
+                         l[x] = table.labels(p + 3 * x);
+                 });
+}
+
+void PassbandThreshold::classify(const cv::Mat &frame,
+                                 cv::Mat &labels,
+                                 const std::vector<int> &lo,
+                                 const std::vector<int> &hi)
+{
+    if (frame.type() != cv_type(PIX_HSV))
+        throw std::runtime_error("HSV classification requires a "
+                                 + color_str(PIX_HSV) + " frame.");
+
+    if (lo.size() != hi.size() || lo.size() % 3 != 0
+        || lo.size() / 3 > HSVLabelTable::MAX_BANDS)
+        throw std::runtime_error("HSV classification takes up to "
+                                 + std::to_string(HSVLabelTable::MAX_BANDS)
+                                 + " sets of H, S and V passbands.");
+
+    // Passbands as bytes, as for apply(). Bands that pass nothing are
+    // dropped.
+    uint8_t l[3 * HSVLabelTable::MAX_BANDS], h[3 * HSVLabelTable::MAX_BANDS];
+    uint8_t bit[HSVLabelTable::MAX_BANDS];
+    size_t n = 0;
+    for (size_t k = 0; k < lo.size() / 3; k++) {
+
+        bool none = false;
+        for (int c = 0; c < 3; c++) {
+            const int a = lo[3 * k + c], b = hi[3 * k + c];
+            none |= a > 255 || a > b || b < 0;
+            l[3 * n + c] = static_cast<uint8_t>(std::max(0, std::min(255, a)));
+            h[3 * n + c] = static_cast<uint8_t>(std::max(0, std::min(255, b)));
+        }
+
+        if (!none)
+            bit[n++] = static_cast<uint8_t>(1 << k);
+    }
+
+    classifyRows(frame, labels,
+                 [&l, &h, &bit, n](const uint8_t *p, uint8_t *out, const int w) {
+                     std::fill(out, out + w, 0);
+                     for (size_t k = 0; k < n; k++) {
+                         const uint8_t *lk = l + 3 * k, *hk = h + 3 * k;
+                         const uint8_t b = bit[k];
+                         for (int x = 0; x < w; x++)
+                             out[x] |= passes<3>(p + 3 * x, lk, hk) * b;
+                     }
+                 });
+}
+
+template <typename Label>
+void PassbandThreshold::classifyRows(const cv::Mat &frame,
+                                     cv::Mat &labels,
+                                     const Label &label)
+{
+    const int rows = frame.rows;
+    const int w = frame.cols;
+    labels.create(rows, w, CV_8UC1);
+    if (rows == 0 || w == 0)
+        return;
+
+    const int band_rows = std::max<int>(MIN_BAND_ROWS, BAND_BYTES / (4 * w));
+    const int bands = (rows + band_rows - 1) / band_rows;
+
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+        for (int band = range.start; band < range.end; band++) {
+            const int y1 = std::min(rows, (band + 1) * band_rows);
+            for (int y = band * band_rows; y < y1; y++)
+                label(frame.ptr<uint8_t>(y), labels.ptr<uint8_t>(y), w);
+        }
+    });
+}
+
+void PassbandThreshold::applyBand(const cv::Mat &labels,
+                                  cv::Mat &mask,
+                                  const int band,
+                                  const int erode_px,
+                                  const int dilate_px)
+{
+    if (labels.type() != CV_8UC1)
+        throw std::runtime_error("Band filtering requires a frame of labels.");
+
+    mask.create(labels.rows, labels.cols, CV_8UC1);
+    if (labels.rows == 0 || labels.cols == 0)
+        return;
+
+    const int shift = band;
+    filter(labels, mask, erode_px, dilate_px,
+           [shift](const uint8_t *p, uint8_t *t, const int w) {
+               for (int x = 0; x < w; x++)
+                   t[x] = (p[x] >> shift) & 1;
+           });
+}
+
+template <typename Pass>
+void PassbandThreshold::filter(const cv::Mat &frame,
+                               cv::Mat &mask,
+                               const int erode_px,
+                               const int dilate_px,
+                               const Pass &pass)
+{
+    const int rows = frame.rows;
+    const int w = frame.cols;
+    const Extent ke(erode_px), kd(dilate_px);
+
+    const int band_rows = std::max<int>(MIN_BAND_ROWS, BAND_BYTES / (4 * w));
+    const int bands = (rows + band_rows - 1) / band_rows;
+    if (scratch_.size() < static_cast<size_t>(bands))
+        scratch_.resize(bands);
+
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+
+        for (int band = range.start; band < range.end; band++) {
+
+            Scratch &s = scratch_[band];
+
+            // Output rows, rows of the eroded image they depend on, and rows
+            // of the threshold image those depend on, all clipped
+            const int d0 = band * band_rows;
+            const int d1 = std::min(rows, d0 + band_rows);
+            const int e0 = std::max(0, d0 - kd.anchor);
+            const int e1 = std::min(rows, d1 - kd.anchor + kd.size - 1);
+            const int t0 = std::max(0, e0 - ke.anchor);
+            const int t1 = std::min(rows, e1 - ke.anchor + ke.size - 1);
+
+            s.eroded_h.resize(static_cast<size_t>(t1 - t0) * w);
+            s.dilated_h.resize(static_cast<size_t>(e1 - e0) * w);
+            s.row.resize(w);
+            s.prefix.resize(w + 1);
+            s.count.resize(w);
+
+            // Threshold and erode horizontally
+            for (int y = t0; y < t1; y++) {
+                uint8_t *t = s.row.data();
+                pass(frame.ptr<uint8_t>(y), t, w);
+                erodeRow(t,
+                         s.eroded_h.data() + static_cast<size_t>(y - t0) * w,
+                         w, ke, s.prefix.data());
+            }
+
+            // Erode vertically, then dilate horizontally
+            ColumnWindow zeros(s.eroded_h.data(), t0, w, s.count.data(), true);
+            for (int y = e0; y < e1; y++) {
+                zeros.moveTo(std::max(0, y - ke.anchor),
+                             std::min(rows, y - ke.anchor + ke.size));
+                uint8_t *e = s.row.data();
+                for (int x = 0; x < w; x++)
+                    e[x] = s.count[x] == 0;
+                dilateRow(e,
+                          s.dilated_h.data() + static_cast<size_t>(y - e0) * w,
+                          w, kd, s.prefix.data());
+            }
+
+            // Dilate vertically into the mask
+            ColumnWindow ones(s.dilated_h.data(), e0, w, s.count.data(), false);
+            for (int y = d0; y < d1; y++) {
+                ones.moveTo(std::max(0, y - kd.anchor),
+                            std::min(rows, y - kd.anchor + kd.size));
+                uint8_t *m = mask.ptr<uint8_t>(y);
+                for (int x = 0; x < w; x++)
+                    m[x] = s.count[x] ? 255 : 0;
+            }
+        }
+    });
+}
+
+// Compiled kernels
+template void PassbandThreshold::apply<PIX_GREY>(
+    const cv::Mat &, cv::Mat &, const int[], const int[], const int, const int);
+template void PassbandThreshold::apply<PIX_BGR>(
+    const cv::Mat &, cv::Mat &, const int[], const int[], const int, const int);
+template void PassbandThreshold::apply<PIX_HSV>(
+    const cv::Mat &, cv::Mat &, const int[], const int[], const int, const int);
+template void PassbandThreshold::apply<PIX_GREY16>(
+    const cv::Mat &, cv::Mat &, const int[], const int[], const int, const int);
+
+} /* namespace oat */
@@ -0,0 +1,244 @@
+//******************************************************************************
+//* File:   PassbandThreshold.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_PASSBANDTHRESHOLD_H
+#define	OAT_PASSBANDTHRESHOLD_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/datatypes/Color.h"
+
+namespace oat {
+
+/**
+ * @brief Membership of BGR colors in a set of HSV passbands, so that BGR frames
+ * can be thresholded in HSV without converting them. Each channel is quantized
+ * to QUANT_BITS bits and a color passes if the HSV value of the centre of its
+ * cell does. One bit is stored per cell, so the table stays in cache.
+ */
+class HSVTable {
+
+public:
+
+    static constexpr int QUANT_BITS {6};
+
+    /**
+     * @brief Rebuild the table if the passbands differ from those it was last
+     * built with.
+     * @param lo Lower bound of the H, S and V passbands, inclusive.
+     * @param hi Upper bound of the H, S and V passbands, inclusive.
+     */
+    void update(const int lo[], const int hi[]);
+
+    /**
+     * @brief 1 if the BGR pixel px lies within the passbands, 0 otherwise.
+     */
+    uint8_t passes(const uint8_t *px) const
+    {
+        constexpr int SHIFT = 8 - QUANT_BITS;
+        const uint32_t i = (px[0] >> SHIFT) << (2 * QUANT_BITS)
+                         | (px[1] >> SHIFT) << QUANT_BITS
+                         | (px[2] >> SHIFT);
+        return (bits_[i >> 3] >> (i & 7)) & 1;
+    }
+
+private:
+
+    std::vector<uint8_t> bits_;
+    int lo_[3] {-1, -1, -1}, hi_[3] {-1, -1, -1};
+};
+
+/**
+ * @brief Membership of BGR colors in up to MAX_BANDS sets of HSV passbands,
+ * so that a BGR frame can be classified into every band in a single pass.
+ * Cells are quantized as for HSVTable but hold a byte, one bit per band.
+ */
+class HSVLabelTable {
+
+public:
+
+    static constexpr int QUANT_BITS {HSVTable::QUANT_BITS};
+    static constexpr size_t MAX_BANDS {8};
+
+    /**
+     * @brief Rebuild the table if the passbands differ from those it was last
+     * built with.
+     * @param lo Lower bounds of the H, S and V passbands of each band, three
+     * per band, inclusive.
+     * @param hi Upper bounds, as lo.
+     */
+    void update(const std::vector<int> &lo, const std::vector<int> &hi);
+
+    /**
+     * @brief Bit k is set if the BGR pixel px lies within band k.
+     */
+    uint8_t labels(const uint8_t *px) const
+    {
+        constexpr int SHIFT = 8 - QUANT_BITS;
+        const uint32_t i = (px[0] >> SHIFT) << (2 * QUANT_BITS)
+                         | (px[1] >> SHIFT) << QUANT_BITS
+                         | (px[2] >> SHIFT);
+        return labels_[i];
+    }
+
+private:
+
+    std::vector<uint8_t> labels_;
+    std::vector<int> lo_, hi_;
+};
+
+/**
+ * @brief Fused per-channel passband threshold, erosion and dilation.
+ * Produces the same mask as cv::inRange followed by cv::erode and cv::dilate
+ * with rectangular kernels and default anchors and borders, but does so in a
+ * single pass over the image: bands of rows are thresholded and filtered
+ * while they are still in cache, and bands are processed in parallel. The
+ * kernel is compiled separately for each pixel color, so the channel loop is
+ * unrolled. Scratch space is kept between frames.
+ */
+class PassbandThreshold {
+
+public:
+
+    /**
+     * @brief Threshold and filter a frame.
+     * @tparam COLOR Pixel color of the frame. Must not be PIX_BINARY.
+     * @param frame Frame of type cv_type(COLOR).
+     * @param mask CV_8UC1 output. 255 where a pixel passes, 0 elsewhere.
+     * @param lo Lower bound of each channel's passband, inclusive.
+     * @param hi Upper bound of each channel's passband, inclusive.
+     * @param erode_px Erode kernel size. 0 to skip erosion.
+     * @param dilate_px Dilate kernel size. 0 to skip dilation.
+     */
+    template <PixelColor COLOR>
+    void apply(const cv::Mat &frame,
+               cv::Mat &mask,
+               const int lo[],
+               const int hi[],
+               const int erode_px,
+               const int dilate_px);
+
+    /**
+     * @brief Threshold and filter a frame held as channel planes. Each plane
+     * is read in turn, so no pixel is deinterleaved.
+     * @param planar CV_8UC1 matrix of three 8 bit channel planes, stacked
+     * as by the PLANAR frame plane.
+     * @param mask CV_8UC1 output of a third of planar's rows. 255 where a
+     * pixel passes, 0 elsewhere.
+     * @param lo Lower bound of each channel's passband, inclusive.
+     * @param hi Upper bound of each channel's passband, inclusive.
+     * @param erode_px Erode kernel size. 0 to skip erosion.
+     * @param dilate_px Dilate kernel size. 0 to skip dilation.
+     */
+    void applyPlanar(const cv::Mat &planar,
+                     cv::Mat &mask,
+                     const int lo[],
+                     const int hi[],
+                     const int erode_px,
+                     const int dilate_px);
+
+    /**
+     * @brief Threshold and filter a BGR frame using HSV passbands.
+     * @param frame Frame of type cv_type(PIX_BGR).
+     * @param mask CV_8UC1 output. 255 where a pixel passes, 0 elsewhere.
+     * @param table HSV passbands of each BGR color.
+     * @param erode_px Erode kernel size. 0 to skip erosion.
+     * @param dilate_px Dilate kernel size. 0 to skip dilation.
+     */
+    void apply(const cv::Mat &frame,
+               cv::Mat &mask,
+               const HSVTable &table,
+               const int erode_px,
+               const int dilate_px);
+
+    /**
+     * @brief Classify every pixel of a BGR frame into HSV bands.
+     * @param frame Frame of type cv_type(PIX_BGR).
+     * @param labels CV_8UC1 output. Bit k is set where a pixel lies in band k.
+     * @param table HSV passbands of each band.
+     */
+    void classify(const cv::Mat &frame,
+                  cv::Mat &labels,
+                  const HSVLabelTable &table);
+
+    /**
+     * @brief Classify every pixel of an HSV frame into bands.
+     * @param frame Frame of type cv_type(PIX_HSV).
+     * @param labels CV_8UC1 output. Bit k is set where a pixel lies in band k.
+     * @param lo Lower bounds of the H, S and V passbands of each band, three
+     * per band, inclusive. At most HSVLabelTable::MAX_BANDS bands.
+     * @param hi Upper bounds, as lo.
+     */
+    void classify(const cv::Mat &frame,
+                  cv::Mat &labels,
+                  const std::vector<int> &lo,
+                  const std::vector<int> &hi);
+
+    /**
+     * @brief Filter one band of a frame of labels made by classify(). Only a
+     * byte per pixel is read, so each band costs a fraction of thresholding
+     * the frame again.
+     * @param labels CV_8UC1 labels.
+     * @param mask CV_8UC1 output. 255 where a pixel lies in the band, 0
+     * elsewhere.
+     * @param band Band to filter.
+     * @param erode_px Erode kernel size. 0 to skip erosion.
+     * @param dilate_px Dilate kernel size. 0 to skip dilation.
+     */
+    void applyBand(const cv::Mat &labels,
+                   cv::Mat &mask,
+                   const int band,
+                   const int erode_px,
+                   const int dilate_px);
+
+private:
+
+    // Classify the rows of frame into labels, label(row, out, cols) setting
+    // out[x] for each pixel of a row, in parallel bands of rows
+    template <typename Label>
+    void classifyRows(const cv::Mat &frame,
+                      cv::Mat &labels,
+                      const Label &label);
+
+    // Scratch space of a single band
+    struct Scratch {
+        std::vector<uint8_t> eroded_h;  // Threshold, eroded horizontally
+        std::vector<uint8_t> dilated_h; // Fully eroded, dilated horizontally
+        std::vector<uint8_t> row;
+        std::vector<uint32_t> prefix;
+        std::vector<uint32_t> count;
+    };
+
+    std::vector<Scratch> scratch_;
+
+    // Filter the mask produced by pass(row, out, cols), which must set out[x]
+    // to 1 for each passing pixel of the row and to 0 otherwise
+    template <typename Pass>
+    void filter(const cv::Mat &frame,
+                cv::Mat &mask,
+                const int erode_px,
+                const int dilate_px,
+                const Pass &pass);
+};
+
+}       /* namespace oat */
+#endif	/* OAT_PASSBANDTHRESHOLD_H */
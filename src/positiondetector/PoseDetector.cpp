@@ -0,0 +1,347 @@
+//******************************************************************************
+//* File:   PoseDetector.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#include "PoseDetector.h"
+
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+#include <opencv2/core.hpp>
+
+#include "../../lib/base/Profiler.h"
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
+
+namespace oat {
+
+PoseDetector::PoseDetector(const std::string &frame_source_address,
+                           const std::string &position_sink_address)
+: PositionDetector(frame_source_address, position_sink_address)
+, source_addresses_{frame_source_address}
+, sink_addresses_{position_sink_address}
+{
+    // Networks take colour frames, whose channel order is set by swap-rb
+    required_color_ = PIX_BGR;
+}
+
+po::options_description PoseDetector::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("model,m", po::value<std::string>(),
+         "Path to a pose estimation network readable by cv::dnn::readNet, "
+         "e.g. an ONNX file. Its output must be a heatmap per keypoint, "
+         "i.e. of shape batch x keypoints x rows x cols, with up to 64 "
+         "keypoints.")
+        ("model-config", po::value<std::string>(),
+         "Path to the network's configuration file, for frameworks that "
+         "keep it separate from the weights, e.g. Caffe or Darknet.")
+        ("input-size,i", po::value<std::string>(),
+         "Array of ints, [cols,rows], specifying the input size of the "
+         "network. Frames are resized to it.")
+        ("scale", po::value<double>(),
+         "Factor by which pixel values are multiplied, after mean "
+         "subtraction, to form the network input. Defaults to 1/255.")
+        ("mean", po::value<std::string>(),
+         "Array of floats, [b,g,r], subtracted from pixel values to form the "
+         "network input. Defaults to [0,0,0].")
+        ("swap-rb",
+         "If true, feed the network RGB rather than BGR frames.")
+        ("threshold,t", po::value<double>(),
+         "Heatmap peak value below which a keypoint is invalid. Defaults to "
+         "0.1.")
+        ("batch", po::value<std::string>(),
+         "Array of further SOURCE and SINK names, "
+         "e.g. '[\"raw1\",\"kps1\",\"raw2\",\"kps2\"]', for other cameras "
+         "whose frames are batched with SOURCE's into each inference. Every "
+         "SOURCE must run at the same rate. Defaults to none.")
+        ("backend", po::value<std::string>(),
+         "Inference backend: 'cpu', 'cuda' or 'cuda-fp16'. The CUDA "
+         "backends require OpenCV 4.2 or later built with CUDA and cuDNN. "
+         "Defaults to 'cuda' if OpenCV has CUDA support and 'cpu' "
+         "otherwise.")
+#ifdef HAVE_CUDA
+        ("gpu-index", po::value<size_t>(),
+         "Index of GPU card to use with the CUDA backends.")
+#endif
+        ;
+
+    return local_opts;
+}
+
+void PoseDetector::applyConfiguration(const po::variables_map &vm,
+                                      const config::OptionTable &config_table)
+{
+    // Other cameras
+    std::vector<std::string> batch;
+    if (oat::config::getArray(vm, config_table, "batch", batch)) {
+
+        if (batch.size() % 2 != 0)
+            throw std::runtime_error("batch must hold a SINK for every "
+                                     "SOURCE.");
+
+        for (size_t i = 0; i < batch.size(); i += 2) {
+            source_addresses_.push_back(batch[i]);
+            sink_addresses_.push_back(batch[i + 1]);
+        }
+
+        auto sources = source_addresses_;
+        oat::config::checkForDuplicateSources(sources);
+    }
+
+    // Network
+    std::string model, model_config;
+    oat::config::getValue<std::string>(vm, config_table, "model", model, true);
+    oat::config::getValue<std::string>(
+        vm, config_table, "model-config", model_config);
+    net_ = cv::dnn::readNet(model, model_config);
+    if (net_.empty())
+        throw std::runtime_error("Could not load network from " + model + ".");
+
+    // Input
+    std::vector<int> size;
+    oat::config::getArray<int, 2>(vm, config_table, "input-size", size, true);
+    if (size[0] < 1 || size[1] < 1)
+        throw std::runtime_error("input-size must be positive.");
+    input_size_ = cv::Size(size[0], size[1]);
+
+    oat::config::getNumericValue<double>(vm, config_table, "scale", scale_);
+
+    std::vector<double> mean;
+    if (oat::config::getArray<double, 3>(vm, config_table, "mean", mean))
+        mean_ = cv::Scalar(mean[0], mean[1], mean[2]);
+
+    oat::config::getValue<bool>(vm, config_table, "swap-rb", swap_rb_);
+
+    // Keypoint validity
+    oat::config::getNumericValue<double>(
+        vm, config_table, "threshold", threshold_);
+
+    // Backend
+#ifdef HAVE_CUDA
+    std::string backend {"cuda"};
+#else
+    std::string backend {"cpu"};
+#endif
+    oat::config::getValue<std::string>(vm, config_table, "backend", backend);
+
+    if (backend == "cpu") {
+        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    } else if (backend == "cuda" || backend == "cuda-fp16") {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 2)
+        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+        net_.setPreferableTarget(backend == "cuda"
+                                 ? cv::dnn::DNN_TARGET_CUDA
+                                 : cv::dnn::DNN_TARGET_CUDA_FP16);
+        use_cuda_ = true;
+#else
+        throw std::runtime_error("The CUDA backends require OpenCV 4.2 or "
+                                 "later.");
+#endif
+    } else {
+        throw std::runtime_error("Unknown backend: " + backend + ".");
+    }
+
+#ifdef HAVE_CUDA
+    if (use_cuda_) {
+        size_t index = 0;
+        oat::config::getNumericValue<size_t>(
+            vm, config_table, "gpu-index", index, 0);
+        if (index >= static_cast<size_t>(cv::cuda::getCudaEnabledDeviceCount()))
+            throw std::runtime_error("Selected GPU index is invalid.");
+        cv::cuda::setDevice(index);
+    }
+#endif
+}
+
+bool PoseDetector::connectToNode()
+{
+    for (const auto &addr : source_addresses_)
+        frame_sources_.push_back(oat::NamedSource<oat::Frame>(
+            addr, oat::make_unique<oat::Source<oat::Frame>>()));
+
+    // Establish our slot in each node
+    for (auto &fs : frame_sources_)
+        fs.source->touch(fs.name);
+
+    // Wait for synchronous start with sink when it binds each node
+    for (auto &fs : frame_sources_) {
+
+        if (fs.source->connect() != SourceState::CONNECTED)
+            return false;
+
+        const auto in = fs.source->parameters();
+        if (in.color != required_color_)
+            throw std::runtime_error("Component requires frame sources "
+                                     "with pixels of type "
+                                     + oat::color_str(required_color_)
+                                     + ". Maybe use oat-framefilt col?");
+
+        frame_sizes_.emplace_back(in.cols, in.rows);
+    }
+
+    // Bind to each sink node and create a shared keypoint array
+    for (const auto &addr : sink_addresses_) {
+        keypoint_sinks_.push_back(
+            oat::make_unique<oat::Sink<oat::PositionArray>>());
+        keypoint_sinks_.back()->bind(addr);
+    }
+
+    keypoints_.resize(sink_addresses_.size());
+    frames_.resize(frame_sources_.size());
+
+    // Batched input, which blobFromImages() fills in place from now on
+    const int shape[] {static_cast<int>(frame_sources_.size()),
+                       3,
+                       input_size_.height,
+                       input_size_.width};
+#ifdef HAVE_CUDA
+    if (use_cuda_) {
+        pinned_blob_.create(1,
+                            shape[0] * shape[1] * shape[2] * shape[3],
+                            CV_32F);
+        blob_ = cv::Mat(4, shape, CV_32F, pinned_blob_.data);
+        return true;
+    }
+#endif
+
+    blob_.create(4, shape, CV_32F);
+
+    return true;
+}
+
+int PoseDetector::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for every camera's sink to write to its node
+    OAT_PHASE(WAIT_SOURCE);
+    for (size_t i = 0; i < frame_sources_.size(); i++) {
+
+        auto &source = *frame_sources_[i].source;
+        if (source.wait() == oat::NodeState::END)
+            return 1;
+
+        const auto &frame = source.borrow();
+        frames_[i] = frame;
+        keypoints_[i].set_sample(frame.sample());
+    }
+
+    // Resize and normalize the shared frames straight into the batch
+    OAT_PHASE(COPY_IN);
+    cv::dnn::blobFromImages(
+        frames_, blob_, scale_, input_size_, mean_, swap_rb_, false);
+
+    // Tell sinks they can continue
+    OAT_PHASE(PUBLISH);
+    for (auto &fs : frame_sources_)
+        fs.source->post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // One inference for every camera
+    OAT_PHASE(COMPUTE);
+    net_.setInput(blob_);
+    net_.forward(heatmaps_);
+
+    if (heatmaps_.dims != 4
+        || heatmaps_.size[0] != static_cast<int>(frames_.size())
+        || heatmaps_.size[1] > static_cast<int>(oat::PositionArray::CAPACITY))
+        throw std::runtime_error("Network output must be a batch of at most "
+                                 + std::to_string(oat::PositionArray::CAPACITY)
+                                 + " keypoint heatmaps per frame.");
+
+    for (size_t i = 0; i < keypoints_.size(); i++)
+        decode(static_cast<int>(i), frame_sizes_[i], keypoints_[i]);
+
+    for (size_t i = 0; i < keypoint_sinks_.size(); i++) {
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+
+        // Wait for sources to read
+        OAT_PHASE(WAIT_SINK);
+        keypoint_sinks_[i]->wait();
+
+        OAT_PHASE(COPY_OUT);
+        *keypoint_sinks_[i]->retrieve() = keypoints_[i];
+
+        // Tell sources there is new data
+        OAT_PHASE(PUBLISH);
+        keypoint_sinks_[i]->post();
+
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+    }
+
+    // Sink was not at END state
+    return 0;
+}
+
+void PoseDetector::decode(const int camera,
+                          const cv::Size &frame_size,
+                          oat::PositionArray &keypoints) const
+{
+    const int num_keypoints = heatmaps_.size[1];
+    const int rows = heatmaps_.size[2];
+    const int cols = heatmaps_.size[3];
+    const double sx = static_cast<double>(frame_size.width) / cols;
+    const double sy = static_cast<double>(frame_size.height) / rows;
+
+    keypoints.clear();
+    for (int k = 0; k < num_keypoints; k++) {
+
+        const cv::Mat map(rows, cols, CV_32F,
+                          const_cast<float *>(heatmaps_.ptr<float>(camera, k)));
+
+        double peak;
+        cv::Point p;
+        cv::minMaxLoc(map, nullptr, &peak, nullptr, &p);
+
+        // Sub-pixel peak from a parabola through the peak's neighbours
+        double dx = 0, dy = 0;
+        if (p.x > 0 && p.x < cols - 1) {
+            const double l = map.at<float>(p.y, p.x - 1);
+            const double r = map.at<float>(p.y, p.x + 1);
+            const double d = l - 2 * peak + r;
+            dx = d < 0 ? 0.5 * (l - r) / d : 0;
+        }
+        if (p.y > 0 && p.y < rows - 1) {
+            const double u = map.at<float>(p.y - 1, p.x);
+            const double b = map.at<float>(p.y + 1, p.x);
+            const double d = u - 2 * peak + b;
+            dy = d < 0 ? 0.5 * (u - b) / d : 0;
+        }
+
+        // Heatmap cell centres to frame pixel centres. Keypoints keep their
+        // index, invalid or not.
+        keypoints.push((p.x + dx + 0.5) * sx - 0.5,
+                       (p.y + dy + 0.5) * sy - 0.5,
+                       peak);
+        keypoints.valid[k] = peak >= threshold_;
+    }
+}
+
+} /* namespace oat */
@@ -0,0 +1,117 @@
+//******************************************************************************
+//* File:   PoseDetector.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#ifndef OAT_POSEDETECTOR_H
+#define	OAT_POSEDETECTOR_H
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/dnn.hpp>
+
+#ifdef HAVE_CUDA
+ #include <opencv2/core/cuda.hpp>
+#endif
+
+#include "../../lib/datatypes/PositionArray.h"
+#include "../../lib/shmemdf/Helpers.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+
+#include "PositionDetector.h"
+
+namespace oat {
+
+class PoseDetector : public PositionDetector {
+public:
+    /**
+     * Keypoint detector that runs a pose estimation network, e.g. one
+     * trained with DeepLabCut or SLEAP and exported to ONNX, on frames from
+     * one or more cameras. Frames from every camera are batched into a
+     * single inference. The keypoints found in each camera's frame are
+     * published to its own SINK as a PositionArray, indexed by keypoint.
+     * @param frame_source_address Frame SOURCE node address of the first
+     * camera
+     * @param position_sink_address Position SINK node address of the first
+     * camera
+     */
+    PoseDetector(const std::string &frame_source_address,
+                 const std::string &position_sink_address);
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Component Interface. Every SOURCE and SINK is handled here rather
+    // than by PositionDetector, which serves a single camera.
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Not used: process() batches frames from every SOURCE
+    void detectPosition(cv::Mat &, oat::Position2D &) override { }
+
+    /**
+     * Find the peak of each keypoint's heatmap in one camera's network
+     * output.
+     * @param camera Index of the camera in the batch
+     * @param frame_size Size of the camera's frame
+     * @param keypoints Keypoint positions, in frame pixels, indexed by
+     * keypoint. The peak value is the keypoint's area.
+     */
+    void decode(const int camera,
+                const cv::Size &frame_size,
+                oat::PositionArray &keypoints) const;
+
+    // Camera SOURCES and SINKS, in batch order
+    std::vector<std::string> source_addresses_;
+    std::vector<std::string> sink_addresses_;
+    oat::NamedSourceList<oat::Frame> frame_sources_;
+    std::vector<std::unique_ptr<oat::Sink<oat::PositionArray>>> keypoint_sinks_;
+    std::vector<oat::PositionArray> keypoints_;
+
+    // Network and input preprocessing
+    cv::dnn::Net net_;
+    cv::Size input_size_;
+    double scale_ {1.0 / 255.0};
+    cv::Scalar mean_;
+    bool swap_rb_ {false};
+    double threshold_ {0.1};
+    bool use_cuda_ {false};
+
+    // Batched network input and output, and the shared frames that make up
+    // the input, which are only borrowed until it is filled
+    std::vector<cv::Mat> frames_;
+    std::vector<cv::Size> frame_sizes_;
+    cv::Mat blob_;
+    cv::Mat heatmaps_;
+
+#ifdef HAVE_CUDA
+    // Page-locked storage of blob_, so that it is uploaded by DMA
+    cv::cuda::HostMem pinned_blob_;
+#endif
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSEDETECTOR_H */
@@ -17,12 +17,22 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
 #include <string>
 #include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
 
+#include "../../lib/base/Profiler.h"
+#include "../../lib/datatypes/PackedMask.h"
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/shmemdf/Source.h"
 #include "../../lib/shmemdf/Sink.h"
+#include "../../lib/utility/TOMLSanitize.h"
 
 #include "PositionDetector.h"
 
@@ -37,65 +47,757 @@ PositionDetector::PositionDetector(const std::string &frame_source_address,
   // Nothing
 }
 
+PositionDetector::~PositionDetector()
+{
+    for (auto &w : worker_pool_) {
+        {
+            std::lock_guard<std::mutex> lock(w->mutex);
+            w->stop = true;
+        }
+        w->cv.notify_one();
+    }
+
+    for (auto &w : worker_pool_)
+        if (w->thread.joinable())
+            w->thread.join();
+}
+
 bool PositionDetector::connectToNode()
 {
     // Establish our a slot in the node
     frame_source_.touch(frame_source_address_);
 
     // Wait for synchronous start with sink when it binds its node
-    if (frame_source_.connect(required_color_) != SourceState::CONNECTED)
+    if (frame_source_.connect() != SourceState::CONNECTED)
         return false;
 
-    // Bind to sink node and create a shared position
-    position_sink_.bind(position_sink_address_, position_sink_address_);
-    shared_position_ = position_sink_.retrieve();
+    // Check frame pixel type
+    auto in = frame_source_.parameters();
+    frame_color_ = in.color;
+    use_plane_ = false;
+    if (frame_color_ != required_color_
+        && std::find(accepted_colors_.begin(),
+                     accepted_colors_.end(),
+                     frame_color_) == accepted_colors_.end()) {
+
+        // Frames converted to the required color by the node itself do
+        // just as well
+        if (oat::plane_of(required_color_, plane_)
+            && frame_source_.hosts(plane_)) {
+            use_plane_ = true;
+            in = frame_source_.planeParameters(plane_);
+            frame_color_ = in.color;
+        } else {
+            throw std::runtime_error("Component requires frame source "
+                                 "with pixels of type "
+                                     + oat::color_str(required_color_)
+                                     + ". Maybe use oat-framefilt col, "
+                                       "or OAT_FRAME_PLANES?");
+        }
+    }
+
+    // Packed masks are not indexed by pixel, so they cannot be cropped or
+    // resampled
+    if (frame_color_ == PIX_MASK
+        && (search_window_px_ > 0 || pyramid_levels_ > 0 || flow_
+            || governor_.enabled()))
+        throw std::runtime_error("MASK frames cannot be detected on with a "
+                                 "search window, pyramid, flow following or "
+                                 "budget.");
 
-    // TODO: check that the pixel color is correct.
+    // Detectors that treat channels separately read them from planes,
+    // without deinterleaving each pixel
+    planar_ = !use_plane_
+              && std::find(planar_colors_.begin(),
+                           planar_colors_.end(),
+                           frame_color_) != planar_colors_.end()
+              && frame_source_.hosts(oat::FramePlane::PLANAR);
+    if (planar_) {
+        use_plane_ = true;
+        plane_ = oat::FramePlane::PLANAR;
+        in = frame_source_.planeParameters(plane_);
+    }
+
+    // Bind to sink node and create a shared position, or object array
+    if (all_objects_) {
+        objects_ = &internal_objects_;
+        objects_sink_.bind(position_sink_address_);
+    } else {
+        objects_ = nullptr;
+        position_sink_.bind(position_sink_address_, position_sink_address_);
+    }
+
+    // Copies of SOURCE frames reuse these buffers from now on
+    if (!zero_copy_)
+        internal_frame_.create(in.rows, in.cols, in.type);
+
+    // Workers fill their own object arrays
+    for (auto &w : worker_pool_) {
+        auto &d = *w->detector;
+        d.objects_ = all_objects_ ? &d.internal_objects_ : nullptr;
+        d.frame_color_ = frame_color_;
+        d.planar_ = planar_;
+        w->frame.create(in.rows, in.cols, in.type);
+    }
 
     return true;
 }
 
+void PositionDetector::siftObjects(cv::Mat &frame,
+                                   oat::Position2D &position,
+                                   double &area,
+                                   double min_area,
+                                   double max_area,
+                                   bool fill_objects)
+{
+    auto objects = fill_objects ? objects_ : nullptr;
+
+    if (frame_color_ == PIX_MASK) {
+
+        // Runs are read from the packed mask, contours from an unpacked copy
+        if (label_components_) {
+            component_sifter_.siftPacked(frame, position, area, min_area,
+                                         max_area, objects, axis_heading_);
+        } else {
+            oat::unpackMask(frame, unpacked_mask_);
+            siftContours(unpacked_mask_, position, area, min_area, max_area,
+                         objects, axis_heading_);
+        }
+
+    } else if (label_components_) {
+        component_sifter_.sift(frame, position, area, min_area, max_area,
+                               objects, axis_heading_);
+    } else {
+        siftContours(frame, position, area, min_area, max_area, objects,
+                     axis_heading_);
+    }
+
+    position.score = position.position_valid ? area : 0.0;
+}
+
+const cv::Mat &PositionDetector::downsample(const cv::Mat &frame)
+{
+    pyramid_.resize(pyramid_levels_);
+
+    // Unaltered frames may have the level published alongside them by a
+    // frameserver, halved as cv::pyrDown would
+    if (reading_source_ && pyramid_levels_ <= MAX_PYRAMID_LEVELS
+        && frame.data == frame_source_.borrow().data
+        && frame.size() == frame_source_.borrow().size()
+        && frame_source_.pyramid_filter() == PyramidFilter::GAUSSIAN) {
+
+        const auto plane = pyramid_plane(pyramid_levels_);
+        if (frame_source_.hosts(plane)) {
+            pyramid_.back() = frame_source_.plane(plane);
+            return pyramid_.back();
+        }
+    }
+
+    cv::pyrDown(frame, pyramid_[0]);
+    for (int i = 1; i < pyramid_levels_; i++)
+        cv::pyrDown(pyramid_[i - 1], pyramid_[i]);
+
+    return pyramid_.back();
+}
+
+void PositionDetector::upsample(oat::Position2D &position, double &area)
+{
+    const double scale = 1 << pyramid_levels_;
+
+    // Coarse pixel centres sit in the middle of the full resolution pixels
+    // they cover
+    auto up = [scale](double c) { return (c + 0.5) * scale - 0.5; };
+
+    if (position.position_valid) {
+        position.position.x = up(position.position.x);
+        position.position.y = up(position.position.y);
+    }
+
+    area *= scale * scale;
+    position.score *= scale * scale;
+
+    if (objects_ != nullptr) {
+        for (size_t i = 0; i < objects_->size(); i++) {
+            objects_->x[i] = up(objects_->x[i]);
+            objects_->y[i] = up(objects_->y[i]);
+            objects_->area[i] *= scale * scale;
+        }
+    }
+}
+
+cv::Rect PositionDetector::refinementWindow(const oat::Position2D &position,
+                                            double area,
+                                            const cv::Size &frame_size) const
+{
+    // Twice the object's diameter, padded by two coarse pixels on each side
+    const int radius = static_cast<int>(std::sqrt(area / PI));
+    const int half = 2 * radius + (2 << pyramid_levels_);
+
+    const cv::Rect window(static_cast<int>(position.position.x) - half,
+                          static_cast<int>(position.position.y) - half,
+                          2 * half + 1,
+                          2 * half + 1);
+
+    return window & cv::Rect(cv::Point(0, 0), frame_size);
+}
+
 int PositionDetector::process()
 {
-    oat::Frame internal_frame;
-    oat::Position2D internal_pos("");
+    if (!worker_pool_.empty())
+        return processWithWorkers();
+
+    // Detectors only set what they find
+    internal_pos_.set_record(oat::PositionRecord());
 
     // START CRITICAL SECTION //
     ////////////////////////////
 
     // Wait for sink to write to node
-    if (frame_source_.wait() == oat::NodeState::END)
+    OAT_PHASE(WAIT_SOURCE);
+    if (waitForFrame() == oat::NodeState::END)
         return 1;
 
-    // Clone the shared frame
-    frame_source_.copyTo(internal_frame);
+    const auto start = std::chrono::steady_clock::now();
+
+    cv::Rect window;
+    bool followed {false};
+
+    if (zero_copy_) {
+
+        // Detect position directly on the shared frame
+        OAT_PHASE(COMPUTE);
+        oat::Frame shared_frame = sourceFrame();
+        reading_source_ = true;
+        followed = detect(shared_frame, window);
+        reading_source_ = false;
+
+    } else {
+
+        // Clone the shared frame, which is detected on right away
+        OAT_PHASE(COPY_IN);
+        sourceFrame().copyTo(internal_frame_, oat::CopyHint::PREFETCH);
+    }
 
     // Tell sink it can continue
+    OAT_PHASE(PUBLISH);
     frame_source_.post();
 
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
     // Propagate sample info and detect position
-    internal_pos.set_sample(internal_frame.sample());
-    detectPosition(internal_frame, internal_pos);
+    OAT_PHASE(COMPUTE);
+    if (!zero_copy_)
+        followed = detect(internal_frame_, window);
+
+    track(window, internal_pos_);
+    orient(internal_pos_);
+
+    // Lock on to a newly detected object
+    if (flow_ && !followed && internal_pos_.position_valid) {
+        flow_score_ = internal_pos_.score;
+        flow_->acquire(internal_pos_.position, flow_score_);
+    }
+
+    // Downstream readers are not this detector's time
+    if (governor_.enabled()) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (governor_.record(ns))
+            degrade(governor_.level());
+    }
+
+    publish(internal_pos_);
+
+    // Sink was not at END state
+    return 0;
+}
+
+bool PositionDetector::detect(oat::Frame &frame, cv::Rect &window)
+{
+    internal_pos_.set_sample(frame.sample());
+
+    // Follow an object that is locked on, unless a detection is due
+    if (flow_ && flow_->locked()
+        && (flow_refresh_ == 0 || flow_frames_ < flow_refresh_)
+        && flow_->follow(frame, frame_color_, internal_pos_.position)) {
+
+        internal_pos_.position_valid = true;
+        internal_pos_.score = flow_score_;
+        flow_frames_++;
+        window = cv::Rect(cv::Point(0, 0), frame.size());
+
+        return true;
+    }
+
+    // Detection may modify the frame, so features are found on a copy
+    if (flow_) {
+        flow_->prepare(frame, frame_color_);
+        flow_frames_ = 0;
+    }
+
+    window = searchWindow(frame.size());
+    cv::Mat view = frame(window);
+    detectPosition(view, internal_pos_);
+
+    return false;
+}
+
+oat::NodeState PositionDetector::waitForFrame()
+{
+    auto state = frame_source_.wait();
+
+    // Only frames that the sink has already written to its ring can be
+    // skipped to, so with a single buffer every frame is processed. Each
+    // skipped frame is read, and so releases the sink, as usual.
+    while (state != oat::NodeState::END) {
+
+        const auto sample = frame_source_.borrow().sample();
+        const bool ours = sample.count() % shards_ == shard_;
+        if (ours && (deadline_.count() == 0
+                     || frame_source_.latest().sample().microseconds()
+                        - sample.microseconds() <= deadline_))
+            break;
+
+        frame_source_.post();
+        state = frame_source_.wait();
+    }
+
+    return state;
+}
 
+oat::Frame PositionDetector::sourceFrame() const
+{
+    if (use_plane_)
+        return frame_source_.plane(plane_);
+
+    return frame_source_.borrow();
+}
+
+void PositionDetector::publish(const oat::Position2D &position)
+{
     // START CRITICAL SECTION //
     ////////////////////////////
 
-    // Wait for sources to read
-    position_sink_.wait();
+    if (objects_ != nullptr) {
+
+        internal_objects_.set_sample(position.sample());
 
-    *shared_position_ = internal_pos;
+        // Wait for sources to read. Shards drop positions that other shards
+        // have overtaken.
+        OAT_PHASE(WAIT_SINK);
+        if (!objects_sink_.wait(internal_objects_.sample().count()))
+            return;
 
-    // Tell sources there is new data
-    position_sink_.post();
+        OAT_PHASE(COPY_OUT);
+        *objects_sink_.retrieve() = internal_objects_;
+
+        // Tell sources there is new data
+        OAT_PHASE(PUBLISH);
+        objects_sink_.post();
+
+    } else {
+
+        // Wait for sources to read
+        OAT_PHASE(WAIT_SINK);
+        if (!position_sink_.wait(position.sample().count()))
+            return;
+
+        OAT_PHASE(COPY_OUT);
+        position_sink_.write(position);
+
+        // Tell sources there is new data
+        OAT_PHASE(PUBLISH);
+        position_sink_.post();
+    }
 
     ////////////////////////////
     //  END CRITICAL SECTION  //
+}
+
+int PositionDetector::processWithWorkers()
+{
+    // Every worker is busy, so wait for the oldest
+    if (in_flight_.size() == worker_pool_.size()) {
+        publishWorker(*in_flight_.front());
+        in_flight_.pop_front();
+    }
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    if (waitForFrame() == oat::NodeState::END) {
+
+        // Flush frames still being worked on
+        for (auto w : in_flight_)
+            publishWorker(*w);
+        in_flight_.clear();
+
+        return 1;
+    }
+
+    // The oldest frame was published last, so the next worker in turn is
+    // free
+    auto &w = *worker_pool_[next_worker_];
+    next_worker_ = (next_worker_ + 1) % worker_pool_.size();
+
+    sourceFrame().copyTo(w.frame);
+
+    // Tell sink it can continue
+    frame_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.busy = true;
+        w.done = false;
+    }
+    w.cv.notify_one();
+    in_flight_.push_back(&w);
+
+    // Publish whatever has finished, in order
+    while (!in_flight_.empty()) {
+
+        auto oldest = in_flight_.front();
+        {
+            std::lock_guard<std::mutex> lock(oldest->mutex);
+            if (!oldest->done)
+                break;
+        }
+
+        publishWorker(*oldest);
+        in_flight_.pop_front();
+    }
 
     // Sink was not at END state
     return 0;
 }
 
+void PositionDetector::publishWorker(Worker &w)
+{
+    {
+        std::unique_lock<std::mutex> lock(w.mutex);
+        w.cv.wait(lock, [&w] { return w.done; });
+        w.busy = false;
+    }
+
+    if (w.error)
+        std::rethrow_exception(w.error);
+
+    if (objects_ != nullptr)
+        internal_objects_ = *w.detector->objects_;
+
+    // Workers' frames are oriented in sample order
+    orient(w.position);
+    publish(w.position);
+}
+
+void PositionDetector::workLoop(Worker &w)
+{
+    std::unique_lock<std::mutex> lock(w.mutex);
+
+    while (true) {
+
+        w.cv.wait(lock, [&w] { return w.stop || (w.busy && !w.done); });
+        if (w.stop)
+            return;
+
+        lock.unlock();
+
+        try {
+            w.position.set_record(oat::PositionRecord());
+            w.position.set_sample(w.frame.sample());
+            w.detector->detectPosition(w.frame, w.position);
+        } catch (...) {
+            w.error = std::current_exception();
+        }
+
+        lock.lock();
+        w.done = true;
+        w.cv.notify_all();
+    }
+}
+
+void PositionDetector::applyParameters(const po::variables_map &vm,
+                                       const config::OptionTable &config_table)
+{
+    // Workers must be idle while their parameters change. Frames they hold
+    // are published first, so none are dropped.
+    for (auto w : in_flight_)
+        publishWorker(*w);
+    in_flight_.clear();
+
+    configureDetection(vm, config_table);
+    for (auto &w : worker_pool_)
+        w->detector->configureDetection(vm, config_table);
+}
+
+void PositionDetector::configureDeadline(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    double deadline_ms;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "deadline", deadline_ms, 0.0))
+        deadline_ = std::chrono::duration_cast<oat::Sample::Microseconds>(
+            std::chrono::duration<double, std::milli>(deadline_ms));
+}
+
+void PositionDetector::configureShard(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    std::string shard;
+    if (!oat::config::getValue<std::string>(vm, config_table, "shard", shard))
+        return;
+
+    unsigned long long i, n;
+    char end;
+    if (std::sscanf(shard.c_str(), "%llu/%llu%c", &i, &n, &end) != 2
+        || n == 0 || i >= n)
+        throw std::runtime_error("shard must be given as I/N with I less "
+                                 "than N, e.g. 0/2.");
+
+    shard_ = i;
+    shards_ = n;
+
+    // A shard that is working on its next frame trails by less than two
+    // rounds of shards. Those lagging further have skipped frames.
+    position_sink_.set_merge(2 * shards_);
+    objects_sink_.set_merge(2 * shards_);
+}
+
+void PositionDetector::configureHistory(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    size_t capacity;
+    if (oat::config::getNumericValue<size_t>(
+            vm, config_table, "history", capacity, 0) && capacity > 0)
+        position_sink_.set_history(capacity);
+}
+
+void PositionDetector::configureBus(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    std::string bus;
+    if (oat::config::getValue<std::string>(vm, config_table, "bus", bus))
+        position_sink_.set_bus(bus);
+}
+
+void PositionDetector::configureGovernor(
+    const po::variables_map &vm,
+    const config::OptionTable &config_table,
+    const bool pyramid)
+{
+    double budget_ms {0.0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "budget", budget_ms, 0.0);
+
+    degrade_.clear();
+    if (!oat::config::getArray(vm, config_table, "degrade", degrade_)) {
+        if (pyramid)
+            degrade_.push_back("pyramid");
+        if (search_window_px_ > 0)
+            degrade_.push_back("window");
+    }
+
+    for (const auto &d : degrade_) {
+        if (d == "pyramid" && !pyramid)
+            throw std::runtime_error("This detector cannot degrade its "
+                                     "pyramid.");
+        if (d == "window" && search_window_px_ == 0)
+            throw std::runtime_error("Degrading the window requires a "
+                                     "search-window.");
+        if (d != "pyramid" && d != "window")
+            throw std::runtime_error("Unknown degrade step '" + d + "'. Use "
+                                     "pyramid or window.");
+    }
+
+    base_pyramid_levels_ = pyramid_levels_;
+    base_search_window_px_ = search_window_px_;
+
+    // Each step can be taken twice
+    const auto budget = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double, std::milli>(budget_ms));
+    governor_.configure(budget, 2 * static_cast<int>(degrade_.size()));
+
+    if (governor_.enabled() && workers_ > 1)
+        throw std::runtime_error("A budget cannot be used with multiple "
+                                 "workers.");
+}
+
+void PositionDetector::degrade(const int level)
+{
+    pyramid_levels_ = base_pyramid_levels_;
+    search_window_px_ = base_search_window_px_;
+
+    int remaining = level;
+    for (const auto &d : degrade_) {
+
+        const int steps = std::min(remaining, 2);
+        remaining -= steps;
+
+        if (d == "pyramid")
+            pyramid_levels_ = std::min(base_pyramid_levels_ + steps, 8);
+        else if (d == "window")
+            search_window_px_ = std::max(base_search_window_px_ >> steps, 32);
+    }
+}
+
+void PositionDetector::configureFlow(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    oat::config::getNumericValue<int>(
+        vm, config_table, "flow-window", flow_window_px_, 0);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "flow-features", flow_features_, 1);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "flow-min-features", flow_min_features_, 1);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "flow-refresh", flow_refresh_, 0);
+
+    if (flow_window_px_ == 0)
+        return;
+
+    if (flow_window_px_ < 32)
+        throw std::runtime_error("flow-window must be at least 32 pixels.");
+
+    if (flow_min_features_ > flow_features_)
+        throw std::runtime_error("flow-min-features cannot exceed "
+                                 "flow-features.");
+
+    if (all_objects_)
+        throw std::runtime_error("Optical flow cannot be used with "
+                                 "all-objects.");
+
+    flow_.reset(new FlowTracker(
+        flow_window_px_, flow_features_, flow_min_features_));
+}
+
+void PositionDetector::configureWorkers(const po::variables_map &vm,
+                                        const config::OptionTable &config_table)
+{
+    if (replica_ || workers_ < 2)
+        return;
+
+    if (search_window_px_ > 0)
+        throw std::runtime_error("A search window cannot be used with "
+                                 "multiple workers.");
+
+    if (flow_window_px_ > 0)
+        throw std::runtime_error("Optical flow cannot be used with multiple "
+                                 "workers.");
+
+    for (int i = 0; i < workers_; i++) {
+
+        std::unique_ptr<Worker> w(new Worker);
+        w->detector = replicate();
+        if (!w->detector)
+            throw std::runtime_error("This detector cannot use multiple "
+                                     "workers.");
+
+        w->detector->replica_ = true;
+        w->detector->applyConfiguration(vm, config_table);
+
+        worker_pool_.push_back(std::move(w));
+    }
+
+    for (auto &w : worker_pool_)
+        w->thread = std::thread(&PositionDetector::workLoop, this, std::ref(*w));
+}
+
+cv::Rect PositionDetector::searchWindow(const cv::Size &frame_size) const
+{
+    const cv::Rect full(cv::Point(0, 0), frame_size);
+
+    if (search_window_px_ == 0 || !last_valid_ || misses_ >= search_misses_)
+        return full;
+
+    // Lead the last position by the last displacement, if there is one
+    auto center = last_position_;
+    if (prev_valid_)
+        center += last_position_ - prev_position_;
+
+    const int half = search_window_px_ / 2;
+    cv::Rect window(static_cast<int>(center.x) - half,
+                    static_cast<int>(center.y) - half,
+                    search_window_px_,
+                    search_window_px_);
+
+    // Views of Bayer frames must start on a tile so that they keep its color
+    // order
+    if (oat::is_bayer(frame_color_)) {
+        window.x &= ~1;
+        window.y &= ~1;
+    }
+
+    // Window may poke out of the frame, or miss it entirely if the
+    // prediction is far off
+    auto clipped = window & full;
+    return clipped.area() > 0 ? clipped : full;
+}
+
+void PositionDetector::track(const cv::Rect &window, oat::Position2D &position)
+{
+    // Move results from window to frame coordinates
+    if (window.x != 0 || window.y != 0) {
+
+        if (position.position_valid) {
+            position.position.x += window.x;
+            position.position.y += window.y;
+        }
+
+        if (objects_ != nullptr) {
+            for (size_t i = 0; i < objects_->size(); i++) {
+                objects_->x[i] += window.x;
+                objects_->y[i] += window.y;
+            }
+        }
+    }
+
+    if (search_window_px_ == 0)
+        return;
+
+    if (position.position_valid) {
+        prev_position_ = last_position_;
+        prev_valid_ = last_valid_ && misses_ == 0;
+        last_position_ = position.position;
+        last_valid_ = true;
+        misses_ = 0;
+    } else if (++misses_ >= search_misses_) {
+
+        // Full frame search from here on, with no stale velocity once the
+        // object is found again
+        last_valid_ = prev_valid_ = false;
+    }
+}
+
+void PositionDetector::orient(oat::Position2D &position)
+{
+    if (!axis_heading_ || !position.position_valid)
+        return;
+
+    // Followed frames, and objects too round to have an axis, keep the
+    // last heading as the reference for the next one
+    if (!position.heading_valid)
+        return;
+
+    auto &heading = position.heading;
+    if (axis_valid_) {
+
+        // Animals move head first
+        const auto step = position.position - axis_position_;
+        const double side = step.dot(step) >= AXIS_MIN_STEP_PX * AXIS_MIN_STEP_PX
+                          ? step.dot(heading)
+                          : axis_.dot(heading);
+        if (side < 0)
+            heading = -heading;
+    }
+
+    axis_ = heading;
+    axis_position_ = position.position;
+    axis_valid_ = true;
+}
+
 } /* namespace oat */
@@ -22,25 +22,44 @@
 
 #define OAT_POSIDET_MAX_OBJ_AREA_PIX 100000
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
-#include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
+#include "../../lib/base/Governor.h"
+#include "../../lib/base/ControllableComponent.h"
 #include "../../lib/datatypes/Frame.h"
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/PositionArray.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
 
+#include "DetectorFunc.h"
+#include "FlowTracker.h"
+
 namespace po = boost::program_options;
 
 namespace oat {
 
 // Forward decl.
+class ArenaDetector;
 class SharedFrameHeader;
+namespace fuse { struct Access; }
+
+class PositionDetector : public ControllableComponent, public Configurable<true> {
+
+// Run position detection within arenas and fused chains
+friend ArenaDetector;
+friend fuse::Access;
 
-class PositionDetector : public Component, public Configurable<false> {
 public:
     /**
      * Abstract object position detector.
@@ -50,11 +69,22 @@ public:
      */
     PositionDetector(const std::string &frame_source_address,
                      const std::string &position_sink_address);
-    virtual ~PositionDetector() { }
+    virtual ~PositionDetector();
 
     // Component Interface
     oat::ComponentType type(void) const override { return oat::positiondetector; };
     std::string name(void) const override { return name_; }
+    bool ready(void) const override
+    {
+        return frame_source_.readable() && position_sink_.writable()
+               && objects_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        return {&frame_source_.sample_event(),
+                position_sink_.sample_event(),
+                objects_sink_.sample_event()};
+    }
 
 protected:
     /**
@@ -64,30 +94,353 @@ protected:
      */
     virtual void detectPosition(cv::Mat &frame, oat::Position2D &position) = 0;
 
+    /**
+     * Apply the configuration keys listed by parameters(). Called by
+     * applyConfiguration() and again, on the detector and its workers, when
+     * a parameter is set at runtime.
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    virtual void configureDetection(const po::variables_map &vm,
+                                    const config::OptionTable &config_table) { }
+
     // Detector name
     const std::string name_;
 
     // Explicit frame data type
     oat::PixelColor required_color_ {PIX_BGR};
 
+    // Frame data types that are accepted in place of required_color_, and
+    // the type of the frames actually received, known once connected
+    std::vector<oat::PixelColor> accepted_colors_;
+    oat::PixelColor frame_color_ {PIX_BGR};
+
+    // Set by detectors that do not modify the frame passed to
+    // detectPosition(). Detection is then performed directly on the shared
+    // frame, without a copy, and the frame SOURCE is held until it finishes.
+    bool zero_copy_ {false};
+
+    // Frame colors that the detector can also read as a PLANAR plane hosted
+    // by the SOURCE node, and whether it is, known once connected. The
+    // frame passed to detectPosition() is then the planar matrix.
+    std::vector<oat::PixelColor> planar_colors_;
+    bool planar_ {false};
+
+    // If true, every object passing the detector's gates is published to the
+    // SINK as a PositionArray instead of only the best one as a Position2D
+    bool all_objects_ {false};
+
+    // Points to the array that detectPosition() should fill with every
+    // detected object when all_objects_ is set. Null otherwise.
+    oat::PositionArray *objects_ {nullptr};
+
+    // Side length, in pixels, of the square window searched around the
+    // predicted object position. 0 to always search the full frame.
+    int search_window_px_ {0};
+
+    // Consecutive misses within the search window after which the full
+    // frame is searched again
+    int search_misses_ {5};
+
+    // Side length, in pixels, of the window in which an object, once
+    // detected, is followed by optical flow instead of being detected again.
+    // 0 to detect in every frame.
+    int flow_window_px_ {0};
+
+    // Features followed, and the fewest with which the object is not lost
+    int flow_features_ {20};
+    int flow_min_features_ {5};
+
+    // Most consecutive frames in which the object is followed before it is
+    // detected again. 0 for no limit.
+    int flow_refresh_ {0};
+
+    /**
+     * Set up optical flow following from the flow-* keys. Call from
+     * applyConfiguration(), after all_objects_ is set.
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureFlow(const po::variables_map &vm,
+                       const config::OptionTable &config_table);
+
+    // If true, objects are found by labeling connected components rather
+    // than by tracing contours
+    bool label_components_ {false};
+
+    // If true, the heading of each position is the major axis of the
+    // detected object, pointed along its motion
+    bool axis_heading_ {false};
+
+    /**
+     * Find objects in a binary frame using siftContours() or, if
+     * label_components_ is set, a ComponentSifter. Every object within the
+     * area range is also written to objects_, if it is not null. When
+     * frame_color_ is PIX_MASK, the frame is taken to be a packed mask.
+     * @param frame Binary frame. May be modified.
+     * @param position Position of the largest object
+     * @param area Area of the largest object
+     * @param min_area Minimum object area
+     * @param max_area Maximum object area
+     * @param fill_objects If false, objects_ is left untouched.
+     */
+    void siftObjects(cv::Mat &frame,
+                     oat::Position2D &position,
+                     double &area,
+                     double min_area,
+                     double max_area,
+                     bool fill_objects = true);
+
+    // Number of detectors that work on successive frames in parallel. 1 to
+    // detect on the component's own thread.
+    int workers_ {1};
+
+    /**
+     * Make an unconfigured detector of the same type as this one, to be used
+     * as a worker. Detectors that depend on previous frames must not be
+     * replicated, because each worker only sees every workers_-th frame.
+     * @return New detector, or null if this type cannot be replicated.
+     */
+    virtual std::unique_ptr<PositionDetector> replicate() const
+    {
+        return nullptr;
+    }
+
+    /**
+     * Implementation of replicate() for concrete type T, which must be
+     * constructible from a frame SOURCE and position SINK address.
+     */
+    template <typename T>
+    std::unique_ptr<PositionDetector> replicateAs() const
+    {
+        return std::unique_ptr<PositionDetector>(
+            new T(frame_source_address_, position_sink_address_));
+    }
+
+    /**
+     * Create and configure workers if workers_ > 1. Call at the end of
+     * applyConfiguration().
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureWorkers(const po::variables_map &vm,
+                          const config::OptionTable &config_table);
+
+    // Largest lag behind the newest frame in the SOURCE's ring at which a
+    // frame is still processed. Staler frames are skipped. 0 to process
+    // every frame.
+    oat::Sample::Microseconds deadline_ {0};
+
+    /**
+     * Set deadline_ from the deadline key, in ms. Call from
+     * applyConfiguration().
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureDeadline(const po::variables_map &vm,
+                           const config::OptionTable &config_table);
+
+    // Share of frames detected by this process, I of N, when several
+    // detectors publish to one merge node. 1 shard to detect every frame.
+    uint64_t shard_ {0};
+    uint64_t shards_ {1};
+
+    /**
+     * Set shard_ and shards_ from the shard key, given as "I/N", and make
+     * the SINK a merge sink. Call from applyConfiguration().
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureShard(const po::variables_map &vm,
+                        const config::OptionTable &config_table);
+
+    /**
+     * Make the SINK keep a position history ring if the history key is set.
+     * Call from applyConfiguration().
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureHistory(const po::variables_map &vm,
+                          const config::OptionTable &config_table);
+
+    /**
+     * Make the SINK also publish to a position bus if the bus key is set.
+     * Call from applyConfiguration().
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     */
+    void configureBus(const po::variables_map &vm,
+                      const config::OptionTable &config_table);
+
+    // Number of times frames are halved for coarse detection before the
+    // result is refined at full resolution. 0 to detect at full resolution.
+    int pyramid_levels_ {0};
+
+    /**
+     * Halve a frame pyramid_levels_ times with cv::pyrDown, or read the
+     * level from SOURCE if its node hosts a Gaussian pyramid.
+     * @param frame Full resolution frame
+     * @return Coarse frame, valid until the next call.
+     */
+    const cv::Mat &downsample(const cv::Mat &frame);
+
+    /**
+     * Move a detection made on a downsampled frame, and every object in
+     * objects_, to full resolution coordinates and areas.
+     * @param position Coarse position
+     * @param area Coarse area
+     */
+    void upsample(oat::Position2D &position, double &area);
+
+    /**
+     * Full resolution window in which to refine a coarse detection. Large
+     * enough to hold the object and the uncertainty of its coarse position.
+     * @param position Coarse detection, in full resolution coordinates
+     * @param area Area of the coarse detection, in full resolution pixels
+     * @param frame_size Size of the full resolution frame
+     */
+    cv::Rect refinementWindow(const oat::Position2D &position,
+                              double area,
+                              const cv::Size &frame_size) const;
+
+    /**
+     * Set up the quality governor from the budget and degrade keys. Call
+     * from applyConfiguration(), after pyramid_levels_, search_window_px_
+     * and workers_ are set.
+     * @param vm Configuration passed to applyConfiguration()
+     * @param config_table Configuration passed to applyConfiguration()
+     * @param pyramid True if pyramid_levels_ can change between frames, so
+     * that 'pyramid' may be listed in degrade.
+     */
+    void configureGovernor(const po::variables_map &vm,
+                           const config::OptionTable &config_table,
+                           bool pyramid);
+
     // List of allowed configuration options
     //std::vector<std::string> config_keys_;
 
 private:
+    // ControllableComponent Interface
+    oat::CommandDescription commands(void) override { return {}; }
+    void applyCommand(const std::string &command) override { }
+    void applyParameters(const po::variables_map &vm,
+                         const config::OptionTable &config_table) override;
+
     // Component Interface
     virtual bool connectToNode(void) override;
     int process(void) override;
 
-    // Current frame
-    oat::Position2D * shared_position_;
-
     // Frame source
     const std::string frame_source_address_;
     oat::Source<oat::Frame> frame_source_;
 
+    // Wait on frame_source_, skipping frames that miss deadline_ or belong
+    // to another shard
+    oat::NodeState waitForFrame(void);
+
+    // If set, frames are read from a plane of the required color hosted by
+    // the SOURCE node instead of in the color the sink wrote
+    bool use_plane_ {false};
+    oat::FramePlane plane_ {oat::FramePlane::GREY};
+
+    // Frame to detect in, valid until frame_source_ is posted
+    oat::Frame sourceFrame(void) const;
+
     // Position sink
     const std::string position_sink_address_;
     oat::Sink<oat::Position2D> position_sink_;
+
+    // Working copy of SOURCE frames, if zero_copy_ is not set, and the
+    // position detected in them. Allocated when the node connects and reused
+    // by every call to process().
+    oat::Frame internal_frame_;
+    oat::Position2D internal_pos_ {""};
+
+    // Set while detecting directly on the shared frame, so that downsample()
+    // can read pyramid levels hosted alongside it
+    bool reading_source_ {false};
+
+    // Multi-object sink, used in place of position_sink_ when all_objects_
+    // is set
+    oat::PositionArray internal_objects_;
+    oat::Sink<oat::PositionArray> objects_sink_;
+
+    // A replicated detector and the frame it is working on
+    struct Worker {
+        std::unique_ptr<PositionDetector> detector;
+        oat::Frame frame;
+        oat::Position2D position {""};
+        std::exception_ptr error;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool busy {false}, done {false}, stop {false};
+    };
+
+    // Workers, and those holding frames not yet published, oldest first.
+    // Frames are handed out in order, so publishing from the front of
+    // in_flight_ keeps positions in sample order.
+    bool replica_ {false};
+    std::vector<std::unique_ptr<Worker>> worker_pool_;
+    std::deque<Worker *> in_flight_;
+    size_t next_worker_ {0};
+    void workLoop(Worker &w);
+    int processWithWorkers(void);
+    void publishWorker(Worker &w);
+    void publish(const oat::Position2D &position);
+
+    // Downsampled frames, one per pyramid level
+    std::vector<cv::Mat> pyramid_;
+
+    // Scratch space for connected component labeling
+    oat::ComponentSifter component_sifter_;
+
+    // Unpacked MASK frame, for contour tracing
+    cv::Mat unpacked_mask_;
+
+    // Optical flow following, the number of frames followed since the last
+    // detection, and the score of that detection
+    std::unique_ptr<FlowTracker> flow_;
+    int flow_frames_ {0};
+    double flow_score_ {0.0};
+
+    /**
+     * Follow the object in a frame by optical flow if it is locked on, or
+     * else detect it in the search window.
+     * @param frame Full frame
+     * @param window Window in which the object was detected
+     * @return True if the object was followed rather than detected.
+     */
+    bool detect(oat::Frame &frame, cv::Rect &window);
+
+    // Search window tracking. The window is centred on a constant velocity
+    // prediction from the last two detected positions.
+    int misses_ {0};
+    bool last_valid_ {false}, prev_valid_ {false};
+    cv::Point2d last_position_, prev_position_;
+    cv::Rect searchWindow(const cv::Size &frame_size) const;
+    void track(const cv::Rect &window, oat::Position2D &position);
+
+    // Head-tail disambiguation of axis headings. The axis points along the
+    // displacement since the last heading, if the object has moved at least
+    // AXIS_MIN_STEP_PX, or else to the same side as the last heading.
+    static constexpr double AXIS_MIN_STEP_PX {1.0};
+    bool axis_valid_ {false};
+    cv::Point2d axis_, axis_position_;
+    void orient(oat::Position2D &position);
+
+    // Quality governor, the knobs it turns in order, and their configured
+    // settings
+    oat::Governor governor_;
+    std::vector<std::string> degrade_;
+    int base_pyramid_levels_ {0};
+    int base_search_window_px_ {0};
+
+    /**
+     * Set pyramid_levels_ and search_window_px_ for a degradation level.
+     * @param level Governor level
+     */
+    void degrade(int level);
 };
 
 }      /* namespace oat */
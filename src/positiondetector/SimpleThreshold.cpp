@@ -20,14 +20,17 @@
 #include "SimpleThreshold.h"
 #include "DetectorFunc.h"
 
+#include <algorithm>
 #include <string>
 #include <opencv2/cvconfig.h>
 #include <opencv2/opencv.hpp>
 #include <cpptoml.h>
 
+#include "../../lib/datatypes/PackedMask.h"
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
@@ -44,6 +47,10 @@ SimpleThreshold::SimpleThreshold(const std::string &frame_source_address,
 
     // Set required frame type
     required_color_ = PIX_GREY;
+    accepted_colors_ = {PIX_GREY16, PIX_MASK};
+
+    // Frames are only read, or cloned before they are modified
+    zero_copy_ = true;
 }
 
 po::options_description SimpleThreshold::options() const
@@ -53,7 +60,30 @@ po::options_description SimpleThreshold::options() const
     local_opts.add_options()
         ("thresh,T", po::value<std::string>(),
          "Array of ints between 0 and 256, [min,max], specifying the "
-         "intensity passband.")
+         "intensity passband. GREY16 frames take bounds up to 65536, and "
+         "must be given them since the defaults only cover 8 bits. MASK "
+         "frames, e.g. from oat-framefilt thresh --pack, are already "
+         "thresholded and are detected on as they are, without erode or "
+         "dilate.")
+        ("adapt", po::value<std::string>(),
+         "If specified, the lower bound of thresh follows slow changes in "
+         "lighting. It is recomputed each frame from a decaying intensity "
+         "histogram of a sparse grid of pixels, either as the bound that best "
+         "separates dark and bright pixels, 'otsu', or as an intensity "
+         "percentile, 'percentile'. The upper bound of thresh is kept.")
+        ("adapt-percentile", po::value<double>(),
+         "Percentage of sampled pixels darker than the lower bound in "
+         "percentile mode, e.g. 99.5 when the object covers about 0.5% of "
+         "the frame. Defaults to 99.")
+        ("adapt-offset", po::value<int>(),
+         "Intensity added to the adaptive lower bound. Defaults to 0.")
+        ("adapt-stride", po::value<int>(),
+         "Spacing, in pixels, of the grid of pixels sampled for the "
+         "histogram. Defaults to 10, i.e. 1% of pixels.")
+        ("adapt-decay", po::value<double>(),
+         "Share, between 0 and 1, of the histogram replaced by each frame. "
+         "Smaller values follow lighting more slowly and ignore the object "
+         "more. Defaults to 0.05.")
         ("erode,e", po::value<int>(),
          "Contour erode kernel size in pixels (normalized box filter).")
         ("dilate,d", po::value<int>(),
@@ -61,6 +91,82 @@ po::options_description SimpleThreshold::options() const
         ("area,a", po::value<std::string>(),
          "Array of floats, [min,max], specifying the minimum and maximum "
          "object contour area in pixels^2.")
+        ("all-objects",
+         "If true, publish every object within the area bounds to SINK as a "
+         "position array, rather than only the largest as a position.")
+        ("label",
+         "If true, find objects by labeling connected pixels in a single pass "
+         "rather than by tracing their contours. Object area is then a pixel "
+         "count that excludes any holes.")
+        ("axis",
+         "If true, set the heading of each position to the major axis of the "
+         "detected object, from its second order moments, pointed along the "
+         "object's motion or, while it is still, to the side of the previous "
+         "heading. Objects too round to have an axis have no heading.")
+        ("deadline", po::value<double>(),
+         "Largest lag, in ms, of the frame being processed behind the newest "
+         "frame in SOURCE's ring buffers. Staler frames are skipped, so "
+         "positions stay fresh when detection falls behind. Skipped frames "
+         "show as gaps in position sample numbers. Defaults to 0, which "
+         "processes every frame.")
+        ("shard", po::value<std::string>(),
+         "Share detection with other posidet processes as I/N, e.g. 0/2 and "
+         "1/2. This process detects only frames whose sample number modulo N "
+         "is I, and SINK becomes a merge node that the other shards publish "
+         "to as well. Sources read the positions of all shards in sample "
+         "order.")
+        ("history", po::value<size_t>(),
+         "Keep the last N positions published to SINK in a history ring that "
+         "components reading SINK can scan by sample number, e.g. to draw "
+         "trails, instead of each keeping its own. At 30 Hz, 300 keeps the "
+         "last 10 s. Defaults to 0, which keeps no history.")
+        ("bus", po::value<std::string>(),
+         "Also publish positions to this position bus, on a channel named "
+         "after SINK, so that programs following many positions can read "
+         "them all with a single wait rather than a source per SINK.")
+        ("search-window", po::value<int>(),
+         "Side length, in pixels, of a square window around the predicted "
+         "object position to which detection is restricted. The prediction "
+         "extrapolates the last two detected positions. The full frame is "
+         "searched until the object is found and after search-misses "
+         "consecutive misses. Defaults to 0, which always searches the full "
+         "frame.")
+        ("search-misses", po::value<int>(),
+         "Number of consecutive misses within the search window after which "
+         "the full frame is searched. Defaults to 5.")
+        ("flow-window", po::value<int>(),
+         "Side length, in pixels, of a square window in which an object, "
+         "once detected, is followed from frame to frame by pyramidal "
+         "Lucas-Kanade optical flow on corner features found on it, rather "
+         "than being detected again. The object is detected again when too "
+         "few features can be followed. Cannot be used with all-objects or "
+         "workers. Defaults to 0, which detects in every frame.")
+        ("flow-features", po::value<int>(),
+         "Largest number of features followed by flow-window. Defaults to "
+         "20.")
+        ("flow-min-features", po::value<int>(),
+         "Fewest features that must survive a forward-backward check for the "
+         "object to still be followed. Defaults to 5.")
+        ("flow-refresh", po::value<int>(),
+         "Most consecutive frames in which the object is followed before it "
+         "is detected again, bounding drift. Defaults to 0, which follows "
+         "until the object is lost.")
+        ("workers", po::value<int>(),
+         "Number of threads that detect positions in successive frames in "
+         "parallel. Positions are still published in order. Cannot be used "
+         "with tune, search-window or flow-window. Defaults to 1.")
+        ("budget", po::value<double>(),
+         "Time, in ms, that detecting the position in a frame should take. "
+         "When detection keeps taking longer, e.g. because the CPU is "
+         "saturated, accuracy is traded for speed in the order given by "
+         "degrade, and it is restored once detection is well within budget "
+         "again. Cannot be used with workers. Defaults to 0, which never "
+         "degrades.")
+        ("degrade", po::value<std::string>(),
+         "Array of strings, e.g. [\"window\"], giving the order in which "
+         "accuracy is traded for speed when budget is exceeded. 'window' "
+         "halves the search-window up to twice. Defaults to window if a "
+         "search-window is set.")
         ("tune,t",
          "If true, provide a GUI with sliders for tuning detection parameters.")
         ;
@@ -70,6 +176,104 @@ po::options_description SimpleThreshold::options() const
 
 void SimpleThreshold::applyConfiguration(
     const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Parameters that can also be set at runtime
+    configureDetection(vm, config_table);
+
+    // Multiple objects
+    oat::config::getValue<bool>(vm, config_table, "all-objects", all_objects_);
+
+    // Connected component labeling
+    oat::config::getValue<bool>(vm, config_table, "label", label_components_);
+
+    // Heading from the object's major axis
+    oat::config::getValue<bool>(vm, config_table, "axis", axis_heading_);
+
+    // Skip stale frames
+    configureDeadline(vm, config_table);
+
+    // Detect a share of the frames
+    configureShard(vm, config_table);
+    configureHistory(vm, config_table);
+    configureBus(vm, config_table);
+
+    // Search window
+    oat::config::getNumericValue<int>(
+        vm, config_table, "search-window", search_window_px_, 0);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "search-misses", search_misses_, 1);
+
+    // Optical flow following
+    configureFlow(vm, config_table);
+
+    // Adaptive threshold
+    std::string adapt;
+    if (oat::config::getValue<std::string>(vm, config_table, "adapt", adapt)) {
+
+        AdaptiveThreshold::Method method;
+        if (adapt == "otsu")
+            method = AdaptiveThreshold::Method::OTSU;
+        else if (adapt == "percentile")
+            method = AdaptiveThreshold::Method::PERCENTILE;
+        else
+            throw std::runtime_error("adapt must be 'otsu' or 'percentile'.");
+
+        double percentile = 99.0;
+        oat::config::getNumericValue<double>(
+            vm, config_table, "adapt-percentile", percentile, 0.0, 100.0);
+
+        int stride = 10;
+        oat::config::getNumericValue<int>(
+            vm, config_table, "adapt-stride", stride, 1);
+
+        double decay = 0.05;
+        oat::config::getNumericValue<double>(
+            vm, config_table, "adapt-decay", decay, 0.0, 1.0);
+
+        oat::config::getNumericValue<int>(
+            vm, config_table, "adapt-offset", adapt_offset_, -255, 255);
+
+        adaptive_threshold_.configure(method, stride, decay, percentile);
+        adaptive_ = true;
+    }
+
+    // Tuning GUI
+    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
+
+    // Parallel detection
+    oat::config::getNumericValue<int>(
+        vm, config_table, "workers", workers_, 1);
+    if (workers_ > 1 && tuning_on_)
+        throw std::runtime_error("Tuning cannot be used with multiple "
+                                 "workers.");
+
+    // Trade accuracy for speed under load
+    configureGovernor(vm, config_table, false);
+
+    configureWorkers(vm, config_table);
+
+    // Its sliders start from the configuration above
+    if (tuning_on_)
+        tuner_ = oat::make_unique<oat::TuningDisplay>(
+            tuning_image_title_,
+            [this] { createTuningWindows(); },
+            helper_thread_policy_);
+}
+
+oat::CommandDescription SimpleThreshold::parameters()
+{
+    const oat::CommandDescription params{
+        {"thresh", "Intensity passband, [min,max]."},
+        {"erode", "Erode kernel size in pixels."},
+        {"dilate", "Dilate kernel size in pixels."},
+        {"area", "Object area range, [min,max], in pixels^2."}
+    };
+
+    return params;
+}
+
+void SimpleThreshold::configureDetection(const po::variables_map &vm,
+                                         const config::OptionTable &config_table)
 {
     // Threshold
     std::vector<int> t;
@@ -78,8 +282,8 @@ void SimpleThreshold::applyConfiguration(
         t_min_ = t[0];
         t_max_ = t[1];
 
-        if (t_min_ < 0 || t_min_> 256 || t_max_ < 0 || t_max_ > 256)
-           throw std::runtime_error("Values of thresh should be between 0 and 256.");
+        if (t_min_ < 0 || t_min_> 65536 || t_max_ < 0 || t_max_ > 65536)
+           throw std::runtime_error("Values of thresh should be between 0 and 65536.");
     }
 
     // Erode size
@@ -106,79 +310,71 @@ void SimpleThreshold::applyConfiguration(
         if (min_object_area_ >= max_object_area_)
            throw std::runtime_error("Max area should be larger than min area.");
     }
-
-    // Tuning GUI
-    oat::config::getValue<bool>(vm, config_table, "tune", tuning_on_);
 }
 
 void SimpleThreshold::detectPosition(cv::Mat &frame, oat::Position2D &position)
 {
-    if (tuning_on_)
-        tune_frame_ = frame.clone();
+    // Only build a tuning view if the display can take it
+    const bool tune = tuner_ && tuner_->ready();
 
-    applyThreshold(frame);
+    // Packed masks are sifted without unpacking them
+    if (frame_color_ == PIX_MASK) {
 
-    // Threshold frame will be destroyed by the transform below, so we need to use
-    // it to form the frame that will be shown in the tuning window here
-    if (tuning_on_)
-         tune_frame_.setTo(0, threshold_frame_ == 0);
+        if (tune) {
+            oat::unpackMask(frame, threshold_frame_);
+            tuner_->capture(threshold_frame_);
+        }
 
-    siftContours(threshold_frame_,
-                 position,
-                 object_area_,
-                 min_object_area_,
-                 max_object_area_);
+        siftObjects(frame,
+                    position,
+                    object_area_,
+                    min_object_area_,
+                    max_object_area_);
 
-    if (tuning_on_)
-        tune(tune_frame_, position);
-}
+        if (tune)
+            tuner_->show(position, object_area_, cv::Scalar(255));
 
-void SimpleThreshold::tune(cv::Mat &frame, const oat::Position2D &position)
-{
-    if (!tuning_windows_created_)
-        createTuningWindows();
-
-    std::string msg = cv::format("Object not found");
-
-    // Plot a circle representing found object
-    if (position.position_valid) {
-
-        // TODO: object_area_ is not set, so this will be 0!
-        auto radius = std::sqrt(object_area_ / PI);
-        cv::Point center;
-        center.x = position.position.x;
-        center.y = position.position.y;
-        cv::circle(frame, center, radius, cv::Scalar(255), 4);
-        msg = cv::format("(%d, %d) pixels",
-                (int) position.position.x,
-                (int) position.position.y);
+        return;
+    }
+
+    if (adaptive_) {
+        if (frame_color_ != PIX_GREY)
+            throw std::runtime_error("Adaptive thresholds require GREY frames.");
+        const int t = adaptive_threshold_.update(frame) + adapt_offset_;
+        t_min_ = std::max(0, std::min(t, 256));
     }
 
-    int baseline = 0;
-    cv::Size textSize = cv::getTextSize(msg, 1, 1, 1, &baseline);
-    cv::Point text_origin(
-            frame.cols - textSize.width - 10,
-            frame.rows - 2 * baseline - 10);
+    applyThreshold(frame);
+
+    // Threshold frame will be destroyed by the transform below, so we need to use
+    // it to form the frame that will be shown in the tuning window here
+    if (tune)
+        tuner_->capture(frame, threshold_frame_);
 
-    cv::putText(frame, msg, text_origin, 1, 1, cv::Scalar(0, 255, 0));
+    siftObjects(threshold_frame_,
+                position,
+                object_area_,
+                min_object_area_,
+                max_object_area_);
 
-    cv::imshow(tuning_image_title_, frame);
-    cv::waitKey(1);
+    if (tune)
+        tuner_->show(position, object_area_, cv::Scalar(255));
 }
 
 void SimpleThreshold::applyThreshold(cv::Mat &frame)
 {
-    cv::inRange(frame,
-                t_min_,
-                t_max_,
-                threshold_frame_);
-
-    // Filter the resulting threshold image
-    if (erode_on_)
-        cv::erode(threshold_frame_, threshold_frame_, erode_element_);
-
-    if (dilate_on_)
-        cv::dilate(threshold_frame_, threshold_frame_, dilate_element_);
+    // Threshold and filter in one pass
+    const int lo[1] {t_min_};
+    const int hi[1] {t_max_};
+    const int erode_px = erode_on_ ? erode_px_ : 0;
+    const int dilate_px = dilate_on_ ? dilate_px_ : 0;
+
+    if (frame_color_ == PIX_GREY16)
+        threshold_.apply<PIX_GREY16>(
+            frame, threshold_frame_, lo, hi, erode_px, dilate_px);
+    else
+        threshold_.apply<PIX_GREY>(
+            frame, threshold_frame_, lo, hi, erode_px, dilate_px);
 }
 
 void SimpleThreshold::createTuningWindows()
@@ -212,7 +408,6 @@ void SimpleThreshold::createTuningWindows()
                        OAT_POSIDET_MAX_OBJ_AREA_PIX,
                        &simpleThresholdMaxAreaSliderChangedCallback,
                        this);
-    tuning_windows_created_ = true;
     cv::createTrackbar("ERODE",
                        tuning_image_title_,
                        &erode_px_,
@@ -232,7 +427,6 @@ void SimpleThreshold::set_erode_size(int value)
     if (value > 0) {
         erode_on_ = true;
         erode_px_ = value;
-        erode_element_ = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(erode_px_, erode_px_));
     } else {
         erode_on_ = false;
     }
@@ -243,7 +437,6 @@ void SimpleThreshold::set_dilate_size(int value)
     if (value > 0) {
         dilate_on_ = true;
         dilate_px_ = value;
-        dilate_element_ = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(dilate_px_, dilate_px_));
     } else {
         dilate_on_ = false;
     }
@@ -20,9 +20,14 @@
 #ifndef OAT_SIMPLETHRESHOLD_H
 #define	OAT_SIMPLETHRESHOLD_H
 
+#include "AdaptiveThreshold.h"
+#include "PassbandThreshold.h"
 #include "PositionDetector.h"
 
 #include <limits>
+#include <memory>
+
+#include "../../lib/utility/TuningDisplay.h"
 
 namespace oat {
 
@@ -58,10 +63,21 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    // Runtime parameters
+    oat::CommandDescription parameters(void) override;
+    void configureDetection(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
     void detectPosition(cv::Mat &frame, oat::Position2D &position) override;
 
+    std::unique_ptr<PositionDetector> replicate() const override
+    {
+        return replicateAs<SimpleThreshold>();
+    }
+
     // Intermediate variables
     cv::Mat threshold_frame_;
+    PassbandThreshold threshold_;
 
     // Object detection
     double object_area_ {0.0};
@@ -70,29 +86,30 @@ private:
     int erode_px_ {0}, dilate_px_ {0};
     bool erode_on_ {false}, dilate_on_ {false};
 
-    // Internal matricies
-    cv::Mat erode_element_, dilate_element_;
-
     // Detector parameters
     int t_min_ {0};
     int t_max_ {256};
     double min_object_area_ {0.0};
     double max_object_area_ {std::numeric_limits<double>::max()};
 
+    // Lower threshold bound that follows the intensity histogram, offset by
+    // adapt_offset_, if adaptive_ is set
+    bool adaptive_ {false};
+    AdaptiveThreshold adaptive_threshold_;
+    int adapt_offset_ {0};
+
     // Settint erode and dilate kernels 
     void set_erode_size(int erode_px);
     void set_dilate_size(int dilate_px);
 
     // Tuning stuff
     bool tuning_on_ {false};
-    bool tuning_windows_created_ {false};
     const std::string tuning_image_title_;
-    cv::Mat tune_frame_;
+    std::unique_ptr<oat::TuningDisplay> tuner_;
     int dummy0_ {0}, dummy1_ {100000};
 
     // Processing functions
     void createTuningWindows(void);
-    void tune(cv::Mat &frame, const oat::Position2D &position);
     void applyThreshold(cv::Mat &frame);
 };
 
@@ -17,6 +17,8 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //****************************************************************************
 
+#include "OatConfig.h" // Generated by CMake
+
 #include <iostream>
 #include <memory>
 #include <string>
@@ -32,8 +34,14 @@
 #include "../../lib/utility/ProgramOptions.h"
 
 #include "PositionDetector.h"
+#include "ArenaDetector.h"
 #include "DifferenceDetector.h"
 #include "HSVDetector.h"
+#include "HSVMarkerDetector.h"
+#include "MOGDetector.h"
+#ifdef USE_DNN
+ #include "PoseDetector.h"
+#endif
 #include "SimpleThreshold.h"
 
 #define REQ_POSITIONAL_ARGS 3
@@ -42,8 +50,13 @@ namespace po = boost::program_options;
 
 const char usage_type[] =
     "TYPE\n"
+    "  arenas: One object per region of the frame, each with its own detector\n"
     "  diff: Difference detector (color or grey-scale, motion)\n"
-    "  hsv: HSV color thresholds (color)\n"
+    "  hsv: HSV color thresholds (HSV or BGR color)\n"
+    "  markers: Several HSV color markers found in one pass (HSV or BGR "
+    "color)\n"
+    "  mog: Mixture of Gaussians background model (color or grey-scale)\n"
+    "  pose: Keypoints found by a pose estimation network (color)\n"
     "  thresh: Simple amplitude threshold (mono)";
 
 const char usage_io[] =
@@ -93,6 +106,10 @@ int main(int argc, char *argv[])
     type_hash["diff"] = 'a';
     type_hash["hsv"] = 'b';
     type_hash["thresh"] = 'c';
+    type_hash["mog"] = 'd';
+    type_hash["pose"] = 'e';
+    type_hash["markers"] = 'f';
+    type_hash["arenas"] = 'g';
 
     // The component itself
     std::string comp_name = "posidet";
@@ -167,6 +184,33 @@ int main(int argc, char *argv[])
                     detector = std::make_shared<oat::SimpleThreshold>(source, sink);
                     break;
                 }
+                case 'd':
+                {
+                    detector = std::make_shared<oat::MOGDetector>(source, sink);
+                    break;
+                }
+                case 'e':
+                {
+#ifndef USE_DNN
+                    std::cerr << oat::Error(
+                        "Oat was not compiled with OpenCV's dnn module, so "
+                        "TYPE=pose is not available.\n");
+                    return -1;
+#else
+                    detector = std::make_shared<oat::PoseDetector>(source, sink);
+#endif
+                    break;
+                }
+                case 'f':
+                {
+                    detector = std::make_shared<oat::HSVMarkerDetector>(source, sink);
+                    break;
+                }
+                case 'g':
+                {
+                    detector = std::make_shared<oat::ArenaDetector>(source, sink);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
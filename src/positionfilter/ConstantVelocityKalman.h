@@ -0,0 +1,321 @@
+//******************************************************************************
+//* File:   ConstantVelocityKalman.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_CONSTANTVELOCITYKALMAN_H
+#define	OAT_CONSTANTVELOCITYKALMAN_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace oat {
+
+/**
+ * @brief Noise model shared by constant velocity Kalman filters. Motion is
+ * driven by random, normally distributed accelerations that are constant
+ * between time steps. Measurements are positions with Gaussian noise.
+ */
+struct ConstantVelocityModel {
+
+    double dt {0.02};
+
+    // Process noise covariance of one axis (see pp13-15 of
+    // MWL.JPN.105.02.002 for derivation)
+    // [ dt^4/4 dt^3/2 ]
+    // [ dt^3/2 dt^2   ] * sigma_accel^2
+    double q00 {0}, q01 {0}, q11 {0};
+
+    // Measurement noise variance
+    double r {0};
+
+    void set(const double dt_sec,
+             const double sigma_accel,
+             const double sigma_noise)
+    {
+        const double a2 = sigma_accel * sigma_accel;
+        dt = dt_sec;
+        q00 = a2 * dt * dt * dt * dt / 4.0;
+        q01 = a2 * dt * dt * dt / 2.0;
+        q11 = a2 * dt * dt;
+        r = sigma_noise * sigma_noise;
+    }
+};
+
+/**
+ * @brief 2D constant velocity Kalman filter with state [x x' y y']^T. The
+ * transition, observation and noise matrices are block diagonal, so the two
+ * axes are independent two-state filters whose symmetric 2x2 covariances are
+ * updated in closed form. Nothing is allocated.
+ */
+class ConstantVelocityKalman {
+public:
+
+    // Position and velocity of one axis, and their covariance
+    struct Axis {
+        double x {0}, v {0};
+        double p00 {0}, p01 {0}, p11 {0};
+    };
+
+    /**
+     * @brief Restart the filter at a measured position with zero velocity.
+     * @param x Measured x position.
+     * @param y Measured y position.
+     * @param p0 Initial variance of each state, large to indicate a lack of
+     * trust in the model.
+     */
+    void init(const double x, const double y, const double p0 = 1000.0)
+    {
+        for (auto &a : axes_) {
+            a.v = a.p01 = 0;
+            a.p00 = a.p11 = p0;
+        }
+        axes_[0].x = x;
+        axes_[1].x = y;
+    }
+
+    // Advance the state by one time step
+    void predict(const ConstantVelocityModel &m)
+    {
+        predict(axes_[0], m);
+        predict(axes_[1], m);
+    }
+
+    // Correct the state with a measured position
+    void correct(const ConstantVelocityModel &m, const double x, const double y)
+    {
+        correct(axes_[0], m, x);
+        correct(axes_[1], m, y);
+    }
+
+    const Axis &x(void) const { return axes_[0]; }
+    const Axis &y(void) const { return axes_[1]; }
+
+    static void predict(Axis &a, const ConstantVelocityModel &m)
+    {
+        const double dt = m.dt;
+        a.x += dt * a.v;
+        a.p00 += dt * (2.0 * a.p01 + dt * a.p11) + m.q00;
+        a.p01 += dt * a.p11 + m.q01;
+        a.p11 += m.q11;
+    }
+
+    static void correct(Axis &a, const ConstantVelocityModel &m, const double z)
+    {
+        const double s = a.p00 + m.r;
+        const double k0 = a.p00 / s;
+        const double k1 = a.p01 / s;
+        const double e = z - a.x;
+
+        a.x += k0 * e;
+        a.v += k1 * e;
+        a.p11 -= k1 * a.p01;
+        a.p01 -= k0 * a.p01;
+        a.p00 -= k0 * a.p00;
+    }
+
+    /**
+     * @brief Rauch-Tung-Striebel step, run backwards over a filtered track.
+     * Smooths the state of one time step using the prediction that was made
+     * from it and the smoothed state of the next time step. Only the state is
+     * smoothed; the covariance is left as filtered.
+     * @param a Filtered state of time step k. Smoothed on return.
+     * @param m Noise model the track was filtered with.
+     * @param predicted State of time step k + 1 predicted from a.
+     * @param next Smoothed state of time step k + 1.
+     */
+    static void smooth(Axis &a,
+                       const ConstantVelocityModel &m,
+                       const Axis &predicted,
+                       const Axis &next)
+    {
+        const double dt = m.dt;
+        const double det = predicted.p00 * predicted.p11
+                           - predicted.p01 * predicted.p01;
+        if (det <= 0)
+            return;
+
+        // Smoother gain, C = P F^T P_predicted^-1
+        const double b00 = a.p00 + dt * a.p01, b01 = a.p01;
+        const double b10 = a.p01 + dt * a.p11, b11 = a.p11;
+        const double i00 = predicted.p11 / det;
+        const double i01 = -predicted.p01 / det;
+        const double i11 = predicted.p00 / det;
+        const double c00 = b00 * i00 + b01 * i01, c01 = b00 * i01 + b01 * i11;
+        const double c10 = b10 * i00 + b11 * i01, c11 = b10 * i01 + b11 * i11;
+
+        const double ex = next.x - predicted.x;
+        const double ev = next.v - predicted.v;
+        a.x += c00 * ex + c01 * ev;
+        a.v += c10 * ex + c11 * ev;
+    }
+
+private:
+    Axis axes_[2];
+};
+
+/**
+ * @brief A batch of constant velocity Kalman filters, stored as a structure
+ * of arrays so that all tracks are stepped in one pass of loops that the
+ * compiler vectorizes. The x axes of all tracks come first, followed by the y
+ * axes, so each loop runs over 2N independent two-state filters. Storage is
+ * allocated by resize() only.
+ */
+class ConstantVelocityKalmanBatch {
+public:
+
+    // Number of tracks
+    size_t size(void) const { return n_; }
+
+    /**
+     * @brief Set the number of tracks. Existing tracks are kept, up to n.
+     * New tracks must be initialized before use.
+     */
+    void resize(const size_t n)
+    {
+        const size_t keep = std::min(n, n_);
+        for (auto a : arrays()) {
+            std::vector<double> b(2 * n, 0.0);
+            std::copy(a->begin(), a->begin() + keep, b.begin());
+            std::copy(a->begin() + n_, a->begin() + n_ + keep, b.begin() + n);
+            a->swap(b);
+        }
+        n_ = n;
+    }
+
+    // Remove track i. The last track takes its index.
+    void erase(const size_t i)
+    {
+        const size_t last = n_ - 1;
+        for (auto a : arrays()) {
+            (*a)[i] = (*a)[last];
+            (*a)[i + n_] = (*a)[last + n_];
+        }
+        resize(last);
+    }
+
+    // Restart track i at a measured position with zero velocity
+    void init(const size_t i, const double x, const double y,
+              const double p0 = 1000.0)
+    {
+        x_[i] = x;
+        x_[i + n_] = y;
+        v_[i] = v_[i + n_] = 0;
+        p00_[i] = p00_[i + n_] = p0;
+        p01_[i] = p01_[i + n_] = 0;
+        p11_[i] = p11_[i + n_] = p0;
+    }
+
+    // Advance all tracks by one time step
+    void predict(const ConstantVelocityModel &m)
+    {
+        predict(2 * n_, m.dt, m.q00, m.q01, m.q11,
+                x_.data(), v_.data(), p00_.data(), p01_.data(), p11_.data());
+    }
+
+    /**
+     * @brief Set the measurement of track i for the next correct().
+     * Tracks without a measurement are left as predicted.
+     */
+    void measure(const size_t i, const double x, const double y)
+    {
+        z_[i] = x;
+        z_[i + n_] = y;
+        w_[i] = w_[i + n_] = 1.0;
+    }
+
+    // Correct all measured tracks, and clear the measurements
+    void correct(const ConstantVelocityModel &m)
+    {
+        correct(2 * n_, m.r, x_.data(), v_.data(),
+                p00_.data(), p01_.data(), p11_.data(), z_.data(), w_.data());
+    }
+
+    // State of track i
+    double x(const size_t i) const { return x_[i]; }
+    double y(const size_t i) const { return x_[i + n_]; }
+    double vx(const size_t i) const { return v_[i]; }
+    double vy(const size_t i) const { return v_[i + n_]; }
+
+    // Predicted position variance of track i, e.g. for gating
+    double var_x(const size_t i) const { return p00_[i]; }
+    double var_y(const size_t i) const { return p00_[i + n_]; }
+
+private:
+    size_t n_ {0};
+    std::vector<double> x_, v_, p00_, p01_, p11_;
+
+    // Pending measurements and their weights (1 if measured, else 0)
+    std::vector<double> z_, w_;
+
+    // The loops take restrict qualified arguments so that they are
+    // vectorized without run time alias checks
+    static void predict(const size_t n,
+                        const double dt,
+                        const double q00,
+                        const double q01,
+                        const double q11,
+                        double * __restrict x,
+                        double * __restrict v,
+                        double * __restrict p00,
+                        double * __restrict p01,
+                        double * __restrict p11)
+    {
+        for (size_t k = 0; k < n; k++) {
+            x[k] += dt * v[k];
+            p00[k] += dt * (2.0 * p01[k] + dt * p11[k]) + q00;
+            p01[k] += dt * p11[k] + q01;
+            p11[k] += q11;
+        }
+    }
+
+    static void correct(const size_t n,
+                        const double r,
+                        double * __restrict x,
+                        double * __restrict v,
+                        double * __restrict p00,
+                        double * __restrict p01,
+                        double * __restrict p11,
+                        const double * __restrict z,
+                        double * __restrict w)
+    {
+        // Unmeasured tracks have zero gain rather than a branch
+        for (size_t k = 0; k < n; k++) {
+            const double g = w[k] / (p00[k] + r);
+            const double k0 = g * p00[k];
+            const double k1 = g * p01[k];
+            const double e = z[k] - x[k];
+
+            x[k] += k0 * e;
+            v[k] += k1 * e;
+            p11[k] -= k1 * p01[k];
+            p01[k] -= k0 * p01[k];
+            p00[k] -= k0 * p00[k];
+            w[k] = 0;
+        }
+    }
+
+    std::array<std::vector<double> *, 7> arrays(void)
+    {
+        return {{&x_, &v_, &p00_, &p01_, &p11_, &z_, &w_}};
+    }
+};
+
+}      /* namespace oat */
+#endif /* OAT_CONSTANTVELOCITYKALMAN_H */
@@ -17,9 +17,11 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <cmath>
 #include <string>
 #include <cpptoml.h>
 
+#include "../../lib/utility/Homography.h"
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/IOFormat.h"
 
@@ -63,46 +65,26 @@ void HomographyTransform2D::applyConfiguration(
 void HomographyTransform2D::filter(oat::Position2D& position) {
 
     // TODO: If the homography_is not valid, I should warn the user...
-    //if (homography_valid_) {
 
     // Position transform
-    if (position.position_valid) {
-        std::vector<oat::Point2D> in_positions;
-        std::vector<oat::Point2D> out_positions;
-        in_positions.push_back(position.position);
-        cv::perspectiveTransform(in_positions, out_positions, homography_);
-        position.position = out_positions[0];
-    }
+    if (position.position_valid)
+        position.position = oat::transformPoint(homography_, position.position);
 
-    // Velocity transform
-    if (position.velocity_valid) {
-        std::vector<oat::Velocity2D> in_velocities;
-        std::vector<oat::Velocity2D> out_velocities;
-        cv::Matx33d vel_homo = homography_;
-        vel_homo(0, 2) = 0.0; // offsets do not apply to velocity
-        vel_homo(1, 2) = 0.0; // offsets do not apply to velocity
-        in_velocities.push_back(position.velocity);
-        cv::perspectiveTransform(in_velocities, out_velocities, vel_homo);
-        position.velocity = out_velocities[0];
-    }
+    // Velocity transform. Offsets do not apply to velocity.
+    if (position.velocity_valid)
+        position.velocity
+            = oat::transformPoint(homography_, position.velocity, false);
 
-    // Heading transform
+    // Heading transform. Offsets do not apply to heading.
     if (position.heading_valid) {
-        std::vector<oat::UnitVector2D> in_heading;
-        std::vector<oat::UnitVector2D> out_heading;
-        cv::Matx33d head_homo = homography_;
-        head_homo(0, 2) = 0.0; // offsets do not apply to heading
-        head_homo(1, 2) = 0.0; // offsets do not apply to heading
-        in_heading.push_back(position.heading);
-        cv::perspectiveTransform(in_heading, out_heading, head_homo);
-        cv::normalize(out_heading, out_heading);
-        position.heading = out_heading[0];
+        const cv::Point2d h
+            = oat::transformPoint(homography_, position.heading, false);
+        const double n = std::sqrt(h.dot(h));
+        position.heading = n > 0.0 ? h * (1.0 / n) : h;
     }
 
     // Update outgoing position's coordinate system
     position.setCoordSystem(oat::DistanceUnit::WORLD, homography_);
-
-    //}
 }
 
 } /* namespace oat */
@@ -17,12 +17,16 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include <opencv2/opencv.hpp>
 #include <cpptoml.h>
 
 #include "../../lib/utility/TOMLSanitize.h"
 #include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/make_unique.h"
 
 #include "KalmanFilter2D.h"
 
@@ -57,6 +61,12 @@ po::options_description KalmanFilter2D::options() const
         ("tune,t",
          "If true, provide a GUI with sliders for tuning filter "
          "parameters.")
+        ("smooth",
+         "If true, and positions are filtered --offline, write the "
+         "fixed-interval (Rauch-Tung-Striebel) smoothed position and velocity "
+         "of every sample, which use all measurements of its track, instead "
+         "of the causal estimates. Tracks are the runs of samples that the "
+         "causal filter considers valid, and are smoothed in parallel.")
         ;
 
     return local_opts;
@@ -73,6 +83,41 @@ void KalmanFilter2D::applyConfiguration(const po::variables_map &vm,
     if (oat::config::getNumericValue<double>(vm, config_table, "timeout", t, 0))
         not_found_count_threshold_ = static_cast<int>(t / dt_);
 
+    // Sigma accel and noise, which can also be set at runtime
+    applyParameters(vm, config_table);
+
+    // Offline smoothing
+    oat::config::getValue<bool>(vm, config_table, "smooth", smooth_);
+
+    // Tuning GUI
+    bool tune = false;
+    oat::config::getValue<bool>(vm, config_table, "tune", tune);
+
+    // Sliders are serviced by their own thread, so tuning does not hold up
+    // filtering
+    if (tune) {
+        sig_accel_tune_ = static_cast<int>(sig_accel_);
+        sig_measure_noise_tune_ = static_cast<int>(sig_measure_noise_);
+        tuner_ = oat::make_unique<oat::TuningDisplay>(
+            tuning_image_title_,
+            [this] { createTuningWindows(); },
+            helper_thread_policy_);
+    }
+}
+
+oat::CommandDescription KalmanFilter2D::parameters()
+{
+    const oat::CommandDescription params{
+        {"sigma-accel", "Standard deviation of random accelerations."},
+        {"sigma-noise", "Standard deviation of position measurement noise."}
+    };
+
+    return params;
+}
+
+void KalmanFilter2D::applyParameters(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
     // Sigma accel
     oat::config::getNumericValue<double>(
         vm, config_table, "sigma-accel", sig_accel_, 0);
@@ -81,22 +126,16 @@ void KalmanFilter2D::applyConfiguration(const po::variables_map &vm,
     oat::config::getNumericValue<double>(
         vm, config_table, "sigma-noise", sig_measure_noise_, 0);
 
-    // Tuning GUI
-    bool tune;
-    oat::config::getValue<bool>(vm, config_table, "tune", tune);
-
-    if (tune) {
-        tuning_on_ = true;
-        createTuningWindows();
-    }
+    // The filter state is kept, so tracking continues under the new model
+    initializeModel();
 }
 
 void KalmanFilter2D::filter(oat::Position2D &position) {
 
     // Transform raw position into kf_meas_ vector
     if (position.position_valid) {
-        kf_meas_(0,0) = position.position.x;
-        kf_meas_(1,0) = position.position.y;
+        meas_x_ = position.position.x;
+        meas_y_ = position.position.y;
         not_found_count_ = 0;
 
         // We are coming from a time step where there were no measurements for
@@ -119,16 +158,18 @@ void KalmanFilter2D::filter(oat::Position2D &position) {
     // the position measurement was invalid, but we are within the not_found_count_threshold_)
     if (found_) {
 
-        kf_predicted_state_ = kf_.predict();
+        kf_.predict(model_);
+        predicted_x_ = kf_.x();
+        predicted_y_ = kf_.y();
 
         // Apply the Kalman update
-        kf_.correct(kf_meas_);
+        kf_.correct(model_, meas_x_, meas_y_);
     }
 
-    position.position.x = kf_predicted_state_(0, 0);
-    position.velocity.x = kf_predicted_state_(1, 0);
-    position.position.y = kf_predicted_state_(2, 0);
-    position.velocity.y = kf_predicted_state_(3, 0);
+    position.position.x = predicted_x_.x;
+    position.velocity.x = predicted_x_.v;
+    position.position.y = predicted_y_.x;
+    position.velocity.y = predicted_y_.v;
 
     // This Position is only valid if the not_found_count_threshold_ has not
     // be exceeded
@@ -144,110 +185,191 @@ void KalmanFilter2D::filter(oat::Position2D &position) {
     tune();
 }
 
-void KalmanFilter2D::initializeFilter(void) {
+namespace {
+
+/**
+ * Forward filter then backward smooth one axis of a track, from its first
+ * sample up to, but excluding, its last.
+ */
+void smoothAxis(const ConstantVelocityModel &m,
+                const size_t first,
+                const size_t last,
+                const std::vector<char> &measured,
+                const std::vector<double> &z,
+                std::vector<double> &x,
+                std::vector<double> &v,
+                std::vector<ConstantVelocityKalman::Axis> &filtered,
+                std::vector<ConstantVelocityKalman::Axis> &predicted)
+{
+    const size_t len = last - first;
+    filtered.resize(len);
+    predicted.resize(len);
+
+    // Forward pass, started at the first measurement as in initializeFilter()
+    ConstantVelocityKalman::Axis a;
+    a.x = z[first];
+    a.p00 = a.p11 = 1000.0;
+
+    for (size_t i = 0; i < len; i++) {
+        ConstantVelocityKalman::predict(a, m);
+        predicted[i] = a;
+        if (measured[first + i])
+            ConstantVelocityKalman::correct(a, m, z[first + i]);
+        filtered[i] = a;
+    }
+
+    // Backward pass. The last sample is already smoothed.
+    for (size_t i = len - 1; i-- > 0;)
+        ConstantVelocityKalman::smooth(filtered[i], m,
+                                       predicted[i + 1], filtered[i + 1]);
+
+    for (size_t i = 0; i < len; i++) {
+        x[first + i] = filtered[i].x;
+        v[first + i] = filtered[i].v;
+    }
+}
+
+} /* namespace */
+
+uint64_t KalmanFilter2D::filterFile(const std::string &in_path,
+                                    const std::string &out_path)
+{
+    if (!smooth_)
+        return PositionFilter::filterFile(in_path, out_path);
+
+    // Smoothing needs the whole file
+    std::ifstream in;
+    const uint64_t n = openPositionFile(in, in_path);
+    const size_t bytes = oat::Position2D::NPY_DTYPE_BYTES;
+    std::vector<char> records(n * bytes);
+    in.read(records.data(), records.size());
+    if (!in)
+        throw std::runtime_error("Could not read " + in_path + ".");
+
+    // Measurements, and the tracks that filter() would follow: each starts
+    // at a measurement and ends once the timeout has passed without one
+    struct Track { size_t first, last; };
+    std::vector<Track> tracks;
+    std::vector<char> measured(n), tracked(n);
+    std::vector<double> zx(n), zy(n);
+
+    oat::Position2D p {"record"};
+    bool found = false;
+    int not_found = 0;
+    for (size_t k = 0; k < n; k++) {
+
+        oat::unpackPosition(records.data() + k * bytes, p);
+        measured[k] = p.position_valid;
+        zx[k] = p.position.x;
+        zy[k] = p.position.y;
+
+        if (measured[k]) {
+            not_found = 0;
+            if (!found)
+                tracks.push_back({k, k});
+            found = true;
+        } else {
+            not_found++;
+        }
 
-    initializeStaticMatracies();
+        if (not_found >= not_found_count_threshold_)
+            found = false;
 
-    // Error covariance matrix (initialize with large value to indicate a lack
-    // of trust in the model)
-    cv::setIdentity(kf_.errorCovPre, 1000.0);
+        if (found) {
+            tracks.back().last = k + 1;
+            tracked[k] = 1;
+        }
+    }
+
+    // Tracks are independent, so they are smoothed in parallel
+    std::vector<double> x(n), vx(n), y(n), vy(n);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(tracks.size())),
+                      [&](const cv::Range &r) {
+        std::vector<ConstantVelocityKalman::Axis> filtered, predicted;
+        for (int t = r.start; t < r.end; t++) {
+            const auto &track = tracks[t];
+            if (track.last == track.first)
+                continue;
+            smoothAxis(model_, track.first, track.last, measured, zx, x, vx,
+                       filtered, predicted);
+            smoothAxis(model_, track.first, track.last, measured, zy, y, vy,
+                       filtered, predicted);
+        }
+    });
+
+    // Samples outside of tracks are invalid, as filter() publishes them
+    for (size_t k = 0; k < n; k++) {
+
+        char *record = records.data() + k * bytes;
+        oat::unpackPosition(record, p);
+
+        p.position_valid = p.velocity_valid = tracked[k] != 0;
+        if (tracked[k]) {
+            p.position.x = x[k];
+            p.position.y = y[k];
+            p.velocity.x = vx[k];
+            p.velocity.y = vy[k];
+        }
+
+        oat::packPosition(p, record);
+    }
+
+    FILE *out = createPositionFile(out_path);
+    if (fwrite(records.data(), 1, records.size(), out) != records.size()) {
+        fclose(out);
+        throw std::runtime_error("Could not write " + out_path + ".");
+    }
+    closePositionFile(out, out_path, n);
+
+    return n;
+}
+
+void KalmanFilter2D::initializeFilter(void) {
+
+    initializeModel();
 
     // TODO: Add head direction?
     // The state is
     // [ x  x'  y  y']^T, where ' denotes the time derivative
-    // Initialize the pre/post state using the current measurement
-    kf_.statePre.at<double>(0) = kf_meas_(0, 0);
-    kf_.statePre.at<double>(1) = 0.0;
-    kf_.statePre.at<double>(2) = kf_meas_(1, 0);
-    kf_.statePre.at<double>(3) = 0.0;
-
-    kf_.statePost.at<double>(0) = kf_meas_(0, 0);
-    kf_.statePost.at<double>(1) = 0.0;
-    kf_.statePost.at<double>(2) = kf_meas_(1, 0);
-    kf_.statePost.at<double>(3) = 0.0;
+    // Initialize the state using the current measurement. The error
+    // covariance is initialized with a large value to indicate a lack of
+    // trust in the model.
+    kf_.init(meas_x_, meas_y_, 1000.0);
 }
 
-void KalmanFilter2D::initializeStaticMatracies() {
+void KalmanFilter2D::initializeModel() {
 
     // State transition matrix
     // [ 1  dt_ 0  0  ]
     // [ 0  1  0  0   ]
     // [ 0  0  1  dt_ ]
     // [ 0  0  0  1   ]
-    cv::setIdentity(kf_.transitionMatrix);
-    kf_.transitionMatrix.at<double>(0, 1) = dt_;
-    kf_.transitionMatrix.at<double>(2, 3) = dt_;
-
+    //
     // Observation Matrix (can only see position directly)
     // [ 1  0  0  0 ]
     // [ 0  0  1  0 ]
-    kf_.measurementMatrix = cv::Mat::zeros(2, 4, CV_64F);
-    kf_.measurementMatrix.at<double>(0, 0) = 1.0;
-    kf_.measurementMatrix.at<double>(1, 2) = 1.0;
-
-    // Noise covariance matrix (see pp13-15 of MWL.JPN.105.02.002 for derivation)
-    // [ dt_^4/4 dt_^3/2 		       ]
-    // [ dt_^3/2 dt_^2   		       ]
-    // [               dt_^4/2 dt_^2/3 ] * sigma_accel^2
-    // [               dt_^2/3 dt_^2   ]
-    kf_.processNoiseCov = cv::Mat::zeros(4, 4, CV_64F);
-    kf_.processNoiseCov.at<double>(0, 0) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_ * dt_) / 4.0;
-    kf_.processNoiseCov.at<double>(0, 1) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_) / 2.0;
-
-    kf_.processNoiseCov.at<double>(1, 0) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_) / 2.0;
-    kf_.processNoiseCov.at<double>(1, 1) = sig_accel_ * sig_accel_ * (dt_ * dt_);
-
-    kf_.processNoiseCov.at<double>(2, 2) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_ * dt_) / 4.0;
-    kf_.processNoiseCov.at<double>(2, 3) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_) / 2.0;
-
-    kf_.processNoiseCov.at<double>(3, 2) = sig_accel_ * sig_accel_ * (dt_ * dt_ * dt_) / 2.0;
-    kf_.processNoiseCov.at<double>(3, 3) = sig_accel_ * sig_accel_ * (dt_ * dt_);
-
-    // Measurement noise covariance
-    // [ sig_x^2  0 ]
-    // [ 0  sig_y^2 ]
-    cv::setIdentity(kf_.measurementNoiseCov, cv::Scalar(sig_measure_noise_ * sig_measure_noise_));
+    //
+    // Both, and the noise covariances, are block diagonal, so each axis is
+    // filtered separately by kf_
+    model_.set(dt_, sig_accel_, sig_measure_noise_);
 }
 
 void KalmanFilter2D::tune() {
 
-    // TODO: The display output of this tuning feature is pretty useless. The constant
-    // rescaling makes it very difficult to get a sense of the absolute accuracy of
-    // filtering and how parameters affect this over time.
-    if (tuning_on_) {
-
-        if (!tuning_windows_created_) {
-            createTuningWindows();
-        }
-
-        // Use the new parameters to create new static filter matracies
-        sig_accel_ = static_cast<double>(sig_accel_tune_);
-        sig_measure_noise_ = static_cast<double>(sig_measure_noise_tune_);
-        initializeStaticMatracies();
-
-        //cv::Mat tuning_canvas(canvas_hw, canvas_hw, CV_8UC3);
-        //tuning_canvas.setTo(255);
-        //drawPosition(tuning_canvas, raw_position);
-        //drawPosition(tuning_canvas, filtered_position);
-
-        // Draw the result, update sliders
-        //cv::imshow(tuning_image_title_, tuning_canvas);
-
-        // If user hits escape, close the tuning windows
-        char user_input;
-        user_input = cv::waitKey(1);
-        if (user_input == 27) { // Capture 'ESC' key
-            tuning_on_ = false;
-        }
-
-    } else if (!tuning_on_ && tuning_windows_created_) {
-        // Destroy the tuning windows
-
-        // TODO: Window will not actually close!!
-        cv::destroyWindow(tuning_image_title_);
-        tuning_windows_created_ = false;
+    if (!tuner_)
+        return;
 
+    // Stop tuning once the user closes the window
+    if (tuner_->closed()) {
+        tuner_.reset();
+        return;
     }
+
+    // Use the slider values, which the display thread updates, to create new
+    // static filter matrices
+    sig_accel_ = static_cast<double>(sig_accel_tune_);
+    sig_measure_noise_ = static_cast<double>(sig_measure_noise_tune_);
+    initializeModel();
 }
 
 void KalmanFilter2D::createTuningWindows() {
@@ -256,12 +378,8 @@ void KalmanFilter2D::createTuningWindows() {
     cv::namedWindow(tuning_image_title_, cv::WINDOW_AUTOSIZE);
 
     // Create sliders and insert them into window
-    sig_accel_tune_ = static_cast<int>(sig_accel_);
-    sig_measure_noise_tune_ = static_cast<int>(sig_measure_noise_);
     cv::createTrackbar("SIGMA ACCEL.", tuning_image_title_, &sig_accel_tune_, 1000);
     cv::createTrackbar("SIGMA NOISE", tuning_image_title_, &sig_measure_noise_tune_, 10);
-
-    tuning_windows_created_ = true;
 }
 
 //void KalmanFilter2D::drawPosition(cv::Mat& canvas, const datatypes::Position2D& position) {
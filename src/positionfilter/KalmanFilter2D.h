@@ -21,9 +21,12 @@
 #define	OAT_KALMANFILTER2D_H
 
 #include "PositionFilter.h"
+#include "ConstantVelocityKalman.h"
 
+#include <memory>
 #include <string>
-#include <opencv2/opencv.hpp>
+
+#include "../../lib/utility/TuningDisplay.h"
 
 namespace oat {
 
@@ -44,15 +47,28 @@ public:
     KalmanFilter2D(const std::string &position_source_address,
                    const std::string& position_sink_address);
 
+    /**
+     * Filter a binary position file. If smoothing is enabled, the file is
+     * read whole and each track is smoothed with a Rauch-Tung-Striebel
+     * fixed-interval smoother, tracks in parallel.
+     */
+    uint64_t filterFile(const std::string &in_path,
+                        const std::string &out_path) override;
+
 private:
     // Configurable Interface
     po::options_description options() const override;
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
-    // Kalman state estimate and measurement vectors
-    cv::Mat_<double> kf_predicted_state_ {4, 1, CV_64F};
-    cv::Mat_<double> kf_meas_ {2, 1, CV_64F};
+    // Runtime parameters
+    oat::CommandDescription parameters(void) override;
+    void applyParameters(const po::variables_map &vm,
+                         const config::OptionTable &config_table) override;
+
+    // Kalman state prediction and measurement
+    ConstantVelocityKalman::Axis predicted_x_, predicted_y_;
+    double meas_x_ {0}, meas_y_ {0};
 
     // Sample period
     double dt_ {0.02};
@@ -63,19 +79,22 @@ private:
 
     // Parameter tuning
     std::string tuning_image_title_;
-    bool tuning_windows_created_ {false};
+    std::unique_ptr<oat::TuningDisplay> tuner_;
     int sig_accel_tune_;
     int sig_measure_noise_tune_;
-    bool tuning_on_ {false};
     //float draw_scale_ {10.0};
 
+    // Offline fixed-interval smoothing
+    bool smooth_ {false};
+
     // Variables and parameters to control whether or not to apply the filter
     bool found_ {false};
     int not_found_count_ {0};
     int not_found_count_threshold_ {0};
 
     // Kalman filter object
-    cv::KalmanFilter kf_ {4, 2, 0, CV_64F};
+    ConstantVelocityModel model_;
+    ConstantVelocityKalman kf_;
 
     /**
      * Perform Kalman filtering.
@@ -86,7 +105,7 @@ private:
     // Subroutines
     void tune(void);
     void initializeFilter(void);
-    void initializeStaticMatracies(void);
+    void initializeModel(void);
     void createTuningWindows(void);
     //void drawPosition(cv::Mat& canvas, const oat::Position2D& position);
 };
@@ -0,0 +1,307 @@
+//******************************************************************************
+//* File:   MultiTargetTracker.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "MultiTargetTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+MultiTargetTracker::MultiTargetTracker(
+    const std::string &position_source_address,
+    const std::string &position_sink_address)
+: PositionFilter(position_source_address, position_sink_address)
+, objects_source_address_(position_source_address)
+, tracks_sink_address_(position_sink_address)
+{
+    // Nothing
+}
+
+po::options_description MultiTargetTracker::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("dt", po::value<double>(),
+         "Kalman filter time step in seconds. Defaults to the SOURCE sample "
+         "period.")
+        ("sigma-accel,a", po::value<double>(),
+         "Standard deviation of normally distributed, random accelerations used "
+         "by the internal model of object motion (position units/s2; e.g. "
+         "pixels/s2). Defaults to 5.")
+        ("sigma-noise,n", po::value<double>(),
+         "Standard deviation of randomly distributed position measurement noise "
+         "(position units; e.g. pixels). Defaults to 0.")
+        ("gate,g", po::value<double>(),
+         "Largest distance between the predicted position of a track and an "
+         "object assigned to it (position units; e.g. pixels). Defaults to "
+         "25.")
+        ("timeout,T", po::value<double>(),
+         "Seconds that a track is kept, and its position predicted, without "
+         "detections. Defaults to 0.5.")
+        ("confirm", po::value<int>(),
+         "Number of consecutive samples in which a new track must be detected "
+         "before it is published. Defaults to 1.")
+        ;
+
+    return local_opts;
+}
+
+void MultiTargetTracker::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Time step
+    oat::config::getNumericValue<double>(vm, config_table, "dt", dt_, 0);
+
+    // Sigma accel
+    oat::config::getNumericValue<double>(
+        vm, config_table, "sigma-accel", sig_accel_, 0);
+
+    // Sigma noise
+    oat::config::getNumericValue<double>(
+        vm, config_table, "sigma-noise", sig_measure_noise_, 0);
+
+    // Gate
+    oat::config::getNumericValue<double>(vm, config_table, "gate", gate_, 0);
+    if (gate_ == 0)
+        throw std::runtime_error("gate must be greater than 0.");
+
+    // Track timeout
+    oat::config::getNumericValue<double>(
+        vm, config_table, "timeout", timeout_, 0);
+
+    // Confirmation
+    oat::config::getNumericValue<int>(
+        vm, config_table, "confirm", confirm_hits_, 1);
+}
+
+bool MultiTargetTracker::connectToNode()
+{
+    // Establish our a slot in the node
+    objects_source_.touch(objects_source_address_);
+
+    // Wait for synchronous start with sink when it binds the node
+    if (objects_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    // Time step defaults to the sample period of the detector
+    if (dt_ == 0)
+        dt_ = objects_source_.retrieve()->sample_period_sec();
+    if (!(dt_ > 0))
+        throw std::runtime_error("SOURCE has no sample period, so dt must be "
+                                 "specified.");
+
+    model_.set(dt_, sig_accel_, sig_measure_noise_);
+    max_misses_ = static_cast<int>(std::round(timeout_ / dt_));
+
+    // Bind to sink sink node and create a shared position array
+    tracks_sink_.bind(tracks_sink_address_);
+
+    return true;
+}
+
+int MultiTargetTracker::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sink to write to node
+    if (objects_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // Copy the shared objects
+    objects_ = *objects_source_.retrieve();
+
+    // Tell sink it can continue
+    objects_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    track(objects_, tracks_);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    tracks_sink_.wait();
+
+    *tracks_sink_.retrieve() = tracks_;
+
+    // Tell sources there is new data
+    tracks_sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    // Sink was not at END state
+    return 0;
+}
+
+int64_t MultiTargetTracker::cellKey(const double x,
+                                    const double y,
+                                    const int dx,
+                                    const int dy) const
+{
+    // Cells of one row are contiguous, so the three cells of a row around a
+    // point form one key range
+    constexpr double lim {1e9};
+    const auto cx = static_cast<int64_t>(
+        std::max(-lim, std::min(lim, std::floor(x / gate_)))) + dx;
+    const auto cy = static_cast<int64_t>(
+        std::max(-lim, std::min(lim, std::floor(y / gate_)))) + dy;
+
+    return cy * (int64_t {1} << 32) + cx;
+}
+
+void MultiTargetTracker::removeTrack(const size_t i)
+{
+    // Both move the last track to i
+    kf_.erase(i);
+    tracks_info_[i] = tracks_info_.back();
+    tracks_info_.pop_back();
+}
+
+void MultiTargetTracker::track(const oat::PositionArray &objects,
+                               oat::PositionArray &tracks)
+{
+    kf_.predict(model_);
+
+    const size_t num_tracks = kf_.size();
+    const double gate2 = gate_ * gate_;
+
+    // Sort objects by grid cell
+    cells_.clear();
+    for (size_t j = 0; j < objects.size(); j++)
+        if (objects.valid[j])
+            cells_.push_back({cellKey(objects.x[j], objects.y[j], 0, 0), j});
+    std::sort(cells_.begin(), cells_.end());
+
+    // Candidate pairs: objects in the 3x3 cells around each track
+    pairs_.clear();
+    for (size_t i = 0; i < num_tracks; i++) {
+
+        const double x = kf_.x(i);
+        const double y = kf_.y(i);
+
+        for (int dy = -1; dy <= 1; dy++) {
+
+            const auto lo = std::lower_bound(
+                cells_.begin(), cells_.end(), Cell {cellKey(x, y, -1, dy), 0});
+            const auto hi = std::upper_bound(
+                lo, cells_.end(), Cell {cellKey(x, y, 1, dy), 0});
+
+            for (auto c = lo; c != hi; ++c) {
+                const double ex = objects.x[c->object] - x;
+                const double ey = objects.y[c->object] - y;
+                const double d2 = ex * ex + ey * ey;
+                if (d2 <= gate2)
+                    pairs_.push_back({d2, i, c->object});
+            }
+        }
+    }
+
+    // Assign closest pairs first
+    std::sort(pairs_.begin(), pairs_.end());
+    track_assigned_.assign(num_tracks, 0);
+    object_track_.assign(objects.size(), -1);
+
+    for (const auto &p : pairs_) {
+        if (track_assigned_[p.track] || object_track_[p.object] >= 0)
+            continue;
+
+        track_assigned_[p.track] = 1;
+        object_track_[p.object] = static_cast<int>(p.track);
+        kf_.measure(p.track, objects.x[p.object], objects.y[p.object]);
+
+        auto &t = tracks_info_[p.track];
+        t.hits++;
+        t.misses = 0;
+        t.area = objects.area[p.object];
+        if (t.hits >= confirm_hits_)
+            t.confirmed = true;
+    }
+
+    kf_.correct(model_);
+
+    // Drop tracks that timed out, and tentative tracks that were missed.
+    // Going backwards, the track moved into a removed slot was already seen.
+    for (size_t i = num_tracks; i-- > 0;) {
+
+        auto &t = tracks_info_[i];
+        if (track_assigned_[i])
+            continue;
+
+        t.misses++;
+        if (t.misses > max_misses_ || !t.confirmed)
+            removeTrack(i);
+    }
+
+    // Unassigned objects start new tracks
+    size_t births = 0;
+    for (size_t j = 0; j < objects.size(); j++)
+        if (objects.valid[j] && object_track_[j] < 0)
+            births++;
+    births = std::min(births, PositionArray::CAPACITY - kf_.size());
+
+    if (births > 0) {
+
+        size_t i = kf_.size();
+        kf_.resize(i + births);
+
+        for (size_t j = 0; j < objects.size() && i < kf_.size(); j++) {
+            if (!objects.valid[j] || object_track_[j] >= 0)
+                continue;
+
+            kf_.init(i++, objects.x[j], objects.y[j]);
+
+            Track t;
+            t.id = next_id_++;
+            t.hits = 1;
+            t.area = objects.area[j];
+            t.confirmed = confirm_hits_ <= 1;
+            tracks_info_.push_back(t);
+        }
+    }
+
+    // Publish confirmed tracks
+    tracks.clear();
+    tracks.set_sample(objects.sample());
+    tracks.set_unit_of_length(objects.unit_of_length());
+
+    for (size_t i = 0; i < kf_.size(); i++) {
+
+        const auto &t = tracks_info_[i];
+        if (!t.confirmed)
+            continue;
+
+        const size_t k = tracks.size();
+        tracks.push(kf_.x(i), kf_.y(i), t.area);
+        tracks.id[k] = t.id;
+    }
+}
+
+} /* namespace oat */
@@ -0,0 +1,147 @@
+//******************************************************************************
+//* File:   MultiTargetTracker.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_MULTITARGETTRACKER_H
+#define	OAT_MULTITARGETTRACKER_H
+
+#include "PositionFilter.h"
+#include "ConstantVelocityKalman.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../lib/datatypes/PositionArray.h"
+
+namespace oat {
+
+class MultiTargetTracker : public PositionFilter {
+
+public:
+    /**
+     * A multi-target tracker.
+     * Each track is a constant velocity Kalman filter, using the same model
+     * as the kalman filter. Every sample, the objects in a SOURCE position
+     * array are assigned to the predicted tracks by gated, global nearest
+     * neighbour association: candidate pairs within the gate are found
+     * through a grid of gate sized cells and assigned closest first.
+     * Unassigned objects start new tracks, and tracks that go undetected for
+     * too long are dropped. Tracks are published as a position array in
+     * which each entry keeps the ID of its track for the track's lifetime.
+     * @param position_source_address Un-filtered position array SOURCE name
+     * @param position_sink_address Track position array SINK name
+     */
+    MultiTargetTracker(const std::string &position_source_address,
+                       const std::string &position_sink_address);
+
+    bool ready(void) const override
+    {
+        return objects_source_.readable() && tracks_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        return {&objects_source_.sample_event(), tracks_sink_.sample_event()};
+    }
+
+    // Position arrays are not recorded to position files
+    uint64_t filterFile(const std::string &, const std::string &) override
+    {
+        throw std::runtime_error("The tracker cannot filter position files.");
+    }
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Position arrays are filtered instead
+    void filter(oat::Position2D &) override { }
+
+    /**
+     * Update tracks with the objects detected in a sample.
+     * @param objects Detected objects
+     * @param tracks Published tracks
+     */
+    void track(const oat::PositionArray &objects, oat::PositionArray &tracks);
+
+    // Detected object SOURCE and track SINK
+    const std::string objects_source_address_;
+    oat::Source<oat::PositionArray> objects_source_;
+    const std::string tracks_sink_address_;
+    oat::Sink<oat::PositionArray> tracks_sink_;
+    oat::PositionArray objects_;
+    oat::PositionArray tracks_;
+
+    // Motion model
+    double dt_ {0.0};
+    double sig_accel_ {5.0};
+    double sig_measure_noise_ {0.0};
+    ConstantVelocityModel model_;
+
+    // Association gate radius
+    double gate_ {25.0};
+
+    // Samples a track is kept for without detections
+    double timeout_ {0.5};
+    int max_misses_ {0};
+
+    // Consecutive detections before a track is published
+    int confirm_hits_ {1};
+
+    // Tracks. kf_ track i is tracks_info_[i].
+    struct Track {
+        uint32_t id {0};
+        int hits {0};
+        int misses {0};
+        bool confirmed {false};
+        double area {0};
+    };
+    ConstantVelocityKalmanBatch kf_;
+    std::vector<Track> tracks_info_;
+    uint32_t next_id_ {0};
+
+    // Association scratch space, reused each sample
+    struct Cell {
+        int64_t key;
+        size_t object;
+        bool operator<(const Cell &rhs) const { return key < rhs.key; }
+    };
+    struct Pair {
+        double d2;
+        size_t track;
+        size_t object;
+        bool operator<(const Pair &rhs) const { return d2 < rhs.d2; }
+    };
+    std::vector<Cell> cells_;
+    std::vector<Pair> pairs_;
+    std::vector<char> track_assigned_;
+    std::vector<int> object_track_;
+
+    int64_t cellKey(double x, double y, int dx, int dy) const;
+    void removeTrack(size_t i);
+};
+
+}      /* namespace oat */
+#endif /* OAT_MULTITARGETTRACKER_H */
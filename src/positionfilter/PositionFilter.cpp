@@ -17,10 +17,19 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "PositionFilter.h"
 
+#include "../../lib/base/Profiler.h"
+#include "../recorder/Format.h"
+
 namespace oat {
 
 PositionFilter::PositionFilter(const std::string &position_source_address,
@@ -43,7 +52,6 @@ bool PositionFilter::connectToNode()
 
     // Bind to sink sink node and create a shared position
     position_sink_.bind(position_sink_address_, position_sink_address_);
-    shared_position_ = position_sink_.retrieve();
 
     return true;
 }
@@ -54,30 +62,37 @@ int PositionFilter::process()
     ////////////////////////////
 
     // Wait for sink to write to node
+    OAT_PHASE(WAIT_SOURCE);
     if (position_source_.wait() == oat::NodeState::END)
         return 1;
 
-    // Clone the shared frame
-    internal_position_ = position_source_.clone();
+    // Copy the shared position
+    OAT_PHASE(COPY_IN);
+    position_source_.copyTo(internal_position_);
 
     // Tell sink it can continue
+    OAT_PHASE(PUBLISH);
     position_source_.post();
 
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
     // Mess with internal frame
+    OAT_PHASE(COMPUTE);
     filter(internal_position_);
 
     // START CRITICAL SECTION //
     ////////////////////////////
 
     // Wait for sources to read
+    OAT_PHASE(WAIT_SINK);
     position_sink_.wait();
 
-    *shared_position_ = internal_position_;
+    OAT_PHASE(COPY_OUT);
+    position_sink_.write(internal_position_);
 
     // Tell sources there is new data
+    OAT_PHASE(PUBLISH);
     position_sink_.post();
 
     ////////////////////////////
@@ -87,4 +102,93 @@ int PositionFilter::process()
     return 0;
 }
 
+uint64_t PositionFilter::filterFile(const std::string &in_path,
+                                    const std::string &out_path)
+{
+    std::ifstream in;
+    const uint64_t n = openPositionFile(in, in_path);
+    FILE *out = createPositionFile(out_path);
+
+    // Positions are filtered in place in the batch they were read into
+    std::vector<char> batch(FILE_BATCH * oat::Position2D::NPY_DTYPE_BYTES);
+    uint64_t done = 0;
+    while (done < n) {
+
+        const size_t rows = std::min<uint64_t>(FILE_BATCH, n - done);
+        const size_t bytes = rows * oat::Position2D::NPY_DTYPE_BYTES;
+        in.read(batch.data(), bytes);
+        if (!in) {
+            fclose(out);
+            throw std::runtime_error("Could not read " + in_path + ".");
+        }
+
+        for (size_t i = 0; i < rows; i++) {
+            char *record = batch.data() + i * oat::Position2D::NPY_DTYPE_BYTES;
+            oat::unpackPosition(record, internal_position_);
+            filter(internal_position_);
+            oat::packPosition(internal_position_, record);
+        }
+
+        if (fwrite(batch.data(), 1, bytes, out) != bytes) {
+            fclose(out);
+            throw std::runtime_error("Could not write " + out_path + ".");
+        }
+        done += rows;
+    }
+
+    closePositionFile(out, out_path, done);
+
+    return done;
+}
+
+uint64_t PositionFilter::openPositionFile(std::ifstream &in,
+                                          const std::string &path)
+{
+    in.open(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        throw std::runtime_error("Could not open position file " + path + ".");
+    const size_t file_bytes = in.tellg();
+    in.seekg(0);
+
+    // Header prefix: magic number, npy version, header length
+    char prefix[NPY_PREFIX_LEN];
+    in.read(prefix, sizeof(prefix));
+    if (!in || std::memcmp(prefix, "\x93NUMPY", 6) != 0 || prefix[6] != 1)
+        throw std::runtime_error(path + " is not a version 1.0 NPY file.");
+
+    const size_t dict_len = static_cast<uint8_t>(prefix[8])
+                            | static_cast<uint8_t>(prefix[9]) << 8;
+    std::string dict(dict_len, ' ');
+    in.read(&dict[0], dict_len);
+    if (!in || dict.find(oat::Position2D::NPY_DTYPE) == std::string::npos)
+        throw std::runtime_error(path + " does not hold positions.");
+
+    // The records present, rather than the shape in the header, which a
+    // recording that was cut short only counts up to its last checkpoint
+    const size_t header_bytes = NPY_PREFIX_LEN + dict_len;
+    return (file_bytes - header_bytes) / oat::Position2D::NPY_DTYPE_BYTES;
+}
+
+FILE *PositionFilter::createPositionFile(const std::string &path)
+{
+    FILE *out = fopen(path.c_str(), "wb");
+    if (!out)
+        throw std::runtime_error("Could not open position file " + path
+                                 + " for writing.");
+
+    auto header = getNumpyHeader(oat::Position2D::NPY_DTYPE);
+    fwrite(header.data(), 1, header.size(), out);
+
+    return out;
+}
+
+void PositionFilter::closePositionFile(FILE *out,
+                                       const std::string &path,
+                                       const uint64_t n)
+{
+    emplaceNumpyShape(out, n);
+    if (fclose(out) != 0)
+        throw std::runtime_error("Could not write " + path + ".");
+}
+
 } /* namespace oat */
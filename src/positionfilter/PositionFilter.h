@@ -20,12 +20,15 @@
 #ifndef OAT_POSITIONFILTER_H
 #define	OAT_POSITIONFILTER_H
 
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <string>
 
 #include <boost/program_options.hpp>
 
-#include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
+#include "../../lib/base/ControllableComponent.h"
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
@@ -34,7 +37,15 @@ namespace po = boost::program_options;
 
 namespace oat {
 
-class PositionFilter : public Component, public Configurable<false> {
+namespace fuse { struct Access; }
+
+class PositionFilter : public ControllableComponent, public Configurable<true> {
+
+// Applies other filters to its positions
+friend class PositionFilterChain;
+
+// Applies its filter within fused chains
+friend fuse::Access;
 
 public:
     /**
@@ -50,6 +61,28 @@ public:
     // Component Interface
     oat::ComponentType type(void) const override { return oat::positionfilter; };
     std::string name(void) const override { return name_; }
+    bool ready(void) const override
+    {
+        return position_source_.readable() && position_sink_.writable();
+    }
+    std::vector<SampleEvent *> events(void) const override
+    {
+        return {&position_source_.sample_event(),
+                position_sink_.sample_event()};
+    }
+
+    /**
+     * Filter a binary (NPY) position file, such as those written by
+     * oat-record, without shared memory. Positions are read, filtered and
+     * written a batch at a time in a tight loop rather than at the rate they
+     * were recorded. Call instead of run(), after configure().
+     * @param in_path Position file to filter
+     * @param out_path Position file to write filtered positions to.
+     * Truncated if it exists.
+     * @return Number of positions filtered
+     */
+    virtual uint64_t filterFile(const std::string &in_path,
+                                const std::string &out_path);
 
 protected:
     /**
@@ -58,7 +91,34 @@ protected:
      */
     virtual void filter(oat::Position2D &position) = 0;
 
+    /**
+     * Open a binary position file and check that it holds positions.
+     * @param in Stream to open. Left at the first record.
+     * @param path Position file
+     * @return Number of records in the file
+     */
+    static uint64_t openPositionFile(std::ifstream &in, const std::string &path);
+
+    /**
+     * Create a binary position file and write its header. Truncated if it
+     * exists.
+     * @param path Position file
+     */
+    static FILE *createPositionFile(const std::string &path);
+
+    /**
+     * Record the number of positions written to a file from
+     * createPositionFile() in its header, and close it.
+     */
+    static void closePositionFile(FILE *out,
+                                  const std::string &path,
+                                  const uint64_t n);
+
 private:
+    // ControllableComponent Interface
+    oat::CommandDescription commands(void) override { return {}; }
+    void applyCommand(const std::string &command) override { }
+
     // Component Interface
     virtual bool connectToNode(void) override;
     int process(void) override;
@@ -70,12 +130,12 @@ private:
     const std::string position_source_address_;
     oat::Source<oat::Position2D> position_source_;
 
+    // Positions per read and write of filterFile()
+    static constexpr size_t FILE_BATCH {4096};
+
     // Internal, mutable position
     oat::Position2D internal_position_ {"internal"};
 
-    // Shared position
-    oat::Position2D * shared_position_;
-
     // Position SINK
     const std::string position_sink_address_;
     oat::Sink<oat::Position2D> position_sink_;
@@ -0,0 +1,150 @@
+//******************************************************************************
+//* File:   PositionFilterChain.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "PositionFilterChain.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
+
+#include "HomographyTransform2D.h"
+#include "KalmanFilter2D.h"
+#include "PositionPredictor.h"
+#include "RegionFilter2D.h"
+#include "UndistortTransform2D.h"
+
+namespace oat {
+
+PositionFilterChain::PositionFilterChain(
+    const std::string &position_source_address,
+    const std::string &position_sink_address)
+: PositionFilter(position_source_address, position_sink_address)
+, source_address_(position_source_address)
+, sink_address_(position_sink_address)
+{
+    // Nothing
+}
+
+po::options_description PositionFilterChain::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("stages", po::value<std::string>(),
+         "Array of strings, e.g. [\"kalman\",\"homography\",\"region\"], "
+         "specifying the position filters to apply, in order. Each may appear "
+         "once.")
+        ("kalman", po::value<std::string>(),
+         "Key of the table, in the configuration file given with --config, "
+         "that configures the kalman stage, as it would the kalman TYPE.")
+        ("undistort", po::value<std::string>(),
+         "Key of the table, in the configuration file given with --config, "
+         "that configures the undistort stage, as it would the undistort "
+         "TYPE.")
+        ("homography", po::value<std::string>(),
+         "Key of the table, in the configuration file given with --config, "
+         "that configures the homography stage, as it would the homography "
+         "TYPE.")
+        ("region", po::value<std::string>(),
+         "Key of the table, in the configuration file given with --config, "
+         "that configures the region stage, as it would the region TYPE.")
+        ("predict", po::value<std::string>(),
+         "Key of the table, in the configuration file given with --config, "
+         "that configures the predict stage, as it would the predict TYPE.")
+        ;
+
+    return local_opts;
+}
+
+void PositionFilterChain::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Stages
+    std::vector<std::string> stages;
+    oat::config::getArray(vm, config_table, "stages", stages, true);
+
+    // Stage tables are looked up in this component's configuration file
+    std::string file;
+    if (!vm["config"].empty())
+        file = vm["config"].as<std::vector<std::string>>()[0];
+
+    stages_.clear();
+    for (size_t i = 0; i < stages.size(); i++) {
+
+        const auto &s = stages[i];
+        if (std::find(stages.begin(), stages.begin() + i, s)
+            != stages.begin() + i)
+            throw std::runtime_error("Chain stage '" + s + "' is listed more "
+                                     "than once.");
+
+        std::unique_ptr<PositionFilter> stage;
+        if (s == "kalman")
+            stage = oat::make_unique<KalmanFilter2D>(source_address_, sink_address_);
+        else if (s == "homography")
+            stage = oat::make_unique<HomographyTransform2D>(source_address_, sink_address_);
+        else if (s == "region")
+            stage = oat::make_unique<RegionFilter2D>(source_address_, sink_address_);
+        else if (s == "undistort")
+            stage = oat::make_unique<UndistortTransform2D>(source_address_, sink_address_);
+        else if (s == "predict")
+            stage = oat::make_unique<PositionPredictor>(source_address_, sink_address_);
+        else
+            throw std::runtime_error("Unknown chain stage '" + s + "'. Use "
+                                     "kalman, undistort, homography, "
+                                     "region or predict.");
+
+        // Configure the stage just as its own program would, from a
+        // '--config file key' pair
+        std::string key;
+        std::vector<std::string> args;
+        if (oat::config::getValue(vm, config_table, s, key)) {
+            if (file.empty())
+                throw std::runtime_error("Chain stage '" + s + "' must be "
+                                         "configured from the file given "
+                                         "with --config.");
+            args = {"--config", file, key};
+        }
+
+        po::options_description opts;
+        stage->appendOptions(opts);
+
+        po::variables_map stage_vm;
+        po::store(po::command_line_parser(args).options(opts).run(), stage_vm);
+        po::notify(stage_vm);
+
+        stage->configure(stage_vm);
+
+        stages_.push_back(std::move(stage));
+    }
+}
+
+void PositionFilterChain::filter(oat::Position2D &position)
+{
+    for (auto &s : stages_)
+        s->filter(position);
+}
+
+} /* namespace oat */
@@ -0,0 +1,67 @@
+//******************************************************************************
+//* File:   PositionFilterChain.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_POSITIONFILTERCHAIN_H
+#define	OAT_POSITIONFILTERCHAIN_H
+
+#include "PositionFilter.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace oat {
+
+class PositionFilterChain : public PositionFilter {
+
+public:
+    /**
+     * A chain of position filters.
+     * Applies an ordered list of kalman, undistort, homography, region and
+     * predict filters to each position within one component, so that the
+     * chain costs a single pair of shared memory exchanges instead of one per
+     * filter.
+     * @param position_source_address Un-filtered position SOURCE name
+     * @param position_sink_address Filtered position SINK name
+     */
+    PositionFilterChain(const std::string &position_source_address,
+                        const std::string &position_sink_address);
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Addresses handed to stages, which only use them for their names
+    const std::string source_address_;
+    const std::string sink_address_;
+
+    // Filters, in order of application
+    std::vector<std::unique_ptr<PositionFilter>> stages_;
+
+    /**
+     * Apply each filter in turn.
+     * @param position Position to filter
+     */
+    void filter(oat::Position2D &position) override;
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONFILTERCHAIN_H */
@@ -0,0 +1,96 @@
+//******************************************************************************
+//* File:   PositionPredictor.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+#include "PositionPredictor.h"
+
+namespace oat {
+
+po::options_description PositionPredictor::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("lead", po::value<double>(),
+         "Time, in ms, by which positions are extrapolated beyond the time "
+         "since their sample was captured, to cover the components that read "
+         "SINK, e.g. a controller and its output device. Defaults to 0.")
+        ("max-lead", po::value<double>(),
+         "Furthest, in ms, that a position is extrapolated, however old its "
+         "sample. Bounds the error of predictions when the pipeline stalls. "
+         "Defaults to 100.")
+        ;
+
+    return local_opts;
+}
+
+void PositionPredictor::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Lead
+    double ms {0.0};
+    if (oat::config::getNumericValue<double>(vm, config_table, "lead", ms, 0.0))
+        lead_sec_ = ms / 1000.0;
+
+    // Horizon
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "max-lead", ms, 0.0))
+        max_lead_sec_ = ms / 1000.0;
+}
+
+void PositionPredictor::filter(oat::Position2D &position)
+{
+    if (!position.position_valid)
+        return;
+
+    // Velocity from the last displacement, if the position has none
+    const uint64_t usec = position.sample_usec();
+    auto velocity = position.velocity;
+    bool moving = position.velocity_valid;
+    if (!moving && last_valid_ && usec > last_usec_) {
+        velocity = (position.position - last_position_)
+                   * (1.0e6 / static_cast<double>(usec - last_usec_));
+        moving = true;
+    }
+
+    last_position_ = position.position;
+    last_usec_ = usec;
+    last_valid_ = true;
+
+    if (!moving)
+        return;
+
+    // The sample's age is the latency of every hop since capture, as of
+    // now. Positions without a capture time are extrapolated by the lead
+    // alone.
+    const double age_sec = std::chrono::duration<double>(
+        position.sample().latency()).count();
+    const double horizon = std::min(age_sec + lead_sec_, max_lead_sec_);
+
+    position.position += velocity * horizon;
+    position.velocity = velocity;
+    position.velocity_valid = true;
+}
+
+} /* namespace oat */
@@ -0,0 +1,70 @@
+//******************************************************************************
+//* File:   PositionPredictor.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_POSITIONPREDICTOR_H
+#define	OAT_POSITIONPREDICTOR_H
+
+#include "PositionFilter.h"
+
+#include <cstdint>
+#include <string>
+#include <opencv2/core/types.hpp>
+
+namespace oat {
+
+class PositionPredictor : public PositionFilter {
+
+public:
+    /**
+     * A latency compensating predictor.
+     * Extrapolates each position, at constant velocity, by the time since its
+     * sample was captured plus a fixed lead, so that SINK carries an estimate
+     * of where the object is as the position is published rather than where
+     * it was when its frame was captured. The velocity is that of the
+     * position, e.g. from a kalman filter, if it is valid, and otherwise
+     * that of the displacement since the last valid position.
+     */
+    using PositionFilter::PositionFilter;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Time added to the age of each sample, to cover hops after this one,
+    // and the furthest a position is extrapolated, in seconds
+    double lead_sec_ {0.0};
+    double max_lead_sec_ {0.1};
+
+    // Last valid position and the time of its sample, to estimate velocity
+    // from
+    bool last_valid_ {false};
+    cv::Point2d last_position_;
+    uint64_t last_usec_ {0};
+
+    /**
+     * Extrapolate the position to the present.
+     * @param position Position to be extrapolated
+     */
+    void filter(oat::Position2D &position) override;
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONPREDICTOR_H */
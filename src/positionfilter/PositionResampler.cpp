@@ -0,0 +1,237 @@
+//******************************************************************************
+//* File:   PositionResampler.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "PositionResampler.h"
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include <cpptoml.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+// Spin time that makes every wait for a deadline a busy wait
+static constexpr double BUSY_SPIN_SEC {1.0};
+
+static int64_t nowNs(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t toNs(const double sec)
+{
+    return static_cast<int64_t>(std::llround(sec * 1e9));
+}
+
+PositionResampler::PositionResampler(
+    const std::string &position_source_address,
+    const std::string &position_sink_address)
+: PositionFilter(position_source_address, position_sink_address)
+, source_address_(position_source_address)
+, sink_address_(position_sink_address)
+{
+    // Nothing
+}
+
+po::options_description PositionResampler::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("rate,r", po::value<double>(),
+         "Positions published per second, on absolute deadlines. Defaults to "
+         "1000.")
+        ("delay,d", po::value<double>(),
+         "Seconds by which published positions lag SOURCE, so that each can "
+         "be linearly interpolated between the SOURCE positions captured "
+         "around its deadline minus the delay. Should be at least the SOURCE "
+         "sample period. Defaults to 0, which holds the latest SOURCE "
+         "position at each deadline instead and adds no more than one "
+         "period of latency.")
+        ("max-age", po::value<double>(),
+         "Seconds since the SOURCE position was captured after which it is "
+         "published as invalid, e.g. if the detector stalls. Defaults to 0, "
+         "which keeps it valid.")
+        ("spin", po::value<double>(),
+         "Microseconds before each deadline that are busy waited instead of "
+         "slept, so that positions are published at exact times at high "
+         "rates. Occupies a core while waiting. Defaults to 0.")
+        ("busy",
+         "Busy wait for every deadline rather than sleeping. Occupies a "
+         "core.")
+        ;
+
+    return local_opts;
+}
+
+void PositionResampler::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Rate
+    oat::config::getNumericValue<double>(
+        vm, config_table, "rate", rate_hz_, 0);
+    if (!(rate_hz_ > 0))
+        throw std::runtime_error("rate must be greater than 0.");
+    pacer_.set_period(std::chrono::duration<double>(1.0 / rate_hz_));
+
+    // Interpolation and expiry
+    double sec;
+    if (oat::config::getNumericValue<double>(vm, config_table, "delay", sec, 0))
+        delay_ns_ = toNs(sec);
+
+    if (oat::config::getNumericValue<double>(vm, config_table, "max-age", sec, 0))
+        max_age_ns_ = toNs(sec);
+
+    // Busy wait before each deadline
+    double spin_us = 0.0;
+    if (oat::config::getNumericValue<double>(vm, config_table, "spin", spin_us, 0))
+        pacer_.set_spin(std::chrono::duration<double, std::micro>(spin_us));
+
+    bool busy = false;
+    oat::config::getValue<bool>(vm, config_table, "busy", busy);
+    if (busy)
+        pacer_.set_spin(std::chrono::duration<double>(BUSY_SPIN_SEC));
+}
+
+bool PositionResampler::connectToNode()
+{
+    // Establish our a slot in the node. Deadlines, not SOURCE, decide
+    // when we read, so the latest position is all we need.
+    source_.touch(source_address_, SourceMode::LATEST);
+
+    // Wait for synchronous start with sink when it binds the node
+    if (source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    // Bind to sink sink node and create a shared position
+    sink_.bind(sink_address_, sink_address_);
+
+    // Pure SINKs set the sample rate
+    clock_ = oat::Sample(1.0 / rate_hz_);
+
+    return true;
+}
+
+int PositionResampler::process()
+{
+    // Deadlines that were missed still advance the sample clock, so sample
+    // times stay on the grid
+    const uint64_t missed = pacer_.wait();
+    for (uint64_t i = 0; i < missed; i++)
+        clock_.incrementCount();
+    clock_.incrementCount();
+
+    const int64_t now_ns = nowNs();
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Take the latest SOURCE position, if there is a new one
+    NodeState state;
+    if (source_.tryWait(state)) {
+
+        if (state == oat::NodeState::END)
+            return 1;
+
+        source_.copyTo(input_);
+        source_.post();
+
+        // Captured positions are placed at their capture time, which is on the
+        // same steady_clock
+        const uint64_t capture_ns = input_.sample().capture_ns();
+        Input in {capture_ns != 0 ? static_cast<int64_t>(capture_ns) : now_ns,
+                  input_};
+        inputs_.push_back(in);
+    }
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    resample(now_ns - delay_ns_, output_);
+    output_.set_sample(clock_);
+
+    // START CRITICAL SECTION //
+    ////////////////////////////
+
+    // Wait for sources to read
+    sink_.wait();
+
+    sink_.write(output_);
+
+    // Tell sources there is new data
+    sink_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    return 0;
+}
+
+void PositionResampler::resample(const int64_t t_ns, oat::Position2D &out) const
+{
+    if (inputs_.empty()) {
+        out.position_valid = out.velocity_valid = out.heading_valid = false;
+        out.region_valid = false;
+        return;
+    }
+
+    // Latest position captured by t, or the oldest kept if none is old
+    // enough
+    size_t i = inputs_.size() - 1;
+    while (i > 0 && inputs_[i].ns > t_ns)
+        i--;
+
+    const auto &a = inputs_[i];
+    out = a.position;
+
+    // Interpolate toward the next position, if there is one after t
+    if (delay_ns_ > 0 && i + 1 < inputs_.size() && a.ns <= t_ns) {
+
+        const auto &b = inputs_[i + 1];
+        const double w = static_cast<double>(t_ns - a.ns) / (b.ns - a.ns);
+
+        // Fields other than position and velocity come from the nearer
+        if (w >= 0.5)
+            out = b.position;
+
+        const auto &pa = a.position, &pb = b.position;
+        if (pa.position_valid && pb.position_valid) {
+            out.position_valid = true;
+            out.position = pa.position + w * (pb.position - pa.position);
+        }
+        if (pa.velocity_valid && pb.velocity_valid) {
+            out.velocity_valid = true;
+            out.velocity = pa.velocity + w * (pb.velocity - pa.velocity);
+        }
+    }
+
+    // Positions that are too old are invalid
+    if (max_age_ns_ > 0 && t_ns - inputs_.back().ns > max_age_ns_) {
+        out.position_valid = out.velocity_valid = out.heading_valid = false;
+        out.region_valid = false;
+    }
+}
+
+} /* namespace oat */
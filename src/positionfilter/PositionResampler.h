@@ -0,0 +1,110 @@
+//******************************************************************************
+//* File:   PositionResampler.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_POSITIONRESAMPLER_H
+#define	OAT_POSITIONRESAMPLER_H
+
+#include "PositionFilter.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <boost/circular_buffer.hpp>
+
+#include "../../lib/datatypes/Sample.h"
+#include "../../lib/utility/Pacer.h"
+
+namespace oat {
+
+class PositionResampler : public PositionFilter {
+
+public:
+    /**
+     * A fixed-clock resampler.
+     * Positions are published at a fixed rate on absolute deadlines, from a
+     * pacer like that of the position generators, regardless of when SOURCE
+     * positions arrive. Each published position is either the latest SOURCE
+     * position, held, or a linear interpolation between the SOURCE positions
+     * around a time a fixed delay before the deadline. Published positions
+     * are numbered and timed by the resampler's own sample clock.
+     * @param position_source_address Un-resampled position SOURCE name
+     * @param position_sink_address Resampled position SINK name
+     */
+    PositionResampler(const std::string &position_source_address,
+                      const std::string &position_sink_address);
+
+    bool ready(void) const override { return true; }
+
+    // Resampling needs the times positions arrive
+    uint64_t filterFile(const std::string &, const std::string &) override
+    {
+        throw std::runtime_error("The resampler cannot filter position files.");
+    }
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Positions are resampled instead
+    void filter(oat::Position2D &) override { }
+
+    /**
+     * Resampled position at a time.
+     * @param t_ns steady_clock time, in nanoseconds.
+     * @param out Position to publish.
+     */
+    void resample(const int64_t t_ns, oat::Position2D &out) const;
+
+    // SOURCE, read for the latest position at each deadline, and SINK
+    const std::string source_address_;
+    oat::Source<oat::Position2D> source_;
+    const std::string sink_address_;
+    oat::Sink<oat::Position2D> sink_;
+
+    // Publication clock
+    double rate_hz_ {1000.0};
+    oat::Pacer pacer_;
+    oat::Sample clock_;
+
+    // Interpolation delay and the age at which held positions become invalid.
+    // 0 means hold the latest position, and never expire it, respectively.
+    int64_t delay_ns_ {0};
+    int64_t max_age_ns_ {0};
+
+    // Recent SOURCE positions and the times they were captured
+    struct Input {
+        int64_t ns;
+        oat::Position2D position;
+    };
+    static constexpr size_t HISTORY {64};
+    boost::circular_buffer<Input> inputs_ {HISTORY};
+    oat::Position2D input_ {"input"};
+    oat::Position2D output_ {"output"};
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONRESAMPLER_H */
@@ -17,10 +17,13 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include <algorithm>
+#include <cstring>
 #include <ostream>
 #include <opencv2/core/types.hpp>
 #include <opencv2/imgproc.hpp>
 #include <string.h>
+#include <string>
 #include <vector>
 #include <cpptoml.h>
 
@@ -31,12 +34,14 @@
 
 namespace oat {
 
-RegionFilter2D::~RegionFilter2D()
-{
-    for (auto &value : region_contours_) {
-        delete value;
-    }
-}
+// Largest region label image, in pixels
+static constexpr int MAX_LABEL_PIXELS {1 << 24};
+
+const char RegionFilter2D::EVENT_DTYPE[]{"[('tick', '<u8'),"
+                                         "('usec', '<u8'),"
+                                         "('capture_ns', '<u8'),"
+                                         "('enter', '<i1'),"
+                                         "('region', 'a10')]"};
 
 po::options_description RegionFilter2D::options() const
 {
@@ -66,6 +71,18 @@ po::options_description RegionFilter2D::options() const
          "        [717.33, 386.67],\n"
          "        [714.00, 316.67],\n"
          "        [655.33, 319.33]]")
+        ("events,e", po::value<std::string>(),
+         "ZMQ-style endpoint to publish region entries and exits to, e.g. "
+         "'tcp://*:5570' or 'ipc:///tmp/regions.pipe'. Each event is one "
+         "35 byte message, packed as NumPy dtype [('tick', '<u8'), ('usec', "
+         "'<u8'), ('capture_ns', '<u8'), ('enter', '<i1'), ('region', "
+         "'a10')], carrying the sample on which the change was first seen. "
+         "Moving straight from one region to another publishes the exit "
+         "before the entry. Positions keep their region labels.")
+        ("dwell", po::value<int>(),
+         "Number of consecutive samples a position must stay in a new "
+         "region, or out of every region, before the change is published. "
+         "Suppresses chatter at region borders. Defaults to 1.")
         ;
 
     return local_opts;
@@ -85,15 +102,24 @@ void RegionFilter2D::applyConfiguration(const po::variables_map &vm,
 
     while (it != config_table->end()) {
 
+        // Options are not regions
+        if (std::find(config_keys_.begin(), config_keys_.end(), it->first)
+            != config_keys_.end()) {
+            it++;
+            continue;
+        }
+
         oat::config::Array region_array;
         oat::config::getArray(config_table, it->first, region_array);
 
         // Push the name of this region onto the id list
         region_ids_.push_back(it->first);
-        if (region_ids_.back().size() > oat::Position2D::REGION_LEN)
-            std::cerr << oat::Warn("Region names are limited to 10 characters.");
+        if (region_ids_.back().size() >= oat::Position2D::REGION_LEN)
+            std::cerr << oat::Warn("Region names are limited to "
+                                   + std::to_string(oat::Position2D::REGION_LEN - 1)
+                                   + " characters.\n");
 
-        region_contours_.push_back(new std::vector<cv::Point>());
+        region_contours_.emplace_back();
 
         auto region = region_array->nested_array();
         auto reg_it = region.begin();
@@ -109,7 +135,7 @@ void RegionFilter2D::applyConfiguration(const po::variables_map &vm,
             }
 
             auto p = cv::Point2d(point[0]->get(), point[1]->get());
-            region_contours_.back()->push_back(p);
+            region_contours_.back().push_back(p);
             reg_it++;
         }
         it++;
@@ -125,30 +151,165 @@ void RegionFilter2D::applyConfiguration(const po::variables_map &vm,
 //            }
 //        }
 //#endif
+
+    buildLabels();
+
+    // Events
+    std::string endpoint;
+    if (oat::config::getValue<std::string>(vm, config_table, "events", endpoint)) {
+        events_.reset(new zmq::socket_t(context_, ZMQ_PUB));
+        events_->bind(endpoint);
+    }
+
+    oat::config::getNumericValue<int>(vm, config_table, "dwell", dwell_, 1);
 }
 
-void RegionFilter2D::filter(oat::Position2D &position) {
+void RegionFilter2D::checkConfigKeys(const config::OptionTable &config_table) const
+{
+    // Any key that is not an option must be a region contour
+    for (const auto &kv : *config_table)
+        if (std::find(config_keys_.begin(), config_keys_.end(), kv.first)
+                == config_keys_.end()
+            && !kv.second->is_array())
+            throw std::runtime_error("Unknown configuration key '" + kv.first
+                                     + "'. Regions must be arrays.");
+}
 
-    // Check the current position to see if it lies inside any regions.
-    if (position.position_valid) {
+void RegionFilter2D::buildLabels()
+{
+    labels_.release();
+
+    cv::Rect bounds;
+    for (const auto &r : region_contours_)
+        if (!r.empty())
+            bounds = bounds.area() == 0 ? cv::boundingRect(r)
+                                        : bounds | cv::boundingRect(r);
+
+    // Too large to label every pixel
+    if (bounds.area() == 0 || bounds.area() > MAX_LABEL_PIXELS
+        || region_contours_.size() >= UINT16_MAX)
+        return;
+
+    origin_ = bounds.tl();
+    labels_.create(bounds.size());
+    labels_ = 0;
 
-        cv::Point pt = (cv::Point)position.position;
-        std::vector<std::string>::size_type i = 0;
+    // Label exactly the pixels that pointPolygonTest places in or on each
+    // region, the first region taking precedence where they overlap
+    for (size_t i = 0; i < region_contours_.size(); i++) {
 
-        for (auto &r : region_contours_) {
+        const auto &r = region_contours_[i];
+        if (r.empty())
+            continue;
 
-            if (cv::pointPolygonTest(*r, pt, false) >= 0) {
+        const cv::Rect box = cv::boundingRect(r);
+        for (int y = box.y; y < box.y + box.height; y++) {
 
-                position.region_valid = true;
-                std::vector<char> writable(region_ids_[i].begin(),
-                                           region_ids_[i].end());
-                writable.push_back('\0');
-                strcpy(position.region, &writable[0]);
-                break;
+            uint16_t *row = labels_[y - origin_.y];
+            for (int x = box.x; x < box.x + box.width; x++) {
+
+                uint16_t &l = row[x - origin_.x];
+                if (l == 0 && cv::pointPolygonTest(r, cv::Point(x, y), false) >= 0)
+                    l = static_cast<uint16_t>(i + 1);
             }
-            i++;
         }
     }
 }
 
+void RegionFilter2D::setRegion(oat::Position2D &position, const size_t i) const
+{
+    position.region_valid = true;
+    strncpy(position.region, region_ids_[i].c_str(), sizeof(position.region));
+    position.region[sizeof(position.region) - 1] = '\0';
+}
+
+int RegionFilter2D::regionOf(const oat::Position2D &position) const
+{
+    // Check the current position to see if it lies inside any regions.
+    if (!position.position_valid)
+        return -1;
+
+    cv::Point pt = (cv::Point)position.position;
+
+    if (!labels_.empty()) {
+
+        const cv::Point p = pt - origin_;
+        if (p.x < 0 || p.y < 0 || p.x >= labels_.cols || p.y >= labels_.rows)
+            return -1;
+
+        return static_cast<int>(labels_(p)) - 1;
+    }
+
+    for (size_t i = 0; i < region_contours_.size(); i++)
+        if (cv::pointPolygonTest(region_contours_[i], pt, false) >= 0)
+            return static_cast<int>(i);
+
+    return -1;
+}
+
+void RegionFilter2D::filter(oat::Position2D &position) {
+
+    const int region = regionOf(position);
+    if (region >= 0)
+        setRegion(position, region);
+
+    if (events_)
+        track(position, region);
+}
+
+void RegionFilter2D::track(const oat::Position2D &position, const int region)
+{
+    // Back where we were, so any pending change did not last
+    if (region == region_) {
+        candidate_samples_ = 0;
+        return;
+    }
+
+    if (candidate_samples_ == 0 || region != candidate_) {
+        candidate_ = region;
+        candidate_samples_ = 0;
+        candidate_onset_ = position.sample();
+    }
+
+    if (++candidate_samples_ < dwell_)
+        return;
+
+    if (region_ >= 0)
+        sendEvent(false, region_, candidate_onset_);
+    if (candidate_ >= 0)
+        sendEvent(true, candidate_, candidate_onset_);
+
+    region_ = candidate_;
+    candidate_samples_ = 0;
+}
+
+void RegionFilter2D::sendEvent(const bool enter,
+                               const int i,
+                               const oat::Sample &onset)
+{
+    // Fields are packed in the order and sizes of EVENT_DTYPE
+    zmq::message_t msg(EVENT_BYTES);
+    char *out = static_cast<char *>(msg.data());
+    auto put = [&out](const void *val, const size_t n) {
+        std::memcpy(out, val, n);
+        out += n;
+    };
+
+    const uint64_t tick = onset.count();
+    const uint64_t usec = onset.microseconds().count();
+    const uint64_t capture_ns = onset.capture_ns();
+    const int8_t e = enter ? 1 : 0;
+    char region[oat::Position2D::REGION_LEN] {0};
+    strncpy(region, region_ids_[i].c_str(), sizeof(region) - 1);
+
+    put(&tick, sizeof(tick));
+    put(&usec, sizeof(usec));
+    put(&capture_ns, sizeof(capture_ns));
+    put(&e, sizeof(e));
+    put(region, sizeof(region));
+
+    // PUB sockets drop rather than block when a subscriber is slow
+    events_->send(msg, ZMQ_DONTWAIT);
+}
+
 } /* namespace oat */
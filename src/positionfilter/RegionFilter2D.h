@@ -22,9 +22,14 @@
 
 #include "PositionFilter.h"
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+#include "../../lib/datatypes/Sample.h"
 
 namespace oat {
 
@@ -39,11 +44,14 @@ public:
      * A region filter to map position coordinates to categorical regions. By
      * specifying a set of named contours, this filter checks if the position
      * is inside a given contour and appends the name of that contour to each
-     * to the position.
+     * to the position. Optionally, entries to and exits from regions are
+     * also published as events.
      */
     using PositionFilter::PositionFilter;
 
-    ~RegionFilter2D();
+    // Bytes and NumPy dtype of a packed region event
+    static constexpr size_t EVENT_BYTES {35};
+    static const char EVENT_DTYPE[];
 
 private:
     // Configurable Interface
@@ -51,9 +59,54 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    // Region contours are user-named entries of the configuration table
+    void checkConfigKeys(const config::OptionTable &config_table) const override;
+
     // Regions
     std::vector<std::string> region_ids_;
-    std::vector<std::vector<cv::Point> *> region_contours_;
+    std::vector<std::vector<cv::Point>> region_contours_;
+
+    // Region label of each pixel position covered by the regions, built
+    // once at configuration: 1 + the index of the first region containing
+    // position origin_ + (x, y), or 0 if there is none. Empty if the regions
+    // are too far apart, in which case each position is tested against each
+    // region.
+    cv::Mat_<uint16_t> labels_;
+    cv::Point origin_;
+
+    void buildLabels(void);
+
+    // Index of the region containing the position, or -1 if there is none
+    int regionOf(const oat::Position2D &position) const;
+
+    // Label the position with region i
+    void setRegion(oat::Position2D &position, size_t i) const;
+
+    // Event publisher. Null unless events are enabled.
+    zmq::context_t context_ {1};
+    std::unique_ptr<zmq::socket_t> events_;
+
+    // Consecutive samples a new region, or no region, must be held for
+    // before the change is published
+    int dwell_ {1};
+
+    // Region that was last published, and the region that is being held
+    // in its place but has yet to last for dwell_ samples
+    int region_ {-1};
+    int candidate_ {-1};
+    int candidate_samples_ {0};
+    oat::Sample candidate_onset_;
+
+    /**
+     * Publish transitions once a change of region has lasted dwell_ samples.
+     * Events carry the sample on which the change was first seen.
+     * @param position Current position.
+     * @param region Region containing the position, or -1.
+     */
+    void track(const oat::Position2D &position, const int region);
+
+    // Publish an entry to, or exit from, region i
+    void sendEvent(const bool enter, const int i, const oat::Sample &onset);
 
     /**
      * Check the position to see if it lies within any of the contours defined
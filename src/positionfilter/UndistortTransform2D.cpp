@@ -0,0 +1,160 @@
+//******************************************************************************
+//* File:   UndistortTransform2D.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include <opencv2/calib3d.hpp>
+#include <cpptoml.h>
+
+#include "../../lib/utility/Homography.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/IOFormat.h"
+
+#include "UndistortTransform2D.h"
+
+namespace oat {
+
+po::options_description UndistortTransform2D::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("camera-matrix,k", po::value<std::string>(),
+         "Nine element float array, [K11,K12,...,K33], specifying the 3x3 "
+         "camera matrix for your imaging setup. Generated by oat-calibrate.")
+        ("distortion-coeffs,d", po::value<std::string>(),
+         "Five to eight element float array, [x1,x2,x3,...], specifying lens "
+         "distortion coefficients. Generated by oat-calibrate.")
+        ("homography,H", po::value<std::string>(),
+         "A nine-element array of floats, [h11,h12,...,h33], specifying a "
+         "3x3 homography matrix to apply to undistorted positions, as the "
+         "homography TYPE would. Can be produced by oat-calibrate homography "
+         "from undistorted frames.")
+        ;
+
+    return local_opts;
+}
+
+void UndistortTransform2D::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Distortion coefficients
+    oat::config::getArray<double>(
+        vm, config_table, "distortion-coeffs", dist_coeff_, true);
+
+    if (dist_coeff_.size() < 5 || dist_coeff_.size() > 8)
+        throw (std::runtime_error("Distortion coefficients consist of 5 to 8 values."));
+
+    // Camera Matrix
+    std::vector<double> K;
+    oat::config::getArray<double, 9>(vm, config_table, "camera-matrix", K, true);
+
+    camera_matrix_(0, 0) = K[0];
+    camera_matrix_(0, 1) = K[1];
+    camera_matrix_(0, 2) = K[2];
+    camera_matrix_(1, 0) = K[3];
+    camera_matrix_(1, 1) = K[4];
+    camera_matrix_(1, 2) = K[5];
+    camera_matrix_(2, 0) = K[6];
+    camera_matrix_(2, 1) = K[7];
+    camera_matrix_(2, 2) = K[8];
+
+    // Homography
+    std::vector<double> H;
+    if (oat::config::getArray<double, 9>(vm, config_table, "homography", H)) {
+
+        use_homography_ = true;
+        homography_(0, 0) = H[0];
+        homography_(0, 1) = H[1];
+        homography_(0, 2) = H[2];
+        homography_(1, 0) = H[3];
+        homography_(1, 1) = H[4];
+        homography_(1, 2) = H[5];
+        homography_(2, 0) = H[6];
+        homography_(2, 1) = H[7];
+        homography_(2, 2) = H[8];
+    }
+}
+
+void UndistortTransform2D::filter(oat::Position2D& position) {
+
+    // Velocity and heading are only meaningful at a position, since
+    // distortion varies across the frame
+    if (position.position_valid) {
+
+        // Velocity and heading, being derivatives, are mapped through the
+        // local linearization of distortion, found from one pixel steps
+        const double v_norm = position.velocity_valid
+            ? std::sqrt(position.velocity.dot(position.velocity)) : 0.0;
+
+        points_.clear();
+        points_.push_back(position.position);
+        if (v_norm > 0.0)
+            points_.push_back(position.position
+                              + position.velocity * (1.0 / v_norm));
+        if (position.heading_valid)
+            points_.push_back(position.position + position.heading);
+
+        // Undistorted points are projected back onto pixels with the same
+        // camera matrix, as oat-framefilt undistort does
+        cv::undistortPoints(points_, undistorted_, camera_matrix_,
+                            dist_coeff_, cv::noArray(), camera_matrix_);
+
+        const cv::Point2d p = undistorted_[0];
+        size_t i = 1;
+
+        if (v_norm > 0.0)
+            position.velocity = (undistorted_[i++] - p) * v_norm;
+
+        if (position.heading_valid) {
+            const cv::Point2d h = undistorted_[i] - p;
+            const double n = std::sqrt(h.dot(h));
+            position.heading = n > 0.0 ? h * (1.0 / n) : h;
+        }
+
+        position.position = p;
+    }
+
+    if (!use_homography_)
+        return;
+
+    // Position transform
+    if (position.position_valid)
+        position.position = oat::transformPoint(homography_, position.position);
+
+    // Velocity transform. Offsets do not apply to velocity.
+    if (position.velocity_valid)
+        position.velocity
+            = oat::transformPoint(homography_, position.velocity, false);
+
+    // Heading transform. Offsets do not apply to heading.
+    if (position.heading_valid) {
+        const cv::Point2d h
+            = oat::transformPoint(homography_, position.heading, false);
+        const double n = std::sqrt(h.dot(h));
+        position.heading = n > 0.0 ? h * (1.0 / n) : h;
+    }
+
+    // Update outgoing position's coordinate system
+    position.setCoordSystem(oat::DistanceUnit::WORLD, homography_);
+}
+
+} /* namespace oat */
@@ -0,0 +1,70 @@
+//******************************************************************************
+//* File:   UndistortTransform2D.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#ifndef OAT_UNDISTORTTRANSFORM2D_H
+#define	OAT_UNDISTORTTRANSFORM2D_H
+
+#include "PositionFilter.h"
+
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+namespace oat {
+
+class UndistortTransform2D : public PositionFilter {
+
+public:
+    /**
+     * Lens distortion compensation of positions.
+     * Moves positions to where they would have been detected in frames
+     * undistorted by oat-framefilt undistort with the same camera model, at
+     * the cost of a few points rather than a remap of every frame. Can then
+     * apply a homography, as HomographyTransform2D would.
+     */
+    using PositionFilter::PositionFilter;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Camera model from oat-calibrate
+    cv::Matx33d camera_matrix_ {1.0, 0, 0, 0, 1.0, 0, 0, 0, 1.0};
+    std::vector<double> dist_coeff_;
+
+    // Optional 2D homography applied after undistortion
+    bool use_homography_ {false};
+    cv::Matx33d homography_ {1.0, 0, 0, 0, 1.0, 0, 0, 0, 1.0};
+
+    // Points undistorted together: the position, and one pixel steps along
+    // the velocity and heading
+    std::vector<cv::Point2d> points_;
+    std::vector<cv::Point2d> undistorted_;
+
+    /**
+     * Undistort position, velocity and heading.
+     * @param Position to be undistorted
+     */
+    void filter(oat::Position2D& position) override;
+};
+
+}      /* namespace oat */
+#endif /* OAT_UNDISTORTTRANSFORM2D_H */
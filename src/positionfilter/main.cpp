@@ -17,6 +17,7 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //****************************************************************************
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -32,7 +33,12 @@
 
 #include "HomographyTransform2D.h"
 #include "KalmanFilter2D.h"
+#include "MultiTargetTracker.h"
+#include "PositionFilterChain.h"
+#include "PositionPredictor.h"
+#include "PositionResampler.h"
 #include "RegionFilter2D.h"
+#include "UndistortTransform2D.h"
 
 #define REQ_POSITIONAL_ARGS 3
 
@@ -42,7 +48,14 @@ const char usage_type[] =
     "TYPE\n"
     "  kalman: Kalman filter\n"
     "  homography: homography transform\n"
-    "  region: position region annotation";
+    "  undistort: lens distortion compensation, optionally followed by a\n"
+    "    homography transform\n"
+    "  region: position region annotation\n"
+    "  track: multi-target tracker for position arrays\n"
+    "  resample: publish the latest or interpolated position on a fixed clock\n"
+    "  predict: extrapolate positions by their latency\n"
+    "  chain: kalman, undistort, homography, region and predict filters\n"
+    "    applied in one component";
 
 const char usage_io[] =
     "SOURCE:\n"
@@ -50,7 +63,9 @@ const char usage_io[] =
     "from (e.g. pos).\n\n"
     "SINK:\n"
     "  User-supplied name of the memory segment to publish positions "
-    "to (e.g. filt).";
+    "to (e.g. filt).\n\n"
+    "With --offline, SOURCE and SINK are instead the paths of binary position "
+    "files.";
 
 const char purpose[] =
     "Filter positions from SOURCE and publish filtered positions "
@@ -92,6 +107,11 @@ int main(int argc, char *argv[])
     type_hash["kalman"] = 'a';
     type_hash["homography"] = 'b';
     type_hash["region"] = 'c';
+    type_hash["track"] = 'd';
+    type_hash["chain"] = 'e';
+    type_hash["undistort"] = 'f';
+    type_hash["resample"] = 'g';
+    type_hash["predict"] = 'h';
 
     // The component itself
     std::string comp_name = "posifilt";
@@ -122,13 +142,25 @@ int main(int argc, char *argv[])
         positional_options.add("sink", 1);
         positional_options.add("type-args", -1);
 
+        // Filtering of position files instead of nodes
+        po::options_description offline_opt_desc("OFFLINE");
+        offline_opt_desc.add_options()
+            ("offline",
+             "If true, SOURCE and SINK are binary (NPY) position files, such as "
+             "those written by oat-record, instead of memory segments. SOURCE "
+             "is filtered into SINK as fast as the filter allows, without "
+             "shared memory, and the program exits.")
+            ;
+
         // Visible options for help message
-        visible_options.add(oat::config::ComponentInfo::instance()->get());
+        visible_options.add(oat::config::ComponentInfo::instance()->get())
+                       .add(offline_opt_desc);
 
         // All options, including positional
         po::options_description options;
         options.add(positional_opt_desc)
-               .add(oat::config::ComponentInfo::instance()->get());
+               .add(oat::config::ComponentInfo::instance()->get())
+               .add(offline_opt_desc);
 
         // Parse options, including unrecognized options which may be
         // type-specific
@@ -164,6 +196,31 @@ int main(int argc, char *argv[])
                     filter = std::make_shared<oat::RegionFilter2D>(source, sink);
                     break;
                 }
+                case 'd':
+                {
+                    filter = std::make_shared<oat::MultiTargetTracker>(source, sink);
+                    break;
+                }
+                case 'e':
+                {
+                    filter = std::make_shared<oat::PositionFilterChain>(source, sink);
+                    break;
+                }
+                case 'f':
+                {
+                    filter = std::make_shared<oat::UndistortTransform2D>(source, sink);
+                    break;
+                }
+                case 'g':
+                {
+                    filter = std::make_shared<oat::PositionResampler>(source, sink);
+                    break;
+                }
+                case 'h':
+                {
+                    filter = std::make_shared<oat::PositionPredictor>(source, sink);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
@@ -230,6 +287,26 @@ int main(int argc, char *argv[])
 
         filter->configure(option_map);
 
+        // Filter a position file and exit
+        if (option_map.count("offline")) {
+
+            std::cout << oat::whoMessage(comp_name,
+                         "Filtering " + source + " into " + sink + ".\n");
+
+            const auto start = std::chrono::steady_clock::now();
+            const auto n = filter->filterFile(source, sink);
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            std::cout << oat::whoMessage(comp_name,
+                         std::to_string(n) + " positions in "
+                         + std::to_string(elapsed.count()) + " seconds.\n")
+                      << oat::whoMessage(comp_name, "Exiting.")
+                      << std::endl;
+
+            return 0;
+        }
+
         // Tell user
         std::cout << oat::whoMessage(comp_name,
                      "Listening to source " + oat::sourceText(source) + ".\n")
@@ -19,7 +19,7 @@
 
 #include <chrono>
 #include <string>
-#include <thread>
+#include <vector>
 #include <cpptoml.h>
 
 #include "../../lib/utility/TOMLSanitize.h"
@@ -29,14 +29,18 @@
 
 namespace oat {
 
+// Time before each deadline that is busy waited in busy mode. Longer sample
+// periods, far below the rates that need it, are partly slept.
+static constexpr double BUSY_SPIN_SEC {1.0};
+
 PositionGenerator::PositionGenerator(const std::string &position_sink_address)
 : name_("posigen[*->" + position_sink_address + "]")
 , position_sink_address_(position_sink_address)
 {
-    tick_ = clock_.now();
+    // Nothing
 }
 
-po::options_description PositionGenerator::baseOptions(void) const
+po::options_description PositionGenerator::baseOptions(const bool room) const
 {
     po::options_description base_opts;
 
@@ -44,23 +48,72 @@ po::options_description PositionGenerator::baseOptions(void) const
     base_opts.add_options()
         ("rate,r", po::value<double>(),
         "Samples per second. Defaults to as fast as possible.")
+        ("spin", po::value<double>(),
+        "Microseconds before each sample deadline that are busy waited "
+        "instead of slept, so that samples are served at exact times at high "
+        "rates. Occupies a core while waiting. Defaults to 0.")
+        ("busy",
+        "Busy wait for every sample deadline rather than sleeping, so that "
+        "rates of 10 kHz and more are served accurately. Occupies a core.")
         ("num-samples,n", po::value<uint64_t>(),
         "Number of position samples to generate and serve. Deafaults to "
         "approximately infinite.")
-        ("room,R", po::value<std::string>(),
-         "Array of floats, [x0,y0,width,height], specifying the boundaries in "
-         "which generated positions reside. The room has periodic boundaries so "
-         "when a position leaves one side it will enter the opposing one.")
         ;
 
+    if (room) {
+        base_opts.add_options()
+            ("room,R", po::value<std::string>(),
+             "Array of floats, [x0,y0,width,height], specifying the boundaries "
+             "in which generated positions reside. The room has periodic "
+             "boundaries so when a position leaves one side it will enter the "
+             "opposing one.")
+            ;
+    }
+
     return base_opts;
 }
 
+void PositionGenerator::configureBase(const po::variables_map &vm,
+                                      const config::OptionTable &config_table,
+                                      const double default_rate)
+{
+    // Rate
+    double fs = default_rate;
+    if (oat::config::getNumericValue<double>(vm, config_table, "rate", fs, 0))
+        enforce_sample_clock_ = true;
+    generateSamplePeriod(fs);
+
+    // Busy wait before each deadline
+    double spin_us = 0.0;
+    if (oat::config::getNumericValue<double>(vm, config_table, "spin", spin_us, 0))
+        pacer_.set_spin(std::chrono::duration<double, std::micro>(spin_us));
+
+    bool busy = false;
+    oat::config::getValue<bool>(vm, config_table, "busy", busy);
+    if (busy)
+        pacer_.set_spin(std::chrono::duration<double>(BUSY_SPIN_SEC));
+
+    // Number of samples
+    oat::config::getNumericValue<uint64_t>(
+        vm, config_table, "num-samples", num_samples_, 0);
+
+    // Room
+    std::vector<double> r;
+    if (oat::config::getArray<double, 4>(vm, config_table, "room", r)) {
+        room_.x = r[0];
+        room_.y = r[1];
+        room_.width = r[2];
+        room_.height = r[3];
+    }
+}
+
 bool PositionGenerator::connectToNode()
 {
-    // Bind to sink sink node and create a shared position
-    position_sink_.bind(position_sink_address_, position_sink_address_);
-    shared_position_ = position_sink_.retrieve();
+    // Bind to sink sink node and create a shared position, or position array
+    if (num_targets_ > 1)
+        positions_sink_.bind(position_sink_address_);
+    else
+        position_sink_.bind(position_sink_address_, position_sink_address_);
 
     // Setup sample rate info on internal copy
     internal_position_.set_rate_hz(1.0 / sample_period_in_sec_.count());
@@ -70,33 +123,38 @@ bool PositionGenerator::connectToNode()
 
 int PositionGenerator::process()
 {
-    // Generate internal position
-    bool eof = generatePosition(internal_position_);
+    // Generate internal position, or positions
+    const bool multi = num_targets_ > 1;
+    bool eof = multi ? generatePositions(internal_positions_)
+                     : generatePosition(internal_position_);
 
     // START CRITICAL SECTION //
     ////////////////////////////
 
     // Wait for sources to read
-    position_sink_.wait();
+    if (multi)
+        positions_sink_.wait();
+    else
+        position_sink_.wait();
 
     if (first_pos_) {
         first_pos_ = false;
         start_ = clock_.now();
     }
 
-    *shared_position_ = internal_position_;
-
-    // Tell sources there is new data
-    position_sink_.post();
+    if (multi) {
+        internal_positions_.set_sample(internal_position_.sample());
+        *positions_sink_.retrieve() = internal_positions_;
+        positions_sink_.post();
+    } else {
+        position_sink_.write(internal_position_);
+        position_sink_.post();
+    }
 
     ////////////////////////////
     //  END CRITICAL SECTION  //
 
-    if (enforce_sample_clock_) {
-        auto tock = clock_.now();
-        std::this_thread::sleep_for(sample_period_in_sec_ - (tock - tick_));
-        tick_ = clock_.now();
-    }
+    pace();
 
     // Pure SINKs increment sample count
     auto time_since_start = std::chrono::duration_cast<Sample::Microseconds>(
@@ -106,10 +164,29 @@ int PositionGenerator::process()
     return eof;
 }
 
+bool PositionGenerator::generatePositions(oat::PositionArray &positions)
+{
+    oat::Position2D p("");
+    const bool eof = generatePosition(p);
+
+    positions.clear();
+    if (p.position_valid)
+        positions.push(p.position.x, p.position.y, p.score);
+
+    return eof;
+}
+
+void PositionGenerator::pace()
+{
+    if (enforce_sample_clock_)
+        pacer_.wait();
+}
+
 void PositionGenerator::generateSamplePeriod(const double samples_per_second)
 {
     oat::Sample::Seconds period(1.0 / samples_per_second);
     sample_period_in_sec_ = period; // Auto conversion
+    pacer_.set_period(sample_period_in_sec_);
 }
 
 } /* namespace oat */
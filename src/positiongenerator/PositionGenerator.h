@@ -31,7 +31,9 @@
 #include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/PositionArray.h"
 #include "../../lib/shmemdf/Sink.h"
+#include "../../lib/utility/Pacer.h"
 
 namespace po = boost::program_options;
 
@@ -62,11 +64,26 @@ protected:
      */
     virtual bool generatePosition(oat::Position2D &position) = 0;
 
+    /**
+     * Generate test positions of all targets, when there is more than one.
+     * Defaults to the single generated position.
+     * @param positions Generated positions.
+     * @return true if EOF has been genereated, false otherwise.
+     */
+    virtual bool generatePositions(oat::PositionArray &positions);
+
+    /**
+     * Wait until the next sample is due. Defaults to the sample clock,
+     * if it is enforced.
+     */
+    virtual void pace(void);
+
     // Test position sample clock
     bool enforce_sample_clock_ {false};
     std::chrono::high_resolution_clock clock_;
     std::chrono::duration<double> sample_period_in_sec_;
-    std::chrono::high_resolution_clock::time_point start_, tick_;
+    std::chrono::high_resolution_clock::time_point start_;
+    oat::Pacer pacer_;
 
     // Periodic boundaries in which simulated particle resides.
     cv::Rect_<double> room_ {0, 0, 100, 100};
@@ -75,6 +92,10 @@ protected:
     uint64_t num_samples_ {std::numeric_limits<uint64_t>::max()};
     uint64_t it_ {0};
 
+    // Number of simulated targets. If more than one, positions are published
+    // as a position array.
+    int num_targets_ {1};
+
     /**
      * Configure the sample period
      * @param samples_per_second Sample period in seconds.
@@ -84,9 +105,20 @@ protected:
     /**
      * @brief Provide a copy of the base program options for derived
      * types that need it.
+     * @param room Include the room option.
      * @return Base program options description.
      */
-    po::options_description baseOptions(void) const;
+    po::options_description baseOptions(const bool room = true) const;
+
+    /**
+     * @brief Apply the base program options.
+     * @param vm Program options variable map.
+     * @param config_table Configuration table.
+     * @param default_rate Sample rate, in Hz, if none is specified.
+     */
+    void configureBase(const po::variables_map &vm,
+                       const config::OptionTable &config_table,
+                       const double default_rate);
 
 private:
     // Component Interface
@@ -99,15 +131,16 @@ private:
     // Internally generated position
     oat::Position2D internal_position_ {"internal"};
 
-    // Shared position
-    oat::Position2D * shared_position_;
-
     // First position
     bool first_pos_ {true};
 
     // The test position SINK
     std::string position_sink_address_;
     oat::Sink<oat::Position2D> position_sink_;
+
+    // Internally generated positions of multiple targets and their SINK
+    oat::PositionArray internal_positions_;
+    oat::Sink<oat::PositionArray> positions_sink_;
 };
 
 }      /* namespace oat */
@@ -0,0 +1,276 @@
+//******************************************************************************
+//* File:   PositionReplay.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "PositionReplay.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cpptoml.h>
+#include <rapidjson/document.h>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+po::options_description PositionReplay::options() const
+{
+    // Update CLI options
+    // Start with base options, except the room, which was recorded
+    po::options_description local_opts(baseOptions(false));
+
+    // Add local options
+    local_opts.add_options()
+        ("file,f", po::value<std::string>(),
+         "Path to a position file saved by oat-record, in either JSON or "
+         "binary (.npy) format.")
+        ("speed,x", po::value<double>(),
+         "Playback speed relative to the recorded sample times, e.g. 10 to "
+         "replay ten times faster. 0 to replay as fast as possible. Ignored "
+         "if a rate is specified. Defaults to 1.")
+        ("loop",
+         "Replay the file from the start when its end is reached, until "
+         "num-samples have been served.")
+        ;
+
+    return local_opts;
+}
+
+void PositionReplay::applyConfiguration(const po::variables_map &vm,
+                                        const config::OptionTable &config_table)
+{
+    // Recorded positions
+    std::string path;
+    oat::config::getValue(vm, config_table, "file", path, true);
+
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".npy") == 0)
+        loadBinary(path);
+    else
+        loadJSON(path);
+
+    if (records_.empty())
+        throw std::runtime_error("No positions were found in " + path + ".");
+
+    // Recorded sample rate, if the file does not say
+    if (recorded_rate_hz_ <= 0.0 && usec_.size() > 1 && usec_.back() > usec_[0])
+        recorded_rate_hz_ = 1e6 * (usec_.size() - 1) / (usec_.back() - usec_[0]);
+
+    // Speed
+    oat::config::getNumericValue<double>(
+        vm, config_table, "speed", speed_, 0.0);
+
+    // Loop
+    oat::config::getValue<bool>(vm, config_table, "loop", loop_);
+
+    // Rate and sample count. SINK rate is that of the replay.
+    double rate = speed_ > 0 && recorded_rate_hz_ > 0
+                ? recorded_rate_hz_ * speed_
+                : 1e8;
+    configureBase(vm, config_table, rate);
+}
+
+void PositionReplay::loadJSON(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("File \"" + path + "\" could not be read.");
+
+    std::string json((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+
+    rapidjson::Document doc;
+    doc.Parse(json.c_str());
+    if (doc.HasParseError() || !doc.IsObject()
+        || !doc.HasMember("positions") || !doc["positions"].IsArray())
+        throw std::runtime_error("File \"" + path + "\" is not a position "
+                                 "file saved by oat-record.");
+
+    if (doc.HasMember("header") && doc["header"].IsObject()
+        && doc["header"].HasMember("sample_rate_hz")
+        && doc["header"]["sample_rate_hz"].IsNumber())
+        recorded_rate_hz_ = doc["header"]["sample_rate_hz"].GetDouble();
+
+    // Fields of invalid data are absent from concise files
+    auto flag = [](const rapidjson::Value &p, const char *key) {
+        return p.HasMember(key) && p[key].IsBool() && p[key].GetBool();
+    };
+
+    auto pair = [](const rapidjson::Value &p, const char *key, double *out) {
+        if (!p.HasMember(key) || !p[key].IsArray() || p[key].Size() != 2)
+            return false;
+        out[0] = p[key][0].GetDouble();
+        out[1] = p[key][1].GetDouble();
+        return true;
+    };
+
+    const auto &positions = doc["positions"];
+    records_.reserve(positions.Size());
+    usec_.reserve(positions.Size());
+
+    for (const auto &p : positions.GetArray()) {
+
+        oat::PositionRecord r;
+        r.position_valid = flag(p, "pos_ok") && pair(p, "pos_xy", r.position);
+        r.velocity_valid = flag(p, "vel_ok") && pair(p, "vel_xy", r.velocity);
+        r.heading_valid = flag(p, "head_ok") && pair(p, "head_xy", r.heading);
+
+        if (flag(p, "reg_ok") && p.HasMember("reg") && p["reg"].IsString()) {
+            r.region_valid = true;
+            std::strncpy(r.region, p["reg"].GetString(), sizeof(r.region));
+            r.region[sizeof(r.region) - 1] = '\0';
+        }
+
+        if (records_.empty() && p.HasMember("unit") && p["unit"].IsInt())
+            unit_ = static_cast<oat::DistanceUnit>(p["unit"].GetInt());
+
+        records_.push_back(r);
+        usec_.push_back(p.HasMember("usec") && p["usec"].IsUint64()
+                        ? p["usec"].GetUint64()
+                        : 0);
+    }
+}
+
+void PositionReplay::loadBinary(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("File \"" + path + "\" could not be read.");
+
+    std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Numpy header: magic number, version, dictionary length, dictionary
+    const size_t prefix_len = 10;
+    if (data.size() < prefix_len || data[0] != static_cast<char>(0x93)
+        || std::memcmp(&data[1], "NUMPY", 5) != 0)
+        throw std::runtime_error("File \"" + path + "\" is not a numpy "
+                                 "file.");
+
+    const size_t dict_len = static_cast<uint8_t>(data[8])
+                          | static_cast<uint8_t>(data[9]) << 8;
+    const std::string dict(data.begin() + prefix_len,
+                           data.begin() + prefix_len + dict_len);
+
+    if (dict.find(oat::Position2D::NPY_DTYPE) == std::string::npos)
+        throw std::runtime_error("File \"" + path + "\" does not hold "
+                                 "positions saved by this version of "
+                                 "oat-record.");
+
+    // Records follow the header. Those of a recording that was not closed
+    // are counted from the file size rather than the header's shape.
+    const size_t rec_bytes = oat::Position2D::NPY_DTYPE_BYTES;
+    const char *rec = data.data() + prefix_len + dict_len;
+    const size_t n = (data.size() - prefix_len - dict_len) / rec_bytes;
+
+    records_.resize(n);
+    usec_.resize(n);
+
+    for (size_t i = 0; i < n; i++, rec += rec_bytes) {
+
+        // Field offsets follow Position2D::NPY_DTYPE
+        oat::PositionRecord &r = records_[i];
+        std::memcpy(&usec_[i], rec + 8, 8);
+        r.position_valid = rec[20] != 0;
+        std::memcpy(r.position, rec + 21, 16);
+        r.velocity_valid = rec[37] != 0;
+        std::memcpy(r.velocity, rec + 38, 16);
+        r.heading_valid = rec[54] != 0;
+        std::memcpy(r.heading, rec + 55, 16);
+        r.region_valid = rec[71] != 0;
+        std::memcpy(r.region, rec + 72, sizeof(r.region));
+        r.region[sizeof(r.region) - 1] = '\0';
+
+        if (i == 0) {
+            int32_t unit;
+            std::memcpy(&unit, rec + 16, 4);
+            unit_ = static_cast<oat::DistanceUnit>(unit);
+        }
+    }
+}
+
+uint64_t PositionReplay::loopUsec() const
+{
+    const uint64_t period_usec = recorded_rate_hz_ > 0
+                               ? static_cast<uint64_t>(1e6 / recorded_rate_hz_)
+                               : 0;
+
+    return usec_.back() - usec_.front() + period_usec;
+}
+
+bool PositionReplay::generatePosition(oat::Position2D &position)
+{
+    if (it_ >= num_samples_)
+        return true;
+
+    if (next_ == records_.size()) {
+
+        if (!loop_)
+            return true;
+
+        next_ = 0;
+        loop_usec_ += loopUsec();
+    }
+
+    // The sample clock is the generator's, so the recorded sample is not
+    // restored
+    const auto &r = records_[next_++];
+    position.setCoordSystem(unit_, position.homography());
+    position.position_valid = r.position_valid;
+    position.position = oat::Point2D(r.position[0], r.position[1]);
+    position.velocity_valid = r.velocity_valid;
+    position.velocity = oat::Velocity2D(r.velocity[0], r.velocity[1]);
+    position.heading_valid = r.heading_valid;
+    position.heading = oat::UnitVector2D(r.heading[0], r.heading[1]);
+    position.region_valid = r.region_valid;
+    std::memcpy(position.region, r.region, sizeof(position.region));
+
+    it_++;
+
+    return false;
+}
+
+void PositionReplay::pace()
+{
+    if (enforce_sample_clock_) {
+        PositionGenerator::pace();
+        return;
+    }
+
+    if (speed_ == 0.0)
+        return;
+
+    // Recorded time of the next position, from the first
+    uint64_t usec;
+    if (next_ < records_.size())
+        usec = loop_usec_ + usec_[next_] - usec_.front();
+    else if (loop_)
+        usec = loop_usec_ + loopUsec();
+    else
+        return;
+
+    pacer_.waitUntil(std::chrono::nanoseconds(
+        static_cast<int64_t>(usec * 1e3 / speed_)));
+}
+
+} /* namespace oat */
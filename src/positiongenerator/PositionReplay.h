@@ -0,0 +1,76 @@
+//******************************************************************************
+//* File:   PositionReplay.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_POSITIONREPLAY_H
+#define	OAT_POSITIONREPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../lib/datatypes/Position2D.h"
+
+#include "PositionGenerator.h"
+
+namespace oat {
+
+class PositionReplay : public PositionGenerator {
+
+public:
+
+    /**
+     * A recorded position player.
+     * Positions saved by oat-record are served again, at their recorded
+     * sample times, at a multiple of them, or at a fixed rate.
+     */
+    using PositionGenerator::PositionGenerator;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Recorded positions and their sample times in microseconds
+    std::vector<oat::PositionRecord> records_;
+    std::vector<uint64_t> usec_;
+    oat::DistanceUnit unit_ {oat::DistanceUnit::PIXELS};
+    double recorded_rate_hz_ {0.0};
+
+    // Playback
+    double speed_ {1.0};
+    bool loop_ {false};
+    size_t next_ {0};
+    uint64_t loop_usec_ {0};
+
+    void loadJSON(const std::string &path);
+    void loadBinary(const std::string &path);
+
+    /**
+     * @brief Recorded time from the first position to the first position
+     * of the next loop.
+     */
+    uint64_t loopUsec(void) const;
+
+    bool generatePosition(oat::Position2D &position) override;
+    void pace(void) override;
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONREPLAY_H */
@@ -37,6 +37,10 @@ po::options_description RandomAccel2D::options() const
     local_opts.add_options()
         ("sigma-accel,a", po::value<double>(),
          "Standard deviation of normally-distributed random accelerations")
+        ("targets,N", po::value<int>(),
+         "Number of independently moving targets, up to 64. If more than one, "
+         "all are published to SINK as a position array, which is also how "
+         "message size is set for throughput tests. Defaults to 1.")
         ;
 
     return local_opts;
@@ -45,26 +49,23 @@ po::options_description RandomAccel2D::options() const
 void RandomAccel2D::applyConfiguration(const po::variables_map &vm,
                                         const config::OptionTable &config_table)
 {
-    // Rate
-    double fs = 1e8; // Very fast s.t. process cannot keep up
-    if (oat::config::getNumericValue<double>(vm, config_table, "rate", fs, 0)) {
-        enforce_sample_clock_ = true;
-    } else {
-        tick_ = clock_.now();
-    }
-    generateSamplePeriod(fs);
-
-    // Number of samples
-    oat::config::getNumericValue<uint64_t>(
-        vm, config_table, "num-samples", num_samples_, 0);
-
-    // Room
-    std::vector<double> r;
-    if (oat::config::getArray<double, 4>(vm, config_table, "room", r)) {
-        room_.x = r[0];
-        room_.y = r[1];
-        room_.width = r[2];
-        room_.height = r[3];
+    // Rate, sample count, room. Very fast s.t. process cannot keep up by
+    // default.
+    configureBase(vm, config_table, 1e8);
+
+    // Targets
+    if (oat::config::getNumericValue<int>(vm, config_table, "targets",
+            num_targets_, 1, static_cast<int>(oat::PositionArray::CAPACITY))
+        && num_targets_ > 1) {
+
+        // Multiple targets start at random places in the room
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        states_.resize(num_targets_);
+        for (auto &state : states_)
+            state = cv::Matx41d(room_.x + u(accel_generator_) * room_.width,
+                                0.0,
+                                room_.y + u(accel_generator_) * room_.height,
+                                0.0);
     }
 
     // Acceleration
@@ -84,17 +85,36 @@ bool RandomAccel2D::generatePosition(oat::Position2D &position)
     if (it_ < num_samples_) {
 
         // Simulate one step of random, but smooth, motion
-        simulateMotion();
+        auto &state = states_[0];
+        simulateMotion(state);
 
         // Simulated position info
         position.position_valid = true;
-        position.position.x = state_(0);
-        position.position.y = state_(2);
+        position.position.x = state(0);
+        position.position.y = state(2);
 
         // We have access to the velocity info for comparison
         position.velocity_valid = true;
-        position.velocity.x = state_(1);
-        position.velocity.y = state_(3);
+        position.velocity.x = state(1);
+        position.velocity.y = state(3);
+
+        it_++;
+
+        return false;
+    }
+
+    return true;
+}
+
+bool RandomAccel2D::generatePositions(oat::PositionArray &positions)
+{
+    if (it_ < num_samples_) {
+
+        positions.clear();
+        for (auto &state : states_) {
+            simulateMotion(state);
+            positions.push(state(0), state(2), 0.0);
+        }
 
         it_++;
 
@@ -104,30 +124,30 @@ bool RandomAccel2D::generatePosition(oat::Position2D &position)
     return true;
 }
 
-void RandomAccel2D::simulateMotion()
+void RandomAccel2D::simulateMotion(cv::Matx41d &state)
 {
     // Generate random acceleration
     accel_vec_(0) = accel_distribution_(accel_generator_);
     accel_vec_(1) = accel_distribution_(accel_generator_);
 
     // Apply acceleration and transition matrix to the simulated position
-    state_ = state_transition_mat_ * state_ + input_mat_ * accel_vec_;
+    state = state_transition_mat_ * state + input_mat_ * accel_vec_;
 
     // Apply circular boundary (not technically correct since positive test
-    // condition should result in state_(0) = 2*room_.x + room_.width - state_(0),
+    // condition should result in state(0) = 2*room_.x + room_.width - state(0),
     // but takes care of endless oscillation that would result if
-    // |state_(0) - room_.x | > room.width.
-    if (state_(0) < room_.x)
-        state_(0) = room_.x + room_.width;
+    // |state(0) - room_.x | > room.width.
+    if (state(0) < room_.x)
+        state(0) = room_.x + room_.width;
 
-    if (state_(0) > room_.x + room_.width)
-        state_(0) = room_.x;
+    if (state(0) > room_.x + room_.width)
+        state(0) = room_.x;
 
-    if (state_(2) < room_.y)
-        state_(2) = room_.y + room_.height;
+    if (state(2) < room_.y)
+        state(2) = room_.y + room_.height;
 
-    if (state_(2) > room_.y + room_.height)
-        state_(2) = room_.y;
+    if (state(2) > room_.y + room_.height)
+        state(2) = room_.y;
 }
 
 void RandomAccel2D::createStaticMatracies()
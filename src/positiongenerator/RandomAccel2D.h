@@ -23,6 +23,7 @@
 #include <chrono>
 #include <random>
 #include <string>
+#include <vector>
 #include <opencv2/core/mat.hpp>
 
 #include "../../lib/datatypes/Position2D.h"
@@ -52,8 +53,8 @@ private:
     std::default_random_engine accel_generator_ {std::random_device{}()};
     std::normal_distribution<double> accel_distribution_ {0.0, 100.0};
 
-    // Simulated position
-    cv::Matx41d state_ {0.0, 0.0, 0.0, 0.0}; // Should be center of bounding region
+    // Simulated position of each target
+    std::vector<cv::Matx41d> states_ {cv::Matx41d(0.0, 0.0, 0.0, 0.0)}; // Should be center of bounding region
     cv::Matx21d accel_vec_;
 
     // STM and input matrix
@@ -61,8 +62,9 @@ private:
     cv::Matx<double, 4, 2> input_mat_;
 
     bool generatePosition(oat::Position2D &position) override;
+    bool generatePositions(oat::PositionArray &positions) override;
     void createStaticMatracies(void);
-    void simulateMotion(void);
+    void simulateMotion(cv::Matx41d &state);
 };
 
 }      /* namespace oat */
@@ -32,6 +32,7 @@
 #include "../../lib/utility/ProgramOptions.h"
 
 #include "PositionGenerator.h"
+#include "PositionReplay.h"
 #include "RandomAccel2D.h"
 
 #define REQ_POSITIONAL_ARGS 2
@@ -40,7 +41,8 @@ namespace po = boost::program_options;
 
 const char usage_type[] =
     "TYPE\n"
-    "  rand2D: Randomly accelerating 2D Position";
+    "  rand2D: Randomly accelerating 2D Position\n"
+    "  replay: Positions recorded by oat-record";
 
 const char usage_io[] =
     "SINK:\n"
@@ -83,6 +85,7 @@ int main(int argc, char *argv[])
     // Component specializations
     std::unordered_map<std::string, char> type_hash;
     type_hash["rand2D"] = 'a';
+    type_hash["replay"] = 'b';
 
     // The component itself
     std::string comp_name = "posigen";
@@ -143,6 +146,11 @@ int main(int argc, char *argv[])
                     posigen = std::make_shared<oat::RandomAccel2D>(sink);
                     break;
                 }
+                case 'b':
+                {
+                    posigen = std::make_shared<oat::PositionReplay>(sink);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
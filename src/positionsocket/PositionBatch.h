@@ -0,0 +1,105 @@
+//******************************************************************************
+//* File:   PositionBatch.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+#ifndef OAT_POSITIONBATCH_H
+#define	OAT_POSITIONBATCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "../../lib/datatypes/Position2D.h"
+
+namespace oat {
+
+/**
+ * @brief Accumulates positions, packed in the layout of
+ * Position2D::NPY_DTYPE, so that several can be sent in a single message.
+ * A batch is due when it holds its maximum count or when its oldest
+ * position has waited for the batch period, whichever comes first. Each
+ * record carries its own sample number, so a receiver can unpack a batch
+ * with numpy.frombuffer() as it would a single record.
+ */
+class PositionBatch {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+
+    // Largest batch that fits into a single UDP datagram
+    static constexpr size_t MAX_COUNT {65507 / Position2D::NPY_DTYPE_BYTES};
+
+    /**
+     * @brief Set the batch limits.
+     * @param count Maximum number of positions per batch.
+     * @param period_sec Maximum time, in seconds, between the first position
+     * added to a batch and the batch being due. 0 means no time limit.
+     */
+    void configure(const size_t count, const double period_sec)
+    {
+        count_ = count;
+        period_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(period_sec));
+        data_.reserve(count_ * Position2D::NPY_DTYPE_BYTES);
+    }
+
+    /**
+     * @brief Append a position to the batch.
+     * @param position Position to append.
+     * @return True if the batch is now due to be sent.
+     */
+    bool add(const oat::Position2D &position)
+    {
+        if (n_ == 0)
+            first_ = Clock::now();
+
+        data_.resize((n_ + 1) * Position2D::NPY_DTYPE_BYTES);
+        oat::packPosition(position,
+                          data_.data() + n_ * Position2D::NPY_DTYPE_BYTES);
+        n_++;
+
+        return n_ >= count_
+               || (period_ > Clock::duration::zero()
+                   && Clock::now() - first_ >= period_);
+    }
+
+    /**
+     * @brief Empty the batch once it has been sent. Its storage is kept.
+     */
+    void clear(void) { n_ = 0; data_.clear(); }
+
+    // Positions are batched rather than sent one at a time
+    bool enabled(void) const { return count_ > 1; }
+
+    // Packed positions
+    const char *data(void) const { return data_.data(); }
+    size_t size(void) const { return data_.size(); }
+    size_t count(void) const { return n_; }
+
+private:
+
+    size_t count_ {1};
+    Clock::duration period_ {Clock::duration::zero()};
+
+    std::vector<char> data_;
+    size_t n_ {0};
+    Clock::time_point first_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONBATCH_H */
@@ -22,11 +22,6 @@
 #include <iostream>
 #include <string>
 
-#include <rapidjson/rapidjson.h>
-#include <rapidjson/prettywriter.h>
-#include <rapidjson/writer.h>
-#include <rapidjson/stringbuffer.h>
-
 #include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
@@ -38,6 +33,10 @@ po::options_description PositionCout::options() const
     local_opts.add_options()
         ("pretty-print,p", 
          "If true, print formated positions to the command line.")
+        ("latest",
+         "If true, send the most recent position instead of every position. "
+         "The upstream component never waits for this socket, and positions "
+         "that arrive while it is busy sending are dropped.")
         ;
 
     return local_opts; 
@@ -48,22 +47,23 @@ void PositionCout::applyConfiguration(const po::variables_map &vm,
 {
     // Format output
     oat::config::getValue<bool>(vm, config_table, "pretty-print", pretty_);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
 }
 
 void PositionCout::sendPosition(const oat::Position2D &position)
 {
     // Serialize the current position
-    rapidjson::StringBuffer buffer;
-
     if (pretty_) {
-        rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
-        oat::serializePosition(position, writer);
+        pretty_serializer_.serialize(position);
+        std::cout.write(pretty_serializer_.data(), pretty_serializer_.size());
     } else {
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        oat::serializePosition(position, writer);
+        serializer_.serialize(position);
+        std::cout.write(serializer_.data(), serializer_.size());
     }
 
-    std::cout << buffer.GetString() << std::flush;
+    std::cout << std::flush;
 }
 
 } /* namespace oat */
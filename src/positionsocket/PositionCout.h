@@ -21,9 +21,12 @@
 #define	OAT_POSITIONCOUT_H
 
 #include "PositionSocket.h"
+#include "PositionSerializer.h"
 
 #include <string>
 
+#include <rapidjson/prettywriter.h>
+
 namespace oat {
 
 // Forward decl.
@@ -42,6 +45,11 @@ class PositionCout : public PositionSocket {
     // Format std out stream
     bool pretty_ {false};
 
+    // JSON serializers, reused for every position
+    oat::PositionSerializer<> serializer_;
+    oat::PositionSerializer<rapidjson::PrettyWriter<rapidjson::StringBuffer>>
+        pretty_serializer_;
+
     void sendPosition(const oat::Position2D &position) override;
 };
 
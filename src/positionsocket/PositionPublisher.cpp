@@ -22,9 +22,6 @@
 #include <string>
 #include <zmq.hpp>
 
-#include <rapidjson/rapidjson.h>
-#include <rapidjson/stringbuffer.h>
-
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
@@ -46,7 +43,24 @@ po::options_description PositionPublisher::options() const
          "ZMQ-style endpoint. For TCP: '<transport>://<host>:<port>'. For instance, "
          "'tcp://*:5555'. Or, for interprocess communication: "
          "'<transport>:///<user-named-pipe>. For instance "
-         "'ipc:///tmp/test.pipe'.");
+         "'ipc:///tmp/test.pipe'.")
+        ("latest",
+         "If true, send the most recent position instead of every position. "
+         "The upstream component never waits for this socket, and positions "
+         "that arrive while it is busy sending are dropped.")
+        ("binary,b",
+         "If true, send each position as a fixed-size, 82 byte record in the "
+         "layout of binary position files saved by oat-record, rather than "
+         "as JSON. Records can be decoded with numpy.frombuffer() using the "
+         "dtype of those files.")
+        ("batch,n", po::value<int>(),
+         "Send up to n positions per message, as consecutive binary records, "
+         "rather than one message per position. Implies binary. Trades "
+         "latency for far fewer packets at high sample rates. Default is 1.")
+        ("batch-period", po::value<double>(),
+         "Maximum time, in seconds, between the first position of a batch "
+         "and the batch being sent, checked as each position arrives. "
+         "Default is 0, meaning batches are sent only when full.")
         ;
 
     return local_opts;
@@ -60,19 +74,41 @@ void PositionPublisher::applyConfiguration(
     oat::config::getValue<std::string>(
         vm, config_table, "endpoint", endpoint, true);
     publisher_.bind(endpoint);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+
+    // Encoding
+    oat::config::getValue<bool>(vm, config_table, "binary", binary_);
+
+    // Batching
+    configureBatch(vm, config_table);
 }
 
 void PositionPublisher::sendPosition(const oat::Position2D &position)
 {
+    // Send a full batch as a single message
+    if (batch_.enabled()) {
+        if (batch_.add(position)) {
+            publisher_.send(batch_.data(), batch_.size());
+            batch_.clear();
+        }
+        return;
+    }
+
+    // Pack straight into the message
+    if (binary_) {
+        zmq::message_t zmsg(oat::Position2D::NPY_DTYPE_BYTES);
+        oat::packPosition(position, static_cast<char *>(zmsg.data()));
+        publisher_.send(zmsg);
+        return;
+    }
+
     // Serialize the current position
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    oat::serializePosition(position, writer);
+    serializer_.serialize(position);
 
     // Publish update
-    zmq::message_t zmsg(buffer.GetSize());
-    memcpy((void *)zmsg.data(), buffer.GetString(), buffer.GetSize());
-    publisher_.send(zmsg);
+    publisher_.send(serializer_.data(), serializer_.size());
 }
 
 } /* namespace oat */
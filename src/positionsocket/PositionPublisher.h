@@ -21,6 +21,7 @@
 #define	OAT_POSITIONPUBLISHER_H
 
 #include "PositionSocket.h"
+#include "PositionSerializer.h"
 
 #include <string>
 #include <zmq.hpp>
@@ -44,6 +45,9 @@ private:
     zmq::context_t context_ {1};
     zmq::socket_t publisher_;
 
+    // JSON serializer, reused for every position
+    oat::PositionSerializer<> serializer_;
+
     void sendPosition(const oat::Position2D& position) override;
 };
 
@@ -19,13 +19,14 @@
 
 #include "PositionReplier.h"
 
+#include <cerrno>
+#include <cstring>
+#include <iostream>
 #include <string>
 #include <zmq.hpp>
 
-#include <rapidjson/rapidjson.h>
-#include <rapidjson/stringbuffer.h>
-
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
@@ -37,6 +38,13 @@ PositionReplier::PositionReplier(const std::string &position_source_address)
     // Nothing
 }
 
+PositionReplier::~PositionReplier()
+{
+    replying_ = false;
+    if (reply_thread_.joinable())
+        reply_thread_.join();
+}
+
 po::options_description PositionReplier::options() const
 {
     // Update CLI options
@@ -46,7 +54,17 @@ po::options_description PositionReplier::options() const
          "ZMQ-style endpoint. For TCP: '<transport>://<host>:<port>'. For instance, "
          "'tcp://*:5555'. Or, for interprocess communication: "
          "'<transport>:///<user-named-pipe>. For instance "
-         "'ipc:///tmp/test.pipe'.");
+         "'ipc:///tmp/test.pipe'.")
+        ("latest",
+         "If true, read the most recent position instead of every position. "
+         "The upstream component never waits for this socket. Requests are "
+         "always answered with the most recent position read, on a thread "
+         "of their own, so either way clients do not hold up positions.")
+        ("binary,b",
+         "If true, send each position as a fixed-size, 82 byte record in the "
+         "layout of binary position files saved by oat-record, rather than "
+         "as JSON. Records can be decoded with numpy.frombuffer() using the "
+         "dtype of those files.")
         ;
 
     return local_opts;
@@ -59,24 +77,70 @@ void PositionReplier::applyConfiguration(
     std::string endpoint;
     oat::config::getValue<std::string>(vm, config_table, "endpoint", endpoint, true);
     replier_.bind(endpoint);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+
+    // Encoding
+    oat::config::getValue<bool>(vm, config_table, "binary", binary_);
+
+    // Answer requests from now on. Until the first position, replies are
+    // empty.
+    reply_thread_ = std::thread(&PositionReplier::reply, this);
+    helper_thread_policy_.apply(reply_thread_, "reply");
 }
 
 void PositionReplier::sendPosition(const oat::Position2D& position)
 {
-    // Serialize the current position
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    oat::serializePosition(position, writer);
-
-    //  Wait for next request from client
-    // TODO: Use incoming string to decide which part of the position to send
-    zmq::message_t request;
-    replier_.recv(&request);
-
-    // Publish update
-    zmq::message_t zmsg(buffer.GetSize());
-    memcpy((void *)zmsg.data(), buffer.GetString(), buffer.GetSize());
-    replier_.send(zmsg);
+    // Encode into the back buffer
+    if (binary_) {
+        back_.resize(oat::Position2D::NPY_DTYPE_BYTES);
+        oat::packPosition(position, back_.data());
+    } else {
+        serializer_.serialize(position);
+        back_.assign(serializer_.data(), serializer_.data() + serializer_.size());
+    }
+
+    // Make it the reply to the next request
+    std::lock_guard<std::mutex> lock(front_mutex_);
+    front_.swap(back_);
+}
+
+void PositionReplier::reply()
+{
+    while (replying_) {
+
+        try {
+
+            zmq::pollitem_t p[] = {{replier_, 0, ZMQ_POLLIN, 0}};
+            zmq::poll(&p[0], 1, POLL_MS);
+            if (!(p[0].revents & ZMQ_POLLIN))
+                continue;
+
+            // TODO: Use incoming string to decide which part of the position to send
+            zmq::message_t request;
+            replier_.recv(&request);
+
+            zmq::message_t zmsg;
+            {
+                std::lock_guard<std::mutex> lock(front_mutex_);
+                zmsg.rebuild(front_.size());
+                std::memcpy(zmsg.data(), front_.data(), front_.size());
+            }
+
+            replier_.send(zmsg);
+
+        } catch (const zmq::error_t &ex) {
+
+            // Interrupted by CTRL+C, which the processing thread handles
+            if (ex.num() == EINTR)
+                continue;
+
+            std::cerr << oat::Warn(std::string("Replies stopped: ")
+                                   + ex.what() + "\n");
+            return;
+        }
+    }
 }
 
 } /* namespace oat */
@@ -21,8 +21,13 @@
 #define OAT_POSITIONREPLIER_H
 
 #include "PositionSocket.h"
+#include "PositionSerializer.h"
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <zmq.hpp>
 
 namespace oat {
@@ -30,9 +35,15 @@ namespace oat {
 // Forward decl.
 class Position2D;
 
+/**
+ * @brief Answers each request with the most recent position. Requests are
+ * answered on a thread of their own from a double buffer, so positions are
+ * never held up for a client and clients never wait for a position.
+ */
 class PositionReplier : public PositionSocket {
 public:
     PositionReplier(const std::string &position_source_address);
+    ~PositionReplier();
 
 private:
     // Configurable Interface
@@ -41,11 +52,26 @@ private:
                             const config::OptionTable &config_table) override;
 
     // TODO: ZMQ_DEALER for multiple clients?
-    // REP socket
+    // REP socket, used only by the reply thread once it starts
     zmq::context_t context_ {1};
     zmq::socket_t replier_;
 
+    // JSON serializer, reused for every position
+    oat::PositionSerializer<> serializer_;
+
+    // Double buffer: positions are encoded into back_, which is then swapped
+    // with front_, the reply to the next request. The lock is only held for
+    // the swap and for copying front_ into a message.
+    std::vector<char> front_, back_;
+    std::mutex front_mutex_;
+
+    // Reply thread, which wakes this often to check that it should go on
+    static constexpr long POLL_MS {100};
+    std::atomic<bool> replying_ {true};
+    std::thread reply_thread_;
+
     void sendPosition(const oat::Position2D& position) override;
+    void reply(void);
 };
 
 }      /* namespace oat */
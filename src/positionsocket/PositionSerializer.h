@@ -0,0 +1,78 @@
+//******************************************************************************
+//* File:   PositionSerializer.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_POSITIONSERIALIZER_H
+#define	OAT_POSITIONSERIALIZER_H
+
+#include <cstddef>
+
+#include <rapidjson/rapidjson.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "../../lib/datatypes/Position2D.h"
+
+namespace oat {
+
+/**
+ * @brief JSON position serializer that keeps its buffer and writer for the
+ * life of a socket. Each position clears them without freeing their memory,
+ * so once the buffer has grown to the size of a position nothing is
+ * allocated per position.
+ */
+template <typename Writer = rapidjson::Writer<rapidjson::StringBuffer>>
+class PositionSerializer {
+public:
+
+    // Initial buffer size, which fits a verbose position
+    static constexpr size_t INITIAL_BYTES {1024};
+
+    PositionSerializer()
+    : buffer_(nullptr, INITIAL_BYTES)
+    , writer_(buffer_)
+    {
+        // Nothing
+    }
+
+    PositionSerializer(const PositionSerializer &) = delete;
+    PositionSerializer &operator=(const PositionSerializer &) = delete;
+
+    /**
+     * @brief Serialize a position, replacing the previous one.
+     * @param position Position to serialize.
+     */
+    void serialize(const oat::Position2D &position)
+    {
+        buffer_.Clear();
+        writer_.Reset(buffer_);
+        oat::serializePosition(position, writer_);
+    }
+
+    // Serialized position
+    const char *data(void) const { return buffer_.GetString(); }
+    size_t size(void) const { return buffer_.GetSize(); }
+
+private:
+
+    rapidjson::StringBuffer buffer_;
+    Writer writer_;
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONSERIALIZER_H */
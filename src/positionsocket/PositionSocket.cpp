@@ -24,6 +24,7 @@
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
+#include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
 
@@ -37,7 +38,8 @@ PositionSocket::PositionSocket(const std::string &position_source_address)
 bool PositionSocket::connectToNode()
 {
     // Establish our a slot in the node 
-    position_source_.touch(position_source_address_);
+    position_source_.touch(position_source_address_,
+                           latest_ ? SourceMode::LATEST : SourceMode::SYNC);
 
     // Wait for synchronous start with sink when it binds its node
     if (position_source_.connect() != SourceState::CONNECTED)
@@ -46,6 +48,26 @@ bool PositionSocket::connectToNode()
     return true;
 }
 
+void PositionSocket::configureBatch(const po::variables_map &vm,
+                                    const config::OptionTable &config_table)
+{
+    int count {1};
+    oat::config::getNumericValue<int>(vm,
+                                      config_table,
+                                      "batch",
+                                      count,
+                                      1,
+                                      static_cast<int>(PositionBatch::MAX_COUNT));
+
+    double period_sec {0.0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "batch-period", period_sec, 0.0);
+
+    batch_.configure(count, period_sec);
+    if (batch_.enabled())
+        binary_ = true;
+}
+
 int PositionSocket::process()
 {
     // START CRITICAL SECTION //
@@ -54,8 +76,8 @@ int PositionSocket::process()
     if (node_state_ == oat::NodeState::END)
         return 1;
 
-    // Clone the shared position
-    internal_position_ = position_source_.clone();
+    // Copy the shared position
+    position_source_.copyTo(internal_position_);
 
     // Tell sink it can continue
     position_source_.post();
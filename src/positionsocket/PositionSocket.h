@@ -31,6 +31,8 @@
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
 
+#include "PositionBatch.h"
+
 namespace po = boost::program_options;
 
 namespace oat {
@@ -56,6 +58,23 @@ protected:
      */
     virtual void sendPosition(const oat::Position2D &position) = 0;
 
+    // Read the latest position rather than every position
+    bool latest_ {false};
+
+    // Send positions packed in the layout of Position2D::NPY_DTYPE rather
+    // than as JSON
+    bool binary_ {false};
+
+    // Positions waiting to be sent together, when batching is enabled
+    oat::PositionBatch batch_;
+
+    /**
+     * @brief Configure batching from the batch and batch-period options.
+     * Batching implies binary encoding.
+     */
+    void configureBatch(const po::variables_map &vm,
+                        const config::OptionTable &config_table);
+
 private:
     // Component Interface
     bool connectToNode(void) override;
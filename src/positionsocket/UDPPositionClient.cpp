@@ -18,17 +18,38 @@
 //******************************************************************************
 
 #include "UDPPositionClient.h"
-#include "SocketWriteStream.h"
 
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <time.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/udp.hpp>
-#include <rapidjson/rapidjson.h>
 
 #include "../../lib/datatypes/Position2D.h"
+#include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
 
+static uint64_t clockNs(const clockid_t clock)
+{
+    timespec t;
+    clock_gettime(clock, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
 UDPPositionClient::UDPPositionClient(const std::string &position_source_address)
 : PositionSocket(position_source_address)
 , socket_(io_service_, UDPEndpoint(boost::asio::ip::udp::v4(), 0))
@@ -36,6 +57,31 @@ UDPPositionClient::UDPPositionClient(const std::string &position_source_address)
     // Nothing
 }
 
+UDPPositionClient::~UDPPositionClient()
+{
+    if (!tx_timestamps_ && txtime_delay_ns_ < 0)
+        return;
+
+    // Timestamps of the last datagrams arrive after they were sent
+    collectTimestamps();
+
+    using H = oat::LatencyHistogram;
+    const auto s = tx_latency_.snapshot();
+    std::string report = "Sent " + std::to_string(next_sequence_)
+                         + " datagrams";
+    if (tx_timestamps_)
+        report += ", " + std::to_string(tx_stamped_) + " timestamped. "
+                  "Send to transmit p50 "
+                  + std::to_string(H::quantile(s, 0.5) / 1000) + " us, p99 "
+                  + std::to_string(H::quantile(s, 0.99) / 1000) + " us, max "
+                  + std::to_string(H::quantile(s, 1.0) / 1000) + " us";
+    if (txtime_delay_ns_ >= 0)
+        report += ". " + std::to_string(txtime_missed_)
+                  + " missed their launch time";
+
+    std::cerr << oat::whoMessage(name(), report + ".") << "\n";
+}
+
 po::options_description UDPPositionClient::options() const
 {
     // Update CLI options
@@ -43,10 +89,59 @@ po::options_description UDPPositionClient::options() const
     local_opts.add_options()
         ("host,h", po::value<std::string>(),
          "Host IP address of remote device to send positions to. For "
-         "instance, '10.0.0.1'.")
+         "instance, '10.0.0.1'. A multicast group address, for instance "
+         "'239.255.0.1', sends each position once to every listener that "
+         "has joined the group.")
         ("port,p", po::value<int>(),
          "Port number of endpoint on remote device to send positions to. For "
          "instance, 5555.")
+        ("latest",
+         "If true, send the most recent position instead of every position. "
+         "The upstream component never waits for this socket, and positions "
+         "that arrive while it is busy sending are dropped.")
+        ("binary,b",
+         "If true, send each position as a fixed-size, 82 byte record in the "
+         "layout of binary position files saved by oat-record, rather than "
+         "as JSON. Records can be decoded with numpy.frombuffer() using the "
+         "dtype of those files.")
+        ("batch,n", po::value<int>(),
+         "Send up to n positions per message, as consecutive binary records, "
+         "rather than one message per position. Implies binary. Trades "
+         "latency for far fewer packets at high sample rates. Default is 1.")
+        ("batch-period", po::value<double>(),
+         "Maximum time, in seconds, between the first position of a batch "
+         "and the batch being sent, checked as each position arrives. "
+         "Default is 0, meaning batches are sent only when full.")
+        ("sequence,q",
+         "If true, prefix each datagram with an unsigned 64-bit sequence "
+         "number, starting at 0 and in the byte order of the binary records, "
+         "so that listeners can detect lost datagrams.")
+        ("ttl", po::value<int>(),
+         "Multicast only. Number of router hops multicast datagrams may "
+         "cross. Default is 1, which keeps them on the local network.")
+        ("interface", po::value<std::string>(),
+         "Multicast only. IP address of the local network interface to send "
+         "multicast datagrams from. Default is chosen by the operating "
+         "system.")
+        ("loopback",
+         "Multicast only. If true, multicast datagrams are also delivered to "
+         "listeners on this host.")
+        ("low-latency",
+         "If true, send each position as a binary record, see binary, with a "
+         "single sendmsg() call from a message header prepared in advance. "
+         "Cannot be combined with batch. Use the cpus and priority options "
+         "to pin the sending thread.")
+        ("txtime", po::value<double>(),
+         "Low-latency only. Give each datagram a launch time this many "
+         "microseconds after it is sent, using SO_TXTIME with CLOCK_TAI, so "
+         "that an etf qdisc on the outgoing interface transmits it at that "
+         "time, whatever the scheduling jitter of this thread. Datagrams "
+         "whose launch time is missed are counted. Requires Linux 4.19 or "
+         "later.")
+        ("tx-timestamps",
+         "Low-latency only. If true, have the kernel timestamp each datagram "
+         "as it is handed to the network device, and report percentiles of "
+         "the time from sending to that timestamp on exit.")
         ;
 
     return local_opts;
@@ -68,25 +163,245 @@ void UDPPositionClient::applyConfiguration(
     );
 
     UDPResolver resolver(io_service_);
-    UDPEndpoint endpoint = *resolver.resolve({boost::asio::ip::udp::v4(),
-                                              host,
-                                              std::to_string(port)});
+    endpoint_ = *resolver.resolve({boost::asio::ip::udp::v4(),
+                                   host,
+                                   std::to_string(port)});
+
+    // Multicast group
+    if (endpoint_.address().is_multicast()) {
+
+        int ttl {1};
+        oat::config::getNumericValue<int>(
+            vm, config_table, "ttl", ttl, 0, 255);
+        socket_.set_option(boost::asio::ip::multicast::hops(ttl));
+
+        std::string iface;
+        if (oat::config::getValue<std::string>(
+                vm, config_table, "interface", iface)) {
+            auto addr = boost::asio::ip::address::from_string(iface);
+            if (!addr.is_v4())
+                throw std::runtime_error("Multicast interface must be an "
+                                         "IPv4 address.");
+            socket_.set_option(
+                boost::asio::ip::multicast::outbound_interface(addr.to_v4()));
+        }
+
+        bool loopback {false};
+        oat::config::getValue<bool>(vm, config_table, "loopback", loopback);
+        socket_.set_option(
+            boost::asio::ip::multicast::enable_loopback(loopback));
+    }
+
+    // Sequence numbers
+    oat::config::getValue<bool>(vm, config_table, "sequence", sequence_);
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+
+    // Encoding
+    oat::config::getValue<bool>(vm, config_table, "binary", binary_);
+
+    // Batching
+    configureBatch(vm, config_table);
+
+    // Low-latency mode
+    configureLowLatency(vm, config_table);
+}
+
+void UDPPositionClient::configureLowLatency(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    oat::config::getValue<bool>(vm, config_table, "low-latency", low_latency_);
+
+    double txtime_us {-1.0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "txtime", txtime_us, 0.0);
+    oat::config::getValue<bool>(
+        vm, config_table, "tx-timestamps", tx_timestamps_);
+
+    if (!low_latency_) {
+        if (txtime_us >= 0 || tx_timestamps_)
+            throw std::runtime_error("txtime and tx-timestamps require "
+                                     "low-latency.");
+        return;
+    }
+
+    if (batch_.enabled())
+        throw std::runtime_error("low-latency cannot be combined with batch.");
+    binary_ = true;
+
+    const int fd = socket_.native_handle();
+
+    // The sequence number, if any, and the record are gathered into one
+    // datagram
+    iov_[0].iov_base = &next_sequence_;
+    iov_[0].iov_len = sizeof(next_sequence_);
+    message_.msg_name = endpoint_.data();
+    message_.msg_namelen = endpoint_.size();
+    message_.msg_iov = sequence_ ? iov_ : iov_ + 1;
+    message_.msg_iovlen = sequence_ ? 2 : 1;
+
+    if (txtime_us >= 0) {
+#ifdef SO_TXTIME
+        txtime_delay_ns_ = static_cast<int64_t>(txtime_us * 1000.0);
+
+        sock_txtime config {};
+        config.clockid = CLOCK_TAI;
+        config.flags = SOF_TXTIME_REPORT_ERRORS;
+        if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)))
+            throw std::system_error(errno, std::generic_category(),
+                                    "SO_TXTIME");
+
+        // Only the launch time changes from one datagram to the next
+        message_.msg_control = txtime_control_;
+        message_.msg_controllen = sizeof(txtime_control_);
+        auto c = CMSG_FIRSTHDR(&message_);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_TXTIME;
+        c->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+#else
+        throw std::runtime_error("txtime is not supported on this system.");
+#endif
+    }
+
+    if (tx_timestamps_) {
+
+        // Timestamps come back on the error queue without a copy of the
+        // datagram, tagged with the index of the datagram on this socket
+        const unsigned int flags = SOF_TIMESTAMPING_TX_SOFTWARE
+                                   | SOF_TIMESTAMPING_SOFTWARE
+                                   | SOF_TIMESTAMPING_OPT_ID
+                                   | SOF_TIMESTAMPING_OPT_TSONLY;
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)))
+            throw std::system_error(errno, std::generic_category(),
+                                    "SO_TIMESTAMPING");
+    }
+}
+
+void UDPPositionClient::send(const char *data, const size_t size)
+{
+    if (low_latency_) {
+        sendLowLatency(data, size);
+        return;
+    }
+
+    if (!sequence_) {
+        socket_.send_to(boost::asio::buffer(data, size), endpoint_);
+        return;
+    }
+
+    // Sequence number and payload are gathered into one datagram
+    const std::array<boost::asio::const_buffer, 2> datagram {{
+        boost::asio::buffer(&next_sequence_, sizeof(next_sequence_)),
+        boost::asio::buffer(data, size)
+    }};
+    socket_.send_to(datagram, endpoint_);
+    next_sequence_++;
+}
+
+void UDPPositionClient::sendLowLatency(const char *data, const size_t size)
+{
+    iov_[1].iov_base = const_cast<char *>(data);
+    iov_[1].iov_len = size;
+
+#ifdef SO_TXTIME
+    if (txtime_delay_ns_ >= 0) {
+        const uint64_t launch = clockNs(CLOCK_TAI) + txtime_delay_ns_;
+        std::memcpy(CMSG_DATA(CMSG_FIRSTHDR(&message_)),
+                    &launch,
+                    sizeof(launch));
+    }
+#endif
+
+    // Software timestamps are taken on the realtime clock
+    if (tx_timestamps_)
+        tx_sent_ns_[tx_id_ % TX_PENDING] = clockNs(CLOCK_REALTIME);
+
+    if (::sendmsg(socket_.native_handle(), &message_, 0) < 0)
+        throw std::system_error(errno, std::generic_category(), "sendmsg");
+
+    next_sequence_++;
+
+    if (tx_timestamps_ || txtime_delay_ns_ >= 0) {
+        tx_id_++;
+        collectTimestamps();
+    }
+}
+
+void UDPPositionClient::collectTimestamps()
+{
+    alignas(cmsghdr) char control[256];
+
+    while (true) {
+
+        msghdr message {};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (::recvmsg(socket_.native_handle(),
+                      &message,
+                      MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            return;
+
+        const scm_timestamping *stamp {nullptr};
+        const sock_extended_err *error {nullptr};
+        for (auto c = CMSG_FIRSTHDR(&message);
+             c != nullptr;
+             c = CMSG_NXTHDR(&message, c)) {
+
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING)
+                stamp = reinterpret_cast<const scm_timestamping *>(CMSG_DATA(c));
+            else if (c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+                error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(c));
+        }
+
+        if (error == nullptr)
+            continue;
+
+#ifdef SO_EE_ORIGIN_TXTIME
+        // The qdisc dropped a datagram whose launch time had passed
+        if (error->ee_origin == SO_EE_ORIGIN_TXTIME) {
+            txtime_missed_++;
+            continue;
+        }
+#endif
+
+        // Timestamps of datagrams too old to still have their send time are
+        // ignored
+        const uint32_t id = error->ee_data;
+        if (stamp == nullptr
+            || error->ee_origin != SO_EE_ORIGIN_TIMESTAMPING
+            || tx_id_ - id > TX_PENDING)
+            continue;
 
-    udp_stream_.reset(new rapidjson::SocketWriteStream<UDPSocket, UDPEndpoint>(
-            &socket_, endpoint, buffer_, sizeof(buffer_)));
+        const uint64_t tx_ns
+            = static_cast<uint64_t>(stamp->ts[0].tv_sec) * 1000000000ULL
+              + stamp->ts[0].tv_nsec;
+        const uint64_t sent_ns = tx_sent_ns_[id % TX_PENDING];
+        tx_latency_.record(tx_ns > sent_ns ? tx_ns - sent_ns : 0);
+        tx_stamped_++;
+    }
 }
 
-// Each position is sent in a single UDP packet
+// Each position, or batch of positions, is sent in a single UDP packet
 void UDPPositionClient::sendPosition(const oat::Position2D &current_position)
 {
-    rapidjson::Writer < rapidjson::SocketWriteStream
-                      < UDPSocket, UDPEndpoint > > udp_writer_ {*udp_stream_};
+    // A full batch is sent as a single datagram
+    if (batch_.enabled()) {
+        if (batch_.add(current_position)) {
+            send(batch_.data(), batch_.size());
+            batch_.clear();
+        }
+        return;
+    }
 
-    oat::serializePosition(current_position, udp_writer_);
+    if (binary_) {
+        oat::packPosition(current_position, packed_);
+        send(packed_, sizeof(packed_));
+        return;
+    }
 
-    // Flush the stream after each Serialization call so that each UDP packet
-    // corresponds to a single position value
-    udp_stream_->Flush();
+    serializer_.serialize(current_position);
+    send(serializer_.data(), serializer_.size());
 }
 
 } /* namespace oat */
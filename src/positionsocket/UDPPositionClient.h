@@ -21,12 +21,19 @@
 #define	OAT_UDPCLIENT_H
 
 #include "PositionSocket.h"
+#include "PositionSerializer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/udp.hpp>
-#include <rapidjson/rapidjson.h>
 
-#include "SocketWriteStream.h"
+#include "../../lib/shmemdf/Telemetry.h"
 
 namespace oat {
 
@@ -38,10 +45,10 @@ class UDPPositionClient : public PositionSocket {
     using UDPSocket = boost::asio::ip::udp::socket;
     using UDPEndpoint = boost::asio::ip::udp::endpoint;
     using UDPResolver = boost::asio::ip::udp::resolver;
-    using SocketWriter = rapidjson::SocketWriteStream<UDPSocket, UDPEndpoint>;
 
 public:
     UDPPositionClient(const std::string &position_source_name);
+    ~UDPPositionClient();
 
 private:
     // Configurable Interface
@@ -52,11 +59,58 @@ private:
     // IO service
     boost::asio::io_service io_service_;
     UDPSocket socket_;
+    UDPEndpoint endpoint_;
+
+    // Position encoders, reused for every position
+    oat::PositionSerializer<> serializer_;
+    char packed_[oat::Position2D::NPY_DTYPE_BYTES];
+
+    // Prefix each datagram with a sequence number so that listeners can
+    // detect lost datagrams
+    bool sequence_ {false};
+    uint64_t next_sequence_ {0};
+
+    // Low-latency mode. Binary records are sent with sendmsg() from a
+    // message header built once, optionally with a launch time for the
+    // interface's qdisc and with kernel transmit timestamps.
+    bool low_latency_ {false};
+    int64_t txtime_delay_ns_ {-1};
+    msghdr message_ {};
+    iovec iov_[2] {};
+    alignas(cmsghdr) char txtime_control_[CMSG_SPACE(sizeof(uint64_t))] {};
+
+    // Transmit timestamps are matched to the time of their sendmsg() call
+    // by the kernel's per-socket datagram counter
+    static constexpr uint32_t TX_PENDING {256};
+    bool tx_timestamps_ {false};
+    uint32_t tx_id_ {0};
+    std::array<uint64_t, TX_PENDING> tx_sent_ns_ {};
+    oat::LatencyHistogram tx_latency_;
+    uint64_t tx_stamped_ {0};
+    uint64_t txtime_missed_ {0};
+
+    void configureLowLatency(const po::variables_map &vm,
+                             const config::OptionTable &config_table);
+
+    /**
+     * @brief Send one datagram in low-latency mode.
+     * @param data Datagram payload.
+     * @param size Payload size in bytes.
+     */
+    void sendLowLatency(const char *data, const size_t size);
+
+    /**
+     * @brief Read transmit timestamps and launch time errors from the
+     * socket's error queue, without blocking.
+     */
+    void collectTimestamps(void);
 
-    // Custom RapidJSON UDP stream
-    static constexpr size_t MAX_LENGTH {65507}; // max udp buffer size
-    char buffer_[MAX_LENGTH]; // Buffer is flushed after each position read
-    std::unique_ptr<SocketWriter> udp_stream_;
+    /**
+     * @brief Send one datagram, prefixed by the sequence number if enabled.
+     * @param data Datagram payload.
+     * @param size Payload size in bytes.
+     */
+    void send(const char *data, const size_t size);
 
     void sendPosition(const oat::Position2D& position) override;
 };
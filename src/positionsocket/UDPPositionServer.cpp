@@ -17,53 +17,180 @@
 //* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
 //******************************************************************************
 
+#include "UDPPositionServer.h"
+
+#include <utility>
+
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/udp.hpp>
-#include <boost/asio/deadline_timer.hpp>
-
-#include <rapidjson/rapidjson.h>
 
+#include "../../lib/base/Globals.h"
 #include "../../lib/datatypes/Position2D.h"
-
-#include "SocketWriteStream.h"
-#include "UDPPositionServer.h"
+#include "../../lib/utility/TOMLSanitize.h"
 
 namespace oat {
 
-UDPPositionServer::UDPPositionServer(const std::string &position_source_address,
-                                     const unsigned short port) :
-  PositionSocket(position_source_address)
-, socket_(io_service_, UDPEndpoint(boost::asio::ip::udp::v4(), port))
-, input_deadline_(io_service_) {
+UDPPositionServer::UDPPositionServer(const std::string &position_source_address)
+: PositionSocket(position_source_address)
+{
+    // Nothing
+}
 
-    input_deadline_.expires_at(boost::posix_time::pos_infin);
+UDPPositionServer::~UDPPositionServer()
+{
+    io_service_.stop();
+    if (io_thread_.joinable())
+        io_thread_.join();
+}
 
-    udp_stream_.reset(new rapidjson::SocketWriteStream<UDPSocket, UDPEndpoint>(
-            &socket_, endpoint_, tx_buffer_, sizeof(tx_buffer_)));
+po::options_description UDPPositionServer::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("port,p", po::value<int>(),
+         "Port number to serve positions on. Clients subscribe by sending any "
+         "datagram to this port.")
+        ("timeout,t", po::value<double>(),
+         "Seconds after its last datagram that a client stops receiving "
+         "positions. Clients should resend a datagram more often than this "
+         "to stay subscribed. Default is 10.")
+        ("latest",
+         "If true, send the most recent position instead of every position. "
+         "The upstream component never waits for this socket, and positions "
+         "that arrive while it is busy sending are dropped.")
+        ("binary,b",
+         "If true, send each position as a fixed-size, 82 byte record in the "
+         "layout of binary position files saved by oat-record, rather than "
+         "as JSON. Records can be decoded with numpy.frombuffer() using the "
+         "dtype of those files.")
+        ;
+
+    return local_opts;
+}
 
+void UDPPositionServer::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    // Port
+    int port;
+    oat::config::getNumericValue<int>(
+        vm, config_table, "port", port, 1025, 65535, true
+    );
+
+    // Client timeout
+    double timeout_sec;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "timeout", timeout_sec, 0.0)) {
+        client_timeout_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(timeout_sec));
+    }
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+
+    // Encoding
+    oat::config::getValue<bool>(vm, config_table, "binary", binary_);
+
+    socket_.reset(new UDPSocket(
+        io_service_, UDPEndpoint(boost::asio::ip::udp::v4(), port)));
+
+    // The reactor owns the socket from here on. Pending receives keep it busy
+    // until the destructor stops it.
+    receive();
+    io_thread_ = std::thread([this] { io_service_.run(); });
 }
 
-void UDPPositionServer::sendPosition(const oat::Position2D& current_position) {
+void UDPPositionServer::receive()
+{
+    socket_->async_receive_from(
+        boost::asio::buffer(rx_buffer_, MAX_REQUEST),
+        remote_,
+        [this](const boost::system::error_code &ec, std::size_t) {
 
-    rapidjson::Writer < rapidjson::SocketWriteStream
-                      < UDPSocket, UDPEndpoint > > udp_writer_ {*udp_stream_};
+            if (ec == boost::asio::error::operation_aborted)
+                return;
 
-    // Need to receive request from remote client in order to proceed.
-    // TODO: check request message contents?
-    // TODO: A request does not nessesarily result in a full positional datum being sent, but just
-    //       in the current position being serialized and maybe sent if flush is called within the
-    //       the SocktWriteStream.
-    // TODO: This operation needs a timeout to prevent everything from locking up
-    //       the program wants to quit but nobody is sending any requests.
+            // Any datagram renews its sender's subscription. Errors, e.g.
+            // those reported for a departed client, renew nothing, so dead
+            // clients expire.
+            if (!ec)
+                clients_[remote_] = Clock::now();
 
-    /*size_t length = */ socket_.receive_from(
-        boost::asio::buffer(rx_buffer_, MAX_LENGTH), endpoint_);
+            receive();
+        });
+}
 
-    current_position.Serialize(udp_writer_);
+void UDPPositionServer::broadcast()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        std::swap(queued_, sending_);
+        send_pending_ = false;
+    }
+    queue_drained_.notify_one();
+
+    const auto now = Clock::now();
+    for (auto c = clients_.begin(); c != clients_.end();) {
+        if (now - c->second > client_timeout_)
+            c = clients_.erase(c);
+        else
+            ++c;
+    }
+
+    for (const auto &position : sending_) {
+
+        const auto buffer = boost::asio::buffer(position);
+
+        // Datagrams to a client that cannot take them are dropped
+        for (const auto &c : clients_) {
+            boost::system::error_code ec;
+            socket_->send_to(buffer, c.first, 0, ec);
+        }
+    }
+
+    sending_.clear();
+}
 
-    // Flush the stream after each Serialization call so that each UDP packet
-    // corresponds to a single position value
-    udp_stream_->Flush();
+// Each position is sent in a single UDP packet to each client
+void UDPPositionServer::sendPosition(const oat::Position2D &current_position)
+{
+    const char *data;
+    size_t size;
+
+    if (binary_) {
+        packed_.resize(oat::Position2D::NPY_DTYPE_BYTES);
+        oat::packPosition(current_position, packed_.data());
+        data = packed_.data();
+        size = packed_.size();
+    } else {
+        serializer_.serialize(current_position);
+        data = serializer_.data();
+        size = serializer_.size();
+    }
+
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+
+    if (latest_ && !queued_.empty()) {
+        queued_.back().assign(data, data + size);
+    } else {
+        // Bounded so that quit is seen if the reactor stops draining the
+        // queue
+        while (!queue_drained_.wait_for(
+                   lock, std::chrono::milliseconds(100),
+                   [this] { return queued_.size() < MAX_QUEUED; })) {
+            if (quit)
+                return;
+        }
+        queued_.emplace_back(data, data + size);
+    }
+
+    // One broadcast is posted at a time. It sends whatever positions are
+    // queued when it runs.
+    if (!send_pending_) {
+        send_pending_ = true;
+        io_service_.post([this] { broadcast(); });
+    }
 }
 
-} /* namespace oat */
\ No newline at end of file
+} /* namespace oat */
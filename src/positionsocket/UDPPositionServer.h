@@ -20,12 +20,21 @@
 #ifndef OAT_UDPSERVER_H
 #define	OAT_UDPSERVER_H
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/udp.hpp>
 
-#include <rapidjson/rapidjson.h>
-
-#include "SocketWriteStream.h"
+#include "PositionSerializer.h"
 #include "PositionSocket.h"
 
 namespace oat {
@@ -37,42 +46,69 @@ class UDPPositionServer : public PositionSocket {
 
     using UDPSocket = boost::asio::ip::udp::socket;
     using UDPEndpoint = boost::asio::ip::udp::endpoint;
-    using UDPResolver = boost::asio::ip::udp::resolver;
-    using DeadlineTimer = boost::asio::deadline_timer;
+    using Clock = std::chrono::steady_clock;
 
 public:
 
-    UDPPositionServer(const std::string& position_source_name,
-             const unsigned short port);
+    /**
+     * @brief A UDP position server. Clients subscribe by sending any datagram
+     * to the server's port and stay subscribed for a timeout after their last
+     * datagram. Each position from SOURCE is pushed to every subscribed
+     * client by an asio reactor on its own thread, so neither slow clients
+     * nor the absence of clients hold up the SOURCE.
+     * @param position_source_address Position source to emit from.
+     */
+    explicit UDPPositionServer(const std::string &position_source_address);
+    ~UDPPositionServer() override;
 
 private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
 
-    // IO service
+    // Reactor
     boost::asio::io_service io_service_;
+    std::unique_ptr<UDPSocket> socket_;
+    std::thread io_thread_;
+
+    // Subscribed clients and the time of their last datagram. Only touched
+    // by the reactor thread.
+    std::map<UDPEndpoint, Clock::time_point> clients_;
+    Clock::duration client_timeout_ {std::chrono::seconds(10)};
+
+    // Incoming datagrams
+    static constexpr size_t MAX_REQUEST {512};
+    char rx_buffer_[MAX_REQUEST];
+    UDPEndpoint remote_;
+
+    // Serialized positions, handed from the component thread to the reactor.
+    // With --latest, a position that arrives before the previous one was
+    // sent replaces it. Otherwise every position is queued, and the
+    // component thread waits while MAX_QUEUED are waiting to be sent.
+    static constexpr size_t MAX_QUEUED {256};
+    std::mutex queue_mutex_;
+    std::condition_variable queue_drained_;
+    std::deque<std::vector<char>> queued_, sending_;
+    bool send_pending_ {false};
+
+    // Position encoders, used by the component thread only
+    oat::PositionSerializer<> serializer_;
+    std::vector<char> packed_;
 
-    // RX/TX buffers
-    static const size_t MAX_LENGTH {65507}; // max udp buffer size
-    char tx_buffer_[MAX_LENGTH]; // Buffer is flushed after each position read
-    char rx_buffer_[MAX_LENGTH];
-
-    // UDP communication specs
-    UDPSocket socket_;
-    UDPEndpoint endpoint_;
-    DeadlineTimer input_deadline_;
-
-    // Custom RapidJSON UDP stream and writer
-    std::unique_ptr < rapidjson::SocketWriteStream
-                    < UDPSocket, UDPEndpoint > > udp_stream_;
+    /**
+     * @brief Wait for the next datagram from any client.
+     */
+    void receive(void);
 
     /**
-     *
-     * @param position
-     * @param sample
+     * @brief Send the queued positions to every subscribed client, in order,
+     * and drop those that have timed out. Runs on the reactor thread.
      */
-    void sendPosition(const oat::Position2D& position) override;
+    void broadcast(void);
 
+    void sendPosition(const oat::Position2D& position) override;
 };
 
 }      /* namespace oat */
 #endif /* OAT_UDPSERVER_H */
-
@@ -34,6 +34,7 @@
 #include "PositionReplier.h"
 #include "PositionSocket.h"
 #include "UDPPositionClient.h"
+#include "UDPPositionServer.h"
 
 #define REQ_POSITIONAL_ARGS 2
 
@@ -50,7 +51,10 @@ const char usage_type[] =
     "       endpoint.Several transport/protocol options. The most\n"
     "       useful are tcp and interprocess (ipc).\n"
     "  udp: Asynchronous, client-side, unicast user datagram protocol\n"
-    "       over a traditional BSD-style socket.";
+    "       over a traditional BSD-style socket.\n"
+    "  udps: Asynchronous, server-side user datagram protocol. Sends\n"
+    "       positions to every client that has recently sent it a\n"
+    "       datagram.";
 
 const char usage_io[] =
     "SOURCE:\n"
@@ -94,6 +98,7 @@ int main(int argc, char *argv[])
     type_hash["rep"] = 'b';
     type_hash["udp"] = 'c';
     type_hash["std"] = 'd';
+    type_hash["udps"] = 'e';
 
     // The component itself
     std::string comp_name = "posisock";
@@ -168,6 +173,11 @@ int main(int argc, char *argv[])
                     socket = std::make_shared<oat::PositionCout>(source);
                     break;
                 }
+                case 'e':
+                {
+                    socket = std::make_shared<oat::UDPPositionServer>(source);
+                    break;
+                }
                 default:
                 {
                     printUsage(visible_options, "");
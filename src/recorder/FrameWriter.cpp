@@ -18,14 +18,58 @@
 //*****************************************************************************
 
 #include "FrameWriter.h"
+#include "LibavEncoder.h"
+#include "Muxer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
 
 #include "../../lib/utility/FileFormat.h"
 #include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/make_unique.h"
 
 namespace oat {
 
+static bool fileExists(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+FrameWriter::~FrameWriter()
+{
+    if (frames_encoded_ > 0)
+        std::cout << oat::whoMessage(addr(),
+                "Encoded " + std::to_string(frames_encoded_) + " frames. "
+                "Peak write queue depth was " + std::to_string(queue_peak_)
+                + " of " + std::to_string(queue_capacity_) + " frames.\n");
+
+    if (!rotating())
+        return;
+
+    indexChunk();
+    if (chunk_index_ != nullptr)
+        fclose(chunk_index_);
+
+    // Discard the chunk that was opened in advance but never used
+    try {
+        if (next_encoder_.valid())
+            next_encoder_.get()->remove();
+    } catch (...) {
+        // Nothing to discard
+    }
+
+    for (auto &c : closing_)
+        c.wait();
+}
+
 void FrameWriter::configure(const oat::config::OptionTable &t,
                             const po::variables_map &vm)
 {
@@ -47,14 +91,75 @@ void FrameWriter::configure(const oat::config::OptionTable &t,
         if (fourcc_ < 0)
             throw std::runtime_error("Unsupported fourcc code.");
     }
+
+    // Recorded region
+    std::vector<int> crop;
+    if (oat::config::getArray<int, 4>(vm, t, "crop", crop)) {
+        use_crop_ = true;
+        crop_ = cv::Rect(crop[0], crop[1], crop[2], crop[3]);
+    }
+
+    // Downscaling
+    oat::config::getNumericValue<double>(vm, t, "scale", scale_, 0.01, 1.0);
+
+    // Encoding backend
+    encoder_chosen_ = oat::config::getValue(vm, t, "encoder", encoder_name_);
+    oat::config::getNumericValue<int>(
+        vm, t, "encode-threads", encode_threads_, 0, 256);
+    encoder_ = makeVideoEncoder(encoder_name_, encode_threads_);
+
+    // File rotation
+    double mb = 0;
+    if (oat::config::getNumericValue<double>(vm, t, "rotate-size", mb, 0))
+        rotate_bytes_ = static_cast<uint64_t>(mb * (1 << 20));
+    oat::config::getNumericValue<double>(vm, t, "rotate-duration", rotate_sec_, 0);
 }
 
 oat::SourceState FrameWriter::connect()
 {
     auto rc = source_.connect();
 
+    // Queued frames are not read until the encoder gets to them, so copying
+    // them must not evict the frames that co-located components work on
+    source_.set_copy_hint(oat::CopyHint::STREAM);
+
     // Get frame meta data to format video writer
     frame_params_ = source_.parameters();
+
+    if (use_crop_) {
+
+        const cv::Rect frame(0, 0, frame_params_.cols, frame_params_.rows);
+        if ((crop_ & frame) != crop_ || crop_.area() == 0)
+            throw std::runtime_error("crop must be a non-empty rectangle within "
+                                     "the frames of source " + addr() + ".");
+
+        // Keep the Bayer tile, and so the color, of the SOURCE
+        if (oat::is_bayer(frame_params_.color)) {
+            crop_.x &= ~1;
+            crop_.y &= ~1;
+            crop_.width &= ~1;
+            crop_.height &= ~1;
+        }
+
+        frame_params_.cols = crop_.width;
+        frame_params_.rows = crop_.height;
+    }
+
+    if (scale_ < 1.0) {
+
+        if (oat::is_bayer(frame_params_.color))
+            throw std::runtime_error("Bayer frames of source " + addr()
+                                     + " cannot be scaled. Demosaic them with "
+                                     "oat-framefilt col first.");
+
+        frame_params_.cols = std::max<size_t>(
+            1, static_cast<size_t>(std::lround(frame_params_.cols * scale_)));
+        frame_params_.rows = std::max<size_t>(
+            1, static_cast<size_t>(std::lround(frame_params_.rows * scale_)));
+    }
+
+    frame_params_.step = frame_params_.cols * CV_ELEM_SIZE(frame_params_.type);
+    frame_params_.bytes = frame_params_.rows * frame_params_.step;
     fps_ = source_.retrieve()->sample().rate_hz();
     if (fps_ == 0) {
         std::cerr << oat::Warn("Unknown sample rate for source " + addr());
@@ -66,31 +171,280 @@ oat::SourceState FrameWriter::connect()
 
 void FrameWriter::initialize(const std::string &path)
 {
-    path_ = path + ".avi";
+    if (!encoder_)
+        encoder_ = makeVideoEncoder(encoder_name_, encode_threads_);
+
+    batch_.reserve(queue_capacity_);
+
+    if (!rotating()) {
+
+        path_ = path + encoder_->extension();
+
+        if (!allow_overwrite_)
+           oat::ensureUniquePath(path_);
+
+        if (!oat::checkWritePermission(path_))
+            throw std::runtime_error("Write permission denied for " + path_);
+
+        encoder_->open(path_, fourcc_, fps_, frame_params_);
+        return;
+    }
+
+    // Chunks are named <base>_0000<ext>, <base>_0001<ext>, ... and are listed
+    // in <base>.chunks.csv
+    extension_ = encoder_->extension();
+    base_path_ = path;
+    for (int i = 1; !allow_overwrite_
+                    && (fileExists(base_path_ + ".chunks.csv")
+                        || fileExists(chunkPath(0))); i++)
+        base_path_ = path + "_" + std::to_string(i);
+
+    auto index_path = base_path_ + ".chunks.csv";
+    chunk_index_ = fopen(index_path.c_str(), "w");
+    if (chunk_index_ == nullptr)
+        throw std::runtime_error("Write permission denied for " + index_path);
+    fprintf(chunk_index_, "file,first_sample,last_sample\n");
+    fflush(chunk_index_);
+
+    chunk_ = 0;
+    path_ = chunkPath(chunk_);
+    encoder_ = openChunk(chunk_);
+    next_encoder_ = std::async(std::launch::async,
+                               &FrameWriter::openChunk, this, chunk_ + 1);
+}
+
+#ifdef USE_FFMPEG
+void FrameWriter::initialize(oat::Muxer &muxer)
+{
+    if (encoder_chosen_ && encoder_name_ != "ffv1"
+        && encoder_name_ != "x264-lossless")
+        throw std::runtime_error("Frames written to a single file with the "
+                                 "other SOURCEs must use the ffv1 or "
+                                 "x264-lossless encoder.");
+    if (rotating())
+        throw std::runtime_error("Frames written to a single file with the "
+                                 "other SOURCEs cannot be rotated.");
+
+    auto encoder = oat::make_unique<LibavEncoder>(
+        encoder_name_ == "x264-lossless" ? LibavEncoder::Codec::H264_LOSSLESS
+                                         : LibavEncoder::Codec::FFV1,
+        encode_threads_);
+    encoder->open(muxer, addr_, fps_, frame_params_);
+    encoder_ = std::move(encoder);
+
+    batch_.reserve(queue_capacity_);
+    path_ = muxer.path();
+}
+#endif
+
+void FrameWriter::deleteFile()
+{
+    if (encoder_)
+        encoder_->remove();
+
+    if (!rotating())
+        return;
+
+    if (next_encoder_.valid()) {
+        next_encoder_.get()->remove();
+        next_encoder_ = std::future<std::unique_ptr<VideoEncoder>>();
+    }
+
+    std::remove((base_path_ + ".chunks.csv").c_str());
+}
+
+std::string FrameWriter::chunkPath(const size_t chunk) const
+{
+    std::ostringstream p;
+    p << base_path_ << "_" << std::setw(4) << std::setfill('0') << chunk
+      << extension_;
+    return p.str();
+}
 
-    if (!allow_overwrite_)
-       oat::ensureUniquePath(path_);
+std::unique_ptr<VideoEncoder> FrameWriter::openChunk(const size_t chunk) const
+{
+    auto p = chunkPath(chunk);
+    auto e = makeVideoEncoder(encoder_name_, encode_threads_);
+    e->open(p, fourcc_, fps_, frame_params_);
+    return e;
+}
 
-    if (!oat::checkWritePermission(path_))
-        throw std::runtime_error("Write permission denied for " + path_);
+bool FrameWriter::chunkFull(const RecordedFrame &next) const
+{
+    if (chunk_frames_ == 0)
+        return false;
 
-    auto sz = cv::Size(frame_params_.cols, frame_params_.rows);
+    if (rotate_bytes_ > 0 && chunk_bytes_ >= rotate_bytes_)
+        return true;
 
-    if (!video_writer_.open(path_, fourcc_, fps_, sz))
-        throw std::runtime_error("Could open video writer.");
+    const auto usec = next.sample.microseconds().count() - chunk_start_usec_;
+    return rotate_sec_ > 0 && usec >= rotate_sec_ * 1e6;
+}
+
+void FrameWriter::encode(const size_t begin, const size_t end)
+{
+    if (begin == end)
+        return;
+
+    if (begin == 0 && end == batch_.size())
+        encoder_->encode(batch_);
+    else
+        encoder_->encode(std::vector<RecordedFrame>(batch_.begin() + begin,
+                                                    batch_.begin() + end));
+
+    struct stat st;
+    if (stat(path_.c_str(), &st) == 0)
+        chunk_bytes_ = st.st_size;
+}
+
+void FrameWriter::rotate()
+{
+    indexChunk();
+
+    // Finish the old chunk in the background. Closing a video file can take
+    // a while when the container needs its index written.
+    closing_.emplace_back(std::async(std::launch::async,
+        [](std::unique_ptr<VideoEncoder> e) { e.reset(); },
+        std::move(encoder_)));
+
+    // Throws if the next chunk could not be opened
+    encoder_ = next_encoder_.get();
+    path_ = chunkPath(++chunk_);
+    chunk_frames_ = 0;
+    chunk_bytes_ = 0;
+
+    next_encoder_ = std::async(std::launch::async,
+                               &FrameWriter::openChunk, this, chunk_ + 1);
+
+    // Forget closers that are done
+    closing_.erase(std::remove_if(closing_.begin(), closing_.end(),
+        [](const std::future<void> &c) {
+            return c.wait_for(std::chrono::seconds(0))
+                   == std::future_status::ready;
+        }), closing_.end());
+}
+
+void FrameWriter::indexChunk()
+{
+    if (chunk_frames_ == 0 || chunk_index_ == nullptr)
+        return;
+
+    auto p = chunkPath(chunk_);
+    auto name = p.substr(p.find_last_of('/') + 1);
+    fprintf(chunk_index_, "%s,%llu,%llu\n",
+            name.c_str(),
+            static_cast<unsigned long long>(chunk_first_),
+            static_cast<unsigned long long>(chunk_last_));
+    fflush(chunk_index_);
 }
 
 void FrameWriter::write(void)
 {
-    cv::Mat mat;
-    while (buffer_.pop(mat))
-        video_writer_.write(mat);
+    // Take everything queued at once so that the encoder sees whole batches
+    // and buffer_ is only touched once per wakeup
+    RecordedFrame f;
+    while (buffer_->pop(f))
+        batch_.push_back(f);
+
+    if (batch_.empty())
+        return;
+
+    frames_encoded_ += batch_.size();
+    queue_peak_ = std::max(queue_peak_, batch_.size());
+    if (!queue_warned_ && batch_.size() > queue_capacity_ / 2) {
+        std::cerr << oat::Warn("Write queue for source " + addr() + " is "
+                               "over half full. Encoding is falling behind.\n");
+        queue_warned_ = true;
+    }
+
+    if (!rotating()) {
+        encoder_->encode(batch_);
+        batch_.clear();
+        return;
+    }
+
+    // Split the batch wherever a chunk fills up
+    size_t begin = 0;
+    for (size_t i = 0; i < batch_.size(); i++) {
+
+        const auto &f = batch_[i];
+        if (chunkFull(f)) {
+            encode(begin, i);
+            rotate();
+            begin = i;
+        }
+
+        if (chunk_frames_++ == 0) {
+            chunk_first_ = f.sample.count();
+            chunk_start_usec_ = f.sample.microseconds().count();
+        }
+        chunk_last_ = f.sample.count();
+    }
+
+    encode(begin, batch_.size());
+    batch_.clear();
 }
 
 void FrameWriter::push(void )
 {
-    if (!buffer_.push(source_.clone()))
+    for (const auto &f : pretrigger_)
+        if (!buffer_->push(f))
+            throw std::runtime_error(OVERRUN_MSG);
+    pretrigger_.clear();
+
+    if (!buffer_->push({source_.retrieve()->sample(), copyFrame()}))
         throw std::runtime_error(OVERRUN_MSG);
+
+    queued_.notify();
+}
+
+double FrameWriter::activity(int64_t &usec)
+{
+    const auto &frame = source_.borrow();
+    usec = frame.sample().microseconds().count();
+
+    // Every GATE_STRIDE-th pixel of every GATE_STRIDE-th row is plenty to see
+    // an animal move and keeps the gate far cheaper than encoding
+    cv::resize(frame, gate_frame_, cv::Size(),
+               1.0 / GATE_STRIDE, 1.0 / GATE_STRIDE, cv::INTER_NEAREST);
+    cv::swap(gate_frame_, gate_previous_);
+
+    if (gate_frame_.size() != gate_previous_.size()
+        || gate_frame_.type() != gate_previous_.type()
+        || gate_frame_.empty())
+        return -1;
+
+    // Mean absolute difference, per channel
+    return cv::norm(gate_frame_, gate_previous_, cv::NORM_L1)
+           / (gate_frame_.total() * gate_frame_.channels());
+}
+
+void FrameWriter::hold(void)
+{
+    if (pretrigger_.capacity() > 0)
+        pretrigger_.push_back({source_.retrieve()->sample(), copyFrame()});
+}
+
+cv::Mat FrameWriter::copyFrame() const
+{
+    if (!use_crop_ && scale_ == 1.0)
+        return source_.clone();
+
+    // Only the recorded region is read from the node. When scaling, it is
+    // resized straight into the queued frame.
+    cv::Mat region = source_.borrow();
+    if (use_crop_)
+        region = region(crop_);
+
+    cv::Mat out;
+    if (scale_ == 1.0)
+        oat::copyPixels(region, out, oat::CopyHint::STREAM);
+    else
+        cv::resize(region, out,
+                   cv::Size(frame_params_.cols, frame_params_.rows),
+                   0, 0, cv::INTER_AREA);
+
+    return out;
 }
 
 } /* namespace oat */
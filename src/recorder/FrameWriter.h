@@ -20,10 +20,18 @@
 #ifndef OAT_FRAMEWRITER_H
 #define OAT_FRAMEWRITER_H
 
+#include "OatConfig.h" // Generated by CMake
 #include "Writer.h"
+#include "VideoEncoder.h"
 
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
 #include <boost/lockfree/spsc_queue.hpp>
-#include <opencv2/videoio.hpp>
 
 #include "../../lib/datatypes/Frame.h"
 #include "../../lib/utility/FileFormat.h"
@@ -31,11 +39,15 @@
 namespace oat {
 namespace blf = boost::lockfree;
 
+class Muxer;
+
 class FrameWriter : public Writer {
 
 public:
     using Writer::Writer;
 
+    ~FrameWriter();
+
     void configure(const oat::config::OptionTable &t,
                    const po::variables_map &vm) override;
     void touch() override { source_.touch(addr_); }
@@ -44,29 +56,105 @@ public:
     {
         return source_.retrieve()->sample_period_sec();
     }
+    uint64_t sample_count() override
+    {
+        return source_.retrieve()->sample_count();
+    }
     oat::NodeState wait() override { return source_.wait(); }
     void post(void) override { source_.post(); }
 
     void initialize(const std::string &path) override;
+#ifdef USE_FFMPEG
+    /**
+     * @brief Encode to a video track of a file shared with the recorder's
+     * other writers instead of to a file of this writer's own. Replaces
+     * initialize(path). Frames are losslessly encoded, with ffv1 unless the
+     * x264-lossless encoder is chosen.
+     */
+    void initialize(oat::Muxer &muxer);
+#endif
     void write(void) override;
+    bool pending(void) const override { return buffer_->read_available() > 0; }
+    int niceness(void) const override { return 5; } // Behind position writes
     void push(void) override;
-    void deleteFile() override
+    void hold(void) override;
+    void setPretrigger(const double seconds) override
     {
-        if (!path_.empty())
-            std::remove(path_.c_str());
+        const auto n = pretriggerSamples(seconds);
+        pretrigger_.set_capacity(n);
+        queue_capacity_ = BUFFER_SIZE + n;
+        buffer_.reset(new SPSCBuffer(queue_capacity_));
     }
+    double activity(int64_t &usec) override;
+    void deleteFile() override;
 
 private:
-    using SPSCBuffer
-        = boost::lockfree::spsc_queue<oat::Frame, blf::capacity<BUFFER_SIZE>>;
-    SPSCBuffer buffer_;
+    using SPSCBuffer = boost::lockfree::spsc_queue<RecordedFrame>;
+    size_t queue_capacity_ {BUFFER_SIZE};
+    std::unique_ptr<SPSCBuffer> buffer_ {new SPSCBuffer(BUFFER_SIZE)};
+
+    // Most recent samples received while recording is off
+    boost::circular_buffer<RecordedFrame> pretrigger_;
+
+    // Subsampled copies of the current and previous frames that a motion
+    // gate compares
+    static constexpr int GATE_STRIDE {8};
+    cv::Mat gate_frame_, gate_previous_;
 
-    // Video writer and required parameters
+    // Frames popped from buffer_ in one go and encoded together
+    std::vector<RecordedFrame> batch_;
+
+    // Write queue statistics, reported when the writer closes. The deepest
+    // batch is the most that the encoder fell behind by.
+    uint64_t frames_encoded_ {0};
+    size_t queue_peak_ {0};
+    bool queue_warned_ {false};
+
+    // Video encoder and required parameters
     std::string path_ {""};
+    std::string encoder_name_ {"opencv"};
+    bool encoder_chosen_ {false};
+    int encode_threads_ {0}; // Every core
     int fourcc_ {0}; // Default to uncompressed
     double fps_;
     oat::FrameParams frame_params_;
-    cv::VideoWriter video_writer_;
+    std::unique_ptr<VideoEncoder> encoder_;
+
+    // Region of the SOURCE's frames that is recorded, and the factor it is
+    // scaled by. Frames are cropped and scaled as they are copied out of the
+    // node, so the write queue and encoder only see the recorded pixels.
+    bool use_crop_ {false};
+    cv::Rect crop_;
+    double scale_ {1.0};
+
+    // Copy the part of the current frame that is recorded
+    cv::Mat copyFrame(void) const;
+
+    // File rotation. When enabled, the recording is split into numbered
+    // chunks listed, with their first and last sample numbers, in an index
+    // file. The encoder for the next chunk is opened ahead of time on a
+    // background thread and finished chunks are closed on one, so rotation
+    // never holds up the frames being written.
+    uint64_t rotate_bytes_ {0};
+    double rotate_sec_ {0};
+    std::string base_path_;
+    std::string extension_;
+    size_t chunk_ {0};
+    size_t chunk_frames_ {0};
+    uint64_t chunk_bytes_ {0};
+    uint64_t chunk_first_ {0}, chunk_last_ {0};
+    int64_t chunk_start_usec_ {0};
+    FILE *chunk_index_ {nullptr};
+    std::future<std::unique_ptr<VideoEncoder>> next_encoder_;
+    std::vector<std::future<void>> closing_;
+
+    bool rotating(void) const { return rotate_bytes_ > 0 || rotate_sec_ > 0; }
+    std::string chunkPath(const size_t chunk) const;
+    std::unique_ptr<VideoEncoder> openChunk(const size_t chunk) const;
+    bool chunkFull(const RecordedFrame &next) const;
+    void encode(const size_t begin, const size_t end);
+    void rotate(void);
+    void indexChunk(void);
 
     // The held frame source
     oat::Source<oat::Frame> source_;
@@ -0,0 +1,348 @@
+//******************************************************************************
+//* File:   LibavEncoder.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "OatConfig.h" // Generated by CMake
+
+#ifdef USE_FFMPEG
+
+#include "LibavEncoder.h"
+#include "Muxer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+}
+
+namespace oat {
+
+// Slices per FFV1 frame. Each is coded independently, which is what lets
+// several threads share a frame.
+static constexpr int FFV1_SLICES {24};
+
+static std::string avError(const int err)
+{
+    char msg[AV_ERROR_MAX_STRING_SIZE] {0};
+    av_strerror(err, msg, sizeof(msg));
+    return msg;
+}
+
+static bool supports(const AVCodec *codec, const AVPixelFormat fmt)
+{
+    if (codec->pix_fmts == nullptr)
+        return false;
+
+    for (auto f = codec->pix_fmts; *f != AV_PIX_FMT_NONE; f++)
+        if (*f == fmt)
+            return true;
+
+    return false;
+}
+
+LibavEncoder::LibavEncoder(const Codec codec, const int threads)
+: codec_(codec)
+, threads_(threads)
+{
+    // Nothing
+}
+
+LibavEncoder::~LibavEncoder()
+{
+    try {
+        close();
+    } catch (const std::exception &ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+    }
+
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    avcodec_free_context(&context_);
+    if (format_ != nullptr) {
+        if (format_->pb != nullptr)
+            avio_closep(&format_->pb);
+        avformat_free_context(format_);
+    }
+}
+
+void LibavEncoder::open(const std::string &path,
+                        const int /* fourcc */,
+                        const double fps,
+                        const oat::FrameParams &params)
+{
+    path_ = path;
+
+    int err = avformat_alloc_output_context2(
+            &format_, nullptr, "matroska", path_.c_str());
+    if (err < 0)
+        throw std::runtime_error("Could not create " + path_ + ": "
+                                 + avError(err));
+
+    openCodec(fps, params, format_->oformat->flags & AVFMT_GLOBALHEADER);
+
+    stream_ = avformat_new_stream(format_, nullptr);
+    stream_->time_base = context_->time_base;
+    avcodec_parameters_from_context(stream_->codecpar, context_);
+
+    err = avio_open(&format_->pb, path_.c_str(), AVIO_FLAG_WRITE);
+    if (err < 0)
+        throw std::runtime_error("Could not open " + path_ + ": "
+                                 + avError(err));
+
+    err = avformat_write_header(format_, nullptr);
+    if (err < 0)
+        throw std::runtime_error("Could not write the header of " + path_
+                                 + ": " + avError(err));
+
+    index_.open(path_);
+}
+
+void LibavEncoder::open(oat::Muxer &muxer,
+                        const std::string &name,
+                        const double fps,
+                        const oat::FrameParams &params)
+{
+    path_ = muxer.path();
+
+    openCodec(fps, params, muxer.globalHeader());
+    track_ = muxer.addVideo(name, context_);
+    muxer_ = &muxer;
+
+    index_.open(path_ + "." + std::to_string(track_));
+}
+
+void LibavEncoder::openCodec(const double fps,
+                             const oat::FrameParams &params,
+                             const bool global_header)
+{
+    const int depth = CV_MAT_DEPTH(params.type);
+    const int channels = CV_MAT_CN(params.type);
+    if (!(depth == CV_8U && (channels == 1 || channels == 3))
+        && !(depth == CV_16U && channels == 1))
+        throw std::runtime_error("Lossless encoding requires 8-bit one or "
+                                 "three channel, or 16-bit single channel, "
+                                 "frames.");
+
+    // Pick the encoder and the pixel layout it is given. Every layout holds
+    // the frame's pixels exactly.
+    const AVCodec *codec = nullptr;
+    AVPixelFormat fmt = AV_PIX_FMT_NONE;
+    if (codec_ == Codec::FFV1) {
+
+        codec = avcodec_find_encoder(AV_CODEC_ID_FFV1);
+        if (channels == 3)
+            fmt = AV_PIX_FMT_0RGB32; // B, G, R, 0 in memory
+        else
+            fmt = depth == CV_8U ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_GRAY16LE;
+
+    } else {
+
+        if (depth != CV_8U)
+            throw std::runtime_error("Lossless H.264 requires 8-bit frames. "
+                                     "Use the ffv1 encoder for 16-bit frames.");
+
+        if (channels == 3) {
+            codec = avcodec_find_encoder_by_name("libx264rgb");
+            fmt = AV_PIX_FMT_BGR24;
+        } else {
+            codec = avcodec_find_encoder_by_name("libx264");
+            if (codec != nullptr && supports(codec, AV_PIX_FMT_GRAY8)) {
+                fmt = AV_PIX_FMT_GRAY8;
+            } else {
+                fmt = AV_PIX_FMT_YUV444P;
+                neutral_chroma_ = true;
+            }
+        }
+    }
+
+    if (codec == nullptr)
+        throw std::runtime_error("FFmpeg was built without the requested "
+                                 "lossless encoder.");
+
+    context_ = avcodec_alloc_context3(codec);
+    context_->width = params.cols;
+    context_->height = params.rows;
+    context_->pix_fmt = fmt;
+    context_->time_base = AVRational {1, 1000000};
+    context_->framerate = av_d2q(fps, 100000);
+
+    // Spread each frame over the encoder's threads
+    context_->thread_count = threads_;
+    context_->thread_type = FF_THREAD_SLICE | FF_THREAD_FRAME;
+
+    if (codec_ == Codec::FFV1) {
+        context_->level = 3;
+        context_->gop_size = 1;
+        context_->slices = FFV1_SLICES;
+        av_opt_set_int(context_->priv_data, "slicecrc", 1, 0);
+    } else {
+        // Lossless. The fastest preset because lossless streams are large and
+        // the encoder must keep up with capture.
+        av_opt_set(context_->priv_data, "preset", "ultrafast", 0);
+        av_opt_set_int(context_->priv_data, "qp", 0, 0);
+    }
+
+    if (global_header)
+        context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    const int err = avcodec_open2(context_, codec, nullptr);
+    if (err < 0)
+        throw std::runtime_error("Could not open the lossless encoder: "
+                                 + avError(err));
+
+    frame_ = av_frame_alloc();
+    frame_->format = fmt;
+    frame_->width = params.cols;
+    frame_->height = params.rows;
+    if (av_frame_get_buffer(frame_, 0) < 0)
+        throw std::runtime_error("Could not allocate an encoder frame.");
+
+    packet_ = av_packet_alloc();
+}
+
+void LibavEncoder::fill(const cv::Mat &mat)
+{
+    // Encoder threads may still hold the previous frame
+    if (av_frame_make_writable(frame_) < 0)
+        throw std::runtime_error("Could not allocate an encoder frame.");
+
+    const int rows = mat.rows;
+    const size_t row_bytes = mat.cols * mat.elemSize();
+
+    if (context_->pix_fmt == AV_PIX_FMT_0RGB32) {
+
+        for (int r = 0; r < rows; r++) {
+            const uint8_t *src = mat.ptr<uint8_t>(r);
+            uint8_t *dst = frame_->data[0] + r * frame_->linesize[0];
+            for (int c = 0; c < mat.cols; c++) {
+                dst[4 * c + 0] = src[3 * c + 0];
+                dst[4 * c + 1] = src[3 * c + 1];
+                dst[4 * c + 2] = src[3 * c + 2];
+                dst[4 * c + 3] = 0;
+            }
+        }
+
+    } else {
+
+        av_image_copy_plane(frame_->data[0], frame_->linesize[0],
+                            mat.data, static_cast<int>(mat.step),
+                            static_cast<int>(row_bytes), rows);
+
+        if (neutral_chroma_) {
+            for (int p = 1; p < 3; p++)
+                for (int r = 0; r < rows; r++)
+                    std::memset(frame_->data[p] + r * frame_->linesize[p],
+                                128, mat.cols);
+        }
+    }
+}
+
+void LibavEncoder::encode(const std::vector<RecordedFrame> &batch)
+{
+    for (const auto &f : batch) {
+
+        fill(f.mat);
+
+        // Frames are placed at their sample times, which must increase
+        frame_->pts = std::max<int64_t>(f.sample.microseconds().count(),
+                                        last_pts_ + 1);
+        last_pts_ = frame_->pts;
+
+        send(frame_);
+        index_.append(f.sample.count(), f.sample.microseconds().count());
+    }
+
+    index_.flush();
+}
+
+void LibavEncoder::send(const AVFrame *frame)
+{
+    int err = avcodec_send_frame(context_, frame);
+    if (err < 0)
+        throw std::runtime_error("Could not encode a frame for " + path_ + ": "
+                                 + avError(err));
+
+    // Write whatever the encoder has finished
+    while ((err = avcodec_receive_packet(context_, packet_)) == 0) {
+
+        if (muxer_ != nullptr) {
+            muxer_->write(track_, packet_);
+            continue;
+        }
+
+        av_packet_rescale_ts(packet_, context_->time_base, stream_->time_base);
+        packet_->stream_index = stream_->index;
+
+        err = av_interleaved_write_frame(format_, packet_);
+        if (err < 0)
+            throw std::runtime_error("Could not write to " + path_ + ": "
+                                     + avError(err));
+    }
+
+    if (err != AVERROR(EAGAIN) && err != AVERROR_EOF)
+        throw std::runtime_error("Could not encode a frame for " + path_ + ": "
+                                 + avError(err));
+}
+
+void LibavEncoder::close()
+{
+    // The shared file is finished by its owner, once every track is flushed
+    if (muxer_ != nullptr) {
+        send(nullptr);
+        index_.close();
+        muxer_ = nullptr;
+        return;
+    }
+
+    if (packet_ == nullptr || format_ == nullptr || format_->pb == nullptr)
+        return;
+
+    // Flush frames still held by the encoder's threads
+    send(nullptr);
+    av_write_trailer(format_);
+    avio_closep(&format_->pb);
+    index_.close();
+}
+
+void LibavEncoder::remove()
+{
+    // Nothing useful can be left behind, so the encoder is not flushed
+    if (format_ != nullptr && format_->pb != nullptr)
+        avio_closep(&format_->pb);
+    index_.remove();
+
+    // The shared file is removed by its owner
+    if (muxer_ != nullptr) {
+        muxer_ = nullptr;
+        return;
+    }
+
+    if (!path_.empty())
+        std::remove(path_.c_str());
+}
+
+} /* namespace oat */
+
+#endif /* USE_FFMPEG */
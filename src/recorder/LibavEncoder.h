@@ -0,0 +1,130 @@
+//******************************************************************************
+//* File:   LibavEncoder.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_LIBAVENCODER_H
+#define OAT_LIBAVENCODER_H
+
+#include "VideoEncoder.h"
+
+#include "../../lib/utility/FrameIndex.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// FFmpeg types, defined in its C headers
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+
+namespace oat {
+
+class Muxer;
+
+/**
+ * @brief Lossless compressed recording through FFmpeg's libraries, to a
+ * Matroska file. Frames are time stamped with their sample times, so gaps
+ * left by dropped or gated samples are kept in the file's timeline, and
+ * indexed by sample in a '.idx' file next to it.
+ *
+ * Encoding is spread over the encoder's slice and frame threads, which
+ * parallelize encoding of each frame rather than relying on several writers
+ * to keep cores busy.
+ *
+ * An encoder can instead write a track of a Muxer that it shares with the
+ * recorder's other writers.
+ */
+class LibavEncoder : public VideoEncoder {
+
+public:
+
+    enum class Codec {
+        FFV1,         //!< FFV1 version 3, intra-only
+        H264_LOSSLESS //!< x264 at qp 0
+    };
+
+    /**
+     * @param codec Lossless codec.
+     * @param threads Number of encoder threads. 0 uses every core.
+     */
+    LibavEncoder(const Codec codec, const int threads);
+    ~LibavEncoder();
+
+    LibavEncoder(const LibavEncoder &) = delete;
+    LibavEncoder &operator=(const LibavEncoder &) = delete;
+
+    std::string extension(void) const override { return ".mkv"; }
+
+    void open(const std::string &path,
+              const int fourcc,
+              const double fps,
+              const oat::FrameParams &params) override;
+
+    /**
+     * @brief Encode to a new video track of a shared file instead of to a
+     * file of this encoder's own. Replaces open(path, ...). Frames are
+     * indexed by sample in '<file>.<track>.idx'.
+     * @param muxer Shared file, which must not have been started yet.
+     * @param name Track title.
+     * @param fps Frame rate written to the track.
+     * @param params Frame parameters.
+     */
+    void open(oat::Muxer &muxer,
+              const std::string &name,
+              const double fps,
+              const oat::FrameParams &params);
+
+    void encode(const std::vector<RecordedFrame> &batch) override;
+
+    void remove(void) override;
+
+private:
+
+    const Codec codec_;
+    const int threads_;
+    std::string path_;
+
+    AVFormatContext *format_ {nullptr};
+    oat::Muxer *muxer_ {nullptr};
+    int track_ {-1};
+    AVCodecContext *context_ {nullptr};
+    AVStream *stream_ {nullptr};
+    AVFrame *frame_ {nullptr};
+    AVPacket *packet_ {nullptr};
+    oat::FrameIndexWriter index_;
+
+    // Luma only frames written as YUV, with neutral chroma
+    bool neutral_chroma_ {false};
+
+    // Presentation time of the last frame, in microseconds
+    int64_t last_pts_ {-1};
+
+    void openCodec(const double fps,
+                   const oat::FrameParams &params,
+                   const bool global_header);
+    void fill(const cv::Mat &mat);
+    void send(const AVFrame *frame);
+    void close(void);
+};
+
+}      /* namespace oat */
+#endif /* OAT_LIBAVENCODER_H */
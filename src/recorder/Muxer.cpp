@@ -0,0 +1,204 @@
+//******************************************************************************
+//* File:   Muxer.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "OatConfig.h" // Generated by CMake
+
+#ifdef USE_FFMPEG
+
+#include "Muxer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace oat {
+
+constexpr int64_t Muxer::INTERLEAVE_USEC;
+
+// Timestamps handed to the muxer, as they are in sample times
+static const AVRational USEC {1, 1000000};
+
+static std::string avError(const int err)
+{
+    char msg[AV_ERROR_MAX_STRING_SIZE] {0};
+    av_strerror(err, msg, sizeof(msg));
+    return msg;
+}
+
+Muxer::Muxer(const std::string &path)
+: path_(path)
+{
+    const int err = avformat_alloc_output_context2(
+            &format_, nullptr, "matroska", path_.c_str());
+    if (err < 0)
+        throw std::runtime_error("Could not create " + path_ + ": "
+                                 + avError(err));
+
+    format_->max_interleave_delta = av_rescale_q(INTERLEAVE_USEC, USEC,
+                                                 AVRational {1, AV_TIME_BASE});
+    text_packet_ = av_packet_alloc();
+}
+
+Muxer::~Muxer()
+{
+    try {
+        close();
+    } catch (const std::exception &ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+    }
+
+    av_packet_free(&text_packet_);
+    if (format_->pb != nullptr)
+        avio_closep(&format_->pb);
+    avformat_free_context(format_);
+}
+
+bool Muxer::globalHeader() const
+{
+    return (format_->oformat->flags & AVFMT_GLOBALHEADER) != 0;
+}
+
+AVStream *Muxer::addStream(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (started_)
+        throw std::logic_error("Tracks must be added to " + path_
+                               + " before it is started.");
+
+    AVStream *stream = avformat_new_stream(format_, nullptr);
+    if (stream == nullptr)
+        throw std::runtime_error("Could not add a track to " + path_ + ".");
+
+    stream->time_base = USEC;
+    av_dict_set(&stream->metadata, "title", name.c_str(), 0);
+    return stream;
+}
+
+int Muxer::addVideo(const std::string &name, const AVCodecContext *context)
+{
+    AVStream *stream = addStream(name);
+    avcodec_parameters_from_context(stream->codecpar, context);
+    return stream->index;
+}
+
+int Muxer::addText(const std::string &name)
+{
+    AVStream *stream = addStream(name);
+    stream->codecpar->codec_type = AVMEDIA_TYPE_SUBTITLE;
+    stream->codecpar->codec_id = AV_CODEC_ID_TEXT;
+    return stream->index;
+}
+
+void Muxer::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int err = avio_open(&format_->pb, path_.c_str(), AVIO_FLAG_WRITE);
+    if (err < 0)
+        throw std::runtime_error("Could not open " + path_ + ": "
+                                 + avError(err));
+
+    // Chooses the time base of each track, which packets are rescaled to
+    err = avformat_write_header(format_, nullptr);
+    if (err < 0)
+        throw std::runtime_error("Could not write the header of " + path_
+                                 + ": " + avError(err));
+
+    started_ = true;
+}
+
+void Muxer::write(const int track, AVPacket *packet)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    packet->stream_index = track;
+    av_packet_rescale_ts(packet, USEC, format_->streams[track]->time_base);
+    interleave(packet);
+}
+
+void Muxer::write(const int track,
+                  const int64_t usec,
+                  const char *text,
+                  const size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (av_new_packet(text_packet_, static_cast<int>(size)) < 0)
+        throw std::runtime_error("Could not allocate a packet for " + path_
+                                 + ".");
+
+    std::memcpy(text_packet_->data, text, size);
+    text_packet_->pts = usec;
+    text_packet_->dts = usec;
+    text_packet_->duration = 1;
+    text_packet_->stream_index = track;
+    av_packet_rescale_ts(text_packet_, USEC,
+                         format_->streams[track]->time_base);
+    interleave(text_packet_);
+}
+
+void Muxer::interleave(AVPacket *packet)
+{
+    if (!started_)
+        throw std::logic_error(path_ + " must be started before it is "
+                               "written.");
+
+    // Takes the packet's data, whether or not it succeeds
+    const int err = av_interleaved_write_frame(format_, packet);
+    if (err < 0)
+        throw std::runtime_error("Could not write to " + path_ + ": "
+                                 + avError(err));
+}
+
+void Muxer::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!started_ || format_->pb == nullptr)
+        return;
+
+    // Writes the packets still held back for interleaving
+    const int err = av_write_trailer(format_);
+    avio_closep(&format_->pb);
+    if (err < 0)
+        throw std::runtime_error("Could not finish " + path_ + ": "
+                                 + avError(err));
+}
+
+void Muxer::remove()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (format_->pb != nullptr)
+        avio_closep(&format_->pb);
+    started_ = false;
+
+    std::remove(path_.c_str());
+}
+
+} /* namespace oat */
+
+#endif /* USE_FFMPEG */
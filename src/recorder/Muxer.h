@@ -0,0 +1,133 @@
+//******************************************************************************
+//* File:   Muxer.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_MUXER_H
+#define OAT_MUXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// FFmpeg types, defined in its C headers
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVPacket;
+struct AVStream;
+
+namespace oat {
+
+/**
+ * @brief Matroska file holding every SOURCE of a recorder as a track of its
+ * own, with the samples of all tracks interleaved by sample time. Frame
+ * SOURCEs are losslessly encoded video tracks and position SOURCEs are text
+ * tracks with one JSON position per block. Tracks are titled after their
+ * SOURCE.
+ *
+ * Writers on different threads share the file. Each encodes on its own
+ * thread and hands finished packets over under the file's lock, and
+ * libavformat holds them back for up to INTERLEAVE_USEC so that they are
+ * written in time order across tracks. A track that falls further behind is
+ * written out of order with the others, but always in order within itself.
+ */
+class Muxer {
+
+public:
+
+    // Longest that a packet is held back for the other tracks to catch up
+    static constexpr int64_t INTERLEAVE_USEC {1000000};
+
+    /**
+     * @param path File to create. Truncated if it exists.
+     */
+    explicit Muxer(const std::string &path);
+    ~Muxer();
+
+    Muxer(const Muxer &) = delete;
+    Muxer &operator=(const Muxer &) = delete;
+
+    const std::string &path(void) const { return path_; }
+
+    /**
+     * @brief Whether the codecs of video tracks must put their headers in
+     * the track rather than in the stream.
+     */
+    bool globalHeader(void) const;
+
+    /**
+     * @brief Add a video track. Must be called before start().
+     * @param name Track title, e.g. the SOURCE address.
+     * @param context Opened encoder that the track's packets come from.
+     * @return Track index.
+     */
+    int addVideo(const std::string &name, const AVCodecContext *context);
+
+    /**
+     * @brief Add a track of UTF-8 text. Must be called before start().
+     * @param name Track title, e.g. the SOURCE address.
+     * @return Track index.
+     */
+    int addText(const std::string &name);
+
+    /**
+     * @brief Open the file and write its header, once every track is added.
+     */
+    void start(void);
+
+    /**
+     * @brief Write an encoded packet of a video track. Its timestamps are in
+     * microseconds.
+     */
+    void write(const int track, AVPacket *packet);
+
+    /**
+     * @brief Write a block of text to a text track.
+     * @param usec Sample time of the block. Must increase within the track.
+     */
+    void write(const int track,
+               const int64_t usec,
+               const char *text,
+               const size_t size);
+
+    /**
+     * @brief Write the packets still held back and the file's index. Must be
+     * called once every writer has finished.
+     */
+    void close(void);
+
+    /**
+     * @brief Delete the file.
+     */
+    void remove(void);
+
+private:
+
+    const std::string path_;
+    AVFormatContext *format_ {nullptr};
+    AVPacket *text_packet_ {nullptr};
+    bool started_ {false};
+    std::mutex mutex_;
+
+    AVStream *addStream(const std::string &name);
+    void interleave(AVPacket *packet);
+};
+
+}      /* namespace oat */
+#endif /* OAT_MUXER_H */
@@ -0,0 +1,270 @@
+//******************************************************************************
+//* File:   PositionStore.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#include "OatConfig.h" // Generated by CMake
+
+#ifdef USE_HDF5
+
+#include "PositionStore.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <hdf5.h>
+
+#include "../../lib/utility/FileFormat.h"
+
+namespace oat {
+
+constexpr size_t PositionTable::CHUNK_ROWS;
+
+static void writeAttribute(const hid_t obj, const char *name, const double val)
+{
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(obj, name, H5T_IEEE_F64LE, space,
+                            H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, H5T_NATIVE_DOUBLE, &val);
+    H5Aclose(attr);
+    H5Sclose(space);
+}
+
+static void writeAttribute(const hid_t obj,
+                           const char *name,
+                           const std::string &val)
+{
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, val.size() + 1);
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(obj, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, type, val.c_str());
+    H5Aclose(attr);
+    H5Sclose(space);
+    H5Tclose(type);
+}
+
+PositionStore::PositionStore(const std::string &path, const int compression)
+: path_(path)
+, compression_(compression)
+{
+    file_ = H5Fcreate(path_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_ < 0)
+        throw std::runtime_error("Could not create " + path_);
+
+    writeAttribute(file_, "oat_version",
+                   std::string(Oat_VERSION_MAJOR) + "." + Oat_VERSION_MINOR);
+    writeAttribute(file_, "date", oat::createTimeStamp(true));
+}
+
+PositionStore::~PositionStore()
+{
+    if (file_ >= 0)
+        H5Fclose(file_);
+}
+
+std::unique_ptr<PositionTable> PositionStore::addTable(
+    const std::string &name, const double sample_rate_hz)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    hid_t group = H5Gcreate2(file_, name.c_str(),
+                             H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (group < 0)
+        throw std::runtime_error("Could not add positions of " + name + " to "
+                                 + path_);
+
+    writeAttribute(group, "sample_rate_hz", sample_rate_hz);
+
+    // Constructor is private
+    return std::unique_ptr<PositionTable>(new PositionTable(*this, group));
+}
+
+void PositionStore::flush()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    H5Fflush(file_, H5F_SCOPE_GLOBAL);
+}
+
+PositionTable::PositionTable(PositionStore &store, const int64_t group)
+: store_(store)
+, group_(group)
+{
+    for (auto &d : datasets_)
+        d = -1;
+
+    // Fixed length, NUL padded labels, as the 'a10' NumPy type
+    region_type_ = H5Tcopy(H5T_C_S1);
+    H5Tset_size(region_type_, oat::Position2D::REGION_LEN);
+    H5Tset_strpad(region_type_, H5T_STR_NULLPAD);
+
+    createDataset(TICK, "tick", H5T_STD_U64LE, 1);
+    createDataset(USEC, "usec", H5T_STD_U64LE, 1);
+    createDataset(UNIT, "unit", H5T_STD_I32LE, 1);
+    createDataset(POS_OK, "pos_ok", H5T_STD_I8LE, 1);
+    createDataset(POS_XY, "pos_xy", H5T_IEEE_F64LE, 2);
+    createDataset(VEL_OK, "vel_ok", H5T_STD_I8LE, 1);
+    createDataset(VEL_XY, "vel_xy", H5T_IEEE_F64LE, 2);
+    createDataset(HEAD_OK, "head_ok", H5T_STD_I8LE, 1);
+    createDataset(HEAD_XY, "head_xy", H5T_IEEE_F64LE, 2);
+    createDataset(REG_OK, "reg_ok", H5T_STD_I8LE, 1);
+    createDataset(REG, "reg", region_type_, 1);
+}
+
+PositionTable::~PositionTable()
+{
+    try {
+        flush();
+    } catch (const std::exception &ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+    }
+
+    std::lock_guard<std::mutex> lk(store_.mutex_);
+    for (auto d : datasets_)
+        if (d >= 0)
+            H5Dclose(d);
+    H5Tclose(region_type_);
+    H5Gclose(group_);
+}
+
+void PositionTable::createDataset(const Field field,
+                                  const char *name,
+                                  const int64_t type,
+                                  const size_t width)
+{
+    // Rank 1 for scalars, rank 2 for vectors
+    const int rank = width > 1 ? 2 : 1;
+    hsize_t dims[2] {0, width};
+    hsize_t max_dims[2] {H5S_UNLIMITED, width};
+    hsize_t chunk[2] {CHUNK_ROWS, width};
+
+    hid_t space = H5Screate_simple(rank, dims, max_dims);
+    hid_t props = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(props, rank, chunk);
+    if (store_.compression_ > 0) {
+        H5Pset_shuffle(props);
+        H5Pset_deflate(props, store_.compression_);
+    }
+
+    datasets_[field] = H5Dcreate2(group_, name, type, space,
+                                  H5P_DEFAULT, props, H5P_DEFAULT);
+    H5Pclose(props);
+    H5Sclose(space);
+
+    if (datasets_[field] < 0)
+        throw std::runtime_error("Could not create position dataset "
+                                 + std::string(name) + " in "
+                                 + store_.path_);
+}
+
+void PositionTable::append(const oat::Position2D &p)
+{
+    tick_.push_back(p.sample_count());
+    usec_.push_back(p.sample_usec());
+    unit_.push_back(static_cast<int32_t>(p.unit_of_length()));
+
+    pos_ok_.push_back(p.position_valid ? 1 : 0);
+    pos_xy_.push_back(p.position.x);
+    pos_xy_.push_back(p.position.y);
+
+    vel_ok_.push_back(p.velocity_valid ? 1 : 0);
+    vel_xy_.push_back(p.velocity.x);
+    vel_xy_.push_back(p.velocity.y);
+
+    head_ok_.push_back(p.heading_valid ? 1 : 0);
+    head_xy_.push_back(p.heading.x);
+    head_xy_.push_back(p.heading.y);
+
+    reg_ok_.push_back(p.region_valid ? 1 : 0);
+    reg_.insert(reg_.end(), p.region, p.region + oat::Position2D::REGION_LEN);
+
+    if (tick_.size() >= CHUNK_ROWS)
+        flush();
+}
+
+void PositionTable::flush()
+{
+    if (tick_.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lk(store_.mutex_);
+
+        extend(TICK, H5T_NATIVE_UINT64, 1, tick_.data());
+        extend(USEC, H5T_NATIVE_UINT64, 1, usec_.data());
+        extend(UNIT, H5T_NATIVE_INT32, 1, unit_.data());
+        extend(POS_OK, H5T_NATIVE_INT8, 1, pos_ok_.data());
+        extend(POS_XY, H5T_NATIVE_DOUBLE, 2, pos_xy_.data());
+        extend(VEL_OK, H5T_NATIVE_INT8, 1, vel_ok_.data());
+        extend(VEL_XY, H5T_NATIVE_DOUBLE, 2, vel_xy_.data());
+        extend(HEAD_OK, H5T_NATIVE_INT8, 1, head_ok_.data());
+        extend(HEAD_XY, H5T_NATIVE_DOUBLE, 2, head_xy_.data());
+        extend(REG_OK, H5T_NATIVE_INT8, 1, reg_ok_.data());
+        extend(REG, region_type_, 1, reg_.data());
+    }
+
+    rows_written_ += tick_.size();
+
+    tick_.clear();
+    usec_.clear();
+    unit_.clear();
+    pos_ok_.clear();
+    pos_xy_.clear();
+    vel_ok_.clear();
+    vel_xy_.clear();
+    head_ok_.clear();
+    head_xy_.clear();
+    reg_ok_.clear();
+    reg_.clear();
+}
+
+void PositionTable::extend(const Field field,
+                           const int64_t mem_type,
+                           const size_t width,
+                           const void *data)
+{
+    // Called with the store's lock held
+    const int rank = width > 1 ? 2 : 1;
+    const hsize_t rows = tick_.size();
+    hsize_t dims[2] {rows_written_ + rows, width};
+    hsize_t start[2] {rows_written_, 0};
+    hsize_t count[2] {rows, width};
+
+    const hid_t d = datasets_[field];
+    if (H5Dset_extent(d, dims) < 0)
+        throw std::runtime_error("Could not extend position datasets in "
+                                 + store_.path_);
+
+    hid_t file_space = H5Dget_space(d);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+                        start, nullptr, count, nullptr);
+    hid_t mem_space = H5Screate_simple(rank, count, nullptr);
+
+    const herr_t err = H5Dwrite(d, mem_type, mem_space, file_space,
+                                H5P_DEFAULT, data);
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+
+    if (err < 0)
+        throw std::runtime_error("Could not write positions to "
+                                 + store_.path_);
+}
+
+} /* namespace oat */
+
+#endif /* USE_HDF5 */
@@ -0,0 +1,148 @@
+//******************************************************************************
+//* File:   PositionStore.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+
+#ifndef OAT_POSITIONSTORE_H
+#define OAT_POSITIONSTORE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../../lib/datatypes/Position2D.h"
+
+namespace oat {
+
+class PositionTable;
+
+/**
+ * @brief Columnar HDF5 file holding the positions of any number of SOURCEs.
+ * Each SOURCE is a group named after it, with one chunked, extendible
+ * dataset per field of Position2D::NPY_DTYPE, so that an analysis reads only
+ * the fields it needs. Chunks are shuffled and deflated when compression is
+ * enabled.
+ *
+ * Writers on different threads share the file. All HDF5 calls are made under
+ * the file's lock, since the library is not built thread safe by default.
+ */
+class PositionStore {
+
+    friend class PositionTable;
+
+public:
+
+    /**
+     * @param path File to create. Truncated if it exists.
+     * @param compression Deflate level, from 0 (none) to 9.
+     */
+    PositionStore(const std::string &path, const int compression);
+    ~PositionStore();
+
+    PositionStore(const PositionStore &) = delete;
+    PositionStore &operator=(const PositionStore &) = delete;
+
+    const std::string &path(void) const { return path_; }
+
+    /**
+     * @brief Add a group for a SOURCE's positions.
+     * @param name Group name, e.g. the SOURCE address.
+     * @param sample_rate_hz Stored as an attribute of the group. Negative if
+     * unknown.
+     */
+    std::unique_ptr<PositionTable> addTable(const std::string &name,
+                                            const double sample_rate_hz);
+
+    /**
+     * @brief Push everything written so far to disk, so that a crash loses
+     * no more.
+     */
+    void flush(void);
+
+private:
+
+    const std::string path_;
+    const int compression_;
+    int64_t file_ {-1};
+    std::mutex mutex_;
+};
+
+/**
+ * @brief Positions of one SOURCE in a PositionStore. Positions are gathered
+ * column by column and written a chunk at a time.
+ */
+class PositionTable {
+
+    friend class PositionStore;
+
+public:
+
+    // Rows per HDF5 chunk and per write
+    static constexpr size_t CHUNK_ROWS {4096};
+
+    ~PositionTable();
+
+    PositionTable(const PositionTable &) = delete;
+    PositionTable &operator=(const PositionTable &) = delete;
+
+    /**
+     * @brief Add a position. Written once CHUNK_ROWS are gathered or on
+     * flush(). Takes no lock.
+     */
+    void append(const oat::Position2D &p);
+
+    /**
+     * @brief Write the positions gathered so far.
+     */
+    void flush(void);
+
+private:
+
+    PositionTable(PositionStore &store, const int64_t group);
+
+    // One dataset per field, in the order of Position2D::NPY_DTYPE
+    enum Field { TICK, USEC, UNIT, POS_OK, POS_XY, VEL_OK, VEL_XY,
+                 HEAD_OK, HEAD_XY, REG_OK, REG, NUM_FIELDS };
+
+    PositionStore &store_;
+    int64_t group_ {-1};
+    int64_t datasets_[NUM_FIELDS];
+    int64_t region_type_ {-1};
+    uint64_t rows_written_ {0};
+
+    // Gathered rows
+    std::vector<uint64_t> tick_, usec_;
+    std::vector<int32_t> unit_;
+    std::vector<int8_t> pos_ok_, vel_ok_, head_ok_, reg_ok_;
+    std::vector<double> pos_xy_, vel_xy_, head_xy_;
+    std::vector<char> reg_;
+
+    void createDataset(const Field field,
+                       const char *name,
+                       const int64_t type,
+                       const size_t width);
+    void extend(const Field field,
+                const int64_t mem_type,
+                const size_t width,
+                const void *data);
+};
+
+}      /* namespace oat */
+#endif /* OAT_POSITIONSTORE_H */
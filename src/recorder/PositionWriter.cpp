@@ -19,19 +19,38 @@
 
 #include "OatConfig.h" // Generated by CMake
 #include "Format.h"
+#include "Muxer.h"
 #include "PositionWriter.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include <unistd.h>
 
 #include "../../lib/utility/FileFormat.h"
 
 namespace oat {
 
+constexpr size_t PositionWriter::BATCH_BYTES;
+constexpr std::chrono::seconds PositionWriter::CHECKPOINT_PERIOD;
+
 PositionWriter::~PositionWriter()
 {
+#ifdef USE_HDF5
+    if (table_)
+        return;
+#endif
+#ifdef USE_FFMPEG
+    if (muxer_ != nullptr)
+        return;
+#endif
+
     if (use_binary_ && fd_ != nullptr) {
-        auto n = std::to_string(completed_writes_);
-        emplaceNumpyShape(fd_, completed_writes_); 
+        flushBinary();
+        emplaceNumpyShape(fd_, completed_writes_);
         fclose(fd_);
     } else if (fd_ != nullptr) {
         json_writer_.EndArray();
@@ -63,7 +82,7 @@ void PositionWriter::initialize(const std::string &path)
 
 void PositionWriter::initializeBinary(const std::string &path)
 {
-    auto path_ =  path + ".npy";
+    path_ =  path + ".npy";
 
     if (!allow_overwrite_)
        oat::ensureUniquePath(path_);
@@ -80,11 +99,70 @@ void PositionWriter::initializeBinary(const std::string &path)
     // Write header
     auto header = getNumpyHeader(oat::Position2D::NPY_DTYPE);
     fwrite(header.data(), 1, header.size(), fd_);
+
+    batch_.reserve(BATCH_BYTES);
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+
+void PositionWriter::flushBinary()
+{
+    if (batch_.empty())
+        return;
+
+    fwrite(batch_.data(), 1, batch_.size(), fd_);
+    batch_.clear();
+}
+
+void PositionWriter::checkpointBinary()
+{
+    flushBinary();
+    fflush(fd_);
+
+    // Records must reach the disk before a header that counts them
+    fdatasync(fileno(fd_));
+
+    emplaceNumpyShape(fd_, completed_writes_);
+    fseek(fd_, 0, SEEK_END);
+    fflush(fd_);
+
+    checkpointed_writes_ = completed_writes_;
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+
+#ifdef USE_HDF5
+void PositionWriter::initialize(oat::PositionStore &store)
+{
+    double fs = 1 / sample_period_sec();
+    store_ = &store;
+    table_ = store.addTable(addr_, std::isfinite(fs) ? fs : -1.0);
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+
+void PositionWriter::checkpointTable()
+{
+    table_->flush();
+    store_->flush();
+
+    checkpointed_writes_ = completed_writes_;
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+#endif
+
+#ifdef USE_FFMPEG
+void PositionWriter::initialize(oat::Muxer &muxer)
+{
+    if (use_binary_)
+        throw std::runtime_error("Positions written to a single file with "
+                                 "the other SOURCEs are always JSON.");
+
+    muxer_ = &muxer;
+    track_ = muxer.addText(addr_);
 }
+#endif
 
 void PositionWriter::initializeJSON(const std::string &path)
 {
-    auto path_ =  path + ".json";
+    path_ =  path + ".json";
 
     if (!allow_overwrite_)
        oat::ensureUniquePath(path_);
@@ -139,26 +217,105 @@ void PositionWriter::initializeJSON(const std::string &path)
 
 void PositionWriter::write() {
 
-    oat::Position2D p("");
+    QueuedPosition p;
+
+    while (buffer_->pop(p)) {
+
+#ifdef USE_FFMPEG
+        if (muxer_ != nullptr) {
+            text_.Clear();
+            text_writer_.Reset(text_);
+            oat::serializePosition(p, text_writer_, !concise_file_);
+
+            last_usec_ = std::max<int64_t>(
+                p.sample().microseconds().count(), last_usec_ + 1);
+            muxer_->write(track_, last_usec_, text_.GetString(),
+                          text_.GetSize());
+            completed_writes_++;
+            continue;
+        }
+#endif
 
-    while (buffer_.pop(p)) {
+#ifdef USE_HDF5
+        if (table_) {
+            table_->append(p);
+            completed_writes_++;
+            continue;
+        }
+#endif
 
         if (use_binary_) {
-            //std::cout << "Dummy write.\n";
-            auto pack = oat::packPosition(p);
-            fwrite(pack.data(), 1, pack.size(), fd_);
+            append(batch_, oat::packPosition(p));
+            if (batch_.size() >= BATCH_BYTES)
+                flushBinary();
         } else {
             oat::serializePosition(p, json_writer_, !concise_file_);
         }
 
         completed_writes_++;
     }
+
+#ifdef USE_HDF5
+    if (table_) {
+        if (completed_writes_ != checkpointed_writes_
+            && std::chrono::steady_clock::now() - last_checkpoint_
+               >= CHECKPOINT_PERIOD)
+            checkpointTable();
+        return;
+    }
+#endif
+
+    if (use_binary_
+        && completed_writes_ != checkpointed_writes_
+        && std::chrono::steady_clock::now() - last_checkpoint_
+           >= CHECKPOINT_PERIOD)
+        checkpointBinary();
 }
 
 void PositionWriter::push() {
 
-    if (!buffer_.push(source_.clone()))
+    for (const auto &p : pretrigger_)
+        if (!buffer_->push(p))
+            throw std::runtime_error(OVERRUN_MSG);
+    pretrigger_.clear();
+
+    if (!buffer_->push(source_.clone()))
         throw std::runtime_error(OVERRUN_MSG);
+
+    queued_.notify();
+}
+
+double PositionWriter::activity(int64_t &usec) {
+
+    const auto &r = *source_.retrieve();
+    usec = r.sample.microseconds().count();
+
+    if (!r.position_valid)
+        return -1;
+
+    // Speed as reported by the detector or filter, or else from the last
+    // valid position
+    double speed = -1;
+    if (r.velocity_valid) {
+        speed = std::hypot(r.velocity[0], r.velocity[1]);
+    } else if (gate_has_previous_ && usec > gate_previous_usec_) {
+        speed = std::hypot(r.position[0] - gate_previous_[0],
+                           r.position[1] - gate_previous_[1])
+                / ((usec - gate_previous_usec_) * 1e-6);
+    }
+
+    gate_has_previous_ = true;
+    gate_previous_[0] = r.position[0];
+    gate_previous_[1] = r.position[1];
+    gate_previous_usec_ = usec;
+
+    return speed;
+}
+
+void PositionWriter::hold() {
+
+    if (pretrigger_.capacity() > 0)
+        pretrigger_.push_back(source_.clone());
 }
 
 } /* namespace oat */
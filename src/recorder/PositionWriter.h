@@ -20,11 +20,20 @@
 #ifndef OAT_POSITIONWRITER_H
 #define OAT_POSITIONWRITER_H
 
+#include "OatConfig.h" // Generated by CMake
 #include "Writer.h"
+#include "PositionStore.h"
 
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
 #include <boost/lockfree/spsc_queue.hpp>
 #include <rapidjson/filewritestream.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 
 #include "../../lib/datatypes/Position2D.h"
 #include "../../lib/utility/FileFormat.h"
@@ -32,6 +41,8 @@
 namespace oat {
 namespace blf = boost::lockfree;
 
+class Muxer;
+
 class PositionWriter : public Writer{
 public:
     using Writer::Writer;
@@ -44,15 +55,43 @@ public:
     oat::SourceState connect() override { return source_.connect(); }
     double sample_period_sec() override
     {
-        return source_.retrieve()->sample_period_sec();
+        return source_.retrieve()->sample.period_sec().count();
+    }
+    uint64_t sample_count() override
+    {
+        return source_.retrieve()->sample.count();
     }
 
     oat::NodeState wait() override { return source_.wait(); }
     void post(void) override { source_.post(); }
 
     void initialize(const std::string &path) override;
+#ifdef USE_HDF5
+    /**
+     * @brief Write to a table of a shared HDF5 file instead of to a file of
+     * this writer's own. Replaces initialize(path).
+     */
+    void initialize(oat::PositionStore &store);
+#endif
+#ifdef USE_FFMPEG
+    /**
+     * @brief Write to a text track of a file shared with the recorder's
+     * other writers instead of to a file of this writer's own, one JSON
+     * position per block. Replaces initialize(path).
+     */
+    void initialize(oat::Muxer &muxer);
+#endif
     void write(void) override;
+    bool pending(void) const override { return buffer_->read_available() > 0; }
     void push(void) override;
+    void hold(void) override;
+    void setPretrigger(const double seconds) override
+    {
+        const auto n = pretriggerSamples(seconds);
+        pretrigger_.set_capacity(n);
+        buffer_.reset(new SPSCBuffer(BUFFER_SIZE + n));
+    }
+    double activity(int64_t &usec) override;
     void deleteFile() override
     {
         if (!path_.empty())
@@ -60,8 +99,12 @@ public:
     }
 
 private:
-    using SPSCBuffer = boost::lockfree::spsc_queue<oat::Position2D,
-                                                   blf::capacity<BUFFER_SIZE>>;
+    // A queue sized at run time default constructs its elements
+    struct QueuedPosition : oat::Position2D {
+        QueuedPosition() : oat::Position2D("") { }
+        QueuedPosition(const oat::Position2D &p) : oat::Position2D(p) { }
+    };
+    using SPSCBuffer = boost::lockfree::spsc_queue<QueuedPosition>;
     /**
      * @brief Determines if indeterminate position data fields should be
      * written in spite of being indeterminate for sample parsing ease? e.g.
@@ -70,7 +113,10 @@ private:
     bool concise_file_ {false};
 
     std::string path_ {""};
-    SPSCBuffer buffer_;
+    std::unique_ptr<SPSCBuffer> buffer_ {new SPSCBuffer(BUFFER_SIZE)};
+
+    // Most recent samples received while recording is off
+    boost::circular_buffer<oat::Position2D> pretrigger_;
 
     //// Timestamp clock
     //std::chrono::system_clock clock_;
@@ -88,10 +134,44 @@ private:
 
     // Binary-specific
     void initializeBinary(const std::string &path);
+    void flushBinary(void);
+    void checkpointBinary(void);
     bool use_binary_ {false};
+
+#ifdef USE_HDF5
+    // HDF5-specific. Tables are flushed along with the file every
+    // CHECKPOINT_PERIOD.
+    void checkpointTable(void);
+    oat::PositionStore *store_ {nullptr};
+    std::unique_ptr<oat::PositionTable> table_;
+#endif
+
+#ifdef USE_FFMPEG
+    // Track of a shared file. Blocks are placed at their sample times, which
+    // must increase.
+    oat::Muxer *muxer_ {nullptr};
+    int track_ {-1};
+    int64_t last_usec_ {-1};
+    rapidjson::StringBuffer text_;
+    rapidjson::Writer<rapidjson::StringBuffer> text_writer_ {text_};
+#endif
+
+    // Packed positions are gathered and written in large batches. The header
+    // shape is rewritten every CHECKPOINT_PERIOD to cover everything written
+    // so far, so a crash loses at most that much data
+    static constexpr size_t BATCH_BYTES {1 << 20};
+    static constexpr std::chrono::seconds CHECKPOINT_PERIOD {1};
+    std::vector<char> batch_;
+    int64_t checkpointed_writes_ {0};
+    std::chrono::steady_clock::time_point last_checkpoint_;
     static constexpr int header_prefix_size_ {10};
     static constexpr int shape_end_byte_ {10};
 
+    // Last valid position seen by a speed gate and its time
+    bool gate_has_previous_ {false};
+    double gate_previous_[2] {0, 0};
+    int64_t gate_previous_usec_ {0};
+
     oat::Source<Position2D> source_;
 };
 
@@ -0,0 +1,185 @@
+//******************************************************************************
+//* File:   RawFrameEncoder.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "RawFrameEncoder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace oat {
+
+constexpr size_t RawFrameEncoder::ALIGNMENT;
+constexpr size_t RawFrameEncoder::STAGING_BYTES;
+constexpr const char RawFrameEncoder::MAGIC[8];
+
+static size_t alignUp(const size_t n, const size_t a)
+{
+    return (n + a - 1) / a * a;
+}
+
+RawFrameEncoder::~RawFrameEncoder()
+{
+    if (index_ != nullptr)
+        fclose(index_);
+
+    if (fd_ >= 0)
+        close(fd_);
+
+    if (staging_ != nullptr) {
+        if (locked_)
+            munlock(staging_, staging_blocks_ * header_.block_bytes);
+        free(staging_);
+    }
+}
+
+void RawFrameEncoder::open(const std::string &path,
+                           const int /* fourcc */,
+                           const double fps,
+                           const oat::FrameParams &params)
+{
+    path_ = path;
+
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, MAGIC, sizeof(header_.magic));
+    header_.version = 1;
+    header_.sample_bytes = sizeof(oat::Sample);
+    header_.header_bytes = ALIGNMENT;
+    header_.rows = params.rows;
+    header_.cols = params.cols;
+    header_.type = params.type;
+    header_.color = params.color;
+    header_.fps = fps;
+
+    row_bytes_ = params.cols * CV_ELEM_SIZE(params.type);
+    header_.frame_bytes = params.rows * row_bytes_;
+    header_.block_bytes
+        = alignUp(sizeof(oat::Sample) + header_.frame_bytes, ALIGNMENT);
+
+    // Staging buffer holds a whole number of blocks
+    staging_blocks_ = std::max<size_t>(1, STAGING_BYTES / header_.block_bytes);
+    const size_t staging_bytes = staging_blocks_ * header_.block_bytes;
+    void *p = nullptr;
+    if (posix_memalign(&p, ALIGNMENT, staging_bytes) != 0)
+        throw std::runtime_error("Could not allocate raw frame staging buffer.");
+    staging_ = static_cast<char *>(p);
+    std::memset(staging_, 0, staging_bytes);
+
+    // Best effort: keep the staging buffer resident
+    locked_ = mlock(staging_, staging_bytes) == 0;
+
+    // Bypass the page cache if the file system allows it
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd_ < 0 && errno == EINVAL)
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+        throw std::runtime_error("Could not open " + path_ + ", "
+                                 + std::strerror(errno) + ".");
+
+    // Header block, written through the staging buffer to respect O_DIRECT
+    // alignment
+    std::memcpy(staging_, &header_, sizeof(header_));
+    writeAll(staging_, ALIGNMENT, 0);
+    std::memset(staging_, 0, ALIGNMENT);
+
+    auto index_path = path_ + ".idx";
+    index_ = fopen(index_path.c_str(), "wb");
+    if (index_ == nullptr)
+        throw std::runtime_error("Could not open " + index_path + ", "
+                                 + std::strerror(errno) + ".");
+}
+
+void RawFrameEncoder::encode(const std::vector<RecordedFrame> &batch)
+{
+    size_t n = 0;
+    for (const auto &f : batch) {
+
+        char *block = staging_ + n * header_.block_bytes;
+        std::memcpy(block, &f.sample, sizeof(oat::Sample));
+
+        char *pixels = block + sizeof(oat::Sample);
+        for (int r = 0; r < f.mat.rows; r++)
+            std::memcpy(pixels + r * row_bytes_, f.mat.ptr(r), row_bytes_);
+
+        RawFrameIndexEntry entry;
+        entry.count = f.sample.count();
+        entry.microseconds = f.sample.microseconds().count();
+        entry.offset = header_.header_bytes
+                       + (blocks_ + n) * header_.block_bytes;
+        fwrite(&entry, sizeof(entry), 1, index_);
+
+        if (++n == staging_blocks_) {
+            flush(n);
+            n = 0;
+        }
+    }
+
+    if (n > 0)
+        flush(n);
+
+    fflush(index_);
+}
+
+void RawFrameEncoder::remove()
+{
+    if (path_.empty())
+        return;
+
+    std::remove(path_.c_str());
+    std::remove((path_ + ".idx").c_str());
+}
+
+void RawFrameEncoder::flush(const size_t n)
+{
+    writeAll(staging_,
+             n * header_.block_bytes,
+             header_.header_bytes + blocks_ * header_.block_bytes);
+    blocks_ += n;
+}
+
+void RawFrameEncoder::writeAll(const char *data,
+                               const size_t bytes,
+                               const off_t offset)
+{
+    size_t done = 0;
+    while (done < bytes) {
+        auto n = pwrite(fd_, data + done, bytes - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        // Some file systems accept O_DIRECT at open but reject the writes
+        if (n < 0 && errno == EINVAL && (fcntl(fd_, F_GETFL) & O_DIRECT)) {
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+            continue;
+        }
+
+        if (n <= 0)
+            throw std::runtime_error("Could not write to " + path_ + ", "
+                                     + std::strerror(errno) + ".");
+        done += n;
+    }
+}
+
+} /* namespace oat */
@@ -0,0 +1,118 @@
+//******************************************************************************
+//* File:   RawFrameEncoder.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_RAWFRAMEENCODER_H
+#define OAT_RAWFRAMEENCODER_H
+
+#include "VideoEncoder.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace oat {
+
+/**
+ * @brief Header at the start of a raw frame file. Occupies the first
+ * RawFrameEncoder::ALIGNMENT bytes of the file.
+ */
+struct RawFrameHeader {
+    char magic[8];         //!< "OATRAW" followed by two NULs
+    uint32_t version;      //!< Format version, currently 1
+    uint32_t sample_bytes; //!< Bytes of oat::Sample at the start of each block
+    uint64_t header_bytes; //!< Offset of the first block
+    uint64_t block_bytes;  //!< Size of each frame block
+    uint64_t rows;
+    uint64_t cols;
+    int32_t type;          //!< OpenCV matrix type
+    int32_t color;         //!< oat::PixelColor
+    uint64_t frame_bytes;  //!< Packed pixel bytes following the sample
+    double fps;
+};
+
+/**
+ * @brief Entry of the index file that accompanies a raw frame file. One per
+ * recorded frame.
+ */
+struct RawFrameIndexEntry {
+    uint64_t count;        //!< Sample count
+    int64_t microseconds;  //!< Sample time
+    uint64_t offset;       //!< Offset of the frame's block in the raw file
+};
+
+/**
+ * @brief Lossless recording to a raw frame file. Each frame is stored in a
+ * fixed-size block, aligned to the device block size, holding its oat::Sample
+ * followed by its packed pixels, so frame i starts at header_bytes + i *
+ * block_bytes. A '.idx' file next to it lists the sample count, time and
+ * offset of each frame for seeking by time.
+ *
+ * Blocks are assembled in a page-locked staging buffer and written with
+ * O_DIRECT, bypassing the page cache, whenever the file system supports it.
+ */
+class RawFrameEncoder : public VideoEncoder {
+
+public:
+
+    static constexpr size_t ALIGNMENT {4096};
+    static constexpr size_t STAGING_BYTES {16 << 20};
+    static constexpr const char MAGIC[8] {"OATRAW"};
+
+    RawFrameEncoder() = default;
+    ~RawFrameEncoder();
+
+    RawFrameEncoder(const RawFrameEncoder &) = delete;
+    RawFrameEncoder &operator=(const RawFrameEncoder &) = delete;
+
+    std::string extension(void) const override { return ".oatraw"; }
+
+    void open(const std::string &path,
+              const int fourcc,
+              const double fps,
+              const oat::FrameParams &params) override;
+
+    void encode(const std::vector<RecordedFrame> &batch) override;
+
+    void remove(void) override;
+
+private:
+
+    std::string path_;
+    int fd_ {-1};
+    FILE *index_ {nullptr};
+
+    RawFrameHeader header_;
+    size_t row_bytes_ {0};
+
+    // Index of the next block to be written
+    uint64_t blocks_ {0};
+
+    // Page-locked, ALIGNMENT-aligned staging buffer and its capacity in
+    // blocks
+    char *staging_ {nullptr};
+    size_t staging_blocks_ {0};
+    bool locked_ {false};
+
+    void flush(const size_t n);
+    void writeAll(const char *data, const size_t bytes, const off_t offset);
+};
+
+}      /* namespace oat */
+#endif /* OAT_RAWFRAMEENCODER_H */
@@ -17,19 +17,33 @@
 //* along with this source code.  If not, see <http://www->gnu.org/licenses/>.
 //******************************************************************************
 
+#include "OatConfig.h" // Generated by CMake
+
 #include "Recorder.h"
 #include "Writer.h"
 #include "FrameWriter.h"
 #include "PositionWriter.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <iomanip>
+#include <iterator>
+#include <limits>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include "../../lib/base/Globals.h"
 #include "../../lib/utility/FileFormat.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/make_unique.h"
@@ -39,17 +53,42 @@ namespace oat {
 
 Recorder::~Recorder()
 {
+    stopReaders();
+
     // Set running to false to trigger thread join
     running_ = false;
-    writer_condition_variable_.notify_one();
-    if (writer_thread_.joinable())
-        writer_thread_.join();
+    for (auto &w : writers_)
+        w->notify();
+    for (auto &t : writer_threads_)
+        if (t.joinable())
+            t.join();
 
     // If files were never written to, get rid of them
     if (!files_have_data_) {
         for (auto &w : writers_)
             w->deleteFile();
     }
+
+#ifdef USE_HDF5
+    // The shared position file can only be closed after its writers' tables
+    if (position_store_) {
+        const auto path = position_store_->path();
+        writers_.clear();
+        position_store_.reset();
+        if (!files_have_data_)
+            std::remove(path.c_str());
+    }
+#endif
+
+#ifdef USE_FFMPEG
+    // Likewise the interleaved file, after its tracks' encoders are flushed
+    if (muxer_) {
+        writers_.clear();
+        if (!files_have_data_)
+            muxer_->remove();
+        muxer_.reset();
+    }
+#endif
 }
 
 po::options_description Recorder::options() const
@@ -84,17 +123,86 @@ po::options_description Recorder::options() const
          "must be implemented by the low  level writer. Common values are "
          "'DIVX' or 'H264'. Defaults to 'None' indicating uncompressed "
          "video.")
+        ("encoder", po::value<std::string>(),
+         "Video encoding backend. Values are:\n"
+         "  opencv: whichever backend OpenCV selects (default).\n"
+         "  ffmpeg: OpenCV's FFmpeg backend.\n"
+         "  ffmpeg-hw: OpenCV's FFmpeg backend using any available hardware "
+         "encoder (e.g. NVENC or VAAPI). Requires OpenCV 4.5.2 or later.\n"
+         "  raw: lossless .oatraw frame file with a .idx index, written "
+         "with direct I/O. fourcc is ignored.\n"
+         "  ffv1: lossless FFV1 compression to a .mkv file, with each frame "
+         "split into slices encoded in parallel. fourcc is ignored. Requires "
+         "a build with USE_FFMPEG.\n"
+         "  x264-lossless: lossless H.264 compression to a .mkv file, with "
+         "frame threading. Smaller files than ffv1 at a higher CPU cost. 8-bit "
+         "frames only. fourcc is ignored. Requires a build with USE_FFMPEG.")
+        ("encode-threads", po::value<int>(),
+         "Number of threads used by each ffv1 or x264-lossless encoder. "
+         "Defaults to 0, which uses every core.")
+        ("crop", po::value<std::string>(),
+         "Four element array of unsigned ints, [x0,y0,width,height], "
+         "defining the region of each frame SOURCE to record, e.g. the "
+         "arena. Origin is upper left corner. Only this region is copied out "
+         "of shared memory, queued and encoded. Defaults to the whole frame.")
+        ("scale", po::value<double>(),
+         "Factor, between 0.01 and 1, by which recorded frames are scaled "
+         "down, after any crop. Defaults to 1.")
+        ("rotate-size", po::value<double>(),
+         "Split video into a new file whenever the current one reaches this "
+         "many megabytes. Files are numbered and listed, along with their "
+         "first and last sample numbers, in a .chunks.csv index.")
+        ("rotate-duration", po::value<double>(),
+         "Split video into a new file whenever the current one spans this "
+         "many seconds of samples.")
         ("binary-file,b",
          "Position data will be written as numpy data file (version 1.0) "
          "instead of JSON. Each position data point occupies a single entry "
          "in a structured numpy array. Individual position characteristics "
          "are described in the arrays dtype.")
+        ("hdf5-file",
+         "Position data of every position SOURCE will be written to a single "
+         "columnar HDF5 file instead of to a JSON or numpy file per SOURCE. "
+         "Each SOURCE is a group, named after it, holding one chunked "
+         "dataset per field of the numpy dtype (tick, usec, pos_xy, etc.), "
+         "so that only the fields needed need to be read. Requires a build "
+         "with USE_HDF5.")
+        ("hdf5-compression", po::value<int>(),
+         "Deflate level, from 0 (none) to 9, of HDF5 position datasets. "
+         "Chunks are byte shuffled before compression. Defaults to 4.")
         ("concise-file,c",
          "If set and using JSON file format, indeterminate position data fields "
          "will not be written e.g. pos_xy will not be written even when "
          "pos_ok = false. This means that position objects will be of "
          "variable size depending on the validity of whether a position was "
          "detected or not, potentially complicating file parsing.")
+        ("pretrigger,t", po::value<double>(),
+         "Length, in seconds, of a pre-trigger window. If set, recording "
+         "starts paused, and the most recent samples are kept in memory until "
+         "a 'start' command is received, at which point they are written "
+         "ahead of the live stream.")
+        ("motion-gate", po::value<double>(),
+         "If set, only record while the first frame SOURCE is moving, that "
+         "is, while the mean absolute difference between subsampled "
+         "successive frames exceeds this many intensity levels. Samples of "
+         "every SOURCE keep their sample numbers, so gaps in a file mark the "
+         "idle periods left out. Samples in the pretrigger window are written "
+         "ahead of each bout of activity, and recording does not start "
+         "paused.")
+        ("speed-gate", po::value<double>(),
+         "As motion-gate, but gated on the first position SOURCE moving "
+         "faster than this speed, in its units of length per second.")
+        ("postroll", po::value<double>(),
+         "Seconds of samples that are still recorded after activity stops "
+         "when recording is motion or speed gated. Defaults to 0.")
+        ("async,a",
+         "If set, each SOURCE is read on its own thread rather than all "
+         "SOURCEs being read in lockstep, so SOURCEs with different sample "
+         "rates are recorded at their own rates and a slow SOURCE does not "
+         "throttle a fast one. Every SOURCE is written as a track of a "
+         "single Matroska file, with samples interleaved by sample time: "
+         "frames losslessly encoded with ffv1, or x264-lossless if chosen, "
+         "and positions as JSON text. Requires a build with USE_FFMPEG.")
         ;
 
     return local_opts;
@@ -142,12 +250,66 @@ void Recorder::applyConfiguration(const po::variables_map &vm,
     // Date
     oat::config::getValue(vm, config_table, "date", prepend_timestamp_);
 
+    // Independent SOURCE readers
+    oat::config::getValue(vm, config_table, "async", async_);
+
+    // Shared position file
+    oat::config::getValue(vm, config_table, "allow-overwrite", allow_overwrite_);
+    oat::config::getValue(vm, config_table, "hdf5-file", use_hdf5_);
+    oat::config::getNumericValue<int>(
+        vm, config_table, "hdf5-compression", hdf5_compression_, 0, 9);
+#ifndef USE_HDF5
+    if (use_hdf5_)
+        throw std::runtime_error("hdf5-file requires a build with USE_HDF5.");
+#endif
+#ifndef USE_FFMPEG
+    if (async_)
+        throw std::runtime_error("async requires a build with USE_FFMPEG.");
+#endif
+    if (async_ && use_hdf5_)
+        throw std::runtime_error("async writes positions to the interleaved "
+                                 "file, so hdf5-file cannot be used with it.");
+
+    // Motion gate, driven by the first SOURCE of the gated kind
+    const bool motion = oat::config::getNumericValue<double>(
+        vm, config_table, "motion-gate", gate_threshold_, 0);
+    const bool speed = oat::config::getNumericValue<double>(
+        vm, config_table, "speed-gate", gate_threshold_, 0);
+
+    if (motion && speed)
+        throw std::runtime_error("Recording can be gated on motion or on "
+                                 "speed, but not both.");
+
+    for (auto &w : writers_) {
+        if ((motion && dynamic_cast<FrameWriter *>(w.get()))
+            || (speed && dynamic_cast<PositionWriter *>(w.get()))) {
+            gate_writer_ = w.get();
+            break;
+        }
+    }
+
+    if ((motion || speed) && gate_writer_ == nullptr)
+        throw std::runtime_error(std::string(motion ? "motion-gate requires a "
+                                                      "frame SOURCE."
+                                                    : "speed-gate requires a "
+                                                      "position SOURCE."));
+
+    gate_open_ = gate_writer_ == nullptr;
+
+    double postroll = 0;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "postroll", postroll, 0))
+        postroll_usec_ = static_cast<int64_t>(postroll * 1e6);
+
+    // Pre-trigger window. Recording starts paused and waits for a trigger,
+    // unless the window serves as the pre-roll of a motion gate.
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "pretrigger", pretrigger_sec_, 0))
+        record_on_ = pretrigger_sec_ == 0 || gate_writer_ != nullptr;
+
     // Writer specific options
     for (auto &w : writers_)
         w->configure(config_table, vm);
-
-    // Start the recording thread
-    writer_thread_ = std::thread( [this] { writeLoop(); } );
 }
 
 bool Recorder::connectToNode()
@@ -163,18 +325,48 @@ bool Recorder::connectToNode()
         all_ts.push_back(w->sample_period_sec());
     }
 
-    // Examine sample period of sources to make sure they are the same
-    if (!oat::checkSamplePeriods(all_ts, sample_rate_hz_))
+    // Examine sample period of sources to make sure they are the same. In
+    // async mode they are free to differ.
+    if (!oat::checkSamplePeriods(all_ts, sample_rate_hz_) && !async_)
         std::cerr << oat::Warn(oat::inconsistentSampleRateWarning(sample_rate_hz_));
 
+    for (auto &w : writers_)
+        w->setPretrigger(pretrigger_sec_);
+
     // Setup file, etc
     initializeRecording();
 
+    // Start the recording threads, now that the write queues are sized
+    for (auto &w : writers_) {
+        auto writer = w.get();
+        writer_threads_.emplace_back([this, writer] { writeLoop(*writer); });
+        helper_thread_policy_.apply(writer_threads_.back(), "file writer");
+    }
+
+    if (async_) {
+        for (auto &w : writers_) {
+            auto writer = w.get();
+            reader_threads_.emplace_back([this, writer] { readLoop(*writer); });
+        }
+    }
+
     return true;
 }
 
 int Recorder::process()
 {
+    if (async_) {
+
+        std::unique_lock<std::mutex> lk(reader_mutex_);
+        reader_condition_variable_.wait_for(lk, std::chrono::milliseconds(10),
+                                            [this] { return source_eof_.load(); });
+
+        if (reader_error_)
+            std::rethrow_exception(reader_error_);
+
+        return source_eof_;
+    }
+
     bool source_eof = false;
 
     // Read sources, push samples to write buffers
@@ -184,9 +376,11 @@ int Recorder::process()
         ////////////////////////////
         source_eof |= w->wait() == oat::NodeState::END;
 
-        if (record_on_ && !source_eof) {
+        if (!source_eof && recording(*w)) {
            w->push();
            files_have_data_ = true;
+        } else if (!source_eof) {
+           w->hold();
         }
 
         w->post();
@@ -194,9 +388,6 @@ int Recorder::process()
         //  END CRITICAL SECTION  //
     }
 
-    // Notify the writer thread that there are new queued samples
-    writer_condition_variable_.notify_one();
-
     return source_eof;
 }
 
@@ -204,9 +395,11 @@ oat::CommandDescription Recorder::commands()
 {
     const oat::CommandDescription commands{
         {"start", "Start recording. This will append the file if it "
-                  "already exists. It will create a new one if it doesn't." },
+                  "already exists. It will create a new one if it doesn't. "
+                  "'at SAMPLE start' starts with sample number SAMPLE." },
         {"pause", "Pause recording. This will pause the recording "
-                  "without creating a new file." },
+                  "without creating a new file. 'at SAMPLE pause' writes "
+                  "samples up to, but not including, SAMPLE." },
         {"new", "Start a new file using folder location and file name "
                 "options as provided in command line arguements."},
     };
@@ -218,33 +411,246 @@ void Recorder::applyCommand(const std::string &command)
 {
     const auto cmds = commands();
 
-    if (command == "start") {
-        record_on_ = true;
-    } else if (command == "pause") {
-        record_on_ = false;
+    if (command == "start" || command == "pause") {
+        std::lock_guard<std::mutex> lk(schedule_mutex_);
+        schedule_.clear();
+        passed_.clear();
+        scheduled_ = false;
+        record_on_ = command == "start";
     } else if (command == "new") {
         // TODO: makeNewFile()
         std::cout << "did not implement new yet...\n";
     }
 }
 
-void Recorder::writeLoop()
+bool Recorder::applyCommandAt(const std::string &command, uint64_t sample)
 {
-    while (running_) {
+    if (command != "start" && command != "pause")
+        return false;
+
+    std::lock_guard<std::mutex> lk(schedule_mutex_);
+    const auto at = schedule_.insert(laterThan(sample),
+                                     {sample, command == "start"});
+    scheduled_ = true;
+
+    // Checked after publishing the entry: a SOURCE that read the sample
+    // before then is seen here, and any later one sees the entry
+    if (sample < next_sample_) {
+        schedule_.erase(at);
+        scheduled_ = !schedule_.empty();
+        std::cerr << oat::whoWarn(name_, "Sample " + std::to_string(sample)
+                                  + " has already been read. '" + command
+                                  + "' was not scheduled.") << "\n";
+        return false;
+    }
 
-        std::unique_lock<std::mutex> lk(writer_mutex_);
-        writer_condition_variable_.wait_for(lk, std::chrono::milliseconds(10));
+    return true;
+}
 
-        for (auto &w : writers_)
-            w->write();
+std::vector<Recorder::Scheduled>::iterator
+Recorder::laterThan(const uint64_t sample)
+{
+    return std::upper_bound(schedule_.begin(), schedule_.end(), sample,
+                            [](const uint64_t s, const Scheduled &entry) {
+                                return s < entry.sample;
+                            });
+}
+
+bool Recorder::recording(Writer &writer)
+{
+    const uint64_t count = writer.sample_count();
+    uint64_t next = next_sample_;
+    while (count >= next
+           && !next_sample_.compare_exchange_weak(next, count + 1)) { }
+
+    bool record;
+    if (scheduled_) {
+
+        std::lock_guard<std::mutex> lk(schedule_mutex_);
+        record = record_on_;
+
+        const auto current = laterThan(count);
+        if (current != schedule_.begin())
+            record = std::prev(current)->record;
+
+        // Entries that every SOURCE has passed hold for all of them from now
+        // on, so the last of them becomes the standing state
+        passed_[&writer] = count;
+        if (passed_.size() == writers_.size()) {
+
+            uint64_t slowest = std::numeric_limits<uint64_t>::max();
+            for (const auto &p : passed_)
+                slowest = std::min(slowest, p.second);
+
+            const auto done = laterThan(slowest);
+            if (done != schedule_.begin()) {
+                record_on_ = std::prev(done)->record;
+                schedule_.erase(schedule_.begin(), done);
+            }
+        }
+
+        if (schedule_.empty()) {
+            passed_.clear();
+            scheduled_ = false;
+        }
+
+    } else {
+        record = record_on_;
+    }
+
+    if (&writer == gate_writer_) {
+
+        int64_t usec;
+        if (writer.activity(usec) > gate_threshold_) {
+            gate_seen_activity_ = true;
+            gate_last_activity_usec_ = usec;
+        }
+
+        // Other SOURCEs follow the gate as of the gate SOURCE's latest
+        // sample, which pre- and post-roll cover
+        gate_open_ = gate_seen_activity_
+                     && usec - gate_last_activity_usec_ <= postroll_usec_;
+    }
+
+    return record && gate_open_;
+}
+
+void Recorder::readLoop(Writer &writer)
+{
+    try {
+
+        while (running_ && !quit) {
+
+            // START CRITICAL SECTION //
+            ////////////////////////////
+            if (writer.wait() == oat::NodeState::END)
+                break;
+
+            if (recording(writer)) {
+               writer.push();
+               files_have_data_ = true;
+            } else {
+               writer.hold();
+            }
+
+            writer.post();
+            ////////////////////////////
+            //  END CRITICAL SECTION  //
+        }
+
+    } catch (const boost::interprocess::interprocess_exception &ex) {
+
+        // Error code 1 indicates a SIGINT during a call to wait(), which is
+        // normal behavior
+        if (ex.get_error_code() != 1) {
+            std::lock_guard<std::mutex> lk(reader_mutex_);
+            reader_error_ = std::current_exception();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lk(reader_mutex_);
+        reader_error_ = std::current_exception();
+    }
+
+    // The end of any stream or an error ends the recording, as in lockstep
+    // mode
+    {
+        std::lock_guard<std::mutex> lk(reader_mutex_);
+        source_eof_ = true;
     }
+    reader_condition_variable_.notify_one();
+}
+
+void Recorder::stopReaders()
+{
+    if (reader_threads_.empty())
+        return;
+
+    // Readers still waiting on a SOURCE are released by quit. Under futex
+    // synchronization, waits are only interrupted by a signal, so deliver
+    // one to each reader too.
+    running_ = false;
+    quit = 1;
+    for (auto &t : reader_threads_) {
+#ifdef USE_FUTEX
+        if (t.joinable())
+            pthread_kill(t.native_handle(), SIGINT);
+#endif
+        if (t.joinable())
+            t.join();
+    }
+
+    reader_threads_.clear();
+}
+
+void Recorder::writeLoop(Writer &writer)
+{
+    // Real-time helper threads are already ordered by their priority
+    if (helper_thread_policy_.priority == 0 && writer.niceness() != 0)
+        setpriority(PRIO_PROCESS,
+                    static_cast<id_t>(syscall(SYS_gettid)),
+                    writer.niceness());
+
+    // Each writer sleeps until its own SOURCE queues samples, so it never
+    // waits on, or is woken for, another writer
+    auto stopped = [this] { return !running_; };
+    while (running_) {
+        if (writer.awaitSamples(stopped, std::chrono::milliseconds(100)))
+            writer.write();
+    }
+
+    // Flush whatever was queued before stopping
+    writer.write();
 }
 
 void Recorder::initializeRecording()
 {
     std::string timestamp = oat::createTimeStamp();
 
+#ifdef USE_FFMPEG
+    if (async_) {
+
+        auto path = generateFileName(timestamp, "recording") + ".mkv";
+        if (!allow_overwrite_)
+            oat::ensureUniquePath(path);
+        if (!oat::checkWritePermission(path))
+            throw std::runtime_error("Write permission denied for " + path);
+        muxer_ = oat::make_unique<oat::Muxer>(path);
+
+        // Every track is added before the file is started
+        for (auto &w : writers_) {
+            if (auto fw = dynamic_cast<FrameWriter *>(w.get()))
+                fw->initialize(*muxer_);
+            else if (auto pw = dynamic_cast<PositionWriter *>(w.get()))
+                pw->initialize(*muxer_);
+        }
+
+        muxer_->start();
+        return;
+    }
+#endif
+
     for (auto &w : writers_) {
+
+#ifdef USE_HDF5
+        auto pw = dynamic_cast<PositionWriter *>(w.get());
+        if (use_hdf5_ && pw != nullptr) {
+
+            if (!position_store_) {
+                auto path = generateFileName(timestamp, "positions") + ".h5";
+                if (!allow_overwrite_)
+                    oat::ensureUniquePath(path);
+                if (!oat::checkWritePermission(path))
+                    throw std::runtime_error("Write permission denied for "
+                                             + path);
+                position_store_ = oat::make_unique<oat::PositionStore>(
+                    path, hdf5_compression_);
+            }
+
+            pw->initialize(*position_store_);
+            continue;
+        }
+#endif
+
         auto fid = generateFileName(timestamp, w->addr());
         w->initialize(fid);
     }
@@ -20,15 +20,23 @@
 #ifndef OAT_RECORDER_H
 #define OAT_RECORDER_H
 
+#include "OatConfig.h" // Generated by CMake
 #include "Writer.h"
+#include "Muxer.h"
+#include "PositionStore.h"
 
 #include <boost/program_options.hpp>
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "../../lib/base/ControllableComponent.h"
 #include "../../lib/base/Configurable.h"
@@ -50,6 +58,7 @@ private:
     bool connectToNode(void) override;
     int process(void) override;
     void applyCommand(const std::string &command) override;
+    bool applyCommandAt(const std::string &command, uint64_t sample) override;
     oat::CommandDescription commands(void) override;
 
     // Implement Configurable interface
@@ -74,6 +83,31 @@ private:
     // threads and processes
     std::atomic<bool> record_on_ {true};
 
+    // Starts and pauses scheduled for a sample number, sorted by sample and
+    // then in the order they were received. Each SOURCE follows the last
+    // entry at or before its current sample, so SOURCEs read at different
+    // times still start and stop on the same sample. Entries that every
+    // SOURCE has passed are folded into record_on_. An immediate start or
+    // pause clears them.
+    struct Scheduled {
+        uint64_t sample;
+        bool record;
+    };
+    std::mutex schedule_mutex_;
+    std::vector<Scheduled> schedule_;
+    std::atomic<bool> scheduled_ {false};
+
+    // Latest sample number of each SOURCE while entries are scheduled
+    std::map<const Writer *, uint64_t> passed_;
+
+    // One past the largest sample number read from any SOURCE, or 0 before
+    // any has been read. Commands scheduled for earlier samples are refused.
+    std::atomic<uint64_t> next_sample_ {0};
+
+    // First scheduled entry for a later sample. Call with schedule_mutex_
+    // held.
+    std::vector<Scheduled>::iterator laterThan(const uint64_t sample);
+
     // Sample rate of this recorder
     // The true sample rate is enforced by the slowest SOURCE since all SOURCEs
     // are synchronized. User will be warned if SOURCE sample rates differ.
@@ -85,22 +119,73 @@ private:
     // Base file name
     std::string file_name_ {""};
 
+    // Length of the pre-trigger window kept while recording is paused
+    double pretrigger_sec_ {0.0};
+
+    // Motion gate. When set, samples are only written while the gate
+    // writer's activity exceeds gate_threshold_, and for postroll_usec_ of
+    // sample time after. The pre-trigger window serves as pre-roll.
+    Writer *gate_writer_ {nullptr};
+    double gate_threshold_ {0.0};
+    int64_t postroll_usec_ {0};
+    bool gate_seen_activity_ {false};
+    int64_t gate_last_activity_usec_ {0};
+    std::atomic<bool> gate_open_ {true};
+
+    /**
+     * @brief Decide whether a SOURCE's current sample is written or held.
+     * Must be called between the writer's wait() and post().
+     * @param writer Writer whose sample was just read.
+     * @return True if the sample should be written.
+     */
+    bool recording(Writer &writer);
+
     // Determines if should file_name be prepended with a timestamp
     bool prepend_timestamp_ {false};
 
-    // True on first file write
-    bool files_have_data_ {false};
+    // Positions of every position SOURCE are written to one columnar HDF5
+    // file, shared by their writers
+    bool use_hdf5_ {false};
+    int hdf5_compression_ {4};
+    bool allow_overwrite_ {false};
+#ifdef USE_HDF5
+    std::unique_ptr<oat::PositionStore> position_store_;
+#endif
 
-    // Executed by writer_thread_
-    void writeLoop(void);
+    // True on first file write
+    std::atomic<bool> files_have_data_ {false};
+
+    // If true, each SOURCE is read by its own reader thread instead of all
+    // SOURCEs being read in lockstep by process(), and every SOURCE is
+    // written to one file with their samples interleaved by sample time
+    bool async_ {false};
+#ifdef USE_FFMPEG
+    std::unique_ptr<oat::Muxer> muxer_;
+#endif
+
+    // Executed by each of reader_threads_ for its own writer in async mode
+    void readLoop(Writer &writer);
+    void stopReaders(void);
+
+    // Reader threading. process() sleeps until a reader reaches the end of
+    // its stream or fails.
+    std::vector<std::thread> reader_threads_;
+    std::mutex reader_mutex_;
+    std::condition_variable reader_condition_variable_;
+    std::atomic<bool> source_eof_ {false};
+    std::exception_ptr reader_error_ {nullptr};
+
+    // Executed by each of writer_threads_ for its own writer
+    void writeLoop(Writer &writer);
 
     // Writers (each owns its SOURCE)
     std::vector<std::unique_ptr<Writer>> writers_;
 
-    // File-writer threading
-    std::thread writer_thread_;
-    std::mutex writer_mutex_;
-    std::condition_variable writer_condition_variable_;
+    // File-writer threading. Each writer encodes and writes on its own
+    // thread, woken by its own write queue, so that, e.g., several compressed
+    // video streams are encoded in parallel and position files keep up while
+    // video is encoded
+    std::vector<std::thread> writer_threads_;
 
     // Create file name from components
     std::string generateFileName(const std::string timestamp,
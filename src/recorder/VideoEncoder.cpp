@@ -0,0 +1,142 @@
+//******************************************************************************
+//* File:   VideoEncoder.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "OatConfig.h" // Generated by CMake
+
+#include "VideoEncoder.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <opencv2/videoio.hpp>
+
+#include "../../lib/utility/FrameIndex.h"
+#include "../../lib/utility/make_unique.h"
+
+#include "LibavEncoder.h"
+#include "RawFrameEncoder.h"
+
+// Hardware acceleration properties appeared in OpenCV 4.5.2
+#if CV_VERSION_MAJOR > 4 \
+    || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR > 5) \
+    || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)
+#define OAT_HAVE_VIDEO_ACCELERATION
+#endif
+
+namespace oat {
+
+/**
+ * @brief Encoder backed by cv::VideoWriter. Frames are indexed by sample in a
+ * '.idx' file next to the video.
+ */
+class CVVideoEncoder : public VideoEncoder {
+
+public:
+
+    CVVideoEncoder(const int api, const bool hardware)
+    : api_(api)
+    , hardware_(hardware)
+    {
+#ifndef OAT_HAVE_VIDEO_ACCELERATION
+        if (hardware_)
+            throw std::runtime_error("Hardware encoding requires OpenCV 4.5.2 "
+                                     "or later.");
+#endif
+    }
+
+    std::string extension() const override { return ".avi"; }
+
+    void open(const std::string &path,
+              const int fourcc,
+              const double fps,
+              const oat::FrameParams &params) override
+    {
+        const cv::Size size(params.cols, params.rows);
+
+        bool ok;
+#ifdef OAT_HAVE_VIDEO_ACCELERATION
+        if (hardware_)
+            ok = writer_.open(path, api_, fourcc, fps, size,
+                              {cv::VIDEOWRITER_PROP_HW_ACCELERATION,
+                               cv::VIDEO_ACCELERATION_ANY});
+        else
+#endif
+            ok = writer_.open(path, api_, fourcc, fps, size);
+
+        if (!ok)
+            throw std::runtime_error("Could not open video writer for "
+                                     + path + ".");
+        path_ = path;
+        index_.open(path_);
+    }
+
+    void encode(const std::vector<RecordedFrame> &batch) override
+    {
+        for (const auto &f : batch) {
+            writer_.write(f.mat);
+            index_.append(f.sample.count(), f.sample.microseconds().count());
+        }
+        index_.flush();
+    }
+
+    void remove() override
+    {
+        index_.remove();
+        if (!path_.empty())
+            std::remove(path_.c_str());
+    }
+
+private:
+
+    const int api_;
+    const bool hardware_;
+    std::string path_;
+    cv::VideoWriter writer_;
+    oat::FrameIndexWriter index_;
+};
+
+std::unique_ptr<VideoEncoder> makeVideoEncoder(const std::string &backend,
+                                               const int threads)
+{
+    if (backend == "opencv")
+        return oat::make_unique<CVVideoEncoder>(cv::CAP_ANY, false);
+    if (backend == "ffmpeg")
+        return oat::make_unique<CVVideoEncoder>(cv::CAP_FFMPEG, false);
+    if (backend == "ffmpeg-hw")
+        return oat::make_unique<CVVideoEncoder>(cv::CAP_FFMPEG, true);
+    if (backend == "raw")
+        return oat::make_unique<RawFrameEncoder>();
+    if (backend == "ffv1" || backend == "x264-lossless") {
+#ifdef USE_FFMPEG
+        return oat::make_unique<LibavEncoder>(
+            backend == "ffv1" ? LibavEncoder::Codec::FFV1
+                              : LibavEncoder::Codec::H264_LOSSLESS,
+            threads);
+#else
+        (void)threads;
+        throw std::runtime_error("The " + backend + " encoder requires a build "
+                                 "with USE_FFMPEG.");
+#endif
+    }
+
+    throw std::runtime_error("Invalid encoder '" + backend + "'. Use opencv, "
+                             "ffmpeg, ffmpeg-hw, raw, ffv1 or x264-lossless.");
+}
+
+} /* namespace oat */
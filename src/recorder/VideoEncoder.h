@@ -0,0 +1,95 @@
+//******************************************************************************
+//* File:   VideoEncoder.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_VIDEOENCODER_H
+#define OAT_VIDEOENCODER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "../../lib/datatypes/Sample.h"
+#include "../../lib/shmemdf/SharedFrameHeader.h"
+
+namespace oat {
+
+/**
+ * @brief A frame queued for encoding along with its sample information.
+ */
+struct RecordedFrame {
+    oat::Sample sample;
+    cv::Mat mat;
+};
+
+/**
+ * @brief Video file encoding backend used by a FrameWriter. Encoders are only
+ * ever driven from their writer's encode thread.
+ */
+class VideoEncoder {
+
+public:
+
+    virtual ~VideoEncoder() { }
+
+    /**
+     * @brief File extension, including the dot, of the files this encoder
+     * writes.
+     */
+    virtual std::string extension(void) const = 0;
+
+    /**
+     * @brief Open a video file.
+     * @param path File path.
+     * @param fourcc Codec four character code. 0 for uncompressed video.
+     * @param fps Frame rate written to the file.
+     * @param params Frame parameters.
+     */
+    virtual void open(const std::string &path,
+                      const int fourcc,
+                      const double fps,
+                      const oat::FrameParams &params) = 0;
+
+    /**
+     * @brief Encode a batch of frames, in order.
+     */
+    virtual void encode(const std::vector<RecordedFrame> &batch) = 0;
+
+    /**
+     * @brief Delete the files this encoder has written.
+     */
+    virtual void remove(void) = 0;
+};
+
+/**
+ * @brief Create an encoder.
+ * @param backend One of 'opencv' (whatever backend OpenCV picks), 'ffmpeg'
+ * (OpenCV's FFmpeg backend), 'ffmpeg-hw' (OpenCV's FFmpeg backend using any
+ * available hardware encoder, e.g. NVENC or VAAPI), 'raw' (lossless
+ * RawFrameEncoder container), or 'ffv1' or 'x264-lossless' (lossless
+ * LibavEncoder compression, which requires a build with USE_FFMPEG).
+ * @param threads Number of threads used by encoders that can spread a frame
+ * over several. 0 uses every core.
+ */
+std::unique_ptr<VideoEncoder> makeVideoEncoder(const std::string &backend,
+                                               const int threads = 0);
+
+}      /* namespace oat */
+#endif /* OAT_VIDEOENCODER_H */
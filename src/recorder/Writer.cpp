@@ -19,6 +19,11 @@
 
 #include "Writer.h"
 
+#include <cmath>
+#include <iostream>
+
+#include "../../lib/utility/IOFormat.h"
+
 namespace oat {
 
 const char Writer::OVERRUN_MSG[]
@@ -27,4 +32,19 @@ const char Writer::OVERRUN_MSG[]
       " - use multiple recorders on multiple disks\n"
       " - or, get a faster hard disk";
 
+size_t Writer::pretriggerSamples(const double seconds)
+{
+    if (seconds <= 0)
+        return 0;
+
+    const double period = sample_period_sec();
+    if (!(period > 0) || !std::isfinite(period)) {
+        std::cerr << oat::Warn("Unknown sample rate for source " + addr()
+                               + ". Pre-trigger window disabled.\n");
+        return 0;
+    }
+
+    return static_cast<size_t>(std::ceil(seconds / period));
+}
+
 } /* namespace oat */
@@ -20,6 +20,8 @@
 #ifndef OAT_WRITER_H
 #define OAT_WRITER_H
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 
 #include <boost/lockfree/spsc_queue.hpp>
@@ -32,6 +34,7 @@
 #include "../../lib/shmemdf/Source.h"
 #include "../../lib/utility/FileFormat.h"
 #include "../../lib/utility/TOMLSanitize.h"
+#include "../buffer/EventCount.h"
 
 namespace oat {
 namespace blf = boost::lockfree;
@@ -62,6 +65,12 @@ public:
     virtual void post(void) = 0;
     virtual double sample_period_sec(void) = 0;
 
+    /**
+     * @brief Sample number of the current sample. Must be called between
+     * wait() and post().
+     */
+    virtual uint64_t sample_count(void) = 0;
+
     /**
      * @brief Create and initialize recording file. Must be called
      * before writeStreams.
@@ -69,15 +78,70 @@ public:
     virtual void initialize(const std::string &path) = 0;
 
     /**
-     * Push a new sample onto the write queue
+     * Push a new sample onto the write queue, preceded by any samples held in
+     * the pre-trigger window
      */
     virtual void push(void) = 0;
 
+    /**
+     * @brief Keep a new sample in the pre-trigger window instead of writing
+     * it. The oldest held sample is discarded once the window is full.
+     */
+    virtual void hold(void) = 0;
+
+    /**
+     * @brief Set the length of the pre-trigger window, and size the write
+     * queue to hold it. Must be called after connect() and before samples
+     * are pushed or written.
+     * @param seconds Window length. 0 to disable.
+     */
+    virtual void setPretrigger(const double seconds) = 0;
+
+    /**
+     * @brief Measure the activity in the current sample, for motion gated
+     * recording. Must be called between wait() and post(), at most once per
+     * sample.
+     * @param usec Set to the time of the sample in microseconds.
+     * @return Activity, in units of the writer's gate threshold, or a
+     * negative value if it cannot be measured on this sample.
+     */
+    virtual double activity(int64_t &usec) = 0;
+
     /**
      * @brief Flush internal sample buffer to file.
      */
     virtual void write(void) = 0;
 
+    /**
+     * @brief True if samples are waiting in the write queue. Called by the
+     * writer thread.
+     */
+    virtual bool pending(void) const = 0;
+
+    /**
+     * @brief Block the writer thread until samples are queued, stop() is
+     * true, or timeout passes. Woken by push().
+     * @return True if samples are waiting in the write queue.
+     */
+    template <typename Stop>
+    bool awaitSamples(Stop stop, const std::chrono::milliseconds timeout)
+    {
+        queued_.await([this, &stop] { return pending() || stop(); }, timeout);
+        return pending();
+    }
+
+    /**
+     * @brief Wake the writer thread, e.g. to stop it.
+     */
+    void notify(void) { queued_.notify(); }
+
+    /**
+     * @brief Nice value of the writer thread. Writers whose writes are
+     * expensive run behind those whose writes are cheap so that a slow
+     * encode cannot starve them of CPU.
+     */
+    virtual int niceness(void) const { return 0; }
+
     /**
      * @brief Delete file
      */
@@ -89,6 +153,16 @@ protected:
     static constexpr int BUFFER_SIZE {1000};
     static const char OVERRUN_MSG[];
 
+    // Notified by push() each time samples are queued
+    oat::EventCount queued_;
+
+    /**
+     * @brief Number of samples of this writer's SOURCE in a pre-trigger
+     * window. Write queues hold this many on top of BUFFER_SIZE, so that
+     * flushing the window cannot overrun them.
+     */
+    size_t pretriggerSamples(const double seconds);
+
     /**
      * @breif Address of shmem for held source
      */
@@ -0,0 +1,702 @@
+//******************************************************************************
+//* File:   Graph.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Graph.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <cpptoml.h>
+
+namespace oat {
+
+// Types that oat-pipeline can host, see Pipeline::makeStage()
+static const std::map<std::string, std::set<std::string>> HOSTABLE {
+    {"framefilt", {"bsub", "mask", "mog", "undistort", "col", "thresh",
+                   "fused", "decimate", "fanout"}},
+    {"posidet", {"diff", "hsv", "thresh", "mog"}},
+    {"posifilt", {"kalman", "homography", "region", "track", "chain"}}
+};
+
+// A key holding either a string or an array of strings
+static std::vector<std::string>
+stringList(const std::shared_ptr<cpptoml::table> &t, const std::string &key)
+{
+    if (!t->contains(key))
+        return {};
+
+    if (auto s = t->get_as<std::string>(key))
+        return {*s};
+
+    if (auto a = t->get_array_of<std::string>(key))
+        return *a;
+
+    throw std::runtime_error("'" + key + "' must be a string or an array "
+                             "of strings.");
+}
+
+template <typename T>
+static T valueOr(const std::shared_ptr<cpptoml::table> &t,
+                 const std::string &key,
+                 const T &fallback)
+{
+    if (!t->contains(key))
+        return fallback;
+
+    auto v = t->get_as<T>(key);
+    if (!v)
+        throw std::runtime_error("'" + key + "' has the wrong type.");
+
+    return *v;
+}
+
+static bool restartPolicy(const std::string &policy)
+{
+    if (policy == "never")
+        return false;
+    if (policy == "on-failure")
+        return true;
+
+    throw std::runtime_error("Invalid restart policy '" + policy
+                             + "'. Use 'never' or 'on-failure'.");
+}
+
+// TOML basic string
+static std::string quoted(const std::string &s)
+{
+    std::string q {"\""};
+    for (auto c : s) {
+        if (c == '"' || c == '\\')
+            q += '\\';
+        q += c;
+    }
+
+    return q + "\"";
+}
+
+// CPUs of the list format used by sysfs, e.g. "0-3,8,10-11"
+static std::vector<int> parseCPUList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+
+        if (range.empty() || range == "\n")
+            continue;
+
+        int lo = 0, hi = 0;
+        const auto n = std::sscanf(range.c_str(), "%d-%d", &lo, &hi);
+        if (n < 1)
+            continue;
+        if (n == 1)
+            hi = lo;
+
+        for (int c = lo; c <= hi; c++)
+            cpus.push_back(c);
+    }
+
+    return cpus;
+}
+
+struct NUMANode {
+    int id {-1};
+    std::vector<int> cpus; // CPUs this process may use
+    size_t used {0};       // CPUs handed out so far
+};
+
+// NUMA nodes with the CPUs this process is allowed to run on. A machine
+// without NUMA information is treated as a single node with id -1.
+static std::vector<NUMANode> topology()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            CPU_SET(c, &allowed);
+
+    std::vector<NUMANode> nodes;
+    const std::string root {"/sys/devices/system/node/"};
+    if (auto dir = ::opendir(root.c_str())) {
+
+        while (auto entry = ::readdir(dir)) {
+
+            int id;
+            char tail;
+            if (std::sscanf(entry->d_name, "node%d%c", &id, &tail) != 1)
+                continue;
+
+            std::ifstream f(root + entry->d_name + "/cpulist");
+            std::string list;
+            std::getline(f, list);
+
+            NUMANode n;
+            n.id = id;
+            for (auto c : parseCPUList(list))
+                if (c < CPU_SETSIZE && CPU_ISSET(c, &allowed))
+                    n.cpus.push_back(c);
+
+            if (!n.cpus.empty())
+                nodes.push_back(n);
+        }
+
+        ::closedir(dir);
+    }
+
+    if (nodes.empty()) {
+        NUMANode n;
+        n.id = -1;
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed))
+                n.cpus.push_back(c);
+        nodes.push_back(n);
+    }
+
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NUMANode &a, const NUMANode &b) { return a.id < b.id; });
+
+    return nodes;
+}
+
+Graph::Graph(const std::string &file)
+{
+    // Pipeline files are read by oat-pipeline from its own working directory
+    char *real = ::realpath(file.c_str(), nullptr);
+    if (real == nullptr)
+        throw std::runtime_error("Graph file " + file + " could not be found.");
+    file_ = real;
+    std::free(real);
+
+    std::vector<Component> components;
+    bool in_process = true, place_cpus = true;
+    parse(components, in_process, place_cpus);
+    build(components, group(components, in_process));
+    order();
+
+    if (place_cpus)
+        place();
+}
+
+Graph::~Graph()
+{
+    for (const auto &f : generated_)
+        std::remove(f.c_str());
+}
+
+void Graph::parse(std::vector<Component> &components,
+                  bool &in_process,
+                  bool &place)
+{
+    // Will throw if file contains bad syntax
+    auto graph = cpptoml::parse_file(file_);
+
+    bool restart = false;
+    int64_t max_restarts = 3;
+    double stall_timeout = 0;
+    if (auto run = graph->get_table("run")) {
+
+        const auto transport = valueOr<std::string>(run, "transport", "in-process");
+        if (transport != "in-process" && transport != "shmem")
+            throw std::runtime_error("Invalid transport '" + transport
+                                     + "'. Use 'in-process' or 'shmem'.");
+        in_process = transport == "in-process";
+
+        const auto placement = valueOr<std::string>(run, "placement", "auto");
+        if (placement != "auto" && placement != "none")
+            throw std::runtime_error("Invalid placement '" + placement
+                                     + "'. Use 'auto' or 'none'.");
+        place = placement == "auto";
+
+        restart = restartPolicy(valueOr<std::string>(run, "restart", "never"));
+        max_restarts = valueOr<int64_t>(run, "max-restarts", max_restarts);
+        stall_timeout = valueOr<double>(run, "stall-timeout", stall_timeout);
+        deterministic_ = valueOr<bool>(run, "deterministic", false);
+    }
+
+    auto table = graph->get_table_array("component");
+    if (!table)
+        throw std::runtime_error("Graph file " + file_ + " does not "
+                                 "declare any [[component]]s.");
+
+    std::set<std::string> names;
+    for (const auto &t : *table) {
+
+        Component c;
+
+        if (!t->contains("component"))
+            throw std::runtime_error("Each graph component requires a "
+                                     "'component' key.");
+        c.component = *t->get_as<std::string>("component");
+        c.name = valueOr<std::string>(
+            t, "name", c.component + std::to_string(components.size()));
+
+        if (!names.insert(c.name).second)
+            throw std::runtime_error("Component name '" + c.name
+                                     + "' is used more than once.");
+
+        c.type = valueOr<std::string>(t, "type", "");
+        c.sources = stringList(t, "source");
+        c.sinks = stringList(t, "sink");
+        c.reads = stringList(t, "reads");
+        c.writes = stringList(t, "writes");
+        c.config = valueOr<std::string>(t, "config", "");
+        c.args = stringList(t, "args");
+
+        if (t->contains("cpus")) {
+            auto cpus = t->get_array_of<int64_t>("cpus");
+            if (!cpus)
+                throw std::runtime_error("'cpus' must be an array of CPU "
+                                         "numbers.");
+            c.cpus.assign(cpus->begin(), cpus->end());
+        }
+
+        c.numa_node = static_cast<int>(valueOr<int64_t>(t, "numa-node", -1));
+
+        const auto transport = valueOr<std::string>(t, "transport", "in-process");
+        if (transport != "in-process" && transport != "shmem")
+            throw std::runtime_error("Invalid transport '" + transport
+                                     + "' for component '" + c.name + "'.");
+        c.shmem = transport == "shmem";
+
+        c.restart = t->contains("restart")
+            ? restartPolicy(*t->get_as<std::string>("restart")) : restart;
+        c.max_restarts = static_cast<int>(
+            valueOr<int64_t>(t, "max-restarts", max_restarts));
+        if (c.max_restarts < 0)
+            throw std::runtime_error("'max-restarts' of component '" + c.name
+                                     + "' must be non-negative.");
+
+        c.stall_timeout = valueOr<double>(t, "stall-timeout", stall_timeout);
+        if (c.stall_timeout < 0)
+            throw std::runtime_error("'stall-timeout' of component '" + c.name
+                                     + "' must be non-negative.");
+
+        components.push_back(c);
+    }
+}
+
+std::vector<int> Graph::group(const std::vector<Component> &components,
+                              bool in_process) const
+{
+    const int n = static_cast<int>(components.size());
+
+    // Node writers
+    std::map<std::string, int> writer;
+    for (int i = 0; i < n; i++) {
+        auto out = components[i].sinks;
+        out.insert(out.end(),
+                   components[i].writes.begin(),
+                   components[i].writes.end());
+        for (const auto &node : out) {
+            if (writer.count(node))
+                throw std::runtime_error(
+                    "Node '" + node + "' is written by both '"
+                    + components[writer[node]].name + "' and '"
+                    + components[i].name + "'.");
+            writer[node] = i;
+        }
+    }
+
+    // Component edges, from writer to reader
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < n; i++) {
+        auto in = components[i].sources;
+        in.insert(in.end(),
+                  components[i].reads.begin(),
+                  components[i].reads.end());
+        for (const auto &node : in) {
+            auto w = writer.find(node);
+            if (w == writer.end())
+                continue;
+            if (w->second == i)
+                throw std::runtime_error("Component '" + components[i].name
+                                         + "' reads its own node '" + node
+                                         + "'.");
+            edges.emplace_back(w->second, i);
+        }
+    }
+
+    std::vector<int> groups(n);
+    std::iota(groups.begin(), groups.end(), 0);
+    if (!in_process)
+        return groups;
+
+    std::function<int(int)> find = [&](int i) {
+        return groups[i] == i ? i : groups[i] = find(groups[i]);
+    };
+
+    auto hostable = [&](const Component &c) {
+        auto h = HOSTABLE.find(c.component);
+        return !c.shmem && h != HOSTABLE.end() && h->second.count(c.type)
+               && c.sources.size() == 1 && c.sinks.size() == 1
+               && c.reads.empty() && c.writes.empty() && c.args.empty()
+               && c.cpus.empty() && c.numa_node < 0;
+    };
+
+    // Whether group b can be reached from group a without taking an edge
+    // straight from a to b. Merging a and b would then close a cycle
+    // through the groups in between.
+    auto detour = [&](int a, int b) {
+        std::vector<bool> seen(n, false);
+        std::queue<int> q;
+        q.push(a);
+        seen[a] = true;
+        while (!q.empty()) {
+            const int g = q.front();
+            q.pop();
+            for (const auto &e : edges) {
+                const int u = find(e.first), v = find(e.second);
+                if (u != g || u == v || seen[v] || (g == a && v == b))
+                    continue;
+                if (v == b)
+                    return true;
+                seen[v] = true;
+                q.push(v);
+            }
+        }
+        return false;
+    };
+
+    for (const auto &e : edges) {
+        if (!hostable(components[e.first]) || !hostable(components[e.second]))
+            continue;
+
+        const int a = find(e.first), b = find(e.second);
+        if (a != b && !detour(a, b) && !detour(b, a))
+            groups[b] = a;
+    }
+
+    for (int i = 0; i < n; i++)
+        groups[i] = find(i);
+
+    return groups;
+}
+
+void Graph::build(const std::vector<Component> &components,
+                  const std::vector<int> &groups)
+{
+    const size_t n = components.size();
+
+    // Processes in the order of their first component
+    std::map<int, size_t> process_of_group;
+    for (size_t i = 0; i < n; i++)
+        if (!process_of_group.count(groups[i])) {
+            process_of_group[groups[i]] = processes_.size();
+            processes_.emplace_back();
+        }
+
+    std::vector<std::vector<size_t>> members(processes_.size());
+    for (size_t i = 0; i < n; i++)
+        members[process_of_group[groups[i]]].push_back(i);
+
+    for (size_t p = 0; p < processes_.size(); p++) {
+
+        auto &proc = processes_[p];
+        std::set<std::string> written;
+
+        for (auto i : members[p]) {
+            const auto &c = components[i];
+            proc.hosts.push_back(c.name);
+            proc.name += (proc.name.empty() ? "" : "+") + c.name;
+            for (const auto &w : c.sinks)
+                written.insert(w);
+            for (const auto &w : c.writes)
+                written.insert(w);
+            proc.restart = proc.restart || c.restart;
+        }
+
+        // The strictest restart limit of the hosted components holds
+        proc.max_restarts = INT_MAX;
+        for (auto i : members[p])
+            if (components[i].restart)
+                proc.max_restarts = std::min(proc.max_restarts,
+                                             components[i].max_restarts);
+        if (!proc.restart)
+            proc.max_restarts = 0;
+
+        // And the shortest stall timeout
+        for (auto i : members[p]) {
+            const auto t = components[i].stall_timeout;
+            if (t > 0 && (proc.stall_timeout == 0 || t < proc.stall_timeout))
+                proc.stall_timeout = t;
+        }
+
+        proc.writes.assign(written.begin(), written.end());
+
+        for (auto i : members[p]) {
+            auto in = components[i].sources;
+            in.insert(in.end(),
+                      components[i].reads.begin(),
+                      components[i].reads.end());
+            for (const auto &r : in)
+                if (!written.count(r)
+                    && std::find(proc.reads.begin(), proc.reads.end(), r)
+                           == proc.reads.end())
+                    proc.reads.push_back(r);
+        }
+
+        // Each reading component outside this process attaches a SOURCE
+        for (size_t i = 0; i < n; i++) {
+            if (std::find(members[p].begin(), members[p].end(), i)
+                    != members[p].end())
+                continue;
+            auto in = components[i].sources;
+            in.insert(in.end(),
+                      components[i].reads.begin(),
+                      components[i].reads.end());
+            for (const auto &r : in)
+                if (written.count(r))
+                    proc.readers[r]++;
+        }
+
+        if (members[p].size() == 1) {
+
+            const auto &c = components[members[p][0]];
+            proc.argv.push_back("oat-" + c.component);
+            if (!c.type.empty())
+                proc.argv.push_back(c.type);
+            proc.argv.insert(proc.argv.end(), c.sources.begin(), c.sources.end());
+            proc.argv.insert(proc.argv.end(), c.sinks.begin(), c.sinks.end());
+            if (!c.config.empty())
+                proc.argv.insert(proc.argv.end(), {"-c", file_, c.config});
+            proc.argv.insert(proc.argv.end(), c.args.begin(), c.args.end());
+            proc.cpus = c.cpus;
+            proc.numa_node = c.numa_node;
+
+            continue;
+        }
+
+        // Chains of hosted components get a pipeline file of their own
+        const auto path = "/tmp/oat-run-" + std::to_string(::getpid()) + "-"
+                          + std::to_string(generated_.size()) + ".toml";
+        std::ofstream f(path);
+        if (!f)
+            throw std::runtime_error("Could not write pipeline file " + path
+                                     + ".");
+        generated_.push_back(path);
+
+        // Nodes passed between the hosted components are in-process channels
+        // unless another process reads them too. Those stay in shared
+        // memory, and the rest are no longer visible outside this process.
+        std::set<std::string> passed, shared;
+        for (auto i : members[p])
+            for (auto j : members[p])
+                if (components[i].sinks[0] == components[j].sources[0])
+                    passed.insert(components[i].sinks[0]);
+        for (const auto &w : passed)
+            if (proc.readers.count(w))
+                shared.insert(w);
+
+        proc.writes.erase(std::remove_if(proc.writes.begin(),
+                                         proc.writes.end(),
+                                         [&](const std::string &w) {
+                                             return passed.count(w)
+                                                    && !shared.count(w);
+                                         }),
+                          proc.writes.end());
+
+        f << "# Written by oat-run for " << file_ << "\n";
+        if (!shared.empty()) {
+            f << "shared = [";
+            for (const auto &s : shared)
+                f << (s == *shared.begin() ? "" : ", ") << quoted(s);
+            f << "]\n";
+        }
+        for (auto i : members[p]) {
+            const auto &c = components[i];
+            f << "\n[[stage]]\n"
+              << "component = " << quoted(c.component) << "\n"
+              << "type = " << quoted(c.type) << "\n"
+              << "source = " << quoted(c.sources[0]) << "\n"
+              << "sink = " << quoted(c.sinks[0]) << "\n";
+            if (!c.config.empty())
+                f << "config = " << quoted(c.config) << "\n"
+                  << "config-file = " << quoted(file_) << "\n";
+        }
+
+        proc.argv = {"oat-pipeline", path};
+    }
+}
+
+void Graph::order()
+{
+    const size_t n = processes_.size();
+
+    std::map<std::string, size_t> writer;
+    for (size_t p = 0; p < n; p++)
+        for (const auto &w : processes_[p].writes)
+            writer[w] = p;
+
+    std::vector<std::set<size_t>> next(n);
+    std::vector<size_t> in_degree(n, 0);
+    for (size_t q = 0; q < n; q++)
+        for (const auto &r : processes_[q].reads) {
+            auto w = writer.find(r);
+            if (w != writer.end() && next[w->second].insert(q).second)
+                in_degree[q]++;
+        }
+
+    // Kahn's algorithm, writers first
+    std::vector<size_t> topo;
+    std::queue<size_t> ready;
+    for (size_t p = 0; p < n; p++)
+        if (in_degree[p] == 0)
+            ready.push(p);
+
+    while (!ready.empty()) {
+        const auto p = ready.front();
+        ready.pop();
+        topo.push_back(p);
+        for (auto q : next[p])
+            if (--in_degree[q] == 0)
+                ready.push(q);
+    }
+
+    if (topo.size() != n) {
+        std::string cycle;
+        for (size_t p = 0; p < n; p++)
+            if (in_degree[p] > 0)
+                cycle += (cycle.empty() ? "" : ", ") + processes_[p].name;
+        throw std::runtime_error("Components " + cycle + " form a cycle, so "
+                                 "they have no start order.");
+    }
+
+    // Readers are started before writers
+    std::reverse(topo.begin(), topo.end());
+
+    std::vector<size_t> position(n);
+    for (size_t k = 0; k < n; k++)
+        position[topo[k]] = k;
+
+    std::vector<Process> ordered;
+    for (auto p : topo) {
+        ordered.push_back(processes_[p]);
+        for (auto q : next[p])
+            ordered.back().downstream.push_back(position[q]);
+        std::sort(ordered.back().downstream.begin(),
+                  ordered.back().downstream.end());
+    }
+
+    processes_.swap(ordered);
+}
+
+void Graph::place()
+{
+    auto numa = topology();
+    const size_t n = processes_.size();
+
+    // Weakly connected parts of the network
+    std::vector<size_t> part(n);
+    std::iota(part.begin(), part.end(), 0);
+    std::function<size_t(size_t)> find = [&](size_t i) {
+        return part[i] == i ? i : part[i] = find(part[i]);
+    };
+    for (size_t p = 0; p < n; p++)
+        for (auto q : processes_[p].downstream)
+            part[find(q)] = find(p);
+
+    // Members of each part, writers first so that neighbours in the data
+    // flow get neighbouring CPUs
+    std::map<size_t, std::vector<size_t>> parts;
+    for (size_t k = n; k-- > 0;)
+        parts[find(k)].push_back(k);
+
+    std::vector<std::vector<size_t>> sorted;
+    for (auto &p : parts)
+        sorted.push_back(p.second);
+
+    auto cpus_wanted = [&](const std::vector<size_t> &members) {
+        size_t c = 0;
+        for (auto m : members)
+            c += processes_[m].hosts.size();
+        return c;
+    };
+
+    // Largest parts choose their node first
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&](const std::vector<size_t> &a,
+                         const std::vector<size_t> &b) {
+                         return cpus_wanted(a) > cpus_wanted(b);
+                     });
+
+    auto node_of = [&](int id) -> NUMANode * {
+        for (auto &u : numa)
+            if (u.id == id)
+                return &u;
+        return nullptr;
+    };
+
+    for (const auto &members : sorted) {
+
+        // The node with the most CPUs still free
+        auto *chosen = &*std::max_element(
+            numa.begin(), numa.end(),
+            [](const NUMANode &a, const NUMANode &b) {
+                return (a.cpus.size() - std::min(a.used, a.cpus.size()))
+                       < (b.cpus.size() - std::min(b.used, b.cpus.size()));
+            });
+
+        for (auto m : members) {
+
+            auto &proc = processes_[m];
+
+            // Explicit CPUs are kept as they are
+            if (!proc.cpus.empty()) {
+                for (auto &u : numa)
+                    if (std::find(u.cpus.begin(), u.cpus.end(), proc.cpus[0])
+                            != u.cpus.end() && proc.numa_node < 0)
+                        proc.numa_node = u.id;
+                continue;
+            }
+
+            auto *node = chosen;
+            if (proc.numa_node >= 0 && node_of(proc.numa_node) != nullptr)
+                node = node_of(proc.numa_node);
+
+            // One CPU per hosted component. Once the node runs out, the
+            // process may run anywhere on it instead of doubling up on a
+            // single CPU.
+            const auto want = proc.hosts.size();
+            if (node->used + want <= node->cpus.size()) {
+                proc.cpus.assign(node->cpus.begin() + node->used,
+                                 node->cpus.begin() + node->used + want);
+                node->used += want;
+            } else {
+                proc.cpus = node->cpus;
+            }
+            proc.numa_node = node->id;
+        }
+    }
+}
+
+} /* namespace oat */
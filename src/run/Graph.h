@@ -0,0 +1,147 @@
+//******************************************************************************
+//* File:   Graph.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_GRAPH_H
+#define	OAT_GRAPH_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace oat {
+
+/**
+ * @brief An operating system process started by oat-run. Either a single
+ * component, or a chain of components hosted together by oat-pipeline.
+ */
+struct Process {
+
+    std::string name;              //!< Hosted component names, joined by '+'
+    std::vector<std::string> argv; //!< Program and arguments to exec
+    std::vector<std::string> hosts;//!< Names of the hosted components
+    std::vector<std::string> writes; //!< Shared memory nodes it binds
+    std::vector<std::string> reads;  //!< Nodes read by this process
+
+    //! SOURCEs in other processes that each written node waits for
+    std::map<std::string, size_t> readers;
+
+    //! Processes reading a node this one writes, as indices into
+    //! Graph::processes()
+    std::vector<size_t> downstream;
+
+    std::vector<int> cpus; //!< CPUs the process may run on. Empty for any.
+    int numa_node {-1};    //!< NUMA node the CPUs belong to, or -1
+
+    bool restart {false};  //!< Restart on failure
+    int max_restarts {3};  //!< Restarts allowed before giving up
+
+    //! Seconds the process may hold up or stop feeding its nodes before it
+    //! is restarted as stalled, or 0 to never restart it for stalling
+    double stall_timeout {0};
+};
+
+/**
+ * @brief A processing network read from a graph file. Each [[component]] of
+ * the file is one Oat component, e.g.
+ *
+ *     [[component]]
+ *     name = "mog"
+ *     component = "framefilt"
+ *     type = "mog"
+ *     source = "raw"
+ *     sink = "bac"
+ *     config = "mog-config"
+ *
+ * and edges are the nodes written by one component and read by others.
+ * Adjacent components that oat-pipeline can host are merged into one process
+ * so that frames pass between them through in-process channels, and
+ * processes are placed on CPUs so that those adjacent in the network share a
+ * NUMA node.
+ */
+class Graph {
+
+public:
+    /**
+     * @brief Read a graph file.
+     * @param file Graph file.
+     */
+    explicit Graph(const std::string &file);
+
+    /**
+     * @brief Processes in the order they should be started: those reading a
+     * node are started before the one writing it, so that SYNC sources see
+     * every sample.
+     */
+    const std::vector<Process> &processes() const { return processes_; }
+
+    /**
+     * @brief Pipeline files written for processes hosting several
+     * components. Removed by the destructor.
+     */
+    const std::vector<std::string> &generated() const { return generated_; }
+
+    /**
+     * @brief True if the [run] table asks for deterministic replay, in which
+     * the processes are started with OAT_DETERMINISTIC set.
+     */
+    bool deterministic() const { return deterministic_; }
+
+    ~Graph();
+
+    Graph(const Graph &) = delete;
+    Graph &operator=(const Graph &) = delete;
+
+private:
+    // A [[component]] of the graph file
+    struct Component {
+        std::string name;
+        std::string component;
+        std::string type;
+        std::vector<std::string> sources; // Positional SOURCE arguments
+        std::vector<std::string> sinks;   // Positional SINK arguments
+        std::vector<std::string> reads;   // Nodes read through options
+        std::vector<std::string> writes;  // Nodes written through options
+        std::string config;
+        std::vector<std::string> args;
+        std::vector<int> cpus;
+        int numa_node {-1};
+        bool shmem {false};
+        bool restart {false};
+        int max_restarts {3};
+        double stall_timeout {0};
+    };
+
+    std::string file_;
+    std::vector<Process> processes_;
+    std::vector<std::string> generated_;
+    bool deterministic_ {false};
+
+    void parse(std::vector<Component> &components, bool &in_process,
+               bool &place);
+    std::vector<int> group(const std::vector<Component> &components,
+                           bool in_process) const;
+    void build(const std::vector<Component> &components,
+               const std::vector<int> &groups);
+    void order();
+    void place();
+};
+
+}      /* namespace oat */
+#endif /* OAT_GRAPH_H */
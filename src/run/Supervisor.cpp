@@ -0,0 +1,301 @@
+//******************************************************************************
+//* File:   Supervisor.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Supervisor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../../lib/base/ThreadPolicy.h"
+#include "../../lib/shmemdf/Readiness.h"
+#include "../../lib/shmemdf/Registry.h"
+#include "../../lib/utility/IOFormat.h"
+
+extern volatile sig_atomic_t quit;
+
+namespace oat {
+
+// Time given to a process to exit after CTRL+C before it is killed
+static constexpr std::chrono::seconds STOP_TIMEOUT {5};
+
+// Wait before the first restart, doubled for each further one
+static constexpr std::chrono::milliseconds FIRST_BACKOFF {500};
+static constexpr std::chrono::milliseconds MAX_BACKOFF {10000};
+
+// Longest wait for a child to exit between watchdog polls
+static constexpr std::chrono::milliseconds WATCH_PERIOD {100};
+
+// Sleep that ends early on CTRL+C
+static void nap(std::chrono::milliseconds duration)
+{
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (!quit && std::chrono::steady_clock::now() < end)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+// Allocate memory from a NUMA node where possible. The policy is inherited
+// through exec, so the process's first touch of a node's shared memory
+// places it next to the CPUs it runs on.
+static void preferNode(int node, const std::string &what)
+{
+    unsigned long mask[16] {};
+    if (node < 0 || node >= static_cast<int>(8 * sizeof(mask)))
+        return;
+
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 8 * sizeof(mask)) != 0)
+        std::cerr << oat::whoWarn(what, "Could not prefer memory of NUMA node "
+                                  + std::to_string(node) + ": "
+                                  + std::strerror(errno) + "\n");
+}
+
+Supervisor::Supervisor(const std::vector<Process> &processes,
+                       std::chrono::duration<double> ready_timeout,
+                       int health_port)
+: processes_(processes)
+, ready_timeout_(ready_timeout)
+, running_(processes.size())
+, watchdog_(processes, health_port)
+{
+    // Nothing
+}
+
+bool Supervisor::run()
+{
+    for (size_t i = 0; i < processes_.size() && !quit; i++)
+        start(i);
+
+    // Children are waited for without blocking while nodes are watched
+    const bool watching = watchdog_.enabled();
+
+    bool interrupted = false;
+    while (running() > 0) {
+
+        if (quit && !interrupted) {
+            interrupt();
+            interrupted = true;
+        }
+
+        int status;
+        const pid_t pid = ::waitpid(-1, &status, watching ? WNOHANG : 0);
+        if (pid == 0) {
+            watch();
+            continue;
+        }
+
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        auto r = std::find_if(running_.begin(), running_.end(),
+                              [pid](const Running &x) { return x.pid == pid; });
+        if (r == running_.end())
+            continue;
+
+        const size_t i = r - running_.begin();
+        r->pid = -1;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            continue;
+
+        const auto why = WIFSIGNALED(status)
+            ? "was killed by signal " + std::to_string(WTERMSIG(status))
+            : "exited with status " + std::to_string(WEXITSTATUS(status));
+
+        if (quit) {
+            r->failed = WIFEXITED(status);
+            continue;
+        }
+
+        std::cerr << oat::whoWarn("run", processes_[i].name + " " + why + ".\n");
+
+        if (!restart(i))
+            running_[i].failed = true;
+    }
+
+    return std::none_of(running_.begin(), running_.end(),
+                        [](const Running &x) { return x.failed; });
+}
+
+void Supervisor::start(size_t i)
+{
+    const auto &proc = processes_[i];
+
+    // Readers of each node this process writes attach first
+    if (!proc.readers.empty()) {
+
+        oat::Registry registry;
+        const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  ready_timeout_);
+
+        for (const auto &r : proc.readers)
+            if (!oat::awaitNode(registry, r.first, r.second, false, deadline, quit)
+                && !quit)
+                std::cerr << oat::whoWarn("run", "Starting " + proc.name
+                                          + " before all readers of '"
+                                          + r.first + "' have attached.\n");
+    }
+
+    if (quit)
+        return;
+
+    const pid_t pid = ::fork();
+    if (pid < 0)
+        throw std::runtime_error("Could not start " + proc.name + ": "
+                                 + std::strerror(errno));
+
+    if (pid == 0) {
+
+        if (!proc.cpus.empty()) {
+            ThreadPolicy policy;
+            policy.cpus = proc.cpus;
+            policy.apply(proc.name);
+        }
+
+        preferNode(proc.numa_node, proc.name);
+
+        std::vector<char *> argv;
+        for (const auto &a : proc.argv)
+            argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+
+        ::execvp(argv[0], argv.data());
+
+        std::cerr << oat::whoError("run", "Could not start " + proc.argv[0]
+                                   + ": " + std::strerror(errno) + "\n");
+        ::_exit(127);
+    }
+
+    running_[i].pid = pid;
+    std::cout << oat::whoMessage("run", "Started " + proc.name + " (pid "
+                                 + std::to_string(pid) + ").\n");
+}
+
+void Supervisor::stop(size_t i)
+{
+    auto &r = running_[i];
+    if (r.pid < 0)
+        return;
+
+    ::kill(r.pid, SIGINT);
+
+    int status;
+    const auto deadline = std::chrono::steady_clock::now() + STOP_TIMEOUT;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (::waitpid(r.pid, &status, WNOHANG) == r.pid) {
+            r.pid = -1;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::cerr << oat::whoWarn("run", "Killing " + processes_[i].name + ".\n");
+    ::kill(r.pid, SIGKILL);
+    ::waitpid(r.pid, &status, 0);
+    r.pid = -1;
+}
+
+void Supervisor::interrupt()
+{
+    for (const auto &r : running_)
+        if (r.pid > 0)
+            ::kill(r.pid, SIGINT);
+}
+
+bool Supervisor::restart(size_t i)
+{
+    auto &r = running_[i];
+    const auto &proc = processes_[i];
+    if (!proc.restart || r.restarts >= proc.max_restarts)
+        return false;
+
+    // Everything downstream has seen the end of this process's streams
+    std::set<size_t> subgraph {i};
+    std::vector<size_t> todo {i};
+    while (!todo.empty()) {
+        const auto p = todo.back();
+        todo.pop_back();
+        for (auto q : processes_[p].downstream)
+            if (subgraph.insert(q).second)
+                todo.push_back(q);
+    }
+
+    for (auto p : subgraph)
+        stop(p);
+
+    nap(std::min(MAX_BACKOFF, FIRST_BACKOFF * (1 << std::min(r.restarts, 5))));
+    r.restarts++;
+
+    std::cout << oat::whoMessage("run", "Restarting " + proc.name + " ("
+                                 + std::to_string(r.restarts) + " of "
+                                 + std::to_string(proc.max_restarts) + ").\n");
+
+    // Set iteration follows the start order
+    for (auto p : subgraph)
+        start(p);
+
+    return true;
+}
+
+size_t Supervisor::running() const
+{
+    return std::count_if(running_.begin(), running_.end(),
+                         [](const Running &x) { return x.pid > 0; });
+}
+
+void Supervisor::watch()
+{
+    std::vector<Watchdog::Status> status(running_.size());
+    for (size_t i = 0; i < running_.size(); i++) {
+        status[i].pid = running_[i].pid;
+        status[i].restarts = running_[i].restarts;
+    }
+
+    for (auto i : watchdog_.poll(status, WATCH_PERIOD)) {
+
+        // Already started again along with an upstream process
+        if (quit || running_[i].pid != status[i].pid)
+            continue;
+
+        std::cerr << oat::whoWarn("run", processes_[i].name + " has stalled.\n");
+
+        if (!restart(i))
+            std::cerr << oat::whoWarn("run", "Leaving " + processes_[i].name
+                                      + " running: it may not be restarted "
+                                        "again.\n");
+    }
+}
+
+} /* namespace oat */
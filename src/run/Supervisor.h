@@ -0,0 +1,81 @@
+//******************************************************************************
+//* File:   Supervisor.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_SUPERVISOR_H
+#define	OAT_SUPERVISOR_H
+
+#include <chrono>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "Graph.h"
+#include "Watchdog.h"
+
+namespace oat {
+
+/**
+ * @brief Starts the processes of a graph and watches over them until they
+ * have all exited. A process that fails and may be restarted is started again
+ * together with every process downstream of it, since those have seen the
+ * end of its streams. So is one that the Watchdog finds stalled.
+ */
+class Supervisor {
+
+public:
+    /**
+     * @param processes Processes in the order they should be started.
+     * @param ready_timeout Longest wait for the readers of a process to
+     * attach before it is started anyway.
+     * @param health_port TCP port to serve health metrics on, or 0 for none.
+     */
+    Supervisor(const std::vector<Process> &processes,
+               std::chrono::duration<double> ready_timeout,
+               int health_port = 0);
+
+    /**
+     * @brief Start every process and wait for all of them to exit. CTRL+C
+     * is passed on to processes that are still running.
+     * @return True if every process finally exited cleanly.
+     */
+    bool run(void);
+
+private:
+    struct Running {
+        pid_t pid {-1};
+        int restarts {0};
+        bool failed {false};
+    };
+
+    const std::vector<Process> &processes_;
+    const std::chrono::duration<double> ready_timeout_;
+    std::vector<Running> running_;
+    Watchdog watchdog_;
+
+    void start(size_t i);
+    void stop(size_t i);
+    void interrupt(void);
+    bool restart(size_t i);
+    size_t running(void) const;
+    void watch(void);
+};
+
+}      /* namespace oat */
+#endif /* OAT_SUPERVISOR_H */
@@ -0,0 +1,442 @@
+//******************************************************************************
+//* File:   Watchdog.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Watchdog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace oat {
+
+// Time between samples of the nodes
+static constexpr std::chrono::seconds SAMPLE_PERIOD {1};
+
+// Longest wait for a health request, or to send its response
+static constexpr int REQUEST_TIMEOUT_US {200000};
+
+// Prometheus label value
+static std::string label(const std::string &s)
+{
+    std::string q {"\""};
+    for (auto c : s) {
+        if (c == '"' || c == '\\')
+            q += '\\';
+        q += c;
+    }
+
+    return q + "\"";
+}
+
+static void family(std::ostream &out,
+                   const std::string &name,
+                   const std::string &type,
+                   const std::string &help)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n";
+}
+
+bool Watchdog::Watched::attach()
+{
+    try {
+        segment.reset(new oat::Segment());
+        node = segment->observe(name + "_node");
+    } catch (const std::exception &) {
+        node = nullptr;
+    }
+
+    if (node == nullptr)
+        return false;
+
+    const auto now = Clock::now();
+    writes = rate_writes = node->write_number();
+    changed = rate_time = now;
+    rate_hz = 0;
+
+    return true;
+}
+
+bool Watchdog::Watched::ended() const
+{
+    return node->sink_state() == oat::NodeState::END;
+}
+
+Watchdog::Watchdog(const std::vector<Process> &processes, int health_port)
+: processes_(processes)
+, inputs_(processes.size())
+, outputs_(processes.size())
+, status_(processes.size())
+, started_(processes.size(), Clock::now())
+, stalled_(processes.size(), false)
+, sampled_(Clock::now() - SAMPLE_PERIOD)
+{
+    std::map<std::string, size_t> index;
+    auto watch = [this, &index](const std::string &name) {
+        auto n = index.find(name);
+        if (n != index.end())
+            return n->second;
+        nodes_.emplace_back();
+        nodes_.back().name = name;
+        nodes_.back().writer = processes_.size();
+        return index[name] = nodes_.size() - 1;
+    };
+
+    for (size_t p = 0; p < processes.size(); p++) {
+        for (const auto &w : processes[p].writes) {
+            const auto n = watch(w);
+            nodes_[n].writer = p;
+            outputs_[p].push_back(n);
+        }
+        for (const auto &r : processes[p].reads)
+            inputs_[p].push_back(watch(r));
+    }
+
+    if (health_port <= 0)
+        return;
+
+    // Children must not inherit the socket, or it would outlive oat-run
+    listener_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener_ < 0)
+        throw std::runtime_error(std::string("Could not open health socket: ")
+                                 + std::strerror(errno));
+
+    const int one = 1;
+    ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(health_port));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (::bind(listener_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || ::listen(listener_, 8) != 0) {
+        const std::string why = std::strerror(errno);
+        ::close(listener_);
+        throw std::runtime_error("Could not serve health on port "
+                                 + std::to_string(health_port) + ": " + why);
+    }
+}
+
+Watchdog::~Watchdog()
+{
+    if (listener_ >= 0)
+        ::close(listener_);
+}
+
+bool Watchdog::enabled() const
+{
+    if (listener_ >= 0)
+        return true;
+
+    for (const auto &p : processes_)
+        if (p.stall_timeout > 0)
+            return true;
+
+    return false;
+}
+
+std::vector<size_t> Watchdog::poll(const std::vector<Status> &status,
+                                   std::chrono::milliseconds timeout)
+{
+    std::vector<size_t> stalled;
+    if (Clock::now() - sampled_ >= SAMPLE_PERIOD)
+        sample(status, stalled);
+
+    // Without a listener this is just a nap that CTRL+C ends early
+    pollfd p {listener_, POLLIN, 0};
+    const nfds_t n = listener_ >= 0 ? 1 : 0;
+    if (::poll(n ? &p : nullptr, n, static_cast<int>(timeout.count())) > 0
+        && (p.revents & POLLIN)) {
+
+        const int fd = ::accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            serve(fd);
+            ::close(fd);
+        }
+    }
+
+    return stalled;
+}
+
+void Watchdog::sample(const std::vector<Status> &status,
+                      std::vector<size_t> &stalled)
+{
+    const auto now = Clock::now();
+    sampled_ = now;
+
+    // A process that was started again has bound new nodes. The ones
+    // observed so far are no longer written.
+    for (size_t i = 0; i < status.size() && i < status_.size(); i++) {
+        if (status[i].pid == status_[i].pid)
+            continue;
+        started_[i] = now;
+        for (auto o : outputs_[i]) {
+            nodes_[o].node = nullptr;
+            nodes_[o].segment.reset();
+        }
+    }
+    status_ = status;
+
+    for (auto &w : nodes_) {
+
+        if (w.node == nullptr && !w.attach())
+            continue;
+
+        const auto writes = w.node->write_number();
+        if (writes != w.writes) {
+            w.writes = writes;
+            w.changed = now;
+        }
+
+        const std::chrono::duration<double> dt = now - w.rate_time;
+        if (dt.count() > 0)
+            w.rate_hz = (writes - w.rate_writes) / dt.count();
+        w.rate_writes = writes;
+        w.rate_time = now;
+    }
+
+    for (size_t i = 0; i < processes_.size(); i++) {
+        const bool s = isStalled(i, now);
+        if (s && !stalled_[i])
+            stalled.push_back(i);
+        stalled_[i] = s;
+    }
+}
+
+bool Watchdog::isStalled(size_t i, Clock::time_point now) const
+{
+    const auto &proc = processes_[i];
+    const pid_t pid = status_[i].pid;
+    if (proc.stall_timeout <= 0 || pid <= 0)
+        return false;
+
+    const auto timeout = std::chrono::duration<double>(proc.stall_timeout);
+    if (now - started_[i] <= timeout)
+        return false;
+
+    // Waiting for its readers, which are to blame if anyone is
+    for (auto o : outputs_[i]) {
+        const auto &w = nodes_[o];
+        if (w.node && !w.ended() && !w.node->writable())
+            return false;
+    }
+
+    if (!inputs_[i].empty()) {
+
+        bool pending = false;
+        for (auto n : inputs_[i]) {
+
+            // Waiting for an upstream process to start or to exit
+            const auto &w = nodes_[n];
+            if (!w.node || w.ended())
+                return false;
+
+            if (now - w.changed <= timeout)
+                continue;
+
+            // An idle input that has been read is starved
+            if (!holds(w, pid))
+                return false;
+
+            pending = true;
+        }
+
+        return pending;
+    }
+
+    // A process without inputs has stopped producing
+    if (outputs_[i].empty())
+        return false;
+
+    for (auto o : outputs_[i]) {
+        const auto &w = nodes_[o];
+        if (!w.node || w.ended() || now - w.changed <= timeout)
+            return false;
+    }
+
+    return true;
+}
+
+bool Watchdog::holds(const Watched &w, pid_t pid) const
+{
+    // Slots may be released while they are being looked at
+    try {
+        for (size_t s = 0; s < w.node->max_sources(); s++)
+            if (w.node->slot_bound(s) && !w.node->best_effort(s)
+                && w.node->owner(s).pid == pid && w.node->readable(s))
+                return true;
+    } catch (const std::runtime_error &) {
+        // Treated as not held
+    }
+
+    return false;
+}
+
+void Watchdog::serve(int fd) const
+{
+    // A slow or silent client must not hold up supervision
+    timeval tv {0, REQUEST_TIMEOUT_US};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    char buf[1024];
+    const auto n = ::recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+        return;
+
+    // Request line, e.g. "GET /metrics HTTP/1.1"
+    std::istringstream request {std::string(buf, static_cast<size_t>(n))};
+    std::string method, path;
+    request >> method >> path;
+    path = path.substr(0, path.find('?'));
+
+    std::string code {"200 OK"}, type {"text/plain; charset=utf-8"}, body;
+    if (method != "GET") {
+        code = "405 Method Not Allowed";
+    } else if (path == "/metrics") {
+        type = "text/plain; version=0.0.4; charset=utf-8";
+        body = metrics();
+    } else if (path == "/health") {
+        body = health();
+        if (body != "ok\n")
+            code = "503 Service Unavailable";
+    } else {
+        code = "404 Not Found";
+        body = "Try /metrics or /health.\n";
+    }
+
+    const auto response = "HTTP/1.0 " + code + "\r\n"
+                          + "Content-Type: " + type + "\r\n"
+                          + "Content-Length: " + std::to_string(body.size())
+                          + "\r\nConnection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const auto k = ::send(fd, response.data() + sent,
+                              response.size() - sent, MSG_NOSIGNAL);
+        if (k <= 0)
+            return;
+        sent += static_cast<size_t>(k);
+    }
+}
+
+std::string Watchdog::metrics() const
+{
+    std::ostringstream out;
+    const auto now = Clock::now();
+
+    family(out, "oat_process_up", "gauge", "1 if the process is running.");
+    for (size_t i = 0; i < processes_.size(); i++)
+        out << "oat_process_up{process=" << label(processes_[i].name) << "} "
+            << (status_[i].pid > 0 ? 1 : 0) << "\n";
+
+    family(out, "oat_process_restarts_total", "counter",
+           "Times the process was restarted.");
+    for (size_t i = 0; i < processes_.size(); i++)
+        out << "oat_process_restarts_total{process="
+            << label(processes_[i].name) << "} " << status_[i].restarts << "\n";
+
+    family(out, "oat_process_stalled", "gauge",
+           "1 if the process was found stalled at the last sample.");
+    for (size_t i = 0; i < processes_.size(); i++)
+        out << "oat_process_stalled{process=" << label(processes_[i].name)
+            << "} " << (stalled_[i] ? 1 : 0) << "\n";
+
+    family(out, "oat_node_writes_total", "counter",
+           "Samples written to the node.");
+    for (const auto &w : nodes_)
+        if (w.node)
+            out << "oat_node_writes_total{node=" << label(w.name) << "} "
+                << w.node->write_number() << "\n";
+
+    family(out, "oat_node_write_rate_hz", "gauge",
+           "Samples written per second over the last sampling period.");
+    for (const auto &w : nodes_)
+        if (w.node)
+            out << "oat_node_write_rate_hz{node=" << label(w.name) << "} "
+                << w.rate_hz << "\n";
+
+    family(out, "oat_node_idle_seconds", "gauge",
+           "Seconds since the node was last seen written.");
+    for (const auto &w : nodes_)
+        if (w.node)
+            out << "oat_node_idle_seconds{node=" << label(w.name) << "} "
+                << std::chrono::duration<double>(now - w.changed).count()
+                << "\n";
+
+    family(out, "oat_node_sources", "gauge", "SOURCEs attached to the node.");
+    for (const auto &w : nodes_)
+        if (w.node)
+            out << "oat_node_sources{node=" << label(w.name) << "} "
+                << w.node->source_ref_count() << "\n";
+
+    // Slots may be released while they are being looked at, in which case
+    // the rest of the node's slots are left out of this scrape
+    family(out, "oat_node_queue_depth", "gauge",
+           "Samples written but not yet read by a SYNC SOURCE.");
+    for (const auto &w : nodes_) {
+        if (!w.node)
+            continue;
+        try {
+            for (size_t s = 0; s < w.node->max_sources(); s++)
+                if (w.node->slot_bound(s) && !w.node->best_effort(s))
+                    out << "oat_node_queue_depth{node=" << label(w.name)
+                        << ",slot=\"" << s << "\"} "
+                        << w.node->write_number() - w.node->read_number(s)
+                        << "\n";
+        } catch (const std::runtime_error &) {
+            // Skipped
+        }
+    }
+
+    family(out, "oat_node_dropped_total", "counter",
+           "Samples skipped by a latest-value SOURCE.");
+    for (const auto &w : nodes_) {
+        if (!w.node)
+            continue;
+        for (size_t s = 0; s < w.node->max_sources(); s++)
+            if (w.node->best_effort(s))
+                out << "oat_node_dropped_total{node=" << label(w.name)
+                    << ",slot=\"" << s << "\"} " << w.node->dropped(s) << "\n";
+    }
+
+    return out.str();
+}
+
+std::string Watchdog::health() const
+{
+    std::string stalled;
+    for (size_t i = 0; i < processes_.size(); i++)
+        if (stalled_[i])
+            stalled += " " + processes_[i].name;
+
+    return stalled.empty() ? "ok\n" : "stalled:" + stalled + "\n";
+}
+
+} /* namespace oat */
@@ -0,0 +1,127 @@
+//******************************************************************************
+//* File:   Watchdog.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_WATCHDOG_H
+#define	OAT_WATCHDOG_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "../../lib/shmemdf/Node.h"
+#include "../../lib/shmemdf/Segment.h"
+
+#include "Graph.h"
+
+namespace oat {
+
+/**
+ * @brief Watches the nodes of a running graph, read-only as oat-top does, to
+ * find processes that have stalled and to report the health of the network
+ * over HTTP.
+ *
+ * A process has stalled when it has left a sample unread on one of its
+ * inputs for longer than its stall timeout while none of its other inputs is
+ * starved and none of its outputs is held up downstream. A process without
+ * inputs has stalled when none of its outputs has been written for that long
+ * although every reader has caught up.
+ */
+class Watchdog {
+
+public:
+    //! State of a process, as known to the Supervisor
+    struct Status {
+        pid_t pid {-1}; //!< -1 if not running
+        int restarts {0};
+    };
+
+    /**
+     * @param processes Processes being supervised.
+     * @param health_port TCP port to serve /metrics and /health on, or 0
+     * for none.
+     */
+    Watchdog(const std::vector<Process> &processes, int health_port);
+    ~Watchdog();
+
+    Watchdog(const Watchdog &) = delete;
+    Watchdog &operator=(const Watchdog &) = delete;
+
+    /**
+     * @brief True if some process has a stall timeout or health is served.
+     * Otherwise poll() need not be called.
+     */
+    bool enabled(void) const;
+
+    /**
+     * @brief Sample the nodes if a sampling period has passed since the last
+     * time, and answer health requests for up to timeout.
+     * @param status State of each process, in the order of processes.
+     * @param timeout Time to wait for requests.
+     * @return Processes that have newly stalled, as indices into processes.
+     */
+    std::vector<size_t> poll(const std::vector<Status> &status,
+                             std::chrono::milliseconds timeout);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A node being observed
+    struct Watched {
+        std::string name;
+        std::unique_ptr<oat::Segment> segment;
+        const oat::Node *node {nullptr};
+        size_t writer;   // Process writing the node, or processes.size()
+
+        uint64_t writes {0};    // At the last change
+        Clock::time_point changed; // Time of the last change
+        double rate_hz {0};     // Writes per second over the last period
+        uint64_t rate_writes {0};
+        Clock::time_point rate_time;
+
+        bool attach(void);
+        bool ended(void) const;
+    };
+
+    const std::vector<Process> &processes_;
+    std::vector<Watched> nodes_;
+    std::vector<std::vector<size_t>> inputs_;  // Per process, into nodes_
+    std::vector<std::vector<size_t>> outputs_; // Per process, into nodes_
+
+    std::vector<Status> status_;
+    std::vector<Clock::time_point> started_;
+    std::vector<bool> stalled_;
+    Clock::time_point sampled_;
+
+    int listener_ {-1};
+
+    void sample(const std::vector<Status> &status,
+                std::vector<size_t> &stalled);
+    bool isStalled(size_t i, Clock::time_point now) const;
+    bool holds(const Watched &w, pid_t pid) const;
+    void serve(int fd) const;
+    std::string metrics(void) const;
+    std::string health(void) const;
+};
+
+}      /* namespace oat */
+#endif /* OAT_WATCHDOG_H */
@@ -0,0 +1,234 @@
+//******************************************************************************
+//* File:   oat run main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+
+#include "Graph.h"
+#include "Supervisor.h"
+
+namespace po = boost::program_options;
+
+volatile sig_atomic_t quit = 0;
+
+void sigHandler(int) { quit = 1; }
+
+void printUsage(po::options_description options) {
+    std::cout << "Usage: run [INFO]\n"
+              << "   or: run FILE [CONFIGURATION]\n"
+              << "Start the processing network described by the graph FILE "
+                 "and supervise it\nuntil every component has exited. "
+                 "Components are started readers first, so\nthat no sample "
+                 "is missed, and are placed on CPUs so that neighbours in the"
+                 "\nnetwork share a NUMA node.\n\n"
+              << "FILE:\n"
+              << "  A TOML file with a [[component]] entry per component:\n\n"
+              << "    [[component]]\n"
+              << "    name = \"mog\"            # Defaults to COMPONENT and "
+                 "an index\n"
+              << "    component = \"framefilt\" # Oat subcommand\n"
+              << "    type = \"mog\"            # TYPE, if the component has "
+                 "one\n"
+              << "    source = \"raw\"          # SOURCE(s), string or array\n"
+              << "    sink = \"bac\"            # SINK(s), string or array\n"
+              << "    reads = []              # Nodes read through options\n"
+              << "    writes = []             # Nodes written through "
+                 "options\n"
+              << "    config = \"mog-config\"   # Configuration table in FILE\n"
+              << "    args = []               # Further arguments\n"
+              << "    cpus = [2]              # CPUs, instead of automatic "
+                 "placement\n"
+              << "    numa-node = 0           # NUMA node to place on\n"
+              << "    transport = \"shmem\"     # Keep in a process of its "
+                 "own\n"
+              << "    restart = \"on-failure\"  # Or \"never\", the default\n"
+              << "    max-restarts = 3        # Restarts before giving up\n"
+              << "    stall-timeout = 30      # Seconds stalled before a "
+                 "restart, 0 for never\n\n"
+              << "  Adjacent frame filters, position detectors and position "
+                 "filters with one\n  SOURCE, one SINK and no further "
+                 "arguments share an oat-pipeline process,\n  passing "
+                 "samples through in-process channels. An optional [run] "
+                 "table\n  takes 'transport' (\"in-process\" or \"shmem\"), "
+                 "'placement' (\"auto\" or\n  \"none\") and defaults for "
+                 "'restart', 'max-restarts' and 'stall-timeout'.\n  "
+                 "'deterministic = true' replays recordings in their own "
+                 "time, with\n  results that do not depend on timing.\n\n"
+              << options << "\n";
+}
+
+int main(int argc, char *argv[]) {
+
+    std::string file;
+    double ready_timeout_sec = 10;
+    int health_port = 0;
+    bool dry_run = false;
+
+    try {
+
+        po::options_description options("INFO");
+        options.add_options()
+            ("help", "Produce help message.")
+            ("version,v", "Print version information.")
+            ;
+
+        po::options_description config("CONFIGURATION");
+        config.add_options()
+            ("dry-run,n",
+             "Print the processes that would be started, with their "
+             "arguments and placement, and exit.")
+            ("ready-timeout", po::value<double>(&ready_timeout_sec),
+             "Longest wait, in seconds, for the readers of a component's "
+             "nodes to attach before it is started anyway. Defaults to 10.")
+            ("health-port", po::value<int>(&health_port),
+             "TCP port on which to serve the health of the network over HTTP: "
+             "Prometheus metrics of each process and node at /metrics, and "
+             "'ok' or the stalled processes at /health. Defaults to none.")
+            ;
+
+        po::options_description hidden("HIDDEN OPTIONS");
+        hidden.add_options()
+            ("file", po::value<std::string>(&file),
+            "The graph file.")
+            ;
+
+        po::positional_options_description positional_options;
+        positional_options.add("file", 1);
+
+        po::options_description all_options("ALL");
+        all_options.add(options).add(config).add(hidden);
+
+        po::options_description visible_options("OPTIONS");
+        visible_options.add(options).add(config);
+
+        po::variables_map variable_map;
+        po::store(po::command_line_parser(argc, argv)
+                .options(all_options)
+                .positional(positional_options)
+                .run(),
+                variable_map);
+        po::notify(variable_map);
+
+        if (variable_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (variable_map.count("version")) {
+            std::cout << "Oat Run version "
+                      << Oat_VERSION_MAJOR
+                      << "."
+                      << Oat_VERSION_MINOR
+                      << "\n";
+            std::cout << "Written by Jonathan P. Newman in the MWL@MIT.\n";
+            std::cout << "Licensed under the GPL3.0.\n";
+            return 0;
+        }
+
+        if (!variable_map.count("file")) {
+            printUsage(visible_options);
+            std::cout << "Error: a graph FILE must be specified. Exiting.\n";
+            return -1;
+        }
+
+        if (ready_timeout_sec < 0) {
+            std::cerr << oat::Error("Ready timeout must be non-negative.\n");
+            return -1;
+        }
+
+        if (health_port < 0 || health_port > 65535) {
+            std::cerr << oat::Error("Health port must be between 0 and 65535.\n");
+            return -1;
+        }
+
+        dry_run = variable_map.count("dry-run") > 0;
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    } catch (...) {
+        std::cerr << oat::Error("Exception of unknown type.\n");
+        return -1;
+    }
+
+    // Without SA_RESTART, so that CTRL+C interrupts waiting for children
+    struct sigaction action {};
+    action.sa_handler = sigHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    try {
+
+        oat::Graph graph(file);
+
+        // Inherited by every process started
+        if (graph.deterministic())
+            ::setenv("OAT_DETERMINISTIC", "1", 1);
+
+        if (dry_run) {
+            if (graph.deterministic())
+                std::cout << "Deterministic replay.\n";
+            for (const auto &p : graph.processes()) {
+                std::cout << p.name << "\n ";
+                for (const auto &a : p.argv)
+                    std::cout << " " << a;
+                std::cout << "\n";
+                if (!p.cpus.empty()) {
+                    std::cout << "  cpus:";
+                    for (auto c : p.cpus)
+                        std::cout << " " << c;
+                    if (p.numa_node >= 0)
+                        std::cout << " (NUMA node " << p.numa_node << ")";
+                    std::cout << "\n";
+                }
+                for (const auto &r : p.readers)
+                    std::cout << "  awaits: " << r.first << ":" << r.second << "\n";
+                if (p.restart)
+                    std::cout << "  restarts: " << p.max_restarts << "\n";
+                if (p.stall_timeout > 0)
+                    std::cout << "  stall timeout: " << p.stall_timeout << " s\n";
+            }
+            return 0;
+        }
+
+        oat::Supervisor supervisor(graph.processes(),
+                                   std::chrono::duration<double>(ready_timeout_sec),
+                                   health_port);
+        if (!supervisor.run())
+            return 1;
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    }
+
+    // Exit
+    return 0;
+}
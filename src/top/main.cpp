@@ -0,0 +1,458 @@
+//******************************************************************************
+//* File:   oat top main.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "OatConfig.h" // Generated by CMake
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/program_options.hpp>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "../../lib/shmemdf/Node.h"
+#include "../../lib/shmemdf/Segment.h"
+#include "../../lib/shmemdf/Telemetry.h"
+#include "../../lib/utility/IOFormat.h"
+
+namespace po = boost::program_options;
+namespace bip = boost::interprocess;
+
+volatile sig_atomic_t quit = 0;
+
+void sigHandler(int) { quit = 1; }
+
+void printUsage(po::options_description options) {
+    std::cout << "Usage: top [INFO]\n"
+              << "   or: top NAMES [CONFIGURATION]\n"
+              << "Show live throughput and latency of the nodes specified by NAMES.\n"
+              << "Nodes are observed read-only and need not exist yet.\n\n"
+              << options << "\n";
+}
+
+// Transport loss totals of a node's SINK
+struct Transport {
+
+    uint64_t dropped {0}, corrupt {0}, requested {0}, received {0};
+
+    static Transport read(const oat::TransportTelemetry &t)
+    {
+        Transport x;
+        x.dropped = t.dropped.load(std::memory_order_relaxed);
+        x.corrupt = t.corrupt.load(std::memory_order_relaxed);
+        x.requested = t.resends_requested.load(std::memory_order_relaxed);
+        x.received = t.resends_received.load(std::memory_order_relaxed);
+        return x;
+    }
+
+    bool any() const { return dropped || corrupt || requested || received; }
+
+    // A SINK that restarts resets its totals
+    static uint64_t since(const uint64_t now, const uint64_t then)
+    {
+        return now >= then ? now - then : now;
+    }
+
+    Transport since(const Transport &then) const
+    {
+        Transport d;
+        d.dropped = since(dropped, then.dropped);
+        d.corrupt = since(corrupt, then.corrupt);
+        d.requested = since(requested, then.requested);
+        d.received = since(received, then.received);
+        return d;
+    }
+};
+
+// A node being observed and the counts it had at the previous refresh
+struct Watched {
+
+    std::string name;
+    std::unique_ptr<oat::Segment> segment;
+    const oat::Node *node {nullptr};
+
+    uint64_t writes {0};
+    oat::LatencyHistogram::Snapshot wait {}, interval {};
+    std::vector<oat::LatencyHistogram::Snapshot> holds;
+    std::vector<uint64_t> drops;
+    Transport transport;
+
+    bool attach()
+    {
+        try {
+            segment.reset(new oat::Segment());
+            node = segment->observe(name + "_node");
+        } catch (const bip::interprocess_exception &) {
+            node = nullptr;
+        }
+
+        if (node == nullptr)
+            return false;
+
+        writes = node->write_number();
+        wait = node->sink_telemetry().wait.snapshot();
+        interval = node->sink_telemetry().write_interval.snapshot();
+        transport = Transport::read(node->sink_telemetry().transport);
+        holds.resize(node->max_sources());
+        drops.resize(node->max_sources());
+        for (size_t i = 0; i < holds.size(); i++) {
+            holds[i] = node->read_hold(i).snapshot();
+            drops[i] = node->dropped(i);
+        }
+
+        return true;
+    }
+};
+
+static double ms(const uint64_t ns) { return ns / 1e6; }
+
+// Counts accumulated by a node over one refresh period
+struct Delta {
+
+    uint64_t writes {0};
+    oat::LatencyHistogram::Snapshot wait {}, interval {};
+    std::vector<oat::LatencyHistogram::Snapshot> holds;
+    std::vector<uint64_t> drops;
+    size_t slowest {0};
+    Transport transport;
+    bool has_transport {false};
+};
+
+static Delta measure(Watched &w)
+{
+    using H = oat::LatencyHistogram;
+
+    Delta d;
+    const auto &t = w.node->sink_telemetry();
+
+    auto writes = w.node->write_number();
+    auto wait = t.wait.snapshot();
+    auto interval = t.write_interval.snapshot();
+    d.writes = writes - w.writes;
+    d.wait = H::difference(wait, w.wait);
+    d.interval = H::difference(interval, w.interval);
+
+    // The slowest reader is the one holding the sink up. Best-effort readers
+    // never do.
+    d.slowest = w.holds.size();
+    uint64_t slowest_p99 = 0;
+    d.holds.resize(w.holds.size());
+    d.drops.resize(w.holds.size());
+    for (size_t i = 0; i < w.holds.size(); i++) {
+        auto hold = w.node->read_hold(i).snapshot();
+        d.holds[i] = H::difference(hold, w.holds[i]);
+        w.holds[i] = hold;
+
+        // Slots are reused, and their drop counts reset, by later sources
+        auto drops = w.node->dropped(i);
+        d.drops[i] = drops >= w.drops[i] ? drops - w.drops[i] : drops;
+        w.drops[i] = drops;
+
+        auto p99 = H::quantile(d.holds[i], 0.99);
+        if (w.node->slot_bound(i) && !w.node->best_effort(i) &&
+            H::count(d.holds[i]) > 0 && p99 >= slowest_p99) {
+            d.slowest = i;
+            slowest_p99 = p99;
+        }
+    }
+
+    // Only producers that count transport losses set them
+    auto transport = Transport::read(t.transport);
+    d.transport = transport.since(w.transport);
+    d.has_transport = transport.any();
+
+    w.writes = writes;
+    w.wait = wait;
+    w.interval = interval;
+    w.transport = transport;
+
+    return d;
+}
+
+static void report(Watched &w, const double period_sec)
+{
+    using H = oat::LatencyHistogram;
+
+    if (w.node == nullptr && !w.attach()) {
+        std::printf("%-16s (not found)\n", w.name.c_str());
+        return;
+    }
+
+    const auto d = measure(w);
+
+    std::printf("%-16s %8.1f fps   sink wait %7.3f/%7.3f ms   "
+                "interval %7.3f/%7.3f ms\n",
+                w.name.c_str(),
+                d.writes / period_sec,
+                ms(H::quantile(d.wait, 0.5)), ms(H::quantile(d.wait, 0.99)),
+                ms(H::quantile(d.interval, 0.5)), ms(H::quantile(d.interval, 0.99)));
+
+    if (d.has_transport)
+        std::printf("  transport      %8.1f drop/s  %8.1f corrupt/s  "
+                    "resend %8.1f/%8.1f pkt/s\n",
+                    d.transport.dropped / period_sec,
+                    d.transport.corrupt / period_sec,
+                    d.transport.requested / period_sec,
+                    d.transport.received / period_sec);
+
+    for (size_t i = 0; i < d.holds.size(); i++) {
+        if (!w.node->slot_bound(i))
+            continue;
+
+        std::printf("  source %-7zu %8.1f rd/s  hold %7.3f/%7.3f ms",
+                    i,
+                    H::count(d.holds[i]) / period_sec,
+                    ms(H::quantile(d.holds[i], 0.5)),
+                    ms(H::quantile(d.holds[i], 0.99)));
+
+        if (w.node->best_effort(i))
+            std::printf("   best effort, %8.1f drop/s\n", d.drops[i] / period_sec);
+        else
+            std::printf("%s\n", i == d.slowest ? "   <- bottleneck" : "");
+    }
+}
+
+template <typename Writer>
+static void writeBins(Writer &writer,
+                      const char *key,
+                      const oat::LatencyHistogram::Snapshot &s)
+{
+    writer.String(key);
+    writer.StartArray();
+    for (auto c : s)
+        writer.Uint64(c);
+    writer.EndArray();
+}
+
+/**
+ * Report a node as a JSON object holding its counts over the period,
+ * including the raw histogram bins, which can be summed across periods by
+ * tools that compute their own quantiles. Bin i counts durations in
+ * [2^(i-1), 2^i) ns.
+ */
+template <typename Writer>
+static void reportJSON(Watched &w, Writer &writer)
+{
+    using H = oat::LatencyHistogram;
+
+    writer.StartObject();
+    writer.String("name");
+    writer.String(w.name.c_str());
+
+    const bool found = w.node != nullptr || w.attach();
+    writer.String("found");
+    writer.Bool(found);
+
+    if (found) {
+
+        const auto d = measure(w);
+
+        writer.String("sink_state");
+        writer.Int(static_cast<int>(w.node->sink_state()));
+        writer.String("writes");
+        writer.Uint64(d.writes);
+        writeBins(writer, "wait", d.wait);
+        writeBins(writer, "interval", d.interval);
+
+        if (d.has_transport) {
+            writer.String("transport");
+            writer.StartObject();
+            writer.String("dropped");
+            writer.Uint64(d.transport.dropped);
+            writer.String("corrupt");
+            writer.Uint64(d.transport.corrupt);
+            writer.String("resends_requested");
+            writer.Uint64(d.transport.requested);
+            writer.String("resends_received");
+            writer.Uint64(d.transport.received);
+            writer.EndObject();
+        }
+
+        writer.String("sources");
+        writer.StartArray();
+        for (size_t i = 0; i < d.holds.size(); i++) {
+            if (!w.node->slot_bound(i))
+                continue;
+
+            writer.StartObject();
+            writer.String("slot");
+            writer.Uint64(i);
+            writer.String("reads");
+            writer.Uint64(H::count(d.holds[i]));
+            writer.String("best_effort");
+            writer.Bool(w.node->best_effort(i));
+            writer.String("dropped");
+            writer.Uint64(d.drops[i]);
+            writeBins(writer, "hold", d.holds[i]);
+            writer.EndObject();
+        }
+        writer.EndArray();
+    }
+
+    writer.EndObject();
+}
+
+int main(int argc, char *argv[]) {
+
+    std::vector<std::string> names;
+    double period_sec = 1.0;
+    bool json = false;
+    int count = 0;
+
+    try {
+
+        po::options_description options("INFO");
+        options.add_options()
+            ("help", "Produce help message.")
+            ("version,v", "Print version information.")
+            ;
+
+        po::options_description config("CONFIGURATION");
+        config.add_options()
+            ("period,p", po::value<double>(&period_sec),
+             "Refresh period in seconds. Latencies are p50/p99 over each "
+             "period. Defaults to 1.")
+            ("json,j",
+             "Print one line of JSON per refresh instead of a table. For each "
+             "node, it holds the sink state, write count, the bound sources "
+             "with their read and drop counts, the raw histogram bins of "
+             "each latency and, for sinks fed over a link that counts its "
+             "losses, such as a GigE camera's, a transport object.")
+            ("count,n", po::value<int>(&count),
+             "Exit after this many refreshes. Defaults to 0, which refreshes "
+             "until interrupted.")
+            ;
+
+        po::options_description hidden("HIDDEN OPTIONS");
+        hidden.add_options()
+            ("names", po::value< std::vector<std::string> >(),
+            "The names of the nodes to observe.")
+            ;
+
+        po::positional_options_description positional_options;
+        positional_options.add("names", -1);
+
+        po::options_description all_options("ALL");
+        all_options.add(options).add(config).add(hidden);
+
+        po::options_description visible_options("OPTIONS");
+        visible_options.add(options).add(config);
+
+        po::variables_map variable_map;
+        po::store(po::command_line_parser(argc, argv)
+                .options(all_options)
+                .positional(positional_options)
+                .run(),
+                variable_map);
+        po::notify(variable_map);
+
+        if (variable_map.count("help")) {
+            printUsage(visible_options);
+            return 0;
+        }
+
+        if (variable_map.count("version")) {
+            std::cout << "Oat Top version "
+                      << Oat_VERSION_MAJOR
+                      << "."
+                      << Oat_VERSION_MINOR
+                      << "\n";
+            std::cout << "Written by Jonathan P. Newman in the MWL@MIT.\n";
+            std::cout << "Licensed under the GPL3.0.\n";
+            return 0;
+        }
+
+        if (!variable_map.count("names")) {
+            printUsage(visible_options);
+            std::cout << "Error: at least a single NAME must be specified. Exiting.\n";
+            return -1;
+        }
+
+        if (period_sec <= 0) {
+            std::cerr << oat::Error("Refresh period must be positive.\n");
+            return -1;
+        }
+
+        if (count < 0) {
+            std::cerr << oat::Error("Refresh count must be non-negative.\n");
+            return -1;
+        }
+
+        json = variable_map.count("json") > 0;
+        names = variable_map["names"].as< std::vector<std::string> >();
+
+    } catch (std::exception& e) {
+        std::cerr << oat::Error(e.what()) << "\n";
+        return -1;
+    } catch (...) {
+        std::cerr << oat::Error("Exception of unknown type.\n");
+        return -1;
+    }
+
+    std::signal(SIGINT, sigHandler);
+
+    std::vector<Watched> watched(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        watched[i].name = names[i];
+        watched[i].attach();
+    }
+
+    const auto period = std::chrono::duration<double>(period_sec);
+    for (int n = 0; !quit && (count == 0 || n < count); n++) {
+
+        std::this_thread::sleep_for(period);
+        if (quit)
+            break;
+
+        if (json) {
+
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            writer.String("time_ns");
+            writer.Uint64(oat::telemetryNow());
+            writer.String("period_sec");
+            writer.Double(period_sec);
+            writer.String("nodes");
+            writer.StartArray();
+            for (auto &w : watched)
+                reportJSON(w, writer);
+            writer.EndArray();
+            writer.EndObject();
+            std::printf("%s\n", buffer.GetString());
+
+        } else {
+
+            std::printf("\n");
+            for (auto &w : watched)
+                report(w, period_sec);
+        }
+
+        std::fflush(stdout);
+    }
+
+    // Exit
+    return 0;
+}
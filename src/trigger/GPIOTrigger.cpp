@@ -0,0 +1,118 @@
+//******************************************************************************
+//* File:   GPIOTrigger.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "GPIOTrigger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+GPIOTrigger::GPIOTrigger(const std::string &position_source_address)
+: Trigger(position_source_address)
+{
+    // Nothing
+}
+
+GPIOTrigger::~GPIOTrigger()
+{
+    if (line_fd_ >= 0) {
+        release();
+        close(line_fd_);
+    }
+}
+
+po::options_description GPIOTrigger::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("chip,c", po::value<std::string>(),
+         "GPIO character device. Defaults to /dev/gpiochip0.")
+        ("line,l", po::value<int>(),
+         "Offset of the output line on the GPIO chip, as listed by gpioinfo. "
+         "For instance, 17.")
+        ;
+    local_opts.add(predicateOptions());
+
+    return local_opts;
+}
+
+void GPIOTrigger::applyConfiguration(const po::variables_map &vm,
+                                     const config::OptionTable &config_table)
+{
+    configurePredicate(vm, config_table);
+
+    // Chip
+    std::string chip {"/dev/gpiochip0"};
+    oat::config::getValue<std::string>(vm, config_table, "chip", chip);
+
+    // Line
+    int line;
+    oat::config::getNumericValue<int>(
+        vm, config_table, "line", line, 0, 1023, true);
+
+    const int chip_fd = open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0)
+        throw std::runtime_error("Could not open " + chip + ": "
+                                 + std::strerror(errno));
+
+    // Request the line as an output, already at its inactive level
+    gpiohandle_request req;
+    std::memset(&req, 0, sizeof(req));
+    req.lineoffsets[0] = static_cast<uint32_t>(line);
+    req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    req.default_values[0] = inactive_level();
+    req.lines = 1;
+    std::strncpy(req.consumer_label, "oat-trigger", sizeof(req.consumer_label) - 1);
+
+    const int rc = ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+    const int err = errno;
+    close(chip_fd);
+
+    if (rc < 0)
+        throw std::runtime_error("Could not request line "
+                                 + std::to_string(line) + " of " + chip + ": "
+                                 + std::strerror(err));
+
+    line_fd_ = req.fd;
+}
+
+void GPIOTrigger::setLevel(const bool level)
+{
+    gpiohandle_data data;
+    std::memset(&data, 0, sizeof(data));
+    data.values[0] = level;
+
+    if (ioctl(line_fd_, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+        throw std::runtime_error(std::string("Could not set GPIO line: ")
+                                 + std::strerror(errno));
+}
+
+} /* namespace oat */
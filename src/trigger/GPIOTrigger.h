@@ -0,0 +1,53 @@
+//******************************************************************************
+//* File:   GPIOTrigger.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_GPIOTRIGGER_H
+#define	OAT_GPIOTRIGGER_H
+
+#include <string>
+
+#include "Trigger.h"
+
+namespace oat {
+
+class GPIOTrigger : public Trigger {
+
+public:
+    /**
+     * @brief Drives a GPIO line through the Linux GPIO character device.
+     * @param position_source_address Position source to read from.
+     */
+    explicit GPIOTrigger(const std::string &position_source_address);
+    ~GPIOTrigger() override;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    void setLevel(const bool level) override;
+
+    // Line handle, from GPIO_GET_LINEHANDLE_IOCTL
+    int line_fd_ {-1};
+};
+
+}      /* namespace oat */
+#endif /* OAT_GPIOTRIGGER_H */
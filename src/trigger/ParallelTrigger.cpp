@@ -0,0 +1,118 @@
+//******************************************************************************
+//* File:   ParallelTrigger.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "ParallelTrigger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/parport.h>
+#include <linux/ppdev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+ParallelTrigger::ParallelTrigger(const std::string &position_source_address)
+: Trigger(position_source_address)
+{
+    // Nothing
+}
+
+ParallelTrigger::~ParallelTrigger()
+{
+    if (port_fd_ >= 0) {
+        release();
+        ioctl(port_fd_, PPRELEASE);
+        close(port_fd_);
+    }
+}
+
+po::options_description ParallelTrigger::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("device,d", po::value<std::string>(),
+         "Parallel port device. Defaults to /dev/parport0.")
+        ("pins", po::value<std::string>(),
+         "Array of data pins to drive, numbered 0 to 7 for D0 to D7, e.g. "
+         "[0, 1]. Pins that are not listed are held low. Defaults to [0].")
+        ;
+    local_opts.add(predicateOptions());
+
+    return local_opts;
+}
+
+void ParallelTrigger::applyConfiguration(
+    const po::variables_map &vm, const config::OptionTable &config_table)
+{
+    configurePredicate(vm, config_table);
+
+    // Device
+    std::string device {"/dev/parport0"};
+    oat::config::getValue<std::string>(vm, config_table, "device", device);
+
+    // Pins
+    std::vector<int> pins;
+    if (oat::config::getArray<int>(vm, config_table, "pins", pins)) {
+        pins_ = 0;
+        for (auto p : pins) {
+            if (p < 0 || p > 7)
+                throw std::runtime_error("Parallel port data pins are "
+                                         "numbered 0 to 7.");
+            pins_ |= static_cast<uint8_t>(1 << p);
+        }
+    }
+
+    port_fd_ = open(device.c_str(), O_RDWR | O_CLOEXEC);
+    if (port_fd_ < 0)
+        throw std::runtime_error("Could not open " + device + ": "
+                                 + std::strerror(errno));
+
+    if (ioctl(port_fd_, PPCLAIM) < 0) {
+        const int err = errno;
+        close(port_fd_);
+        port_fd_ = -1;
+        throw std::runtime_error("Could not claim " + device + ": "
+                                 + std::strerror(err));
+    }
+
+    int mode = IEEE1284_MODE_COMPAT;
+    ioctl(port_fd_, PPSETMODE, &mode);
+
+    setLevel(inactive_level());
+}
+
+void ParallelTrigger::setLevel(const bool level)
+{
+    unsigned char data = level ? pins_ : 0;
+    if (ioctl(port_fd_, PPWDATA, &data) < 0)
+        throw std::runtime_error(std::string("Could not write parallel "
+                                             "port: ") + std::strerror(errno));
+}
+
+} /* namespace oat */
@@ -0,0 +1,57 @@
+//******************************************************************************
+//* File:   ParallelTrigger.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_PARALLELTRIGGER_H
+#define	OAT_PARALLELTRIGGER_H
+
+#include <cstdint>
+#include <string>
+
+#include "Trigger.h"
+
+namespace oat {
+
+class ParallelTrigger : public Trigger {
+
+public:
+    /**
+     * @brief Drives data pins of a parallel port through ppdev.
+     * @param position_source_address Position source to read from.
+     */
+    explicit ParallelTrigger(const std::string &position_source_address);
+    ~ParallelTrigger() override;
+
+private:
+    // Configurable Interface
+    po::options_description options() const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    void setLevel(const bool level) override;
+
+    // Claimed port
+    int port_fd_ {-1};
+
+    // Data pins that are driven, as a mask of D0 to D7
+    uint8_t pins_ {0x01};
+};
+
+}      /* namespace oat */
+#endif /* OAT_PARALLELTRIGGER_H */
@@ -0,0 +1,104 @@
+//******************************************************************************
+//* File:   SerialTrigger.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "SerialTrigger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+SerialTrigger::SerialTrigger(const std::string &position_source_address)
+: Trigger(position_source_address)
+, line_(TIOCM_RTS)
+{
+    // Nothing
+}
+
+SerialTrigger::~SerialTrigger()
+{
+    if (tty_fd_ >= 0) {
+        release();
+        close(tty_fd_);
+    }
+}
+
+po::options_description SerialTrigger::options() const
+{
+    // Update CLI options
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("device,d", po::value<std::string>(),
+         "Serial port device. For instance, /dev/ttyUSB0.")
+        ("line,l", po::value<std::string>(),
+         "Modem control line to drive, 'rts' or 'dtr'. The line is asserted "
+         "while the output is active. Defaults to rts.")
+        ;
+    local_opts.add(predicateOptions());
+
+    return local_opts;
+}
+
+void SerialTrigger::applyConfiguration(const po::variables_map &vm,
+                                       const config::OptionTable &config_table)
+{
+    configurePredicate(vm, config_table);
+
+    // Device
+    std::string device;
+    oat::config::getValue<std::string>(vm, config_table, "device", device, true);
+
+    // Line
+    std::string line;
+    if (oat::config::getValue<std::string>(vm, config_table, "line", line)) {
+        if (line == "rts")
+            line_ = TIOCM_RTS;
+        else if (line == "dtr")
+            line_ = TIOCM_DTR;
+        else
+            throw std::runtime_error("Serial line must be 'rts' or 'dtr'.");
+    }
+
+    // Opening a tty can assert both lines, so set the level straight away
+    tty_fd_ = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (tty_fd_ < 0)
+        throw std::runtime_error("Could not open " + device + ": "
+                                 + std::strerror(errno));
+
+    setLevel(inactive_level());
+}
+
+void SerialTrigger::setLevel(const bool level)
+{
+    if (ioctl(tty_fd_, level ? TIOCMBIS : TIOCMBIC, &line_) < 0)
+        throw std::runtime_error(std::string("Could not set serial line: ")
+                                 + std::strerror(errno));
+}
+
+} /* namespace oat */
@@ -0,0 +1,220 @@
+//******************************************************************************
+//* File:   Trigger.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#include "Trigger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/TOMLSanitize.h"
+
+namespace oat {
+
+Trigger::Trigger(const std::string &position_source_address)
+: name_("trigger[" + position_source_address + "->*]")
+, position_source_address_(position_source_address)
+{
+    // Nothing
+}
+
+po::options_description Trigger::predicateOptions() const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("regions,r", po::value<std::string>(),
+         "Array of region labels, e.g. '[\"CN\", \"R0\"]', assigned upstream "
+         "by oat-posifilt region. The output is active while the position is "
+         "in any of them.")
+        ("polygon", po::value<std::string>(),
+         "NOTE: The polygon can only be specified in a config file.\n"
+         "Vertices of a region, as an n-point matrix [[x0, y0],[x1, y1],...,"
+         "[xn, yn]] in the units of the positions. The output is active "
+         "while a valid position is inside. An alternative to regions that "
+         "needs no region filter upstream.")
+        ("invert",
+         "If true, the output is active while the position is outside the "
+         "regions or polygon instead, including while it is invalid.")
+        ("active-low",
+         "If true, the active output is driven low and the inactive output "
+         "high.")
+        ("log", po::value<std::string>(),
+         "File to append a record of every toggle to, as comma separated "
+         "lines of: sample count, sample time in microseconds, capture time "
+         "and toggle time in steady_clock nanoseconds, and the new state "
+         "(1 for active). The toggle is made before the record is written.")
+        ("latest",
+         "If true, read the most recent position instead of every position. "
+         "The upstream component never waits for this output.")
+        ;
+
+    return local_opts;
+}
+
+void Trigger::configurePredicate(const po::variables_map &vm,
+                                 const config::OptionTable &config_table)
+{
+    // Region labels
+    oat::config::getArray(vm, config_table, "regions", regions_);
+    for (const auto &r : regions_)
+        if (r.size() >= oat::Position2D::REGION_LEN)
+            throw std::runtime_error("Region labels are limited to "
+                    + std::to_string(oat::Position2D::REGION_LEN - 1)
+                    + " characters.");
+
+    // Polygon
+    if (vm.count("polygon"))
+        throw std::runtime_error("The polygon can only be specified using a "
+                                 "config file.");
+
+    oat::config::Array polygon;
+    if (oat::config::getArray(config_table, "polygon", polygon)) {
+
+        for (const auto &v : polygon->nested_array()) {
+
+            auto point = v->array_of<double>();
+            if (point.size() != 2)
+                throw std::runtime_error("The polygon must be a nested, Nx2 "
+                                         "TOML array of doubles.");
+
+            polygon_.emplace_back(point[0]->get(), point[1]->get());
+        }
+
+        if (polygon_.size() < 3)
+            throw std::runtime_error("The polygon must have at least 3 "
+                                     "vertices.");
+    }
+
+    if (regions_.empty() == polygon_.empty())
+        throw std::runtime_error("Exactly one of regions or polygon must be "
+                                 "specified.");
+
+    // Polarity
+    oat::config::getValue<bool>(vm, config_table, "invert", invert_);
+    oat::config::getValue<bool>(vm, config_table, "active-low", active_low_);
+
+    // Event log
+    std::string log_path;
+    if (oat::config::getValue<std::string>(vm, config_table, "log", log_path)) {
+        log_.open(log_path, std::ios::app);
+        if (!log_)
+            throw std::runtime_error("Could not open trigger log " + log_path
+                                     + ".");
+    }
+
+    // Source mode
+    oat::config::getValue<bool>(vm, config_table, "latest", latest_);
+}
+
+bool Trigger::connectToNode()
+{
+    // Establish our a slot in the node
+    position_source_.touch(position_source_address_,
+                           latest_ ? SourceMode::LATEST : SourceMode::SYNC);
+
+    // Wait for synchronous start with sink when it binds its node
+    if (position_source_.connect() != SourceState::CONNECTED)
+        return false;
+
+    return true;
+}
+
+int Trigger::process()
+{
+    // START CRITICAL SECTION //
+    ////////////////////////////
+    if (position_source_.wait() == oat::NodeState::END)
+        return 1;
+
+    // Copy the shared position
+    position_source_.copyTo(position_);
+
+    // Tell sink it can continue
+    position_source_.post();
+
+    ////////////////////////////
+    //  END CRITICAL SECTION  //
+
+    const bool active = satisfied(position_) != invert_;
+    if (active != active_)
+        drive(active);
+
+    return 0;
+}
+
+bool Trigger::satisfied(const oat::Position2D &position) const
+{
+    if (!polygon_.empty())
+        return position.position_valid
+               && cv::pointPolygonTest(polygon_,
+                                       cv::Point2f(position.position),
+                                       false) >= 0;
+
+    if (!position.position_valid || !position.region_valid)
+        return false;
+
+    return std::any_of(regions_.begin(), regions_.end(),
+                       [&position](const std::string &r) {
+                           return std::strncmp(r.c_str(),
+                                               position.region,
+                                               sizeof(position.region)) == 0;
+                       });
+}
+
+void Trigger::drive(const bool active)
+{
+    setLevel(active != active_low_);
+    const uint64_t toggle_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    active_ = active;
+    toggles_++;
+
+    if (log_.is_open()) {
+        const auto &s = position_.sample();
+        log_ << s.count() << ','
+             << s.microseconds().count() << ','
+             << s.capture_ns() << ','
+             << toggle_ns << ','
+             << active << '\n';
+    }
+}
+
+void Trigger::release()
+{
+    // Called from destructors
+    try {
+        if (active_) {
+            setLevel(active_low_);
+            active_ = false;
+        }
+    } catch (const std::runtime_error &ex) {
+        std::cerr << oat::Warn(std::string(ex.what()) + "\n");
+    }
+
+    log_.flush();
+}
+
+} /* namespace oat */
@@ -0,0 +1,126 @@
+//******************************************************************************
+//* File:   Trigger.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#ifndef OAT_TRIGGER_H
+#define	OAT_TRIGGER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <opencv2/core/types.hpp>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/Source.h"
+
+namespace po = boost::program_options;
+
+namespace oat {
+
+class Trigger : public Component, public Configurable<false> {
+
+public:
+    /**
+     * @brief An abstract digital output that is driven high while positions
+     * satisfy a region predicate.
+     * @param position_source_address Position source to read from.
+     */
+    explicit Trigger(const std::string &position_source_address);
+    virtual ~Trigger() { }
+
+    // Component Interface
+    oat::ComponentType type(void) const override { return oat::trigger; };
+    std::string name(void) const override { return name_; }
+
+    /**
+     * @brief Number of times the output changed.
+     */
+    uint64_t toggles() const { return toggles_; }
+
+protected:
+    /**
+     * @brief Options shared by every output type.
+     */
+    po::options_description predicateOptions() const;
+
+    /**
+     * @brief Configure the region predicate, polarity and event log from the
+     * options in predicateOptions().
+     */
+    void configurePredicate(const po::variables_map &vm,
+                            const config::OptionTable &config_table);
+
+    /**
+     * @brief Drive the physical output. Called on the processing thread only
+     * when the level changes, so it should do no more than the write itself.
+     * @param level Electrical level, after any inversion for active-low
+     * outputs.
+     */
+    virtual void setLevel(const bool level) = 0;
+
+    /**
+     * @brief Electrical level of the inactive output. Output types drive the
+     * output to it when they open their device, which must be after
+     * configurePredicate().
+     */
+    bool inactive_level() const { return active_low_; }
+
+    /**
+     * @brief Return the output to its inactive level. Output types call this
+     * from their destructors, before closing the device.
+     */
+    void release();
+
+private:
+    // Component Interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Trigger name
+    const std::string name_;
+
+    // The position SOURCE
+    const std::string position_source_address_;
+    oat::Source<oat::Position2D> position_source_;
+    oat::Position2D position_ {"trigger"};
+    bool latest_ {false};
+
+    // Predicate: inside any of the labelled regions, or inside the polygon
+    std::vector<std::string> regions_;
+    std::vector<cv::Point2f> polygon_;
+    bool invert_ {false};
+    bool active_low_ {false};
+
+    // Output state
+    bool active_ {false};
+    uint64_t toggles_ {0};
+
+    // Event record of every toggle
+    std::ofstream log_;
+
+    bool satisfied(const oat::Position2D &position) const;
+    void drive(const bool active);
+};
+
+}      /* namespace oat */
+#endif /* OAT_TRIGGER_H */
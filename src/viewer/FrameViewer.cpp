@@ -19,12 +19,20 @@
 
 #include "FrameViewer.h"
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <boost/filesystem.hpp>
 #include <opencv2/cvconfig.h>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#ifdef OAT_GL_VIEWER
+#include <GL/gl.h>
+#endif
 
+#include "../../lib/datatypes/PackedMask.h"
 #include "../../lib/utility/FileFormat.h"
 #include "../../lib/utility/IOFormat.h"
 #include "../../lib/utility/ProgramOptions.h"
@@ -46,6 +54,11 @@ po::options_description FrameViewer::options(void) const
          "they are ignored. Setting this to a reasonably low value prevents "
          "the viewer from consuming processing resources in order to update "
          "the display faster than is visually perceptible. Defaults to 30.")
+        ("budget", po::value<double>(),
+         "Time, in ms, that drawing a frame should take. When drawing keeps "
+         "taking longer, e.g. because the CPU is saturated, the display rate "
+         "is halved, up to three times, and restored once drawing is well "
+         "within budget again. Defaults to 0, which keeps display-rate.")
         ("min-max,m", po::value<std::string>(),
          "2-element array of floats, [min,max], specifying the requested "
          "dyanmic range of the display. Pixel values below min will be mapped to "
@@ -54,8 +67,33 @@ po::options_description FrameViewer::options(void) const
         ("snapshot-path,f", po::value<std::string>(),
          "The path to which in which snapshots will be saved. "
          "If a folder is designated, the base file name will be SOURCE. "
-         "The time stamp of the snapshot will be prepended to the file name. "
-         "Defaults to the current directory.")
+         "The time stamp of the snapshot will be prepended to the file name "
+         "and its sample number appended. Defaults to the current directory.")
+        ("snapshot-format", po::value<std::string>(),
+         "Image format of snapshots, 'png' or 'jpg'. Defaults to png.")
+        ("snapshot-workers", po::value<size_t>(),
+         "Number of threads that encode and write snapshots, so that the "
+         "display is not held up while they are saved. Defaults to 2.")
+        ("snapshot-queue", po::value<size_t>(),
+         "Maximum number of snapshots waiting to be written. Snapshots "
+         "requested while the queue is full, e.g. during a long burst, are "
+         "dropped with a warning. Defaults to 16.")
+        ("overlay,o", po::value<std::string>(),
+         "Overlay SOURCE, e.g. from oat-decorate with its overlay option, "
+         "composited onto displayed frames. Only the latest overlay is drawn, "
+         "so it may lag its frame by a sample or so. Defaults to none.")
+        ("preview,p", po::value<std::string>(),
+         "ZMQ-style endpoint, e.g. 'tcp://*:5560', on which to publish a "
+         "low-bandwidth preview of the displayed frames, for monitoring from "
+         "another machine. Each message has three parts: the topic, "
+         "'preview' or 'snapshot', the frame sample number as an 8-byte "
+         "unsigned integer, and a JPEG (preview) or full size PNG (snapshot) "
+         "image. Previews are published at the display rate. Defaults to "
+         "none.")
+        ("preview-scale", po::value<double>(),
+         "Resize factor in (0, 1] applied to preview frames. Default is 0.25.")
+        ("preview-quality", po::value<int>(),
+         "JPEG quality of preview frames, 1 to 100. Default is 75.")
         ;
 
     return local_opts;
@@ -71,6 +109,14 @@ void FrameViewer::applyConfiguration(const po::variables_map &vm,
         min_update_period_ms = Milliseconds(static_cast<int>(1000.0 / r));
     }
 
+    // Display rate under load
+    double budget_ms {0.0};
+    oat::config::getNumericValue<double>(
+        vm, config_table, "budget", budget_ms, 0.0);
+    display_governor_.configure(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double, std::milli>(budget_ms)), 3);
+
     // Min/max
     std::vector<double> m;
     if (oat::config::getArray<double, 2>(vm, config_table, "min-max", m, 0)) {
@@ -91,12 +137,103 @@ void FrameViewer::applyConfiguration(const po::variables_map &vm,
         }
 
         min_max_defined_ = true;
+
+#ifdef OAT_GL_VIEWER
+        // The same map, in normalized units, as a clamped scale and bias
+        gl_scale_ = static_cast<float>(255.0 / (max - min));
+        gl_bias_ = static_cast<float>(-min / (max - min));
+#endif
     }
 
     // Snapshot save path
     std::string snapshot_path = "./";
     oat::config::getValue(vm, config_table, "snapshot-path", snapshot_path);
     set_snapshot_path(snapshot_path);
+
+    // Snapshot format
+    if (oat::config::getValue(
+            vm, config_table, "snapshot-format", snapshot_format_)) {
+        if (snapshot_format_ != "png" && snapshot_format_ != "jpg")
+            throw std::runtime_error("snapshot-format must be 'png' or "
+                                     "'jpg'.");
+    }
+
+    // Snapshot workers
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "snapshot-workers", snapshot_workers_, 1, 16);
+    oat::config::getNumericValue<size_t>(
+        vm, config_table, "snapshot-queue", snapshot_queue_, 1, 256);
+
+    // Overlay
+    oat::config::getValue(vm, config_table, "overlay", overlay_address_);
+
+    // Preview stream
+    oat::config::getNumericValue<double>(
+        vm, config_table, "preview-scale", preview_scale_, 0.0, 1.0);
+    if (preview_scale_ == 0.0)
+        throw std::runtime_error("preview-scale must be greater than 0.");
+
+    oat::config::getNumericValue<int>(
+        vm, config_table, "preview-quality", preview_quality_, 1, 100);
+
+    std::string endpoint;
+    if (oat::config::getValue(vm, config_table, "preview", endpoint)) {
+
+        // Slow subscribers drop previews rather than hold up the display
+        preview_.reset(new zmq::socket_t(context_, ZMQ_PUB));
+        const int hwm = 4;
+        preview_->setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
+        preview_->bind(endpoint);
+    }
+}
+
+oat::CommandDescription FrameViewer::commands()
+{
+    const oat::CommandDescription commands{
+        {"snapshot", "Save a snapshot of the displayed frame, and publish it "
+                     "to the preview stream if there is one."}
+    };
+
+    return commands;
+}
+
+void FrameViewer::applyCommand(const std::string &command)
+{
+    // Taken by the display thread
+    if (command == "snapshot")
+        snapshot_requested_ = true;
+}
+
+bool FrameViewer::connectToNode()
+{
+    if (!Viewer<oat::Frame>::connectToNode())
+        return false;
+
+    // Workers are started once the helper thread policy is known
+    snapshot_writer_.reset(new oat::SnapshotWriter(
+        snapshot_workers_, snapshot_queue_, helper_thread_policy_));
+
+    if (overlay_address_.empty())
+        return true;
+
+    // Overlays are only displayed, so they never hold up their sink
+    overlay_source_.touch(overlay_address_, SourceMode::LATEST);
+
+    return overlay_source_.connect() == SourceState::CONNECTED;
+}
+
+void FrameViewer::capture()
+{
+    if (overlay_address_.empty())
+        return;
+
+    // Keep the previous overlay if there is no new one
+    oat::NodeState state;
+    if (overlay_source_.tryWait(state)) {
+        if (state != oat::NodeState::END)
+            overlay_ = overlay_source_.clone();
+        overlay_source_.post();
+    }
 }
 
 void FrameViewer::display(const oat::Frame &frame)
@@ -105,16 +242,18 @@ void FrameViewer::display(const oat::Frame &frame)
     // thread that actually calls imshow(). If done in in the constructor, it
     // will not play nice with OpenGL.
     if (!gui_inititalized_) {
-#ifdef HAVE_OPENGL
+#ifdef OAT_GL_VIEWER
         try {
-            cv::namedWindow(name_, cv::WINDOW_OPENGL & cv::WINDOW_KEEPRATIO);
+            cv::namedWindow(name_, cv::WINDOW_OPENGL | cv::WINDOW_KEEPRATIO);
+            cv::setOpenGlDrawCallback(name_, &FrameViewer::draw, this);
+            gl_ = true;
         } catch (cv::Exception& ex) {
             oat::whoWarn(name_, "OpenCV not compiled with OpenGL support. "
                     "Falling back to OpenCV's display driver.\n");
-            cv::namedWindow(name_, cv::WINDOW_NORMAL & cv::WINDOW_KEEPRATIO);
+            cv::namedWindow(name_, cv::WINDOW_NORMAL | cv::WINDOW_KEEPRATIO);
         }
 #else
-        cv::namedWindow(name_, cv::WINDOW_NORMAL & cv::WINDOW_KEEPRATIO);
+        cv::namedWindow(name_, cv::WINDOW_NORMAL | cv::WINDOW_KEEPRATIO);
 #endif
         gui_inititalized_ = true;
     }
@@ -122,31 +261,158 @@ void FrameViewer::display(const oat::Frame &frame)
     if (frame.rows == 0 || frame.cols == 0)
         return;
 
-    if (min_max_defined_)
-        cv::LUT(frame, lut_, frame);
+    // Shallow copy, so that the frame can be drawn on. Bayer frames are
+    // demosaiced, 12-bit GREY16 frames scaled to 8 bits, and MASK frames
+    // unpacked here, on the display thread.
+    cv::Mat canvas = frame;
+    if (oat::is_bayer(frame.color())) {
+        cv::cvtColor(frame,
+                     demosaic_frame_,
+                     oat::color_conv_code(frame.color(), PIX_BGR));
+        canvas = demosaic_frame_;
+    } else if (frame.color() == PIX_GREY16) {
+        frame.convertTo(demosaic_frame_, CV_8U, 1.0 / 16);
+        canvas = demosaic_frame_;
+    } else if (frame.color() == PIX_MASK) {
+        oat::unpackMask(frame, demosaic_frame_);
+        canvas = demosaic_frame_;
+    }
+
+#ifdef OAT_GL_VIEWER
+    if (gl_) {
+
+        // Overlays are drawn before the upload, so they are scaled by min-max
+        // along with the frame
+        if (!overlay_address_.empty())
+            renderer_.render(overlay_, canvas);
+
+        upload(canvas);
+        cv::updateWindow(name_);
+
+    } else
+#endif
+    {
+        if (min_max_defined_)
+            cv::LUT(canvas, lut_, canvas);
+
+        // Drawn last, so that overlay colors are not remapped
+        if (!overlay_address_.empty())
+            renderer_.render(overlay_, canvas);
+
+        cv::imshow(name_, canvas);
+    }
 
-    cv::imshow(name_, frame);
     char command = cv::waitKey(1);
+    const bool snapshot = command == 's' || snapshot_requested_.exchange(false);
 
-    if (command == 's') {
+#ifdef OAT_GL_VIEWER
+    // min-max was only applied on the GPU
+    if (gl_ && min_max_defined_ && (snapshot || preview_))
+        cv::LUT(canvas, lut_, canvas);
+#endif
 
-        // Generate current snapshot save path
-        std::string fid;
-        std::string timestamp = oat::createTimeStamp();
+    // Encoded here, on the display thread, so the observed pipeline is never
+    // held up
+    if (preview_) {
 
-        int err = oat::createSavePath(fid,
-                snapshot_folder_,
-                snapshot_base_file_ + ".png",
-                timestamp + "_",
-                true);
+        if (preview_scale_ < 1.0)
+            cv::resize(canvas,
+                       preview_frame_,
+                       cv::Size(),
+                       preview_scale_,
+                       preview_scale_,
+                       cv::INTER_AREA);
+        else
+            preview_frame_ = canvas;
 
-        if (!err) {
-            cv::imwrite(fid, frame);
-            std::cout << "Snapshot saved to " << fid << "\n";
-        } else {
-            std::cerr << oat::Error("Snapshot file creation exited "
-                    "with error " + std::to_string(err) + "\n");
-        }
+        cv::imencode(".jpg",
+                     preview_frame_,
+                     preview_buffer_,
+                     {cv::IMWRITE_JPEG_QUALITY, preview_quality_});
+        publish("preview", frame.sample_count(), preview_buffer_);
+    }
+
+    if (snapshot)
+        saveSnapshot(frame, canvas);
+
+    // Snapshots encoded by the workers since the last frame
+    if (preview_) {
+        uint64_t count;
+        while (snapshot_writer_->nextEncoded(count, snapshot_buffer_))
+            publish("snapshot", count, snapshot_buffer_);
+    }
+}
+
+void FrameViewer::publish(const char *topic,
+                          uint64_t count,
+                          const std::vector<unsigned char> &image)
+{
+    preview_->send(topic, std::strlen(topic), ZMQ_SNDMORE);
+    preview_->send(&count, sizeof(count), ZMQ_SNDMORE);
+    preview_->send(image.data(), image.size());
+}
+
+#ifdef OAT_GL_VIEWER
+void FrameViewer::upload(const cv::Mat &frame)
+{
+    cv::setOpenGlContext(name_);
+
+    // Pixels are staged in a buffer the GPU did not read from last time, so
+    // the copy does not wait for the previous texture update
+    cv::ogl::Buffer &pbo = pbo_[pbo_index_];
+    pbo_index_ ^= 1;
+    pbo.copyFrom(frame, cv::ogl::Buffer::PIXEL_UNPACK_BUFFER, true);
+
+    if (min_max_defined_) {
+        glPixelTransferf(GL_RED_SCALE, gl_scale_);
+        glPixelTransferf(GL_GREEN_SCALE, gl_scale_);
+        glPixelTransferf(GL_BLUE_SCALE, gl_scale_);
+        glPixelTransferf(GL_DEPTH_SCALE, gl_scale_);
+        glPixelTransferf(GL_RED_BIAS, gl_bias_);
+        glPixelTransferf(GL_GREEN_BIAS, gl_bias_);
+        glPixelTransferf(GL_BLUE_BIAS, gl_bias_);
+        glPixelTransferf(GL_DEPTH_BIAS, gl_bias_);
+    }
+
+    // Color conversion happens on the GPU during the transfer
+    texture_.copyFrom(pbo, true);
+}
+
+void FrameViewer::draw(void *viewer)
+{
+    // The texture is stretched over the window and filtered by the GPU
+    const auto *v = static_cast<FrameViewer *>(viewer);
+    if (!v->texture_.empty())
+        cv::ogl::render(v->texture_);
+}
+#endif
+
+void FrameViewer::saveSnapshot(const oat::Frame &frame, const cv::Mat &canvas)
+{
+    // Generate current snapshot save path. Millisecond time stamps and the
+    // sample number keep the names of snapshots taken in a burst distinct.
+    std::string fid;
+    std::string timestamp = oat::createTimeStamp(true);
+
+    int err = oat::createSavePath(fid,
+            snapshot_folder_,
+            snapshot_base_file_ + "_" + std::to_string(frame.sample_count())
+                + "." + snapshot_format_,
+            timestamp + "_",
+            true);
+
+    if (!err) {
+        // Saved by the workers, which also encode the displayed image for
+        // the preview stream
+        if (!snapshot_writer_->submit(
+                fid, frame, preview_ ? canvas : cv::Mat(), frame.sample_count()))
+            std::cerr << oat::Warn("Snapshot queue is full. Snapshot of "
+                                   "sample "
+                                   + std::to_string(frame.sample_count())
+                                   + " dropped.\n");
+    } else {
+        std::cerr << oat::Error("Snapshot file creation exited "
+                "with error " + std::to_string(err) + "\n");
     }
 }
 
@@ -20,12 +20,26 @@
 #ifndef OAT_FRAMEVIEWER_H
 #define OAT_FRAMEVIEWER_H
 
+#include "OatConfig.h" // Generated by CMake
 #include "Viewer.h"
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <opencv2/cvconfig.h>
+#include <zmq.hpp>
+#if defined(USE_OPENGL) && defined(HAVE_OPENGL)
+#include <opencv2/core/opengl.hpp>
+#define OAT_GL_VIEWER
+#endif
+
 #include "../../lib/datatypes/Frame.h"
+#include "../../lib/datatypes/Overlay.h"
+#include "../../lib/utility/OverlayRenderer.h"
+
+#include "SnapshotWriter.h"
 
 namespace oat {
 
@@ -42,19 +56,65 @@ private:
     void applyConfiguration(const po::variables_map &vm,
                             const config::OptionTable &config_table) override;
 
+    // Implement ControllableComponent interface
+    oat::CommandDescription commands(void) override;
+    void applyCommand(const std::string &command) override;
+
     // Viewer Interface
+    bool connectToNode(void) override;
     void display(const oat::Frame &frame) override;
+    void capture(void) override;
 
     // Viewer params
     bool gui_inititalized_ {false};
     cv::Matx<unsigned char, 256, 1> lut_;
     bool min_max_defined_ {false};
+    cv::Mat demosaic_frame_;
+
+    // Optional overlay SOURCE composited onto displayed frames
+    std::string overlay_address_;
+    oat::Source<oat::Overlay> overlay_source_;
+    oat::Overlay overlay_;
+    oat::OverlayRenderer renderer_;
+
+#ifdef OAT_GL_VIEWER
+    // Frames are streamed through alternating pixel buffers into a texture
+    // that is scaled to the window by the GPU. min-max is applied as a
+    // scale and bias during the upload.
+    bool gl_ {false};
+    cv::ogl::Buffer pbo_[2];
+    size_t pbo_index_ {0};
+    cv::ogl::Texture2D texture_;
+    float gl_scale_ {1.0f}, gl_bias_ {0.0f};
+    void upload(const cv::Mat &frame);
+    static void draw(void *viewer);
+#endif
 
     // Used to request a snapshot of the current image which is saved to disk
+    // by a pool of workers
     std::string snapshot_folder_;
     std::string snapshot_base_file_;
+    std::string snapshot_format_ {"png"};
+    size_t snapshot_workers_ {2};
+    size_t snapshot_queue_ {16};
+    std::unique_ptr<oat::SnapshotWriter> snapshot_writer_;
     void set_snapshot_path(const std::string &snapshot_path);
-    void saveSnapshot(void);
+    void saveSnapshot(const oat::Frame &frame, const cv::Mat &canvas);
+    std::atomic<bool> snapshot_requested_ {false};
+
+    // Optional remote preview stream. Downscaled JPEGs of displayed frames,
+    // and PNG snapshots encoded by the snapshot workers, are published on the
+    // display thread.
+    zmq::context_t context_ {1};
+    std::unique_ptr<zmq::socket_t> preview_;
+    double preview_scale_ {0.25};
+    int preview_quality_ {75};
+    cv::Mat preview_frame_;
+    std::vector<unsigned char> preview_buffer_;
+    std::vector<unsigned char> snapshot_buffer_;
+    void publish(const char *topic,
+                 uint64_t count,
+                 const std::vector<unsigned char> &image);
 };
 
 }      /* namespace oat */
@@ -0,0 +1,152 @@
+//******************************************************************************
+//* File:   SnapshotWriter.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#include "SnapshotWriter.h"
+
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+
+namespace oat {
+
+SnapshotWriter::SnapshotWriter(size_t workers,
+                               size_t depth,
+                               const oat::ThreadPolicy &policy)
+: jobs_(depth)
+{
+    for (size_t i = depth; i > 0; i--)
+        free_.push_back(i - 1);
+
+    for (size_t i = 0; i < workers; i++) {
+        threads_.emplace_back([this] { run(); });
+        policy.apply(threads_.back(), "snapshot");
+    }
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+
+    for (auto &t : threads_)
+        t.join();
+
+    if (dropped_ > 0)
+        std::cerr << oat::Warn(std::to_string(dropped_)
+                               + " snapshot(s) were dropped because the "
+                                 "snapshot queue was full.\n");
+}
+
+bool SnapshotWriter::submit(const std::string &path,
+                            const cv::Mat &frame,
+                            const cv::Mat &canvas,
+                            uint64_t count)
+{
+    size_t i;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (free_.empty()) {
+            dropped_++;
+            return false;
+        }
+        i = free_.back();
+        free_.pop_back();
+    }
+
+    // The job is ours until queued. Copies reuse the buffers of the last
+    // snapshot of the same size.
+    auto &job = jobs_[i];
+    job.path = path;
+    job.count = count;
+    job.encode = !canvas.empty();
+    frame.copyTo(job.frame);
+    if (job.encode)
+        canvas.copyTo(job.canvas);
+
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        queued_.push_back(i);
+    }
+    cv_.notify_one();
+
+    return true;
+}
+
+bool SnapshotWriter::nextEncoded(uint64_t &count, std::vector<unsigned char> &png)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (encoded_.empty())
+        return false;
+
+    const size_t i = encoded_.front();
+    encoded_.pop_front();
+
+    // Swapped so that the job keeps a buffer to encode into next time
+    count = jobs_[i].count;
+    png.swap(jobs_[i].png);
+    free_.push_back(i);
+
+    return true;
+}
+
+void SnapshotWriter::run()
+{
+    while (true) {
+
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cv_.wait(lk, [this] { return !running_ || !queued_.empty(); });
+            if (queued_.empty())
+                return;
+            i = queued_.front();
+            queued_.pop_front();
+        }
+
+        auto &job = jobs_[i];
+        try {
+            if (cv::imwrite(job.path, job.frame))
+                std::cout << "Snapshot saved to " + job.path + "\n";
+            else
+                std::cerr << oat::Error("Snapshot could not be written to "
+                                        + job.path + "\n");
+
+            if (job.encode)
+                cv::imencode(".png", job.canvas, job.png);
+
+        } catch (const cv::Exception &ex) {
+            std::cerr << oat::Error("Snapshot " + job.path + ": "
+                                    + ex.what() + "\n");
+            job.encode = false;
+        }
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (job.encode)
+            encoded_.push_back(i);
+        else
+            free_.push_back(i);
+    }
+}
+
+} /* namespace oat */
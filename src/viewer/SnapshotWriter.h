@@ -0,0 +1,127 @@
+//******************************************************************************
+//* File:   SnapshotWriter.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//****************************************************************************
+
+#ifndef OAT_SNAPSHOTWRITER_H
+#define OAT_SNAPSHOTWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "../../lib/base/ThreadPolicy.h"
+
+namespace oat {
+
+/**
+ * @brief Saves snapshots to disk on a small pool of worker threads so that
+ * encoding never holds up the display. Snapshots are copied into one of a
+ * fixed number of pooled buffers, which keep their allocation between
+ * snapshots. When every buffer is in use, further snapshots are dropped and
+ * counted rather than queued without bound.
+ *
+ * Workers can also encode a PNG of the displayed image for publication. These
+ * are handed back with nextEncoded() so that they are sent from the thread
+ * that owns the publishing socket.
+ */
+class SnapshotWriter {
+public:
+
+    /**
+     * @param workers Number of worker threads
+     * @param depth Number of pooled buffers, i.e. the number of snapshots
+     * that may be pending at once
+     * @param policy CPU placement and scheduling of the worker threads
+     */
+    SnapshotWriter(size_t workers,
+                   size_t depth,
+                   const oat::ThreadPolicy &policy = oat::ThreadPolicy());
+
+    /**
+     * @brief Finishes writing pending snapshots before returning.
+     */
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    /**
+     * @brief Queue a snapshot. Never blocks.
+     * @param path File to write. Its extension selects the format.
+     * @param frame Image to write
+     * @param canvas Displayed image to encode as PNG for nextEncoded(), or
+     * empty for none
+     * @param count Sample number of the snapshot
+     * @return False if no buffer was free and the snapshot was dropped
+     */
+    bool submit(const std::string &path,
+                const cv::Mat &frame,
+                const cv::Mat &canvas,
+                uint64_t count);
+
+    /**
+     * @brief Take the next PNG encoded from a submitted canvas. Never blocks.
+     * @param count Sample number of the snapshot
+     * @param png Encoded image. Its previous contents are discarded.
+     * @return False if no encoded image is ready
+     */
+    bool nextEncoded(uint64_t &count, std::vector<unsigned char> &png);
+
+    /**
+     * @brief Number of snapshots dropped because every buffer was in use.
+     */
+    uint64_t dropped() const { return dropped_; }
+
+private:
+
+    struct Job {
+        std::string path;
+        cv::Mat frame;
+        cv::Mat canvas;
+        bool encode {false};
+        uint64_t count {0};
+        std::vector<unsigned char> png;
+    };
+
+    // Buffer pool and the indices of free, queued and encoded jobs
+    std::vector<Job> jobs_;
+    std::vector<size_t> free_;
+    std::deque<size_t> queued_;
+    std::deque<size_t> encoded_;
+    uint64_t dropped_ {0};
+
+    bool running_ {true};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> threads_;
+
+    /**
+     * @brief Worker thread: writes and encodes queued jobs until stopped and
+     * the queue is empty.
+     */
+    void run(void);
+};
+
+}      /* namespace oat */
+#endif /* OAT_SNAPSHOTWRITER_H */
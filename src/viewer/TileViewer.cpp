@@ -0,0 +1,217 @@
+//******************************************************************************
+//* File:   TileViewer.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#include "TileViewer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/utility/IOFormat.h"
+#include "../../lib/utility/ProgramOptions.h"
+#include "../../lib/utility/TOMLSanitize.h"
+#include "../../lib/utility/make_unique.h"
+
+namespace oat {
+
+TileViewer::TileViewer(const std::string &source_address)
+: name_("viewer[" + source_address + "...]")
+{
+    tiles_.resize(1);
+    tiles_[0].address = source_address;
+}
+
+po::options_description TileViewer::options(void) const
+{
+    po::options_description local_opts;
+    local_opts.add_options()
+        ("tiles,t", po::value<std::vector<std::string>>()->multitoken(),
+         "Names of frame SOURCEs shown after SOURCE, in order, each as a "
+         "tile of the same window.")
+        ("columns,c", po::value<int>(),
+         "Number of tiles per row. Defaults to the square root of the number "
+         "of sources, rounded up.")
+        ("tile-width,w", po::value<int>(),
+         "Width, in pixels, of each tile. Tile height follows the aspect "
+         "ratio of SOURCE, and other sources are fitted inside. Defaults to "
+         "320.")
+        ("display-rate,r", po::value<double>(),
+         "Rate, in Hz, at which the window is redrawn with the latest frame "
+         "from each source. Sources are never waited for, so frames supplied "
+         "faster than this rate are ignored. Defaults to 30.")
+        ;
+
+    return local_opts;
+}
+
+void TileViewer::applyConfiguration(const po::variables_map &vm,
+                                    const config::OptionTable &config_table)
+{
+    // Additional sources
+    // NOTE: not settable via configuration file
+    if (vm.count("tiles")) {
+        for (const auto &addr : vm["tiles"].as<std::vector<std::string>>()) {
+            Tile t;
+            t.address = addr;
+            tiles_.push_back(std::move(t));
+        }
+    }
+
+    for (auto &t : tiles_)
+        t.source = oat::make_unique<oat::Source<oat::Frame>>();
+
+    oat::config::getNumericValue<int>(vm, config_table, "columns", columns_, 1);
+    if (columns_ == 0)
+        columns_ = std::ceil(std::sqrt(static_cast<double>(tiles_.size())));
+
+    oat::config::getNumericValue<int>(
+        vm, config_table, "tile-width", tile_width_, 16);
+
+    double r;
+    if (oat::config::getNumericValue<double>(
+            vm, config_table, "display-rate", r, 0.001)) {
+        period_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / r));
+    }
+}
+
+bool TileViewer::connectToNode()
+{
+    // Viewers drop frames anyway, so watch the nodes without making their
+    // sinks wait for us
+    for (auto &t : tiles_)
+        t.source->touch(t.address, SourceMode::LATEST);
+
+    for (auto &t : tiles_) {
+        if (t.source->connect() != SourceState::CONNECTED)
+            return false;
+
+        const auto p = t.source->parameters();
+        if (CV_MAT_DEPTH(p.type) != CV_8U
+            || (CV_MAT_CN(p.type) != 1 && CV_MAT_CN(p.type) != 3))
+            throw std::runtime_error("Tiled viewer requires 8-bit, 1 or 3 "
+                                     "channel frames from " + t.address + ".");
+    }
+
+    // All tiles have the aspect ratio of the first source
+    const auto first = tiles_[0].source->parameters();
+    const int tile_height = std::max(
+        1, static_cast<int>(std::lround(tile_width_ * first.rows
+                                        / static_cast<double>(first.cols))));
+
+    const int n = static_cast<int>(tiles_.size());
+    const int rows = (n + columns_ - 1) / columns_;
+    const int cols = std::min(columns_, n);
+    mosaic_ = cv::Mat::zeros(rows * tile_height, cols * tile_width_, CV_8UC3);
+
+    // Fit each source inside its tile, centered
+    for (int i = 0; i < n; i++) {
+
+        const auto p = tiles_[i].source->parameters();
+        const double s = std::min(tile_width_ / static_cast<double>(p.cols),
+                                  tile_height / static_cast<double>(p.rows));
+        const int w = std::max(1, static_cast<int>(std::lround(p.cols * s)));
+        const int h = std::max(1, static_cast<int>(std::lround(p.rows * s)));
+
+        tiles_[i].roi = cv::Rect((i % columns_) * tile_width_ + (tile_width_ - w) / 2,
+                                 (i / columns_) * tile_height + (tile_height - h) / 2,
+                                 w,
+                                 h);
+    }
+
+    next_update_ = Clock::now();
+
+    return true;
+}
+
+int TileViewer::process()
+{
+    // Fixed UI rate, whatever the sources are doing
+    std::this_thread::sleep_until(next_update_);
+    next_update_ = std::max(next_update_ + period_, Clock::now());
+
+    size_t ended = 0;
+    for (auto &t : tiles_) {
+
+        if (t.ended) {
+            ended++;
+            continue;
+        }
+
+        // START CRITICAL SECTION //
+        ////////////////////////////
+        oat::NodeState state;
+        if (!t.source->tryWait(state))
+            continue;
+
+        if (state == oat::NodeState::END) {
+            t.ended = true;
+            ended++;
+        } else {
+            t.source->copyTo(t.latest);
+        }
+
+        t.source->post();
+        ////////////////////////////
+        //  END CRITICAL SECTION  //
+
+        if (!t.ended)
+            drawTile(t);
+    }
+
+    if (ended == tiles_.size())
+        return 1;
+
+    // NOTE: Done on the processing thread, which is also the one that
+    // created the window
+    if (!gui_inititalized_) {
+        cv::namedWindow(name_, cv::WINDOW_NORMAL | cv::WINDOW_KEEPRATIO);
+        gui_inititalized_ = true;
+    }
+
+    cv::imshow(name_, mosaic_);
+    cv::waitKey(1);
+
+    return 0;
+}
+
+void TileViewer::drawTile(Tile &t)
+{
+    // Downscale straight into the mosaic, converting only the small result
+    cv::Mat dst = mosaic_(t.roi);
+    if (t.latest.channels() == 3) {
+        cv::resize(t.latest, dst, t.roi.size(), 0, 0, cv::INTER_AREA);
+    } else {
+        cv::resize(t.latest, scratch_, t.roi.size(), 0, 0, cv::INTER_AREA);
+        cv::cvtColor(scratch_, dst, cv::COLOR_GRAY2BGR);
+    }
+
+    cv::putText(dst,
+                t.address,
+                cv::Point(5, 15),
+                cv::FONT_HERSHEY_PLAIN,
+                1.0,
+                cv::Scalar(255, 255, 255));
+}
+
+} /* namespace oat */
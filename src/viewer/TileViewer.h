@@ -0,0 +1,93 @@
+//******************************************************************************
+//* File:   TileViewer.h
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//*****************************************************************************
+
+#ifndef OAT_TILEVIEWER_H
+#define OAT_TILEVIEWER_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "../../lib/base/Component.h"
+#include "../../lib/base/Configurable.h"
+#include "../../lib/datatypes/Frame.h"
+#include "../../lib/shmemdf/Source.h"
+
+namespace po = boost::program_options;
+
+namespace oat {
+
+class TileViewer : public Component, public Configurable<false> {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+    /**
+     * @brief View many frame streams, as downscaled tiles of a single window.
+     * Sources are watched in LATEST mode, so no sink ever waits for the
+     * viewer, and the window is redrawn at a fixed rate no matter how many
+     * sources there are or how fast they run.
+     * @param source_address Address of the first SOURCE
+     */
+    explicit TileViewer(const std::string &source_address);
+
+    // Implement Component interface
+    oat::ComponentType type(void) const override { return oat::viewer; };
+    std::string name(void) const override { return name_; }
+
+private:
+    // Implement Component interface
+    bool connectToNode(void) override;
+    int process(void) override;
+
+    // Implement Configurable Interface
+    po::options_description options(void) const override;
+    void applyConfiguration(const po::variables_map &vm,
+                            const config::OptionTable &config_table) override;
+
+    // Viewer name
+    std::string name_;
+
+    // Sources, one per tile
+    struct Tile {
+        std::string address;
+        std::unique_ptr<oat::Source<oat::Frame>> source;
+        oat::Frame latest;
+        cv::Rect roi;
+        bool ended {false};
+    };
+    std::vector<Tile> tiles_;
+
+    // Layout
+    int tile_width_ {320};
+    int columns_ {0};
+    cv::Mat mosaic_, scratch_;
+
+    // Fixed UI rate
+    Clock::duration period_ {std::chrono::milliseconds(33)};
+    Clock::time_point next_update_;
+    bool gui_inititalized_ {false};
+
+    void drawTile(Tile &tile);
+};
+
+}      /* namespace oat */
+#endif /* OAT_TILEVIEWER_H */
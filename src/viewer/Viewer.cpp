@@ -51,8 +51,12 @@ Viewer<T>::~Viewer()
 template <typename T>
 bool Viewer<T>::connectToNode()
 {
-    // Establish our a slot in the node
-    source_.touch(source_address_);
+    // The display thread was started before the viewer was configured
+    helper_thread_policy_.apply(display_thread_, "display");
+
+    // Viewers drop frames anyway, so watch the node without making the sink
+    // wait for us
+    source_.touch(source_address_, SourceMode::LATEST);
 
     // Wait for synchronous start with sink when it binds the node
     if (source_.connect() != SourceState::CONNECTED)
@@ -74,11 +78,14 @@ int Viewer<T>::process()
     // Figure out the time since we last updated the viewer
     Milliseconds duration
         = std::chrono::duration_cast<Milliseconds>(Clock::now() - tock_);
-    bool refresh_needed = duration > min_update_period_ms && display_complete_;
+    bool refresh_needed = duration > min_update_period_ms * (1 << display_level_)
+                          && display_complete_;
 
     // Clone the shared frame if needed
-    if (refresh_needed)
+    if (refresh_needed) {
         source_.copyTo(sample_);
+        capture();
+    }
 
     // Tell sink it can continue
     source_.post();
@@ -112,7 +119,12 @@ void Viewer<T>::processAsync()
             break;
 
         display_complete_ = false;
+        const auto start = Clock::now();
         display(sample_); // Implemented in concrete class
+        if (display_governor_.record(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start).count()))
+            display_level_ = display_governor_.level();
         display_complete_ = true;
     }
 }
@@ -28,8 +28,9 @@
 #include <thread>
 #include <boost/program_options.hpp>
 
-#include "../../lib/base/Component.h"
 #include "../../lib/base/Configurable.h"
+#include "../../lib/base/Governor.h"
+#include "../../lib/base/ControllableComponent.h"
 #include "../../lib/shmemdf/Source.h"
 
 namespace po = boost::program_options;
@@ -37,7 +38,7 @@ namespace po = boost::program_options;
 namespace oat {
 
 template <typename T>
-class Viewer : public Component, public Configurable<false> {
+class Viewer : public ControllableComponent, public Configurable<false> {
 
     using Clock = std::chrono::high_resolution_clock;
 
@@ -50,7 +51,7 @@ public:
     explicit Viewer(const std::string &source_name);
     virtual ~Viewer();
 
-    // Implement Component interface
+    // Implement ControllableComponent interface
     oat::ComponentType type(void) const override { return oat::viewer; };
     std::string name(void) const override { return name_; }
     bool connectToNode(void) override;
@@ -67,6 +68,10 @@ protected:
     using Milliseconds = std::chrono::milliseconds;
     Milliseconds min_update_period_ms {33};
 
+    // Doubles the update period, up to three times, while display() keeps
+    // taking longer than its budget. Only used by the display thread.
+    oat::Governor display_governor_;
+
     /**
      * @brief Perform sample display. Override to implement display operation
      * in derived classes.
@@ -74,6 +79,13 @@ protected:
      */
     virtual void display(const T &sample) = 0;
 
+    /**
+     * @brief Copy any other data needed by display() alongside a sample.
+     * Called on the processing thread whenever the sample to be displayed is
+     * updated, while display() is not running. Must not block.
+     */
+    virtual void capture(void) { }
+
 private:
     // Sample SOURCE
     T sample_;
@@ -85,6 +97,7 @@ private:
     // Display update thread
     std::atomic<bool> running_ {true};
     std::atomic<bool> display_complete_ {true};
+    std::atomic<int> display_level_ {0};
     std::mutex display_mutex_;
     std::condition_variable display_cv_;
     std::thread display_thread_;
@@ -39,6 +39,7 @@
 #include "ViewerBase.h"
 #include "Viewer.h"
 #include "FrameViewer.h"
+#include "TileViewer.h"
 
 #define REQ_POSITIONAL_ARGS 2
 
@@ -46,7 +47,8 @@ namespace po = boost::program_options;
 
 const char usage_type[] =
     "TYPE\n"
-    "  frame: Display frames in a GUI";
+    "  frame: Display frames in a GUI\n"
+    "  tile: Display frames from many sources as tiles of a single GUI";
 
 const char usage_io[] =
     "SOURCE:\n"
@@ -108,6 +110,7 @@ int main(int argc, char *argv[])
     std::unordered_map<std::string, char> type_hash;
     type_hash["frame"] = 'a';
     type_hash["position"] = 'b';
+    type_hash["tile"] = 'c';
 
     // The component itself
     std::string comp_name = "viewer";
@@ -169,6 +172,12 @@ int main(int argc, char *argv[])
                         oat::in_place<oat::FrameViewer>(), source);
                     break;
                 }
+                case 'c':
+                {
+                    viewer = std::make_shared<oat::ViewerBase>(
+                        oat::in_place<oat::TileViewer>(), source);
+                    break;
+                }
                 // TODO
                 //case 'b':
                 //{
@@ -0,0 +1,188 @@
+//******************************************************************************
+//* File:   RunningAverage_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../src/framefilter/RunningAverage.h"
+
+namespace {
+
+// Background subtraction as it was before the fused kernel
+struct Reference {
+
+    cv::Mat acc;
+    double alpha;
+
+    Reference(const cv::Mat &first, const double a) : alpha(a)
+    {
+        first.convertTo(acc, CV_32F);
+    }
+
+    cv::Mat subtract(const cv::Mat &in)
+    {
+        cv::accumulateWeighted(in, acc, alpha);
+        cv::Mat bg, out;
+        acc.convertTo(bg, in.depth());
+        cv::subtract(in, bg, out);
+        return out;
+    }
+};
+
+// Largest element of |a - b|
+double maxDifference(const cv::Mat &a, const cv::Mat &b)
+{
+    cv::Mat d;
+    cv::absdiff(a, b, d);
+    double m;
+    cv::minMaxLoc(d.reshape(1), nullptr, &m);
+    return m;
+}
+
+// Noisy frame around a level, in grey levels of an 8 bit frame
+cv::Mat noisyFrame(const int depth, const double level, cv::RNG &rng)
+{
+    const double scale = depth == CV_8U ? 1.0 : 257.0;
+    cv::Mat f(37, 29, CV_MAKETYPE(depth, 3));
+    rng.fill(f, cv::RNG::UNIFORM, (level - 10) * scale, (level + 10) * scale);
+    return f;
+}
+
+} // namespace
+
+SCENARIO ("A running average subtracts what cv::accumulateWeighted would.",
+          "[RunningAverage]") {
+
+    const int depths[] {CV_8U, CV_16U};
+    const double alphas[] {0.001, 0.01, 0.05, 0.5, 1.0};
+
+    GIVEN ("Noisy frames whose level steps up and down") {
+
+        WHEN ("Each is subtracted by running averages and by "
+              "cv::accumulateWeighted, at each depth and coefficient") {
+
+            THEN ("Every difference agrees to within one grey level") {
+
+                for (const int depth : depths) {
+                    for (const double alpha : alphas) {
+
+                        cv::RNG rng(17);
+                        const cv::Mat first = noisyFrame(depth, 60, rng);
+                        oat::RunningAverage avg;
+                        avg.reset(first, alpha);
+                        Reference ref(first, alpha);
+
+                        double worst = 0;
+                        for (int i = 0; i < 2000; i++) {
+                            const double level = (i / 250) % 2 ? 200 : 60;
+                            const cv::Mat in = noisyFrame(depth, level, rng);
+                            cv::Mat out;
+                            avg.subtract(in, out);
+                            worst = std::max(
+                                worst, maxDifference(out, ref.subtract(in)));
+                        }
+
+                        INFO ("depth " << depth << ", alpha " << alpha);
+                        REQUIRE (worst <= 1);
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN ("A steady frame 40 grey levels above the initial background") {
+
+        WHEN ("Enough frames for each average to converge are subtracted") {
+
+            // A float average of 16 bit frames stops short once alpha times
+            // the difference is under half its resolution, which at small
+            // alpha is about one grey level, as with cv::accumulateWeighted
+            THEN ("The background reaches the frame") {
+
+                for (const int depth : depths) {
+                    for (const double alpha : alphas) {
+
+                        const double scale = depth == CV_8U ? 1.0 : 257.0;
+                        const int type = CV_MAKETYPE(depth, 3);
+                        const cv::Mat first(8, 8, type,
+                                            cv::Scalar::all(100 * scale));
+                        const cv::Mat steady(8, 8, type,
+                                             cv::Scalar::all(140 * scale));
+
+                        oat::RunningAverage avg;
+                        avg.reset(first, alpha);
+
+                        cv::Mat out;
+                        const int frames = static_cast<int>(16 / alpha) + 1;
+                        for (int i = 0; i < frames; i++)
+                            avg.subtract(steady, out);
+
+                        const double slack = depth == CV_8U ? 0 : 1;
+                        INFO ("depth " << depth << ", alpha " << alpha);
+                        REQUIRE (maxDifference(avg.background(), steady)
+                                 <= slack);
+                        REQUIRE (maxDifference(out, cv::Mat::zeros(
+                                     out.size(), out.type())) <= slack);
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO ("Subtracting in place gives the same difference as into a new frame.",
+          "[RunningAverage]") {
+
+    GIVEN ("Pairs of running averages, with fixed point and float models") {
+
+        WHEN ("One of each pair subtracts in place, the other into a new "
+              "frame") {
+
+            THEN ("The differences are identical") {
+
+                const double alphas[] {0.01, 0.1};
+
+                for (const double alpha : alphas) {
+
+                    cv::RNG rng(3);
+                    const cv::Mat first = noisyFrame(CV_8U, 100, rng);
+                    oat::RunningAverage a, b;
+                    a.reset(first, alpha);
+                    b.reset(first, alpha);
+
+                    bool same = true;
+                    for (int i = 0; i < 50; i++) {
+                        cv::Mat in = noisyFrame(CV_8U, 150, rng), out;
+                        b.subtract(in, out);
+                        a.subtract(in, in);
+                        same &= maxDifference(in, out) == 0;
+                    }
+
+                    INFO ("alpha " << alpha);
+                    REQUIRE (same);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,297 @@
+#!/usr/bin/env python3
+
+# Reproducible end-to-end benchmark of an Oat processing chain.
+#
+# A pipeline description (TOML, see pipelines/) lists the components to run.
+# Each repetition launches every component except the driver, waits until
+# each of them has connected to its SOURCE nodes, then launches the driver,
+# usually a finite frame or position server, and times it to completion.
+# Node telemetry is collected throughout with `oat top --json`, and CPU time
+# is taken from each component's resource usage when it exits. Warm-up
+# repetitions are run first and discarded. Results are printed as JSON.
+#
+# Usage: bench.py PIPELINE [-r N] [-w N] [-D key=value ...] [-o results.json]
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import signal
+import statistics
+import subprocess
+import sys
+import threading
+import time
+
+try:
+    import tomllib as toml_parser # Python >= 3.11
+
+    def load_toml(path):
+        with open(path, 'rb') as f:
+            return toml_parser.load(f)
+except ImportError:
+    import toml as toml_parser
+
+    def load_toml(path):
+        return toml_parser.load(path)
+
+# Same binning as oat::LatencyHistogram: bin i counts durations in
+# [2^(i-1), 2^i) ns
+def quantile(bins, q):
+    n = sum(bins)
+    if n == 0:
+        return None
+    rank = int(q * (n - 1))
+    seen = 0
+    for i, c in enumerate(bins):
+        seen += c
+        if seen > rank:
+            return 0 if i == 0 else (1 << i) - 1
+    return (1 << (len(bins) - 1)) - 1
+
+def add_bins(total, bins):
+    if not total:
+        return list(bins)
+    return [a + b for a, b in zip(total, bins)]
+
+def latency_ms(bins):
+    out = {}
+    for name, q in (('p50', 0.5), ('p90', 0.9), ('p99', 0.99)):
+        v = quantile(bins, q)
+        out[name] = None if v is None else v / 1e6
+    return out
+
+class Telemetry:
+    """Runs `oat top --json` over the nodes of a pipeline and sums its
+    per-period counts."""
+
+    def __init__(self, oat, nodes, period):
+        self.proc = subprocess.Popen(
+            [oat, 'top', '--json', '-p', str(period)] + nodes,
+            stdout=subprocess.PIPE, universal_newlines=True)
+        self.nodes = {n: {'writes': 0, 'wait': [], 'interval': [],
+                          'sources': {}} for n in nodes}
+        self.thread = threading.Thread(target=self._read)
+        self.thread.start()
+
+    def _read(self):
+        for line in self.proc.stdout:
+            try:
+                report = json.loads(line)
+            except ValueError:
+                continue
+            for n in report['nodes']:
+                if not n['found']:
+                    continue
+                acc = self.nodes[n['name']]
+                acc['writes'] += n['writes']
+                acc['wait'] = add_bins(acc['wait'], n['wait'])
+                acc['interval'] = add_bins(acc['interval'], n['interval'])
+                for s in n['sources']:
+                    src = acc['sources'].setdefault(
+                        s['slot'], {'reads': 0, 'hold': []})
+                    src['reads'] += s['reads']
+                    src['hold'] = add_bins(src['hold'], s['hold'])
+
+    def stop(self):
+        self.proc.send_signal(signal.SIGINT)
+        self.proc.wait()
+        self.thread.join()
+        return self.nodes
+
+def bound_sources(oat, nodes):
+    """Number of sources bound to each node, or None if it does not exist."""
+    out = subprocess.check_output(
+        [oat, 'top', '--json', '-n', '1', '-p', '0.05'] + nodes,
+        universal_newlines=True)
+    report = json.loads(out.strip().splitlines()[-1])
+    return {n['name']: (len(n['sources']) if n['found'] else None)
+            for n in report['nodes']}
+
+def wait_ready(oat, launched, timeout):
+    """Wait until every launched component has connected to its sources."""
+    expected = {}
+    for c in launched:
+        for s in c.get('sources', []):
+            expected[s] = expected.get(s, 0) + 1
+
+    if not expected:
+        return
+
+    names = ['%s:%d' % (n, k) for n, k in sorted(expected.items())]
+    if subprocess.call([oat, 'await', '-t', str(timeout)] + names) != 0:
+        raise RuntimeError('Components did not connect within %g s: %s'
+                           % (timeout, bound_sources(oat, list(expected))))
+
+def reap(proc, timeout=None):
+    """Wait for a process and return its CPU time in seconds. If it has not
+    exited within timeout seconds, it is interrupted first."""
+    deadline = None if timeout is None else time.time() + timeout
+    while True:
+        pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+        if pid != 0:
+            break
+        if deadline is not None and time.time() > deadline:
+            proc.send_signal(signal.SIGINT)
+            _, status, usage = os.wait4(proc.pid, 0)
+            break
+        time.sleep(0.01)
+
+    proc.returncode = status
+    return {'user_sec': usage.ru_utime, 'sys_sec': usage.ru_stime}
+
+def substitute(args, variables):
+    return [str(a).format(**variables) for a in args]
+
+def run_once(desc, variables, args):
+    components = desc['component']
+    drivers = [c for c in components if c.get('driver', False)]
+    others = [c for c in components if not c.get('driver', False)]
+    if len(drivers) != 1:
+        raise RuntimeError('A pipeline must have exactly one driver component.')
+    driver = drivers[0]
+
+    procs = []
+    try:
+        # Downstream components first, so that no samples are missed
+        for c in others:
+            procs.append((c, subprocess.Popen(
+                [args.oat] + substitute(c['args'], variables))))
+        wait_ready(args.oat, others, args.ready_timeout)
+
+        telemetry = Telemetry(args.oat, desc['benchmark']['nodes'],
+                              args.period)
+
+        t0 = time.monotonic()
+        dproc = subprocess.Popen(
+            [args.oat] + substitute(driver['args'], variables))
+        cpu = {driver['name']: reap(dproc)}
+        wall = time.monotonic() - t0
+
+        # Remaining components leave once their sources see the sink leave
+        for c, p in procs:
+            cpu[c['name']] = reap(p, args.exit_timeout)
+        procs = []
+
+        nodes = telemetry.stop()
+
+    finally:
+        for _, p in procs:
+            if p.returncode is None:
+                p.kill()
+                p.wait()
+
+    result = {'wall_sec': wall, 'nodes': {}, 'components': {}}
+    for name, n in nodes.items():
+        result['nodes'][name] = {
+            'writes': n['writes'],
+            'fps': n['writes'] / wall,
+            'interval_ms': latency_ms(n['interval']),
+            'sink_wait_ms': latency_ms(n['wait']),
+            'sources': [{'slot': slot,
+                         'reads': s['reads'],
+                         'hold_ms': latency_ms(s['hold'])}
+                        for slot, s in sorted(n['sources'].items())]
+        }
+    for name, c in cpu.items():
+        total = c['user_sec'] + c['sys_sec']
+        result['components'][name] = dict(c, cpu_percent=100.0 * total / wall)
+
+    return result
+
+def summarize(runs):
+    """Median, min and max of throughput and CPU over the measured runs."""
+    def stats(values):
+        return {'median': statistics.median(values),
+                'min': min(values), 'max': max(values)}
+
+    summary = {'wall_sec': stats([r['wall_sec'] for r in runs]),
+               'fps': {}, 'cpu_percent': {}}
+    for node in runs[0]['nodes']:
+        summary['fps'][node] = stats([r['nodes'][node]['fps'] for r in runs])
+    for comp in runs[0]['components']:
+        summary['cpu_percent'][comp] = stats(
+            [r['components'][comp]['cpu_percent'] for r in runs])
+    return summary
+
+def git_commit(path):
+    try:
+        return subprocess.check_output(
+            ['git', 'rev-parse', '--short', 'HEAD'], cwd=path,
+            universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Benchmark an Oat processing chain described by PIPELINE.')
+    parser.add_argument('pipeline', help='TOML pipeline description.')
+    parser.add_argument('-r', '--repetitions', type=int,
+                        help='Measured repetitions. Overrides the description.')
+    parser.add_argument('-w', '--warmup', type=int,
+                        help='Discarded warm-up repetitions. Overrides the '
+                             'description.')
+    parser.add_argument('-D', dest='defines', action='append', default=[],
+                        metavar='KEY=VALUE',
+                        help='Override a [vars] entry of the description.')
+    parser.add_argument('-o', '--output', help='Write JSON results here '
+                        'instead of to stdout.')
+    parser.add_argument('--oat', default='oat', help='oat executable.')
+    parser.add_argument('--period', type=float, default=0.1,
+                        help='Telemetry period in seconds.')
+    parser.add_argument('--ready-timeout', type=float, default=10.0,
+                        help='Seconds to wait for components to connect.')
+    parser.add_argument('--exit-timeout', type=float, default=10.0,
+                        help='Seconds to wait for components to exit after '
+                             'the driver.')
+    args = parser.parse_args()
+
+    desc = load_toml(args.pipeline)
+    bench = desc['benchmark']
+
+    variables = dict(desc.get('vars', {}))
+    for d in args.defines:
+        key, _, value = d.partition('=')
+        variables[key] = value
+
+    repetitions = args.repetitions or bench.get('repetitions', 5)
+    warmup = args.warmup if args.warmup is not None else bench.get('warmup', 1)
+
+    # Paths in descriptions are relative to the description's directory
+    os.chdir(os.path.dirname(os.path.abspath(args.pipeline)))
+
+    runs = []
+    for i in range(warmup + repetitions):
+        r = run_once(desc, variables, args)
+        if i >= warmup:
+            runs.append(r)
+        print('%s: repetition %d/%d%s, %.3f s' % (
+                  bench.get('name', args.pipeline), i + 1,
+                  warmup + repetitions, ' (warm-up)' if i < warmup else '',
+                  r['wall_sec']),
+              file=sys.stderr)
+
+    results = {
+        'name': bench.get('name', os.path.basename(args.pipeline)),
+        'date': datetime.datetime.now().isoformat(),
+        'commit': git_commit('.'),
+        'machine': {'node': platform.node(),
+                    'system': platform.platform(),
+                    'processor': platform.processor(),
+                    'cpus': os.cpu_count()},
+        'vars': variables,
+        'warmup': warmup,
+        'summary': summarize(runs),
+        'repetitions': runs
+    }
+
+    out = json.dumps(results, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(out + '\n')
+    else:
+        print(out)
+
+if __name__ == '__main__':
+    main()
@@ -1,3 +0,0 @@
-oat framefilt mog raw flt &
-sleep 100
-time oat frameserve test raw -f $1 -c test.toml test
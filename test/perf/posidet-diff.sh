@@ -1,3 +0,0 @@
-oat posidet diff raw pos &
-sleep 1
-time oat frameserve test raw -f $1 -c test.toml test
@@ -1,3 +0,0 @@
-oat posifilt kalman pos flt -c test.toml posifilt-kalman &
-sleep 1
-time oat posigen rand2D pos -n 1000
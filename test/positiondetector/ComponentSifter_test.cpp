@@ -0,0 +1,269 @@
+//******************************************************************************
+//* File:   ComponentSifter_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/datatypes/PackedMask.h"
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/datatypes/PositionArray.h"
+#include "../../src/positiondetector/DetectorFunc.h"
+
+namespace {
+
+struct Component {
+    double x, y, area;
+    int label;
+};
+
+// 8-connected components as OpenCV finds them, in the raster order of their
+// topmost pixel
+std::vector<Component> reference(const cv::Mat &mask,
+                                 cv::Mat &labels,
+                                 const double min_area,
+                                 const double max_area)
+{
+    cv::Mat stats, centroids;
+    const int n = cv::connectedComponentsWithStats(
+        mask, labels, stats, centroids, 8, CV_32S);
+
+    std::vector<bool> seen(n, false);
+    std::vector<Component> c;
+    for (int y = 0; y < labels.rows; y++)
+        for (int x = 0; x < labels.cols; x++) {
+            const int l = labels.at<int>(y, x);
+            if (l == 0 || seen[l])
+                continue;
+            seen[l] = true;
+            const double area = stats.at<int>(l, cv::CC_STAT_AREA);
+            if (area >= min_area && area < max_area)
+                c.push_back({centroids.at<double>(l, 0),
+                             centroids.at<double>(l, 1),
+                             area,
+                             l});
+        }
+
+    return c;
+}
+
+// Compare a sifter's objects, position and heading with those of OpenCV.
+// Packed masks are sifted in their packed form.
+void requireSameComponents(oat::ComponentSifter &sifter,
+                           const cv::Mat &mask,
+                           const bool packed,
+                           const double min_area = 0,
+                           const double max_area
+                           = std::numeric_limits<double>::max())
+{
+    constexpr double TOL {1e-9};
+
+    cv::Mat labels;
+    const auto ref = reference(mask, labels, min_area, max_area);
+
+    oat::Position2D position("test");
+    oat::PositionArray objects;
+    double area = -1;
+    if (packed) {
+        cv::Mat p;
+        oat::packMask(mask, p);
+        sifter.siftPacked(p, position, area, min_area, max_area, &objects, true);
+    } else {
+        sifter.sift(mask, position, area, min_area, max_area, &objects, true);
+    }
+
+    INFO (mask.rows << "x" << mask.cols << (packed ? ", packed" : "")
+          << ", " << ref.size() << " components");
+
+    const size_t n = std::min(ref.size(), oat::PositionArray::CAPACITY);
+    REQUIRE (objects.size() == n);
+    for (size_t i = 0; i < n; i++) {
+        INFO ("component " << i);
+        REQUIRE (objects.area[i] == ref[i].area);
+        REQUIRE (std::abs(objects.x[i] - ref[i].x) < TOL);
+        REQUIRE (std::abs(objects.y[i] - ref[i].y) < TOL);
+    }
+
+    // The first of the largest components
+    const Component *largest = nullptr;
+    for (const auto &c : ref)
+        if (largest == nullptr || c.area > largest->area)
+            largest = &c;
+
+    REQUIRE (position.position_valid == (largest != nullptr));
+    if (largest == nullptr) {
+        REQUIRE (area == 0);
+        return;
+    }
+
+    REQUIRE (area == largest->area);
+    REQUIRE (std::abs(position.position.x - largest->x) < TOL);
+    REQUIRE (std::abs(position.position.y - largest->y) < TOL);
+
+    // Its major axis, from the moments of its own mask
+    cv::Mat own = cv::Mat::zeros(mask.size(), CV_8UC1);
+    for (int y = 0; y < mask.rows; y++)
+        for (int x = 0; x < mask.cols; x++)
+            if (labels.at<int>(y, x) == largest->label)
+                own.at<uint8_t>(y, x) = 255;
+    const cv::Moments m = cv::moments(own, true);
+
+    const double spread = m.mu20 + m.mu02;
+    const double elongation = std::sqrt(
+        (m.mu20 - m.mu02) * (m.mu20 - m.mu02) + 4 * m.mu11 * m.mu11);
+    const bool heading_valid
+        = spread > 0 && elongation >= oat::MIN_AXIS_ELONGATION * spread;
+    REQUIRE (position.heading_valid == heading_valid);
+
+    if (heading_valid) {
+        // Either end of the axis
+        const double theta = 0.5 * std::atan2(2 * m.mu11, m.mu20 - m.mu02);
+        const double along = position.heading.x * std::cos(theta)
+                           + position.heading.y * std::sin(theta);
+        REQUIRE (std::abs(std::abs(along) - 1) < 1e-6);
+    }
+}
+
+// Mask whose pixels are set with a probability of density, in blobs of cell
+// pixels across so that components span rows as well as columns
+cv::Mat randomMask(const int rows,
+                   const int cols,
+                   const int cell,
+                   const double density,
+                   cv::RNG &rng)
+{
+    const int cw = cols / cell + 1;
+    std::vector<double> coarse((rows / cell + 1) * cw);
+    for (auto &p : coarse)
+        p = rng.uniform(0.0, 2 * density);
+
+    cv::Mat mask(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; y++)
+        for (int x = 0; x < cols; x++)
+            mask.at<uint8_t>(y, x) = rng.uniform(0.0, 1.0)
+                < coarse[(y / cell) * cw + x / cell] ? 255 : 0;
+
+    return mask;
+}
+
+// Mask of shapes that test the joining of labels: combs whose teeth meet
+// only in their last row, combs hanging from their first, stairs of runs
+// touching only at their corners, and diagonal lines. Each crosses the edges
+// of bands of MIN_BAND_ROWS rows.
+cv::Mat shapeMask(const int rows, const int cols)
+{
+    cv::Mat mask = cv::Mat::zeros(rows, cols, CV_8UC1);
+    auto set = [&mask](const int y, const int x0, const int x1) {
+        for (int x = std::max(0, x0); x < std::min(mask.cols, x1); x++)
+            mask.at<uint8_t>(y, x) = 255;
+    };
+
+    // U comb, teeth 2 columns apart, each starting lower than the last so
+    // that the component's first pixel is not in its first tooth.
+    for (int t = 0; t < 5; t++)
+        for (int y = 40 - 8 * t; y < rows - 1; y++)
+            set(y, 2 * t, 2 * t + 1);
+    set(rows - 1, 0, 9);
+
+    // Inverted comb
+    set(0, 12, 21);
+    for (int t = 0; t < 5; t++)
+        for (int y = 1; y < rows - 10 * t - 1; y++)
+            set(y, 12 + 2 * t, 13 + 2 * t);
+
+    // Runs touching only at their corners across every band edge, and runs
+    // one pixel short of touching
+    const int edge = oat::ComponentSifter::MIN_BAND_ROWS;
+    for (int y = edge; y < rows; y += edge) {
+        set(y - 1, 23, 27);
+        set(y, 27, 30);
+        set(y - 1, 32, 35);
+        set(y, 36, 38);
+    }
+
+    // Diagonals, connected only through corners
+    for (int y = 0; y < rows; y++) {
+        set(y, 40 + y % 10, 41 + y % 10);
+        set(y, 60 - y % 8, 61 - y % 8);
+    }
+
+    return mask;
+}
+
+} // namespace
+
+SCENARIO ("Connected components match cv::connectedComponentsWithStats.",
+          "[ComponentSifter]") {
+
+    // Frames of 4 * MIN_BAND_ROWS rows are then cut into bands at multiples
+    // of MIN_BAND_ROWS
+    cv::setNumThreads(4);
+    const int band = oat::ComponentSifter::MIN_BAND_ROWS;
+
+    GIVEN ("Random masks of single rows and columns, single bands and many") {
+
+        WHEN ("They are sifted, whole and packed") {
+
+            THEN ("Every component has OpenCV's area, centroid and axis") {
+
+                // The sifter is kept across frames, as its scratch space is
+                const int sizes[][2] {{1, 1}, {1, 300}, {300, 1}, {50, 61},
+                                      {4 * band, 61}, {4 * band, 64},
+                                      {4 * band + 13, 203}, {9 * band, 37}};
+                const double densities[] {0.05, 0.3, 0.6};
+
+                oat::ComponentSifter sifter;
+                cv::RNG rng(23);
+
+                for (const auto &s : sizes)
+                    for (const double d : densities) {
+                        const cv::Mat mask
+                            = randomMask(s[0], s[1], 4, d, rng);
+                        requireSameComponents(sifter, mask, false);
+                        requireSameComponents(sifter, mask, true);
+                        requireSameComponents(sifter, mask, false, 5, 50);
+                    }
+            }
+        }
+    }
+
+    GIVEN ("Combs, corner-touching runs and diagonals across band edges") {
+
+        WHEN ("They are sifted, whole and packed") {
+
+            THEN ("Every component has OpenCV's area, centroid and axis") {
+
+                oat::ComponentSifter sifter;
+                const int rows[] {band - 1, band, 4 * band, 4 * band + 1};
+
+                for (const int r : rows) {
+                    const cv::Mat mask = shapeMask(r, 61);
+                    requireSameComponents(sifter, mask, false);
+                    requireSameComponents(sifter, mask, true);
+                }
+            }
+        }
+    }
+}
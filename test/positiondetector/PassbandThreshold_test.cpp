@@ -0,0 +1,193 @@
+//******************************************************************************
+//* File:   PassbandThreshold_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <limits>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../../lib/datatypes/Color.h"
+#include "../../src/positiondetector/PassbandThreshold.h"
+
+namespace {
+
+struct Shape { int rows, cols; };
+
+// Single rows and columns, a frame smaller than the largest kernels, and
+// frames wide enough to be cut into bands of fewer rows than those kernels
+const Shape SHAPES[] {{1, 300}, {300, 1}, {1, 1}, {5, 7}, {64, 200},
+                      {23, 4100}, {20, 8200}};
+
+// Erode and dilate sizes: absent, odd, even and oversized
+const int KERNELS[][2] {{0, 0}, {1, 1}, {3, 0}, {0, 4}, {2, 5}, {5, 2},
+                        {4, 6}, {9, 17}, {17, 9}};
+
+// Frame of random blobs, cell pixels across, under per pixel noise, so that
+// its threshold has structure for the kernels to erode and dilate
+template <typename T>
+cv::Mat blobFrame(const Shape &s, const int channels, cv::RNG &rng)
+{
+    constexpr int MAX = std::numeric_limits<T>::max();
+    constexpr int CELL = 5;
+    const int noise = MAX / 16;
+    const int cw = s.cols / CELL + 1;
+
+    std::vector<int> coarse((s.rows / CELL + 1) * cw * channels);
+    for (auto &v : coarse)
+        v = rng.uniform(0, MAX + 1);
+
+    const int depth = sizeof(T) == 1 ? CV_8U : CV_16U;
+    cv::Mat f(s.rows, s.cols, CV_MAKETYPE(depth, channels));
+    for (int y = 0; y < s.rows; y++) {
+        T *p = f.ptr<T>(y);
+        for (int x = 0; x < s.cols; x++)
+            for (int c = 0; c < channels; c++) {
+                const int v = coarse[((y / CELL) * cw + x / CELL) * channels + c]
+                            + rng.uniform(-noise, noise + 1);
+                p[x * channels + c] = cv::saturate_cast<T>(v);
+            }
+    }
+
+    return f;
+}
+
+// The mask as OpenCV makes it
+cv::Mat reference(const cv::Mat &frame,
+                  const int lo[],
+                  const int hi[],
+                  const int erode_px,
+                  const int dilate_px)
+{
+    cv::Mat mask;
+    cv::inRange(frame,
+                cv::Scalar(lo[0], lo[1], lo[2]),
+                cv::Scalar(hi[0], hi[1], hi[2]),
+                mask);
+    if (erode_px > 0)
+        cv::erode(mask, mask, cv::getStructuringElement(
+                      cv::MORPH_RECT, cv::Size(erode_px, erode_px)));
+    if (dilate_px > 0)
+        cv::dilate(mask, mask, cv::getStructuringElement(
+                       cv::MORPH_RECT, cv::Size(dilate_px, dilate_px)));
+    return mask;
+}
+
+bool sameMask(const cv::Mat &a, const cv::Mat &b)
+{
+    if (a.size() != b.size() || a.type() != b.type())
+        return false;
+    cv::Mat d;
+    cv::absdiff(a, b, d);
+    return cv::countNonZero(d) == 0;
+}
+
+// Compare every kernel of one frame and passband
+template <oat::PixelColor COLOR>
+void requireSameMasks(oat::PassbandThreshold &pt,
+                      const cv::Mat &frame,
+                      const int lo[],
+                      const int hi[])
+{
+    for (const auto &k : KERNELS) {
+        cv::Mat mask;
+        pt.apply<COLOR>(frame, mask, lo, hi, k[0], k[1]);
+        INFO (oat::color_str(COLOR) << " " << frame.rows << "x" << frame.cols
+              << ", erode " << k[0] << ", dilate " << k[1]);
+        REQUIRE (sameMask(mask, reference(frame, lo, hi, k[0], k[1])));
+    }
+}
+
+} // namespace
+
+SCENARIO ("Fused passband thresholds match cv::inRange, cv::erode and "
+          "cv::dilate.", "[PassbandThreshold]") {
+
+    GIVEN ("Frames of random blobs of every shape and pixel color") {
+
+        WHEN ("Each is thresholded and filtered with absent, odd, even and "
+              "oversized kernels") {
+
+            THEN ("Every mask is the one OpenCV makes") {
+
+                // One threshold for all, so scratch space is reused across
+                // frame shapes
+                oat::PassbandThreshold pt;
+                cv::RNG rng(11);
+
+                const int grey_lo[] {80, 0, 0}, grey_hi[] {200, 0, 0};
+                const int none_lo[] {200, 0, 0}, none_hi[] {100, 0, 0};
+                const int bgr_lo[] {40, 60, 30}, bgr_hi[] {220, 255, 200};
+                const int hsv_lo[] {0, 40, 40}, hsv_hi[] {120, 255, 255};
+                const int g16_lo[] {20000, 0, 0}, g16_hi[] {50000, 0, 0};
+
+                for (const auto &s : SHAPES) {
+
+                    const cv::Mat grey = blobFrame<uint8_t>(s, 1, rng);
+                    requireSameMasks<oat::PIX_GREY>(pt, grey, grey_lo, grey_hi);
+                    requireSameMasks<oat::PIX_GREY>(pt, grey, none_lo, none_hi);
+
+                    const cv::Mat bgr = blobFrame<uint8_t>(s, 3, rng);
+                    requireSameMasks<oat::PIX_BGR>(pt, bgr, bgr_lo, bgr_hi);
+
+                    cv::Mat hsv;
+                    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+                    requireSameMasks<oat::PIX_HSV>(pt, hsv, hsv_lo, hsv_hi);
+
+                    const cv::Mat g16 = blobFrame<uint16_t>(s, 1, rng);
+                    requireSameMasks<oat::PIX_GREY16>(pt, g16, g16_lo, g16_hi);
+                }
+            }
+        }
+    }
+
+    GIVEN ("BGR frames of every shape held as stacked channel planes") {
+
+        WHEN ("Each is thresholded and filtered from its planes") {
+
+            THEN ("Every mask is the one OpenCV makes of the interleaved "
+                  "frame") {
+
+                oat::PassbandThreshold pt;
+                cv::RNG rng(5);
+                const int lo[] {40, 60, 30}, hi[] {220, 255, 200};
+
+                for (const auto &s : SHAPES) {
+
+                    const cv::Mat bgr = blobFrame<uint8_t>(s, 3, rng);
+                    cv::Mat planes[3], planar;
+                    cv::split(bgr, planes);
+                    cv::vconcat(planes, 3, planar);
+
+                    for (const auto &k : KERNELS) {
+                        cv::Mat mask;
+                        pt.applyPlanar(planar, mask, lo, hi, k[0], k[1]);
+                        INFO (s.rows << "x" << s.cols << ", erode " << k[0]
+                              << ", dilate " << k[1]);
+                        REQUIRE (sameMask(mask,
+                                          reference(bgr, lo, hi, k[0], k[1])));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,323 @@
+//******************************************************************************
+//* File:   ConstantVelocityKalman_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "../../src/positionfilter/ConstantVelocityKalman.h"
+
+namespace {
+
+using Mat4 = double[4][4];
+
+// Inverse of a nonsingular 4x4 matrix, by Gauss-Jordan elimination with
+// partial pivoting
+void invert(const Mat4 &m, Mat4 &inv)
+{
+    double a[4][8] {};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            a[i][j] = m[i][j];
+        a[i][4 + i] = 1;
+    }
+
+    for (int c = 0; c < 4; c++) {
+        int pivot = c;
+        for (int i = c + 1; i < 4; i++)
+            if (std::abs(a[i][c]) > std::abs(a[pivot][c]))
+                pivot = i;
+        for (int j = 0; j < 8; j++)
+            std::swap(a[c][j], a[pivot][j]);
+
+        const double d = a[c][c];
+        for (int j = 0; j < 8; j++)
+            a[c][j] /= d;
+        for (int i = 0; i < 4; i++) {
+            if (i == c)
+                continue;
+            const double e = a[i][c];
+            for (int j = 0; j < 8; j++)
+                a[i][j] -= e * a[c][j];
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            inv[i][j] = a[i][4 + j];
+}
+
+// Textbook Kalman filter over the full state [x x' y y']^T, with dense 4x4
+// matrices, that the closed form filters must agree with
+struct DenseKalman {
+
+    double s[4] {0, 0, 0, 0};
+    Mat4 p {};
+    Mat4 f {};
+    Mat4 q {};
+    double r {0};
+
+    DenseKalman(const oat::ConstantVelocityModel &m,
+                const double x, const double y, const double p0)
+    {
+        s[0] = x;
+        s[2] = y;
+        for (int k = 0; k < 4; k++) {
+            p[k][k] = p0;
+            f[k][k] = 1;
+        }
+        for (int a = 0; a < 4; a += 2) {
+            f[a][a + 1] = m.dt;
+            q[a][a] = m.q00;
+            q[a][a + 1] = q[a + 1][a] = m.q01;
+            q[a + 1][a + 1] = m.q11;
+        }
+        r = m.r;
+    }
+
+    // s = F s, P = F P F^T + Q
+    void predict()
+    {
+        double t[4] {0, 0, 0, 0};
+        Mat4 fp {}, fpf {};
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++) {
+                t[i] += f[i][j] * s[j];
+                for (int k = 0; k < 4; k++)
+                    fp[i][j] += f[i][k] * p[k][j];
+            }
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++) {
+                for (int k = 0; k < 4; k++)
+                    fpf[i][j] += fp[i][k] * f[j][k];
+                p[i][j] = fpf[i][j] + q[i][j];
+            }
+        for (int i = 0; i < 4; i++)
+            s[i] = t[i];
+    }
+
+    // H picks rows 0 and 2. K = P H^T (H P H^T + R)^-1, s += K (z - H s),
+    // P = (I - K H) P
+    void correct(const double zx, const double zy)
+    {
+        const int h[2] {0, 2};
+        const double a = p[0][0] + r, b = p[0][2], c = p[2][0],
+                     d = p[2][2] + r;
+        const double det = a * d - b * c;
+        const double inv[2][2] {{d / det, -b / det}, {-c / det, a / det}};
+
+        double k[4][2] {};
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 2; j++)
+                for (int l = 0; l < 2; l++)
+                    k[i][j] += p[i][h[l]] * inv[l][j];
+
+        const double e[2] {zx - s[0], zy - s[2]};
+        for (int i = 0; i < 4; i++)
+            s[i] += k[i][0] * e[0] + k[i][1] * e[1];
+
+        Mat4 np {};
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                np[i][j] = p[i][j] - k[i][0] * p[0][j] - k[i][1] * p[2][j];
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                p[i][j] = np[i][j];
+    }
+
+    // Rauch-Tung-Striebel step of a filtered state, given the filter as
+    // predicted from it and the smoothed state of the next step.
+    // C = P F^T P_predicted^-1, s += C (s_next - s_predicted)
+    void smooth(const DenseKalman &predicted, const double next[4])
+    {
+        Mat4 inv {}, pf {}, c {};
+        invert(predicted.p, inv);
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                for (int k = 0; k < 4; k++)
+                    pf[i][j] += p[i][k] * f[j][k];
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                for (int k = 0; k < 4; k++)
+                    c[i][j] += pf[i][k] * inv[k][j];
+
+        double d[4];
+        for (int i = 0; i < 4; i++)
+            d[i] = next[i] - predicted.s[i];
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                s[i] += c[i][j] * d[j];
+    }
+};
+
+} // namespace
+
+SCENARIO ("Closed form constant velocity filters agree with a dense Kalman filter.",
+          "[ConstantVelocityKalman]") {
+
+    GIVEN ("A noise model and noisy measurements of a moving target") {
+
+        oat::ConstantVelocityModel m;
+        m.set(1.0 / 30.0, 50.0, 2.0);
+
+        std::mt19937 gen(7);
+        std::normal_distribution<double> noise(0.0, 2.0);
+        const size_t steps = 300;
+        std::vector<double> zx(steps), zy(steps);
+        for (size_t t = 0; t < steps; t++) {
+            zx[t] = 10.0 + 40.0 * t * m.dt + noise(gen);
+            zy[t] = -5.0 + 100.0 * std::sin(t * m.dt) + noise(gen);
+        }
+
+        const double tol = 1e-9;
+
+        WHEN ("A single filter is stepped alongside the dense filter") {
+
+            oat::ConstantVelocityKalman kf;
+            kf.init(zx[0], zy[0]);
+            DenseKalman ref(m, zx[0], zy[0], 1000.0);
+
+            bool agree = true;
+            for (size_t t = 1; t < steps; t++) {
+                kf.predict(m);
+                ref.predict();
+                kf.correct(m, zx[t], zy[t]);
+                ref.correct(zx[t], zy[t]);
+
+                const double got[4] {kf.x().x, kf.x().v, kf.y().x, kf.y().v};
+                for (int i = 0; i < 4; i++)
+                    agree &= std::abs(got[i] - ref.s[i]) <= tol;
+                agree &= std::abs(kf.x().p00 - ref.p[0][0]) <= tol;
+                agree &= std::abs(kf.x().p01 - ref.p[0][1]) <= tol;
+                agree &= std::abs(kf.y().p11 - ref.p[3][3]) <= tol;
+                agree &= std::abs(ref.p[0][2]) <= tol;
+            }
+
+            THEN ("Their states and covariances agree at every step") {
+                REQUIRE (agree);
+            }
+        }
+
+        WHEN ("A batch of tracks is stepped, some of them unmeasured at times") {
+
+            const size_t n = 5;
+            oat::ConstantVelocityKalmanBatch batch;
+            batch.resize(n);
+            std::vector<DenseKalman> refs;
+            for (size_t i = 0; i < n; i++) {
+                batch.init(i, zx[0] + i, zy[0] - i);
+                refs.emplace_back(m, zx[0] + i, zy[0] - i, 1000.0);
+            }
+
+            bool agree = true;
+            for (size_t t = 1; t < steps; t++) {
+                batch.predict(m);
+                for (size_t i = 0; i < n; i++) {
+                    refs[i].predict();
+
+                    // Track i misses every (i + 2)th measurement
+                    if (t % (i + 2) == 0)
+                        continue;
+                    batch.measure(i, zx[t] + i, zy[t] - i);
+                    refs[i].correct(zx[t] + i, zy[t] - i);
+                }
+                batch.correct(m);
+
+                for (size_t i = 0; i < n; i++) {
+                    agree &= std::abs(batch.x(i) - refs[i].s[0]) <= tol;
+                    agree &= std::abs(batch.vx(i) - refs[i].s[1]) <= tol;
+                    agree &= std::abs(batch.y(i) - refs[i].s[2]) <= tol;
+                    agree &= std::abs(batch.vy(i) - refs[i].s[3]) <= tol;
+                    agree &= std::abs(batch.var_x(i) - refs[i].p[0][0]) <= tol;
+                    agree &= std::abs(batch.var_y(i) - refs[i].p[2][2]) <= tol;
+                }
+            }
+
+            THEN ("Each track agrees with its own dense filter at every step") {
+                REQUIRE (agree);
+            }
+        }
+
+        WHEN ("A track with missed measurements is filtered and smoothed "
+              "backwards, per axis as by KalmanFilter2D and densely") {
+
+            // Measurements are missed now and then, and in one long gap
+            std::vector<char> measured(steps);
+            for (size_t t = 0; t < steps; t++)
+                measured[t] = t == 0
+                              || (t % 7 != 3 && (t < 100 || t >= 130));
+
+            using Axis = oat::ConstantVelocityKalman::Axis;
+            std::vector<Axis> fx(steps), fy(steps), px(steps), py(steps);
+            std::vector<DenseKalman> filtered, predicted;
+
+            Axis ax, ay;
+            ax.x = zx[0];
+            ay.x = zy[0];
+            ax.p00 = ax.p11 = ay.p00 = ay.p11 = 1000.0;
+            DenseKalman ref(m, zx[0], zy[0], 1000.0);
+
+            for (size_t t = 0; t < steps; t++) {
+                oat::ConstantVelocityKalman::predict(ax, m);
+                oat::ConstantVelocityKalman::predict(ay, m);
+                ref.predict();
+                px[t] = ax;
+                py[t] = ay;
+                predicted.push_back(ref);
+
+                if (measured[t]) {
+                    oat::ConstantVelocityKalman::correct(ax, m, zx[t]);
+                    oat::ConstantVelocityKalman::correct(ay, m, zy[t]);
+                    ref.correct(zx[t], zy[t]);
+                }
+                fx[t] = ax;
+                fy[t] = ay;
+                filtered.push_back(ref);
+            }
+
+            const std::vector<Axis> causal_x = fx;
+            for (size_t t = steps - 1; t-- > 0;) {
+                oat::ConstantVelocityKalman::smooth(
+                    fx[t], m, px[t + 1], fx[t + 1]);
+                oat::ConstantVelocityKalman::smooth(
+                    fy[t], m, py[t + 1], fy[t + 1]);
+                filtered[t].smooth(predicted[t + 1], filtered[t + 1].s);
+            }
+
+            bool agree = true;
+            double moved = 0;
+            for (size_t t = 0; t < steps; t++) {
+                const double got[4] {fx[t].x, fx[t].v, fy[t].x, fy[t].v};
+                for (int i = 0; i < 4; i++)
+                    agree &= std::abs(got[i] - filtered[t].s[i]) <= tol;
+                moved = std::max(moved, std::abs(fx[t].x - causal_x[t].x));
+            }
+
+            THEN ("Their smoothed states agree at every step") {
+                REQUIRE (moved > 0.1);
+                REQUIRE (agree);
+            }
+        }
+    }
+}
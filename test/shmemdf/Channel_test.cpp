@@ -0,0 +1,178 @@
+//******************************************************************************
+//* File:   Channel_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstring>
+#include <future>
+#include <string>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "../../lib/shmemdf/Channel.h"
+#include "../../lib/shmemdf/SharedFrameHeader.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+namespace bip = boost::interprocess;
+
+const std::string node_addr {"test_channel"};
+
+static bool inSharedMemory(const std::string &name)
+{
+    try {
+        bip::shared_memory_object shm(bip::open_only, name.c_str(), bip::read_only);
+        return true;
+    } catch (const bip::interprocess_exception &) {
+        return false;
+    }
+}
+
+SCENARIO ("Channels grow without moving.", "[Channel]") {
+
+    GIVEN ("A new channel") {
+
+        oat::Channel channel;
+
+        WHEN ("it is grown") {
+
+            channel.resize(4096);
+            std::memset(channel.base(), 0x5a, 4096);
+            auto base = channel.base();
+            channel.resize(1 << 20);
+
+            THEN ("Its memory stays where it was and keeps its contents") {
+                REQUIRE (channel.base() == base);
+                REQUIRE (channel.size() == 1 << 20);
+                REQUIRE (channel.base()[4095] == 0x5a);
+                REQUIRE (channel.base()[(1 << 20) - 1] == 0);
+            }
+
+            AND_THEN ("It cannot shrink") {
+                channel.resize(64);
+                REQUIRE (channel.size() == 1 << 20);
+            }
+        }
+
+        THEN ("It cannot grow past its reservation") {
+            REQUIRE_THROWS (channel.resize(oat::Channel::RESERVE_BYTES + 1));
+        }
+    }
+}
+
+SCENARIO ("Nodes declared in-process are held in channels.", "[Channel]") {
+
+    GIVEN ("An address declared in-process") {
+
+        oat::Channel::declare(node_addr);
+
+        WHEN ("a sink binds it and a source connects") {
+
+            oat::Sink<int> sink;
+            sink.bind(node_addr);
+
+            oat::Source<int> source;
+            source.touch(node_addr);
+            source.connect();
+
+            THEN ("Nothing is made in shared memory") {
+                REQUIRE (oat::Channel::find(node_addr + "_node") != nullptr);
+                REQUIRE_FALSE (inSharedMemory(node_addr + "_node"));
+            }
+
+            AND_THEN ("The sink and source share the object") {
+                *sink.retrieve() = 42;
+                REQUIRE (source.retrieve() == sink.retrieve());
+                REQUIRE (*source.retrieve() == 42);
+            }
+
+            AND_THEN ("Writes are handed over as through a segment") {
+
+                auto reader = std::async(std::launch::async, [&source] {
+                    int sum = 0;
+                    for (int i = 0; i < 100; i++) {
+                        source.wait();
+                        sum += *source.retrieve();
+                        source.post();
+                    }
+                    return sum;
+                });
+
+                for (int i = 1; i <= 100; i++) {
+                    sink.wait();
+                    *sink.retrieve() = i;
+                    sink.post();
+                }
+
+                REQUIRE (reader.get() == 5050);
+            }
+        }
+
+        WHEN ("a frame sink binds it and grows its frames") {
+
+            oat::Sink<oat::Frame> sink;
+            sink.bind(node_addr, 10 * 10);
+            sink.retrieve(10, 10, 0, oat::PIX_GREY);
+
+            oat::Source<oat::Frame> source;
+            source.touch(node_addr);
+            source.connect();
+
+            sink.wait();
+            auto frame = sink.reformat(1000, 1000, 0, oat::PIX_GREY);
+            frame.data[1000 * 1000 - 1] = 7;
+            sink.post();
+
+            THEN ("The source reads the grown frame in place") {
+                source.wait();
+                REQUIRE (source.borrow().data == frame.data);
+                REQUIRE (source.borrow().rows == 1000);
+                REQUIRE (source.borrow().data[1000 * 1000 - 1] == 7);
+                source.post();
+            }
+        }
+
+        WHEN ("its components leave") {
+
+            {
+                oat::Sink<int> sink;
+                sink.bind(node_addr);
+            }
+
+            THEN ("The channel is removed with them") {
+                REQUIRE (oat::Channel::find(node_addr + "_node") == nullptr);
+            }
+        }
+    }
+
+    GIVEN ("An address that is not declared in-process") {
+
+        oat::Sink<int> sink;
+        sink.bind("test_channel_shmem");
+
+        THEN ("Its node is made in shared memory") {
+            REQUIRE (inSharedMemory("test_channel_shmem_node"));
+            REQUIRE (oat::Channel::find("test_channel_shmem_node") == nullptr);
+        }
+    }
+}
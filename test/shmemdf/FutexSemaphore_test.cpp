@@ -0,0 +1,131 @@
+//******************************************************************************
+//* File:   FutexSemaphore_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <boost/thread/thread_time.hpp>
+
+#include "../../lib/shmemdf/FutexSemaphore.h"
+
+using msec = std::chrono::milliseconds;
+
+SCENARIO ("FutexSemaphores count posts and waits.", "[FutexSemaphore]") {
+
+    GIVEN ("A FutexSemaphore with an initial count of 2") {
+
+        oat::FutexSemaphore sem(2);
+
+        THEN ("Two waits succeed without blocking and a third does not") {
+            REQUIRE (sem.try_wait());
+            REQUIRE (sem.try_wait());
+            REQUIRE_FALSE (sem.try_wait());
+        }
+
+        WHEN ("The count is exhausted and the semaphore is posted") {
+
+            sem.wait();
+            sem.wait();
+            sem.post();
+
+            THEN ("A single wait succeeds") {
+                REQUIRE (sem.try_wait());
+                REQUIRE_FALSE (sem.try_wait());
+            }
+        }
+    }
+}
+
+SCENARIO ("FutexSemaphore waits block until a post.", "[FutexSemaphore]") {
+
+    GIVEN ("A FutexSemaphore with an initial count of 0") {
+
+        oat::FutexSemaphore sem(0);
+
+        WHEN ("A thread waits on the semaphore") {
+
+            auto fut = std::async(std::launch::async, [&sem]{ sem.wait(); });
+
+            THEN ("The thread shall block until the semaphore is posted") {
+
+                std::this_thread::sleep_for(msec(5));
+                auto status = fut.wait_for(msec(0));
+                REQUIRE (status != std::future_status::ready);
+
+                sem.post();
+
+                status = fut.wait_for(msec(100));
+                REQUIRE (status == std::future_status::ready);
+            }
+        }
+
+        WHEN ("A thread waits on the semaphore with a deadline") {
+
+            auto deadline = boost::get_system_time()
+                            + boost::posix_time::milliseconds(5);
+
+            THEN ("The wait shall time out") {
+                REQUIRE_FALSE (sem.timed_wait(deadline));
+                REQUIRE (boost::get_system_time() >= deadline);
+            }
+        }
+
+        WHEN ("A thread waits on the semaphore for a while") {
+
+            THEN ("The wait shall time out after that while") {
+                const auto start = std::chrono::steady_clock::now();
+                REQUIRE_FALSE (sem.wait_for(msec(20)));
+                REQUIRE (std::chrono::steady_clock::now() - start >= msec(20));
+            }
+
+            THEN ("A post shall end the wait early") {
+                auto fut = std::async(std::launch::async,
+                                      [&sem]{ return sem.wait_for(msec(5000)); });
+
+                std::this_thread::sleep_for(msec(5));
+                sem.post();
+
+                REQUIRE (fut.wait_for(msec(1000)) == std::future_status::ready);
+                REQUIRE (fut.get());
+            }
+        }
+
+        WHEN ("Many posts race with many waits") {
+
+            const int n = 10000;
+            auto waiter = std::async(std::launch::async, [&sem, n] {
+                for (int i = 0; i < n; i++)
+                    sem.wait();
+            });
+
+            for (int i = 0; i < n; i++)
+                sem.post();
+
+            THEN ("No post is lost") {
+                auto status = waiter.wait_for(std::chrono::seconds(5));
+                REQUIRE (status == std::future_status::ready);
+                REQUIRE_FALSE (sem.try_wait());
+            }
+        }
+    }
+}
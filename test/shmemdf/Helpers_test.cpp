@@ -21,6 +21,7 @@
 #include <catch.hpp>
 
 #include "../../lib/shmemdf/Helpers.h"
+#include "../../lib/shmemdf/Sink.h"
 
 // Global via extern in Globals.h
 namespace oat { volatile sig_atomic_t quit = 0; }
@@ -58,3 +59,168 @@ SCENARIO ("Sample period comparisons with epsilon tolerance.", "[Helpers]") {
         }
     }
 }
+
+SCENARIO ("waitAll() reads every source in a list.", "[Helpers]") {
+
+    GIVEN ("Two bound Sink<int>s and a list of connected sources") {
+
+        oat::Sink<int> sink0, sink1;
+        sink0.bind("helpers0");
+        sink1.bind("helpers1");
+
+        oat::NamedSourceList<int> sources;
+        sources.push_back(oat::NamedSource<int>(
+            "helpers0", oat::make_unique<oat::Source<int>>()));
+        sources.push_back(oat::NamedSource<int>(
+            "helpers1", oat::make_unique<oat::Source<int>>()));
+
+        for (auto &s : sources) {
+            s.source->touch(s.name);
+            s.source->connect();
+        }
+
+        std::vector<int> samples(2, 0);
+
+        WHEN ("The sinks write in the reverse order of the list") {
+
+            sink1.wait();
+            *sink1.retrieve() = 1;
+            sink1.post();
+
+            sink0.wait();
+            *sink0.retrieve() = 42;
+            sink0.post();
+
+            THEN ("waitAll() copies out the sample from each source") {
+                REQUIRE( oat::waitAll(sources, samples) == oat::NodeState::SINK_BOUND );
+                REQUIRE( samples[0] == 42 );
+                REQUIRE( samples[1] == 1 );
+            }
+        }
+    }
+}
+
+SCENARIO ("GenericSources read the samples of nodes of any type.", "[Helpers]") {
+
+    GIVEN ("A Sink<Frame> of 4x4 grey frames and a connected GenericSource") {
+
+        oat::Sink<oat::Frame> sink;
+        sink.bind("generic", 16);
+        auto frame = sink.retrieve(4, 4, CV_8UC1, oat::PIX_GREY);
+
+        oat::GenericSource source;
+        source.touch("generic");
+        source.connect();
+
+        THEN ("The source finds the node's type from its layout") {
+            REQUIRE( source.type() == oat::TokenType::Frame );
+        }
+
+        WHEN ("The sink writes sample 7 of a frame") {
+
+            sink.wait();
+            for (int i = 0; i < 16; i++)
+                frame.data[i] = static_cast<uint8_t>(i);
+            oat::Sample sample;
+            sample.set_count(7);
+            frame.set_sample(sample);
+            sink.post();
+
+            source.wait();
+
+            THEN ("The source reads its pixels and sample in place") {
+                auto r = source.record();
+                REQUIRE( r.bytes == 16 );
+                REQUIRE( static_cast<const uint8_t *>(r.data)[0] == 0 );
+                REQUIRE( static_cast<const uint8_t *>(r.data)[15] == 15 );
+                REQUIRE( source.sample().count() == 7 );
+            }
+
+            source.post();
+        }
+    }
+
+    GIVEN ("A double-buffered Sink<Position2D> and a connected GenericSource") {
+
+        oat::Sink<oat::Position2D> sink;
+        sink.bind("generic", "anterior", 2);
+
+        oat::GenericSource source;
+        source.touch("generic");
+        source.connect();
+
+        WHEN ("The sink writes samples 1 and 2") {
+
+            for (uint64_t i = 1; i <= 2; i++) {
+                oat::Position2D pos("ignored");
+                oat::Sample sample;
+                sample.set_count(i);
+                pos.set_sample(sample);
+                pos.position_valid = true;
+                pos.position = oat::Point2D(i, 0);
+                sink.wait();
+                sink.write(pos);
+                sink.post();
+            }
+
+            THEN ("The source reads each record in turn") {
+
+                REQUIRE( source.type() == oat::TokenType::Position );
+
+                for (uint64_t i = 1; i <= 2; i++) {
+                    source.wait();
+                    std::vector<char> bytes;
+                    source.copyRecord(bytes);
+                    REQUIRE( bytes.size() == sizeof(oat::PositionRecord) );
+                    const auto &rec
+                        = *reinterpret_cast<const oat::PositionRecord *>(bytes.data());
+                    REQUIRE( rec.position[0] == i );
+                    REQUIRE( source.sample().count() == i );
+                    source.post();
+                }
+            }
+        }
+    }
+
+    GIVEN ("A Sink<int> and a connected GenericSource") {
+
+        oat::Sink<int> sink;
+        sink.bind("generic");
+
+        oat::GenericSource source;
+        source.touch("generic");
+        source.connect();
+
+        WHEN ("The sink writes 42") {
+
+            sink.wait();
+            *sink.retrieve() = 42;
+            sink.post();
+            source.wait();
+
+            THEN ("The source reads the whole object, which has no sample") {
+                REQUIRE( source.type() == oat::TokenType::Any );
+                REQUIRE( source.record().bytes == sizeof(int) );
+                REQUIRE( *static_cast<const int *>(source.record().data) == 42 );
+                REQUIRE_THROWS( source.sample() );
+            }
+
+            source.post();
+        }
+    }
+
+    GIVEN ("A view of a frame node") {
+
+        oat::Sink<oat::Frame> sink, view;
+        sink.bind("generic", 16);
+        sink.retrieve(4, 4, CV_8UC1, oat::PIX_GREY);
+        view.bindView("generic_view", "generic", cv::Rect(0, 0, 2, 2));
+
+        oat::GenericSource source;
+        source.touch("generic_view");
+
+        THEN ("A GenericSource refuses to connect to it") {
+            REQUIRE_THROWS( source.connect() );
+        }
+    }
+}
@@ -0,0 +1,155 @@
+//******************************************************************************
+//* File:   MemoryPolicy_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstdlib>
+#include <string>
+
+#include "../../lib/shmemdf/MemoryPolicy.h"
+#include "../../lib/shmemdf/SharedFrameHeader.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+SCENARIO ("Memory policies are read from the environment.", "[MemoryPolicy]") {
+
+    GIVEN ("No policy variables") {
+
+        unsetenv("OAT_HUGE_PAGES");
+        unsetenv("OAT_PREFAULT");
+        unsetenv("OAT_NUMA_NODE");
+
+        THEN ("The default policy does nothing special") {
+            auto p = oat::MemoryPolicy::fromEnvironment();
+            REQUIRE_FALSE (p.huge_pages);
+            REQUIRE_FALSE (p.prefault);
+            REQUIRE (p.numa_node == -1);
+            REQUIRE (p.segmentBytes(1000) == 1000);
+        }
+    }
+
+    GIVEN ("Huge pages, prefaulting and a NUMA node are requested") {
+
+        setenv("OAT_HUGE_PAGES", "1", 1);
+        setenv("OAT_PREFAULT", "1", 1);
+        setenv("OAT_NUMA_NODE", "1", 1);
+
+        THEN ("The policy reflects the request") {
+            auto p = oat::MemoryPolicy::fromEnvironment();
+            REQUIRE (p.huge_pages);
+            REQUIRE (p.prefault);
+            REQUIRE (p.numa_node == 1);
+        }
+
+        AND_THEN ("Segments are rounded up to whole huge pages") {
+            auto p = oat::MemoryPolicy::fromEnvironment();
+            const size_t huge = oat::MemoryPolicy::HUGE_PAGE_SIZE;
+            REQUIRE (p.segmentBytes(1) == huge);
+            REQUIRE (p.segmentBytes(huge) == huge);
+            REQUIRE (p.segmentBytes(huge + 1) == 2 * huge);
+        }
+
+        unsetenv("OAT_HUGE_PAGES");
+        unsetenv("OAT_PREFAULT");
+        unsetenv("OAT_NUMA_NODE");
+    }
+
+    GIVEN ("An invalid NUMA node") {
+
+        setenv("OAT_NUMA_NODE", "any", 1);
+
+        THEN ("Reading the policy shall throw") {
+            REQUIRE_THROWS( oat::MemoryPolicy::fromEnvironment() );
+        }
+
+        unsetenv("OAT_NUMA_NODE");
+    }
+}
+
+SCENARIO ("Prefaulted frame segments keep their contents.", "[MemoryPolicy]") {
+
+    GIVEN ("A frame sink bound with prefaulting enabled") {
+
+        setenv("OAT_PREFAULT", "1", 1);
+
+        oat::Sink<oat::Frame> sink;
+        sink.bind("test", 100 * 100);
+        unsetenv("OAT_PREFAULT");
+
+        THEN ("The segment remains usable") {
+            oat::Frame frame;
+            REQUIRE_NOTHROW( frame = sink.retrieve(100, 100, 0, oat::PIX_GREY); );
+        }
+    }
+}
+
+SCENARIO ("Shared frame data is aligned and rows can be padded.", "[MemoryPolicy]") {
+
+    GIVEN ("A frame sink") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Frame frame;
+        const size_t align = oat::MemoryPolicy::DATA_ALIGNMENT;
+
+        WHEN ("Rows are not padded") {
+
+            sink.bind("test", 100 * 100);
+            frame = sink.retrieve(100, 100, 0, oat::PIX_GREY);
+
+            THEN ("Data is aligned and rows are packed") {
+                REQUIRE (reinterpret_cast<uintptr_t>(frame.data) % align == 0);
+                REQUIRE (frame.step == 100);
+            }
+        }
+
+        WHEN ("Rows are padded") {
+
+            setenv("OAT_PAD_ROWS", "1", 1);
+            sink.bind("test", 100 * 1000);
+            unsetenv("OAT_PAD_ROWS");
+            frame = sink.retrieve(100, 1000, 0, oat::PIX_GREY);
+
+            THEN ("Data is aligned and each row starts on an aligned address") {
+                REQUIRE (reinterpret_cast<uintptr_t>(frame.data) % align == 0);
+                REQUIRE (frame.step == 1024);
+            }
+
+            AND_THEN ("Sources rebuild frames with the padded stride") {
+                oat::Source<oat::Frame> source;
+                source.touch("test");
+                source.connect();
+                REQUIRE (source.parameters().step == 1024);
+                REQUIRE (source.retrieve()->step == 1024);
+            }
+        }
+
+        WHEN ("A stride is requested that does not fit the bound size") {
+
+            sink.bind("test", 100 * 100);
+
+            THEN ("Retrieving the frame shall throw") {
+                REQUIRE_THROWS( frame = sink.retrieve(100, 100, 0, oat::PIX_GREY, 128); );
+            }
+        }
+    }
+}
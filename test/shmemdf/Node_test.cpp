@@ -20,31 +20,52 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include <cstdlib>
+#include <new>
+#include <vector>
+
 #include "../../lib/shmemdf/Node.h"
 
 // Global via extern in Globals.h
 namespace oat { volatile sig_atomic_t quit = 0; }
 
-SCENARIO ("Nodes can accept up to Node::NUM_SLOTS sources.", "[Node]") {
+SCENARIO ("Nodes can accept up to Node::max_sources() sources.", "[Node]") {
 
-    GIVEN ("A fresh Node") {
+    GIVEN ("A fresh Node with room for 10 sources") {
 
-        oat::Node node;
+        std::vector<char> mem(oat::Node::bytes(10));
+        auto &node = *new (mem.data()) oat::Node(10);
+        REQUIRE (node.max_sources() == 10);
         REQUIRE (node.source_ref_count() == 0);
         REQUIRE (node.sink_state() == oat::NodeState::UNDEFINED);
 
-        WHEN ("Node::NUM_SLOTS+1 sources are added") {
+        WHEN ("Node::max_sources()+1 sources are added") {
 
             THEN ("The Node shall return normal exit codes until the 11th") {
-                for (size_t i = 0; i <= oat::Node::NUM_SLOTS; i++) {
-                    if (i < oat::Node::NUM_SLOTS)
-                        REQUIRE (node.acquireSlot(i) == 0);
+                size_t idx;
+                for (size_t i = 0; i <= node.max_sources(); i++) {
+                    if (i < node.max_sources())
+                        REQUIRE (node.acquireSlot(idx) == 0);
                     else
-                        REQUIRE (node.acquireSlot(i) < 0);
+                        REQUIRE (node.acquireSlot(idx) < 0);
                 }
             }
         }
 
+        WHEN ("a source is released") {
+
+            size_t idx;
+            for (size_t i = 0; i < node.max_sources(); i++)
+                node.acquireSlot(idx);
+            node.releaseSlot(3);
+
+            THEN ("its slot is reused by the next source") {
+                REQUIRE (node.source_ref_count() == 9);
+                REQUIRE (node.acquireSlot(idx) == 0);
+                REQUIRE (idx == 3);
+            }
+        }
+
         WHEN ("a source is removed") {
 
             node.releaseSlot(0);
@@ -58,7 +79,7 @@ SCENARIO ("Nodes can accept up to Node::NUM_SLOTS sources.", "[Node]") {
 
             THEN ("The Node shall throw") {
                 REQUIRE_THROWS(
-                    boost::interprocess::interprocess_semaphore &s = node.read_barrier(-1);
+                    oat::Node::semaphore &s = node.read_barrier(-1);
                 );
             }
         }
@@ -70,9 +91,328 @@ SCENARIO ("Nodes can accept up to Node::NUM_SLOTS sources.", "[Node]") {
 
             THEN ("reading a greater indexed read-barrier shall throw") {
                 REQUIRE_THROWS(
-                boost::interprocess::interprocess_semaphore &s = node.read_barrier(idx+1);
+                oat::Node::semaphore &s = node.read_barrier(idx+1);
                 );
             }
         }
     }
 }
+
+SCENARIO ("Best-effort sources hold a slot that the sink never waits for.", "[Node]") {
+
+    GIVEN ("A Node with one SYNC and one best-effort source") {
+
+        std::vector<char> mem(oat::Node::bytes(4));
+        auto &node = *new (mem.data()) oat::Node(4);
+
+        size_t sync_idx, best_idx;
+        node.acquireSlot(sync_idx);
+        node.acquireSlot(best_idx, true);
+
+        THEN ("Both are bound, but only the SYNC source is waited for") {
+            REQUIRE (node.source_ref_count() == 2);
+            REQUIRE (node.sync_ref_count() == 1);
+            REQUIRE_FALSE (node.best_effort(sync_idx));
+            REQUIRE (node.best_effort(best_idx));
+        }
+
+        WHEN ("the sink writes") {
+
+            node.write_barrier.try_wait();
+            node.notifySinkWriteComplete();
+
+            THEN ("both sources are woken") {
+                REQUIRE (node.read_barrier(sync_idx).try_wait());
+                REQUIRE (node.read_barrier(best_idx).try_wait());
+            }
+
+            AND_THEN ("the write is finished when the SYNC source reads") {
+                REQUIRE (node.notifySourceReadComplete(sync_idx));
+            }
+        }
+
+        WHEN ("the best-effort source records drops and is released") {
+
+            node.recordDrops(best_idx, 5);
+            REQUIRE (node.dropped(best_idx) == 5);
+            node.releaseSlot(best_idx);
+
+            THEN ("its slot starts without drops when it is reused") {
+                REQUIRE (node.sync_ref_count() == 1);
+                REQUIRE (node.acquireSlot(best_idx, true) == 0);
+                REQUIRE (node.dropped(best_idx) == 0);
+            }
+        }
+    }
+}
+
+SCENARIO ("Node source capacity is chosen when the node is created.", "[Node]") {
+
+    GIVEN ("A Node with room for 200 sources") {
+
+        std::vector<char> mem(oat::Node::bytes(200));
+        auto &node = *new (mem.data()) oat::Node(200);
+
+        WHEN ("200 sources are added") {
+
+            size_t idx;
+            for (size_t i = 0; i < 200; i++)
+                REQUIRE (node.acquireSlot(idx) == 0);
+
+            THEN ("each has its own read barrier") {
+                REQUIRE (node.source_ref_count() == 200);
+                node.notifySinkWriteComplete();
+                for (size_t i = 0; i < 200; i++)
+                    REQUIRE (node.read_barrier(i).try_wait());
+            }
+
+            AND_THEN ("the write is finished when the last source reads") {
+                node.write_barrier.try_wait();
+                node.notifySinkWriteComplete();
+                for (size_t i = 0; i < 199; i++)
+                    REQUIRE_FALSE (node.notifySourceReadComplete(i));
+                REQUIRE (node.notifySourceReadComplete(199));
+            }
+        }
+    }
+
+    GIVEN ("An out of range capacity") {
+
+        std::vector<char> mem(oat::Node::bytes(1));
+
+        THEN ("Node construction shall throw") {
+            REQUIRE_THROWS( new (mem.data()) oat::Node(0) );
+            REQUIRE_THROWS( new (mem.data())
+                            oat::Node(oat::Node::MAX_SOURCES_LIMIT + 1) );
+        }
+    }
+
+    GIVEN ("The OAT_MAX_SOURCES environment variable") {
+
+        WHEN ("it is unset") {
+            unsetenv("OAT_MAX_SOURCES");
+            THEN ("the default capacity is used") {
+                const size_t expected = oat::Node::DEFAULT_MAX_SOURCES;
+                REQUIRE (oat::Node::default_max_sources() == expected);
+            }
+        }
+
+        WHEN ("it is set to a valid capacity") {
+            setenv("OAT_MAX_SOURCES", "64", 1);
+            THEN ("that capacity is used") {
+                REQUIRE (oat::Node::default_max_sources() == 64);
+            }
+            unsetenv("OAT_MAX_SOURCES");
+        }
+
+        WHEN ("it is not a valid capacity") {
+            setenv("OAT_MAX_SOURCES", "lots", 1);
+            THEN ("requesting the capacity shall throw") {
+                REQUIRE_THROWS( oat::Node::default_max_sources() );
+            }
+            unsetenv("OAT_MAX_SOURCES");
+        }
+    }
+}
+
+SCENARIO ("Ring nodes let a sink run ahead of its sources by "
+          "Node::num_buffers() writes.", "[Node]") {
+
+    GIVEN ("A fresh Node with a single source") {
+
+        std::vector<char> mem(oat::Node::bytes(10));
+        auto &node = *new (mem.data()) oat::Node(10);
+        size_t idx;
+        node.acquireSlot(idx);
+        REQUIRE (node.num_buffers() == 1);
+
+        WHEN ("the number of buffers is out of range") {
+
+            THEN ("The Node shall throw") {
+                REQUIRE_THROWS( node.set_num_buffers(0) );
+                REQUIRE_THROWS( node.set_num_buffers(oat::Node::MAX_BUFFERS + 1) );
+            }
+        }
+
+        WHEN ("the node is given 3 buffers") {
+
+            node.set_num_buffers(3);
+
+            THEN ("The sink can write 3 times before the source reads") {
+                for (size_t i = 0; i < 3; i++) {
+                    REQUIRE (node.write_index() == i);
+                    REQUIRE (node.write_barrier.try_wait());
+                    node.notifySinkWriteComplete();
+                }
+                REQUIRE_FALSE (node.write_barrier.try_wait());
+            }
+
+            AND_THEN ("The source reads buffers in the order they were written") {
+                for (size_t i = 0; i < 3; i++) {
+                    node.write_barrier.try_wait();
+                    node.notifySinkWriteComplete();
+                }
+
+                for (size_t i = 0; i < 3; i++) {
+                    REQUIRE (node.read_index(idx) == i);
+                    REQUIRE (node.notifySourceReadComplete(idx));
+                }
+                REQUIRE (node.read_number(idx) == 3);
+            }
+
+            AND_THEN ("Buffers cannot be added after the first write") {
+                node.write_barrier.try_wait();
+                node.notifySinkWriteComplete();
+                REQUIRE_THROWS( node.set_num_buffers(4) );
+            }
+        }
+
+        WHEN ("a source with unread buffers is removed") {
+
+            node.set_num_buffers(2);
+            for (size_t i = 0; i < 2; i++) {
+                node.write_barrier.try_wait();
+                node.notifySinkWriteComplete();
+            }
+            REQUIRE_FALSE (node.write_barrier.try_wait());
+
+            node.releaseSlot(idx);
+
+            THEN ("the buffers it owed reads on are released to the sink") {
+                REQUIRE (node.write_barrier.try_wait());
+                REQUIRE (node.write_barrier.try_wait());
+                REQUIRE_FALSE (node.write_barrier.try_wait());
+            }
+        }
+    }
+}
+
+SCENARIO ("Nodes tell whether their sink or sources would block.", "[Node]") {
+
+    GIVEN ("A double-buffered Node with a SYNC and a best-effort source") {
+
+        std::vector<char> mem(oat::Node::bytes(10));
+        auto &node = *new (mem.data()) oat::Node(10);
+        size_t sync_idx, latest_idx;
+        node.acquireSlot(sync_idx);
+        node.acquireSlot(latest_idx, true);
+        node.set_num_buffers(2);
+
+        THEN ("Sources have nothing to read and the sink may write") {
+            REQUIRE_FALSE (node.readable(sync_idx));
+            REQUIRE (node.writable());
+        }
+
+        WHEN ("the sink writes both buffers") {
+
+            for (size_t i = 0; i < 2; i++) {
+                node.write_barrier.try_wait();
+                node.notifySinkWriteComplete();
+            }
+
+            THEN ("The SYNC source can read and the sink must wait for it") {
+                REQUIRE (node.readable(sync_idx));
+                REQUIRE_FALSE (node.writable());
+            }
+
+            AND_THEN ("Once it reads a buffer the sink may write again") {
+                const auto seen = node.sample_event().generation();
+                node.notifySourceReadComplete(sync_idx);
+                REQUIRE (node.readable(sync_idx));
+                REQUIRE (node.writable());
+                REQUIRE (node.sample_event().generation() != seen);
+
+                node.notifySourceReadComplete(sync_idx);
+                REQUIRE_FALSE (node.readable(sync_idx));
+            }
+        }
+
+        WHEN ("the sink leaves") {
+
+            node.set_sink_state(oat::NodeState::END);
+
+            THEN ("Sources can read the end of the stream") {
+                REQUIRE (node.readable(sync_idx));
+            }
+        }
+    }
+}
+
+SCENARIO ("Merge nodes write the samples of several sinks in count order.", "[Node]") {
+
+    GIVEN ("A merge node joined by two sinks with a reorder window of 2") {
+
+        std::vector<char> mem(oat::Node::bytes(1));
+        auto &node = *new (mem.data()) oat::Node(1);
+
+        size_t a, b;
+        REQUIRE (node.joinProducer(a, 2) == 0);
+        node.set_sink_state(oat::NodeState::SINK_BOUND);
+        REQUIRE (node.joinProducer(b, 0) == 0);
+        REQUIRE (node.merge());
+        REQUIRE (node.reorder_window() == 2);
+        REQUIRE (node.producer_count() == 2);
+
+        using Turn = oat::Node::Turn;
+
+        WHEN ("both sinks offer a sample") {
+
+            REQUIRE (node.requestTurn(b, 2) == Turn::WAIT);
+
+            THEN ("The earlier sample is written first") {
+                REQUIRE (node.requestTurn(a, 1) == Turn::GRANTED);
+                REQUIRE (node.requestTurn(b, 2) == Turn::WAIT);
+
+                node.notifySinkWriteComplete();
+                node.releaseTurn(a);
+                REQUIRE (node.requestTurn(b, 2) == Turn::GRANTED);
+            }
+        }
+
+        WHEN ("one sink lags by more than the window") {
+
+            node.requestTurn(a, 1);
+            node.notifySinkWriteComplete();
+            node.releaseTurn(a);
+
+            THEN ("The other sink no longer waits for it") {
+                REQUIRE (node.requestTurn(a, 2) == Turn::WAIT);
+                REQUIRE (node.requestTurn(a, 3) == Turn::GRANTED);
+                node.notifySinkWriteComplete();
+                node.releaseTurn(a);
+            }
+
+            AND_THEN ("Its samples behind the stream are dropped") {
+                node.requestTurn(a, 3);
+                node.notifySinkWriteComplete();
+                node.releaseTurn(a);
+
+                REQUIRE (node.requestTurn(b, 2) == Turn::STALE);
+                REQUIRE (node.merge_dropped() == 1);
+            }
+        }
+
+        WHEN ("one sink leaves") {
+
+            REQUIRE_FALSE (node.leaveProducer(b));
+
+            THEN ("The other writes without waiting, and ends the node last") {
+                REQUIRE (node.requestTurn(a, 5) == Turn::GRANTED);
+                node.cancelTurn(a);
+                REQUIRE (node.leaveProducer(a));
+            }
+        }
+    }
+
+    GIVEN ("A node bound by an ordinary sink") {
+
+        std::vector<char> mem(oat::Node::bytes(1));
+        auto &node = *new (mem.data()) oat::Node(1);
+        node.set_sink_state(oat::NodeState::SINK_BOUND);
+
+        THEN ("No sink can join it") {
+            size_t idx;
+            REQUIRE (node.joinProducer(idx, 1) < 0);
+        }
+    }
+}
@@ -0,0 +1,211 @@
+//******************************************************************************
+//* File:   PositionBus_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <string>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../../lib/datatypes/Position2D.h"
+#include "../../lib/shmemdf/PositionBus.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+using msec = std::chrono::milliseconds;
+
+const size_t capacity {oat::PositionBus::CAPACITY};
+
+const std::string bus_name {"test_position_bus"};
+
+static oat::Position2D positionAt(const double x, const double y)
+{
+    oat::Position2D p {"test"};
+    p.position = {x, y};
+    p.position_valid = true;
+    return p;
+}
+
+SCENARIO ("Position buses carry the latest position of each channel.", "[PositionBus]") {
+
+    GIVEN ("A new bus") {
+
+        boost::interprocess::shared_memory_object::remove(
+            oat::PositionBus::segmentName(bus_name).c_str());
+        oat::PositionBus bus {bus_name};
+
+        THEN ("No channel is named") {
+            REQUIRE (bus.find("a") == capacity);
+            REQUIRE (bus.name(0).empty());
+        }
+
+        THEN ("Channel names must fit in a channel") {
+            REQUIRE_THROWS (bus.claim(""));
+            REQUIRE_THROWS (bus.claim(std::string(oat::PositionBus::NAME_LEN, 'a')));
+        }
+
+        WHEN ("two channels are claimed") {
+
+            auto seen = bus.generation();
+            auto a = bus.claim("a");
+            auto b = bus.claim("b");
+
+            THEN ("They are named, distinct and the bus has changed") {
+                REQUIRE (a != b);
+                REQUIRE (bus.find("a") == a);
+                REQUIRE (bus.find("b") == b);
+                REQUIRE (bus.name(b) == "b");
+                REQUIRE (bus.generation() != seen);
+            }
+
+            THEN ("Nothing can be read from them") {
+                oat::Position2D p {"reader"};
+                REQUIRE (bus.writes(a) == 0);
+                REQUIRE (bus.read(a, p) == 0);
+            }
+
+            THEN ("Claiming a channel again returns the same channel") {
+                REQUIRE (bus.claim("a") == a);
+            }
+
+            AND_WHEN ("the bus is opened again") {
+
+                oat::PositionBus other {bus_name};
+
+                THEN ("It holds the same channels") {
+                    REQUIRE (other.find("a") == a);
+                    REQUIRE (other.find("b") == b);
+                }
+            }
+
+            AND_WHEN ("one of them is written twice") {
+
+                bus.write(b, positionAt(1, 2));
+                bus.write(b, positionAt(3, 4));
+
+                THEN ("Its latest position is read and counted") {
+                    oat::Position2D p {"reader"};
+                    REQUIRE (bus.writes(b) == 2);
+                    REQUIRE (bus.read(b, p) == 2);
+                    REQUIRE (p.position_valid);
+                    REQUIRE (p.position.x == 3);
+                    REQUIRE (p.position.y == 4);
+                }
+
+                THEN ("The other is untouched") {
+                    REQUIRE (bus.writes(a) == 0);
+                }
+
+                THEN ("The reader's label is kept") {
+                    oat::Position2D p {"reader"};
+                    bus.read(b, p);
+                    REQUIRE (std::string(p.label()) == "reader");
+                }
+            }
+        }
+
+        WHEN ("a thread waits on the bus and a channel is written") {
+
+            auto c = bus.claim("c");
+            auto seen = bus.generation();
+
+            auto fut = std::async(std::launch::async, [&bus, seen] {
+                return bus.wait(seen, msec(5000));
+            });
+
+            THEN ("The thread shall wake well before its timeout") {
+                REQUIRE (fut.wait_for(msec(50)) == std::future_status::timeout);
+                bus.write(c, positionAt(5, 6));
+                REQUIRE (fut.wait_for(msec(1000)) == std::future_status::ready);
+                REQUIRE (fut.get());
+            }
+        }
+
+        WHEN ("nothing is written") {
+
+            auto seen = bus.generation();
+
+            THEN ("A wait on the bus times out") {
+                REQUIRE_FALSE (bus.wait(seen, msec(10)));
+            }
+        }
+
+        WHEN ("the writer of a channel dies part way through a write") {
+
+            // The child claims the channel, writes it once, then writes a
+            // record it cannot read so that it faults after the write began
+            auto pid = fork();
+            if (pid == 0) {
+                oat::PositionBus child_bus {bus_name};
+                auto i = child_bus.claim("d");
+                child_bus.write(i, positionAt(1, 2));
+                void *page = mmap(nullptr, 4096, PROT_NONE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                child_bus.write(i,
+                                *static_cast<oat::PositionRecord *>(page),
+                                oat::DistanceUnit::PIXELS,
+                                cv::Matx33d::eye());
+                _exit(0);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+            auto d = bus.find("d");
+
+            THEN ("The torn position is not read") {
+                oat::Position2D p {"reader"};
+                REQUIRE (WIFSIGNALED(status));
+                REQUIRE (bus.writes(d) == 1);
+                REQUIRE (bus.read(d, p) == 0);
+            }
+
+            AND_WHEN ("the channel is taken over and written") {
+
+                REQUIRE (bus.claim("d") == d);
+                bus.write(d, positionAt(3, 4));
+                bus.write(d, positionAt(5, 6));
+
+                THEN ("Each position is read and counted") {
+                    oat::Position2D p {"reader"};
+                    REQUIRE (bus.writes(d) == 3);
+                    REQUIRE (bus.read(d, p) == 3);
+                    REQUIRE (p.position.x == 5);
+                    REQUIRE (p.position.y == 6);
+                }
+            }
+        }
+
+        WHEN ("every channel is claimed") {
+
+            for (size_t i = 0; i < capacity; i++)
+                bus.claim("ch" + std::to_string(i));
+
+            THEN ("No more can be claimed") {
+                REQUIRE_THROWS (bus.claim("more"));
+            }
+        }
+    }
+}
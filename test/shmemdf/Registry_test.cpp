@@ -0,0 +1,137 @@
+//******************************************************************************
+//* File:   Registry_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../lib/shmemdf/Node.h"
+#include "../../lib/shmemdf/Registry.h"
+#include "../../lib/shmemdf/Segment.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+const std::string segment_name {"test_registry_node"};
+
+static bool listed(const std::string &name)
+{
+    auto names = oat::Registry().names();
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+SCENARIO ("Node segments are listed while they exist.", "[Registry]") {
+
+    GIVEN ("A node segment that does not exist") {
+
+        oat::Segment::remove(segment_name);
+        oat::Registry registry;
+
+        THEN ("It is not listed") {
+            REQUIRE (!listed(segment_name));
+        }
+
+        WHEN ("a component creates it") {
+
+            auto seen = registry.generation();
+            oat::Segment segment;
+            segment.open(segment_name, 10);
+
+            THEN ("It is listed and the list has changed") {
+                REQUIRE (listed(segment_name));
+                REQUIRE (registry.generation() != seen);
+                REQUIRE (registry.awaitChange(seen, std::chrono::milliseconds(0)));
+            }
+
+            AND_WHEN ("a second component opens it") {
+
+                oat::Segment other;
+                other.open(segment_name, 10);
+
+                THEN ("It is listed once") {
+                    auto names = registry.names();
+                    REQUIRE (std::count(names.begin(), names.end(), segment_name) == 1);
+                }
+            }
+
+            AND_WHEN ("it is removed") {
+
+                oat::Segment::remove(segment_name);
+
+                THEN ("It is no longer listed") {
+                    REQUIRE (!listed(segment_name));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO ("Waiters are woken by changes to a node.", "[Registry]") {
+
+    GIVEN ("A node without a sink") {
+
+        oat::Segment::remove(segment_name);
+        oat::Segment segment;
+        auto node = segment.open(segment_name, 10);
+
+        WHEN ("nothing changes") {
+
+            auto seen = node->state_generation();
+
+            THEN ("A wait times out") {
+                REQUIRE (!node->awaitStateChange(seen, std::chrono::milliseconds(10)));
+            }
+        }
+
+        WHEN ("a source attaches") {
+
+            auto seen = node->state_generation();
+            size_t idx;
+            node->acquireSlot(idx);
+
+            THEN ("The generation advances") {
+                REQUIRE (node->state_generation() != seen);
+            }
+        }
+
+        WHEN ("the sink binds while a source waits") {
+
+            auto seen = node->state_generation();
+            bool woken = false;
+            std::thread waiter([&] {
+                woken = node->awaitStateChange(seen, std::chrono::seconds(5));
+            });
+
+            node->set_sink_state(oat::NodeState::SINK_BOUND);
+            waiter.join();
+
+            THEN ("The source is woken") {
+                REQUIRE (woken);
+                REQUIRE (node->sink_state() == oat::NodeState::SINK_BOUND);
+            }
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+}
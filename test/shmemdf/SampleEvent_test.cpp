@@ -0,0 +1,66 @@
+//******************************************************************************
+//* File:   SampleEvent_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "../../lib/shmemdf/SampleEvent.h"
+
+using msec = std::chrono::milliseconds;
+
+SCENARIO ("SampleEvents wake waiters on any of several events.", "[SampleEvent]") {
+
+    GIVEN ("Three SampleEvents and the generation of each") {
+
+        oat::SampleEvent a, b, c;
+        oat::SampleEvent *events[] {&a, &b, &c};
+        uint32_t seen[] {a.generation(), b.generation(), c.generation()};
+
+        THEN ("A wait on them times out when none is notified") {
+            REQUIRE_FALSE (oat::SampleEvent::waitAny(events, seen, 3, msec(10)));
+        }
+
+        WHEN ("One event is notified before the wait") {
+
+            b.notify();
+
+            THEN ("The wait returns immediately") {
+                REQUIRE (oat::SampleEvent::waitAny(events, seen, 3, msec(0)));
+            }
+        }
+
+        WHEN ("A thread waits on them and one is notified") {
+
+            auto fut = std::async(std::launch::async, [&events, &seen] {
+                return oat::SampleEvent::waitAny(events, seen, 3, msec(5000));
+            });
+
+            THEN ("The thread shall wake well before its timeout") {
+                REQUIRE (fut.wait_for(msec(50)) == std::future_status::timeout);
+                c.notify();
+                REQUIRE (fut.wait_for(msec(1000)) == std::future_status::ready);
+                REQUIRE (fut.get());
+            }
+        }
+    }
+}
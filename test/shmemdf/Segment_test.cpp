@@ -0,0 +1,254 @@
+//******************************************************************************
+//* File:   Segment_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstring>
+#include <string>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../../lib/shmemdf/MemoryPolicy.h"
+#include "../../lib/shmemdf/Segment.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+namespace bip = boost::interprocess;
+
+const std::string segment_name {"test_segment_node"};
+
+SCENARIO ("Nodes are found at fixed offsets in a single segment.", "[Segment]") {
+
+    GIVEN ("A segment opened before the sink binds") {
+
+        oat::Segment::remove(segment_name);
+        oat::Segment source_side;
+        auto node = source_side.open(segment_name, 10);
+
+        THEN ("It holds only the node and its reader table") {
+            REQUIRE (node->max_sources() == 10);
+            REQUIRE (source_side.size() == oat::Segment::sync_bytes(10));
+        }
+
+        WHEN ("a second component opens it") {
+
+            oat::Segment other;
+            auto other_node = other.open(segment_name, 20);
+
+            THEN ("It shares the first component's node") {
+                REQUIRE (other_node->max_sources() == 10);
+                size_t idx;
+                REQUIRE (node->acquireSlot(idx) == 0);
+                REQUIRE (other_node->source_ref_count() == 1);
+            }
+        }
+
+        WHEN ("a sink binds it with a payload") {
+
+            oat::Segment sink_side;
+            sink_side.open(segment_name, 10);
+            auto obj = sink_side.bind<int>(4096, oat::MemoryPolicy(), 42);
+            std::memset(sink_side.payload(), 0x5a, 4096);
+
+            THEN ("The shared object and payload are mapped by connect()") {
+                REQUIRE (obj != nullptr);
+                auto seen = source_side.connect<int>(false);
+                REQUIRE (seen != nullptr);
+                REQUIRE (*seen == 42);
+                REQUIRE (static_cast<char *>(source_side.payload())[4095] == 0x5a);
+            }
+
+            AND_THEN ("Handles resolve to the same memory on both sides") {
+                auto h = sink_side.handle(sink_side.payload());
+                source_side.connect<int>(true);
+                REQUIRE (source_side.address(h) == source_side.payload());
+            }
+
+            AND_THEN ("The node survives mapping the grown segment") {
+                size_t idx;
+                node->acquireSlot(idx);
+                source_side.connect<int>(false);
+                REQUIRE (source_side.node()->source_ref_count() == 1);
+                REQUIRE (sink_side.node()->source_ref_count() == 1);
+            }
+
+            AND_THEN ("A second sink cannot claim the node") {
+                oat::Segment late;
+                late.open(segment_name, 10);
+                REQUIRE (late.bind<int>(0, oat::MemoryPolicy(), 0) == nullptr);
+            }
+
+            AND_THEN ("A different shared object type does not connect") {
+                REQUIRE (source_side.connect<float>(false) == nullptr);
+            }
+        }
+
+        WHEN ("a bound sink grows it") {
+
+            oat::Segment sink_side;
+            sink_side.open(segment_name, 10);
+            auto obj = sink_side.bind<int>(64, oat::MemoryPolicy(), 7);
+            source_side.connect<int>(false);
+
+            const size_t before = sink_side.size();
+            auto h = sink_side.grow(1 << 20, oat::MemoryPolicy());
+            std::memset(sink_side.address(h), 0x3c, 1 << 20);
+
+            THEN ("Pointers into the earlier mapping stay valid") {
+                REQUIRE (sink_side.size() >= before + (1 << 20));
+                REQUIRE (*obj == 7);
+            }
+
+            AND_THEN ("Sources see the new payload once they update") {
+                REQUIRE (source_side.size() == before);
+                source_side.update(false);
+                REQUIRE (source_side.size() == sink_side.size());
+                auto p = static_cast<char *>(source_side.address(h));
+                REQUIRE (p[0] == 0x3c);
+                REQUIRE (p[(1 << 20) - 1] == 0x3c);
+            }
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+}
+
+SCENARIO ("Segments can be observed read-only.", "[Segment]") {
+
+    GIVEN ("No segment") {
+
+        oat::Segment::remove(segment_name);
+
+        THEN ("Observing it finds no node") {
+            oat::Segment observer;
+            REQUIRE (observer.observe(segment_name) == nullptr);
+        }
+    }
+
+    GIVEN ("A node with a bound source") {
+
+        oat::Segment::remove(segment_name);
+        oat::Segment segment;
+        size_t idx;
+        segment.open(segment_name, 4)->acquireSlot(idx);
+
+        THEN ("An observer sees its reader table") {
+            oat::Segment observer;
+            auto node = observer.observe(segment_name);
+            REQUIRE (node != nullptr);
+            REQUIRE (node->max_sources() == 4);
+            REQUIRE (node->slot_bound(idx));
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+}
+
+SCENARIO ("Segments that are not Oat nodes are rejected.", "[Segment]") {
+
+    GIVEN ("A segment of the right size filled with something else") {
+
+        oat::Segment::remove(segment_name);
+        {
+            bip::shared_memory_object shm(
+                    bip::create_only, segment_name.c_str(), bip::read_write);
+            shm.truncate(oat::Segment::sync_bytes(4));
+            bip::mapped_region region(shm, bip::read_write);
+            std::memset(region.get_address(), 0xff, region.get_size());
+        }
+
+        THEN ("Opening it shall throw") {
+            oat::Segment segment;
+            REQUIRE_THROWS( segment.open(segment_name, 4) );
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+}
+
+// Run f in a child process that exits without any clean up, as though it
+// had crashed
+template <typename F>
+static void crashAfter(F f)
+{
+    auto pid = fork();
+    if (pid == 0) {
+        f();
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+SCENARIO ("Segments left by processes that exited are reclaimed.", "[Segment]") {
+
+    GIVEN ("A node whose sink exited without removing it") {
+
+        oat::Segment::remove(segment_name);
+        crashAfter([] {
+            oat::Segment sink_side;
+            sink_side.open(segment_name, 4);
+            sink_side.bind<int>(4096, oat::MemoryPolicy(), 42);
+        });
+
+        WHEN ("another component opens it") {
+
+            oat::Segment segment;
+            segment.open(segment_name, 4);
+
+            THEN ("It is made again and can be bound by a new sink") {
+                REQUIRE (segment.size() == oat::Segment::sync_bytes(4));
+                REQUIRE (segment.bind<int>(0, oat::MemoryPolicy(), 7) != nullptr);
+            }
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+
+    GIVEN ("A node holding the slot of a source that exited") {
+
+        oat::Segment::remove(segment_name);
+        oat::Segment segment;
+        auto node = segment.open(segment_name, 4);
+        crashAfter([] {
+            oat::Segment source_side;
+            size_t idx;
+            source_side.open(segment_name, 4)->acquireSlot(idx);
+        });
+
+        REQUIRE (node->source_ref_count() == 1);
+
+        WHEN ("another component opens it") {
+
+            oat::Segment other;
+            other.open(segment_name, 4);
+
+            THEN ("The slot is released") {
+                REQUIRE (node->source_ref_count() == 0);
+                REQUIRE (node->sync_ref_count() == 0);
+            }
+        }
+
+        oat::Segment::remove(segment_name);
+    }
+}
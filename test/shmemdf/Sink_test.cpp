@@ -20,7 +20,12 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "../../lib/datatypes/Color.h"
 #include "../../lib/shmemdf/SharedFrameHeader.h"
@@ -183,3 +188,83 @@ SCENARIO ("Sink<SharedFrameHeader> must bind() before waiting, posting, or alloc
         }
     }
 }
+
+SCENARIO ("Sink<SharedFrameHeader> only lends its shared frame between wait() and post().", "[Sink, SharedFrameHeader]") {
+
+    GIVEN ("A bound Sink<SharedFrameHeader> with an allocated frame") {
+
+        oat::Sink<oat::Frame> sink;
+        sink.bind(node_addr, 100 * 100);
+        oat::Frame shared = sink.retrieve(100, 100, 0, oat::PIX_GREY);
+        oat::Frame borrowed;
+
+        WHEN ("When the sink calls borrow() before calling wait()") {
+
+            THEN ("The the sink shall throw") {
+                REQUIRE_THROWS( borrowed = sink.borrow(); );
+            }
+        }
+
+        WHEN ("When the sink calls borrow() after calling wait()") {
+
+            sink.wait();
+
+            THEN ("The sink lends the shared frame itself") {
+                REQUIRE_NOTHROW( borrowed = sink.borrow(); );
+                REQUIRE( borrowed.data == shared.data );
+                sink.post();
+            }
+        }
+    }
+}
+
+SCENARIO ("Sink<SharedFrameHeader> stamps each frame it publishes.", "[Sink, SharedFrameHeader]") {
+
+    GIVEN ("A bound Sink<SharedFrameHeader> with an allocated frame") {
+
+        oat::Sink<oat::Frame> sink;
+        sink.bind(node_addr, 10 * 10);
+        oat::Frame shared = sink.retrieve(10, 10, 0, oat::PIX_GREY);
+
+        WHEN ("The sink captures and posts a frame") {
+
+            sink.wait();
+            shared.incrementSampleCount();
+            sink.post();
+
+            THEN ("The frame carries its capture time and one stage stamp") {
+                auto s = shared.sample();
+                REQUIRE( s.capture_ns() > 0 );
+                REQUIRE( s.num_stamps() == 1 );
+                REQUIRE( s.stamp_ns(0) >= s.capture_ns() );
+            }
+        }
+    }
+}
+
+SCENARIO ("A prefaulting Sink<SharedFrameHeader> faults in its frames when it binds.", "[Sink, SharedFrameHeader]") {
+
+    GIVEN ("A Sink<SharedFrameHeader> asked to prefault") {
+
+        oat::Sink<oat::Frame> sink;
+        sink.set_prefault(true);
+
+        WHEN ("The sink binds and allocates a frame") {
+
+            const size_t rows {512}, cols {512};
+            sink.bind(node_addr, rows * cols, 2);
+            oat::Frame shared = sink.retrieve(rows, cols, 0, oat::PIX_GREY);
+
+            THEN ("Every page of the frame is resident before it is written") {
+                const auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+                const auto begin = reinterpret_cast<uintptr_t>(shared.data) / page * page;
+                const auto end = reinterpret_cast<uintptr_t>(shared.data) + rows * cols;
+                std::vector<unsigned char> resident((end - begin + page - 1) / page);
+                REQUIRE( mincore(reinterpret_cast<void *>(begin), end - begin,
+                                 resident.data()) == 0 );
+                for (const auto r : resident)
+                    REQUIRE( (r & 1) == 1 );
+            }
+        }
+    }
+}
@@ -20,8 +20,12 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 
+#include "../../lib/datatypes/PositionArray.h"
 #include "../../lib/shmemdf/SharedFrameHeader.h"
 #include "../../lib/shmemdf/Sink.h"
 #include "../../lib/shmemdf/Source.h"
@@ -31,17 +35,20 @@ namespace oat { volatile sig_atomic_t quit = 0; }
 
 const std::string node_addr = "test";
 
-SCENARIO ("Up to 10 sources can connect a single Node.", "[Source]") {
+SCENARIO ("Up to OAT_MAX_SOURCES sources can connect a single Node.", "[Source]") {
 
     GIVEN ("11 sources and a bound sink with common node address") {
 
+        INFO ("The node is limited to 10 sources");
+        setenv("OAT_MAX_SOURCES", "10", 1);
+
         oat::Sink<int> sink;
 
         INFO ("The sink binds a node");
         sink.bind(node_addr);
         oat::Source<int> s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10;
 
-        WHEN ("sources 0 to Oat::Node:NUM_SLOTS connect a node") {
+        WHEN ("sources 0 to OAT_MAX_SOURCES connect a node") {
 
             THEN ("The first 10 connections will succeed") {
                 REQUIRE_NOTHROW(
@@ -69,7 +76,7 @@ SCENARIO ("Up to 10 sources can connect a single Node.", "[Source]") {
                 );
             }
 
-            AND_THEN ("The oat::Node:NUM_SLOTS+1 connection shall throw") {
+            AND_THEN ("The OAT_MAX_SOURCES+1 connection shall throw") {
                 REQUIRE_THROWS(
                     s0.touch(node_addr);
                     s1.touch(node_addr);
@@ -97,6 +104,8 @@ SCENARIO ("Up to 10 sources can connect a single Node.", "[Source]") {
                 );
             }
         }
+
+        unsetenv("OAT_MAX_SOURCES");
     }
 }
 
@@ -214,5 +223,545 @@ SCENARIO ("Connected sources can retrieve shared objects to mutate them.", "[Sou
     }
 }
 
+SCENARIO ("Frame sources can read the latest completed frame of a ring.", "[Source, SharedFrameHeader]") {
+
+    GIVEN ("A double-buffered Sink<Frame> and a connected Source<Frame>") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, 10 * 10, 2);
+        sink.retrieve(10, 10, 0, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+        REQUIRE( source.latest_index() == 0 );
+
+        WHEN ("The sink writes two frames before the source reads") {
+
+            for (uint8_t i = 0; i < 2; i++) {
+                sink.wait();
+                sink.retrieve().data[0] = i + 1;
+                sink.post();
+            }
+
+            THEN ("The source reads the oldest frame but can see the latest") {
+                source.wait();
+                REQUIRE( source.latest_index() == 1 );
+                REQUIRE( source.borrow().data[0] == 1 );
+                REQUIRE( source.latest().data[0] == 2 );
+                source.post();
+            }
+        }
+    }
+}
+
+SCENARIO ("Frame sources follow format changes made by the sink.", "[Source, SharedFrameHeader]") {
+
+    GIVEN ("A double-buffered Sink<Frame> and a connected Source<Frame>") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, 10 * 10, 2);
+        sink.retrieve(10, 10, 0, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+        const auto generation = source.generation();
+
+        WHEN ("The sink grows its frames between two writes") {
+
+            sink.wait();
+            sink.retrieve().data[0] = 1;
+            sink.post();
+
+            sink.wait();
+            auto frame = sink.reformat(40, 30, 0, oat::PIX_GREY);
+            frame.data[0] = 2;
+            frame.data[40 * 30 - 1] = 3;
+            sink.post();
+
+            THEN ("The source reads each frame in the format it was written in") {
+                source.wait();
+                REQUIRE( source.generation() == generation );
+                REQUIRE( source.parameters().rows == 10 );
+                REQUIRE( source.borrow().data[0] == 1 );
+                source.post();
+
+                source.wait();
+                REQUIRE( source.generation() > generation );
+                REQUIRE( source.parameters().rows == 40 );
+                REQUIRE( source.parameters().cols == 30 );
+                REQUIRE( source.borrow().rows == 40 );
+                REQUIRE( source.borrow().data[0] == 2 );
+                REQUIRE( source.borrow().data[40 * 30 - 1] == 3 );
+                source.post();
+            }
+        }
+    }
+}
+
+SCENARIO ("Frame sources connected to a view read a rectangle of its parent in place.", "[Source, Sink, SharedFrameHeader]") {
+
+    GIVEN ("A Sink<Frame> and a view of a rectangle of its frames") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Sink<oat::Frame> view;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, 10 * 10);
+        auto frame = sink.retrieve(10, 10, CV_8UC1, oat::PIX_GREY);
+        view.bindView("view", node_addr, cv::Rect(2, 3, 4, 5));
+
+        WHEN ("A source connects to the view and the sink writes a frame") {
+
+            source.touch("view");
+            source.connect();
+
+            sink.wait();
+            for (int r = 0; r < 10; r++)
+                for (int c = 0; c < 10; c++)
+                    frame.at<uint8_t>(r, c) = r * 10 + c;
+            sink.post();
+
+            THEN ("The source reads the rectangle from the sink's frame") {
+                source.wait();
+                const auto &f = source.borrow();
+                REQUIRE( source.is_view() );
+                REQUIRE( source.parameters().rows == 5 );
+                REQUIRE( source.parameters().cols == 4 );
+                REQUIRE( f.rows == 5 );
+                REQUIRE( f.cols == 4 );
+                REQUIRE( f.data == frame.data + 3 * frame.step + 2 );
+                REQUIRE( f.at<uint8_t>(0, 0) == 32 );
+                REQUIRE( f.at<uint8_t>(4, 3) == 75 );
+                source.post();
+            }
+        }
+
+        WHEN ("A view is made of the view") {
+
+            oat::Sink<oat::Frame> inner;
+            inner.bindView("inner", "view", cv::Rect(1, 1, 10, 10));
+
+            source.touch("inner");
+            source.connect();
+
+            THEN ("The source reads the overlap of both rectangles") {
+                REQUIRE( source.view_rect() == cv::Rect(3, 4, 3, 4) );
+            }
+        }
+    }
+}
+
+// Forwards to OpenCV's default allocator, counting the buffers it allocates
+struct CountingAllocator : public cv::MatAllocator {
+
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                           size_t *step, int flags,
+                           cv::UMatUsageFlags usage) const override
+    {
+        count++;
+        return cv::Mat::getStdAllocator()->allocate(
+            dims, sizes, type, data, step, flags, usage);
+    }
+
+    bool allocate(cv::UMatData *u, int flags,
+                  cv::UMatUsageFlags usage) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(u, flags, usage);
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        cv::Mat::getStdAllocator()->deallocate(u);
+    }
+
+    mutable int count {0};
+};
+
+SCENARIO ("Frame copies into a preallocated working frame do not allocate.", "[Source]") {
+
+    GIVEN ("A Sink<Frame>, a connected Source<Frame> and a working frame "
+           "sized from the node's FrameParams") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, 10 * 10);
+        sink.retrieve(10, 10, CV_8UC1, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+
+        CountingAllocator allocator;
+        oat::Frame frame;
+        frame.allocator = &allocator;
+        const auto p = source.parameters();
+        frame.create(p.rows, p.cols, p.type);
+        const auto data = frame.data;
+
+        WHEN ("The source copies several frames") {
+
+            for (uint8_t i = 0; i < 3; i++) {
+                sink.wait();
+                sink.retrieve().data[0] = i + 1;
+                sink.post();
+
+                source.wait();
+                source.copyTo(frame);
+                source.post();
+            }
+
+            THEN ("Every copy reuses the working frame's buffer") {
+                REQUIRE( allocator.count == 1 );
+                REQUIRE( frame.data == data );
+                REQUIRE( frame.data[0] == 3 );
+            }
+        }
+    }
+}
+
+SCENARIO ("Streamed and prefetched frame copies match plain ones.", "[Source]") {
+
+    GIVEN ("A Sink<Frame> writing frames too large to be copied through "
+           "cache and a connected Source<Frame>") {
+
+        const int rows = 1024, cols = 1031; // Rows not a multiple of 16 bytes
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, rows * cols);
+        sink.retrieve(rows, cols, CV_8UC1, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+
+        sink.wait();
+        auto shared = sink.retrieve();
+        for (int i = 0; i < rows * cols; i++)
+            shared.data[i] = static_cast<uint8_t>(i % 251);
+        sink.post();
+
+        source.wait();
+
+        WHEN ("The source copies the frame with each hint") {
+
+            const oat::CopyHint hints[] {oat::CopyHint::CACHED,
+                                         oat::CopyHint::STREAM,
+                                         oat::CopyHint::PREFETCH};
+
+            int matches = 0;
+            for (const auto hint : hints) {
+
+                oat::Frame copy;
+                source.set_copy_hint(hint);
+                source.copyTo(copy);
+                const auto clone = source.clone();
+
+                matches += std::memcmp(copy.data, shared.data, rows * cols) == 0;
+                matches += std::memcmp(clone.data, shared.data, rows * cols) == 0;
+            }
+
+            THEN ("Every copy and clone holds the frame") {
+                REQUIRE( matches == 6 );
+            }
+        }
+
+        source.post();
+    }
+}
+
+SCENARIO ("Frame sinks can compute a frame pyramid for their sources.", "[Source, Sink, SharedFrameHeader]") {
+
+    const auto quarter = oat::FramePlane::QUARTER;
+    const auto eighth = oat::FramePlane::EIGHTH;
+
+    GIVEN ("A Sink<Frame> computing two area pyramid levels of its frames, "
+           "and a connected Source<Frame>") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.set_planes(1u << static_cast<size_t>(quarter));
+        sink.bind(node_addr, 12 * 20);
+        sink.retrieve(12, 20, CV_8UC1, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+
+        THEN ("The node hosts the level above the one asked for too") {
+            REQUIRE( source.hosts(oat::FramePlane::HALF) );
+            REQUIRE( source.hosts(quarter) );
+            REQUIRE_FALSE( source.hosts(eighth) );
+        }
+
+        WHEN ("The sink writes a frame with one bright 2x2 block") {
+
+            sink.wait();
+            auto frame = sink.retrieve();
+            for (int r = 0; r < frame.rows; r++)
+                for (int c = 0; c < frame.cols; c++)
+                    frame.at<uint8_t>(r, c) = r < 2 && c < 2 ? 120 : 40;
+            sink.post();
+
+            source.wait();
+
+            THEN ("Both levels are ready for the source when it reads") {
+                auto half = source.plane(oat::FramePlane::HALF);
+                auto q = source.plane(quarter);
+                REQUIRE( half.rows == 6 );
+                REQUIRE( half.cols == 10 );
+                REQUIRE( q.rows == 3 );
+                REQUIRE( q.cols == 5 );
+                REQUIRE( half.at<uint8_t>(0, 0) == 120 );
+                REQUIRE( q.at<uint8_t>(0, 0) == 60 );
+                REQUIRE( q.at<uint8_t>(2, 4) == 40 );
+            }
+
+            THEN ("Levels the node does not host are computed by the source") {
+                auto e = source.plane(eighth);
+                REQUIRE( e.rows == 1 );
+                REQUIRE( e.cols == 2 );
+                REQUIRE( e.at<uint8_t>(0, 0) == 45 );
+            }
+
+            source.post();
+        }
+    }
+
+    GIVEN ("A Sink<Frame> computing a Gaussian pyramid of its frames") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.set_planes(1u << static_cast<size_t>(eighth),
+                        oat::PyramidFilter::GAUSSIAN);
+        sink.bind(node_addr, 12 * 20);
+        sink.retrieve(12, 20, CV_8UC1, oat::PIX_GREY);
+
+        source.touch(node_addr);
+        source.connect();
+
+        THEN ("Level sizes are rounded up, as cv::pyrDown rounds them") {
+            REQUIRE( source.pyramid_filter() == oat::PyramidFilter::GAUSSIAN );
+            REQUIRE( source.planeParameters(quarter).rows == 3 );
+            REQUIRE( source.planeParameters(quarter).cols == 5 );
+            REQUIRE( source.planeParameters(eighth).rows == 2 );
+            REQUIRE( source.planeParameters(eighth).cols == 3 );
+        }
+    }
+}
+
+SCENARIO ("Latest-value sources never block the sink.", "[Source]") {
+
+    GIVEN ("A bound Sink<int> and a Source<int> connected in LATEST mode") {
+
+        oat::Sink<int> sink;
+        oat::Source<int> source;
+
+        sink.bind(node_addr);
+        source.touch(node_addr, oat::SourceMode::LATEST);
+        source.connect();
+
+        REQUIRE( source.mode() == oat::SourceMode::LATEST );
+
+        WHEN ("The sink writes several times before the source reads") {
+
+            for (int i = 1; i <= 3; i++) {
+                sink.wait();
+                *sink.retrieve() = i;
+                sink.post();
+            }
+
+            THEN ("The source sees only the latest value") {
+                REQUIRE( source.wait() == oat::NodeState::SINK_BOUND );
+                REQUIRE( source.clone() == 3 );
+                source.post();
+            }
+
+            AND_THEN ("The values it skipped are counted as drops") {
+                source.wait();
+                REQUIRE( source.dropped() == 2 );
+                source.post();
+            }
+        }
+
+        WHEN ("The source reads every value as it is written") {
+
+            for (int i = 1; i <= 3; i++) {
+                sink.wait();
+                *sink.retrieve() = i;
+                sink.post();
+
+                source.wait();
+                REQUIRE( source.clone() == i );
+                source.post();
+            }
+
+            THEN ("No values are dropped") {
+                REQUIRE( source.dropped() == 0 );
+            }
+        }
+    }
+}
+
+SCENARIO ("Position sources read the records written by position sinks.", "[Source, SharedPosition]") {
+
+    GIVEN ("A double-buffered Sink<Position2D> and a connected Source<Position2D>") {
+
+        oat::Sink<oat::Position2D> sink;
+        oat::Source<oat::Position2D> source;
+
+        sink.bind(node_addr, "anterior", 2);
+        source.touch(node_addr);
+        source.connect();
+
+        REQUIRE( std::string(source.label()) == "anterior" );
+
+        WHEN ("The sink writes two positions in world units before the source reads") {
+
+            cv::Matx33d h {2.0, 0, 0, 0, 2.0, 0, 0, 0, 1.0};
+
+            for (int i = 0; i < 2; i++) {
+                oat::Position2D pos("ignored");
+                pos.setCoordSystem(oat::DistanceUnit::WORLD, h);
+                pos.position_valid = true;
+                pos.position = oat::Point2D(i + 1, 0);
+                sink.wait();
+                sink.write(pos);
+                sink.post();
+            }
+
+            THEN ("The source reads each record in order with the node's label and coordinate system") {
+
+                for (int i = 0; i < 2; i++) {
+                    source.wait();
+                    REQUIRE( source.retrieve()->position[0] == i + 1 );
+
+                    auto pos = source.clone();
+                    source.post();
+
+                    REQUIRE( std::string(pos.label()) == "anterior" );
+                    REQUIRE( pos.position_valid );
+                    REQUIRE( pos.position.x == i + 1 );
+                    REQUIRE( pos.unit_of_length() == oat::DistanceUnit::WORLD );
+                    REQUIRE( pos.homography()(0, 0) == 2.0 );
+                }
+            }
+        }
+    }
+}
+
+SCENARIO ("Position sources can scan the history kept by position sinks.", "[Source, SharedPosition]") {
+
+    GIVEN ("A Sink<Position2D> keeping 4 positions and a connected Source<Position2D>") {
+
+        oat::Sink<oat::Position2D> sink;
+        oat::Source<oat::Position2D> source;
+
+        sink.set_history(4);
+        sink.bind(node_addr, "anterior");
+        source.touch(node_addr);
+        source.connect();
+
+        auto history = source.history();
+        REQUIRE( history != nullptr );
+        REQUIRE( history->capacity() == 4 );
+
+        WHEN ("The sink publishes samples 1 to 6") {
+
+            for (uint64_t i = 1; i <= 6; i++) {
+                oat::Position2D pos("ignored");
+                oat::Sample sample;
+                sample.set_count(i);
+                pos.set_sample(sample);
+                pos.position_valid = true;
+                pos.position = oat::Point2D(i, 0);
+                sink.wait();
+                sink.write(pos);
+                sink.post();
+                source.wait();
+                source.post();
+            }
+
+            std::vector<oat::PositionRecord> records;
+
+            THEN ("Only the last 4 are held, oldest first") {
+                REQUIRE( history->written() == 6 );
+                REQUIRE( history->read(0, 100, records) == 4 );
+                REQUIRE( records.front().sample.count() == 3 );
+                REQUIRE( records.back().sample.count() == 6 );
+                REQUIRE( records.back().position[0] == 6 );
+            }
+
+            THEN ("A range of sample numbers can be read") {
+                REQUIRE( history->read(4, 5, records) == 2 );
+                REQUIRE( records[0].sample.count() == 4 );
+                REQUIRE( records[1].sample.count() == 5 );
+            }
+
+            THEN ("The latest positions can be read") {
+                REQUIRE( history->latest(2, records) == 2 );
+                REQUIRE( records[0].sample.count() == 5 );
+                REQUIRE( records[1].sample.count() == 6 );
+            }
+        }
+    }
+
+    GIVEN ("A Sink<Position2D> keeping no history") {
+
+        oat::Sink<oat::Position2D> sink;
+        oat::Source<oat::Position2D> source;
+
+        sink.bind(node_addr, "anterior");
+        source.touch(node_addr);
+        source.connect();
+
+        THEN ("Sources find no history") {
+            REQUIRE( source.history() == nullptr );
+        }
+    }
+}
+
+SCENARIO ("Position array sources read every object in a single copy.", "[Source, PositionArray]") {
+
+    GIVEN ("A bound Sink<PositionArray> and a connected Source<PositionArray>") {
+
+        oat::Sink<oat::PositionArray> sink;
+        oat::Source<oat::PositionArray> source;
+
+        sink.bind(node_addr);
+        source.touch(node_addr);
+        source.connect();
+
+        WHEN ("The sink writes more objects than an array can hold") {
+
+            oat::PositionArray objects;
+            const auto capacity = oat::PositionArray::CAPACITY;
+            for (size_t i = 0; i < capacity; i++)
+                REQUIRE( objects.push(i, 2.0 * i, 10) );
+            REQUIRE( !objects.push(0, 0, 10) );
+
+            sink.wait();
+            *sink.retrieve() = objects;
+            sink.post();
+
+            THEN ("The source reads the objects that fit") {
+                source.wait();
+                auto read = source.clone();
+                source.post();
+
+                REQUIRE( read.size() == capacity );
+                REQUIRE( read.valid[capacity - 1] );
+                REQUIRE( read.x[capacity - 1] == capacity - 1 );
+                REQUIRE( read.y[capacity - 1] == 2.0 * (capacity - 1) );
+                REQUIRE( read.sample().num_stamps() == 1 );
+            }
+        }
+    }
+}
 
 // TODO: specialization tests
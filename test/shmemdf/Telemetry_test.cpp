@@ -0,0 +1,134 @@
+//******************************************************************************
+//* File:   Telemetry_test.cpp
+//* Author: Jon Newman <jpnewman snail mit dot edu>
+//*
+//* Copyright (c) Jon Newman (jpnewman snail mit dot edu)
+//* All right reserved.
+//* This file is part of the Oat project.
+//* This is free software: you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation, either version 3 of the License, or
+//* (at your option) any later version.
+//* This software is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//* You should have received a copy of the GNU General Public License
+//* along with this source code.  If not, see <http://www.gnu.org/licenses/>.
+//******************************************************************************
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <string>
+
+#include "../../lib/shmemdf/Segment.h"
+#include "../../lib/shmemdf/Sink.h"
+#include "../../lib/shmemdf/Source.h"
+#include "../../lib/shmemdf/Telemetry.h"
+
+// Global via extern in Globals.h
+namespace oat { volatile sig_atomic_t quit = 0; }
+
+SCENARIO ("Latency histograms bin durations by powers of two.", "[Telemetry]") {
+
+    GIVEN ("An empty histogram") {
+
+        oat::LatencyHistogram h;
+        auto empty = h.snapshot();
+
+        REQUIRE( oat::LatencyHistogram::count(empty) == 0 );
+        REQUIRE( oat::LatencyHistogram::quantile(empty, 0.5) == 0 );
+
+        WHEN ("99 short and 1 long duration are recorded") {
+
+            for (int i = 0; i < 99; i++)
+                h.record(1000);
+            h.record(1000000);
+
+            auto d = oat::LatencyHistogram::difference(h.snapshot(), empty);
+
+            THEN ("The median bin bounds the short duration") {
+                REQUIRE( oat::LatencyHistogram::count(d) == 100 );
+                REQUIRE( oat::LatencyHistogram::quantile(d, 0.5) >= 1000 );
+                REQUIRE( oat::LatencyHistogram::quantile(d, 0.5) < 2000 );
+            }
+
+            THEN ("The maximum bin bounds the long duration") {
+                REQUIRE( oat::LatencyHistogram::quantile(d, 1.0) >= 1000000 );
+                REQUIRE( oat::LatencyHistogram::quantile(d, 1.0) < 2000000 );
+            }
+        }
+    }
+}
+
+SCENARIO ("Nodes record sink and source timing.", "[Telemetry]") {
+
+    GIVEN ("A bound Sink<int> and a connected Source<int>") {
+
+        oat::Sink<int> sink;
+        oat::Source<int> source;
+
+        sink.bind("test_telemetry");
+        source.touch("test_telemetry");
+        source.connect();
+
+        WHEN ("Two samples pass through the node") {
+
+            for (int i = 0; i < 2; i++) {
+                sink.wait();
+                sink.post();
+                source.wait();
+                source.post();
+            }
+
+            THEN ("Each sink wait and read hold is counted") {
+
+                oat::Segment segment;
+                auto node = segment.observe("test_telemetry_node");
+                REQUIRE( node != nullptr );
+
+                auto &t = node->sink_telemetry();
+                REQUIRE( oat::LatencyHistogram::count(t.wait.snapshot()) == 2 );
+                REQUIRE( oat::LatencyHistogram::count(t.write_interval.snapshot()) == 1 );
+                REQUIRE( oat::LatencyHistogram::count(node->read_hold(0).snapshot()) == 2 );
+            }
+        }
+    }
+}
+
+SCENARIO ("Sinks publish transport losses to observers.", "[Telemetry]") {
+
+    GIVEN ("A bound Sink<int>") {
+
+        oat::Sink<int> sink;
+        sink.bind("test_transport");
+
+        oat::Segment segment;
+        auto node = segment.observe("test_transport_node");
+        REQUIRE( node != nullptr );
+
+        THEN ("No losses are counted") {
+            const auto &t = node->sink_telemetry().transport;
+            REQUIRE( t.dropped == 0 );
+            REQUIRE( t.corrupt == 0 );
+            REQUIRE( t.resends_requested == 0 );
+            REQUIRE( t.resends_received == 0 );
+        }
+
+        WHEN ("The sink's producer sets its loss totals") {
+
+            sink.transport().dropped = 3;
+            sink.transport().resends_requested = 40;
+            sink.transport().resends_received = 38;
+
+            THEN ("An observer of the node reads them") {
+                const auto &t = node->sink_telemetry().transport;
+                REQUIRE( t.dropped == 3 );
+                REQUIRE( t.corrupt == 0 );
+                REQUIRE( t.resends_requested == 40 );
+                REQUIRE( t.resends_received == 38 );
+            }
+        }
+    }
+}
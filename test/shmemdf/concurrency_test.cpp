@@ -525,3 +525,56 @@ SCENARIO ("Sources attaching or detaching during source or sink wait() periods "
         }
     }
 }
+
+SCENARIO ("A ring Sink<Frame> does not block on a lagging source until "
+          "all of its buffers are full.", "[Sink, Source, Concurrency]") {
+
+    GIVEN ("A Sink<Frame> with 2 buffers and a connected Source<Frame>") {
+
+        oat::Sink<oat::Frame> sink;
+        oat::Source<oat::Frame> source;
+
+        sink.bind(node_addr, 100, 2);
+        auto frame = sink.retrieve(10, 10, CV_8UC1, oat::PIX_GREY);
+        REQUIRE(frame.data != nullptr);
+
+        source.touch(node_addr);
+        source.connect();
+
+        WHEN ("The sink writes two distinct frames") {
+
+            for (int i = 0; i < 2; i++) {
+                REQUIRE_NOTHROW(sink.wait());
+                frame = sink.retrieve();
+                frame.data[0] = i;
+                frame.incrementSampleCount();
+                REQUIRE_NOTHROW(sink.post());
+            }
+
+            THEN ("A third write shall block until the source reads") {
+
+                auto fut = std::async(std::launch::async, [&sink]{ sink.wait(); });
+
+                std::this_thread::sleep_for(msec(5));
+                auto status = fut.wait_for(msec(0));
+                REQUIRE(status != std::future_status::ready);
+
+                REQUIRE_NOTHROW(source.wait());
+                REQUIRE(source.retrieve()->data[0] == 0);
+                REQUIRE(source.retrieve()->sample_count() == 1);
+                REQUIRE_NOTHROW(source.post());
+
+                std::this_thread::sleep_for(msec(1));
+                status = fut.wait_for(msec(0));
+                REQUIRE(status == std::future_status::ready);
+
+                AND_THEN ("The source reads the second frame next") {
+                    REQUIRE_NOTHROW(source.wait());
+                    REQUIRE(source.retrieve()->data[0] == 1);
+                    REQUIRE(source.retrieve()->sample_count() == 2);
+                    REQUIRE_NOTHROW(source.post());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,408 @@
+#!/usr/bin/env python3
+
+# Long-duration soak and chaos test of the shared memory transport.
+#
+# A soak description (TOML, see soak/) lists the components to run, all of
+# which run until stopped. A component with a count is launched that many
+# times, with {i} in its name and arguments replaced by its index, which is
+# how a node is given as many readers as it has slots. Once every component
+# has connected, the test runs for the given duration. Meanwhile, at random
+# intervals, a random component is killed, usually with SIGKILL to simulate a
+# crash and otherwise with SIGINT, and restarted shortly after. Components
+# that exit on their own are restarted too, and counted as crashes if their
+# exit status was not 0.
+#
+# Node telemetry is taken over consecutive windows with `oat top --json`,
+# which attaches afresh each window so that nodes rebound after a crash are
+# followed. Each window records the write rate and p50/p99/p99.9 write
+# interval, sink wait and source hold times of every node, the number of
+# bound sources, and the number of segments in /dev/shm.
+#
+# The run is flagged, and the script exits with status 1, if
+#  - throughput over the last windows fell by more than --max-slowdown from
+#    the first windows,
+#  - p99 write interval grew by more than --max-tail-growth times,
+#  - a node wrote nothing for a whole window that had no chaos event,
+#  - the number of segments in /dev/shm kept growing during the run, or
+#  - once every component has been stopped, segments remain that were not in
+#    /dev/shm before the run. `oat clean --report` is printed for them.
+# Results are printed as JSON.
+#
+# Usage: soak.py SOAK [-t SECONDS] [-D key=value ...] [-o results.json]
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import random
+import signal
+import statistics
+import subprocess
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..', 'perf'))
+from bench import git_commit, load_toml, quantile, substitute
+
+SHM = '/dev/shm'
+
+def segments():
+    try:
+        return set(os.listdir(SHM))
+    except OSError:
+        return set()
+
+def tail_ms(bins):
+    out = {}
+    for name, q in (('p50', 0.5), ('p99', 0.99), ('p999', 0.999)):
+        v = quantile(bins, q)
+        out[name] = None if v is None else v / 1e6
+    return out
+
+def max_bins(sources):
+    """Hold histogram of the source with the longest p99 hold time."""
+    worst, worst_p99 = [], -1
+    for s in sources:
+        p99 = quantile(s['hold'], 0.99)
+        if p99 is not None and p99 > worst_p99:
+            worst, worst_p99 = s['hold'], p99
+    return worst
+
+class Component:
+    """A component that is killed and restarted during the soak."""
+
+    def __init__(self, name, argv, sources, quiet):
+        self.name = name
+        self.argv = argv
+        self.sources = sources
+        self.quiet = quiet
+        self.proc = None
+        self.killed = False
+        self.restarts = 0
+        self.crashes = 0
+
+    def start(self):
+        out = subprocess.DEVNULL if self.quiet else None
+        self.proc = subprocess.Popen(self.argv, stdout=out)
+        self.killed = False
+
+    def kill(self, sig):
+        self.killed = True
+        self.proc.send_signal(sig)
+        try:
+            self.proc.wait(10)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+
+    def poll(self):
+        """True if the component exited without being killed."""
+        if self.killed or self.proc.poll() is None:
+            return False
+        if self.proc.returncode != 0:
+            self.crashes += 1
+        return True
+
+def expand(desc, variables, oat):
+    components = []
+    for c in desc['component']:
+        count = int(str(c.get('count', 1)).format(**variables))
+        for i in range(count):
+            v = dict(variables, i=i)
+            components.append(Component(
+                str(c['name']).format(**v),
+                [oat] + substitute(c['args'], v),
+                c.get('sources', []),
+                c.get('quiet', True)))
+    return components
+
+def wait_ready(oat, components, timeout):
+    expected = {}
+    for c in components:
+        for s in c.sources:
+            expected[s] = expected.get(s, 0) + 1
+
+    if not expected:
+        return
+
+    names = ['%s:%d' % (n, k) for n, k in sorted(expected.items())]
+    if subprocess.call([oat, 'await', '-t', str(timeout)] + names) != 0:
+        raise RuntimeError('Components did not connect within %g s.'
+                           % timeout)
+
+class Chaos:
+    """Kills and restarts random components at exponentially distributed
+    intervals, and restarts those that exit on their own."""
+
+    def __init__(self, components, period, restart_delay, crash_fraction,
+                 seed):
+        self.components = components
+        self.period = period
+        self.restart_delay = restart_delay
+        self.crash_fraction = crash_fraction
+        self.random = random.Random(seed)
+        self.events = []
+        self.lock = threading.Lock()
+        self.running = True
+        self.thread = threading.Thread(target=self._run)
+        self.thread.start()
+
+    def _event(self, t, component, what):
+        with self.lock:
+            self.events.append({'t': t, 'component': component, 'event': what})
+
+    def take(self):
+        """Events since the last call."""
+        with self.lock:
+            events, self.events = self.events, []
+        return events
+
+    def _run(self):
+        t0 = time.monotonic()
+        next_kill = self.random.expovariate(1.0 / self.period) \
+                    if self.period > 0 else float('inf')
+
+        while self.running:
+            time.sleep(0.05)
+            now = time.monotonic() - t0
+
+            for c in self.components:
+                if c.poll():
+                    self._event(now, c.name,
+                                'exited %d' % c.proc.returncode)
+                    c.start()
+                    c.restarts += 1
+
+            if now < next_kill:
+                continue
+
+            c = self.random.choice(self.components)
+            crash = self.random.random() < self.crash_fraction
+            c.kill(signal.SIGKILL if crash else signal.SIGINT)
+            self._event(now, c.name, 'SIGKILL' if crash else 'SIGINT')
+            time.sleep(self.random.uniform(0, self.restart_delay))
+            c.start()
+            c.restarts += 1
+
+            next_kill = now + self.random.expovariate(1.0 / self.period)
+
+    def stop(self):
+        self.running = False
+        self.thread.join()
+
+def measure(oat, nodes, window):
+    """Telemetry of nodes over one window."""
+    result = {n: None for n in nodes}
+    try:
+        out = subprocess.check_output(
+            [oat, 'top', '--json', '-n', '1', '-p', str(window)] + nodes,
+            universal_newlines=True)
+        report = json.loads(out.strip().splitlines()[-1])
+    except (subprocess.CalledProcessError, ValueError, IndexError):
+        return result
+
+    for n in report['nodes']:
+        if not n['found']:
+            result[n['name']] = None
+            continue
+        result[n['name']] = {
+            'writes': n['writes'],
+            'fps': n['writes'] / window,
+            'sources': len(n['sources']),
+            'interval_ms': tail_ms(n['interval']),
+            'sink_wait_ms': tail_ms(n['wait']),
+            'worst_hold_ms': tail_ms(max_bins(n['sources']))
+        }
+    return result
+
+def stop(components, timeout):
+    """Interrupt every component. Returns the names of those that had to be
+    killed."""
+    for c in components:
+        if c.proc.poll() is None:
+            c.proc.send_signal(signal.SIGINT)
+
+    hung = []
+    deadline = time.monotonic() + timeout
+    for c in components:
+        try:
+            c.proc.wait(max(0.0, deadline - time.monotonic()))
+        except subprocess.TimeoutExpired:
+            c.proc.kill()
+            c.proc.wait()
+            hung.append(c.name)
+    return hung
+
+def trend(windows, node, key, n):
+    """Medians of a per-window value over the first and last n windows in
+    which the node was found."""
+    values = [w['nodes'][node][key] for w in windows
+              if w['nodes'].get(node) is not None
+              and w['nodes'][node][key] is not None]
+    if len(values) < 2 * n:
+        return None, None
+    return statistics.median(values[:n]), statistics.median(values[-n:])
+
+def judge(windows, nodes, args):
+    flags = []
+    n = args.compare_windows
+
+    for node in nodes:
+        first, last = trend(windows, node, 'fps', n)
+        if first and last < (1.0 - args.max_slowdown) * first:
+            flags.append('%s: throughput fell from %.1f to %.1f Hz'
+                         % (node, first, last))
+
+        p99 = [w['nodes'][node]['interval_ms']['p99'] for w in windows
+               if w['nodes'].get(node) is not None]
+        p99 = [v for v in p99 if v is not None]
+        if len(p99) >= 2 * n:
+            first, last = statistics.median(p99[:n]), statistics.median(p99[-n:])
+            if first > 0 and last > args.max_tail_growth * first:
+                flags.append('%s: p99 write interval grew from %.3f to %.3f '
+                             'ms' % (node, first, last))
+
+        for w in windows:
+            r = w['nodes'].get(node)
+            if not w['events'] and (r is None or r['writes'] == 0):
+                flags.append('%s: no writes in the window ending at %.0f s'
+                             % (node, w['t']))
+
+    # Segments of crashed sinks are reclaimed when they are rebound, so the
+    # count should level off once every component has crashed at least once
+    counts = [w['segments'] for w in windows]
+    if len(counts) >= 2 * n and min(counts[-n:]) > max(counts[n:2 * n]):
+        flags.append('Segments in %s grew from %d to %d'
+                     % (SHM, max(counts[n:2 * n]), min(counts[-n:])))
+
+    return flags
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Soak and chaos test of the transport described by SOAK.')
+    parser.add_argument('soak', help='TOML soak description.')
+    parser.add_argument('-t', '--duration', type=float,
+                        help='Seconds to run. Overrides the description.')
+    parser.add_argument('-D', dest='defines', action='append', default=[],
+                        metavar='KEY=VALUE',
+                        help='Override a [vars] entry of the description.')
+    parser.add_argument('-o', '--output', help='Write JSON results here '
+                        'instead of to stdout.')
+    parser.add_argument('--oat', default='oat', help='oat executable.')
+    parser.add_argument('--seed', type=int, help='Seed of the chaos schedule.')
+    parser.add_argument('--no-chaos', action='store_true',
+                        help='Run without killing components, as a baseline.')
+    parser.add_argument('--crash-fraction', type=float, default=0.75,
+                        help='Fraction of kills that use SIGKILL rather than '
+                             'SIGINT.')
+    parser.add_argument('--restart-delay', type=float, default=1.0,
+                        help='Longest time, in seconds, a killed component '
+                             'stays down.')
+    parser.add_argument('--compare-windows', type=int, default=3,
+                        help='Windows at the start and end of the run '
+                             'compared to detect degradation.')
+    parser.add_argument('--max-slowdown', type=float, default=0.1,
+                        help='Largest tolerated fractional drop in '
+                             'throughput.')
+    parser.add_argument('--max-tail-growth', type=float, default=2.0,
+                        help='Largest tolerated growth factor of p99 write '
+                             'interval.')
+    parser.add_argument('--ready-timeout', type=float, default=10.0,
+                        help='Seconds to wait for components to connect.')
+    parser.add_argument('--exit-timeout', type=float, default=10.0,
+                        help='Seconds to wait for components to exit at the '
+                             'end of the run.')
+    args = parser.parse_args()
+
+    desc = load_toml(args.soak)
+    soak = desc['soak']
+
+    variables = dict(desc.get('vars', {}))
+    for d in args.defines:
+        key, _, value = d.partition('=')
+        variables[key] = value
+
+    duration = args.duration or soak.get('duration', 3600)
+    window = soak.get('window', 10)
+    period = 0 if args.no_chaos else soak.get('chaos-period', 20)
+    nodes = soak['nodes']
+
+    # Paths in descriptions are relative to the description's directory
+    os.chdir(os.path.dirname(os.path.abspath(args.soak)))
+
+    before = segments()
+    components = expand(desc, variables, args.oat)
+    windows = []
+    chaos = None
+    try:
+        for c in components:
+            c.start()
+        wait_ready(args.oat, components, args.ready_timeout)
+
+        chaos = Chaos(components, period, args.restart_delay,
+                      args.crash_fraction, args.seed)
+
+        t0 = time.monotonic()
+        while time.monotonic() - t0 < duration:
+            w = {'nodes': measure(args.oat, nodes, window)}
+            w['t'] = time.monotonic() - t0
+            w['events'] = chaos.take()
+            w['segments'] = len(segments() - before)
+            windows.append(w)
+
+            print('%s: %.0f/%.0f s, %s, %d event(s), %d segment(s)' % (
+                      soak.get('name', args.soak), w['t'], duration,
+                      ', '.join('%s %s' % (k, 'down' if v is None
+                                           else '%.0f Hz' % v['fps'])
+                                for k, v in w['nodes'].items()),
+                      len(w['events']), w['segments']),
+                  file=sys.stderr)
+
+    finally:
+        if chaos:
+            chaos.stop()
+        hung = stop(components, args.exit_timeout)
+
+    flags = judge(windows, nodes, args)
+    for name in hung:
+        flags.append('%s did not exit when interrupted' % name)
+
+    leaked = sorted(segments() - before)
+    if leaked:
+        flags.append('Segments left in %s: %s' % (SHM, ', '.join(leaked)))
+        subprocess.call([args.oat, 'clean', '--report'])
+
+    results = {
+        'name': soak.get('name', os.path.basename(args.soak)),
+        'date': datetime.datetime.now().isoformat(),
+        'commit': git_commit('.'),
+        'machine': {'node': platform.node(),
+                    'system': platform.platform(),
+                    'processor': platform.processor(),
+                    'cpus': os.cpu_count()},
+        'vars': variables,
+        'seed': args.seed,
+        'components': {c.name: {'restarts': c.restarts, 'crashes': c.crashes}
+                       for c in components},
+        'flags': flags,
+        'leaked_segments': leaked,
+        'windows': windows
+    }
+
+    out = json.dumps(results, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(out + '\n')
+    else:
+        print(out)
+
+    for f in flags:
+        print('FLAG: ' + f, file=sys.stderr)
+
+    return 1 if flags else 0
+
+if __name__ == '__main__':
+    sys.exit(main())